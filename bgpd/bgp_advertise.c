@@ -37,6 +37,7 @@ Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
 #include "bgpd/bgp_packet.h"
 #include "bgpd/bgp_fsm.h"
 #include "bgpd/bgp_mplsvpn.h"
+#include "bgpd/bgp_updgrp.h"
 
 /* BGP advertise attribute is used for pack same attribute update into
    one packet.  To do that we maintain attribute hash in struct
@@ -75,7 +76,11 @@ static int baa_hash_cmp(const void *p1, const void *p2) {
    structure.  This structure is referred from BGP adjacency
    information.  */
 static struct bgp_advertise *bgp_advertise_new(void) {
-	return (struct bgp_advertise *) XCALLOC(MTYPE_BGP_ADVERTISE, sizeof(struct bgp_advertise));
+	struct bgp_advertise *adv;
+
+	adv = XCALLOC(MTYPE_BGP_ADVERTISE, sizeof(struct bgp_advertise));
+	quagga_gettime(QUAGGA_CLK_MONOTONIC, &adv->queued);
+	return adv;
 }
 
 static void bgp_advertise_free(struct bgp_advertise *adv) {
@@ -137,20 +142,208 @@ static void bgp_adj_out_free(struct bgp_adj_out *adj) {
 	XFREE(MTYPE_BGP_ADJ_OUT, adj);
 }
 
-int bgp_adj_out_lookup(struct peer *peer, struct prefix *p, afi_t afi, safi_t safi, struct bgp_node *rn) {
+/* Whether the peer's bit is set in a shared entry */
+int bgp_adj_shared_member(struct bgp_adj_shared *as, struct peer *peer, afi_t afi, safi_t safi) {
+	unsigned int i = peer->updgrp_index[afi][safi];
+
+	return (as->updgrp == peer->updgrp[afi][safi] && i < as->words * 32U && (as->bits[i / 32] & (1U << (i % 32))));
+}
+
+/* The group's shared entry on rn for the path ID, if the peer's bit is
+   set in it */
+static struct bgp_adj_shared *bgp_adj_shared_lookup(struct bgp_node *rn, struct peer *peer, afi_t afi, safi_t safi, u_int32_t addpath_tx_id) {
+	struct update_group *group = peer->updgrp[afi][safi];
+	struct bgp_adj_shared *as;
+
+	if(!group || !rn) {
+		return NULL;
+	}
+
+	for(as = rn->adj_shared; as; as = as->next) {
+		if(as->updgrp == group && as->addpath_tx_id == addpath_tx_id) {
+			break;
+		}
+	}
+
+	if(!as || !bgp_adj_shared_member(as, peer, afi, safi)) {
+		return NULL;
+	}
+	return as;
+}
+
+static void bgp_adj_shared_unset_bit(struct bgp_node *rn, struct bgp_adj_shared *as, unsigned int i) {
+	as->bits[i / 32] &= ~(1U << (i % 32));
+	if(--as->count) {
+		return;
+	}
+
+	BGP_ADJ_SHARED_DEL(rn, as);
+	bgp_attr_unintern(&as->attr);
+	XFREE(MTYPE_BGP_ADJ_SHARED, as);
+	bgp_unlock_node(rn);
+}
+
+/* Give the peer its own adj-out again, holding whatever the group's
+   shared entry said it was sent. */
+static struct bgp_adj_out *bgp_adj_out_detach(struct bgp_node *rn, struct peer *peer, afi_t afi, safi_t safi, u_int32_t addpath_tx_id) {
+	struct bgp_adj_shared *as;
+	struct bgp_adj_out *adj;
+
+	if((as = bgp_adj_shared_lookup(rn, peer, afi, safi, addpath_tx_id)) == NULL) {
+		return NULL;
+	}
+
+	adj = XCALLOC(MTYPE_BGP_ADJ_OUT, sizeof(struct bgp_adj_out));
+	adj->peer = peer_lock(peer); /* adj_out peer reference */
+	adj->attr = bgp_attr_intern(as->attr);
+	adj->addpath_tx_id = addpath_tx_id;
+	BGP_ADJ_OUT_ADD(rn, adj);
+	bgp_lock_node(rn);
+
+	bgp_adj_shared_unset_bit(rn, as, peer->updgrp_index[afi][safi]);
+	return adj;
+}
+
+static struct bgp_adj_out *bgp_adj_out_get(struct bgp_node *rn, struct peer *peer, afi_t afi, safi_t safi, u_int32_t addpath_tx_id) {
 	struct bgp_adj_out *adj;
 
 	for(adj = rn->adj_out; adj; adj = adj->next) {
-		if(adj->peer == peer) {
+		if(adj->peer == peer && adj->addpath_tx_id == addpath_tx_id) {
+			return adj;
+		}
+	}
+	return bgp_adj_out_detach(rn, peer, afi, safi, addpath_tx_id);
+}
+
+/* Once all the peer's own adj-out holds is what it was sent, merge it into
+   the group's shared entry, unless that says something else. */
+void bgp_adj_out_fold(struct bgp_node *rn, struct bgp_adj_out *adj, struct peer *peer, afi_t afi, safi_t safi) {
+	struct update_group *group = peer->updgrp[afi][safi];
+	struct bgp_adj_shared *as;
+	unsigned int i = peer->updgrp_index[afi][safi];
+
+	if(!group || !rn || adj->adv || !adj->attr || !BGP_ADJ_SHARED_SAFI(safi) || bgp_node_table(rn)->type != BGP_TABLE_MAIN) {
+		return;
+	}
+
+	for(as = rn->adj_shared; as; as = as->next) {
+		if(as->updgrp == group && as->addpath_tx_id == adj->addpath_tx_id) {
 			break;
 		}
 	}
 
-	if(!adj) {
-		return 0;
+	if(!as) {
+		as = XCALLOC(MTYPE_BGP_ADJ_SHARED, sizeof(struct bgp_adj_shared) + group->index_words * sizeof(u_int32_t));
+		as->updgrp = group;
+		as->attr = bgp_attr_intern(adj->attr);
+		as->addpath_tx_id = adj->addpath_tx_id;
+		as->words = group->index_words;
+		BGP_ADJ_SHARED_ADD(rn, as);
+		bgp_lock_node(rn);
+	} else if(as->attr != adj->attr) {
+		return;
+	} else if(i >= as->words * 32U) {
+		struct bgp_adj_shared *old = as;
+
+		as = XREALLOC(MTYPE_BGP_ADJ_SHARED, old, sizeof(struct bgp_adj_shared) + group->index_words * sizeof(u_int32_t));
+		memset(&as->bits[as->words], 0, (group->index_words - as->words) * sizeof(u_int32_t));
+		as->words = group->index_words;
+
+		/* relink */
+		if(as->next) {
+			as->next->prev = as;
+		}
+		if(as->prev) {
+			as->prev->next = as;
+		} else {
+			rn->adj_shared = as;
+		}
 	}
 
-	return (adj->adv ? (adj->adv->baa ? 1 : 0) : (adj->attr ? 1 : 0));
+	as->bits[i / 32] |= (1U << (i % 32));
+	as->count++;
+
+	BGP_ADJ_OUT_DEL(rn, adj);
+	bgp_attr_unintern(&adj->attr);
+	bgp_adj_out_free(adj);
+	bgp_unlock_node(rn);
+}
+
+/* Forget the peer's part of the group's shared entries on rn */
+void bgp_adj_out_shared_unset(struct bgp_node *rn, struct peer *peer, afi_t afi, safi_t safi) {
+	struct bgp_adj_shared *as, *next;
+
+	for(as = rn->adj_shared; as; as = next) {
+		next = as->next;
+		if(bgp_adj_shared_member(as, peer, afi, safi)) {
+			bgp_adj_shared_unset_bit(rn, as, peer->updgrp_index[afi][safi]);
+		}
+	}
+}
+
+/* The peer is leaving its update-group.  Either move its part of the
+   group's shared entries back to adj-outs of its own, or, if its adj-out
+   state is being dropped anyway, just forget it. */
+void bgp_adj_out_shared_leave(struct peer *peer, afi_t afi, safi_t safi, int detach) {
+	struct bgp_table *table = peer->bgp->rib[afi][safi];
+	struct bgp_node *rn;
+
+	if(!table || !BGP_ADJ_SHARED_SAFI(safi)) {
+		return;
+	}
+
+	for(rn = bgp_table_top(table); rn; rn = bgp_route_next(rn)) {
+		struct bgp_adj_shared *as, *next;
+
+		if(!detach) {
+			bgp_adj_out_shared_unset(rn, peer, afi, safi);
+			continue;
+		}
+		for(as = rn->adj_shared; as; as = next) {
+			next = as->next;
+			if(bgp_adj_shared_member(as, peer, afi, safi)) {
+				bgp_adj_out_detach(rn, peer, afi, safi, as->addpath_tx_id);
+			}
+		}
+	}
+}
+
+/* Whether the peer has, or is about to have, any path of rn */
+int bgp_adj_out_lookup(struct peer *peer, struct prefix *p, afi_t afi, safi_t safi, struct bgp_node *rn) {
+	struct bgp_adj_out *adj;
+	struct bgp_adj_shared *as;
+
+	for(adj = rn->adj_out; adj; adj = adj->next) {
+		if(adj->peer == peer && (adj->adv ? adj->adv->baa != NULL : adj->attr != NULL)) {
+			return 1;
+		}
+	}
+
+	for(as = rn->adj_shared; as; as = as->next) {
+		if(bgp_adj_shared_member(as, peer, afi, safi)) {
+			return 1;
+		}
+	}
+	return 0;
+}
+
+/* Whether the peer has, or is about to have, the path ID with attr, an
+   interned attribute */
+int bgp_adj_out_same(struct bgp_node *rn, struct peer *peer, afi_t afi, safi_t safi, u_int32_t addpath_tx_id, struct attr *attr) {
+	struct bgp_adj_out *adj;
+	struct bgp_adj_shared *as;
+
+	for(adj = rn->adj_out; adj; adj = adj->next) {
+		if(adj->peer == peer && adj->addpath_tx_id == addpath_tx_id) {
+			if(adj->adv) {
+				return (adj->adv->baa && adj->adv->baa->attr == attr);
+			}
+			return (adj->attr == attr);
+		}
+	}
+
+	as = bgp_adj_shared_lookup(rn, peer, afi, safi, addpath_tx_id);
+	return (as && as->attr == attr);
 }
 
 struct bgp_advertise *bgp_advertise_clean(struct peer *peer, struct bgp_adj_out *adj, afi_t afi, safi_t safi) {
@@ -187,7 +380,7 @@ struct bgp_advertise *bgp_advertise_clean(struct peer *peer, struct bgp_adj_out
 	return next;
 }
 
-void bgp_adj_out_set(struct bgp_node *rn, struct peer *peer, struct prefix *p, struct attr *attr, afi_t afi, safi_t safi, struct bgp_info *binfo) {
+void bgp_adj_out_set(struct bgp_node *rn, struct peer *peer, struct prefix *p, struct attr *attr, afi_t afi, safi_t safi, struct bgp_info *binfo, u_int32_t addpath_tx_id) {
 	struct bgp_adj_out *adj = NULL;
 	struct bgp_advertise *adv;
 
@@ -197,16 +390,13 @@ void bgp_adj_out_set(struct bgp_node *rn, struct peer *peer, struct prefix *p, s
 
 	/* Look for adjacency information. */
 	if(rn) {
-		for(adj = rn->adj_out; adj; adj = adj->next) {
-			if(adj->peer == peer) {
-				break;
-			}
-		}
+		adj = bgp_adj_out_get(rn, peer, afi, safi, addpath_tx_id);
 	}
 
 	if(!adj) {
 		adj = XCALLOC(MTYPE_BGP_ADJ_OUT, sizeof(struct bgp_adj_out));
 		adj->peer = peer_lock(peer); /* adj_out peer reference */
+		adj->addpath_tx_id = addpath_tx_id;
 
 		if(rn) {
 			BGP_ADJ_OUT_ADD(rn, adj);
@@ -239,7 +429,7 @@ void bgp_adj_out_set(struct bgp_node *rn, struct peer *peer, struct prefix *p, s
 	BGP_ADV_FIFO_ADD(&peer->sync[afi][safi]->update, &adv->fifo);
 }
 
-void bgp_adj_out_unset(struct bgp_node *rn, struct peer *peer, struct prefix *p, afi_t afi, safi_t safi) {
+void bgp_adj_out_unset(struct bgp_node *rn, struct peer *peer, struct prefix *p, afi_t afi, safi_t safi, u_int32_t addpath_tx_id) {
 	struct bgp_adj_out *adj;
 	struct bgp_advertise *adv;
 
@@ -248,11 +438,7 @@ void bgp_adj_out_unset(struct bgp_node *rn, struct peer *peer, struct prefix *p,
 	}
 
 	/* Lookup existing adjacency, if it is not there return immediately.  */
-	for(adj = rn->adj_out; adj; adj = adj->next) {
-		if(adj->peer == peer) {
-			break;
-		}
-	}
+	adj = bgp_adj_out_get(rn, peer, afi, safi, addpath_tx_id);
 
 	if(!adj) {
 		return;
@@ -286,6 +472,46 @@ void bgp_adj_out_unset(struct bgp_node *rn, struct peer *peer, struct prefix *p,
 	}
 }
 
+static int bgp_addpath_id_listed(u_int32_t id, const u_int32_t *ids, unsigned int count) {
+	unsigned int i;
+
+	for(i = 0; i < count; i++) {
+		if(ids[i] == id) {
+			return 1;
+		}
+	}
+	return 0;
+}
+
+/* Withdraw from an Add-Path peer the paths of rn whose IDs are not among
+   those it is now sent */
+void bgp_adj_out_unset_others(struct bgp_node *rn, struct peer *peer, afi_t afi, safi_t safi, const u_int32_t *ids, unsigned int count) {
+	struct bgp_adj_shared *as, *asnext;
+	struct bgp_adj_out *adj, *next;
+
+	if(DISABLE_BGP_ANNOUNCE) {
+		return;
+	}
+
+	for(as = rn->adj_shared; as; as = asnext) {
+		asnext = as->next;
+		if(bgp_adj_shared_member(as, peer, afi, safi) && !bgp_addpath_id_listed(as->addpath_tx_id, ids, count)) {
+			bgp_adj_out_detach(rn, peer, afi, safi, as->addpath_tx_id);
+		}
+	}
+
+	for(adj = rn->adj_out; adj; adj = next) {
+		next = adj->next;
+		if(adj->peer != peer || bgp_addpath_id_listed(adj->addpath_tx_id, ids, count)) {
+			continue;
+		}
+		if(adj->adv && !adj->adv->baa) {
+			continue; /* already being withdrawn */
+		}
+		bgp_adj_out_unset(rn, peer, &rn->p, afi, safi, adj->addpath_tx_id);
+	}
+}
+
 void bgp_adj_out_remove(struct bgp_node *rn, struct bgp_adj_out *adj, struct peer *peer, afi_t afi, safi_t safi) {
 	if(adj->attr) {
 		bgp_attr_unintern(&adj->attr);
@@ -299,11 +525,11 @@ void bgp_adj_out_remove(struct bgp_node *rn, struct bgp_adj_out *adj, struct pee
 	bgp_adj_out_free(adj);
 }
 
-void bgp_adj_in_set(struct bgp_node *rn, struct peer *peer, struct attr *attr) {
+void bgp_adj_in_set(struct bgp_node *rn, struct peer *peer, struct attr *attr, u_int32_t addpath_rx_id) {
 	struct bgp_adj_in *adj;
 
 	for(adj = rn->adj_in; adj; adj = adj->next) {
-		if(adj->peer == peer) {
+		if(adj->peer == peer && adj->addpath_rx_id == addpath_rx_id) {
 			if(adj->attr != attr) {
 				bgp_attr_unintern(&adj->attr);
 				adj->attr = bgp_attr_intern(attr);
@@ -314,6 +540,7 @@ void bgp_adj_in_set(struct bgp_node *rn, struct peer *peer, struct attr *attr) {
 	adj = XCALLOC(MTYPE_BGP_ADJ_IN, sizeof(struct bgp_adj_in));
 	adj->peer = peer_lock(peer); /* adj_in peer reference */
 	adj->attr = bgp_attr_intern(attr);
+	adj->addpath_rx_id = addpath_rx_id;
 	BGP_ADJ_IN_ADD(rn, adj);
 	bgp_lock_node(rn);
 }
@@ -325,11 +552,11 @@ void bgp_adj_in_remove(struct bgp_node *rn, struct bgp_adj_in *bai) {
 	XFREE(MTYPE_BGP_ADJ_IN, bai);
 }
 
-int bgp_adj_in_unset(struct bgp_node *rn, struct peer *peer) {
+int bgp_adj_in_unset(struct bgp_node *rn, struct peer *peer, u_int32_t addpath_rx_id) {
 	struct bgp_adj_in *adj;
 
 	for(adj = rn->adj_in; adj; adj = adj->next) {
-		if(adj->peer == peer) {
+		if(adj->peer == peer && adj->addpath_rx_id == addpath_rx_id) {
 			break;
 		}
 	}
@@ -355,7 +582,7 @@ void bgp_sync_init(struct peer *peer) {
 			BGP_ADV_FIFO_INIT(&sync->withdraw);
 			BGP_ADV_FIFO_INIT(&sync->withdraw_low);
 			peer->sync[afi][safi] = sync;
-			peer->hash[afi][safi] = hash_create(baa_hash_key, baa_hash_cmp);
+			peer->hash[afi][safi] = hash_create_open(baa_hash_key, baa_hash_cmp);
 		}
 	}
 }
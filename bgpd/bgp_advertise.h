@@ -62,6 +62,9 @@ struct bgp_advertise {
 
 	/* BGP info.  */
 	struct bgp_info *binfo;
+
+	/* When the change was first queued for the peer */
+	struct timeval queued;
 };
 
 /* BGP adjacency out.  */
@@ -78,8 +81,36 @@ struct bgp_adj_out {
 
 	/* Advertisement information.  */
 	struct bgp_advertise *adv;
+
+	/* Path ID, for a peer the node's paths go to by Add-Path, else 0 */
+	u_int32_t addpath_tx_id;
 };
 
+/* BGP adjacency out, shared by the members of an update-group.  Each
+   member whose bit is set was last sent 'attr' for the node, and has no
+   bgp_adj_out of its own there.  Members whose state diverges from it
+   keep their own bgp_adj_out.  Add-Path groups have one per path ID.  */
+struct bgp_adj_shared {
+	/* Linked list pointer.  */
+	struct bgp_adj_shared *next;
+	struct bgp_adj_shared *prev;
+
+	struct update_group *updgrp;
+
+	/* Advertised attribute.  */
+	struct attr *attr;
+
+	u_int32_t addpath_tx_id;
+
+	/* Members, by bgp_updgrp index.  */
+	u_int16_t words;
+	u_int16_t count;
+	u_int32_t bits[];
+};
+
+/* AFI/SAFIs whose adj-out is kept shared, those with a single level table */
+#define BGP_ADJ_SHARED_SAFI(S) ((S) == SAFI_UNICAST || (S) == SAFI_MULTICAST)
+
 /* BGP adjacency in. */
 struct bgp_adj_in {
 	/* Linked list pointer.  */
@@ -91,6 +122,9 @@ struct bgp_adj_in {
 
 	/* Received attribute.  */
 	struct attr *attr;
+
+	/* Path ID the peer sent it with, 0 without Add-Path */
+	u_int32_t addpath_rx_id;
 };
 
 /* BGP advertisement list.  */
@@ -122,6 +156,8 @@ struct bgp_synchronize {
 #define BGP_ADJ_IN_DEL(N, A) BGP_INFO_DEL(N, A, adj_in)
 #define BGP_ADJ_OUT_ADD(N, A) BGP_INFO_ADD(N, A, adj_out)
 #define BGP_ADJ_OUT_DEL(N, A) BGP_INFO_DEL(N, A, adj_out)
+#define BGP_ADJ_SHARED_ADD(N, A) BGP_INFO_ADD(N, A, adj_shared)
+#define BGP_ADJ_SHARED_DEL(N, A) BGP_INFO_DEL(N, A, adj_shared)
 
 #define BGP_ADV_FIFO_ADD(F, N) \
 	do { \
@@ -142,13 +178,19 @@ struct bgp_synchronize {
 	} while(0)
 
 /* Prototypes.  */
-extern void bgp_adj_out_set(struct bgp_node *, struct peer *, struct prefix *, struct attr *, afi_t, safi_t, struct bgp_info *);
-extern void bgp_adj_out_unset(struct bgp_node *, struct peer *, struct prefix *, afi_t, safi_t);
+extern void bgp_adj_out_set(struct bgp_node *, struct peer *, struct prefix *, struct attr *, afi_t, safi_t, struct bgp_info *, u_int32_t addpath_tx_id);
+extern void bgp_adj_out_unset(struct bgp_node *, struct peer *, struct prefix *, afi_t, safi_t, u_int32_t addpath_tx_id);
+extern void bgp_adj_out_unset_others(struct bgp_node *, struct peer *, afi_t, safi_t, const u_int32_t *ids, unsigned int count);
+extern int bgp_adj_out_same(struct bgp_node *, struct peer *, afi_t, safi_t, u_int32_t addpath_tx_id, struct attr *);
 extern void bgp_adj_out_remove(struct bgp_node *, struct bgp_adj_out *, struct peer *, afi_t, safi_t);
 extern int bgp_adj_out_lookup(struct peer *, struct prefix *, afi_t, safi_t, struct bgp_node *);
+extern void bgp_adj_out_fold(struct bgp_node *, struct bgp_adj_out *, struct peer *, afi_t, safi_t);
+extern int bgp_adj_shared_member(struct bgp_adj_shared *, struct peer *, afi_t, safi_t);
+extern void bgp_adj_out_shared_unset(struct bgp_node *, struct peer *, afi_t, safi_t);
+extern void bgp_adj_out_shared_leave(struct peer *, afi_t, safi_t, int detach);
 
-extern void bgp_adj_in_set(struct bgp_node *, struct peer *, struct attr *);
-extern int bgp_adj_in_unset(struct bgp_node *, struct peer *);
+extern void bgp_adj_in_set(struct bgp_node *, struct peer *, struct attr *, u_int32_t addpath_rx_id);
+extern int bgp_adj_in_unset(struct bgp_node *, struct peer *, u_int32_t addpath_rx_id);
 extern void bgp_adj_in_remove(struct bgp_node *, struct bgp_adj_in *);
 
 extern struct bgp_advertise *bgp_advertise_clean(struct peer *, struct bgp_adj_out *, afi_t, safi_t);
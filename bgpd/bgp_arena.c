@@ -0,0 +1,98 @@
+/* BGP UPDATE parse arena
+ *
+ * This file is part of Quagga
+ *
+ * Quagga is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2, or (at your option) any
+ * later version.
+ *
+ * Quagga is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Quagga; see the file COPYING.  If not, write to the Free
+ * Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ * 02111-1307, USA.
+ */
+
+#include <zebra.h>
+
+#include "memory.h"
+
+#include "bgpd/bgp_arena.h"
+
+#define BGP_ARENA_ALIGN(n) (((n) + 7) & ~(size_t) 7)
+
+struct bgp_arena_chunk {
+	struct bgp_arena_chunk *next;
+	size_t size;
+	size_t used;
+};
+
+#define BGP_ARENA_HDR BGP_ARENA_ALIGN(sizeof(struct bgp_arena_chunk))
+#define BGP_ARENA_DATA(C) ((char *) (C) + BGP_ARENA_HDR)
+
+/* The chunk being allocated from first; the one kept across resets is
+ * always the last */
+static struct bgp_arena_chunk *arena;
+
+void *bgp_arena_alloc(size_t size) {
+	struct bgp_arena_chunk *chunk = arena;
+	void *p;
+
+	size = BGP_ARENA_ALIGN(size);
+	if(!chunk || chunk->size - chunk->used < size) {
+		size_t csize = size > BGP_ARENA_SIZE ? size : BGP_ARENA_SIZE;
+
+		chunk = XMALLOC(MTYPE_BGP_ARENA, BGP_ARENA_HDR + csize);
+		chunk->size = csize;
+		chunk->used = 0;
+		chunk->next = arena;
+		arena = chunk;
+	}
+	p = BGP_ARENA_DATA(chunk) + chunk->used;
+	chunk->used += size;
+	return p;
+}
+
+void *bgp_arena_calloc(size_t size) {
+	void *p = bgp_arena_alloc(size);
+
+	memset(p, 0, size);
+	return p;
+}
+
+int bgp_arena_owns(const void *p) {
+	struct bgp_arena_chunk *chunk;
+
+	for(chunk = arena; chunk; chunk = chunk->next) {
+		if((const char *) p >= BGP_ARENA_DATA(chunk) && (const char *) p < BGP_ARENA_DATA(chunk) + chunk->size) {
+			return 1;
+		}
+	}
+	return 0;
+}
+
+/* Drop everything allocated since the last reset */
+void bgp_arena_reset(void) {
+	struct bgp_arena_chunk *chunk;
+
+	while(arena && arena->next) {
+		chunk = arena;
+		arena = chunk->next;
+		XFREE(MTYPE_BGP_ARENA, chunk);
+	}
+	if(arena) {
+		arena->used = 0;
+	}
+}
+
+void bgp_arena_finish(void) {
+	bgp_arena_reset();
+	if(arena) {
+		XFREE(MTYPE_BGP_ARENA, arena);
+	}
+}
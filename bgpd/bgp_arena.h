@@ -0,0 +1,46 @@
+/* BGP UPDATE parse arena
+ *
+ * This file is part of Quagga
+ *
+ * Quagga is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2, or (at your option) any
+ * later version.
+ *
+ * Quagga is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Quagga; see the file COPYING.  If not, write to the Free
+ * Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ * 02111-1307, USA.
+ */
+
+#ifndef _QUAGGA_BGP_ARENA_H
+#define _QUAGGA_BGP_ARENA_H
+
+/* Scratch memory for what parsing an UPDATE's attributes needs only until
+ * they are interned: AS path segments, sorted communities, unknown
+ * transitive attributes and tunnel encapsulation sub-TLVs.  Allocation
+ * walks down a buffer, nothing is freed on its own, and the whole lot goes
+ * once bgp_update_receive() is done with the packet.  What outlives it is
+ * copied to the heap when first interned, so a path or community already
+ * known costs no malloc() at all.
+ *
+ * Freeing memory the arena owns is left to bgp_arena_reset(), so the
+ * free functions of the temporaries check bgp_arena_owns() first.
+ */
+
+/* The buffer kept from one UPDATE to the next; allocations that do not
+ * fit get a buffer of their own, freed on reset */
+#define BGP_ARENA_SIZE 65536
+
+extern void *bgp_arena_alloc(size_t);
+extern void *bgp_arena_calloc(size_t);
+extern int bgp_arena_owns(const void *);
+extern void bgp_arena_reset(void);
+extern void bgp_arena_finish(void);
+
+#endif /* _QUAGGA_BGP_ARENA_H */
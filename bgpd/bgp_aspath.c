@@ -36,6 +36,7 @@ Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
 #include "bgpd/bgp_aspath.h"
 #include "bgpd/bgp_debug.h"
 #include "bgpd/bgp_attr.h"
+#include "bgpd/bgp_arena.h"
 
 /* Attr. Flags and Attr. Type Code. */
 #define AS_HEADER_SIZE 2
@@ -169,6 +170,37 @@ static struct assegment *assegment_dup_all(struct assegment *seg) {
 	return head;
 }
 
+/* Interned paths keep their segments in one block: the segment structs
+ * in order, then the ASNs of all of them, so that walking a path stays
+ * within one allocation and freeing it is a single free. */
+static struct assegment *assegment_packed_new(int nseg, int nas) {
+	return XMALLOC(MTYPE_AS_SEG, nseg * sizeof(struct assegment) + ASSEGMENT_DATA_SIZE(nas, 1));
+}
+
+/* Copy a chain of segments into a single block */
+static struct assegment *assegment_pack(struct assegment *head) {
+	struct assegment *seg, *block;
+	as_t *as;
+	int nseg = 0, nas = 0, i;
+
+	for(seg = head; seg; seg = seg->next) {
+		nseg++;
+		nas += seg->length;
+	}
+
+	block = assegment_packed_new(nseg, nas);
+	as = (as_t *) (block + nseg);
+	for(seg = head, i = 0; seg; seg = seg->next, i++) {
+		block[i].next = seg->next ? &block[i + 1] : NULL;
+		block[i].as = as;
+		block[i].length = seg->length;
+		block[i].type = seg->type;
+		memcpy(as, seg->as, ASSEGMENT_DATA_SIZE(seg->length, 1));
+		as += seg->length;
+	}
+	return block;
+}
+
 /* prepend the as number to given segment, given num of times */
 static struct assegment *assegment_prepend_asns(struct assegment *seg, as_t asnum, int num) {
 	as_t *newas;
@@ -222,6 +254,31 @@ static int int_cmp(const void *p1, const void *p2) {
 	return (*as1 == *as2) ? 0 : ((*as1 > *as2) ? 1 : -1);
 }
 
+/* Sort the values of a SET segment and weed out duplicates, for
+ * determinism in paths to aid creation of hash values / path comparisons
+ * and because it helps other lesser implementations ;) */
+static void assegment_sort_set(struct assegment *seg) {
+	int tail = 0;
+	int i;
+
+	qsort(seg->as, seg->length, sizeof(as_t), int_cmp);
+
+	for(i = 1; i < seg->length; i++) {
+		if(seg->as[tail] == seg->as[i]) {
+			continue;
+		}
+
+		tail++;
+		if(tail < i) {
+			seg->as[tail] = seg->as[i];
+		}
+	}
+	/* seg->length can be 0.. */
+	if(seg->length) {
+		seg->length = tail + 1;
+	}
+}
+
 /* normalise the segment.
  * In particular, merge runs of AS_SEQUENCEs into one segment
  * Internally, we do not care about the wire segment length limit, and
@@ -239,31 +296,8 @@ static struct assegment *assegment_normalise(struct assegment *head) {
 	while(seg) {
 		pin = seg;
 
-		/* Sort values SET segments, for determinism in paths to aid
-       * creation of hash values / path comparisons
-       * and because it helps other lesser implementations ;)
-       */
 		if(seg->type == AS_SET || seg->type == AS_CONFED_SET) {
-			int tail = 0;
-			int i;
-
-			qsort(seg->as, seg->length, sizeof(as_t), int_cmp);
-
-			/* weed out dupes */
-			for(i = 1; i < seg->length; i++) {
-				if(seg->as[tail] == seg->as[i]) {
-					continue;
-				}
-
-				tail++;
-				if(tail < i) {
-					seg->as[tail] = seg->as[i];
-				}
-			}
-			/* seg->length can be 0.. */
-			if(seg->length) {
-				seg->length = tail + 1;
-			}
+			assegment_sort_set(seg);
 		}
 
 		/* read ahead from the current, pinned segment while the segments
@@ -299,7 +333,9 @@ void aspath_free(struct aspath *aspath) {
 	if(!aspath) {
 		return;
 	}
-	if(aspath->segments) {
+	if(aspath->packed) {
+		XFREE(MTYPE_AS_SEG, aspath->segments);
+	} else if(aspath->segments) {
 		assegment_free_all(aspath->segments);
 	}
 	if(aspath->str) {
@@ -449,6 +485,24 @@ as_t aspath_leftmost(struct aspath *aspath) {
 	return leftmost;
 }
 
+/* The AS the route originated in (RFC 6811): the last of the final
+ * segment if that is a sequence, 0 (none) if it is a set, and local if
+ * the path has nothing outside of the confederation. */
+as_t aspath_origin(struct aspath *aspath, as_t local) {
+	struct assegment *seg, *last = NULL;
+
+	for(seg = aspath->segments; seg; seg = seg->next) {
+		if(seg->length && (seg->type == AS_SEQUENCE || seg->type == AS_SET)) {
+			last = seg;
+		}
+	}
+
+	if(last == NULL) {
+		return local;
+	}
+	return (last->type == AS_SEQUENCE) ? last->as[last->length - 1] : 0;
+}
+
 /* Return 1 if there are any 4-byte ASes in the path */
 unsigned int aspath_has_as4(struct aspath *aspath) {
 	struct assegment *seg = aspath->segments;
@@ -561,26 +615,31 @@ static void aspath_make_str_count(struct aspath *as) {
 	return;
 }
 
+/* The segments changed, the string is made again when next asked for */
 static void aspath_str_update(struct aspath *as) {
 	if(as->str) {
 		XFREE(MTYPE_AS_STR, as->str);
 	}
-	aspath_make_str_count(as);
+	as->str_len = 0;
 }
 
 /* Intern allocated AS path. */
 struct aspath *aspath_intern(struct aspath *aspath) {
 	struct aspath *find;
 
-	/* Assert this AS path structure is not interned and has the string
-     representation built. */
+	/* Assert this AS path structure is not interned. */
 	assert(aspath->refcnt == 0);
-	assert(aspath->str);
 
 	/* Check AS path hash. */
 	find = hash_get(ashash, aspath, hash_alloc_intern);
 	if(find != aspath) {
 		aspath_free(aspath);
+	} else if(aspath->segments && !aspath->packed) {
+		struct assegment *block = assegment_pack(aspath->segments);
+
+		assegment_free_all(aspath->segments);
+		aspath->segments = block;
+		aspath->packed = 1;
 	}
 
 	find->refcnt++;
@@ -589,7 +648,7 @@ struct aspath *aspath_intern(struct aspath *aspath) {
 }
 
 /* Duplicate aspath structure.  Created same aspath structure but
-   reference count and AS path string is cleared. */
+   reference count is cleared. */
 struct aspath *aspath_dup(struct aspath *aspath) {
 	unsigned short buflen = aspath->str_len + 1;
 	struct aspath *new;
@@ -621,29 +680,37 @@ static void *aspath_hash_alloc(void *arg) {
 	const struct aspath *aspath = arg;
 	struct aspath *new;
 
-	/* Malformed AS path value. */
-	assert(aspath->str);
-	if(!aspath->str) {
-		return NULL;
-	}
-
 	/* New aspath structure is needed. */
 	new = XMALLOC(MTYPE_AS_PATH, sizeof(struct aspath));
 
 	/* Reuse segments and string representation */
 	new->refcnt = 0;
 	new->segments = aspath->segments;
+	new->packed = aspath->packed;
 	new->str = aspath->str;
 	new->str_len = aspath->str_len;
 
 	return new;
 }
 
-/* parse as-segment byte stream in struct assegment */
+/* As aspath_hash_alloc(), for a path parsed into the UPDATE's arena */
+static void *aspath_parse_hash_alloc(void *arg) {
+	struct aspath *new = aspath_hash_alloc(arg);
+
+	if(new->segments) {
+		new->segments = assegment_pack(new->segments);
+	}
+	return new;
+}
+
+/* parse as-segment byte stream into one block of segments, normalised
+ * as assegment_normalise() would */
 static int assegments_parse(struct stream *s, size_t length, struct assegment **result, int use32bit) {
 	struct assegment_header segh;
-	struct assegment *seg, *prev = NULL, *head = NULL;
-	size_t bytes = 0;
+	struct assegment *block, *seg = NULL;
+	as_t *as;
+	size_t start, bytes = 0;
+	int nseg = 0, nas = 0;
 
 	/* empty aspath (ie iBGP or somesuch) */
 	if(length == 0) {
@@ -658,20 +725,18 @@ static int assegments_parse(struct stream *s, size_t length, struct assegment **
 		return -1;
 	}
 
+	/* Check and count the segments first, to size the block. */
+	start = stream_get_getp(s);
 	while(bytes < length) {
-		int i;
 		size_t seg_size;
 
 		if((length - bytes) <= AS_HEADER_SIZE) {
-			if(head) {
-				assegment_free_all(head);
-			}
 			return -1;
 		}
 
 		/* softly softly, get the header first on its own */
-		segh.type = stream_getc(s);
-		segh.length = stream_getc(s);
+		segh.type = stream_getc_from(s, start + bytes);
+		segh.length = stream_getc_from(s, start + bytes + 1);
 
 		seg_size = ASSEGMENT_SIZE(segh.length, use32bit);
 
@@ -688,9 +753,6 @@ static int assegments_parse(struct stream *s, size_t length, struct assegment **
            * on more, than 8 bits (otherwise it's a warning, bug #564).
            */
 		   || ((sizeof segh.length > 1) && (0x10 + segh.length > 0x10 + AS_SEGMENT_MAX))) {
-			if(head) {
-				assegment_free_all(head);
-			}
 			return -1;
 		}
 
@@ -699,36 +761,52 @@ static int assegments_parse(struct stream *s, size_t length, struct assegment **
 			case AS_SET:
 			case AS_CONFED_SEQUENCE:
 			case AS_CONFED_SET: break;
-			default:
-				if(head) {
-					assegment_free_all(head);
-				}
-				return -1;
+			default: return -1;
 		}
 
-		/* now its safe to trust lengths */
-		seg = assegment_new(segh.type, segh.length);
+		nseg++;
+		nas += segh.length;
+		bytes += seg_size;
 
-		if(head) {
-			prev->next = seg;
-		} else { /* it's the first segment */
-			head = prev = seg;
+		if(BGP_DEBUG(as4, AS4_SEGMENT)) {
+			zlog_debug("[AS4SEG] Parse aspath segment: Bytes now: %lu", (unsigned long) bytes);
 		}
+	}
 
-		for(i = 0; i < segh.length; i++) {
-			seg->as[i] = (use32bit) ? stream_getl(s) : stream_getw(s);
-		}
+	/* now its safe to trust lengths: read the ASNs in one go, merging
+	 * runs of AS_SEQUENCE and sorting sets as we go, into the UPDATE's
+	 * arena, as most paths are known already */
+	block = bgp_arena_alloc(nseg * sizeof(struct assegment) + ASSEGMENT_DATA_SIZE(nas, 1));
+	as = (as_t *) (block + nseg);
+	nseg = 0;
+	for(bytes = 0; bytes < length; bytes += ASSEGMENT_SIZE(segh.length, use32bit)) {
+		int i;
 
-		bytes += seg_size;
+		segh.type = stream_getc(s);
+		segh.length = stream_getc(s);
 
-		if(BGP_DEBUG(as4, AS4_SEGMENT)) {
-			zlog_debug("[AS4SEG] Parse aspath segment: Bytes now: %lu", (unsigned long) bytes);
+		if(!seg || segh.type != AS_SEQUENCE || seg->type != AS_SEQUENCE) {
+			if(seg) {
+				seg->next = &block[nseg];
+			}
+			seg = &block[nseg++];
+			seg->next = NULL;
+			seg->as = as;
+			seg->length = 0;
+			seg->type = segh.type;
 		}
 
-		prev = seg;
+		for(i = 0; i < segh.length; i++) {
+			seg->as[seg->length++] = (use32bit) ? stream_getl(s) : stream_getw(s);
+		}
+
+		if(seg->type == AS_SET || seg->type == AS_CONFED_SET) {
+			assegment_sort_set(seg);
+		}
+		as = seg->as + seg->length;
 	}
 
-	*result = assegment_normalise(head);
+	*result = block;
 	return 0;
 }
 
@@ -756,20 +834,14 @@ struct aspath *aspath_parse(struct stream *s, size_t length, int use32bit) {
 	if(assegments_parse(s, length, &as.segments, use32bit) < 0) {
 		return NULL;
 	}
+	as.packed = as.segments != NULL;
 
 	/* If already same aspath exist then return it. */
-	find = hash_get(ashash, &as, aspath_hash_alloc);
+	find = hash_get(ashash, &as, aspath_parse_hash_alloc);
 
 	/* bug! should not happen, let the daemon crash below */
 	assert(find);
 
-	/* if the aspath was already hashed free temporary memory. */
-	if(find->refcnt) {
-		assegment_free_all(as.segments);
-		/* aspath_key_make() always updates the string */
-		XFREE(MTYPE_AS_STR, as.str);
-	}
-
 	find->refcnt++;
 
 	return find;
@@ -1529,7 +1601,7 @@ struct aspath *aspath_reconcile_as4(struct aspath *aspath, struct aspath *as4pat
 	}
 
 	if(BGP_DEBUG(as4, AS4)) {
-		zlog_debug("[AS4] got AS_PATH %s and AS4_PATH %s synthesizing now", aspath->str, as4path->str);
+		zlog_debug("[AS4] got AS_PATH %s and AS4_PATH %s synthesizing now", aspath_print(aspath), aspath_print(as4path));
 	}
 
 	while(seg && hops > 0) {
@@ -1583,7 +1655,7 @@ struct aspath *aspath_reconcile_as4(struct aspath *aspath, struct aspath *as4pat
 	aspath_str_update(mergedpath);
 
 	if(BGP_DEBUG(as4, AS4)) {
-		zlog_debug("[AS4] result of synthesizing is %s", mergedpath->str);
+		zlog_debug("[AS4] result of synthesizing is %s", aspath_print(mergedpath));
 	}
 
 	return mergedpath;
@@ -1688,7 +1760,6 @@ struct aspath *aspath_empty_get(void) {
 	struct aspath *aspath;
 
 	aspath = aspath_new();
-	aspath_make_str_count(aspath);
 	return aspath;
 }
 
@@ -1832,22 +1903,19 @@ struct aspath *aspath_str2aspath(const char *str) {
 		}
 	}
 
-	aspath_make_str_count(aspath);
-
 	return aspath;
 }
 
 /* Make hash value by raw aspath data. */
 unsigned int aspath_key_make(void *p) {
 	struct aspath *aspath = (struct aspath *) p;
-	unsigned int key = 0;
+	struct assegment *seg;
+	unsigned int key = 2334325;
 
-	if(!aspath->str) {
-		aspath_str_update(aspath);
+	for(seg = aspath->segments; seg; seg = seg->next) {
+		key = jhash2(seg->as, seg->length, jhash_2words(seg->type, seg->length, key));
 	}
 
-	key = jhash(aspath->str, aspath->str_len, 2334325);
-
 	return key;
 }
 
@@ -1857,7 +1925,6 @@ int aspath_cmp(const void *arg1, const void *arg2) {
 	const struct assegment *seg2 = ((const struct aspath *) arg2)->segments;
 
 	while(seg1 || seg2) {
-		int i;
 		if((!seg1 && seg2) || (seg1 && !seg2)) {
 			return 0;
 		}
@@ -1867,10 +1934,8 @@ int aspath_cmp(const void *arg1, const void *arg2) {
 		if(seg1->length != seg2->length) {
 			return 0;
 		}
-		for(i = 0; i < seg1->length; i++) {
-			if(seg1->as[i] != seg2->as[i]) {
-				return 0;
-			}
+		if(memcmp(seg1->as, seg2->as, ASSEGMENT_DATA_SIZE(seg1->length, 1))) {
+			return 0;
 		}
 		seg1 = seg1->next;
 		seg2 = seg2->next;
@@ -1880,7 +1945,7 @@ int aspath_cmp(const void *arg1, const void *arg2) {
 
 /* AS path hash initialize. */
 void aspath_init(void) {
-	ashash = hash_create_size(32768, aspath_key_make, aspath_cmp);
+	ashash = hash_create_open(aspath_key_make, aspath_cmp);
 }
 
 void aspath_finish(void) {
@@ -1893,8 +1958,11 @@ void aspath_finish(void) {
 	}
 }
 
-/* return and as path value */
+/* return and as path value, made on first use */
 const char *aspath_print(struct aspath *as) {
+	if(as && !as->str) {
+		aspath_make_str_count(as);
+	}
 	return (as ? as->str : NULL);
 }
 
@@ -1904,7 +1972,7 @@ const char *aspath_print(struct aspath *as) {
  */
 void aspath_print_vty(struct vty *vty, const char *format, struct aspath *as, const char *suffix) {
 	assert(format);
-	vty_out(vty, format, as->str);
+	vty_out(vty, format, aspath_print(as));
 	if(as->str_len && strlen(suffix)) {
 		vty_out(vty, "%s", suffix);
 	}
@@ -1916,7 +1984,7 @@ static void aspath_show_all_iterator(struct hash_backet *backet, struct vty *vty
 	as = (struct aspath *) backet->data;
 
 	vty_out(vty, "[%p:%u] (%ld) ", (void *) backet, backet->key, as->refcnt);
-	vty_out(vty, "%s%s", as->str, VTY_NEWLINE);
+	vty_out(vty, "%s%s", aspath_print(as), VTY_NEWLINE);
 }
 
 /* Print all aspath and hash information.  This function is used from
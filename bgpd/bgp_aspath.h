@@ -61,9 +61,14 @@ struct aspath {
 	struct assegment *segments;
 
 	/* String expression of AS path.  This string is used by vty output
-     and AS path regular expression match.  */
+     and AS path regular expression match, and only made when first
+     asked for through aspath_print().  */
 	char *str;
 	unsigned short str_len;
+
+	/* Set once interned: segments and their ASNs are then one block,
+	   see assegment_pack(). */
+	u_char packed;
 };
 
 #define ASPATH_STR_DEFAULT_LEN 32
@@ -105,6 +110,7 @@ extern unsigned int aspath_count_confeds(struct aspath *);
 extern unsigned int aspath_size(struct aspath *);
 extern as_t aspath_highest(struct aspath *);
 extern as_t aspath_leftmost(struct aspath *);
+extern as_t aspath_origin(struct aspath *, as_t);
 extern size_t aspath_put(struct stream *, struct aspath *, int);
 
 extern struct aspath *aspath_reconcile_as4(struct aspath *, struct aspath *);
@@ -41,6 +41,7 @@ Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
 #include "bgpd/bgp_packet.h"
 #include "bgpd/bgp_ecommunity.h"
 #include "bgpd/bgp_lcommunity.h"
+#include "bgpd/bgp_arena.h"
 #include "table.h"
 #include "bgp_encap_types.h"
 
@@ -233,7 +234,10 @@ static void encap_free(struct bgp_attr_encap_subtlv *p) {
 	while(p) {
 		next = p->next;
 		p->next = NULL;
-		XFREE(MTYPE_ENCAP_TLV, p);
+		/* as parsed, in the UPDATE's arena */
+		if(!bgp_arena_owns(p)) {
+			XFREE(MTYPE_ENCAP_TLV, p);
+		}
 		p = next;
 	}
 }
@@ -303,24 +307,32 @@ static int encap_same(struct bgp_attr_encap_subtlv *h1, struct bgp_attr_encap_su
 static struct hash *transit_hash;
 
 static void transit_free(struct transit *transit) {
+	/* not interned yet, so still in the UPDATE's arena */
+	if(bgp_arena_owns(transit)) {
+		return;
+	}
 	if(transit->val) {
 		XFREE(MTYPE_TRANSIT_VAL, transit->val);
 	}
 	XFREE(MTYPE_TRANSIT, transit);
 }
 
+/* Copied out of the UPDATE's arena */
 static void *transit_hash_alloc(void *p) {
-	/* Transit structure is already allocated.  */
-	return p;
+	struct transit *val = p;
+	struct transit *transit;
+
+	transit = XCALLOC(MTYPE_TRANSIT, sizeof(struct transit));
+	transit->length = val->length;
+	transit->val = XMALLOC(MTYPE_TRANSIT_VAL, val->length);
+	memcpy(transit->val, val->val, val->length);
+	return transit;
 }
 
 static struct transit *transit_intern(struct transit *transit) {
 	struct transit *find;
 
 	find = hash_get(transit_hash, transit, transit_hash_alloc);
-	if(find != transit) {
-		transit_free(transit);
-	}
 	find->refcnt++;
 
 	return find;
@@ -440,6 +452,7 @@ unsigned int attrhash_key_make(void *p) {
 	MIX(attr->nexthop.s_addr);
 	MIX(attr->med);
 	MIX(attr->local_pref);
+	MIX(attr->weight);
 
 	key += attr->origin;
 	key += attr->nexthop.s_addr;
@@ -449,7 +462,6 @@ unsigned int attrhash_key_make(void *p) {
 	if(extra) {
 		MIX(extra->aggregator_as);
 		MIX(extra->aggregator_addr.s_addr);
-		MIX(extra->weight);
 		MIX(extra->mp_nexthop_global_in.s_addr);
 		MIX(extra->originator_id.s_addr);
 		MIX(extra->tag);
@@ -489,11 +501,11 @@ int attrhash_cmp(const void *p1, const void *p2) {
 	const struct attr *attr2 = p2;
 
 	if(attr1->flag == attr2->flag && attr1->origin == attr2->origin && attr1->nexthop.s_addr == attr2->nexthop.s_addr && attr1->aspath == attr2->aspath && attr1->community == attr2->community && attr1->med == attr2->med
-	   && attr1->local_pref == attr2->local_pref) {
+	   && attr1->local_pref == attr2->local_pref && attr1->weight == attr2->weight) {
 		const struct attr_extra *ae1 = attr1->extra;
 		const struct attr_extra *ae2 = attr2->extra;
 
-		if(ae1 && ae2 && ae1->aggregator_as == ae2->aggregator_as && ae1->aggregator_addr.s_addr == ae2->aggregator_addr.s_addr && ae1->weight == ae2->weight && ae1->tag == ae2->tag && ae1->mp_nexthop_len == ae2->mp_nexthop_len
+		if(ae1 && ae2 && ae1->aggregator_as == ae2->aggregator_as && ae1->aggregator_addr.s_addr == ae2->aggregator_addr.s_addr && ae1->tag == ae2->tag && ae1->mp_nexthop_len == ae2->mp_nexthop_len
 		   && IPV6_ADDR_SAME(&ae1->mp_nexthop_global, &ae2->mp_nexthop_global) && IPV6_ADDR_SAME(&ae1->mp_nexthop_local, &ae2->mp_nexthop_local) && IPV4_ADDR_SAME(&ae1->mp_nexthop_global_in, &ae2->mp_nexthop_global_in)
 		   && ae1->ecommunity == ae2->ecommunity && ae1->lcommunity == ae2->lcommunity && ae1->cluster == ae2->cluster && ae1->transit == ae2->transit && (ae1->encap_tunneltype == ae2->encap_tunneltype)
 		   && encap_same(ae1->encap_subtlvs, ae2->encap_subtlvs) && IPV4_ADDR_SAME(&ae1->originator_id, &ae2->originator_id)) {
@@ -509,7 +521,7 @@ int attrhash_cmp(const void *p1, const void *p2) {
 }
 
 static void attrhash_init(void) {
-	attrhash = hash_create(attrhash_key_make, attrhash_cmp);
+	attrhash = hash_create_open(attrhash_key_make, attrhash_cmp);
 }
 
 /*
@@ -532,8 +544,13 @@ static void attr_show_all_iterator(struct hash_backet *backet, struct vty *vty)
 	vty_out(vty, "attr[%ld] nexthop %s%s", attr->refcnt, inet_ntoa(attr->nexthop), VTY_NEWLINE);
 }
 
+static struct hash *attr_encode_hash;
+static unsigned long attr_encode_hits;
+static unsigned long attr_encode_misses;
+
 void attr_show_all(struct vty *vty) {
 	hash_iterate(attrhash, (void (*)(struct hash_backet *, void *)) attr_show_all_iterator, vty);
+	vty_out(vty, "Encodings: %lu cached, %lu hits, %lu misses%s", attr_encode_hash ? attr_encode_hash->count : 0, attr_encode_hits, attr_encode_misses, VTY_NEWLINE);
 }
 
 static void *bgp_attr_hash_alloc(void *p) {
@@ -621,7 +638,7 @@ struct attr *bgp_attr_default_set(struct attr *attr, u_char origin) {
 	attr->flag |= ATTR_FLAG_BIT(BGP_ATTR_ORIGIN);
 	attr->aspath = aspath_empty();
 	attr->flag |= ATTR_FLAG_BIT(BGP_ATTR_AS_PATH);
-	attr->extra->weight = BGP_ATTR_DEFAULT_WEIGHT;
+	attr->weight = BGP_ATTR_DEFAULT_WEIGHT;
 	attr->extra->tag = 0;
 	attr->flag |= ATTR_FLAG_BIT(BGP_ATTR_NEXT_HOP);
 	attr->extra->mp_nexthop_len = IPV6_MAX_BYTELEN;
@@ -676,7 +693,7 @@ struct attr *bgp_attr_aggregate_intern(struct bgp *bgp, u_char origin, struct as
 		attr.flag |= ATTR_FLAG_BIT(BGP_ATTR_COMMUNITIES);
 	}
 
-	attre.weight = BGP_ATTR_DEFAULT_WEIGHT;
+	attr.weight = BGP_ATTR_DEFAULT_WEIGHT;
 	attre.mp_nexthop_len = IPV6_MAX_BYTELEN;
 
 	if(!as_set || atomic_aggregate) {
@@ -1678,9 +1695,8 @@ static int bgp_attr_encap(
 			return -1;
 		}
 
-		/* alloc and copy sub-tlv */
-		/* TBD make sure these are freed when attributes are released */
-		tlv = XCALLOC(MTYPE_ENCAP_TLV, sizeof(struct bgp_attr_encap_subtlv) - 1 + sublength);
+		/* copied to the heap with the rest of the attributes when interned */
+		tlv = bgp_arena_calloc(sizeof(struct bgp_attr_encap_subtlv) - 1 + sublength);
 		tlv->type = subtype;
 		tlv->length = sublength;
 		stream_get(tlv->value, peer->ibuf, sublength);
@@ -1723,6 +1739,7 @@ static bgp_attr_parse_ret_t bgp_attr_unknown(struct bgp_attr_parser_args *args)
 	bgp_size_t total = args->total;
 	struct transit *transit;
 	struct attr_extra *attre;
+	u_char *val;
 	struct peer *const peer = args->peer;
 	struct attr *const attr = args->attr;
 	u_char *const startp = args->startp;
@@ -1761,20 +1778,20 @@ static bgp_attr_parse_ret_t bgp_attr_unknown(struct bgp_attr_parser_args *args)
      is not set back to 0 by the current AS. */
 	SET_FLAG(*startp, BGP_ATTR_FLAG_PARTIAL);
 
-	/* Store transitive attribute to the end of attr->transit. */
+	/* Store transitive attribute to the end of attr->transit, in the
+	 * UPDATE's arena until bgp_attr_parse() interns it. */
 	if(!((attre = bgp_attr_extra_get(attr))->transit)) {
-		attre->transit = XCALLOC(MTYPE_TRANSIT, sizeof(struct transit));
+		attre->transit = bgp_arena_calloc(sizeof(struct transit));
 	}
 
 	transit = attre->transit;
 
-	if(transit->val) {
-		transit->val = XREALLOC(MTYPE_TRANSIT_VAL, transit->val, transit->length + total);
-	} else {
-		transit->val = XMALLOC(MTYPE_TRANSIT_VAL, total);
+	val = bgp_arena_alloc(transit->length + total);
+	if(transit->length) {
+		memcpy(val, transit->val, transit->length);
 	}
-
-	memcpy(transit->val + transit->length, startp, total);
+	memcpy(val + transit->length, startp, total);
+	transit->val = val;
 	transit->length += total;
 
 	return BGP_ATTR_PARSE_PROCEED;
@@ -2170,7 +2187,7 @@ void bgp_packet_mpattr_prefix(struct stream *s, afi_t afi, safi_t safi, struct p
 size_t bgp_packet_mpattr_prefix_size(afi_t afi, safi_t safi, struct prefix *p) {
 	int size = PSIZE(p->prefixlen);
 	if(safi == SAFI_MPLS_VPN) {
-		size += 88;
+		size += 3 + 8; /* label, RD */
 	}
 	return size;
 }
@@ -2275,6 +2292,9 @@ bgp_size_t bgp_packet_attribute(struct bgp *bgp, struct peer *peer, struct strea
 	if(p && !(afi == AFI_IP && safi == SAFI_UNICAST)) {
 		size_t mpattrlen_pos = 0;
 		mpattrlen_pos = bgp_packet_mpattr_start(s, afi, safi, attr);
+		if(BGP_ADDPATH_TX(peer, afi, safi)) {
+			stream_putl(s, 0); /* the default route, see bgp_default_update_send() */
+		}
 		bgp_packet_mpattr_prefix(s, afi, safi, p, prd, tag);
 		bgp_packet_mpattr_end(s, mpattrlen_pos);
 	}
@@ -2590,6 +2610,146 @@ bgp_size_t bgp_packet_attribute(struct bgp *bgp, struct peer *peer, struct strea
 	return stream_get_endp(s) - cp;
 }
 
+/* What of the peer, the route's source and the BGP instance
+ * bgp_packet_attribute() looks at, besides the attributes themselves,
+ * when there is no prefix to put in an MP_REACH_NLRI. */
+struct attr_encode_ctx {
+	struct in_addr from_id; /* ORIGINATOR_ID default, when reflecting */
+	struct in_addr cluster_id;
+	as_t local_as;
+	as_t change_local_as;
+	as_t confed_id;
+	u_int16_t flags;
+#define ATTR_ENCODE_AS4 (1 << 0)
+#define ATTR_ENCODE_AS_PATH_UNCHANGED (1 << 1)
+#define ATTR_ENCODE_RSERVER_CLIENT (1 << 2)
+#define ATTR_ENCODE_LOCAL_AS_REPLACE_AS (1 << 3)
+#define ATTR_ENCODE_CONFEDERATION (1 << 4)
+#define ATTR_ENCODE_REFLECT (1 << 5)
+#define ATTR_ENCODE_COMMUNITY (1 << 6)
+#define ATTR_ENCODE_LARGE_COMMUNITY (1 << 7)
+#define ATTR_ENCODE_EXT_COMMUNITY (1 << 8)
+	u_char sort;
+	u_char afi;
+	u_char safi;
+};
+
+struct attr_encode {
+	struct attr *attr; /* interned, holds a reference */
+	struct attr_encode_ctx ctx;
+	bgp_size_t len;
+	u_char *data;
+};
+
+static unsigned int attr_encode_key(void *p) {
+	const struct attr_encode *enc = p;
+
+	return jhash(&enc->ctx, sizeof(struct attr_encode_ctx), (uintptr_t) enc->attr);
+}
+
+static int attr_encode_cmp(const void *p1, const void *p2) {
+	const struct attr_encode *enc1 = p1;
+	const struct attr_encode *enc2 = p2;
+
+	return (enc1->attr == enc2->attr && memcmp(&enc1->ctx, &enc2->ctx, sizeof(struct attr_encode_ctx)) == 0);
+}
+
+static void attr_encode_free(void *p) {
+	struct attr_encode *enc = p;
+
+	bgp_attr_unintern(&enc->attr);
+	XFREE(MTYPE_ATTR_ENCODE, enc->data);
+	XFREE(MTYPE_ATTR_ENCODE, enc);
+}
+
+static void attr_encode_ctx_make(struct attr_encode_ctx *ctx, struct bgp *bgp, struct peer *peer, afi_t afi, safi_t safi, struct peer *from) {
+	memset(ctx, 0, sizeof(struct attr_encode_ctx));
+
+	ctx->sort = peer->sort;
+	ctx->afi = afi;
+	ctx->safi = safi;
+	ctx->local_as = peer->local_as;
+	ctx->change_local_as = peer->change_local_as;
+
+	if(CHECK_FLAG(peer->cap, PEER_CAP_AS4_RCV)) {
+		SET_FLAG(ctx->flags, ATTR_ENCODE_AS4);
+	}
+	if(CHECK_FLAG(peer->af_flags[afi][safi], PEER_FLAG_AS_PATH_UNCHANGED)) {
+		SET_FLAG(ctx->flags, ATTR_ENCODE_AS_PATH_UNCHANGED);
+	}
+	if(CHECK_FLAG(peer->af_flags[afi][safi], PEER_FLAG_RSERVER_CLIENT)) {
+		SET_FLAG(ctx->flags, ATTR_ENCODE_RSERVER_CLIENT);
+	}
+	if(CHECK_FLAG(peer->flags, PEER_FLAG_LOCAL_AS_REPLACE_AS)) {
+		SET_FLAG(ctx->flags, ATTR_ENCODE_LOCAL_AS_REPLACE_AS);
+	}
+	if(CHECK_FLAG(peer->af_flags[afi][safi], PEER_FLAG_SEND_COMMUNITY)) {
+		SET_FLAG(ctx->flags, ATTR_ENCODE_COMMUNITY);
+	}
+	if(CHECK_FLAG(peer->af_flags[afi][safi], PEER_FLAG_SEND_LARGE_COMMUNITY)) {
+		SET_FLAG(ctx->flags, ATTR_ENCODE_LARGE_COMMUNITY);
+	}
+	if(CHECK_FLAG(peer->af_flags[afi][safi], PEER_FLAG_SEND_EXT_COMMUNITY)) {
+		SET_FLAG(ctx->flags, ATTR_ENCODE_EXT_COMMUNITY);
+	}
+	if(CHECK_FLAG(bgp->config, BGP_CONFIG_CONFEDERATION)) {
+		SET_FLAG(ctx->flags, ATTR_ENCODE_CONFEDERATION);
+		ctx->confed_id = bgp->confed_id;
+	}
+
+	if(peer->sort == BGP_PEER_IBGP && from && from->sort == BGP_PEER_IBGP) {
+		SET_FLAG(ctx->flags, ATTR_ENCODE_REFLECT);
+		ctx->from_id = from->remote_id;
+		ctx->cluster_id = (bgp->config & BGP_CONFIG_CLUSTER_ID) ? bgp->cluster_id : bgp->router_id;
+	}
+}
+
+/* bgp_packet_attribute() without a prefix, that is for IPv4 unicast or
+ * with the NLRI going in an MP_REACH_NLRI of its own, taken from a cache
+ * of the encoding of each interned attribute per encoding context. */
+bgp_size_t bgp_packet_attribute_cached(struct peer *peer, struct stream *s, struct attr *attr, afi_t afi, safi_t safi, struct peer *from) {
+	struct bgp *bgp = bgp_get_default();
+	struct attr_encode key, *enc;
+	size_t start;
+	bgp_size_t len;
+
+	/* The Tunnel Encap attribute is not worth the trouble */
+	if(attr_encode_hash == NULL || attr->refcnt == 0 || bgp == NULL || (safi != SAFI_UNICAST && safi != SAFI_MULTICAST)) {
+		return bgp_packet_attribute(NULL, peer, s, attr, NULL, afi, safi, from, NULL, NULL);
+	}
+
+	key.attr = attr;
+	attr_encode_ctx_make(&key.ctx, bgp, peer, afi, safi, from);
+
+	enc = hash_lookup(attr_encode_hash, &key);
+	if(enc) {
+		attr_encode_hits++;
+		stream_put(s, enc->data, enc->len);
+		return enc->len;
+	}
+	attr_encode_misses++;
+
+	start = stream_get_endp(s);
+	len = bgp_packet_attribute(NULL, peer, s, attr, NULL, afi, safi, from, NULL, NULL);
+	if(stream_get_endp(s) - start != len) {
+		return len;
+	}
+
+	if(attr_encode_hash->count >= ATTR_ENCODE_MAX) {
+		hash_clean(attr_encode_hash, attr_encode_free);
+	}
+
+	enc = XCALLOC(MTYPE_ATTR_ENCODE, sizeof(struct attr_encode));
+	enc->attr = bgp_attr_intern(attr);
+	enc->ctx = key.ctx;
+	enc->len = len;
+	enc->data = XMALLOC(MTYPE_ATTR_ENCODE, len ? len : 1);
+	memcpy(enc->data, STREAM_DATA(s) + start, len);
+	hash_get(attr_encode_hash, enc, hash_alloc_intern);
+
+	return len;
+}
+
 size_t bgp_packet_mpunreach_start(struct stream *s, afi_t afi, safi_t safi) {
 	unsigned long attrlen_pnt;
 
@@ -2617,6 +2777,7 @@ void bgp_packet_mpunreach_end(struct stream *s, size_t attrlen_pnt) {
 void bgp_attr_init(void) {
 	aspath_init();
 	attrhash_init();
+	attr_encode_hash = hash_create_open(attr_encode_key, attr_encode_cmp);
 	community_init();
 	ecommunity_init();
 	lcommunity_init();
@@ -2625,6 +2786,9 @@ void bgp_attr_init(void) {
 }
 
 void bgp_attr_finish(void) {
+	hash_clean(attr_encode_hash, attr_encode_free);
+	hash_free(attr_encode_hash);
+	attr_encode_hash = NULL;
 	aspath_finish();
 	attrhash_finish();
 	community_finish();
@@ -2632,6 +2796,7 @@ void bgp_attr_finish(void) {
 	lcommunity_finish();
 	cluster_finish();
 	transit_finish();
+	bgp_arena_finish();
 }
 
 /* Make attribute packet. */
@@ -2768,3 +2933,213 @@ void bgp_dump_routes_attr(struct stream *s, struct attr *attr, struct prefix *pr
 	len = stream_get_endp(s) - cp - 2;
 	stream_putw_at(s, cp, len);
 }
+
+/* What of an attribute a snapshot keeps, see bgp_snapshot.c: the fields
+ * of struct attr as they are, and the interned parts, present or not as
+ * told by a bitmap, each as a length and what goes on the wire, with
+ * 4-byte AS numbers.  Tunnel encapsulation is left out, as only unicast
+ * and multicast tables are snapshotted. */
+#define ATTR_SNAPSHOT_ASPATH 0x01
+#define ATTR_SNAPSHOT_COMMUNITY 0x02
+#define ATTR_SNAPSHOT_ECOMMUNITY 0x04
+#define ATTR_SNAPSHOT_LCOMMUNITY 0x08
+#define ATTR_SNAPSHOT_CLUSTER 0x10
+#define ATTR_SNAPSHOT_TRANSIT 0x20
+#define ATTR_SNAPSHOT_EXTRA 0x80
+
+#define ATTR_SNAPSHOT_FIXED_SIZE 22
+#define ATTR_SNAPSHOT_EXTRA_SIZE 53
+
+static int bgp_attr_snapshot_put_part(struct stream *s, const void *val, size_t len) {
+	if(len > 65535 || STREAM_WRITEABLE(s) < len + 2) {
+		return -1;
+	}
+	stream_putw(s, len);
+	stream_put(s, val, len);
+	return 0;
+}
+
+/* -1 if it doesn't fit in s, which is then left as it was */
+int bgp_attr_snapshot_put(struct stream *s, struct attr *attr) {
+	struct attr_extra *attre = attr->extra;
+	size_t start = stream_get_endp(s);
+	size_t bitmapp, lenp;
+	u_char bitmap = 0;
+
+	if(STREAM_WRITEABLE(s) < ATTR_SNAPSHOT_FIXED_SIZE + ATTR_SNAPSHOT_EXTRA_SIZE) {
+		return -1;
+	}
+
+	bitmapp = stream_get_endp(s);
+	stream_putc(s, 0);
+	stream_putl(s, attr->flag);
+	stream_put_in_addr(s, &attr->nexthop);
+	stream_putl(s, attr->med);
+	stream_putl(s, attr->local_pref);
+	stream_putl(s, attr->weight);
+	stream_putc(s, attr->origin);
+
+	if(attre) {
+		bitmap |= ATTR_SNAPSHOT_EXTRA;
+		stream_put(s, &attre->mp_nexthop_global, IPV6_MAX_BYTELEN);
+		stream_put(s, &attre->mp_nexthop_local, IPV6_MAX_BYTELEN);
+		stream_put_in_addr(s, &attre->mp_nexthop_global_in);
+		stream_put_in_addr(s, &attre->aggregator_addr);
+		stream_put_in_addr(s, &attre->originator_id);
+		stream_putl(s, attre->aggregator_as);
+		stream_putc(s, attre->mp_nexthop_len);
+		stream_putl(s, attre->tag);
+	}
+
+	if(attr->aspath) {
+		bitmap |= ATTR_SNAPSHOT_ASPATH;
+		/* with room for the headers of overlong segments split up */
+		if(STREAM_WRITEABLE(s) < 2 * aspath_size(attr->aspath) + 2) {
+			goto toolong;
+		}
+		lenp = stream_get_endp(s);
+		stream_putw(s, 0);
+		stream_putw_at(s, lenp, aspath_put(s, attr->aspath, 1));
+	}
+	if(attr->community) {
+		bitmap |= ATTR_SNAPSHOT_COMMUNITY;
+		if(bgp_attr_snapshot_put_part(s, attr->community->val, attr->community->size * 4) < 0) {
+			goto toolong;
+		}
+	}
+	if(attre && attre->ecommunity) {
+		bitmap |= ATTR_SNAPSHOT_ECOMMUNITY;
+		if(bgp_attr_snapshot_put_part(s, attre->ecommunity->val, attre->ecommunity->size * ECOMMUNITY_SIZE) < 0) {
+			goto toolong;
+		}
+	}
+	if(attre && attre->lcommunity) {
+		bitmap |= ATTR_SNAPSHOT_LCOMMUNITY;
+		if(bgp_attr_snapshot_put_part(s, attre->lcommunity->val, attre->lcommunity->size * LCOMMUNITY_SIZE) < 0) {
+			goto toolong;
+		}
+	}
+	if(attre && attre->cluster) {
+		bitmap |= ATTR_SNAPSHOT_CLUSTER;
+		if(bgp_attr_snapshot_put_part(s, attre->cluster->list, attre->cluster->length) < 0) {
+			goto toolong;
+		}
+	}
+	if(attre && attre->transit) {
+		bitmap |= ATTR_SNAPSHOT_TRANSIT;
+		if(bgp_attr_snapshot_put_part(s, attre->transit->val, attre->transit->length) < 0) {
+			goto toolong;
+		}
+	}
+
+	stream_putc_at(s, bitmapp, bitmap);
+	return 0;
+
+toolong:
+	stream_set_endp(s, start);
+	return -1;
+}
+
+/* The length of the next part of a snapshotted attribute, -1 if it
+ * runs past the end of s */
+static int bgp_attr_snapshot_get_part(struct stream *s) {
+	u_int16_t len;
+
+	if(STREAM_READABLE(s) < 2) {
+		return -1;
+	}
+	len = stream_getw(s);
+	return STREAM_READABLE(s) < len ? -1 : len;
+}
+
+/* What bgp_attr_snapshot_put() put from the getp to the end of s,
+ * interned, or NULL if it is malformed.  Like bgp_attr_parse(), may
+ * leave what it parsed in the arena. */
+struct attr *bgp_attr_snapshot_get(struct stream *s) {
+	struct attr attr, *new = NULL;
+	struct attr_extra extra;
+	struct transit transit;
+	u_char bitmap;
+	int len;
+
+	memset(&attr, 0, sizeof(struct attr));
+	memset(&extra, 0, sizeof(struct attr_extra));
+
+	if(STREAM_READABLE(s) < ATTR_SNAPSHOT_FIXED_SIZE) {
+		return NULL;
+	}
+	bitmap = stream_getc(s);
+	attr.flag = stream_getl(s);
+	attr.nexthop.s_addr = stream_get_ipv4(s);
+	attr.med = stream_getl(s);
+	attr.local_pref = stream_getl(s);
+	attr.weight = stream_getl(s);
+	attr.origin = stream_getc(s);
+
+	if(CHECK_FLAG(bitmap, ATTR_SNAPSHOT_EXTRA)) {
+		if(STREAM_READABLE(s) < ATTR_SNAPSHOT_EXTRA_SIZE) {
+			return NULL;
+		}
+		attr.extra = &extra;
+		stream_get(&extra.mp_nexthop_global, s, IPV6_MAX_BYTELEN);
+		stream_get(&extra.mp_nexthop_local, s, IPV6_MAX_BYTELEN);
+		extra.mp_nexthop_global_in.s_addr = stream_get_ipv4(s);
+		extra.aggregator_addr.s_addr = stream_get_ipv4(s);
+		extra.originator_id.s_addr = stream_get_ipv4(s);
+		extra.aggregator_as = stream_getl(s);
+		extra.mp_nexthop_len = stream_getc(s);
+		extra.tag = stream_getl(s);
+	} else if(CHECK_FLAG(bitmap, ATTR_SNAPSHOT_ECOMMUNITY | ATTR_SNAPSHOT_LCOMMUNITY | ATTR_SNAPSHOT_CLUSTER | ATTR_SNAPSHOT_TRANSIT)) {
+		return NULL;
+	}
+
+	/* each part is interned as soon as parsed, as bgp_attr_parse() does,
+	 * and the references dropped once the attribute holds its own */
+	if(CHECK_FLAG(bitmap, ATTR_SNAPSHOT_ASPATH)) {
+		if((len = bgp_attr_snapshot_get_part(s)) < 0 || !(attr.aspath = aspath_parse(s, len, 1))) {
+			goto out;
+		}
+	}
+	if(CHECK_FLAG(bitmap, ATTR_SNAPSHOT_COMMUNITY)) {
+		if((len = bgp_attr_snapshot_get_part(s)) < 0 || !(attr.community = community_parse((u_int32_t *) stream_pnt(s), len))) {
+			goto out;
+		}
+		stream_forward_getp(s, len);
+	}
+	if(CHECK_FLAG(bitmap, ATTR_SNAPSHOT_ECOMMUNITY)) {
+		if((len = bgp_attr_snapshot_get_part(s)) < 0 || !(extra.ecommunity = ecommunity_parse(stream_pnt(s), len))) {
+			goto out;
+		}
+		stream_forward_getp(s, len);
+	}
+	if(CHECK_FLAG(bitmap, ATTR_SNAPSHOT_LCOMMUNITY)) {
+		if((len = bgp_attr_snapshot_get_part(s)) < 0 || !(extra.lcommunity = lcommunity_parse(stream_pnt(s), len))) {
+			goto out;
+		}
+		stream_forward_getp(s, len);
+	}
+	if(CHECK_FLAG(bitmap, ATTR_SNAPSHOT_CLUSTER)) {
+		if((len = bgp_attr_snapshot_get_part(s)) < 0 || len % 4) {
+			goto out;
+		}
+		extra.cluster = cluster_parse((struct in_addr *) stream_pnt(s), len);
+		stream_forward_getp(s, len);
+	}
+	if(CHECK_FLAG(bitmap, ATTR_SNAPSHOT_TRANSIT)) {
+		if((len = bgp_attr_snapshot_get_part(s)) <= 0) {
+			goto out;
+		}
+		transit.length = len;
+		transit.val = stream_pnt(s);
+		extra.transit = transit_intern(&transit);
+		stream_forward_getp(s, len);
+	}
+
+	if(STREAM_READABLE(s) == 0) {
+		new = bgp_attr_intern(&attr);
+	}
+
+out:
+	bgp_attr_unintern_sub(&attr);
+	return new;
+}
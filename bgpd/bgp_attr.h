@@ -45,6 +45,9 @@ Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
 #define BGP_ATTR_MIN_LEN 3 /* Attribute flag, type length. */
 #define BGP_ATTR_DEFAULT_WEIGHT 32768
 
+/* Attribute encodings kept before the cache is flushed to start over */
+#define ATTR_ENCODE_MAX 8192
+
 struct bgp_attr_encap_subtlv {
 	struct bgp_attr_encap_subtlv *next; /* for chaining */
 	uint16_t type;
@@ -81,9 +84,6 @@ struct attr_extra {
 	/* Route Reflector Originator attribute */
 	struct in_addr originator_id;
 
-	/* Local weight, not actually an attribute */
-	u_int32_t weight;
-
 	/* Aggregator ASN */
 	as_t aggregator_as;
 
@@ -97,20 +97,15 @@ struct attr_extra {
 	route_tag_t tag;
 };
 
-/* BGP core attribute structure. */
+/* BGP core attribute structure.
+ *
+ * What best path selection and the UPDATE encoder look at for nearly
+ * every route comes first, so that it shares a cache line, and doesn't
+ * need the extra attributes allocated for a plain eBGP route. */
 struct attr {
 	/* AS Path structure */
 	struct aspath *aspath;
 
-	/* Community structure */
-	struct community *community;
-
-	/* Lazily allocated pointer to extra attributes */
-	struct attr_extra *extra;
-
-	/* Reference count of this attribute. */
-	unsigned long refcnt;
-
 	/* Flag of attribute is set or not. */
 	u_int32_t flag;
 
@@ -119,8 +114,20 @@ struct attr {
 	u_int32_t med;
 	u_int32_t local_pref;
 
+	/* Local weight, not actually an attribute */
+	u_int32_t weight;
+
 	/* Path origin attribute */
 	u_char origin;
+
+	/* Community structure */
+	struct community *community;
+
+	/* Lazily allocated pointer to extra attributes */
+	struct attr_extra *extra;
+
+	/* Reference count of this attribute. */
+	unsigned long refcnt;
 };
 
 /* Router Reflector related structure. */
@@ -163,7 +170,10 @@ extern struct attr *bgp_attr_default_set(struct attr *attr, u_char);
 extern struct attr *bgp_attr_default_intern(u_char);
 extern struct attr *bgp_attr_aggregate_intern(struct bgp *, u_char, struct aspath *, struct community *, int as_set, u_char);
 extern bgp_size_t bgp_packet_attribute(struct bgp *bgp, struct peer *, struct stream *, struct attr *, struct prefix *, afi_t, safi_t, struct peer *, struct prefix_rd *, u_char *);
+extern bgp_size_t bgp_packet_attribute_cached(struct peer *, struct stream *, struct attr *, afi_t, safi_t, struct peer *);
 extern void bgp_dump_routes_attr(struct stream *, struct attr *, struct prefix *);
+extern int bgp_attr_snapshot_put(struct stream *, struct attr *);
+extern struct attr *bgp_attr_snapshot_get(struct stream *);
 extern int attrhash_cmp(const void *, const void *);
 extern unsigned int attrhash_key_make(void *);
 extern void attr_show_all(struct vty *);
@@ -0,0 +1,129 @@
+/* BGP neighbours watched by BFD
+ *
+ * This file is part of GNU Zebra.
+ *
+ * GNU Zebra is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2, or (at your option) any
+ * later version.
+ *
+ * GNU Zebra is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with GNU Zebra; see the file COPYING.  If not, write to the Free
+ * Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ * 02111-1307, USA.
+ */
+
+#include <zebra.h>
+
+#include "prefix.h"
+#include "linklist.h"
+#include "command.h"
+#include "thread.h"
+#include "stream.h"
+#include "sockunion.h"
+#include "log.h"
+#include "filter.h"
+#include "zclient.h"
+
+#include "bgpd/bgpd.h"
+#include "bgpd/bgp_fsm.h"
+#include "bgpd/bgp_debug.h"
+#include "bgpd/bgp_bfd.h"
+
+extern struct zclient *zclient;
+
+static int bgp_bfd_zapi(struct peer *peer, struct zapi_bfd *bfd) {
+	memset(bfd, 0, sizeof(struct zapi_bfd));
+	if(!peer->su_local || !sockunion2hostprefix(&peer->su, &bfd->dst) || !sockunion2hostprefix(peer->su_local, &bfd->src)) {
+		return -1;
+	}
+	bfd->ifindex = peer->ifindex;
+	bfd->min_rx = ZEBRA_BFD_MIN_RX_DEFAULT;
+	bfd->min_tx = ZEBRA_BFD_MIN_TX_DEFAULT;
+	bfd->detect_mult = ZEBRA_BFD_DETECT_MULT_DEFAULT;
+	return 0;
+}
+
+void bgp_bfd_register(struct peer *peer) {
+	struct zapi_bfd bfd;
+
+	if(!CHECK_FLAG(peer->flags, PEER_FLAG_BFD) || CHECK_FLAG(peer->sflags, PEER_STATUS_BFD) || bgp_bfd_zapi(peer, &bfd) < 0) {
+		return;
+	}
+	if(zebra_bfd_send(zclient, ZEBRA_BFD_DEST_REGISTER, &bfd) < 0) {
+		return;
+	}
+	SET_FLAG(peer->sflags, PEER_STATUS_BFD);
+	if(BGP_DEBUG(events, EVENTS)) {
+		zlog_debug("%s BFD session registered", peer->host);
+	}
+}
+
+void bgp_bfd_deregister(struct peer *peer) {
+	struct zapi_bfd bfd;
+
+	if(!CHECK_FLAG(peer->sflags, PEER_STATUS_BFD)) {
+		return;
+	}
+	UNSET_FLAG(peer->sflags, PEER_STATUS_BFD);
+	if(bgp_bfd_zapi(peer, &bfd) == 0) {
+		zebra_bfd_send(zclient, ZEBRA_BFD_DEST_DEREGISTER, &bfd);
+	}
+}
+
+void bgp_bfd_peer_update(struct peer *peer) {
+	if(CHECK_FLAG(peer->flags, PEER_FLAG_BFD)) {
+		if(peer->status == Established) {
+			bgp_bfd_register(peer);
+		}
+	} else {
+		bgp_bfd_deregister(peer);
+	}
+}
+
+void bgp_bfd_register_all(void) {
+	struct listnode *mnode, *node;
+	struct bgp *bgp;
+	struct peer *peer;
+
+	for(ALL_LIST_ELEMENTS_RO(bm->bgp, mnode, bgp)) {
+		for(ALL_LIST_ELEMENTS_RO(bgp->peer, node, peer)) {
+			UNSET_FLAG(peer->sflags, PEER_STATUS_BFD);
+			if(peer->status == Established) {
+				bgp_bfd_register(peer);
+			}
+		}
+	}
+}
+
+int bgp_bfd_update(int command, struct zclient *zclient, zebra_size_t length, vrf_id_t vrf_id) {
+	struct zapi_bfd bfd;
+	struct listnode *mnode, *node;
+	struct bgp *bgp;
+	struct peer *peer;
+	struct prefix dst, src;
+
+	if(zapi_bfd_decode(zclient->ibuf, &bfd) < 0 || bfd.state != ZEBRA_BFD_DOWN) {
+		return 0;
+	}
+
+	for(ALL_LIST_ELEMENTS_RO(bm->bgp, mnode, bgp)) {
+		for(ALL_LIST_ELEMENTS_RO(bgp->peer, node, peer)) {
+			if(!CHECK_FLAG(peer->sflags, PEER_STATUS_BFD) || !sockunion2hostprefix(&peer->su, &dst) || !sockunion2hostprefix(peer->su_local, &src)) {
+				continue;
+			}
+			if(!prefix_same(&dst, &bfd.dst) || !prefix_same(&src, &bfd.src)) {
+				continue;
+			}
+			zlog_info("%s BFD session went down", peer->host);
+			peer->last_reset = PEER_DOWN_BFD_DOWN;
+			BGP_EVENT_ADD(peer, BGP_Stop);
+		}
+	}
+	return 0;
+}
@@ -0,0 +1,38 @@
+/* BGP neighbours watched by BFD
+ *
+ * This file is part of GNU Zebra.
+ *
+ * GNU Zebra is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2, or (at your option) any
+ * later version.
+ *
+ * GNU Zebra is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with GNU Zebra; see the file COPYING.  If not, write to the Free
+ * Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ * 02111-1307, USA.
+ */
+
+#ifndef _QUAGGA_BGP_BFD_H
+#define _QUAGGA_BGP_BFD_H
+
+/* A neighbour with "neighbor X bfd" has zebra run a BFD session to it
+ * while it is Established, from the local address of the connection.
+ * The session going down stops the peer there and then, rather than
+ * when the hold timer runs out. */
+struct zclient;
+
+extern void bgp_bfd_register(struct peer *);
+extern void bgp_bfd_deregister(struct peer *);
+/* For the flag set or unset */
+extern void bgp_bfd_peer_update(struct peer *);
+/* For zebra connected again, which knows of no session then */
+extern void bgp_bfd_register_all(void);
+extern int bgp_bfd_update(int, struct zclient *, zebra_size_t, vrf_id_t);
+
+#endif /* _QUAGGA_BGP_BFD_H */
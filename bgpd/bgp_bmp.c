@@ -0,0 +1,767 @@
+/* BGP Monitoring Protocol (RFC 7854) exporter
+ *
+ * This file is part of GNU Zebra.
+ *
+ * GNU Zebra is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2, or (at your option) any
+ * later version.
+ *
+ * GNU Zebra is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with GNU Zebra; see the file COPYING.  If not, write to the Free
+ * Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ * 02111-1307, USA.
+ */
+
+#include <zebra.h>
+
+#include "prefix.h"
+#include "stream.h"
+#include "sockunion.h"
+#include "command.h"
+#include "thread.h"
+#include "linklist.h"
+#include "memory.h"
+#include "network.h"
+#include "log.h"
+#include "filter.h"
+#include "version.h"
+
+#include "bgpd/bgpd.h"
+#include "bgpd/bgp_table.h"
+#include "bgpd/bgp_route.h"
+#include "bgpd/bgp_attr.h"
+#include "bgpd/bgp_packet.h"
+#include "bgpd/bgp_bmp.h"
+
+#define BMP_VERSION 3
+#define BMP_HEADER_SIZE 6
+#define BMP_PEER_HEADER_SIZE 42
+
+/* Seconds between attempts to reach a collector */
+#define BMP_RECONNECT 30
+
+/* Route nodes per slice of the initial sync, and how long the sync
+ * waits for a collector more than half behind to catch up. */
+#define BMP_SYNC_BATCH 1000
+#define BMP_SYNC_WAIT 100 /* ms */
+
+enum bmp_state {
+	BMP_IDLE,
+	BMP_CONNECTING,
+	BMP_UP,
+};
+
+static const struct message bmp_state_msg[] = {
+	{BMP_IDLE,	   "Idle"	 },
+	{ BMP_CONNECTING, "Connecting"},
+	{ BMP_UP,	  "Up"	      },
+};
+static const int bmp_state_msg_max = BMP_UP + 1;
+
+struct bmp_collector {
+	union sockunion su;
+	u_int16_t port;
+
+	enum bmp_state state;
+	int fd;
+	struct thread *t_connect;
+	struct thread *t_read;
+	struct thread *t_write;
+
+	/* Messages waiting for the socket.  Monitoring never waits for a
+	 * collector: a message that doesn't fit is dropped and, as the
+	 * collector's view is then wrong, the session is reset. */
+	u_char *ring;
+	size_t size;
+	size_t head;
+	size_t len;
+
+	/* Initial route-monitoring sync, in slices */
+	struct bgp *bgp;
+	bgp_table_iter_t iter;
+	struct thread *t_sync;
+
+	time_t uptime;
+	unsigned long messages;
+	unsigned long long bytes;
+	unsigned long dropped;
+	unsigned long resets;
+};
+
+static struct list *bmp_collectors;
+
+/* Collectors up, so the hooks know when there is nothing to do */
+static unsigned int bmp_up_count;
+
+/* Messages are built here, then copied to each collector's ring */
+static struct stream *bmp_obuf;
+
+static int bmp_collector_connect(struct thread *);
+static int bmp_collector_sync(struct thread *);
+
+static void bmp_header(struct stream *s, u_char type) {
+	stream_putc(s, BMP_VERSION);
+	stream_putl(s, 0); /* length, see bmp_set_size() */
+	stream_putc(s, type);
+}
+
+static void bmp_set_size(struct stream *s) {
+	stream_putl_at(s, 1, stream_get_endp(s));
+}
+
+static void bmp_peer_header(struct stream *s, struct peer *peer, u_char flags) {
+	struct timeval tv;
+
+	gettimeofday(&tv, NULL);
+
+	if(sockunion_family(&peer->su) == AF_INET6) {
+		flags |= BMP_PEER_FLAG_V;
+	}
+
+	stream_putc(s, 0); /* global instance peer */
+	stream_putc(s, flags);
+	stream_put(s, NULL, 8); /* peer distinguisher */
+	if(sockunion_family(&peer->su) == AF_INET6) {
+		stream_put(s, &peer->su.sin6.sin6_addr, IPV6_MAX_BYTELEN);
+	} else {
+		stream_put(s, NULL, 12);
+		stream_put_in_addr(s, &peer->su.sin.sin_addr);
+	}
+	stream_putl(s, peer->as);
+	stream_put_in_addr(s, &peer->remote_id);
+	stream_putl(s, tv.tv_sec);
+	stream_putl(s, tv.tv_usec);
+}
+
+static void bmp_put_addr(struct stream *s, union sockunion *su) {
+	if(su && sockunion_family(su) == AF_INET6) {
+		stream_put(s, &su->sin6.sin6_addr, IPV6_MAX_BYTELEN);
+	} else if(su && sockunion_family(su) == AF_INET) {
+		stream_put(s, NULL, 12);
+		stream_put_in_addr(s, &su->sin.sin_addr);
+	} else {
+		stream_put(s, NULL, 16);
+	}
+}
+
+/* BGP message header of a PDU carried in a BMP message */
+static void bmp_put_bgp_header(struct stream *s, u_int16_t length, u_char type) {
+	int i;
+
+	for(i = 0; i < BGP_MARKER_SIZE; i++) {
+		stream_putc(s, 0xff);
+	}
+	stream_putw(s, length);
+	stream_putc(s, type);
+}
+
+static void bmp_put_info(struct stream *s, u_int16_t type, const char *str) {
+	stream_putw(s, type);
+	stream_putw(s, strlen(str));
+	stream_put(s, str, strlen(str));
+}
+
+/* A single-prefix IPv4 UPDATE: an announcement with attr, or the
+ * withdrawal of p without. */
+static void bmp_put_update(struct stream *s, struct prefix *p, struct attr *attr) {
+	size_t start = stream_get_endp(s);
+	int psize = PSIZE(p->prefixlen);
+
+	bmp_put_bgp_header(s, 0, BGP_MSG_UPDATE);
+
+	if(attr) {
+		stream_putw(s, 0);
+		bgp_dump_routes_attr(s, attr, p);
+		stream_putc(s, p->prefixlen);
+		stream_put(s, &p->u.prefix4, psize);
+	} else {
+		stream_putw(s, psize + 1);
+		stream_putc(s, p->prefixlen);
+		stream_put(s, &p->u.prefix4, psize);
+		stream_putw(s, 0);
+	}
+
+	stream_putw_at(s, start + BGP_MARKER_SIZE, stream_get_endp(s) - start);
+}
+
+static void bmp_collector_close(struct bmp_collector *col) {
+	THREAD_OFF(col->t_read);
+	THREAD_OFF(col->t_write);
+	THREAD_OFF(col->t_sync);
+	THREAD_OFF(col->t_connect);
+
+	if(col->iter.table) {
+		bgp_table_iter_cleanup(&col->iter);
+	}
+	if(col->bgp) {
+		bgp_unlock(col->bgp);
+		col->bgp = NULL;
+	}
+
+	if(col->fd >= 0) {
+		close(col->fd);
+		col->fd = -1;
+	}
+	if(col->state == BMP_UP) {
+		bmp_up_count--;
+	}
+	col->state = BMP_IDLE;
+	col->head = col->len = 0;
+}
+
+/* Lost, or not keeping up: start over with a fresh session and sync */
+static void bmp_collector_reset(struct bmp_collector *col) {
+	char buf[SU_ADDRSTRLEN];
+
+	zlog_warn("BMP collector %s port %u: session reset", sockunion2str(&col->su, buf, sizeof(buf)), col->port);
+
+	bmp_collector_close(col);
+	col->resets++;
+	col->t_connect = thread_add_timer(bm->master, bmp_collector_connect, col, BMP_RECONNECT);
+}
+
+/* Write what the socket takes of the ring, < 0 if the session failed */
+static int bmp_collector_flush(struct bmp_collector *col) {
+	struct iovec iov[2];
+	size_t first;
+	ssize_t n;
+
+	first = col->size - col->head;
+	if(first > col->len) {
+		first = col->len;
+	}
+	iov[0].iov_base = col->ring + col->head;
+	iov[0].iov_len = first;
+	iov[1].iov_base = col->ring;
+	iov[1].iov_len = col->len - first;
+
+	n = writev(col->fd, iov, iov[1].iov_len ? 2 : 1);
+	if(n < 0) {
+		return ERRNO_IO_RETRY(errno) ? 0 : -1;
+	}
+
+	col->head = (col->head + n) % col->size;
+	col->len -= n;
+	col->bytes += n;
+	return 0;
+}
+
+static int bmp_collector_write(struct thread *t) {
+	struct bmp_collector *col = THREAD_ARG(t);
+
+	col->t_write = NULL;
+
+	if(bmp_collector_flush(col) < 0) {
+		bmp_collector_reset(col);
+		return 0;
+	}
+	if(col->len) {
+		col->t_write = thread_add_write(bm->master, bmp_collector_write, col, col->fd);
+	}
+	return 0;
+}
+
+/* Queue the message in s to col, false if it had to be dropped */
+static int bmp_collector_send(struct bmp_collector *col, struct stream *s) {
+	size_t len = stream_get_endp(s);
+	size_t tail, first;
+
+	if(col->len + len > col->size) {
+		col->dropped++;
+		bmp_collector_reset(col);
+		return 0;
+	}
+
+	tail = (col->head + col->len) % col->size;
+	first = col->size - tail;
+	if(first > len) {
+		first = len;
+	}
+	memcpy(col->ring + tail, STREAM_DATA(s), first);
+	memcpy(col->ring, STREAM_DATA(s) + first, len - first);
+	col->len += len;
+	col->messages++;
+
+	if(!col->t_write) {
+		col->t_write = thread_add_write(bm->master, bmp_collector_write, col, col->fd);
+	}
+	return 1;
+}
+
+/* Send s to every collector up */
+static void bmp_send_all(struct stream *s) {
+	struct listnode *node, *nnode;
+	struct bmp_collector *col;
+
+	for(ALL_LIST_ELEMENTS(bmp_collectors, node, nnode, col)) {
+		if(col->state == BMP_UP) {
+			bmp_collector_send(col, s);
+		}
+	}
+}
+
+static int bmp_peer_monitored(struct peer *peer) {
+	return (peer->bgp && !peer->bgp->name && peer != peer->bgp->peer_self);
+}
+
+static void bmp_make_peer_up(struct stream *s, struct peer *peer) {
+	stream_reset(s);
+	bmp_header(s, BMP_MSG_PEER_UP);
+	bmp_peer_header(s, peer, 0);
+	bmp_put_addr(s, peer->su_local);
+	stream_putw(s, peer->su_local ? sockunion_get_port(peer->su_local) : 0);
+	stream_putw(s, peer->su_remote ? sockunion_get_port(peer->su_remote) : 0);
+	stream_put(s, STREAM_DATA(peer->open_sent), stream_get_endp(peer->open_sent));
+	stream_put(s, STREAM_DATA(peer->open_rcvd), stream_get_endp(peer->open_rcvd));
+	bmp_set_size(s);
+}
+
+void bgp_bmp_peer_up(struct peer *peer) {
+	if(!bmp_up_count || !bmp_peer_monitored(peer) || !peer->open_sent || !peer->open_rcvd) {
+		return;
+	}
+
+	bmp_make_peer_up(bmp_obuf, peer);
+	bmp_send_all(bmp_obuf);
+}
+
+void bgp_bmp_peer_down(struct peer *peer) {
+	struct stream *s = bmp_obuf;
+	struct stream *notify;
+
+	/* the copy is of this session only, sent or not */
+	notify = peer->notify_sent;
+	peer->notify_sent = NULL;
+
+	if(!bmp_up_count || !bmp_peer_monitored(peer)) {
+		stream_free(notify);
+		return;
+	}
+
+	stream_reset(s);
+	bmp_header(s, BMP_MSG_PEER_DOWN);
+	bmp_peer_header(s, peer, 0);
+
+	if(notify) {
+		stream_putc(s, BMP_PEER_DOWN_LOCAL_NOTIFY);
+		stream_put(s, STREAM_DATA(notify), stream_get_endp(notify));
+		stream_free(notify);
+	} else {
+		switch(peer->last_reset) {
+			case PEER_DOWN_NOTIFY_RECEIVED:
+				stream_putc(s, BMP_PEER_DOWN_REMOTE_NOTIFY);
+				bmp_put_bgp_header(s, BGP_HEADER_SIZE + 2 + peer->notify.length, BGP_MSG_NOTIFY);
+				stream_putc(s, peer->notify.code);
+				stream_putc(s, peer->notify.subcode);
+				if(peer->notify.length) {
+					stream_put(s, peer->notify.data, peer->notify.length);
+				}
+				break;
+			case PEER_DOWN_NEIGHBOR_DELETE: stream_putc(s, BMP_PEER_DOWN_DECONFIGURED); break;
+			case PEER_DOWN_CLOSE_SESSION:
+			case PEER_DOWN_NSF_CLOSE_SESSION: stream_putc(s, BMP_PEER_DOWN_REMOTE_NO_NOTIFY); break;
+			default:
+				/* no FSM event code to go with it */
+				stream_putc(s, BMP_PEER_DOWN_LOCAL_NO_NOTIFY);
+				stream_putw(s, 0);
+				break;
+		}
+	}
+
+	bmp_set_size(s);
+	bmp_send_all(s);
+}
+
+static void bmp_make_route(struct stream *s, struct peer *peer, struct prefix *p, struct attr *attr) {
+	stream_reset(s);
+	bmp_header(s, BMP_MSG_ROUTE_MONITORING);
+	bmp_peer_header(s, peer, BMP_PEER_FLAG_L);
+	bmp_put_update(s, p, attr);
+	bmp_set_size(s);
+}
+
+/* The peer's path, as it stands after inbound policy */
+static struct bgp_info *bmp_route_info(struct bgp_node *rn, struct peer *peer) {
+	struct bgp_info *ri;
+
+	for(ri = rn->info; ri; ri = ri->next) {
+		if(ri->peer == peer && ri->type == ZEBRA_ROUTE_BGP && ri->sub_type == BGP_ROUTE_NORMAL) {
+			if(CHECK_FLAG(ri->flags, BGP_INFO_REMOVED) || CHECK_FLAG(ri->flags, BGP_INFO_HISTORY)) {
+				return NULL;
+			}
+			return ri;
+		}
+	}
+	return NULL;
+}
+
+/* After an UPDATE or withdraw from peer about p went through policy */
+void bgp_bmp_route(struct peer *peer, struct prefix *p, afi_t afi, safi_t safi) {
+	struct bgp_node *rn;
+	struct bgp_info *ri = NULL;
+
+	if(!bmp_up_count || afi != AFI_IP || safi != SAFI_UNICAST || !bmp_peer_monitored(peer)) {
+		return;
+	}
+
+	rn = bgp_node_lookup(peer->bgp->rib[afi][safi], p);
+	if(rn) {
+		ri = bmp_route_info(rn, peer);
+		bgp_unlock_node(rn);
+	}
+
+	bmp_make_route(bmp_obuf, peer, p, ri ? ri->attr : NULL);
+	bmp_send_all(bmp_obuf);
+}
+
+/* Peers up at the start of the sync, and the End-of-RIB closing it */
+static void bmp_sync_peers(struct bmp_collector *col, int eor) {
+	struct listnode *node;
+	struct peer *peer;
+	struct stream *s = bmp_obuf;
+
+	for(ALL_LIST_ELEMENTS_RO(col->bgp->peer, node, peer)) {
+		if(peer->status != Established || !peer->open_sent || !peer->open_rcvd) {
+			continue;
+		}
+		if(eor) {
+			stream_reset(s);
+			bmp_header(s, BMP_MSG_ROUTE_MONITORING);
+			bmp_peer_header(s, peer, BMP_PEER_FLAG_L);
+			bmp_put_bgp_header(s, BGP_MSG_UPDATE_MIN_SIZE, BGP_MSG_UPDATE);
+			stream_putw(s, 0);
+			stream_putw(s, 0);
+			bmp_set_size(s);
+		} else {
+			bmp_make_peer_up(s, peer);
+		}
+		if(!bmp_collector_send(col, s)) {
+			return;
+		}
+	}
+}
+
+/* A slice of the initial sync.  Unlike live updates, the sync can wait
+ * for the collector: it holds back while the ring is over half full. */
+static int bmp_collector_sync(struct thread *t) {
+	struct bmp_collector *col = THREAD_ARG(t);
+	struct bgp_node *rn;
+	struct bgp_info *ri;
+	int count = 0;
+
+	col->t_sync = NULL;
+
+	while(count < BMP_SYNC_BATCH) {
+		if(col->len > col->size / 2) {
+			bgp_table_iter_pause(&col->iter);
+			col->t_sync = thread_add_background(bm->master, bmp_collector_sync, col, BMP_SYNC_WAIT);
+			return 0;
+		}
+
+		rn = bgp_table_iter_next(&col->iter);
+		if(rn == NULL) {
+			bgp_table_iter_cleanup(&col->iter);
+			bmp_sync_peers(col, 1);
+			return 0;
+		}
+
+		for(ri = rn->info; ri; ri = ri->next) {
+			if(ri->peer->status != Established || bmp_route_info(rn, ri->peer) != ri || ri->peer == col->bgp->peer_self) {
+				continue;
+			}
+			bmp_make_route(bmp_obuf, ri->peer, &rn->p, ri->attr);
+			if(!bmp_collector_send(col, bmp_obuf)) {
+				return 0;
+			}
+		}
+		count++;
+	}
+
+	bgp_table_iter_pause(&col->iter);
+	col->t_sync = thread_add_background(bm->master, bmp_collector_sync, col, 0);
+	return 0;
+}
+
+static int bmp_collector_read(struct thread *t) {
+	struct bmp_collector *col = THREAD_ARG(t);
+	u_char buf[512];
+	ssize_t n;
+
+	col->t_read = NULL;
+
+	/* Collectors aren't meant to send anything, this is to notice
+	 * them going away */
+	n = read(col->fd, buf, sizeof(buf));
+	if(n == 0 || (n < 0 && !ERRNO_IO_RETRY(errno))) {
+		bmp_collector_reset(col);
+		return 0;
+	}
+
+	col->t_read = thread_add_read(bm->master, bmp_collector_read, col, col->fd);
+	return 0;
+}
+
+static void bmp_collector_established(struct bmp_collector *col) {
+	struct stream *s = bmp_obuf;
+	char buf[SU_ADDRSTRLEN];
+
+	zlog_info("BMP collector %s port %u: session up", sockunion2str(&col->su, buf, sizeof(buf)), col->port);
+
+	col->state = BMP_UP;
+	col->uptime = bgp_clock();
+	bmp_up_count++;
+	col->t_read = thread_add_read(bm->master, bmp_collector_read, col, col->fd);
+
+	stream_reset(s);
+	bmp_header(s, BMP_MSG_INITIATION);
+	bmp_put_info(s, BMP_INFO_SYS_DESCR, QUAGGA_PROGNAME " bgpd " QUAGGA_VERSION);
+	bmp_put_info(s, BMP_INFO_SYS_NAME, host.name ? host.name : "");
+	bmp_set_size(s);
+	if(!bmp_collector_send(col, s)) {
+		return;
+	}
+
+	col->bgp = bgp_get_default();
+	if(col->bgp == NULL) {
+		return;
+	}
+	bgp_lock(col->bgp);
+
+	bmp_sync_peers(col, 0);
+	if(col->state != BMP_UP) {
+		return;
+	}
+	bgp_table_iter_init(&col->iter, col->bgp->rib[AFI_IP][SAFI_UNICAST]);
+	col->t_sync = thread_add_background(bm->master, bmp_collector_sync, col, 0);
+}
+
+static int bmp_collector_connected(struct thread *t) {
+	struct bmp_collector *col = THREAD_ARG(t);
+	int err = 0;
+	socklen_t len = sizeof(err);
+
+	col->t_write = NULL;
+
+	if(getsockopt(col->fd, SOL_SOCKET, SO_ERROR, &err, &len) < 0 || err) {
+		bmp_collector_reset(col);
+		return 0;
+	}
+
+	bmp_collector_established(col);
+	return 0;
+}
+
+static int bmp_collector_connect(struct thread *t) {
+	struct bmp_collector *col = THREAD_ARG(t);
+	enum connect_result ret;
+
+	col->t_connect = NULL;
+
+	col->fd = sockunion_socket(&col->su);
+	if(col->fd < 0) {
+		bmp_collector_reset(col);
+		return 0;
+	}
+
+	ret = sockunion_connect(col->fd, &col->su, htons(col->port), 0);
+	if(ret == connect_error) {
+		bmp_collector_reset(col);
+		return 0;
+	}
+	set_nonblocking(col->fd);
+
+	if(ret == connect_success) {
+		bmp_collector_established(col);
+	} else {
+		col->state = BMP_CONNECTING;
+		col->t_write = thread_add_write(bm->master, bmp_collector_connected, col, col->fd);
+	}
+	return 0;
+}
+
+static struct bmp_collector *bmp_collector_lookup(union sockunion *su, u_int16_t port) {
+	struct listnode *node;
+	struct bmp_collector *col;
+
+	for(ALL_LIST_ELEMENTS_RO(bmp_collectors, node, col)) {
+		if(sockunion_same(&col->su, su) && col->port == port) {
+			return col;
+		}
+	}
+	return NULL;
+}
+
+static void bmp_collector_free(struct bmp_collector *col) {
+	struct stream *s = bmp_obuf;
+
+	/* Say goodbye, as far as the socket takes it without waiting */
+	if(col->state == BMP_UP) {
+		stream_reset(s);
+		bmp_header(s, BMP_MSG_TERMINATION);
+		stream_putw(s, BMP_TERM_REASON);
+		stream_putw(s, 2);
+		stream_putw(s, 0); /* administratively closed */
+		bmp_set_size(s);
+		if(bmp_collector_send(col, s)) {
+			bmp_collector_flush(col);
+		}
+	}
+
+	bmp_collector_close(col);
+	XFREE(MTYPE_BGP_BMP_BUF, col->ring);
+	XFREE(MTYPE_BGP_BMP, col);
+}
+
+DEFUN(bgp_bmp_collector, bgp_bmp_collector_cmd, "bmp collector A.B.C.D <1-65535> buffer <64-1048576>",
+      "BGP Monitoring Protocol\n"
+      "Export to a BMP collector\n"
+      "Collector address\n"
+      "Collector port\n"
+      "Limit what may wait for the collector\n"
+      "Kilobytes\n") {
+	struct bmp_collector *col;
+	union sockunion su;
+	u_int16_t port;
+	size_t size = BMP_BUFFER_DEFAULT;
+
+	if(vty->index && ((struct bgp *) vty->index)->name) {
+		vty_out(vty, "%% BMP monitors the default instance only%s", VTY_NEWLINE);
+		return CMD_WARNING;
+	}
+
+	if(str2sockunion(argv[0], &su) < 0) {
+		vty_out(vty, "%% Malformed address%s", VTY_NEWLINE);
+		return CMD_WARNING;
+	}
+	VTY_GET_INTEGER_RANGE("port", port, argv[1], 1, 65535);
+	if(argc > 2) {
+		VTY_GET_INTEGER_RANGE("buffer", size, argv[2], 64, 1048576);
+	}
+	size *= 1024;
+
+	col = bmp_collector_lookup(&su, port);
+	if(col) {
+		if(col->size == size) {
+			return CMD_SUCCESS;
+		}
+		listnode_delete(bmp_collectors, col);
+		bmp_collector_free(col);
+	}
+
+	col = XCALLOC(MTYPE_BGP_BMP, sizeof(struct bmp_collector));
+	col->su = su;
+	col->port = port;
+	col->fd = -1;
+	col->size = size;
+	col->ring = XMALLOC(MTYPE_BGP_BMP_BUF, size);
+	listnode_add(bmp_collectors, col);
+
+	col->t_connect = thread_add_event(bm->master, bmp_collector_connect, col, 0);
+	return CMD_SUCCESS;
+}
+
+ALIAS(bgp_bmp_collector, bgp_bmp_collector_port_cmd, "bmp collector A.B.C.D <1-65535>",
+      "BGP Monitoring Protocol\n"
+      "Export to a BMP collector\n"
+      "Collector address\n"
+      "Collector port\n")
+
+DEFUN(no_bgp_bmp_collector, no_bgp_bmp_collector_cmd, "no bmp collector A.B.C.D <1-65535>",
+      NO_STR "BGP Monitoring Protocol\n"
+	     "Export to a BMP collector\n"
+	     "Collector address\n"
+	     "Collector port\n") {
+	struct bmp_collector *col;
+	union sockunion su;
+	u_int16_t port;
+
+	if(str2sockunion(argv[0], &su) < 0) {
+		vty_out(vty, "%% Malformed address%s", VTY_NEWLINE);
+		return CMD_WARNING;
+	}
+	VTY_GET_INTEGER_RANGE("port", port, argv[1], 1, 65535);
+
+	col = bmp_collector_lookup(&su, port);
+	if(!col) {
+		vty_out(vty, "%% No such collector%s", VTY_NEWLINE);
+		return CMD_WARNING;
+	}
+
+	listnode_delete(bmp_collectors, col);
+	bmp_collector_free(col);
+	return CMD_SUCCESS;
+}
+
+ALIAS(no_bgp_bmp_collector, no_bgp_bmp_collector_buffer_cmd, "no bmp collector A.B.C.D <1-65535> buffer <64-1048576>",
+      NO_STR "BGP Monitoring Protocol\n"
+	     "Export to a BMP collector\n"
+	     "Collector address\n"
+	     "Collector port\n"
+	     "Limit what may wait for the collector\n"
+	     "Kilobytes\n")
+
+DEFUN(show_bgp_bmp, show_bgp_bmp_cmd, "show bgp bmp", SHOW_STR BGP_STR "BGP Monitoring Protocol collectors\n") {
+	struct listnode *node;
+	struct bmp_collector *col;
+	char buf[SU_ADDRSTRLEN];
+	char timebuf[BGP_UPTIME_LEN];
+
+	for(ALL_LIST_ELEMENTS_RO(bmp_collectors, node, col)) {
+		vty_out(vty, "Collector %s port %u, %s", sockunion2str(&col->su, buf, sizeof(buf)), col->port, LOOKUP(bmp_state_msg, col->state));
+		if(col->state == BMP_UP) {
+			vty_out(vty, " for %s%s", peer_uptime(col->uptime, timebuf, BGP_UPTIME_LEN), col->t_sync || col->iter.table ? ", initial sync running" : "");
+		}
+		vty_out(vty, "%s", VTY_NEWLINE);
+		vty_out(vty, "  Queued %lu of %lu KB, %lu messages, %llu bytes sent%s", (unsigned long) (col->len / 1024), (unsigned long) (col->size / 1024), col->messages, col->bytes, VTY_NEWLINE);
+		vty_out(vty, "  Dropped %lu messages, %lu session resets%s", col->dropped, col->resets, VTY_NEWLINE);
+	}
+	return CMD_SUCCESS;
+}
+
+int bgp_bmp_config_write(struct vty *vty, struct bgp *bgp) {
+	struct listnode *node;
+	struct bmp_collector *col;
+	char buf[SU_ADDRSTRLEN];
+
+	if(bgp->name) {
+		return 0;
+	}
+
+	for(ALL_LIST_ELEMENTS_RO(bmp_collectors, node, col)) {
+		vty_out(vty, " bmp collector %s %u", sockunion2str(&col->su, buf, sizeof(buf)), col->port);
+		if(col->size != BMP_BUFFER_DEFAULT * 1024) {
+			vty_out(vty, " buffer %lu", (unsigned long) (col->size / 1024));
+		}
+		vty_out(vty, "%s", VTY_NEWLINE);
+	}
+	return 0;
+}
+
+void bgp_bmp_init(void) {
+	bmp_collectors = list_new();
+	bmp_obuf = stream_new(BGP_MAX_PACKET_SIZE * 2 + BMP_HEADER_SIZE + BMP_PEER_HEADER_SIZE);
+
+	install_element(BGP_NODE, &bgp_bmp_collector_cmd);
+	install_element(BGP_NODE, &bgp_bmp_collector_port_cmd);
+	install_element(BGP_NODE, &no_bgp_bmp_collector_cmd);
+	install_element(BGP_NODE, &no_bgp_bmp_collector_buffer_cmd);
+	install_element(VIEW_NODE, &show_bgp_bmp_cmd);
+}
+
+void bgp_bmp_finish(void) {
+	struct bmp_collector *col;
+
+	while(listcount(bmp_collectors)) {
+		col = listgetdata(listhead(bmp_collectors));
+		list_delete_node(bmp_collectors, listhead(bmp_collectors));
+		bmp_collector_free(col);
+	}
+	list_free(bmp_collectors);
+	stream_free(bmp_obuf);
+}
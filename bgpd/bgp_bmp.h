@@ -0,0 +1,62 @@
+/* BGP Monitoring Protocol (RFC 7854) exporter
+ *
+ * This file is part of GNU Zebra.
+ *
+ * GNU Zebra is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2, or (at your option) any
+ * later version.
+ *
+ * GNU Zebra is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with GNU Zebra; see the file COPYING.  If not, write to the Free
+ * Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ * 02111-1307, USA.
+ */
+
+#ifndef _QUAGGA_BGP_BMP_H
+#define _QUAGGA_BGP_BMP_H
+
+/* Message types */
+#define BMP_MSG_ROUTE_MONITORING 0
+#define BMP_MSG_STATISTICS_REPORT 1
+#define BMP_MSG_PEER_DOWN 2
+#define BMP_MSG_PEER_UP 3
+#define BMP_MSG_INITIATION 4
+#define BMP_MSG_TERMINATION 5
+
+/* Per-peer header flags */
+#define BMP_PEER_FLAG_V 0x80 /* IPv6 peer address */
+#define BMP_PEER_FLAG_L 0x40 /* post-policy Adj-RIB-In */
+
+/* Peer down reasons */
+#define BMP_PEER_DOWN_LOCAL_NOTIFY 1
+#define BMP_PEER_DOWN_LOCAL_NO_NOTIFY 2
+#define BMP_PEER_DOWN_REMOTE_NOTIFY 3
+#define BMP_PEER_DOWN_REMOTE_NO_NOTIFY 4
+#define BMP_PEER_DOWN_DECONFIGURED 5
+
+/* Initiation and termination information TLVs */
+#define BMP_INFO_STRING 0
+#define BMP_INFO_SYS_DESCR 1
+#define BMP_INFO_SYS_NAME 2
+#define BMP_TERM_REASON 1
+
+#define BMP_PORT_DEFAULT 5000
+#define BMP_BUFFER_DEFAULT 4096 /* KB */
+
+/* Only the default instance's peers and IPv4 unicast routes are
+ * monitored.  The hooks are cheap while no collector is up. */
+extern void bgp_bmp_peer_up(struct peer *);
+extern void bgp_bmp_peer_down(struct peer *);
+extern void bgp_bmp_route(struct peer *, struct prefix *, afi_t, safi_t);
+
+extern int bgp_bmp_config_write(struct vty *, struct bgp *);
+extern void bgp_bmp_init(void);
+extern void bgp_bmp_finish(void);
+
+#endif /* _QUAGGA_BGP_BMP_H */
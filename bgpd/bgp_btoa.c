@@ -34,6 +34,7 @@ Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
 #include "bgpd/bgp_dump.h"
 #include "bgpd/bgp_attr.h"
 #include "bgpd/bgp_aspath.h"
+#include "bgpd/bgp_arena.h"
 
 /* privileges */
 static zebra_capabilities_t _caps_p[] = {
@@ -108,8 +109,9 @@ static int attr_parse(struct stream *s, u_int16_t len) {
 					struct aspath *aspath;
 
 					aspath = aspath_parse(s, length, 1);
-					printf("ASPATH: %s\n", aspath->str);
+					printf("ASPATH: %s\n", aspath_print(aspath));
 					aspath_free(aspath);
+					bgp_arena_reset();
 				}
 				break;
 			case BGP_ATTR_NEXT_HOP:
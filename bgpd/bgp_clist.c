@@ -25,6 +25,8 @@ Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
 #include "prefix.h"
 #include "memory.h"
 #include "filter.h"
+#include "hash.h"
+#include "jhash.h"
 
 #include "bgpd/bgpd.h"
 #include "bgpd/bgp_community.h"
@@ -84,6 +86,9 @@ static void community_entry_free(struct community_entry *entry) {
 			if(entry->reg) {
 				bgp_regex_free(entry->reg);
 			}
+			if(entry->literal) {
+				XFREE(MTYPE_COMMUNITY_LIST_CONFIG, entry->literal);
+			}
 		default: break;
 	}
 	XFREE(MTYPE_COMMUNITY_LIST_ENTRY, entry);
@@ -230,6 +235,225 @@ static struct community_list *community_list_get(struct community_list_handler *
 	return list;
 }
 
+/* Lists at least this long are matched through their index.  */
+#define COMMUNITY_LIST_INDEX_MIN 8
+
+/* The entries of a standard list that hold a single value, community,
+   extended or large, are found by the value: only those for the values
+   a route carries have to be tried, however long the list.  Each value
+   has them chained in list order.  */
+struct community_index {
+	u_char val[LCOMMUNITY_SIZE];
+	u_char len;
+	struct community_entry *head;
+};
+
+static unsigned int community_index_key(void *arg) {
+	struct community_index *index = arg;
+
+	return jhash(index->val, index->len, 0);
+}
+
+static int community_index_cmp(const void *arg1, const void *arg2) {
+	const struct community_index *index1 = arg1;
+	const struct community_index *index2 = arg2;
+
+	return index1->len == index2->len && memcmp(index1->val, index2->val, index1->len) == 0;
+}
+
+static void *community_index_alloc(void *arg) {
+	struct community_index *index;
+
+	index = XCALLOC(MTYPE_COMMUNITY_LIST_INDEX, sizeof(struct community_index));
+	memcpy(index, arg, sizeof(struct community_index));
+	index->head = NULL;
+	return index;
+}
+
+static void community_index_free(void *index) {
+	XFREE(MTYPE_COMMUNITY_LIST_INDEX, index);
+}
+
+/* The value the entry is indexed by, if it is.  A standard community
+   entry with "internet" in it matches anything, so it is not.  */
+static int community_entry_key(struct community_entry *entry, struct community_index *key) {
+	if(entry->any) {
+		return 0;
+	}
+
+	switch(entry->style) {
+		case COMMUNITY_LIST_STANDARD:
+			if(!entry->u.com || entry->u.com->size != 1 || community_include(entry->u.com, COMMUNITY_INTERNET)) {
+				return 0;
+			}
+			key->len = sizeof(u_int32_t);
+			memcpy(key->val, entry->u.com->val, key->len);
+			return 1;
+		case EXTCOMMUNITY_LIST_STANDARD:
+			if(!entry->u.ecom || entry->u.ecom->size != 1) {
+				return 0;
+			}
+			key->len = ECOMMUNITY_SIZE;
+			memcpy(key->val, entry->u.ecom->val, key->len);
+			return 1;
+		case LARGE_COMMUNITY_LIST_STANDARD:
+			if(!entry->u.lcom || entry->u.lcom->size != 1) {
+				return 0;
+			}
+			key->len = LCOMMUNITY_SIZE;
+			memcpy(key->val, entry->u.lcom->val, key->len);
+			return 1;
+		default: return 0;
+	}
+}
+
+/* Entries are only ever added at the tail, so last on their chain too. */
+static void community_index_add(struct community_list *list, struct community_entry *entry) {
+	struct community_entry **point;
+	struct community_index key, *index;
+
+	entry->seq = ++list->seq;
+	entry->index_next = NULL;
+
+	if(community_entry_key(entry, &key)) {
+		if(!list->index) {
+			list->index = hash_create(community_index_key, community_index_cmp);
+		}
+		index = hash_get(list->index, &key, community_index_alloc);
+		point = &index->head;
+	} else {
+		point = &list->unindexed;
+	}
+
+	for(; *point; point = &(*point)->index_next)
+		;
+	*point = entry;
+}
+
+static void community_index_delete(struct community_list *list, struct community_entry *entry) {
+	struct community_entry **point;
+	struct community_index key, *index = NULL;
+
+	if(community_entry_key(entry, &key)) {
+		index = hash_lookup(list->index, &key);
+		assert(index);
+		point = &index->head;
+	} else {
+		point = &list->unindexed;
+	}
+
+	for(; *point != entry; point = &(*point)->index_next)
+		;
+	*point = entry->index_next;
+
+	if(index && !index->head) {
+		hash_release(list->index, index);
+		community_index_free(index);
+	}
+}
+
+/* The first entry, in list order, of those indexed by any of the n
+   values of len bytes at val.  */
+static struct community_entry *community_index_first(struct community_list *list, const u_char *val, int n, u_char len) {
+	struct community_entry *best = NULL;
+	struct community_index key, *index;
+	int i;
+
+	if(!list->index) {
+		return NULL;
+	}
+
+	key.len = len;
+	for(i = 0; i < n; i++) {
+		memcpy(key.val, val + i * len, len);
+		index = hash_lookup(list->index, &key);
+		if(index && (!best || index->head->seq < best->seq)) {
+			best = index->head;
+		}
+	}
+	return best;
+}
+
+/* An expanded entry whose regular expression is a plain string, maybe
+   with '^' or '_' in front and '$' or '_' behind, is looked for as a
+   string.  '_' stands for the start or end of the string, or one of
+   the characters bgp_regcomp() lets it match. */
+#define COMMUNITY_LITERAL_START 0x01 /* ^ */
+#define COMMUNITY_LITERAL_END 0x02   /* $ */
+#define COMMUNITY_LITERAL_HEAD 0x04  /* _ in front */
+#define COMMUNITY_LITERAL_TAIL 0x08  /* _ behind */
+
+static void community_entry_literal(struct community_entry *entry) {
+	const char *str = entry->config, *end;
+	u_char flags = 0;
+	const char *p;
+
+	if(*str == '^') {
+		flags |= COMMUNITY_LITERAL_START;
+		str++;
+	} else if(*str == '_') {
+		flags |= COMMUNITY_LITERAL_HEAD;
+		str++;
+	}
+
+	end = str + strlen(str);
+	if(end > str && end[-1] == '$') {
+		flags |= COMMUNITY_LITERAL_END;
+		end--;
+	} else if(end > str && end[-1] == '_') {
+		flags |= COMMUNITY_LITERAL_TAIL;
+		end--;
+	}
+
+	if(end == str) {
+		return;
+	}
+	for(p = str; p < end; p++) {
+		if(!isalnum((int) *p) && !strchr(":- ", *p)) {
+			return;
+		}
+	}
+
+	entry->literal = XMALLOC(MTYPE_COMMUNITY_LIST_CONFIG, end - str + 1);
+	memcpy(entry->literal, str, end - str);
+	entry->literal[end - str] = '\0';
+	entry->literal_flags = flags;
+}
+
+static int community_literal_delim(char c) {
+	return c && strchr(",{}() ", c);
+}
+
+static int community_literal_match(struct community_entry *entry, const char *str) {
+	size_t len = strlen(entry->literal);
+	const char *p;
+
+	for(p = str; (p = strstr(p, entry->literal)) != NULL; p++) {
+		if((entry->literal_flags & COMMUNITY_LITERAL_START) && p != str) {
+			return 0;
+		}
+		if((entry->literal_flags & COMMUNITY_LITERAL_HEAD) && p != str && !community_literal_delim(p[-1])) {
+			continue;
+		}
+		if((entry->literal_flags & COMMUNITY_LITERAL_END) && p[len]) {
+			continue;
+		}
+		if((entry->literal_flags & COMMUNITY_LITERAL_TAIL) && p[len] && !community_literal_delim(p[len])) {
+			continue;
+		}
+		return 1;
+	}
+	return 0;
+}
+
+/* Whether an expanded entry matches the string.  */
+static int community_entry_regexec(struct community_entry *entry, const char *str) {
+	if(entry->literal) {
+		return community_literal_match(entry, str);
+	}
+	return bgp_regexec_str(entry->reg, str) == 0;
+}
+
 static void community_list_delete(struct community_list *list) {
 	struct community_list_list *clist;
 	struct community_entry *entry, *next;
@@ -238,6 +462,10 @@ static void community_list_delete(struct community_list *list) {
 		next = entry->next;
 		community_entry_free(entry);
 	}
+	if(list->index) {
+		hash_clean(list->index, community_index_free);
+		hash_free(list->index);
+	}
 
 	clist = list->parent;
 
@@ -271,6 +499,12 @@ static void community_list_entry_add(struct community_list *list, struct communi
 		list->head = entry;
 	}
 	list->tail = entry;
+
+	if(entry->reg && entry->config) {
+		community_entry_literal(entry);
+	}
+	community_index_add(list, entry);
+	list->count++;
 }
 
 /* Delete community-list entry from the list.  */
@@ -287,6 +521,8 @@ static void community_list_entry_delete(struct community_list *list, struct comm
 		list->head = entry->next;
 	}
 
+	community_index_delete(list, entry);
+	list->count--;
 	community_entry_free(entry);
 
 	if(community_list_empty_p(list)) {
@@ -382,7 +618,7 @@ static char *community_str_get(struct community *com, int i) {
 
 /* Internal function to perform regular expression match for
  *  * a single community. */
-static int community_regexp_include(regex_t *reg, struct community *com, int i) {
+static int community_regexp_include(struct community_entry *entry, struct community *com, int i) {
 	char *str;
 	int rv;
 
@@ -395,21 +631,16 @@ static int community_regexp_include(regex_t *reg, struct community *com, int i)
 	}
 
 	/* Regular expression match.  */
-	rv = regexec(reg, str, 0, NULL, 0);
+	rv = community_entry_regexec(entry, str);
 
 	XFREE(MTYPE_COMMUNITY_STR, str);
 
-	if(rv == 0) {
-		return 1;
-	}
-
-	/* No match.  */
-	return 0;
+	return rv;
 }
 
 /* Internal function to perform regular expression match for community
    attribute.  */
-static int community_regexp_match(struct community *com, regex_t *reg) {
+static int community_regexp_match(struct community *com, struct community_entry *entry) {
 	const char *str;
 
 	/* When there is no communities attribute it is treated as empty
@@ -421,12 +652,7 @@ static int community_regexp_match(struct community *com, regex_t *reg) {
 	}
 
 	/* Regular expression match.  */
-	if(regexec(reg, str, 0, NULL, 0) == 0) {
-		return 1;
-	}
-
-	/* No match.  */
-	return 0;
+	return community_entry_regexec(entry, str);
 }
 
 static char *lcommunity_str_get(struct lcommunity *lcom, int i) {
@@ -471,27 +697,26 @@ static char *lcommunity_str_get(struct lcommunity *lcom, int i) {
 
 /* Internal function to perform regular expression match for
  *  * a single community. */
-static int lcommunity_regexp_include(regex_t *reg, struct lcommunity *lcom, int i) {
-	const char *str;
+static int lcommunity_regexp_include(struct community_entry *entry, struct lcommunity *lcom, int i) {
+	char *str;
+	int rv;
 
 	/* When there is no communities attribute it is treated as empty
  *      string.  */
 	if(lcom == NULL || lcom->size == 0) {
-		str = "";
-	} else {
-		str = lcommunity_str_get(lcom, i);
+		return community_entry_regexec(entry, "");
 	}
+	str = lcommunity_str_get(lcom, i);
 
 	/* Regular expression match.  */
-	if(regexec(reg, str, 0, NULL, 0) == 0) {
-		return 1;
-	}
+	rv = community_entry_regexec(entry, str);
 
-	/* No match.  */
-	return 0;
+	XFREE(MTYPE_LCOMMUNITY_STR, str);
+
+	return rv;
 }
 
-static int lcommunity_regexp_match(struct lcommunity *com, regex_t *reg) {
+static int lcommunity_regexp_match(struct lcommunity *com, struct community_entry *entry) {
 	const char *str;
 
 	/* When there is no communities attribute it is treated as empty
@@ -503,15 +728,10 @@ static int lcommunity_regexp_match(struct lcommunity *com, regex_t *reg) {
 	}
 
 	/* Regular expression match.  */
-	if(regexec(reg, str, 0, NULL, 0) == 0) {
-		return 1;
-	}
-
-	/* No match.  */
-	return 0;
+	return community_entry_regexec(entry, str);
 }
 
-static int ecommunity_regexp_match(struct ecommunity *ecom, regex_t *reg) {
+static int ecommunity_regexp_match(struct ecommunity *ecom, struct community_entry *entry) {
 	const char *str;
 
 	/* When there is no communities attribute it is treated as empty
@@ -523,11 +743,47 @@ static int ecommunity_regexp_match(struct ecommunity *ecom, regex_t *reg) {
 	}
 
 	/* Regular expression match.  */
-	if(regexec(reg, str, 0, NULL, 0) == 0) {
+	return community_entry_regexec(entry, str);
+}
+
+/* The first entry, in list order, that match() accepts.  In a long
+   list the index gives the first of the entries for the n values at
+   val, which all match, and only the unindexed entries ahead of it
+   are tried.  */
+static struct community_entry *community_list_first(struct community_list *list, const u_char *val, int n, u_char len, int (*match)(struct community_entry *, void *), void *arg) {
+	struct community_entry *entry;
+	struct community_entry *best;
+
+	if(list->count < COMMUNITY_LIST_INDEX_MIN) {
+		for(entry = list->head; entry; entry = entry->next) {
+			if(match(entry, arg)) {
+				return entry;
+			}
+		}
+		return NULL;
+	}
+
+	best = community_index_first(list, val, n, len);
+	for(entry = list->unindexed; entry && (!best || entry->seq < best->seq); entry = entry->index_next) {
+		if(match(entry, arg)) {
+			return entry;
+		}
+	}
+	return best;
+}
+
+static int community_entry_match(struct community_entry *entry, void *arg) {
+	struct community *com = arg;
+
+	if(entry->any) {
 		return 1;
 	}
 
-	/* No match.  */
+	if(entry->style == COMMUNITY_LIST_STANDARD) {
+		return community_include(entry->u.com, COMMUNITY_INTERNET) || community_match(com, entry->u.com);
+	} else if(entry->style == COMMUNITY_LIST_EXPANDED) {
+		return community_regexp_match(com, entry);
+	}
 	return 0;
 }
 
@@ -536,24 +792,24 @@ static int ecommunity_regexp_match(struct ecommunity *ecom, regex_t *reg) {
 int community_list_match(struct community *com, struct community_list *list) {
 	struct community_entry *entry;
 
-	for(entry = list->head; entry; entry = entry->next) {
-		if(entry->any) {
-			return entry->direct == COMMUNITY_PERMIT ? 1 : 0;
-		}
+	entry = community_list_first(list, com ? (u_char *) com->val : NULL, com ? com->size : 0, sizeof(u_int32_t), community_entry_match, com);
+	if(entry) {
+		return entry->direct == COMMUNITY_PERMIT ? 1 : 0;
+	}
+	return 0;
+}
 
-		if(entry->style == COMMUNITY_LIST_STANDARD) {
-			if(community_include(entry->u.com, COMMUNITY_INTERNET)) {
-				return entry->direct == COMMUNITY_PERMIT ? 1 : 0;
-			}
+static int lcommunity_entry_match(struct community_entry *entry, void *arg) {
+	struct lcommunity *lcom = arg;
 
-			if(community_match(com, entry->u.com)) {
-				return entry->direct == COMMUNITY_PERMIT ? 1 : 0;
-			}
-		} else if(entry->style == COMMUNITY_LIST_EXPANDED) {
-			if(community_regexp_match(com, entry->reg)) {
-				return entry->direct == COMMUNITY_PERMIT ? 1 : 0;
-			}
-		}
+	if(entry->any) {
+		return 1;
+	}
+
+	if(entry->style == LARGE_COMMUNITY_LIST_STANDARD) {
+		return lcommunity_match(lcom, entry->u.lcom);
+	} else if(entry->style == LARGE_COMMUNITY_LIST_EXPANDED) {
+		return lcommunity_regexp_match(lcom, entry);
 	}
 	return 0;
 }
@@ -561,20 +817,24 @@ int community_list_match(struct community *com, struct community_list *list) {
 int lcommunity_list_match(struct lcommunity *lcom, struct community_list *list) {
 	struct community_entry *entry;
 
-	for(entry = list->head; entry; entry = entry->next) {
-		if(entry->any) {
-			return entry->direct == COMMUNITY_PERMIT ? 1 : 0;
-		}
+	entry = community_list_first(list, lcom ? lcom->val : NULL, lcom ? lcom->size : 0, LCOMMUNITY_SIZE, lcommunity_entry_match, lcom);
+	if(entry) {
+		return entry->direct == COMMUNITY_PERMIT ? 1 : 0;
+	}
+	return 0;
+}
 
-		if(entry->style == LARGE_COMMUNITY_LIST_STANDARD) {
-			if(lcommunity_match(lcom, entry->u.lcom)) {
-				return entry->direct == COMMUNITY_PERMIT ? 1 : 0;
-			}
-		} else if(entry->style == LARGE_COMMUNITY_LIST_EXPANDED) {
-			if(lcommunity_regexp_match(lcom, entry->reg)) {
-				return entry->direct == COMMUNITY_PERMIT ? 1 : 0;
-			}
-		}
+static int ecommunity_entry_match(struct community_entry *entry, void *arg) {
+	struct ecommunity *ecom = arg;
+
+	if(entry->any) {
+		return 1;
+	}
+
+	if(entry->style == EXTCOMMUNITY_LIST_STANDARD) {
+		return ecommunity_match(ecom, entry->u.ecom);
+	} else if(entry->style == EXTCOMMUNITY_LIST_EXPANDED) {
+		return ecommunity_regexp_match(ecom, entry);
 	}
 	return 0;
 }
@@ -582,20 +842,24 @@ int lcommunity_list_match(struct lcommunity *lcom, struct community_list *list)
 int ecommunity_list_match(struct ecommunity *ecom, struct community_list *list) {
 	struct community_entry *entry;
 
-	for(entry = list->head; entry; entry = entry->next) {
-		if(entry->any) {
-			return entry->direct == COMMUNITY_PERMIT ? 1 : 0;
-		}
+	entry = community_list_first(list, ecom ? ecom->val : NULL, ecom ? ecom->size : 0, ECOMMUNITY_SIZE, ecommunity_entry_match, ecom);
+	if(entry) {
+		return entry->direct == COMMUNITY_PERMIT ? 1 : 0;
+	}
+	return 0;
+}
 
-		if(entry->style == EXTCOMMUNITY_LIST_STANDARD) {
-			if(ecommunity_match(ecom, entry->u.ecom)) {
-				return entry->direct == COMMUNITY_PERMIT ? 1 : 0;
-			}
-		} else if(entry->style == EXTCOMMUNITY_LIST_EXPANDED) {
-			if(ecommunity_regexp_match(ecom, entry->reg)) {
-				return entry->direct == COMMUNITY_PERMIT ? 1 : 0;
-			}
-		}
+static int community_entry_exact_match(struct community_entry *entry, void *arg) {
+	struct community *com = arg;
+
+	if(entry->any) {
+		return 1;
+	}
+
+	if(entry->style == COMMUNITY_LIST_STANDARD) {
+		return community_include(entry->u.com, COMMUNITY_INTERNET) || community_cmp(com, entry->u.com);
+	} else if(entry->style == COMMUNITY_LIST_EXPANDED) {
+		return community_regexp_match(com, entry);
 	}
 	return 0;
 }
@@ -605,24 +869,31 @@ int ecommunity_list_match(struct ecommunity *ecom, struct community_list *list)
 int community_list_exact_match(struct community *com, struct community_list *list) {
 	struct community_entry *entry;
 
-	for(entry = list->head; entry; entry = entry->next) {
-		if(entry->any) {
-			return entry->direct == COMMUNITY_PERMIT ? 1 : 0;
-		}
+	/* An entry of one value is only the same as one value. */
+	entry = community_list_first(list, com ? (u_char *) com->val : NULL, com && com->size == 1 ? 1 : 0, sizeof(u_int32_t), community_entry_exact_match, com);
+	if(entry) {
+		return entry->direct == COMMUNITY_PERMIT ? 1 : 0;
+	}
+	return 0;
+}
 
-		if(entry->style == COMMUNITY_LIST_STANDARD) {
-			if(community_include(entry->u.com, COMMUNITY_INTERNET)) {
-				return entry->direct == COMMUNITY_PERMIT ? 1 : 0;
-			}
+/* One value of a communities attribute.  */
+struct community_nth {
+	void *com;
+	int i;
+};
 
-			if(community_cmp(com, entry->u.com)) {
-				return entry->direct == COMMUNITY_PERMIT ? 1 : 0;
-			}
-		} else if(entry->style == COMMUNITY_LIST_EXPANDED) {
-			if(community_regexp_match(com, entry->reg)) {
-				return entry->direct == COMMUNITY_PERMIT ? 1 : 0;
-			}
-		}
+static int community_entry_include(struct community_entry *entry, void *arg) {
+	struct community_nth *nth = arg;
+
+	if(entry->any) {
+		return 1;
+	}
+
+	if(entry->style == COMMUNITY_LIST_STANDARD) {
+		return community_include(entry->u.com, COMMUNITY_INTERNET) || community_include(entry->u.com, community_val_get(nth->com, nth->i));
+	} else if(entry->style == COMMUNITY_LIST_EXPANDED) {
+		return community_regexp_include(entry, nth->com, nth->i);
 	}
 	return 0;
 }
@@ -630,6 +901,7 @@ int community_list_exact_match(struct community *com, struct community_list *lis
 /* Delete all permitted communities in the list from com.  */
 struct community *community_list_match_delete(struct community *com, struct community_list *list) {
 	struct community_entry *entry;
+	struct community_nth nth;
 	u_int32_t val;
 	u_int32_t com_index_to_delete[com->size];
 	int delete_index = 0;
@@ -639,39 +911,19 @@ struct community *community_list_match_delete(struct community *com, struct comm
    * community-list.  If we need to delete a community value add its index to
    * com_index_to_delete.
    */
+	nth.com = com;
 	for(i = 0; i < com->size; i++) {
-		val = community_val_get(com, i);
-
-		for(entry = list->head; entry; entry = entry->next) {
-			if(entry->any) {
-				if(entry->direct == COMMUNITY_PERMIT) {
-					com_index_to_delete[delete_index] = i;
-					delete_index++;
-				}
-				break;
-			}
-
-			else if((entry->style == COMMUNITY_LIST_STANDARD) && (community_include(entry->u.com, COMMUNITY_INTERNET) || community_include(entry->u.com, val))) {
-				if(entry->direct == COMMUNITY_PERMIT) {
-					com_index_to_delete[delete_index] = i;
-					delete_index++;
-				}
-				break;
-			}
-
-			else if((entry->style == COMMUNITY_LIST_EXPANDED) && community_regexp_include(entry->reg, com, i)) {
-				if(entry->direct == COMMUNITY_PERMIT) {
-					com_index_to_delete[delete_index] = i;
-					delete_index++;
-				}
-				break;
-			}
+		nth.i = i;
+		entry = community_list_first(list, (u_char *) com_nthval(com, i), 1, sizeof(u_int32_t), community_entry_include, &nth);
+		if(entry && entry->direct == COMMUNITY_PERMIT) {
+			com_index_to_delete[delete_index] = i;
+			delete_index++;
 		}
 	}
 
 	/* Delete all of the communities we flagged for deletion */
 	for(i = delete_index - 1; i >= 0; i--) {
-		val = community_val_get(com, com_index_to_delete[i]);
+		memcpy(&val, com_nthval(com, com_index_to_delete[i]), sizeof(u_int32_t));
 		community_del_val(com, &val);
 	}
 
@@ -737,7 +989,7 @@ int community_list_set(struct community_list_handler *ch, const char *name, cons
 	struct community_entry *entry = NULL;
 	struct community_list *list;
 	struct community *com = NULL;
-	regex_t *regex = NULL;
+	struct bgp_regex *regex = NULL;
 
 	/* Get community list. */
 	list = community_list_get(ch, name, COMMUNITY_LIST_MASTER);
@@ -791,7 +1043,7 @@ int community_list_unset(struct community_list_handler *ch, const char *name, co
 	struct community_entry *entry = NULL;
 	struct community_list *list;
 	struct community *com = NULL;
-	regex_t *regex = NULL;
+	struct bgp_regex *regex = NULL;
 
 	/* Lookup community list.  */
 	list = community_list_lookup(ch, name, COMMUNITY_LIST_MASTER);
@@ -838,8 +1090,25 @@ int community_list_unset(struct community_list_handler *ch, const char *name, co
 }
 
 /* Delete all permitted large communities in the list from com.  */
+static int lcommunity_entry_include(struct community_entry *entry, void *arg) {
+	struct community_nth *nth = arg;
+	struct lcommunity *lcom = nth->com;
+
+	if(entry->any) {
+		return 1;
+	}
+
+	if(entry->style == LARGE_COMMUNITY_LIST_STANDARD) {
+		return lcommunity_include(entry->u.lcom, lcom->val + (nth->i * LCOMMUNITY_SIZE));
+	} else if(entry->style == LARGE_COMMUNITY_LIST_EXPANDED) {
+		return lcommunity_regexp_include(entry, lcom, nth->i);
+	}
+	return 0;
+}
+
 struct lcommunity *lcommunity_list_match_delete(struct lcommunity *lcom, struct community_list *list) {
 	struct community_entry *entry;
+	struct community_nth nth;
 	u_int32_t com_index_to_delete[lcom->size];
 	u_char *ptr;
 	int delete_index = 0;
@@ -850,32 +1119,14 @@ struct lcommunity *lcommunity_list_match_delete(struct lcommunity *lcom, struct
    * com_index_to_delete.
    */
 
+	nth.com = lcom;
 	for(i = 0; i < lcom->size; i++) {
+		nth.i = i;
 		ptr = lcom->val + (i * LCOMMUNITY_SIZE);
-		for(entry = list->head; entry; entry = entry->next) {
-			if(entry->any) {
-				if(entry->direct == COMMUNITY_PERMIT) {
-					com_index_to_delete[delete_index] = i;
-					delete_index++;
-				}
-				break;
-			}
-
-			else if((entry->style == LARGE_COMMUNITY_LIST_STANDARD) && lcommunity_include(entry->u.lcom, ptr)) {
-				if(entry->direct == COMMUNITY_PERMIT) {
-					com_index_to_delete[delete_index] = i;
-					delete_index++;
-				}
-				break;
-			}
-
-			else if((entry->style == LARGE_COMMUNITY_LIST_STANDARD) && entry->reg && lcommunity_regexp_include(entry->reg, lcom, i)) {
-				if(entry->direct == COMMUNITY_PERMIT) {
-					com_index_to_delete[delete_index] = i;
-					delete_index++;
-				}
-				break;
-			}
+		entry = community_list_first(list, ptr, 1, LCOMMUNITY_SIZE, lcommunity_entry_include, &nth);
+		if(entry && entry->direct == COMMUNITY_PERMIT) {
+			com_index_to_delete[delete_index] = i;
+			delete_index++;
 		}
 	}
 
@@ -894,7 +1145,7 @@ int lcommunity_list_set(struct community_list_handler *ch, const char *name, con
 	struct community_entry *entry = NULL;
 	struct community_list *list;
 	struct lcommunity *lcom = NULL;
-	regex_t *regex = NULL;
+	struct bgp_regex *regex = NULL;
 
 	/* Get community list. */
 	list = community_list_get(ch, name, LARGE_COMMUNITY_LIST_MASTER);
@@ -954,7 +1205,7 @@ int lcommunity_list_unset(struct community_list_handler *ch, const char *name, c
 	struct community_entry *entry = NULL;
 	struct community_list *list;
 	struct lcommunity *lcom = NULL;
-	regex_t *regex = NULL;
+	struct bgp_regex *regex = NULL;
 
 	/* Lookup community list.  */
 	list = community_list_lookup(ch, name, LARGE_COMMUNITY_LIST_MASTER);
@@ -1005,7 +1256,7 @@ int extcommunity_list_set(struct community_list_handler *ch, const char *name, c
 	struct community_entry *entry = NULL;
 	struct community_list *list;
 	struct ecommunity *ecom = NULL;
-	regex_t *regex = NULL;
+	struct bgp_regex *regex = NULL;
 
 	entry = NULL;
 
@@ -1071,7 +1322,7 @@ int extcommunity_list_unset(struct community_list_handler *ch, const char *name,
 	struct community_entry *entry = NULL;
 	struct community_list *list;
 	struct ecommunity *ecom = NULL;
-	regex_t *regex = NULL;
+	struct bgp_regex *regex = NULL;
 
 	/* Lookup extcommunity list.  */
 	list = community_list_lookup(ch, name, EXTCOMMUNITY_LIST_MASTER);
@@ -61,6 +61,13 @@ struct community_list {
 	/* Community-list entry in this community-list.  */
 	struct community_entry *head;
 	struct community_entry *tail;
+	unsigned int count;
+
+	/* Standard entries of a single value, by the value, and the entries
+	   not indexed that way; see bgp_clist.c.  */
+	struct hash *index;
+	struct community_entry *unindexed;
+	u_int32_t seq;
 };
 
 /* Each entry in community-list.  */
@@ -88,7 +95,17 @@ struct community_entry {
 	char *config;
 
 	/* Expanded community-list regular expression.  */
-	regex_t *reg;
+	struct bgp_regex *reg;
+
+	/* The same, when it is only a string to look for, maybe anchored or
+	   between '_'s: found without the regex engine.  */
+	char *literal;
+	u_char literal_flags;
+
+	/* Position in the list, and the next entry on the same index chain
+	   or among the unindexed ones, in list order.  */
+	u_int32_t seq;
+	struct community_entry *index_next;
 };
 
 /* Linked list of community-list.  */
@@ -25,6 +25,7 @@ Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
 #include "memory.h"
 
 #include "bgpd/bgp_community.h"
+#include "bgpd/bgp_arena.h"
 
 /* Hash of community attribute. */
 static struct hash *comhash;
@@ -147,27 +148,41 @@ u_int32_t community_val_get(struct community *com, int i) {
 }
 
 /* Sort and uniq given community. */
+/* Sort size values in place and drop the duplicates, returning how many
+ * are left */
+static int community_sort_uniq_val(u_int32_t *val, int size) {
+	int i, n = 0;
+
+	/* Sorted, duplicates are next to each other. */
+	qsort(val, size, sizeof(u_int32_t), community_compare);
+
+	for(i = 0; i < size; i++) {
+		if(n && val[n - 1] == val[i]) {
+			continue;
+		}
+		val[n++] = val[i];
+	}
+	return n;
+}
+
 struct community *community_uniq_sort(struct community *com) {
-	int i;
 	struct community *new;
-	u_int32_t val;
 
 	if(!com) {
 		return NULL;
 	}
 
 	new = community_new();
-	;
-
-	for(i = 0; i < com->size; i++) {
-		val = community_val_get(com, i);
-
-		if(!community_include(new, val)) {
-			community_add_val(new, val);
-		}
+	if(!com->size) {
+		return new;
 	}
 
-	qsort(new->val, new->size, sizeof(u_int32_t), community_compare);
+	new->val = XMALLOC(MTYPE_COMMUNITY_VAL, com_length(com));
+	memcpy(new->val, com->val, com_length(com));
+	new->size = community_sort_uniq_val(new->val, com->size);
+	if(new->size < com->size) {
+		new->val = XREALLOC(MTYPE_COMMUNITY_VAL, new->val, com_length(new));
+	}
 
 	return new;
 }
@@ -312,22 +327,36 @@ void community_unintern(struct community **com) {
 }
 
 /* Create new community attribute. */
+static void *community_parse_hash_alloc(void *p) {
+	return community_dup(p);
+}
+
 struct community *community_parse(u_int32_t *pnt, u_short length) {
 	struct community tmp;
-	struct community *new;
+	struct community *find;
 
 	/* If length is malformed return NULL. */
 	if(length % 4) {
 		return NULL;
 	}
 
-	/* Make temporary community for hash look up. */
-	tmp.size = length / 4;
-	tmp.val = pnt;
+	/* Make temporary community for hash look up, sorted in the UPDATE's
+	 * arena: only one not seen before is copied to the heap. */
+	memset(&tmp, 0, sizeof(struct community));
+	if(length) {
+		tmp.val = bgp_arena_alloc(length);
+		memcpy(tmp.val, pnt, length);
+		tmp.size = community_sort_uniq_val(tmp.val, length / 4);
+	}
+
+	find = (struct community *) hash_get(comhash, &tmp, community_parse_hash_alloc);
+	find->refcnt++;
 
-	new = community_uniq_sort(&tmp);
+	if(!find->str) {
+		find->str = community_com2str(find);
+	}
 
-	return community_intern(new);
+	return find;
 }
 
 struct community *community_dup(struct community *com) {
@@ -580,7 +609,7 @@ struct hash *community_hash(void) {
 
 /* Initialize comminity related hash. */
 void community_init(void) {
-	comhash = hash_create((unsigned int (*)(void *)) community_hash_make, (int (*)(const void *, const void *)) community_cmp);
+	comhash = hash_create_open((unsigned int (*)(void *)) community_hash_make, (int (*)(const void *, const void *)) community_cmp);
 }
 
 void community_finish(void) {
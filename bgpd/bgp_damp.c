@@ -45,11 +45,14 @@ static struct bgp_damp_config *damp = &bgp_damp_cfg;
 #define BGP_DAMP_LIST_DEL(N, A) BGP_INFO_DEL(N, A, no_reuse_list)
 
 /* Calculate reuse list index by penalty value.  */
-static int bgp_reuse_index(int penalty) {
-	unsigned int i;
+static int bgp_reuse_index(unsigned int penalty) {
+	unsigned int i = 0;
 	int index;
 
-	i = (int) (((double) penalty / damp->reuse_limit - 1.0) * damp->scale_factor);
+	/* (penalty / reuse_limit - 1) * scale_factor */
+	if(penalty > damp->reuse_limit) {
+		i = (((u_int64_t) (penalty - damp->reuse_limit) * damp->reuse_scale_factor) / damp->reuse_limit) >> BGP_DAMP_DECAY_SHIFT;
+	}
 
 	if(i >= damp->reuse_index_size) {
 		i = damp->reuse_index_size - 1;
@@ -74,6 +77,14 @@ static void bgp_reuse_list_add(struct bgp_damp_info *bdi) {
 	damp->reuse_list[index] = bdi;
 }
 
+/* The reuse list, or the pending list, bdi is on.  */
+static struct bgp_damp_info **bgp_reuse_list_head(struct bgp_damp_info *bdi) {
+	if(bdi->index == BGP_DAMP_INDEX_PENDING) {
+		return &damp->reuse_pending;
+	}
+	return &damp->reuse_list[bdi->index];
+}
+
 /* Delete BGP dampening information from reuse list.  */
 static void bgp_reuse_list_delete(struct bgp_damp_info *bdi) {
 	if(bdi->next) {
@@ -82,7 +93,7 @@ static void bgp_reuse_list_delete(struct bgp_damp_info *bdi) {
 	if(bdi->prev) {
 		bdi->prev->next = bdi->next;
 	} else {
-		damp->reuse_list[bdi->index] = bdi->next;
+		*bgp_reuse_list_head(bdi) = bdi->next;
 	}
 }
 
@@ -90,7 +101,7 @@ static void bgp_reuse_list_delete(struct bgp_damp_info *bdi) {
 int bgp_damp_decay(time_t tdiff, int penalty) {
 	unsigned int i;
 
-	i = (int) ((double) tdiff / DELTA_T);
+	i = tdiff / DELTA_T;
 
 	if(i == 0) {
 		return penalty;
@@ -100,35 +111,29 @@ int bgp_damp_decay(time_t tdiff, int penalty) {
 		return 0;
 	}
 
-	return (int) (penalty * damp->decay_array[i]);
+	return (int) (((u_int64_t) penalty * damp->decay_array[i]) >> BGP_DAMP_DECAY_SHIFT);
 }
 
-/* Handler of reuse timer event.  Each route in the current reuse-list
-   is evaluated.  RFC2439 Section 4.8.7.  */
-static int bgp_reuse_timer(struct thread *t) {
+static int bgp_reuse_batch(struct thread *);
+
+/* Evaluate up to BGP_DAMP_REUSE_BATCH routes off the pending list,
+   leaving the rest to a background thread.  RFC2439 Section 4.8.7.  */
+static void bgp_reuse_run(void) {
 	struct bgp_damp_info *bdi;
-	struct bgp_damp_info *next;
 	time_t t_now, t_diff;
-
-	damp->t_reuse = NULL;
-	damp->t_reuse = thread_add_timer(bm->master, bgp_reuse_timer, NULL, DELTA_REUSE);
+	unsigned int count;
 
 	t_now = bgp_clock();
+	damp->reuse_batches++;
 
-	/* 1.  save a pointer to the current zeroth queue head and zero the
-     list head entry.  */
-	bdi = damp->reuse_list[damp->reuse_offset];
-	damp->reuse_list[damp->reuse_offset] = NULL;
-
-	/* 2.  set offset = modulo reuse-list-size ( offset + 1 ), thereby
-     rotating the circular queue of list-heads.  */
-	damp->reuse_offset = (damp->reuse_offset + 1) % damp->reuse_list_size;
-
-	/* 3. if ( the saved list head pointer is non-empty ) */
-	for(; bdi; bdi = next) {
+	for(count = 0; count < BGP_DAMP_REUSE_BATCH && (bdi = damp->reuse_pending); count++) {
 		struct bgp *bgp = bdi->binfo->peer->bgp;
 
-		next = bdi->next;
+		damp->reuse_pending = bdi->next;
+		if(bdi->next) {
+			bdi->next->prev = NULL;
+		}
+		damp->reuse_evaluated++;
 
 		/* Set t-diff = t-now - t-updated.  */
 		t_diff = t_now - bdi->t_updated;
@@ -144,6 +149,7 @@ static int bgp_reuse_timer(struct thread *t) {
 			/* Reuse the route.  */
 			bgp_info_unset_flag(bdi->rn, bdi->binfo, BGP_INFO_DAMPED);
 			bdi->suppress_time = 0;
+			damp->reused++;
 
 			if(bdi->lastrecord == BGP_RECORD_UPDATE) {
 				bgp_info_unset_flag(bdi->rn, bdi->binfo, BGP_INFO_HISTORY);
@@ -151,7 +157,7 @@ static int bgp_reuse_timer(struct thread *t) {
 				bgp_process(bgp, bdi->rn, bdi->afi, bdi->safi);
 			}
 
-			if(bdi->penalty <= damp->reuse_limit / 2.0) {
+			if(bdi->penalty * 2 <= damp->reuse_limit) {
 				bgp_damp_info_free(bdi, 1);
 			} else {
 				BGP_DAMP_LIST_ADD(damp, bdi);
@@ -162,6 +168,52 @@ static int bgp_reuse_timer(struct thread *t) {
 		}
 	}
 
+	if(damp->reuse_pending && !damp->t_reuse_batch) {
+		damp->t_reuse_batch = thread_add_background(bm->master, bgp_reuse_batch, NULL, 0);
+	}
+}
+
+static int bgp_reuse_batch(struct thread *t) {
+	damp->t_reuse_batch = NULL;
+	bgp_reuse_run();
+	return 0;
+}
+
+/* Handler of reuse timer event.  The routes in the current reuse-list
+   are queued on the pending list for bgp_reuse_run().  */
+static int bgp_reuse_timer(struct thread *t) {
+	struct bgp_damp_info *bdi;
+	struct bgp_damp_info *next;
+
+	damp->t_reuse = NULL;
+	damp->t_reuse = thread_add_timer(bm->master, bgp_reuse_timer, NULL, DELTA_REUSE);
+
+	/* 1.  save a pointer to the current zeroth queue head and zero the
+     list head entry.  */
+	bdi = damp->reuse_list[damp->reuse_offset];
+	damp->reuse_list[damp->reuse_offset] = NULL;
+
+	/* 2.  set offset = modulo reuse-list-size ( offset + 1 ), thereby
+     rotating the circular queue of list-heads.  */
+	damp->reuse_offset = (damp->reuse_offset + 1) % damp->reuse_list_size;
+
+	/* 3. if ( the saved list head pointer is non-empty ) */
+	for(; bdi; bdi = next) {
+		next = bdi->next;
+
+		bdi->index = BGP_DAMP_INDEX_PENDING;
+		bdi->prev = NULL;
+		bdi->next = damp->reuse_pending;
+		if(damp->reuse_pending) {
+			damp->reuse_pending->prev = bdi;
+		}
+		damp->reuse_pending = bdi;
+	}
+
+	if(damp->reuse_pending) {
+		bgp_reuse_run();
+	}
+
 	return 0;
 }
 
@@ -169,7 +221,7 @@ static int bgp_reuse_timer(struct thread *t) {
 int bgp_damp_withdraw(struct bgp_info *binfo, struct bgp_node *rn, afi_t afi, safi_t safi, int attr_change) {
 	time_t t_now;
 	struct bgp_damp_info *bdi = NULL;
-	double last_penalty = 0;
+	unsigned int last_penalty = 0;
 
 	t_now = bgp_clock();
 
@@ -268,7 +320,7 @@ int bgp_damp_update(struct bgp_info *binfo, struct bgp_node *rn, afi_t afi, safi
 		status = BGP_DAMP_SUPPRESSED;
 	}
 
-	if(bdi->penalty > damp->reuse_limit / 2.0) {
+	if(bdi->penalty * 2 > damp->reuse_limit) {
 		bdi->t_updated = t_now;
 	} else {
 		bgp_damp_info_free(bdi, 0);
@@ -309,7 +361,7 @@ int bgp_damp_scan(struct bgp_info *binfo, afi_t afi, safi_t safi) {
 		t_diff = t_now - bdi->t_updated;
 		bdi->penalty = bgp_damp_decay(t_diff, bdi->penalty);
 
-		if(bdi->penalty <= damp->reuse_limit / 2.0) {
+		if(bdi->penalty * 2 <= damp->reuse_limit) {
 			/* release the bdi, bdi->binfo. */
 			bgp_damp_info_free(bdi, 1);
 			return 0;
@@ -360,15 +412,11 @@ static void bgp_damp_parameter_set(int hlife, int reuse, int sup, int maxsup) {
 
 	damp->ceiling = (int) (damp->reuse_limit * (pow(2, (double) damp->max_suppress_time / damp->half_life)));
 
-	/* Decay-array computations */
+	/* Decay-array computations, for all possible times */
 	damp->decay_array_size = ceil((double) damp->max_suppress_time / DELTA_T);
-	damp->decay_array = XMALLOC(MTYPE_BGP_DAMP_ARRAY, sizeof(double) * (damp->decay_array_size));
-	damp->decay_array[0] = 1.0;
-	damp->decay_array[1] = exp((1.0 / ((double) damp->half_life / DELTA_T)) * log(0.5));
-
-	/* Calculate decay values for all possible times */
-	for(i = 2; i < damp->decay_array_size; i++) {
-		damp->decay_array[i] = damp->decay_array[i - 1] * damp->decay_array[1];
+	damp->decay_array = XMALLOC(MTYPE_BGP_DAMP_ARRAY, sizeof(u_int32_t) * (damp->decay_array_size));
+	for(i = 0; i < damp->decay_array_size; i++) {
+		damp->decay_array[i] = (u_int32_t) (pow(0.5, (double) i * DELTA_T / damp->half_life) * (1 << BGP_DAMP_DECAY_SHIFT) + 0.5);
 	}
 
 	/* Reuse-list computations */
@@ -390,6 +438,7 @@ static void bgp_damp_parameter_set(int hlife, int reuse, int sup, int maxsup) {
 	}
 
 	damp->scale_factor = (double) damp->reuse_index_size / (reuse_max_ratio - 1);
+	damp->reuse_scale_factor = (unsigned int) (damp->scale_factor * (1 << BGP_DAMP_DECAY_SHIFT));
 
 	for(i = 0; i < damp->reuse_index_size; i++) {
 		damp->reuse_index[i] = (int) (((double) damp->half_life / DELTA_REUSE) * log10(1.0 / (damp->reuse_limit * (1.0 + ((double) i / damp->scale_factor)))) / log10(0.5));
@@ -433,6 +482,12 @@ void bgp_damp_info_clean(void) {
 
 	damp->reuse_offset = 0;
 
+	for(bdi = damp->reuse_pending; bdi; bdi = next) {
+		next = bdi->next;
+		bgp_damp_info_free(bdi, 1);
+	}
+	damp->reuse_pending = NULL;
+
 	for(i = 0; i < damp->reuse_list_size; i++) {
 		if(!damp->reuse_list[i]) {
 			continue;
@@ -463,6 +518,7 @@ int bgp_damp_disable(struct bgp *bgp, afi_t afi, safi_t safi) {
 		thread_cancel(damp->t_reuse);
 	}
 	damp->t_reuse = NULL;
+	THREAD_OFF(damp->t_reuse_batch);
 
 	/* Clean BGP dampening information.  */
 	bgp_damp_info_clean();
@@ -489,7 +545,7 @@ static const char *bgp_get_reuse_time(unsigned int penalty, char *buf, size_t le
 	struct tm *tm = NULL;
 
 	if(penalty > damp->reuse_limit) {
-		reuse_time = (int) (DELTA_T * ((log((double) damp->reuse_limit / penalty)) / (log(damp->decay_array[1]))));
+		reuse_time = (int) (damp->half_life * log((double) penalty / damp->reuse_limit) / log(2.0));
 
 		if(reuse_time > damp->max_suppress_time) {
 			reuse_time = damp->max_suppress_time;
@@ -597,3 +653,38 @@ int bgp_show_dampening_parameters(struct vty *vty, afi_t afi, safi_t safi) {
 
 	return CMD_SUCCESS;
 }
+
+int bgp_show_dampening_statistics(struct vty *vty) {
+	struct bgp_damp_info *bdi;
+	unsigned long queued = 0, pending = 0, others = 0;
+	unsigned long depth, max_depth = 0;
+	unsigned int i;
+
+	if(damp->reuse_list == NULL) {
+		vty_out(vty, "dampening not enabled%s", VTY_NEWLINE);
+		return CMD_SUCCESS;
+	}
+
+	for(i = 0; i < damp->reuse_list_size; i++) {
+		depth = 0;
+		for(bdi = damp->reuse_list[i]; bdi; bdi = bdi->next) {
+			depth++;
+		}
+		queued += depth;
+		if(depth > max_depth) {
+			max_depth = depth;
+		}
+	}
+	for(bdi = damp->reuse_pending; bdi; bdi = bdi->next) {
+		pending++;
+	}
+	for(bdi = damp->no_reuse_list; bdi; bdi = bdi->next) {
+		others++;
+	}
+
+	vty_out(vty, "Suppressed routes on reuse lists: %lu in %u lists, longest %lu%s", queued, damp->reuse_list_size, max_depth, VTY_NEWLINE);
+	vty_out(vty, "Waiting to be evaluated: %lu%s", pending, VTY_NEWLINE);
+	vty_out(vty, "Other routes with flap history: %lu%s", others, VTY_NEWLINE);
+	vty_out(vty, "Evaluated: %lu, reused: %lu, in %lu batches%s", damp->reuse_evaluated, damp->reused, damp->reuse_batches, VTY_NEWLINE);
+	return CMD_SUCCESS;
+}
@@ -89,10 +89,11 @@ struct bgp_damp_config {
 	unsigned int decay_rate_per_tick; /* Calculated from half-life */
 	unsigned int decay_array_size;	  /* Calculated using config parameters */
 	double scale_factor;
-	unsigned int reuse_scale_factor;
+	unsigned int reuse_scale_factor; /* scale_factor, fixed point */
 
-	/* Decay array per-set based. */
-	double *decay_array;
+	/* Decay array per-set based, fixed point with BGP_DAMP_DECAY_SHIFT
+	 * fraction bits. */
+	u_int32_t *decay_array;
 
 	/* Reuse index array per-set based. */
 	int *reuse_index;
@@ -101,6 +102,15 @@ struct bgp_damp_config {
 	struct bgp_damp_info **reuse_list;
 	int reuse_offset;
 
+	/* Taken off the reuse list at its turn, but not evaluated yet.  */
+	struct bgp_damp_info *reuse_pending;
+	struct thread *t_reuse_batch;
+
+	/* Statistics */
+	unsigned long reuse_evaluated; /* entries evaluated at their turn */
+	unsigned long reused;	       /* of which reused */
+	unsigned long reuse_batches;   /* bgp_reuse_run() calls */
+
 	/* All dampening information which is not on reuse list.  */
 	struct bgp_damp_info *no_reuse_list;
 
@@ -118,6 +128,16 @@ struct bgp_damp_config {
 /* Time granularity for decay arrays */
 #define DELTA_T 5
 
+/* Fraction bits of the fixed point decay factors and scale factor */
+#define BGP_DAMP_DECAY_SHIFT 16
+
+/* Most reuse list entries evaluated in one go, the rest are left for a
+ * background thread so that a flap storm can't hold up everything else */
+#define BGP_DAMP_REUSE_BATCH 1000
+
+/* bgp_damp_info index while on the pending list */
+#define BGP_DAMP_INDEX_PENDING -2
+
 #define DEFAULT_PENALTY 1000
 
 #define DEFAULT_HALF_LIFE 15
@@ -140,5 +160,6 @@ extern void bgp_damp_info_vty(struct vty *, struct bgp_info *);
 extern const char *bgp_damp_reuse_time_vty(struct vty *, struct bgp_info *, char *, size_t);
 
 extern int bgp_show_dampening_parameters(struct vty *vty, afi_t, safi_t);
+extern int bgp_show_dampening_statistics(struct vty *vty);
 
 #endif /* _QUAGGA_BGP_DAMP_H */
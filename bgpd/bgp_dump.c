@@ -29,6 +29,8 @@ Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
 #include "thread.h"
 #include "linklist.h"
 #include "filter.h"
+#include "memory.h"
+#include "workpool.h"
 
 #include "bgpd/bgp_table.h"
 #include "bgpd/bgpd.h"
@@ -73,6 +75,30 @@ enum MRT_MSG_TYPES {
 	MSG_TABLE_DUMP_V2	  /* routing table dump, version 2 */
 };
 
+/* Size of the chunks a RIB dump is written out in, and the most route
+ * nodes it encodes before yielding to other work. */
+#define BGP_DUMP_CHUNK_SIZE (256 * 1024)
+#define BGP_DUMP_ROUTES_BATCH 1000
+
+/* Encoded records on their way to the writer.  The writer is the only
+ * one to touch fp once the walk has handed it over. */
+struct bgp_dump_chunk {
+	FILE *fp;
+	size_t len;
+	int last; /* close fp once written */
+	u_char data[BGP_DUMP_CHUNK_SIZE];
+};
+
+/* A RIB dump in progress */
+struct bgp_dump_walk {
+	struct bgp *bgp;
+	afi_t afi;
+	bgp_table_iter_t iter;
+	unsigned int seq;
+	struct bgp_dump_chunk *chunk;
+	struct thread *t_walk;
+};
+
 struct bgp_dump {
 	enum bgp_dump_type type;
 
@@ -85,6 +111,8 @@ struct bgp_dump {
 	char *interval_str;
 
 	struct thread *t_interval;
+
+	struct bgp_dump_walk *walk;
 };
 
 static int bgp_dump_unset(struct vty *vty, struct bgp_dump *bgp_dump);
@@ -102,6 +130,9 @@ struct bgp_dump bgp_dump_updates;
 /* BGP dump structure for 'dump bgp routes' */
 struct bgp_dump bgp_dump_routes;
 
+/* Writes out RIB dumps, a single worker so chunks land in order */
+static struct work_pool *bgp_dump_writer;
+
 static FILE *bgp_dump_open_file(struct bgp_dump *bgp_dump) {
 	int ret;
 	time_t clock;
@@ -203,7 +234,50 @@ static void bgp_dump_set_size(struct stream *s, int type) {
 	stream_putl_at(s, 8, stream_get_endp(s) - BGP_DUMP_HEADER_SIZE);
 }
 
-static void bgp_dump_routes_index_table(struct bgp *bgp) {
+static struct bgp_dump_chunk *bgp_dump_chunk_new(FILE *fp) {
+	struct bgp_dump_chunk *chunk;
+
+	chunk = XMALLOC(MTYPE_BGP_DUMP, sizeof(struct bgp_dump_chunk));
+	chunk->fp = fp;
+	chunk->len = 0;
+	chunk->last = 0;
+	return chunk;
+}
+
+/* On the writer: no logging here, a failed write just loses the dump as
+ * it did when written inline. */
+static void bgp_dump_chunk_write(void *arg) {
+	struct bgp_dump_chunk *chunk = arg;
+
+	if(chunk->len) {
+		fwrite(chunk->data, chunk->len, 1, chunk->fp);
+	}
+	if(chunk->last) {
+		fclose(chunk->fp);
+	}
+}
+
+static void bgp_dump_chunk_free(void *arg) {
+	XFREE(MTYPE_BGP_DUMP, arg);
+}
+
+/* Copy the record in obuf to the walk's chunk, handing the chunk to the
+ * writer when it is full. */
+static void bgp_dump_walk_put(struct bgp_dump_walk *walk, struct stream *obuf) {
+	size_t len = stream_get_endp(obuf);
+
+	if(walk->chunk->len + len > BGP_DUMP_CHUNK_SIZE) {
+		FILE *fp = walk->chunk->fp;
+
+		work_pool_submit(bgp_dump_writer, bgp_dump_chunk_write, bgp_dump_chunk_free, walk->chunk);
+		walk->chunk = bgp_dump_chunk_new(fp);
+	}
+	memcpy(walk->chunk->data + walk->chunk->len, STREAM_DATA(obuf), len);
+	walk->chunk->len += len;
+}
+
+static void bgp_dump_routes_index_table(struct bgp_dump_walk *walk) {
+	struct bgp *bgp = walk->bgp;
 	struct peer *peer;
 	struct listnode *node;
 	uint16_t peerno = 1;
@@ -269,11 +343,10 @@ static void bgp_dump_routes_index_table(struct bgp *bgp) {
 
 	bgp_dump_set_size(obuf, MSG_TABLE_DUMP_V2);
 
-	fwrite(STREAM_DATA(obuf), stream_get_endp(obuf), 1, bgp_dump_routes.fp);
-	fflush(bgp_dump_routes.fp);
+	bgp_dump_walk_put(walk, obuf);
 }
 
-static struct bgp_info *bgp_dump_route_node_record(int afi, struct bgp_node *rn, struct bgp_info *info, unsigned int seq) {
+static struct bgp_info *bgp_dump_route_node_record(struct bgp_dump_walk *walk, int afi, struct bgp_node *rn, struct bgp_info *info, unsigned int seq) {
 	struct stream *obuf;
 	size_t sizep;
 	size_t endp;
@@ -346,48 +419,102 @@ static struct bgp_info *bgp_dump_route_node_record(int afi, struct bgp_node *rn,
 	stream_putw_at(obuf, sizep, entry_count);
 
 	bgp_dump_set_size(obuf, MSG_TABLE_DUMP_V2);
-	fwrite(STREAM_DATA(obuf), stream_get_endp(obuf), 1, bgp_dump_routes.fp);
+	bgp_dump_walk_put(walk, obuf);
 
 	return info;
 }
 
-/* Runs under child process. */
-static unsigned int bgp_dump_routes_func(int afi, int first_run, unsigned int seq) {
-	struct bgp_info *info;
-	struct bgp_node *rn;
-	struct bgp *bgp;
-	struct bgp_table *table;
+/* Hand what is left to the writer, which closes the file after it */
+static void bgp_dump_walk_finish(struct bgp_dump *bgp_dump) {
+	struct bgp_dump_walk *walk = bgp_dump->walk;
 
-	bgp = bgp_get_default();
-	if(!bgp) {
-		return seq;
+	if(walk->t_walk) {
+		thread_cancel(walk->t_walk);
+		walk->t_walk = NULL;
 	}
-
-	if(bgp_dump_routes.fp == NULL) {
-		return seq;
+	if(walk->iter.table) {
+		bgp_table_iter_cleanup(&walk->iter);
 	}
 
-	/* Note that bgp_dump_routes_index_table will do ipv4 and ipv6 peers,
-     so this should only be done on the first call to bgp_dump_routes_func.
-     ( this function will be called once for ipv4 and once for ipv6 ) */
-	if(first_run) {
-		bgp_dump_routes_index_table(bgp);
-	}
+	walk->chunk->last = 1;
+	work_pool_submit(bgp_dump_writer, bgp_dump_chunk_write, bgp_dump_chunk_free, walk->chunk);
 
-	/* Walk down each BGP route. */
-	table = bgp->rib[afi][SAFI_UNICAST];
+	bgp_unlock(walk->bgp);
+	XFREE(MTYPE_BGP_DUMP, walk);
+	bgp_dump->walk = NULL;
+}
+
+/* Encode up to BGP_DUMP_ROUTES_BATCH nodes of the table, then pause the
+ * iterator so that the table may change before the walk goes on. */
+static int bgp_dump_routes_func(struct thread *t) {
+	struct bgp_dump *bgp_dump = THREAD_ARG(t);
+	struct bgp_dump_walk *walk = bgp_dump->walk;
+	struct bgp_info *info;
+	struct bgp_node *rn;
+	int count = 0;
+
+	walk->t_walk = NULL;
+
+	while(count < BGP_DUMP_ROUTES_BATCH) {
+		if(!walk->iter.table) {
+			bgp_table_iter_init(&walk->iter, walk->bgp->rib[walk->afi][SAFI_UNICAST]);
+		}
+
+		rn = bgp_table_iter_next(&walk->iter);
+		if(rn == NULL) {
+			bgp_table_iter_cleanup(&walk->iter);
+			if(walk->afi == AFI_IP) {
+				walk->afi = AFI_IP6;
+				continue;
+			}
+			bgp_dump_walk_finish(bgp_dump);
+			return 0;
+		}
 
-	for(rn = bgp_table_top(table); rn; rn = bgp_route_next(rn)) {
 		info = rn->info;
 		while(info) {
-			info = bgp_dump_route_node_record(afi, rn, info, seq);
-			seq++;
+			info = bgp_dump_route_node_record(walk, walk->afi, rn, info, walk->seq);
+			walk->seq++;
 		}
+		count++;
+	}
+
+	bgp_table_iter_pause(&walk->iter);
+	walk->t_walk = thread_add_background(bm->master, bgp_dump_routes_func, bgp_dump, 0);
+	return 0;
+}
+
+/* Start a RIB dump to the file just opened, which the walk takes over */
+static void bgp_dump_routes_start(struct bgp_dump *bgp_dump) {
+	struct bgp_dump_walk *walk;
+	struct bgp *bgp;
+
+	bgp = bgp_get_default();
+	if(!bgp) {
+		fclose(bgp_dump->fp);
+		bgp_dump->fp = NULL;
+		return;
 	}
 
-	fflush(bgp_dump_routes.fp);
+	/* Not done at bgp_dump_init() time, as the worker wouldn't survive
+	 * daemonizing. */
+	if(!bgp_dump_writer) {
+		bgp_dump_writer = work_pool_new(bm->master, "BGP dump writer", 1);
+	}
+
+	walk = XCALLOC(MTYPE_BGP_DUMP, sizeof(struct bgp_dump_walk));
+	walk->bgp = bgp;
+	bgp_lock(bgp);
+	walk->afi = AFI_IP;
+	walk->chunk = bgp_dump_chunk_new(bgp_dump->fp);
+	bgp_dump->fp = NULL;
+	bgp_dump->walk = walk;
 
-	return seq;
+	/* The index covers IPv4 and IPv6 peers alike.  Peers that come up
+	 * during the walk are dumped as the local one. */
+	bgp_dump_routes_index_table(walk);
+
+	walk->t_walk = thread_add_background(bm->master, bgp_dump_routes_func, bgp_dump, 0);
 }
 
 static int bgp_dump_interval_func(struct thread *t) {
@@ -395,16 +522,16 @@ static int bgp_dump_interval_func(struct thread *t) {
 	bgp_dump = THREAD_ARG(t);
 	bgp_dump->t_interval = NULL;
 
-	/* Reschedule dump even if file couldn't be opened this time... */
-	if(bgp_dump_open_file(bgp_dump) != NULL) {
-		/* In case of bgp_dump_routes, we need special route dump function. */
+	/* Reschedule dump even if file couldn't be opened this time, or a
+	 * RIB dump outlasted the interval and is let finish first... */
+	if(bgp_dump->walk) {
+		zlog_warn("bgp_dump_interval_func: previous RIB dump still running, skipping this one");
+	} else if(bgp_dump_open_file(bgp_dump) != NULL) {
+		/* In case of bgp_dump_routes, we need special route dump function.
+		 * The file is closed once the dump is written: for a RIB dump
+		 * there's no point in leaving it open until the next one. */
 		if(bgp_dump->type == BGP_DUMP_ROUTES) {
-			unsigned int seq = bgp_dump_routes_func(AFI_IP, 1, 0);
-			bgp_dump_routes_func(AFI_IP6, 0, seq);
-			/* Close the file now. For a RIB dump there's no point in leaving
-	   * it open until the next scheduled dump starts. */
-			fclose(bgp_dump->fp);
-			bgp_dump->fp = NULL;
+			bgp_dump_routes_start(bgp_dump);
 		}
 	}
 
@@ -625,7 +752,10 @@ static int bgp_dump_unset(struct vty *vty, struct bgp_dump *bgp_dump) {
 		bgp_dump->filename = NULL;
 	}
 
-	/* Closing file. */
+	/* Closing file, a RIB dump under way ends with what it has */
+	if(bgp_dump->walk) {
+		bgp_dump_walk_finish(bgp_dump);
+	}
 	if(bgp_dump->fp) {
 		fclose(bgp_dump->fp);
 		bgp_dump->fp = NULL;
@@ -761,7 +891,7 @@ void bgp_dump_init(void) {
 	memset(&bgp_dump_updates, 0, sizeof(struct bgp_dump));
 	memset(&bgp_dump_routes, 0, sizeof(struct bgp_dump));
 
-	bgp_dump_obuf = stream_new((BGP_MAX_PACKET_SIZE << 1) + BGP_DUMP_MSG_HEADER + BGP_DUMP_HEADER_SIZE);
+	bgp_dump_obuf = stream_new(BGP_EXTENDED_MESSAGE_MAX_PACKET_SIZE + BGP_DUMP_MSG_HEADER + BGP_DUMP_HEADER_SIZE);
 
 	install_node(&bgp_dump_node, config_write_bgp_dump);
 
@@ -770,6 +900,15 @@ void bgp_dump_init(void) {
 }
 
 void bgp_dump_finish(void) {
+	/* chunks still queued for the writer are lost with it */
+	if(bgp_dump_routes.walk) {
+		bgp_dump_walk_finish(&bgp_dump_routes);
+	}
+	if(bgp_dump_writer) {
+		work_pool_free(bgp_dump_writer);
+		bgp_dump_writer = NULL;
+	}
+
 	stream_free(bgp_dump_obuf);
 	bgp_dump_obuf = NULL;
 }
@@ -22,6 +22,7 @@ Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
 #include <zebra.h>
 
 #include "hash.h"
+#include "jhash.h"
 #include "memory.h"
 #include "prefix.h"
 #include "command.h"
@@ -30,6 +31,7 @@ Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
 #include "bgpd/bgpd.h"
 #include "bgpd/bgp_ecommunity.h"
 #include "bgpd/bgp_aspath.h"
+#include "bgpd/bgp_arena.h"
 
 /* Hash of community attribute. */
 static struct hash *ecomhash;
@@ -47,6 +49,9 @@ void ecommunity_free(struct ecommunity **ecom) {
 	if((*ecom)->str) {
 		XFREE(MTYPE_ECOMMUNITY_STR, (*ecom)->str);
 	}
+	if((*ecom)->rt) {
+		XFREE(MTYPE_ECOMMUNITY_VAL, (*ecom)->rt);
+	}
 	XFREE(MTYPE_ECOMMUNITY, *ecom);
 	ecom = NULL;
 }
@@ -112,26 +117,55 @@ struct ecommunity *ecommunity_uniq_sort(struct ecommunity *ecom) {
 	return new;
 }
 
+static int ecommunity_val_cmp(const void *v1, const void *v2) {
+	return memcmp(v1, v2, ECOMMUNITY_SIZE);
+}
+
+static void ecommunity_rt_make(struct ecommunity *);
+
+static void *ecommunity_parse_hash_alloc(void *p) {
+	struct ecommunity *new = ecommunity_dup(p);
+
+	ecommunity_rt_make(new);
+	return new;
+}
+
 /* Parse Extended Communites Attribute in BGP packet.  */
 struct ecommunity *ecommunity_parse(u_int8_t *pnt, u_short length) {
 	struct ecommunity tmp;
-	struct ecommunity *new;
+	struct ecommunity *find;
+	int i;
 
 	/* Length check.  */
 	if(length % ECOMMUNITY_SIZE) {
 		return NULL;
 	}
 
-	/* Prepare tmporary structure for making a new Extended Communities
-     Attribute.  */
-	tmp.size = length / ECOMMUNITY_SIZE;
-	tmp.val = pnt;
+	/* Prepare tmporary structure for looking up the Extended Communities
+     Attribute, uniq and sorted as ecommunity_uniq_sort() would, in the
+     UPDATE's arena: only one not seen before is copied to the heap.  */
+	memset(&tmp, 0, sizeof(struct ecommunity));
+	if(length) {
+		tmp.val = bgp_arena_alloc(length);
+		memcpy(tmp.val, pnt, length);
+		qsort(tmp.val, length / ECOMMUNITY_SIZE, ECOMMUNITY_SIZE, ecommunity_val_cmp);
+		for(i = 0; i < length / ECOMMUNITY_SIZE; i++) {
+			if(tmp.size && memcmp(tmp.val + (tmp.size - 1) * ECOMMUNITY_SIZE, tmp.val + i * ECOMMUNITY_SIZE, ECOMMUNITY_SIZE) == 0) {
+				continue;
+			}
+			memmove(tmp.val + tmp.size * ECOMMUNITY_SIZE, tmp.val + i * ECOMMUNITY_SIZE, ECOMMUNITY_SIZE);
+			tmp.size++;
+		}
+	}
 
-	/* Create a new Extended Communities Attribute by uniq and sort each
-     Extended Communities value  */
-	new = ecommunity_uniq_sort(&tmp);
+	find = (struct ecommunity *) hash_get(ecomhash, &tmp, ecommunity_parse_hash_alloc);
+	find->refcnt++;
+
+	if(!find->str) {
+		find->str = ecommunity_ecom2str(find, ECOMMUNITY_FORMAT_DISPLAY);
+	}
 
-	return ecommunity_intern(new);
+	return find;
 }
 
 /* Duplicate the Extended Communities Attribute structure.  */
@@ -171,6 +205,36 @@ struct ecommunity *ecommunity_merge(struct ecommunity *ecom1, struct ecommunity
 	return ecom1;
 }
 
+/* An Extended Communities value as a number, in network byte order, so
+   that numbers sort as the values do.  */
+u_int64_t ecommunity_val2u64(const u_int8_t *pnt) {
+	u_int32_t hi, lo;
+
+	memcpy(&hi, pnt, 4);
+	memcpy(&lo, pnt + 4, 4);
+	return ((u_int64_t) ntohl(hi) << 32) | ntohl(lo);
+}
+
+/* Pick the route targets out of the sorted values, once, so that
+   matching them against a set of route targets need not parse the
+   values again for each route.  */
+static void ecommunity_rt_make(struct ecommunity *ecom) {
+	u_int8_t *pnt;
+	int i;
+
+	ecom->rt_size = 0;
+	for(i = 0; i < ecom->size; i++) {
+		pnt = ecom->val + i * ECOMMUNITY_SIZE;
+		if(!ECOMMUNITY_IS_RT(pnt)) {
+			continue;
+		}
+		if(!ecom->rt) {
+			ecom->rt = XMALLOC(MTYPE_ECOMMUNITY_VAL, (ecom->size - i) * sizeof(u_int64_t));
+		}
+		ecom->rt[ecom->rt_size++] = ecommunity_val2u64(pnt);
+	}
+}
+
 /* Intern Extended Communities Attribute.  */
 struct ecommunity *ecommunity_intern(struct ecommunity *ecom) {
 	struct ecommunity *find;
@@ -181,6 +245,8 @@ struct ecommunity *ecommunity_intern(struct ecommunity *ecom) {
 
 	if(find != ecom) {
 		ecommunity_free(&ecom);
+	} else {
+		ecommunity_rt_make(find);
 	}
 
 	find->refcnt++;
@@ -213,23 +279,8 @@ void ecommunity_unintern(struct ecommunity **ecom) {
 /* Utinity function to make hash key.  */
 unsigned int ecommunity_hash_make(void *arg) {
 	const struct ecommunity *ecom = arg;
-	int size = ecom->size * ECOMMUNITY_SIZE;
-	u_int8_t *pnt = ecom->val;
-	unsigned int key = 0;
-	int c;
-
-	for(c = 0; c < size; c += ECOMMUNITY_SIZE) {
-		key += pnt[c];
-		key += pnt[c + 1];
-		key += pnt[c + 2];
-		key += pnt[c + 3];
-		key += pnt[c + 4];
-		key += pnt[c + 5];
-		key += pnt[c + 6];
-		key += pnt[c + 7];
-	}
 
-	return key;
+	return jhash(ecom->val, ecom->size * ECOMMUNITY_SIZE, 0x3c0e9b1d);
 }
 
 /* Compare two Extended Communities Attribute structure.  */
@@ -683,7 +734,7 @@ int ecommunity_match(const struct ecommunity *ecom1, const struct ecommunity *ec
 
 	/* Every community on com2 needs to be on com1 for this to match */
 	while(i < ecom1->size && j < ecom2->size) {
-		if(memcmp(ecom1->val + i, ecom2->val + j, ECOMMUNITY_SIZE) == 0) {
+		if(memcmp(ecom1->val + (i * ECOMMUNITY_SIZE), ecom2->val + (j * ECOMMUNITY_SIZE), ECOMMUNITY_SIZE) == 0) {
 			j++;
 		}
 		i++;
@@ -59,6 +59,11 @@ struct ecommunity {
 
 	/* Human readable format string.  */
 	char *str;
+
+	/* Route targets among the values, as 64 bit numbers in the same
+	   (ascending) order, set when interned.  */
+	u_int64_t *rt;
+	int rt_size;
 };
 
 /* Extended community value is eight octet.  */
@@ -68,6 +73,9 @@ struct ecommunity_val {
 
 #define ecom_length(X) ((X)->size * ECOMMUNITY_SIZE)
 
+/* Route target of any encoding.  */
+#define ECOMMUNITY_IS_RT(P) ((P)[0] <= ECOMMUNITY_ENCODE_AS4 && (P)[1] == ECOMMUNITY_ROUTE_TARGET)
+
 extern void ecommunity_init(void);
 extern void ecommunity_finish(void);
 extern void ecommunity_free(struct ecommunity **);
@@ -83,5 +91,6 @@ extern struct ecommunity *ecommunity_str2com(const char *, int, int);
 extern char *ecommunity_ecom2str(struct ecommunity *, int);
 extern int ecommunity_match(const struct ecommunity *, const struct ecommunity *);
 extern char *ecommunity_str(struct ecommunity *);
+extern u_int64_t ecommunity_val2u64(const u_int8_t *);
 
 #endif /* _QUAGGA_BGP_ECOMMUNITY_H */
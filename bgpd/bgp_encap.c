@@ -204,9 +204,9 @@ int bgp_nlri_parse_encap(
 		}
 
 		if(attr) {
-			bgp_update(peer, &p, attr, afi, SAFI_ENCAP, ZEBRA_ROUTE_BGP, BGP_ROUTE_NORMAL, &prd, NULL, 0);
+			bgp_update(peer, &p, 0, attr, afi, SAFI_ENCAP, ZEBRA_ROUTE_BGP, BGP_ROUTE_NORMAL, &prd, NULL, 0);
 		} else {
-			bgp_withdraw(peer, &p, attr, afi, SAFI_ENCAP, ZEBRA_ROUTE_BGP, BGP_ROUTE_NORMAL, &prd, NULL);
+			bgp_withdraw(peer, &p, 0, attr, afi, SAFI_ENCAP, ZEBRA_ROUTE_BGP, BGP_ROUTE_NORMAL, &prd, NULL);
 		}
 	}
 
@@ -258,11 +258,7 @@ static int show_adj_route_encap(struct vty *vty, struct peer *peer, struct prefi
 		return CMD_WARNING;
 	}
 
-	for(rn = bgp_table_top(bgp->rib[AFI_IP][SAFI_ENCAP]); rn; rn = bgp_route_next(rn)) {
-		if(prd && memcmp(rn->p.u.val, prd->val, 8) != 0) {
-			continue;
-		}
-
+	for(rn = bgp_rd_top(bgp->rib[AFI_IP][SAFI_ENCAP], prd); rn; rn = bgp_rd_next(rn, prd)) {
 		if((table = rn->info) != NULL) {
 			rd_header = 1;
 
@@ -354,11 +350,7 @@ static int bgp_show_encap(struct vty *vty, afi_t afi, struct prefix_rd *prd, enu
 		return CMD_WARNING;
 	}
 
-	for(rn = bgp_table_top(bgp->rib[afi][SAFI_ENCAP]); rn; rn = bgp_route_next(rn)) {
-		if(prd && memcmp(rn->p.u.val, prd->val, 8) != 0) {
-			continue;
-		}
-
+	for(rn = bgp_rd_top(bgp->rib[afi][SAFI_ENCAP], prd); rn; rn = bgp_rd_next(rn, prd)) {
 		if((table = rn->info) != NULL) {
 			rd_header = 1;
 
@@ -60,7 +60,7 @@ struct as_filter {
 
 	enum as_filter_type type;
 
-	regex_t *reg;
+	struct bgp_aspath_regex *reg;
 	char *reg_str;
 };
 
@@ -93,7 +93,7 @@ static struct as_filter *as_filter_new(void) {
 /* Free allocated AS filter. */
 static void as_filter_free(struct as_filter *asfilter) {
 	if(asfilter->reg) {
-		bgp_regex_free(asfilter->reg);
+		bgp_aspath_regex_free(asfilter->reg);
 	}
 	if(asfilter->reg_str) {
 		XFREE(MTYPE_AS_FILTER_STR, asfilter->reg_str);
@@ -102,7 +102,7 @@ static void as_filter_free(struct as_filter *asfilter) {
 }
 
 /* Make new AS filter. */
-static struct as_filter *as_filter_make(regex_t *reg, const char *reg_str, enum as_filter_type type) {
+static struct as_filter *as_filter_make(struct bgp_aspath_regex *reg, const char *reg_str, enum as_filter_type type) {
 	struct as_filter *asfilter;
 
 	asfilter = as_filter_new();
@@ -344,7 +344,7 @@ static void as_list_filter_delete(struct as_list *aslist, struct as_filter *asfi
 }
 
 static int as_filter_match(struct as_filter *asfilter, struct aspath *aspath) {
-	if(bgp_regexec(asfilter->reg, aspath) != REG_NOMATCH) {
+	if(bgp_aspath_regexec(asfilter->reg, aspath) != REG_NOMATCH) {
 		return 1;
 	}
 	return 0;
@@ -400,7 +400,7 @@ DEFUN(ip_as_path, ip_as_path_cmd, "ip as-path access-list WORD (deny|permit) .LI
 	enum as_filter_type type;
 	struct as_filter *asfilter;
 	struct as_list *aslist;
-	regex_t *regex;
+	struct bgp_aspath_regex *regex;
 	char *regstr;
 
 	/* Check the filter type. */
@@ -416,7 +416,7 @@ DEFUN(ip_as_path, ip_as_path_cmd, "ip as-path access-list WORD (deny|permit) .LI
 	/* Check AS path regex. */
 	regstr = argv_concat(argv, argc, 2);
 
-	regex = bgp_regcomp(regstr);
+	regex = bgp_aspath_regcomp(regstr);
 	if(!regex) {
 		XFREE(MTYPE_TMP, regstr);
 		vty_out(vty, "can't compile regexp %s%s", argv[0], VTY_NEWLINE);
@@ -451,7 +451,7 @@ DEFUN(no_ip_as_path, no_ip_as_path_cmd, "no ip as-path access-list WORD (deny|pe
 	struct as_filter *asfilter;
 	struct as_list *aslist;
 	char *regstr;
-	regex_t *regex;
+	struct bgp_aspath_regex *regex;
 
 	/* Lookup AS list from AS path list. */
 	aslist = as_list_lookup(argv[0]);
@@ -473,7 +473,7 @@ DEFUN(no_ip_as_path, no_ip_as_path_cmd, "no ip as-path access-list WORD (deny|pe
 	/* Compile AS path. */
 	regstr = argv_concat(argv, argc, 2);
 
-	regex = bgp_regcomp(regstr);
+	regex = bgp_aspath_regcomp(regstr);
 	if(!regex) {
 		XFREE(MTYPE_TMP, regstr);
 		vty_out(vty, "can't compile regexp %s%s", argv[0], VTY_NEWLINE);
@@ -484,7 +484,7 @@ DEFUN(no_ip_as_path, no_ip_as_path_cmd, "no ip as-path access-list WORD (deny|pe
 	asfilter = as_filter_lookup(aslist, regstr, type);
 
 	XFREE(MTYPE_TMP, regstr);
-	bgp_regex_free(regex);
+	bgp_aspath_regex_free(regex);
 
 	if(asfilter == NULL) {
 		vty_out(vty, "%s", VTY_NEWLINE);
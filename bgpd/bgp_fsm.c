@@ -42,8 +42,13 @@ Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
 #include "bgpd/bgp_network.h"
 #include "bgpd/bgp_route.h"
 #include "bgpd/bgp_dump.h"
+#include "bgpd/bgp_bmp.h"
 #include "bgpd/bgp_open.h"
 #include "bgpd/bgp_nht.h"
+#include "bgpd/bgp_bfd.h"
+#include "bgpd/bgp_updgrp.h"
+#include "bgpd/bgp_io.h"
+#include "bgpd/bgp_rtc.h"
 #ifdef HAVE_SNMP
 	#include "bgpd/bgp_snmp.h"
 #endif /* HAVE_SNMP */
@@ -84,7 +89,7 @@ void bgp_timer_set(struct peer *peer) {
 			/* First entry point of peer's finite state machine.  In Idle
 	 status start timer is on unless peer is shutdown or peer is
 	 inactive.  All other timer must be turned off */
-			if(BGP_PEER_START_SUPPRESSED(peer) || !peer_active(peer)) {
+			if(BGP_PEER_START_SUPPRESSED(peer) || !peer_active(peer) || bm->start_hold) {
 				BGP_TIMER_OFF(peer->t_start);
 			} else {
 				jitter = bgp_start_jitter(peer->v_start);
@@ -181,6 +186,28 @@ void bgp_timer_set(struct peer *peer) {
 	}
 }
 
+/* Start the sessions held back while the startup configuration was
+   read, BGP_START_WAVE of them a second, so they don't all connect and
+   send their tables at once. */
+void bgp_fsm_startup(void) {
+	struct listnode *node, *nnode, *pnode, *pnnode;
+	struct bgp *bgp;
+	struct peer *peer;
+	unsigned int n = 0;
+
+	bm->start_hold = 0;
+
+	for(ALL_LIST_ELEMENTS(bm->bgp, node, nnode, bgp)) {
+		for(ALL_LIST_ELEMENTS(bgp->peer, pnode, pnnode, peer)) {
+			if(peer->status != Idle || BGP_PEER_START_SUPPRESSED(peer) || !peer_active(peer)) {
+				continue;
+			}
+			BGP_TIMER_OFF(peer->t_start);
+			BGP_TIMER_ON(peer->t_start, bgp_start_timer, peer->v_start + n++ / BGP_START_WAVE);
+		}
+	}
+}
+
 /* BGP start timer.  This function set BGP_Start event to thread value
    and process event. */
 static int bgp_start_timer(struct thread *thread) {
@@ -223,6 +250,12 @@ static int bgp_holdtime_timer(struct thread *thread) {
 	peer = THREAD_ARG(thread);
 	peer->t_holdtime = NULL;
 
+	/* Not if the I/O thread has read packets we haven't got to yet */
+	if(peer->io && bgp_io_rx_peek(peer->io)) {
+		BGP_TIMER_ON(peer->t_holdtime, bgp_holdtime_timer, 1);
+		return 0;
+	}
+
 	if(BGP_DEBUG(fsm, FSM)) {
 		zlog(peer->log, LOG_DEBUG, "%s [FSM] Timer (holdtime timer expire)", peer->host);
 	}
@@ -292,7 +325,8 @@ const char *peer_down_str[] = { "",
 				"Capability changed",
 				"Passive config change",
 				"Multihop config change",
-				"NSF peer closed the session" };
+				"NSF peer closed the session",
+				"BFD down received" };
 
 static int bgp_graceful_restart_timer_expire(struct thread *thread) {
 	struct peer *peer;
@@ -348,11 +382,31 @@ static int bgp_graceful_stale_timer_expire(struct thread *thread) {
 	return 0;
 }
 
+/* Hold the paths of peer read back from the snapshot as if it had gone
+   down under graceful restart just now: stale, for it to come back and
+   refresh them within the restart time. */
+void bgp_graceful_restart_hold(struct peer *peer) {
+	SET_FLAG(peer->sflags, PEER_STATUS_NSF_WAIT | PEER_STATUS_SNAPSHOT);
+
+	if(BGP_DEBUG(events, EVENTS)) {
+		zlog_debug("%s graceful restart timer started for %d sec", peer->host, peer->bgp->restart_time);
+		zlog_debug("%s graceful restart stalepath timer started for %d sec", peer->host, peer->bgp->stalepath_time);
+	}
+	BGP_TIMER_ON(peer->t_gr_restart, bgp_graceful_restart_timer_expire, peer->bgp->restart_time);
+	BGP_TIMER_ON(peer->t_gr_stale, bgp_graceful_stale_timer_expire, peer->bgp->stalepath_time);
+}
+
 /* Called after event occurred, this function change status and reset
    read/write and timer thread. */
 void bgp_fsm_change_status(struct peer *peer, int status) {
 	bgp_dump_state(peer, peer->status, status);
 
+	if(status == Established && peer->status != Established) {
+		bgp_bmp_peer_up(peer);
+	} else if(peer->status == Established && status != Established) {
+		bgp_bmp_peer_down(peer);
+	}
+
 	/* Transition into Clearing or Deleted must /always/ clear all routes..
    * (and must do so before actually changing into Deleted..
    */
@@ -405,6 +459,9 @@ int bgp_stop(struct peer *peer) {
 		BGP_EVENT_FLUSH(peer);
 	}
 
+	/* Only Established peers are grouped */
+	bgp_updgrp_peer_leave_all(peer);
+
 	/* Increment Dropped count. */
 	if(peer->status == Established) {
 		peer->dropped++;
@@ -414,6 +471,8 @@ int bgp_stop(struct peer *peer) {
 			zlog_info("%%ADJCHANGE: neighbor %s Down %s", peer->host, peer_down_str[(int) peer->last_reset]);
 		}
 
+		bgp_bfd_deregister(peer);
+
 		/* graceful restart */
 		if(peer->t_gr_stale) {
 			BGP_TIMER_OFF(peer->t_gr_stale);
@@ -449,10 +508,15 @@ int bgp_stop(struct peer *peer) {
 		peer->synctime = 0;
 	}
 
-	/* Stop read and write threads when exists. */
+	/* Take the socket back from the I/O thread, and stop read and write
+	 * threads when exists. */
+	bgp_io_stop(peer);
 	BGP_READ_OFF(peer->t_read);
 	BGP_WRITE_OFF(peer->t_write);
 
+	/* Nothing more to announce */
+	bgp_announce_walk_stop_all(peer);
+
 	/* Stop all timers. */
 	BGP_TIMER_OFF(peer->t_start);
 	BGP_TIMER_OFF(peer->t_connect);
@@ -463,6 +527,9 @@ int bgp_stop(struct peer *peer) {
 	/* Stream reset. */
 	peer->packet_size = 0;
 
+	/* The next session sends its table anew */
+	UNSET_FLAG(peer->sflags, PEER_STATUS_IMPLICIT_EOR);
+
 	/* Clear input and output buffer.  */
 	if(peer->ibuf) {
 		stream_reset(peer->ibuf);
@@ -502,6 +569,9 @@ int bgp_stop(struct peer *peer) {
 		}
 	}
 
+	/* Received RT memberships */
+	bgp_rtc_reset(peer);
+
 	/* Reset keepalive and holdtime */
 	if(CHECK_FLAG(peer->config, PEER_CONFIG_TIMER)) {
 		peer->v_keepalive = peer->keepalive;
@@ -669,6 +739,7 @@ int bgp_start(struct peer *peer) {
 
 	/* Clear peer capability flag. */
 	peer->cap = 0;
+	peer->max_packet_size = BGP_MAX_PACKET_SIZE;
 
 	/* If the peer is passive mode, force to move to Active mode. */
 	if(CHECK_FLAG(peer->flags, PEER_FLAG_PASSIVE)) {
@@ -762,6 +833,7 @@ static int bgp_establish(struct peer *peer) {
 	afi_t afi;
 	safi_t safi;
 	int nsf_af_count = 0;
+	int preloaded;
 
 	/* Reset capability open status flag. */
 	if(!CHECK_FLAG(peer->sflags, PEER_STATUS_CAPABILITY_OPEN)) {
@@ -787,12 +859,17 @@ static int bgp_establish(struct peer *peer) {
 		zlog_info("%%ADJCHANGE: neighbor %s Up", peer->host);
 	}
 
-	/* graceful restart */
+	bgp_bfd_register(peer);
+
+	/* graceful restart.  Paths from the snapshot are kept for a peer that
+	   did not restart itself, whether or not it says it kept forwarding:
+	   it has no reason to have stopped. */
 	UNSET_FLAG(peer->sflags, PEER_STATUS_NSF_WAIT);
+	preloaded = CHECK_FLAG(peer->sflags, PEER_STATUS_SNAPSHOT) && !CHECK_FLAG(peer->cap, PEER_CAP_RESTART_BIT_RCV);
 	for(afi = AFI_IP; afi < AFI_MAX; afi++) {
 		for(safi = SAFI_UNICAST; safi < SAFI_RESERVED_3; safi++) {
 			if(peer->afc_nego[afi][safi] && CHECK_FLAG(peer->cap, PEER_CAP_RESTART_ADV) && CHECK_FLAG(peer->af_cap[afi][safi], PEER_CAP_RESTART_AF_RCV)) {
-				if(peer->nsf[afi][safi] && !CHECK_FLAG(peer->af_cap[afi][safi], PEER_CAP_RESTART_AF_PRESERVE_RCV)) {
+				if(peer->nsf[afi][safi] && !CHECK_FLAG(peer->af_cap[afi][safi], PEER_CAP_RESTART_AF_PRESERVE_RCV) && !preloaded) {
 					bgp_clear_stale_route(peer, afi, safi);
 				}
 
@@ -846,10 +923,23 @@ static int bgp_establish(struct peer *peer) {
 		}
 	}
 
+	/* Extended messages, RFC 8654, once both sides said so.  A session
+	 * without keeps no bigger buffers from an earlier one. */
+	if(CHECK_FLAG(peer->cap, PEER_CAP_EXTENDED_MSG_ADV) && CHECK_FLAG(peer->cap, PEER_CAP_EXTENDED_MSG_RCV)) {
+		bgp_packet_size_set(peer, BGP_EXTENDED_MESSAGE_MAX_PACKET_SIZE);
+	} else {
+		bgp_packet_size_set(peer, BGP_MAX_PACKET_SIZE);
+	}
+
 	if(peer->v_keepalive) {
 		bgp_keepalive_send(peer);
 	}
 
+	/* VPN routes go out as the peer asks for them, and we ask for all */
+	if(BGP_RTC_NEGOTIATED(peer)) {
+		bgp_rtc_default_send(peer);
+	}
+
 	/* First update is deferred until ORF or ROUTE-REFRESH is received */
 	for(afi = AFI_IP; afi < AFI_MAX; afi++) {
 		for(safi = SAFI_UNICAST; safi < SAFI_MAX; safi++) {
@@ -865,6 +955,9 @@ static int bgp_establish(struct peer *peer) {
 
 	BGP_TIMER_ON(peer->t_routeadv, bgp_routeadv_timer, 1);
 
+	/* Packet I/O moves to an I/O thread, if there are any */
+	bgp_io_start(peer);
+
 	return 0;
 }
 
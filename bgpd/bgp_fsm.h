@@ -69,7 +69,9 @@ Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
 extern int bgp_event(struct thread *);
 extern int bgp_stop(struct peer *peer);
 extern void bgp_timer_set(struct peer *);
+extern void bgp_fsm_startup(void);
 extern void bgp_fsm_change_status(struct peer *peer, int status);
+extern void bgp_graceful_restart_hold(struct peer *);
 extern const char *peer_down_str[];
 
 #endif /* _QUAGGA_BGP_FSM_H */
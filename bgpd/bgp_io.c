@@ -0,0 +1,856 @@
+/* BGP packet I/O threads
+ *
+ * This file is part of Quagga
+ *
+ * Quagga is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2, or (at your option) any
+ * later version.
+ *
+ * Quagga is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Quagga; see the file COPYING.  If not, write to the Free
+ * Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ * 02111-1307, USA.
+ */
+
+#include <zebra.h>
+
+#include <poll.h>
+#ifdef HAVE_PTHREAD
+	#define BGP_IO_THREADED
+	#include <pthread.h>
+#endif
+#ifdef HAVE_SYS_EVENTFD_H
+	#include <sys/eventfd.h>
+#endif
+
+#include "thread.h"
+#include "stream.h"
+#include "memory.h"
+#include "command.h"
+#include "log.h"
+#include "network.h"
+#include "prefix.h"
+#include "filter.h"
+#include "placement.h"
+
+#include "bgpd/bgpd.h"
+#include "bgpd/bgp_attr.h"
+#include "bgpd/bgp_fsm.h"
+#include "bgpd/bgp_packet.h"
+#include "bgpd/bgp_io.h"
+
+/* Peers served by a thread.  Replaced, never modified, so that the I/O
+ * thread can go on using the one it has without holding the lock. */
+struct bgp_io_set {
+	unsigned int count;
+	struct bgp_io_peer **peers;
+	struct pollfd *pfds; /* count + 1, the last for the kick fd */
+};
+
+struct bgp_io_thread {
+	unsigned int id;
+
+	/* The set the I/O thread polls, and the one the main thread last
+	 * asked it to switch to; gen/ack_gen say whether it has. */
+	struct bgp_io_set *cur;
+	struct bgp_io_set *next;
+	unsigned int gen;
+	unsigned int ack_gen;
+	int shutdown;
+
+	/* main thread -> I/O thread, and I/O thread -> main thread */
+	int kick[2];
+	int kicked;
+	int wakeup[2];
+	struct thread *t_wakeup;
+
+	/* stats, written by the I/O thread */
+	unsigned long loops;
+	unsigned long packets_in;
+	unsigned long writes;
+	unsigned long keepalives;
+
+#ifdef BGP_IO_THREADED
+	pthread_t pthread;
+	pthread_mutex_t mtx;
+	pthread_cond_t cond;
+#endif
+};
+
+static struct bgp_io_thread **io_threads;
+static unsigned int io_thread_count;
+static unsigned int io_threads_wanted;
+
+static void bgp_io_threads_start(void);
+
+/* A KEEPALIVE is just the header */
+static const u_char bgp_io_keepalive_packet[BGP_HEADER_SIZE] = {
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0x00, BGP_HEADER_SIZE, BGP_MSG_KEEPALIVE,
+};
+
+static void bgp_io_fd_write(int fd) {
+	uint64_t one = 1;
+	ssize_t ret;
+
+	do {
+		ret = write(fd, &one, sizeof(one));
+	} while(ret < 0 && errno == EINTR);
+}
+
+static void bgp_io_fd_drain(int fd) {
+	uint64_t buf[16];
+
+	while(read(fd, buf, sizeof(buf)) > 0) {
+		;
+	}
+}
+
+static int bgp_io_fd_open(int fds[2]) {
+#ifdef HAVE_SYS_EVENTFD_H
+	fds[0] = fds[1] = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	return fds[0];
+#else
+	if(pipe(fds) < 0) {
+		return -1;
+	}
+	set_nonblocking(fds[0]);
+	set_nonblocking(fds[1]);
+	return 0;
+#endif
+}
+
+static void bgp_io_fd_close(int fds[2]) {
+	close(fds[0]);
+	if(fds[1] != fds[0]) {
+		close(fds[1]);
+	}
+}
+
+/* The I/O threads' own clock; bgp_clock() isn't safe to call from them */
+static time_t bgp_io_clock(void) {
+#ifdef CLOCK_MONOTONIC
+	struct timespec ts;
+
+	if(clock_gettime(CLOCK_MONOTONIC, &ts) == 0) {
+		return ts.tv_sec;
+	}
+#endif
+	return time(NULL);
+}
+
+#ifdef BGP_IO_THREADED
+
+static int bgp_io_decode_prefixes(struct bgp_io_peer *io, struct bgp_io_slot *slot, u_char *pnt, u_char *lim, unsigned int *count) {
+	struct prefix_ipv4 *p;
+	u_char prefixlen;
+
+	while(pnt < lim) {
+		prefixlen = *pnt++;
+		if(prefixlen > IPV4_MAX_BITLEN || pnt + PSIZE(prefixlen) > lim || *count == io->prefix_max) {
+			return 0;
+		}
+
+		p = &slot->prefix[(*count)++];
+		p->family = AF_INET;
+		p->prefixlen = prefixlen;
+		p->prefix.s_addr = 0;
+		memcpy(&p->prefix, pnt, PSIZE(prefixlen));
+		pnt += PSIZE(prefixlen);
+	}
+	return 1;
+}
+
+/* Decode the IPv4 withdrawn routes and NLRI of an UPDATE.  Anything
+ * malformed is left to the main thread, to complain about. */
+static void bgp_io_decode_update(struct bgp_io_peer *io, struct bgp_io_slot *slot) {
+	u_char *pnt = slot->data + BGP_HEADER_SIZE;
+	u_char *end = slot->data + slot->len;
+	unsigned int count = 0;
+	bgp_size_t len;
+
+	slot->decoded = 0;
+	if(slot->data[BGP_MARKER_SIZE + 2] != BGP_MSG_UPDATE) {
+		return;
+	}
+
+	/* Withdrawn routes */
+	if(pnt + 2 > end) {
+		return;
+	}
+	len = (pnt[0] << 8) | pnt[1];
+	pnt += 2;
+	if(pnt + len > end || !bgp_io_decode_prefixes(io, slot, pnt, pnt + len, &count)) {
+		return;
+	}
+	slot->withdrawn = count;
+	pnt += len;
+
+	/* Path attributes, skipped */
+	if(pnt + 2 > end) {
+		return;
+	}
+	len = (pnt[0] << 8) | pnt[1];
+	pnt += 2;
+	if(pnt + len > end) {
+		return;
+	}
+	pnt += len;
+
+	/* NLRI */
+	if(!bgp_io_decode_prefixes(io, slot, pnt, end, &count)) {
+		return;
+	}
+	slot->nlri = count - slot->withdrawn;
+	slot->decoded = 1;
+}
+
+/* Read whole packets into free slots, until the socket or the ring runs
+ * dry.  Returns 1 if there's something new for the main thread. */
+static int bgp_io_read(struct bgp_io_peer *io) {
+	struct bgp_io_slot *slot;
+	size_t want, size;
+	ssize_t nbytes;
+	int news = 0;
+
+	while(io->rx_head - __atomic_load_n(&io->rx_tail, __ATOMIC_ACQUIRE) < io->rx_slots) {
+		slot = &io->rx[io->rx_head % io->rx_slots];
+
+		size = BGP_HEADER_SIZE;
+		if(io->rx_fill >= BGP_HEADER_SIZE) {
+			size = (slot->data[BGP_MARKER_SIZE] << 8) | slot->data[BGP_MARKER_SIZE + 1];
+		}
+		want = size - io->rx_fill;
+
+		if(want) {
+			nbytes = read(io->fd, slot->data + io->rx_fill, want);
+			if(nbytes < 0) {
+				if(ERRNO_IO_RETRY(errno)) {
+					break;
+				}
+				io->error_errno = errno;
+				__atomic_store_n(&io->error, BGP_IO_ERROR, __ATOMIC_RELEASE);
+				io->dead = 1;
+				return 1;
+			}
+			if(nbytes == 0) {
+				__atomic_store_n(&io->error, BGP_IO_CLOSED, __ATOMIC_RELEASE);
+				io->dead = 1;
+				return 1;
+			}
+			io->rx_fill += nbytes;
+			if(io->rx_fill < size) {
+				continue;
+			}
+		}
+
+		if(size == BGP_HEADER_SIZE && io->rx_fill == BGP_HEADER_SIZE) {
+			size = (slot->data[BGP_MARKER_SIZE] << 8) | slot->data[BGP_MARKER_SIZE + 1];
+
+			/* Can't frame past a bad length.  Pass the header on by
+			 * itself for the main thread to reject, and stop. */
+			if(size < BGP_HEADER_SIZE || size > io->max_packet_size) {
+				slot->len = BGP_HEADER_SIZE;
+				slot->decoded = 0;
+				__atomic_store_n(&io->rx_head, io->rx_head + 1, __ATOMIC_RELEASE);
+				io->dead = 1;
+				return 1;
+			}
+			if(size > BGP_HEADER_SIZE) {
+				continue;
+			}
+		}
+
+		slot->len = size;
+		io->rx_fill = 0;
+		bgp_io_decode_update(io, slot);
+		__atomic_store_n(&io->rx_head, io->rx_head + 1, __ATOMIC_RELEASE);
+		io->thread->packets_in++;
+		news = 1;
+	}
+
+	return news;
+}
+
+/* Is the byte stream in the middle of a packet? */
+static int bgp_io_midpacket(struct bgp_io_peer *io) {
+	if(io->ka_off > 0) {
+		return 1;
+	}
+	return io->tx_sent != __atomic_load_n(&io->tx_head, __ATOMIC_ACQUIRE) && io->tx[io->tx_sent % BGP_IO_TX_SLOTS].off > 0;
+}
+
+static int bgp_io_tx_pending(struct bgp_io_peer *io) {
+	return io->ka_off >= 0 || io->tx_sent != __atomic_load_n(&io->tx_head, __ATOMIC_ACQUIRE);
+}
+
+#define BGP_IO_IOV_MAX 16
+
+/* Write out a pending KEEPALIVE, then as many queued streams as the
+ * socket takes.  Returns 1 if there's something new for the main
+ * thread. */
+static int bgp_io_write(struct bgp_io_peer *io, time_t now) {
+	struct iovec iov[BGP_IO_IOV_MAX];
+	unsigned int head, i, n;
+	struct stream *s;
+	ssize_t nbytes;
+	int news = 0;
+
+	while(!io->dead) {
+		if(io->ka_off >= 0) {
+			nbytes = write(io->fd, bgp_io_keepalive_packet + io->ka_off, BGP_HEADER_SIZE - io->ka_off);
+			if(nbytes > 0) {
+				io->ka_off += nbytes;
+				io->last_write = now;
+				if(io->ka_off == BGP_HEADER_SIZE) {
+					io->ka_off = -1;
+					__atomic_store_n(&io->keepalives, io->keepalives + 1, __ATOMIC_RELAXED);
+					io->thread->keepalives++;
+				}
+				continue;
+			}
+		} else {
+			head = __atomic_load_n(&io->tx_head, __ATOMIC_ACQUIRE);
+			for(n = 0; n < BGP_IO_IOV_MAX && io->tx_sent + n != head; n++) {
+				struct bgp_io_tx *tx = &io->tx[(io->tx_sent + n) % BGP_IO_TX_SLOTS];
+
+				iov[n].iov_base = STREAM_DATA(tx->s) + tx->off;
+				iov[n].iov_len = stream_get_endp(tx->s) - tx->off;
+			}
+			if(n == 0) {
+				break;
+			}
+
+			nbytes = writev(io->fd, iov, n);
+			if(nbytes > 0) {
+				io->last_write = now;
+				io->thread->writes++;
+				for(i = 0; i < n && nbytes > 0; i++) {
+					struct bgp_io_tx *tx = &io->tx[io->tx_sent % BGP_IO_TX_SLOTS];
+
+					s = tx->s;
+					if((size_t) nbytes < stream_get_endp(s) - tx->off) {
+						tx->off += nbytes;
+						break;
+					}
+					nbytes -= stream_get_endp(s) - tx->off;
+					__atomic_store_n(&io->tx_sent, io->tx_sent + 1, __ATOMIC_RELEASE);
+					news = 1;
+				}
+				continue;
+			}
+		}
+
+		if(nbytes < 0 && !ERRNO_IO_RETRY(errno)) {
+			io->error_errno = errno;
+			__atomic_store_n(&io->error, BGP_IO_ERROR, __ATOMIC_RELEASE);
+			io->dead = 1;
+			return 1;
+		}
+		break;
+	}
+
+	return news;
+}
+
+static void *bgp_io_thread_main(void *arg) {
+	struct bgp_io_thread *t = arg;
+	struct bgp_io_set *set;
+	struct bgp_io_peer *io;
+	unsigned int i;
+	int timeout, wake, news;
+	time_t now, due;
+	char name[32];
+
+	snprintf(name, sizeof(name), "BGP I/O %u", t->id);
+	thread_placement_enter(THREAD_PLACE_IO, name);
+
+	for(;;) {
+		pthread_mutex_lock(&t->mtx);
+		if(t->shutdown) {
+			pthread_mutex_unlock(&t->mtx);
+			break;
+		}
+		if(t->ack_gen != t->gen) {
+			t->cur = t->next;
+			t->ack_gen = t->gen;
+			pthread_cond_broadcast(&t->cond);
+		}
+		pthread_mutex_unlock(&t->mtx);
+		set = t->cur;
+		thread_placement_check();
+
+		now = bgp_io_clock();
+		timeout = -1;
+		for(i = 0; i < set->count; i++) {
+			io = set->peers[i];
+			set->pfds[i].fd = io->fd;
+			set->pfds[i].events = 0;
+			set->pfds[i].revents = 0;
+			if(io->dead) {
+				set->pfds[i].fd = -1;
+				continue;
+			}
+			if(io->rx_head - __atomic_load_n(&io->rx_tail, __ATOMIC_ACQUIRE) < io->rx_slots) {
+				set->pfds[i].events |= POLLIN;
+			}
+			if(bgp_io_tx_pending(io)) {
+				set->pfds[i].events |= POLLOUT;
+			}
+			if(io->keepalive) {
+				due = io->last_write + io->keepalive;
+				if(due <= now) {
+					timeout = 0;
+				} else if(timeout < 0 || timeout > (due - now) * 1000) {
+					timeout = (due - now) * 1000;
+				}
+			}
+		}
+		set->pfds[set->count].fd = t->kick[0];
+		set->pfds[set->count].events = POLLIN;
+		set->pfds[set->count].revents = 0;
+
+		poll(set->pfds, set->count + 1, timeout);
+		t->loops++;
+
+		/* drain first, so a kick racing with us re-arms it */
+		if(set->pfds[set->count].revents) {
+			bgp_io_fd_drain(t->kick[0]);
+		}
+		__atomic_store_n(&t->kicked, 0, __ATOMIC_SEQ_CST);
+
+		now = bgp_io_clock();
+		wake = 0;
+		for(i = 0; i < set->count; i++) {
+			io = set->peers[i];
+			if(io->dead) {
+				continue;
+			}
+			news = 0;
+
+			if(set->pfds[i].revents & (POLLIN | POLLHUP | POLLERR)) {
+				news |= bgp_io_read(io);
+			}
+
+			if(!io->dead && io->keepalive && io->ka_off < 0 && io->last_write + io->keepalive <= now && !bgp_io_midpacket(io)) {
+				io->ka_off = 0;
+			}
+
+			/* Try the socket if it's writable, or if what there is to
+			 * write turned up while we weren't asking. */
+			if(!io->dead && bgp_io_tx_pending(io) && ((set->pfds[i].revents & (POLLOUT | POLLERR)) || !(set->pfds[i].events & POLLOUT))) {
+				news |= bgp_io_write(io, now);
+			}
+
+			if(news && !__atomic_exchange_n(&io->signalled, 1, __ATOMIC_ACQ_REL)) {
+				wake = 1;
+			}
+		}
+
+		if(wake) {
+			bgp_io_fd_write(t->wakeup[1]);
+		}
+	}
+
+	thread_placement_leave();
+	return NULL;
+}
+#endif /* BGP_IO_THREADED */
+
+static struct bgp_io_set *bgp_io_set_new(unsigned int count) {
+	struct bgp_io_set *set;
+
+	set = XCALLOC(MTYPE_BGP_IO, sizeof(struct bgp_io_set));
+	set->count = count;
+	set->peers = XCALLOC(MTYPE_BGP_IO, sizeof(struct bgp_io_peer *) * (count + 1));
+	set->pfds = XCALLOC(MTYPE_BGP_IO, sizeof(struct pollfd) * (count + 1));
+	return set;
+}
+
+static void bgp_io_set_free(struct bgp_io_set *set) {
+	XFREE(MTYPE_BGP_IO, set->peers);
+	XFREE(MTYPE_BGP_IO, set->pfds);
+	XFREE(MTYPE_BGP_IO, set);
+}
+
+/* Add or remove a peer, and wait for the I/O thread to take the new set
+ * on, after which it won't touch the removed peer again. */
+static void bgp_io_set_change(struct bgp_io_thread *t, struct bgp_io_peer *io, int add) {
+	struct bgp_io_set *old = t->next, *set;
+	unsigned int i, j;
+
+	set = bgp_io_set_new(add ? old->count + 1 : old->count - 1);
+	for(i = j = 0; i < old->count; i++) {
+		if(old->peers[i] != io) {
+			set->peers[j++] = old->peers[i];
+		}
+	}
+	if(add) {
+		set->peers[j++] = io;
+	}
+	assert(j == set->count);
+
+#ifdef BGP_IO_THREADED
+	pthread_mutex_lock(&t->mtx);
+	t->next = set;
+	t->gen++;
+	bgp_io_fd_write(t->kick[1]);
+	while(t->ack_gen != t->gen) {
+		pthread_cond_wait(&t->cond, &t->mtx);
+	}
+	pthread_mutex_unlock(&t->mtx);
+#else
+	t->next = t->cur = set;
+#endif
+
+	bgp_io_set_free(old);
+}
+
+static void bgp_io_free(struct bgp_io_peer *io) {
+	XFREE(MTYPE_BGP_IO_BUF, io->rx_buf);
+	XFREE(MTYPE_BGP_IO_BUF, io->rx_prefix);
+	XFREE(MTYPE_BGP_IO_BUF, io->rx);
+	XFREE(MTYPE_BGP_IO, io);
+}
+
+/* The I/O thread has something for us: service each peer it flagged. */
+static int bgp_io_wakeup(struct thread *thread) {
+	struct bgp_io_thread *t = THREAD_ARG(thread);
+	struct bgp_io_set *set = t->next;
+	struct peer **peers;
+	unsigned int i, n = 0;
+	int ret, more = 0;
+
+	t->t_wakeup = NULL;
+	bgp_io_fd_drain(t->wakeup[0]);
+
+	/* servicing one peer may take another off the set */
+	peers = XCALLOC(MTYPE_TMP, sizeof(struct peer *) * (set->count + 1));
+	for(i = 0; i < set->count; i++) {
+		if(__atomic_exchange_n(&set->peers[i]->signalled, 0, __ATOMIC_ACQ_REL)) {
+			peers[n++] = peer_lock(set->peers[i]->peer);
+		}
+	}
+	for(i = 0; i < n; i++) {
+		struct bgp_io_peer *io = peers[i]->io;
+
+		if(io) {
+			io->servicing = 1;
+			ret = bgp_io_service(peers[i]);
+			io->servicing = 0;
+
+			if(io->stopped) {
+				bgp_io_free(io);
+			} else if(ret) {
+				/* leave the rest for later, rather than hog the main
+				 * thread */
+				__atomic_store_n(&io->signalled, 1, __ATOMIC_RELEASE);
+				more = 1;
+			}
+		}
+		peer_unlock(peers[i]);
+	}
+	XFREE(MTYPE_TMP, peers);
+
+	if(more) {
+		bgp_io_fd_write(t->wakeup[1]);
+	}
+
+	t->t_wakeup = thread_add_read(bm->master, bgp_io_wakeup, t, t->wakeup[0]);
+	return 0;
+}
+
+void bgp_io_start(struct peer *peer) {
+	struct bgp_io_thread *t = NULL;
+	struct bgp_io_peer *io;
+	unsigned int i;
+	size_t fill;
+
+	if(io_threads_wanted) {
+		bgp_io_threads_start();
+	}
+	if(!io_thread_count || peer->io || peer->fd < 0) {
+		return;
+	}
+
+	for(i = 0; i < io_thread_count; i++) {
+		if(!t || io_threads[i]->next->count < t->next->count) {
+			t = io_threads[i];
+		}
+	}
+
+	io = XCALLOC(MTYPE_BGP_IO, sizeof(struct bgp_io_peer));
+	io->max_packet_size = peer->max_packet_size;
+	io->rx_slots = (io->max_packet_size > BGP_MAX_PACKET_SIZE) ? BGP_IO_RX_SLOTS_EXTENDED : BGP_IO_RX_SLOTS;
+	io->rx = XCALLOC(MTYPE_BGP_IO_BUF, sizeof(struct bgp_io_slot) * io->rx_slots);
+	io->prefix_max = BGP_IO_PREFIX_MAX * (io->max_packet_size / BGP_MAX_PACKET_SIZE);
+	io->rx_buf = XMALLOC(MTYPE_BGP_IO_BUF, (size_t) io->max_packet_size * io->rx_slots);
+	io->rx_prefix = XMALLOC(MTYPE_BGP_IO_BUF, sizeof(struct prefix_ipv4) * io->prefix_max * io->rx_slots);
+	for(i = 0; i < io->rx_slots; i++) {
+		io->rx[i].data = io->rx_buf + (size_t) i * io->max_packet_size;
+		io->rx[i].prefix = io->rx_prefix + i * io->prefix_max;
+	}
+	io->peer = peer;
+	io->thread = t;
+	io->fd = peer->fd;
+	io->keepalive = peer->v_keepalive;
+	io->ka_off = -1;
+	io->last_write = bgp_io_clock();
+
+	/* Carry on from whatever part of a packet was read already */
+	fill = stream_get_endp(peer->ibuf) - stream_get_getp(peer->ibuf);
+	if(fill && stream_get_getp(peer->ibuf) == 0) {
+		memcpy(io->rx[0].data, STREAM_DATA(peer->ibuf), fill);
+		io->rx_fill = fill;
+	}
+	peer->packet_size = 0;
+	stream_reset(peer->ibuf);
+
+	/* From here on the I/O thread reads the socket */
+	BGP_READ_OFF(peer->t_read);
+
+	peer->io = io;
+	bgp_io_set_change(t, io, 1);
+
+	/* and whatever was queued goes through the ring */
+	BGP_WRITE_OFF(peer->t_write);
+	bgp_io_flush(peer);
+}
+
+int bgp_io_stop(struct peer *peer) {
+	struct bgp_io_peer *io = peer->io;
+	struct stream *s;
+	int midpacket;
+
+	if(!io) {
+		return 0;
+	}
+
+	bgp_io_set_change(io->thread, io, 0);
+
+	midpacket = io->ka_off > 0 || (io->tx_sent != io->tx_head && io->tx[io->tx_sent % BGP_IO_TX_SLOTS].off > 0);
+
+	peer->keepalive_out += bgp_io_keepalives(io);
+	while((s = bgp_io_tx_done(io)) != NULL) {
+		bgp_packet_sent(peer, s);
+		stream_free(s);
+	}
+	for(; io->tx_tail != io->tx_head; io->tx_tail++) {
+		stream_free(io->tx[io->tx_tail % BGP_IO_TX_SLOTS].s);
+	}
+
+	peer->io = NULL;
+	if(io->servicing) {
+		io->stopped = 1;
+	} else {
+		bgp_io_free(io);
+	}
+
+	return midpacket;
+}
+
+int bgp_io_tx_full(struct bgp_io_peer *io) {
+	return io->tx_head - io->tx_tail == BGP_IO_TX_SLOTS;
+}
+
+void bgp_io_tx_push(struct bgp_io_peer *io, struct stream *s) {
+	struct bgp_io_tx *tx = &io->tx[io->tx_head % BGP_IO_TX_SLOTS];
+
+	assert(!bgp_io_tx_full(io));
+	tx->s = s;
+	tx->off = stream_get_getp(s);
+	__atomic_store_n(&io->tx_head, io->tx_head + 1, __ATOMIC_RELEASE);
+}
+
+/* Next stream the I/O thread has finished writing, or NULL */
+struct stream *bgp_io_tx_done(struct bgp_io_peer *io) {
+	struct stream *s;
+
+	if(io->tx_tail == __atomic_load_n(&io->tx_sent, __ATOMIC_ACQUIRE)) {
+		return NULL;
+	}
+	s = io->tx[io->tx_tail % BGP_IO_TX_SLOTS].s;
+	io->tx_tail++;
+	return s;
+}
+
+/* Have the I/O thread look at the rings again */
+void bgp_io_kick(struct bgp_io_peer *io) {
+	if(!__atomic_exchange_n(&io->thread->kicked, 1, __ATOMIC_SEQ_CST)) {
+		bgp_io_fd_write(io->thread->kick[1]);
+	}
+}
+
+struct bgp_io_slot *bgp_io_rx_peek(struct bgp_io_peer *io) {
+	if(io->rx_tail == __atomic_load_n(&io->rx_head, __ATOMIC_ACQUIRE)) {
+		return NULL;
+	}
+	return &io->rx[io->rx_tail % io->rx_slots];
+}
+
+void bgp_io_rx_next(struct bgp_io_peer *io) {
+	__atomic_store_n(&io->rx_tail, io->rx_tail + 1, __ATOMIC_RELEASE);
+}
+
+/* BGP_IO_CLOSED or BGP_IO_ERROR once the I/O thread has given up on the
+ * socket; packets read before that are all in the ring by then. */
+int bgp_io_error(struct bgp_io_peer *io) {
+	int error = __atomic_load_n(&io->error, __ATOMIC_ACQUIRE);
+
+	if(error == BGP_IO_ERROR) {
+		errno = io->error_errno;
+	}
+	return error;
+}
+
+/* Packets the I/O thread read that are yet to be handled */
+unsigned int bgp_io_rx_queued(struct bgp_io_peer *io) {
+	return __atomic_load_n(&io->rx_head, __ATOMIC_ACQUIRE) - io->rx_tail;
+}
+
+/* Packets handed to the I/O thread and not all written yet, and their
+ * bytes */
+unsigned int bgp_io_tx_queued(struct bgp_io_peer *io, unsigned long *bytes) {
+	unsigned int i;
+
+	for(i = io->tx_tail; i != io->tx_head; i++) {
+		struct stream *s = io->tx[i % BGP_IO_TX_SLOTS].s;
+
+		*bytes += stream_get_endp(s) - stream_get_getp(s);
+	}
+	return io->tx_head - io->tx_tail;
+}
+
+/* KEEPALIVEs sent since last asked */
+unsigned int bgp_io_keepalives(struct bgp_io_peer *io) {
+	unsigned int count = __atomic_load_n(&io->keepalives, __ATOMIC_RELAXED);
+	unsigned int delta = count - io->keepalives_seen;
+
+	io->keepalives_seen = count;
+	return delta;
+}
+
+DEFUN(show_bgp_io_threads, show_bgp_io_threads_cmd, "show bgp io-threads", SHOW_STR BGP_STR "Packet I/O threads\n") {
+	unsigned int i;
+
+	if(io_threads_wanted) {
+		vty_out(vty, "%u I/O threads, to be started with the first established session%s", io_threads_wanted, VTY_NEWLINE);
+		return CMD_SUCCESS;
+	}
+	if(!io_thread_count) {
+		vty_out(vty, "No I/O threads, packets are read and written by the main thread%s", VTY_NEWLINE);
+		return CMD_SUCCESS;
+	}
+
+	vty_out(vty, "%6s %5s %10s %10s %10s %10s%s", "Thread", "Peers", "Loops", "Packets in", "Writes", "Keepalives", VTY_NEWLINE);
+	for(i = 0; i < io_thread_count; i++) {
+		struct bgp_io_thread *t = io_threads[i];
+
+		vty_out(vty, "%6u %5u %10lu %10lu %10lu %10lu%s", t->id, t->next->count, __atomic_load_n(&t->loops, __ATOMIC_RELAXED), __atomic_load_n(&t->packets_in, __ATOMIC_RELAXED),
+			__atomic_load_n(&t->writes, __ATOMIC_RELAXED), __atomic_load_n(&t->keepalives, __ATOMIC_RELAXED), VTY_NEWLINE);
+	}
+	return CMD_SUCCESS;
+}
+
+/* Not done at bgp_io_init() time, as the threads wouldn't survive
+ * daemonizing. */
+static void bgp_io_threads_start(void) {
+#ifdef BGP_IO_THREADED
+	unsigned int i, threads = io_threads_wanted;
+
+	io_threads_wanted = 0;
+	io_threads = XCALLOC(MTYPE_BGP_IO, sizeof(struct bgp_io_thread *) * threads);
+	for(i = 0; i < threads; i++) {
+		struct bgp_io_thread *t;
+		sigset_t all, old;
+		int err;
+
+		t = XCALLOC(MTYPE_BGP_IO, sizeof(struct bgp_io_thread));
+		t->id = i;
+		t->cur = t->next = bgp_io_set_new(0);
+
+		if(bgp_io_fd_open(t->kick) < 0) {
+			zlog_err("%s: can't create kick for I/O thread %u: %s", __func__, i, safe_strerror(errno));
+			goto fail_kick;
+		}
+		if(bgp_io_fd_open(t->wakeup) < 0) {
+			zlog_err("%s: can't create wakeup for I/O thread %u: %s", __func__, i, safe_strerror(errno));
+			goto fail_wakeup;
+		}
+		pthread_mutex_init(&t->mtx, NULL);
+		pthread_cond_init(&t->cond, NULL);
+
+		/* Signals are for the main thread's sigevent handling only */
+		sigfillset(&all);
+		pthread_sigmask(SIG_BLOCK, &all, &old);
+		err = pthread_create(&t->pthread, NULL, bgp_io_thread_main, t);
+		pthread_sigmask(SIG_SETMASK, &old, NULL);
+		if(err != 0) {
+			zlog_err("%s: can't start I/O thread %u: %s", __func__, i, safe_strerror(err));
+			pthread_cond_destroy(&t->cond);
+			pthread_mutex_destroy(&t->mtx);
+			bgp_io_fd_close(t->wakeup);
+		fail_wakeup:
+			bgp_io_fd_close(t->kick);
+		fail_kick:
+			bgp_io_set_free(t->cur);
+			XFREE(MTYPE_BGP_IO, t);
+			break;
+		}
+
+		t->t_wakeup = thread_add_read(bm->master, bgp_io_wakeup, t, t->wakeup[0]);
+		io_threads[io_thread_count++] = t;
+	}
+#endif /* BGP_IO_THREADED */
+}
+
+void bgp_io_init(unsigned int threads) {
+	install_element(VIEW_NODE, &show_bgp_io_threads_cmd);
+
+	if(!threads) {
+		return;
+	}
+#ifndef BGP_IO_THREADED
+	zlog_warn("%s: no thread support, packet I/O stays on the main thread", __func__);
+#else
+	io_threads_wanted = threads > BGP_IO_THREADS_MAX ? BGP_IO_THREADS_MAX : threads;
+#endif
+}
+
+void bgp_io_finish(void) {
+	unsigned int i;
+
+	for(i = 0; i < io_thread_count; i++) {
+		struct bgp_io_thread *t = io_threads[i];
+
+		while(t->next->count) {
+			bgp_io_stop(t->next->peers[0]->peer);
+		}
+
+#ifdef BGP_IO_THREADED
+		pthread_mutex_lock(&t->mtx);
+		t->shutdown = 1;
+		bgp_io_fd_write(t->kick[1]);
+		pthread_mutex_unlock(&t->mtx);
+		pthread_join(t->pthread, NULL);
+		pthread_cond_destroy(&t->cond);
+		pthread_mutex_destroy(&t->mtx);
+#endif
+
+		THREAD_OFF(t->t_wakeup);
+		bgp_io_fd_close(t->kick);
+		bgp_io_fd_close(t->wakeup);
+		bgp_io_set_free(t->cur);
+		XFREE(MTYPE_BGP_IO, t);
+	}
+
+	if(io_threads) {
+		XFREE(MTYPE_BGP_IO, io_threads);
+	}
+	io_thread_count = 0;
+}
@@ -0,0 +1,153 @@
+/* BGP packet I/O threads
+ *
+ * This file is part of Quagga
+ *
+ * Quagga is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2, or (at your option) any
+ * later version.
+ *
+ * Quagga is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Quagga; see the file COPYING.  If not, write to the Free
+ * Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ * 02111-1307, USA.
+ */
+
+#ifndef _QUAGGA_BGP_IO_H
+#define _QUAGGA_BGP_IO_H
+
+/* With bgpd started with -t/--io_threads, the socket of each Established
+ * peer is handed to one of a set of I/O threads.  That thread reads and
+ * frames whole packets into a ring of slots, writes out the streams the
+ * main thread queues onto a second ring, and sends KEEPALIVEs on its own
+ * when nothing else has been written for the keepalive interval, so that
+ * a long stretch of route processing on the main thread can neither
+ * stall the TCP receive window nor let the neighbour's hold timer run
+ * out.
+ *
+ * The I/O thread also decodes the IPv4 withdrawn routes and NLRI of each
+ * UPDATE into its slot, so the main thread only has to parse the
+ * attributes and run bgp_update()/bgp_withdraw() on the result.  Parsing
+ * attributes needs memory and the attribute hashes, so that, and all FSM
+ * work, stays on the main thread.
+ *
+ * Both rings are single producer, single consumer and lock-free.  The I/O
+ * threads never touch struct peer, allocate memory, log or schedule
+ * threads; everything they produce is picked up by bgp_io_service() on
+ * the main thread.  The OPEN exchange, and the NOTIFICATION ending a
+ * session, are still done by the main thread as before.
+ */
+
+#define BGP_IO_THREADS_MAX 16
+
+/* Packet slots, and queued streams, per peer.  Peers that negotiated
+ * extended messages get fewer, bigger slots. */
+#define BGP_IO_RX_SLOTS 16
+#define BGP_IO_RX_SLOTS_EXTENDED 4
+#define BGP_IO_TX_SLOTS 64
+
+/* Reasons the I/O thread stopped reading */
+#define BGP_IO_CLOSED 1 /* the neighbour closed the connection */
+#define BGP_IO_ERROR 2	/* read or write failed, see error_errno */
+
+struct bgp_io_thread;
+
+/* Most IPv4 prefixes of an UPDATE the I/O thread decodes, per
+ * BGP_MAX_PACKET_SIZE of the session's largest message */
+#define BGP_IO_PREFIX_MAX 256
+
+struct bgp_io_slot {
+	bgp_size_t len;
+
+	/* Set for an UPDATE whose IPv4 withdrawn routes and NLRI the I/O
+	 * thread found well formed and decoded: 'withdrawn' of the first,
+	 * then 'nlri' of the second. */
+	int decoded;
+	u_int16_t withdrawn;
+	u_int16_t nlri;
+	struct prefix_ipv4 *prefix; /* prefix_max of the peer's rx_prefix */
+
+	u_char *data; /* max_packet_size bytes of the peer's rx_buf */
+};
+
+struct bgp_io_tx {
+	struct stream *s;
+	size_t off; /* next byte to write, owned by the I/O thread */
+};
+
+struct bgp_io_peer {
+	struct peer *peer; /* for the main thread only */
+	struct bgp_io_thread *thread;
+	int fd;
+	time_t keepalive;
+
+	/* Received packets: the I/O thread fills rx[rx_head], the main
+	 * thread consumes from rx[rx_tail]. */
+	struct bgp_io_slot *rx;
+	u_char *rx_buf;
+	struct prefix_ipv4 *rx_prefix;
+	unsigned int rx_slots;
+	unsigned int prefix_max;
+	bgp_size_t max_packet_size;
+	unsigned int rx_head;
+	unsigned int rx_tail;
+	size_t rx_fill; /* I/O thread: bytes read into rx[rx_head] */
+
+	/* Streams to send: the main thread queues at tx_head, the I/O thread
+	 * has written all before tx_sent, and the main thread frees them up
+	 * to there from tx_tail. */
+	struct bgp_io_tx tx[BGP_IO_TX_SLOTS];
+	unsigned int tx_head;
+	unsigned int tx_sent;
+	unsigned int tx_tail;
+
+	/* I/O thread: bytes of the current KEEPALIVE written, or -1 */
+	int ka_off;
+	/* I/O thread: stopped reading and writing */
+	int dead;
+
+	/* I/O thread: when anything was last written */
+	time_t last_write;
+
+	/* Written by the I/O thread, read by the main thread */
+	unsigned int keepalives;
+	int error;
+	int error_errno;
+	int signalled;
+
+	/* main thread: keepalives already accounted for, and whether the
+	 * peer is being serviced, in which case bgp_io_stop() leaves freeing
+	 * the slots to bgp_io_wakeup(). */
+	unsigned int keepalives_seen;
+	int servicing;
+	int stopped;
+};
+
+extern void bgp_io_init(unsigned int threads);
+extern void bgp_io_finish(void);
+
+/* Hand an Established peer's socket over to an I/O thread.  Does nothing
+ * if there are no I/O threads. */
+extern void bgp_io_start(struct peer *);
+/* Take the socket back, dropping whatever is still queued.  Returns 1 if
+ * that left a packet partly written. */
+extern int bgp_io_stop(struct peer *);
+
+/* Main thread side of the rings */
+extern int bgp_io_tx_full(struct bgp_io_peer *);
+extern void bgp_io_tx_push(struct bgp_io_peer *, struct stream *);
+extern struct stream *bgp_io_tx_done(struct bgp_io_peer *);
+extern void bgp_io_kick(struct bgp_io_peer *);
+extern struct bgp_io_slot *bgp_io_rx_peek(struct bgp_io_peer *);
+extern void bgp_io_rx_next(struct bgp_io_peer *);
+extern int bgp_io_error(struct bgp_io_peer *);
+extern unsigned int bgp_io_keepalives(struct bgp_io_peer *);
+extern unsigned int bgp_io_rx_queued(struct bgp_io_peer *);
+extern unsigned int bgp_io_tx_queued(struct bgp_io_peer *, unsigned long *);
+
+#endif /* _QUAGGA_BGP_IO_H */
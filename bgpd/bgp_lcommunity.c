@@ -30,6 +30,7 @@ Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
 #include "bgpd/bgpd.h"
 #include "bgpd/bgp_lcommunity.h"
 #include "bgpd/bgp_aspath.h"
+#include "bgpd/bgp_arena.h"
 
 /* Hash of community attribute. */
 static struct hash *lcomhash;
@@ -112,26 +113,50 @@ struct lcommunity *lcommunity_uniq_sort(struct lcommunity *lcom) {
 	return new;
 }
 
+static int lcommunity_val_cmp(const void *v1, const void *v2) {
+	return memcmp(v1, v2, LCOMMUNITY_SIZE);
+}
+
+static void *lcommunity_parse_hash_alloc(void *p) {
+	return lcommunity_dup(p);
+}
+
 /* Parse Large Communites Attribute in BGP packet.  */
 struct lcommunity *lcommunity_parse(u_int8_t *pnt, u_short length) {
 	struct lcommunity tmp;
-	struct lcommunity *new;
+	struct lcommunity *find;
+	int i;
 
 	/* Length check.  */
 	if(length % LCOMMUNITY_SIZE) {
 		return NULL;
 	}
 
-	/* Prepare tmporary structure for making a new Large Communities
-     Attribute.  */
-	tmp.size = length / LCOMMUNITY_SIZE;
-	tmp.val = pnt;
+	/* Prepare tmporary structure for looking up the Large Communities
+     Attribute, uniq and sorted as lcommunity_uniq_sort() would, in the
+     UPDATE's arena: only one not seen before is copied to the heap.  */
+	memset(&tmp, 0, sizeof(struct lcommunity));
+	if(length) {
+		tmp.val = bgp_arena_alloc(length);
+		memcpy(tmp.val, pnt, length);
+		qsort(tmp.val, length / LCOMMUNITY_SIZE, LCOMMUNITY_SIZE, lcommunity_val_cmp);
+		for(i = 0; i < length / LCOMMUNITY_SIZE; i++) {
+			if(tmp.size && memcmp(tmp.val + (tmp.size - 1) * LCOMMUNITY_SIZE, tmp.val + i * LCOMMUNITY_SIZE, LCOMMUNITY_SIZE) == 0) {
+				continue;
+			}
+			memmove(tmp.val + tmp.size * LCOMMUNITY_SIZE, tmp.val + i * LCOMMUNITY_SIZE, LCOMMUNITY_SIZE);
+			tmp.size++;
+		}
+	}
+
+	find = (struct lcommunity *) hash_get(lcomhash, &tmp, lcommunity_parse_hash_alloc);
+	find->refcnt++;
 
-	/* Create a new Large Communities Attribute by uniq and sort each
-     Large Communities value  */
-	new = lcommunity_uniq_sort(&tmp);
+	if(!find->str) {
+		find->str = lcommunity_lcom2str(find, LCOMMUNITY_FORMAT_DISPLAY);
+	}
 
-	return lcommunity_intern(new);
+	return find;
 }
 
 /* Duplicate the Large Communities Attribute structure.  */
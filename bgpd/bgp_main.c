@@ -39,12 +39,16 @@ Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
 #include "stream.h"
 #include "vrf.h"
 #include "workqueue.h"
+#include "zring.h"
 
 #include "bgpd/bgpd.h"
 #include "bgpd/bgp_attr.h"
 #include "bgpd/bgp_mplsvpn.h"
 #include "bgpd/bgp_aspath.h"
 #include "bgpd/bgp_dump.h"
+#include "bgpd/bgp_bmp.h"
+#include "bgpd/bgp_rpki.h"
+#include "bgpd/bgp_snapshot.h"
 #include "bgpd/bgp_route.h"
 #include "bgpd/bgp_nexthop.h"
 #include "bgpd/bgp_regex.h"
@@ -65,6 +69,9 @@ static const struct option longopts[] = {
 	{ "vty_port", required_argument, NULL, 'P' },
 	{ "retain", no_argument, NULL, 'r' },
 	{ "no_kernel", no_argument, NULL, 'n' },
+	{ "io_threads", required_argument, NULL, 't' },
+	{ "select_threads", required_argument, NULL, 's' },
+	{ "zebra_ring", required_argument, NULL, 'R' },
 	{ "user", required_argument, NULL, 'u' },
 	{ "group", required_argument, NULL, 'g' },
 	{ "skip_runas", no_argument, NULL, 'S' },
@@ -154,6 +161,9 @@ redistribution between different routing protocols.\n\n\
 -P, --vty_port     Set vty's port number\n\
 -r, --retain       When program terminates, retain added route by bgpd.\n\
 -n, --no_kernel    Do not install route to kernel.\n\
+-t, --io_threads   Number of threads for packet I/O of established peers\n\
+-s, --select_threads Number of threads helping with best path selection\n\
+-R, --zebra_ring   Send to zebra through a shared memory ring of this many KiB\n\
 -u, --user         User to run as\n\
 -g, --group        Group to run as\n\
 -S, --skip_runas   Skip user and group run as\n\
@@ -221,6 +231,12 @@ static void bgp_exit(int status) {
 	/* it only makes sense for this to be called on a clean exit */
 	assert(status == 0);
 
+	/* reverse bgp_bmp_init, before the peers go: collectors are told
+	 * bgpd is shutting down instead */
+	bgp_bmp_finish();
+	bgp_rpki_finish();
+	bgp_snapshot_finish();
+
 	/* reverse bgp_master_init */
 	for(ALL_LIST_ELEMENTS(bm->bgp, node, nnode, bgp)) {
 		bgp_delete(bgp);
@@ -296,6 +312,9 @@ static void bgp_exit(int status) {
 	/* reverse community_list_init */
 	community_list_terminate(bgp_clist);
 
+	/* reverse bgp_regex_init, the lists holding regexes being gone */
+	bgp_regex_terminate();
+
 	vrf_terminate();
 	cmd_terminate();
 	vty_terminate();
@@ -352,7 +371,7 @@ int main(int argc, char **argv) {
 
 	/* Command line argument treatment. */
 	while(1) {
-		opt = getopt_long(argc, argv, "df:i:z:hp:l:A:P:rnu:g:vCS", longopts, 0);
+		opt = getopt_long(argc, argv, "df:i:z:hp:l:A:P:rnt:s:R:u:g:vCS", longopts, 0);
 
 		if(opt == EOF) {
 			break;
@@ -390,6 +409,23 @@ int main(int argc, char **argv) {
 				bm->address = optarg;
 				/* listenon implies -n */
 			case 'n': bgp_option_set(BGP_OPT_NO_FIB); break;
+			case 't':
+				if(atoi(optarg) > 0) {
+					bm->io_threads = atoi(optarg);
+				}
+				break;
+			case 's':
+				if(atoi(optarg) > 0) {
+					bm->select_threads = atoi(optarg);
+				}
+				break;
+			case 'R':
+				bm->zebra_ring = strtoul(optarg, NULL, 10) * 1024;
+				if(bm->zebra_ring < ZRING_SIZE_MIN || bm->zebra_ring > ZRING_SIZE_MAX || (bm->zebra_ring & (bm->zebra_ring - 1))) {
+					fprintf(stderr, "The zebra ring must be a power of two between %u and %u KiB\n", ZRING_SIZE_MIN / 1024, ZRING_SIZE_MAX / 1024);
+					exit(1);
+				}
+				break;
 			case 'u': bgpd_privs.user = optarg; break;
 			case 'g': bgpd_privs.group = optarg; break;
 			case 'S': skip_runas = 1; break;
@@ -418,7 +454,8 @@ int main(int argc, char **argv) {
 	/* BGP related initialization.  */
 	bgp_init();
 
-	/* Parse config file. */
+	/* Parse config file, all of it before any session starts. */
+	bm->start_hold = 1;
 	vty_read_config(config_file, config_default);
 
 	/* Start execution only if not in dry-run mode */
@@ -441,6 +478,8 @@ int main(int argc, char **argv) {
 	/* Print banner. */
 	zlog_notice("BGPd %s starting: vty@%d, bgp@%s:%d pid %d", QUAGGA_VERSION, vty_port, (bm->address ? bm->address : "<all>"), bm->port, getpid());
 
+	bgp_startup();
+
 	/* Start finite state machine, here we go! */
 	thread_main(bm->master);
 
@@ -29,6 +29,8 @@
 #include "sockunion.h"
 #include "memory.h"
 #include "filter.h"
+#include "hash.h"
+#include "jhash.h"
 
 #include "bgpd/bgpd.h"
 #include "bgpd/bgp_table.h"
@@ -41,6 +43,25 @@
 #include "bgpd/bgp_lcommunity.h"
 #include "bgpd/bgp_mpath.h"
 
+/* The aggregated attribute of a best path and its multipaths, shared by
+ * every best path whose paths have the same attributes, in the same
+ * order: the paths of many prefixes come in the same updates, and so
+ * aggregate to the same attribute.  Holds a reference on the attributes
+ * it was aggregated from, so that they stay what the key says they are.
+ */
+struct bgp_mpath_agg {
+	unsigned long refcnt;
+
+	/* Aggregated attribute, interned */
+	struct attr *attr;
+
+	/* Attributes of the best path then its multipaths, interned */
+	u_int32_t count;
+	struct attr **members;
+};
+
+static struct hash *bgp_mpath_agg_hash;
+
 bool bgp_mpath_is_configured_sort(struct bgp *bgp, bgp_peer_sort_t sort, afi_t afi, safi_t safi) {
 	struct bgp_maxpaths_cfg *cfg = &bgp->maxpaths[afi][safi];
 
@@ -179,10 +200,11 @@ static int bgp_info_mpath_cmp(void *val1, void *val2) {
  * Initialize the mp_list, which holds the list of multipaths
  * selected by bgp_best_selection
  */
-void bgp_mp_list_init(struct list *mp_list) {
+void bgp_mp_list_init(struct bgp_mp_list *mp_list) {
 	assert(mp_list);
-	memset(mp_list, 0, sizeof(struct list));
-	mp_list->cmp = bgp_info_mpath_cmp;
+	mp_list->paths = mp_list->stack;
+	mp_list->count = 0;
+	mp_list->size = BGP_MP_LIST_STACK;
 }
 
 /*
@@ -190,19 +212,103 @@ void bgp_mp_list_init(struct list *mp_list) {
  *
  * Clears all entries out of the mp_list
  */
-void bgp_mp_list_clear(struct list *mp_list) {
+void bgp_mp_list_clear(struct bgp_mp_list *mp_list) {
 	assert(mp_list);
-	list_delete_all_node(mp_list);
+	if(mp_list->paths != mp_list->stack) {
+		XFREE(MTYPE_TMP, mp_list->paths);
+	}
+	bgp_mp_list_init(mp_list);
 }
 
 /*
  * bgp_mp_list_add
  *
- * Adds a multipath entry to the mp_list
+ * Adds a multipath entry to the mp_list, after any it compares equal to
  */
-void bgp_mp_list_add(struct list *mp_list, struct bgp_info *mpinfo) {
+void bgp_mp_list_add(struct bgp_mp_list *mp_list, struct bgp_info *mpinfo) {
+	u_int32_t lo, hi, mid;
+
 	assert(mp_list && mpinfo);
-	listnode_add_sort(mp_list, mpinfo);
+
+	if(mp_list->count == mp_list->size) {
+		mp_list->size *= 2;
+		if(mp_list->paths == mp_list->stack) {
+			mp_list->paths = XMALLOC(MTYPE_TMP, mp_list->size * sizeof(struct bgp_info *));
+			memcpy(mp_list->paths, mp_list->stack, sizeof(mp_list->stack));
+		} else {
+			mp_list->paths = XREALLOC(MTYPE_TMP, mp_list->paths, mp_list->size * sizeof(struct bgp_info *));
+		}
+	}
+
+	lo = 0;
+	hi = mp_list->count;
+	while(lo < hi) {
+		mid = (lo + hi) / 2;
+		if(bgp_info_mpath_cmp(mp_list->paths[mid], mpinfo) <= 0) {
+			lo = mid + 1;
+		} else {
+			hi = mid;
+		}
+	}
+	memmove(&mp_list->paths[lo + 1], &mp_list->paths[lo], (mp_list->count - lo) * sizeof(struct bgp_info *));
+	mp_list->paths[lo] = mpinfo;
+	mp_list->count++;
+}
+
+static unsigned int bgp_mpath_agg_key(void *p) {
+	struct bgp_mpath_agg *agg = p;
+
+	return jhash(agg->members, agg->count * sizeof(struct attr *), agg->count);
+}
+
+static int bgp_mpath_agg_cmp(const void *p1, const void *p2) {
+	const struct bgp_mpath_agg *agg1 = p1;
+	const struct bgp_mpath_agg *agg2 = p2;
+
+	return agg1->count == agg2->count && memcmp(agg1->members, agg2->members, agg1->count * sizeof(struct attr *)) == 0;
+}
+
+static void *bgp_mpath_agg_alloc(void *p) {
+	struct bgp_mpath_agg *key = p;
+	struct bgp_mpath_agg *agg;
+	u_int32_t i;
+
+	agg = XCALLOC(MTYPE_BGP_MPATH_AGG, sizeof(struct bgp_mpath_agg) + key->count * sizeof(struct attr *));
+	agg->count = key->count;
+	agg->members = (struct attr **) (agg + 1);
+	for(i = 0; i < key->count; i++) {
+		agg->members[i] = bgp_attr_intern(key->members[i]);
+	}
+	return agg;
+}
+
+/*
+ * bgp_mpath_agg_release
+ *
+ * Drop a best path's reference on an aggregated attribute
+ */
+static void bgp_mpath_agg_release(struct bgp_mpath_agg **aggp) {
+	struct bgp_mpath_agg *agg = *aggp;
+	u_int32_t i;
+
+	*aggp = NULL;
+	if(--agg->refcnt) {
+		return;
+	}
+
+	hash_release(bgp_mpath_agg_hash, agg);
+	for(i = 0; i < agg->count; i++) {
+		bgp_attr_unintern(&agg->members[i]);
+	}
+	if(agg->attr) {
+		bgp_attr_unintern(&agg->attr);
+	}
+	XFREE(MTYPE_BGP_MPATH_AGG, agg);
+
+	if(bgp_mpath_agg_hash->count == 0) {
+		hash_free(bgp_mpath_agg_hash);
+		bgp_mpath_agg_hash = NULL;
+	}
 }
 
 /*
@@ -223,14 +329,24 @@ static struct bgp_info_mpath *bgp_info_mpath_new(void) {
  */
 void bgp_info_mpath_free(struct bgp_info_mpath **mpath) {
 	if(mpath && *mpath) {
-		if((*mpath)->mp_attr) {
-			bgp_attr_unintern(&(*mpath)->mp_attr);
+		if((*mpath)->mp_agg) {
+			bgp_mpath_agg_release(&(*mpath)->mp_agg);
 		}
 		XFREE(MTYPE_BGP_MPATH_INFO, *mpath);
 		*mpath = NULL;
 	}
 }
 
+/*
+ * bgp_info_mpath
+ *
+ * The mpath element of the given bgp_info, if it has one. It lives in
+ * the extra information as most paths never get one.
+ */
+static inline struct bgp_info_mpath *bgp_info_mpath(struct bgp_info *binfo) {
+	return binfo->extra ? binfo->extra->mpath : NULL;
+}
+
 /*
  * bgp_info_mpath_get
  *
@@ -239,15 +355,15 @@ void bgp_info_mpath_free(struct bgp_info_mpath **mpath) {
  */
 static struct bgp_info_mpath *bgp_info_mpath_get(struct bgp_info *binfo) {
 	struct bgp_info_mpath *mpath;
-	if(!binfo->mpath) {
+	if(!bgp_info_mpath(binfo)) {
 		mpath = bgp_info_mpath_new();
 		if(!mpath) {
 			return NULL;
 		}
-		binfo->mpath = mpath;
+		bgp_info_extra_get(binfo)->mpath = mpath;
 		mpath->mp_info = binfo;
 	}
-	return binfo->mpath;
+	return binfo->extra->mpath;
 }
 
 /*
@@ -281,7 +397,7 @@ static void bgp_info_mpath_enqueue(struct bgp_info *prev_info, struct bgp_info *
  * Remove a path from the multipath list
  */
 void bgp_info_mpath_dequeue(struct bgp_info *binfo) {
-	struct bgp_info_mpath *mpath = binfo->mpath;
+	struct bgp_info_mpath *mpath = bgp_info_mpath(binfo);
 	if(!mpath) {
 		return;
 	}
@@ -301,10 +417,11 @@ void bgp_info_mpath_dequeue(struct bgp_info *binfo) {
  * Given a bgp_info, return the next multipath entry
  */
 struct bgp_info *bgp_info_mpath_next(struct bgp_info *binfo) {
-	if(!binfo->mpath || !binfo->mpath->mp_next) {
+	struct bgp_info_mpath *mpath = bgp_info_mpath(binfo);
+	if(!mpath || !mpath->mp_next) {
 		return NULL;
 	}
-	return binfo->mpath->mp_next->mp_info;
+	return mpath->mp_next->mp_info;
 }
 
 /*
@@ -322,10 +439,11 @@ struct bgp_info *bgp_info_mpath_first(struct bgp_info *binfo) {
  * Given the bestpath bgp_info, return the number of multipath entries
  */
 u_int32_t bgp_info_mpath_count(struct bgp_info *binfo) {
-	if(!binfo->mpath) {
+	struct bgp_info_mpath *mpath = bgp_info_mpath(binfo);
+	if(!mpath) {
 		return 0;
 	}
-	return binfo->mpath->mp_count;
+	return mpath->mp_count;
 }
 
 /*
@@ -335,7 +453,7 @@ u_int32_t bgp_info_mpath_count(struct bgp_info *binfo) {
  */
 static void bgp_info_mpath_count_set(struct bgp_info *binfo, u_int32_t count) {
 	struct bgp_info_mpath *mpath;
-	if(!count && !binfo->mpath) {
+	if(!count && !bgp_info_mpath(binfo)) {
 		return;
 	}
 	mpath = bgp_info_mpath_get(binfo);
@@ -352,27 +470,11 @@ static void bgp_info_mpath_count_set(struct bgp_info *binfo, u_int32_t count) {
  * for advertising the multipath route
  */
 struct attr *bgp_info_mpath_attr(struct bgp_info *binfo) {
-	if(!binfo->mpath) {
+	struct bgp_info_mpath *mpath = bgp_info_mpath(binfo);
+	if(!mpath || !mpath->mp_agg) {
 		return NULL;
 	}
-	return binfo->mpath->mp_attr;
-}
-
-/*
- * bgp_info_mpath_attr_set
- *
- * Sets the aggregated attribute into bestpath's mpath element
- */
-static void bgp_info_mpath_attr_set(struct bgp_info *binfo, struct attr *attr) {
-	struct bgp_info_mpath *mpath;
-	if(!attr && !binfo->mpath) {
-		return;
-	}
-	mpath = bgp_info_mpath_get(binfo);
-	if(!mpath) {
-		return;
-	}
-	mpath->mp_attr = attr;
+	return mpath->mp_agg->attr;
 }
 
 /*
@@ -381,9 +483,10 @@ static void bgp_info_mpath_attr_set(struct bgp_info *binfo, struct attr *attr) {
  * Compare and sync up the multipath list with the mp_list generated by
  * bgp_best_selection
  */
-void bgp_info_mpath_update(struct bgp_node *rn, struct bgp_info *new_best, struct bgp_info *old_best, struct list *mp_list, afi_t afi, safi_t safi) {
+void bgp_info_mpath_update(struct bgp_node *rn, struct bgp_info *new_best, struct bgp_info *old_best, struct bgp_mp_list *mp_list, afi_t afi, safi_t safi) {
 	u_int16_t maxpaths, mpath_count, old_mpath_count;
-	struct listnode *mp_node, *mp_next_node;
+	u_int32_t mp_index;
+	struct bgp_info *mp_node;
 	struct bgp_info *cur_mpath, *new_mpath, *next_mpath, *prev_mpath;
 	int mpath_changed, debug;
 	char pfx_buf[INET6_ADDRSTRLEN], nh_buf[2][INET6_ADDRSTRLEN];
@@ -395,7 +498,8 @@ void bgp_info_mpath_update(struct bgp_node *rn, struct bgp_info *new_best, struc
 	cur_mpath = NULL;
 	old_mpath_count = 0;
 	prev_mpath = new_best;
-	mp_node = listhead(mp_list);
+	mp_index = 0;
+	mp_node = mp_list->count ? mp_list->paths[0] : NULL;
 
 	debug = BGP_DEBUG(events, EVENTS);
 
@@ -440,15 +544,13 @@ void bgp_info_mpath_update(struct bgp_node *rn, struct bgp_info *new_best, struc
 			break;
 		}
 
-		mp_next_node = mp_node ? listnextnode(mp_node) : NULL;
 		next_mpath = cur_mpath ? bgp_info_mpath_next(cur_mpath) : NULL;
 
 		/*
        * If equal, the path was a multipath and is still a multipath.
        * Insert onto new multipath list if maxpaths allows.
        */
-		if(mp_node && (listgetdata(mp_node) == cur_mpath)) {
-			list_delete_node(mp_list, mp_node);
+		if(mp_node && (mp_node == cur_mpath)) {
 			bgp_info_mpath_dequeue(cur_mpath);
 			if((mpath_count < maxpaths) && bgp_info_nexthop_cmp(prev_mpath, cur_mpath)) {
 				bgp_info_mpath_enqueue(prev_mpath, cur_mpath);
@@ -463,12 +565,12 @@ void bgp_info_mpath_update(struct bgp_node *rn, struct bgp_info *new_best, struc
 					);
 				}
 			}
-			mp_node = mp_next_node;
+			mp_node = ++mp_index < mp_list->count ? mp_list->paths[mp_index] : NULL;
 			cur_mpath = next_mpath;
 			continue;
 		}
 
-		if(cur_mpath && (!mp_node || (bgp_info_mpath_cmp(cur_mpath, listgetdata(mp_node)) < 0))) {
+		if(cur_mpath && (!mp_node || (bgp_info_mpath_cmp(cur_mpath, mp_node) < 0))) {
 			/*
            * If here, we have an old multipath and either the mp_list
            * is finished or the next mp_node points to a later
@@ -493,8 +595,7 @@ void bgp_info_mpath_update(struct bgp_node *rn, struct bgp_info *new_best, struc
            *   point to the multipath after this one
            * - Dequeue the path from the multipath list just to make sure
            */
-			new_mpath = listgetdata(mp_node);
-			list_delete_node(mp_list, mp_node);
+			new_mpath = mp_node;
 			if((mpath_count < maxpaths) && (new_mpath != new_best) && bgp_info_nexthop_cmp(prev_mpath, new_mpath)) {
 				if(new_mpath == next_mpath) {
 					next_mpath = bgp_info_mpath_next(new_mpath);
@@ -511,7 +612,7 @@ void bgp_info_mpath_update(struct bgp_node *rn, struct bgp_info *new_best, struc
 					);
 				}
 			}
-			mp_node = mp_next_node;
+			mp_node = ++mp_index < mp_list->count ? mp_list->paths[mp_index] : NULL;
 		}
 	}
 
@@ -547,73 +648,23 @@ void bgp_mp_dmed_deselect(struct bgp_info *dmed_best) {
 }
 
 /*
- * bgp_info_mpath_aggregate_update
+ * bgp_info_mpath_aggregate
  *
- * Set the multipath aggregate attribute. We need to see if the
- * aggregate has changed and then set the ATTR_CHANGED flag on the
- * bestpath info so that a peer update will be generated. The
- * change is detected by generating the current attribute,
- * interning it, and then comparing the interned pointer with the
- * current value. We can skip this generate/compare step if there
- * is no change in multipath selection and no attribute change in
- * any multipath.
+ * Aggregate the attributes of the best path and its multipaths into
+ * the attribute the multipath route is advertised with, interned
  */
-void bgp_info_mpath_aggregate_update(struct bgp_info *new_best, struct bgp_info *old_best) {
+static struct attr *bgp_info_mpath_aggregate(struct bgp_info *new_best) {
 	struct bgp_info *mpinfo;
 	struct aspath *aspath;
 	struct aspath *asmerge;
-	struct attr *new_attr, *old_attr;
-	u_char origin, attr_chg;
+	struct attr *new_attr;
+	u_char origin;
 	struct community *community, *commerge;
 	struct ecommunity *ecomm, *ecommerge;
 	struct lcommunity *lcomm, *lcommerge;
 	struct attr_extra *ae;
 	struct attr attr = { 0 };
 
-	if(old_best && (old_best != new_best) && (old_attr = bgp_info_mpath_attr(old_best))) {
-		bgp_attr_unintern(&old_attr);
-		bgp_info_mpath_attr_set(old_best, NULL);
-	}
-
-	if(!new_best) {
-		return;
-	}
-
-	if(!bgp_info_mpath_count(new_best)) {
-		if((new_attr = bgp_info_mpath_attr(new_best))) {
-			bgp_attr_unintern(&new_attr);
-			bgp_info_mpath_attr_set(new_best, NULL);
-			SET_FLAG(new_best->flags, BGP_INFO_ATTR_CHANGED);
-		}
-		return;
-	}
-
-	/*
-   * Bail out here if the following is true:
-   * - MULTIPATH_CHG bit is not set on new_best, and
-   * - No change in bestpath, and
-   * - ATTR_CHANGED bit is not set on new_best or any of the multipaths
-   */
-	if(!CHECK_FLAG(new_best->flags, BGP_INFO_MULTIPATH_CHG) && (old_best == new_best)) {
-		attr_chg = 0;
-
-		if(CHECK_FLAG(new_best->flags, BGP_INFO_ATTR_CHANGED)) {
-			attr_chg = 1;
-		} else {
-			for(mpinfo = bgp_info_mpath_first(new_best); mpinfo; mpinfo = bgp_info_mpath_next(mpinfo)) {
-				if(CHECK_FLAG(mpinfo->flags, BGP_INFO_ATTR_CHANGED)) {
-					attr_chg = 1;
-					break;
-				}
-			}
-		}
-
-		if(!attr_chg) {
-			assert(bgp_info_mpath_attr(new_best));
-			return;
-		}
-	}
-
 	bgp_attr_dup(&attr, new_best->attr);
 
 	/* aggregate attribute from multipath constituents */
@@ -689,13 +740,103 @@ void bgp_info_mpath_aggregate_update(struct bgp_info *new_best, struct bgp_info
 	new_attr = bgp_attr_intern(&attr);
 	bgp_attr_extra_free(&attr);
 
-	if(new_attr != bgp_info_mpath_attr(new_best)) {
-		if((old_attr = bgp_info_mpath_attr(new_best))) {
-			bgp_attr_unintern(&old_attr);
+	return new_attr;
+}
+
+/* Attributes bgp_info_mpath_aggregate_update() keys the aggregate by
+ * on the stack */
+#define BGP_MPATH_AGG_STACK 16
+
+/*
+ * bgp_info_mpath_aggregate_update
+ *
+ * Set the multipath aggregate attribute. We need to see if the
+ * aggregate has changed and then set the ATTR_CHANGED flag on the
+ * bestpath info so that a peer update will be generated. The
+ * aggregate is looked up by the attributes of the best path and its
+ * multipaths, and only worked out when no other best path has those.
+ * We can skip the lookup if there is no change in multipath selection
+ * and no attribute change in any multipath.
+ */
+void bgp_info_mpath_aggregate_update(struct bgp_info *new_best, struct bgp_info *old_best) {
+	struct bgp_info *mpinfo;
+	struct bgp_info_mpath *mpath;
+	struct bgp_mpath_agg key;
+	struct bgp_mpath_agg *agg;
+	struct attr *members[BGP_MPATH_AGG_STACK];
+	u_char attr_chg;
+
+	if(old_best && (old_best != new_best) && (mpath = bgp_info_mpath(old_best)) && mpath->mp_agg) {
+		bgp_mpath_agg_release(&mpath->mp_agg);
+	}
+
+	if(!new_best) {
+		return;
+	}
+
+	mpath = bgp_info_mpath(new_best);
+	if(!bgp_info_mpath_count(new_best)) {
+		if(mpath && mpath->mp_agg) {
+			bgp_mpath_agg_release(&mpath->mp_agg);
+			SET_FLAG(new_best->flags, BGP_INFO_ATTR_CHANGED);
+		}
+		return;
+	}
+
+	/*
+   * Bail out here if the following is true:
+   * - MULTIPATH_CHG bit is not set on new_best, and
+   * - No change in bestpath, and
+   * - ATTR_CHANGED bit is not set on new_best or any of the multipaths
+   */
+	if(!CHECK_FLAG(new_best->flags, BGP_INFO_MULTIPATH_CHG) && (old_best == new_best)) {
+		attr_chg = 0;
+
+		if(CHECK_FLAG(new_best->flags, BGP_INFO_ATTR_CHANGED)) {
+			attr_chg = 1;
+		} else {
+			for(mpinfo = bgp_info_mpath_first(new_best); mpinfo; mpinfo = bgp_info_mpath_next(mpinfo)) {
+				if(CHECK_FLAG(mpinfo->flags, BGP_INFO_ATTR_CHANGED)) {
+					attr_chg = 1;
+					break;
+				}
+			}
+		}
+
+		if(!attr_chg) {
+			assert(bgp_info_mpath_attr(new_best));
+			return;
 		}
-		bgp_info_mpath_attr_set(new_best, new_attr);
+	}
+
+	key.count = bgp_info_mpath_count(new_best) + 1;
+	key.members = key.count > BGP_MPATH_AGG_STACK ? XMALLOC(MTYPE_TMP, key.count * sizeof(struct attr *)) : members;
+	key.count = 0;
+	key.members[key.count++] = new_best->attr;
+	for(mpinfo = bgp_info_mpath_first(new_best); mpinfo; mpinfo = bgp_info_mpath_next(mpinfo)) {
+		key.members[key.count++] = mpinfo->attr;
+	}
+
+	if(!bgp_mpath_agg_hash) {
+		bgp_mpath_agg_hash = hash_create(bgp_mpath_agg_key, bgp_mpath_agg_cmp);
+	}
+	agg = hash_get(bgp_mpath_agg_hash, &key, bgp_mpath_agg_alloc);
+	if(!agg->attr) {
+		agg->attr = bgp_info_mpath_aggregate(new_best);
+	}
+	if(key.members != members) {
+		XFREE(MTYPE_TMP, key.members);
+	}
+
+	if(agg == mpath->mp_agg) {
+		return;
+	}
+	agg->refcnt++;
+	if(!mpath->mp_agg || mpath->mp_agg->attr != agg->attr) {
 		SET_FLAG(new_best->flags, BGP_INFO_ATTR_CHANGED);
-	} else {
-		bgp_attr_unintern(&new_attr);
 	}
+	if(mpath->mp_agg) {
+		bgp_mpath_agg_release(&mpath->mp_agg);
+	}
+	mpath->mp_agg = agg;
 }
@@ -44,7 +44,20 @@ struct bgp_info_mpath {
 	u_int32_t mp_count;
 
 	/* Aggregated attribute for advertising multipath route */
-	struct attr *mp_attr;
+	struct bgp_mpath_agg *mp_agg;
+};
+
+/* Paths that compare equal to the best, as bgp_best_selection finds
+ * them, in bgp_info_mpath_cmp order.  Held in an array on the stack,
+ * which only more candidates than that move to the heap.
+ */
+#define BGP_MP_LIST_STACK 16
+
+struct bgp_mp_list {
+	struct bgp_info **paths;
+	u_int32_t count;
+	u_int32_t size;
+	struct bgp_info *stack[BGP_MP_LIST_STACK];
 };
 
 /* Functions to support maximum-paths configuration */
@@ -56,11 +69,11 @@ bool bgp_mpath_is_configured(struct bgp *, afi_t, safi_t);
 /* Functions used by bgp_best_selection to record current
  * multipath selections
  */
-extern void bgp_mp_list_init(struct list *);
-extern void bgp_mp_list_clear(struct list *);
-extern void bgp_mp_list_add(struct list *, struct bgp_info *);
+extern void bgp_mp_list_init(struct bgp_mp_list *);
+extern void bgp_mp_list_clear(struct bgp_mp_list *);
+extern void bgp_mp_list_add(struct bgp_mp_list *, struct bgp_info *);
 extern void bgp_mp_dmed_deselect(struct bgp_info *);
-extern void bgp_info_mpath_update(struct bgp_node *, struct bgp_info *, struct bgp_info *, struct list *, afi_t, safi_t);
+extern void bgp_info_mpath_update(struct bgp_node *, struct bgp_info *, struct bgp_info *, struct bgp_mp_list *, afi_t, safi_t);
 extern void bgp_info_mpath_aggregate_update(struct bgp_info *, struct bgp_info *);
 
 /* Unlink and free multipath information associated with a bgp_info */
@@ -183,9 +183,9 @@ int bgp_nlri_parse_vpn(struct peer *peer, struct attr *attr, struct bgp_nlri *pa
 		memcpy(&p.u.prefix, pnt + VPN_PREFIXLEN_MIN_BYTES, psize - VPN_PREFIXLEN_MIN_BYTES);
 
 		if(attr) {
-			bgp_update(peer, &p, attr, packet->afi, SAFI_MPLS_VPN, ZEBRA_ROUTE_BGP, BGP_ROUTE_NORMAL, &prd, tagpnt, 0);
+			bgp_update(peer, &p, 0, attr, packet->afi, SAFI_MPLS_VPN, ZEBRA_ROUTE_BGP, BGP_ROUTE_NORMAL, &prd, tagpnt, 0);
 		} else {
-			bgp_withdraw(peer, &p, attr, packet->afi, SAFI_MPLS_VPN, ZEBRA_ROUTE_BGP, BGP_ROUTE_NORMAL, &prd, tagpnt);
+			bgp_withdraw(peer, &p, 0, attr, packet->afi, SAFI_MPLS_VPN, ZEBRA_ROUTE_BGP, BGP_ROUTE_NORMAL, &prd, tagpnt);
 		}
 	}
 	/* Packet length consistency check. */
@@ -369,11 +369,7 @@ static int show_adj_route_vpn(struct vty *vty, struct peer *peer, struct prefix_
 		return CMD_WARNING;
 	}
 
-	for(rn = bgp_table_top(bgp->rib[AFI_IP][SAFI_MPLS_VPN]); rn; rn = bgp_route_next(rn)) {
-		if(prd && memcmp(rn->p.u.val, prd->val, 8) != 0) {
-			continue;
-		}
-
+	for(rn = bgp_rd_top(bgp->rib[AFI_IP][SAFI_MPLS_VPN], prd); rn; rn = bgp_rd_next(rn, prd)) {
 		if((table = rn->info) != NULL) {
 			rd_header = 1;
 
@@ -467,11 +463,7 @@ static int bgp_show_mpls_vpn(struct vty *vty, afi_t afi, struct prefix_rd *prd,
 		return CMD_WARNING;
 	}
 
-	for(rn = bgp_table_top(bgp->rib[afi][SAFI_MPLS_VPN]); rn; rn = bgp_route_next(rn)) {
-		if(prd && memcmp(rn->p.u.val, prd->val, 8) != 0) {
-			continue;
-		}
-
+	for(rn = bgp_rd_top(bgp->rib[afi][SAFI_MPLS_VPN], prd); rn; rn = bgp_rd_next(rn, prd)) {
 		if((table = rn->info) != NULL) {
 			rd_header = 1;
 
@@ -135,6 +135,28 @@ static void bgp_update_sock_send_buffer_size(int fd) {
 	}
 }
 
+/* Socket buffers as configured for the peer, or the default send buffer.
+ * The receive buffer's size scales the window offered when connecting, so
+ * it is set ahead of connect(); accepted sockets have theirs from the
+ * listener's to begin with.  Updates are written only as the peer takes
+ * them, not queued up in the kernel: see BGP_SOCKET_NOTSENT_LOWAT. */
+void bgp_set_socket_buffers(struct peer *peer, int bgp_sock) {
+	if(bgp_sock < 0) {
+		return;
+	}
+
+	if(CHECK_FLAG(peer->config, PEER_CONFIG_SNDBUF)) {
+		setsockopt_so_sendbuf(bgp_sock, peer->sndbuf);
+	} else {
+		bgp_update_sock_send_buffer_size(bgp_sock);
+	}
+	if(CHECK_FLAG(peer->config, PEER_CONFIG_RCVBUF)) {
+		setsockopt_so_recvbuf(bgp_sock, peer->rcvbuf);
+	}
+
+	sockopt_tcp_notsent_lowat(bgp_sock, BGP_SOCKET_NOTSENT_LOWAT);
+}
+
 void bgp_set_socket_ttl(struct peer *peer, int bgp_sock) {
 	char buf[INET_ADDRSTRLEN];
 	int ret, ttl, minttl;
@@ -188,9 +210,6 @@ static int bgp_accept(struct thread *thread) {
 	}
 	set_nonblocking(bgp_sock);
 
-	/* Set socket send buffer size */
-	bgp_update_sock_send_buffer_size(bgp_sock);
-
 	if(BGP_DEBUG(events, EVENTS)) {
 		zlog_debug("[Event] BGP connection from host %s:%d", inet_sutop(&su, buf), sockunion_get_port(&su));
 	}
@@ -212,6 +231,7 @@ static int bgp_accept(struct thread *thread) {
 		return -1;
 	}
 
+	bgp_set_socket_buffers(peer1, bgp_sock);
 	bgp_set_socket_ttl(peer1, bgp_sock);
 
 	/* Make dummy peer until read Open packet. */
@@ -222,8 +242,7 @@ static int bgp_accept(struct thread *thread) {
 	{
 		char buf[SU_ADDRSTRLEN];
 
-		peer = peer_create_accept(peer1->bgp);
-		peer->su = su;
+		peer = peer_create_accept(peer1->bgp, &su);
 		peer->fd = bgp_sock;
 		peer->status = Active;
 
@@ -350,8 +369,7 @@ int bgp_connect(struct peer *peer) {
 
 	set_nonblocking(peer->fd);
 
-	/* Set socket send buffer size */
-	bgp_update_sock_send_buffer_size(peer->fd);
+	bgp_set_socket_buffers(peer, peer->fd);
 
 	bgp_set_socket_ttl(peer, peer->fd);
 
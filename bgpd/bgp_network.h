@@ -24,12 +24,17 @@ Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
 
 #define BGP_SOCKET_SNDBUF_SIZE 65536
 
+/* Unsent data the kernel takes from bgp_write() at most, see
+   sockopt_tcp_notsent_lowat() */
+#define BGP_SOCKET_NOTSENT_LOWAT 65536
+
 extern int bgp_socket(unsigned short, const char *);
 extern void bgp_close(void);
 extern int bgp_connect(struct peer *);
 extern void bgp_getsockname(struct peer *);
 
 extern void bgp_set_socket_ttl(struct peer *peer, int bgp_sock);
+extern void bgp_set_socket_buffers(struct peer *peer, int bgp_sock);
 extern int bgp_md5_set(struct peer *);
 
 #endif /* _QUAGGA_BGP_NETWORK_H */
@@ -50,6 +50,11 @@ struct bgp_nexthop_cache {
 #define BGP_NEXTHOP_METRIC_CHANGED (1 << 1)
 #define BGP_NEXTHOP_CONNECTED_CHANGED (1 << 2)
 
+	/* Nexthop group routes through it are installed with in zebra (0
+	 * for none yet), and the zebra connection it was last sent on */
+	u_int32_t nhg_id;
+	int nhg_connect;
+
 	struct bgp_node *node;
 	void *nht_info; /* In BGP, peer session */
 	LIST_HEAD(path_list, bgp_info) paths;
@@ -129,6 +129,7 @@ static void bgp_unlink_nexthop_check(struct bgp_nexthop_cache *bnc) {
 			zlog_debug("bgp_unlink_nexthop: freeing bnc %s", bnc_str(bnc, buf, INET6_ADDRSTRLEN));
 		}
 		unregister_nexthop(bnc);
+		bgp_zebra_nhg_delete(bnc);
 		bnc->node->info = NULL;
 		bgp_unlock_node(bnc->node);
 		bnc->node = NULL;
@@ -205,6 +206,7 @@ int bgp_ensure_nexthop(struct bgp_info *ri, struct peer *peer, int connected) {
 		} else if(ri->extra) {
 			ri->extra->igpmetric = 0;
 		}
+		bgp_info_key_update(ri);
 	} else if(peer) {
 		bnc->nht_info = (void *) peer; /* NHT peer reference */
 	}
@@ -340,6 +342,12 @@ void bgp_parse_nexthop_update(void) {
 		bnc->nexthop = NULL;
 	}
 
+	/* Move the routes installed through the nexthop's group first, what
+	 * best path selection then makes of the change comes after. */
+	if(bnc->nhg_id && CHECK_FLAG(bnc->change_flags, BGP_NEXTHOP_CHANGED)) {
+		bgp_zebra_nhg_update(bnc);
+	}
+
 	evaluate_paths(bnc);
 }
 
@@ -456,6 +464,50 @@ static void unregister_nexthop(struct bgp_nexthop_cache *bnc) {
 	sendmsg_nexthop(bnc, ZEBRA_NEXTHOP_UNREGISTER);
 }
 
+/* Bring one path up to date with its nexthop, and have its node
+ * processed where that can make a difference.  */
+static void evaluate_path(struct bgp *bgp, struct bgp_nexthop_cache *bnc, struct bgp_info *path) {
+	struct bgp_node *rn = path->net;
+	int afi = family2afi(rn->p.family);
+	int valid_changed = 0;
+
+	/* Path becomes valid/invalid depending on whether the nexthop
+     * reachable/unreachable.
+     */
+	if((CHECK_FLAG(path->flags, BGP_INFO_VALID) ? 1 : 0) != (CHECK_FLAG(bnc->flags, BGP_NEXTHOP_VALID) ? 1 : 0)) {
+		if(CHECK_FLAG(path->flags, BGP_INFO_VALID)) {
+			bgp_aggregate_decrement(bgp, &rn->p, path, afi, SAFI_UNICAST);
+			bgp_info_unset_flag(rn, path, BGP_INFO_VALID);
+		} else {
+			bgp_info_set_flag(rn, path, BGP_INFO_VALID);
+			bgp_aggregate_increment(bgp, &rn->p, path, afi, SAFI_UNICAST);
+		}
+		valid_changed = 1;
+	}
+
+	/* Copy the metric to the path. Will be used for bestpath computation */
+	if(CHECK_FLAG(bnc->flags, BGP_NEXTHOP_VALID) && bnc->metric) {
+		(bgp_info_extra_get(path))->igpmetric = bnc->metric;
+	} else if(path->extra) {
+		path->extra->igpmetric = 0;
+	}
+	bgp_info_key_update(path);
+
+	if(!valid_changed) {
+		/* nothing about the nexthop that matters here has moved */
+		if(!CHECK_FLAG(bnc->change_flags, BGP_NEXTHOP_METRIC_CHANGED | BGP_NEXTHOP_CHANGED)) {
+			return;
+		}
+		/* only the metric, which can't get the path selected */
+		if(!CHECK_FLAG(bnc->change_flags, BGP_NEXTHOP_CHANGED) && !bgp_info_igp_metric_matters(bgp, rn, path)) {
+			return;
+		}
+	}
+
+	SET_FLAG(path->flags, BGP_INFO_IGP_CHANGED);
+	bgp_process_path(bgp, rn, path, afi, SAFI_UNICAST);
+}
+
 /**
  * evaluate_paths - Evaluate the paths/nets associated with a nexthop.
  * ARGUMENTS:
@@ -464,45 +516,23 @@ static void unregister_nexthop(struct bgp_nexthop_cache *bnc) {
  *   void.
  */
 static void evaluate_paths(struct bgp_nexthop_cache *bnc) {
-	struct bgp_node *rn;
 	struct bgp_info *path;
 	struct bgp *bgp = bgp_get_default();
-	int afi;
 	struct peer *peer = (struct peer *) bnc->nht_info;
+	int selected;
 
-	LIST_FOREACH(path, &(bnc->paths), nh_thread) {
-		if(!(path->type == ZEBRA_ROUTE_BGP && path->sub_type == BGP_ROUTE_NORMAL)) {
-			continue;
-		}
-
-		rn = path->net;
-		afi = family2afi(rn->p.family);
-
-		/* Path becomes valid/invalid depending on whether the nexthop
-       * reachable/unreachable.
-       */
-		if((CHECK_FLAG(path->flags, BGP_INFO_VALID) ? 1 : 0) != (CHECK_FLAG(bnc->flags, BGP_NEXTHOP_VALID) ? 1 : 0)) {
-			if(CHECK_FLAG(path->flags, BGP_INFO_VALID)) {
-				bgp_aggregate_decrement(bgp, &rn->p, path, afi, SAFI_UNICAST);
-				bgp_info_unset_flag(rn, path, BGP_INFO_VALID);
-			} else {
-				bgp_info_set_flag(rn, path, BGP_INFO_VALID);
-				bgp_aggregate_increment(bgp, &rn->p, path, afi, SAFI_UNICAST);
+	/* Selected and multipaths first, what is forwarded on goes ahead of
+     any other path for the process queue. */
+	for(selected = 1; selected >= 0; selected--) {
+		LIST_FOREACH(path, &(bnc->paths), nh_thread) {
+			if(!(path->type == ZEBRA_ROUTE_BGP && path->sub_type == BGP_ROUTE_NORMAL)) {
+				continue;
 			}
+			if((CHECK_FLAG(path->flags, BGP_INFO_SELECTED | BGP_INFO_MULTIPATH) ? 1 : 0) != selected) {
+				continue;
+			}
+			evaluate_path(bgp, bnc, path);
 		}
-
-		/* Copy the metric to the path. Will be used for bestpath computation */
-		if(CHECK_FLAG(bnc->flags, BGP_NEXTHOP_VALID) && bnc->metric) {
-			(bgp_info_extra_get(path))->igpmetric = bnc->metric;
-		} else if(path->extra) {
-			path->extra->igpmetric = 0;
-		}
-
-		if(CHECK_FLAG(bnc->flags, BGP_NEXTHOP_METRIC_CHANGED) || CHECK_FLAG(bnc->flags, BGP_NEXTHOP_CHANGED)) {
-			SET_FLAG(path->flags, BGP_INFO_IGP_CHANGED);
-		}
-
-		bgp_process(bgp, rn, afi, SAFI_UNICAST);
 	}
 
 	if(peer && !CHECK_FLAG(bnc->flags, BGP_NEXTHOP_PEER_NOTIFIED)) {
@@ -38,6 +38,7 @@ Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
 #include "bgpd/bgp_open.h"
 #include "bgpd/bgp_aspath.h"
 #include "bgpd/bgp_vty.h"
+#include "bgpd/bgp_rtc.h"
 
 /* BGP-4 Multiprotocol Extentions lead us to the complex world. We can
    negotiate remote peer supports extentions or not. But if
@@ -83,6 +84,7 @@ void bgp_capability_vty_out(struct vty *vty, struct peer *peer) {
 				case SAFI_MULTICAST: vty_out(vty, "SAFI Multicast"); break;
 				case SAFI_MPLS_LABELED_VPN: vty_out(vty, "SAFI MPLS-labeled VPN"); break;
 				case SAFI_ENCAP: vty_out(vty, "SAFI ENCAP"); break;
+				case SAFI_RT_CONSTRAIN: vty_out(vty, "SAFI RT Constrain"); break;
 				default: vty_out(vty, "SAFI Unknown %d ", mpc.safi); break;
 			}
 			vty_out(vty, "%s", VTY_NEWLINE);
@@ -135,6 +137,12 @@ static int bgp_capability_mp(struct peer *peer, struct capability_header *hdr) {
 		zlog_debug("%s OPEN has MP_EXT CAP for afi/safi: %u/%u", peer->host, mpc.afi, mpc.safi);
 	}
 
+	/* RT membership has no table, just VPNv4's capability bits */
+	if(mpc.afi == AFI_IP && mpc.safi == SAFI_RT_CONSTRAIN) {
+		SET_FLAG(peer->af_cap[AFI_IP][SAFI_MPLS_VPN], PEER_CAP_RTC_RCV);
+		return CHECK_FLAG(peer->af_flags[AFI_IP][SAFI_MPLS_VPN], PEER_FLAG_RT_CONSTRAIN) ? 0 : -1;
+	}
+
 	if(!bgp_afi_safi_valid_indices(mpc.afi, &mpc.safi)) {
 		return -1;
 	}
@@ -332,6 +340,40 @@ static int bgp_capability_restart(struct peer *peer, struct capability_header *c
 	return 0;
 }
 
+static int bgp_capability_addpath(struct peer *peer, struct capability_header *hdr) {
+	struct stream *s = BGP_INPUT(peer);
+	size_t end = stream_get_getp(s) + hdr->length;
+
+	while(stream_get_getp(s) + CAPABILITY_CODE_ADDPATH_LEN <= end) {
+		afi_t afi = stream_getw(s);
+		safi_t safi = stream_getc(s);
+		u_char send_receive = stream_getc(s);
+
+		if(!bgp_afi_safi_valid_indices(afi, &safi) || !BGP_ADDPATH_SAFI(safi) || !peer->afc[afi][safi]) {
+			if(BGP_DEBUG(normal, NORMAL)) {
+				zlog_debug(
+					"%s Addr-family %d/%d(afi/safi) not supported or not enabled."
+					" Ignore the Add-Path capability for it",
+					peer->host, afi, safi
+				);
+			}
+			continue;
+		}
+
+		if(BGP_DEBUG(normal, NORMAL)) {
+			zlog_debug("%s OPEN has Add-Path %s%s%s for %s", peer->host, CHECK_FLAG(send_receive, ADDPATH_SEND) ? "send" : "", CHECK_FLAG(send_receive, ADDPATH_SEND | ADDPATH_RECEIVE) == (ADDPATH_SEND | ADDPATH_RECEIVE) ? "/" : "", CHECK_FLAG(send_receive, ADDPATH_RECEIVE) ? "receive" : "", afi_safi_print(afi, safi));
+		}
+
+		if(CHECK_FLAG(send_receive, ADDPATH_SEND)) {
+			SET_FLAG(peer->af_cap[afi][safi], PEER_CAP_ADDPATH_AF_TX_RCV);
+		}
+		if(CHECK_FLAG(send_receive, ADDPATH_RECEIVE)) {
+			SET_FLAG(peer->af_cap[afi][safi], PEER_CAP_ADDPATH_AF_RX_RCV);
+		}
+	}
+	return 0;
+}
+
 static as_t bgp_capability_as4(struct peer *peer, struct capability_header *hdr) {
 	SET_FLAG(peer->cap, PEER_CAP_AS4_RCV);
 
@@ -352,9 +394,11 @@ static const struct message capcode_str[] = {
 	{CAPABILITY_CODE_MP,	      "MultiProtocol Extensions"	 },
 	    { CAPABILITY_CODE_REFRESH,     "Route Refresh"	       },
 	  { CAPABILITY_CODE_ORF,	 "Cooperative Route Filtering"},
+	{ CAPABILITY_CODE_EXT_MESSAGE, "Extended Message"		 },
 	  { CAPABILITY_CODE_RESTART,     "Graceful Restart"		},
 	{ CAPABILITY_CODE_AS4,	       "4-octet AS number"	   },
 	    { CAPABILITY_CODE_DYNAMIC,     "Dynamic"			 },
+	{ CAPABILITY_CODE_ADDPATH,     "Add-Path"			 },
 	  { CAPABILITY_CODE_REFRESH_OLD, "Route Refresh (Old)"	       },
 	  { CAPABILITY_CODE_ORF_OLD,     "ORF (Old)"			 },
 };
@@ -365,9 +409,11 @@ static const size_t cap_minsizes[] = {
 	[CAPABILITY_CODE_MP] = CAPABILITY_CODE_MP_LEN,
 	[CAPABILITY_CODE_REFRESH] = CAPABILITY_CODE_REFRESH_LEN,
 	[CAPABILITY_CODE_ORF] = CAPABILITY_CODE_ORF_LEN,
+	[CAPABILITY_CODE_EXT_MESSAGE] = CAPABILITY_CODE_EXT_MESSAGE_LEN,
 	[CAPABILITY_CODE_RESTART] = CAPABILITY_CODE_RESTART_LEN,
 	[CAPABILITY_CODE_AS4] = CAPABILITY_CODE_AS4_LEN,
 	[CAPABILITY_CODE_DYNAMIC] = CAPABILITY_CODE_DYNAMIC_LEN,
+	[CAPABILITY_CODE_ADDPATH] = CAPABILITY_CODE_ADDPATH_LEN,
 	[CAPABILITY_CODE_REFRESH_OLD] = CAPABILITY_CODE_REFRESH_LEN,
 	[CAPABILITY_CODE_ORF_OLD] = CAPABILITY_CODE_ORF_LEN,
 };
@@ -380,6 +426,7 @@ static const size_t cap_minsizes[] = {
 static const size_t cap_modsizes[] = {
 	[CAPABILITY_CODE_MP] = 4,  [CAPABILITY_CODE_REFRESH] = 1, [CAPABILITY_CODE_ORF] = 1,	     [CAPABILITY_CODE_RESTART] = 1,
 	[CAPABILITY_CODE_AS4] = 4, [CAPABILITY_CODE_DYNAMIC] = 1, [CAPABILITY_CODE_REFRESH_OLD] = 1, [CAPABILITY_CODE_ORF_OLD] = 1,
+	[CAPABILITY_CODE_EXT_MESSAGE] = 1, [CAPABILITY_CODE_ADDPATH] = CAPABILITY_CODE_ADDPATH_LEN,
 };
 
 /**
@@ -433,6 +480,8 @@ static int bgp_capability_parse(struct peer *peer, size_t length, int *mp_capabi
 			case CAPABILITY_CODE_RESTART:
 			case CAPABILITY_CODE_AS4:
 			case CAPABILITY_CODE_DYNAMIC:
+			case CAPABILITY_CODE_EXT_MESSAGE:
+			case CAPABILITY_CODE_ADDPATH:
 				/* Check length. */
 				if(caphdr.length < cap_minsizes[caphdr.code]) {
 					zlog_info(
@@ -498,6 +547,12 @@ static int bgp_capability_parse(struct peer *peer, size_t length, int *mp_capabi
 				}
 				break;
 			case CAPABILITY_CODE_DYNAMIC: SET_FLAG(peer->cap, PEER_CAP_DYNAMIC_RCV); break;
+			case CAPABILITY_CODE_EXT_MESSAGE: SET_FLAG(peer->cap, PEER_CAP_EXTENDED_MSG_RCV); break;
+			case CAPABILITY_CODE_ADDPATH:
+				if(bgp_capability_addpath(peer, &caphdr)) {
+					return -1;
+				}
+				break;
 			case CAPABILITY_CODE_AS4:
 				/* Already handled as a special-case parsing of the capabilities
                * at the beginning of OPEN processing. So we care not a jot
@@ -783,6 +838,51 @@ static void bgp_open_capability_orf(struct stream *s, struct peer *peer, afi_t a
 	stream_putc_at(s, capp, cap_len);
 }
 
+static void bgp_open_capability_addpath(struct stream *s, struct peer *peer) {
+	afi_t afi;
+	safi_t safi;
+	u_char send_receive;
+	unsigned long capp = 0;
+
+	for(afi = AFI_IP; afi < AFI_MAX; afi++) {
+		for(safi = SAFI_UNICAST; safi < SAFI_MAX; safi++) {
+			if(!peer->afc[afi][safi] || !BGP_ADDPATH_SAFI(safi)) {
+				continue;
+			}
+
+			send_receive = 0;
+			if(CHECK_FLAG(peer->af_flags[afi][safi], PEER_FLAG_ADDPATH_TX_ALL_PATHS | PEER_FLAG_ADDPATH_TX_MULTIPATH)) {
+				SET_FLAG(peer->af_cap[afi][safi], PEER_CAP_ADDPATH_AF_TX_ADV);
+				send_receive |= ADDPATH_SEND;
+			}
+			if(CHECK_FLAG(peer->af_flags[afi][safi], PEER_FLAG_ADDPATH_RX)) {
+				SET_FLAG(peer->af_cap[afi][safi], PEER_CAP_ADDPATH_AF_RX_ADV);
+				send_receive |= ADDPATH_RECEIVE;
+			}
+			if(!send_receive) {
+				continue;
+			}
+
+			/* One capability for all the address families */
+			if(!capp) {
+				stream_putc(s, BGP_OPEN_OPT_CAP);
+				capp = stream_get_endp(s);
+				stream_putc(s, 0);
+				stream_putc(s, CAPABILITY_CODE_ADDPATH);
+				stream_putc(s, 0);
+			}
+			stream_putw(s, afi);
+			stream_putc(s, safi);
+			stream_putc(s, send_receive);
+		}
+	}
+
+	if(capp) {
+		stream_putc_at(s, capp, stream_get_endp(s) - capp - 1);
+		stream_putc_at(s, capp + 2, stream_get_endp(s) - capp - 3);
+	}
+}
+
 /* Fill in capability open option to the packet. */
 void bgp_open_capability(struct stream *s, struct peer *peer) {
 	u_char len;
@@ -847,6 +947,17 @@ void bgp_open_capability(struct stream *s, struct peer *peer) {
 		stream_putc(s, 0);
 		stream_putc(s, SAFI_ENCAP);
 	}
+	/* IPv4 RT membership, with VPNv4 */
+	if(peer->afc[AFI_IP][SAFI_MPLS_VPN] && CHECK_FLAG(peer->af_flags[AFI_IP][SAFI_MPLS_VPN], PEER_FLAG_RT_CONSTRAIN)) {
+		SET_FLAG(peer->af_cap[AFI_IP][SAFI_MPLS_VPN], PEER_CAP_RTC_ADV);
+		stream_putc(s, BGP_OPEN_OPT_CAP);
+		stream_putc(s, CAPABILITY_CODE_MP_LEN + 2);
+		stream_putc(s, CAPABILITY_CODE_MP);
+		stream_putc(s, CAPABILITY_CODE_MP_LEN);
+		stream_putw(s, AFI_IP);
+		stream_putc(s, 0);
+		stream_putc(s, SAFI_RT_CONSTRAIN);
+	}
 	/* IPv6 unicast. */
 	if(peer->afc[AFI_IP6][SAFI_UNICAST]) {
 		peer->afc_adv[AFI_IP6][SAFI_UNICAST] = 1;
@@ -935,6 +1046,18 @@ void bgp_open_capability(struct stream *s, struct peer *peer) {
 		stream_putc(s, CAPABILITY_CODE_DYNAMIC_LEN);
 	}
 
+	/* Extended message, RFC 8654. */
+	if(CHECK_FLAG(peer->flags, PEER_FLAG_EXTENDED_MESSAGE)) {
+		SET_FLAG(peer->cap, PEER_CAP_EXTENDED_MSG_ADV);
+		stream_putc(s, BGP_OPEN_OPT_CAP);
+		stream_putc(s, CAPABILITY_CODE_EXT_MESSAGE_LEN + 2);
+		stream_putc(s, CAPABILITY_CODE_EXT_MESSAGE);
+		stream_putc(s, CAPABILITY_CODE_EXT_MESSAGE_LEN);
+	}
+
+	/* Add-Path, RFC 7911 */
+	bgp_open_capability_addpath(s, peer);
+
 	/* Sending base graceful-restart capability irrespective of the config */
 	SET_FLAG(peer->cap, PEER_CAP_RESTART_ADV);
 	stream_putc(s, BGP_OPEN_OPT_CAP);
@@ -68,9 +68,11 @@ struct capability_gr {
 #define CAPABILITY_CODE_MP 1		/* Multiprotocol Extensions */
 #define CAPABILITY_CODE_REFRESH 2	/* Route Refresh Capability */
 #define CAPABILITY_CODE_ORF 3		/* Cooperative Route Filtering Capability */
+#define CAPABILITY_CODE_EXT_MESSAGE 6	/* Extended Message Support */
 #define CAPABILITY_CODE_RESTART 64	/* Graceful Restart Capability */
 #define CAPABILITY_CODE_AS4 65		/* 4-octet AS number Capability */
 #define CAPABILITY_CODE_DYNAMIC 66	/* Dynamic Capability */
+#define CAPABILITY_CODE_ADDPATH 69	/* Add-Path Capability */
 #define CAPABILITY_CODE_REFRESH_OLD 128 /* Route Refresh Capability(cisco) */
 #define CAPABILITY_CODE_ORF_OLD 130	/* Cooperative Route Filtering Capability(cisco) */
 
@@ -78,9 +80,11 @@ struct capability_gr {
 #define CAPABILITY_CODE_MP_LEN 4
 #define CAPABILITY_CODE_REFRESH_LEN 0
 #define CAPABILITY_CODE_DYNAMIC_LEN 0
+#define CAPABILITY_CODE_EXT_MESSAGE_LEN 0
 #define CAPABILITY_CODE_RESTART_LEN 2 /* Receiving only case */
 #define CAPABILITY_CODE_AS4_LEN 4
 #define CAPABILITY_CODE_ORF_LEN 5
+#define CAPABILITY_CODE_ADDPATH_LEN 4 /* per AFI/SAFI */
 
 /* Cooperative Route Filtering Capability.  */
 
@@ -97,6 +101,10 @@ struct capability_gr {
 #define CAPABILITY_ACTION_SET 0
 #define CAPABILITY_ACTION_UNSET 1
 
+/* Add-Path send/receive field */
+#define ADDPATH_RECEIVE 1
+#define ADDPATH_SEND 2
+
 /* Graceful Restart */
 #define RESTART_R_BIT 0x8000
 #define RESTART_F_BIT 0x80
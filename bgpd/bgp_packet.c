@@ -33,6 +33,7 @@ Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
 #include "linklist.h"
 #include "plist.h"
 #include "filter.h"
+#include "trace.h"
 
 #include "bgpd/bgpd.h"
 #include "bgpd/bgp_table.h"
@@ -51,6 +52,10 @@ Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
 #include "bgpd/bgp_encap.h"
 #include "bgpd/bgp_advertise.h"
 #include "bgpd/bgp_vty.h"
+#include "bgpd/bgp_updgrp.h"
+#include "bgpd/bgp_io.h"
+#include "bgpd/bgp_rtc.h"
+#include "bgpd/bgp_arena.h"
 
 int stream_put_prefix(struct stream *, struct prefix *);
 
@@ -143,6 +148,8 @@ static struct stream *bgp_update_packet(struct peer *peer, afi_t afi, safi_t saf
 	int space_needed = 0;
 	size_t mpattrlen_pos = 0;
 	size_t mpattr_pos = 0;
+	struct timeval queued;
+	int addpath = BGP_ADDPATH_TX(peer, afi, safi);
 
 	s = peer->work;
 	stream_reset(s);
@@ -150,6 +157,9 @@ static struct stream *bgp_update_packet(struct peer *peer, afi_t afi, safi_t saf
 	stream_reset(snlri);
 
 	adv = BGP_ADV_FIFO_HEAD(&peer->sync[afi][safi]->update);
+	if(adv) {
+		queued = adv->queued; /* the oldest change */
+	}
 
 	while(adv) {
 		assert(adv->rn);
@@ -159,8 +169,8 @@ static struct stream *bgp_update_packet(struct peer *peer, afi_t afi, safi_t saf
 			binfo = adv->binfo;
 		}
 
-		space_remaining = STREAM_CONCAT_REMAIN(s, snlri, STREAM_SIZE(s)) - BGP_MAX_PACKET_SIZE_OVERFLOW;
-		space_needed = BGP_NLRI_LENGTH + bgp_packet_mpattr_prefix_size(afi, safi, &rn->p);
+		space_remaining = STREAM_CONCAT_REMAIN(s, snlri, peer->max_packet_size);
+		space_needed = BGP_NLRI_LENGTH + bgp_packet_mpattr_prefix_size(afi, safi, &rn->p) + (addpath ? BGP_ADDPATH_ID_LEN : 0);
 
 		/* When remaining space can't include NLRI and it's length.  */
 		if(space_remaining < space_needed) {
@@ -173,8 +183,8 @@ static struct stream *bgp_update_packet(struct peer *peer, afi_t afi, safi_t saf
 			u_char *tag = NULL;
 			struct peer *from = NULL;
 
-			if(rn->prn) {
-				prd = (struct prefix_rd *) &rn->prn->p;
+			if(bgp_node_prn(rn)) {
+				prd = (struct prefix_rd *) &bgp_node_prn(rn)->p;
 			}
 			if(binfo) {
 				from = binfo->peer;
@@ -202,10 +212,9 @@ static struct stream *bgp_update_packet(struct peer *peer, afi_t afi, safi_t saf
 			mpattr_pos = stream_get_endp(s);
 
 			/* 5: Encode all the attributes, except MP_REACH_NLRI attr. */
-			total_attr_len = bgp_packet_attribute(NULL, peer, s, adv->baa->attr, ((afi == AFI_IP && safi == SAFI_UNICAST) ? &rn->p : NULL), afi, safi, from, prd, tag);
-			space_remaining = STREAM_CONCAT_REMAIN(s, snlri, STREAM_SIZE(s)) - BGP_MAX_PACKET_SIZE_OVERFLOW;
-			space_needed = BGP_NLRI_LENGTH + bgp_packet_mpattr_prefix_size(afi, safi, &rn->p);
-			;
+			total_attr_len = bgp_updgrp_packet_attribute(peer, s, adv->baa->attr, ((afi == AFI_IP && safi == SAFI_UNICAST) ? &rn->p : NULL), afi, safi, from, prd, tag);
+			space_remaining = STREAM_CONCAT_REMAIN(s, snlri, peer->max_packet_size);
+			space_needed = BGP_NLRI_LENGTH + bgp_packet_mpattr_prefix_size(afi, safi, &rn->p) + (addpath ? BGP_ADDPATH_ID_LEN : 0);
 
 			/* If the attributes alone do not leave any room for NLRI then
            * return */
@@ -224,14 +233,17 @@ static struct stream *bgp_update_packet(struct peer *peer, afi_t afi, safi_t saf
 		}
 
 		if(afi == AFI_IP && safi == SAFI_UNICAST) {
+			if(addpath) {
+				stream_putl(s, adj->addpath_tx_id);
+			}
 			stream_put_prefix(s, &rn->p);
 		} else {
 			/* Encode the prefix in MP_REACH_NLRI attribute */
 			struct prefix_rd *prd = NULL;
 			u_char *tag = NULL;
 
-			if(rn->prn) {
-				prd = (struct prefix_rd *) &rn->prn->p;
+			if(bgp_node_prn(rn)) {
+				prd = (struct prefix_rd *) &bgp_node_prn(rn)->p;
 			}
 			if(binfo && binfo->extra) {
 				tag = binfo->extra->tag;
@@ -240,6 +252,9 @@ static struct stream *bgp_update_packet(struct peer *peer, afi_t afi, safi_t saf
 			if(stream_empty(snlri)) {
 				mpattrlen_pos = bgp_packet_mpattr_start(snlri, afi, safi, adv->baa->attr);
 			}
+			if(addpath) {
+				stream_putl(snlri, adj->addpath_tx_id);
+			}
 			bgp_packet_mpattr_prefix(snlri, afi, safi, &rn->p, prd, tag);
 		}
 		if(BGP_DEBUG(update, UPDATE_OUT)) {
@@ -258,6 +273,9 @@ static struct stream *bgp_update_packet(struct peer *peer, afi_t afi, safi_t saf
 		adj->attr = bgp_attr_intern(adv->baa->attr);
 
 		adv = bgp_advertise_clean(peer, adj, afi, safi);
+
+		/* Hand the adj-out back to the peer's update-group, if it can */
+		bgp_adj_out_fold(rn, adj, peer, afi, safi);
 	}
 
 	if(!stream_empty(s)) {
@@ -276,6 +294,7 @@ static struct stream *bgp_update_packet(struct peer *peer, afi_t afi, safi_t saf
 		}
 		bgp_packet_set_size(packet);
 		bgp_packet_add(peer, packet);
+		peer_lag_add(&peer->lag_out, &queued);
 		BGP_WRITE_ON(peer->t_write, bgp_write, peer->fd);
 		stream_reset(s);
 		stream_reset(snlri);
@@ -345,17 +364,31 @@ static struct stream *bgp_withdraw_packet(struct peer *peer, afi_t afi, safi_t s
 	u_char first_time = 1;
 	int space_remaining = 0;
 	int space_needed = 0;
+	struct timeval queued;
+	int addpath = BGP_ADDPATH_TX(peer, afi, safi);
 
 	s = peer->work;
 	stream_reset(s);
 
+	if((adv = BGP_ADV_FIFO_HEAD(&peer->sync[afi][safi]->withdraw)) != NULL) {
+		queued = adv->queued;
+	}
+
 	while((adv = BGP_ADV_FIFO_HEAD(&peer->sync[afi][safi]->withdraw)) != NULL) {
 		assert(adv->rn);
 		adj = adv->adj;
 		rn = adv->rn;
 
-		space_remaining = STREAM_REMAIN(s) - BGP_MAX_PACKET_SIZE_OVERFLOW;
-		space_needed = (BGP_NLRI_LENGTH + BGP_TOTAL_ATTR_LEN + bgp_packet_mpattr_prefix_size(afi, safi, &rn->p));
+		/* Fill the message right up: besides the prefix, room is only
+		 * kept for what's still to be written around it. */
+		space_remaining = peer->max_packet_size - stream_get_endp(s);
+		space_needed = BGP_NLRI_LENGTH + BGP_TOTAL_ATTR_LEN + bgp_packet_mpattr_prefix_size(afi, safi, &rn->p) + (addpath ? BGP_ADDPATH_ID_LEN : 0);
+		if(stream_empty(s)) {
+			space_needed += BGP_HEADER_SIZE + BGP_UNFEASIBLE_LEN;
+			if(!(afi == AFI_IP && safi == SAFI_UNICAST)) {
+				space_needed += BGP_WITHDRAW_MPUNREACH_LEN;
+			}
+		}
 
 		if(space_remaining < space_needed) {
 			break;
@@ -369,12 +402,15 @@ static struct stream *bgp_withdraw_packet(struct peer *peer, afi_t afi, safi_t s
 		}
 
 		if(afi == AFI_IP && safi == SAFI_UNICAST) {
+			if(addpath) {
+				stream_putl(s, adj->addpath_tx_id);
+			}
 			stream_put_prefix(s, &rn->p);
 		} else {
 			struct prefix_rd *prd = NULL;
 
-			if(rn->prn) {
-				prd = (struct prefix_rd *) &rn->prn->p;
+			if(bgp_node_prn(rn)) {
+				prd = (struct prefix_rd *) &bgp_node_prn(rn)->p;
 			}
 
 			/* If first time, format the MP_UNREACH header */
@@ -386,6 +422,9 @@ static struct stream *bgp_withdraw_packet(struct peer *peer, afi_t afi, safi_t s
 				mplen_pos = bgp_packet_mpunreach_start(s, afi, safi);
 			}
 
+			if(addpath) {
+				stream_putl(s, adj->addpath_tx_id);
+			}
 			bgp_packet_mpunreach_prefix(s, &rn->p, afi, safi, prd, NULL);
 		}
 
@@ -417,6 +456,7 @@ static struct stream *bgp_withdraw_packet(struct peer *peer, afi_t afi, safi_t s
 		bgp_packet_set_size(s);
 		packet = stream_dup(s);
 		bgp_packet_add(peer, packet);
+		peer_lag_add(&peer->lag_out, &queued);
 		stream_reset(s);
 		return packet;
 	}
@@ -466,8 +506,12 @@ void bgp_default_update_send(struct peer *peer, struct attr *attr, afi_t afi, sa
 	/* Set Total Path Attribute Length. */
 	stream_putw_at(s, pos, total_attr_len);
 
-	/* NLRI set. */
+	/* NLRI set.  The default route goes out to Add-Path peers as path 0,
+	   which no path from the RIB is given. */
 	if(p.family == AF_INET && safi == SAFI_UNICAST) {
+		if(BGP_ADDPATH_TX(peer, afi, safi)) {
+			stream_putl(s, 0);
+		}
 		stream_put_prefix(s, &p);
 	}
 
@@ -524,6 +568,9 @@ void bgp_default_withdraw_send(struct peer *peer, afi_t afi, safi_t safi) {
 
 	/* Withdrawn Routes. */
 	if(p.family == AF_INET && safi == SAFI_UNICAST) {
+		if(BGP_ADDPATH_TX(peer, afi, safi)) {
+			stream_putl(s, 0);
+		}
 		stream_put_prefix(s, &p);
 
 		unfeasible_len = stream_get_endp(s) - cp - 2;
@@ -538,6 +585,9 @@ void bgp_default_withdraw_send(struct peer *peer, afi_t afi, safi_t safi) {
 		stream_putw(s, 0);
 		mp_start = stream_get_endp(s);
 		mplen_pos = bgp_packet_mpunreach_start(s, afi, safi);
+		if(BGP_ADDPATH_TX(peer, afi, safi)) {
+			stream_putl(s, 0);
+		}
 		bgp_packet_mpunreach_prefix(s, &p, afi, safi, NULL, NULL);
 
 		/* Set the mp_unreach attr's length */
@@ -556,22 +606,104 @@ void bgp_default_withdraw_send(struct peer *peer, afi_t afi, safi_t safi) {
 	BGP_WRITE_ON(peer->t_write, bgp_write, peer->fd);
 }
 
+/* Ask an RT constrain peer for every VPN route: the default RT
+   membership, then the End-of-RIB of RT memberships. */
+void bgp_rtc_default_send(struct peer *peer) {
+	struct stream *s;
+	struct attr attr;
+	unsigned long pos;
+	bgp_size_t total_attr_len;
+
+	if(DISABLE_BGP_ANNOUNCE) {
+		return;
+	}
+
+	if(BGP_DEBUG(update, UPDATE_OUT)) {
+		zlog(peer->log, LOG_DEBUG, "%s send UPDATE default RT membership", peer->host);
+	}
+
+	bgp_attr_default_set(&attr, BGP_ORIGIN_IGP);
+
+	s = stream_new(BGP_MAX_PACKET_SIZE);
+
+	/* Make BGP update packet. */
+	bgp_packet_set_marker(s, BGP_MSG_UPDATE);
+
+	/* Unfeasible Routes Length. */
+	stream_putw(s, 0);
+
+	/* Make place for total attribute length.  */
+	pos = stream_get_endp(s);
+	stream_putw(s, 0);
+	total_attr_len = bgp_packet_attribute(NULL, peer, s, &attr, NULL, AFI_IP, SAFI_MPLS_VPN, NULL, NULL, NULL);
+
+	/* MP_REACH_NLRI with our address and the zero length membership */
+	stream_putc(s, BGP_ATTR_FLAG_OPTIONAL);
+	stream_putc(s, BGP_ATTR_MP_REACH_NLRI);
+	stream_putc(s, 10);
+	stream_putw(s, AFI_IP);
+	stream_putc(s, SAFI_RT_CONSTRAIN);
+	stream_putc(s, IPV4_MAX_BYTELEN);
+	stream_put_in_addr(s, &peer->nexthop.v4);
+	stream_putc(s, 0); /* SNPA */
+	stream_putc(s, 0);
+	total_attr_len += 13;
+
+	/* Set Total Path Attribute Length. */
+	stream_putw_at(s, pos, total_attr_len);
+
+	bgp_packet_set_size(s);
+	bgp_packet_add(peer, s);
+
+	bgp_update_packet_eor(peer, AFI_IP, SAFI_RT_CONSTRAIN);
+
+	bgp_attr_extra_free(&attr);
+	aspath_unintern(&attr.aspath);
+
+	BGP_WRITE_ON(peer->t_write, bgp_write, peer->fd);
+}
+
+/* Longest withdrawn prefix of an AFI/SAFI, with its length octet */
+static int bgp_withdraw_prefix_max(afi_t afi, safi_t safi) {
+	int size = BGP_NLRI_LENGTH + ((afi == AFI_IP6) ? IPV6_MAX_BYTELEN : IPV4_MAX_BYTELEN);
+
+	if(safi == SAFI_MPLS_VPN || safi == SAFI_ENCAP) {
+		size += 3 + 8; /* label, RD */
+	}
+	return size;
+}
+
+/* Whether withdraws queued for an AFI/SAFI should go out now.  While
+ * best paths are still being worked out, e.g. after a peer went down,
+ * more are likely to follow: short of a full message they wait for the
+ * process queues to run dry, and bgp_write_deferred().  Under churn that
+ * doesn't let up the queues may never run dry, so they wait no longer
+ * than the next route advertisement run either. */
+static int bgp_withdraw_due(struct peer *peer, afi_t afi, safi_t safi) {
+	struct fifo *fifo = &peer->sync[afi][safi]->withdraw;
+	struct bgp_advertise *adv;
+
+	if((adv = BGP_ADV_FIFO_HEAD(fifo)) == NULL) {
+		return 0;
+	}
+	if(!bgp_process_busy() || adv->queued.tv_sec < peer->synctime) {
+		return 1;
+	}
+	return fifo->count >= (peer->max_packet_size - BGP_HEADER_SIZE - BGP_UNFEASIBLE_LEN - BGP_TOTAL_ATTR_LEN - BGP_WITHDRAW_MPUNREACH_LEN) / bgp_withdraw_prefix_max(afi, safi);
+}
+
 /* Get next packet to be written.  */
-static struct stream *bgp_write_packet(struct peer *peer) {
+/* Build the next withdraw/update packet onto the end of obuf, if any
+   is due. */
+static struct stream *bgp_write_packet_new(struct peer *peer) {
 	afi_t afi;
 	safi_t safi;
 	struct stream *s = NULL;
 	struct bgp_advertise *adv;
 
-	s = stream_fifo_head(peer->obuf);
-	if(s) {
-		return s;
-	}
-
 	for(afi = AFI_IP; afi < AFI_MAX; afi++) {
 		for(safi = SAFI_UNICAST; safi < SAFI_MAX; safi++) {
-			adv = BGP_ADV_FIFO_HEAD(&peer->sync[afi][safi]->withdraw);
-			if(adv) {
+			if(bgp_withdraw_due(peer, afi, safi)) {
 				s = bgp_withdraw_packet(peer, afi, safi);
 				if(s) {
 					return s;
@@ -602,7 +734,7 @@ static struct stream *bgp_write_packet(struct peer *peer) {
 			}
 
 			if(CHECK_FLAG(peer->cap, PEER_CAP_RESTART_RCV)) {
-				if(peer->afc_nego[afi][safi] && peer->synctime && !CHECK_FLAG(peer->af_sflags[afi][safi], PEER_STATUS_EOR_SEND) && safi != SAFI_MPLS_VPN) {
+				if(peer->afc_nego[afi][safi] && peer->synctime && !CHECK_FLAG(peer->af_sflags[afi][safi], PEER_STATUS_EOR_SEND) && safi != SAFI_MPLS_VPN && !peer->announce_walk[afi][safi]) {
 					SET_FLAG(peer->af_sflags[afi][safi], PEER_STATUS_EOR_SEND);
 					return bgp_update_packet_eor(peer, afi, safi);
 				}
@@ -613,6 +745,17 @@ static struct stream *bgp_write_packet(struct peer *peer) {
 	return NULL;
 }
 
+/* Head of obuf, or else the next packet built from the adj-out. */
+static struct stream *bgp_write_packet(struct peer *peer) {
+	struct stream *s;
+
+	s = stream_fifo_head(peer->obuf);
+	if(s) {
+		return s;
+	}
+	return bgp_write_packet_new(peer);
+}
+
 /* Is there partially written packet or updates we can send right
    now.  */
 static int bgp_write_proceed(struct peer *peer) {
@@ -626,7 +769,7 @@ static int bgp_write_proceed(struct peer *peer) {
 
 	for(afi = AFI_IP; afi < AFI_MAX; afi++) {
 		for(safi = SAFI_UNICAST; safi < SAFI_MAX; safi++) {
-			if(FIFO_HEAD(&peer->sync[afi][safi]->withdraw)) {
+			if(bgp_withdraw_due(peer, afi, safi)) {
 				return 1;
 			}
 		}
@@ -645,6 +788,66 @@ static int bgp_write_proceed(struct peer *peer) {
 	return 0;
 }
 
+void bgp_queue_depth(struct peer *peer, struct bgp_queue_depth *depth) {
+	struct stream *s;
+	afi_t afi;
+	safi_t safi;
+	int unread;
+
+	memset(depth, 0, sizeof(struct bgp_queue_depth));
+
+	if(peer->io) {
+		depth->in_packets = bgp_io_rx_queued(peer->io);
+		depth->out_packets = bgp_io_tx_queued(peer->io, &depth->out_bytes);
+	}
+	if(peer->fd >= 0 && ioctl(peer->fd, FIONREAD, &unread) == 0) {
+		depth->in_bytes = unread;
+	}
+
+	for(s = stream_fifo_head(peer->obuf); s; s = s->next) {
+		depth->out_packets++;
+		depth->out_bytes += stream_get_endp(s) - stream_get_getp(s);
+	}
+
+	for(afi = AFI_IP; afi < AFI_MAX; afi++) {
+		for(safi = SAFI_UNICAST; safi < SAFI_MAX; safi++) {
+			if(peer->sync[afi][safi]) {
+				depth->adv += peer->sync[afi][safi]->update.count + peer->sync[afi][safi]->withdraw.count + peer->sync[afi][safi]->withdraw_low.count;
+			}
+		}
+	}
+}
+
+/* Count a packet sent in full, returning its type. */
+u_char bgp_packet_sent(struct peer *peer, struct stream *s) {
+	u_char type = stream_getc_from(s, BGP_MARKER_SIZE + 2);
+
+	switch(type) {
+		case BGP_MSG_OPEN: peer->open_out++; break;
+		case BGP_MSG_UPDATE: peer->update_out++; break;
+		case BGP_MSG_NOTIFY: peer->notify_out++; break;
+		case BGP_MSG_KEEPALIVE: peer->keepalive_out++; break;
+		case BGP_MSG_ROUTE_REFRESH_NEW:
+		case BGP_MSG_ROUTE_REFRESH_OLD: peer->refresh_out++; break;
+		case BGP_MSG_CAPABILITY: peer->dynamic_cap_out++; break;
+	}
+	return type;
+}
+
+/* Queue what's due to go out onto the I/O thread's ring. */
+void bgp_io_flush(struct peer *peer) {
+	int queued = 0;
+
+	while(!bgp_io_tx_full(peer->io) && bgp_write_packet(peer) != NULL) {
+		bgp_io_tx_push(peer->io, stream_fifo_pop(peer->obuf));
+		queued = 1;
+	}
+
+	if(queued) {
+		bgp_io_kick(peer->io);
+	}
+}
+
 /* Write packet to the peer. */
 int bgp_write(struct thread *thread) {
 	struct peer *peer;
@@ -657,6 +860,12 @@ int bgp_write(struct thread *thread) {
 	peer = THREAD_ARG(thread);
 	peer->t_write = NULL;
 
+	/* The I/O thread does the writing */
+	if(peer->io) {
+		bgp_io_flush(peer);
+		return 0;
+	}
+
 	/* For non-blocking IO check. */
 	if(peer->status == Connect) {
 		bgp_connect_check(peer);
@@ -670,15 +879,15 @@ int bgp_write(struct thread *thread) {
 
 	sockopt_cork(peer->fd, 1);
 
-	/* Nonblocking write until TCP output buffer is full.  */
+	/* Nonblocking write until the socket takes no more: once what waits
+	   to be sent reaches BGP_SOCKET_NOTSENT_LOWAT, where it has that. */
 	do {
-		int writenum;
-
-		/* Number of bytes to be sent.  */
-		writenum = stream_get_endp(s) - stream_get_getp(s);
+		/* Build what's due up front, so it all goes in one writev(). */
+		while(peer->obuf->count < BGP_WRITE_PACKET_MAX - count && bgp_write_packet_new(peer)) {
+			;
+		}
 
-		/* Call write() system call.  */
-		num = write(peer->fd, STREAM_PNT(s), writenum);
+		num = stream_fifo_flush(peer->obuf, peer->fd, BGP_WRITE_PACKET_MAX - count);
 		if(num < 0) {
 			/* write failed either retry needed or error */
 			if(ERRNO_IO_RETRY(errno)) {
@@ -689,35 +898,25 @@ int bgp_write(struct thread *thread) {
 			return 0;
 		}
 
-		if(num != writenum) {
-			/* Partial write */
-			stream_forward_getp(s, num);
-			break;
-		}
-
-		/* Retrieve BGP packet type. */
-		stream_set_getp(s, BGP_MARKER_SIZE + 2);
-		type = stream_getc(s);
-
-		switch(type) {
-			case BGP_MSG_OPEN: peer->open_out++; break;
-			case BGP_MSG_UPDATE: peer->update_out++; break;
-			case BGP_MSG_NOTIFY:
-				peer->notify_out++;
-
+		/* Account for, and delete, the packets sent in full. */
+		while((s = stream_fifo_head(peer->obuf)) != NULL && !STREAM_READABLE(s)) {
+			type = bgp_packet_sent(peer, s);
+			if(type == BGP_MSG_NOTIFY) {
 				/* Flush any existing events */
 				BGP_EVENT_ADD(peer, BGP_Stop_with_error);
 				goto done;
+			}
 
-			case BGP_MSG_KEEPALIVE: peer->keepalive_out++; break;
-			case BGP_MSG_ROUTE_REFRESH_NEW:
-			case BGP_MSG_ROUTE_REFRESH_OLD: peer->refresh_out++; break;
-			case BGP_MSG_CAPABILITY: peer->dynamic_cap_out++; break;
+			/* OK we send packet so delete it. */
+			bgp_packet_delete(peer);
+			count++;
 		}
 
-		/* OK we send packet so delete it. */
-		bgp_packet_delete(peer);
-	} while(++count < BGP_WRITE_PACKET_MAX && (s = bgp_write_packet(peer)) != NULL);
+		/* Partial write */
+		if(s && stream_get_getp(s) > 0) {
+			break;
+		}
+	} while(count < BGP_WRITE_PACKET_MAX && bgp_write_packet(peer) != NULL);
 
 	if(bgp_write_proceed(peer)) {
 		BGP_WRITE_ON(peer->t_write, bgp_write, peer->fd);
@@ -728,6 +927,51 @@ done:
 	return 0;
 }
 
+/* Best-path processing has caught up: send the withdraws it held back */
+void bgp_write_deferred(void) {
+	struct listnode *node, *nnode;
+	struct listnode *pnode, *pnnode;
+	struct bgp *bgp;
+	struct peer *peer;
+	afi_t afi;
+	safi_t safi;
+
+	for(ALL_LIST_ELEMENTS(bm->bgp, node, nnode, bgp)) {
+		for(ALL_LIST_ELEMENTS(bgp->peer, pnode, pnnode, peer)) {
+			if(peer->status != Established) {
+				continue;
+			}
+			for(afi = AFI_IP; afi < AFI_MAX; afi++) {
+				for(safi = SAFI_UNICAST; safi < SAFI_MAX; safi++) {
+					if(BGP_ADV_FIFO_HEAD(&peer->sync[afi][safi]->withdraw)) {
+						BGP_WRITE_ON(peer->t_write, bgp_write, peer->fd);
+						goto next;
+					}
+				}
+			}
+		next:;
+		}
+	}
+}
+
+/* Take messages of up to size octets from the peer, and send them, with
+ * the buffers sized to match.  Only for a session coming up: nothing is
+ * built in work or scratch across callbacks, and what ibuf may hold of
+ * the peer's next message already is within size. */
+void bgp_packet_size_set(struct peer *peer, bgp_size_t size) {
+	peer->max_packet_size = size;
+
+	if(STREAM_SIZE(peer->ibuf) != size) {
+		stream_resize(peer->ibuf, size);
+	}
+	if(STREAM_SIZE(peer->work) != (size_t) size + BGP_MAX_PACKET_SIZE_OVERFLOW) {
+		stream_resize(peer->work, (size_t) size + BGP_MAX_PACKET_SIZE_OVERFLOW);
+	}
+	if(STREAM_SIZE(peer->scratch) != size) {
+		stream_resize(peer->scratch, size);
+	}
+}
+
 /* This is only for sending NOTIFICATION message to neighbor. */
 static int bgp_write_notify(struct peer *peer) {
 	int ret, val;
@@ -741,6 +985,13 @@ static int bgp_write_notify(struct peer *peer) {
 	}
 	assert(stream_get_endp(s) >= BGP_HEADER_SIZE);
 
+	/* Take the socket back from the I/O thread.  If it was part way
+	 * through a packet, the NOTIFY can't be framed, so don't send it. */
+	if(bgp_io_stop(peer)) {
+		BGP_EVENT_ADD(peer, BGP_Stop_with_error);
+		return 0;
+	}
+
 	/* Stop collecting data within the socket */
 	sockopt_cork(peer->fd, 0);
 
@@ -778,6 +1029,11 @@ void bgp_keepalive_send(struct peer *peer) {
 	struct stream *s;
 	int length;
 
+	/* The I/O thread sends them, when nothing else has gone out */
+	if(peer->io) {
+		return;
+	}
+
 	s = stream_new(BGP_MAX_PACKET_SIZE);
 
 	/* Make keepalive packet. */
@@ -850,6 +1106,13 @@ void bgp_open_send(struct peer *peer) {
 	/* Dump packet if debug option is set. */
 	/* bgp_packet_dump (s); */
 
+	/* Kept for BMP */
+	if(peer->open_sent) {
+		stream_free(peer->open_sent);
+	}
+	peer->open_sent = stream_new(length);
+	stream_put(peer->open_sent, STREAM_DATA(s), length);
+
 	/* Add packet to the peer. */
 	bgp_packet_add(peer, s);
 
@@ -879,6 +1142,15 @@ void bgp_notify_send_with_data(struct peer *peer, u_char code, u_char sub_code,
 	/* Set BGP packet length. */
 	length = bgp_packet_set_size(s);
 
+	/* Kept for BMP */
+	if(peer->status == Established) {
+		if(peer->notify_sent) {
+			stream_free(peer->notify_sent);
+		}
+		peer->notify_sent = stream_new(length);
+		stream_put(peer->notify_sent, STREAM_DATA(s), length);
+	}
+
 	/* Add packet to the peer. */
 	stream_fifo_clean(peer->obuf);
 	bgp_packet_add(peer, s);
@@ -1071,8 +1343,7 @@ void bgp_capability_send(struct peer *peer, afi_t afi, safi_t safi, int capabili
 
 /* RFC1771 6.8 Connection collision detection. */
 static int bgp_collision_detect(struct peer *new, struct in_addr remote_id) {
-	struct peer *peer;
-	struct listnode *node, *nnode;
+	struct peer *peer, *next;
 	struct bgp *bgp;
 
 	bgp = bgp_get_default();
@@ -1089,13 +1360,11 @@ static int bgp_collision_detect(struct peer *new, struct in_addr remote_id) {
      OPEN message, then the local system performs the following
      collision resolution procedure: */
 
-	for(ALL_LIST_ELEMENTS(bgp->peer, node, nnode, peer)) {
+	for(peer = peer_index_lookup(bgp, &new->su); peer; peer = next) {
+		next = peer->su_next;
 		if(peer == new) {
 			continue;
 		}
-		if(!sockunion_same(&peer->su, &new->su)) {
-			continue;
-		}
 
 		/* Unless allowed via configuration, a connection collision with an
          existing BGP connection that is in the Established state causes
@@ -1404,6 +1673,14 @@ static int bgp_open_receive(struct peer *peer, bgp_size_t size) {
 		realpeer->obuf = peer->obuf;
 		peer->obuf = NULL;
 
+		if(peer->open_sent) {
+			if(realpeer->open_sent) {
+				stream_free(realpeer->open_sent);
+			}
+			realpeer->open_sent = peer->open_sent;
+			peer->open_sent = NULL;
+		}
+
 		bool open_deferred = CHECK_FLAG(peer->sflags, PEER_STATUS_OPEN_DEFERRED);
 
 		/* Transfer status. */
@@ -1527,6 +1804,13 @@ static int bgp_open_receive(struct peer *peer, bgp_size_t size) {
 	bgp_getsockname(peer);
 	peer->rtt = sockopt_tcp_rtt(peer->fd);
 
+	/* Kept for BMP */
+	if(peer->open_rcvd) {
+		stream_free(peer->open_rcvd);
+	}
+	peer->open_rcvd = stream_new(peer->packet_size);
+	stream_put(peer->open_rcvd, STREAM_DATA(peer->ibuf), peer->packet_size);
+
 	BGP_EVENT_ADD(peer, Receive_OPEN_message);
 
 	peer->packet_size = 0;
@@ -1545,10 +1829,15 @@ int bgp_nlri_parse(struct peer *peer, struct attr *attr, struct bgp_nlri *packet
 		case SAFI_MPLS_VPN:
 		case SAFI_MPLS_LABELED_VPN: return bgp_nlri_parse_vpn(peer, attr, packet);
 		case SAFI_ENCAP: return bgp_nlri_parse_encap(peer, attr, packet);
+		case SAFI_RT_CONSTRAIN: return bgp_nlri_parse_rtc(peer, attr, packet);
 	}
 	return -1;
 }
 
+/* The I/O thread's slot for the UPDATE being received, if it has
+   decoded its IPv4 prefixes already. */
+static struct bgp_io_slot *bgp_update_decoded;
+
 /* Parse BGP Update packet and make attribute object. */
 static int bgp_update_receive(struct peer *peer, bgp_size_t size) {
 	int ret, nlri_ret;
@@ -1570,6 +1859,8 @@ static int bgp_update_receive(struct peer *peer, bgp_size_t size) {
 	};
 	struct bgp_nlri nlris[NLRI_TYPE_MAX];
 
+	QUAGGA_TRACE(bgp, update_receive, peer->host, size);
+
 	/* Status must be Established. */
 	if(peer->status != Established) {
 		zlog_err("%s [FSM] Update packet received under status %s", peer->host, LOOKUP(bgp_status_msg, peer->status));
@@ -1713,6 +2004,19 @@ static int bgp_update_receive(struct peer *peer, bgp_size_t size) {
 			continue;
 		}
 
+		/* RT membership, which has no indices of its own, see bgp_rtc.c */
+		if(nlris[i].afi == AFI_IP && nlris[i].safi == SAFI_RT_CONSTRAIN) {
+			if(nlris[i].length && bgp_nlri_parse(peer, i == NLRI_MP_UPDATE ? NLRI_ATTR_ARG : NULL, &nlris[i]) < 0) {
+				plog_err(peer->log, "%s [Error] Error parsing NLRI", peer->host);
+				if(peer->status == Established) {
+					bgp_notify_send(peer, BGP_NOTIFY_UPDATE_ERR, BGP_NOTIFY_UPDATE_OPT_ATTR_ERR);
+				}
+				bgp_attr_unintern_sub(&attr);
+				return -1;
+			}
+			continue;
+		}
+
 		/* We use afi and safi as indices into tables and what not.  It would
        * be impossible, at this time, to support unknown afi/safis.  And
        * anyway, the peer needs to be configured to enable the afi/safi
@@ -1745,12 +2049,27 @@ static int bgp_update_receive(struct peer *peer, bgp_size_t size) {
 
 		switch(i) {
 			case NLRI_UPDATE:
+				if(bgp_update_decoded) {
+					nlri_ret = bgp_nlri_parse_ipv4_decoded(peer, NLRI_ATTR_ARG, &nlris[i], bgp_update_decoded->prefix + bgp_update_decoded->withdrawn, bgp_update_decoded->nlri);
+					break;
+				}
+				/* fall through */
 			case NLRI_MP_UPDATE: nlri_ret = bgp_nlri_parse(peer, NLRI_ATTR_ARG, &nlris[i]); break;
 			case NLRI_WITHDRAW:
+				if(bgp_update_decoded) {
+					nlri_ret = bgp_nlri_parse_ipv4_decoded(peer, NULL, &nlris[i], bgp_update_decoded->prefix, bgp_update_decoded->withdrawn);
+					break;
+				}
+				/* fall through */
 			case NLRI_MP_WITHDRAW: nlri_ret = bgp_nlri_parse(peer, NULL, &nlris[i]);
 		}
 
 		if(nlri_ret < 0) {
+			/* maximum-prefix has already sent its Cease */
+			if(CHECK_FLAG(peer->sflags, PEER_STATUS_PREFIX_OVERFLOW)) {
+				bgp_attr_unintern_sub(&attr);
+				return -1;
+			}
 			plog_err(peer->log, "%s [Error] Error parsing NLRI", peer->host);
 			if(peer->status == Established) {
 				bgp_notify_send(peer, BGP_NOTIFY_UPDATE_ERR, i <= NLRI_WITHDRAW ? BGP_NOTIFY_UPDATE_INVAL_NETWORK : BGP_NOTIFY_UPDATE_OPT_ATTR_ERR);
@@ -1796,6 +2115,8 @@ static int bgp_update_receive(struct peer *peer, bgp_size_t size) {
 			if(BGP_DEBUG(normal, NORMAL)) {
 				zlog(peer->log, LOG_DEBUG, "rcvd End-of-RIB for %s from %s", peer->host, afi_safi_print(afi, safi));
 			}
+
+			bgp_update_delay_check(peer->bgp);
 		}
 	}
 
@@ -1898,6 +2219,13 @@ static void bgp_keepalive_receive(struct peer *peer, bgp_size_t size) {
 		zlog_debug("%s KEEPALIVE rcvd", peer->host);
 	}
 
+	/* A keepalive once Established comes after the table, for a peer
+	   that doesn't send End-of-RIB; one that does has sent that too. */
+	if(peer->status == Established && !CHECK_FLAG(peer->sflags, PEER_STATUS_IMPLICIT_EOR)) {
+		SET_FLAG(peer->sflags, PEER_STATUS_IMPLICIT_EOR);
+		bgp_update_delay_check(peer->bgp);
+	}
+
 	BGP_EVENT_ADD(peer, Receive_KEEPALIVE_message);
 }
 
@@ -2215,6 +2543,18 @@ int bgp_capability_receive(struct peer *peer, bgp_size_t size) {
 	return bgp_capability_msg_parse(peer, pnt, size);
 }
 
+/* Note why the session went, when the connection is lost. */
+static void bgp_read_lost(struct peer *peer) {
+	if(peer->status == Established) {
+		if(CHECK_FLAG(peer->sflags, PEER_STATUS_NSF_MODE)) {
+			peer->last_reset = PEER_DOWN_NSF_CLOSE_SESSION;
+			SET_FLAG(peer->sflags, PEER_STATUS_NSF_WAIT);
+		} else {
+			peer->last_reset = PEER_DOWN_CLOSE_SESSION;
+		}
+	}
+}
+
 /* BGP read utility function. */
 static int bgp_read_packet(struct peer *peer) {
 	int nbytes;
@@ -2239,14 +2579,7 @@ static int bgp_read_packet(struct peer *peer) {
 
 		plog_err(peer->log, "%s [Error] bgp_read_packet error: %s", peer->host, safe_strerror(errno));
 
-		if(peer->status == Established) {
-			if(CHECK_FLAG(peer->sflags, PEER_STATUS_NSF_MODE)) {
-				peer->last_reset = PEER_DOWN_NSF_CLOSE_SESSION;
-				SET_FLAG(peer->sflags, PEER_STATUS_NSF_WAIT);
-			} else {
-				peer->last_reset = PEER_DOWN_CLOSE_SESSION;
-			}
-		}
+		bgp_read_lost(peer);
 
 		BGP_EVENT_ADD(peer, TCP_fatal_error);
 		return -1;
@@ -2258,14 +2591,7 @@ static int bgp_read_packet(struct peer *peer) {
 			plog_debug(peer->log, "%s [Event] BGP connection closed fd %d", peer->host, peer->fd);
 		}
 
-		if(peer->status == Established) {
-			if(CHECK_FLAG(peer->sflags, PEER_STATUS_NSF_MODE)) {
-				peer->last_reset = PEER_DOWN_NSF_CLOSE_SESSION;
-				SET_FLAG(peer->sflags, PEER_STATUS_NSF_WAIT);
-			} else {
-				peer->last_reset = PEER_DOWN_CLOSE_SESSION;
-			}
-		}
+		bgp_read_lost(peer);
 
 		BGP_EVENT_ADD(peer, TCP_connection_closed);
 		return -1;
@@ -2299,86 +2625,57 @@ static time_t bgp_recent_clock(void) {
 	return recent_relative_time().tv_sec;
 }
 
-/* Starting point of packet process function. */
-int bgp_read(struct thread *thread) {
-	int ret;
-	u_char type = 0;
-	struct peer *peer;
+/* Check the header at the start of ibuf, setting packet_size from it.
+   Returns -1, having sent a NOTIFY, if it's no good. */
+static int bgp_read_header(struct peer *peer) {
+	u_char type;
 	bgp_size_t size;
 	char notify_data_length[2];
 
-	/* Yes first of all get peer pointer. */
-	peer = THREAD_ARG(thread);
-	peer->t_read = NULL;
+	/* Get size and type. */
+	stream_forward_getp(peer->ibuf, BGP_MARKER_SIZE);
+	memcpy(notify_data_length, stream_pnt(peer->ibuf), 2);
+	size = stream_getw(peer->ibuf);
+	type = stream_getc(peer->ibuf);
 
-	/* For non-blocking IO check. */
-	if(peer->status == Connect) {
-		bgp_connect_check(peer);
-		goto done;
-	} else {
-		if(peer->fd < 0) {
-			zlog_err("bgp_read peer's fd is negative value %d", peer->fd);
-			return -1;
-		}
-		BGP_READ_ON(peer->t_read, bgp_read, peer->fd);
+	if(BGP_DEBUG(normal, NORMAL) && type != 2 && type != 0) {
+		zlog_debug("%s rcv message type %d, length (excl. header) %d", peer->host, type, size - BGP_HEADER_SIZE);
 	}
 
-	/* Read packet header to determine type of the packet */
-	if(peer->packet_size == 0) {
-		peer->packet_size = BGP_HEADER_SIZE;
+	/* Marker check */
+	if(((type == BGP_MSG_OPEN) || (type == BGP_MSG_KEEPALIVE)) && !bgp_marker_all_one(peer->ibuf, BGP_MARKER_SIZE)) {
+		bgp_notify_send(peer, BGP_NOTIFY_HEADER_ERR, BGP_NOTIFY_HEADER_NOT_SYNC);
+		return -1;
 	}
 
-	if(stream_get_endp(peer->ibuf) < BGP_HEADER_SIZE) {
-		ret = bgp_read_packet(peer);
-
-		/* Header read error or partial read packet. */
-		if(ret < 0) {
-			goto done;
-		}
-
-		/* Get size and type. */
-		stream_forward_getp(peer->ibuf, BGP_MARKER_SIZE);
-		memcpy(notify_data_length, stream_pnt(peer->ibuf), 2);
-		size = stream_getw(peer->ibuf);
-		type = stream_getc(peer->ibuf);
-
-		if(BGP_DEBUG(normal, NORMAL) && type != 2 && type != 0) {
-			zlog_debug("%s rcv message type %d, length (excl. header) %d", peer->host, type, size - BGP_HEADER_SIZE);
-		}
-
-		/* Marker check */
-		if(((type == BGP_MSG_OPEN) || (type == BGP_MSG_KEEPALIVE)) && !bgp_marker_all_one(peer->ibuf, BGP_MARKER_SIZE)) {
-			bgp_notify_send(peer, BGP_NOTIFY_HEADER_ERR, BGP_NOTIFY_HEADER_NOT_SYNC);
-			goto done;
-		}
-
-		/* BGP type check. */
-		if(type != BGP_MSG_OPEN && type != BGP_MSG_UPDATE && type != BGP_MSG_NOTIFY && type != BGP_MSG_KEEPALIVE && type != BGP_MSG_ROUTE_REFRESH_NEW && type != BGP_MSG_ROUTE_REFRESH_OLD && type != BGP_MSG_CAPABILITY) {
-			if(BGP_DEBUG(normal, NORMAL)) {
-				plog_debug(peer->log, "%s unknown message type 0x%02x", peer->host, type);
-			}
-			bgp_notify_send_with_data(peer, BGP_NOTIFY_HEADER_ERR, BGP_NOTIFY_HEADER_BAD_MESTYPE, &type, 1);
-			goto done;
+	/* BGP type check. */
+	if(type != BGP_MSG_OPEN && type != BGP_MSG_UPDATE && type != BGP_MSG_NOTIFY && type != BGP_MSG_KEEPALIVE && type != BGP_MSG_ROUTE_REFRESH_NEW && type != BGP_MSG_ROUTE_REFRESH_OLD && type != BGP_MSG_CAPABILITY) {
+		if(BGP_DEBUG(normal, NORMAL)) {
+			plog_debug(peer->log, "%s unknown message type 0x%02x", peer->host, type);
 		}
-		/* Mimimum packet length check. */
-		if((size < BGP_HEADER_SIZE) || (size > BGP_MAX_PACKET_SIZE) || (type == BGP_MSG_OPEN && size < BGP_MSG_OPEN_MIN_SIZE) || (type == BGP_MSG_UPDATE && size < BGP_MSG_UPDATE_MIN_SIZE)
-		   || (type == BGP_MSG_NOTIFY && size < BGP_MSG_NOTIFY_MIN_SIZE) || (type == BGP_MSG_KEEPALIVE && size != BGP_MSG_KEEPALIVE_MIN_SIZE) || (type == BGP_MSG_ROUTE_REFRESH_NEW && size < BGP_MSG_ROUTE_REFRESH_MIN_SIZE)
-		   || (type == BGP_MSG_ROUTE_REFRESH_OLD && size < BGP_MSG_ROUTE_REFRESH_MIN_SIZE) || (type == BGP_MSG_CAPABILITY && size < BGP_MSG_CAPABILITY_MIN_SIZE)) {
-			if(BGP_DEBUG(normal, NORMAL)) {
-				plog_debug(peer->log, "%s bad message length - %d for %s", peer->host, size, type == 128 ? "ROUTE-REFRESH" : bgp_type_str[(int) type]);
-			}
-			bgp_notify_send_with_data(peer, BGP_NOTIFY_HEADER_ERR, BGP_NOTIFY_HEADER_BAD_MESLEN, (u_char *) notify_data_length, 2);
-			goto done;
+		bgp_notify_send_with_data(peer, BGP_NOTIFY_HEADER_ERR, BGP_NOTIFY_HEADER_BAD_MESTYPE, &type, 1);
+		return -1;
+	}
+	/* Mimimum packet length check. */
+	if((size < BGP_HEADER_SIZE) || (size > peer->max_packet_size) || ((type == BGP_MSG_OPEN || type == BGP_MSG_KEEPALIVE) && size > BGP_MAX_PACKET_SIZE) || (type == BGP_MSG_OPEN && size < BGP_MSG_OPEN_MIN_SIZE) || (type == BGP_MSG_UPDATE && size < BGP_MSG_UPDATE_MIN_SIZE)
+	   || (type == BGP_MSG_NOTIFY && size < BGP_MSG_NOTIFY_MIN_SIZE) || (type == BGP_MSG_KEEPALIVE && size != BGP_MSG_KEEPALIVE_MIN_SIZE) || (type == BGP_MSG_ROUTE_REFRESH_NEW && size < BGP_MSG_ROUTE_REFRESH_MIN_SIZE)
+	   || (type == BGP_MSG_ROUTE_REFRESH_OLD && size < BGP_MSG_ROUTE_REFRESH_MIN_SIZE) || (type == BGP_MSG_CAPABILITY && size < BGP_MSG_CAPABILITY_MIN_SIZE)) {
+		if(BGP_DEBUG(normal, NORMAL)) {
+			plog_debug(peer->log, "%s bad message length - %d for %s", peer->host, size, type == 128 ? "ROUTE-REFRESH" : bgp_type_str[(int) type]);
 		}
-
-		/* Adjust size to message length. */
-		peer->packet_size = size;
+		bgp_notify_send_with_data(peer, BGP_NOTIFY_HEADER_ERR, BGP_NOTIFY_HEADER_BAD_MESLEN, (u_char *) notify_data_length, 2);
+		return -1;
 	}
 
-	ret = bgp_read_packet(peer);
-	if(ret < 0) {
-		goto done;
-	}
+	/* Adjust size to message length. */
+	peer->packet_size = size;
+	return 0;
+}
+
+/* Process the whole packet in ibuf, returning its type. */
+static u_char bgp_read_dispatch(struct peer *peer) {
+	u_char type;
+	bgp_size_t size;
 
 	/* Get size and type again. */
 	size = stream_getw_from(peer->ibuf, BGP_MARKER_SIZE);
@@ -2398,6 +2695,8 @@ int bgp_read(struct thread *thread) {
 		case BGP_MSG_UPDATE:
 			peer->readtime = bgp_recent_clock();
 			bgp_update_receive(peer, size);
+			/* all that outlives the UPDATE is interned by now */
+			bgp_arena_reset();
 			break;
 		case BGP_MSG_NOTIFY: bgp_notify_receive(peer, size); break;
 		case BGP_MSG_KEEPALIVE:
@@ -2421,6 +2720,55 @@ int bgp_read(struct thread *thread) {
 		stream_reset(peer->ibuf);
 	}
 
+	return type;
+}
+
+/* Starting point of packet process function. */
+int bgp_read(struct thread *thread) {
+	int ret;
+	struct peer *peer;
+
+	/* Yes first of all get peer pointer. */
+	peer = THREAD_ARG(thread);
+	peer->t_read = NULL;
+
+	/* For non-blocking IO check. */
+	if(peer->status == Connect) {
+		bgp_connect_check(peer);
+		goto done;
+	} else {
+		if(peer->fd < 0) {
+			zlog_err("bgp_read peer's fd is negative value %d", peer->fd);
+			return -1;
+		}
+		BGP_READ_ON(peer->t_read, bgp_read, peer->fd);
+	}
+
+	/* Read packet header to determine type of the packet */
+	if(peer->packet_size == 0) {
+		peer->packet_size = BGP_HEADER_SIZE;
+	}
+
+	if(stream_get_endp(peer->ibuf) < BGP_HEADER_SIZE) {
+		ret = bgp_read_packet(peer);
+
+		/* Header read error or partial read packet. */
+		if(ret < 0) {
+			goto done;
+		}
+
+		if(bgp_read_header(peer) < 0) {
+			goto done;
+		}
+	}
+
+	ret = bgp_read_packet(peer);
+	if(ret < 0) {
+		goto done;
+	}
+
+	bgp_read_dispatch(peer);
+
 done:
 	if(CHECK_FLAG(peer->sflags, PEER_STATUS_ACCEPT_PEER)) {
 		if(BGP_DEBUG(events, EVENTS)) {
@@ -2430,3 +2778,77 @@ done:
 	}
 	return 0;
 }
+
+/* Pick up what the I/O thread has done for the peer: count and free what
+   it has sent, process what it has read, and queue more to send.  Returns
+   1 if it stopped short of all there is to read. */
+int bgp_io_service(struct peer *peer) {
+	struct bgp_io_peer *io = peer->io;
+	struct bgp_io_slot *slot;
+	struct stream *s;
+	unsigned int count = 0;
+	int error, error_errno;
+	u_char type;
+
+	peer->keepalive_out += bgp_io_keepalives(io);
+	while((s = bgp_io_tx_done(io)) != NULL) {
+		bgp_packet_sent(peer, s);
+		stream_free(s);
+	}
+
+	/* Everything read before an error is in the ring once it's set */
+	error = bgp_io_error(io);
+	error_errno = errno;
+
+	while(count < BGP_IO_RX_SLOTS && (slot = bgp_io_rx_peek(io)) != NULL) {
+		stream_reset(peer->ibuf);
+		stream_put(peer->ibuf, slot->data, slot->len);
+		count++;
+
+		/* The slot stays ours, and its prefixes valid, until we move
+		 * on; even if the session goes down under us. */
+		if(bgp_read_header(peer) < 0) {
+			break;
+		}
+		/* path IDs ahead of the prefixes are beyond the I/O thread */
+		bgp_update_decoded = (slot->decoded && !BGP_ADDPATH_RX(peer, AFI_IP, SAFI_UNICAST)) ? slot : NULL;
+		type = bgp_read_dispatch(peer);
+		bgp_update_decoded = NULL;
+
+		if(peer->io != io) {
+			break;
+		}
+		bgp_io_rx_next(io);
+		if(type == BGP_MSG_NOTIFY) {
+			break;
+		}
+	}
+
+	/* The session went down under us */
+	if(peer->io != io) {
+		return 0;
+	}
+
+	if(error && !bgp_io_rx_peek(io)) {
+		if(error == BGP_IO_CLOSED) {
+			if(BGP_DEBUG(events, EVENTS)) {
+				plog_debug(peer->log, "%s [Event] BGP connection closed fd %d", peer->host, peer->fd);
+			}
+			bgp_read_lost(peer);
+			BGP_EVENT_ADD(peer, TCP_connection_closed);
+		} else {
+			plog_err(peer->log, "%s [Error] bgp_io_service error: %s", peer->host, safe_strerror(error_errno));
+			bgp_read_lost(peer);
+			BGP_EVENT_ADD(peer, TCP_fatal_error);
+		}
+		bgp_io_stop(peer);
+		return 0;
+	}
+
+	if(count) {
+		bgp_io_kick(io);
+	}
+	bgp_io_flush(peer);
+
+	return bgp_io_rx_peek(io) != NULL;
+}
@@ -25,6 +25,7 @@ Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
 #define BGP_NLRI_LENGTH 1U
 #define BGP_TOTAL_ATTR_LEN 2U
 #define BGP_UNFEASIBLE_LEN 2U
+#define BGP_WITHDRAW_MPUNREACH_LEN 7U /* MP_UNREACH_NLRI header, AFI, SAFI */
 #define BGP_WRITE_PACKET_MAX 10U
 
 /* When to refresh */
@@ -38,6 +39,15 @@ Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
 #define ORF_COMMON_PART_PERMIT 0x00
 #define ORF_COMMON_PART_DENY 0x20
 
+/* How much a peer has waiting, to read and to write */
+struct bgp_queue_depth {
+	unsigned long in_packets; /* read by an I/O thread, not yet handled */
+	unsigned long in_bytes;	  /* not yet read from the socket */
+	unsigned long out_packets;
+	unsigned long out_bytes;
+	unsigned long adv; /* route changes not yet in an UPDATE */
+};
+
 /* Packet send and receive function prototypes. */
 extern int bgp_read(struct thread *);
 extern int bgp_write(struct thread *);
@@ -50,9 +60,19 @@ extern void bgp_route_refresh_send(struct peer *, afi_t, safi_t, u_char, u_char,
 extern void bgp_capability_send(struct peer *, afi_t, safi_t, int, int);
 extern void bgp_default_update_send(struct peer *, struct attr *, afi_t, safi_t, struct peer *);
 extern void bgp_default_withdraw_send(struct peer *, afi_t, safi_t);
+extern void bgp_rtc_default_send(struct peer *);
 
 extern int bgp_capability_receive(struct peer *, bgp_size_t);
 
+extern u_char bgp_packet_sent(struct peer *, struct stream *);
+extern void bgp_queue_depth(struct peer *, struct bgp_queue_depth *);
+
+/* Main thread side of the I/O threads, see bgp_io.h */
+extern void bgp_io_flush(struct peer *);
+extern void bgp_write_deferred(void);
+extern void bgp_packet_size_set(struct peer *, bgp_size_t);
+extern int bgp_io_service(struct peer *);
+
 extern int bgp_nlri_parse(struct peer *, struct attr *, struct bgp_nlri *);
 
 #endif /* _QUAGGA_BGP_PACKET_H */
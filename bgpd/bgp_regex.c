@@ -25,25 +25,52 @@ Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
 #include "command.h"
 #include "memory.h"
 #include "filter.h"
+#include "hash.h"
+#include "thread.h"
+#include "regex_dfa.h"
 
 #include "bgpd.h"
 #include "bgp_aspath.h"
 #include "bgp_regex.h"
 
+/* Compiled regexes are shared by all the lists using the same pattern,
+   in a cache keyed by the pattern as configured, made on first use.  Each keeps what its
+   matches cost, and is flagged, once, when one took too long or its DFA
+   had to start over. */
+static struct hash *bgp_regex_cache;
+
+/* The engine for patterns compiled from now on, and switched to by those
+   already compiled. */
+static int bgp_regex_engine = BGP_REGEX_ENGINE_POSIX;
+
+/* A regexec() taking this long flags the pattern */
+#define BGP_REGEX_SLOW_USEC 1000
+
+static unsigned int bgp_regex_hash_key(void *p) {
+	struct bgp_regex *regex = p;
+
+	return string_hash_make(regex->str);
+}
+
+static int bgp_regex_hash_cmp(const void *p1, const void *p2) {
+	const struct bgp_regex *regex1 = p1;
+	const struct bgp_regex *regex2 = p2;
+
+	return strcmp(regex1->str, regex2->str) == 0;
+}
+
 /* Character `_' has special mean.  It represents [,{}() ] and the
    beginning of the line(^) and the end of the line ($).
 
    (^|[,{}() ]|$) */
 
-regex_t *bgp_regcomp(const char *regstr) {
+static char *bgp_regex_expand(const char *regstr) {
 	/* Convert _ character to generic regular expression. */
 	int i, j;
 	int len;
 	int magic = 0;
 	char *magic_str;
 	char magic_regexp[] = "(^|[,{}() ]|$)";
-	int ret;
-	regex_t *regex;
 
 	len = strlen(regstr);
 	for(i = 0; i < len; i++) {
@@ -52,7 +79,7 @@ regex_t *bgp_regcomp(const char *regstr) {
 		}
 	}
 
-	magic_str = XMALLOC(MTYPE_TMP, len + (14 * magic) + 1);
+	magic_str = XMALLOC(MTYPE_BGP_REGEXP_STR, len + (14 * magic) + 1);
 
 	for(i = 0, j = 0; i < len; i++) {
 		if(regstr[i] == '_') {
@@ -63,26 +90,338 @@ regex_t *bgp_regcomp(const char *regstr) {
 		}
 	}
 	magic_str[j] = '\0';
+	return magic_str;
+}
 
-	regex = XMALLOC(MTYPE_BGP_REGEXP, sizeof(regex_t));
-
-	ret = regcomp(regex, magic_str, REG_EXTENDED | REG_NOSUB);
+struct bgp_regex *bgp_regcomp(const char *regstr) {
+	struct bgp_regex tmp, *regex;
+	char *magic_str;
 
-	XFREE(MTYPE_TMP, magic_str);
+	if(!bgp_regex_cache) {
+		bgp_regex_cache = hash_create(bgp_regex_hash_key, bgp_regex_hash_cmp);
+	}
+	tmp.str = (char *) regstr;
+	regex = hash_lookup(bgp_regex_cache, &tmp);
+	if(regex) {
+		regex->refcnt++;
+		return regex;
+	}
 
-	if(ret != 0) {
+	magic_str = bgp_regex_expand(regstr);
+	regex = XCALLOC(MTYPE_BGP_REGEXP, sizeof(struct bgp_regex));
+	if(regcomp(&regex->reg, magic_str, REG_EXTENDED | REG_NOSUB) != 0) {
+		XFREE(MTYPE_BGP_REGEXP_STR, magic_str);
 		XFREE(MTYPE_BGP_REGEXP, regex);
 		return NULL;
 	}
 
+	regex->str = XSTRDUP(MTYPE_BGP_REGEXP_STR, regstr);
+	regex->expanded = magic_str;
+	if(bgp_regex_engine == BGP_REGEX_ENGINE_DFA) {
+		regex->dfa = regex_dfa_compile(magic_str);
+	}
+	regex->refcnt = 1;
+	hash_get(bgp_regex_cache, regex, hash_alloc_intern);
 	return regex;
 }
 
-int bgp_regexec(regex_t *regex, struct aspath *aspath) {
-	return regexec(regex, aspath->str, 0, NULL, 0);
+static void bgp_regex_flag(struct bgp_regex *regex, const char *why) {
+	if(!regex->flagged) {
+		regex->flagged = 1;
+		zlog_warn("BGP regexp \"%s\" %s", regex->str, why);
+	}
+}
+
+/* What regexec() returns: 0 if it matches, REG_NOMATCH if not */
+int bgp_regexec_str(struct bgp_regex *regex, const char *str) {
+	struct timeval start, end;
+	unsigned long usec, resets;
+	int ret;
+
+	regex->execs++;
+	if(regex->dfa) {
+		resets = regex_dfa_stats(regex->dfa)->resets;
+		ret = regex_dfa_exec(regex->dfa, str) ? 0 : REG_NOMATCH;
+		if(regex_dfa_stats(regex->dfa)->resets != resets) {
+			bgp_regex_flag(regex, "makes too many DFA states, and is matched slowly");
+		}
+	} else {
+		quagga_gettime(QUAGGA_CLK_MONOTONIC, &start);
+		ret = regexec(&regex->reg, str, 0, NULL, 0);
+		quagga_gettime(QUAGGA_CLK_MONOTONIC, &end);
+
+		usec = timeval_elapsed(end, start);
+		regex->usec += usec;
+		if(usec > regex->usec_max) {
+			regex->usec_max = usec;
+		}
+		if(usec >= BGP_REGEX_SLOW_USEC) {
+			bgp_regex_flag(regex, "took over a millisecond to match, try bgp regex-engine dfa");
+		}
+	}
+	if(ret == 0) {
+		regex->matches++;
+	}
+	return ret;
 }
 
-void bgp_regex_free(regex_t *regex) {
-	regfree(regex);
+int bgp_regexec(struct bgp_regex *regex, struct aspath *aspath) {
+	return bgp_regexec_str(regex, aspath_print(aspath));
+}
+
+void bgp_regex_free(struct bgp_regex *regex) {
+	if(--regex->refcnt > 0) {
+		return;
+	}
+	hash_release(bgp_regex_cache, regex);
+	regfree(&regex->reg);
+	if(regex->dfa) {
+		regex_dfa_free(regex->dfa);
+	}
+	XFREE(MTYPE_BGP_REGEXP_STR, regex->str);
+	XFREE(MTYPE_BGP_REGEXP_STR, regex->expanded);
 	XFREE(MTYPE_BGP_REGEXP, regex);
 }
+
+static void bgp_regex_engine_apply(struct hash_backet *backet, void *arg) {
+	struct bgp_regex *regex = backet->data;
+
+	if(bgp_regex_engine == BGP_REGEX_ENGINE_DFA && !regex->dfa) {
+		regex->dfa = regex_dfa_compile(regex->expanded);
+	} else if(bgp_regex_engine == BGP_REGEX_ENGINE_POSIX && regex->dfa) {
+		regex_dfa_free(regex->dfa);
+		regex->dfa = NULL;
+	}
+}
+
+static void bgp_regex_engine_set(int engine) {
+	if(bgp_regex_engine != engine) {
+		bgp_regex_engine = engine;
+		if(bgp_regex_cache) {
+			hash_iterate(bgp_regex_cache, bgp_regex_engine_apply, NULL);
+		}
+	}
+}
+
+DEFUN(bgp_regex_engine_dfa, bgp_regex_engine_cmd, "bgp regex-engine (posix|dfa)",
+      BGP_STR "Engine for AS path and community list regular expressions\n"
+	      "Backtracking POSIX regexec(), the default\n"
+	      "Linear-time DFA, with regexec() for what it cannot take\n") {
+	bgp_regex_engine_set(strcmp(argv[0], "dfa") == 0 ? BGP_REGEX_ENGINE_DFA : BGP_REGEX_ENGINE_POSIX);
+	return CMD_SUCCESS;
+}
+
+DEFUN(no_bgp_regex_engine, no_bgp_regex_engine_cmd, "no bgp regex-engine", NO_STR BGP_STR "Engine for AS path and community list regular expressions\n") {
+	bgp_regex_engine_set(BGP_REGEX_ENGINE_POSIX);
+	return CMD_SUCCESS;
+}
+
+ALIAS(no_bgp_regex_engine, no_bgp_regex_engine_val_cmd, "no bgp regex-engine (posix|dfa)",
+      NO_STR BGP_STR "Engine for AS path and community list regular expressions\n"
+		     "Backtracking POSIX regexec(), the default\n"
+		     "Linear-time DFA, with regexec() for what it cannot take\n")
+
+static void bgp_regex_show_one(struct hash_backet *backet, void *arg) {
+	struct bgp_regex *regex = backet->data;
+	struct vty *vty = arg;
+
+	if(regex->dfa) {
+		const struct regex_dfa_stats *stats = regex_dfa_stats(regex->dfa);
+
+		vty_out(vty, "%c %-5s %5d %10lu %10lu %8lu states %6lu resets  %s%s", regex->flagged ? '*' : ' ', "dfa", regex->refcnt, regex->execs, regex->matches, stats->states, stats->resets, regex->str, VTY_NEWLINE);
+	} else {
+		vty_out(vty, "%c %-5s %5d %10lu %10lu %8lu usec avg %6lu max  %s%s", regex->flagged ? '*' : ' ', "posix", regex->refcnt, regex->execs, regex->matches, regex->execs ? (unsigned long) (regex->usec / regex->execs) : 0UL, regex->usec_max, regex->str, VTY_NEWLINE);
+	}
+}
+
+DEFUN(show_bgp_regexp_statistics, show_bgp_regexp_statistics_cmd, "show bgp regexp statistics",
+      SHOW_STR BGP_STR "AS path and community list regular expressions\n"
+		       "What matching them has cost\n") {
+	vty_out(vty, "Engine: %s; * costly pattern%s", bgp_regex_engine == BGP_REGEX_ENGINE_DFA ? "dfa" : "posix", VTY_NEWLINE);
+	vty_out(vty, "  Engine  Refs      Execs    Matches  Cost                          Pattern%s", VTY_NEWLINE);
+	if(bgp_regex_cache) {
+		hash_iterate(bgp_regex_cache, bgp_regex_show_one, vty);
+	}
+	return CMD_SUCCESS;
+}
+
+int bgp_regex_config_write(struct vty *vty) {
+	if(bgp_regex_engine == BGP_REGEX_ENGINE_DFA) {
+		vty_out(vty, "bgp regex-engine dfa%s", VTY_NEWLINE);
+		return 1;
+	}
+	return 0;
+}
+
+void bgp_regex_init(void) {
+	install_element(CONFIG_NODE, &bgp_regex_engine_cmd);
+	install_element(CONFIG_NODE, &no_bgp_regex_engine_cmd);
+	install_element(CONFIG_NODE, &no_bgp_regex_engine_val_cmd);
+	install_element(VIEW_NODE, &show_bgp_regexp_statistics_cmd);
+	install_element(RESTRICTED_NODE, &show_bgp_regexp_statistics_cmd);
+}
+
+/* Once every list holding a regex is gone */
+void bgp_regex_terminate(void) {
+	if(bgp_regex_cache) {
+		hash_free(bgp_regex_cache);
+		bgp_regex_cache = NULL;
+	}
+}
+
+/* AS path regexes made of whole ASNs and "[0-9]+" between '_'s (or
+   spaces), with '^' or '_' in front and '$' or '_' behind, are matched
+   against the ASNs of paths made only of AS_SEQUENCEs, where the string
+   is no more than the ASNs with a space between each.  Anything else
+   goes through regexec() on the string. */
+#define ASPATH_REGEX_ELEM_MAX 8
+
+struct aspath_regex_elem {
+	as_t as;
+	int any;
+};
+
+struct bgp_aspath_regex {
+	struct bgp_regex *reg;
+
+	int simple;
+	int anchor_start;
+	int anchor_end;
+	int count;
+	struct aspath_regex_elem elem[ASPATH_REGEX_ELEM_MAX];
+};
+
+static int aspath_regex_simple_parse(struct bgp_aspath_regex *re, const char *str) {
+	const char *p = str;
+
+	if(strcmp(str, "^$") == 0) {
+		re->anchor_start = re->anchor_end = 1;
+		return 1;
+	}
+
+	if(*p == '^') {
+		re->anchor_start = 1;
+	} else if(*p != '_') {
+		return 0;
+	}
+	p++;
+
+	while(1) {
+		struct aspath_regex_elem *elem;
+
+		if(re->count == ASPATH_REGEX_ELEM_MAX) {
+			return 0;
+		}
+		elem = &re->elem[re->count++];
+
+		if(strncmp(p, "[0-9]+", 6) == 0) {
+			elem->any = 1;
+			p += 6;
+		} else {
+			const char *start = p;
+			unsigned long long as = 0;
+
+			while(isdigit((int) *p) && p - start < 10) {
+				as = as * 10 + (*p++ - '0');
+			}
+			/* leading zeroes never match the string */
+			if(p == start || isdigit((int) *p) || as > UINT32_MAX || (*start == '0' && p - start > 1)) {
+				return 0;
+			}
+			elem->as = as;
+		}
+
+		if(*p == '$' && p[1] == '\0') {
+			re->anchor_end = 1;
+			return 1;
+		}
+		if(*p != '_' && *p != ' ') {
+			return 0;
+		}
+		p++;
+		if(*p == '\0') {
+			return (p[-1] == '_');
+		}
+	}
+}
+
+/* -1 if the path has segments other than AS_SEQUENCE */
+static int aspath_regex_simple_match(struct bgp_aspath_regex *re, struct aspath *aspath) {
+	struct assegment *seg, *start_seg;
+	int start_i, n, pos, i, k;
+
+	n = 0;
+	for(seg = aspath->segments; seg; seg = seg->next) {
+		if(seg->type != AS_SEQUENCE) {
+			return -1;
+		}
+		n += seg->length;
+	}
+	if(n < re->count || (re->anchor_start && re->anchor_end && n != re->count)) {
+		return 0;
+	}
+
+	start_seg = aspath->segments;
+	start_i = 0;
+	for(pos = 0; pos <= n - re->count; pos++) {
+		while(start_seg && start_i >= start_seg->length) {
+			start_seg = start_seg->next;
+			start_i = 0;
+		}
+
+		if(!re->anchor_end || pos == n - re->count) {
+			seg = start_seg;
+			i = start_i;
+			for(k = 0; k < re->count; k++, i++) {
+				while(i >= seg->length) {
+					seg = seg->next;
+					i = 0;
+				}
+				if(!re->elem[k].any && seg->as[i] != re->elem[k].as) {
+					break;
+				}
+			}
+			if(k == re->count) {
+				return 1;
+			}
+		}
+
+		if(re->anchor_start) {
+			break;
+		}
+		start_i++;
+	}
+	return 0;
+}
+
+struct bgp_aspath_regex *bgp_aspath_regcomp(const char *str) {
+	struct bgp_aspath_regex *re;
+	struct bgp_regex *reg;
+
+	reg = bgp_regcomp(str);
+	if(reg == NULL) {
+		return NULL;
+	}
+
+	re = XCALLOC(MTYPE_BGP_ASPATH_REGEXP, sizeof(struct bgp_aspath_regex));
+	re->reg = reg;
+	re->simple = aspath_regex_simple_parse(re, str);
+	return re;
+}
+
+int bgp_aspath_regexec(struct bgp_aspath_regex *re, struct aspath *aspath) {
+	int ret;
+
+	if(re->simple) {
+		ret = aspath_regex_simple_match(re, aspath);
+		if(ret >= 0) {
+			return (ret ? 0 : REG_NOMATCH);
+		}
+	}
+	return bgp_regexec(re->reg, aspath);
+}
+
+void bgp_aspath_regex_free(struct bgp_aspath_regex *re) {
+	bgp_regex_free(re->reg);
+	XFREE(MTYPE_BGP_ASPATH_REGEXP, re);
+}
@@ -34,8 +34,39 @@ Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
 	#endif /* HAVE_GNU_REGEX */
 #endif	       /* HAVE_LIBPCREPOSIX */
 
-extern void bgp_regex_free(regex_t *regex);
-extern regex_t *bgp_regcomp(const char *str);
-extern int bgp_regexec(regex_t *regex, struct aspath *aspath);
+/* A compiled regex, shared by all the lists with the same pattern */
+struct bgp_regex {
+	char *str;	/* as configured, the cache key */
+	char *expanded; /* with the '_'s expanded */
+	regex_t reg;
+	struct regex_dfa *dfa; /* under "bgp regex-engine dfa", if it can take the pattern */
+	int refcnt;
+
+	/* What matching has cost */
+	unsigned long execs;
+	unsigned long matches;
+	unsigned long long usec; /* in regexec() */
+	unsigned long usec_max;
+	int flagged;
+};
+
+#define BGP_REGEX_ENGINE_POSIX 0
+#define BGP_REGEX_ENGINE_DFA 1
+
+extern void bgp_regex_free(struct bgp_regex *regex);
+extern struct bgp_regex *bgp_regcomp(const char *str);
+extern int bgp_regexec(struct bgp_regex *regex, struct aspath *aspath);
+extern int bgp_regexec_str(struct bgp_regex *regex, const char *str);
+
+extern void bgp_regex_init(void);
+extern void bgp_regex_terminate(void);
+extern int bgp_regex_config_write(struct vty *);
+
+/* bgp_regcomp()/bgp_regexec() for AS paths, which matches the common
+ * forms of regex without making the AS path string */
+struct bgp_aspath_regex;
+extern struct bgp_aspath_regex *bgp_aspath_regcomp(const char *str);
+extern int bgp_aspath_regexec(struct bgp_aspath_regex *, struct aspath *aspath);
+extern void bgp_aspath_regex_free(struct bgp_aspath_regex *);
 
 #endif /* _QUAGGA_BGP_REGEX_H */
@@ -0,0 +1,307 @@
+/* BGP route-map result cache
+ *
+ * This file is part of Quagga
+ *
+ * Quagga is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2, or (at your option) any
+ * later version.
+ *
+ * Quagga is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Quagga; see the file COPYING.  If not, write to the Free
+ * Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ * 02111-1307, USA.
+ */
+
+#include <zebra.h>
+
+#include "command.h"
+#include "prefix.h"
+#include "memory.h"
+#include "hash.h"
+#include "linklist.h"
+#include "jhash.h"
+#include "routemap.h"
+#include "filter.h"
+
+#include "bgpd/bgpd.h"
+#include "bgpd/bgp_route.h"
+#include "bgpd/bgp_attr.h"
+#include "bgpd/bgp_rmap_cache.h"
+
+struct bgp_rmap_cache_entry {
+	struct route_map *map;
+	struct peer *peer; /* holds a lock */
+	u_char rmap_type;
+
+	struct attr *in;  /* interned */
+	struct attr *out; /* interned, NULL on deny */
+	route_map_result_t result;
+	u_int32_t gen; /* the route-map's, when it was run */
+};
+
+/* Whether a route-map can go through the cache at all, and which of the
+ * entries for it still hold. */
+struct bgp_rmap_cache_map {
+	struct route_map *map;
+	int cacheable;
+	u_int32_t gen;
+};
+
+static struct hash *bgp_rmap_cache;
+static struct hash *bgp_rmap_cache_maps;
+
+static unsigned long bgp_rmap_cache_hits;
+static unsigned long bgp_rmap_cache_misses;
+static unsigned long bgp_rmap_cache_uncacheable;
+static unsigned long bgp_rmap_cache_flushes;
+static unsigned long bgp_rmap_cache_invalidations;
+static unsigned long bgp_rmap_cache_stale;
+static u_int32_t bgp_rmap_cache_gen;
+
+static unsigned int bgp_rmap_cache_key(void *p) {
+	const struct bgp_rmap_cache_entry *entry = p;
+
+	return jhash_3words((uintptr_t) entry->map, (uintptr_t) entry->peer, entry->rmap_type, attrhash_key_make(entry->in));
+}
+
+static int bgp_rmap_cache_cmp(const void *p1, const void *p2) {
+	const struct bgp_rmap_cache_entry *e1 = p1;
+	const struct bgp_rmap_cache_entry *e2 = p2;
+
+	return (e1->map == e2->map && e1->peer == e2->peer && e1->rmap_type == e2->rmap_type && attrhash_cmp(e1->in, e2->in));
+}
+
+static unsigned int bgp_rmap_cache_map_key(void *p) {
+	const struct bgp_rmap_cache_map *m = p;
+
+	return jhash_1word((uintptr_t) m->map, 0);
+}
+
+static int bgp_rmap_cache_map_cmp(const void *p1, const void *p2) {
+	const struct bgp_rmap_cache_map *m1 = p1;
+	const struct bgp_rmap_cache_map *m2 = p2;
+
+	return (m1->map == m2->map);
+}
+
+static void bgp_rmap_cache_entry_free(void *p) {
+	struct bgp_rmap_cache_entry *entry = p;
+
+	bgp_attr_unintern(&entry->in);
+	if(entry->out) {
+		bgp_attr_unintern(&entry->out);
+	}
+	peer_unlock(entry->peer);
+	XFREE(MTYPE_BGP_RMAP_CACHE, entry);
+}
+
+static void bgp_rmap_cache_map_free(void *p) {
+	XFREE(MTYPE_BGP_RMAP_CACHE, p);
+}
+
+void bgp_rmap_cache_flush(void) {
+	if(bgp_rmap_cache == NULL) {
+		return;
+	}
+	if(bgp_rmap_cache->count || bgp_rmap_cache_maps->count) {
+		bgp_rmap_cache_flushes++;
+	}
+	hash_clean(bgp_rmap_cache, bgp_rmap_cache_entry_free);
+	hash_clean(bgp_rmap_cache_maps, bgp_rmap_cache_map_free);
+}
+
+int bgp_rmap_rule_per_prefix(const char *cmd, const char *rule_str, int set, void *arg) {
+	if(set) {
+		return 0;
+	}
+	return (strncmp(cmd, "ip address", 10) == 0 || strncmp(cmd, "ipv6 address", 12) == 0 || strcmp(cmd, "probability") == 0 || strcmp(cmd, "rpki") == 0);
+}
+
+/* Route-map rules whose outcome depends on more than the attributes, the
+ * peer and the configuration: the prefix, chance, the ROAs, or the peer's
+ * current round trip time. */
+static int bgp_rmap_cache_rule_volatile(const char *cmd, const char *rule_str, int set, void *arg) {
+	if(!set) {
+		return bgp_rmap_rule_per_prefix(cmd, rule_str, set, arg);
+	}
+	if(rule_str && (strcmp(cmd, "local-preference") == 0 || strcmp(cmd, "metric") == 0 || strcmp(cmd, "weight") == 0)) {
+		return (strstr(rule_str, "rtt") != NULL);
+	}
+	return 0;
+}
+
+static void *bgp_rmap_cache_map_alloc(void *p) {
+	const struct bgp_rmap_cache_map *key = p;
+	struct bgp_rmap_cache_map *m;
+
+	m = XCALLOC(MTYPE_BGP_RMAP_CACHE, sizeof(struct bgp_rmap_cache_map));
+	m->map = key->map;
+	m->cacheable = (route_map_rule_walk(m->map, bgp_rmap_cache_rule_volatile, NULL) == 0);
+	m->gen = ++bgp_rmap_cache_gen;
+	return m;
+}
+
+/* Does a rule, or a call, name the list or route-map?  Arguments like
+ * "NAME exact-match" or "NAME delete" start with it.  A rule that only
+ * happens to start with the same word costs a needless invalidation. */
+static int bgp_rmap_cache_rule_refers(const char *cmd, const char *rule_str, int set, void *arg) {
+	const char *name = arg;
+	size_t len = strlen(name);
+
+	return (rule_str && strncmp(rule_str, name, len) == 0 && (rule_str[len] == '\0' || rule_str[len] == ' '));
+}
+
+static void bgp_rmap_cache_map_invalidate(struct hash_backet *hb, void *arg) {
+	struct bgp_rmap_cache_map *m = hb->data;
+	const char *name = arg;
+
+	if(strcmp(m->map->name, name) != 0 && !route_map_rule_walk(m->map, bgp_rmap_cache_rule_refers, arg)) {
+		return;
+	}
+	/* the rules may be others now */
+	m->cacheable = (route_map_rule_walk(m->map, bgp_rmap_cache_rule_volatile, NULL) == 0);
+	m->gen = ++bgp_rmap_cache_gen;
+	bgp_rmap_cache_invalidations++;
+}
+
+/* The route-map or list of that name changed: results of the route-maps
+ * depending on it no longer hold.  They are dropped as they are met. */
+void bgp_rmap_cache_invalidate(const char *name) {
+	if(bgp_rmap_cache == NULL) {
+		return;
+	}
+	if(name == NULL) {
+		bgp_rmap_cache_flush();
+		return;
+	}
+	hash_iterate(bgp_rmap_cache_maps, bgp_rmap_cache_map_invalidate, (void *) name);
+}
+
+struct bgp_rmap_cache_peer_walk {
+	struct peer *peer;
+	struct list *entries;
+};
+
+static void bgp_rmap_cache_peer_collect(struct hash_backet *hb, void *arg) {
+	struct bgp_rmap_cache_entry *entry = hb->data;
+	struct bgp_rmap_cache_peer_walk *walk = arg;
+
+	if(entry->peer == walk->peer) {
+		listnode_add(walk->entries, entry);
+	}
+}
+
+/* Drop the entries for a peer, and their locks on it. */
+void bgp_rmap_cache_flush_peer(struct peer *peer) {
+	struct bgp_rmap_cache_peer_walk walk;
+	struct listnode *node;
+	struct bgp_rmap_cache_entry *entry;
+
+	if(bgp_rmap_cache == NULL || bgp_rmap_cache->count == 0) {
+		return;
+	}
+
+	/* the backets can't go while they are walked */
+	walk.peer = peer;
+	walk.entries = list_new();
+	hash_iterate(bgp_rmap_cache, bgp_rmap_cache_peer_collect, &walk);
+
+	for(ALL_LIST_ELEMENTS_RO(walk.entries, node, entry)) {
+		hash_release(bgp_rmap_cache, entry);
+		bgp_rmap_cache_entry_free(entry);
+	}
+	list_delete(walk.entries);
+}
+
+static struct bgp_rmap_cache_map *bgp_rmap_cache_map_get(struct route_map *map) {
+	struct bgp_rmap_cache_map key;
+
+	key.map = map;
+	return hash_get(bgp_rmap_cache_maps, &key, bgp_rmap_cache_map_alloc);
+}
+
+route_map_result_t bgp_rmap_cache_apply(struct route_map *map, struct prefix *p, struct bgp_info *info) {
+	struct bgp_rmap_cache_entry key, *entry;
+	struct bgp_rmap_cache_map *m;
+	struct peer *peer = info->peer;
+
+	if(map == NULL || bgp_rmap_cache == NULL || !(m = bgp_rmap_cache_map_get(map))->cacheable) {
+		bgp_rmap_cache_uncacheable++;
+		return route_map_apply(map, p, RMAP_BGP, info);
+	}
+
+	key.map = map;
+	key.peer = peer;
+	key.rmap_type = peer->rmap_type;
+	key.in = info->attr;
+
+	entry = hash_lookup(bgp_rmap_cache, &key);
+	if(entry && entry->gen != m->gen) {
+		bgp_rmap_cache_stale++;
+		hash_release(bgp_rmap_cache, entry);
+		bgp_rmap_cache_entry_free(entry);
+		entry = NULL;
+	}
+	if(entry) {
+		bgp_rmap_cache_hits++;
+		if(entry->out) {
+			/* what the "set" rules would have left in the attribute */
+			bgp_attr_flush(info->attr);
+			bgp_attr_dup(info->attr, entry->out);
+		}
+		return entry->result;
+	}
+	bgp_rmap_cache_misses++;
+
+	if(bgp_rmap_cache->count >= BGP_RMAP_CACHE_MAX) {
+		bgp_rmap_cache_flush();
+	}
+
+	entry = XCALLOC(MTYPE_BGP_RMAP_CACHE, sizeof(struct bgp_rmap_cache_entry));
+	entry->map = map;
+	entry->peer = peer_lock(peer);
+	entry->rmap_type = peer->rmap_type;
+	entry->gen = m->gen;
+
+	/* The entry takes over what the attribute refers to, from here on
+	 * the caller's flush leaves it alone. */
+	entry->in = bgp_attr_intern(info->attr);
+
+	entry->result = route_map_apply(map, p, RMAP_BGP, info);
+	if(entry->result != RMAP_DENYMATCH) {
+		entry->out = bgp_attr_intern(info->attr);
+	}
+
+	hash_get(bgp_rmap_cache, entry, hash_alloc_intern);
+	return entry->result;
+}
+
+DEFUN(show_bgp_route_map_cache, show_bgp_route_map_cache_cmd, "show bgp route-map-cache", SHOW_STR BGP_STR "Route-map result cache\n") {
+	vty_out(vty, "Entries: %lu, route-maps: %lu%s", bgp_rmap_cache->count, bgp_rmap_cache_maps->count, VTY_NEWLINE);
+	vty_out(vty, "Hits: %lu, misses: %lu, uncacheable: %lu, flushes: %lu%s", bgp_rmap_cache_hits, bgp_rmap_cache_misses, bgp_rmap_cache_uncacheable, bgp_rmap_cache_flushes, VTY_NEWLINE);
+	vty_out(vty, "Route-maps invalidated: %lu, stale entries dropped: %lu%s", bgp_rmap_cache_invalidations, bgp_rmap_cache_stale, VTY_NEWLINE);
+	return CMD_SUCCESS;
+}
+
+void bgp_rmap_cache_init(void) {
+	bgp_rmap_cache = hash_create_open(bgp_rmap_cache_key, bgp_rmap_cache_cmp);
+	bgp_rmap_cache_maps = hash_create_open(bgp_rmap_cache_map_key, bgp_rmap_cache_map_cmp);
+
+	install_element(VIEW_NODE, &show_bgp_route_map_cache_cmd);
+}
+
+void bgp_rmap_cache_finish(void) {
+	if(bgp_rmap_cache == NULL) {
+		return;
+	}
+	bgp_rmap_cache_flush();
+	hash_free(bgp_rmap_cache);
+	hash_free(bgp_rmap_cache_maps);
+	bgp_rmap_cache = bgp_rmap_cache_maps = NULL;
+}
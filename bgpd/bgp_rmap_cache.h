@@ -0,0 +1,58 @@
+/* BGP route-map result cache
+ *
+ * This file is part of Quagga
+ *
+ * Quagga is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2, or (at your option) any
+ * later version.
+ *
+ * Quagga is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Quagga; see the file COPYING.  If not, write to the Free
+ * Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ * 02111-1307, USA.
+ */
+
+#ifndef _QUAGGA_BGP_RMAP_CACHE_H
+#define _QUAGGA_BGP_RMAP_CACHE_H
+
+/* Most routes are run through a neighbour's route-map with one of only a
+ * few attribute sets, so for route-maps none of whose rules look at the
+ * prefix, the outcome is remembered per route-map, peer, direction and
+ * (interned) attributes going in, together with the interned attributes
+ * coming out.
+ *
+ * Anything the outcome could depend on, route-maps, the access, prefix,
+ * AS path and community lists they refer to, and peers, is configuration.
+ * A change to a named route-map or list invalidates the results of just
+ * the route-maps that refer to that name, directly or through a call,
+ * and a peer going drops just its own entries.  Anything else flushes
+ * the whole cache.
+ */
+
+/* Entries kept before the cache is flushed to start over */
+#define BGP_RMAP_CACHE_MAX 16384
+
+extern void bgp_rmap_cache_init(void);
+extern void bgp_rmap_cache_finish(void);
+extern void bgp_rmap_cache_flush(void);
+extern void bgp_rmap_cache_invalidate(const char *name);
+extern void bgp_rmap_cache_flush_peer(struct peer *);
+
+/* A route_map_rule_walk() function: is the outcome of a match rule one
+ * of the prefix, that is, is it not the same for all the prefixes
+ * received, or sent, with the same attributes?  "probability" counts, as
+ * it draws anew for each prefix, as does "rpki", which validates the
+ * prefix against the ROAs. */
+extern int bgp_rmap_rule_per_prefix(const char *cmd, const char *rule_str, int set, void *arg);
+
+/* route_map_apply(), for info->peer with its rmap_type set for the
+ * direction, through the cache where map allows. */
+extern route_map_result_t bgp_rmap_cache_apply(struct route_map *map, struct prefix *, struct bgp_info *info);
+
+#endif /* _QUAGGA_BGP_RMAP_CACHE_H */
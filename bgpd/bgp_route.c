@@ -36,6 +36,9 @@ Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
 #include "plist.h"
 #include "thread.h"
 #include "workqueue.h"
+#include "workpool.h"
+#include "trace.h"
+#include "json.h"
 
 #include "bgpd/bgpd.h"
 #include "bgpd/bgp_table.h"
@@ -59,13 +62,16 @@ Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
 #include "bgpd/bgp_vty.h"
 #include "bgpd/bgp_mpath.h"
 #include "bgpd/bgp_nht.h"
+#include "bgpd/bgp_updgrp.h"
+#include "bgpd/bgp_rmap_cache.h"
+#include "bgpd/bgp_bmp.h"
+#include "bgpd/bgp_rtc.h"
 
 /* Extern from bgp_dump.c */
 extern const char *bgp_origin_str[];
 extern const char *bgp_origin_long_str[];
 
 static struct bgp_node *bgp_afi_node_get(struct bgp_table *table, afi_t afi, safi_t safi, struct prefix *p, struct prefix_rd *prd) {
-	struct bgp_node *rn;
 	struct bgp_node *prn = NULL;
 
 	assert(table);
@@ -78,19 +84,14 @@ static struct bgp_node *bgp_afi_node_get(struct bgp_table *table, afi_t afi, saf
 
 		if(prn->info == NULL) {
 			prn->info = bgp_table_init(afi, safi);
+			((struct bgp_table *) prn->info)->prn = prn;
 		} else {
 			bgp_unlock_node(prn);
 		}
 		table = prn->info;
 	}
 
-	rn = bgp_node_get(table, p);
-
-	if((safi == SAFI_MPLS_VPN) || (safi == SAFI_ENCAP)) {
-		rn->prn = prn;
-	}
-
-	return rn;
+	return bgp_node_get(table, p);
 }
 
 /* Allocate bgp_info_extra */
@@ -108,6 +109,12 @@ static void bgp_info_extra_free(struct bgp_info_extra **extra) {
 
 		(*extra)->damp_info = NULL;
 
+		bgp_info_mpath_free(&(*extra)->mpath);
+
+		if((*extra)->rs) {
+			XFREE(MTYPE_BGP_RS_PATH, (*extra)->rs);
+		}
+
 		XFREE(MTYPE_BGP_ROUTE_EXTRA, *extra);
 
 		*extra = NULL;
@@ -124,6 +131,40 @@ struct bgp_info_extra *bgp_info_extra_get(struct bgp_info *ri) {
 	return ri->extra;
 }
 
+void bgp_info_key_update(struct bgp_info *ri) {
+	struct bgp_info_key *key = &ri->key;
+	struct attr *attr = ri->attr;
+	struct attr_extra *attre = attr->extra;
+
+	memset(key, 0, sizeof(struct bgp_info_key));
+
+	key->weight = attr->weight;
+	if(attr->flag & ATTR_FLAG_BIT(BGP_ATTR_LOCAL_PREF)) {
+		key->local_pref = attr->local_pref;
+		SET_FLAG(key->flags, BGP_INFO_KEY_LOCAL_PREF);
+	}
+	if(attr->flag & ATTR_FLAG_BIT(BGP_ATTR_MULTI_EXIT_DISC)) {
+		key->med = attr->med;
+		SET_FLAG(key->flags, BGP_INFO_KEY_MED);
+	}
+	if(attr->flag & ATTR_FLAG_BIT(BGP_ATTR_ORIGINATOR_ID)) {
+		key->originator_id = ntohl(attre->originator_id.s_addr);
+		SET_FLAG(key->flags, BGP_INFO_KEY_ORIGINATOR_ID);
+	}
+	if(attr->flag & ATTR_FLAG_BIT(BGP_ATTR_CLUSTER_LIST)) {
+		key->cluster = attre->cluster->length;
+	}
+	if(attr->aspath) {
+		key->hops = aspath_count_hops(attr->aspath);
+		key->confeds = aspath_count_confeds(attr->aspath);
+	}
+	key->origin = attr->origin;
+
+	if(ri->extra) {
+		key->igpmetric = ri->extra->igpmetric;
+	}
+}
+
 /* Free bgp route information. */
 static void bgp_info_free(struct bgp_info *binfo) {
 	if(binfo->attr) {
@@ -132,7 +173,6 @@ static void bgp_info_free(struct bgp_info *binfo) {
 
 	bgp_unlink_nexthop(binfo);
 	bgp_info_extra_free(&binfo->extra);
-	bgp_info_mpath_free(&binfo->mpath);
 
 	peer_unlock(binfo->peer); /* bgp_info peer reference */
 
@@ -197,6 +237,11 @@ static void bgp_info_reap(struct bgp_node *rn, struct bgp_info *ri) {
 		rn->info = ri->next;
 	}
 
+	if(rn->changed == ri) {
+		rn->changed = NULL;
+		SET_FLAG(rn->flags, BGP_NODE_SELECT_FULL);
+	}
+
 	bgp_info_mpath_dequeue(ri);
 	bgp_info_unlock(ri);
 	bgp_unlock_node(rn);
@@ -275,9 +320,9 @@ void bgp_info_unset_flag(struct bgp_node *rn, struct bgp_info *ri, u_int32_t fla
 
 /* Get MED value.  If MED value is missing and "bgp bestpath
    missing-as-worst" is specified, treat it as the worst value. */
-static u_int32_t bgp_med_value(struct attr *attr, struct bgp *bgp) {
-	if(attr->flag & ATTR_FLAG_BIT(BGP_ATTR_MULTI_EXIT_DISC)) {
-		return attr->med;
+static u_int32_t bgp_med_value(struct bgp_info_key *key, struct bgp *bgp) {
+	if(CHECK_FLAG(key->flags, BGP_INFO_KEY_MED)) {
+		return key->med;
 	} else {
 		if(bgp_flag_check(bgp, BGP_FLAG_MED_MISSING_AS_WORST)) {
 			return BGP_MED_MAX;
@@ -287,67 +332,41 @@ static u_int32_t bgp_med_value(struct attr *attr, struct bgp *bgp) {
 	}
 }
 
-/* Compare two bgp route entity.  Return -1 if new is preferred, 1 if exist
- * is preferred, or 0 if they are the same (usually will only occur if
- * multipath is enabled */
-static int bgp_info_cmp(struct bgp *bgp, struct bgp_info *new, struct bgp_info *exist, afi_t afi, safi_t safi) {
+/* The steps of bgp_info_cmp() up to the IGP metric of the nexthop,
+ * 0 if they don't tell the two paths apart. */
+static int bgp_info_cmp_pre_igp(struct bgp *bgp, struct bgp_info *new, struct bgp_info *exist) {
+	struct bgp_info_key *newkey, *existkey;
 	struct attr *newattr, *existattr;
-	struct attr_extra *newattre, *existattre;
 	bgp_peer_sort_t new_sort;
 	bgp_peer_sort_t exist_sort;
 	u_int32_t new_pref;
 	u_int32_t exist_pref;
 	u_int32_t new_med;
 	u_int32_t exist_med;
-	u_int32_t new_weight;
-	u_int32_t exist_weight;
-	uint32_t newm, existm;
-	struct in_addr new_id;
-	struct in_addr exist_id;
-	int new_cluster;
-	int exist_cluster;
 	int internal_as_route;
 	int confed_as_route;
-	int ret;
-
-	/* 0. Null check. */
-	if(new == NULL) {
-		return 1;
-	}
-	if(exist == NULL) {
-		return -1;
-	}
 
 	newattr = new->attr;
 	existattr = exist->attr;
-	newattre = newattr->extra;
-	existattre = existattr->extra;
+	newkey = &new->key;
+	existkey = &exist->key;
 
 	/* 1. Weight check. */
-	new_weight = exist_weight = 0;
-
-	if(newattre) {
-		new_weight = newattre->weight;
-	}
-	if(existattre) {
-		exist_weight = existattre->weight;
-	}
-
-	if(new_weight > exist_weight) {
+	if(newkey->weight > existkey->weight) {
 		return -1;
 	}
-	if(new_weight < exist_weight) {
+	if(newkey->weight < existkey->weight) {
 		return 1;
 	}
 
 	/* 2. Local preference check. */
 	new_pref = exist_pref = bgp->default_local_pref;
 
-	if(newattr->flag & ATTR_FLAG_BIT(BGP_ATTR_LOCAL_PREF)) {
-		new_pref = newattr->local_pref;
+	if(CHECK_FLAG(newkey->flags, BGP_INFO_KEY_LOCAL_PREF)) {
+		new_pref = newkey->local_pref;
 	}
-	if(existattr->flag & ATTR_FLAG_BIT(BGP_ATTR_LOCAL_PREF)) {
-		exist_pref = existattr->local_pref;
+	if(CHECK_FLAG(existkey->flags, BGP_INFO_KEY_LOCAL_PREF)) {
+		exist_pref = existkey->local_pref;
 	}
 
 	if(new_pref > exist_pref) {
@@ -371,49 +390,38 @@ static int bgp_info_cmp(struct bgp *bgp, struct bgp_info *new, struct bgp_info *
 
 	/* 4. AS path length check. */
 	if(!bgp_flag_check(bgp, BGP_FLAG_ASPATH_IGNORE)) {
-		int exist_hops = aspath_count_hops(existattr->aspath);
-		int exist_confeds = aspath_count_confeds(existattr->aspath);
+		unsigned int new_hops = newkey->hops;
+		unsigned int exist_hops = existkey->hops;
 
 		if(bgp_flag_check(bgp, BGP_FLAG_ASPATH_CONFED)) {
-			int aspath_hops;
-
-			aspath_hops = aspath_count_hops(newattr->aspath);
-			aspath_hops += aspath_count_confeds(newattr->aspath);
-
-			if(aspath_hops < (exist_hops + exist_confeds)) {
-				return -1;
-			}
-			if(aspath_hops > (exist_hops + exist_confeds)) {
-				return 1;
-			}
-		} else {
-			int newhops = aspath_count_hops(newattr->aspath);
+			new_hops += newkey->confeds;
+			exist_hops += existkey->confeds;
+		}
 
-			if(newhops < exist_hops) {
-				return -1;
-			}
-			if(newhops > exist_hops) {
-				return 1;
-			}
+		if(new_hops < exist_hops) {
+			return -1;
+		}
+		if(new_hops > exist_hops) {
+			return 1;
 		}
 	}
 
 	/* 5. Origin check. */
-	if(newattr->origin < existattr->origin) {
+	if(newkey->origin < existkey->origin) {
 		return -1;
 	}
-	if(newattr->origin > existattr->origin) {
+	if(newkey->origin > existkey->origin) {
 		return 1;
 	}
 
 	/* 6. MED check. */
-	internal_as_route = (aspath_count_hops(newattr->aspath) == 0 && aspath_count_hops(existattr->aspath) == 0);
-	confed_as_route = (aspath_count_confeds(newattr->aspath) > 0 && aspath_count_confeds(existattr->aspath) > 0 && aspath_count_hops(newattr->aspath) == 0 && aspath_count_hops(existattr->aspath) == 0);
+	internal_as_route = (newkey->hops == 0 && existkey->hops == 0);
+	confed_as_route = (newkey->confeds > 0 && existkey->confeds > 0 && internal_as_route);
 
 	if(bgp_flag_check(bgp, BGP_FLAG_ALWAYS_COMPARE_MED) || (bgp_flag_check(bgp, BGP_FLAG_MED_CONFED) && confed_as_route) || aspath_cmp_left(newattr->aspath, existattr->aspath)
 	   || aspath_cmp_left_confed(newattr->aspath, existattr->aspath) || internal_as_route) {
-		new_med = bgp_med_value(new->attr, bgp);
-		exist_med = bgp_med_value(exist->attr, bgp);
+		new_med = bgp_med_value(newkey, bgp);
+		exist_med = bgp_med_value(existkey, bgp);
 
 		if(new_med < exist_med) {
 			return -1;
@@ -434,20 +442,43 @@ static int bgp_info_cmp(struct bgp *bgp, struct bgp_info *new, struct bgp_info *
 		return 1;
 	}
 
-	/* 8. IGP metric check. */
-	newm = existm = 0;
+	return 0;
+}
+
+/* Compare two bgp route entity.  Return -1 if new is preferred, 1 if exist
+ * is preferred, or 0 if they are the same (usually will only occur if
+ * multipath is enabled */
+static int bgp_info_cmp(struct bgp *bgp, struct bgp_info *new, struct bgp_info *exist, afi_t afi, safi_t safi) {
+	struct bgp_info_key *newkey, *existkey;
+	bgp_peer_sort_t new_sort;
+	bgp_peer_sort_t exist_sort;
+	u_int32_t new_id;
+	u_int32_t exist_id;
+	int ret;
 
-	if(new->extra) {
-		newm = new->extra->igpmetric;
+	/* 0. Null check. */
+	if(new == NULL) {
+		return 1;
+	}
+	if(exist == NULL) {
+		return -1;
 	}
-	if(exist->extra) {
-		existm = exist->extra->igpmetric;
+
+	/* 1. - 7. */
+	if((ret = bgp_info_cmp_pre_igp(bgp, new, exist)) != 0) {
+		return ret;
 	}
 
-	if(newm < existm) {
+	newkey = &new->key;
+	existkey = &exist->key;
+	new_sort = new->peer->sort;
+	exist_sort = exist->peer->sort;
+
+	/* 8. IGP metric check. */
+	if(newkey->igpmetric < existkey->igpmetric) {
 		return -1;
 	}
-	if(newm > existm) {
+	if(newkey->igpmetric > existkey->igpmetric) {
 		return 1;
 	}
 
@@ -490,38 +521,29 @@ static int bgp_info_cmp(struct bgp *bgp, struct bgp_info *new, struct bgp_info *
    * be 0 and would always win over the other path. If originator id is
    * used for the comparision, it will decide which path is better.
    */
-	if(newattr->flag & ATTR_FLAG_BIT(BGP_ATTR_ORIGINATOR_ID)) {
-		new_id.s_addr = newattre->originator_id.s_addr;
+	if(CHECK_FLAG(newkey->flags, BGP_INFO_KEY_ORIGINATOR_ID)) {
+		new_id = newkey->originator_id;
 	} else {
-		new_id.s_addr = new->peer->remote_id.s_addr;
+		new_id = ntohl(new->peer->remote_id.s_addr);
 	}
-	if(existattr->flag & ATTR_FLAG_BIT(BGP_ATTR_ORIGINATOR_ID)) {
-		exist_id.s_addr = existattre->originator_id.s_addr;
+	if(CHECK_FLAG(existkey->flags, BGP_INFO_KEY_ORIGINATOR_ID)) {
+		exist_id = existkey->originator_id;
 	} else {
-		exist_id.s_addr = exist->peer->remote_id.s_addr;
+		exist_id = ntohl(exist->peer->remote_id.s_addr);
 	}
 
-	if(ntohl(new_id.s_addr) < ntohl(exist_id.s_addr)) {
+	if(new_id < exist_id) {
 		return -1;
 	}
-	if(ntohl(new_id.s_addr) > ntohl(exist_id.s_addr)) {
+	if(new_id > exist_id) {
 		return 1;
 	}
 
 	/* 12. Cluster length comparision. */
-	new_cluster = exist_cluster = 0;
-
-	if(newattr->flag & ATTR_FLAG_BIT(BGP_ATTR_CLUSTER_LIST)) {
-		new_cluster = newattre->cluster->length;
-	}
-	if(existattr->flag & ATTR_FLAG_BIT(BGP_ATTR_CLUSTER_LIST)) {
-		exist_cluster = existattre->cluster->length;
-	}
-
-	if(new_cluster < exist_cluster) {
+	if(newkey->cluster < existkey->cluster) {
 		return -1;
 	}
-	if(new_cluster > exist_cluster) {
+	if(newkey->cluster > existkey->cluster) {
 		return 1;
 	}
 
@@ -555,6 +577,38 @@ static int bgp_info_cmp(struct bgp *bgp, struct bgp_info *new, struct bgp_info *
 	return -1;
 }
 
+/* Whether a change to just the IGP metric of ri's nexthop could make any
+ * difference to best path or multipath selection at rn: not when ri
+ * isn't a candidate, or when it loses to the selected path before the
+ * metric is looked at.  */
+int bgp_info_igp_metric_matters(struct bgp *bgp, struct bgp_node *rn, struct bgp_info *ri) {
+	struct bgp_info *best;
+
+	if(CHECK_FLAG(ri->flags, BGP_INFO_SELECTED | BGP_INFO_MULTIPATH)) {
+		return 1;
+	}
+	if(BGP_INFO_HOLDDOWN(ri)) {
+		return 0;
+	}
+	/* MEDs are then compared within each neighbour AS first */
+	if(bgp_flag_check(bgp, BGP_FLAG_DETERMINISTIC_MED)) {
+		return 1;
+	}
+
+	for(best = rn->info; best; best = best->next) {
+		if(CHECK_FLAG(best->flags, BGP_INFO_SELECTED)) {
+			break;
+		}
+	}
+	if(!best || BGP_INFO_HOLDDOWN(best)) {
+		return 1;
+	}
+
+	return (bgp_info_cmp_pre_igp(bgp, ri, best) != 1);
+}
+
+/* Without a prefix only the filter-list is applied, without attributes
+   only the distribute-list and prefix-list. */
 static enum filter_type bgp_input_filter(struct peer *peer, struct prefix *p, struct attr *attr, afi_t afi, safi_t safi) {
 	struct bgp_filter *filter;
 
@@ -563,7 +617,7 @@ static enum filter_type bgp_input_filter(struct peer *peer, struct prefix *p, st
 #define FILTER_EXIST_WARN(F, f, filter) \
 	if(BGP_DEBUG(update, UPDATE_IN) && !(F##_IN(filter))) plog_warn(peer->log, "%s: Could not find configured input %s-list %s!", peer->host, #f, F##_IN_NAME(filter));
 
-	if(DISTRIBUTE_IN_NAME(filter)) {
+	if(p && DISTRIBUTE_IN_NAME(filter)) {
 		FILTER_EXIST_WARN(DISTRIBUTE, distribute, filter);
 
 		if(access_list_apply(DISTRIBUTE_IN(filter), p) == FILTER_DENY) {
@@ -571,7 +625,7 @@ static enum filter_type bgp_input_filter(struct peer *peer, struct prefix *p, st
 		}
 	}
 
-	if(PREFIX_LIST_IN_NAME(filter)) {
+	if(p && PREFIX_LIST_IN_NAME(filter)) {
 		FILTER_EXIST_WARN(PREFIX_LIST, prefix, filter);
 
 		if(prefix_list_apply(PREFIX_LIST_IN(filter), p) == PREFIX_DENY) {
@@ -579,7 +633,7 @@ static enum filter_type bgp_input_filter(struct peer *peer, struct prefix *p, st
 		}
 	}
 
-	if(FILTER_LIST_IN_NAME(filter)) {
+	if(attr && FILTER_LIST_IN_NAME(filter)) {
 		FILTER_EXIST_WARN(FILTER_LIST, as, filter);
 
 		if(as_list_apply(FILTER_LIST_IN(filter), attr->aspath) == AS_FILTER_DENY) {
@@ -677,7 +731,7 @@ static int bgp_input_modifier(struct peer *peer, struct prefix *p, struct attr *
 
 	/* Apply default weight value. */
 	if(peer->weight) {
-		(bgp_attr_extra_get(attr))->weight = peer->weight;
+		attr->weight = peer->weight;
 	}
 
 	/* Route map apply. */
@@ -689,7 +743,7 @@ static int bgp_input_modifier(struct peer *peer, struct prefix *p, struct attr *
 		SET_FLAG(peer->rmap_type, PEER_RMAP_TYPE_IN);
 
 		/* Apply BGP route map to the attribute. */
-		ret = route_map_apply(ROUTE_MAP_IN(filter), p, RMAP_BGP, &info);
+		ret = bgp_rmap_cache_apply(ROUTE_MAP_IN(filter), p, &info);
 
 		peer->rmap_type = 0;
 
@@ -717,7 +771,7 @@ static int bgp_export_modifier(struct peer *rsclient, struct peer *peer, struct
 		SET_FLAG(rsclient->rmap_type, PEER_RMAP_TYPE_EXPORT);
 
 		/* Apply BGP route map to the attribute. */
-		ret = route_map_apply(ROUTE_MAP_EXPORT(filter), p, RMAP_BGP, &info);
+		ret = bgp_rmap_cache_apply(ROUTE_MAP_EXPORT(filter), p, &info);
 
 		rsclient->rmap_type = 0;
 
@@ -739,7 +793,7 @@ static int bgp_import_modifier(struct peer *rsclient, struct peer *peer, struct
 
 	/* Apply default weight value. */
 	if(peer->weight) {
-		(bgp_attr_extra_get(attr))->weight = peer->weight;
+		attr->weight = peer->weight;
 	}
 
 	/* Route map apply. */
@@ -751,7 +805,7 @@ static int bgp_import_modifier(struct peer *rsclient, struct peer *peer, struct
 		SET_FLAG(peer->rmap_type, PEER_RMAP_TYPE_IMPORT);
 
 		/* Apply BGP route map to the attribute. */
-		ret = route_map_apply(ROUTE_MAP_IMPORT(filter), p, RMAP_BGP, &info);
+		ret = bgp_rmap_cache_apply(ROUTE_MAP_IMPORT(filter), p, &info);
 
 		peer->rmap_type = 0;
 
@@ -764,19 +818,13 @@ static int bgp_import_modifier(struct peer *rsclient, struct peer *peer, struct
 	return RMAP_PERMIT;
 }
 
-static int bgp_announce_check(struct bgp_info *ri, struct peer *peer, struct prefix *p, struct attr *attr, afi_t afi, safi_t safi) {
-	int ret;
+/* Checks specific to the peer itself, rather than its outbound policy. */
+static int bgp_announce_check_peer(struct bgp_info *ri, struct peer *peer, struct prefix *p, afi_t afi, safi_t safi) {
 	char buf[SU_ADDRSTRLEN];
-	struct bgp_filter *filter;
 	struct peer *from;
-	struct bgp *bgp;
-	int transparent;
-	int reflect;
 	struct attr *riattr;
 
 	from = ri->peer;
-	filter = &peer->filter[afi][safi];
-	bgp = peer->bgp;
 	riattr = bgp_info_mpath_count(ri) ? bgp_info_mpath_attr(ri) : ri->attr;
 
 	if(DISABLE_BGP_ANNOUNCE) {
@@ -793,6 +841,53 @@ static int bgp_announce_check(struct bgp_info *ri, struct peer *peer, struct pre
 		return 0;
 	}
 
+	/* If the attribute has originator-id and it is same as remote
+     peer's id. */
+	if(riattr->flag & ATTR_FLAG_BIT(BGP_ATTR_ORIGINATOR_ID)) {
+		if(IPV4_ADDR_SAME(&peer->remote_id, &riattr->extra->originator_id)) {
+			if(BGP_DEBUG(filter, FILTER)) {
+				zlog(peer->log, LOG_DEBUG, "%s [Update:SEND] %s/%d originator-id is same as remote router-id", peer->host, inet_ntop(p->family, &p->u.prefix, buf, SU_ADDRSTRLEN), p->prefixlen);
+			}
+			return 0;
+		}
+	}
+
+	/* Only the VPN routes whose route targets the peer asked for */
+	if(safi == SAFI_MPLS_VPN && BGP_RTC_NEGOTIATED(peer) && !bgp_rtc_permits(peer, riattr)) {
+		if(BGP_DEBUG(filter, FILTER)) {
+			zlog(peer->log, LOG_DEBUG, "%s [Update:SEND] %s/%d has no route target the peer is a member of", peer->host, inet_ntop(p->family, &p->u.prefix, buf, SU_ADDRSTRLEN), p->prefixlen);
+		}
+		return 0;
+	}
+
+	/* ORF prefix-list filter check */
+	if(CHECK_FLAG(peer->af_cap[afi][safi], PEER_CAP_ORF_PREFIX_RM_ADV) && (CHECK_FLAG(peer->af_cap[afi][safi], PEER_CAP_ORF_PREFIX_SM_RCV) || CHECK_FLAG(peer->af_cap[afi][safi], PEER_CAP_ORF_PREFIX_SM_OLD_RCV))) {
+		if(peer->orf_plist[afi][safi]) {
+			if(prefix_list_apply(peer->orf_plist[afi][safi], p) == PREFIX_DENY) {
+				return 0;
+			}
+		}
+	}
+	return 1;
+}
+
+/* The part of the outbound policy that only depends on what update-group
+   the peer is in, so may be run once for all of the group's members. */
+static int bgp_announce_check_policy(struct bgp_info *ri, struct peer *peer, struct prefix *p, struct attr *attr, afi_t afi, safi_t safi) {
+	int ret;
+	char buf[SU_ADDRSTRLEN];
+	struct bgp_filter *filter;
+	struct peer *from;
+	struct bgp *bgp;
+	int transparent;
+	int reflect;
+	struct attr *riattr;
+
+	from = ri->peer;
+	filter = &peer->filter[afi][safi];
+	bgp = peer->bgp;
+	riattr = bgp_info_mpath_count(ri) ? bgp_info_mpath_attr(ri) : ri->attr;
+
 	/* Aggregate-address suppress check. */
 	if(ri->extra && ri->extra->suppress) {
 		if(!UNSUPPRESS_MAP_NAME(filter)) {
@@ -821,26 +916,6 @@ static int bgp_announce_check(struct bgp_info *ri, struct peer *peer, struct pre
 		return 0;
 	}
 
-	/* If the attribute has originator-id and it is same as remote
-     peer's id. */
-	if(riattr->flag & ATTR_FLAG_BIT(BGP_ATTR_ORIGINATOR_ID)) {
-		if(IPV4_ADDR_SAME(&peer->remote_id, &riattr->extra->originator_id)) {
-			if(BGP_DEBUG(filter, FILTER)) {
-				zlog(peer->log, LOG_DEBUG, "%s [Update:SEND] %s/%d originator-id is same as remote router-id", peer->host, inet_ntop(p->family, &p->u.prefix, buf, SU_ADDRSTRLEN), p->prefixlen);
-			}
-			return 0;
-		}
-	}
-
-	/* ORF prefix-list filter check */
-	if(CHECK_FLAG(peer->af_cap[afi][safi], PEER_CAP_ORF_PREFIX_RM_ADV) && (CHECK_FLAG(peer->af_cap[afi][safi], PEER_CAP_ORF_PREFIX_SM_RCV) || CHECK_FLAG(peer->af_cap[afi][safi], PEER_CAP_ORF_PREFIX_SM_OLD_RCV))) {
-		if(peer->orf_plist[afi][safi]) {
-			if(prefix_list_apply(peer->orf_plist[afi][safi], p) == PREFIX_DENY) {
-				return 0;
-			}
-		}
-	}
-
 	/* Output filter check. */
 	if(bgp_output_filter(peer, p, riattr, afi, safi) == FILTER_DENY) {
 		if(BGP_DEBUG(filter, FILTER)) {
@@ -1007,9 +1082,9 @@ static int bgp_announce_check(struct bgp_info *ri, struct peer *peer, struct pre
 		SET_FLAG(peer->rmap_type, PEER_RMAP_TYPE_OUT);
 
 		if(ri->extra && ri->extra->suppress) {
-			ret = route_map_apply(UNSUPPRESS_MAP(filter), p, RMAP_BGP, &info);
+			ret = bgp_rmap_cache_apply(UNSUPPRESS_MAP(filter), p, &info);
 		} else {
-			ret = route_map_apply(ROUTE_MAP_OUT(filter), p, RMAP_BGP, &info);
+			ret = bgp_rmap_cache_apply(ROUTE_MAP_OUT(filter), p, &info);
 		}
 
 		peer->rmap_type = 0;
@@ -1022,17 +1097,21 @@ static int bgp_announce_check(struct bgp_info *ri, struct peer *peer, struct pre
 	return 1;
 }
 
-static int bgp_announce_check_rsclient(struct bgp_info *ri, struct peer *rsclient, struct prefix *p, struct attr *attr, afi_t afi, safi_t safi) {
+static int bgp_announce_check(struct bgp_info *ri, struct peer *peer, struct prefix *p, struct attr *attr, afi_t afi, safi_t safi) {
+	return bgp_announce_check_peer(ri, peer, p, afi, safi) && bgp_announce_check_policy(ri, peer, p, attr, afi, safi);
+}
+
+/* The checks of bgp_announce_check_rsclient() on ri, with riattr the
+ * attributes the RS client's policy left it with. */
+static int bgp_announce_check_rsclient_attr(struct bgp_info *ri, struct attr *riattr, struct peer *rsclient, struct prefix *p, struct attr *attr, afi_t afi, safi_t safi) {
 	int ret;
 	char buf[SU_ADDRSTRLEN];
 	struct bgp_filter *filter;
 	struct bgp_info info;
 	struct peer *from;
-	struct attr *riattr;
 
 	from = ri->peer;
 	filter = &rsclient->filter[afi][safi];
-	riattr = bgp_info_mpath_count(ri) ? bgp_info_mpath_attr(ri) : ri->attr;
 
 	if(DISABLE_BGP_ANNOUNCE) {
 		return 0;
@@ -1166,9 +1245,9 @@ static int bgp_announce_check_rsclient(struct bgp_info *ri, struct peer *rsclien
 		SET_FLAG(rsclient->rmap_type, PEER_RMAP_TYPE_OUT);
 
 		if(ri->extra && ri->extra->suppress) {
-			ret = route_map_apply(UNSUPPRESS_MAP(filter), p, RMAP_BGP, &info);
+			ret = bgp_rmap_cache_apply(UNSUPPRESS_MAP(filter), p, &info);
 		} else {
-			ret = route_map_apply(ROUTE_MAP_OUT(filter), p, RMAP_BGP, &info);
+			ret = bgp_rmap_cache_apply(ROUTE_MAP_OUT(filter), p, &info);
 		}
 
 		rsclient->rmap_type = 0;
@@ -1182,12 +1261,122 @@ static int bgp_announce_check_rsclient(struct bgp_info *ri, struct peer *rsclien
 	return 1;
 }
 
+static int bgp_announce_check_rsclient(struct bgp_info *ri, struct peer *rsclient, struct prefix *p, struct attr *attr, afi_t afi, safi_t safi) {
+	return bgp_announce_check_rsclient_attr(ri, bgp_info_mpath_count(ri) ? bgp_info_mpath_attr(ri) : ri->attr, rsclient, p, attr, afi, safi);
+}
+
 struct bgp_info_pair {
 	struct bgp_info *old;
 	struct bgp_info *new;
 };
 
-static void bgp_best_selection(struct bgp *bgp, struct bgp_node *rn, struct bgp_info_pair *result, afi_t afi, safi_t safi) {
+/* Whether ri takes part in best path selection at all */
+static int bgp_info_selectable(struct bgp *bgp, struct bgp_info *ri, afi_t afi, safi_t safi) {
+	if(BGP_INFO_HOLDDOWN(ri) || BGP_INFO_DEAD(ri, afi, safi)) {
+		return 0;
+	}
+	if(ri->peer && ri->peer != bgp->peer_self && !CHECK_FLAG(ri->peer->sflags, PEER_STATUS_NSF_WAIT)) {
+		if(ri->peer->status != Established) {
+			return 0;
+		}
+	}
+	return 1;
+}
+
+/* Delete a dead path met by selection, as the clear queue would have:
+ * saves that visit to the node, and queueing it again after. */
+static void bgp_info_dead_delete(struct bgp_node *rn, struct bgp_info *ri, afi_t afi, safi_t safi) {
+	if(CHECK_FLAG(ri->flags, BGP_INFO_REMOVED | BGP_INFO_HISTORY)) {
+		return;
+	}
+	UNSET_FLAG(ri->flags, BGP_INFO_ADJ_IN);
+	bgp_aggregate_decrement(ri->peer->bgp, &rn->p, ri, afi, safi);
+	bgp_info_delete(rn, ri);
+}
+
+/* When the only path that changed since the last selection is not the
+ * selected one and still does not beat it, every other path already lost
+ * to the selected one and the selection stands.  Returns 0 if all the
+ * paths have to be compared again. */
+static int bgp_best_selection_changed(struct bgp *bgp, struct bgp_node *rn, struct bgp_info_pair *result, afi_t afi, safi_t safi) {
+	struct bgp_info *changed = rn->changed;
+	struct bgp_info *old_select;
+	struct bgp_info *ri;
+	struct bgp_info *nextri = NULL;
+
+	if(changed == NULL || CHECK_FLAG(rn->flags, BGP_NODE_SELECT_FULL)) {
+		return 0;
+	}
+
+	/* Both compare groups of paths rather than pairs */
+	if(bgp_flag_check(bgp, BGP_FLAG_DETERMINISTIC_MED) || bgp_mpath_is_configured(bgp, afi, safi)) {
+		return 0;
+	}
+
+	for(old_select = rn->info; old_select; old_select = old_select->next) {
+		if(CHECK_FLAG(old_select->flags, BGP_INFO_SELECTED)) {
+			break;
+		}
+	}
+	if(old_select == NULL || old_select == changed || !bgp_info_selectable(bgp, old_select, afi, safi)) {
+		return 0;
+	}
+	if(CHECK_FLAG(old_select->flags, BGP_INFO_ATTR_CHANGED | BGP_INFO_IGP_CHANGED) || bgp_info_mpath_count(old_select)) {
+		return 0;
+	}
+
+	if(bgp_info_selectable(bgp, changed, afi, safi) && bgp_info_cmp(bgp, changed, old_select, afi, safi) == -1) {
+		return 0;
+	}
+
+	/* reap REMOVED and dead routes, as the full selection would */
+	for(ri = rn->info; (ri != NULL) && (nextri = ri->next, 1); ri = nextri) {
+		if(BGP_INFO_DEAD(ri, afi, safi)) {
+			bgp_info_dead_delete(rn, ri, afi, safi);
+		}
+		if(CHECK_FLAG(ri->flags, BGP_INFO_REMOVED) && (ri != old_select)) {
+			bgp_info_reap(rn, ri);
+		}
+	}
+
+	bgp_info_mpath_aggregate_update(old_select, old_select);
+
+	result->old = result->new = old_select;
+	return 1;
+}
+
+/* Whether the best path at rn may be worked out by bgp_best_preselect(),
+ * which leaves out whatever needs more than comparing paths two by two. */
+static int bgp_best_preselectable(struct bgp *bgp, struct bgp_node *rn, afi_t afi, safi_t safi) {
+	return (rn->info != NULL && bgp_node_table(rn)->type == BGP_TABLE_MAIN && !bgp_flag_check(bgp, BGP_FLAG_DETERMINISTIC_MED) && !bgp_mpath_is_configured(bgp, afi, safi));
+}
+
+/* The path bgp_best_selection() would select at rn, for a node that is
+ * bgp_best_preselectable().  Runs on the select threads: only reads. */
+static struct bgp_info *bgp_best_preselect(struct bgp *bgp, struct bgp_node *rn, afi_t afi, safi_t safi) {
+	struct bgp_info *new_select = NULL;
+	struct bgp_info *ri;
+
+	for(ri = rn->info; ri; ri = ri->next) {
+		if(BGP_INFO_HOLDDOWN(ri) || BGP_INFO_DEAD(ri, afi, safi)) {
+			continue;
+		}
+		if(ri->peer && ri->peer != bgp->peer_self && !CHECK_FLAG(ri->peer->sflags, PEER_STATUS_NSF_WAIT)) {
+			if(ri->peer->status != Established) {
+				continue;
+			}
+		}
+		if(bgp_info_cmp(bgp, ri, new_select, afi, safi) == -1) {
+			new_select = ri;
+		}
+	}
+
+	return new_select;
+}
+
+/* Best path selection at rn.  With preselect, the path comparisons were
+ * already made by bgp_best_preselect(), whose result it points to. */
+static void bgp_best_selection(struct bgp *bgp, struct bgp_node *rn, struct bgp_info_pair *result, afi_t afi, safi_t safi, struct bgp_info **preselect) {
 	struct bgp_info *new_select;
 	struct bgp_info *old_select;
 	struct bgp_info *ri;
@@ -1195,7 +1384,7 @@ static void bgp_best_selection(struct bgp *bgp, struct bgp_node *rn, struct bgp_
 	struct bgp_info *ri2;
 	struct bgp_info *nextri = NULL;
 	int cmpret, do_mpath;
-	struct list mp_list;
+	struct bgp_mp_list mp_list;
 
 	result->old = result->new = NULL;
 
@@ -1205,6 +1394,13 @@ static void bgp_best_selection(struct bgp *bgp, struct bgp_node *rn, struct bgp_
 		return;
 	}
 
+	if(!preselect && bgp_best_selection_changed(bgp, rn, result, afi, safi)) {
+		rn->changed = NULL;
+		return;
+	}
+	rn->changed = NULL;
+	UNSET_FLAG(rn->flags, BGP_NODE_SELECT_FULL);
+
 	bgp_mp_list_init(&mp_list);
 	do_mpath = bgp_mpath_is_configured(bgp, afi, safi);
 
@@ -1215,7 +1411,7 @@ static void bgp_best_selection(struct bgp *bgp, struct bgp_node *rn, struct bgp_
 			if(CHECK_FLAG(ri1->flags, BGP_INFO_DMED_CHECK)) {
 				continue;
 			}
-			if(BGP_INFO_HOLDDOWN(ri1)) {
+			if(BGP_INFO_HOLDDOWN(ri1) || BGP_INFO_DEAD(ri1, afi, safi)) {
 				continue;
 			}
 			if(ri1->peer && ri1->peer != bgp->peer_self) {
@@ -1234,7 +1430,7 @@ static void bgp_best_selection(struct bgp *bgp, struct bgp_node *rn, struct bgp_
 					if(CHECK_FLAG(ri2->flags, BGP_INFO_DMED_CHECK)) {
 						continue;
 					}
-					if(BGP_INFO_HOLDDOWN(ri2)) {
+					if(BGP_INFO_HOLDDOWN(ri2) || BGP_INFO_DEAD(ri2, afi, safi)) {
 						continue;
 					}
 					if(ri2->peer && ri2->peer != bgp->peer_self && !CHECK_FLAG(ri2->peer->sflags, PEER_STATUS_NSF_WAIT)) {
@@ -1282,6 +1478,10 @@ static void bgp_best_selection(struct bgp *bgp, struct bgp_node *rn, struct bgp_
 			old_select = ri;
 		}
 
+		if(BGP_INFO_DEAD(ri, afi, safi)) {
+			bgp_info_dead_delete(rn, ri, afi, safi);
+		}
+
 		if(BGP_INFO_HOLDDOWN(ri)) {
 			/* reap REMOVED routes, if needs be
            * selected route must stay for a while longer though
@@ -1306,6 +1506,13 @@ static void bgp_best_selection(struct bgp *bgp, struct bgp_node *rn, struct bgp_
 		bgp_info_unset_flag(rn, ri, BGP_INFO_DMED_CHECK);
 		bgp_info_unset_flag(rn, ri, BGP_INFO_DMED_SELECTED);
 
+		if(preselect) {
+			if(ri == *preselect) {
+				new_select = ri;
+			}
+			continue;
+		}
+
 		if((cmpret = bgp_info_cmp(bgp, ri, new_select, afi, safi)) == -1) {
 			if(do_mpath && bgp_flag_check(bgp, BGP_FLAG_DETERMINISTIC_MED)) {
 				bgp_mp_dmed_deselect(new_select);
@@ -1340,17 +1547,124 @@ static void bgp_best_selection(struct bgp *bgp, struct bgp_node *rn, struct bgp_
 	return;
 }
 
-static int bgp_process_announce_selected(struct peer *peer, struct bgp_info *selected, struct bgp_node *rn, afi_t afi, safi_t safi) {
-	struct prefix *p;
-	struct attr attr;
-	struct attr_extra extra;
-
-	memset(&attr, 0, sizeof(struct attr));
-	memset(&extra, 0, sizeof(struct attr_extra));
+/* Path IDs bgp_process_announce_addpath() keeps track of on the stack */
+#define BGP_ADDPATH_IDS_STACK 16
 
-	p = &rn->p;
+/* The lowest path ID none of the paths of rn goes out with */
+static u_int32_t bgp_addpath_tx_id_new(struct bgp_node *rn) {
+	struct bgp_info *ri;
+	u_int32_t id;
 
-	/* Announce route to Established peer. */
+	for(id = 1;; id++) {
+		for(ri = rn->info; ri; ri = ri->next) {
+			if(ri->addpath_tx_id == id) {
+				break;
+			}
+		}
+		if(!ri) {
+			return id;
+		}
+	}
+}
+
+/* Whether ri is among the paths an Add-Path peer is sent, next to the
+   selected one */
+static int bgp_addpath_tx_path(struct bgp *bgp, struct peer *peer, struct bgp_info *ri, struct bgp_info *selected, afi_t afi, safi_t safi) {
+	if(ri == selected) {
+		return 1;
+	}
+	if(!selected || !bgp_info_selectable(bgp, ri, afi, safi)) {
+		return 0;
+	}
+	if(CHECK_FLAG(peer->af_flags[afi][safi], PEER_FLAG_ADDPATH_TX_ALL_PATHS)) {
+		return 1;
+	}
+	return (CHECK_FLAG(peer->af_flags[afi][safi], PEER_FLAG_ADDPATH_TX_MULTIPATH) && CHECK_FLAG(ri->flags, BGP_INFO_MULTIPATH));
+}
+
+/* bgp_process_announce_selected() for a peer that is sent more than the
+   selected path.  Each path goes out with its own path ID, and only if it
+   changed; those the peer is no longer sent are withdrawn. */
+static void bgp_process_announce_addpath(struct peer *peer, struct bgp_info *selected, struct bgp_node *rn, afi_t afi, safi_t safi) {
+	struct bgp *bgp = peer->bgp;
+	struct update_group *group = NULL;
+	struct bgp_info *ri;
+	struct attr attr;
+	struct attr_extra extra;
+	struct attr *shared;
+	struct attr *attr_new;
+	u_int32_t ids_stack[BGP_ADDPATH_IDS_STACK];
+	u_int32_t *ids = ids_stack;
+	unsigned int count = 0;
+	unsigned int size = BGP_ADDPATH_IDS_STACK;
+	int ret;
+
+	for(ri = rn->info; ri; ri = ri->next) {
+		if(!bgp_addpath_tx_path(bgp, peer, ri, selected, afi, safi) || !bgp_announce_check_peer(ri, peer, &rn->p, afi, safi)) {
+			continue;
+		}
+
+		memset(&attr, 0, sizeof(struct attr));
+		memset(&extra, 0, sizeof(struct attr_extra));
+		attr.extra = &extra;
+		shared = NULL;
+
+		if(!group) {
+			group = bgp_updgrp_peer_get(peer, afi, safi);
+		}
+		if(listcount(group->peers) < 2) {
+			ret = bgp_announce_check_policy(ri, peer, &rn->p, &attr, afi, safi);
+		} else if((ret = bgp_updgrp_memo_get(group, ri, &shared)) < 0) {
+			ret = bgp_announce_check_policy(ri, peer, &rn->p, &attr, afi, safi);
+			shared = bgp_updgrp_memo_set(group, ri, ret, &attr);
+		}
+
+		if(ret) {
+			if(!ri->addpath_tx_id) {
+				ri->addpath_tx_id = bgp_addpath_tx_id_new(rn);
+			}
+
+			attr_new = bgp_attr_intern(shared ? shared : &attr);
+			if(!bgp_adj_out_same(rn, peer, afi, safi, ri->addpath_tx_id, attr_new)) {
+				bgp_adj_out_set(rn, peer, &rn->p, attr_new, afi, safi, ri, ri->addpath_tx_id);
+			}
+			bgp_attr_unintern(&attr_new);
+
+			if(count == size) {
+				u_int32_t *grown = XMALLOC(MTYPE_TMP, 2 * size * sizeof(u_int32_t));
+
+				memcpy(grown, ids, count * sizeof(u_int32_t));
+				if(ids != ids_stack) {
+					XFREE(MTYPE_TMP, ids);
+				}
+				ids = grown;
+				size *= 2;
+			}
+			ids[count++] = ri->addpath_tx_id;
+		}
+		bgp_attr_flush(&attr);
+	}
+
+	bgp_adj_out_unset_others(rn, peer, afi, safi, ids, count);
+	if(ids != ids_stack) {
+		XFREE(MTYPE_TMP, ids);
+	}
+}
+
+static int bgp_process_announce_selected(struct peer *peer, struct bgp_info *selected, struct bgp_node *rn, afi_t afi, safi_t safi) {
+	struct prefix *p;
+	struct attr attr;
+	struct attr_extra extra;
+	struct attr *shared = NULL;
+	struct update_group *group;
+	int ret = 0;
+
+	memset(&attr, 0, sizeof(struct attr));
+	memset(&extra, 0, sizeof(struct attr_extra));
+
+	p = &rn->p;
+
+	/* Announce route to Established peer. */
 	if(peer->status != Established) {
 		return 0;
 	}
@@ -1370,36 +1684,511 @@ static int bgp_process_announce_selected(struct peer *peer, struct bgp_info *sel
 
 	switch(bgp_node_table(rn)->type) {
 		case BGP_TABLE_MAIN:
+			if(BGP_ADDPATH_TX(peer, afi, safi)) {
+				bgp_process_announce_addpath(peer, selected, rn, afi, safi);
+				break;
+			}
+
 			/* Announcement to peer->conf.  If the route is filtered,
          withdraw it. */
-			if(selected && bgp_announce_check(selected, peer, p, &attr, afi, safi)) {
-				bgp_adj_out_set(rn, peer, p, &attr, afi, safi, selected);
+			if(selected && bgp_announce_check_peer(selected, peer, p, afi, safi)) {
+				group = bgp_updgrp_peer_get(peer, afi, safi);
+
+				/* Another member may have run the policy on this route already */
+				if(listcount(group->peers) < 2) {
+					ret = bgp_announce_check_policy(selected, peer, p, &attr, afi, safi);
+				} else if((ret = bgp_updgrp_memo_get(group, selected, &shared)) < 0) {
+					ret = bgp_announce_check_policy(selected, peer, p, &attr, afi, safi);
+					shared = bgp_updgrp_memo_set(group, selected, ret, &attr);
+				}
+			}
+			if(ret) {
+				bgp_adj_out_set(rn, peer, p, shared ? shared : &attr, afi, safi, selected, 0);
 			} else {
-				bgp_adj_out_unset(rn, peer, p, afi, safi);
+				bgp_adj_out_unset(rn, peer, p, afi, safi, 0);
 			}
 			break;
 		case BGP_TABLE_RSCLIENT:
 			/* Announcement to peer->conf.  If the route is filtered,
            withdraw it. */
 			if(selected && bgp_announce_check_rsclient(selected, peer, p, &attr, afi, safi)) {
-				bgp_adj_out_set(rn, peer, p, &attr, afi, safi, selected);
+				bgp_adj_out_set(rn, peer, p, &attr, afi, safi, selected, 0);
 			} else {
-				bgp_adj_out_unset(rn, peer, p, afi, safi);
+				bgp_adj_out_unset(rn, peer, p, afi, safi, 0);
 			}
 			break;
+		case BGP_TABLE_RSSHARED:
+			/* see bgp_process_rs_shared() */
+			break;
 	}
 
 	bgp_attr_flush(&attr);
 	return 0;
 }
 
+/* Whether the client with index i accepts ri or, with selected, has it
+ * as its best path, in the shared RS-client table */
+static int bgp_rs_path_test(struct bgp_info *ri, int selected, u_int16_t i) {
+	struct bgp_rs_path *rs = ri->extra ? ri->extra->rs : NULL;
+
+	if(rs == NULL || i / 32 >= rs->words) {
+		return 0;
+	}
+	return (rs->bits[(selected ? rs->words : 0) + i / 32] & (1U << (i % 32))) != 0;
+}
+
+static void bgp_rs_path_set(struct bgp_info *ri, int selected, u_int16_t i, int on) {
+	struct bgp_rs_path *rs = ri->extra ? ri->extra->rs : NULL;
+	struct bgp_rs_path *new;
+	u_int16_t words;
+
+	if(rs == NULL || i / 32 >= rs->words) {
+		if(!on) {
+			return;
+		}
+
+		words = i / 32 + 1;
+		new = XCALLOC(MTYPE_BGP_RS_PATH, sizeof(struct bgp_rs_path) + 2 * words * sizeof(u_int32_t));
+		new->words = words;
+		if(rs) {
+			memcpy(new->bits, rs->bits, rs->words * sizeof(u_int32_t));
+			memcpy(new->bits + words, rs->bits + rs->words, rs->words * sizeof(u_int32_t));
+			XFREE(MTYPE_BGP_RS_PATH, rs);
+		}
+		bgp_info_extra_get(ri)->rs = rs = new;
+	}
+
+	if(on) {
+		rs->bits[(selected ? rs->words : 0) + i / 32] |= (1U << (i % 32));
+	} else {
+		rs->bits[(selected ? rs->words : 0) + i / 32] &= ~(1U << (i % 32));
+	}
+}
+
+/* Run the policy of rsclient between the peer of ri, in the shared
+ * RS-client table, and rsclient: bgp_update_rsclient() and
+ * bgp_static_update_rsclient() for a table of the client's own.  Returns
+ * the attributes the policy leaves ri with, interned, or NULL if the
+ * policy rejects it, with reason set unless ri came from rsclient. */
+static struct attr *bgp_rs_shared_policy(struct peer *rsclient, struct bgp_info *ri, struct prefix *p, afi_t afi, safi_t safi, const char **reason) {
+	struct bgp *bgp = rsclient->bgp;
+	struct peer *peer = ri->peer;
+	struct bgp_node *rn;
+	struct bgp_static *bgp_static;
+	struct bgp_info info;
+	struct attr new_attr;
+	struct attr_extra new_extra;
+	struct attr *attr_new;
+	struct attr *attr_new2;
+	int ret;
+
+	new_attr.extra = &new_extra;
+	bgp_attr_dup(&new_attr, ri->attr);
+
+	if(peer == bgp->peer_self) {
+		/* Apply network route-map for export to this rsclient. */
+		bgp_static = NULL;
+		if(ri->sub_type == BGP_ROUTE_STATIC && (rn = bgp_node_lookup(bgp->route[afi][safi], p))) {
+			bgp_static = rn->info;
+			bgp_unlock_node(rn);
+		}
+		if(bgp_static && bgp_static->rmap.name) {
+			info.peer = rsclient;
+			info.attr = &new_attr;
+
+			SET_FLAG(rsclient->rmap_type, PEER_RMAP_TYPE_EXPORT);
+			SET_FLAG(rsclient->rmap_type, PEER_RMAP_TYPE_NETWORK);
+
+			ret = route_map_apply(bgp_static->rmap.map, p, RMAP_BGP, &info);
+
+			rsclient->rmap_type = 0;
+
+			if(ret == RMAP_DENYMATCH) {
+				bgp_attr_flush(&new_attr);
+				*reason = "network route-map;";
+				return NULL;
+			}
+		}
+	} else {
+		/* Do not send back route to sender. */
+		if(peer == rsclient) {
+			*reason = NULL;
+			return NULL;
+		}
+
+		/* AS path loop check. */
+		if(aspath_loop_check(ri->attr->aspath, rsclient->as) > rsclient->allowas_in[afi][safi]) {
+			*reason = "as-path contains our own AS;";
+			return NULL;
+		}
+
+		/* Route reflector originator ID check.  */
+		if(ri->attr->flag & ATTR_FLAG_BIT(BGP_ATTR_ORIGINATOR_ID) && IPV4_ADDR_SAME(&rsclient->remote_id, &ri->attr->extra->originator_id)) {
+			*reason = "originator is us;";
+			return NULL;
+		}
+
+		/* Apply export policy. */
+		if(CHECK_FLAG(peer->af_flags[afi][safi], PEER_FLAG_RSERVER_CLIENT) && bgp_export_modifier(rsclient, peer, p, &new_attr, afi, safi) == RMAP_DENY) {
+			*reason = "export-policy;";
+			return NULL;
+		}
+	}
+
+	attr_new2 = bgp_attr_intern(&new_attr);
+
+	/* Apply import policy. */
+	if(peer == bgp->peer_self) {
+		SET_FLAG(peer->rmap_type, PEER_RMAP_TYPE_NETWORK);
+	}
+	ret = bgp_import_modifier(rsclient, peer, p, &new_attr, afi, safi);
+	peer->rmap_type = 0;
+
+	if(ret == RMAP_DENY) {
+		bgp_attr_unintern(&attr_new2);
+		*reason = "import-policy;";
+		return NULL;
+	}
+
+	attr_new = bgp_attr_intern(&new_attr);
+	bgp_attr_unintern(&attr_new2);
+
+	/* IPv4 unicast next hop check.  */
+	if(peer != bgp->peer_self && (afi == AFI_IP) && ((safi == SAFI_UNICAST) || safi == SAFI_MULTICAST)) {
+		/* Next hop must not be 0.0.0.0 nor Class D/E address. */
+		if(new_attr.nexthop.s_addr == 0 || IPV4_CLASS_DE(ntohl(new_attr.nexthop.s_addr))) {
+			bgp_attr_unintern(&attr_new);
+			*reason = "martian next-hop;";
+			return NULL;
+		}
+	}
+
+	return attr_new;
+}
+
+/* Announce selected, with riattr what the policy of its RS client left
+ * of it, to peer, or withdraw the prefix.  The Adj-RIB-Out stays in the
+ * client's own table, which has no paths. */
+static void bgp_rs_shared_announce_peer(struct peer *peer, struct bgp_info *selected, struct attr *riattr, struct bgp_node *rn, afi_t afi, safi_t safi) {
+	struct prefix *p = &rn->p;
+	struct bgp_node *crn;
+	struct attr attr;
+	struct attr_extra extra;
+
+	if(peer->status != Established || !peer->afc_nego[afi][safi]) {
+		return;
+	}
+
+	/* First update is deferred until ORF or ROUTE-REFRESH is received */
+	if(CHECK_FLAG(peer->af_sflags[afi][safi], PEER_STATUS_ORF_WAIT_REFRESH)) {
+		return;
+	}
+
+	memset(&attr, 0, sizeof(struct attr));
+	memset(&extra, 0, sizeof(struct attr_extra));
+	attr.extra = &extra;
+
+	if(selected && riattr && bgp_announce_check_rsclient_attr(selected, riattr, peer, p, &attr, afi, safi)) {
+		crn = bgp_node_get(peer->rib[afi][safi], p);
+		bgp_adj_out_set(crn, peer, p, &attr, afi, safi, selected, 0);
+		bgp_unlock_node(crn);
+	} else {
+		/* bgp_node_lookup() only finds nodes with paths */
+		crn = bgp_node_get(peer->rib[afi][safi], p);
+		bgp_adj_out_unset(crn, peer, p, afi, safi, 0);
+		bgp_unlock_node(crn);
+	}
+
+	bgp_attr_flush(&attr);
+}
+
+/* Announce selected to the RS client of entry, or to all the members of
+ * its peer-group, or withdraw the prefix if selected is NULL. */
+static void bgp_rs_shared_announce(struct peer *entry, struct bgp_info *selected, struct bgp_node *rn, afi_t afi, safi_t safi) {
+	struct attr *riattr = NULL;
+	struct peer *peer;
+	struct listnode *node, *nnode;
+	const char *reason;
+
+	if(!CHECK_FLAG(entry->sflags, PEER_STATUS_GROUP) && entry->status != Established) {
+		return;
+	}
+
+	if(selected) {
+		riattr = bgp_rs_shared_policy(entry, selected, &rn->p, afi, safi, &reason);
+	}
+
+	if(CHECK_FLAG(entry->sflags, PEER_STATUS_GROUP)) {
+		if(entry->group) {
+			for(ALL_LIST_ELEMENTS(entry->group->peer, node, nnode, peer)) {
+				bgp_rs_shared_announce_peer(peer, selected, riattr, rn, afi, safi);
+			}
+		}
+	} else {
+		bgp_rs_shared_announce_peer(entry, selected, riattr, rn, afi, safi);
+	}
+
+	if(riattr) {
+		bgp_attr_unintern(&riattr);
+	}
+}
+
+/* Best of the candidates cand of paths, compared on what the policy
+ * of the RS client entry makes of them, for a client whose policy may
+ * change the attributes that count in the selection. */
+static struct bgp_info *bgp_rs_shared_select_policy(struct bgp *bgp, struct peer *entry, struct bgp_info **paths, u_int32_t *cand, unsigned int count, struct bgp_info *old_select, struct bgp_node *rn, afi_t afi, safi_t safi) {
+	struct bgp_info copy[2];
+	struct bgp_info *cur = &copy[0];
+	struct bgp_info *best = NULL;
+	struct bgp_info *new_select = NULL;
+	struct attr *attr;
+	const char *reason;
+	unsigned int k;
+
+	for(k = 0; k < count; k++) {
+		if(!(cand[k / 32] & (1U << (k % 32)))) {
+			continue;
+		}
+		if((attr = bgp_rs_shared_policy(entry, paths[k], &rn->p, afi, safi, &reason)) == NULL) {
+			continue;
+		}
+
+		*cur = *paths[k];
+		cur->attr = attr;
+		if(paths[k] == old_select) {
+			SET_FLAG(cur->flags, BGP_INFO_SELECTED);
+		} else {
+			UNSET_FLAG(cur->flags, BGP_INFO_SELECTED);
+		}
+		bgp_info_key_update(cur);
+
+		if(bgp_info_cmp(bgp, cur, best, afi, safi) == -1) {
+			if(best) {
+				bgp_attr_unintern(&best->attr);
+			}
+			best = cur;
+			cur = (cur == &copy[0]) ? &copy[1] : &copy[0];
+			new_select = paths[k];
+		} else {
+			bgp_attr_unintern(&cur->attr);
+		}
+	}
+
+	if(best) {
+		bgp_attr_unintern(&best->attr);
+	}
+	return new_select;
+}
+
+/* Best path selection on rn, of the shared RS-client table, for each RS
+ * client: among the paths it accepts.  Clients accepting the same paths,
+ * as is common, share one selection, unless their policy may change the
+ * attributes the paths are compared on: an import route-map, shared only
+ * by clients with the same one, or an export route-map of the sender. */
+static void bgp_process_rs_shared(struct bgp *bgp, struct bgp_node *rn, afi_t afi, safi_t safi) {
+	struct bgp_rs_shared *rs = bgp->rs_shared[afi][safi];
+	struct bgp_info *ri;
+	struct bgp_info *nextri;
+	struct bgp_info *old_select;
+	struct bgp_info *new_select;
+	struct bgp_info **paths;
+	struct bgp_info **best;
+	struct listnode *node;
+	struct peer *entry;
+	void **keys;
+	void *key;
+	int policy;
+	u_int32_t *sets;
+	u_int32_t *cand;
+	unsigned int count;
+	unsigned int words;
+	unsigned int nsets = 0;
+	unsigned int k, s;
+	u_int16_t i;
+
+	rn->changed = NULL;
+	UNSET_FLAG(rn->flags, BGP_NODE_SELECT_FULL);
+
+	/* the table went with the last client while rn was queued */
+	if(rs == NULL || rs->table != bgp_node_table(rn)) {
+		return;
+	}
+
+	count = 0;
+	for(ri = rn->info; ri; ri = ri->next) {
+		count++;
+	}
+	words = (count + 31) / 32;
+
+	/* one candidate set per client at most, the last one the scratch */
+	paths = XCALLOC(MTYPE_TMP, (count + 1) * sizeof(struct bgp_info *));
+	best = XCALLOC(MTYPE_TMP, (listcount(bgp->rsclient) + 1) * sizeof(struct bgp_info *));
+	keys = XCALLOC(MTYPE_TMP, (listcount(bgp->rsclient) + 1) * sizeof(void *));
+	sets = XCALLOC(MTYPE_TMP, (listcount(bgp->rsclient) + 1) * (words + 1) * sizeof(u_int32_t));
+
+	for(ri = rn->info, k = 0; ri; ri = ri->next, k++) {
+		paths[k] = ri;
+	}
+
+	for(ALL_LIST_ELEMENTS_RO(bgp->rsclient, node, entry)) {
+		if(!entry->rs_index[afi][safi]) {
+			continue;
+		}
+		i = entry->rs_index[afi][safi] - 1;
+
+		cand = sets + nsets * words;
+		memset(cand, 0, words * sizeof(u_int32_t));
+		old_select = NULL;
+		key = ROUTE_MAP_IMPORT_NAME(&entry->filter[afi][safi]) ? (void *) ROUTE_MAP_IMPORT(&entry->filter[afi][safi]) : NULL;
+		policy = (key != NULL);
+		for(k = 0; k < count; k++) {
+			ri = paths[k];
+			if(bgp_rs_path_test(ri, 1, i)) {
+				old_select = ri;
+			}
+			if(bgp_rs_path_test(ri, 0, i) && bgp_info_selectable(bgp, ri, afi, safi)) {
+				cand[k / 32] |= (1U << (k % 32));
+				if(ri->peer == bgp->peer_self || (CHECK_FLAG(ri->peer->af_flags[afi][safi], PEER_FLAG_RSERVER_CLIENT) && ROUTE_MAP_EXPORT_NAME(&ri->peer->filter[afi][safi]))) {
+					key = entry;
+					policy = 1;
+				}
+			}
+		}
+
+		for(s = 0; s < nsets; s++) {
+			if(keys[s] == key && memcmp(sets + s * words, cand, words * sizeof(u_int32_t)) == 0) {
+				break;
+			}
+		}
+		if(s == nsets) {
+			if(policy) {
+				new_select = bgp_rs_shared_select_policy(bgp, entry, paths, cand, count, old_select, rn, afi, safi);
+			} else {
+				new_select = NULL;
+				for(k = 0; k < count; k++) {
+					if((cand[k / 32] & (1U << (k % 32))) && bgp_info_cmp(bgp, paths[k], new_select, afi, safi) == -1) {
+						new_select = paths[k];
+					}
+				}
+			}
+			keys[nsets] = key;
+			best[nsets++] = new_select;
+			rs->selections++;
+		}
+		new_select = best[s];
+		rs->decisions++;
+
+		/* Nothing to do. */
+		if(old_select == new_select && (!new_select || !CHECK_FLAG(new_select->flags, BGP_INFO_ATTR_CHANGED))) {
+			continue;
+		}
+
+		if(old_select) {
+			bgp_rs_path_set(old_select, 1, i, 0);
+		}
+		if(new_select) {
+			bgp_rs_path_set(new_select, 1, i, 1);
+		}
+		bgp_rs_shared_announce(entry, new_select, rn, afi, safi);
+	}
+
+	XFREE(MTYPE_TMP, paths);
+	XFREE(MTYPE_TMP, best);
+	XFREE(MTYPE_TMP, keys);
+	XFREE(MTYPE_TMP, sets);
+
+	/* Reap the removed paths, no client has them selected any more */
+	for(ri = rn->info; ri && (nextri = ri->next, 1); ri = nextri) {
+		bgp_info_unset_flag(rn, ri, BGP_INFO_ATTR_CHANGED);
+		if(CHECK_FLAG(ri->flags, BGP_INFO_REMOVED)) {
+			bgp_info_reap(rn, ri);
+		}
+	}
+}
+
 struct bgp_process_queue {
 	struct bgp *bgp;
 	struct bgp_node *rn;
 	afi_t afi;
 	safi_t safi;
+
+	/* Result of bgp_best_preselect(), good for the queue run it was
+	 * made in, run + 1, while rn is BGP_NODE_PRESELECTED. */
+	struct bgp_info *preselect;
+	unsigned long preselect_run;
+
+	/* The peer whose route first had the node queued, and when */
+	struct peer *peer;
+	struct timeval queued;
+};
+
+/* Queued nodes a select thread works out the best paths of at once */
+#define BGP_PRESELECT_CHUNK 64
+/* Queued nodes looked ahead at, for all the select threads */
+#define BGP_PRESELECT_BATCH 1024
+
+struct bgp_preselect_chunk {
+	struct bgp_process_queue *pq[BGP_PRESELECT_CHUNK];
+	unsigned int count;
 };
 
+static struct work_pool *bgp_select_pool;
+
+static void bgp_preselect_chunk_run(void *arg) {
+	struct bgp_preselect_chunk *chunk = arg;
+	struct bgp_process_queue *pq;
+	unsigned int i;
+
+	for(i = 0; i < chunk->count; i++) {
+		pq = chunk->pq[i];
+		pq->preselect = bgp_best_preselect(pq->bgp, pq->rn, pq->afi, pq->safi);
+	}
+}
+
+/* Have the select threads work out the best paths of the nodes queued on
+ * wq, from its head on, while the main thread waits.  What they find
+ * holds until the end of this queue run: nothing else can change paths
+ * in the meantime, but processing and bgp_process() on them, which makes
+ * the node lose BGP_NODE_PRESELECTED. */
+static void bgp_process_preselect(struct work_queue *wq) {
+	struct bgp_preselect_chunk *chunks;
+	struct bgp_process_queue *pq;
+	struct work_queue_item *item;
+	struct listnode *node;
+	void **args;
+	unsigned int nchunks = 0;
+	unsigned int looked = 0;
+
+	chunks = XCALLOC(MTYPE_TMP, (BGP_PRESELECT_BATCH / BGP_PRESELECT_CHUNK) * sizeof(struct bgp_preselect_chunk));
+	args = XCALLOC(MTYPE_TMP, (BGP_PRESELECT_BATCH / BGP_PRESELECT_CHUNK) * sizeof(void *));
+
+	for(ALL_LIST_ELEMENTS_RO(wq->items, node, item)) {
+		if(looked++ == BGP_PRESELECT_BATCH) {
+			break;
+		}
+
+		/* looked at, whether it gets a result or not */
+		pq = item->data;
+		pq->preselect_run = wq->runs + 1;
+		if(!bgp_best_preselectable(pq->bgp, pq->rn, pq->afi, pq->safi)) {
+			UNSET_FLAG(pq->rn->flags, BGP_NODE_PRESELECTED);
+			continue;
+		}
+		SET_FLAG(pq->rn->flags, BGP_NODE_PRESELECTED);
+
+		if(nchunks == 0 || chunks[nchunks - 1].count == BGP_PRESELECT_CHUNK) {
+			args[nchunks] = &chunks[nchunks];
+			nchunks++;
+		}
+		chunks[nchunks - 1].pq[chunks[nchunks - 1].count++] = pq;
+	}
+
+	work_pool_run(bgp_select_pool, bgp_preselect_chunk_run, args, nchunks);
+
+	XFREE(MTYPE_TMP, chunks);
+	XFREE(MTYPE_TMP, args);
+}
+
 static wq_item_status bgp_process_rsclient(struct work_queue *wq, void *data) {
 	struct bgp_process_queue *pq = data;
 	struct bgp *bgp = pq->bgp;
@@ -1412,8 +2201,14 @@ static wq_item_status bgp_process_rsclient(struct work_queue *wq, void *data) {
 	struct listnode *node, *nnode;
 	struct peer *rsclient = bgp_node_table(rn)->owner;
 
+	if(bgp_node_table(rn)->type == BGP_TABLE_RSSHARED) {
+		bgp_process_rs_shared(bgp, rn, afi, safi);
+		UNSET_FLAG(rn->flags, BGP_NODE_PROCESS_SCHEDULED);
+		return WQ_SUCCESS;
+	}
+
 	/* Best path selection. */
-	bgp_best_selection(bgp, rn, &old_and_new, afi, safi);
+	bgp_best_selection(bgp, rn, &old_and_new, afi, safi, NULL);
 	new_select = old_and_new.new;
 	old_select = old_and_new.old;
 
@@ -1472,20 +2267,51 @@ static wq_item_status bgp_process_main(struct work_queue *wq, void *data) {
 	struct listnode *node, *nnode;
 	struct peer *peer;
 
-	/* Best path selection. */
-	bgp_best_selection(bgp, rn, &old_and_new, afi, safi);
+	QUAGGA_TRACE(bgp, process, p, afi, safi);
+
+	/* Not done at bgp_route_init() time, as the threads wouldn't survive
+	 * daemonizing. */
+	if(bm->select_threads && bgp_select_pool == NULL) {
+		bgp_select_pool = work_pool_new(bm->master, "BGP best path selection", bm->select_threads);
+	}
+
+	/* Best path selection, made already for the nodes queued next if
+	 * there are select threads. */
+	if(bgp_select_pool && pq->preselect_run != wq->runs + 1) {
+		bgp_process_preselect(wq);
+		if(pq->preselect_run != wq->runs + 1) {
+			pq->preselect_run = wq->runs + 1;
+			UNSET_FLAG(rn->flags, BGP_NODE_PRESELECTED);
+		}
+	}
+	if(pq->preselect_run == wq->runs + 1 && CHECK_FLAG(rn->flags, BGP_NODE_PRESELECTED)) {
+		bgp_best_selection(bgp, rn, &old_and_new, afi, safi, &pq->preselect);
+	} else {
+		bgp_best_selection(bgp, rn, &old_and_new, afi, safi, NULL);
+	}
+	UNSET_FLAG(rn->flags, BGP_NODE_PRESELECTED);
 	old_select = old_and_new.old;
 	new_select = old_and_new.new;
 
 	/* Nothing to do. */
 	if(old_select && old_select == new_select && !CHECK_FLAG(rn->flags, BGP_NODE_USER_CLEAR)) {
 		if(!CHECK_FLAG(old_select->flags, BGP_INFO_ATTR_CHANGED)) {
-			if(CHECK_FLAG(old_select->flags, BGP_INFO_IGP_CHANGED) || CHECK_FLAG(old_select->flags, BGP_INFO_MULTIPATH_CHG)) {
+			/* a route installed through its nexthop's group has
+			 * already moved with the group */
+			if((CHECK_FLAG(old_select->flags, BGP_INFO_IGP_CHANGED) && !CHECK_FLAG(old_select->flags, BGP_INFO_NHG)) || CHECK_FLAG(old_select->flags, BGP_INFO_MULTIPATH_CHG)) {
 				bgp_zebra_announce(p, old_select, bgp, safi);
 			}
 
 			UNSET_FLAG(old_select->flags, BGP_INFO_MULTIPATH_CHG);
 			UNSET_FLAG(rn->flags, BGP_NODE_PROCESS_SCHEDULED);
+
+			/* the paths that changed may still go out by Add-Path */
+			bgp_updgrp_memo_begin();
+			for(ALL_LIST_ELEMENTS(bgp->peer, node, nnode, peer)) {
+				if(BGP_ADDPATH_TX(peer, afi, safi)) {
+					bgp_process_announce_selected(peer, old_select, rn, afi, safi);
+				}
+			}
 			return WQ_SUCCESS;
 		}
 	}
@@ -1503,6 +2329,7 @@ static wq_item_status bgp_process_main(struct work_queue *wq, void *data) {
 	}
 
 	/* Check each BGP peer. */
+	bgp_updgrp_memo_begin();
 	for(ALL_LIST_ELEMENTS(bgp->peer, node, nnode, peer)) {
 		bgp_process_announce_selected(peer, new_select, rn, afi, safi);
 	}
@@ -1524,6 +2351,10 @@ static wq_item_status bgp_process_main(struct work_queue *wq, void *data) {
 		bgp_info_reap(rn, old_select);
 	}
 
+	if(old_select || new_select) {
+		bgp_node_version_bump(rn, new_select == NULL);
+	}
+
 	UNSET_FLAG(rn->flags, BGP_NODE_PROCESS_SCHEDULED);
 	return WQ_SUCCESS;
 }
@@ -1532,12 +2363,27 @@ static void bgp_processq_del(struct work_queue *wq, void *data) {
 	struct bgp_process_queue *pq = data;
 	struct bgp_table *table = bgp_node_table(pq->rn);
 
+	if(pq->peer) {
+		peer_lag_add(&pq->peer->lag_in, &pq->queued);
+		peer_unlock(pq->peer);
+	}
 	bgp_unlock(pq->bgp);
 	bgp_unlock_node(pq->rn);
 	bgp_table_unlock(table);
 	XFREE(MTYPE_BGP_PROCESS_QUEUE, pq);
 }
 
+/* Whether best paths are yet to be worked out for some nodes */
+int bgp_process_busy(void) {
+	return (bm->process_main_queue && listcount(bm->process_main_queue->items)) || (bm->process_rsclient_queue && listcount(bm->process_rsclient_queue->items));
+}
+
+static void bgp_process_complete(struct work_queue *wq) {
+	if(!bgp_process_busy()) {
+		bgp_write_deferred();
+	}
+}
+
 static void bgp_process_queue_init(void) {
 	bm->process_main_queue = work_queue_new(bm->master, "process_main_queue");
 	bm->process_rsclient_queue = work_queue_new(bm->master, "process_rsclient_queue");
@@ -1551,18 +2397,25 @@ static void bgp_process_queue_init(void) {
 	bm->process_main_queue->spec.del_item_data = &bgp_processq_del;
 	bm->process_main_queue->spec.max_retries = 0;
 	bm->process_main_queue->spec.hold = 50;
+	bm->process_main_queue->spec.timeslice = THREAD_YIELD_TIME_SLOT;
 
 	bm->process_rsclient_queue->spec.workfunc = &bgp_process_rsclient;
 	bm->process_rsclient_queue->spec.del_item_data = &bgp_processq_del;
 	bm->process_rsclient_queue->spec.max_retries = 0;
 	bm->process_rsclient_queue->spec.hold = 50;
+	bm->process_rsclient_queue->spec.timeslice = THREAD_YIELD_TIME_SLOT;
+
+	bm->process_main_queue->spec.completion_func = &bgp_process_complete;
+	bm->process_rsclient_queue->spec.completion_func = &bgp_process_complete;
 }
 
-void bgp_process(struct bgp *bgp, struct bgp_node *rn, afi_t afi, safi_t safi) {
+static void bgp_process_schedule(struct bgp *bgp, struct bgp_node *rn, afi_t afi, safi_t safi, struct peer *peer) {
 	struct bgp_process_queue *pqnode;
 
 	/* already scheduled for processing? */
 	if(CHECK_FLAG(rn->flags, BGP_NODE_PROCESS_SCHEDULED)) {
+		/* what's been worked out in advance no longer holds */
+		UNSET_FLAG(rn->flags, BGP_NODE_PRESELECTED);
 		return;
 	}
 
@@ -1592,16 +2445,39 @@ void bgp_process(struct bgp *bgp, struct bgp_node *rn, afi_t afi, safi_t safi) {
 	bgp_lock(bgp);
 	pqnode->afi = afi;
 	pqnode->safi = safi;
+	if(peer && peer != bgp->peer_self) {
+		pqnode->peer = peer_lock(peer);
+		quagga_gettime(QUAGGA_CLK_MONOTONIC, &pqnode->queued);
+	}
 
 	switch(bgp_node_table(rn)->type) {
 		case BGP_TABLE_MAIN: work_queue_add(bm->process_main_queue, pqnode); break;
-		case BGP_TABLE_RSCLIENT: work_queue_add(bm->process_rsclient_queue, pqnode); break;
+		case BGP_TABLE_RSCLIENT:
+		case BGP_TABLE_RSSHARED: work_queue_add(bm->process_rsclient_queue, pqnode); break;
 	}
 
 	SET_FLAG(rn->flags, BGP_NODE_PROCESS_SCHEDULED);
 	return;
 }
 
+/* Anything may have changed on rn, all its paths will be compared. */
+void bgp_process(struct bgp *bgp, struct bgp_node *rn, afi_t afi, safi_t safi) {
+	SET_FLAG(rn->flags, BGP_NODE_SELECT_FULL);
+	bgp_process_schedule(bgp, rn, afi, safi, NULL);
+}
+
+/* Only ri, which a peer announced, replaced or withdrew, has changed on
+ * rn.  If nothing else changes before rn is processed, best path
+ * selection may get away with comparing ri to the selected path alone. */
+void bgp_process_path(struct bgp *bgp, struct bgp_node *rn, struct bgp_info *ri, afi_t afi, safi_t safi) {
+	if(rn->changed == NULL && !CHECK_FLAG(rn->flags, BGP_NODE_PROCESS_SCHEDULED)) {
+		rn->changed = ri;
+	} else if(rn->changed != ri) {
+		SET_FLAG(rn->flags, BGP_NODE_SELECT_FULL);
+	}
+	bgp_process_schedule(bgp, rn, afi, safi, ri->peer);
+}
+
 static int bgp_maximum_prefix_restart_timer(struct thread *thread) {
 	struct peer *peer;
 
@@ -1617,12 +2493,14 @@ static int bgp_maximum_prefix_restart_timer(struct thread *thread) {
 	return 0;
 }
 
-int bgp_maximum_prefix_overflow(struct peer *peer, afi_t afi, safi_t safi, int always) {
+/* Whether having count prefixes from peer takes it over its
+ * maximum-prefix, which is then dealt with */
+static int bgp_maximum_prefix_check(struct peer *peer, afi_t afi, safi_t safi, unsigned long count, int always) {
 	if(!CHECK_FLAG(peer->af_flags[afi][safi], PEER_FLAG_MAX_PREFIX)) {
 		return 0;
 	}
 
-	if(peer->pcount[afi][safi] > peer->pmax[afi][safi]) {
+	if(count > peer->pmax[afi][safi]) {
 		if(CHECK_FLAG(peer->af_sflags[afi][safi], PEER_STATUS_PREFIX_LIMIT) && !always) {
 			return 0;
 		}
@@ -1630,7 +2508,7 @@ int bgp_maximum_prefix_overflow(struct peer *peer, afi_t afi, safi_t safi, int a
 		zlog(peer->log, LOG_INFO,
 		     "%%MAXPFXEXCEED: No. of %s prefix received from %s %ld exceed, "
 		     "limit %ld",
-		     afi_safi_print(afi, safi), peer->host, peer->pcount[afi][safi], peer->pmax[afi][safi]);
+		     afi_safi_print(afi, safi), peer->host, count, peer->pmax[afi][safi]);
 		SET_FLAG(peer->af_sflags[afi][safi], PEER_STATUS_PREFIX_LIMIT);
 
 		if(CHECK_FLAG(peer->af_flags[afi][safi], PEER_FLAG_MAX_PREFIX_WARNING)) {
@@ -1672,12 +2550,12 @@ int bgp_maximum_prefix_overflow(struct peer *peer, afi_t afi, safi_t safi, int a
 		UNSET_FLAG(peer->af_sflags[afi][safi], PEER_STATUS_PREFIX_LIMIT);
 	}
 
-	if(peer->pcount[afi][safi] > (peer->pmax[afi][safi] * peer->pmax_threshold[afi][safi] / 100)) {
+	if(count > (peer->pmax[afi][safi] * peer->pmax_threshold[afi][safi] / 100)) {
 		if(CHECK_FLAG(peer->af_sflags[afi][safi], PEER_STATUS_PREFIX_THRESHOLD) && !always) {
 			return 0;
 		}
 
-		zlog(peer->log, LOG_INFO, "%%MAXPFX: No. of %s prefix received from %s reaches %ld, max %ld", afi_safi_print(afi, safi), peer->host, peer->pcount[afi][safi], peer->pmax[afi][safi]);
+		zlog(peer->log, LOG_INFO, "%%MAXPFX: No. of %s prefix received from %s reaches %ld, max %ld", afi_safi_print(afi, safi), peer->host, count, peer->pmax[afi][safi]);
 		SET_FLAG(peer->af_sflags[afi][safi], PEER_STATUS_PREFIX_THRESHOLD);
 	} else {
 		UNSET_FLAG(peer->af_sflags[afi][safi], PEER_STATUS_PREFIX_THRESHOLD);
@@ -1685,6 +2563,10 @@ int bgp_maximum_prefix_overflow(struct peer *peer, afi_t afi, safi_t safi, int a
 	return 0;
 }
 
+int bgp_maximum_prefix_overflow(struct peer *peer, afi_t afi, safi_t safi, int always) {
+	return bgp_maximum_prefix_check(peer, afi, safi, peer->pcount[afi][safi], always);
+}
+
 /* Unconditionally remove the route from the RIB, without taking
  * damping into consideration (eg, because the session went down)
  */
@@ -1695,7 +2577,7 @@ static void bgp_rib_remove(struct bgp_node *rn, struct bgp_info *ri, struct peer
 		bgp_info_delete(rn, ri); /* keep historical info */
 	}
 
-	bgp_process(peer->bgp, rn, afi, safi);
+	bgp_process_path(peer->bgp, rn, ri, afi, safi);
 }
 
 static void bgp_rib_withdraw(struct bgp_node *rn, struct bgp_info *ri, struct peer *peer, afi_t afi, safi_t safi, struct prefix_rd *prd) {
@@ -1724,11 +2606,168 @@ static struct bgp_info *info_make(int type, int sub_type, struct peer *peer, str
 	new->peer = peer;
 	new->attr = attr;
 	new->uptime = bgp_clock();
+	new->epoch = peer->epoch[bgp_node_table(rn)->afi][bgp_node_table(rn)->safi];
 	new->net = rn;
+	bgp_info_key_update(new);
 	return new;
 }
 
-static void bgp_update_rsclient(struct peer *rsclient, afi_t afi, safi_t safi, struct attr *attr, struct peer *peer, struct prefix *p, int type, int sub_type, struct prefix_rd *prd, u_char *tag) {
+/* The peer whose index in the shared RS-client table rsclient goes by,
+ * itself or its peer-group, or NULL if it has a table of its own. */
+static struct peer *bgp_rs_shared_entry(struct peer *rsclient, afi_t afi, safi_t safi) {
+	struct peer *entry;
+
+	if(rsclient->rib[afi][safi] == NULL) {
+		return NULL;
+	}
+	entry = rsclient->rib[afi][safi]->owner;
+	return (entry && entry->rs_index[afi][safi]) ? entry : NULL;
+}
+
+/* Run the policy of the RS client of entry on ri again.  Returns
+ * whether the client's verdict on ri changed. */
+static int bgp_rs_shared_evaluate(struct peer *entry, struct bgp_info *ri, struct prefix *p, afi_t afi, safi_t safi) {
+	u_int16_t i = entry->rs_index[afi][safi] - 1;
+	struct attr *attr;
+	const char *reason = NULL;
+	char buf[SU_ADDRSTRLEN];
+	int accept;
+
+	attr = bgp_rs_shared_policy(entry, ri, p, afi, safi, &reason);
+	accept = (attr != NULL);
+	if(attr) {
+		bgp_attr_unintern(&attr);
+	} else if(reason && BGP_DEBUG(update, UPDATE_IN)) {
+		zlog(entry->log, LOG_DEBUG, "%s rcvd UPDATE about %s/%d -- DENIED for RS-client %s due to: %s", ri->peer->host, inet_ntop(p->family, &p->u.prefix, buf, SU_ADDRSTRLEN), p->prefixlen, entry->host, reason);
+	}
+
+	if(accept == bgp_rs_path_test(ri, 0, i)) {
+		return 0;
+	}
+	bgp_rs_path_set(ri, 0, i, accept);
+	return 1;
+}
+
+/* Run the policies of all the RS clients sharing the table on ri */
+static void bgp_rs_shared_evaluate_all(struct bgp *bgp, struct bgp_info *ri, struct prefix *p, afi_t afi, safi_t safi) {
+	struct listnode *node;
+	struct peer *entry;
+
+	for(ALL_LIST_ELEMENTS_RO(bgp->rsclient, node, entry)) {
+		if(entry->rs_index[afi][safi]) {
+			bgp_rs_shared_evaluate(entry, ri, p, afi, safi);
+		}
+	}
+}
+
+/* bgp_update_rsclient() for all the RS clients at once: the path goes
+ * into the shared table as received once, and each client's policy is
+ * run on it. */
+static void bgp_update_rs_shared(struct peer *peer, afi_t afi, safi_t safi, struct attr *attr, struct prefix *p, u_int32_t addpath_id, int type, int sub_type) {
+	struct bgp *bgp = peer->bgp;
+	struct bgp_node *rn;
+	struct bgp_info *ri;
+	struct attr new_attr;
+	struct attr_extra new_extra;
+	struct attr *attr_new;
+	char buf[SU_ADDRSTRLEN];
+
+	rn = bgp_node_get(bgp->rs_shared[afi][safi]->table, p);
+
+	/* Check previously received route. */
+	for(ri = rn->info; ri; ri = ri->next) {
+		if(ri->peer == peer && ri->addpath_rx_id == addpath_id && ri->type == type && ri->sub_type == sub_type) {
+			break;
+		}
+	}
+
+	/* Selection sees the weight each import policy starts from */
+	new_attr.extra = &new_extra;
+	bgp_attr_dup(&new_attr, attr);
+	if(peer->weight) {
+		new_attr.weight = peer->weight;
+	}
+	attr_new = bgp_attr_intern(&new_attr);
+
+	if(ri) {
+		ri->uptime = bgp_clock();
+		ri->epoch = peer->epoch[afi][safi];
+
+		/* Same attribute comes in. */
+		if(!CHECK_FLAG(ri->flags, BGP_INFO_REMOVED) && attrhash_cmp(ri->attr, attr_new)) {
+			if(BGP_DEBUG(update, UPDATE_IN)) {
+				zlog(peer->log, LOG_DEBUG, "%s rcvd %s/%d for RS-clients...duplicate ignored", peer->host, inet_ntop(p->family, &p->u.prefix, buf, SU_ADDRSTRLEN), p->prefixlen);
+			}
+
+			bgp_unlock_node(rn);
+			bgp_attr_unintern(&attr_new);
+			return;
+		}
+
+		/* Withdraw/Announce before we fully processed the withdraw */
+		if(CHECK_FLAG(ri->flags, BGP_INFO_REMOVED)) {
+			bgp_info_restore(rn, ri);
+		}
+
+		/* The attribute is changed. */
+		bgp_info_set_flag(rn, ri, BGP_INFO_ATTR_CHANGED);
+
+		/* Update to new attribute.  */
+		bgp_attr_unintern(&ri->attr);
+		ri->attr = attr_new;
+		bgp_info_key_update(ri);
+	} else {
+		ri = info_make(type, sub_type, peer, attr_new, rn);
+		ri->addpath_rx_id = addpath_id;
+
+		/* Register new BGP information. */
+		bgp_info_add(rn, ri);
+	}
+
+	/* Received Logging. */
+	if(BGP_DEBUG(update, UPDATE_IN)) {
+		zlog(peer->log, LOG_DEBUG, "%s rcvd %s/%d for RS-clients", peer->host, inet_ntop(p->family, &p->u.prefix, buf, SU_ADDRSTRLEN), p->prefixlen);
+	}
+
+	/* Nexthop reachability check. */
+	if(sub_type == BGP_ROUTE_STATIC && bgp_flag_check(bgp, BGP_FLAG_IMPORT_CHECK) && !bgp_ensure_nexthop(ri, NULL, 0)) {
+		bgp_info_unset_flag(rn, ri, BGP_INFO_VALID);
+	} else {
+		bgp_info_set_flag(rn, ri, BGP_INFO_VALID);
+	}
+	bgp_rs_shared_evaluate_all(bgp, ri, p, afi, safi);
+
+	/* Process change. */
+	bgp_process(bgp, rn, afi, safi);
+	bgp_unlock_node(rn);
+}
+
+static void bgp_withdraw_rs_shared(struct peer *peer, afi_t afi, safi_t safi, struct prefix *p, u_int32_t addpath_id, int type, int sub_type) {
+	struct bgp_node *rn;
+	struct bgp_info *ri;
+
+	rn = bgp_node_lookup(peer->bgp->rs_shared[afi][safi]->table, p);
+	if(rn == NULL) {
+		return;
+	}
+
+	/* Lookup withdrawn route. */
+	for(ri = rn->info; ri; ri = ri->next) {
+		if(ri->peer == peer && ri->addpath_rx_id == addpath_id && ri->type == type && ri->sub_type == sub_type) {
+			break;
+		}
+	}
+
+	/* Withdraw specified route from routing table. */
+	if(ri && !CHECK_FLAG(ri->flags, BGP_INFO_HISTORY)) {
+		bgp_rib_withdraw(rn, ri, peer, afi, safi, NULL);
+	}
+
+	/* Unlock bgp_node_lookup() lock. */
+	bgp_unlock_node(rn);
+}
+
+static void bgp_update_rsclient(struct peer *rsclient, afi_t afi, safi_t safi, struct attr *attr, struct peer *peer, struct prefix *p, u_int32_t addpath_id, int type, int sub_type, struct prefix_rd *prd, u_char *tag) {
 	struct bgp_node *rn;
 	struct bgp *bgp;
 	struct attr new_attr;
@@ -1740,6 +2779,12 @@ static void bgp_update_rsclient(struct peer *rsclient, afi_t afi, safi_t safi, s
 	const char *reason;
 	char buf[SU_ADDRSTRLEN];
 
+	/* Paths in the shared table are there for all clients */
+	if(bgp_rs_shared_entry(rsclient, afi, safi)) {
+		bgp_update_rs_shared(peer, afi, safi, attr, p, addpath_id, type, sub_type);
+		return;
+	}
+
 	/* Do not insert announces from a rsclient into its own 'bgp_table'. */
 	if(peer == rsclient) {
 		return;
@@ -1750,7 +2795,7 @@ static void bgp_update_rsclient(struct peer *rsclient, afi_t afi, safi_t safi, s
 
 	/* Check previously received route. */
 	for(ri = rn->info; ri; ri = ri->next) {
-		if(ri->peer == peer && ri->type == type && ri->sub_type == sub_type) {
+		if(ri->peer == peer && ri->addpath_rx_id == addpath_id && ri->type == type && ri->sub_type == sub_type) {
 			break;
 		}
 	}
@@ -1803,6 +2848,7 @@ static void bgp_update_rsclient(struct peer *rsclient, afi_t afi, safi_t safi, s
 	/* If the update is implicit withdraw. */
 	if(ri) {
 		ri->uptime = bgp_clock();
+		ri->epoch = peer->epoch[afi][safi];
 
 		/* Same attribute comes in. */
 		if(!CHECK_FLAG(ri->flags, BGP_INFO_REMOVED) && attrhash_cmp(ri->attr, attr_new)) {
@@ -1832,6 +2878,7 @@ static void bgp_update_rsclient(struct peer *rsclient, afi_t afi, safi_t safi, s
 		/* Update to new attribute.  */
 		bgp_attr_unintern(&ri->attr);
 		ri->attr = attr_new;
+		bgp_info_key_update(ri);
 
 		/* Update MPLS tag.  */
 		if(safi == SAFI_MPLS_VPN) {
@@ -1853,6 +2900,7 @@ static void bgp_update_rsclient(struct peer *rsclient, afi_t afi, safi_t safi, s
 	}
 
 	new = info_make(type, sub_type, peer, attr_new, rn);
+	new->addpath_rx_id = addpath_id;
 
 	/* Update MPLS tag. */
 	if(safi == SAFI_MPLS_VPN) {
@@ -1888,38 +2936,224 @@ filtered:
 	return;
 }
 
-static void bgp_withdraw_rsclient(struct peer *rsclient, afi_t afi, safi_t safi, struct peer *peer, struct prefix *p, int type, int sub_type, struct prefix_rd *prd, u_char *tag) {
-	struct bgp_node *rn;
-	struct bgp_info *ri;
-	char buf[SU_ADDRSTRLEN];
-
-	if(rsclient == peer) {
+static void bgp_withdraw_rsclient(struct peer *rsclient, afi_t afi, safi_t safi, struct peer *peer, struct prefix *p, u_int32_t addpath_id, int type, int sub_type, struct prefix_rd *prd, u_char *tag) {
+	struct bgp_node *rn;
+	struct bgp_info *ri;
+	char buf[SU_ADDRSTRLEN];
+
+	if(rsclient == peer) {
+		return;
+	}
+
+	rn = bgp_afi_node_get(rsclient->rib[afi][safi], afi, safi, p, prd);
+
+	/* Lookup withdrawn route. */
+	for(ri = rn->info; ri; ri = ri->next) {
+		if(ri->peer == peer && ri->addpath_rx_id == addpath_id && ri->type == type && ri->sub_type == sub_type) {
+			break;
+		}
+	}
+
+	/* Withdraw specified route from routing table. */
+	if(ri && !CHECK_FLAG(ri->flags, BGP_INFO_HISTORY)) {
+		bgp_rib_withdraw(rn, ri, peer, afi, safi, prd);
+	} else if(BGP_DEBUG(update, UPDATE_IN)) {
+		zlog(peer->log, LOG_DEBUG, "%s Can't find the route %s/%d", peer->host, inet_ntop(p->family, &p->u.prefix, buf, SU_ADDRSTRLEN), p->prefixlen);
+	}
+
+	/* Unlock bgp_node_get() lock. */
+	bgp_unlock_node(rn);
+}
+
+/* Inbound policy shared by the prefixes of the UPDATE being parsed, see
+   bgp_update_batch_begin() */
+struct bgp_update_batch {
+	struct peer *peer; /* NULL when no batch is open */
+	struct attr *attr;
+	afi_t afi;
+	safi_t safi;
+
+	/* whether the route-map in can be evaluated once for all */
+	int rmap_shared;
+
+	int evaluated;
+	const char *reason;    /* why the routes are filtered, or NULL */
+	struct attr *attr_new; /* interned, holds a reference */
+};
+
+static struct bgp_update_batch bgp_update_batch;
+
+/* The inbound checks that only look at the attributes as received.
+   Returns why the route is filtered, or NULL. */
+static const char *bgp_update_check_attr(struct peer *peer, struct attr *attr, afi_t afi, safi_t safi) {
+	struct bgp *bgp = peer->bgp;
+	int aspath_loop_count = 0;
+
+	/* AS path local-as loop check. */
+	if(peer->change_local_as) {
+		if(!CHECK_FLAG(peer->flags, PEER_FLAG_LOCAL_AS_NO_PREPEND)) {
+			aspath_loop_count = 1;
+		}
+
+		if(aspath_loop_check(attr->aspath, peer->change_local_as) > aspath_loop_count) {
+			return "as-path contains our own AS;";
+		}
+	}
+
+	/* AS path loop check. */
+	if(aspath_loop_check(attr->aspath, bgp->as) > peer->allowas_in[afi][safi] || (CHECK_FLAG(bgp->config, BGP_CONFIG_CONFEDERATION) && aspath_loop_check(attr->aspath, bgp->confed_id) > peer->allowas_in[afi][safi])) {
+		return "as-path contains our own AS;";
+	}
+
+	/* Route reflector originator ID check.  */
+	if(attr->flag & ATTR_FLAG_BIT(BGP_ATTR_ORIGINATOR_ID) && IPV4_ADDR_SAME(&bgp->router_id, &attr->extra->originator_id)) {
+		return "originator is us;";
+	}
+
+	/* Route reflector cluster ID check.  */
+	if(bgp_cluster_filter(peer, attr)) {
+		return "reflected from the same cluster;";
+	}
+
+	/* Apply incoming filter-list.  */
+	if(bgp_input_filter(peer, NULL, attr, afi, safi) == FILTER_DENY) {
+		return "filter;";
+	}
+
+	return NULL;
+}
+
+/* Copy attr into new_attr, whose extra must be set, and apply the
+   incoming route-map and next hop check to it.  Returns why the route is
+   filtered, having flushed new_attr, or NULL. */
+static const char *bgp_update_modify(struct peer *peer, struct prefix *p, struct attr *attr, struct attr *new_attr, afi_t afi, safi_t safi) {
+	bgp_attr_dup(new_attr, attr);
+
+	/* Apply incoming route-map.
+   * NB: new_attr may now contain newly allocated values from route-map "set"
+   * commands, so we need bgp_attr_flush in the error paths, until we intern
+   * the attr (which takes over the memory references) */
+	if(bgp_input_modifier(peer, p, new_attr, afi, safi) == RMAP_DENY) {
+		bgp_attr_flush(new_attr);
+		return "route-map;";
+	}
+
+	/* IPv4 unicast next hop check.  */
+	if(afi == AFI_IP && safi == SAFI_UNICAST) {
+		/* Next hop must not be 0.0.0.0 nor Class D/E address. Next hop
+	 must not be my own address.  */
+		if(new_attr->nexthop.s_addr == 0 || IPV4_CLASS_DE(ntohl(new_attr->nexthop.s_addr)) || bgp_nexthop_self(new_attr)) {
+			bgp_attr_flush(new_attr);
+			return "martian next-hop;";
+		}
+	}
+
+	return NULL;
+}
+
+/* Open a batch for the prefixes of an UPDATE, all received with attr.
+   The attribute-only part of the inbound policy is evaluated once, for
+   the first of them, and its result reused for the rest, which then only
+   go through the distribute-list and prefix-list.  The same goes for the
+   route-map, and the interned result, if no rule of the route-map looks
+   at the prefix. */
+static void bgp_update_batch_begin(struct peer *peer, struct attr *attr, afi_t afi, safi_t safi) {
+	struct bgp_update_batch *batch = &bgp_update_batch;
+	struct bgp_filter *filter = &peer->filter[afi][safi];
+
+	memset(batch, 0, sizeof(struct bgp_update_batch));
+	batch->peer = peer;
+	batch->attr = attr;
+	batch->afi = afi;
+	batch->safi = safi;
+	batch->rmap_shared = (route_map_rule_walk(ROUTE_MAP_IN(filter), bgp_rmap_rule_per_prefix, NULL) == 0);
+}
+
+static void bgp_update_batch_end(void) {
+	struct bgp_update_batch *batch = &bgp_update_batch;
+
+	if(batch->attr_new) {
+		bgp_attr_unintern(&batch->attr_new);
+	}
+	memset(batch, 0, sizeof(struct bgp_update_batch));
+}
+
+/* The open batch, evaluated for p if that's the first prefix, if it
+   covers this update. */
+static struct bgp_update_batch *bgp_update_batch_get(struct peer *peer, struct prefix *p, struct attr *attr, afi_t afi, safi_t safi) {
+	struct bgp_update_batch *batch = &bgp_update_batch;
+	struct attr new_attr;
+	struct attr_extra new_extra;
+
+	if(batch->peer != peer || batch->attr != attr || batch->afi != afi || batch->safi != safi) {
+		return NULL;
+	}
+
+	if(batch->evaluated) {
+		return batch;
+	}
+	batch->evaluated = 1;
+
+	batch->reason = bgp_update_check_attr(peer, attr, afi, safi);
+	if(batch->reason || !batch->rmap_shared) {
+		return batch;
+	}
+
+	memset(&new_attr, 0, sizeof(struct attr));
+	memset(&new_extra, 0, sizeof(struct attr_extra));
+	new_attr.extra = &new_extra;
+
+	batch->reason = bgp_update_modify(peer, p, attr, &new_attr, afi, safi);
+	if(batch->reason == NULL) {
+		batch->attr_new = bgp_attr_intern(&new_attr);
+		bgp_attr_flush(&new_attr);
+	}
+	return batch;
+}
+
+/* With soft-reconfiguration inbound, what a peer sent is only kept in
+ * the Adj-RIB-In when it is not also where the path ended up: when
+ * inbound policy left the attributes alone, the path is flagged
+ * BGP_INFO_ADJ_IN and its own attr stands for the received one.
+ *
+ * Records adj_attr, interned from what came in, for peer at rn once the
+ * update has gone through policy, and drops the reference to it.
+ */
+static void bgp_adj_in_record(struct bgp_node *rn, struct peer *peer, u_int32_t addpath_id, struct bgp_info *ri, int accepted, struct attr **adj_attr) {
+	if(*adj_attr == NULL) {
 		return;
 	}
 
-	rn = bgp_afi_node_get(rsclient->rib[afi][safi], afi, safi, p, prd);
-
-	/* Lookup withdrawn route. */
-	for(ri = rn->info; ri; ri = ri->next) {
-		if(ri->peer == peer && ri->type == type && ri->sub_type == sub_type) {
-			break;
+	if(accepted && ri->attr == *adj_attr) {
+		bgp_adj_in_unset(rn, peer, addpath_id);
+		SET_FLAG(ri->flags, BGP_INFO_ADJ_IN);
+	} else {
+		bgp_adj_in_set(rn, peer, *adj_attr, addpath_id);
+		if(ri) {
+			UNSET_FLAG(ri->flags, BGP_INFO_ADJ_IN);
 		}
 	}
+	bgp_attr_unintern(adj_attr);
+}
 
-	/* Withdraw specified route from routing table. */
-	if(ri && !CHECK_FLAG(ri->flags, BGP_INFO_HISTORY)) {
-		bgp_rib_withdraw(rn, ri, peer, afi, safi, prd);
-	} else if(BGP_DEBUG(update, UPDATE_IN)) {
-		zlog(peer->log, LOG_DEBUG, "%s Can't find the route %s/%d", peer->host, inet_ntop(p->family, &p->u.prefix, buf, SU_ADDRSTRLEN), p->prefixlen);
-	}
+/* bgp_adj_in_unset(), for a path standing in for the Adj-RIB-In entry
+ * too. */
+static int bgp_adj_in_clear(struct bgp_node *rn, struct peer *peer, u_int32_t addpath_id) {
+	struct bgp_info *ri;
+	int found;
 
-	/* Unlock bgp_node_get() lock. */
-	bgp_unlock_node(rn);
+	found = bgp_adj_in_unset(rn, peer, addpath_id);
+	for(ri = rn->info; ri; ri = ri->next) {
+		if(ri->peer == peer && ri->addpath_rx_id == addpath_id && CHECK_FLAG(ri->flags, BGP_INFO_ADJ_IN)) {
+			UNSET_FLAG(ri->flags, BGP_INFO_ADJ_IN);
+			found = 1;
+		}
+	}
+	return found;
 }
 
-static int bgp_update_main(struct peer *peer, struct prefix *p, struct attr *attr, afi_t afi, safi_t safi, int type, int sub_type, struct prefix_rd *prd, u_char *tag, int soft_reconfig) {
+static int bgp_update_main(struct peer *peer, struct prefix *p, u_int32_t addpath_id, struct attr *attr, afi_t afi, safi_t safi, int type, int sub_type, struct prefix_rd *prd, u_char *tag, int soft_reconfig) {
 	int ret;
-	int aspath_loop_count = 0;
 	struct bgp_node *rn;
 	struct bgp *bgp;
 	struct attr new_attr;
@@ -1927,6 +3161,8 @@ static int bgp_update_main(struct peer *peer, struct prefix *p, struct attr *att
 	struct attr *attr_new;
 	struct bgp_info *ri;
 	struct bgp_info *new;
+	struct bgp_update_batch *batch;
+	struct attr *adj_attr = NULL;
 	const char *reason;
 	char buf[SU_ADDRSTRLEN];
 	int connected = 0;
@@ -1938,83 +3174,49 @@ static int bgp_update_main(struct peer *peer, struct prefix *p, struct attr *att
 	rn = bgp_afi_node_get(bgp->rib[afi][safi], afi, safi, p, prd);
 
 	/* When peer's soft reconfiguration enabled.  Record input packet in
-     Adj-RIBs-In.  */
-	if(!soft_reconfig && CHECK_FLAG(peer->af_flags[afi][safi], PEER_FLAG_SOFT_RECONFIG) && peer != bgp->peer_self) {
-		bgp_adj_in_set(rn, peer, attr);
+     Adj-RIBs-In, see bgp_adj_in_record().  On soft reconfiguration attr
+     may be the path's own, this keeps it about. */
+	if(CHECK_FLAG(peer->af_flags[afi][safi], PEER_FLAG_SOFT_RECONFIG) && peer != bgp->peer_self) {
+		adj_attr = bgp_attr_intern(attr);
 	}
 
 	/* Check previously received route. */
 	for(ri = rn->info; ri; ri = ri->next) {
-		if(ri->peer == peer && ri->type == type && ri->sub_type == sub_type) {
+		if(ri->peer == peer && ri->addpath_rx_id == addpath_id && ri->type == type && ri->sub_type == sub_type) {
 			break;
 		}
 	}
 
-	/* AS path local-as loop check. */
-	if(peer->change_local_as) {
-		if(!CHECK_FLAG(peer->flags, PEER_FLAG_LOCAL_AS_NO_PREPEND)) {
-			aspath_loop_count = 1;
-		}
-
-		if(aspath_loop_check(attr->aspath, peer->change_local_as) > aspath_loop_count) {
-			reason = "as-path contains our own AS;";
-			goto filtered;
-		}
-	}
-
-	/* AS path loop check. */
-	if(aspath_loop_check(attr->aspath, bgp->as) > peer->allowas_in[afi][safi] || (CHECK_FLAG(bgp->config, BGP_CONFIG_CONFEDERATION) && aspath_loop_check(attr->aspath, bgp->confed_id) > peer->allowas_in[afi][safi])) {
-		reason = "as-path contains our own AS;";
-		goto filtered;
-	}
-
-	/* Route reflector originator ID check.  */
-	if(attr->flag & ATTR_FLAG_BIT(BGP_ATTR_ORIGINATOR_ID) && IPV4_ADDR_SAME(&bgp->router_id, &attr->extra->originator_id)) {
-		reason = "originator is us;";
-		goto filtered;
-	}
-
-	/* Route reflector cluster ID check.  */
-	if(bgp_cluster_filter(peer, attr)) {
-		reason = "reflected from the same cluster;";
+	/* AS path loops, reflection and filter-list, maybe for the whole
+	   UPDATE at once. */
+	batch = bgp_update_batch_get(peer, p, attr, afi, safi);
+	reason = batch ? batch->reason : bgp_update_check_attr(peer, attr, afi, safi);
+	if(reason) {
 		goto filtered;
 	}
 
-	/* Apply incoming filter.  */
-	if(bgp_input_filter(peer, p, attr, afi, safi) == FILTER_DENY) {
+	/* Apply incoming distribute-list and prefix-list.  */
+	if(bgp_input_filter(peer, p, NULL, afi, safi) == FILTER_DENY) {
 		reason = "filter;";
 		goto filtered;
 	}
 
-	new_attr.extra = &new_extra;
-	bgp_attr_dup(&new_attr, attr);
-
-	/* Apply incoming route-map.
-   * NB: new_attr may now contain newly allocated values from route-map "set"
-   * commands, so we need bgp_attr_flush in the error paths, until we intern
-   * the attr (which takes over the memory references) */
-	if(bgp_input_modifier(peer, p, &new_attr, afi, safi) == RMAP_DENY) {
-		reason = "route-map;";
-		bgp_attr_flush(&new_attr);
-		goto filtered;
-	}
-
-	/* IPv4 unicast next hop check.  */
-	if(afi == AFI_IP && safi == SAFI_UNICAST) {
-		/* Next hop must not be 0.0.0.0 nor Class D/E address. Next hop
-	 must not be my own address.  */
-		if(new_attr.nexthop.s_addr == 0 || IPV4_CLASS_DE(ntohl(new_attr.nexthop.s_addr)) || bgp_nexthop_self(&new_attr)) {
-			reason = "martian next-hop;";
-			bgp_attr_flush(&new_attr);
+	if(batch && batch->attr_new) {
+		attr_new = bgp_attr_intern(batch->attr_new);
+	} else {
+		new_attr.extra = &new_extra;
+		reason = bgp_update_modify(peer, p, attr, &new_attr, afi, safi);
+		if(reason) {
 			goto filtered;
 		}
-	}
 
-	attr_new = bgp_attr_intern(&new_attr);
+		attr_new = bgp_attr_intern(&new_attr);
+	}
 
 	/* If the update is implicit withdraw. */
 	if(ri) {
 		ri->uptime = bgp_clock();
+		ri->epoch = peer->epoch[afi][safi];
 
 		/* Same attribute comes in. */
 		if(!CHECK_FLAG(ri->flags, BGP_INFO_REMOVED) && attrhash_cmp(ri->attr, attr_new)) {
@@ -2040,6 +3242,7 @@ static int bgp_update_main(struct peer *peer, struct prefix *p, struct attr *att
 				}
 			}
 
+			bgp_adj_in_record(rn, peer, addpath_id, ri, 1, &adj_attr);
 			bgp_unlock_node(rn);
 			bgp_attr_unintern(&attr_new);
 			bgp_attr_flush(&new_attr);
@@ -2085,6 +3288,7 @@ static int bgp_update_main(struct peer *peer, struct prefix *p, struct attr *att
 		/* Update to new attribute.  */
 		bgp_attr_unintern(&ri->attr);
 		ri->attr = attr_new;
+		bgp_info_key_update(ri);
 
 		/* Update MPLS tag.  */
 		if(safi == SAFI_MPLS_VPN) {
@@ -2098,6 +3302,7 @@ static int bgp_update_main(struct peer *peer, struct prefix *p, struct attr *att
 			/* Now we do normal update dampening.  */
 			ret = bgp_damp_update(ri, rn, afi, safi);
 			if(ret == BGP_DAMP_SUPPRESSED) {
+				bgp_adj_in_record(rn, peer, addpath_id, ri, 1, &adj_attr);
 				bgp_unlock_node(rn);
 				return 0;
 			}
@@ -2130,7 +3335,8 @@ static int bgp_update_main(struct peer *peer, struct prefix *p, struct attr *att
 		/* Process change. */
 		bgp_aggregate_increment(bgp, p, ri, afi, safi);
 
-		bgp_process(bgp, rn, afi, safi);
+		bgp_process_path(bgp, rn, ri, afi, safi);
+		bgp_adj_in_record(rn, peer, addpath_id, ri, 1, &adj_attr);
 		bgp_unlock_node(rn);
 
 		return 0;
@@ -2143,6 +3349,7 @@ static int bgp_update_main(struct peer *peer, struct prefix *p, struct attr *att
 
 	/* Make new BGP info. */
 	new = info_make(type, sub_type, peer, attr_new, rn);
+	new->addpath_rx_id = addpath_id;
 
 	/* Update MPLS tag. */
 	if(safi == SAFI_MPLS_VPN) {
@@ -2176,6 +3383,7 @@ static int bgp_update_main(struct peer *peer, struct prefix *p, struct attr *att
 
 	/* Register new BGP information. */
 	bgp_info_add(rn, new);
+	bgp_adj_in_record(rn, peer, addpath_id, new, 1, &adj_attr);
 
 	/* route_node_get lock */
 	bgp_unlock_node(rn);
@@ -2189,7 +3397,7 @@ static int bgp_update_main(struct peer *peer, struct prefix *p, struct attr *att
 	}
 
 	/* Process change. */
-	bgp_process(bgp, rn, afi, safi);
+	bgp_process_path(bgp, rn, new, afi, safi);
 
 	return 0;
 
@@ -2200,6 +3408,7 @@ filtered:
 		zlog(peer->log, LOG_DEBUG, "%s rcvd UPDATE about %s/%d -- DENIED due to: %s", peer->host, inet_ntop(p->family, &p->u.prefix, buf, SU_ADDRSTRLEN), p->prefixlen, reason);
 	}
 
+	bgp_adj_in_record(rn, peer, addpath_id, ri, 0, &adj_attr);
 	if(ri) {
 		bgp_rib_remove(rn, ri, peer, afi, safi);
 	}
@@ -2210,27 +3419,31 @@ filtered:
 	return 0;
 }
 
-int bgp_update(struct peer *peer, struct prefix *p, struct attr *attr, afi_t afi, safi_t safi, int type, int sub_type, struct prefix_rd *prd, u_char *tag, int soft_reconfig) {
+int bgp_update(struct peer *peer, struct prefix *p, u_int32_t addpath_id, struct attr *attr, afi_t afi, safi_t safi, int type, int sub_type, struct prefix_rd *prd, u_char *tag, int soft_reconfig) {
 	struct peer *rsclient;
 	struct listnode *node, *nnode;
 	struct bgp *bgp;
 	int ret;
 
-	ret = bgp_update_main(peer, p, attr, afi, safi, type, sub_type, prd, tag, soft_reconfig);
+	ret = bgp_update_main(peer, p, addpath_id, attr, afi, safi, type, sub_type, prd, tag, soft_reconfig);
+	bgp_bmp_route(peer, p, afi, safi);
 
 	bgp = peer->bgp;
 
 	/* Process the update for each RS-client. */
+	if(bgp->rs_shared[afi][safi]) {
+		bgp_update_rs_shared(peer, afi, safi, attr, p, addpath_id, type, sub_type);
+	}
 	for(ALL_LIST_ELEMENTS(bgp->rsclient, node, nnode, rsclient)) {
-		if(CHECK_FLAG(rsclient->af_flags[afi][safi], PEER_FLAG_RSERVER_CLIENT)) {
-			bgp_update_rsclient(rsclient, afi, safi, attr, peer, p, type, sub_type, prd, tag);
+		if(CHECK_FLAG(rsclient->af_flags[afi][safi], PEER_FLAG_RSERVER_CLIENT) && !rsclient->rs_index[afi][safi]) {
+			bgp_update_rsclient(rsclient, afi, safi, attr, peer, p, addpath_id, type, sub_type, prd, tag);
 		}
 	}
 
 	return ret;
 }
 
-int bgp_withdraw(struct peer *peer, struct prefix *p, struct attr *attr, afi_t afi, safi_t safi, int type, int sub_type, struct prefix_rd *prd, u_char *tag) {
+int bgp_withdraw(struct peer *peer, struct prefix *p, u_int32_t addpath_id, struct attr *attr, afi_t afi, safi_t safi, int type, int sub_type, struct prefix_rd *prd, u_char *tag) {
 	struct bgp *bgp;
 	char buf[SU_ADDRSTRLEN];
 	struct bgp_node *rn;
@@ -2249,7 +3462,7 @@ int bgp_withdraw(struct peer *peer, struct prefix *p, struct attr *attr, afi_t a
    * Since we need to remove the entry from adj_in anyway, do that first and
    * if there was no entry, we don't need to do anything more. */
 	if(CHECK_FLAG(peer->af_flags[afi][safi], PEER_FLAG_SOFT_RECONFIG) && peer != bgp->peer_self) {
-		if(!bgp_adj_in_unset(rn, peer)) {
+		if(!bgp_adj_in_clear(rn, peer, addpath_id)) {
 			if(BGP_DEBUG(update, UPDATE_IN)) {
 				zlog(peer->log, LOG_DEBUG,
 				     "%s withdrawing route %s/%d "
@@ -2262,9 +3475,12 @@ int bgp_withdraw(struct peer *peer, struct prefix *p, struct attr *attr, afi_t a
 	}
 
 	/* Process the withdraw for each RS-client. */
+	if(bgp->rs_shared[afi][safi]) {
+		bgp_withdraw_rs_shared(peer, afi, safi, p, addpath_id, type, sub_type);
+	}
 	for(ALL_LIST_ELEMENTS(bgp->rsclient, node, nnode, rsclient)) {
-		if(CHECK_FLAG(rsclient->af_flags[afi][safi], PEER_FLAG_RSERVER_CLIENT)) {
-			bgp_withdraw_rsclient(rsclient, afi, safi, peer, p, type, sub_type, prd, tag);
+		if(CHECK_FLAG(rsclient->af_flags[afi][safi], PEER_FLAG_RSERVER_CLIENT) && !rsclient->rs_index[afi][safi]) {
+			bgp_withdraw_rsclient(rsclient, afi, safi, peer, p, addpath_id, type, sub_type, prd, tag);
 		}
 	}
 
@@ -2275,7 +3491,7 @@ int bgp_withdraw(struct peer *peer, struct prefix *p, struct attr *attr, afi_t a
 
 	/* Lookup withdrawn route. */
 	for(ri = rn->info; ri; ri = ri->next) {
-		if(ri->peer == peer && ri->type == type && ri->sub_type == sub_type) {
+		if(ri->peer == peer && ri->addpath_rx_id == addpath_id && ri->type == type && ri->sub_type == sub_type) {
 			break;
 		}
 	}
@@ -2283,6 +3499,7 @@ int bgp_withdraw(struct peer *peer, struct prefix *p, struct attr *attr, afi_t a
 	/* Withdraw specified route from routing table. */
 	if(ri && !CHECK_FLAG(ri->flags, BGP_INFO_HISTORY)) {
 		bgp_rib_withdraw(rn, ri, peer, afi, safi, prd);
+		bgp_bmp_route(peer, p, afi, safi);
 	} else if(BGP_DEBUG(update, UPDATE_IN)) {
 		zlog(peer->log, LOG_DEBUG, "%s Can't find the route %s/%d", peer->host, inet_ntop(p->family, &p->u.prefix, buf, SU_ADDRSTRLEN), p->prefixlen);
 	}
@@ -2384,11 +3601,61 @@ void bgp_default_originate(struct peer *peer, afi_t afi, safi_t safi, int withdr
 	aspath_unintern(&aspath);
 }
 
+/* bgp_announce_table() for an RS client sharing its table */
+static void bgp_announce_table_rs_shared(struct peer *peer, struct peer *entry, afi_t afi, safi_t safi) {
+	struct bgp_node *rn;
+	struct bgp_info *ri;
+	struct attr *riattr;
+	const char *reason;
+	u_int16_t i = entry->rs_index[afi][safi] - 1;
+
+	for(rn = bgp_table_top_info(peer->bgp->rs_shared[afi][safi]->table); rn; rn = bgp_route_next_info(rn)) {
+		for(ri = rn->info; ri; ri = ri->next) {
+			if(bgp_rs_path_test(ri, 1, i)) {
+				break;
+			}
+		}
+		if(ri && ri->peer != peer) {
+			riattr = bgp_rs_shared_policy(entry, ri, &rn->p, afi, safi, &reason);
+			bgp_rs_shared_announce_peer(peer, ri, riattr, rn, afi, safi);
+			if(riattr) {
+				bgp_attr_unintern(&riattr);
+			}
+		}
+	}
+}
+
+static void bgp_announce_node(struct peer *peer, struct bgp_node *rn, struct attr *attr, afi_t afi, safi_t safi, int rsclient) {
+	struct bgp_info *ri;
+
+	if(!rsclient && BGP_ADDPATH_TX(peer, afi, safi) && bgp_node_table(rn)->type == BGP_TABLE_MAIN) {
+		for(ri = rn->info; ri; ri = ri->next) {
+			if(CHECK_FLAG(ri->flags, BGP_INFO_SELECTED)) {
+				break;
+			}
+		}
+		bgp_updgrp_memo_begin();
+		bgp_process_announce_addpath(peer, ri, rn, afi, safi);
+		return;
+	}
+
+	for(ri = rn->info; ri; ri = ri->next) {
+		if(CHECK_FLAG(ri->flags, BGP_INFO_SELECTED) && ri->peer != peer) {
+			if((rsclient) ? (bgp_announce_check_rsclient(ri, peer, &rn->p, attr, afi, safi)) : (bgp_announce_check(ri, peer, &rn->p, attr, afi, safi))) {
+				bgp_adj_out_set(rn, peer, &rn->p, attr, afi, safi, ri, 0);
+			} else {
+				bgp_adj_out_unset(rn, peer, &rn->p, afi, safi, 0);
+			}
+		}
+	}
+}
+
 static void bgp_announce_table(struct peer *peer, afi_t afi, safi_t safi, struct bgp_table *table, int rsclient) {
 	struct bgp_node *rn;
 	struct bgp_info *ri;
 	struct attr attr;
 	struct attr_extra extra;
+	struct peer *entry;
 
 	memset(&extra, 0, sizeof(extra));
 
@@ -2400,22 +3667,132 @@ static void bgp_announce_table(struct peer *peer, afi_t afi, safi_t safi, struct
 		bgp_default_originate(peer, afi, safi, 0);
 	}
 
+	if(rsclient && (entry = bgp_rs_shared_entry(peer, afi, safi))) {
+		bgp_announce_table_rs_shared(peer, entry, afi, safi);
+		return;
+	}
+
 	/* It's initialized in bgp_announce_[check|check_rsclient]() */
 	attr.extra = &extra;
 
-	for(rn = bgp_table_top(table); rn; rn = bgp_route_next(rn)) {
-		for(ri = rn->info; ri; ri = ri->next) {
-			if(CHECK_FLAG(ri->flags, BGP_INFO_SELECTED) && ri->peer != peer) {
-				if((rsclient) ? (bgp_announce_check_rsclient(ri, peer, &rn->p, &attr, afi, safi)) : (bgp_announce_check(ri, peer, &rn->p, &attr, afi, safi))) {
-					bgp_adj_out_set(rn, peer, &rn->p, &attr, afi, safi, ri);
-				} else {
-					bgp_adj_out_unset(rn, peer, &rn->p, afi, safi);
-				}
+	for(rn = bgp_table_top_info(table); rn; rn = bgp_route_next_info(rn)) {
+		bgp_announce_node(peer, rn, &attr, afi, safi, rsclient);
+	}
+
+	bgp_attr_flush_encap(&attr);
+}
+
+static void bgp_announce_walk_free(struct bgp_announce_walk *walk) {
+	struct peer *peer = walk->peer;
+
+	if(walk->t_walk) {
+		thread_cancel(walk->t_walk);
+	}
+	if(walk->iter.table) {
+		bgp_table_iter_cleanup(&walk->iter);
+	}
+	peer->announce_walk[walk->afi][walk->safi] = NULL;
+	XFREE(MTYPE_BGP_ANNOUNCE_WALK, walk);
+	peer_unlock(peer);
+}
+
+static void bgp_announce_walk_table(struct bgp_announce_walk *walk, struct bgp_table *table) {
+	bgp_table_iter_init(&walk->iter, table);
+	walk->walked = 0;
+	walk->total = bgp_table_count(table);
+}
+
+/* Announce the next announce_pace nodes of the walk's table */
+static int bgp_announce_walk_func(struct thread *t) {
+	struct bgp_announce_walk *walk = THREAD_ARG(t);
+	struct peer *peer = walk->peer;
+	struct bgp_node *rn;
+	struct attr attr;
+	struct attr_extra extra;
+	u_int32_t count;
+
+	walk->t_walk = NULL;
+
+	if(peer->status != Established || !peer->afc_nego[walk->afi][walk->safi]) {
+		bgp_announce_walk_free(walk);
+		return 0;
+	}
+
+	memset(&extra, 0, sizeof(extra));
+	attr.extra = &extra;
+
+	for(count = 0; count < peer->bgp->announce_pace; count++) {
+		rn = bgp_table_iter_next(&walk->iter);
+		if(rn == NULL) {
+			bgp_table_iter_cleanup(&walk->iter);
+			if(walk->rsclient_next && peer->rib[walk->afi][walk->safi]) {
+				walk->rsclient = 1;
+				walk->rsclient_next = 0;
+				bgp_announce_walk_table(walk, peer->rib[walk->afi][walk->safi]);
+				continue;
 			}
+			break;
+		}
+
+		walk->walked++;
+		if(rn->info) {
+			bgp_announce_node(peer, rn, &attr, walk->afi, walk->safi, walk->rsclient);
 		}
 	}
 
 	bgp_attr_flush_encap(&attr);
+
+	if(!walk->iter.table) {
+		if(BGP_DEBUG(update, UPDATE_OUT)) {
+			zlog_debug("%s announced %s table", peer->host, afi_safi_print(walk->afi, walk->safi));
+		}
+		bgp_announce_walk_free(walk);
+
+		/* the End-of-RIB waited for the walk */
+		BGP_WRITE_ON(peer->t_write, bgp_write, peer->fd);
+		return 0;
+	}
+
+	bgp_table_iter_pause(&walk->iter);
+	walk->t_walk = thread_add_background(bm->master, bgp_announce_walk_func, walk, 0);
+	return 0;
+}
+
+/* (Re)start the peer's walk of the main table, and its own after */
+static void bgp_announce_walk_start(struct peer *peer, afi_t afi, safi_t safi) {
+	struct bgp_announce_walk *walk = peer->announce_walk[afi][safi];
+
+	if(walk) {
+		bgp_table_iter_cleanup(&walk->iter);
+	} else {
+		walk = XCALLOC(MTYPE_BGP_ANNOUNCE_WALK, sizeof(struct bgp_announce_walk));
+		walk->peer = peer_lock(peer);
+		walk->afi = afi;
+		walk->safi = safi;
+		peer->announce_walk[afi][safi] = walk;
+		walk->t_walk = thread_add_background(bm->master, bgp_announce_walk_func, walk, 0);
+	}
+
+	walk->rsclient = 0;
+	walk->rsclient_next = CHECK_FLAG(peer->af_flags[afi][safi], PEER_FLAG_RSERVER_CLIENT) && !bgp_rs_shared_entry(peer, afi, safi);
+	bgp_announce_walk_table(walk, peer->bgp->rib[afi][safi]);
+}
+
+void bgp_announce_walk_stop(struct peer *peer, afi_t afi, safi_t safi) {
+	if(peer->announce_walk[afi][safi]) {
+		bgp_announce_walk_free(peer->announce_walk[afi][safi]);
+	}
+}
+
+void bgp_announce_walk_stop_all(struct peer *peer) {
+	afi_t afi;
+	safi_t safi;
+
+	for(afi = AFI_IP; afi < AFI_MAX; afi++) {
+		for(safi = SAFI_UNICAST; safi < SAFI_MAX; safi++) {
+			bgp_announce_walk_stop(peer, afi, safi);
+		}
+	}
 }
 
 void bgp_announce_route(struct peer *peer, afi_t afi, safi_t safi) {
@@ -2435,13 +3812,22 @@ void bgp_announce_route(struct peer *peer, afi_t afi, safi_t safi) {
 		return;
 	}
 
+	/* Unicast and multicast tables are walked in the background, the two
+	 * level VPN and ENCAP ones, and shared route-server tables, here. */
 	if((safi != SAFI_MPLS_VPN) && (safi != SAFI_ENCAP)) {
-		bgp_announce_table(peer, afi, safi, NULL, 0);
-	} else {
-		for(rn = bgp_table_top(peer->bgp->rib[afi][safi]); rn; rn = bgp_route_next(rn)) {
-			if((table = (rn->info)) != NULL) {
-				bgp_announce_table(peer, afi, safi, table, 0);
-			}
+		if(CHECK_FLAG(peer->af_flags[afi][safi], PEER_FLAG_DEFAULT_ORIGINATE)) {
+			bgp_default_originate(peer, afi, safi, 0);
+		}
+		bgp_announce_walk_start(peer, afi, safi);
+		if(CHECK_FLAG(peer->af_flags[afi][safi], PEER_FLAG_RSERVER_CLIENT) && bgp_rs_shared_entry(peer, afi, safi)) {
+			bgp_announce_table(peer, afi, safi, NULL, 1);
+		}
+		return;
+	}
+
+	for(rn = bgp_table_top(peer->bgp->rib[afi][safi]); rn; rn = bgp_route_next(rn)) {
+		if((table = (rn->info)) != NULL) {
+			bgp_announce_table(peer, afi, safi, table, 0);
 		}
 	}
 
@@ -2470,11 +3856,47 @@ static void bgp_soft_reconfig_table_rsclient(struct peer *rsclient, afi_t afi, s
 	}
 
 	for(rn = bgp_table_top(table); rn; rn = bgp_route_next(rn)) {
+		struct bgp_info *ri;
+
 		for(ain = rn->adj_in; ain; ain = ain->next) {
-			struct bgp_info *ri = rn->info;
-			u_char *tag = (ri && ri->extra) ? ri->extra->tag : NULL;
+			u_char *tag;
+
+			ri = rn->info;
+			tag = (ri && ri->extra) ? ri->extra->tag : NULL;
+			bgp_update_rsclient(rsclient, afi, safi, ain->attr, ain->peer, &rn->p, ain->addpath_rx_id, ZEBRA_ROUTE_BGP, BGP_ROUTE_NORMAL, prd, tag);
+		}
+		for(ri = rn->info; ri; ri = ri->next) {
+			if(CHECK_FLAG(ri->flags, BGP_INFO_ADJ_IN)) {
+				bgp_update_rsclient(rsclient, afi, safi, ri->attr, ri->peer, &rn->p, ri->addpath_rx_id, ZEBRA_ROUTE_BGP, BGP_ROUTE_NORMAL, prd, ri->extra ? ri->extra->tag : NULL);
+			}
+		}
+	}
+}
+
+/* Run the policy of the RS client of entry on all the paths of the shared
+ * table, after it joined the table or changed its policy. */
+static void bgp_soft_reconfig_rs_shared(struct peer *entry, afi_t afi, safi_t safi) {
+	struct bgp_node *rn;
+	struct bgp_info *ri;
+	struct bgp_info *selected;
+	u_int16_t i = entry->rs_index[afi][safi] - 1;
+	int changed;
+
+	for(rn = bgp_table_top_info(entry->bgp->rs_shared[afi][safi]->table); rn; rn = bgp_route_next_info(rn)) {
+		changed = 0;
+		selected = NULL;
+		for(ri = rn->info; ri; ri = ri->next) {
+			changed |= bgp_rs_shared_evaluate(entry, ri, &rn->p, afi, safi);
+			if(bgp_rs_path_test(ri, 1, i)) {
+				selected = ri;
+			}
+		}
 
-			bgp_update_rsclient(rsclient, afi, safi, ain->attr, ain->peer, &rn->p, ZEBRA_ROUTE_BGP, BGP_ROUTE_NORMAL, prd, tag);
+		/* what the policy makes of the selected path may have changed */
+		if(changed) {
+			bgp_process(entry->bgp, rn, afi, safi);
+		} else if(selected) {
+			bgp_rs_shared_announce(entry, selected, rn, afi, safi);
 		}
 	}
 }
@@ -2482,6 +3904,14 @@ static void bgp_soft_reconfig_table_rsclient(struct peer *rsclient, afi_t afi, s
 void bgp_soft_reconfig_rsclient(struct peer *rsclient, afi_t afi, safi_t safi) {
 	struct bgp_table *table;
 	struct bgp_node *rn;
+	struct peer *entry;
+
+	/* Paths received before the shared table was there go into it first */
+	if((entry = bgp_rs_shared_entry(rsclient, afi, safi))) {
+		bgp_soft_reconfig_table_rsclient(rsclient, afi, safi, NULL, NULL);
+		bgp_soft_reconfig_rs_shared(entry, afi, safi);
+		return;
+	}
 
 	if((safi != SAFI_MPLS_VPN) && (safi != SAFI_ENCAP)) {
 		bgp_soft_reconfig_table_rsclient(rsclient, afi, safi, NULL, NULL);
@@ -2511,23 +3941,78 @@ static void bgp_soft_reconfig_table(struct peer *peer, afi_t afi, safi_t safi, s
 	}
 
 	for(rn = bgp_table_top(table); rn; rn = bgp_route_next(rn)) {
-		for(ain = rn->adj_in; ain; ain = ain->next) {
+		struct bgp_info *ri, *next;
+		struct bgp_adj_in *ain_next;
+
+		/* An Add-Path peer has as many entries as it sent paths.  Those
+		   the paths stand in for may move to rn->adj_in, ahead of the
+		   entries already there, which are then done on their own. */
+		ain = rn->adj_in;
+		for(ri = rn->info; ri; ri = next) {
+			next = ri->next;
+			if(ri->peer == peer && CHECK_FLAG(ri->flags, BGP_INFO_ADJ_IN)) {
+				ret = bgp_update(peer, &rn->p, ri->addpath_rx_id, ri->attr, afi, safi, ZEBRA_ROUTE_BGP, BGP_ROUTE_NORMAL, prd, ri->extra ? ri->extra->tag : NULL, 1);
+
+				if(ret < 0) {
+					bgp_unlock_node(rn);
+					return;
+				}
+			}
+		}
+
+		for(; ain; ain = ain_next) {
+			ain_next = ain->next;
 			if(ain->peer == peer) {
-				struct bgp_info *ri = rn->info;
-				u_char *tag = (ri && ri->extra) ? ri->extra->tag : NULL;
+				u_char *tag;
 
-				ret = bgp_update(peer, &rn->p, ain->attr, afi, safi, ZEBRA_ROUTE_BGP, BGP_ROUTE_NORMAL, prd, tag, 1);
+				ri = rn->info;
+				tag = (ri && ri->extra) ? ri->extra->tag : NULL;
+				ret = bgp_update(peer, &rn->p, ain->addpath_rx_id, ain->attr, afi, safi, ZEBRA_ROUTE_BGP, BGP_ROUTE_NORMAL, prd, tag, 1);
 
 				if(ret < 0) {
 					bgp_unlock_node(rn);
 					return;
 				}
-				continue;
 			}
 		}
 	}
 }
 
+/* Run the inbound policy again on the paths of rn it can be run on, those
+ * of peers keeping an Adj-RIB-In, then the selection on all of them. */
+void bgp_soft_reconfig_node(struct bgp *bgp, struct bgp_node *rn, afi_t afi, safi_t safi) {
+	struct bgp_info *ri, *next;
+	struct bgp_adj_in *ain, *ain_next;
+	u_char *tag;
+
+	/* as in bgp_soft_reconfig_table(), entries ahead of ain are those
+	   the paths just done moved to */
+	ain = rn->adj_in;
+	for(ri = rn->info; ri; ri = next) {
+		next = ri->next;
+		if(CHECK_FLAG(ri->flags, BGP_INFO_ADJ_IN) && ri->peer->status == Established) {
+			if(bgp_update(ri->peer, &rn->p, ri->addpath_rx_id, ri->attr, afi, safi, ZEBRA_ROUTE_BGP, BGP_ROUTE_NORMAL, NULL, ri->extra ? ri->extra->tag : NULL, 1) < 0) {
+				return;
+			}
+		}
+	}
+
+	for(; ain; ain = ain_next) {
+		ain_next = ain->next;
+		if(ain->peer->status == Established) {
+			ri = rn->info;
+			tag = (ri && ri->extra) ? ri->extra->tag : NULL;
+			if(bgp_update(ain->peer, &rn->p, ain->addpath_rx_id, ain->attr, afi, safi, ZEBRA_ROUTE_BGP, BGP_ROUTE_NORMAL, NULL, tag, 1) < 0) {
+				return;
+			}
+		}
+	}
+
+	if(rn->info) {
+		bgp_process(bgp, rn, afi, safi);
+	}
+}
+
 void bgp_soft_reconfig_in(struct peer *peer, afi_t afi, safi_t safi) {
 	struct bgp_node *rn;
 	struct bgp_table *table;
@@ -2552,50 +4037,122 @@ void bgp_soft_reconfig_in(struct peer *peer, afi_t afi, safi_t safi) {
 	}
 }
 
+/* A table to clear of a peer, BGP_CLEAR_NODE_BATCH nodes per queue run
+ * of the item.  Clearing a peer thus queues an item per table: its paths
+ * are dead from the start, see BGP_INFO_DEAD, which is all selection
+ * needs to know of them until the item gets to their nodes. */
 struct bgp_clear_node_queue {
-	struct bgp_node *rn;
+	bgp_table_iter_t iter;
 	enum bgp_clear_route_type purpose;
+
+	/* Keep the paths, as stale, for the peer to refresh */
+	int nsf;
 };
 
+#define BGP_CLEAR_NODE_BATCH 100
+
+static void bgp_clear_node(struct peer *peer, struct bgp_node *rn, struct bgp_clear_node_queue *cnq, afi_t afi, safi_t safi) {
+	struct bgp_info *ri, *ri_next;
+	struct bgp_adj_in *ain, *ain_next;
+	struct bgp_adj_out *aout, *aout_next;
+
+	/* Overview: There are 3 different indices which need to be
+	 * scrubbed, potentially, when a peer is removed:
+	 *
+	 * 1 peer's routes visible via the RIB (ie accepted routes)
+	 * 2 peer's routes visible by the (optional) peer's adj-in index
+	 * 3 other routes visible by the peer's adj-out index
+	 *
+	 * 1 and 2 must be 'scrubbed' in some way, at least made
+	 * invisible via RIB index before peer session is allowed to be
+	 * brought back up: the FSM waits in Clearing for the queue.
+	 *
+	 * With Add-Path a peer may have several of each on the node.
+	 */
+	if(cnq->purpose != BGP_CLEAR_ROUTE_STALE) {
+		for(ain = rn->adj_in; ain; ain = ain_next) {
+			ain_next = ain->next;
+			if(ain->peer == peer || cnq->purpose == BGP_CLEAR_ROUTE_MY_RSCLIENT) {
+				bgp_adj_in_remove(rn, ain);
+				bgp_unlock_node(rn);
+			}
+		}
+		for(aout = rn->adj_out; aout; aout = aout_next) {
+			aout_next = aout->next;
+			if(aout->peer == peer || cnq->purpose == BGP_CLEAR_ROUTE_MY_RSCLIENT) {
+				bgp_adj_out_remove(rn, aout, peer, afi, safi);
+				bgp_unlock_node(rn);
+			}
+		}
+		if(rn->adj_shared && cnq->purpose == BGP_CLEAR_ROUTE_NORMAL) {
+			bgp_adj_out_shared_unset(rn, peer, afi, safi);
+		}
+	}
+
+	for(ri = rn->info; ri; ri = ri_next) {
+		ri_next = ri->next;
+		if(ri->peer == peer || cnq->purpose == BGP_CLEAR_ROUTE_MY_RSCLIENT) {
+			/* selection got here first */
+			if(CHECK_FLAG(ri->flags, BGP_INFO_REMOVED)) {
+				continue;
+			}
+
+			if(cnq->purpose == BGP_CLEAR_ROUTE_STALE) {
+				if(CHECK_FLAG(ri->flags, BGP_INFO_STALE) || BGP_INFO_DEAD(ri, afi, safi)) {
+					bgp_rib_remove(rn, ri, peer, afi, safi);
+				}
+				continue;
+			}
+
+			/* gone from the Adj-RIB-In along with the rest */
+			UNSET_FLAG(ri->flags, BGP_INFO_ADJ_IN);
+
+			/* graceful restart STALE flag set. */
+			if(cnq->nsf && !BGP_INFO_DEAD(ri, afi, safi) && !CHECK_FLAG(ri->flags, BGP_INFO_STALE) && !CHECK_FLAG(ri->flags, BGP_INFO_UNUSEABLE)) {
+				bgp_info_set_flag(rn, ri, BGP_INFO_STALE);
+			} else {
+				bgp_rib_remove(rn, ri, peer, afi, safi);
+			}
+		}
+	}
+}
+
 static wq_item_status bgp_clear_route_node(struct work_queue *wq, void *data) {
 	struct bgp_clear_node_queue *cnq = data;
-	struct bgp_node *rn = cnq->rn;
 	struct peer *peer = wq->spec.data;
-	struct bgp_info *ri;
-	afi_t afi = bgp_node_table(rn)->afi;
-	safi_t safi = bgp_node_table(rn)->safi;
+	struct bgp_node *rn;
+	afi_t afi = cnq->iter.table->afi;
+	safi_t safi = cnq->iter.table->safi;
+	int count;
 
-	assert(rn && peer);
+	assert(peer);
 
-	for(ri = rn->info; ri; ri = ri->next) {
-		if(ri->peer == peer || cnq->purpose == BGP_CLEAR_ROUTE_MY_RSCLIENT) {
-			/* graceful restart STALE flag set. */
-			if(CHECK_FLAG(peer->sflags, PEER_STATUS_NSF_WAIT) && peer->nsf[afi][safi] && !CHECK_FLAG(ri->flags, BGP_INFO_STALE) && !CHECK_FLAG(ri->flags, BGP_INFO_UNUSEABLE)) {
-				bgp_info_set_flag(rn, ri, BGP_INFO_STALE);
-			} else {
-				bgp_rib_remove(rn, ri, peer, afi, safi);
-			}
-			break;
+	for(count = 0; count < BGP_CLEAR_NODE_BATCH; count++) {
+		if((rn = bgp_table_iter_next(&cnq->iter)) == NULL) {
+			return WQ_SUCCESS;
 		}
+		bgp_clear_node(peer, rn, cnq, afi, safi);
 	}
-	return WQ_SUCCESS;
+
+	bgp_table_iter_pause(&cnq->iter);
+	return WQ_REQUEUE;
 }
 
 static void bgp_clear_node_queue_del(struct work_queue *wq, void *data) {
 	struct bgp_clear_node_queue *cnq = data;
-	struct bgp_node *rn = cnq->rn;
-	struct bgp_table *table = bgp_node_table(rn);
 
-	bgp_unlock_node(rn);
-	bgp_table_unlock(table);
+	bgp_table_iter_cleanup(&cnq->iter);
 	XFREE(MTYPE_BGP_CLEAR_NODE_QUEUE, cnq);
 }
 
 static void bgp_clear_node_complete(struct work_queue *wq) {
 	struct peer *peer = wq->spec.data;
 
-	/* Tickle FSM to start moving again */
-	BGP_EVENT_ADD(peer, Clearing_Completed);
+	/* Tickle FSM to start moving again, if it waits: stale paths and
+	 * address families are cleared with the session up. */
+	if(peer->status == Clearing || peer->status == Deleted) {
+		BGP_EVENT_ADD(peer, Clearing_Completed);
+	}
 
 	peer_unlock(peer); /* bgp_clear_route */
 }
@@ -2621,84 +4178,23 @@ static void bgp_clear_node_queue_init(struct peer *peer) {
 }
 
 static void bgp_clear_route_table(struct peer *peer, afi_t afi, safi_t safi, struct bgp_table *table, struct peer *rsclient, enum bgp_clear_route_type purpose) {
-	struct bgp_node *rn;
+	struct bgp_clear_node_queue *cnq;
 
 	if(!table) {
 		table = (rsclient) ? rsclient->rib[afi][safi] : peer->bgp->rib[afi][safi];
 	}
 
 	/* If still no table => afi/safi isn't configured at all or smth. */
-	if(!table) {
+	if(!table || bgp_table_count(table) == 0) {
 		return;
 	}
 
-	for(rn = bgp_table_top(table); rn; rn = bgp_route_next(rn)) {
-		struct bgp_info *ri;
-		struct bgp_adj_in *ain;
-		struct bgp_adj_out *aout;
-
-		/* XXX:TODO: This is suboptimal, every non-empty route_node is
-       * queued for every clearing peer, regardless of whether it is
-       * relevant to the peer at hand.
-       *
-       * Overview: There are 3 different indices which need to be
-       * scrubbed, potentially, when a peer is removed:
-       *
-       * 1 peer's routes visible via the RIB (ie accepted routes)
-       * 2 peer's routes visible by the (optional) peer's adj-in index
-       * 3 other routes visible by the peer's adj-out index
-       *
-       * 3 there is no hurry in scrubbing, once the struct peer is
-       * removed from bgp->peer, we could just GC such deleted peer's
-       * adj-outs at our leisure.
-       *
-       * 1 and 2 must be 'scrubbed' in some way, at least made
-       * invisible via RIB index before peer session is allowed to be
-       * brought back up. So one needs to know when such a 'search' is
-       * complete.
-       *
-       * Ideally:
-       *
-       * - there'd be a single global queue or a single RIB walker
-       * - rather than tracking which route_nodes still need to be
-       *   examined on a peer basis, we'd track which peers still
-       *   aren't cleared
-       *
-       * Given that our per-peer prefix-counts now should be reliable,
-       * this may actually be achievable. It doesn't seem to be a huge
-       * problem at this time,
-       */
-		for(ain = rn->adj_in; ain; ain = ain->next) {
-			if(ain->peer == peer || purpose == BGP_CLEAR_ROUTE_MY_RSCLIENT) {
-				bgp_adj_in_remove(rn, ain);
-				bgp_unlock_node(rn);
-				break;
-			}
-		}
-		for(aout = rn->adj_out; aout; aout = aout->next) {
-			if(aout->peer == peer || purpose == BGP_CLEAR_ROUTE_MY_RSCLIENT) {
-				bgp_adj_out_remove(rn, aout, peer, afi, safi);
-				bgp_unlock_node(rn);
-				break;
-			}
-		}
-
-		for(ri = rn->info; ri; ri = ri->next) {
-			if(ri->peer == peer || purpose == BGP_CLEAR_ROUTE_MY_RSCLIENT) {
-				struct bgp_clear_node_queue *cnq;
-
-				/* both unlocked in bgp_clear_node_queue_del */
-				bgp_table_lock(bgp_node_table(rn));
-				bgp_lock_node(rn);
-				cnq = XCALLOC(MTYPE_BGP_CLEAR_NODE_QUEUE, sizeof(struct bgp_clear_node_queue));
-				cnq->rn = rn;
-				cnq->purpose = purpose;
-				work_queue_add(peer->clear_node_queue, cnq);
-				break;
-			}
-		}
-	}
-	return;
+	/* the table unlocked in bgp_clear_node_queue_del */
+	cnq = XCALLOC(MTYPE_BGP_CLEAR_NODE_QUEUE, sizeof(struct bgp_clear_node_queue));
+	bgp_table_iter_init(&cnq->iter, table);
+	cnq->purpose = purpose;
+	cnq->nsf = CHECK_FLAG(peer->sflags, PEER_STATUS_NSF_WAIT) && peer->nsf[afi][safi];
+	work_queue_add(peer->clear_node_queue, cnq);
 }
 
 void bgp_clear_route(struct peer *peer, afi_t afi, safi_t safi, enum bgp_clear_route_type purpose) {
@@ -2731,8 +4227,19 @@ void bgp_clear_route(struct peer *peer, afi_t afi, safi_t safi, enum bgp_clear_r
 	if(!peer->clear_node_queue->thread) {
 		peer_lock(peer); /* bgp_clear_node_complete */
 	}
+
+	/* All at once, the peer's paths are dead, or stale under graceful
+	 * restart, before the queue gets to clear them */
+	if(purpose == BGP_CLEAR_ROUTE_NORMAL) {
+		peer->epoch[afi][safi]++;
+		if(!CHECK_FLAG(peer->sflags, PEER_STATUS_NSF_WAIT) || !peer->nsf[afi][safi]) {
+			peer->epoch_live[afi][safi] = peer->epoch[afi][safi];
+		}
+	}
+
 	switch(purpose) {
 		case BGP_CLEAR_ROUTE_NORMAL:
+		case BGP_CLEAR_ROUTE_STALE:
 			if((safi != SAFI_MPLS_VPN) && (safi != SAFI_ENCAP)) {
 				bgp_clear_route_table(peer, afi, safi, NULL, NULL, purpose);
 			} else {
@@ -2743,8 +4250,15 @@ void bgp_clear_route(struct peer *peer, afi_t afi, safi_t safi, enum bgp_clear_r
 				}
 			}
 
+			/* Clients sharing a table have their Adj-RIB-Out alone in theirs */
+			if(peer->bgp->rs_shared[afi][safi]) {
+				bgp_clear_route_table(peer, afi, safi, peer->bgp->rs_shared[afi][safi]->table, NULL, purpose);
+				if(CHECK_FLAG(peer->af_flags[afi][safi], PEER_FLAG_RSERVER_CLIENT) && peer->rib[afi][safi]) {
+					bgp_clear_route_table(peer, afi, safi, peer->rib[afi][safi], NULL, purpose);
+				}
+			}
 			for(ALL_LIST_ELEMENTS(peer->bgp->rsclient, node, nnode, rsclient)) {
-				if(CHECK_FLAG(rsclient->af_flags[afi][safi], PEER_FLAG_RSERVER_CLIENT)) {
+				if(CHECK_FLAG(rsclient->af_flags[afi][safi], PEER_FLAG_RSERVER_CLIENT) && !rsclient->rs_index[afi][safi]) {
 					bgp_clear_route_table(peer, afi, safi, NULL, rsclient, purpose);
 				}
 			}
@@ -2825,43 +4339,53 @@ void bgp_process_queues_drain_immediate(void) {
 	bgp_drain_workqueue_immediate(bm->process_rsclient_queue);
 }
 
+/* Hold back best path selection, nodes queue up meanwhile; or go on. */
+void bgp_process_hold(int hold) {
+	if((bm->process_main_queue == NULL) || (bm->process_rsclient_queue == NULL)) {
+		bgp_process_queue_init();
+	}
+
+	if(hold) {
+		work_queue_plug(bm->process_main_queue);
+		work_queue_plug(bm->process_rsclient_queue);
+	} else {
+		work_queue_unplug(bm->process_main_queue);
+		work_queue_unplug(bm->process_rsclient_queue);
+	}
+}
+
 void bgp_clear_adj_in(struct peer *peer, afi_t afi, safi_t safi) {
 	struct bgp_table *table;
 	struct bgp_node *rn;
-	struct bgp_adj_in *ain;
 
 	table = peer->bgp->rib[afi][safi];
 
 	for(rn = bgp_table_top(table); rn; rn = bgp_route_next(rn)) {
-		for(ain = rn->adj_in; ain; ain = ain->next) {
+		struct bgp_adj_in *ain, *next;
+		struct bgp_info *ri;
+
+		for(ain = rn->adj_in; ain; ain = next) {
+			next = ain->next;
 			if(ain->peer == peer) {
 				bgp_adj_in_remove(rn, ain);
 				bgp_unlock_node(rn);
-				break;
 			}
 		}
-	}
-}
-
-void bgp_clear_stale_route(struct peer *peer, afi_t afi, safi_t safi) {
-	struct bgp_node *rn;
-	struct bgp_info *ri;
-	struct bgp_table *table;
-
-	table = peer->bgp->rib[afi][safi];
-
-	for(rn = bgp_table_top(table); rn; rn = bgp_route_next(rn)) {
 		for(ri = rn->info; ri; ri = ri->next) {
 			if(ri->peer == peer) {
-				if(CHECK_FLAG(ri->flags, BGP_INFO_STALE)) {
-					bgp_rib_remove(rn, ri, peer, afi, safi);
-				}
-				break;
+				UNSET_FLAG(ri->flags, BGP_INFO_ADJ_IN);
 			}
 		}
 	}
 }
 
+/* Paths the peer did not refresh since it restarted are dead from now */
+void bgp_clear_stale_route(struct peer *peer, afi_t afi, safi_t safi) {
+	UNSET_FLAG(peer->sflags, PEER_STATUS_SNAPSHOT);
+	peer->epoch_live[afi][safi] = peer->epoch[afi][safi];
+	bgp_clear_route(peer, afi, safi, BGP_CLEAR_ROUTE_STALE);
+}
+
 static void bgp_cleanup_table(struct bgp_table *table, safi_t safi) {
 	struct bgp_node *rn;
 	struct bgp_info *ri;
@@ -2920,19 +4444,125 @@ void bgp_reset(void) {
 	prefix_list_reset();
 }
 
-/* Parse NLRI stream.  Withdraw NLRI is recognized by NULL attr
-   value. */
-int bgp_nlri_parse_ip(struct peer *peer, struct attr *attr, struct bgp_nlri *packet) {
+/* Update or withdraw one prefix from an NLRI stream.  Returns -1 if
+   the session can't go on. */
+/* Whether peer has a path for p with the path ID, in the RIB proper */
+static int bgp_update_ingress_known(struct peer *peer, struct prefix *p, u_int32_t addpath_id, afi_t afi, safi_t safi) {
+	struct bgp_node *rn;
+	struct bgp_info *ri;
+
+	rn = bgp_node_lookup(peer->bgp->rib[afi][safi], p);
+	if(!rn) {
+		return 0;
+	}
+	for(ri = rn->info; ri; ri = ri->next) {
+		if(ri->peer == peer && ri->addpath_rx_id == addpath_id && ri->type == ZEBRA_ROUTE_BGP && ri->sub_type == BGP_ROUTE_NORMAL) {
+			break;
+		}
+	}
+	bgp_unlock_node(rn);
+	return ri != NULL;
+}
+
+/* Drop, before bgp_update() gets a node for it, a prefix new from peer
+   that the incoming distribute-list or prefix-list denies, or that takes
+   peer over its maximum-prefix.  A peer leaking a full table then costs
+   the parsing only.  Prefixes peer already has a path for go on to
+   bgp_update(), to be replaced or withdrawn there; so do filtered ones
+   that soft reconfiguration keeps in Adj-RIB-In, or RS-clients may
+   take, as the incoming filters aren't theirs.  Returns 1 to drop p, -1
+   when the session is being brought down. */
+static int bgp_update_ingress(struct peer *peer, struct prefix *p, u_int32_t addpath_id, afi_t afi, safi_t safi) {
+	struct bgp_filter *filter = &peer->filter[afi][safi];
+	char buf[SU_ADDRSTRLEN];
+	int deny = 0;
+	int limit = 0;
+
+	if((DISTRIBUTE_IN_NAME(filter) || PREFIX_LIST_IN_NAME(filter)) && !CHECK_FLAG(peer->af_flags[afi][safi], PEER_FLAG_SOFT_RECONFIG) && !listcount(peer->bgp->rsclient)) {
+		deny = bgp_input_filter(peer, p, NULL, afi, safi) == FILTER_DENY;
+	}
+	if(CHECK_FLAG(peer->af_flags[afi][safi], PEER_FLAG_MAX_PREFIX) && !CHECK_FLAG(peer->af_flags[afi][safi], PEER_FLAG_MAX_PREFIX_WARNING)) {
+		limit = peer->pcount[afi][safi] >= peer->pmax[afi][safi];
+	}
+	if(!deny && !limit) {
+		return 0;
+	}
+
+	if(bgp_update_ingress_known(peer, p, addpath_id, afi, safi)) {
+		return 0;
+	}
+
+	if(deny) {
+		if(BGP_DEBUG(update, UPDATE_IN)) {
+			zlog(peer->log, LOG_DEBUG, "%s rcvd UPDATE about %s/%d -- DENIED due to: filter;", peer->host, inet_ntop(p->family, &p->u.prefix, buf, SU_ADDRSTRLEN), p->prefixlen);
+		}
+		return 1;
+	}
+
+	/* Already over and on its way down */
+	if(CHECK_FLAG(peer->sflags, PEER_STATUS_PREFIX_OVERFLOW)) {
+		return -1;
+	}
+	return bgp_maximum_prefix_check(peer, afi, safi, peer->pcount[afi][safi] + 1, 0) ? -1 : 0;
+}
+
+static int bgp_nlri_parse_prefix(struct peer *peer, struct attr *attr, struct bgp_nlri *packet, struct prefix *p, u_int32_t addpath_id) {
+	int ret;
+
+	/* Check address. */
+	if(packet->afi == AFI_IP && packet->safi == SAFI_UNICAST) {
+		if(IN_CLASSD(ntohl(p->u.prefix4.s_addr))) {
+			/*
+			 * From RFC4271 Section 6.3:
+			 *
+			 * If a prefix in the NLRI field is semantically incorrect
+			 * (e.g., an unexpected multicast IP address), an error SHOULD
+			 * be logged locally, and the prefix SHOULD be ignored.
+			 */
+			zlog(peer->log, LOG_ERR, "%s: IPv4 unicast NLRI is multicast address %s, ignoring", peer->host, inet_ntoa(p->u.prefix4));
+			return 0;
+		}
+	}
+
+	/* Check address. */
+	if(packet->afi == AFI_IP6 && packet->safi == SAFI_UNICAST) {
+		if(IN6_IS_ADDR_LINKLOCAL(&p->u.prefix6)) {
+			char buf[BUFSIZ];
+
+			zlog(peer->log, LOG_ERR, "%s: IPv6 unicast NLRI is link-local address %s, ignoring", peer->host, inet_ntop(AF_INET6, &p->u.prefix6, buf, BUFSIZ));
+			return 0;
+		}
+		if(IN6_IS_ADDR_MULTICAST(&p->u.prefix6)) {
+			char buf[BUFSIZ];
+
+			zlog(peer->log, LOG_ERR, "%s: IPv6 unicast NLRI is multicast address %s, ignoring", peer->host, inet_ntop(AF_INET6, &p->u.prefix6, buf, BUFSIZ));
+			return 0;
+		}
+	}
+
+	/* Normal process. */
+	if(attr) {
+		ret = bgp_update_ingress(peer, p, addpath_id, packet->afi, packet->safi);
+		if(ret == 0) {
+			ret = bgp_update(peer, p, addpath_id, attr, packet->afi, packet->safi, ZEBRA_ROUTE_BGP, BGP_ROUTE_NORMAL, NULL, NULL, 0);
+		}
+	} else {
+		ret = bgp_withdraw(peer, p, addpath_id, attr, packet->afi, packet->safi, ZEBRA_ROUTE_BGP, BGP_ROUTE_NORMAL, NULL, NULL);
+	}
+
+	/* Address family configuration mismatch or maximum-prefix count
+	   overflow. */
+	return ret < 0 ? -1 : 0;
+}
+
+static int bgp_nlri_parse_ip_prefixes(struct peer *peer, struct attr *attr, struct bgp_nlri *packet) {
 	u_char *pnt;
 	u_char *lim;
 	struct prefix p;
 	int psize;
 	int ret;
-
-	/* Check peer status. */
-	if(peer->status != Established) {
-		return 0;
-	}
+	int addpath = BGP_ADDPATH_RX(peer, packet->afi, packet->safi);
+	u_int32_t addpath_id = 0;
 
 	pnt = packet->nlri;
 	lim = pnt + packet->length;
@@ -2944,6 +4574,17 @@ int bgp_nlri_parse_ip(struct peer *peer, struct attr *attr, struct bgp_nlri *pac
 		/* Clear prefix structure. */
 		memset(&p, 0, sizeof(struct prefix));
 
+		/* With Add-Path, each prefix comes after its path ID */
+		if(addpath) {
+			if(pnt + BGP_ADDPATH_ID_LEN >= lim) {
+				plog_err(peer->log, "%s [Error] Update packet error (path ID overflows packet)", peer->host);
+				return -1;
+			}
+			memcpy(&addpath_id, pnt, BGP_ADDPATH_ID_LEN);
+			addpath_id = ntohl(addpath_id);
+			pnt += BGP_ADDPATH_ID_LEN;
+		}
+
 		/* Fetch prefix length. */
 		p.prefixlen = *pnt++;
 		/* afi/safi validity already verified by caller, bgp_update_receive */
@@ -2988,46 +4629,7 @@ int bgp_nlri_parse_ip(struct peer *peer, struct attr *attr, struct bgp_nlri *pac
 		/* Fetch prefix from NLRI packet. */
 		memcpy(&p.u.prefix, pnt, psize);
 
-		/* Check address. */
-		if(packet->afi == AFI_IP && packet->safi == SAFI_UNICAST) {
-			if(IN_CLASSD(ntohl(p.u.prefix4.s_addr))) {
-				/*
- 	      * From RFC4271 Section 6.3:
-	      *
-	      * If a prefix in the NLRI field is semantically incorrect
-	      * (e.g., an unexpected multicast IP address), an error SHOULD
-	      * be logged locally, and the prefix SHOULD be ignored.
-	      */
-				zlog(peer->log, LOG_ERR, "%s: IPv4 unicast NLRI is multicast address %s, ignoring", peer->host, inet_ntoa(p.u.prefix4));
-				continue;
-			}
-		}
-
-		/* Check address. */
-		if(packet->afi == AFI_IP6 && packet->safi == SAFI_UNICAST) {
-			if(IN6_IS_ADDR_LINKLOCAL(&p.u.prefix6)) {
-				char buf[BUFSIZ];
-
-				zlog(peer->log, LOG_ERR, "%s: IPv6 unicast NLRI is link-local address %s, ignoring", peer->host, inet_ntop(AF_INET6, &p.u.prefix6, buf, BUFSIZ));
-				continue;
-			}
-			if(IN6_IS_ADDR_MULTICAST(&p.u.prefix6)) {
-				char buf[BUFSIZ];
-
-				zlog(peer->log, LOG_ERR, "%s: IPv6 unicast NLRI is multicast address %s, ignoring", peer->host, inet_ntop(AF_INET6, &p.u.prefix6, buf, BUFSIZ));
-				continue;
-			}
-		}
-
-		/* Normal process. */
-		if(attr) {
-			ret = bgp_update(peer, &p, attr, packet->afi, packet->safi, ZEBRA_ROUTE_BGP, BGP_ROUTE_NORMAL, NULL, NULL, 0);
-		} else {
-			ret = bgp_withdraw(peer, &p, attr, packet->afi, packet->safi, ZEBRA_ROUTE_BGP, BGP_ROUTE_NORMAL, NULL, NULL);
-		}
-
-		/* Address family configuration mismatch or maximum-prefix count
-         overflow. */
+		ret = bgp_nlri_parse_prefix(peer, attr, packet, &p, addpath_id);
 		if(ret < 0) {
 			return -1;
 		}
@@ -3047,6 +4649,62 @@ int bgp_nlri_parse_ip(struct peer *peer, struct attr *attr, struct bgp_nlri *pac
 	return 0;
 }
 
+/* Parse NLRI stream.  Withdraw NLRI is recognized by NULL attr
+   value. */
+int bgp_nlri_parse_ip(struct peer *peer, struct attr *attr, struct bgp_nlri *packet) {
+	int ret;
+
+	/* Check peer status. */
+	if(peer->status != Established) {
+		return 0;
+	}
+
+	if(attr == NULL) {
+		return bgp_nlri_parse_ip_prefixes(peer, attr, packet);
+	}
+
+	bgp_update_batch_begin(peer, attr, packet->afi, packet->safi);
+	ret = bgp_nlri_parse_ip_prefixes(peer, attr, packet);
+	bgp_update_batch_end();
+
+	return ret;
+}
+
+/* bgp_nlri_parse_ip(), for IPv4 prefixes the I/O thread has already
+   decoded from the NLRI stream, and found well formed. */
+int bgp_nlri_parse_ipv4_decoded(struct peer *peer, struct attr *attr, struct bgp_nlri *packet, const struct prefix_ipv4 *prefixes, unsigned int count) {
+	struct prefix p;
+	unsigned int i;
+	int ret = 0;
+
+	/* Check peer status. */
+	if(peer->status != Established) {
+		return 0;
+	}
+
+	if(attr) {
+		bgp_update_batch_begin(peer, attr, packet->afi, packet->safi);
+	}
+
+	for(i = 0; i < count; i++) {
+		memset(&p, 0, sizeof(struct prefix));
+		p.family = AF_INET;
+		p.prefixlen = prefixes[i].prefixlen;
+		p.u.prefix4 = prefixes[i].prefix;
+
+		if(bgp_nlri_parse_prefix(peer, attr, packet, &p, 0) < 0) {
+			ret = -1;
+			break;
+		}
+	}
+
+	if(attr) {
+		bgp_update_batch_end();
+	}
+
+	return ret;
+}
+
 static struct bgp_static *bgp_static_new(void) {
 	return XCALLOC(MTYPE_BGP_STATIC, sizeof(struct bgp_static));
 }
@@ -3081,6 +4739,28 @@ static void bgp_static_withdraw_rsclient(struct bgp *bgp, struct peer *rsclient,
 	bgp_unlock_node(rn);
 }
 
+/* The static route as it goes into the shared RS-client table, before
+ * any client's network route-map */
+static void bgp_static_update_rs_shared(struct bgp *bgp, struct prefix *p, struct bgp_static *bgp_static, afi_t afi, safi_t safi) {
+	struct attr attr;
+
+	bgp_attr_default_set(&attr, BGP_ORIGIN_IGP);
+
+	attr.nexthop = bgp_static->igpnexthop;
+	attr.med = bgp_static->igpmetric;
+	attr.flag |= ATTR_FLAG_BIT(BGP_ATTR_MULTI_EXIT_DISC);
+
+	if(bgp_static->atomic) {
+		attr.flag |= ATTR_FLAG_BIT(BGP_ATTR_ATOMIC_AGGREGATE);
+	}
+
+	bgp_update_rs_shared(bgp->peer_self, afi, safi, &attr, p, 0, ZEBRA_ROUTE_BGP, BGP_ROUTE_STATIC);
+
+	/* Unintern original. */
+	aspath_unintern(&attr.aspath);
+	bgp_attr_extra_free(&attr);
+}
+
 static void bgp_static_update_rsclient(struct peer *rsclient, struct prefix *p, struct bgp_static *bgp_static, afi_t afi, safi_t safi) {
 	struct bgp_node *rn;
 	struct bgp_info *ri;
@@ -3101,6 +4781,12 @@ static void bgp_static_update_rsclient(struct peer *rsclient, struct prefix *p,
 		return;
 	}
 
+	/* The client's verdict comes with bgp_soft_reconfig_rsclient() */
+	if(bgp_rs_shared_entry(rsclient, afi, safi)) {
+		bgp_static_update_rs_shared(bgp, p, bgp_static, afi, safi);
+		return;
+	}
+
 	rn = bgp_afi_node_get(rsclient->rib[afi][safi], afi, safi, p, NULL);
 
 	bgp_attr_default_set(&attr, BGP_ORIGIN_IGP);
@@ -3192,6 +4878,7 @@ static void bgp_static_update_rsclient(struct peer *rsclient, struct prefix *p,
 			}
 			bgp_attr_unintern(&ri->attr);
 			ri->attr = attr_new;
+			bgp_info_key_update(ri);
 			ri->uptime = bgp_clock();
 
 			/* Nexthop reachability check. */
@@ -3326,6 +5013,7 @@ static void bgp_static_update_main(struct bgp *bgp, struct prefix *p, struct bgp
 			}
 			bgp_attr_unintern(&ri->attr);
 			ri->attr = attr_new;
+			bgp_info_key_update(ri);
 			ri->uptime = bgp_clock();
 
 			/* Nexthop reachability check. */
@@ -3392,8 +5080,11 @@ void bgp_static_update(struct bgp *bgp, struct prefix *p, struct bgp_static *bgp
 
 	bgp_static_update_main(bgp, p, bgp_static, afi, safi);
 
+	if(bgp->rs_shared[afi][safi]) {
+		bgp_static_update_rs_shared(bgp, p, bgp_static, afi, safi);
+	}
 	for(ALL_LIST_ELEMENTS(bgp->rsclient, node, nnode, rsclient)) {
-		if(CHECK_FLAG(rsclient->af_flags[afi][safi], PEER_FLAG_RSERVER_CLIENT)) {
+		if(CHECK_FLAG(rsclient->af_flags[afi][safi], PEER_FLAG_RSERVER_CLIENT) && !rsclient->rs_index[afi][safi]) {
 			bgp_static_update_rsclient(rsclient, p, bgp_static, afi, safi);
 		}
 	}
@@ -3423,21 +5114,104 @@ void bgp_static_withdraw(struct bgp *bgp, struct prefix *p, afi_t afi, safi_t sa
 
 	/* Unlock bgp_node_lookup. */
 	bgp_unlock_node(rn);
+
+	if(bgp->rs_shared[afi][safi]) {
+		bgp_withdraw_rs_shared(bgp->peer_self, afi, safi, p, 0, ZEBRA_ROUTE_BGP, BGP_ROUTE_STATIC);
+	}
+}
+
+void bgp_check_local_routes_rsclient(struct peer *rsclient, afi_t afi, safi_t safi) {
+	struct bgp_static *bgp_static;
+	struct bgp *bgp;
+	struct bgp_node *rn;
+	struct prefix *p;
+
+	bgp = rsclient->bgp;
+
+	for(rn = bgp_table_top(bgp->route[afi][safi]); rn; rn = bgp_route_next(rn)) {
+		if((bgp_static = rn->info) != NULL) {
+			p = &rn->p;
+
+			bgp_static_update_rsclient(rsclient, p, bgp_static, afi, safi);
+		}
+	}
+}
+
+/* Have rsclient, with 'bgp route-server shared-rib', go by the shared
+ * table instead of its own, which then keeps its Adj-RIB-Out alone.
+ * Called once its table is there, before it is filled. */
+void bgp_rsclient_shared_join(struct peer *rsclient, afi_t afi, safi_t safi) {
+	struct bgp *bgp = rsclient->bgp;
+	struct bgp_rs_shared *rs;
+	unsigned int i;
+
+	if(!bgp_flag_check(bgp, BGP_FLAG_RSCLIENT_SHARED) || !BGP_RS_SHARED_SAFI(safi) || rsclient->rs_index[afi][safi]) {
+		return;
+	}
+
+	if((rs = bgp->rs_shared[afi][safi]) == NULL) {
+		rs = XCALLOC(MTYPE_BGP_RS_SHARED, sizeof(struct bgp_rs_shared));
+		rs->table = bgp_table_init(afi, safi);
+		rs->table->type = BGP_TABLE_RSSHARED;
+		bgp->rs_shared[afi][safi] = rs;
+	}
+
+	for(i = 0; i < rs->index_words * 32U; i++) {
+		if(!(rs->index_used[i / 32] & (1U << (i % 32)))) {
+			break;
+		}
+	}
+
+	if(i >= rs->index_words * 32U) {
+		rs->index_used = XREALLOC(MTYPE_BGP_RS_SHARED, rs->index_used, (rs->index_words + 1) * sizeof(u_int32_t));
+		rs->index_used[rs->index_words++] = 0;
+	}
+
+	rs->index_used[i / 32] |= (1U << (i % 32));
+	rsclient->rs_index[afi][safi] = i + 1;
+	rs->clients++;
 }
 
-void bgp_check_local_routes_rsclient(struct peer *rsclient, afi_t afi, safi_t safi) {
-	struct bgp_static *bgp_static;
-	struct bgp *bgp;
+/* Undo bgp_rsclient_shared_join(), before the client's own table goes.
+ * The shared table goes with its last client. */
+void bgp_rsclient_shared_leave(struct peer *rsclient, afi_t afi, safi_t safi) {
+	struct bgp *bgp = rsclient->bgp;
+	struct bgp_rs_shared *rs = bgp->rs_shared[afi][safi];
 	struct bgp_node *rn;
-	struct prefix *p;
+	struct bgp_info *ri;
+	struct bgp_info *next;
+	u_int16_t i;
 
-	bgp = rsclient->bgp;
+	if(!rsclient->rs_index[afi][safi] || rs == NULL) {
+		return;
+	}
 
-	for(rn = bgp_table_top(bgp->route[afi][safi]); rn; rn = bgp_route_next(rn)) {
-		if((bgp_static = rn->info) != NULL) {
-			p = &rn->p;
+	i = rsclient->rs_index[afi][safi] - 1;
+	rsclient->rs_index[afi][safi] = 0;
+	rs->index_used[i / 32] &= ~(1U << (i % 32));
 
-			bgp_static_update_rsclient(rsclient, p, bgp_static, afi, safi);
+	if(--rs->clients == 0) {
+		for(rn = bgp_table_top(rs->table); rn; rn = bgp_route_next(rn)) {
+			for(ri = rn->info; ri; ri = next) {
+				next = ri->next;
+				bgp_info_reap(rn, ri);
+			}
+		}
+		bgp_table_finish(&rs->table);
+
+		if(rs->index_used) {
+			XFREE(MTYPE_BGP_RS_SHARED, rs->index_used);
+		}
+		XFREE(MTYPE_BGP_RS_SHARED, rs);
+		bgp->rs_shared[afi][safi] = NULL;
+		return;
+	}
+
+	/* a client taking the index over starts with clean verdicts */
+	for(rn = bgp_table_top_info(rs->table); rn; rn = bgp_route_next_info(rn)) {
+		for(ri = rn->info; ri; ri = ri->next) {
+			bgp_rs_path_set(ri, 0, i, 0);
+			bgp_rs_path_set(ri, 1, i, 0);
 		}
 	}
 }
@@ -3542,6 +5316,7 @@ static void bgp_static_update_safi(struct bgp *bgp, struct prefix *p, struct bgp
 			}
 			bgp_attr_unintern(&ri->attr);
 			ri->attr = attr_new;
+			bgp_info_key_update(ri);
 			ri->uptime = bgp_clock();
 
 			/* Process change. */
@@ -4243,18 +6018,46 @@ struct bgp_aggregate {
 
 	/* SAFI configuration. */
 	safi_t safi;
+
+	/* Where it is configured, for the refresh timer */
+	struct bgp *bgp;
+	afi_t afi;
+	struct bgp_node *rn;
+
+	/* Pending recalculation of the aggregate route. */
+	struct thread *t_refresh;
 };
 
+/* The aggregate route is worked out again at most this often while the
+   routes under it change. */
+#define BGP_AGGREGATE_REFRESH_MSEC 100
+
 static struct bgp_aggregate *bgp_aggregate_new(void) {
 	return XCALLOC(MTYPE_BGP_AGGREGATE, sizeof(struct bgp_aggregate));
 }
 
 static void bgp_aggregate_free(struct bgp_aggregate *aggregate) {
+	THREAD_OFF(aggregate->t_refresh);
 	XFREE(MTYPE_BGP_AGGREGATE, aggregate);
 }
 
-/* Update an aggregate as routes are added/removed from the BGP table */
-static void bgp_aggregate_route(struct bgp *bgp, struct prefix *p, struct bgp_info *rinew, afi_t afi, safi_t safi, struct bgp_info *del, struct bgp_aggregate *aggregate) {
+/* The aggregate route currently in the table, if any */
+static struct bgp_info *bgp_aggregate_info(struct bgp *bgp, struct bgp_node *rn) {
+	struct bgp_info *ri;
+
+	for(ri = rn->info; ri; ri = ri->next) {
+		if(ri->peer == bgp->peer_self && ri->type == ZEBRA_ROUTE_BGP && ri->sub_type == BGP_ROUTE_AGGREGATE && !CHECK_FLAG(ri->flags, BGP_INFO_REMOVED)) {
+			return ri;
+		}
+	}
+	return NULL;
+}
+
+/* Work out the aggregate route from the routes under it, in one walk,
+   and put it in the table if it differs from the one there.  Which
+   routes it suppresses is kept up to date as they come and go, see
+   bgp_aggregate_increment(). */
+static void bgp_aggregate_refresh(struct bgp *bgp, struct prefix *p, afi_t afi, safi_t safi, struct bgp_aggregate *aggregate) {
 	struct bgp_table *table;
 	struct bgp_node *top;
 	struct bgp_node *rn;
@@ -4265,8 +6068,7 @@ static void bgp_aggregate_route(struct bgp *bgp, struct prefix *p, struct bgp_in
 	struct community *commerge = NULL;
 	struct bgp_info *ri;
 	struct bgp_info *new;
-	int first = 1;
-	unsigned long match = 0;
+	struct attr *attr;
 	u_char atomic_aggregate = 0;
 
 	/* ORIGIN attribute: If at least one route among routes that are
@@ -4280,124 +6082,76 @@ static void bgp_aggregate_route(struct bgp *bgp, struct prefix *p, struct bgp_in
 	origin = BGP_ORIGIN_IGP;
 
 	table = bgp->rib[afi][safi];
+	aggregate->count = 0;
 
 	top = bgp_node_get(table, p);
 	for(rn = bgp_node_get(table, p); rn; rn = bgp_route_next_until(rn, top)) {
-		if(rn->p.prefixlen > p->prefixlen) {
-			match = 0;
-
-			for(ri = rn->info; ri; ri = ri->next) {
-				if(BGP_INFO_HOLDDOWN(ri)) {
-					continue;
-				}
-
-				if(del && ri == del) {
-					continue;
-				}
-
-				if(!rinew && first) {
-					first = 0;
-				}
+		if(rn->p.prefixlen <= p->prefixlen) {
+			continue;
+		}
 
-#ifdef AGGREGATE_NEXTHOP_CHECK
-				if(!IPV4_ADDR_SAME(&ri->attr->nexthop, &nexthop) || ri->attr->med != med) {
-					if(aspath) {
-						aspath_free(aspath);
-					}
-					if(community) {
-						community_free(community);
-					}
-					bgp_unlock_node(rn);
-					bgp_unlock_node(top);
-					return;
-				}
-#endif /* AGGREGATE_NEXTHOP_CHECK */
+		for(ri = rn->info; ri; ri = ri->next) {
+			if(BGP_INFO_HOLDDOWN(ri)) {
+				continue;
+			}
 
-				if(ri->attr->flag & ATTR_FLAG_BIT(BGP_ATTR_ATOMIC_AGGREGATE)) {
-					atomic_aggregate = 1;
-				}
+			if(ri->attr->flag & ATTR_FLAG_BIT(BGP_ATTR_ATOMIC_AGGREGATE)) {
+				atomic_aggregate = 1;
+			}
 
-				if(ri->sub_type != BGP_ROUTE_AGGREGATE) {
-					if(aggregate->summary_only) {
-						(bgp_info_extra_get(ri))->suppress++;
-						bgp_info_set_flag(rn, ri, BGP_INFO_ATTR_CHANGED);
-						match++;
-					}
+			if(ri->sub_type == BGP_ROUTE_AGGREGATE) {
+				continue;
+			}
 
-					aggregate->count++;
+			aggregate->count++;
 
-					if(origin < ri->attr->origin) {
-						origin = ri->attr->origin;
-					}
+			if(origin < ri->attr->origin) {
+				origin = ri->attr->origin;
+			}
 
-					if(aggregate->as_set) {
-						if(aspath) {
-							asmerge = aspath_aggregate(aspath, ri->attr->aspath);
-							aspath_free(aspath);
-							aspath = asmerge;
-						} else {
-							aspath = aspath_dup(ri->attr->aspath);
-						}
+			/* as-set aggregate route generate origin, as path,
+	       community aggregation.  */
+			if(aggregate->as_set) {
+				if(aspath) {
+					asmerge = aspath_aggregate(aspath, ri->attr->aspath);
+					aspath_free(aspath);
+					aspath = asmerge;
+				} else {
+					aspath = aspath_dup(ri->attr->aspath);
+				}
 
-						if(ri->attr->community) {
-							if(community) {
-								commerge = community_merge(community, ri->attr->community);
-								community = community_uniq_sort(commerge);
-								community_free(commerge);
-							} else {
-								community = community_dup(ri->attr->community);
-							}
-						}
+				if(ri->attr->community) {
+					if(community) {
+						commerge = community_merge(community, ri->attr->community);
+						community = community_uniq_sort(commerge);
+						community_free(commerge);
+					} else {
+						community = community_dup(ri->attr->community);
 					}
 				}
 			}
-			if(match) {
-				bgp_process(bgp, rn, afi, safi);
-			}
 		}
 	}
-	bgp_unlock_node(top);
 
-	if(rinew) {
-		aggregate->count++;
+	ri = bgp_aggregate_info(bgp, top);
 
-		if(aggregate->summary_only) {
-			(bgp_info_extra_get(rinew))->suppress++;
-		}
+	if(aggregate->count) {
+		attr = bgp_attr_aggregate_intern(bgp, origin, aspath, community, aggregate->as_set, atomic_aggregate);
 
-		if(origin < rinew->attr->origin) {
-			origin = rinew->attr->origin;
+		/* Unchanged: nothing to advertise again. */
+		if(ri && ri->attr == attr) {
+			bgp_attr_unintern(&attr);
+			bgp_unlock_node(top);
+			return;
 		}
-
-		if(aggregate->as_set) {
-			if(aspath) {
-				asmerge = aspath_aggregate(aspath, rinew->attr->aspath);
-				aspath_free(aspath);
-				aspath = asmerge;
-			} else {
-				aspath = aspath_dup(rinew->attr->aspath);
-			}
-
-			if(rinew->attr->community) {
-				if(community) {
-					commerge = community_merge(community, rinew->attr->community);
-					community = community_uniq_sort(commerge);
-					community_free(commerge);
-				} else {
-					community = community_dup(rinew->attr->community);
-				}
-			}
+		if(ri) {
+			bgp_info_delete(top, ri);
 		}
-	}
 
-	if(aggregate->count > 0) {
-		rn = bgp_node_get(table, p);
-		new = info_make(ZEBRA_ROUTE_BGP, BGP_ROUTE_AGGREGATE, bgp->peer_self, bgp_attr_aggregate_intern(bgp, origin, aspath, community, aggregate->as_set, atomic_aggregate), rn);
+		new = info_make(ZEBRA_ROUTE_BGP, BGP_ROUTE_AGGREGATE, bgp->peer_self, attr, top);
 		SET_FLAG(new->flags, BGP_INFO_VALID);
-
-		bgp_info_add(rn, new);
-		bgp_unlock_node(rn);
-		bgp_process(bgp, rn, afi, safi);
+		bgp_info_add(top, new);
+		bgp_process(bgp, top, afi, safi);
 	} else {
 		if(aspath) {
 			aspath_free(aspath);
@@ -4405,16 +6159,42 @@ static void bgp_aggregate_route(struct bgp *bgp, struct prefix *p, struct bgp_in
 		if(community) {
 			community_free(community);
 		}
+		if(ri) {
+			bgp_info_delete(top, ri);
+			bgp_process(bgp, top, afi, safi);
+		}
+	}
+	bgp_unlock_node(top);
+}
+
+static int bgp_aggregate_refresh_timer(struct thread *thread) {
+	struct bgp_aggregate *aggregate = THREAD_ARG(thread);
+
+	aggregate->t_refresh = NULL;
+	bgp_aggregate_refresh(aggregate->bgp, &aggregate->rn->p, aggregate->afi, aggregate->safi, aggregate);
+	return 0;
+}
+
+/* A route under the aggregate changed: work the aggregate out again
+   shortly, once for however many change meanwhile. */
+static void bgp_aggregate_schedule(struct bgp_aggregate *aggregate) {
+	if(!aggregate->t_refresh) {
+		aggregate->t_refresh = thread_add_timer_msec(bm->master, bgp_aggregate_refresh_timer, aggregate, BGP_AGGREGATE_REFRESH_MSEC);
 	}
 }
 
 void bgp_aggregate_delete(struct bgp *, struct prefix *, afi_t, safi_t, struct bgp_aggregate *);
 
+/* A route is counted, and suppressed by summary-only aggregates, once,
+   from the increment that finds it usable to the next decrement;
+   BGP_INFO_AGGREGATED says it is.  The callers do not pair the two
+   strictly, so the flag, rather than the call, decides. */
 void bgp_aggregate_increment(struct bgp *bgp, struct prefix *p, struct bgp_info *ri, afi_t afi, safi_t safi) {
 	struct bgp_node *child;
 	struct bgp_node *rn;
 	struct bgp_aggregate *aggregate;
 	struct bgp_table *table;
+	int counted;
 
 	/* MPLS-VPN aggregation is not yet supported. */
 	if((safi == SAFI_MPLS_VPN) || (safi == SAFI_ENCAP)) {
@@ -4436,13 +6216,19 @@ void bgp_aggregate_increment(struct bgp *bgp, struct prefix *p, struct bgp_info
 		return;
 	}
 
+	counted = ri->sub_type == BGP_ROUTE_AGGREGATE || CHECK_FLAG(ri->flags, BGP_INFO_AGGREGATED);
 	child = bgp_node_get(table, p);
 
 	/* Aggregate address configuration check. */
 	for(rn = child; rn; rn = bgp_node_parent_nolock(rn)) {
 		if((aggregate = rn->info) != NULL && rn->p.prefixlen < p->prefixlen) {
-			bgp_aggregate_delete(bgp, &rn->p, afi, safi, aggregate);
-			bgp_aggregate_route(bgp, &rn->p, ri, afi, safi, NULL, aggregate);
+			if(!counted) {
+				if(aggregate->summary_only) {
+					(bgp_info_extra_get(ri))->suppress++;
+				}
+				SET_FLAG(ri->flags, BGP_INFO_AGGREGATED);
+			}
+			bgp_aggregate_schedule(aggregate);
 		}
 	}
 	bgp_unlock_node(child);
@@ -4453,6 +6239,7 @@ void bgp_aggregate_decrement(struct bgp *bgp, struct prefix *p, struct bgp_info
 	struct bgp_node *rn;
 	struct bgp_aggregate *aggregate;
 	struct bgp_table *table;
+	int counted;
 
 	/* MPLS-VPN aggregation is not yet supported. */
 	if((safi == SAFI_MPLS_VPN) || (safi == SAFI_ENCAP)) {
@@ -4470,13 +6257,17 @@ void bgp_aggregate_decrement(struct bgp *bgp, struct prefix *p, struct bgp_info
 		return;
 	}
 
+	counted = CHECK_FLAG(del->flags, BGP_INFO_AGGREGATED);
+	UNSET_FLAG(del->flags, BGP_INFO_AGGREGATED);
 	child = bgp_node_get(table, p);
 
 	/* Aggregate address configuration check. */
 	for(rn = child; rn; rn = bgp_node_parent_nolock(rn)) {
 		if((aggregate = rn->info) != NULL && rn->p.prefixlen < p->prefixlen) {
-			bgp_aggregate_delete(bgp, &rn->p, afi, safi, aggregate);
-			bgp_aggregate_route(bgp, &rn->p, NULL, afi, safi, del, aggregate);
+			if(counted && aggregate->summary_only && del->extra && del->extra->suppress) {
+				del->extra->suppress--;
+			}
+			bgp_aggregate_schedule(aggregate);
 		}
 	}
 	bgp_unlock_node(child);
@@ -4487,15 +6278,8 @@ static void bgp_aggregate_add(struct bgp *bgp, struct prefix *p, afi_t afi, safi
 	struct bgp_table *table;
 	struct bgp_node *top;
 	struct bgp_node *rn;
-	struct bgp_info *new;
 	struct bgp_info *ri;
 	unsigned long match;
-	u_char origin = BGP_ORIGIN_IGP;
-	struct aspath *aspath = NULL;
-	struct aspath *asmerge = NULL;
-	struct community *community = NULL;
-	struct community *commerge = NULL;
-	u_char atomic_aggregate = 0;
 
 	table = bgp->rib[afi][safi];
 
@@ -4507,64 +6291,24 @@ static void bgp_aggregate_add(struct bgp *bgp, struct prefix *p, afi_t afi, safi
 		return;
 	}
 
-	/* If routes exists below this node, generate aggregate routes. */
+	/* summary-only aggregate route suppress aggregated route
+     announcement.  */
 	top = bgp_node_get(table, p);
 	for(rn = bgp_node_get(table, p); rn; rn = bgp_route_next_until(rn, top)) {
 		if(rn->p.prefixlen > p->prefixlen) {
 			match = 0;
 
 			for(ri = rn->info; ri; ri = ri->next) {
-				if(BGP_INFO_HOLDDOWN(ri)) {
+				if(BGP_INFO_HOLDDOWN(ri) || ri->sub_type == BGP_ROUTE_AGGREGATE) {
 					continue;
 				}
 
-				if(ri->attr->flag & ATTR_FLAG_BIT(BGP_ATTR_ATOMIC_AGGREGATE)) {
-					atomic_aggregate = 1;
-				}
-
-				if(ri->sub_type != BGP_ROUTE_AGGREGATE) {
-					/* summary-only aggregate route suppress aggregated
-		   route announcement.  */
-					if(aggregate->summary_only) {
-						(bgp_info_extra_get(ri))->suppress++;
-						bgp_info_set_flag(rn, ri, BGP_INFO_ATTR_CHANGED);
-						match++;
-					}
-
-					/* If at least one route among routes that are aggregated has
-                 * ORIGIN with the value INCOMPLETE, then the aggregated route
-                 * MUST have the ORIGIN attribute with the value INCOMPLETE.
-                 * Otherwise, if at least one route among routes that are
-                 * aggregated has ORIGIN with the value EGP, then the aggregated
-                 * route MUST have the ORIGIN attribute with the value EGP.
-                 */
-					if(origin < ri->attr->origin) {
-						origin = ri->attr->origin;
-					}
-
-					/* as-set aggregate route generate origin, as path,
-		   community aggregation.  */
-					if(aggregate->as_set) {
-						if(aspath) {
-							asmerge = aspath_aggregate(aspath, ri->attr->aspath);
-							aspath_free(aspath);
-							aspath = asmerge;
-						} else {
-							aspath = aspath_dup(ri->attr->aspath);
-						}
-
-						if(ri->attr->community) {
-							if(community) {
-								commerge = community_merge(community, ri->attr->community);
-								community = community_uniq_sort(commerge);
-								community_free(commerge);
-							} else {
-								community = community_dup(ri->attr->community);
-							}
-						}
-					}
-					aggregate->count++;
+				if(aggregate->summary_only) {
+					(bgp_info_extra_get(ri))->suppress++;
+					bgp_info_set_flag(rn, ri, BGP_INFO_ATTR_CHANGED);
+					match++;
 				}
+				SET_FLAG(ri->flags, BGP_INFO_AGGREGATED);
 			}
 
 			/* If this node is suppressed, process the change. */
@@ -4576,24 +6320,7 @@ static void bgp_aggregate_add(struct bgp *bgp, struct prefix *p, afi_t afi, safi
 	bgp_unlock_node(top);
 
 	/* Add aggregate route to BGP table. */
-	if(aggregate->count) {
-		rn = bgp_node_get(table, p);
-		new = info_make(ZEBRA_ROUTE_BGP, BGP_ROUTE_AGGREGATE, bgp->peer_self, bgp_attr_aggregate_intern(bgp, origin, aspath, community, aggregate->as_set, atomic_aggregate), rn);
-		SET_FLAG(new->flags, BGP_INFO_VALID);
-
-		bgp_info_add(rn, new);
-		bgp_unlock_node(rn);
-
-		/* Process change. */
-		bgp_process(bgp, rn, afi, safi);
-	} else {
-		if(aspath) {
-			aspath_free(aspath);
-		}
-		if(community) {
-			community_free(community);
-		}
-	}
+	bgp_aggregate_refresh(bgp, p, afi, safi, aggregate);
 }
 
 void bgp_aggregate_delete(struct bgp *bgp, struct prefix *p, afi_t afi, safi_t safi, struct bgp_aggregate *aggregate) {
@@ -4605,6 +6332,8 @@ void bgp_aggregate_delete(struct bgp *bgp, struct prefix *p, afi_t afi, safi_t s
 
 	table = bgp->rib[afi][safi];
 
+	THREAD_OFF(aggregate->t_refresh);
+
 	if(afi == AFI_IP && p->prefixlen == IPV4_MAX_BITLEN) {
 		return;
 	}
@@ -4619,20 +6348,17 @@ void bgp_aggregate_delete(struct bgp *bgp, struct prefix *p, afi_t afi, safi_t s
 			match = 0;
 
 			for(ri = rn->info; ri; ri = ri->next) {
-				if(BGP_INFO_HOLDDOWN(ri)) {
+				if(!CHECK_FLAG(ri->flags, BGP_INFO_AGGREGATED)) {
 					continue;
 				}
 
-				if(ri->sub_type != BGP_ROUTE_AGGREGATE) {
-					if(aggregate->summary_only && ri->extra) {
-						ri->extra->suppress--;
+				if(aggregate->summary_only && ri->extra && ri->extra->suppress) {
+					ri->extra->suppress--;
 
-						if(ri->extra->suppress == 0) {
-							bgp_info_set_flag(rn, ri, BGP_INFO_ATTR_CHANGED);
-							match++;
-						}
+					if(ri->extra->suppress == 0) {
+						bgp_info_set_flag(rn, ri, BGP_INFO_ATTR_CHANGED);
+						match++;
 					}
-					aggregate->count--;
 				}
 			}
 
@@ -4642,25 +6368,38 @@ void bgp_aggregate_delete(struct bgp *bgp, struct prefix *p, afi_t afi, safi_t s
 			}
 		}
 	}
+	aggregate->count = 0;
+
+	/* Withdraw aggregate route from routing table. */
+	if((ri = bgp_aggregate_info(bgp, top)) != NULL) {
+		bgp_info_delete(top, ri);
+		bgp_process(bgp, top, afi, safi);
+	}
+
+	/* Unlock bgp_node_get. */
 	bgp_unlock_node(top);
+}
 
-	/* Delete aggregate route from BGP table. */
-	rn = bgp_node_get(table, p);
+/* Withdraw and forget every aggregate, the instance is going */
+void bgp_aggregate_delete_all(struct bgp *bgp) {
+	afi_t afi;
+	safi_t safi;
+	struct bgp_node *rn;
+	struct bgp_aggregate *aggregate;
 
-	for(ri = rn->info; ri; ri = ri->next) {
-		if(ri->peer == bgp->peer_self && ri->type == ZEBRA_ROUTE_BGP && ri->sub_type == BGP_ROUTE_AGGREGATE) {
-			break;
+	for(afi = AFI_IP; afi < AFI_MAX; afi++) {
+		for(safi = SAFI_UNICAST; safi < SAFI_MAX; safi++) {
+			for(rn = bgp_table_top(bgp->aggregate[afi][safi]); rn; rn = bgp_route_next(rn)) {
+				if((aggregate = rn->info) == NULL) {
+					continue;
+				}
+				bgp_aggregate_delete(bgp, &rn->p, afi, safi, aggregate);
+				bgp_aggregate_free(aggregate);
+				rn->info = NULL;
+				bgp_unlock_node(rn);
+			}
 		}
 	}
-
-	/* Withdraw static BGP route from routing table. */
-	if(ri) {
-		bgp_info_delete(rn, ri);
-		bgp_process(bgp, rn, afi, safi);
-	}
-
-	/* Unlock bgp_node_lookup. */
-	bgp_unlock_node(rn);
 }
 
 /* Aggregate route attribute. */
@@ -4746,6 +6485,9 @@ static int bgp_aggregate_set(struct vty *vty, const char *prefix_str, afi_t afi,
 	aggregate->summary_only = summary_only;
 	aggregate->as_set = as_set;
 	aggregate->safi = safi;
+	aggregate->bgp = bgp;
+	aggregate->afi = afi;
+	aggregate->rn = rn;
 	rn->info = aggregate;
 
 	/* Aggregate address insert into BGP routing table. */
@@ -5083,6 +6825,7 @@ void bgp_redistribute_add(struct prefix *p, const struct in_addr *nexthop, const
 					}
 					bgp_attr_unintern(&bi->attr);
 					bi->attr = new_attr;
+					bgp_info_key_update(bi);
 					bi->uptime = bgp_clock();
 
 					/* Process change. */
@@ -5303,7 +7046,7 @@ void route_vty_out(struct vty *vty, struct prefix *p, struct bgp_info *binfo, in
 			vty_out(vty, "       ");
 		}
 
-		vty_out(vty, "%7u ", (attr->extra ? attr->extra->weight : 0));
+		vty_out(vty, "%7u ", attr->weight);
 
 		/* Print aspath */
 		if(attr->aspath) {
@@ -5361,7 +7104,7 @@ void route_vty_out_tmp(struct vty *vty, struct prefix *p, struct attr *attr, saf
 			vty_out(vty, "       ");
 		}
 
-		vty_out(vty, "%7u ", (attr->extra ? attr->extra->weight : 0));
+		vty_out(vty, "%7u ", attr->weight);
 
 		/* Print aspath */
 		if(attr->aspath) {
@@ -5614,8 +7357,8 @@ static void route_vty_out_detail(struct vty *vty, struct bgp *bgp, struct prefix
 			vty_out(vty, ", localpref %u", bgp->default_local_pref);
 		}
 
-		if(attr->extra && attr->extra->weight != 0) {
-			vty_out(vty, ", weight %u", attr->extra->weight);
+		if(attr->weight != 0) {
+			vty_out(vty, ", weight %u", attr->weight);
 		}
 
 		if(attr->extra && attr->extra->tag != 0) {
@@ -5743,213 +7486,310 @@ enum bgp_show_type {
 	bgp_show_type_damp_neighbor
 };
 
-static int bgp_show_table(struct vty *vty, struct bgp_table *table, struct in_addr *router_id, enum bgp_show_type type, void *output_arg) {
-	struct bgp_info *ri;
-	struct bgp_node *rn;
-	int header = 1;
-	int display;
+/* The RS client whose table is a stand-in for the shared one, if so */
+static struct peer *bgp_show_rs_shared(struct bgp_table *table) {
+	if(table->type != BGP_TABLE_RSCLIENT || table->owner == NULL || !table->owner->rs_index[table->afi][table->safi]) {
+		return NULL;
+	}
+	return table->owner;
+}
+
+/* A bgp_show_table() walk, kept while its output is continued. */
+struct bgp_show_state {
+	enum bgp_show_type type;
+	void *output_arg;
+	struct in_addr router_id;
+	u_int64_t version;
+	struct peer *rsclient;
+	u_int16_t rs_i;
+	int header;
 	unsigned long output_count;
 	unsigned long total_count;
+	bgp_table_iter_t iter;
+};
 
-	/* This is first entry point, so reset total line. */
-	output_count = 0;
-	total_count = 0;
+/* Show the paths of rn that pass the filter of st. */
+static void bgp_show_node(struct vty *vty, struct bgp_node *rn, struct bgp_show_state *st) {
+	struct bgp_info *ri;
+	struct peer *rsclient = st->rsclient;
+	u_int16_t rs_i = st->rs_i;
+	enum bgp_show_type type = st->type;
+	void *output_arg = st->output_arg;
+	int display;
+	int selected;
 
-	/* Start processing of routes. */
-	for(rn = bgp_table_top(table); rn; rn = bgp_route_next(rn)) {
-		if(rn->info != NULL) {
-			display = 0;
+	display = 0;
 
-			for(ri = rn->info; ri; ri = ri->next) {
-				total_count++;
-				if(type == bgp_show_type_flap_statistics || type == bgp_show_type_flap_address || type == bgp_show_type_flap_prefix || type == bgp_show_type_flap_cidr_only || type == bgp_show_type_flap_regexp
-				   || type == bgp_show_type_flap_filter_list || type == bgp_show_type_flap_prefix_list || type == bgp_show_type_flap_prefix_longer || type == bgp_show_type_flap_route_map
-				   || type == bgp_show_type_flap_neighbor || type == bgp_show_type_dampend_paths || type == bgp_show_type_damp_neighbor) {
-					if(!(ri->extra && ri->extra->damp_info)) {
-						continue;
-					}
-				}
-				if(type == bgp_show_type_regexp || type == bgp_show_type_flap_regexp) {
-					regex_t *regex = output_arg;
+	for(ri = rn->info; ri; ri = ri->next) {
+		if(rsclient && !bgp_rs_path_test(ri, 0, rs_i)) {
+			continue;
+		}
+		st->total_count++;
+		if(type == bgp_show_type_flap_statistics || type == bgp_show_type_flap_address || type == bgp_show_type_flap_prefix || type == bgp_show_type_flap_cidr_only || type == bgp_show_type_flap_regexp
+		   || type == bgp_show_type_flap_filter_list || type == bgp_show_type_flap_prefix_list || type == bgp_show_type_flap_prefix_longer || type == bgp_show_type_flap_route_map
+		   || type == bgp_show_type_flap_neighbor || type == bgp_show_type_dampend_paths || type == bgp_show_type_damp_neighbor) {
+			if(!(ri->extra && ri->extra->damp_info)) {
+				continue;
+			}
+		}
+		if(type == bgp_show_type_regexp || type == bgp_show_type_flap_regexp) {
+			struct bgp_aspath_regex *regex = output_arg;
 
-					if(bgp_regexec(regex, ri->attr->aspath) == REG_NOMATCH) {
-						continue;
-					}
-				}
-				if(type == bgp_show_type_prefix_list || type == bgp_show_type_flap_prefix_list) {
-					struct prefix_list *plist = output_arg;
+			if(bgp_aspath_regexec(regex, ri->attr->aspath) == REG_NOMATCH) {
+				continue;
+			}
+		}
+		if(type == bgp_show_type_prefix_list || type == bgp_show_type_flap_prefix_list) {
+			struct prefix_list *plist = output_arg;
 
-					if(prefix_list_apply(plist, &rn->p) != PREFIX_PERMIT) {
-						continue;
-					}
-				}
-				if(type == bgp_show_type_filter_list || type == bgp_show_type_flap_filter_list) {
-					struct as_list *as_list = output_arg;
+			if(prefix_list_apply(plist, &rn->p) != PREFIX_PERMIT) {
+				continue;
+			}
+		}
+		if(type == bgp_show_type_filter_list || type == bgp_show_type_flap_filter_list) {
+			struct as_list *as_list = output_arg;
 
-					if(as_list_apply(as_list, ri->attr->aspath) != AS_FILTER_PERMIT) {
-						continue;
-					}
-				}
-				if(type == bgp_show_type_route_map || type == bgp_show_type_flap_route_map) {
-					struct route_map *rmap = output_arg;
-					struct bgp_info binfo;
-					struct attr dummy_attr;
-					struct attr_extra dummy_extra;
-					int ret;
+			if(as_list_apply(as_list, ri->attr->aspath) != AS_FILTER_PERMIT) {
+				continue;
+			}
+		}
+		if(type == bgp_show_type_route_map || type == bgp_show_type_flap_route_map) {
+			struct route_map *rmap = output_arg;
+			struct bgp_info binfo;
+			struct attr dummy_attr;
+			struct attr_extra dummy_extra;
+			int ret;
+
+			dummy_attr.extra = &dummy_extra;
+			bgp_attr_dup(&dummy_attr, ri->attr);
+
+			binfo.peer = ri->peer;
+			binfo.attr = &dummy_attr;
+
+			ret = route_map_apply(rmap, &rn->p, RMAP_BGP, &binfo);
+			if(ret == RMAP_DENYMATCH) {
+				continue;
+			}
+		}
+		if(type == bgp_show_type_neighbor || type == bgp_show_type_flap_neighbor || type == bgp_show_type_damp_neighbor) {
+			union sockunion *su = output_arg;
+
+			if(ri->peer->su_remote == NULL || !sockunion_same(ri->peer->su_remote, su)) {
+				continue;
+			}
+		}
+		if(type == bgp_show_type_cidr_only || type == bgp_show_type_flap_cidr_only) {
+			u_int32_t destination;
+
+			destination = ntohl(rn->p.u.prefix4.s_addr);
+			if(IN_CLASSC(destination) && rn->p.prefixlen == 24) {
+				continue;
+			}
+			if(IN_CLASSB(destination) && rn->p.prefixlen == 16) {
+				continue;
+			}
+			if(IN_CLASSA(destination) && rn->p.prefixlen == 8) {
+				continue;
+			}
+		}
+		if(type == bgp_show_type_prefix_longer || type == bgp_show_type_flap_prefix_longer) {
+			struct prefix *p = output_arg;
+
+			if(!prefix_match(p, &rn->p)) {
+				continue;
+			}
+		}
+		if(type == bgp_show_type_community_all) {
+			if(!ri->attr->community) {
+				continue;
+			}
+		}
+		if(type == bgp_show_type_community) {
+			struct community *com = output_arg;
+
+			if(!ri->attr->community || !community_match(ri->attr->community, com)) {
+				continue;
+			}
+		}
+		if(type == bgp_show_type_community_exact) {
+			struct community *com = output_arg;
+
+			if(!ri->attr->community || !community_cmp(ri->attr->community, com)) {
+				continue;
+			}
+		}
+		if(type == bgp_show_type_community_list) {
+			struct community_list *list = output_arg;
 
-					dummy_attr.extra = &dummy_extra;
-					bgp_attr_dup(&dummy_attr, ri->attr);
+			if(!community_list_match(ri->attr->community, list)) {
+				continue;
+			}
+		}
+		if(type == bgp_show_type_community_list_exact) {
+			struct community_list *list = output_arg;
 
-					binfo.peer = ri->peer;
-					binfo.attr = &dummy_attr;
+			if(!community_list_exact_match(ri->attr->community, list)) {
+				continue;
+			}
+		}
+		if(type == bgp_show_type_community_all) {
+			if(!ri->attr->community) {
+				continue;
+			}
+		}
+		if(type == bgp_show_type_lcommunity) {
+			struct lcommunity *lcom = output_arg;
 
-					ret = route_map_apply(rmap, &rn->p, RMAP_BGP, &binfo);
-					if(ret == RMAP_DENYMATCH) {
-						continue;
-					}
-				}
-				if(type == bgp_show_type_neighbor || type == bgp_show_type_flap_neighbor || type == bgp_show_type_damp_neighbor) {
-					union sockunion *su = output_arg;
+			if(!ri->attr->extra || !ri->attr->extra->lcommunity || !lcommunity_match(ri->attr->extra->lcommunity, lcom)) {
+				continue;
+			}
+		}
+		if(type == bgp_show_type_lcommunity_list) {
+			struct community_list *list = output_arg;
 
-					if(ri->peer->su_remote == NULL || !sockunion_same(ri->peer->su_remote, su)) {
-						continue;
-					}
-				}
-				if(type == bgp_show_type_cidr_only || type == bgp_show_type_flap_cidr_only) {
-					u_int32_t destination;
+			if(!ri->attr->extra || !lcommunity_list_match(ri->attr->extra->lcommunity, list)) {
+				continue;
+			}
+		}
+		if(type == bgp_show_type_lcommunity_all) {
+			if(!ri->attr->extra || !ri->attr->extra->lcommunity) {
+				continue;
+			}
+		}
+		if(type == bgp_show_type_flap_address || type == bgp_show_type_flap_prefix) {
+			struct prefix *p = output_arg;
 
-					destination = ntohl(rn->p.u.prefix4.s_addr);
-					if(IN_CLASSC(destination) && rn->p.prefixlen == 24) {
-						continue;
-					}
-					if(IN_CLASSB(destination) && rn->p.prefixlen == 16) {
-						continue;
-					}
-					if(IN_CLASSA(destination) && rn->p.prefixlen == 8) {
-						continue;
-					}
-				}
-				if(type == bgp_show_type_prefix_longer || type == bgp_show_type_flap_prefix_longer) {
-					struct prefix *p = output_arg;
+			if(!prefix_match(&rn->p, p)) {
+				continue;
+			}
 
-					if(!prefix_match(p, &rn->p)) {
-						continue;
-					}
-				}
-				if(type == bgp_show_type_community_all) {
-					if(!ri->attr->community) {
-						continue;
-					}
+			if(type == bgp_show_type_flap_prefix) {
+				if(p->prefixlen != rn->p.prefixlen) {
+					continue;
 				}
-				if(type == bgp_show_type_community) {
-					struct community *com = output_arg;
+			}
+		}
+		if(type == bgp_show_type_dampend_paths || type == bgp_show_type_damp_neighbor) {
+			if(!CHECK_FLAG(ri->flags, BGP_INFO_DAMPED) || CHECK_FLAG(ri->flags, BGP_INFO_HISTORY)) {
+				continue;
+			}
+		}
 
-					if(!ri->attr->community || !community_match(ri->attr->community, com)) {
-						continue;
-					}
-				}
-				if(type == bgp_show_type_community_exact) {
-					struct community *com = output_arg;
+		if(st->header) {
+			vty_out(vty, "BGP table version is %llu, local router ID is %s%s", (unsigned long long) st->version, inet_ntoa(st->router_id), VTY_NEWLINE);
+			vty_out(vty, BGP_SHOW_SCODE_HEADER, VTY_NEWLINE, VTY_NEWLINE);
+			vty_out(vty, BGP_SHOW_OCODE_HEADER, VTY_NEWLINE, VTY_NEWLINE);
+			if(type == bgp_show_type_dampend_paths || type == bgp_show_type_damp_neighbor) {
+				vty_out(vty, BGP_SHOW_DAMP_HEADER, VTY_NEWLINE);
+			} else if(type == bgp_show_type_flap_statistics || type == bgp_show_type_flap_address || type == bgp_show_type_flap_prefix || type == bgp_show_type_flap_cidr_only || type == bgp_show_type_flap_regexp || type == bgp_show_type_flap_filter_list || type == bgp_show_type_flap_prefix_list || type == bgp_show_type_flap_prefix_longer || type == bgp_show_type_flap_route_map || type == bgp_show_type_flap_neighbor) {
+				vty_out(vty, BGP_SHOW_FLAP_HEADER, VTY_NEWLINE);
+			} else {
+				vty_out(vty, BGP_SHOW_HEADER, VTY_NEWLINE);
+			}
+			st->header = 0;
+		}
 
-					if(!ri->attr->community || !community_cmp(ri->attr->community, com)) {
-						continue;
-					}
-				}
-				if(type == bgp_show_type_community_list) {
-					struct community_list *list = output_arg;
+		selected = rsclient && bgp_rs_path_test(ri, 1, rs_i);
+		if(selected) {
+			SET_FLAG(ri->flags, BGP_INFO_SELECTED);
+		}
+		if(type == bgp_show_type_dampend_paths || type == bgp_show_type_damp_neighbor) {
+			damp_route_vty_out(vty, &rn->p, ri, display, SAFI_UNICAST);
+		} else if(type == bgp_show_type_flap_statistics || type == bgp_show_type_flap_address || type == bgp_show_type_flap_prefix || type == bgp_show_type_flap_cidr_only || type == bgp_show_type_flap_regexp || type == bgp_show_type_flap_filter_list || type == bgp_show_type_flap_prefix_list || type == bgp_show_type_flap_prefix_longer || type == bgp_show_type_flap_route_map || type == bgp_show_type_flap_neighbor) {
+			flap_route_vty_out(vty, &rn->p, ri, display, SAFI_UNICAST);
+		} else {
+			route_vty_out(vty, &rn->p, ri, display, SAFI_UNICAST);
+		}
+		if(selected) {
+			UNSET_FLAG(ri->flags, BGP_INFO_SELECTED);
+		}
+		display++;
+	}
+	if(display) {
+		st->output_count++;
+	}
+}
 
-					if(!community_list_match(ri->attr->community, list)) {
-						continue;
-					}
-				}
-				if(type == bgp_show_type_community_list_exact) {
-					struct community_list *list = output_arg;
+static void bgp_show_table_end(struct vty *vty, struct bgp_show_state *st) {
+	/* No route is displayed */
+	if(st->output_count == 0) {
+		if(st->type == bgp_show_type_normal) {
+			vty_out(vty, "No BGP prefixes displayed, %ld exist%s", st->total_count, VTY_NEWLINE);
+		}
+	} else {
+		vty_out(vty, "%sDisplayed  %ld out of %ld total prefixes%s", VTY_NEWLINE, st->output_count, st->total_count, VTY_NEWLINE);
+	}
+}
 
-					if(!community_list_exact_match(ri->attr->community, list)) {
-						continue;
-					}
-				}
-				if(type == bgp_show_type_community_all) {
-					if(!ri->attr->community) {
-						continue;
-					}
-				}
-				if(type == bgp_show_type_lcommunity) {
-					struct lcommunity *lcom = output_arg;
+/* Show routes until the vty has enough buffered; nonzero if there are
+   more to come. */
+static int bgp_show_table_continue(struct vty *vty, void *arg) {
+	struct bgp_show_state *st = arg;
+	struct bgp_node *rn;
 
-					if(!ri->attr->extra || !ri->attr->extra->lcommunity || !lcommunity_match(ri->attr->extra->lcommunity, lcom)) {
-						continue;
-					}
-				}
-				if(type == bgp_show_type_lcommunity_list) {
-					struct community_list *list = output_arg;
+	while((rn = bgp_table_iter_next(&st->iter)) != NULL) {
+		if(rn->info != NULL) {
+			bgp_show_node(vty, rn, st);
+		}
+		if(vty_output_full(vty)) {
+			bgp_table_iter_pause(&st->iter);
+			return 1;
+		}
+	}
 
-					if(!ri->attr->extra || !lcommunity_list_match(ri->attr->extra->lcommunity, list)) {
-						continue;
-					}
-				}
-				if(type == bgp_show_type_lcommunity_all) {
-					if(!ri->attr->extra || !ri->attr->extra->lcommunity) {
-						continue;
-					}
-				}
-				if(type == bgp_show_type_flap_address || type == bgp_show_type_flap_prefix) {
-					struct prefix *p = output_arg;
+	bgp_show_table_end(vty, st);
+	return 0;
+}
 
-					if(!prefix_match(&rn->p, p)) {
-						continue;
-					}
+static void bgp_show_table_clean(void *arg) {
+	struct bgp_show_state *st = arg;
 
-					if(type == bgp_show_type_flap_prefix) {
-						if(p->prefixlen != rn->p.prefixlen) {
-							continue;
-						}
-					}
-				}
-				if(type == bgp_show_type_dampend_paths || type == bgp_show_type_damp_neighbor) {
-					if(!CHECK_FLAG(ri->flags, BGP_INFO_DAMPED) || CHECK_FLAG(ri->flags, BGP_INFO_HISTORY)) {
-						continue;
-					}
-				}
+	bgp_table_iter_cleanup(&st->iter);
+	XFREE(MTYPE_BGP_SHOW, st);
+}
 
-				if(header) {
-					vty_out(vty, "BGP table version is 0, local router ID is %s%s", inet_ntoa(*router_id), VTY_NEWLINE);
-					vty_out(vty, BGP_SHOW_SCODE_HEADER, VTY_NEWLINE, VTY_NEWLINE);
-					vty_out(vty, BGP_SHOW_OCODE_HEADER, VTY_NEWLINE, VTY_NEWLINE);
-					if(type == bgp_show_type_dampend_paths || type == bgp_show_type_damp_neighbor) {
-						vty_out(vty, BGP_SHOW_DAMP_HEADER, VTY_NEWLINE);
-					} else if(type == bgp_show_type_flap_statistics || type == bgp_show_type_flap_address || type == bgp_show_type_flap_prefix || type == bgp_show_type_flap_cidr_only || type == bgp_show_type_flap_regexp || type == bgp_show_type_flap_filter_list || type == bgp_show_type_flap_prefix_list || type == bgp_show_type_flap_prefix_longer || type == bgp_show_type_flap_route_map || type == bgp_show_type_flap_neighbor) {
-						vty_out(vty, BGP_SHOW_FLAP_HEADER, VTY_NEWLINE);
-					} else {
-						vty_out(vty, BGP_SHOW_HEADER, VTY_NEWLINE);
-					}
-					header = 0;
-				}
+static int bgp_show_table(struct vty *vty, struct bgp_table *table, struct in_addr *router_id, enum bgp_show_type type, void *output_arg) {
+	struct bgp_show_state state;
+	struct bgp_show_state *st;
+	struct bgp_node *rn;
 
-				if(type == bgp_show_type_dampend_paths || type == bgp_show_type_damp_neighbor) {
-					damp_route_vty_out(vty, &rn->p, ri, display, SAFI_UNICAST);
-				} else if(type == bgp_show_type_flap_statistics || type == bgp_show_type_flap_address || type == bgp_show_type_flap_prefix || type == bgp_show_type_flap_cidr_only || type == bgp_show_type_flap_regexp || type == bgp_show_type_flap_filter_list || type == bgp_show_type_flap_prefix_list || type == bgp_show_type_flap_prefix_longer || type == bgp_show_type_flap_route_map || type == bgp_show_type_flap_neighbor) {
-					flap_route_vty_out(vty, &rn->p, ri, display, SAFI_UNICAST);
-				} else {
-					route_vty_out(vty, &rn->p, ri, display, SAFI_UNICAST);
-				}
-				display++;
-			}
-			if(display) {
-				output_count++;
-			}
+	memset(&state, 0, sizeof(state));
+	state.type = type;
+	state.output_arg = output_arg;
+	state.router_id = *router_id;
+	state.version = table->version;
+	state.header = 1;
+
+	/* The paths an RS client sharing its table accepts, its best flagged */
+	if((state.rsclient = bgp_show_rs_shared(table))) {
+		state.rs_i = state.rsclient->rs_index[table->afi][table->safi] - 1;
+		table = state.rsclient->bgp->rs_shared[table->afi][table->safi]->table;
+	}
+
+	/* A plain walk goes out as the vty drains, rather than being
+	   buffered whole.  Filter arguments belong to the caller and an RS
+	   client may go away meanwhile, so those are shown in one go. */
+	if(output_arg == NULL && state.rsclient == NULL) {
+		st = XMALLOC(MTYPE_BGP_SHOW, sizeof(struct bgp_show_state));
+		*st = state;
+		bgp_table_iter_init(&st->iter, table);
+		if(bgp_show_table_continue(vty, st)) {
+			vty_output_continue(vty, bgp_show_table_continue, bgp_show_table_clean, st);
+		} else {
+			bgp_show_table_clean(st);
 		}
+		return CMD_SUCCESS;
 	}
 
-	/* No route is displayed */
-	if(output_count == 0) {
-		if(type == bgp_show_type_normal) {
-			vty_out(vty, "No BGP prefixes displayed, %ld exist%s", total_count, VTY_NEWLINE);
+	/* Start processing of routes. */
+	for(rn = bgp_table_top_info(table); rn; rn = bgp_route_next_info(rn)) {
+		if(rn->info != NULL) {
+			bgp_show_node(vty, rn, &state);
 		}
-	} else {
-		vty_out(vty, "%sDisplayed  %ld out of %ld total prefixes%s", VTY_NEWLINE, output_count, total_count, VTY_NEWLINE);
 	}
 
+	bgp_show_table_end(vty, &state);
+
 	return CMD_SUCCESS;
 }
 
@@ -5970,8 +7810,169 @@ static int bgp_show(struct vty *vty, struct bgp *bgp, afi_t afi, safi_t safi, en
 	return bgp_show_table(vty, table, &bgp->router_id, type, output_arg);
 }
 
+/* A node's best path, or its withdrawal, for 'changes-since' */
+static void bgp_show_change_json(struct json_out *j, struct bgp_node *rn) {
+	struct bgp_info *ri;
+	struct attr *attr;
+	char buf[INET6_ADDRSTRLEN];
+
+	for(ri = rn->info; ri; ri = ri->next) {
+		if(CHECK_FLAG(ri->flags, BGP_INFO_SELECTED)) {
+			break;
+		}
+	}
+
+	json_out_object(j, NULL);
+	json_out_prefix(j, "prefix", &rn->p);
+	json_out_uint(j, "version", rn->version);
+	if(ri == NULL) {
+		json_out_bool(j, "withdrawn", 1);
+		json_out_object_end(j);
+		return;
+	}
+
+	attr = ri->attr;
+	if(rn->p.family == AF_INET6 && attr->extra) {
+		json_out_str(j, "nexthop", inet_ntop(AF_INET6, &attr->extra->mp_nexthop_global, buf, sizeof(buf)));
+	} else {
+		json_out_in_addr(j, "nexthop", attr->nexthop);
+	}
+	json_out_str(j, "peer", ri->peer->host);
+	if(attr->flag & ATTR_FLAG_BIT(BGP_ATTR_MULTI_EXIT_DISC)) {
+		json_out_uint(j, "med", attr->med);
+	}
+	if(attr->flag & ATTR_FLAG_BIT(BGP_ATTR_LOCAL_PREF)) {
+		json_out_uint(j, "localPref", attr->local_pref);
+	}
+	json_out_uint(j, "weight", attr->weight);
+	json_out_str(j, "asPath", attr->aspath ? aspath_print(attr->aspath) : "");
+	json_out_str(j, "origin", bgp_origin_str[attr->origin]);
+	json_out_object_end(j);
+}
+
+/* What goes out of a 'changes-since' that comes to the whole table */
+struct bgp_show_changes_state {
+	struct json_out json;
+	bgp_table_iter_t iter;
+};
+
+static int bgp_show_changes_continue(struct vty *vty, void *arg) {
+	struct bgp_show_changes_state *st = arg;
+	struct bgp_node *rn;
+
+	while((rn = bgp_table_iter_next(&st->iter)) != NULL) {
+		if(CHECK_FLAG(rn->flags, BGP_NODE_CHANGED)) {
+			bgp_show_change_json(&st->json, rn);
+		}
+		if(vty_output_full(vty)) {
+			bgp_table_iter_pause(&st->iter);
+			return 1;
+		}
+	}
+
+	json_out_array_end(&st->json);
+	json_out_object_end(&st->json);
+	json_out_finish(&st->json);
+	return 0;
+}
+
+static void bgp_show_changes_clean(void *arg) {
+	struct bgp_show_changes_state *st = arg;
+
+	bgp_table_iter_cleanup(&st->iter);
+	XFREE(MTYPE_BGP_SHOW, st);
+}
+
+/* The best paths changed since a table version, oldest change first, so
+ * that a consumer keeping a copy of the table need not fetch all of it
+ * again.  If the changes since are no longer all known, because too
+ * many withdrawals came since, it has to: the JSON then holds every
+ * best path, "full" telling to drop what isn't among them. */
+static int bgp_show_changes(struct vty *vty, afi_t afi, safi_t safi, const char *version_str, int use_json) {
+	struct bgp *bgp;
+	struct bgp_table *table;
+	struct bgp_show_changes_state *st;
+	struct json_out json;
+	bgp_table_changes_t changes;
+	struct bgp_node *rn;
+	struct bgp_info *ri;
+	unsigned long long version;
+	char *endptr;
+	int known;
+
+	errno = 0;
+	version = strtoull(version_str, &endptr, 10);
+	if(*endptr != '\0' || errno || version_str[0] == '-') {
+		vty_out(vty, "%% Malformed table version%s", VTY_NEWLINE);
+		return CMD_WARNING;
+	}
+
+	bgp = bgp_get_default();
+	if(bgp == NULL) {
+		vty_out(vty, "No BGP process is configured%s", VTY_NEWLINE);
+		return CMD_WARNING;
+	}
+	table = bgp->rib[afi][safi];
+	known = bgp_table_changes_init(&changes, table, version);
+
+	if(!use_json) {
+		if(!known) {
+			vty_out(vty, "%% Changes since version %llu are no longer kept, table version is %llu%s", version, (unsigned long long) table->version, VTY_NEWLINE);
+			return CMD_WARNING;
+		}
+		vty_out(vty, "BGP table version is %llu, changes since version %llu%s", (unsigned long long) table->version, version, VTY_NEWLINE);
+		vty_out(vty, BGP_SHOW_SCODE_HEADER, VTY_NEWLINE, VTY_NEWLINE);
+		vty_out(vty, "              W withdrawn%s", VTY_NEWLINE);
+		vty_out(vty, BGP_SHOW_OCODE_HEADER, VTY_NEWLINE, VTY_NEWLINE);
+		vty_out(vty, BGP_SHOW_HEADER, VTY_NEWLINE);
+		while((rn = bgp_table_changes_next(&changes)) != NULL) {
+			for(ri = rn->info; ri; ri = ri->next) {
+				if(CHECK_FLAG(ri->flags, BGP_INFO_SELECTED)) {
+					break;
+				}
+			}
+			if(ri) {
+				route_vty_out(vty, &rn->p, ri, 0, safi);
+			} else {
+				vty_out(vty, "W  ");
+				route_vty_out_route(&rn->p, vty);
+				vty_out(vty, "%s", VTY_NEWLINE);
+			}
+		}
+		return CMD_SUCCESS;
+	}
+
+	json_out_init(&json, vty);
+	json_out_object(&json, NULL);
+	json_out_uint(&json, "version", table->version);
+	json_out_uint(&json, "since", version);
+	json_out_bool(&json, "full", !known);
+	json_out_array(&json, "changes");
+
+	if(known) {
+		while((rn = bgp_table_changes_next(&changes)) != NULL) {
+			bgp_show_change_json(&json, rn);
+		}
+		json_out_array_end(&json);
+		json_out_object_end(&json);
+		json_out_finish(&json);
+		return CMD_SUCCESS;
+	}
+
+	/* the whole table goes out as the vty drains */
+	st = XMALLOC(MTYPE_BGP_SHOW, sizeof(struct bgp_show_changes_state));
+	st->json = json;
+	bgp_table_iter_init(&st->iter, table);
+	if(bgp_show_changes_continue(vty, st)) {
+		vty_output_continue(vty, bgp_show_changes_continue, bgp_show_changes_clean, st);
+	} else {
+		bgp_show_changes_clean(st);
+	}
+	return CMD_SUCCESS;
+}
+
 /* Header of detailed BGP route information */
-static void route_vty_out_detail_header(struct vty *vty, struct bgp *bgp, struct bgp_node *rn, struct prefix_rd *prd, afi_t afi, safi_t safi) {
+static void route_vty_out_detail_header(struct vty *vty, struct bgp *bgp, struct bgp_node *rn, struct prefix_rd *prd, afi_t afi, safi_t safi, struct peer *rsclient) {
 	struct bgp_info *ri;
 	struct prefix *p;
 	struct peer *peer;
@@ -5991,6 +7992,9 @@ static void route_vty_out_detail_header(struct vty *vty, struct bgp *bgp, struct
 	vty_out(vty, "BGP routing table entry for %s%s%s/%d%s", (printrd ? prefix_rd2str(prd, buf1, RD_ADDRSTRLEN) : ""), printrd ? ":" : "", inet_ntop(p->family, &p->u.prefix, buf2, INET6_ADDRSTRLEN), p->prefixlen, VTY_NEWLINE);
 
 	for(ri = rn->info; ri; ri = ri->next) {
+		if(rsclient && !bgp_rs_path_test(ri, 0, rsclient->rs_index[afi][safi] - 1)) {
+			continue;
+		}
 		count++;
 		if(CHECK_FLAG(ri->flags, BGP_INFO_SELECTED)) {
 			best = count;
@@ -6032,7 +8036,10 @@ static void route_vty_out_detail_header(struct vty *vty, struct bgp *bgp, struct
 	}
 	vty_out(vty, ")%s", VTY_NEWLINE);
 
-	/* advertised peer */
+	/* advertised peer, from the client's own table for a shared one */
+	if(rsclient) {
+		rn = bgp_node_get(rsclient->rib[afi][safi], p);
+	}
 	for(ALL_LIST_ELEMENTS(bgp->peer, node, nnode, peer)) {
 		if(bgp_adj_out_lookup(peer, p, afi, safi, rn)) {
 			if(!first) {
@@ -6046,6 +8053,10 @@ static void route_vty_out_detail_header(struct vty *vty, struct bgp *bgp, struct
 		vty_out(vty, "  Not advertised to any peer");
 	}
 	vty_out(vty, "%s", VTY_NEWLINE);
+
+	if(rsclient) {
+		bgp_unlock_node(rn);
+	}
 }
 
 /* Display specified route of BGP table. */
@@ -6057,7 +8068,10 @@ static int bgp_show_route_in_table(struct vty *vty, struct bgp *bgp, struct bgp_
 	struct bgp_node *rn;
 	struct bgp_node *rm;
 	struct bgp_info *ri;
+	struct bgp_info *selected = NULL;
 	struct bgp_table *table;
+	struct peer *rsclient;
+	u_int16_t rs_i = 0;
 
 	memset(&match, 0, sizeof(struct prefix)); /* keep valgrind happy */
 	/* Check IP address argument. */
@@ -6070,11 +8084,7 @@ static int bgp_show_route_in_table(struct vty *vty, struct bgp *bgp, struct bgp_
 	match.family = afi2family(afi);
 
 	if((safi == SAFI_MPLS_VPN) || (safi == SAFI_ENCAP)) {
-		for(rn = bgp_table_top(rib); rn; rn = bgp_route_next(rn)) {
-			if(prd && memcmp(rn->p.u.val, prd->val, 8) != 0) {
-				continue;
-			}
-
+		for(rn = bgp_rd_top(rib, prd); rn; rn = bgp_rd_next(rn, prd)) {
 			if((table = rn->info) != NULL) {
 				header = 1;
 
@@ -6086,7 +8096,7 @@ static int bgp_show_route_in_table(struct vty *vty, struct bgp *bgp, struct bgp_
 
 					for(ri = rm->info; ri; ri = ri->next) {
 						if(header) {
-							route_vty_out_detail_header(vty, bgp, rm, (struct prefix_rd *) &rn->p, AFI_IP, safi);
+							route_vty_out_detail_header(vty, bgp, rm, (struct prefix_rd *) &rn->p, AFI_IP, safi, NULL);
 
 							header = 0;
 						}
@@ -6105,11 +8115,26 @@ static int bgp_show_route_in_table(struct vty *vty, struct bgp *bgp, struct bgp_
 	} else {
 		header = 1;
 
+		/* as bgp_show_table() */
+		if((rsclient = bgp_show_rs_shared(rib))) {
+			rs_i = rsclient->rs_index[afi][safi] - 1;
+			rib = bgp->rs_shared[afi][safi]->table;
+		}
+
 		if((rn = bgp_node_match(rib, &match)) != NULL) {
 			if(!prefix_check || rn->p.prefixlen == match.prefixlen) {
+				for(selected = rn->info; rsclient && selected; selected = selected->next) {
+					if(bgp_rs_path_test(selected, 1, rs_i)) {
+						SET_FLAG(selected->flags, BGP_INFO_SELECTED);
+						break;
+					}
+				}
 				for(ri = rn->info; ri; ri = ri->next) {
+					if(rsclient && !bgp_rs_path_test(ri, 0, rs_i)) {
+						continue;
+					}
 					if(header) {
-						route_vty_out_detail_header(vty, bgp, rn, NULL, afi, safi);
+						route_vty_out_detail_header(vty, bgp, rn, NULL, afi, safi, rsclient);
 						header = 0;
 					}
 					display++;
@@ -6119,6 +8144,9 @@ static int bgp_show_route_in_table(struct vty *vty, struct bgp *bgp, struct bgp_
 						route_vty_out_detail(vty, bgp, &rn->p, ri, afi, safi);
 					}
 				}
+				if(rsclient && selected) {
+					UNSET_FLAG(selected->flags, BGP_INFO_SELECTED);
+				}
 			}
 
 			bgp_unlock_node(rn);
@@ -6171,6 +8199,36 @@ DEFUN(show_ip_bgp_ipv4, show_ip_bgp_ipv4_cmd, "show ip bgp ipv4 (unicast|multica
 	return bgp_show(vty, NULL, AFI_IP, SAFI_UNICAST, bgp_show_type_normal, NULL);
 }
 
+DEFUN(show_ip_bgp_changes, show_ip_bgp_changes_cmd, "show ip bgp changes-since VERSION", SHOW_STR IP_STR BGP_STR "Best paths changed since a table version\n" "Table version\n") {
+	return bgp_show_changes(vty, AFI_IP, SAFI_UNICAST, argv[0], 0);
+}
+
+DEFUN(show_ip_bgp_changes_json, show_ip_bgp_changes_json_cmd, "show ip bgp changes-since VERSION json",
+      SHOW_STR IP_STR BGP_STR "Best paths changed since a table version\n"
+			      "Table version\n"
+			      "JavaScript Object Notation\n") {
+	return bgp_show_changes(vty, AFI_IP, SAFI_UNICAST, argv[0], 1);
+}
+
+DEFUN(show_ip_bgp_ipv4_changes, show_ip_bgp_ipv4_changes_cmd, "show ip bgp ipv4 (unicast|multicast) changes-since VERSION",
+      SHOW_STR IP_STR BGP_STR "Address family\n"
+			      "Address Family modifier\n"
+			      "Address Family modifier\n"
+			      "Best paths changed since a table version\n"
+			      "Table version\n") {
+	return bgp_show_changes(vty, AFI_IP, strncmp(argv[0], "m", 1) == 0 ? SAFI_MULTICAST : SAFI_UNICAST, argv[1], 0);
+}
+
+DEFUN(show_ip_bgp_ipv4_changes_json, show_ip_bgp_ipv4_changes_json_cmd, "show ip bgp ipv4 (unicast|multicast) changes-since VERSION json",
+      SHOW_STR IP_STR BGP_STR "Address family\n"
+			      "Address Family modifier\n"
+			      "Address Family modifier\n"
+			      "Best paths changed since a table version\n"
+			      "Table version\n"
+			      "JavaScript Object Notation\n") {
+	return bgp_show_changes(vty, AFI_IP, strncmp(argv[0], "m", 1) == 0 ? SAFI_MULTICAST : SAFI_UNICAST, argv[1], 1);
+}
+
 DEFUN(show_ip_bgp_route, show_ip_bgp_route_cmd, "show ip bgp A.B.C.D", SHOW_STR IP_STR BGP_STR "Network in the BGP routing table to display\n") {
 	return bgp_show_route(vty, NULL, argv[0], AFI_IP, SAFI_UNICAST, NULL, 0, BGP_PATH_ALL);
 }
@@ -6354,6 +8412,25 @@ DEFUN(show_bgp, show_bgp_cmd, "show bgp", SHOW_STR BGP_STR) {
 
 ALIAS(show_bgp, show_bgp_ipv6_cmd, "show bgp ipv6", SHOW_STR BGP_STR "Address family\n")
 
+DEFUN(show_bgp_ipv6_changes, show_bgp_ipv6_changes_cmd, "show bgp ipv6 (unicast|multicast) changes-since VERSION",
+      SHOW_STR BGP_STR "Address family\n"
+		       "Address Family modifier\n"
+		       "Address Family modifier\n"
+		       "Best paths changed since a table version\n"
+		       "Table version\n") {
+	return bgp_show_changes(vty, AFI_IP6, strncmp(argv[0], "m", 1) == 0 ? SAFI_MULTICAST : SAFI_UNICAST, argv[1], 0);
+}
+
+DEFUN(show_bgp_ipv6_changes_json, show_bgp_ipv6_changes_json_cmd, "show bgp ipv6 (unicast|multicast) changes-since VERSION json",
+      SHOW_STR BGP_STR "Address family\n"
+		       "Address Family modifier\n"
+		       "Address Family modifier\n"
+		       "Best paths changed since a table version\n"
+		       "Table version\n"
+		       "JavaScript Object Notation\n") {
+	return bgp_show_changes(vty, AFI_IP6, strncmp(argv[0], "m", 1) == 0 ? SAFI_MULTICAST : SAFI_UNICAST, argv[1], 1);
+}
+
 /* old command */
 DEFUN(show_ipv6_bgp, show_ipv6_bgp_cmd, "show ipv6 bgp", SHOW_STR IP_STR BGP_STR) {
 	return bgp_show(vty, NULL, AFI_IP6, SAFI_UNICAST, bgp_show_type_normal, NULL);
@@ -6892,7 +8969,7 @@ static int bgp_show_regexp(struct vty *vty, int argc, const char **argv, afi_t a
 	struct buffer *b;
 	char *regstr;
 	int first;
-	regex_t *regex;
+	struct bgp_aspath_regex *regex;
 	int rc;
 
 	first = 0;
@@ -6914,7 +8991,7 @@ static int bgp_show_regexp(struct vty *vty, int argc, const char **argv, afi_t a
 	regstr = buffer_getstr(b);
 	buffer_free(b);
 
-	regex = bgp_regcomp(regstr);
+	regex = bgp_aspath_regcomp(regstr);
 	XFREE(MTYPE_TMP, regstr);
 	if(!regex) {
 		vty_out(vty, "Can't compile regexp %s%s", argv[0], VTY_NEWLINE);
@@ -6922,7 +8999,7 @@ static int bgp_show_regexp(struct vty *vty, int argc, const char **argv, afi_t a
 	}
 
 	rc = bgp_show(vty, NULL, afi, safi, type, regex);
-	bgp_regex_free(regex);
+	bgp_aspath_regex_free(regex);
 	return rc;
 }
 
@@ -7301,6 +9378,12 @@ DEFUN(show_ip_bgp_dampening_info, show_ip_bgp_dampening_params_cmd, "show ip bgp
 	return bgp_show_dampening_parameters(vty, AFI_IP, SAFI_UNICAST);
 }
 
+DEFUN(show_bgp_dampening_statistics, show_bgp_dampening_statistics_cmd, "show bgp dampening statistics",
+      SHOW_STR BGP_STR "Display detailed information about dampening\n"
+		       "Display reuse list depths and reuse processing counters\n") {
+	return bgp_show_dampening_statistics(vty);
+}
+
 DEFUN(show_bgp_ipv4_filter_list, show_bgp_ipv4_filter_list_cmd, "show bgp ipv4 filter-list WORD",
       SHOW_STR BGP_STR IP_STR "Display routes conforming to the filter-list\n"
 			      "Regular expression access list name\n") {
@@ -10493,6 +12576,10 @@ static int bgp_peer_count_walker(struct thread *t) {
 
 			pc->count[PCOUNT_ALL]++;
 
+			if(CHECK_FLAG(ri->flags, BGP_INFO_ADJ_IN)) {
+				pc->count[PCOUNT_ADJ_IN]++;
+			}
+
 			if(CHECK_FLAG(ri->flags, BGP_INFO_DAMPED)) {
 				pc->count[PCOUNT_DAMPED]++;
 			}
@@ -10703,6 +12790,24 @@ DEFUN(show_ip_bgp_encap_neighbor_prefix_counts, show_ip_bgp_encap_neighbor_prefi
 	return bgp_peer_counts(vty, peer, AFI_IP, SAFI_ENCAP);
 }
 
+/* One Adj-RIB-In or -Out entry; attr is NULL for one yet to be sent */
+static void show_adj_route_entry(struct vty *vty, struct bgp *bgp, struct prefix *p, struct attr *attr, safi_t safi, int *header1, int *header2, unsigned long *output_count) {
+	if(*header1) {
+		vty_out(vty, "BGP table version is 0, local router ID is %s%s", inet_ntoa(bgp->router_id), VTY_NEWLINE);
+		vty_out(vty, BGP_SHOW_SCODE_HEADER, VTY_NEWLINE, VTY_NEWLINE);
+		vty_out(vty, BGP_SHOW_OCODE_HEADER, VTY_NEWLINE, VTY_NEWLINE);
+		*header1 = 0;
+	}
+	if(*header2) {
+		vty_out(vty, BGP_SHOW_HEADER, VTY_NEWLINE);
+		*header2 = 0;
+	}
+	if(attr) {
+		route_vty_out_tmp(vty, p, attr, safi);
+		(*output_count)++;
+	}
+}
+
 static void show_adj_route(struct vty *vty, struct peer *peer, afi_t afi, safi_t safi, int in) {
 	struct bgp_table *table;
 	struct bgp_adj_in *ain;
@@ -10734,41 +12839,33 @@ static void show_adj_route(struct vty *vty, struct peer *peer, afi_t afi, safi_t
 
 	for(rn = bgp_table_top(table); rn; rn = bgp_route_next(rn)) {
 		if(in) {
+			struct bgp_info *ri;
+
 			for(ain = rn->adj_in; ain; ain = ain->next) {
 				if(ain->peer == peer) {
-					if(header1) {
-						vty_out(vty, "BGP table version is 0, local router ID is %s%s", inet_ntoa(bgp->router_id), VTY_NEWLINE);
-						vty_out(vty, BGP_SHOW_SCODE_HEADER, VTY_NEWLINE, VTY_NEWLINE);
-						vty_out(vty, BGP_SHOW_OCODE_HEADER, VTY_NEWLINE, VTY_NEWLINE);
-						header1 = 0;
-					}
-					if(header2) {
-						vty_out(vty, BGP_SHOW_HEADER, VTY_NEWLINE);
-						header2 = 0;
-					}
-					if(ain->attr) {
-						route_vty_out_tmp(vty, &rn->p, ain->attr, safi);
-						output_count++;
-					}
+					show_adj_route_entry(vty, bgp, &rn->p, ain->attr, safi, &header1, &header2, &output_count);
+				}
+			}
+
+			/* or the paths that stand in for the entries */
+			for(ri = rn->info; ri; ri = ri->next) {
+				if(ri->peer == peer && CHECK_FLAG(ri->flags, BGP_INFO_ADJ_IN)) {
+					show_adj_route_entry(vty, bgp, &rn->p, ri->attr, safi, &header1, &header2, &output_count);
 				}
 			}
 		} else {
+			struct bgp_adj_shared *as;
+
 			for(adj = rn->adj_out; adj; adj = adj->next) {
 				if(adj->peer == peer) {
-					if(header1) {
-						vty_out(vty, "BGP table version is 0, local router ID is %s%s", inet_ntoa(bgp->router_id), VTY_NEWLINE);
-						vty_out(vty, BGP_SHOW_SCODE_HEADER, VTY_NEWLINE, VTY_NEWLINE);
-						vty_out(vty, BGP_SHOW_OCODE_HEADER, VTY_NEWLINE, VTY_NEWLINE);
-						header1 = 0;
-					}
-					if(header2) {
-						vty_out(vty, BGP_SHOW_HEADER, VTY_NEWLINE);
-						header2 = 0;
-					}
-					if(adj->attr) {
-						route_vty_out_tmp(vty, &rn->p, adj->attr, safi);
-						output_count++;
-					}
+					show_adj_route_entry(vty, bgp, &rn->p, adj->attr, safi, &header1, &header2, &output_count);
+				}
+			}
+
+			/* and whatever the peer's update-group holds for it */
+			for(as = rn->adj_shared; as; as = as->next) {
+				if(bgp_adj_shared_member(as, peer, afi, safi)) {
+					show_adj_route_entry(vty, bgp, &rn->p, as->attr, safi, &header1, &header2, &output_count);
 				}
 			}
 		}
@@ -13255,11 +15352,7 @@ static int bgp_clear_damp_route(struct vty *vty, const char *view_name, const ch
 	match.family = afi2family(afi);
 
 	if((safi == SAFI_MPLS_VPN) || (safi == SAFI_ENCAP)) {
-		for(rn = bgp_table_top(bgp->rib[AFI_IP][safi]); rn; rn = bgp_route_next(rn)) {
-			if(prd && memcmp(rn->p.u.val, prd->val, 8) != 0) {
-				continue;
-			}
-
+		for(rn = bgp_rd_top(bgp->rib[AFI_IP][safi], prd); rn; rn = bgp_rd_next(rn, prd)) {
 			if((table = rn->info) != NULL) {
 				if((rm = bgp_node_match(table, &match)) != NULL) {
 					if(!prefix_check || rm->p.prefixlen == match.prefixlen) {
@@ -13828,6 +15921,8 @@ void bgp_route_init(void) {
 	install_element(BGP_NODE, &old_no_ipv6_aggregate_address_summary_only_cmd);
 
 	install_element(VIEW_NODE, &show_bgp_ipv6_safi_cmd);
+	install_element(VIEW_NODE, &show_bgp_ipv6_changes_cmd);
+	install_element(VIEW_NODE, &show_bgp_ipv6_changes_json_cmd);
 	install_element(VIEW_NODE, &show_bgp_ipv6_route_cmd);
 	install_element(VIEW_NODE, &show_bgp_ipv6_safi_route_cmd);
 	install_element(VIEW_NODE, &show_bgp_ipv6_prefix_cmd);
@@ -14003,6 +16098,10 @@ void bgp_route_init(void) {
 	/* old style commands */
 	install_element(VIEW_NODE, &show_ip_bgp_cmd);
 	install_element(VIEW_NODE, &show_ip_bgp_ipv4_cmd);
+	install_element(VIEW_NODE, &show_ip_bgp_changes_cmd);
+	install_element(VIEW_NODE, &show_ip_bgp_changes_json_cmd);
+	install_element(VIEW_NODE, &show_ip_bgp_ipv4_changes_cmd);
+	install_element(VIEW_NODE, &show_ip_bgp_ipv4_changes_json_cmd);
 	install_element(VIEW_NODE, &show_ip_bgp_route_cmd);
 	install_element(VIEW_NODE, &show_ip_bgp_route_pathtype_cmd);
 	install_element(VIEW_NODE, &show_bgp_ipv4_safi_route_pathtype_cmd);
@@ -14074,6 +16173,7 @@ void bgp_route_init(void) {
 	install_element(VIEW_NODE, &show_ip_bgp_neighbor_received_prefix_filter_cmd);
 	install_element(VIEW_NODE, &show_ip_bgp_ipv4_neighbor_received_prefix_filter_cmd);
 	install_element(VIEW_NODE, &show_ip_bgp_dampening_params_cmd);
+	install_element(VIEW_NODE, &show_bgp_dampening_statistics_cmd);
 	install_element(VIEW_NODE, &show_ip_bgp_ipv4_dampening_parameters_cmd);
 	install_element(VIEW_NODE, &show_ip_bgp_dampened_paths_cmd);
 	install_element(VIEW_NODE, &show_ip_bgp_ipv4_dampening_dampd_paths_cmd);
@@ -14332,4 +16432,9 @@ void bgp_route_init(void) {
 void bgp_route_finish(void) {
 	bgp_table_unlock(bgp_distance_table);
 	bgp_distance_table = NULL;
+
+	if(bgp_select_pool) {
+		work_pool_free(bgp_select_pool);
+		bgp_select_pool = NULL;
+	}
 }
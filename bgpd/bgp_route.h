@@ -43,6 +43,65 @@ struct bgp_info_extra {
 
 	/* MPLS label.  */
 	u_char tag[3];
+
+	/* Multipath information, only ever there with maximum-paths set.  */
+	struct bgp_info_mpath *mpath;
+
+	/* Clients accepting the path and clients it is the best path of,
+	 * for paths in the shared RS-client table only.  */
+	struct bgp_rs_path *rs;
+};
+
+/* Bitmaps over client indices in the shared RS-client table: the first
+ * 'words' words are the clients whose policy accepts the path, the next
+ * 'words' the clients it is currently selected for.  Indices past the end
+ * are clear in both.
+ */
+struct bgp_rs_path {
+	u_int16_t words;
+	u_int32_t bits[];
+};
+
+/* Route server clients of an instance, in an AFI/SAFI, that share one
+ * table of paths instead of each having a copy of all of them.  Which
+ * paths a client's policy accepts is kept per path, and best path
+ * selection runs once for all the clients accepting the same paths.
+ */
+struct bgp_rs_shared {
+	struct bgp_table *table;
+
+	/* Client indices in use.  A client's index is in peer->rs_index. */
+	u_int32_t *index_used;
+	u_int16_t index_words;
+	unsigned int clients;
+
+	/* Statistics */
+	unsigned long selections; /* best path selections run */
+	unsigned long decisions;  /* client best paths they decided */
+};
+
+/* SAFIs whose RS clients can share their table, those with a single
+ * level one */
+#define BGP_RS_SHARED_SAFI(S) ((S) == SAFI_UNICAST || (S) == SAFI_MULTICAST)
+
+/* What bgp_info_cmp() needs of the attributes and the nexthop metric,
+ * worked out again by bgp_info_key_update() whenever either changes.
+ */
+struct bgp_info_key {
+	u_int32_t weight;
+	u_int32_t local_pref;
+	u_int32_t med;
+	u_int32_t igpmetric;
+	u_int32_t originator_id; /* host order */
+	unsigned int hops;
+	unsigned int confeds;
+	int cluster;
+	u_char origin;
+
+	u_char flags;
+#define BGP_INFO_KEY_LOCAL_PREF (1 << 0)
+#define BGP_INFO_KEY_MED (1 << 1)
+#define BGP_INFO_KEY_ORIGINATOR_ID (1 << 2)
 };
 
 struct bgp_info {
@@ -65,15 +124,23 @@ struct bgp_info {
 	/* Attribute structure.  */
 	struct attr *attr;
 
-	/* Extra information */
+	/* Extra information, for the few routes that need any */
 	struct bgp_info_extra *extra;
 
-	/* Multipath information */
-	struct bgp_info_mpath *mpath;
+	/* Best path comparison key.  */
+	struct bgp_info_key key;
 
 	/* Uptime.  */
 	time_t uptime;
 
+	/* Epoch of the peer the path was last received in */
+	u_int32_t epoch;
+
+	/* Add-Path IDs: the one the peer sent the path with, and the one it
+	   goes out with to peers that are sent more than the best path */
+	u_int32_t addpath_rx_id;
+	u_int32_t addpath_tx_id;
+
 	/* reference count */
 	int lock;
 
@@ -92,6 +159,9 @@ struct bgp_info {
 #define BGP_INFO_COUNTED (1 << 10)
 #define BGP_INFO_MULTIPATH (1 << 11)
 #define BGP_INFO_MULTIPATH_CHG (1 << 12)
+#define BGP_INFO_ADJ_IN (1 << 13) /* attr is also what was received */
+#define BGP_INFO_NHG (1 << 14)	  /* in zebra through its nexthop's group */
+#define BGP_INFO_AGGREGATED (1 << 15) /* counted by the aggregates over it */
 
 	/* BGP route type.  This can be static, RIP, OSPF, BGP etc.  */
 	u_char type;
@@ -135,6 +205,26 @@ struct bgp_static {
 	u_char tag[3];
 };
 
+/* A peer's table walk (re)announcing routes, a batch of route nodes per
+ * background thread run: the main table, then the peer's own where it
+ * is a route-server client.  Nodes best-path processing gets to in the
+ * meantime are announced as usual, before or after the walk did. */
+struct bgp_announce_walk {
+	struct peer *peer;
+	afi_t afi;
+	safi_t safi;
+
+	/* walking peer->rib, or still to */
+	int rsclient;
+	int rsclient_next;
+
+	bgp_table_iter_t iter;
+	unsigned long walked;
+	unsigned long total;
+
+	struct thread *t_walk;
+};
+
 #define BGP_INFO_COUNTABLE(BI) (!CHECK_FLAG((BI)->flags, BGP_INFO_HISTORY) && !CHECK_FLAG((BI)->flags, BGP_INFO_REMOVED))
 
 /* Flags which indicate a route is unuseable in some form */
@@ -145,6 +235,9 @@ struct bgp_static {
  */
 #define BGP_INFO_HOLDDOWN(BI) (!CHECK_FLAG((BI)->flags, BGP_INFO_VALID) || CHECK_FLAG((BI)->flags, BGP_INFO_UNUSEABLE))
 
+/* Received before the peer last lost its paths, see struct peer */
+#define BGP_INFO_DEAD(BI, AFI, SAFI) ((BI)->peer && (BI)->epoch < (BI)->peer->epoch_live[(AFI)][(SAFI)])
+
 #define DISTRIBUTE_IN_NAME(F) ((F)->dlist[FILTER_IN].name)
 #define DISTRIBUTE_IN(F) ((F)->dlist[FILTER_IN].alist)
 #define DISTRIBUTE_OUT_NAME(F) ((F)->dlist[FILTER_OUT].name)
@@ -175,7 +268,8 @@ struct bgp_static {
 
 enum bgp_clear_route_type {
 	BGP_CLEAR_ROUTE_NORMAL,
-	BGP_CLEAR_ROUTE_MY_RSCLIENT
+	BGP_CLEAR_ROUTE_MY_RSCLIENT,
+	BGP_CLEAR_ROUTE_STALE
 };
 
 enum bgp_path_type {
@@ -190,10 +284,15 @@ extern void bgp_route_finish(void);
 extern void bgp_cleanup_routes(void);
 extern void bgp_announce_route(struct peer *, afi_t, safi_t);
 extern void bgp_announce_route_all(struct peer *);
+extern void bgp_announce_walk_stop(struct peer *, afi_t, safi_t);
+extern void bgp_announce_walk_stop_all(struct peer *);
 extern void bgp_default_originate(struct peer *, afi_t, safi_t, int);
 extern void bgp_soft_reconfig_in(struct peer *, afi_t, safi_t);
+extern void bgp_soft_reconfig_node(struct bgp *, struct bgp_node *, afi_t, safi_t);
 extern void bgp_soft_reconfig_rsclient(struct peer *, afi_t, safi_t);
 extern void bgp_check_local_routes_rsclient(struct peer *rsclient, afi_t afi, safi_t safi);
+extern void bgp_rsclient_shared_join(struct peer *rsclient, afi_t afi, safi_t safi);
+extern void bgp_rsclient_shared_leave(struct peer *rsclient, afi_t afi, safi_t safi);
 extern void bgp_clear_route(struct peer *, afi_t, safi_t, enum bgp_clear_route_type);
 extern void bgp_clear_route_all(struct peer *);
 extern void bgp_clear_adj_in(struct peer *, afi_t, safi_t);
@@ -204,10 +303,13 @@ extern struct bgp_info *bgp_info_unlock(struct bgp_info *);
 extern void bgp_info_add(struct bgp_node *rn, struct bgp_info *ri);
 extern void bgp_info_delete(struct bgp_node *rn, struct bgp_info *ri);
 extern struct bgp_info_extra *bgp_info_extra_get(struct bgp_info *);
+extern int bgp_info_igp_metric_matters(struct bgp *, struct bgp_node *, struct bgp_info *);
+extern void bgp_info_key_update(struct bgp_info *);
 extern void bgp_info_set_flag(struct bgp_node *, struct bgp_info *, u_int32_t);
 extern void bgp_info_unset_flag(struct bgp_node *, struct bgp_info *, u_int32_t);
 
 extern int bgp_nlri_parse_ip(struct peer *, struct attr *, struct bgp_nlri *);
+extern int bgp_nlri_parse_ipv4_decoded(struct peer *, struct attr *, struct bgp_nlri *, const struct prefix_ipv4 *, unsigned int);
 
 extern int bgp_maximum_prefix_overflow(struct peer *, afi_t, safi_t, int);
 
@@ -224,16 +326,19 @@ extern int bgp_static_set_safi(safi_t safi, struct vty *vty, const char *, const
 extern int bgp_static_unset_safi(safi_t safi, struct vty *, const char *, const char *, const char *);
 
 /* this is primarily for MPLS-VPN */
-extern int bgp_update(struct peer *, struct prefix *, struct attr *, afi_t, safi_t, int, int, struct prefix_rd *, u_char *, int);
-extern int bgp_withdraw(struct peer *, struct prefix *, struct attr *, afi_t, safi_t, int, int, struct prefix_rd *, u_char *);
+extern int bgp_update(struct peer *, struct prefix *, u_int32_t addpath_id, struct attr *, afi_t, safi_t, int, int, struct prefix_rd *, u_char *, int);
+extern int bgp_withdraw(struct peer *, struct prefix *, u_int32_t addpath_id, struct attr *, afi_t, safi_t, int, int, struct prefix_rd *, u_char *);
 
 /* for bgp_nexthop and bgp_damp */
 extern void bgp_process(struct bgp *, struct bgp_node *, afi_t, safi_t);
+extern void bgp_process_path(struct bgp *, struct bgp_node *, struct bgp_info *, afi_t, safi_t);
+extern int bgp_process_busy(void);
 extern int bgp_config_write_network(struct vty *, struct bgp *, afi_t, safi_t, int *);
 extern int bgp_config_write_distance(struct vty *, struct bgp *, afi_t, safi_t, int *);
 
 extern void bgp_aggregate_increment(struct bgp *, struct prefix *, struct bgp_info *, afi_t, safi_t);
 extern void bgp_aggregate_decrement(struct bgp *, struct prefix *, struct bgp_info *, afi_t, safi_t);
+extern void bgp_aggregate_delete_all(struct bgp *);
 
 extern u_char bgp_distance_apply(struct prefix *, struct bgp_info *, struct bgp *);
 extern u_char ipv6_bgp_distance_apply(struct prefix *, struct bgp_info *, struct bgp *);
@@ -247,5 +352,6 @@ extern void route_vty_out_tmp(struct vty *, struct prefix *, struct attr *, safi
 
 extern void bgp_peer_clear_node_queue_drain_immediate(struct peer *peer);
 extern void bgp_process_queues_drain_immediate(void);
+extern void bgp_process_hold(int);
 
 #endif /* _QUAGGA_BGP_ROUTE_H */
@@ -54,6 +54,8 @@ Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
 #include "bgpd/bgp_ecommunity.h"
 #include "bgpd/bgp_lcommunity.h"
 #include "bgpd/bgp_vty.h"
+#include "bgpd/bgp_rmap_cache.h"
+#include "bgpd/bgp_rpki.h"
 
 /* Memo of route-map commands.
 
@@ -815,6 +817,44 @@ static void route_match_origin_free(void *rule) {
 /* Route map commands for origin matching. */
 struct route_map_rule_cmd route_match_origin_cmd = { "origin", route_match_origin, route_match_origin_compile, route_match_origin_free };
 
+/* `match rpki' */
+static route_map_result_t route_match_rpki(void *rule, struct prefix *prefix, route_map_object_t type, void *object) {
+	struct bgp_info *bgp_info;
+
+	if(type == RMAP_BGP) {
+		bgp_info = object;
+
+		if(bgp_rpki_validate(prefix, bgp_info->attr->aspath, bgp_info->peer ? bgp_info->peer->local_as : 0) == *(enum bgp_rpki_state *) rule) {
+			return RMAP_MATCH;
+		}
+	}
+
+	return RMAP_NOMATCH;
+}
+
+static void *route_match_rpki_compile(const char *arg) {
+	enum bgp_rpki_state *state;
+
+	state = XMALLOC(MTYPE_ROUTE_MAP_COMPILED, sizeof(enum bgp_rpki_state));
+
+	if(strcmp(arg, "valid") == 0) {
+		*state = RPKI_VALID;
+	} else if(strcmp(arg, "invalid") == 0) {
+		*state = RPKI_INVALID;
+	} else {
+		*state = RPKI_NOTFOUND;
+	}
+
+	return state;
+}
+
+static void route_match_rpki_free(void *rule) {
+	XFREE(MTYPE_ROUTE_MAP_COMPILED, rule);
+}
+
+/* Route map commands for origin validation state matching. */
+struct route_map_rule_cmd route_match_rpki_cmd = { "rpki", route_match_rpki, route_match_rpki_compile, route_match_rpki_free };
+
 /* match probability  { */
 
 static route_map_result_t route_match_probability(void *rule, struct prefix *prefix, route_map_object_t type, void *object) {
@@ -1008,11 +1048,7 @@ static route_map_result_t route_set_weight(void *rule, struct prefix *prefix, ro
 
 		/* Set weight value. */
 		weight = route_value_adjust(rv, 0, bgp_info->peer);
-		if(weight) {
-			(bgp_attr_extra_get(bgp_info->attr))->weight = weight;
-		} else if(bgp_info->attr->extra) {
-			bgp_info->attr->extra->weight = 0;
-		}
+		bgp_info->attr->weight = weight;
 	}
 
 	return RMAP_OKAY;
@@ -2178,8 +2214,17 @@ static int bgp_route_set_delete(struct vty *vty, struct route_map_index *index,
 	return CMD_SUCCESS;
 }
 
+static void bgp_route_map_update_static(struct bgp_static *bgp_static) {
+	if(bgp_static->rmap.name) {
+		bgp_static->rmap.map = route_map_lookup_by_name(bgp_static->rmap.name);
+	} else {
+		bgp_static->rmap.map = NULL;
+	}
+}
+
 /* Hook function for updating route_map assignment. */
-static void bgp_route_map_update(const char *unused) {
+/* Point every route-map reference at the map of its name. */
+static void bgp_route_map_resolve(void) {
 	int i;
 	afi_t afi;
 	safi_t safi;
@@ -2191,6 +2236,7 @@ static void bgp_route_map_update(const char *unused) {
 	struct peer_group *group;
 	struct bgp_filter *filter;
 	struct bgp_node *bn;
+	struct bgp_node *rn;
 	struct bgp_static *bgp_static;
 
 	if(bm->bgp == NULL) { /* may be called during cleanup */
@@ -2263,12 +2309,18 @@ static void bgp_route_map_update(const char *unused) {
 		for(afi = AFI_IP; afi < AFI_MAX; afi++) {
 			for(safi = SAFI_UNICAST; safi < SAFI_MAX; safi++) {
 				for(bn = bgp_table_top(bgp->route[afi][safi]); bn; bn = bgp_route_next(bn)) {
-					if((bgp_static = bn->info) != NULL) {
-						if(bgp_static->rmap.name) {
-							bgp_static->rmap.map = route_map_lookup_by_name(bgp_static->rmap.name);
-						} else {
-							bgp_static->rmap.map = NULL;
+					if(bn->info == NULL) {
+						continue;
+					}
+					/* VPN and encap statics hang off a table per RD */
+					if(safi == SAFI_MPLS_VPN || safi == SAFI_ENCAP) {
+						for(rn = bgp_table_top(bn->info); rn; rn = bgp_route_next(rn)) {
+							if((bgp_static = rn->info) != NULL) {
+								bgp_route_map_update_static(bgp_static);
+							}
 						}
+					} else {
+						bgp_route_map_update_static(bn->info);
 					}
 				}
 			}
@@ -2288,6 +2340,22 @@ static void bgp_route_map_update(const char *unused) {
 	}
 }
 
+/* A new map is picked up at the end of a configuration batch, but the
+   references to a deleted one must go at once.  A new map only makes the
+   results of maps calling it stale, a deleted one may have cached
+   results under a pointer that is freed now. */
+static void bgp_route_map_add(const char *name) {
+	bgp_rmap_cache_invalidate(name);
+	if(!cmd_batch_defer(bgp_route_map_resolve)) {
+		bgp_route_map_resolve();
+	}
+}
+
+static void bgp_route_map_delete(const char *name) {
+	bgp_rmap_cache_flush();
+	bgp_route_map_resolve();
+}
+
 DEFUN(match_peer, match_peer_cmd, "match peer (A.B.C.D|X:X::X:X)",
       MATCH_STR "Match peer address\n"
 		"IP address of peer\n"
@@ -2625,6 +2693,24 @@ ALIAS(no_match_origin, no_match_origin_val_cmd, "no match origin (egp|igp|incomp
 		       "local IGP\n"
 		       "unknown heritage\n")
 
+DEFUN(match_rpki, match_rpki_cmd, "match rpki (invalid|notfound|valid)",
+      MATCH_STR "RPKI origin validation state\n"
+		"Covered by ROAs, none for the origin AS and length\n"
+		"Not covered by any ROA\n"
+		"Authorised by a ROA\n") {
+	return bgp_route_match_add(vty, vty->index, "rpki", argv[0]);
+}
+
+DEFUN(no_match_rpki, no_match_rpki_cmd, "no match rpki", NO_STR MATCH_STR "RPKI origin validation state\n") {
+	return bgp_route_match_delete(vty, vty->index, "rpki", NULL);
+}
+
+ALIAS(no_match_rpki, no_match_rpki_val_cmd, "no match rpki (invalid|notfound|valid)",
+      NO_STR MATCH_STR "RPKI origin validation state\n"
+		       "Covered by ROAs, none for the origin AS and length\n"
+		       "Not covered by any ROA\n"
+		       "Authorised by a ROA\n")
+
 DEFUN(match_tag, match_tag_cmd, "match tag <1-4294967295>",
       MATCH_STR "Match tag of route\n"
 		"Tag value\n") {
@@ -3352,12 +3438,19 @@ ALIAS(no_match_pathlimit_as, no_match_pathlimit_as_val_cmd, "no match pathlimit
       NO_STR MATCH_STR "BGP AS-Pathlimit attribute\n"
 		       "Match Pathlimit ASN\n")
 
+/* A route-map was edited: what it, and the maps calling it, gave
+   before no longer holds */
+static void bgp_route_map_event(route_map_event_t event, const char *name) {
+	bgp_rmap_cache_invalidate(name);
+}
+
 /* Initialization of route map. */
 void bgp_route_map_init(void) {
 	route_map_init();
 	route_map_init_vty();
-	route_map_add_hook(bgp_route_map_update);
-	route_map_delete_hook(bgp_route_map_update);
+	route_map_add_hook(bgp_route_map_add);
+	route_map_delete_hook(bgp_route_map_delete);
+	route_map_event_hook(bgp_route_map_event);
 
 	route_map_install_match(&route_match_peer_cmd);
 	route_map_install_match(&route_match_local_pref_cmd);
@@ -3375,6 +3468,7 @@ void bgp_route_map_init(void) {
 	route_map_install_match(&route_match_metric_cmd);
 	route_map_install_match(&route_match_origin_cmd);
 	route_map_install_match(&route_match_probability_cmd);
+	route_map_install_match(&route_match_rpki_cmd);
 	route_map_install_match(&route_match_tag_cmd);
 
 	route_map_install_set(&route_set_ip_nexthop_cmd);
@@ -3445,6 +3539,9 @@ void bgp_route_map_init(void) {
 	install_element(RMAP_NODE, &match_probability_cmd);
 	install_element(RMAP_NODE, &no_match_probability_cmd);
 	install_element(RMAP_NODE, &no_match_probability_val_cmd);
+	install_element(RMAP_NODE, &match_rpki_cmd);
+	install_element(RMAP_NODE, &no_match_rpki_cmd);
+	install_element(RMAP_NODE, &no_match_rpki_val_cmd);
 	install_element(RMAP_NODE, &match_tag_cmd);
 	install_element(RMAP_NODE, &no_match_tag_cmd);
 	install_element(RMAP_NODE, &no_match_tag_val_cmd);
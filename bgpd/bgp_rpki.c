@@ -0,0 +1,829 @@
+/* BGP prefix origin validation, with ROAs from RPKI-RTR caches (RFC 8210)
+ *
+ * This file is part of GNU Zebra.
+ *
+ * GNU Zebra is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2, or (at your option) any
+ * later version.
+ *
+ * GNU Zebra is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with GNU Zebra; see the file COPYING.  If not, write to the Free
+ * Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ * 02111-1307, USA.
+ */
+
+#include <zebra.h>
+
+#include "prefix.h"
+#include "table.h"
+#include "stream.h"
+#include "sockunion.h"
+#include "command.h"
+#include "thread.h"
+#include "linklist.h"
+#include "memory.h"
+#include "network.h"
+#include "log.h"
+#include "filter.h"
+
+#include "bgpd/bgpd.h"
+#include "bgpd/bgp_table.h"
+#include "bgpd/bgp_route.h"
+#include "bgpd/bgp_aspath.h"
+#include "bgpd/bgp_rpki.h"
+
+#define RPKI_VERSION 1
+#define RPKI_HEADER_SIZE 8
+
+/* Largest PDU taken from a cache, error reports with their text included */
+#define RPKI_PDU_MAX 65536
+
+/* Seconds between attempts to reach a cache */
+#define RPKI_RECONNECT 30
+
+enum rpki_state {
+	RPKI_IDLE,
+	RPKI_CONNECTING,
+	RPKI_UP,
+};
+
+static const struct message rpki_state_msg[] = {
+	{RPKI_IDLE,	    "Idle"	  },
+	{ RPKI_CONNECTING, "Connecting"},
+	{ RPKI_UP,	   "Up"	       },
+};
+static const int rpki_state_msg_max = RPKI_UP + 1;
+
+struct rpki_cache {
+	union sockunion su;
+	u_int16_t port;
+
+	enum rpki_state state;
+	int fd;
+	struct thread *t_connect;
+	struct thread *t_read;
+	struct thread *t_refresh;
+	struct thread *t_expire;
+	struct stream *ibuf;
+
+	/* Protocol version, lowered if the cache doesn't know ours */
+	u_char version;
+
+	/* Where the last complete transfer left the cache's data */
+	u_int16_t session_id;
+	u_int32_t serial;
+	int have_serial;
+
+	/* A transfer is only applied once it is complete, and one asked
+	 * with a reset query replaces whatever the cache gave before: its
+	 * ROAs then take the new generation, and those left are removed. */
+	int in_transfer;
+	int reset;
+	u_int32_t gen;
+	struct list *pending;
+
+	u_int32_t refresh;
+	u_int32_t retry;
+	u_int32_t expire;
+
+	unsigned long roa_count[AFI_MAX];
+	time_t uptime;
+	time_t updated;
+	unsigned long transfers;
+	unsigned long resets;
+};
+
+/* A ROA in rpki_roas, one of the list at the node of its prefix */
+struct rpki_roa {
+	struct rpki_roa *next;
+	struct rpki_cache *cache;
+	as_t asn;
+	u_char maxlen;
+	u_int32_t gen;
+};
+
+/* A ROA announced or withdrawn in a transfer not yet complete */
+struct rpki_change {
+	struct prefix p;
+	as_t asn;
+	u_char maxlen;
+	u_char announce;
+};
+
+static struct list *rpki_caches;
+
+static struct route_table *rpki_roas[AFI_MAX];
+
+/* Prefixes of the ROAs changed since the routes were last revalidated,
+ * any non-NULL info marking one */
+static struct route_table *rpki_dirty[AFI_MAX];
+
+static int rpki_cache_connect(struct thread *);
+
+enum bgp_rpki_state bgp_rpki_validate(struct prefix *p, struct aspath *aspath, as_t local) {
+	struct route_node *rn, *node;
+	struct rpki_roa *roa;
+	afi_t afi;
+	as_t origin;
+	int covered = 0;
+
+	afi = family2afi(p->family);
+	if((afi != AFI_IP && afi != AFI_IP6) || rpki_roas[afi]->count == 0) {
+		return RPKI_NOTFOUND;
+	}
+
+	rn = route_node_match(rpki_roas[afi], p);
+	if(rn == NULL) {
+		return RPKI_NOTFOUND;
+	}
+
+	origin = aspath ? aspath_origin(aspath, local) : local;
+	for(node = rn; node; node = node->parent) {
+		for(roa = node->info; roa; roa = roa->next) {
+			covered = 1;
+			if(origin && roa->asn == origin && p->prefixlen <= roa->maxlen) {
+				route_unlock_node(rn);
+				return RPKI_VALID;
+			}
+		}
+	}
+	route_unlock_node(rn);
+
+	return covered ? RPKI_INVALID : RPKI_NOTFOUND;
+}
+
+static void rpki_dirty_mark(afi_t afi, struct prefix *p) {
+	struct route_node *rn;
+
+	rn = route_node_get(rpki_dirty[afi], p);
+	if(rn->info) {
+		route_unlock_node(rn);
+	} else {
+		rn->info = rn;
+	}
+}
+
+/* Run the inbound policy again on the routes covered by the ROAs changed,
+ * once for each of those not covered by another one changed */
+static void rpki_revalidate(void) {
+	struct route_node *dn, *up;
+	struct bgp_node *top, *rn;
+	struct listnode *node;
+	struct bgp *bgp;
+	afi_t afi;
+
+	for(afi = AFI_IP; afi < AFI_MAX; afi++) {
+		if(rpki_dirty[afi]->count == 0) {
+			continue;
+		}
+
+		for(dn = route_top(rpki_dirty[afi]); dn; dn = route_next(dn)) {
+			if(dn->info == NULL) {
+				continue;
+			}
+			for(up = dn->parent; up; up = up->parent) {
+				if(up->info) {
+					break;
+				}
+			}
+			if(up) {
+				continue;
+			}
+
+			for(ALL_LIST_ELEMENTS_RO(bm->bgp, node, bgp)) {
+				top = bgp_node_get(bgp->rib[afi][SAFI_UNICAST], &dn->p);
+				bgp_lock_node(top);
+				for(rn = top; rn; rn = bgp_route_next_until(rn, top)) {
+					if(rn->info || rn->adj_in) {
+						bgp_soft_reconfig_node(bgp, rn, afi, SAFI_UNICAST);
+					}
+				}
+				bgp_unlock_node(top);
+			}
+		}
+
+		route_table_finish(rpki_dirty[afi]);
+		rpki_dirty[afi] = route_table_init();
+	}
+}
+
+static void rpki_roa_add(struct rpki_cache *cache, struct rpki_change *change) {
+	struct route_node *rn;
+	struct rpki_roa *roa;
+	afi_t afi = family2afi(change->p.family);
+
+	rn = route_node_get(rpki_roas[afi], &change->p);
+	for(roa = rn->info; roa; roa = roa->next) {
+		if(roa->cache == cache && roa->asn == change->asn && roa->maxlen == change->maxlen) {
+			roa->gen = cache->gen;
+			route_unlock_node(rn);
+			return;
+		}
+	}
+
+	/* the node keeps the lock while it has ROAs */
+	roa = XCALLOC(MTYPE_BGP_RPKI_ROA, sizeof(struct rpki_roa));
+	roa->cache = cache;
+	roa->asn = change->asn;
+	roa->maxlen = change->maxlen;
+	roa->gen = cache->gen;
+	roa->next = rn->info;
+	rn->info = roa;
+
+	cache->roa_count[afi]++;
+	rpki_dirty_mark(afi, &change->p);
+}
+
+/* Unlink prev's successor, or the first of rn's ROAs without prev */
+static void rpki_roa_unlink(struct route_node *rn, struct rpki_roa *prev, afi_t afi) {
+	struct rpki_roa *roa;
+
+	roa = prev ? prev->next : rn->info;
+	if(prev) {
+		prev->next = roa->next;
+	} else {
+		rn->info = roa->next;
+	}
+
+	roa->cache->roa_count[afi]--;
+	rpki_dirty_mark(afi, &rn->p);
+	XFREE(MTYPE_BGP_RPKI_ROA, roa);
+
+	if(rn->info == NULL) {
+		route_unlock_node(rn);
+	}
+}
+
+static void rpki_roa_del(struct rpki_cache *cache, struct rpki_change *change) {
+	struct route_node *rn;
+	struct rpki_roa *roa, *prev = NULL;
+	afi_t afi = family2afi(change->p.family);
+
+	rn = route_node_lookup(rpki_roas[afi], &change->p);
+	if(rn == NULL) {
+		return;
+	}
+
+	for(roa = rn->info; roa; prev = roa, roa = roa->next) {
+		if(roa->cache == cache && roa->asn == change->asn && roa->maxlen == change->maxlen) {
+			break;
+		}
+	}
+	if(roa) {
+		rpki_roa_unlink(rn, prev, afi);
+	}
+	route_unlock_node(rn);
+}
+
+/* Remove the ROAs of cache, all or those not of its current generation */
+static void rpki_roa_flush(struct rpki_cache *cache, int all) {
+	struct route_node *rn;
+	struct rpki_roa *roa, *prev, *next;
+	afi_t afi;
+
+	for(afi = AFI_IP; afi < AFI_MAX; afi++) {
+		if(cache->roa_count[afi] == 0) {
+			continue;
+		}
+		for(rn = route_top(rpki_roas[afi]); rn; rn = route_next(rn)) {
+			prev = NULL;
+			for(roa = rn->info; roa; roa = next) {
+				next = roa->next;
+				if(roa->cache == cache && (all || roa->gen != cache->gen)) {
+					rpki_roa_unlink(rn, prev, afi);
+				} else {
+					prev = roa;
+				}
+			}
+		}
+	}
+}
+
+static void rpki_pending_free(struct rpki_cache *cache) {
+	struct listnode *node, *nnode;
+	struct rpki_change *change;
+
+	for(ALL_LIST_ELEMENTS(cache->pending, node, nnode, change)) {
+		XFREE(MTYPE_BGP_RPKI_ROA, change);
+		list_delete_node(cache->pending, node);
+	}
+}
+
+static void rpki_cache_close(struct rpki_cache *cache) {
+	THREAD_OFF(cache->t_connect);
+	THREAD_OFF(cache->t_read);
+	THREAD_OFF(cache->t_refresh);
+
+	if(cache->fd >= 0) {
+		close(cache->fd);
+		cache->fd = -1;
+	}
+	cache->state = RPKI_IDLE;
+	cache->in_transfer = 0;
+	rpki_pending_free(cache);
+	stream_reset(cache->ibuf);
+}
+
+/* Lost, or not making sense: its ROAs stay until they expire, while a
+ * new session is tried in delay seconds. */
+static void rpki_cache_reset(struct rpki_cache *cache, int delay) {
+	char buf[SU_ADDRSTRLEN];
+
+	zlog_warn("RPKI cache %s port %u: session reset", sockunion2str(&cache->su, buf, sizeof(buf)), cache->port);
+
+	rpki_cache_close(cache);
+	cache->resets++;
+	cache->t_connect = thread_add_timer(bm->master, rpki_cache_connect, cache, delay);
+}
+
+static int rpki_cache_send_query(struct rpki_cache *cache) {
+	u_char pdu[12];
+	size_t len;
+
+	pdu[0] = cache->version;
+	if(cache->have_serial) {
+		pdu[1] = RPKI_PDU_SERIAL_QUERY;
+		pdu[2] = cache->session_id >> 8;
+		pdu[3] = cache->session_id;
+		len = 12;
+		pdu[8] = cache->serial >> 24;
+		pdu[9] = cache->serial >> 16;
+		pdu[10] = cache->serial >> 8;
+		pdu[11] = cache->serial;
+	} else {
+		pdu[1] = RPKI_PDU_RESET_QUERY;
+		pdu[2] = pdu[3] = 0;
+		len = 8;
+	}
+	pdu[4] = pdu[5] = pdu[6] = 0;
+	pdu[7] = len;
+
+	/* queries are asked one at a time, and go whole into the socket */
+	cache->reset = !cache->have_serial;
+	if(write(cache->fd, pdu, len) != (ssize_t) len) {
+		return -1;
+	}
+	return 0;
+}
+
+static int rpki_cache_refresh(struct thread *t) {
+	struct rpki_cache *cache = THREAD_ARG(t);
+
+	cache->t_refresh = NULL;
+
+	if(cache->state == RPKI_UP && !cache->in_transfer && rpki_cache_send_query(cache) < 0) {
+		rpki_cache_reset(cache, RPKI_RECONNECT);
+	}
+	return 0;
+}
+
+/* Nothing heard of the cache for its expire interval: its ROAs may no
+ * longer be right, and are better gone. */
+static int rpki_cache_expire(struct thread *t) {
+	struct rpki_cache *cache = THREAD_ARG(t);
+	char buf[SU_ADDRSTRLEN];
+
+	cache->t_expire = NULL;
+
+	zlog_warn("RPKI cache %s port %u: data expired", sockunion2str(&cache->su, buf, sizeof(buf)), cache->port);
+
+	cache->have_serial = 0;
+	rpki_roa_flush(cache, 1);
+	rpki_revalidate();
+
+	/* a session still up starts over with all of the cache's data */
+	if(cache->state == RPKI_UP) {
+		rpki_cache_reset(cache, 0);
+	}
+	return 0;
+}
+
+static void rpki_cache_end_of_data(struct rpki_cache *cache, u_int32_t serial) {
+	struct listnode *node;
+	struct rpki_change *change;
+
+	for(ALL_LIST_ELEMENTS_RO(cache->pending, node, change)) {
+		if(change->announce) {
+			rpki_roa_add(cache, change);
+		} else {
+			rpki_roa_del(cache, change);
+		}
+	}
+	rpki_pending_free(cache);
+	if(cache->reset) {
+		rpki_roa_flush(cache, 0);
+	}
+
+	cache->in_transfer = 0;
+	cache->reset = 0;
+	cache->serial = serial;
+	cache->have_serial = 1;
+	cache->updated = bgp_clock();
+	cache->transfers++;
+
+	THREAD_OFF(cache->t_refresh);
+	THREAD_OFF(cache->t_expire);
+	cache->t_refresh = thread_add_timer(bm->master, rpki_cache_refresh, cache, cache->refresh);
+	cache->t_expire = thread_add_timer(bm->master, rpki_cache_expire, cache, cache->expire);
+
+	rpki_revalidate();
+}
+
+static int rpki_cache_prefix(struct rpki_cache *cache, struct stream *s, size_t at, u_int32_t len, afi_t afi) {
+	struct rpki_change *change;
+	u_char flags, plen, maxlen, bits;
+
+	bits = (afi == AFI_IP) ? IPV4_MAX_BITLEN : IPV6_MAX_BITLEN;
+	if(!cache->in_transfer || len != (u_int32_t) RPKI_HEADER_SIZE + 4 + bits / 8 + 4) {
+		return -1;
+	}
+
+	flags = stream_getc_from(s, at + 8);
+	plen = stream_getc_from(s, at + 9);
+	maxlen = stream_getc_from(s, at + 10);
+	if(plen > maxlen || maxlen > bits) {
+		return -1;
+	}
+
+	change = XCALLOC(MTYPE_BGP_RPKI_ROA, sizeof(struct rpki_change));
+	change->p.family = afi2family(afi);
+	change->p.prefixlen = plen;
+	memcpy(&change->p.u.prefix, STREAM_DATA(s) + at + 12, bits / 8);
+	apply_mask(&change->p);
+	change->maxlen = maxlen;
+	change->asn = stream_getl_from(s, at + 12 + bits / 8);
+	change->announce = CHECK_FLAG(flags, RPKI_PREFIX_FLAG_ANNOUNCE) ? 1 : 0;
+	listnode_add(cache->pending, change);
+	return 0;
+}
+
+/* Act on the PDU at at in s, of length len: < 0 if the session has to go,
+ * > 0 if it went already */
+static int rpki_cache_pdu(struct rpki_cache *cache, struct stream *s, size_t at, u_int32_t len) {
+	char buf[SU_ADDRSTRLEN];
+	u_char version, type;
+	u_int16_t session, code;
+
+	version = stream_getc_from(s, at);
+	type = stream_getc_from(s, at + 1);
+	session = stream_getw_from(s, at + 2);
+
+	if(type == RPKI_PDU_ERROR_REPORT) {
+		code = session;
+		zlog_warn("RPKI cache %s port %u: error report, code %u", sockunion2str(&cache->su, buf, sizeof(buf)), cache->port, code);
+
+		if(code == RPKI_ERR_UNSUPPORTED_VERSION && cache->version > 0) {
+			cache->version--;
+			cache->have_serial = 0;
+			rpki_cache_reset(cache, 0);
+			return 1;
+		}
+		if(code == RPKI_ERR_NO_DATA) {
+			rpki_cache_reset(cache, cache->retry);
+			return 1;
+		}
+		return -1;
+	}
+
+	if(version != cache->version) {
+		return -1;
+	}
+
+	switch(type) {
+		case RPKI_PDU_SERIAL_NOTIFY:
+			if(!cache->in_transfer) {
+				THREAD_OFF(cache->t_refresh);
+				return rpki_cache_send_query(cache);
+			}
+			return 0;
+
+		case RPKI_PDU_CACHE_RESPONSE:
+			if(cache->in_transfer) {
+				return -1;
+			}
+			if(!cache->reset && session != cache->session_id) {
+				/* the cache started over: so do we */
+				cache->have_serial = 0;
+				return rpki_cache_send_query(cache);
+			}
+			cache->session_id = session;
+			cache->in_transfer = 1;
+			if(cache->reset) {
+				cache->gen++;
+			}
+			return 0;
+
+		case RPKI_PDU_IPV4_PREFIX: return rpki_cache_prefix(cache, s, at, len, AFI_IP);
+		case RPKI_PDU_IPV6_PREFIX: return rpki_cache_prefix(cache, s, at, len, AFI_IP6);
+
+		case RPKI_PDU_END_OF_DATA:
+			if(!cache->in_transfer || session != cache->session_id || len < 12) {
+				return -1;
+			}
+			if(version >= 1 && len >= 24) {
+				cache->refresh = stream_getl_from(s, at + 12);
+				cache->retry = stream_getl_from(s, at + 16);
+				cache->expire = stream_getl_from(s, at + 20);
+			}
+			rpki_cache_end_of_data(cache, stream_getl_from(s, at + 8));
+			return 0;
+
+		case RPKI_PDU_CACHE_RESET:
+			cache->have_serial = 0;
+			rpki_pending_free(cache);
+			cache->in_transfer = 0;
+			return rpki_cache_send_query(cache);
+
+		case RPKI_PDU_ROUTER_KEY:
+			/* BGPsec keys, of no use to origin validation */
+			return 0;
+
+		default: return -1;
+	}
+}
+
+static int rpki_cache_read(struct thread *t) {
+	struct rpki_cache *cache = THREAD_ARG(t);
+	struct stream *s = cache->ibuf;
+	ssize_t nbytes;
+	size_t at;
+	u_int32_t len;
+	int ret;
+
+	cache->t_read = NULL;
+
+	nbytes = stream_read_try(s, cache->fd, STREAM_WRITEABLE(s));
+	if(nbytes == 0 || nbytes == -1) {
+		rpki_cache_reset(cache, RPKI_RECONNECT);
+		return 0;
+	}
+
+	while(STREAM_READABLE(s) >= RPKI_HEADER_SIZE) {
+		at = stream_get_getp(s);
+		len = stream_getl_from(s, at + 4);
+		if(len < RPKI_HEADER_SIZE || len > RPKI_PDU_MAX) {
+			rpki_cache_reset(cache, RPKI_RECONNECT);
+			return 0;
+		}
+		if(STREAM_READABLE(s) < len) {
+			break;
+		}
+
+		ret = rpki_cache_pdu(cache, s, at, len);
+		if(ret > 0) {
+			return 0;
+		}
+		if(ret < 0) {
+			rpki_cache_reset(cache, RPKI_RECONNECT);
+			return 0;
+		}
+		stream_forward_getp(s, len);
+	}
+	stream_discard(s);
+
+	cache->t_read = thread_add_read(bm->master, rpki_cache_read, cache, cache->fd);
+	return 0;
+}
+
+static void rpki_cache_established(struct rpki_cache *cache) {
+	char buf[SU_ADDRSTRLEN];
+
+	zlog_info("RPKI cache %s port %u: session up", sockunion2str(&cache->su, buf, sizeof(buf)), cache->port);
+
+	cache->state = RPKI_UP;
+	cache->uptime = bgp_clock();
+	cache->t_read = thread_add_read(bm->master, rpki_cache_read, cache, cache->fd);
+
+	if(rpki_cache_send_query(cache) < 0) {
+		rpki_cache_reset(cache, RPKI_RECONNECT);
+	}
+}
+
+static int rpki_cache_connected(struct thread *t) {
+	struct rpki_cache *cache = THREAD_ARG(t);
+	int err = 0;
+	socklen_t len = sizeof(err);
+
+	cache->t_read = NULL;
+
+	if(getsockopt(cache->fd, SOL_SOCKET, SO_ERROR, &err, &len) < 0 || err) {
+		rpki_cache_reset(cache, RPKI_RECONNECT);
+		return 0;
+	}
+
+	rpki_cache_established(cache);
+	return 0;
+}
+
+static int rpki_cache_connect(struct thread *t) {
+	struct rpki_cache *cache = THREAD_ARG(t);
+	enum connect_result ret;
+
+	cache->t_connect = NULL;
+
+	cache->fd = sockunion_socket(&cache->su);
+	if(cache->fd < 0) {
+		rpki_cache_reset(cache, RPKI_RECONNECT);
+		return 0;
+	}
+
+	ret = sockunion_connect(cache->fd, &cache->su, htons(cache->port), 0);
+	if(ret == connect_error) {
+		rpki_cache_reset(cache, RPKI_RECONNECT);
+		return 0;
+	}
+	set_nonblocking(cache->fd);
+
+	if(ret == connect_success) {
+		rpki_cache_established(cache);
+	} else {
+		/* t_read stands in for the write thread waiting on connect() */
+		cache->state = RPKI_CONNECTING;
+		cache->t_read = thread_add_write(bm->master, rpki_cache_connected, cache, cache->fd);
+	}
+	return 0;
+}
+
+static struct rpki_cache *rpki_cache_lookup(union sockunion *su, u_int16_t port) {
+	struct listnode *node;
+	struct rpki_cache *cache;
+
+	for(ALL_LIST_ELEMENTS_RO(rpki_caches, node, cache)) {
+		if(sockunion_same(&cache->su, su) && cache->port == port) {
+			return cache;
+		}
+	}
+	return NULL;
+}
+
+static void rpki_cache_free(struct rpki_cache *cache) {
+	rpki_cache_close(cache);
+	THREAD_OFF(cache->t_expire);
+	list_free(cache->pending);
+	stream_free(cache->ibuf);
+	XFREE(MTYPE_BGP_RPKI_CACHE, cache);
+}
+
+DEFUN(bgp_rpki_cache, bgp_rpki_cache_cmd, "rpki cache A.B.C.D <1-65535>",
+      "RPKI origin validation\n"
+      "Take ROAs from an RPKI-RTR cache\n"
+      "Cache address\n"
+      "Cache port\n") {
+	struct rpki_cache *cache;
+	union sockunion su;
+	u_int16_t port;
+
+	if(vty->index && ((struct bgp *) vty->index)->name) {
+		vty_out(vty, "%% RPKI caches are configured in the default instance only%s", VTY_NEWLINE);
+		return CMD_WARNING;
+	}
+
+	if(str2sockunion(argv[0], &su) < 0) {
+		vty_out(vty, "%% Malformed address%s", VTY_NEWLINE);
+		return CMD_WARNING;
+	}
+	VTY_GET_INTEGER_RANGE("port", port, argv[1], 1, 65535);
+
+	if(rpki_cache_lookup(&su, port)) {
+		return CMD_SUCCESS;
+	}
+
+	cache = XCALLOC(MTYPE_BGP_RPKI_CACHE, sizeof(struct rpki_cache));
+	cache->su = su;
+	cache->port = port;
+	cache->fd = -1;
+	cache->version = RPKI_VERSION;
+	cache->refresh = RPKI_REFRESH_DEFAULT;
+	cache->retry = RPKI_RETRY_DEFAULT;
+	cache->expire = RPKI_EXPIRE_DEFAULT;
+	cache->pending = list_new();
+	cache->ibuf = stream_new(RPKI_PDU_MAX);
+	listnode_add(rpki_caches, cache);
+
+	cache->t_connect = thread_add_event(bm->master, rpki_cache_connect, cache, 0);
+	return CMD_SUCCESS;
+}
+
+DEFUN(no_bgp_rpki_cache, no_bgp_rpki_cache_cmd, "no rpki cache A.B.C.D <1-65535>",
+      NO_STR "RPKI origin validation\n"
+	     "Take ROAs from an RPKI-RTR cache\n"
+	     "Cache address\n"
+	     "Cache port\n") {
+	struct rpki_cache *cache;
+	union sockunion su;
+	u_int16_t port;
+
+	if(str2sockunion(argv[0], &su) < 0) {
+		vty_out(vty, "%% Malformed address%s", VTY_NEWLINE);
+		return CMD_WARNING;
+	}
+	VTY_GET_INTEGER_RANGE("port", port, argv[1], 1, 65535);
+
+	cache = rpki_cache_lookup(&su, port);
+	if(!cache) {
+		vty_out(vty, "%% No such cache%s", VTY_NEWLINE);
+		return CMD_WARNING;
+	}
+
+	listnode_delete(rpki_caches, cache);
+	rpki_roa_flush(cache, 1);
+	rpki_cache_free(cache);
+	rpki_revalidate();
+	return CMD_SUCCESS;
+}
+
+DEFUN(show_bgp_rpki, show_bgp_rpki_cmd, "show bgp rpki", SHOW_STR BGP_STR "RPKI-RTR caches\n") {
+	struct listnode *node;
+	struct rpki_cache *cache;
+	char buf[SU_ADDRSTRLEN];
+	char timebuf[BGP_UPTIME_LEN];
+
+	for(ALL_LIST_ELEMENTS_RO(rpki_caches, node, cache)) {
+		vty_out(vty, "Cache %s port %u, %s", sockunion2str(&cache->su, buf, sizeof(buf)), cache->port, LOOKUP(rpki_state_msg, cache->state));
+		if(cache->state == RPKI_UP) {
+			vty_out(vty, " for %s, version %u%s", peer_uptime(cache->uptime, timebuf, BGP_UPTIME_LEN), cache->version, cache->in_transfer ? ", transfer running" : "");
+		}
+		vty_out(vty, "%s", VTY_NEWLINE);
+		if(cache->have_serial) {
+			vty_out(vty, "  Session %u, serial %u, updated %s ago%s", cache->session_id, cache->serial, peer_uptime(cache->updated, timebuf, BGP_UPTIME_LEN), VTY_NEWLINE);
+		}
+		vty_out(vty, "  %lu IPv4 and %lu IPv6 ROAs, %lu transfers, %lu session resets%s", cache->roa_count[AFI_IP], cache->roa_count[AFI_IP6], cache->transfers, cache->resets, VTY_NEWLINE);
+		vty_out(vty, "  Refresh %u, retry %u, expire %u seconds%s", cache->refresh, cache->retry, cache->expire, VTY_NEWLINE);
+	}
+	return CMD_SUCCESS;
+}
+
+DEFUN(show_bgp_rpki_roa, show_bgp_rpki_roa_cmd, "show bgp rpki roa",
+      SHOW_STR BGP_STR "RPKI-RTR caches\n"
+		       "Route origin authorisations\n") {
+	struct route_node *rn;
+	struct rpki_roa *roa;
+	char buf[SU_ADDRSTRLEN];
+	char pbuf[PREFIX_STRLEN];
+	afi_t afi;
+
+	vty_out(vty, "%-43s %-6s %-10s %s%s", "Prefix", "Maxlen", "Origin AS", "Cache", VTY_NEWLINE);
+	for(afi = AFI_IP; afi < AFI_MAX; afi++) {
+		for(rn = route_top(rpki_roas[afi]); rn; rn = route_next(rn)) {
+			for(roa = rn->info; roa; roa = roa->next) {
+				vty_out(vty, "%-43s %-6u %-10u %s%s", prefix2str(&rn->p, pbuf, sizeof(pbuf)), roa->maxlen, roa->asn, sockunion2str(&roa->cache->su, buf, sizeof(buf)), VTY_NEWLINE);
+			}
+		}
+	}
+	return CMD_SUCCESS;
+}
+
+int bgp_rpki_config_write(struct vty *vty, struct bgp *bgp) {
+	struct listnode *node;
+	struct rpki_cache *cache;
+	char buf[SU_ADDRSTRLEN];
+
+	if(bgp->name) {
+		return 0;
+	}
+
+	for(ALL_LIST_ELEMENTS_RO(rpki_caches, node, cache)) {
+		vty_out(vty, " rpki cache %s %u%s", sockunion2str(&cache->su, buf, sizeof(buf)), cache->port, VTY_NEWLINE);
+	}
+	return 0;
+}
+
+void bgp_rpki_init(void) {
+	afi_t afi;
+
+	rpki_caches = list_new();
+	for(afi = AFI_IP; afi < AFI_MAX; afi++) {
+		rpki_roas[afi] = route_table_init();
+		rpki_dirty[afi] = route_table_init();
+	}
+
+	install_element(BGP_NODE, &bgp_rpki_cache_cmd);
+	install_element(BGP_NODE, &no_bgp_rpki_cache_cmd);
+	install_element(VIEW_NODE, &show_bgp_rpki_cmd);
+	install_element(VIEW_NODE, &show_bgp_rpki_roa_cmd);
+}
+
+void bgp_rpki_finish(void) {
+	struct rpki_cache *cache;
+	afi_t afi;
+
+	/* the routes are going as well, there is nothing to revalidate */
+	while(listcount(rpki_caches)) {
+		cache = listgetdata(listhead(rpki_caches));
+		list_delete_node(rpki_caches, listhead(rpki_caches));
+		rpki_roa_flush(cache, 1);
+		rpki_cache_free(cache);
+	}
+	list_free(rpki_caches);
+
+	for(afi = AFI_IP; afi < AFI_MAX; afi++) {
+		route_table_finish(rpki_roas[afi]);
+		route_table_finish(rpki_dirty[afi]);
+	}
+}
@@ -0,0 +1,66 @@
+/* BGP prefix origin validation, with ROAs from RPKI-RTR caches (RFC 8210)
+ *
+ * This file is part of GNU Zebra.
+ *
+ * GNU Zebra is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2, or (at your option) any
+ * later version.
+ *
+ * GNU Zebra is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with GNU Zebra; see the file COPYING.  If not, write to the Free
+ * Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ * 02111-1307, USA.
+ */
+
+#ifndef _QUAGGA_BGP_RPKI_H
+#define _QUAGGA_BGP_RPKI_H
+
+/* PDU types */
+#define RPKI_PDU_SERIAL_NOTIFY 0
+#define RPKI_PDU_SERIAL_QUERY 1
+#define RPKI_PDU_RESET_QUERY 2
+#define RPKI_PDU_CACHE_RESPONSE 3
+#define RPKI_PDU_IPV4_PREFIX 4
+#define RPKI_PDU_IPV6_PREFIX 6
+#define RPKI_PDU_END_OF_DATA 7
+#define RPKI_PDU_CACHE_RESET 8
+#define RPKI_PDU_ROUTER_KEY 9
+#define RPKI_PDU_ERROR_REPORT 10
+
+/* Error codes */
+#define RPKI_ERR_CORRUPT_DATA 0
+#define RPKI_ERR_NO_DATA 2
+#define RPKI_ERR_UNSUPPORTED_VERSION 4
+
+#define RPKI_PREFIX_FLAG_ANNOUNCE 0x01
+
+/* Intervals (RFC 8210, 6) used until a cache sends its own */
+#define RPKI_REFRESH_DEFAULT 3600
+#define RPKI_RETRY_DEFAULT 600
+#define RPKI_EXPIRE_DEFAULT 7200
+
+/* Validation states, as "match rpki" knows them */
+enum bgp_rpki_state {
+	RPKI_NOTFOUND,
+	RPKI_VALID,
+	RPKI_INVALID,
+};
+
+/* The ROAs of all caches are kept in a prefix tree per address family,
+ * updated as a cache's transfers complete, and looked up in place from
+ * the inbound policy: bgpd's tables are only touched by its main thread.
+ * Once a transfer changed the ROAs, the routes covered by the prefixes of
+ * those ROAs, and these only, have their inbound policy run again. */
+extern enum bgp_rpki_state bgp_rpki_validate(struct prefix *, struct aspath *, as_t local);
+
+extern int bgp_rpki_config_write(struct vty *, struct bgp *);
+extern void bgp_rpki_init(void);
+extern void bgp_rpki_finish(void);
+
+#endif /* _QUAGGA_BGP_RPKI_H */
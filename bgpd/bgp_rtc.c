@@ -0,0 +1,270 @@
+/* BGP route target constrain (RFC 4684)
+ *
+ * This file is part of Quagga
+ *
+ * Quagga is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2, or (at your option) any
+ * later version.
+ *
+ * Quagga is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Quagga; see the file COPYING.  If not, write to the Free
+ * Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ * 02111-1307, USA.
+ */
+
+#include <zebra.h>
+
+#include "command.h"
+#include "prefix.h"
+#include "memory.h"
+#include "hash.h"
+#include "jhash.h"
+#include "thread.h"
+#include "log.h"
+#include "filter.h"
+
+#include "bgpd/bgpd.h"
+#include "bgpd/bgp_attr.h"
+#include "bgpd/bgp_route.h"
+#include "bgpd/bgp_ecommunity.h"
+#include "bgpd/bgp_debug.h"
+#include "bgpd/bgp_rtc.h"
+
+/* Origin AS and route target */
+#define BGP_RTC_NLRI_MAX 12
+
+/* An RT membership NLRI as received, bits past its length clear */
+struct bgp_rtc_member {
+	u_char len;
+	u_char val[BGP_RTC_NLRI_MAX];
+};
+
+/* How many full length memberships name a route target, from any
+ * origin AS */
+struct bgp_rtc_rt {
+	u_int64_t val;
+	unsigned long count;
+};
+
+struct bgp_rtc {
+	struct hash *members;
+	struct hash *rts;
+
+	/* Memberships shorter than a route target: the default one, or an
+	 * origin AS or route target prefix.  Any of them lets everything
+	 * through, which only ever sends the peer more than it asked for. */
+	unsigned long wildcard;
+
+	/* Pending reannouncement of the VPN tables after a change */
+	struct thread *t_announce;
+};
+
+static unsigned int bgp_rtc_member_key(void *p) {
+	struct bgp_rtc_member *member = p;
+
+	return jhash(member->val, BGP_RTC_NLRI_MAX, member->len);
+}
+
+static int bgp_rtc_member_cmp(const void *p1, const void *p2) {
+	const struct bgp_rtc_member *m1 = p1;
+	const struct bgp_rtc_member *m2 = p2;
+
+	return m1->len == m2->len && memcmp(m1->val, m2->val, BGP_RTC_NLRI_MAX) == 0;
+}
+
+static void *bgp_rtc_member_alloc(void *p) {
+	struct bgp_rtc_member *member;
+
+	member = XMALLOC(MTYPE_BGP_RTC_MEMBER, sizeof(struct bgp_rtc_member));
+	memcpy(member, p, sizeof(struct bgp_rtc_member));
+	return member;
+}
+
+static void bgp_rtc_entry_free(void *p) {
+	XFREE(MTYPE_BGP_RTC_MEMBER, p);
+}
+
+static unsigned int bgp_rtc_rt_key(void *p) {
+	struct bgp_rtc_rt *rt = p;
+
+	return jhash_2words(rt->val >> 32, rt->val, 0);
+}
+
+static int bgp_rtc_rt_cmp(const void *p1, const void *p2) {
+	const struct bgp_rtc_rt *rt1 = p1;
+	const struct bgp_rtc_rt *rt2 = p2;
+
+	return rt1->val == rt2->val;
+}
+
+static void *bgp_rtc_rt_alloc(void *p) {
+	struct bgp_rtc_rt *rt;
+
+	rt = XCALLOC(MTYPE_BGP_RTC_MEMBER, sizeof(struct bgp_rtc_rt));
+	rt->val = ((struct bgp_rtc_rt *) p)->val;
+	return rt;
+}
+
+static struct bgp_rtc *bgp_rtc_get(struct peer *peer) {
+	if(!peer->rtc) {
+		peer->rtc = XCALLOC(MTYPE_BGP_RTC, sizeof(struct bgp_rtc));
+		peer->rtc->members = hash_create(bgp_rtc_member_key, bgp_rtc_member_cmp);
+		peer->rtc->rts = hash_create(bgp_rtc_rt_key, bgp_rtc_rt_cmp);
+	}
+	return peer->rtc;
+}
+
+/* Forget the peer's memberships, as its session is gone */
+void bgp_rtc_reset(struct peer *peer) {
+	struct bgp_rtc *rtc = peer->rtc;
+
+	if(!rtc) {
+		return;
+	}
+	THREAD_OFF(rtc->t_announce);
+	hash_clean(rtc->members, bgp_rtc_entry_free);
+	hash_free(rtc->members);
+	hash_clean(rtc->rts, bgp_rtc_entry_free);
+	hash_free(rtc->rts);
+	XFREE(MTYPE_BGP_RTC, rtc);
+	peer->rtc = NULL;
+}
+
+unsigned long bgp_rtc_count(struct peer *peer) {
+	return peer->rtc ? peer->rtc->members->count : 0;
+}
+
+/* May a VPN route with these attributes go to the peer? */
+int bgp_rtc_permits(struct peer *peer, struct attr *attr) {
+	struct bgp_rtc *rtc = peer->rtc;
+	struct ecommunity *ecom;
+	struct bgp_rtc_rt key;
+	int i;
+
+	/* Nothing asked for yet, nothing sent */
+	if(!rtc) {
+		return 0;
+	}
+	if(rtc->wildcard) {
+		return 1;
+	}
+	if(!rtc->rts->count || !attr->extra || !(ecom = attr->extra->ecommunity)) {
+		return 0;
+	}
+
+	/* The attribute is interned, so its route targets are parsed out */
+	for(i = 0; i < ecom->rt_size; i++) {
+		key.val = ecom->rt[i];
+		if(hash_lookup(rtc->rts, &key)) {
+			return 1;
+		}
+	}
+	return 0;
+}
+
+static int bgp_rtc_announce(struct thread *t) {
+	struct peer *peer = THREAD_ARG(t);
+
+	peer->rtc->t_announce = NULL;
+
+	if(BGP_DEBUG(update, UPDATE_IN)) {
+		zlog_debug("%s RT memberships changed, %lu now, announcing VPN routes again", peer->host, peer->rtc->members->count);
+	}
+
+	/* bgp_announce_node() withdraws what is no longer permitted */
+	bgp_announce_route(peer, AFI_IP, SAFI_MPLS_VPN);
+	bgp_announce_route(peer, AFI_IP6, SAFI_MPLS_VPN);
+	return 0;
+}
+
+static int bgp_rtc_member_add(struct bgp_rtc *rtc, struct bgp_rtc_member *key) {
+	struct bgp_rtc_rt rtkey;
+	struct bgp_rtc_rt *rt;
+
+	if(hash_lookup(rtc->members, key)) {
+		return 0;
+	}
+	hash_get(rtc->members, key, bgp_rtc_member_alloc);
+
+	if(key->len < BGP_RTC_NLRI_MAX * 8) {
+		rtc->wildcard++;
+		return 1;
+	}
+	rtkey.val = ecommunity_val2u64(key->val + 4);
+	rt = hash_get(rtc->rts, &rtkey, bgp_rtc_rt_alloc);
+	rt->count++;
+	return 1;
+}
+
+static int bgp_rtc_member_del(struct bgp_rtc *rtc, struct bgp_rtc_member *key) {
+	struct bgp_rtc_member *member;
+	struct bgp_rtc_rt rtkey;
+	struct bgp_rtc_rt *rt;
+
+	if(!(member = hash_release(rtc->members, key))) {
+		return 0;
+	}
+	bgp_rtc_entry_free(member);
+
+	if(key->len < BGP_RTC_NLRI_MAX * 8) {
+		rtc->wildcard--;
+		return 1;
+	}
+	rtkey.val = ecommunity_val2u64(key->val + 4);
+	if((rt = hash_lookup(rtc->rts, &rtkey)) && --rt->count == 0) {
+		hash_release(rtc->rts, rt);
+		bgp_rtc_entry_free(rt);
+	}
+	return 1;
+}
+
+/* RT membership NLRI, announced with attr or withdrawn without */
+int bgp_nlri_parse_rtc(struct peer *peer, struct attr *attr, struct bgp_nlri *packet) {
+	u_char *pnt;
+	u_char *lim;
+	struct bgp_rtc *rtc;
+	struct bgp_rtc_member key;
+	int psize;
+	int changed = 0;
+
+	if(!BGP_RTC_NEGOTIATED(peer)) {
+		return 0;
+	}
+	rtc = bgp_rtc_get(peer);
+
+	pnt = packet->nlri;
+	lim = pnt + packet->length;
+
+	for(; pnt < lim; pnt += psize) {
+		memset(&key, 0, sizeof(struct bgp_rtc_member));
+		key.len = *pnt++;
+
+		/* Either the default, or at least the origin AS */
+		if(key.len > BGP_RTC_NLRI_MAX * 8 || (key.len > 0 && key.len < 32)) {
+			plog_err(peer->log, "%s [Error] Update packet error (wrong RT membership length %d)", peer->host, key.len);
+			return -1;
+		}
+		psize = PSIZE(key.len);
+		if(pnt + psize > lim) {
+			plog_err(peer->log, "%s [Error] Update packet error (RT membership length %d overflows packet)", peer->host, key.len);
+			return -1;
+		}
+		memcpy(key.val, pnt, psize);
+		if(key.len % 8) {
+			key.val[psize - 1] &= 0xff << (8 - key.len % 8);
+		}
+
+		changed |= attr ? bgp_rtc_member_add(rtc, &key) : bgp_rtc_member_del(rtc, &key);
+	}
+
+	if(changed && !rtc->t_announce) {
+		rtc->t_announce = thread_add_event(bm->master, bgp_rtc_announce, peer, 0);
+	}
+	return 0;
+}
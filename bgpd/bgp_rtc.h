@@ -0,0 +1,46 @@
+/* BGP route target constrain (RFC 4684)
+ *
+ * This file is part of Quagga
+ *
+ * Quagga is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2, or (at your option) any
+ * later version.
+ *
+ * Quagga is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Quagga; see the file COPYING.  If not, write to the Free
+ * Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ * 02111-1307, USA.
+ */
+
+#ifndef _QUAGGA_BGP_RTC_H
+#define _QUAGGA_BGP_RTC_H
+
+/* A peer with "neighbor route-target-constrain" in its VPNv4 address
+ * family advertises the IPv4 RT membership AFI/SAFI, and once the other
+ * side does too, sends it only those VPN routes carrying a route target
+ * the peer has asked for with an RT membership NLRI.  The memberships
+ * live outside the RIB, in a hash of route targets per peer, so there is
+ * no table, and no index in the afi/safi arrays, for this SAFI: its
+ * capability bits sit with VPNv4's.
+ *
+ * Having no VRFs to import into, we ourselves ask for every route target,
+ * as a route reflector would, with the default membership.
+ */
+
+/* RT membership NLRI, on the wire only */
+#define SAFI_RT_CONSTRAIN 132
+
+#define BGP_RTC_NEGOTIATED(P) (CHECK_FLAG((P)->af_cap[AFI_IP][SAFI_MPLS_VPN], PEER_CAP_RTC_ADV | PEER_CAP_RTC_RCV) == (PEER_CAP_RTC_ADV | PEER_CAP_RTC_RCV))
+
+extern int bgp_nlri_parse_rtc(struct peer *, struct attr *, struct bgp_nlri *);
+extern int bgp_rtc_permits(struct peer *, struct attr *);
+extern unsigned long bgp_rtc_count(struct peer *);
+extern void bgp_rtc_reset(struct peer *);
+
+#endif /* _QUAGGA_BGP_RTC_H */
@@ -0,0 +1,905 @@
+/* BGP Adj-RIB-In snapshot, for warm restarts
+ *
+ * This file is part of GNU Zebra.
+ *
+ * GNU Zebra is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2, or (at your option) any
+ * later version.
+ *
+ * GNU Zebra is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with GNU Zebra; see the file COPYING.  If not, write to the Free
+ * Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ * 02111-1307, USA.
+ */
+
+#include <zebra.h>
+#include <sys/mman.h>
+
+#include "log.h"
+#include "stream.h"
+#include "sockunion.h"
+#include "command.h"
+#include "prefix.h"
+#include "thread.h"
+#include "linklist.h"
+#include "memory.h"
+#include "hash.h"
+#include "jhash.h"
+#include "workpool.h"
+#include "filter.h"
+
+#include "bgpd/bgpd.h"
+#include "bgpd/bgp_table.h"
+#include "bgpd/bgp_route.h"
+#include "bgpd/bgp_attr.h"
+#include "bgpd/bgp_advertise.h"
+#include "bgpd/bgp_arena.h"
+#include "bgpd/bgp_debug.h"
+#include "bgpd/bgp_fsm.h"
+#include "bgpd/bgp_snapshot.h"
+
+/* Size of the chunks a snapshot is written out in, and the most route
+ * nodes it encodes before yielding to other work, as for RIB dumps. */
+#define BGP_SNAPSHOT_CHUNK_SIZE (256 * 1024)
+#define BGP_SNAPSHOT_BATCH 1000
+
+/* The tables snapshotted, in this order */
+static const struct bgp_snapshot_table {
+	afi_t afi;
+	safi_t safi;
+} bgp_snapshot_tables[] = {
+	{ AFI_IP,  SAFI_UNICAST	  },
+	{ AFI_IP,  SAFI_MULTICAST },
+	{ AFI_IP6, SAFI_UNICAST	  },
+	{ AFI_IP6, SAFI_MULTICAST },
+};
+
+/* The file being written.  Once the walk has handed it over, only the
+ * writer touches it, until the 'done' of the last chunk frees it. */
+struct bgp_snapshot_file {
+	int fd;
+	int error; /* errno of what failed first */
+	char *path;
+	char *tmp;
+	u_int32_t paths;
+};
+
+struct bgp_snapshot_chunk {
+	struct bgp_snapshot_file *file;
+	size_t len;
+	int last; /* 1: rename the file over the last snapshot, -1: drop it */
+	u_char data[BGP_SNAPSHOT_CHUNK_SIZE];
+};
+
+/* An attribute written out, holding a reference so that it can't be
+ * freed and another take its address while the walk is paused. */
+struct bgp_snapshot_attr {
+	struct attr *attr;
+	u_int32_t index;
+};
+
+/* A snapshot in progress */
+struct bgp_snapshot_walk {
+	struct bgp *bgp;
+	unsigned int table;
+	bgp_table_iter_t iter;
+	struct hash *attrs;
+	u_int32_t nattrs;
+	u_int32_t paths;
+	struct bgp_snapshot_file *file;
+	struct bgp_snapshot_chunk *chunk;
+	struct thread *t_walk;
+};
+
+static char *snapshot_path;
+static unsigned int snapshot_interval;
+static struct thread *t_snapshot;
+static struct bgp_snapshot_walk *snapshot_walk;
+
+/* Whether reading the snapshot back was tried, once in bgpd's life */
+static int snapshot_loaded;
+
+/* A record of the walk, and an attribute record it writes ahead of it */
+static struct stream *snapshot_obuf;
+static struct stream *snapshot_abuf;
+
+/* Writes out snapshots, a single worker so chunks land in order */
+static struct work_pool *snapshot_writer;
+
+static int bgp_snapshot_timer(struct thread *);
+
+static void bgp_snapshot_fullpath(char *buf, size_t size, const char *suffix) {
+	if(snapshot_path[0] != DIRECTORY_SEP) {
+		snprintf(buf, size, "%s/%s%s", vty_get_cwd(), snapshot_path, suffix);
+	} else {
+		snprintf(buf, size, "%s%s", snapshot_path, suffix);
+	}
+}
+
+/*------------------------------------------------------------------------*
+ * Writing it.
+ *------------------------------------------------------------------------*/
+
+static size_t bgp_snapshot_record_start(struct stream *s, u_char type) {
+	size_t lenp;
+
+	stream_putc(s, type);
+	lenp = stream_get_endp(s);
+	stream_putl(s, 0);
+	return lenp;
+}
+
+static void bgp_snapshot_record_end(struct stream *s, size_t lenp) {
+	stream_putl_at(s, lenp, stream_get_endp(s) - lenp - 4);
+}
+
+static struct bgp_snapshot_chunk *bgp_snapshot_chunk_new(struct bgp_snapshot_file *file) {
+	struct bgp_snapshot_chunk *chunk;
+
+	chunk = XMALLOC(MTYPE_BGP_SNAPSHOT, sizeof(struct bgp_snapshot_chunk));
+	chunk->file = file;
+	chunk->len = 0;
+	chunk->last = 0;
+	return chunk;
+}
+
+/* On the writer: errors are only noted, for the 'done' of the last chunk
+ * to log.  The previous snapshot stays until this one is all on disk. */
+static void bgp_snapshot_chunk_write(void *arg) {
+	struct bgp_snapshot_chunk *chunk = arg;
+	struct bgp_snapshot_file *file = chunk->file;
+	size_t done = 0;
+	ssize_t n;
+
+	while(!file->error && done < chunk->len) {
+		n = write(file->fd, chunk->data + done, chunk->len - done);
+		if(n < 0) {
+			if(errno != EINTR) {
+				file->error = errno;
+			}
+			continue;
+		}
+		done += n;
+	}
+
+	if(chunk->last) {
+		if(chunk->last > 0 && !file->error && fsync(file->fd) < 0) {
+			file->error = errno;
+		}
+		close(file->fd);
+		if(chunk->last > 0 && !file->error && rename(file->tmp, file->path) < 0) {
+			file->error = errno;
+		}
+		if(chunk->last < 0 || file->error) {
+			unlink(file->tmp);
+		}
+	}
+}
+
+static void bgp_snapshot_chunk_done(void *arg) {
+	struct bgp_snapshot_chunk *chunk = arg;
+	struct bgp_snapshot_file *file = chunk->file;
+
+	if(chunk->last) {
+		if(file->error) {
+			zlog_warn("BGP snapshot %s: %s", file->tmp, safe_strerror(file->error));
+		} else if(chunk->last > 0 && BGP_DEBUG(events, EVENTS)) {
+			zlog_debug("BGP snapshot of %u paths written to %s", file->paths, file->path);
+		}
+		XFREE(MTYPE_BGP_SNAPSHOT, file->path);
+		XFREE(MTYPE_BGP_SNAPSHOT, file->tmp);
+		XFREE(MTYPE_BGP_SNAPSHOT, file);
+	}
+	XFREE(MTYPE_BGP_SNAPSHOT, chunk);
+}
+
+/* Copy the record in s to the walk's chunk, handing the chunk to the
+ * writer when it is full. */
+static void bgp_snapshot_put(struct bgp_snapshot_walk *walk, struct stream *s) {
+	size_t len = stream_get_endp(s);
+
+	if(walk->chunk->len + len > BGP_SNAPSHOT_CHUNK_SIZE) {
+		work_pool_submit(snapshot_writer, bgp_snapshot_chunk_write, bgp_snapshot_chunk_done, walk->chunk);
+		walk->chunk = bgp_snapshot_chunk_new(walk->file);
+	}
+	memcpy(walk->chunk->data + walk->chunk->len, STREAM_DATA(s), len);
+	walk->chunk->len += len;
+}
+
+static unsigned int bgp_snapshot_attr_key(void *p) {
+	struct bgp_snapshot_attr *sa = p;
+
+	return jhash_1word((uintptr_t) sa->attr, 0);
+}
+
+static int bgp_snapshot_attr_cmp(const void *a, const void *b) {
+	const struct bgp_snapshot_attr *sa = a, *sb = b;
+
+	return sa->attr == sb->attr;
+}
+
+static void bgp_snapshot_attr_free(void *p) {
+	struct bgp_snapshot_attr *sa = p;
+
+	bgp_attr_unintern(&sa->attr);
+	XFREE(MTYPE_BGP_SNAPSHOT, sa);
+}
+
+/* The index of attr in the snapshot, written out first if it's new, -1
+ * if it can't be */
+static int64_t bgp_snapshot_attr_index(struct bgp_snapshot_walk *walk, struct attr *attr) {
+	struct bgp_snapshot_attr key, *sa;
+	struct stream *s = snapshot_abuf;
+	size_t lenp;
+
+	key.attr = attr;
+	if((sa = hash_lookup(walk->attrs, &key)) != NULL) {
+		return sa->index;
+	}
+
+	stream_reset(s);
+	lenp = bgp_snapshot_record_start(s, BGP_SNAPSHOT_ATTR);
+	stream_putl(s, walk->nattrs);
+	if(bgp_attr_snapshot_put(s, attr) < 0) {
+		return -1;
+	}
+	bgp_snapshot_record_end(s, lenp);
+	bgp_snapshot_put(walk, s);
+
+	sa = XMALLOC(MTYPE_BGP_SNAPSHOT, sizeof(struct bgp_snapshot_attr));
+	sa->attr = bgp_attr_intern(attr);
+	sa->index = walk->nattrs++;
+	hash_get(walk->attrs, sa, hash_alloc_intern);
+	return sa->index;
+}
+
+/* Add a path to the record of rn in the making, started if *lenp is 0,
+ * or written out and started anew when full. */
+static void bgp_snapshot_path(struct bgp_snapshot_walk *walk, struct bgp_node *rn, struct peer *peer, u_int32_t addpath_id, struct attr *attr, size_t *lenp) {
+	struct stream *s = snapshot_obuf;
+	int64_t index;
+
+	if(!peer->snapshot_index || (index = bgp_snapshot_attr_index(walk, attr)) < 0) {
+		return;
+	}
+
+	if(*lenp && STREAM_WRITEABLE(s) < BGP_SNAPSHOT_PATH_SIZE) {
+		bgp_snapshot_record_end(s, *lenp);
+		bgp_snapshot_put(walk, s);
+		*lenp = 0;
+	}
+	if(!*lenp) {
+		stream_reset(s);
+		*lenp = bgp_snapshot_record_start(s, BGP_SNAPSHOT_ROUTE);
+		stream_putc(s, rn->p.prefixlen);
+		stream_put(s, &rn->p.u.prefix, PSIZE(rn->p.prefixlen));
+	}
+
+	stream_putw(s, peer->snapshot_index);
+	stream_putl(s, addpath_id);
+	stream_putl(s, index);
+	walk->paths++;
+}
+
+/* The Adj-RIB-In entries of rn: the paths standing in for one, and those
+ * apart from the paths */
+static void bgp_snapshot_node(struct bgp_snapshot_walk *walk, struct bgp_node *rn) {
+	struct bgp_info *ri;
+	struct bgp_adj_in *ain;
+	size_t lenp = 0;
+
+	for(ri = rn->info; ri; ri = ri->next) {
+		if(CHECK_FLAG(ri->flags, BGP_INFO_ADJ_IN) && !CHECK_FLAG(ri->flags, BGP_INFO_REMOVED)) {
+			bgp_snapshot_path(walk, rn, ri->peer, ri->addpath_rx_id, ri->attr, &lenp);
+		}
+	}
+	for(ain = rn->adj_in; ain; ain = ain->next) {
+		bgp_snapshot_path(walk, rn, ain->peer, ain->addpath_rx_id, ain->attr, &lenp);
+	}
+
+	if(lenp) {
+		bgp_snapshot_record_end(snapshot_obuf, lenp);
+		bgp_snapshot_put(walk, snapshot_obuf);
+	}
+}
+
+/* Hand what is left to the writer, which puts the file in place if it
+ * is complete, and drops it if not */
+static void bgp_snapshot_walk_finish(int complete) {
+	struct bgp_snapshot_walk *walk = snapshot_walk;
+	struct stream *s = snapshot_obuf;
+	size_t lenp;
+
+	if(walk->t_walk) {
+		thread_cancel(walk->t_walk);
+		walk->t_walk = NULL;
+	}
+	if(walk->iter.table) {
+		bgp_table_iter_cleanup(&walk->iter);
+	}
+
+	if(complete) {
+		stream_reset(s);
+		lenp = bgp_snapshot_record_start(s, BGP_SNAPSHOT_END);
+		stream_putl(s, walk->paths);
+		bgp_snapshot_record_end(s, lenp);
+		bgp_snapshot_put(walk, s);
+	}
+	walk->file->paths = walk->paths;
+	walk->chunk->last = complete ? 1 : -1;
+	work_pool_submit(snapshot_writer, bgp_snapshot_chunk_write, bgp_snapshot_chunk_done, walk->chunk);
+
+	hash_clean(walk->attrs, bgp_snapshot_attr_free);
+	hash_free(walk->attrs);
+	bgp_unlock(walk->bgp);
+	XFREE(MTYPE_BGP_SNAPSHOT, walk);
+	snapshot_walk = NULL;
+}
+
+/* Encode up to BGP_SNAPSHOT_BATCH nodes, then pause the iterator so that
+ * the tables may change before the walk goes on. */
+static int bgp_snapshot_walk_func(struct thread *t) {
+	struct bgp_snapshot_walk *walk = snapshot_walk;
+	const struct bgp_snapshot_table *table;
+	struct stream *s = snapshot_obuf;
+	struct bgp_node *rn;
+	size_t lenp;
+	int count = 0;
+
+	walk->t_walk = NULL;
+
+	while(count < BGP_SNAPSHOT_BATCH) {
+		if(!walk->iter.table) {
+			if(walk->table == array_size(bgp_snapshot_tables)) {
+				bgp_snapshot_walk_finish(1);
+				return 0;
+			}
+			table = &bgp_snapshot_tables[walk->table];
+			bgp_table_iter_init(&walk->iter, walk->bgp->rib[table->afi][table->safi]);
+
+			stream_reset(s);
+			lenp = bgp_snapshot_record_start(s, BGP_SNAPSHOT_TABLE);
+			stream_putw(s, table->afi);
+			stream_putc(s, table->safi);
+			bgp_snapshot_record_end(s, lenp);
+			bgp_snapshot_put(walk, s);
+		}
+
+		rn = bgp_table_iter_next(&walk->iter);
+		if(rn == NULL) {
+			bgp_table_iter_cleanup(&walk->iter);
+			walk->table++;
+			continue;
+		}
+
+		if(rn->info || rn->adj_in) {
+			bgp_snapshot_node(walk, rn);
+		}
+		count++;
+	}
+
+	bgp_table_iter_pause(&walk->iter);
+	walk->t_walk = thread_add_background(bm->master, bgp_snapshot_walk_func, NULL, 0);
+	return 0;
+}
+
+/* The header, and the peers the paths are of by index.  Peers that come
+ * up during the walk have no index, and are left out. */
+static void bgp_snapshot_header(struct bgp_snapshot_walk *walk) {
+	struct bgp *bgp = walk->bgp;
+	struct stream *s = snapshot_obuf;
+	struct listnode *node;
+	struct peer *peer;
+	u_int16_t index = 0;
+	size_t lenp;
+
+	stream_reset(s);
+	stream_putl(s, BGP_SNAPSHOT_MAGIC);
+	stream_putw(s, BGP_SNAPSHOT_VERSION);
+	stream_putw(s, 0);
+	stream_putl(s, time(NULL));
+	stream_putl(s, bgp->as);
+	stream_put_in_addr(s, &bgp->router_id);
+	bgp_snapshot_put(walk, s);
+
+	for(ALL_LIST_ELEMENTS_RO(bgp->peer, node, peer)) {
+		peer->snapshot_index = 0;
+		if(index == UINT16_MAX || (sockunion_family(&peer->su) != AF_INET && sockunion_family(&peer->su) != AF_INET6)) {
+			continue;
+		}
+		peer->snapshot_index = ++index;
+
+		stream_reset(s);
+		lenp = bgp_snapshot_record_start(s, BGP_SNAPSHOT_PEER);
+		stream_putw(s, index);
+		if(sockunion_family(&peer->su) == AF_INET) {
+			stream_putc(s, AFI_IP);
+			stream_put_in_addr(s, &peer->su.sin.sin_addr);
+		} else {
+			stream_putc(s, AFI_IP6);
+			stream_put(s, &peer->su.sin6.sin6_addr, IPV6_MAX_BYTELEN);
+		}
+		bgp_snapshot_record_end(s, lenp);
+		bgp_snapshot_put(walk, s);
+	}
+}
+
+static void bgp_snapshot_start(struct bgp *bgp) {
+	struct bgp_snapshot_walk *walk;
+	struct bgp_snapshot_file *file;
+	char path[MAXPATHLEN];
+	int fd;
+
+	bgp_snapshot_fullpath(path, sizeof(path), ".tmp");
+	fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, LOGFILE_MASK);
+	if(fd < 0) {
+		zlog_warn("BGP snapshot %s: %s", path, safe_strerror(errno));
+		return;
+	}
+
+	/* Not done at bgp_snapshot_init() time, as the worker wouldn't
+	 * survive daemonizing. */
+	if(!snapshot_writer) {
+		snapshot_writer = work_pool_new(bm->master, "BGP snapshot writer", 1);
+	}
+
+	file = XCALLOC(MTYPE_BGP_SNAPSHOT, sizeof(struct bgp_snapshot_file));
+	file->fd = fd;
+	file->tmp = XSTRDUP(MTYPE_BGP_SNAPSHOT, path);
+	bgp_snapshot_fullpath(path, sizeof(path), "");
+	file->path = XSTRDUP(MTYPE_BGP_SNAPSHOT, path);
+
+	walk = XCALLOC(MTYPE_BGP_SNAPSHOT, sizeof(struct bgp_snapshot_walk));
+	walk->bgp = bgp;
+	bgp_lock(bgp);
+	walk->attrs = hash_create_open(bgp_snapshot_attr_key, bgp_snapshot_attr_cmp);
+	walk->file = file;
+	walk->chunk = bgp_snapshot_chunk_new(file);
+	snapshot_walk = walk;
+
+	bgp_snapshot_header(walk);
+	walk->t_walk = thread_add_background(bm->master, bgp_snapshot_walk_func, NULL, 0);
+}
+
+/* Whether paths read back from the last snapshot still wait for their
+ * peers: taking one now would leave them out. */
+static int bgp_snapshot_held(struct bgp *bgp) {
+	struct listnode *node;
+	struct peer *peer;
+
+	for(ALL_LIST_ELEMENTS_RO(bgp->peer, node, peer)) {
+		if(CHECK_FLAG(peer->sflags, PEER_STATUS_SNAPSHOT)) {
+			return 1;
+		}
+	}
+	return 0;
+}
+
+static int bgp_snapshot_timer(struct thread *t) {
+	struct bgp *bgp = bgp_get_default();
+
+	t_snapshot = NULL;
+
+	if(snapshot_walk) {
+		zlog_warn("BGP snapshot: previous one still being written, skipping this one");
+	} else if(bgp && !bgp_snapshot_held(bgp)) {
+		bgp_snapshot_start(bgp);
+	}
+
+	t_snapshot = thread_add_timer(bm->master, bgp_snapshot_timer, NULL, snapshot_interval);
+	return 0;
+}
+
+/*------------------------------------------------------------------------*
+ * Reading it back.
+ *------------------------------------------------------------------------*/
+
+static u_int16_t bgp_snapshot_getw(const u_char *p) {
+	u_int16_t v;
+
+	memcpy(&v, p, sizeof(v));
+	return ntohs(v);
+}
+
+static u_int32_t bgp_snapshot_getl(const u_char *p) {
+	u_int32_t v;
+
+	memcpy(&v, p, sizeof(v));
+	return ntohl(v);
+}
+
+/* What a snapshot being read back refers to by index */
+struct bgp_snapshot_load {
+	struct bgp *bgp;
+	struct peer *peers[UINT16_MAX + 1];
+	struct attr **attrs;
+	u_int32_t nattrs;
+	u_int32_t size;
+	struct stream *s;
+	const struct bgp_snapshot_table *table;
+	int tables; /* bitmap of bgp_snapshot_tables read */
+	u_int32_t paths;
+};
+
+/* The configured peer the snapshot had at an index.  Peers of a session
+ * already up are left alone. */
+static int bgp_snapshot_load_peer(struct bgp_snapshot_load *load, const u_char *p, u_int32_t len) {
+	union sockunion su;
+	struct peer *peer;
+	u_int16_t index;
+
+	if(len < 3) {
+		return -1;
+	}
+	index = bgp_snapshot_getw(p);
+	memset(&su, 0, sizeof(union sockunion));
+	if(p[2] == AFI_IP && len == 7) {
+		su.sin.sin_family = AF_INET;
+		memcpy(&su.sin.sin_addr, p + 3, 4);
+	} else if(p[2] == AFI_IP6 && len == 19) {
+		su.sin6.sin6_family = AF_INET6;
+		memcpy(&su.sin6.sin6_addr, p + 3, IPV6_MAX_BYTELEN);
+	} else {
+		return -1;
+	}
+
+	peer = peer_lookup(load->bgp, &su);
+	if(peer && peer->status != Established) {
+		load->peers[index] = peer;
+	}
+	return 0;
+}
+
+static int bgp_snapshot_load_attr(struct bgp_snapshot_load *load, const u_char *p, u_int32_t len) {
+	struct attr *attr;
+
+	if(len < 4 || len - 4 > stream_get_size(load->s) || bgp_snapshot_getl(p) != load->nattrs) {
+		return -1;
+	}
+
+	stream_reset(load->s);
+	stream_put(load->s, p + 4, len - 4);
+	attr = bgp_attr_snapshot_get(load->s);
+	bgp_arena_reset();
+	if(!attr) {
+		return -1;
+	}
+
+	if(load->nattrs == load->size) {
+		load->size = load->size ? load->size * 2 : 1024;
+		load->attrs = XREALLOC(MTYPE_BGP_SNAPSHOT, load->attrs, load->size * sizeof(struct attr *));
+	}
+	load->attrs[load->nattrs++] = attr;
+	return 0;
+}
+
+static int bgp_snapshot_load_table(struct bgp_snapshot_load *load, const u_char *p, u_int32_t len) {
+	unsigned int i;
+
+	if(len != 3) {
+		return -1;
+	}
+	for(i = 0; i < array_size(bgp_snapshot_tables); i++) {
+		if(bgp_snapshot_tables[i].afi == bgp_snapshot_getw(p) && bgp_snapshot_tables[i].safi == p[2]) {
+			load->table = &bgp_snapshot_tables[i];
+			return 0;
+		}
+	}
+	return -1;
+}
+
+/* The paths of a prefix, through inbound policy and on to selection as
+ * if their peers had just sent them, their peers then waiting for the
+ * sessions to come back as after a graceful restart. */
+static int bgp_snapshot_load_route(struct bgp_snapshot_load *load, const u_char *p, u_int32_t len) {
+	struct prefix prefix;
+	struct peer *peer;
+	afi_t afi;
+	safi_t safi;
+	u_int32_t attr_index;
+	size_t psize;
+
+	if(!load->table || len < 1) {
+		return -1;
+	}
+	afi = load->table->afi;
+	safi = load->table->safi;
+
+	memset(&prefix, 0, sizeof(struct prefix));
+	prefix.family = afi2family(afi);
+	prefix.prefixlen = p[0];
+	psize = PSIZE(prefix.prefixlen);
+	if(prefix.prefixlen > prefix_blen(&prefix) * 8 || len < 1 + psize || (len - 1 - psize) % BGP_SNAPSHOT_PATH_SIZE) {
+		return -1;
+	}
+	memcpy(&prefix.u.prefix, p + 1, psize);
+	apply_mask(&prefix);
+
+	for(p += 1 + psize, len -= 1 + psize; len; p += BGP_SNAPSHOT_PATH_SIZE, len -= BGP_SNAPSHOT_PATH_SIZE) {
+		attr_index = bgp_snapshot_getl(p + 6);
+		if(attr_index >= load->nattrs) {
+			return -1;
+		}
+
+		peer = load->peers[bgp_snapshot_getw(p)];
+		if(!peer || !peer->afc[afi][safi]) {
+			continue;
+		}
+		if(!CHECK_FLAG(peer->sflags, PEER_STATUS_SNAPSHOT)) {
+			bgp_graceful_restart_hold(peer);
+		}
+		peer->nsf[afi][safi] = 1;
+
+		bgp_update(peer, &prefix, bgp_snapshot_getl(p + 2), load->attrs[attr_index], afi, safi, ZEBRA_ROUTE_BGP, BGP_ROUTE_NORMAL, NULL, NULL, 0);
+		load->tables |= 1 << (load->table - bgp_snapshot_tables);
+		load->paths++;
+	}
+	return 0;
+}
+
+/* Leave the paths read back as a peer's are once it went down under
+ * graceful restart: stale, of an epoch before the paths it will send,
+ * out of the Adj-RIB-In. */
+static void bgp_snapshot_load_stale(struct bgp_snapshot_load *load) {
+	struct bgp *bgp = load->bgp;
+	const struct bgp_snapshot_table *table;
+	struct bgp_node *rn;
+	struct bgp_info *ri;
+	struct bgp_adj_in *ain, *ain_next;
+	struct listnode *node;
+	struct peer *peer;
+	unsigned int i;
+
+	for(i = 0; i < array_size(bgp_snapshot_tables); i++) {
+		if(!(load->tables & (1 << i))) {
+			continue;
+		}
+		table = &bgp_snapshot_tables[i];
+
+		for(rn = bgp_table_top(bgp->rib[table->afi][table->safi]); rn; rn = bgp_route_next(rn)) {
+			for(ri = rn->info; ri; ri = ri->next) {
+				if(ri->peer != bgp->peer_self && CHECK_FLAG(ri->peer->sflags, PEER_STATUS_SNAPSHOT)) {
+					UNSET_FLAG(ri->flags, BGP_INFO_ADJ_IN);
+					bgp_info_set_flag(rn, ri, BGP_INFO_STALE);
+				}
+			}
+			for(ain = rn->adj_in; ain; ain = ain_next) {
+				ain_next = ain->next;
+				if(CHECK_FLAG(ain->peer->sflags, PEER_STATUS_SNAPSHOT)) {
+					bgp_adj_in_remove(rn, ain);
+					bgp_unlock_node(rn);
+				}
+			}
+		}
+
+		for(ALL_LIST_ELEMENTS_RO(bgp->peer, node, peer)) {
+			if(CHECK_FLAG(peer->sflags, PEER_STATUS_SNAPSHOT) && peer->nsf[table->afi][table->safi]) {
+				peer->epoch[table->afi][table->safi]++;
+			}
+		}
+	}
+}
+
+static void bgp_snapshot_load(struct bgp *bgp) {
+	struct bgp_snapshot_load *load;
+	char path[MAXPATHLEN];
+	struct stat st;
+	u_char *map, *p, *end;
+	u_int32_t len, i;
+	time_t written;
+	int fd, ret = 0;
+
+	bgp_snapshot_fullpath(path, sizeof(path), "");
+	fd = open(path, O_RDONLY);
+	if(fd < 0) {
+		if(errno != ENOENT) {
+			zlog_warn("BGP snapshot %s: %s", path, safe_strerror(errno));
+		}
+		return;
+	}
+	if(fstat(fd, &st) < 0 || st.st_size < BGP_SNAPSHOT_HEADER_SIZE) {
+		zlog_warn("BGP snapshot %s: too short", path);
+		close(fd);
+		return;
+	}
+	map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if(map == MAP_FAILED) {
+		zlog_warn("BGP snapshot %s: mmap: %s", path, safe_strerror(errno));
+		return;
+	}
+#ifdef MADV_SEQUENTIAL
+	madvise(map, st.st_size, MADV_SEQUENTIAL);
+#endif /* MADV_SEQUENTIAL */
+	end = map + st.st_size;
+
+	if(bgp_snapshot_getl(map) != BGP_SNAPSHOT_MAGIC || bgp_snapshot_getw(map + 4) != BGP_SNAPSHOT_VERSION) {
+		zlog_warn("BGP snapshot %s: not a snapshot of this version", path);
+		goto out;
+	}
+	written = bgp_snapshot_getl(map + 8);
+	if(bgp_snapshot_getl(map + 12) != bgp->as) {
+		zlog_warn("BGP snapshot %s: of AS %u, not ours", path, bgp_snapshot_getl(map + 12));
+		goto out;
+	}
+
+	/* All the records must be there, down to the end one, before any is
+	 * taken in: one written only in part was never renamed into place. */
+	for(p = map + BGP_SNAPSHOT_HEADER_SIZE;; p += BGP_SNAPSHOT_RECORD_HEADER_SIZE + len) {
+		if(end - p < BGP_SNAPSHOT_RECORD_HEADER_SIZE || (len = bgp_snapshot_getl(p + 1)) > (size_t)(end - p - BGP_SNAPSHOT_RECORD_HEADER_SIZE)) {
+			zlog_warn("BGP snapshot %s: truncated", path);
+			goto out;
+		}
+		if(p[0] == BGP_SNAPSHOT_END) {
+			break;
+		}
+	}
+
+	load = XCALLOC(MTYPE_BGP_SNAPSHOT, sizeof(struct bgp_snapshot_load));
+	load->bgp = bgp;
+	load->s = stream_new(BGP_EXTENDED_MESSAGE_MAX_PACKET_SIZE + 128);
+
+	for(p = map + BGP_SNAPSHOT_HEADER_SIZE; p[0] != BGP_SNAPSHOT_END && ret == 0; p += BGP_SNAPSHOT_RECORD_HEADER_SIZE + len) {
+		len = bgp_snapshot_getl(p + 1);
+		switch(p[0]) {
+			case BGP_SNAPSHOT_PEER: ret = bgp_snapshot_load_peer(load, p + BGP_SNAPSHOT_RECORD_HEADER_SIZE, len); break;
+			case BGP_SNAPSHOT_ATTR: ret = bgp_snapshot_load_attr(load, p + BGP_SNAPSHOT_RECORD_HEADER_SIZE, len); break;
+			case BGP_SNAPSHOT_TABLE: ret = bgp_snapshot_load_table(load, p + BGP_SNAPSHOT_RECORD_HEADER_SIZE, len); break;
+			case BGP_SNAPSHOT_ROUTE: ret = bgp_snapshot_load_route(load, p + BGP_SNAPSHOT_RECORD_HEADER_SIZE, len); break;
+			default: break;
+		}
+	}
+	if(ret < 0) {
+		zlog_warn("BGP snapshot %s: malformed record at offset %lu, the rest is ignored", path, (unsigned long) (p - map - BGP_SNAPSHOT_RECORD_HEADER_SIZE - len));
+	}
+
+	bgp_snapshot_load_stale(load);
+	zlog_info("BGP snapshot %s: %u paths read back, taken %ld seconds ago", path, load->paths, (long) (time(NULL) - written));
+
+	for(i = 0; i < load->nattrs; i++) {
+		bgp_attr_unintern(&load->attrs[i]);
+	}
+	if(load->attrs) {
+		XFREE(MTYPE_BGP_SNAPSHOT, load->attrs);
+	}
+	stream_free(load->s);
+	XFREE(MTYPE_BGP_SNAPSHOT, load);
+
+out:
+	munmap(map, st.st_size);
+}
+
+/* Once the startup configuration is all read, the peers with it */
+static int bgp_snapshot_load_event(struct thread *t) {
+	struct bgp *bgp = bgp_get_default();
+
+	if(bgp && snapshot_path && bgp_flag_check(bgp, BGP_FLAG_GRACEFUL_RESTART)) {
+		bgp_snapshot_load(bgp);
+	}
+	return 0;
+}
+
+/*------------------------------------------------------------------------*
+ * Configuration.
+ *------------------------------------------------------------------------*/
+
+static void bgp_snapshot_unset(void) {
+	if(snapshot_walk) {
+		bgp_snapshot_walk_finish(0);
+	}
+	THREAD_OFF(t_snapshot);
+	if(snapshot_path) {
+		XFREE(MTYPE_BGP_SNAPSHOT, snapshot_path);
+		snapshot_path = NULL;
+	}
+}
+
+DEFUN(bgp_snapshot, bgp_snapshot_cmd, "bgp graceful-restart snapshot PATH",
+      "BGP specific commands\n"
+      "Graceful restart capability parameters\n"
+      "Keep a snapshot of the Adj-RIB-In, read back at startup\n"
+      "Snapshot file\n") {
+	struct bgp *bgp = vty->index;
+	unsigned int interval = BGP_SNAPSHOT_INTERVAL_DEFAULT;
+
+	if(bgp->name) {
+		vty_out(vty, "%% Only the default instance is snapshotted%s", VTY_NEWLINE);
+		return CMD_WARNING;
+	}
+	if(argc > 1) {
+		VTY_GET_INTEGER_RANGE("interval", interval, argv[1], 10, 86400);
+	}
+
+	if(snapshot_path && strcmp(snapshot_path, argv[0]) == 0 && snapshot_interval == interval) {
+		return CMD_SUCCESS;
+	}
+	bgp_snapshot_unset();
+	snapshot_path = XSTRDUP(MTYPE_BGP_SNAPSHOT, argv[0]);
+	snapshot_interval = interval;
+	t_snapshot = thread_add_timer(bm->master, bgp_snapshot_timer, NULL, interval);
+
+	/* Read back once, at startup, before any session comes up */
+	if(!snapshot_loaded && bgp->t_startup) {
+		thread_add_event(bm->master, bgp_snapshot_load_event, NULL, 0);
+	}
+	snapshot_loaded = 1;
+	return CMD_SUCCESS;
+}
+
+ALIAS(bgp_snapshot, bgp_snapshot_interval_cmd, "bgp graceful-restart snapshot PATH interval <10-86400>",
+      "BGP specific commands\n"
+      "Graceful restart capability parameters\n"
+      "Keep a snapshot of the Adj-RIB-In, read back at startup\n"
+      "Snapshot file\n"
+      "Time between snapshots\n"
+      "Seconds\n")
+
+DEFUN(no_bgp_snapshot, no_bgp_snapshot_cmd, "no bgp graceful-restart snapshot",
+      NO_STR "BGP specific commands\n"
+	     "Graceful restart capability parameters\n"
+	     "Keep a snapshot of the Adj-RIB-In, read back at startup\n") {
+	struct bgp *bgp = vty->index;
+
+	if(!bgp->name) {
+		bgp_snapshot_unset();
+	}
+	return CMD_SUCCESS;
+}
+
+ALIAS(no_bgp_snapshot, no_bgp_snapshot_path_cmd, "no bgp graceful-restart snapshot PATH",
+      NO_STR "BGP specific commands\n"
+	     "Graceful restart capability parameters\n"
+	     "Keep a snapshot of the Adj-RIB-In, read back at startup\n"
+	     "Snapshot file\n")
+
+ALIAS(no_bgp_snapshot, no_bgp_snapshot_interval_cmd, "no bgp graceful-restart snapshot PATH interval <10-86400>",
+      NO_STR "BGP specific commands\n"
+	     "Graceful restart capability parameters\n"
+	     "Keep a snapshot of the Adj-RIB-In, read back at startup\n"
+	     "Snapshot file\n"
+	     "Time between snapshots\n"
+	     "Seconds\n")
+
+int bgp_snapshot_config_write(struct vty *vty, struct bgp *bgp) {
+	if(bgp->name || !snapshot_path) {
+		return 0;
+	}
+
+	vty_out(vty, " bgp graceful-restart snapshot %s", snapshot_path);
+	if(snapshot_interval != BGP_SNAPSHOT_INTERVAL_DEFAULT) {
+		vty_out(vty, " interval %u", snapshot_interval);
+	}
+	vty_out(vty, "%s", VTY_NEWLINE);
+	return 0;
+}
+
+void bgp_snapshot_init(void) {
+	snapshot_obuf = stream_new(65536);
+	snapshot_abuf = stream_new(BGP_EXTENDED_MESSAGE_MAX_PACKET_SIZE + 128);
+
+	install_element(BGP_NODE, &bgp_snapshot_cmd);
+	install_element(BGP_NODE, &bgp_snapshot_interval_cmd);
+	install_element(BGP_NODE, &no_bgp_snapshot_cmd);
+	install_element(BGP_NODE, &no_bgp_snapshot_path_cmd);
+	install_element(BGP_NODE, &no_bgp_snapshot_interval_cmd);
+}
+
+/* A snapshot being written is dropped, what the writer has is let finish
+ * so that the file is closed and removed. */
+void bgp_snapshot_finish(void) {
+	bgp_snapshot_unset();
+	if(snapshot_writer) {
+		work_pool_wait(snapshot_writer);
+		work_pool_free(snapshot_writer);
+		snapshot_writer = NULL;
+	}
+	stream_free(snapshot_obuf);
+	stream_free(snapshot_abuf);
+	snapshot_obuf = snapshot_abuf = NULL;
+}
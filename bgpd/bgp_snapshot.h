@@ -0,0 +1,56 @@
+/* BGP Adj-RIB-In snapshot, for warm restarts
+ *
+ * This file is part of GNU Zebra.
+ *
+ * GNU Zebra is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2, or (at your option) any
+ * later version.
+ *
+ * GNU Zebra is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with GNU Zebra; see the file COPYING.  If not, write to the Free
+ * Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ * 02111-1307, USA.
+ */
+
+#ifndef _QUAGGA_BGP_SNAPSHOT_H
+#define _QUAGGA_BGP_SNAPSHOT_H
+
+/* Every so often the default instance writes what its peers sent it, as
+ * received, to a file, which the next bgpd reads back at startup under
+ * graceful restart: the paths go through inbound policy and selection
+ * and into zebra as if the peers had just sent them, stale, and are
+ * then refreshed, or swept away, as the peers come back.  Only what the
+ * peers with soft-reconfiguration inbound sent is kept by bgpd, and so
+ * only that makes it into the snapshot.
+ *
+ * The file is a header then records, each a type and a length: the
+ * peers, by index; each attribute, by index, before the first path it
+ * is the attribute of; the table, and the paths of a prefix, as peer,
+ * Add-Path ID and attribute indexes.  It is written to PATH.tmp, from a
+ * worker thread, and renamed over PATH once complete. */
+#define BGP_SNAPSHOT_MAGIC 0x51424753 /* "QBGS" */
+#define BGP_SNAPSHOT_VERSION 1
+#define BGP_SNAPSHOT_HEADER_SIZE 20
+
+#define BGP_SNAPSHOT_PEER 1
+#define BGP_SNAPSHOT_ATTR 2
+#define BGP_SNAPSHOT_TABLE 3
+#define BGP_SNAPSHOT_ROUTE 4
+#define BGP_SNAPSHOT_END 5
+
+#define BGP_SNAPSHOT_RECORD_HEADER_SIZE 5
+#define BGP_SNAPSHOT_PATH_SIZE 10
+
+#define BGP_SNAPSHOT_INTERVAL_DEFAULT 300
+
+extern int bgp_snapshot_config_write(struct vty *, struct bgp *);
+extern void bgp_snapshot_init(void);
+extern void bgp_snapshot_finish(void);
+
+#endif /* _QUAGGA_BGP_SNAPSHOT_H */
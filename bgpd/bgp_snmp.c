@@ -39,11 +39,15 @@ Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
 	#include "bgpd/bgp_attr.h"
 	#include "bgpd/bgp_route.h"
 	#include "bgpd/bgp_fsm.h"
+	#include "bgpd/bgp_packet.h"
 	#include "bgpd/bgp_snmp.h"
 
 	/* BGP4-MIB described in RFC1657. */
 	#define BGP4MIB 1, 3, 6, 1, 2, 1, 15
 
+	/* bgpd under GNOME-PRODUCT-ZEBRA-MIB, for what BGP4-MIB has no room */
+	#define BGPDMIB 1, 3, 6, 1, 4, 1, 3317, 1, 2, 2
+
 	/* BGP TRAP. */
 	#define BGPESTABLISHED 1
 	#define BGPBACKWARDTRANSITION 2
@@ -106,6 +110,20 @@ Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
 	#define BGP4PATHATTRBEST 13
 	#define BGP4PATHATTRUNKNOWN 14
 
+/* bgpdPeerLagTable, indexed as bgpPeerTable: queue depths, and lags in
+ * microseconds. */
+	#define BGPDPEERINQPACKETS 1
+	#define BGPDPEERINQBYTES 2
+	#define BGPDPEEROUTQPACKETS 3
+	#define BGPDPEEROUTQBYTES 4
+	#define BGPDPEERADVQUEUED 5
+	#define BGPDPEERINLAGLAST 6
+	#define BGPDPEERINLAGAVERAGE 7
+	#define BGPDPEERINLAGMAX 8
+	#define BGPDPEEROUTLAGLAST 9
+	#define BGPDPEEROUTLAGAVERAGE 10
+	#define BGPDPEEROUTLAGMAX 11
+
 	/* SNMP value hack. */
 	#define INTEGER ASN_INTEGER
 	#define INTEGER32 ASN_INTEGER
@@ -119,6 +137,7 @@ SNMP_LOCAL_VARIABLES
 
 /* BGP-MIB instances. */
 oid bgp_oid[] = { BGP4MIB };
+oid bgpd_oid[] = { BGPDMIB };
 oid bgp_trap_oid[] = { BGP4MIB, 0 };
 
 /* IP address 0.0.0.0. */
@@ -131,6 +150,7 @@ static u_char *bgpPeerTable(struct variable *, oid[], size_t *, int, size_t *, W
 static u_char *bgpRcvdPathAttrTable(struct variable *, oid[], size_t *, int, size_t *, WriteMethod **);
 static u_char *bgpIdentifier(struct variable *, oid[], size_t *, int, size_t *, WriteMethod **);
 static u_char *bgp4PathAttrTable(struct variable *, oid[], size_t *, int, size_t *, WriteMethod **);
+static u_char *bgpdPeerLagTable(struct variable *, oid[], size_t *, int, size_t *, WriteMethod **);
 /* static u_char *bgpTraps (); */
 
 struct variable bgp_variables[] = {
@@ -188,6 +208,20 @@ struct variable bgp_variables[] = {
 	{ BGP4PATHATTRUNKNOWN,		       OCTET_STRING, RONLY,  bgp4PathAttrTable,    3, { 6, 1, 14 }},
 };
 
+struct variable bgpd_variables[] = {
+	{ BGPDPEERINQPACKETS,    GAUGE32, RONLY, bgpdPeerLagTable, 3, { 1, 1, 1 } },
+	{ BGPDPEERINQBYTES,      GAUGE32, RONLY, bgpdPeerLagTable, 3, { 1, 1, 2 } },
+	{ BGPDPEEROUTQPACKETS,   GAUGE32, RONLY, bgpdPeerLagTable, 3, { 1, 1, 3 } },
+	{ BGPDPEEROUTQBYTES,     GAUGE32, RONLY, bgpdPeerLagTable, 3, { 1, 1, 4 } },
+	{ BGPDPEERADVQUEUED,     GAUGE32, RONLY, bgpdPeerLagTable, 3, { 1, 1, 5 } },
+	{ BGPDPEERINLAGLAST,     GAUGE32, RONLY, bgpdPeerLagTable, 3, { 1, 1, 6 } },
+	{ BGPDPEERINLAGAVERAGE,  GAUGE32, RONLY, bgpdPeerLagTable, 3, { 1, 1, 7 } },
+	{ BGPDPEERINLAGMAX,      GAUGE32, RONLY, bgpdPeerLagTable, 3, { 1, 1, 8 } },
+	{ BGPDPEEROUTLAGLAST,    GAUGE32, RONLY, bgpdPeerLagTable, 3, { 1, 1, 9 } },
+	{ BGPDPEEROUTLAGAVERAGE, GAUGE32, RONLY, bgpdPeerLagTable, 3, { 1, 1, 10 }},
+	{ BGPDPEEROUTLAGMAX,     GAUGE32, RONLY, bgpdPeerLagTable, 3, { 1, 1, 11 }},
+};
+
 static u_char *bgpVersion(struct variable *v, oid name[], size_t *length, int exact, size_t *var_len, WriteMethod **write_method) {
 	static u_char version;
 
@@ -510,18 +544,49 @@ static u_char *bgpRcvdPathAttrTable(struct variable *v, oid name[], size_t *leng
 	return NULL;
 }
 
+#define BGP_PATHATTR_ENTRY_OFFSET (IN_ADDR_SIZE + 1 + IN_ADDR_SIZE)
+
+/* Where the last GETNEXT of bgp4PathAttrTable left off.  A walk asks
+   for the row after the one it was just given, so when the index asked
+   for is the one returned last time, the walk goes on from the node
+   found then instead of looking the prefix up again.  The node, and
+   its table, are kept locked while held here. */
+static struct {
+	struct bgp_table *table;
+	struct bgp_node *rn;
+	oid index[BGP_PATHATTR_ENTRY_OFFSET];
+} pathattr_cursor;
+
+static void bgp4PathAttrCursorClear(void) {
+	if(pathattr_cursor.rn) {
+		bgp_unlock_node(pathattr_cursor.rn);
+		bgp_table_unlock(pathattr_cursor.table);
+		pathattr_cursor.rn = NULL;
+		pathattr_cursor.table = NULL;
+	}
+}
+
+static void bgp4PathAttrCursorSet(struct bgp_table *table, struct bgp_node *rn, oid *index) {
+	if(pathattr_cursor.rn != rn) {
+		bgp4PathAttrCursorClear();
+		bgp_table_lock(table);
+		pathattr_cursor.table = table;
+		pathattr_cursor.rn = bgp_lock_node(rn);
+	}
+	oid_copy(pathattr_cursor.index, index, BGP_PATHATTR_ENTRY_OFFSET);
+}
+
 static struct bgp_info *bgp4PathAttrLookup(struct variable *v, oid name[], size_t *length, struct bgp *bgp, struct prefix_ipv4 *addr, int exact) {
 	oid *offset;
 	int offsetlen;
 	struct bgp_info *binfo;
 	struct bgp_info *min;
 	struct bgp_node *rn;
+	struct bgp_table *table = bgp->rib[AFI_IP][SAFI_UNICAST];
 	union sockunion su;
 	unsigned int len;
 	struct in_addr paddr;
 
-	#define BGP_PATHATTR_ENTRY_OFFSET (IN_ADDR_SIZE + 1 + IN_ADDR_SIZE)
-
 	if(exact) {
 		if(*length - v->namelen != BGP_PATHATTR_ENTRY_OFFSET) {
 			return NULL;
@@ -552,43 +617,50 @@ static struct bgp_info *bgp4PathAttrLookup(struct variable *v, oid name[], size_
 			}
 		}
 	} else {
-		offset = name + v->namelen;
-		offsetlen = *length - v->namelen;
-		len = offsetlen;
-
-		if(offsetlen == 0) {
-			rn = bgp_table_top(bgp->rib[AFI_IP][SAFI_UNICAST]);
+		if(pathattr_cursor.rn && pathattr_cursor.table == table && *length - v->namelen == BGP_PATHATTR_ENTRY_OFFSET
+		   && oid_compare(name + v->namelen, BGP_PATHATTR_ENTRY_OFFSET, pathattr_cursor.index, BGP_PATHATTR_ENTRY_OFFSET) == 0) {
+			/* Next row after the one returned last. */
+			rn = bgp_lock_node(pathattr_cursor.rn);
+			oid2in_addr(pathattr_cursor.index + IN_ADDR_SIZE + 1, IN_ADDR_SIZE, &paddr);
 		} else {
-			if(len > IN_ADDR_SIZE) {
-				len = IN_ADDR_SIZE;
-			}
+			offset = name + v->namelen;
+			offsetlen = *length - v->namelen;
+			len = offsetlen;
 
-			oid2in_addr(offset, len, &addr->prefix);
+			if(offsetlen == 0) {
+				rn = bgp_table_top(table);
+			} else {
+				if(len > IN_ADDR_SIZE) {
+					len = IN_ADDR_SIZE;
+				}
 
-			offset += IN_ADDR_SIZE;
-			offsetlen -= IN_ADDR_SIZE;
+				oid2in_addr(offset, len, &addr->prefix);
 
-			if(offsetlen > 0) {
-				addr->prefixlen = *offset;
-			} else {
-				addr->prefixlen = len * 8;
-			}
+				offset += IN_ADDR_SIZE;
+				offsetlen -= IN_ADDR_SIZE;
 
-			rn = bgp_node_get(bgp->rib[AFI_IP][SAFI_UNICAST], (struct prefix *) addr);
+				if(offsetlen > 0) {
+					addr->prefixlen = *offset;
+				} else {
+					addr->prefixlen = len * 8;
+				}
 
-			offset++;
-			offsetlen--;
-		}
+				rn = bgp_node_get(table, (struct prefix *) addr);
 
-		if(offsetlen > 0) {
-			len = offsetlen;
-			if(len > IN_ADDR_SIZE) {
-				len = IN_ADDR_SIZE;
+				offset++;
+				offsetlen--;
 			}
 
-			oid2in_addr(offset, len, &paddr);
-		} else {
-			paddr.s_addr = 0;
+			if(offsetlen > 0) {
+				len = offsetlen;
+				if(len > IN_ADDR_SIZE) {
+					len = IN_ADDR_SIZE;
+				}
+
+				oid2in_addr(offset, len, &paddr);
+			} else {
+				paddr.s_addr = 0;
+			}
 		}
 
 		if(!rn) {
@@ -622,6 +694,7 @@ static struct bgp_info *bgp4PathAttrLookup(struct variable *v, oid name[], size_
 				addr->prefix = rn->p.u.prefix4;
 				addr->prefixlen = rn->p.prefixlen;
 
+				bgp4PathAttrCursorSet(table, rn, name + v->namelen);
 				bgp_unlock_node(rn);
 
 				return min;
@@ -737,8 +810,43 @@ void bgpTrapBackwardTransition(struct peer *peer) {
 	);
 }
 
+static u_char *bgpdPeerLagTable(struct variable *v, oid name[], size_t *length, int exact, size_t *var_len, WriteMethod **write_method) {
+	static struct in_addr addr;
+	struct peer *peer;
+	struct bgp_queue_depth depth;
+
+	if(smux_header_table(v, name, length, exact, var_len, write_method) == MATCH_FAILED) {
+		return NULL;
+	}
+	memset(&addr, 0, sizeof(struct in_addr));
+
+	peer = bgpPeerTable_lookup(v, name, length, &addr, exact);
+	if(!peer) {
+		return NULL;
+	}
+
+	bgp_queue_depth(peer, &depth);
+
+	switch(v->magic) {
+		case BGPDPEERINQPACKETS: return SNMP_INTEGER(depth.in_packets); break;
+		case BGPDPEERINQBYTES: return SNMP_INTEGER(depth.in_bytes); break;
+		case BGPDPEEROUTQPACKETS: return SNMP_INTEGER(depth.out_packets); break;
+		case BGPDPEEROUTQBYTES: return SNMP_INTEGER(depth.out_bytes); break;
+		case BGPDPEERADVQUEUED: return SNMP_INTEGER(depth.adv); break;
+		case BGPDPEERINLAGLAST: return SNMP_INTEGER(peer->lag_in.last); break;
+		case BGPDPEERINLAGAVERAGE: return SNMP_INTEGER(peer_lag_average(&peer->lag_in)); break;
+		case BGPDPEERINLAGMAX: return SNMP_INTEGER(peer->lag_in.max); break;
+		case BGPDPEEROUTLAGLAST: return SNMP_INTEGER(peer->lag_out.last); break;
+		case BGPDPEEROUTLAGAVERAGE: return SNMP_INTEGER(peer_lag_average(&peer->lag_out)); break;
+		case BGPDPEEROUTLAGMAX: return SNMP_INTEGER(peer->lag_out.max); break;
+		default: return NULL; break;
+	}
+	return NULL;
+}
+
 void bgp_snmp_init(void) {
 	smux_init(bm->master);
 	REGISTER_MIB("mibII/bgp", bgp_variables, variable, bgp_oid);
+	REGISTER_MIB("bgpd", bgpd_variables, variable, bgpd_oid);
 }
 #endif /* HAVE_SNMP */
@@ -72,9 +72,38 @@ static struct route_node *bgp_node_create(route_table_delegate_t *delegate, stru
 /*
  * bgp_node_destroy
  */
+static void bgp_node_version_unlink(struct bgp_table *table, struct bgp_node *rn) {
+	struct bgp_node **head, **tail;
+
+	if(CHECK_FLAG(rn->flags, BGP_NODE_WITHDRAWN)) {
+		head = &table->withdrawn_head;
+		tail = &table->withdrawn_tail;
+		table->withdrawn_count--;
+	} else if(CHECK_FLAG(rn->flags, BGP_NODE_CHANGED)) {
+		head = &table->changed_head;
+		tail = &table->changed_tail;
+	} else {
+		return;
+	}
+
+	if(rn->vprev) {
+		rn->vprev->vnext = rn->vnext;
+	} else {
+		*head = rn->vnext;
+	}
+	if(rn->vnext) {
+		rn->vnext->vprev = rn->vprev;
+	} else {
+		*tail = rn->vprev;
+	}
+	rn->vprev = rn->vnext = NULL;
+	UNSET_FLAG(rn->flags, BGP_NODE_CHANGED | BGP_NODE_WITHDRAWN);
+}
+
 static void bgp_node_destroy(route_table_delegate_t *delegate, struct route_table *table, struct route_node *node) {
 	struct bgp_node *bgp_node;
 	bgp_node = bgp_node_from_rnode(node);
+	bgp_node_version_unlink(table->info, bgp_node);
 	XFREE(MTYPE_BGP_NODE, bgp_node);
 }
 
@@ -106,3 +135,82 @@ struct bgp_table *bgp_table_init(afi_t afi, safi_t safi) {
 
 	return rt;
 }
+
+/* Give rn the table's next version, its best path having changed.  A
+ * node with none is locked while it is on the withdrawn list. */
+void bgp_node_version_bump(struct bgp_node *rn, int withdrawn) {
+	struct bgp_table *table = bgp_node_table(rn);
+	struct bgp_node *old;
+	int was_withdrawn = CHECK_FLAG(rn->flags, BGP_NODE_WITHDRAWN);
+
+	bgp_node_version_unlink(table, rn);
+	rn->version = ++table->version;
+
+	if(withdrawn) {
+		if(!was_withdrawn) {
+			bgp_lock_node(rn);
+		}
+		rn->vprev = table->withdrawn_tail;
+		if(table->withdrawn_tail) {
+			table->withdrawn_tail->vnext = rn;
+		} else {
+			table->withdrawn_head = rn;
+		}
+		table->withdrawn_tail = rn;
+		table->withdrawn_count++;
+		SET_FLAG(rn->flags, BGP_NODE_WITHDRAWN);
+
+		while(table->withdrawn_count > BGP_TABLE_WITHDRAWN_MAX) {
+			old = table->withdrawn_head;
+			table->forgotten = old->version;
+			bgp_node_version_unlink(table, old);
+			bgp_unlock_node(old);
+		}
+		return;
+	}
+
+	rn->vprev = table->changed_tail;
+	if(table->changed_tail) {
+		table->changed_tail->vnext = rn;
+	} else {
+		table->changed_head = rn;
+	}
+	table->changed_tail = rn;
+	SET_FLAG(rn->flags, BGP_NODE_CHANGED);
+
+	if(was_withdrawn) {
+		bgp_unlock_node(rn);
+	}
+}
+
+/* The first node of a list after 'version', looked for from the end as
+ * the changes asked for are the latest */
+static struct bgp_node *bgp_table_changes_after(struct bgp_node *tail, u_int64_t version) {
+	struct bgp_node *rn, *first = NULL;
+
+	for(rn = tail; rn && rn->version > version; rn = rn->vprev) {
+		first = rn;
+	}
+	return first;
+}
+
+int bgp_table_changes_init(bgp_table_changes_t *changes, struct bgp_table *table, u_int64_t version) {
+	changes->changed = bgp_table_changes_after(table->changed_tail, version);
+	changes->withdrawn = bgp_table_changes_after(table->withdrawn_tail, version);
+	return version >= table->forgotten;
+}
+
+struct bgp_node *bgp_table_changes_next(bgp_table_changes_t *changes) {
+	struct bgp_node *rn;
+
+	if(changes->changed && (!changes->withdrawn || changes->changed->version < changes->withdrawn->version)) {
+		rn = changes->changed;
+		changes->changed = rn->vnext;
+	} else {
+		rn = changes->withdrawn;
+		if(rn) {
+			changes->withdrawn = rn->vnext;
+		}
+	}
+	return rn;
+}
@@ -27,6 +27,7 @@ Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
 typedef enum {
 	BGP_TABLE_MAIN,
 	BGP_TABLE_RSCLIENT,
+	BGP_TABLE_RSSHARED, /* paths of all RS clients, see bgp_rs_shared */
 } bgp_table_t;
 
 struct bgp_table {
@@ -41,9 +42,27 @@ struct bgp_table {
 	/* The owner of this 'bgp_table' structure. */
 	struct peer *owner;
 
+	/* For the per-RD tables of SAFI_MPLS_VPN and SAFI_ENCAP, the node of
+	 * the RD in the top level table, shared by all their nodes. */
+	struct bgp_node *prn;
+
 	struct route_table *route_table;
+
+	/* Each node whose best path changes takes the next version and goes
+	 * to the end of 'changed', or of 'withdrawn' if it is left with no
+	 * best path, held for the withdrawal to be told.  Beyond
+	 * BGP_TABLE_WITHDRAWN_MAX the oldest are let go, 'forgotten' being
+	 * the version of the last: what changed since an older version can
+	 * only be had as the whole table. */
+	u_int64_t version;
+	u_int64_t forgotten;
+	struct bgp_node *changed_head, *changed_tail;
+	struct bgp_node *withdrawn_head, *withdrawn_tail;
+	unsigned long withdrawn_count;
 };
 
+#define BGP_TABLE_WITHDRAWN_MAX 16384
+
 struct bgp_node {
 	/*
    * CAUTION
@@ -57,15 +76,34 @@ struct bgp_node {
 
 	struct bgp_adj_out *adj_out;
 
+	struct bgp_adj_shared *adj_shared;
+
 	struct bgp_adj_in *adj_in;
 
-	struct bgp_node *prn;
+	/* The one path changed since best path selection last ran, see
+	 * bgp_process_path() */
+	struct bgp_info *changed;
+
+	/* Version of the last change of best path, and the node's place on
+	 * its table's 'changed' or 'withdrawn' list */
+	u_int64_t version;
+	struct bgp_node *vprev, *vnext;
 
 	u_char flags;
 #define BGP_NODE_PROCESS_SCHEDULED (1 << 0)
 #define BGP_NODE_USER_CLEAR (1 << 1)
+#define BGP_NODE_SELECT_FULL (1 << 2)
+#define BGP_NODE_PRESELECTED (1 << 3)
+#define BGP_NODE_CHANGED (1 << 4)
+#define BGP_NODE_WITHDRAWN (1 << 5)
 };
 
+/* Walk of the nodes changed since a version, in version order */
+typedef struct bgp_table_changes_t_ {
+	struct bgp_node *changed;
+	struct bgp_node *withdrawn;
+} bgp_table_changes_t;
+
 /*
  * bgp_table_iter_t
  *
@@ -81,6 +119,11 @@ extern void bgp_table_lock(struct bgp_table *);
 extern void bgp_table_unlock(struct bgp_table *);
 extern void bgp_table_finish(struct bgp_table **);
 
+extern void bgp_node_version_bump(struct bgp_node *, int withdrawn);
+/* 0 if the changes since 'version' are no longer all known */
+extern int bgp_table_changes_init(bgp_table_changes_t *, struct bgp_table *, u_int64_t version);
+extern struct bgp_node *bgp_table_changes_next(bgp_table_changes_t *);
+
 /*
  * bgp_node_from_rnode
  *
@@ -108,6 +151,16 @@ static inline struct bgp_table *bgp_node_table(struct bgp_node *node) {
 	return bgp_node_to_rnode(node)->table->info;
 }
 
+/*
+ * bgp_node_prn
+ *
+ * Returns the node of the RD in the top level table for a node in one of
+ * the per-RD tables, NULL otherwise.
+ */
+static inline struct bgp_node *bgp_node_prn(struct bgp_node *node) {
+	return bgp_node_table(node)->prn;
+}
+
 /*
  * bgp_node_parent_nolock
  *
@@ -149,6 +202,23 @@ static inline struct bgp_node *bgp_route_next(struct bgp_node *node) {
 	return bgp_node_from_rnode(route_next(bgp_node_to_rnode(node)));
 }
 
+/*
+ * bgp_table_top_info
+ *
+ * Gets the first node with info without locking it.  The table must
+ * not change while it's walked with bgp_route_next_info().
+ */
+static inline struct bgp_node *bgp_table_top_info(const struct bgp_table *const table) {
+	return bgp_node_from_rnode(route_top_info(table->route_table));
+}
+
+/*
+ * bgp_route_next_info
+ */
+static inline struct bgp_node *bgp_route_next_info(struct bgp_node *node) {
+	return bgp_node_from_rnode(route_next_info(bgp_node_to_rnode(node)));
+}
+
 /*
  * bgp_route_next_until
  */
@@ -173,6 +243,31 @@ static inline struct bgp_node *bgp_node_lookup(const struct bgp_table *const tab
 	return bgp_node_from_rnode(route_node_lookup(table->route_table, p));
 }
 
+/*
+ * bgp_rd_top
+ *
+ * Starts a walk over the RD level of a VPN or Encap table, continued
+ * with bgp_rd_next(): every RD, or when prd is given just its node,
+ * looked up directly rather than found by visiting all the others.
+ */
+static inline struct bgp_node *bgp_rd_top(const struct bgp_table *const table, struct prefix_rd *prd) {
+	if(prd) {
+		return bgp_node_lookup(table, (struct prefix *) prd);
+	}
+	return bgp_table_top(table);
+}
+
+/*
+ * bgp_rd_next
+ */
+static inline struct bgp_node *bgp_rd_next(struct bgp_node *node, struct prefix_rd *prd) {
+	if(prd) {
+		bgp_unlock_node(node);
+		return NULL;
+	}
+	return bgp_route_next(node);
+}
+
 /*
  * bgp_lock_node
  */
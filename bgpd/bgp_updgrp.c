@@ -0,0 +1,460 @@
+/* BGP update-groups
+ *
+ * This file is part of Quagga
+ *
+ * Quagga is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2, or (at your option) any
+ * later version.
+ *
+ * Quagga is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Quagga; see the file COPYING.  If not, write to the Free
+ * Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ * 02111-1307, USA.
+ */
+
+#include <zebra.h>
+
+#include "command.h"
+#include "prefix.h"
+#include "linklist.h"
+#include "memory.h"
+#include "stream.h"
+#include "thread.h"
+#include "routemap.h"
+#include "filter.h"
+
+#include "bgpd/bgpd.h"
+#include "bgpd/bgp_table.h"
+#include "bgpd/bgp_route.h"
+#include "bgpd/bgp_attr.h"
+#include "bgpd/bgp_debug.h"
+#include "bgpd/bgp_vty.h"
+#include "bgpd/bgp_advertise.h"
+#include "bgpd/bgp_updgrp.h"
+
+/* Flags that only affect what we accept from the peer */
+#define BGP_UPDGRP_AF_FLAGS_INBOUND (PEER_FLAG_SOFT_RECONFIG | PEER_FLAG_ALLOWAS_IN | PEER_FLAG_ORF_PREFIX_SM | PEER_FLAG_ORF_PREFIX_RM | PEER_FLAG_MAX_PREFIX | PEER_FLAG_MAX_PREFIX_WARNING | PEER_FLAG_ADDPATH_RX)
+
+#define BGP_UPDGRP_AF_CAP_ORF (PEER_CAP_ORF_PREFIX_SM_RCV | PEER_CAP_ORF_PREFIX_SM_OLD_RCV)
+
+static unsigned int bgp_updgrp_next_id = 1;
+static unsigned long bgp_updgrp_memo_seq = 1;
+
+/* Route-map rules whose outcome depends on which peer the route goes to,
+ * rather than just on the route and the peer's configuration. */
+static int bgp_updgrp_rule_per_peer(const char *cmd, const char *rule_str, int set, void *arg) {
+	if(!set) {
+		return (strcmp(cmd, "peer") == 0 || strncmp(cmd, "ip route-source", 15) == 0 || strcmp(cmd, "probability") == 0);
+	}
+	if(strcmp(cmd, "ipv6 next-hop peer-address") == 0) {
+		return 1;
+	}
+	if(!rule_str) {
+		return 0;
+	}
+	if(strcmp(cmd, "ip next-hop") == 0) {
+		return (strcmp(rule_str, "peer-address") == 0);
+	}
+	if(strcmp(cmd, "as-path prepend") == 0) {
+		return (strstr(rule_str, "last-as") != NULL);
+	}
+	if(strcmp(cmd, "local-preference") == 0 || strcmp(cmd, "metric") == 0 || strcmp(cmd, "weight") == 0) {
+		return (strstr(rule_str, "rtt") != NULL);
+	}
+	return 0;
+}
+
+static int bgp_updgrp_policy_per_peer(struct peer *peer, afi_t afi, safi_t safi) {
+	struct bgp_filter *filter = &peer->filter[afi][safi];
+
+	/* Where the nexthop is rewritten rests on the peer's own address */
+	if(peer->sort == BGP_PEER_EBGP) {
+		return 1;
+	}
+
+	/* ORF prefix-lists are the peer's own */
+	if(CHECK_FLAG(peer->af_cap[afi][safi], BGP_UPDGRP_AF_CAP_ORF)) {
+		return 1;
+	}
+
+	/* Keep filter debugs naming the peer they're about */
+	if(BGP_DEBUG(filter, FILTER)) {
+		return 1;
+	}
+
+	if(route_map_rule_walk(filter->map[RMAP_OUT].map, bgp_updgrp_rule_per_peer, NULL) != 0) {
+		return 1;
+	}
+	if(route_map_rule_walk(filter->usmap.map, bgp_updgrp_rule_per_peer, NULL) != 0) {
+		return 1;
+	}
+	return 0;
+}
+
+static void bgp_updgrp_key_make(struct peer *peer, afi_t afi, safi_t safi, struct update_group_key *key) {
+	struct bgp *bgp = peer->bgp;
+	struct bgp_filter *filter = &peer->filter[afi][safi];
+
+	memset(key, 0, sizeof(struct update_group_key));
+
+	if(bgp_updgrp_policy_per_peer(peer, afi, safi)) {
+		key->peer = peer;
+	}
+
+	key->sort = peer->sort;
+	key->as = peer->as;
+	key->local_as = peer->local_as;
+	key->change_local_as = peer->change_local_as;
+	key->flags = peer->flags & (PEER_FLAG_LOCAL_AS_NO_PREPEND | PEER_FLAG_LOCAL_AS_REPLACE_AS);
+	key->af_flags = peer->af_flags[afi][safi] & ~BGP_UPDGRP_AF_FLAGS_INBOUND;
+	key->af_sflags = peer->af_sflags[afi][safi] & PEER_STATUS_DEFAULT_ORIGINATE;
+	key->cap = peer->cap & PEER_CAP_AS4_RCV;
+
+	key->nexthop_v4 = peer->nexthop.v4;
+	key->nexthop_v6_global = peer->nexthop.v6_global;
+	key->nexthop_v6_local = peer->nexthop.v6_local;
+	key->shared_network = peer->shared_network;
+
+	key->bgp_config = bgp->config;
+	key->router_id = bgp->router_id;
+	key->cluster_id = bgp->cluster_id;
+	key->confed_id = bgp->confed_id;
+
+	key->addpath_tx = BGP_ADDPATH_TX(peer, afi, safi);
+
+	key->dlist = filter->dlist[FILTER_OUT].name;
+	key->plist = filter->plist[FILTER_OUT].name;
+	key->aslist = filter->aslist[FILTER_OUT].name;
+	key->rmap = filter->map[RMAP_OUT].name;
+	key->usmap = filter->usmap.name;
+}
+
+static int bgp_updgrp_name_same(const char *a, const char *b) {
+	if(!a || !b) {
+		return (a == b);
+	}
+	return (strcmp(a, b) == 0);
+}
+
+static int bgp_updgrp_key_same(const struct update_group_key *a, const struct update_group_key *b) {
+	/* both cleared before being filled in, so padding compares equal */
+	if(memcmp(a, b, offsetof(struct update_group_key, dlist)) != 0) {
+		return 0;
+	}
+	return (bgp_updgrp_name_same(a->dlist, b->dlist) && bgp_updgrp_name_same(a->plist, b->plist) && bgp_updgrp_name_same(a->aslist, b->aslist) && bgp_updgrp_name_same(a->rmap, b->rmap) && bgp_updgrp_name_same(a->usmap, b->usmap));
+}
+
+static char *bgp_updgrp_name_dup(const char *name) {
+	return name ? XSTRDUP(MTYPE_BGP_UPDGRP, name) : NULL;
+}
+
+static void bgp_updgrp_name_free(char *name) {
+	if(name) {
+		XFREE(MTYPE_BGP_UPDGRP, name);
+	}
+}
+
+static struct update_group *bgp_updgrp_new(struct bgp *bgp, afi_t afi, safi_t safi, const struct update_group_key *key) {
+	struct update_group *group;
+
+	group = XCALLOC(MTYPE_BGP_UPDGRP, sizeof(struct update_group));
+	group->bgp = bgp;
+	group->afi = afi;
+	group->safi = safi;
+	group->id = bgp_updgrp_next_id++;
+	group->peers = list_new();
+
+	/* the names belong to whichever peer they came from */
+	group->key = *key;
+	group->key.dlist = bgp_updgrp_name_dup(key->dlist);
+	group->key.plist = bgp_updgrp_name_dup(key->plist);
+	group->key.aslist = bgp_updgrp_name_dup(key->aslist);
+	group->key.rmap = bgp_updgrp_name_dup(key->rmap);
+	group->key.usmap = bgp_updgrp_name_dup(key->usmap);
+
+	listnode_add(bgp->update_groups, group);
+	return group;
+}
+
+static void bgp_updgrp_encode_flush(struct update_group *group) {
+	int i;
+
+	for(i = 0; i < BGP_UPDGRP_ENCODE_SLOTS; i++) {
+		struct update_group_encode *enc = &group->encode[i];
+
+		if(enc->attr) {
+			bgp_attr_unintern(&enc->attr);
+			XFREE(MTYPE_BGP_UPDGRP_ENCODE, enc->data);
+		}
+	}
+}
+
+static void bgp_updgrp_memo_flush(struct update_group *group) {
+	unsigned int i;
+
+	for(i = 0; i < group->memo_count; i++) {
+		if(group->memo[i].attr) {
+			bgp_attr_unintern(&group->memo[i].attr);
+		}
+	}
+	group->memo_count = 0;
+}
+
+static void bgp_updgrp_free(struct update_group *group) {
+	listnode_delete(group->bgp->update_groups, group);
+
+	bgp_updgrp_memo_flush(group);
+	bgp_updgrp_encode_flush(group);
+
+	bgp_updgrp_name_free(group->key.dlist);
+	bgp_updgrp_name_free(group->key.plist);
+	bgp_updgrp_name_free(group->key.aslist);
+	bgp_updgrp_name_free(group->key.rmap);
+	bgp_updgrp_name_free(group->key.usmap);
+
+	list_delete(group->peers);
+	if(group->index_used) {
+		XFREE(MTYPE_BGP_UPDGRP, group->index_used);
+	}
+	XFREE(MTYPE_BGP_UPDGRP, group);
+}
+
+static void bgp_updgrp_index_get(struct update_group *group, struct peer *peer, afi_t afi, safi_t safi) {
+	unsigned int i;
+
+	for(i = 0; i < group->index_words * 32U; i++) {
+		if(!(group->index_used[i / 32] & (1U << (i % 32)))) {
+			break;
+		}
+	}
+
+	if(i >= group->index_words * 32U) {
+		group->index_used = XREALLOC(MTYPE_BGP_UPDGRP, group->index_used, (group->index_words + 1) * sizeof(u_int32_t));
+		group->index_used[group->index_words++] = 0;
+	}
+
+	group->index_used[i / 32] |= (1U << (i % 32));
+	peer->updgrp_index[afi][safi] = i;
+}
+
+static void bgp_updgrp_peer_remove(struct peer *peer, afi_t afi, safi_t safi, int detach) {
+	struct update_group *group = peer->updgrp[afi][safi];
+	unsigned int i = peer->updgrp_index[afi][safi];
+
+	if(!group) {
+		return;
+	}
+
+	bgp_adj_out_shared_leave(peer, afi, safi, detach);
+
+	group->index_used[i / 32] &= ~(1U << (i % 32));
+	peer->updgrp[afi][safi] = NULL;
+	listnode_delete(group->peers, peer);
+	if(!listcount(group->peers)) {
+		bgp_updgrp_free(group);
+	}
+}
+
+void bgp_updgrp_peer_leave(struct peer *peer, afi_t afi, safi_t safi) {
+	bgp_updgrp_peer_remove(peer, afi, safi, 0);
+}
+
+void bgp_updgrp_peer_leave_all(struct peer *peer) {
+	afi_t afi;
+	safi_t safi;
+
+	for(afi = AFI_IP; afi < AFI_MAX; afi++) {
+		for(safi = SAFI_UNICAST; safi < SAFI_MAX; safi++) {
+			bgp_updgrp_peer_leave(peer, afi, safi);
+		}
+	}
+}
+
+struct update_group *bgp_updgrp_peer_get(struct peer *peer, afi_t afi, safi_t safi) {
+	struct update_group *group = peer->updgrp[afi][safi];
+	struct update_group_key key;
+	struct listnode *node;
+
+	if(group && peer->updgrp_seq[afi][safi] == thread_call_seq) {
+		return group;
+	}
+
+	bgp_updgrp_key_make(peer, afi, safi, &key);
+
+	if(!group || !bgp_updgrp_key_same(&group->key, &key)) {
+		/* still Established, so keep what it was sent */
+		bgp_updgrp_peer_remove(peer, afi, safi, 1);
+
+		for(ALL_LIST_ELEMENTS_RO(peer->bgp->update_groups, node, group)) {
+			if(group->afi == afi && group->safi == safi && bgp_updgrp_key_same(&group->key, &key)) {
+				break;
+			}
+		}
+		if(!node) {
+			group = bgp_updgrp_new(peer->bgp, afi, safi, &key);
+		}
+
+		listnode_add(group->peers, peer);
+		peer->updgrp[afi][safi] = group;
+		bgp_updgrp_index_get(group, peer, afi, safi);
+	}
+
+	peer->updgrp_seq[afi][safi] = thread_call_seq;
+	return group;
+}
+
+void bgp_updgrp_memo_begin(void) {
+	bgp_updgrp_memo_seq++;
+}
+
+int bgp_updgrp_memo_get(struct update_group *group, struct bgp_info *ri, struct attr **attr) {
+	unsigned int i;
+
+	if(group->memo_seq == bgp_updgrp_memo_seq) {
+		for(i = 0; i < group->memo_count; i++) {
+			if(group->memo[i].ri == ri) {
+				group->memo_hits++;
+				*attr = group->memo[i].attr;
+				return group->memo[i].result;
+			}
+		}
+	}
+
+	group->memo_misses++;
+	return -1;
+}
+
+struct attr *bgp_updgrp_memo_set(struct update_group *group, struct bgp_info *ri, int result, struct attr *attr) {
+	struct update_group_memo *memo;
+
+	/* past the last slot, the paths just go on being evaluated again */
+	if(group->memo_seq != bgp_updgrp_memo_seq || group->memo_count == BGP_UPDGRP_MEMO_SLOTS) {
+		bgp_updgrp_memo_flush(group);
+		group->memo_seq = bgp_updgrp_memo_seq;
+	}
+
+	memo = &group->memo[group->memo_count++];
+	memo->ri = ri;
+	memo->result = result;
+	memo->attr = result ? bgp_attr_intern(attr) : NULL;
+	return memo->attr;
+}
+
+bgp_size_t bgp_updgrp_packet_attribute(struct peer *peer, struct stream *s, struct attr *attr, struct prefix *p, afi_t afi, safi_t safi, struct peer *from, struct prefix_rd *prd, u_char *tag) {
+	struct update_group *group;
+	struct update_group_encode *enc;
+	struct in_addr from_id;
+	int from_ibgp;
+	size_t start;
+	bgp_size_t len;
+
+	/* Only the MP_REACH_NLRI of other AFI/SAFIs carries the prefix */
+	if(peer->status != Established || (p && !(afi == AFI_IP && safi == SAFI_UNICAST))) {
+		return bgp_packet_attribute(NULL, peer, s, attr, p, afi, safi, from, prd, tag);
+	}
+
+	group = bgp_updgrp_peer_get(peer, afi, safi);
+	if(listcount(group->peers) < 2) {
+		return bgp_packet_attribute_cached(peer, s, attr, afi, safi, from);
+	}
+
+	/* All the encoding wants of 'from' is the ORIGINATOR_ID default */
+	from_ibgp = (from && from->sort == BGP_PEER_IBGP);
+	from_id.s_addr = from_ibgp ? from->remote_id.s_addr : 0;
+
+	enc = &group->encode[((uintptr_t) attr / sizeof(struct attr) ^ from_id.s_addr) % BGP_UPDGRP_ENCODE_SLOTS];
+	if(enc->attr == attr && enc->from_ibgp == from_ibgp && IPV4_ADDR_SAME(&enc->from_id, &from_id)) {
+		group->encode_hits++;
+		stream_put(s, enc->data, enc->len);
+		return enc->len;
+	}
+
+	group->encode_misses++;
+	start = stream_get_endp(s);
+	len = bgp_packet_attribute_cached(peer, s, attr, afi, safi, from);
+	if(stream_get_endp(s) - start != len) {
+		return len;
+	}
+
+	if(enc->attr) {
+		bgp_attr_unintern(&enc->attr);
+		XFREE(MTYPE_BGP_UPDGRP_ENCODE, enc->data);
+	}
+	enc->attr = bgp_attr_intern(attr);
+	enc->from_ibgp = from_ibgp;
+	enc->from_id = from_id;
+	enc->len = len;
+	enc->data = XMALLOC(MTYPE_BGP_UPDGRP_ENCODE, len ? len : 1);
+	memcpy(enc->data, STREAM_DATA(s) + start, len);
+
+	return len;
+}
+
+static void bgp_updgrp_show(struct vty *vty, struct bgp *bgp) {
+	struct listnode *node, *pnode;
+	struct update_group *group;
+	struct peer *peer;
+
+	for(ALL_LIST_ELEMENTS_RO(bgp->update_groups, node, group)) {
+		vty_out(vty, "Update-group %u, %s, %s%s", group->id, afi_safi_print(group->afi, group->safi), group->key.peer ? "per-peer policy" : "shared policy", VTY_NEWLINE);
+		vty_out(vty, "  Policy results: %lu shared, %lu computed%s", group->memo_hits, group->memo_misses, VTY_NEWLINE);
+		vty_out(vty, "  Attribute encodings: %lu shared, %lu computed%s", group->encode_hits, group->encode_misses, VTY_NEWLINE);
+		vty_out(vty, "  %d member(s):", listcount(group->peers));
+		for(ALL_LIST_ELEMENTS_RO(group->peers, pnode, peer)) {
+			vty_out(vty, " %s", peer->host);
+		}
+		vty_out(vty, "%s", VTY_NEWLINE);
+	}
+}
+
+DEFUN(show_ip_bgp_update_groups, show_ip_bgp_update_groups_cmd, "show ip bgp update-groups", SHOW_STR IP_STR BGP_STR "Update-groups of peers sharing outbound policy\n") {
+	struct bgp *bgp;
+
+	bgp = bgp_get_default();
+	if(bgp == NULL) {
+		vty_out(vty, "No BGP process is configured%s", VTY_NEWLINE);
+		return CMD_WARNING;
+	}
+
+	bgp_updgrp_show(vty, bgp);
+	return CMD_SUCCESS;
+}
+
+DEFUN(show_ip_bgp_instance_update_groups, show_ip_bgp_instance_update_groups_cmd, "show ip bgp view WORD update-groups",
+      SHOW_STR IP_STR BGP_STR "BGP view\n"
+			      "View name\n"
+			      "Update-groups of peers sharing outbound policy\n") {
+	struct bgp *bgp;
+
+	bgp = bgp_lookup_by_name(argv[0]);
+	if(bgp == NULL) {
+		vty_out(vty, "Can't find BGP view %s%s", argv[0], VTY_NEWLINE);
+		return CMD_WARNING;
+	}
+
+	bgp_updgrp_show(vty, bgp);
+	return CMD_SUCCESS;
+}
+
+/* Groups go away with their last member; all that's left is the list */
+void bgp_updgrp_finish(struct bgp *bgp) {
+	struct update_group *group;
+
+	while(listcount(bgp->update_groups)) {
+		group = listgetdata(listhead(bgp->update_groups));
+		bgp_updgrp_peer_leave(listgetdata(listhead(group->peers)), group->afi, group->safi);
+	}
+	list_delete(bgp->update_groups);
+	bgp->update_groups = NULL;
+}
+
+void bgp_updgrp_init(void) {
+	install_element(VIEW_NODE, &show_ip_bgp_update_groups_cmd);
+	install_element(VIEW_NODE, &show_ip_bgp_instance_update_groups_cmd);
+}
@@ -0,0 +1,144 @@
+/* BGP update-groups
+ *
+ * This file is part of Quagga
+ *
+ * Quagga is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2, or (at your option) any
+ * later version.
+ *
+ * Quagga is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Quagga; see the file COPYING.  If not, write to the Free
+ * Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ * 02111-1307, USA.
+ */
+
+#ifndef _QUAGGA_BGP_UPDGRP_H
+#define _QUAGGA_BGP_UPDGRP_H
+
+/* Established peers whose outbound policy and capabilities would give
+ * the same result for every route are put in one update-group per
+ * AFI/SAFI.  The group then runs the policy part of bgp_announce_check()
+ * once per route for all of its members, and caches the encoded path
+ * attributes so that each attribute set is only encoded once.  What
+ * members were last sent is kept in one struct bgp_adj_shared per node,
+ * with a struct bgp_adj_out of their own only where they differ.
+ *
+ * Membership is worked out lazily and re-checked at most once per thread
+ * callback, as the configuration it depends on can only change from some
+ * other callback.
+ */
+
+/* Encoded attribute cache slots per group */
+#define BGP_UPDGRP_ENCODE_SLOTS 64
+
+/* Policy results kept per group for the route being processed: one
+ * path, or as many as go out to Add-Path members */
+#define BGP_UPDGRP_MEMO_SLOTS 8
+
+/* Everything about a peer that its outbound policy depends on */
+struct update_group_key {
+	/* set to the peer itself, when its policy can't be shared */
+	struct peer *peer;
+
+	bgp_peer_sort_t sort;
+	as_t as;
+	as_t local_as;
+	as_t change_local_as;
+	u_int32_t flags;
+	u_int32_t af_flags;
+	u_int16_t af_sflags;
+	u_int16_t cap;
+
+	struct in_addr nexthop_v4;
+	struct in6_addr nexthop_v6_global;
+	struct in6_addr nexthop_v6_local;
+	int shared_network;
+
+	/* instance wide settings that end up in the encoding */
+	u_int16_t bgp_config;
+	struct in_addr router_id;
+	struct in_addr cluster_id;
+	as_t confed_id;
+
+	/* whether members are sent all the paths they get, with Add-Path */
+	int addpath_tx;
+
+	/* outbound filter names, compared by value */
+	char *dlist;
+	char *plist;
+	char *aslist;
+	char *rmap;
+	char *usmap;
+};
+
+struct update_group_encode {
+	struct attr *attr; /* interned, holds a reference */
+	int from_ibgp;
+	struct in_addr from_id;
+	bgp_size_t len;
+	u_char *data;
+};
+
+struct update_group_memo {
+	struct bgp_info *ri;
+	int result;
+	struct attr *attr; /* interned, holds a reference */
+};
+
+struct update_group {
+	struct bgp *bgp;
+	afi_t afi;
+	safi_t safi;
+	unsigned int id;
+
+	struct update_group_key key;
+
+	/* Established member peers */
+	struct list *peers;
+
+	/* Member indices in use, and the words needed to hold them */
+	u_int32_t *index_used;
+	u_int16_t index_words;
+
+	/* Result of the outbound policy for the route currently being
+	 * processed, see bgp_updgrp_memo_begin() */
+	unsigned long memo_seq;
+	struct update_group_memo memo[BGP_UPDGRP_MEMO_SLOTS];
+	unsigned int memo_count;
+
+	struct update_group_encode encode[BGP_UPDGRP_ENCODE_SLOTS];
+
+	/* Statistics */
+	unsigned long memo_hits;
+	unsigned long memo_misses;
+	unsigned long encode_hits;
+	unsigned long encode_misses;
+};
+
+extern void bgp_updgrp_init(void);
+extern void bgp_updgrp_finish(struct bgp *);
+
+/* Group of an Established peer, joining or moving it as needed */
+extern struct update_group *bgp_updgrp_peer_get(struct peer *, afi_t, safi_t);
+/* For a peer going down: its part of the shared adj-out is dropped */
+extern void bgp_updgrp_peer_leave(struct peer *, afi_t, safi_t);
+extern void bgp_updgrp_peer_leave_all(struct peer *);
+
+/* Start a new route: memos from the previous one no longer apply */
+extern void bgp_updgrp_memo_begin(void);
+/* Returns -1 if the group hasn't evaluated ri for this route yet, else
+ * the result, with *attr set to the interned attribute on permit. */
+extern int bgp_updgrp_memo_get(struct update_group *, struct bgp_info *ri, struct attr **attr);
+/* Records the result for ri, returning the interned attribute to use */
+extern struct attr *bgp_updgrp_memo_set(struct update_group *, struct bgp_info *ri, int result, struct attr *attr);
+
+/* bgp_packet_attribute(), with the encoding shared across the group */
+extern bgp_size_t bgp_updgrp_packet_attribute(struct peer *, struct stream *, struct attr *, struct prefix *, afi_t, safi_t, struct peer *from, struct prefix_rd *, u_char *tag);
+
+#endif /* _QUAGGA_BGP_UPDGRP_H */
@@ -32,6 +32,9 @@ Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
 #include "memory.h"
 #include "hash.h"
 #include "filter.h"
+#include "routemap.h"
+#include "json.h"
+#include "sockopt.h"
 
 #include "bgpd/bgpd.h"
 #include "bgpd/bgp_advertise.h"
@@ -46,12 +49,15 @@ Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
 #include "bgpd/bgp_mplsvpn.h"
 #include "bgpd/bgp_nexthop.h"
 #include "bgpd/bgp_open.h"
+#include "bgpd/bgp_packet.h"
 #include "bgpd/bgp_regex.h"
 #include "bgpd/bgp_route.h"
 #include "bgpd/bgp_zebra.h"
 #include "bgpd/bgp_table.h"
 #include "bgpd/bgp_vty.h"
 #include "bgpd/bgp_mpath.h"
+#include "bgpd/bgp_rmap_cache.h"
+#include "bgpd/bgp_rtc.h"
 
 /* Utility function to get address family from current node.  */
 afi_t bgp_node_afi(struct vty *vty) {
@@ -1098,6 +1104,58 @@ DEFUN(no_bgp_network_import_check, no_bgp_network_import_check_cmd, "no bgp netw
 	return CMD_SUCCESS;
 }
 
+/* "bgp nexthop-group" configuration.  */
+DEFUN(bgp_nexthop_group, bgp_nexthop_group_cmd, "bgp nexthop-group",
+      "BGP specific commands\n"
+      "Install routes in zebra through a nexthop group per BGP nexthop\n") {
+	struct bgp *bgp;
+
+	bgp = vty->index;
+	bgp_flag_set(bgp, BGP_FLAG_NEXTHOP_GROUP);
+	return CMD_SUCCESS;
+}
+
+DEFUN(no_bgp_nexthop_group, no_bgp_nexthop_group_cmd, "no bgp nexthop-group",
+      NO_STR "BGP specific commands\n"
+	     "Install routes in zebra through a nexthop group per BGP nexthop\n") {
+	struct bgp *bgp;
+
+	bgp = vty->index;
+	bgp_flag_unset(bgp, BGP_FLAG_NEXTHOP_GROUP);
+	return CMD_SUCCESS;
+}
+
+/* "bgp route-server shared-rib" configuration.  */
+DEFUN(bgp_rsclient_shared, bgp_rsclient_shared_cmd, "bgp route-server shared-rib",
+      "BGP specific commands\n"
+      "Route server\n"
+      "Keep one table of paths for all route-server clients\n") {
+	struct bgp *bgp;
+
+	bgp = vty->index;
+	if(listcount(bgp->rsclient)) {
+		vty_out(vty, "%% Remove the route-server clients first%s", VTY_NEWLINE);
+		return CMD_WARNING;
+	}
+	bgp_flag_set(bgp, BGP_FLAG_RSCLIENT_SHARED);
+	return CMD_SUCCESS;
+}
+
+DEFUN(no_bgp_rsclient_shared, no_bgp_rsclient_shared_cmd, "no bgp route-server shared-rib",
+      NO_STR "BGP specific commands\n"
+	     "Route server\n"
+	     "Keep one table of paths for all route-server clients\n") {
+	struct bgp *bgp;
+
+	bgp = vty->index;
+	if(listcount(bgp->rsclient)) {
+		vty_out(vty, "%% Remove the route-server clients first%s", VTY_NEWLINE);
+		return CMD_WARNING;
+	}
+	bgp_flag_unset(bgp, BGP_FLAG_RSCLIENT_SHARED);
+	return CMD_SUCCESS;
+}
+
 DEFUN(bgp_default_local_preference, bgp_default_local_preference_cmd, "bgp default local-preference <0-4294967295>",
       "BGP specific commands\n"
       "Configure BGP defaults\n"
@@ -1132,6 +1190,79 @@ ALIAS(no_bgp_default_local_preference, no_bgp_default_local_preference_val_cmd,
 	     "local preference (higher=more preferred)\n"
 	     "Configure default local preference value\n")
 
+DEFUN(bgp_announce_pace, bgp_announce_pace_cmd, "bgp announce-pace <1-1000000>",
+      "BGP specific commands\n"
+      "Pace of table walks announcing routes to a peer\n"
+      "Route nodes per walk run\n") {
+	struct bgp *bgp;
+
+	bgp = vty->index;
+
+	VTY_GET_INTEGER_RANGE("announce pace", bgp->announce_pace, argv[0], 1, 1000000);
+
+	return CMD_SUCCESS;
+}
+
+DEFUN(no_bgp_announce_pace, no_bgp_announce_pace_cmd, "no bgp announce-pace",
+      NO_STR "BGP specific commands\n"
+	     "Pace of table walks announcing routes to a peer\n") {
+	struct bgp *bgp;
+
+	bgp = vty->index;
+	bgp->announce_pace = BGP_ANNOUNCE_PACE_DEFAULT;
+	return CMD_SUCCESS;
+}
+
+ALIAS(no_bgp_announce_pace, no_bgp_announce_pace_val_cmd, "no bgp announce-pace <1-1000000>",
+      NO_STR "BGP specific commands\n"
+	     "Pace of table walks announcing routes to a peer\n"
+	     "Route nodes per walk run\n")
+
+DEFUN(bgp_update_delay, bgp_update_delay_cmd, "bgp update-delay <0-3600>",
+      "BGP specific commands\n"
+      "Hold best path selection at startup until the peers sent their tables\n"
+      "Seconds to hold it at most, 0 not to\n") {
+	struct bgp *bgp;
+	u_int16_t delay, wait = 0;
+
+	bgp = vty->index;
+
+	VTY_GET_INTEGER_RANGE("update delay", delay, argv[0], 0, 3600);
+	if(argc > 1) {
+		VTY_GET_INTEGER_RANGE("establish wait", wait, argv[1], 1, 3600);
+		if(wait > delay) {
+			vty_out(vty, "%% The establish wait cannot be longer than the update delay%s", VTY_NEWLINE);
+			return CMD_WARNING;
+		}
+	}
+	bgp->v_update_delay = delay;
+	bgp->v_establish_wait = wait;
+
+	return CMD_SUCCESS;
+}
+
+ALIAS(bgp_update_delay, bgp_update_delay_establish_wait_cmd, "bgp update-delay <0-3600> <1-3600>",
+      "BGP specific commands\n"
+      "Hold best path selection at startup until the peers sent their tables\n"
+      "Seconds to hold it at most, 0 not to\n"
+      "Seconds after which only the peers that are up are waited for\n")
+
+DEFUN(no_bgp_update_delay, no_bgp_update_delay_cmd, "no bgp update-delay",
+      NO_STR "BGP specific commands\n"
+	     "Hold best path selection at startup until the peers sent their tables\n") {
+	struct bgp *bgp;
+
+	bgp = vty->index;
+	bgp->v_update_delay = 0;
+	bgp->v_establish_wait = 0;
+	return CMD_SUCCESS;
+}
+
+ALIAS(no_bgp_update_delay, no_bgp_update_delay_val_cmd, "no bgp update-delay <0-3600>",
+      NO_STR "BGP specific commands\n"
+	     "Hold best path selection at startup until the peers sent their tables\n"
+	     "Seconds to hold it at most, 0 not to\n")
+
 static void peer_announce_routes_if_rmap_out(struct bgp *bgp) {
 	struct peer *peer;
 	struct listnode *node, *nnode;
@@ -1579,7 +1710,29 @@ DEFUN(no_neighbor_capability_dynamic, no_neighbor_capability_dynamic_cmd, NO_NEI
 	return peer_flag_unset_vty(vty, argv[0], PEER_FLAG_DYNAMIC_CAPABILITY);
 }
 
+/* neighbor capability extended-message. */
+DEFUN(neighbor_capability_extended_message, neighbor_capability_extended_message_cmd, NEIGHBOR_CMD2 "capability extended-message",
+      NEIGHBOR_STR NEIGHBOR_ADDR_STR2 "Advertise capability to the peer\n"
+				      "Advertise extended message capability to this neighbor\n") {
+	return peer_flag_set_vty(vty, argv[0], PEER_FLAG_EXTENDED_MESSAGE);
+}
+
+DEFUN(no_neighbor_capability_extended_message, no_neighbor_capability_extended_message_cmd, NO_NEIGHBOR_CMD2 "capability extended-message",
+      NO_STR NEIGHBOR_STR NEIGHBOR_ADDR_STR2 "Advertise capability to the peer\n"
+					     "Advertise extended message capability to this neighbor\n") {
+	return peer_flag_unset_vty(vty, argv[0], PEER_FLAG_EXTENDED_MESSAGE);
+}
+
 /* neighbor dont-capability-negotiate */
+/* neighbor bfd. */
+DEFUN(neighbor_bfd, neighbor_bfd_cmd, NEIGHBOR_CMD2 "bfd", NEIGHBOR_STR NEIGHBOR_ADDR_STR2 "Detect the neighbour going down with BFD\n") {
+	return peer_flag_set_vty(vty, argv[0], PEER_FLAG_BFD);
+}
+
+DEFUN(no_neighbor_bfd, no_neighbor_bfd_cmd, NO_NEIGHBOR_CMD2 "bfd", NO_STR NEIGHBOR_STR NEIGHBOR_ADDR_STR2 "Detect the neighbour going down with BFD\n") {
+	return peer_flag_unset_vty(vty, argv[0], PEER_FLAG_BFD);
+}
+
 DEFUN(neighbor_dont_capability_negotiate, neighbor_dont_capability_negotiate_cmd, NEIGHBOR_CMD2 "dont-capability-negotiate", NEIGHBOR_STR NEIGHBOR_ADDR_STR2 "Do not perform capability negotiation\n") {
 	return peer_flag_set_vty(vty, argv[0], PEER_FLAG_DONT_CAPABILITY);
 }
@@ -1686,6 +1839,52 @@ DEFUN(no_neighbor_nexthop_self, no_neighbor_nexthop_self_cmd, NO_NEIGHBOR_CMD2 "
 	return peer_af_flag_unset_vty(vty, argv[0], bgp_node_afi(vty), bgp_node_safi(vty), PEER_FLAG_NEXTHOP_SELF | PEER_FLAG_NEXTHOP_SELF_ALL);
 }
 
+/* neighbor addpath-receive, addpath-tx-all-paths and addpath-tx-multipath. */
+DEFUN(neighbor_addpath_receive, neighbor_addpath_receive_cmd, NEIGHBOR_CMD2 "addpath-receive", NEIGHBOR_STR NEIGHBOR_ADDR_STR2 "Accept any number of paths for a prefix from this neighbor, using Add-Path\n") {
+	return peer_af_flag_set_vty(vty, argv[0], bgp_node_afi(vty), bgp_node_safi(vty), PEER_FLAG_ADDPATH_RX);
+}
+
+DEFUN(no_neighbor_addpath_receive, no_neighbor_addpath_receive_cmd, NO_NEIGHBOR_CMD2 "addpath-receive", NO_STR NEIGHBOR_STR NEIGHBOR_ADDR_STR2 "Accept any number of paths for a prefix from this neighbor, using Add-Path\n") {
+	return peer_af_flag_unset_vty(vty, argv[0], bgp_node_afi(vty), bgp_node_safi(vty), PEER_FLAG_ADDPATH_RX);
+}
+
+DEFUN(neighbor_addpath_tx_all_paths, neighbor_addpath_tx_all_paths_cmd, NEIGHBOR_CMD2 "addpath-tx-all-paths", NEIGHBOR_STR NEIGHBOR_ADDR_STR2 "Send all usable paths for a prefix to this neighbor, using Add-Path\n") {
+	int rc;
+
+	rc = peer_af_flag_unset_vty(vty, argv[0], bgp_node_afi(vty), bgp_node_safi(vty), PEER_FLAG_ADDPATH_TX_MULTIPATH);
+	if(rc == CMD_SUCCESS) {
+		rc = peer_af_flag_set_vty(vty, argv[0], bgp_node_afi(vty), bgp_node_safi(vty), PEER_FLAG_ADDPATH_TX_ALL_PATHS);
+	}
+	return rc;
+}
+
+DEFUN(no_neighbor_addpath_tx_all_paths, no_neighbor_addpath_tx_all_paths_cmd, NO_NEIGHBOR_CMD2 "addpath-tx-all-paths", NO_STR NEIGHBOR_STR NEIGHBOR_ADDR_STR2 "Send all usable paths for a prefix to this neighbor, using Add-Path\n") {
+	return peer_af_flag_unset_vty(vty, argv[0], bgp_node_afi(vty), bgp_node_safi(vty), PEER_FLAG_ADDPATH_TX_ALL_PATHS);
+}
+
+DEFUN(neighbor_addpath_tx_multipath, neighbor_addpath_tx_multipath_cmd, NEIGHBOR_CMD2 "addpath-tx-multipath", NEIGHBOR_STR NEIGHBOR_ADDR_STR2 "Send the best path and its multipaths to this neighbor, using Add-Path\n") {
+	int rc;
+
+	rc = peer_af_flag_unset_vty(vty, argv[0], bgp_node_afi(vty), bgp_node_safi(vty), PEER_FLAG_ADDPATH_TX_ALL_PATHS);
+	if(rc == CMD_SUCCESS) {
+		rc = peer_af_flag_set_vty(vty, argv[0], bgp_node_afi(vty), bgp_node_safi(vty), PEER_FLAG_ADDPATH_TX_MULTIPATH);
+	}
+	return rc;
+}
+
+DEFUN(no_neighbor_addpath_tx_multipath, no_neighbor_addpath_tx_multipath_cmd, NO_NEIGHBOR_CMD2 "addpath-tx-multipath", NO_STR NEIGHBOR_STR NEIGHBOR_ADDR_STR2 "Send the best path and its multipaths to this neighbor, using Add-Path\n") {
+	return peer_af_flag_unset_vty(vty, argv[0], bgp_node_afi(vty), bgp_node_safi(vty), PEER_FLAG_ADDPATH_TX_MULTIPATH);
+}
+
+/* neighbor route-target-constrain. */
+DEFUN(neighbor_rt_constrain, neighbor_rt_constrain_cmd, NEIGHBOR_CMD2 "route-target-constrain", NEIGHBOR_STR NEIGHBOR_ADDR_STR2 "Send this neighbor only the VPN routes whose route targets it asks for (RFC 4684)\n") {
+	return peer_af_flag_set_vty(vty, argv[0], bgp_node_afi(vty), bgp_node_safi(vty), PEER_FLAG_RT_CONSTRAIN);
+}
+
+DEFUN(no_neighbor_rt_constrain, no_neighbor_rt_constrain_cmd, NO_NEIGHBOR_CMD2 "route-target-constrain", NO_STR NEIGHBOR_STR NEIGHBOR_ADDR_STR2 "Send this neighbor only the VPN routes whose route targets it asks for (RFC 4684)\n") {
+	return peer_af_flag_unset_vty(vty, argv[0], bgp_node_afi(vty), bgp_node_safi(vty), PEER_FLAG_RT_CONSTRAIN);
+}
+
 /* neighbor remove-private-AS. */
 DEFUN(neighbor_remove_private_as, neighbor_remove_private_as_cmd, NEIGHBOR_CMD2 "remove-private-AS", NEIGHBOR_STR NEIGHBOR_ADDR_STR2 "Remove private AS number from outbound updates\n") {
 	return peer_af_flag_set_vty(vty, argv[0], bgp_node_afi(vty), bgp_node_safi(vty), PEER_FLAG_REMOVE_PRIVATE_AS);
@@ -1815,6 +2014,7 @@ static int peer_rsclient_set_vty(struct vty *vty, const char *peer_str, int afi,
 	peer->rib[afi][safi]->type = BGP_TABLE_RSCLIENT;
 	/* RIB peer reference.  Released when table is free'd in bgp_table_free. */
 	peer->rib[afi][safi]->owner = peer_lock(peer);
+	bgp_rsclient_shared_join(peer, afi, safi);
 
 	/* Check for existing 'network' and 'redistribute' routes. */
 	bgp_check_local_routes_rsclient(peer, afi, safi);
@@ -1906,6 +2106,7 @@ static int peer_rsclient_unset_vty(struct vty *vty, const char *peer_str, int af
 		peer_unlock(peer); /* peer bgp rsclient reference */
 	}
 
+	bgp_rsclient_shared_leave(peer, afi, safi);
 	bgp_table_finish(&peer->rib[bgp_node_afi(vty)][bgp_node_safi(vty)]);
 
 	return CMD_SUCCESS;
@@ -2414,6 +2615,46 @@ ALIAS(no_neighbor_weight, no_neighbor_weight_val_cmd, NO_NEIGHBOR_CMD2 "weight <
       NO_STR NEIGHBOR_STR NEIGHBOR_ADDR_STR2 "Set default weight for routes from this neighbor\n"
 					     "default weight\n")
 
+/* neighbor socket-buffer. */
+static int peer_socket_buffer_vty(struct vty *vty, const char *ip_str, const char *dir_str, const char *size_str) {
+	struct peer *peer;
+	u_int32_t size;
+
+	peer = peer_and_group_lookup_vty(vty, ip_str);
+	if(!peer) {
+		return CMD_WARNING;
+	}
+
+	if(!size_str) {
+		return bgp_vty_return(vty, peer_socket_buffer_unset(peer, dir_str[0] == 's'));
+	}
+
+	VTY_GET_INTEGER_RANGE("socket buffer size", size, size_str, 4096, 67108864);
+
+	return bgp_vty_return(vty, peer_socket_buffer_set(peer, dir_str[0] == 's', size));
+}
+
+DEFUN(neighbor_socket_buffer, neighbor_socket_buffer_cmd, NEIGHBOR_CMD2 "socket-buffer (send|receive) <4096-67108864>",
+      NEIGHBOR_STR NEIGHBOR_ADDR_STR2 "Size the session's TCP socket buffers\n"
+				      "Send buffer\n"
+				      "Receive buffer\n"
+				      "Size in bytes\n") {
+	return peer_socket_buffer_vty(vty, argv[0], argv[1], argv[2]);
+}
+
+DEFUN(no_neighbor_socket_buffer, no_neighbor_socket_buffer_cmd, NO_NEIGHBOR_CMD2 "socket-buffer (send|receive)",
+      NO_STR NEIGHBOR_STR NEIGHBOR_ADDR_STR2 "Size the session's TCP socket buffers\n"
+					     "Send buffer\n"
+					     "Receive buffer\n") {
+	return peer_socket_buffer_vty(vty, argv[0], argv[1], NULL);
+}
+
+ALIAS(no_neighbor_socket_buffer, no_neighbor_socket_buffer_val_cmd, NO_NEIGHBOR_CMD2 "socket-buffer (send|receive) <4096-67108864>",
+      NO_STR NEIGHBOR_STR NEIGHBOR_ADDR_STR2 "Size the session's TCP socket buffers\n"
+					     "Send buffer\n"
+					     "Receive buffer\n"
+					     "Size in bytes\n")
+
 /* Override capability negotiation. */
 DEFUN(neighbor_override_capability, neighbor_override_capability_cmd, NEIGHBOR_CMD2 "override-capability", NEIGHBOR_STR NEIGHBOR_ADDR_STR2 "Override capability negotiation result\n") {
 	return peer_flag_set_vty(vty, argv[0], PEER_FLAG_OVERRIDE_CAPABILITY);
@@ -3361,11 +3602,7 @@ static int bgp_clear_prefix(struct vty *vty, char *view_name, const char *ip_str
 	rib = bgp->rib[afi][safi];
 
 	if(safi == SAFI_MPLS_VPN) {
-		for(rn = bgp_table_top(rib); rn; rn = bgp_route_next(rn)) {
-			if(prd && memcmp(rn->p.u.val, prd->val, 8) != 0) {
-				continue;
-			}
-
+		for(rn = bgp_rd_top(rib, prd); rn; rn = bgp_rd_next(rn, prd)) {
 			if((table = rn->info) != NULL) {
 				if((rm = bgp_node_match(table, &match)) != NULL) {
 					if(rm->p.prefixlen == match.prefixlen) {
@@ -4624,6 +4861,12 @@ DEFUN(show_bgp_memory, show_bgp_memory_cmd, "show bgp memory", SHOW_STR BGP_STR
 	if((count = mtype_stats_alloc(MTYPE_BGP_ROUTE_EXTRA))) {
 		vty_out(vty, "%ld BGP route ancillaries, using %s of memory%s", count, mtype_memstr(memstrbuf, sizeof(memstrbuf), count * sizeof(struct bgp_info_extra)), VTY_NEWLINE);
 	}
+	if((count = mtype_stats_alloc(MTYPE_BGP_MPATH_INFO))) {
+		vty_out(vty, "%ld BGP multipath entries, using %s of memory%s", count, mtype_memstr(memstrbuf, sizeof(memstrbuf), count * sizeof(struct bgp_info_mpath)), VTY_NEWLINE);
+	}
+	if((count = mtype_stats_alloc(MTYPE_BGP_TABLE))) {
+		vty_out(vty, "%ld BGP tables, using %s of memory%s", count, mtype_memstr(memstrbuf, sizeof(memstrbuf), count * sizeof(struct bgp_table)), VTY_NEWLINE);
+	}
 
 	if((count = mtype_stats_alloc(MTYPE_BGP_STATIC))) {
 		vty_out(vty, "%ld Static routes, using %s of memory%s", count, mtype_memstr(memstrbuf, sizeof(memstrbuf), count * sizeof(struct bgp_static)), VTY_NEWLINE);
@@ -4636,6 +4879,9 @@ DEFUN(show_bgp_memory, show_bgp_memory_cmd, "show bgp memory", SHOW_STR BGP_STR
 	if((count = mtype_stats_alloc(MTYPE_BGP_ADJ_OUT))) {
 		vty_out(vty, "%ld Adj-Out entries, using %s of memory%s", count, mtype_memstr(memstrbuf, sizeof(memstrbuf), count * sizeof(struct bgp_adj_out)), VTY_NEWLINE);
 	}
+	if((count = mtype_stats_alloc(MTYPE_BGP_ADJ_SHARED))) {
+		vty_out(vty, "%ld shared Adj-Out entries, using %s of memory%s", count, mtype_memstr(memstrbuf, sizeof(memstrbuf), count * sizeof(struct bgp_adj_shared)), VTY_NEWLINE);
+	}
 
 	if((count = mtype_stats_alloc(MTYPE_BGP_NEXTHOP_CACHE))) {
 		vty_out(vty, "%ld Nexthop cache entries, using %s of memory%s", count, mtype_memstr(memstrbuf, sizeof(memstrbuf), count * sizeof(struct bgp_nexthop_cache)), VTY_NEWLINE);
@@ -4693,7 +4939,7 @@ DEFUN(show_bgp_memory, show_bgp_memory_cmd, "show bgp memory", SHOW_STR BGP_STR
 		vty_out(vty, "%ld hash buckets, using %s of memory%s", count, mtype_memstr(memstrbuf, sizeof(memstrbuf), count * sizeof(struct hash_backet)), VTY_NEWLINE);
 	}
 	if((count = mtype_stats_alloc(MTYPE_BGP_REGEXP))) {
-		vty_out(vty, "%ld compiled regexes, using %s of memory%s", count, mtype_memstr(memstrbuf, sizeof(memstrbuf), count * sizeof(regex_t)), VTY_NEWLINE);
+		vty_out(vty, "%ld compiled regexes, using %s of memory%s", count, mtype_memstr(memstrbuf, sizeof(memstrbuf), count * sizeof(struct bgp_regex)), VTY_NEWLINE);
 	}
 	return CMD_SUCCESS;
 }
@@ -4719,6 +4965,9 @@ static int bgp_show_summary(struct vty *vty, struct bgp *bgp, int afi, int safi)
 
 				/* Usage summary and header */
 				vty_out(vty, "BGP router identifier %s, local AS number %u%s", inet_ntoa(bgp->router_id), bgp->as, VTY_NEWLINE);
+				if(bgp->update_delay_pending) {
+					vty_out(vty, "Read-only mode: update delay in progress, %lu seconds left%s", thread_timer_remain_second(bgp->t_update_delay), VTY_NEWLINE);
+				}
 
 				ents = bgp_table_count(bgp->rib[afi][safi]);
 				vty_out(vty, "RIB entries %ld, using %s of memory%s", ents, mtype_memstr(memstrbuf, sizeof(memstrbuf), ents * sizeof(struct bgp_node)), VTY_NEWLINE);
@@ -4787,7 +5036,54 @@ static int bgp_show_summary(struct vty *vty, struct bgp *bgp, int afi, int safi)
 	return CMD_SUCCESS;
 }
 
-static int bgp_show_summary_vty(struct vty *vty, const char *name, afi_t afi, safi_t safi) {
+/* Show BGP peer's summary information as JSON. */
+static void bgp_show_summary_json(struct vty *vty, struct bgp *bgp, int afi, int safi) {
+	struct json_out json;
+	struct json_out *j = &json;
+	struct peer *peer;
+	struct listnode *node, *nnode;
+
+	json_out_init(j, vty);
+	json_out_object(j, NULL);
+	json_out_in_addr(j, "routerId", bgp->router_id);
+	json_out_uint(j, "as", bgp->as);
+	json_out_uint(j, "ribCount", bgp_table_count(bgp->rib[afi][safi]));
+	json_out_bool(j, "dampening", CHECK_FLAG(bgp->af_flags[afi][safi], BGP_CONFIG_DAMPENING));
+
+	json_out_array(j, "peers");
+	for(ALL_LIST_ELEMENTS(bgp->peer, node, nnode, peer)) {
+		if(!peer->afc[afi][safi]) {
+			continue;
+		}
+
+		json_out_object(j, NULL);
+		json_out_str(j, "neighbor", peer->host);
+		json_out_uint(j, "remoteAs", peer->as);
+		json_out_uint(j, "msgRcvd", peer->open_in + peer->update_in + peer->keepalive_in + peer->notify_in + peer->refresh_in + peer->dynamic_cap_in);
+		json_out_uint(j, "msgSent", peer->open_out + peer->update_out + peer->keepalive_out + peer->notify_out + peer->refresh_out + peer->dynamic_cap_out);
+		json_out_uint(j, "outq", peer->sync[afi][safi]->update.count + peer->sync[afi][safi]->withdraw.count);
+		if(peer->uptime) {
+			json_out_int(j, "uptime", bgp_clock() - peer->uptime);
+		} else {
+			json_out_null(j, "uptime");
+		}
+		json_out_str(j, "state", LOOKUP(bgp_status_msg, peer->status));
+		if(peer->status == Established) {
+			json_out_uint(j, "prefixReceived", peer->pcount[afi][safi]);
+		} else if(CHECK_FLAG(peer->flags, PEER_FLAG_SHUTDOWN)) {
+			json_out_bool(j, "adminShutdown", 1);
+		} else if(CHECK_FLAG(peer->sflags, PEER_STATUS_PREFIX_OVERFLOW)) {
+			json_out_bool(j, "prefixOverflow", 1);
+		}
+		json_out_object_end(j);
+	}
+	json_out_array_end(j);
+
+	json_out_object_end(j);
+	json_out_finish(j);
+}
+
+static int bgp_show_summary_common(struct vty *vty, const char *name, afi_t afi, safi_t safi, int use_json) {
 	struct bgp *bgp;
 
 	if(name) {
@@ -4798,24 +5094,50 @@ static int bgp_show_summary_vty(struct vty *vty, const char *name, afi_t afi, sa
 			return CMD_WARNING;
 		}
 
-		bgp_show_summary(vty, bgp, afi, safi);
+		if(use_json) {
+			bgp_show_summary_json(vty, bgp, afi, safi);
+		} else {
+			bgp_show_summary(vty, bgp, afi, safi);
+		}
 		return CMD_SUCCESS;
 	}
 
 	bgp = bgp_get_default();
 
 	if(bgp) {
-		bgp_show_summary(vty, bgp, afi, safi);
+		if(use_json) {
+			bgp_show_summary_json(vty, bgp, afi, safi);
+		} else {
+			bgp_show_summary(vty, bgp, afi, safi);
+		}
 	}
 
 	return CMD_SUCCESS;
 }
 
+static int bgp_show_summary_vty(struct vty *vty, const char *name, afi_t afi, safi_t safi) {
+	return bgp_show_summary_common(vty, name, afi, safi, 0);
+}
+
 /* `show ip bgp summary' commands. */
 DEFUN(show_ip_bgp_summary, show_ip_bgp_summary_cmd, "show ip bgp summary", SHOW_STR IP_STR BGP_STR "Summary of BGP neighbor status\n") {
 	return bgp_show_summary_vty(vty, NULL, AFI_IP, SAFI_UNICAST);
 }
 
+DEFUN(show_ip_bgp_summary_json, show_ip_bgp_summary_json_cmd, "show ip bgp summary json",
+      SHOW_STR IP_STR BGP_STR "Summary of BGP neighbor status\n"
+			      "JavaScript Object Notation\n") {
+	return bgp_show_summary_common(vty, NULL, AFI_IP, SAFI_UNICAST, 1);
+}
+
+DEFUN(show_ip_bgp_instance_summary_json, show_ip_bgp_instance_summary_json_cmd, "show ip bgp view WORD summary json",
+      SHOW_STR IP_STR BGP_STR "BGP view\n"
+			      "View name\n"
+			      "Summary of BGP neighbor status\n"
+			      "JavaScript Object Notation\n") {
+	return bgp_show_summary_common(vty, argv[0], AFI_IP, SAFI_UNICAST, 1);
+}
+
 DEFUN(show_ip_bgp_instance_summary, show_ip_bgp_instance_summary_cmd, "show ip bgp view WORD summary",
       SHOW_STR IP_STR BGP_STR "BGP view\n"
 			      "View name\n"
@@ -5368,6 +5690,18 @@ static void bgp_show_peer_afi(struct vty *vty, struct peer *p, afi_t afi, safi_t
 	/* Receive prefix count */
 	vty_out(vty, "  %ld accepted prefixes%s", p->pcount[afi][safi], VTY_NEWLINE);
 
+	/* Route changes not yet sent */
+	if(p->sync[afi][safi] && (p->sync[afi][safi]->update.count || p->sync[afi][safi]->withdraw.count || p->sync[afi][safi]->withdraw_low.count)) {
+		vty_out(vty, "  %u announcements and %u withdrawals queued%s", p->sync[afi][safi]->update.count, p->sync[afi][safi]->withdraw.count + p->sync[afi][safi]->withdraw_low.count, VTY_NEWLINE);
+	}
+
+	/* Announce walk */
+	if(p->announce_walk[afi][safi]) {
+		struct bgp_announce_walk *walk = p->announce_walk[afi][safi];
+
+		vty_out(vty, "  Announcing %s table, %lu of %lu nodes walked%s", walk->rsclient ? "route-server client" : "main", walk->walked, walk->total, VTY_NEWLINE);
+	}
+
 	/* Maximum prefix */
 	if(CHECK_FLAG(p->af_flags[afi][safi], PEER_FLAG_MAX_PREFIX)) {
 		vty_out(vty, "  Maximum prefixes allowed %ld%s%s", p->pmax[afi][safi], CHECK_FLAG(p->af_flags[afi][safi], PEER_FLAG_MAX_PREFIX_WARNING) ? " (warning-only)" : "", VTY_NEWLINE);
@@ -5381,8 +5715,30 @@ static void bgp_show_peer_afi(struct vty *vty, struct peer *p, afi_t afi, safi_t
 	vty_out(vty, "%s", VTY_NEWLINE);
 }
 
+static void bgp_show_peer_lag(struct vty *vty, const char *what, struct peer_lag *lag) {
+	u_int32_t average = peer_lag_average(lag);
+
+	vty_out(vty, "    %-15s %6u.%03u %6u.%03u %6u.%03u%s", what, lag->last / 1000, lag->last % 1000, average / 1000, average % 1000, lag->max / 1000, lag->max % 1000, VTY_NEWLINE);
+}
+
+/* One direction of the Add-Path capability for an AFI/SAFI */
+static void bgp_show_peer_addpath(struct vty *vty, const char *what, int adv, int rcv, int *shown) {
+	if(!adv && !rcv) {
+		return;
+	}
+	vty_out(vty, "%s %s", *shown ? "," : "", what);
+	if(adv) {
+		vty_out(vty, " advertised");
+	}
+	if(rcv) {
+		vty_out(vty, " %sreceived", adv ? "and " : "");
+	}
+	(*shown)++;
+}
+
 static void bgp_show_peer(struct vty *vty, struct peer *p) {
 	struct bgp *bgp;
+	struct bgp_queue_depth depth;
 	char buf1[BUFSIZ];
 	char timebuf[BGP_UPTIME_LEN];
 	afi_t afi;
@@ -5474,6 +5830,17 @@ static void bgp_show_peer(struct vty *vty, struct peer *p) {
 				}
 				vty_out(vty, "%s", VTY_NEWLINE);
 			}
+			/* Extended message */
+			if(CHECK_FLAG(p->cap, PEER_CAP_EXTENDED_MSG_RCV) || CHECK_FLAG(p->cap, PEER_CAP_EXTENDED_MSG_ADV)) {
+				vty_out(vty, "    Extended message:");
+				if(CHECK_FLAG(p->cap, PEER_CAP_EXTENDED_MSG_ADV)) {
+					vty_out(vty, " advertised");
+				}
+				if(CHECK_FLAG(p->cap, PEER_CAP_EXTENDED_MSG_RCV)) {
+					vty_out(vty, " %sreceived", CHECK_FLAG(p->cap, PEER_CAP_EXTENDED_MSG_ADV) ? "and " : "");
+				}
+				vty_out(vty, "%s", VTY_NEWLINE);
+			}
 
 			/* Route Refresh */
 			if(CHECK_FLAG(p->cap, PEER_CAP_REFRESH_ADV) || CHECK_FLAG(p->cap, PEER_CAP_REFRESH_NEW_RCV) || CHECK_FLAG(p->cap, PEER_CAP_REFRESH_OLD_RCV)) {
@@ -5507,6 +5874,37 @@ static void bgp_show_peer(struct vty *vty, struct peer *p) {
 				}
 			}
 
+			/* Add-Path */
+			for(afi = AFI_IP; afi < AFI_MAX; afi++) {
+				for(safi = SAFI_UNICAST; safi < SAFI_MAX; safi++) {
+					u_int16_t cap = p->af_cap[afi][safi];
+					int shown = 0;
+
+					if(!CHECK_FLAG(cap, PEER_CAP_ADDPATH_AF_TX_ADV | PEER_CAP_ADDPATH_AF_RX_ADV | PEER_CAP_ADDPATH_AF_TX_RCV | PEER_CAP_ADDPATH_AF_RX_RCV)) {
+						continue;
+					}
+					vty_out(vty, "    Add-Path %s:", afi_safi_print(afi, safi));
+					bgp_show_peer_addpath(vty, "send", CHECK_FLAG(cap, PEER_CAP_ADDPATH_AF_TX_ADV), CHECK_FLAG(cap, PEER_CAP_ADDPATH_AF_TX_RCV), &shown);
+					bgp_show_peer_addpath(vty, "receive", CHECK_FLAG(cap, PEER_CAP_ADDPATH_AF_RX_ADV), CHECK_FLAG(cap, PEER_CAP_ADDPATH_AF_RX_RCV), &shown);
+					vty_out(vty, "%s", VTY_NEWLINE);
+				}
+			}
+
+			/* Route target constrain */
+			if(CHECK_FLAG(p->af_cap[AFI_IP][SAFI_MPLS_VPN], PEER_CAP_RTC_ADV | PEER_CAP_RTC_RCV)) {
+				vty_out(vty, "    Route target constrain:");
+				if(CHECK_FLAG(p->af_cap[AFI_IP][SAFI_MPLS_VPN], PEER_CAP_RTC_ADV)) {
+					vty_out(vty, " advertised");
+				}
+				if(CHECK_FLAG(p->af_cap[AFI_IP][SAFI_MPLS_VPN], PEER_CAP_RTC_RCV)) {
+					vty_out(vty, " %sreceived", CHECK_FLAG(p->af_cap[AFI_IP][SAFI_MPLS_VPN], PEER_CAP_RTC_ADV) ? "and " : "");
+				}
+				if(BGP_RTC_NEGOTIATED(p)) {
+					vty_out(vty, ", %lu memberships", bgp_rtc_count(p));
+				}
+				vty_out(vty, "%s", VTY_NEWLINE);
+			}
+
 			/* Gracefull Restart */
 			if(CHECK_FLAG(p->cap, PEER_CAP_RESTART_RCV) || CHECK_FLAG(p->cap, PEER_CAP_RESTART_ADV)) {
 				vty_out(vty, "    Graceful Restart Capabilty:");
@@ -5582,9 +5980,10 @@ static void bgp_show_peer(struct vty *vty, struct peer *p) {
 	}
 
 	/* Packet counts. */
+	bgp_queue_depth(p, &depth);
 	vty_out(vty, "  Message statistics:%s", VTY_NEWLINE);
-	vty_out(vty, "    Inq depth is 0%s", VTY_NEWLINE);
-	vty_out(vty, "    Outq depth is %lu%s", (unsigned long) p->obuf->count, VTY_NEWLINE);
+	vty_out(vty, "    Inq depth is %lu, %lu bytes unread%s", depth.in_packets, depth.in_bytes, VTY_NEWLINE);
+	vty_out(vty, "    Outq depth is %lu, %lu bytes%s", depth.out_packets, depth.out_bytes, VTY_NEWLINE);
 	vty_out(vty, "                         Sent       Rcvd%s", VTY_NEWLINE);
 	vty_out(vty, "    Opens:         %10d %10d%s", p->open_out, p->open_in, VTY_NEWLINE);
 	vty_out(vty, "    Notifications: %10d %10d%s", p->notify_out, p->notify_in, VTY_NEWLINE);
@@ -5595,6 +5994,13 @@ static void bgp_show_peer(struct vty *vty, struct peer *p) {
 	vty_out(vty, "    Total:         %10d %10d%s", p->open_out + p->notify_out + p->update_out + p->keepalive_out + p->refresh_out + p->dynamic_cap_out,
 		p->open_in + p->notify_in + p->update_in + p->keepalive_in + p->refresh_in + p->dynamic_cap_in, VTY_NEWLINE);
 
+	/* How far behind routes from and to the peer are */
+	if(p->lag_in.count || p->lag_out.count) {
+		vty_out(vty, "  Route lag, msecs:        Last    Average        Max%s", VTY_NEWLINE);
+		bgp_show_peer_lag(vty, "Best path:", &p->lag_in);
+		bgp_show_peer_lag(vty, "Sent:", &p->lag_out);
+	}
+
 	/* advertisement-interval */
 	vty_out(vty, "  Minimum time between advertisement runs is %d seconds%s", p->v_routeadv, VTY_NEWLINE);
 
@@ -5614,6 +6020,11 @@ static void bgp_show_peer(struct vty *vty, struct peer *p) {
 		vty_out(vty, "  Default weight %d%s", p->weight, VTY_NEWLINE);
 	}
 
+	/* Socket buffers, as they are */
+	if(p->fd >= 0 && CHECK_FLAG(p->config, PEER_CONFIG_SNDBUF | PEER_CONFIG_RCVBUF)) {
+		vty_out(vty, "  Socket buffers: send %d, receive %d bytes%s", getsockopt_so_sendbuf(p->fd), getsockopt_so_recvbuf(p->fd), VTY_NEWLINE);
+	}
+
 	vty_out(vty, "%s", VTY_NEWLINE);
 
 	/* Address Family Information */
@@ -6019,6 +6430,9 @@ static int bgp_show_rsclient_summary(struct vty *vty, struct bgp *bgp, afi_t afi
 
 	if(count) {
 		vty_out(vty, "%sTotal number of Route Server Clients %d%s", VTY_NEWLINE, count, VTY_NEWLINE);
+		if(bgp->rs_shared[afi][safi]) {
+			vty_out(vty, "Shared table for %u clients, %lu best path selections for %lu decisions%s", bgp->rs_shared[afi][safi]->clients, bgp->rs_shared[afi][safi]->selections, bgp->rs_shared[afi][safi]->decisions, VTY_NEWLINE);
+		}
 	} else {
 		vty_out(vty, "No %s Route Server Client is configured%s", afi == AFI_IP ? "IPv4" : "IPv6", VTY_NEWLINE);
 	}
@@ -6711,11 +7125,30 @@ void bgp_vty_init(void) {
 	install_element(BGP_NODE, &bgp_network_import_check_cmd);
 	install_element(BGP_NODE, &no_bgp_network_import_check_cmd);
 
+	/* "bgp nexthop-group" commands. */
+	install_element(BGP_NODE, &bgp_nexthop_group_cmd);
+	install_element(BGP_NODE, &no_bgp_nexthop_group_cmd);
+
+	/* "bgp route-server shared-rib" commands. */
+	install_element(BGP_NODE, &bgp_rsclient_shared_cmd);
+	install_element(BGP_NODE, &no_bgp_rsclient_shared_cmd);
+
 	/* "bgp default local-preference" commands. */
 	install_element(BGP_NODE, &bgp_default_local_preference_cmd);
 	install_element(BGP_NODE, &no_bgp_default_local_preference_cmd);
 	install_element(BGP_NODE, &no_bgp_default_local_preference_val_cmd);
 
+	/* "bgp announce-pace" commands. */
+	install_element(BGP_NODE, &bgp_announce_pace_cmd);
+	install_element(BGP_NODE, &no_bgp_announce_pace_cmd);
+	install_element(BGP_NODE, &no_bgp_announce_pace_val_cmd);
+
+	/* "bgp update-delay" commands. */
+	install_element(BGP_NODE, &bgp_update_delay_cmd);
+	install_element(BGP_NODE, &bgp_update_delay_establish_wait_cmd);
+	install_element(BGP_NODE, &no_bgp_update_delay_cmd);
+	install_element(BGP_NODE, &no_bgp_update_delay_val_cmd);
+
 	/* bgp ibgp-allow-policy-mods command */
 	install_element(BGP_NODE, &bgp_rr_allow_outbound_policy_cmd);
 	install_element(BGP_NODE, &no_bgp_rr_allow_outbound_policy_cmd);
@@ -7039,6 +7472,43 @@ void bgp_vty_init(void) {
 	install_element(BGP_ENCAPV6_NODE, &neighbor_nexthop_self_cmd);
 	install_element(BGP_ENCAPV6_NODE, &no_neighbor_nexthop_self_cmd);
 
+	/* "neighbor addpath-*" commands, for the AFI/SAFIs Add-Path is
+	   negotiated for. */
+	install_element(BGP_NODE, &neighbor_addpath_receive_cmd);
+	install_element(BGP_NODE, &no_neighbor_addpath_receive_cmd);
+	install_element(BGP_NODE, &neighbor_addpath_tx_all_paths_cmd);
+	install_element(BGP_NODE, &no_neighbor_addpath_tx_all_paths_cmd);
+	install_element(BGP_NODE, &neighbor_addpath_tx_multipath_cmd);
+	install_element(BGP_NODE, &no_neighbor_addpath_tx_multipath_cmd);
+	install_element(BGP_IPV4_NODE, &neighbor_addpath_receive_cmd);
+	install_element(BGP_IPV4_NODE, &no_neighbor_addpath_receive_cmd);
+	install_element(BGP_IPV4_NODE, &neighbor_addpath_tx_all_paths_cmd);
+	install_element(BGP_IPV4_NODE, &no_neighbor_addpath_tx_all_paths_cmd);
+	install_element(BGP_IPV4_NODE, &neighbor_addpath_tx_multipath_cmd);
+	install_element(BGP_IPV4_NODE, &no_neighbor_addpath_tx_multipath_cmd);
+	install_element(BGP_IPV4M_NODE, &neighbor_addpath_receive_cmd);
+	install_element(BGP_IPV4M_NODE, &no_neighbor_addpath_receive_cmd);
+	install_element(BGP_IPV4M_NODE, &neighbor_addpath_tx_all_paths_cmd);
+	install_element(BGP_IPV4M_NODE, &no_neighbor_addpath_tx_all_paths_cmd);
+	install_element(BGP_IPV4M_NODE, &neighbor_addpath_tx_multipath_cmd);
+	install_element(BGP_IPV4M_NODE, &no_neighbor_addpath_tx_multipath_cmd);
+	install_element(BGP_IPV6_NODE, &neighbor_addpath_receive_cmd);
+	install_element(BGP_IPV6_NODE, &no_neighbor_addpath_receive_cmd);
+	install_element(BGP_IPV6_NODE, &neighbor_addpath_tx_all_paths_cmd);
+	install_element(BGP_IPV6_NODE, &no_neighbor_addpath_tx_all_paths_cmd);
+	install_element(BGP_IPV6_NODE, &neighbor_addpath_tx_multipath_cmd);
+	install_element(BGP_IPV6_NODE, &no_neighbor_addpath_tx_multipath_cmd);
+	install_element(BGP_IPV6M_NODE, &neighbor_addpath_receive_cmd);
+	install_element(BGP_IPV6M_NODE, &no_neighbor_addpath_receive_cmd);
+	install_element(BGP_IPV6M_NODE, &neighbor_addpath_tx_all_paths_cmd);
+	install_element(BGP_IPV6M_NODE, &no_neighbor_addpath_tx_all_paths_cmd);
+	install_element(BGP_IPV6M_NODE, &neighbor_addpath_tx_multipath_cmd);
+	install_element(BGP_IPV6M_NODE, &no_neighbor_addpath_tx_multipath_cmd);
+
+	/* "neighbor route-target-constrain" commands, VPNv4 only. */
+	install_element(BGP_VPNV4_NODE, &neighbor_rt_constrain_cmd);
+	install_element(BGP_VPNV4_NODE, &no_neighbor_rt_constrain_cmd);
+
 	/* "neighbor remove-private-AS" commands. */
 	install_element(BGP_NODE, &neighbor_remove_private_as_cmd);
 	install_element(BGP_NODE, &no_neighbor_remove_private_as_cmd);
@@ -7164,8 +7634,14 @@ void bgp_vty_init(void) {
 	/* "neighbor capability dynamic" commands.*/
 	install_element(BGP_NODE, &neighbor_capability_dynamic_cmd);
 	install_element(BGP_NODE, &no_neighbor_capability_dynamic_cmd);
+	install_element(BGP_NODE, &neighbor_capability_extended_message_cmd);
+	install_element(BGP_NODE, &no_neighbor_capability_extended_message_cmd);
 
 	/* "neighbor dont-capability-negotiate" commands. */
+	/* "neighbor bfd" commands. */
+	install_element(BGP_NODE, &neighbor_bfd_cmd);
+	install_element(BGP_NODE, &no_neighbor_bfd_cmd);
+
 	install_element(BGP_NODE, &neighbor_dont_capability_negotiate_cmd);
 	install_element(BGP_NODE, &no_neighbor_dont_capability_negotiate_cmd);
 
@@ -7222,6 +7698,11 @@ void bgp_vty_init(void) {
 	install_element(BGP_NODE, &no_neighbor_weight_cmd);
 	install_element(BGP_NODE, &no_neighbor_weight_val_cmd);
 
+	/* "neighbor socket-buffer" commands. */
+	install_element(BGP_NODE, &neighbor_socket_buffer_cmd);
+	install_element(BGP_NODE, &no_neighbor_socket_buffer_cmd);
+	install_element(BGP_NODE, &no_neighbor_socket_buffer_val_cmd);
+
 	/* "neighbor override-capability" commands. */
 	install_element(BGP_NODE, &neighbor_override_capability_cmd);
 	install_element(BGP_NODE, &no_neighbor_override_capability_cmd);
@@ -7846,6 +8327,8 @@ void bgp_vty_init(void) {
 
 	/* non afi/safi forms of commands */
 	install_element(VIEW_NODE, &show_ip_bgp_summary_cmd);
+	install_element(VIEW_NODE, &show_ip_bgp_summary_json_cmd);
+	install_element(VIEW_NODE, &show_ip_bgp_instance_summary_json_cmd);
 	install_element(VIEW_NODE, &show_ip_bgp_instance_summary_cmd);
 	install_element(VIEW_NODE, &show_ip_bgp_ipv4_summary_cmd);
 	install_element(VIEW_NODE, &show_ip_bgp_instance_ipv4_summary_cmd);
@@ -7951,6 +8434,7 @@ static int community_list_set_vty(struct vty *vty, int argc, const char **argv,
 	/* When community_list_set() return nevetive value, it means
      malformed community string.  */
 	ret = community_list_set(bgp_clist, argv[0], str, direct, style);
+	bgp_rmap_cache_invalidate(argv[0]);
 
 	/* Free temporary community list string allocated by
      argv_concat().  */
@@ -7990,6 +8474,7 @@ static int community_list_unset_vty(struct vty *vty, int argc, const char **argv
 
 	/* Unset community list.  */
 	ret = community_list_unset(bgp_clist, argv[0], str, direct, style);
+	bgp_rmap_cache_invalidate(argv[0]);
 
 	/* Free temporary community list string allocated by
      argv_concat().  */
@@ -8192,6 +8677,7 @@ static int lcommunity_list_set_vty(struct vty *vty, int argc, const char **argv,
 	}
 
 	ret = lcommunity_list_set(bgp_clist, argv[0], str, direct, style);
+	bgp_rmap_cache_invalidate(argv[0]);
 
 	/* Free temporary community list string allocated by
      argv_concat().  */
@@ -8228,6 +8714,7 @@ static int lcommunity_list_unset_vty(struct vty *vty, int argc, const char **arg
 
 	/* Unset community list.  */
 	ret = lcommunity_list_unset(bgp_clist, argv[0], str, direct, style);
+	bgp_rmap_cache_invalidate(argv[0]);
 
 	/* Free temporary community list string allocated by
      argv_concat().  */
@@ -8427,6 +8914,7 @@ static int extcommunity_list_set_vty(struct vty *vty, int argc, const char **arg
 	}
 
 	ret = extcommunity_list_set(bgp_clist, argv[0], str, direct, style);
+	bgp_rmap_cache_invalidate(argv[0]);
 
 	/* Free temporary community list string allocated by
      argv_concat().  */
@@ -8463,6 +8951,7 @@ static int extcommunity_list_unset_vty(struct vty *vty, int argc, const char **a
 
 	/* Unset community list.  */
 	ret = extcommunity_list_unset(bgp_clist, argv[0], str, direct, style);
+	bgp_rmap_cache_invalidate(argv[0]);
 
 	/* Free temporary community list string allocated by
      argv_concat().  */
@@ -31,6 +31,7 @@ Boston, MA 02111-1307, USA.  */
 #include "routemap.h"
 #include "thread.h"
 #include "filter.h"
+#include "nexthop.h"
 
 #include "bgpd/bgpd.h"
 #include "bgpd/bgp_route.h"
@@ -42,6 +43,7 @@ Boston, MA 02111-1307, USA.  */
 #include "bgpd/bgp_mpath.h"
 #include "bgpd/bgp_nexthop.h"
 #include "bgpd/bgp_nht.h"
+#include "bgpd/bgp_bfd.h"
 
 /* All information about zebra. */
 struct zclient *zclient = NULL;
@@ -100,7 +102,7 @@ static int bgp_interface_delete(int command, struct zclient *zclient, zebra_size
 		return 0;
 	}
 
-	ifp->ifindex = IFINDEX_INTERNAL;
+	if_set_index(ifp, IFINDEX_INTERNAL);
 
 	if(BGP_DEBUG(zebra, ZEBRA)) {
 		zlog_debug("Zebra rcvd: interface delete %s", ifp->name);
@@ -374,97 +376,19 @@ static int zebra_read_ipv6(int command, struct zclient *zclient, zebra_size_t le
 }
 
 struct interface *if_lookup_by_ipv4(struct in_addr *addr) {
-	struct listnode *ifnode;
-	struct listnode *cnode;
-	struct interface *ifp;
-	struct connected *connected;
-	struct prefix_ipv4 p;
-	struct prefix *cp;
-
-	p.family = AF_INET;
-	p.prefix = *addr;
-	p.prefixlen = IPV4_MAX_BITLEN;
-
-	for(ALL_LIST_ELEMENTS_RO(iflist, ifnode, ifp)) {
-		for(ALL_LIST_ELEMENTS_RO(ifp->connected, cnode, connected)) {
-			cp = connected->address;
-
-			if(cp->family == AF_INET) {
-				if(prefix_match(cp, (struct prefix *) &p)) {
-					return ifp;
-				}
-			}
-		}
-	}
-	return NULL;
+	return if_lookup_address(*addr);
 }
 
 struct interface *if_lookup_by_ipv4_exact(struct in_addr *addr) {
-	struct listnode *ifnode;
-	struct listnode *cnode;
-	struct interface *ifp;
-	struct connected *connected;
-	struct prefix *cp;
-
-	for(ALL_LIST_ELEMENTS_RO(iflist, ifnode, ifp)) {
-		for(ALL_LIST_ELEMENTS_RO(ifp->connected, cnode, connected)) {
-			cp = connected->address;
-
-			if(cp->family == AF_INET) {
-				if(IPV4_ADDR_SAME(&cp->u.prefix4, addr)) {
-					return ifp;
-				}
-			}
-		}
-	}
-	return NULL;
+	return if_lookup_exact_address(*addr);
 }
 
 struct interface *if_lookup_by_ipv6(struct in6_addr *addr) {
-	struct listnode *ifnode;
-	struct listnode *cnode;
-	struct interface *ifp;
-	struct connected *connected;
-	struct prefix_ipv6 p;
-	struct prefix *cp;
-
-	p.family = AF_INET6;
-	p.prefix = *addr;
-	p.prefixlen = IPV6_MAX_BITLEN;
-
-	for(ALL_LIST_ELEMENTS_RO(iflist, ifnode, ifp)) {
-		for(ALL_LIST_ELEMENTS_RO(ifp->connected, cnode, connected)) {
-			cp = connected->address;
-
-			if(cp->family == AF_INET6) {
-				if(prefix_match(cp, (struct prefix *) &p)) {
-					return ifp;
-				}
-			}
-		}
-	}
-	return NULL;
+	return if_lookup_address6(addr);
 }
 
 struct interface *if_lookup_by_ipv6_exact(struct in6_addr *addr) {
-	struct listnode *ifnode;
-	struct listnode *cnode;
-	struct interface *ifp;
-	struct connected *connected;
-	struct prefix *cp;
-
-	for(ALL_LIST_ELEMENTS_RO(iflist, ifnode, ifp)) {
-		for(ALL_LIST_ELEMENTS_RO(ifp->connected, cnode, connected)) {
-			cp = connected->address;
-
-			if(cp->family == AF_INET6) {
-				if(IPV6_ADDR_SAME(&cp->u.prefix6, addr)) {
-					return ifp;
-				}
-			}
-		}
-	}
-	return NULL;
+	return if_lookup_exact_address6(addr);
 }
 
 static int if_get_ipv6_global(struct interface *ifp, struct in6_addr *addr) {
@@ -622,6 +546,103 @@ int bgp_nexthop_set(union sockunion *local, union sockunion *remote, struct bgp_
 	return ret;
 }
 
+/* Ids of the nexthop groups sent to zebra, the last one handed out */
+static u_int32_t bgp_nhg_id_last;
+
+/* Tell zebra how to reach the address of bnc, as the nexthop group its
+ * routes are installed with: when that changes, they all move with a
+ * single message. */
+void bgp_zebra_nhg_update(struct bgp_nexthop_cache *bnc) {
+	struct stream *s;
+	struct nexthop *nexthop;
+	size_t nump;
+	u_char num = 0;
+
+	if(zclient->sock < 0) {
+		return;
+	}
+
+	if(bnc->nhg_id == 0) {
+		if(++bgp_nhg_id_last == 0) {
+			bgp_nhg_id_last = 1;
+		}
+		bnc->nhg_id = bgp_nhg_id_last;
+	}
+
+	s = zclient->obuf;
+	stream_reset(s);
+	zclient_create_header(s, ZEBRA_NEXTHOP_GROUP_ADD, VRF_DEFAULT);
+	stream_putl(s, bnc->nhg_id);
+	nump = stream_get_endp(s);
+	stream_putc(s, 0);
+
+	for(nexthop = bnc->nexthop; nexthop; nexthop = nexthop->next) {
+		switch(nexthop->type) {
+			case ZEBRA_NEXTHOP_IPV4:
+				stream_putc(s, ZEBRA_NEXTHOP_IPV4);
+				stream_put_in_addr(s, &nexthop->gate.ipv4);
+				break;
+			case ZEBRA_NEXTHOP_IPV4_IFINDEX:
+			case ZEBRA_NEXTHOP_IPV4_IFNAME:
+				stream_putc(s, ZEBRA_NEXTHOP_IPV4_IFINDEX);
+				stream_put_in_addr(s, &nexthop->gate.ipv4);
+				stream_putl(s, nexthop->ifindex);
+				break;
+			case ZEBRA_NEXTHOP_IFINDEX:
+			case ZEBRA_NEXTHOP_IFNAME:
+				/* connected, so the BGP nexthop is the gateway */
+				stream_putc(s, ZEBRA_NEXTHOP_IPV4_IFINDEX);
+				stream_put_in_addr(s, &bnc->node->p.u.prefix4);
+				stream_putl(s, nexthop->ifindex);
+				break;
+			default: continue;
+		}
+		num++;
+	}
+	stream_putc_at(s, nump, num);
+	stream_putw_at(s, 0, stream_get_endp(s));
+
+	if(BGP_DEBUG(zebra, ZEBRA)) {
+		char buf[INET6_ADDRSTRLEN];
+		zlog_debug("Zebra send: nexthop group %u for %s, %u nexthops", bnc->nhg_id, bnc_str(bnc, buf, sizeof(buf)), num);
+	}
+
+	zclient_send_message(zclient);
+	bnc->nhg_connect = zclient_num_connects;
+}
+
+void bgp_zebra_nhg_delete(struct bgp_nexthop_cache *bnc) {
+	struct stream *s;
+
+	if(bnc->nhg_id == 0) {
+		return;
+	}
+
+	if(zclient->sock >= 0 && bnc->nhg_connect == zclient_num_connects) {
+		s = zclient->obuf;
+		stream_reset(s);
+		zclient_create_header(s, ZEBRA_NEXTHOP_GROUP_DELETE, VRF_DEFAULT);
+		stream_putl(s, bnc->nhg_id);
+		stream_putw_at(s, 0, stream_get_endp(s));
+		zclient_send_message(zclient);
+	}
+	bnc->nhg_id = 0;
+}
+
+/* The nexthop whose group a route with a single path can be installed
+ * through, if there is one to use. */
+static struct bgp_nexthop_cache *bgp_zebra_nhg(struct bgp *bgp, struct bgp_info *info) {
+	struct bgp_nexthop_cache *bnc = info->nexthop;
+
+	if(!bgp_flag_check(bgp, BGP_FLAG_NEXTHOP_GROUP) || bnc == NULL || bnc->node->p.family != AF_INET) {
+		return NULL;
+	}
+	if(!CHECK_FLAG(bnc->flags, BGP_NEXTHOP_VALID) || bnc->nexthop == NULL) {
+		return NULL;
+	}
+	return bnc;
+}
+
 void bgp_zebra_announce(struct prefix *p, struct bgp_info *info, struct bgp *bgp, safi_t safi) {
 	int flags;
 	u_char distance;
@@ -660,6 +681,17 @@ void bgp_zebra_announce(struct prefix *p, struct bgp_info *info, struct bgp *bgp
 	if(p->family == AF_INET) {
 		struct zapi_ipv4 api;
 		struct in_addr *nexthop;
+		struct bgp_nexthop_cache *bnc = NULL;
+
+		/* before the route, which is built in the same buffer */
+		if(nhcount == 1 && (bnc = bgp_zebra_nhg(bgp, info)) != NULL) {
+			if(bnc->nhg_id == 0 || bnc->nhg_connect != zclient_num_connects) {
+				bgp_zebra_nhg_update(bnc);
+			}
+			SET_FLAG(info->flags, BGP_INFO_NHG);
+		} else {
+			UNSET_FLAG(info->flags, BGP_INFO_NHG);
+		}
 
 		/* resize nexthop buffer size if necessary */
 		if((oldsize = stream_get_size(bgp_nexthop_buf)) < (sizeof(struct in_addr *) * nhcount)) {
@@ -696,6 +728,11 @@ void bgp_zebra_announce(struct prefix *p, struct bgp_info *info, struct bgp *bgp
 			api.tag = tag;
 		}
 
+		if(bnc) {
+			SET_FLAG(api.message, ZAPI_MESSAGE_NHG);
+			api.nhg_id = bnc->nhg_id;
+		}
+
 		distance = bgp_distance_apply(p, info, bgp);
 
 		if(distance) {
@@ -1046,6 +1083,7 @@ void bgp_zclient_reset(void) {
 static void bgp_zebra_connected(struct zclient *zclient) {
 	zclient_num_connects++;
 	zclient_send_requests(zclient, VRF_DEFAULT);
+	bgp_bfd_register_all();
 }
 
 void bgp_zebra_init(struct thread_master *master) {
@@ -1054,6 +1092,7 @@ void bgp_zebra_init(struct thread_master *master) {
 	/* Set default values. */
 	zclient = zclient_new(master);
 	zclient_init(zclient, ZEBRA_ROUTE_BGP);
+	zclient->ring_size = bm->zebra_ring;
 	zclient->zebra_connected = bgp_zebra_connected;
 	zclient->router_id_update = bgp_router_id_update;
 	zclient->interface_add = bgp_interface_add;
@@ -1067,6 +1106,7 @@ void bgp_zebra_init(struct thread_master *master) {
 	zclient->ipv6_route_add = zebra_read_ipv6;
 	zclient->ipv6_route_delete = zebra_read_ipv6;
 	zclient->nexthop_update = bgp_read_nexthop_update;
+	zclient->bfd_update = bgp_bfd_update;
 
 	bgp_nexthop_buf = stream_new(BGP_NEXTHOP_BUF_SIZE);
 	bgp_ifindices_buf = stream_new(BGP_IFINDICES_BUF_SIZE);
@@ -36,6 +36,8 @@ extern int bgp_config_write_maxpaths(struct vty *, struct bgp *, afi_t, safi_t,
 extern int bgp_config_write_redistribute(struct vty *, struct bgp *, afi_t, safi_t, int *);
 extern void bgp_zebra_announce(struct prefix *, struct bgp_info *, struct bgp *, safi_t);
 extern void bgp_zebra_withdraw(struct prefix *, struct bgp_info *, safi_t);
+extern void bgp_zebra_nhg_update(struct bgp_nexthop_cache *);
+extern void bgp_zebra_nhg_delete(struct bgp_nexthop_cache *);
 
 extern int bgp_redistribute_set(struct bgp *, afi_t, int);
 extern int bgp_redistribute_rmap_set(struct bgp *, afi_t, int, const char *);
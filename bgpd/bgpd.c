@@ -36,6 +36,7 @@ Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
 #include "log.h"
 #include "plist.h"
 #include "linklist.h"
+#include "hash.h"
 #include "workqueue.h"
 #include "table.h"
 
@@ -63,6 +64,13 @@ Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
 #include "bgpd/bgp_vty.h"
 #include "bgpd/bgp_mpath.h"
 #include "bgpd/bgp_nht.h"
+#include "bgpd/bgp_updgrp.h"
+#include "bgpd/bgp_io.h"
+#include "bgpd/bgp_rmap_cache.h"
+#include "bgpd/bgp_bmp.h"
+#include "bgpd/bgp_bfd.h"
+#include "bgpd/bgp_rpki.h"
+#include "bgpd/bgp_snapshot.h"
 #ifdef HAVE_SNMP
 	#include "bgpd/bgp_snmp.h"
 #endif /* HAVE_SNMP */
@@ -238,6 +246,26 @@ time_t bgp_clock(void) {
 	return tv.tv_sec;
 }
 
+/* Account for a route that waited since start */
+void peer_lag_add(struct peer_lag *lag, struct timeval *start) {
+	struct timeval now;
+	unsigned long elapsed;
+
+	quagga_gettime(QUAGGA_CLK_MONOTONIC, &now);
+	elapsed = timeval_elapsed(now, *start);
+
+	lag->last = elapsed;
+	if(elapsed > lag->max) {
+		lag->max = elapsed;
+	}
+	lag->total += elapsed;
+	lag->count++;
+}
+
+u_int32_t peer_lag_average(struct peer_lag *lag) {
+	return lag->count ? lag->total / lag->count : 0;
+}
+
 /* BGP timer configuration.  */
 int bgp_timers_set(struct bgp *bgp, u_int32_t keepalive, u_int32_t holdtime) {
 	bgp->default_keepalive = (keepalive < holdtime / 3 ? keepalive : holdtime / 3);
@@ -680,6 +708,16 @@ static void peer_free(struct peer *peer) {
 		XFREE(MTYPE_TMP, peer->notify.data);
 	}
 
+	if(peer->open_sent) {
+		stream_free(peer->open_sent);
+	}
+	if(peer->open_rcvd) {
+		stream_free(peer->open_rcvd);
+	}
+	if(peer->notify_sent) {
+		stream_free(peer->notify_sent);
+	}
+
 	bgp_sync_delete(peer);
 
 	bgp_unlock(peer->bgp);
@@ -780,6 +818,7 @@ static struct peer *peer_new(struct bgp *bgp) {
    */
 	peer->work = stream_new(BGP_MAX_PACKET_SIZE + BGP_MAX_PACKET_SIZE_OVERFLOW);
 	peer->scratch = stream_new(BGP_MAX_PACKET_SIZE);
+	peer->max_packet_size = BGP_MAX_PACKET_SIZE;
 
 	bgp_sync_init(peer);
 
@@ -790,6 +829,56 @@ static struct peer *peer_new(struct bgp *bgp) {
 	return peer;
 }
 
+/* bgp->peerhash holds the first peer at each address, and chains the
+ * others there, accept peers beside the configured one, off it through
+ * su_next in the order they came. */
+static unsigned int peer_hash_key(void *p) {
+	return sockunion_hash(&((struct peer *) p)->su);
+}
+
+static int peer_hash_cmp(const void *p1, const void *p2) {
+	return sockunion_same(&((const struct peer *) p1)->su, &((const struct peer *) p2)->su);
+}
+
+static void peer_index_add(struct peer *peer) {
+	struct peer *head, *last;
+
+	peer->su_next = NULL;
+	head = hash_get(peer->bgp->peerhash, peer, hash_alloc_intern);
+	if(head != peer) {
+		for(last = head; last->su_next; last = last->su_next)
+			;
+		last->su_next = peer;
+	}
+}
+
+static void peer_index_del(struct peer *peer) {
+	struct peer *head, *prev;
+
+	head = hash_lookup(peer->bgp->peerhash, peer);
+	if(head == peer) {
+		hash_release(peer->bgp->peerhash, peer);
+		if(peer->su_next) {
+			hash_get(peer->bgp->peerhash, peer->su_next, hash_alloc_intern);
+		}
+	} else if(head) {
+		for(prev = head; prev->su_next && prev->su_next != peer; prev = prev->su_next)
+			;
+		if(prev->su_next == peer) {
+			prev->su_next = peer->su_next;
+		}
+	}
+	peer->su_next = NULL;
+}
+
+/* The first of the instance's peers at su, to walk through su_next. */
+struct peer *peer_index_lookup(struct bgp *bgp, union sockunion *su) {
+	struct peer key;
+
+	key.su = *su;
+	return hash_lookup(bgp->peerhash, &key);
+}
+
 /* Create new BGP peer.  */
 static struct peer *peer_create(union sockunion *su, struct bgp *bgp, as_t local_as, as_t remote_as, afi_t afi, safi_t safi) {
 	int active;
@@ -811,6 +900,7 @@ static struct peer *peer_create(union sockunion *su, struct bgp *bgp, as_t local
 
 	peer = peer_lock(peer); /* bgp peer list reference */
 	listnode_add_sort(bgp->peer, peer);
+	peer_index_add(peer);
 
 	active = peer_active(peer);
 
@@ -834,13 +924,15 @@ static struct peer *peer_create(union sockunion *su, struct bgp *bgp, as_t local
 }
 
 /* Make accept BGP peer.  Called from bgp_accept (). */
-struct peer *peer_create_accept(struct bgp *bgp) {
+struct peer *peer_create_accept(struct bgp *bgp, union sockunion *su) {
 	struct peer *peer;
 
 	peer = peer_new(bgp);
+	peer->su = *su;
 
 	peer = peer_lock(peer); /* bgp peer list reference */
 	listnode_add_sort(bgp->peer, peer);
+	peer_index_add(peer);
 
 	return peer;
 }
@@ -1056,6 +1148,7 @@ static void peer_nsf_stop(struct peer *peer) {
 
 	UNSET_FLAG(peer->sflags, PEER_STATUS_NSF_WAIT);
 	UNSET_FLAG(peer->sflags, PEER_STATUS_NSF_MODE);
+	UNSET_FLAG(peer->sflags, PEER_STATUS_SNAPSHOT);
 
 	for(afi = AFI_IP; afi < AFI_MAX; afi++) {
 		for(safi = SAFI_UNICAST; safi < SAFI_RESERVED_3; safi++) {
@@ -1123,6 +1216,9 @@ int peer_delete(struct peer *peer) {
 	bgp_stop(peer);
 	bgp_fsm_change_status(peer, Deleted);
 
+	/* Drop the route-map results cached for it */
+	bgp_rmap_cache_flush_peer(peer);
+
 	/* Remove from NHT */
 	bgp_unlink_nexthop_by_peer(peer);
 
@@ -1140,6 +1236,7 @@ int peer_delete(struct peer *peer) {
 
 	/* Delete from all peer list. */
 	if(!CHECK_FLAG(peer->sflags, PEER_STATUS_GROUP) && (pn = listnode_lookup(bgp->peer, peer))) {
+		peer_index_del(peer);
 		peer_unlock(peer); /* bgp peer list reference */
 		list_delete_node(bgp->peer, pn);
 	}
@@ -1163,6 +1260,7 @@ int peer_delete(struct peer *peer) {
 	for(afi = AFI_IP; afi < AFI_MAX; afi++) {
 		for(safi = SAFI_UNICAST; safi < SAFI_MAX; safi++) {
 			if(peer->rib[afi][safi] && !peer->af_group[afi][safi]) {
+				bgp_rsclient_shared_leave(peer, afi, safi);
 				bgp_table_finish(&peer->rib[afi][safi]);
 			}
 		}
@@ -1347,6 +1445,10 @@ static void peer_group2peer_config_copy(struct peer_group *group, struct peer *p
 	/* Weight */
 	peer->weight = conf->weight;
 
+	/* Socket buffers */
+	peer->sndbuf = conf->sndbuf;
+	peer->rcvbuf = conf->rcvbuf;
+
 	/* peer flags apply */
 	peer->flags = conf->flags;
 	/* peer af_flags apply */
@@ -1745,6 +1847,7 @@ int peer_group_bind(struct bgp *bgp, union sockunion *su, struct peer_group *gro
 			bgp_clear_route(peer, afi, safi, BGP_CLEAR_ROUTE_MY_RSCLIENT);
 		}
 
+		bgp_rsclient_shared_leave(peer, afi, safi);
 		bgp_table_finish(&peer->rib[afi][safi]);
 
 		/* Import policy. */
@@ -1822,6 +1925,122 @@ static int bgp_startup_timer_expire(struct thread *thread) {
 	return 0;
 }
 
+/* Update delay: best path selection is held after startup until the
+ * peers have sent their tables, or for v_update_delay seconds at most,
+ * so routes aren't selected and advertised over and over as the tables
+ * of one peer after another come in.  The queues are shared, so they go
+ * on once no instance is holding them any more. */
+static void bgp_update_delay_end(struct bgp *bgp, const char *why) {
+	if(!bgp->update_delay_pending) {
+		return;
+	}
+
+	THREAD_OFF(bgp->t_update_delay);
+	THREAD_OFF(bgp->t_establish_wait);
+	bgp->update_delay_pending = 0;
+	zlog_notice("BGP %u: update delay over, %s; leaving read-only mode", bgp->as, why);
+
+	if(--bm->update_delays == 0) {
+		bgp_process_hold(0);
+	}
+}
+
+static int bgp_update_delay_expire(struct thread *thread) {
+	struct bgp *bgp;
+
+	bgp = THREAD_ARG(thread);
+	bgp->t_update_delay = NULL;
+	bgp_update_delay_end(bgp, "timer expired");
+
+	return 0;
+}
+
+/* From now on, only the peers that are up are waited for. */
+static int bgp_establish_wait_expire(struct thread *thread) {
+	struct bgp *bgp;
+
+	bgp = THREAD_ARG(thread);
+	bgp->t_establish_wait = NULL;
+	bgp_update_delay_check(bgp);
+
+	return 0;
+}
+
+/* Whether the peer sent all of its table: End-of-RIB in all its address
+ * families, or a keepalive after it came up for one that doesn't send
+ * End-of-RIB. */
+static int peer_initial_table_done(struct peer *peer) {
+	afi_t afi;
+	safi_t safi;
+
+	if(peer->status != Established) {
+		return 0;
+	}
+	if(CHECK_FLAG(peer->sflags, PEER_STATUS_IMPLICIT_EOR)) {
+		return 1;
+	}
+	for(afi = AFI_IP; afi < AFI_MAX; afi++) {
+		for(safi = SAFI_UNICAST; safi < SAFI_MAX; safi++) {
+			if(peer->afc_nego[afi][safi] && !CHECK_FLAG(peer->af_sflags[afi][safi], PEER_STATUS_EOR_RECEIVED)) {
+				return 0;
+			}
+		}
+	}
+	return 1;
+}
+
+/* Called as peers finish sending their tables. */
+void bgp_update_delay_check(struct bgp *bgp) {
+	struct listnode *node, *nnode;
+	struct peer *peer;
+
+	if(!bgp->update_delay_pending) {
+		return;
+	}
+
+	for(ALL_LIST_ELEMENTS(bgp->peer, node, nnode, peer)) {
+		if(CHECK_FLAG(peer->flags, PEER_FLAG_SHUTDOWN) || !peer_active(peer)) {
+			continue;
+		}
+		if(peer->status != Established && bgp->v_establish_wait && !bgp->t_establish_wait) {
+			continue;
+		}
+		if(!peer_initial_table_done(peer)) {
+			return;
+		}
+	}
+	bgp_update_delay_end(bgp, "all peers sent their tables");
+}
+
+/* The startup configuration is read, and the policies in it resolved:
+ * start the update delays, and the sessions. */
+void bgp_startup(void) {
+	struct listnode *node, *nnode;
+	struct bgp *bgp;
+
+	for(ALL_LIST_ELEMENTS(bm->bgp, node, nnode, bgp)) {
+		if(!bgp->v_update_delay) {
+			continue;
+		}
+		if(bm->update_delays++ == 0) {
+			bgp_process_hold(1);
+		}
+		bgp->update_delay_pending = 1;
+		THREAD_TIMER_ON(bm->master, bgp->t_update_delay, bgp_update_delay_expire, bgp, bgp->v_update_delay);
+		if(bgp->v_establish_wait) {
+			THREAD_TIMER_ON(bm->master, bgp->t_establish_wait, bgp_establish_wait_expire, bgp, bgp->v_establish_wait);
+		}
+		zlog_notice("BGP %u: read-only mode, update delay of %u seconds", bgp->as, bgp->v_update_delay);
+	}
+
+	bgp_fsm_startup();
+
+	/* nothing to wait for, perhaps */
+	for(ALL_LIST_ELEMENTS(bm->bgp, node, nnode, bgp)) {
+		bgp_update_delay_check(bgp);
+	}
+}
+
 /* BGP instance creation by `router bgp' commands. */
 static struct bgp *bgp_create(as_t *as, const char *name) {
 	struct bgp *bgp;
@@ -1838,11 +2057,13 @@ static struct bgp *bgp_create(as_t *as, const char *name) {
 
 	bgp->peer = list_new();
 	bgp->peer->cmp = (int (*)(void *, void *)) peer_cmp;
+	bgp->peerhash = hash_create(peer_hash_key, peer_hash_cmp);
 
 	bgp->group = list_new();
 	bgp->group->cmp = (int (*)(void *, void *)) peer_group_cmp;
 
 	bgp->rsclient = list_new();
+	bgp->update_groups = list_new();
 	bgp->rsclient->cmp = (int (*)(void *, void *)) peer_cmp;
 
 	for(afi = AFI_IP; afi < AFI_MAX; afi++) {
@@ -1858,6 +2079,7 @@ static struct bgp *bgp_create(as_t *as, const char *name) {
 	bgp->default_local_pref = BGP_DEFAULT_LOCAL_PREF;
 	bgp->default_holdtime = BGP_DEFAULT_HOLDTIME;
 	bgp->default_keepalive = BGP_DEFAULT_KEEPALIVE;
+	bgp->announce_pace = BGP_ANNOUNCE_PACE_DEFAULT;
 	bgp->restart_time = BGP_DEFAULT_RESTART_TIME;
 	bgp->stalepath_time = BGP_DEFAULT_STALEPATH_TIME;
 	bgp_flag_set(bgp, BGP_FLAG_LOG_NEIGHBOR_CHANGES);
@@ -1975,6 +2197,7 @@ int bgp_delete(struct bgp *bgp) {
 	SET_FLAG(bgp->flags, BGP_FLAG_DELETING);
 
 	THREAD_OFF(bgp->t_startup);
+	bgp_update_delay_end(bgp, "instance deleted");
 
 	for(ALL_LIST_ELEMENTS(bgp->peer, node, next, peer)) {
 		if(peer->status == Established || peer->status == OpenSent || peer->status == OpenConfirm) {
@@ -1985,6 +2208,9 @@ int bgp_delete(struct bgp *bgp) {
 	/* Delete static route. */
 	bgp_static_delete(bgp);
 
+	/* And the aggregates. */
+	bgp_aggregate_delete_all(bgp);
+
 	/* Unset redistribution. */
 	for(afi = AFI_IP; afi < AFI_MAX; afi++) {
 		for(i = 0; i < ZEBRA_ROUTE_MAX; i++) {
@@ -2061,7 +2287,9 @@ static void bgp_free(struct bgp *bgp) {
 
 	list_delete(bgp->group);
 	list_delete(bgp->peer);
+	hash_free(bgp->peerhash);
 	list_delete(bgp->rsclient);
+	bgp_updgrp_finish(bgp);
 
 	if(bgp->name) {
 		free(bgp->name);
@@ -2083,24 +2311,30 @@ static void bgp_free(struct bgp *bgp) {
 	XFREE(MTYPE_BGP, bgp);
 }
 
+/* The configured peer at su, of which an instance has one at most. */
+static struct peer *peer_lookup_one(struct bgp *bgp, union sockunion *su) {
+	struct peer *peer;
+
+	for(peer = peer_index_lookup(bgp, su); peer; peer = peer->su_next) {
+		if(!CHECK_FLAG(peer->sflags, PEER_STATUS_ACCEPT_PEER)) {
+			return peer;
+		}
+	}
+	return NULL;
+}
+
+/* Across all instances, in their order: there are few of them, and a
+ * lookup per instance keeps the one found the same as before. */
 struct peer *peer_lookup(struct bgp *bgp, union sockunion *su) {
 	struct peer *peer;
-	struct listnode *node, *nnode;
+	struct listnode *bgpnode;
 
 	if(bgp != NULL) {
-		for(ALL_LIST_ELEMENTS(bgp->peer, node, nnode, peer)) {
-			if(sockunion_same(&peer->su, su) && !CHECK_FLAG(peer->sflags, PEER_STATUS_ACCEPT_PEER)) {
-				return peer;
-			}
-		}
+		return peer_lookup_one(bgp, su);
 	} else if(bm->bgp != NULL) {
-		struct listnode *bgpnode, *nbgpnode;
-
-		for(ALL_LIST_ELEMENTS(bm->bgp, bgpnode, nbgpnode, bgp)) {
-			for(ALL_LIST_ELEMENTS(bgp->peer, node, nnode, peer)) {
-				if(sockunion_same(&peer->su, su) && !CHECK_FLAG(peer->sflags, PEER_STATUS_ACCEPT_PEER)) {
-					return peer;
-				}
+		for(ALL_LIST_ELEMENTS_RO(bm->bgp, bgpnode, bgp)) {
+			if((peer = peer_lookup_one(bgp, su))) {
+				return peer;
 			}
 		}
 	}
@@ -2109,7 +2343,6 @@ struct peer *peer_lookup(struct bgp *bgp, union sockunion *su) {
 
 struct peer *peer_lookup_with_open(union sockunion *su, as_t remote_as, struct in_addr *remote_id, int *as) {
 	struct peer *peer;
-	struct listnode *node;
 	struct listnode *bgpnode;
 	struct bgp *bgp;
 
@@ -2118,26 +2351,12 @@ struct peer *peer_lookup_with_open(union sockunion *su, as_t remote_as, struct i
 	}
 
 	for(ALL_LIST_ELEMENTS_RO(bm->bgp, bgpnode, bgp)) {
-		for(ALL_LIST_ELEMENTS_RO(bgp->peer, node, peer)) {
-			if(sockunion_same(&peer->su, su) && !CHECK_FLAG(peer->sflags, PEER_STATUS_ACCEPT_PEER)) {
-				if(peer->as == remote_as && peer->remote_id.s_addr == remote_id->s_addr) {
-					return peer;
-				}
-				if(peer->as == remote_as) {
-					*as = 1;
-				}
-			}
-		}
-
-		for(ALL_LIST_ELEMENTS_RO(bgp->peer, node, peer)) {
-			if(sockunion_same(&peer->su, su) && !CHECK_FLAG(peer->sflags, PEER_STATUS_ACCEPT_PEER)) {
-				if(peer->as == remote_as && peer->remote_id.s_addr == 0) {
-					return peer;
-				}
-				if(peer->as == remote_as) {
-					*as = 1;
-				}
+		peer = peer_lookup_one(bgp, su);
+		if(peer && peer->as == remote_as) {
+			if(peer->remote_id.s_addr == remote_id->s_addr || peer->remote_id.s_addr == 0) {
+				return peer;
 			}
+			*as = 1;
 		}
 	}
 	return NULL;
@@ -2213,6 +2432,8 @@ static const struct peer_flag_action peer_flag_action_list[] = {
 	{ PEER_FLAG_STRICT_CAP_MATCH,	      0, peer_change_none },
 	     { PEER_FLAG_DYNAMIC_CAPABILITY,	     0, peer_change_reset},
 	     { PEER_FLAG_DISABLE_CONNECTED_CHECK, 0, peer_change_reset},
+	{ PEER_FLAG_EXTENDED_MESSAGE,	      0, peer_change_reset},
+	{ PEER_FLAG_BFD,		      0, peer_change_none },
 	  { 0,				       0, 0		    }
 };
 
@@ -2233,6 +2454,10 @@ static const struct peer_flag_action peer_af_flag_action_list[] = {
 	{ PEER_FLAG_ORF_PREFIX_RM,	   1, peer_change_reset	},
 	{ PEER_FLAG_NEXTHOP_LOCAL_UNCHANGED, 0, peer_change_reset_out},
 	{ PEER_FLAG_NEXTHOP_SELF_ALL,	      1, peer_change_reset_out},
+	{ PEER_FLAG_ADDPATH_RX,		1, peer_change_reset	},
+	{ PEER_FLAG_ADDPATH_TX_ALL_PATHS,	  1, peer_change_reset	},
+	{ PEER_FLAG_ADDPATH_TX_MULTIPATH,	  1, peer_change_reset	},
+	{ PEER_FLAG_RT_CONSTRAIN,		  1, peer_change_reset	},
 	{ 0,				 0, 0		    }
 };
 
@@ -2314,7 +2539,7 @@ static void peer_flag_modify_action(struct peer *peer, u_int32_t flag) {
 			BGP_EVENT_ADD(peer, BGP_Stop);
 		}
 	} else if(BGP_IS_VALID_STATE_FOR_NOTIF(peer->status)) {
-		if(flag == PEER_FLAG_DYNAMIC_CAPABILITY) {
+		if(flag == PEER_FLAG_DYNAMIC_CAPABILITY || flag == PEER_FLAG_EXTENDED_MESSAGE) {
 			peer->last_reset = PEER_DOWN_CAPABILITY_CHANGE;
 		} else if(flag == PEER_FLAG_PASSIVE) {
 			peer->last_reset = PEER_DOWN_PASSIVE_CHANGE;
@@ -2387,6 +2612,9 @@ static int peer_flag_modify(struct peer *peer, u_int32_t flag, int set) {
 		if(action.type == peer_change_reset) {
 			peer_flag_modify_action(peer, flag);
 		}
+		if(flag == PEER_FLAG_BFD) {
+			bgp_bfd_peer_update(peer);
+		}
 
 		return 0;
 	}
@@ -2412,6 +2640,9 @@ static int peer_flag_modify(struct peer *peer, u_int32_t flag, int set) {
 		if(action.type == peer_change_reset) {
 			peer_flag_modify_action(peer, flag);
 		}
+		if(flag == PEER_FLAG_BFD) {
+			bgp_bfd_peer_update(peer);
+		}
 	}
 	return 0;
 }
@@ -2505,6 +2736,8 @@ static int peer_af_flag_modify(struct peer *peer, afi_t afi, safi_t safi, u_int3
 				peer->last_reset = PEER_DOWN_CAPABILITY_CHANGE;
 			} else if(flag == PEER_FLAG_ORF_PREFIX_RM) {
 				peer->last_reset = PEER_DOWN_CAPABILITY_CHANGE;
+			} else if(CHECK_FLAG(flag, PEER_FLAG_ADDPATH_RX | PEER_FLAG_ADDPATH_TX_ALL_PATHS | PEER_FLAG_ADDPATH_TX_MULTIPATH | PEER_FLAG_RT_CONSTRAIN)) {
+				peer->last_reset = PEER_DOWN_CAPABILITY_CHANGE;
 			}
 
 			peer_change_action(peer, afi, safi, action.type);
@@ -2546,6 +2779,8 @@ static int peer_af_flag_modify(struct peer *peer, afi_t afi, safi_t safi, u_int3
 						peer->last_reset = PEER_DOWN_CAPABILITY_CHANGE;
 					} else if(flag == PEER_FLAG_ORF_PREFIX_RM) {
 						peer->last_reset = PEER_DOWN_CAPABILITY_CHANGE;
+					} else if(CHECK_FLAG(flag, PEER_FLAG_ADDPATH_RX | PEER_FLAG_ADDPATH_TX_ALL_PATHS | PEER_FLAG_ADDPATH_TX_MULTIPATH | PEER_FLAG_RT_CONSTRAIN)) {
+						peer->last_reset = PEER_DOWN_CAPABILITY_CHANGE;
 					}
 
 					peer_change_action(peer, afi, safi, action.type);
@@ -2918,6 +3153,88 @@ int peer_port_unset(struct peer *peer) {
 	return 0;
 }
 
+/* neighbor socket-buffer: of the session's socket, for sending or
+   receiving.  A connection up takes a new size at once, except that a
+   receive buffer doesn't change the window scale it was opened with; an
+   unset one keeps what it has until the next. */
+static void peer_socket_buffer_apply(struct peer *peer) {
+	if(peer->fd >= 0) {
+		bgp_set_socket_buffers(peer, peer->fd);
+	}
+}
+
+int peer_socket_buffer_set(struct peer *peer, int send, u_int32_t size) {
+	struct peer_group *group;
+	struct listnode *node, *nnode;
+
+	if(send) {
+		SET_FLAG(peer->config, PEER_CONFIG_SNDBUF);
+		peer->sndbuf = size;
+	} else {
+		SET_FLAG(peer->config, PEER_CONFIG_RCVBUF);
+		peer->rcvbuf = size;
+	}
+
+	if(!CHECK_FLAG(peer->sflags, PEER_STATUS_GROUP)) {
+		peer_socket_buffer_apply(peer);
+		return 0;
+	}
+
+	/* peer-group member updates. */
+	group = peer->group;
+	for(ALL_LIST_ELEMENTS(group->peer, node, nnode, peer)) {
+		if(send) {
+			SET_FLAG(peer->config, PEER_CONFIG_SNDBUF);
+			peer->sndbuf = size;
+		} else {
+			SET_FLAG(peer->config, PEER_CONFIG_RCVBUF);
+			peer->rcvbuf = size;
+		}
+		peer_socket_buffer_apply(peer);
+	}
+	return 0;
+}
+
+int peer_socket_buffer_unset(struct peer *peer, int send) {
+	struct peer_group *group;
+	struct listnode *node, *nnode;
+	u_int32_t flag = send ? PEER_CONFIG_SNDBUF : PEER_CONFIG_RCVBUF;
+
+	/* Back to the group's, if it has one. */
+	if(peer_group_active(peer) && CHECK_FLAG(peer->group->conf->config, flag)) {
+		if(send) {
+			peer->sndbuf = peer->group->conf->sndbuf;
+		} else {
+			peer->rcvbuf = peer->group->conf->rcvbuf;
+		}
+		peer_socket_buffer_apply(peer);
+		return 0;
+	}
+
+	UNSET_FLAG(peer->config, flag);
+	if(send) {
+		peer->sndbuf = 0;
+	} else {
+		peer->rcvbuf = 0;
+	}
+
+	if(!CHECK_FLAG(peer->sflags, PEER_STATUS_GROUP)) {
+		return 0;
+	}
+
+	/* peer-group member updates. */
+	group = peer->group;
+	for(ALL_LIST_ELEMENTS(group->peer, node, nnode, peer)) {
+		UNSET_FLAG(peer->config, flag);
+		if(send) {
+			peer->sndbuf = 0;
+		} else {
+			peer->rcvbuf = 0;
+		}
+	}
+	return 0;
+}
+
 /* neighbor weight. */
 int peer_weight_set(struct peer *peer, u_int16_t weight) {
 	struct peer_group *group;
@@ -3577,7 +3894,7 @@ int peer_distribute_unset(struct peer *peer, afi_t afi, safi_t safi, int direct)
 }
 
 /* Update distribute list. */
-static void peer_distribute_update(const char *name) {
+static void peer_distribute_resolve(void) {
 	afi_t afi;
 	safi_t safi;
 	int direct;
@@ -3736,7 +4053,7 @@ int peer_prefix_list_unset(struct peer *peer, afi_t afi, safi_t safi, int direct
 }
 
 /* Update prefix-list list. */
-static void peer_prefix_list_update(struct prefix_list *plist) {
+static void peer_prefix_list_resolve(void) {
 	struct listnode *mnode, *mnnode;
 	struct listnode *node, *nnode;
 	struct bgp *bgp;
@@ -3889,7 +4206,7 @@ int peer_aslist_unset(struct peer *peer, afi_t afi, safi_t safi, int direct) {
 	return 0;
 }
 
-static void peer_aslist_update(void) {
+static void peer_aslist_resolve(void) {
 	afi_t afi;
 	safi_t safi;
 	int direct;
@@ -4605,6 +4922,18 @@ static void bgp_config_write_peer(struct vty *vty, struct bgp *bgp, struct peer
 			}
 		}
 
+		/* Socket buffers. */
+		if(CHECK_FLAG(peer->config, PEER_CONFIG_SNDBUF)) {
+			if(!peer_group_active(peer) || !CHECK_FLAG(g_peer->config, PEER_CONFIG_SNDBUF) || g_peer->sndbuf != peer->sndbuf) {
+				vty_out(vty, " neighbor %s socket-buffer send %u%s", addr, peer->sndbuf, VTY_NEWLINE);
+			}
+		}
+		if(CHECK_FLAG(peer->config, PEER_CONFIG_RCVBUF)) {
+			if(!peer_group_active(peer) || !CHECK_FLAG(g_peer->config, PEER_CONFIG_RCVBUF) || g_peer->rcvbuf != peer->rcvbuf) {
+				vty_out(vty, " neighbor %s socket-buffer receive %u%s", addr, peer->rcvbuf, VTY_NEWLINE);
+			}
+		}
+
 		/* Dynamic capability.  */
 		if(CHECK_FLAG(peer->flags, PEER_FLAG_DYNAMIC_CAPABILITY)) {
 			if(!peer_group_active(peer) || !CHECK_FLAG(g_peer->flags, PEER_FLAG_DYNAMIC_CAPABILITY)) {
@@ -4612,6 +4941,20 @@ static void bgp_config_write_peer(struct vty *vty, struct bgp *bgp, struct peer
 			}
 		}
 
+		/* Extended message capability. */
+		if(CHECK_FLAG(peer->flags, PEER_FLAG_EXTENDED_MESSAGE)) {
+			if(!peer_group_active(peer) || !CHECK_FLAG(g_peer->flags, PEER_FLAG_EXTENDED_MESSAGE)) {
+				vty_out(vty, " neighbor %s capability extended-message%s", addr, VTY_NEWLINE);
+			}
+		}
+
+		/* BFD. */
+		if(CHECK_FLAG(peer->flags, PEER_FLAG_BFD)) {
+			if(!peer_group_active(peer) || !CHECK_FLAG(g_peer->flags, PEER_FLAG_BFD)) {
+				vty_out(vty, " neighbor %s bfd%s", addr, VTY_NEWLINE);
+			}
+		}
+
 		/* dont capability negotiation. */
 		if(CHECK_FLAG(peer->flags, PEER_FLAG_DONT_CAPABILITY)) {
 			if(!peer_group_active(peer) || !CHECK_FLAG(g_peer->flags, PEER_FLAG_DONT_CAPABILITY)) {
@@ -4674,6 +5017,22 @@ static void bgp_config_write_peer(struct vty *vty, struct bgp *bgp, struct peer
 		}
 	}
 
+	/* Add-Path capability.  */
+	if(peer_af_flag_check(peer, afi, safi, PEER_FLAG_ADDPATH_RX) && !peer->af_group[afi][safi]) {
+		vty_out(vty, " neighbor %s addpath-receive%s", addr, VTY_NEWLINE);
+	}
+	if(peer_af_flag_check(peer, afi, safi, PEER_FLAG_ADDPATH_TX_ALL_PATHS) && !peer->af_group[afi][safi]) {
+		vty_out(vty, " neighbor %s addpath-tx-all-paths%s", addr, VTY_NEWLINE);
+	}
+	if(peer_af_flag_check(peer, afi, safi, PEER_FLAG_ADDPATH_TX_MULTIPATH) && !peer->af_group[afi][safi]) {
+		vty_out(vty, " neighbor %s addpath-tx-multipath%s", addr, VTY_NEWLINE);
+	}
+
+	/* Route target constrain. */
+	if(peer_af_flag_check(peer, afi, safi, PEER_FLAG_RT_CONSTRAIN) && !peer->af_group[afi][safi]) {
+		vty_out(vty, " neighbor %s route-target-constrain%s", addr, VTY_NEWLINE);
+	}
+
 	/* Route reflector client. */
 	if(peer_af_flag_check(peer, afi, safi, PEER_FLAG_REFLECTOR_CLIENT) && !peer->af_group[afi][safi]) {
 		vty_out(vty, " neighbor %s route-reflector-client%s", addr, VTY_NEWLINE);
@@ -4879,6 +5238,9 @@ int bgp_config_write(struct vty *vty) {
 		write++;
 	}
 
+	/* BGP regex engine. */
+	write += bgp_regex_config_write(vty);
+
 	/* BGP configuration. */
 	for(ALL_LIST_ELEMENTS(bm->bgp, mnode, mnnode, bgp)) {
 		if(write) {
@@ -4930,6 +5292,18 @@ int bgp_config_write(struct vty *vty) {
 			vty_out(vty, " bgp default local-preference %d%s", bgp->default_local_pref, VTY_NEWLINE);
 		}
 
+		/* BGP announce pace. */
+		if(bgp->announce_pace != BGP_ANNOUNCE_PACE_DEFAULT) {
+			vty_out(vty, " bgp announce-pace %u%s", bgp->announce_pace, VTY_NEWLINE);
+		}
+
+		/* BGP update delay. */
+		if(bgp->v_update_delay && bgp->v_establish_wait) {
+			vty_out(vty, " bgp update-delay %u %u%s", bgp->v_update_delay, bgp->v_establish_wait, VTY_NEWLINE);
+		} else if(bgp->v_update_delay) {
+			vty_out(vty, " bgp update-delay %u%s", bgp->v_update_delay, VTY_NEWLINE);
+		}
+
 		/* BGP client-to-client reflection. */
 		if(bgp_flag_check(bgp, BGP_FLAG_NO_CLIENT_TO_CLIENT)) {
 			vty_out(vty, " no bgp client-to-client reflection%s", VTY_NEWLINE);
@@ -4978,6 +5352,7 @@ int bgp_config_write(struct vty *vty) {
 		if(bgp_flag_check(bgp, BGP_FLAG_GRACEFUL_RESTART)) {
 			vty_out(vty, " bgp graceful-restart%s", VTY_NEWLINE);
 		}
+		bgp_snapshot_config_write(vty, bgp);
 
 		/* BGP bestpath method. */
 		if(bgp_flag_check(bgp, BGP_FLAG_ASPATH_IGNORE)) {
@@ -5011,6 +5386,22 @@ int bgp_config_write(struct vty *vty) {
 			vty_out(vty, " bgp network import-check%s", VTY_NEWLINE);
 		}
 
+		/* BGP nexthop groups in zebra. */
+		if(bgp_flag_check(bgp, BGP_FLAG_NEXTHOP_GROUP)) {
+			vty_out(vty, " bgp nexthop-group%s", VTY_NEWLINE);
+		}
+
+		/* BGP RS clients sharing a table, before the clients. */
+		if(bgp_flag_check(bgp, BGP_FLAG_RSCLIENT_SHARED)) {
+			vty_out(vty, " bgp route-server shared-rib%s", VTY_NEWLINE);
+		}
+
+		/* BMP collectors. */
+		bgp_bmp_config_write(vty, bgp);
+
+		/* RPKI caches. */
+		bgp_rpki_config_write(vty, bgp);
+
 		/* BGP flag dampening. */
 		if(CHECK_FLAG(bgp->af_flags[AFI_IP][SAFI_UNICAST], BGP_CONFIG_DAMPENING)) {
 			bgp_config_write_damp(vty);
@@ -5082,13 +5473,58 @@ void bgp_master_init(void) {
 	memset(&bgp_master, 0, sizeof(struct bgp_master));
 
 	bm = &bgp_master;
+
+	/* Allocated and freed by the million during convergence. */
+	mtype_slab_init(MTYPE_BGP_NODE, sizeof(struct bgp_node));
+	mtype_slab_init(MTYPE_BGP_ROUTE, sizeof(struct bgp_info));
+	mtype_slab_init(MTYPE_BGP_ADJ_OUT, sizeof(struct bgp_adj_out));
+	mtype_slab_init(MTYPE_BGP_ADVERTISE, sizeof(struct bgp_advertise));
+
 	bm->bgp = list_new();
 	bm->listen_sockets = list_new();
 	bm->port = BGP_PORT_DEFAULT;
 	bm->master = thread_master_create();
+	/* keepalive, holdtime and routeadv timers are re-armed constantly */
+	thread_master_timer_wheel_enable(bm->master);
 	bm->start_time = bgp_clock();
 }
 
+/* Filter changes are picked up at the end of a configuration batch,
+ * but references to a list that may have been freed are dropped at
+ * once.  Cached results of the route-maps matching on the list go now;
+ * the as-path hooks don't say which list changed. */
+static void peer_distribute_add(const char *name) {
+	bgp_rmap_cache_invalidate(name);
+	if(!cmd_batch_defer(peer_distribute_resolve)) {
+		peer_distribute_resolve();
+	}
+}
+
+static void peer_distribute_delete(const char *name) {
+	bgp_rmap_cache_invalidate(name);
+	peer_distribute_resolve();
+}
+
+static void peer_aslist_add(void) {
+	bgp_rmap_cache_flush();
+	if(!cmd_batch_defer(peer_aslist_resolve)) {
+		peer_aslist_resolve();
+	}
+}
+
+static void peer_aslist_delete(void) {
+	bgp_rmap_cache_flush();
+	peer_aslist_resolve();
+}
+
+/* A prefix-list is passed while it lives, and NULL once it is freed. */
+static void peer_prefix_list_update(struct prefix_list *plist) {
+	bgp_rmap_cache_invalidate(plist ? prefix_list_name(plist) : NULL);
+	if(!plist || !cmd_batch_defer(peer_prefix_list_resolve)) {
+		peer_prefix_list_resolve();
+	}
+}
+
 void bgp_init(void) {
 	/* allocates some vital data structures used by peer commands in vty_init */
 	bgp_scan_init();
@@ -5103,22 +5539,31 @@ void bgp_init(void) {
 	bgp_attr_init();
 	bgp_debug_init();
 	bgp_dump_init();
+	bgp_bmp_init();
+	bgp_rpki_init();
+	bgp_snapshot_init();
 	bgp_route_init();
 	bgp_route_map_init();
 	bgp_address_init();
 	bgp_scan_vty_init();
 	bgp_mplsvpn_init();
 	bgp_encap_init();
+	bgp_updgrp_init();
+	bgp_rmap_cache_init();
+	bgp_io_init(bm->io_threads);
 
 	/* Access list initialize. */
 	access_list_init();
-	access_list_add_hook(peer_distribute_update);
-	access_list_delete_hook(peer_distribute_update);
+	access_list_add_hook(peer_distribute_add);
+	access_list_delete_hook(peer_distribute_delete);
+
+	/* AS path and community list regexes. */
+	bgp_regex_init();
 
 	/* Filter list initialize. */
 	bgp_filter_init();
-	as_list_add_hook(peer_aslist_update);
-	as_list_delete_hook(peer_aslist_update);
+	as_list_add_hook(peer_aslist_add);
+	as_list_delete_hook(peer_aslist_delete);
 
 	/* Prefix list initialize.*/
 	prefix_list_init();
@@ -5147,6 +5592,8 @@ void bgp_terminate(void) {
 		}
 	}
 
+	bgp_io_finish();
+	bgp_rmap_cache_finish();
 	bgp_cleanup_routes();
 
 	if(bm->process_main_queue) {
@@ -54,6 +54,21 @@ struct bgp_master {
 	/* BGP start time.  */
 	time_t start_time;
 
+	/* Packet I/O threads, -t/--io_threads */
+	unsigned int io_threads;
+
+	/* Best path selection threads, -s/--select_threads */
+	unsigned int select_threads;
+
+	/* Bytes of the ring to send to zebra through, -R/--zebra_ring */
+	u_int32_t zebra_ring;
+
+	/* No session starts while the configuration is read at startup */
+	int start_hold;
+
+	/* Instances holding back best path selection, see bgp_startup() */
+	int update_delays;
+
 	/* Various BGP global configuration.  */
 	u_char options;
 #define BGP_OPT_NO_FIB (1 << 0)
@@ -79,12 +94,21 @@ struct bgp {
 	/* BGP peer. */
 	struct list *peer;
 
+	/* The same peers by address, chained through su_next. */
+	struct hash *peerhash;
+
 	/* BGP peer group.  */
 	struct list *group;
 
 	/* BGP route-server-clients. */
 	struct list *rsclient;
 
+	/* Table shared by the RS clients, with 'bgp route-server shared-rib' */
+	struct bgp_rs_shared *rs_shared[AFI_MAX][SAFI_MAX];
+
+	/* Update-groups of Established peers, see bgp_updgrp.h */
+	struct list *update_groups;
+
 	/* BGP configuration.  */
 	u_int16_t config;
 #define BGP_CONFIG_ROUTER_ID (1 << 0)
@@ -105,6 +129,15 @@ struct bgp {
 
 	struct thread *t_startup;
 
+	/* Best path selection held after startup, "bgp update-delay": the
+	   instance is read-only meanwhile.  Peers not up after the
+	   establish-wait are not waited for. */
+	u_int16_t v_update_delay;
+	u_int16_t v_establish_wait;
+	struct thread *t_update_delay;
+	struct thread *t_establish_wait;
+	int update_delay_pending;
+
 	/* BGP flags. */
 	u_int32_t flags;
 #define BGP_FLAG_ALWAYS_COMPARE_MED (1 << 0)
@@ -124,6 +157,8 @@ struct bgp {
 #define BGP_FLAG_ASPATH_MULTIPATH_RELAX (1 << 14)
 #define BGP_FLAG_DELETING (1 << 15)
 #define BGP_FLAG_RR_ALLOW_OUTBOUND_POLICY (1 << 16)
+#define BGP_FLAG_NEXTHOP_GROUP (1 << 17)
+#define BGP_FLAG_RSCLIENT_SHARED (1 << 18)
 
 	/* BGP Per AF flags */
 	u_int16_t af_flags[AFI_MAX][SAFI_MAX];
@@ -168,6 +203,9 @@ struct bgp {
 	u_int32_t default_holdtime;
 	u_int32_t default_keepalive;
 
+	/* Route nodes an announce walk takes per run */
+	u_int32_t announce_pace;
+
 	/* BGP graceful restart */
 	u_int32_t restart_time;
 	u_int32_t stalepath_time;
@@ -267,6 +305,14 @@ typedef enum {
 
 #define BGP_MAX_PACKET_SIZE_OVERFLOW 1024
 
+/* How long routes from or to a peer took along, in microseconds */
+struct peer_lag {
+	u_int32_t last;
+	u_int32_t max;
+	u_int64_t total;
+	u_int32_t count;
+};
+
 /* BGP neighbor structure. */
 struct peer {
 	/* BGP structure.  */
@@ -306,6 +352,9 @@ struct peer {
 	/* Packet receive and send buffer. */
 	struct stream *ibuf;
 	struct stream_fifo *obuf;
+
+	/* Set while an I/O thread owns the socket, see bgp_io.h */
+	struct bgp_io_peer *io;
 	struct stream *work;
 
 	/* We use a separate stream to encode MP_REACH_NLRI for efficient
@@ -321,6 +370,15 @@ struct peer {
 	/* Peer index, used for dumping TABLE_DUMP_V2 format */
 	uint16_t table_dump_index;
 
+	/* Peer index in the snapshot being written, 0 for none */
+	uint16_t snapshot_index;
+
+	/* The OPEN messages of the session, for BMP Peer Up, and the
+	 * NOTIFICATION that ended it, for Peer Down */
+	struct stream *open_sent;
+	struct stream *open_rcvd;
+	struct stream *notify_sent;
+
 	/* Peer information */
 	int fd;		     /* File descriptor */
 	int ttl;	     /* TTL of TCP connection to the peer. */
@@ -330,6 +388,7 @@ struct peer {
 	unsigned short port; /* Destination port for peer */
 	char *host;	     /* Printable address of the peer. */
 	union sockunion su;  /* Sockunion address of the peer. */
+	struct peer *su_next; /* Next peer of bgp->peerhash at su. */
 	time_t uptime;	     /* Last Up/Down time */
 	time_t readtime;     /* Last read time */
 	time_t resettime;    /* Last reset time */
@@ -364,6 +423,8 @@ struct peer {
 #define PEER_CAP_AS4_RCV (1 << 8)	   /* as4 received */
 #define PEER_CAP_RESTART_BIT_ADV (1 << 9)  /* sent restart state */
 #define PEER_CAP_RESTART_BIT_RCV (1 << 10) /* peer restart state */
+#define PEER_CAP_EXTENDED_MSG_ADV (1 << 11) /* extended message advertised */
+#define PEER_CAP_EXTENDED_MSG_RCV (1 << 12) /* extended message received */
 
 	/* Capability flags (reset in bgp_stop) */
 	u_int16_t af_cap[AFI_MAX][SAFI_MAX];
@@ -375,6 +436,12 @@ struct peer {
 #define PEER_CAP_ORF_PREFIX_RM_OLD_RCV (1 << 5)	  /* receive-mode received */
 #define PEER_CAP_RESTART_AF_RCV (1 << 6)	  /* graceful restart afi/safi received */
 #define PEER_CAP_RESTART_AF_PRESERVE_RCV (1 << 7) /* graceful restart afi/safi F-bit received */
+#define PEER_CAP_ADDPATH_AF_TX_ADV (1 << 8)	  /* addpath send advertised */
+#define PEER_CAP_ADDPATH_AF_RX_ADV (1 << 9)	  /* addpath receive advertised */
+#define PEER_CAP_ADDPATH_AF_TX_RCV (1 << 10)	  /* addpath send received */
+#define PEER_CAP_ADDPATH_AF_RX_RCV (1 << 11)	  /* addpath receive received */
+#define PEER_CAP_RTC_ADV (1 << 12)		  /* RT constrain advertised, VPNv4 only */
+#define PEER_CAP_RTC_RCV (1 << 13)		  /* RT constrain received, VPNv4 only */
 
 	/* Global configuration flags. */
 	u_int32_t flags;
@@ -387,6 +454,8 @@ struct peer {
 #define PEER_FLAG_DISABLE_CONNECTED_CHECK (1 << 6) /* disable-connected-check */
 #define PEER_FLAG_LOCAL_AS_NO_PREPEND (1 << 7)	   /* local-as no-prepend */
 #define PEER_FLAG_LOCAL_AS_REPLACE_AS (1 << 8)	   /* local-as no-prepend replace-as */
+#define PEER_FLAG_EXTENDED_MESSAGE (1 << 9)	   /* extended message capability */
+#define PEER_FLAG_BFD (1 << 10)			   /* bfd */
 
 	/* NSF mode (graceful restart) */
 	u_char nsf[AFI_MAX][SAFI_MAX];
@@ -412,6 +481,10 @@ struct peer {
 #define PEER_FLAG_NEXTHOP_LOCAL_UNCHANGED (1 << 16) /* leave link-local nexthop unchanged */
 #define PEER_FLAG_NEXTHOP_SELF_ALL (1 << 17)	    /* next-hop-self all */
 #define PEER_FLAG_SEND_LARGE_COMMUNITY (1 << 18)    /* Send large Communities */
+#define PEER_FLAG_ADDPATH_RX (1 << 19)		    /* addpath-receive */
+#define PEER_FLAG_ADDPATH_TX_ALL_PATHS (1 << 20)    /* addpath-tx-all-paths */
+#define PEER_FLAG_ADDPATH_TX_MULTIPATH (1 << 21)    /* addpath-tx-multipath */
+#define PEER_FLAG_RT_CONSTRAIN (1 << 22)	    /* route-target-constrain, VPNv4 only */
 
 	/* MD5 password */
 	char *password;
@@ -431,6 +504,9 @@ struct peer {
 #define PEER_STATUS_GROUP (1 << 4)	     /* peer-group conf */
 #define PEER_STATUS_NSF_MODE (1 << 5)	     /* NSF aware peer */
 #define PEER_STATUS_NSF_WAIT (1 << 6)	     /* wait comeback peer */
+#define PEER_STATUS_IMPLICIT_EOR (1 << 7)    /* keepalive after the table */
+#define PEER_STATUS_BFD (1 << 8)	     /* BFD session registered */
+#define PEER_STATUS_SNAPSHOT (1 << 9)	     /* stale paths from the snapshot */
 
 	/* Peer status af flags (reset in bgp_stop) */
 	u_int16_t af_sflags[AFI_MAX][SAFI_MAX];
@@ -448,11 +524,15 @@ struct peer {
 #define PEER_CONFIG_TIMER (1 << 1)    /* keepalive & holdtime */
 #define PEER_CONFIG_CONNECT (1 << 2)  /* connect */
 #define PEER_CONFIG_ROUTEADV (1 << 3) /* route advertise */
+#define PEER_CONFIG_SNDBUF (1 << 4)   /* socket send buffer */
+#define PEER_CONFIG_RCVBUF (1 << 5)   /* socket receive buffer */
 	u_int32_t weight;
 	u_int32_t holdtime;
 	u_int32_t keepalive;
 	u_int32_t connect;
 	u_int32_t routeadv;
+	u_int32_t sndbuf;
+	u_int32_t rcvbuf;
 
 	/* Timer values. */
 	u_int32_t v_start;
@@ -484,6 +564,8 @@ struct peer {
 	u_int32_t update_in;	   /* Update message input count */
 	u_int32_t update_out;	   /* Update message ouput count */
 	time_t update_time;	   /* Update message received time. */
+	struct peer_lag lag_in;	   /* UPDATE read to best paths worked out */
+	struct peer_lag lag_out;   /* best path changed to UPDATE written */
 	u_int32_t keepalive_in;	   /* Keepalive input count */
 	u_int32_t keepalive_out;   /* Keepalive output count */
 	u_int32_t notify_in;	   /* Notify input count */
@@ -501,27 +583,55 @@ struct peer {
 	struct bgp_synchronize *sync[AFI_MAX][SAFI_MAX];
 	time_t synctime;
 
+	/* Table walks (re)announcing routes, see bgp_announce_route() */
+	struct bgp_announce_walk *announce_walk[AFI_MAX][SAFI_MAX];
+
 	/* Send prefix count. */
 	unsigned long scount[AFI_MAX][SAFI_MAX];
 
 	/* Announcement attribute hash.  */
 	struct hash *hash[AFI_MAX][SAFI_MAX];
 
+	/* Update-group, the thread_call_seq it was last checked at, and the
+	 * peer's index in the group's shared adj-out entries */
+	struct update_group *updgrp[AFI_MAX][SAFI_MAX];
+	unsigned long updgrp_seq[AFI_MAX][SAFI_MAX];
+	u_int16_t updgrp_index[AFI_MAX][SAFI_MAX];
+
+	/* One more than the RS client's index in bgp->rs_shared, 0 while it
+	 * has a table of its own or none.  Peer-group members go by the index
+	 * of the group. */
+	u_int16_t rs_index[AFI_MAX][SAFI_MAX];
+
 	/* Notify data. */
 	struct bgp_notify notify;
 
 	/* Whole packet size to be read. */
 	unsigned long packet_size;
 
+	/* Largest message but OPEN and KEEPALIVE the session allows, either
+	 * way: BGP_EXTENDED_MESSAGE_MAX_PACKET_SIZE once both sides have
+	 * the extended message capability. */
+	bgp_size_t max_packet_size;
+
 	/* Filter structure. */
 	struct bgp_filter filter[AFI_MAX][SAFI_MAX];
 
 	/* ORF Prefix-list */
 	struct prefix_list *orf_plist[AFI_MAX][SAFI_MAX];
 
+	/* RT memberships received, see bgp_rtc.c */
+	struct bgp_rtc *rtc;
+
 	/* Prefix count. */
 	unsigned long pcount[AFI_MAX][SAFI_MAX];
 
+	/* Epoch a path from the peer is stamped with when received, and the
+	 * oldest still alive.  Paths of an older epoch are dead: selection
+	 * leaves them out and reaps them, ahead of the clear queue. */
+	u_int32_t epoch[AFI_MAX][SAFI_MAX];
+	u_int32_t epoch_live[AFI_MAX][SAFI_MAX];
+
 	/* Max prefix count. */
 	unsigned long pmax[AFI_MAX][SAFI_MAX];
 	u_char pmax_threshold[AFI_MAX][SAFI_MAX];
@@ -555,6 +665,7 @@ struct peer {
 #define PEER_DOWN_PASSIVE_CHANGE 20	 /* neighbor passive command */
 #define PEER_DOWN_MULTIHOP_CHANGE 21	 /* neighbor multihop command */
 #define PEER_DOWN_NSF_CLOSE_SESSION 22	 /* NSF tcp session close */
+#define PEER_DOWN_BFD_DOWN 23		 /* BFD session went down */
 
 	/* The kind of route-map Flags.*/
 	u_char rmap_type;
@@ -597,6 +708,7 @@ struct bgp_nlri {
 #define BGP_MARKER_SIZE 16
 #define BGP_HEADER_SIZE 19
 #define BGP_MAX_PACKET_SIZE 4096
+#define BGP_EXTENDED_MESSAGE_MAX_PACKET_SIZE 65535
 
 /* BGP minimum message size.  */
 #define BGP_MSG_OPEN_MIN_SIZE (BGP_HEADER_SIZE + 10)
@@ -747,6 +859,12 @@ struct bgp_nlri {
 /* BGP default local preference.  */
 #define BGP_DEFAULT_LOCAL_PREF 100
 
+/* BGP announce walk default pace */
+#define BGP_ANNOUNCE_PACE_DEFAULT 1000
+
+/* Sessions started per second once the startup configuration is read */
+#define BGP_START_WAVE 32
+
 /* BGP graceful restart  */
 #define BGP_DEFAULT_RESTART_TIME 120
 #define BGP_DEFAULT_STALEPATH_TIME 360
@@ -782,6 +900,16 @@ enum bgp_clear_type {
 #define BGP_INPUT_PNT(P) (STREAM_PNT(BGP_INPUT(P)))
 #define BGP_IS_VALID_STATE_FOR_NOTIF(S) (((S) == OpenSent) || ((S) == OpenConfirm) || ((S) == Established))
 
+/* Whether NLRI to, or from, the peer carry path IDs (Add-Path, RFC 7911) */
+#define BGP_ADDPATH_TX(P, A, S) (CHECK_FLAG((P)->af_cap[(A)][(S)], PEER_CAP_ADDPATH_AF_TX_ADV | PEER_CAP_ADDPATH_AF_RX_RCV) == (PEER_CAP_ADDPATH_AF_TX_ADV | PEER_CAP_ADDPATH_AF_RX_RCV))
+#define BGP_ADDPATH_RX(P, A, S) (CHECK_FLAG((P)->af_cap[(A)][(S)], PEER_CAP_ADDPATH_AF_RX_ADV | PEER_CAP_ADDPATH_AF_TX_RCV) == (PEER_CAP_ADDPATH_AF_RX_ADV | PEER_CAP_ADDPATH_AF_TX_RCV))
+
+/* AFI/SAFIs Add-Path is negotiated for, those with a single level table */
+#define BGP_ADDPATH_SAFI(S) ((S) == SAFI_UNICAST || (S) == SAFI_MULTICAST)
+
+/* Path ID ahead of each prefix */
+#define BGP_ADDPATH_ID_LEN 4
+
 /* BGP error codes.  */
 #define BGP_SUCCESS 0
 #define BGP_ERR_INVALID_VALUE -1
@@ -830,6 +958,7 @@ extern struct bgp *bgp_get_default(void);
 extern struct bgp *bgp_lookup(as_t, const char *);
 extern struct bgp *bgp_lookup_by_name(const char *);
 extern struct peer *peer_lookup(struct bgp *, union sockunion *);
+extern struct peer *peer_index_lookup(struct bgp *, union sockunion *);
 extern struct peer_group *peer_group_lookup(struct bgp *, const char *);
 extern struct peer_group *peer_group_get(struct bgp *, const char *);
 extern struct peer *peer_lookup_with_open(union sockunion *, as_t, struct in_addr *, int *);
@@ -840,6 +969,8 @@ extern struct peer *peer_lookup_with_open(union sockunion *, as_t, struct in_add
  * Provide some functionality to debug locks and unlocks
  */
 extern struct peer *peer_lock_with_caller(const char *, struct peer *);
+extern void peer_lag_add(struct peer_lag *, struct timeval *);
+extern u_int32_t peer_lag_average(struct peer_lag *);
 extern struct peer *peer_unlock_with_caller(const char *, struct peer *);
 #define peer_unlock(A) peer_unlock_with_caller(__FUNCTION__, (A))
 #define peer_lock(B) peer_lock_with_caller(__FUNCTION__, (B))
@@ -847,7 +978,7 @@ extern struct peer *peer_unlock_with_caller(const char *, struct peer *);
 extern bgp_peer_sort_t peer_sort(struct peer *peer);
 extern int peer_active(struct peer *);
 extern int peer_active_nego(struct peer *);
-extern struct peer *peer_create_accept(struct bgp *);
+extern struct peer *peer_create_accept(struct bgp *, union sockunion *);
 extern char *peer_uptime(time_t, char *, size_t);
 extern int bgp_config_write(struct vty *);
 extern void bgp_config_write_family_header(struct vty *, afi_t, safi_t, int *);
@@ -855,6 +986,8 @@ extern void bgp_config_write_family_header(struct vty *, afi_t, safi_t, int *);
 extern void bgp_master_init(void);
 
 extern void bgp_init(void);
+extern void bgp_startup(void);
+extern void bgp_update_delay_check(struct bgp *);
 extern void bgp_route_map_init(void);
 
 extern int bgp_option_set(int);
@@ -931,6 +1064,9 @@ extern int peer_port_unset(struct peer *);
 extern int peer_weight_set(struct peer *, u_int16_t);
 extern int peer_weight_unset(struct peer *);
 
+extern int peer_socket_buffer_set(struct peer *, int, u_int32_t);
+extern int peer_socket_buffer_unset(struct peer *, int);
+
 extern int peer_timers_set(struct peer *, u_int32_t keepalive, u_int32_t holdtime);
 extern int peer_timers_unset(struct peer *);
 
@@ -32,7 +32,6 @@
 #include "if.h"
 #include "stream.h"
 
-#include "isisd/dict.h"
 #include "isisd/include-netbsd/iso.h"
 #include "isisd/isis_constants.h"
 #include "isisd/isis_common.h"
@@ -48,6 +47,7 @@
 #include "isisd/isis_lsp.h"
 #include "isisd/isis_spf.h"
 #include "isisd/isis_events.h"
+#include "isisd/isis_bfd.h"
 
 extern struct isis *isis;
 
@@ -79,6 +79,7 @@ struct isis_adjacency *isis_new_adj(const u_char *id, const u_char *snpa, int le
 
 	adj->circuit = circuit;
 	adj->level = level;
+	adj->mt_mask = 1 << ISIS_MT_IPV4_UNICAST;
 	adj->flaps = 0;
 	adj->last_flap = time(NULL);
 	if(circuit->circ_type == CIRCUIT_T_BROADCAST) {
@@ -128,6 +129,8 @@ void isis_delete_adj(void *arg) {
 	}
 
 	THREAD_TIMER_OFF(adj->t_expire);
+	isis_adj_hello_flush(adj);
+	isis_bfd_adj_deregister(adj);
 
 	/* remove from SPF trees */
 	spftree_area_adj_del(adj->circuit->area, adj);
@@ -166,6 +169,14 @@ void isis_adj_state_change(struct isis_adjacency *adj, enum isis_adj_state new_s
 
 	old_state = adj->adj_state;
 	adj->adj_state = new_state;
+	if(old_state != new_state) {
+		isis_adj_hello_flush(adj);
+	}
+	if(new_state == ISIS_ADJ_UP) {
+		isis_bfd_adj_register(adj);
+	} else if(old_state == ISIS_ADJ_UP) {
+		isis_bfd_adj_deregister(adj);
+	}
 
 	circuit = adj->circuit;
 
@@ -203,9 +214,7 @@ void isis_adj_state_change(struct isis_adjacency *adj, enum isis_adj_state new_s
 				circuit->upadjcount[level - 1]--;
 				if(circuit->upadjcount[level - 1] == 0) {
 					/* Clean lsp_queue when no adj is up. */
-					if(circuit->lsp_queue) {
-						list_delete_all_node(circuit->lsp_queue);
-					}
+					lsp_queue_flush(circuit);
 				}
 				isis_event_adjacency_state_change(adj, new_state);
 				isis_delete_adj(adj);
@@ -248,9 +257,7 @@ void isis_adj_state_change(struct isis_adjacency *adj, enum isis_adj_state new_s
 				circuit->upadjcount[level - 1]--;
 				if(circuit->upadjcount[level - 1] == 0) {
 					/* Clean lsp_queue when no adj is up. */
-					if(circuit->lsp_queue) {
-						list_delete_all_node(circuit->lsp_queue);
-					}
+					lsp_queue_flush(circuit);
 				}
 				isis_event_adjacency_state_change(adj, new_state);
 				isis_delete_adj(adj);
@@ -261,6 +268,42 @@ void isis_adj_state_change(struct isis_adjacency *adj, enum isis_adj_state new_s
 	return;
 }
 
+/*
+ * The image of the last hello that went through the full parse. A hello
+ * matching it only refreshes the hold timer, see process_p2p_hello().
+ */
+void isis_adj_hello_set(struct isis_adjacency *adj, const u_char *image, u_int16_t len) {
+	if(adj->hello && adj->hello_len != len) {
+		isis_adj_hello_flush(adj);
+	}
+	if(!adj->hello) {
+		adj->hello = XMALLOC(MTYPE_ISIS_ADJACENCY, len);
+	}
+	memcpy(adj->hello, image, len);
+	adj->hello_len = len;
+	adj->hello_parsed = time(NULL);
+}
+
+void isis_adj_hello_flush(struct isis_adjacency *adj) {
+	if(adj->hello) {
+		XFREE(MTYPE_ISIS_ADJACENCY, adj->hello);
+		adj->hello = NULL;
+	}
+	adj->hello_len = 0;
+}
+
+/* still reparse now and then, so the adjacency can't go stale on us */
+int isis_adj_hello_same(struct isis_adjacency *adj, const u_char *image, u_int16_t len) {
+	if(!adj->hello || adj->hello_len != len) {
+		return 0;
+	}
+	if(time(NULL) - adj->hello_parsed >= ISIS_HELLO_REPARSE_INTERVAL) {
+		return 0;
+	}
+
+	return memcmp(adj->hello, image, len) == 0;
+}
+
 void isis_adj_print(struct isis_adjacency *adj) {
 	struct isis_dynhn *dyn;
 	struct listnode *node;
@@ -77,6 +77,7 @@ struct isis_adjacency {
 	enum isis_adj_usage adj_usage; /* adjacencyUsage */
 	struct list *area_addrs;       /* areaAdressesOfNeighbour */
 	struct nlpids nlpids;	       /* protocols spoken ... */
+	u_int32_t mt_mask;	       /* topologies (below 32) it is in */
 	struct list *ipv4_addrs;
 	struct in_addr router_address;
 #ifdef HAVE_IPV6
@@ -93,14 +94,25 @@ struct isis_adjacency {
 	int flaps;		      /* number of adjacency flaps  */
 	struct thread *t_expire;      /* expire after hold_time  */
 	struct isis_circuit *circuit; /* back pointer */
+	u_char *hello;		      /* image of the last parsed IIH */
+	u_int16_t hello_len;
+	time_t hello_parsed;	      /* when that IIH was parsed */
+	u_char bfd;		      /* BFD session registered, see isis_bfd.c */
+	struct in_addr bfd_dst;	      /* and its addresses */
+	struct in_addr bfd_src;
 };
 
+#define ISIS_ADJ_HAS_MT(A, M) ((M) < 32 && ((A)->mt_mask & (1 << (M))))
+
 struct isis_adjacency *isis_adj_lookup(const u_char *sysid, struct list *adjdb);
 struct isis_adjacency *isis_adj_lookup_snpa(const u_char *ssnpa, struct list *adjdb);
 struct isis_adjacency *isis_new_adj(const u_char *id, const u_char *snpa, int level, struct isis_circuit *circuit);
 void isis_delete_adj(void *adj);
 void isis_adj_state_change(struct isis_adjacency *adj, enum isis_adj_state state, const char *reason);
 void isis_adj_print(struct isis_adjacency *adj);
+void isis_adj_hello_set(struct isis_adjacency *adj, const u_char *image, u_int16_t len);
+void isis_adj_hello_flush(struct isis_adjacency *adj);
+int isis_adj_hello_same(struct isis_adjacency *adj, const u_char *image, u_int16_t len);
 int isis_adj_expire(struct thread *thread);
 void isis_adj_print_vty(struct isis_adjacency *adj, struct vty *vty, char detail);
 void isis_adj_build_neigh_list(struct list *adjdb, struct list *list);
@@ -0,0 +1,202 @@
+/*
+ * IS-IS adjacencies watched by BFD sessions run in zebra
+ *
+ * This file is part of GNU Zebra.
+ *
+ * GNU Zebra is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2, or (at your option) any
+ * later version.
+ *
+ * GNU Zebra is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with GNU Zebra; see the file COPYING.  If not, write to the Free
+ * Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ * 02111-1307, USA.
+ */
+
+#include <zebra.h>
+
+#include "log.h"
+#include "linklist.h"
+#include "prefix.h"
+#include "if.h"
+#include "stream.h"
+#include "zclient.h"
+
+#include "isisd/isis_constants.h"
+#include "isisd/isis_common.h"
+#include "isisd/isis_flags.h"
+#include "isisd/isisd.h"
+#include "isisd/isis_circuit.h"
+#include "isisd/isis_adjacency.h"
+#include "isisd/isis_misc.h"
+#include "isisd/isis_bfd.h"
+
+extern struct zclient *zclient;
+
+static void isis_bfd_zapi(struct isis_adjacency *adj, struct zapi_bfd *bfd) {
+	memset(bfd, 0, sizeof(struct zapi_bfd));
+	bfd->dst.family = AF_INET;
+	bfd->dst.prefixlen = IPV4_MAX_BITLEN;
+	bfd->dst.u.prefix4 = adj->bfd_dst;
+	bfd->src.family = AF_INET;
+	bfd->src.prefixlen = IPV4_MAX_BITLEN;
+	bfd->src.u.prefix4 = adj->bfd_src;
+	bfd->ifindex = adj->circuit->interface->ifindex;
+	bfd->min_rx = ZEBRA_BFD_MIN_RX_DEFAULT;
+	bfd->min_tx = ZEBRA_BFD_MIN_TX_DEFAULT;
+	bfd->detect_mult = ZEBRA_BFD_DETECT_MULT_DEFAULT;
+}
+
+/* The neighbour's first address, and ours on its subnet or else our
+ * first */
+static int isis_bfd_addrs(struct isis_adjacency *adj) {
+	struct isis_circuit *circuit = adj->circuit;
+	struct listnode *node;
+	struct prefix_ipv4 *ip, *src = NULL;
+	struct prefix_ipv4 dst;
+
+	if(!adj->ipv4_addrs || listcount(adj->ipv4_addrs) == 0 || !circuit->ip_addrs || listcount(circuit->ip_addrs) == 0) {
+		return -1;
+	}
+	dst.family = AF_INET;
+	dst.prefixlen = IPV4_MAX_BITLEN;
+	dst.prefix = *(struct in_addr *) listgetdata(listhead(adj->ipv4_addrs));
+	for(ALL_LIST_ELEMENTS_RO(circuit->ip_addrs, node, ip)) {
+		if(!src || prefix_match((struct prefix *) ip, (struct prefix *) &dst)) {
+			src = ip;
+		}
+	}
+	adj->bfd_dst = dst.prefix;
+	adj->bfd_src = src->prefix;
+	return 0;
+}
+
+void isis_bfd_adj_register(struct isis_adjacency *adj) {
+	struct zapi_bfd bfd;
+
+	if(adj->bfd || !adj->circuit->bfd || adj->adj_state != ISIS_ADJ_UP || isis_bfd_addrs(adj) < 0) {
+		return;
+	}
+	isis_bfd_zapi(adj, &bfd);
+	if(zebra_bfd_send(zclient, ZEBRA_BFD_DEST_REGISTER, &bfd) < 0) {
+		return;
+	}
+	adj->bfd = 1;
+	if(isis->debugs & DEBUG_ADJ_PACKETS) {
+		zlog_debug("ISIS-Adj (%s): BFD session registered to %s", adj->circuit->area->area_tag, inet_ntoa(adj->bfd_dst));
+	}
+}
+
+void isis_bfd_adj_deregister(struct isis_adjacency *adj) {
+	struct zapi_bfd bfd;
+
+	if(!adj->bfd) {
+		return;
+	}
+	adj->bfd = 0;
+	isis_bfd_zapi(adj, &bfd);
+	zebra_bfd_send(zclient, ZEBRA_BFD_DEST_DEREGISTER, &bfd);
+}
+
+/* reset for the sessions zebra forgot */
+static void isis_bfd_adj_update(struct isis_adjacency *adj, int reset) {
+	if(reset) {
+		adj->bfd = 0;
+	}
+	if(adj->circuit->bfd) {
+		isis_bfd_adj_register(adj);
+	} else {
+		isis_bfd_adj_deregister(adj);
+	}
+}
+
+static void isis_bfd_circuit_walk(struct isis_circuit *circuit, int reset) {
+	struct listnode *node;
+	struct isis_adjacency *adj;
+	int level;
+
+	if(circuit->circ_type == CIRCUIT_T_BROADCAST) {
+		for(level = 0; level < ISIS_LEVELS; level++) {
+			if(!circuit->u.bc.adjdb[level]) {
+				continue;
+			}
+			for(ALL_LIST_ELEMENTS_RO(circuit->u.bc.adjdb[level], node, adj)) {
+				isis_bfd_adj_update(adj, reset);
+			}
+		}
+	} else if(circuit->circ_type == CIRCUIT_T_P2P && circuit->u.p2p.neighbor) {
+		isis_bfd_adj_update(circuit->u.p2p.neighbor, reset);
+	}
+}
+
+void isis_bfd_circuit_update(struct isis_circuit *circuit) {
+	isis_bfd_circuit_walk(circuit, 0);
+}
+
+/* The adjacency with the session from src to dst */
+static struct isis_adjacency *isis_bfd_adj_lookup(struct in_addr *dst, struct in_addr *src) {
+	struct listnode *anode, *cnode, *node;
+	struct isis_area *area;
+	struct isis_circuit *circuit;
+	struct isis_adjacency *adj;
+	int level;
+
+	for(ALL_LIST_ELEMENTS_RO(isis->area_list, anode, area)) {
+		for(ALL_LIST_ELEMENTS_RO(area->circuit_list, cnode, circuit)) {
+			if(circuit->circ_type == CIRCUIT_T_P2P) {
+				adj = circuit->u.p2p.neighbor;
+				if(adj && adj->bfd && IPV4_ADDR_SAME(&adj->bfd_dst, dst) && IPV4_ADDR_SAME(&adj->bfd_src, src)) {
+					return adj;
+				}
+				continue;
+			}
+			if(circuit->circ_type != CIRCUIT_T_BROADCAST) {
+				continue;
+			}
+			for(level = 0; level < ISIS_LEVELS; level++) {
+				if(!circuit->u.bc.adjdb[level]) {
+					continue;
+				}
+				for(ALL_LIST_ELEMENTS_RO(circuit->u.bc.adjdb[level], node, adj)) {
+					if(adj->bfd && IPV4_ADDR_SAME(&adj->bfd_dst, dst) && IPV4_ADDR_SAME(&adj->bfd_src, src)) {
+						return adj;
+					}
+				}
+			}
+		}
+	}
+	return NULL;
+}
+
+void isis_bfd_register_all(void) {
+	struct listnode *anode, *cnode;
+	struct isis_area *area;
+	struct isis_circuit *circuit;
+
+	for(ALL_LIST_ELEMENTS_RO(isis->area_list, anode, area)) {
+		for(ALL_LIST_ELEMENTS_RO(area->circuit_list, cnode, circuit)) {
+			isis_bfd_circuit_walk(circuit, 1);
+		}
+	}
+}
+
+int isis_bfd_update(int command, struct zclient *zclient, zebra_size_t length, vrf_id_t vrf_id) {
+	struct zapi_bfd bfd;
+	struct isis_adjacency *adj;
+
+	if(zapi_bfd_decode(zclient->ibuf, &bfd) < 0 || bfd.state != ZEBRA_BFD_DOWN || bfd.dst.family != AF_INET) {
+		return 0;
+	}
+
+	/* One adjacency a level on a LAN, each with its own session */
+	while((adj = isis_bfd_adj_lookup(&bfd.dst.u.prefix4, &bfd.src.u.prefix4)) != NULL) {
+		isis_adj_state_change(adj, ISIS_ADJ_DOWN, "BFD session went down");
+	}
+	return 0;
+}
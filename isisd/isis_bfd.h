@@ -0,0 +1,41 @@
+/*
+ * IS-IS adjacencies watched by BFD sessions run in zebra
+ *
+ * This file is part of GNU Zebra.
+ *
+ * GNU Zebra is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2, or (at your option) any
+ * later version.
+ *
+ * GNU Zebra is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with GNU Zebra; see the file COPYING.  If not, write to the Free
+ * Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ * 02111-1307, USA.
+ */
+
+#ifndef _ZEBRA_ISIS_BFD_H
+#define _ZEBRA_ISIS_BFD_H
+
+/* On a circuit with "isis bfd", each adjacency that is Up and has told
+ * its IPv4 address in its hellos has a session to that address, from
+ * ours on the same subnet, and the session going down brings the
+ * adjacency down without waiting for the holding time. */
+struct zclient;
+struct isis_adjacency;
+struct isis_circuit;
+
+extern void isis_bfd_adj_register(struct isis_adjacency *);
+extern void isis_bfd_adj_deregister(struct isis_adjacency *);
+/* For "isis bfd" set or unset on the circuit */
+extern void isis_bfd_circuit_update(struct isis_circuit *);
+/* For zebra connected again, which knows of no session then */
+extern void isis_bfd_register_all(void);
+extern int isis_bfd_update(int, struct zclient *, zebra_size_t, vrf_id_t);
+
+#endif /* _ZEBRA_ISIS_BFD_H */
@@ -33,7 +33,6 @@
 	#include "stream.h"
 	#include "if.h"
 
-	#include "isisd/dict.h"
 	#include "isisd/include-netbsd/iso.h"
 	#include "isisd/isis_constants.h"
 	#include "isisd/isis_common.h"
@@ -209,6 +208,11 @@ end:
 	return retval;
 }
 
+void isis_sock_close(struct isis_circuit *circuit) {
+	close(circuit->fd);
+	circuit->fd = 0;
+}
+
 int isis_recv_pdu_bcast(struct isis_circuit *circuit, u_char *ssnpa) {
 	int bytesread = 0, bytestoread, offset, one = 1;
 	struct bpf_hdr *bpf_hdr;
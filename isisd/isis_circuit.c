@@ -41,7 +41,6 @@
 #include "prefix.h"
 #include "stream.h"
 
-#include "isisd/dict.h"
 #include "isisd/include-netbsd/iso.h"
 #include "isisd/isis_constants.h"
 #include "isisd/isis_common.h"
@@ -509,7 +508,7 @@ void isis_circuit_if_unbind(struct isis_circuit *circuit, struct interface *ifp)
 static void isis_circuit_update_all_srmflags(struct isis_circuit *circuit, int is_set) {
 	struct isis_area *area;
 	struct isis_lsp *lsp;
-	dnode_t *dnode, *dnode_next;
+	unsigned int i;
 	int level;
 
 	assert(circuit);
@@ -517,12 +516,10 @@ static void isis_circuit_update_all_srmflags(struct isis_circuit *circuit, int i
 	assert(area);
 	for(level = ISIS_LEVEL1; level <= ISIS_LEVEL2; level++) {
 		if(level & circuit->is_type) {
-			if(area->lspdb[level - 1] && dict_count(area->lspdb[level - 1]) > 0) {
-				for(dnode = dict_first(area->lspdb[level - 1]); dnode != NULL; dnode = dnode_next) {
-					dnode_next = dict_next(area->lspdb[level - 1], dnode);
-					lsp = dnode_get(dnode);
+			if(lspdb_count(area->lspdb[level - 1]) > 0) {
+				for(i = 0; (lsp = lspdb_nth(area->lspdb[level - 1], i)); i++) {
 					if(is_set) {
-						ISIS_SET_FLAG(lsp->SRMflags, circuit);
+						lsp_set_srmflag(lsp, circuit);
 					} else {
 						ISIS_CLEAR_FLAG(lsp->SRMflags, circuit);
 					}
@@ -552,8 +549,11 @@ void isis_circuit_stream(struct isis_circuit *circuit, struct stream **stream) {
 int isis_circuit_up(struct isis_circuit *circuit) {
 	int retv;
 
-	/* Set the flags for all the lsps of the circuit. */
-	isis_circuit_update_all_srmflags(circuit, 1);
+	/* Set the flags for all the lsps of the circuit. A blocked circuit
+   * is synchronized by CSNPs only. */
+	if(!circuit->mesh_blocked) {
+		isis_circuit_update_all_srmflags(circuit, 1);
+	}
 
 	if(circuit->state == C_STATE_UP) {
 		return ISIS_OK;
@@ -652,6 +652,8 @@ int isis_circuit_up(struct isis_circuit *circuit) {
 
 	circuit->lsp_queue = list_new();
 	circuit->lsp_queue_last_cleared = time(NULL);
+	circuit->psnp_queue[0] = list_new();
+	circuit->psnp_queue[1] = list_new();
 
 	return ISIS_OK;
 }
@@ -719,10 +721,17 @@ void isis_circuit_down(struct isis_circuit *circuit) {
 	THREAD_OFF(circuit->t_read);
 
 	if(circuit->lsp_queue) {
+		lsp_queue_flush(circuit);
 		circuit->lsp_queue->del = NULL;
 		list_delete(circuit->lsp_queue);
 		circuit->lsp_queue = NULL;
 	}
+	if(circuit->psnp_queue[0]) {
+		lsp_psnp_queue_flush(circuit);
+		list_delete(circuit->psnp_queue[0]);
+		list_delete(circuit->psnp_queue[1]);
+		circuit->psnp_queue[0] = circuit->psnp_queue[1] = NULL;
+	}
 
 	/* send one gratuitous hello to spead up convergence */
 	if(circuit->is_type & IS_LEVEL_1) {
@@ -737,8 +746,7 @@ void isis_circuit_down(struct isis_circuit *circuit) {
 
 	/* close the socket */
 	if(circuit->fd) {
-		close(circuit->fd);
-		circuit->fd = 0;
+		isis_sock_close(circuit);
 	}
 
 	if(circuit->rcv_stream != NULL) {
@@ -909,6 +917,17 @@ int isis_interface_config_write(struct vty *vty) {
 				vty_out(vty, " isis network point-to-point%s", VTY_NEWLINE);
 				write++;
 			}
+			if(circuit->bfd) {
+				vty_out(vty, " isis bfd%s", VTY_NEWLINE);
+				write++;
+			}
+			if(circuit->mesh_blocked) {
+				vty_out(vty, " isis mesh-group blocked%s", VTY_NEWLINE);
+				write++;
+			} else if(circuit->mesh_group) {
+				vty_out(vty, " isis mesh-group %u%s", circuit->mesh_group, VTY_NEWLINE);
+				write++;
+			}
 #ifdef HAVE_IPV6
 			if(circuit->ipv6_router) {
 				vty_out(vty, " ipv6 router isis %s%s", area->area_tag, VTY_NEWLINE);
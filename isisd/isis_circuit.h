@@ -77,12 +77,15 @@ struct isis_circuit {
 	struct thread *t_send_csnp[2];
 	struct thread *t_send_psnp[2];
 	struct list *lsp_queue;	       /* LSPs to be txed (both levels) */
+	struct list *psnp_queue[2];    /* LSPs with SSNflag set, per level */
 	time_t lsp_queue_last_cleared; /* timestamp used to enforce transmit interval;
                                  * for scalability, use one timestamp per 
                                  * circuit, instead of one per lsp per circuit
                                  */
 	/* there is no real point in two streams, just for programming kicker */
 	int (*rx)(struct isis_circuit *circuit, u_char *ssnpa);
+	int (*rx_pending)(struct isis_circuit *circuit); /* more to rx now? */
+	struct isis_pfring *pfring; /* PACKET_MMAP rings, isis_pfpacket.c */
 	struct stream *rcv_stream; /* Stream for receiving */
 	int (*tx)(struct isis_circuit *circuit, int level);
 	struct stream *snd_stream; /* Stream for sending */
@@ -118,6 +121,9 @@ struct isis_circuit {
 	struct mpls_te_circuit *mtc; /* Support for MPLS-TE parameters - see isis_te.[c,h] */
 	int ip_router;		     /* Route IP ? */
 	int is_passive;		     /* Is Passive ? */
+	u_int32_t mesh_group;	     /* RFC 2973 mesh group, 0 if none */
+	int mesh_blocked;	     /* don't flood LSPs on this circuit */
+	int bfd;		     /* BFD to the adjacencies ? */
 	struct list *ip_addrs;	     /* our IP addresses */
 #ifdef HAVE_IPV6
 	int ipv6_router;	    /* Route IPv6 ? */
@@ -69,6 +69,7 @@
 #define MIN_MIN_LSP_GEN_INTERVAL 1
 #define MAX_MIN_LSP_GEN_INTERVAL 120 /* RFC 4444 says 65535 */
 #define DEFAULT_MIN_LSP_GEN_INTERVAL 30
+#define DEFAULT_REDIST_DELAY 500 /* msec */
 
 #define MIN_LSP_TRANS_INTERVAL 5
 
@@ -79,10 +80,13 @@
 #define MIN_PSNP_INTERVAL 1
 #define MAX_PSNP_INTERVAL 120
 #define DEFAULT_PSNP_INTERVAL 2
+#define PSNP_MAX_BURST 8 /* PSNPs per circuit and run */
+#define PSNP_PACE_INTERVAL 250 /* msecs until the next run */
 
 #define MIN_HELLO_INTERVAL 1
 #define MAX_HELLO_INTERVAL 600
 #define DEFAULT_HELLO_INTERVAL 3
+#define ISIS_HELLO_REPARSE_INTERVAL 10 /* secs a repeated IIH is trusted */
 
 #define MIN_HELLO_MULTIPLIER 2
 #define MAX_HELLO_MULTIPLIER 100
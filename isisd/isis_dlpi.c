@@ -37,7 +37,6 @@
 	#include "stream.h"
 	#include "if.h"
 
-	#include "isisd/dict.h"
 	#include "isisd/include-netbsd/iso.h"
 	#include "isisd/isis_constants.h"
 	#include "isisd/isis_common.h"
@@ -462,6 +461,11 @@ end:
 	return retval;
 }
 
+void isis_sock_close(struct isis_circuit *circuit) {
+	close(circuit->fd);
+	circuit->fd = 0;
+}
+
 int isis_recv_pdu_bcast(struct isis_circuit *circuit, u_char *ssnpa) {
 	struct pollfd fds[1];
 	struct strbuf ctlbuf, databuf;
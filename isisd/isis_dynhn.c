@@ -30,8 +30,9 @@
 #include "command.h"
 #include "if.h"
 #include "thread.h"
+#include "hash.h"
+#include "jhash.h"
 
-#include "isisd/dict.h"
 #include "isisd/isis_constants.h"
 #include "isisd/isis_common.h"
 #include "isisd/isis_flags.h"
@@ -44,60 +45,91 @@
 extern struct host host;
 
 struct list *dyn_cache = NULL;
-static int dyn_cache_cleanup(struct thread *);
+static struct hash *dyn_by_id = NULL;
+static struct hash *dyn_by_name = NULL;
+static int dyn_cache_expire(struct thread *);
+
+static unsigned int dynhn_id_key(void *arg) {
+	struct isis_dynhn *dyn = arg;
+
+	return jhash(dyn->id, ISIS_SYS_ID_LEN, 0);
+}
+
+static int dynhn_id_cmp(const void *a, const void *b) {
+	const struct isis_dynhn *da = a, *db = b;
+
+	return memcmp(da->id, db->id, ISIS_SYS_ID_LEN) == 0;
+}
+
+static unsigned int dynhn_name_key(void *arg) {
+	struct isis_dynhn *dyn = arg;
+
+	return jhash(dyn->name.name, dyn->name.namelen, 0);
+}
+
+static int dynhn_name_cmp(const void *a, const void *b) {
+	const struct isis_dynhn *da = a, *db = b;
+
+	return da->name.namelen == db->name.namelen && memcmp(da->name.name, db->name.name, da->name.namelen) == 0;
+}
 
 void dyn_cache_init(void) {
 	if(dyn_cache == NULL) {
 		dyn_cache = list_new();
+		dyn_by_id = hash_create_open(dynhn_id_key, dynhn_id_cmp);
+		dyn_by_name = hash_create_open(dynhn_name_key, dynhn_name_cmp);
 	}
-	THREAD_TIMER_ON(master, isis->t_dync_clean, dyn_cache_cleanup, NULL, 120);
 	return;
 }
 
-static int dyn_cache_cleanup(struct thread *thread) {
-	struct listnode *node, *nnode;
-	struct isis_dynhn *dyn;
-	time_t now = time(NULL);
+/* a duplicate hostname stays indexed under the first system using it */
+static void dynhn_name_release(struct isis_dynhn *dyn) {
+	if(hash_lookup(dyn_by_name, dyn) == dyn) {
+		hash_release(dyn_by_name, dyn);
+	}
+}
 
-	isis->t_dync_clean = NULL;
+static void dynhn_free(struct isis_dynhn *dyn) {
+	THREAD_TIMER_OFF(dyn->t_expire);
+	hash_release(dyn_by_id, dyn);
+	dynhn_name_release(dyn);
+	list_delete_node(dyn_cache, dyn->node);
+	XFREE(MTYPE_ISIS_DYNHN, dyn);
+}
 
-	for(ALL_LIST_ELEMENTS(dyn_cache, node, nnode, dyn)) {
-		if((now - dyn->refresh) < MAX_LSP_LIFETIME) {
-			continue;
-		}
+/*
+ * The timer is armed once per entry. Refreshes only move dyn->refresh,
+ * so an entry that is still being refreshed is rearmed for the rest of
+ * its lifetime when it fires.
+ */
+static int dyn_cache_expire(struct thread *thread) {
+	struct isis_dynhn *dyn = THREAD_ARG(thread);
+	time_t age = time(NULL) - dyn->refresh;
 
-		list_delete_node(dyn_cache, node);
-		XFREE(MTYPE_ISIS_DYNHN, dyn);
+	dyn->t_expire = NULL;
+
+	if(age < MAX_LSP_LIFETIME) {
+		THREAD_TIMER_ON(master, dyn->t_expire, dyn_cache_expire, dyn, MAX_LSP_LIFETIME - age);
+		return ISIS_OK;
 	}
 
-	THREAD_TIMER_ON(master, isis->t_dync_clean, dyn_cache_cleanup, NULL, 120);
+	dynhn_free(dyn);
 	return ISIS_OK;
 }
 
 struct isis_dynhn *dynhn_find_by_id(const u_char *id) {
-	struct listnode *node = NULL;
-	struct isis_dynhn *dyn = NULL;
+	struct isis_dynhn key;
 
-	for(ALL_LIST_ELEMENTS_RO(dyn_cache, node, dyn)) {
-		if(memcmp(dyn->id, id, ISIS_SYS_ID_LEN) == 0) {
-			return dyn;
-		}
-	}
-
-	return NULL;
+	memcpy(key.id, id, ISIS_SYS_ID_LEN);
+	return hash_lookup(dyn_by_id, &key);
 }
 
 struct isis_dynhn *dynhn_find_by_name(const char *hostname) {
-	struct listnode *node = NULL;
-	struct isis_dynhn *dyn = NULL;
+	struct isis_dynhn key;
 
-	for(ALL_LIST_ELEMENTS_RO(dyn_cache, node, dyn)) {
-		if(strncmp((char *) dyn->name.name, hostname, 255) == 0) {
-			return dyn;
-		}
-	}
-
-	return NULL;
+	key.name.namelen = strnlen(hostname, sizeof(key.name.name));
+	memcpy(key.name.name, hostname, key.name.namelen);
+	return hash_lookup(dyn_by_name, &key);
 }
 
 void isis_dynhn_insert(const u_char *id, struct hostname *hostname, int level) {
@@ -105,8 +137,12 @@ void isis_dynhn_insert(const u_char *id, struct hostname *hostname, int level) {
 
 	dyn = dynhn_find_by_id(id);
 	if(dyn) {
-		memcpy(&dyn->name, hostname, hostname->namelen + 1);
-		memcpy(dyn->id, id, ISIS_SYS_ID_LEN);
+		if(dyn->name.namelen != hostname->namelen || memcmp(dyn->name.name, hostname->name, hostname->namelen)) {
+			dynhn_name_release(dyn);
+			memset(&dyn->name, 0, sizeof(dyn->name));
+			memcpy(&dyn->name, hostname, hostname->namelen + 1);
+			hash_get(dyn_by_name, dyn, hash_alloc_intern);
+		}
 		dyn->refresh = time(NULL);
 		return;
 	}
@@ -123,6 +159,10 @@ void isis_dynhn_insert(const u_char *id, struct hostname *hostname, int level) {
 	dyn->level = level;
 
 	listnode_add(dyn_cache, dyn);
+	dyn->node = listtail(dyn_cache);
+	hash_get(dyn_by_id, dyn, hash_alloc_intern);
+	hash_get(dyn_by_name, dyn, hash_alloc_intern);
+	THREAD_TIMER_ON(master, dyn->t_expire, dyn_cache_expire, dyn, MAX_LSP_LIFETIME);
 
 	return;
 }
@@ -134,8 +174,7 @@ void isis_dynhn_remove(const u_char *id) {
 	if(!dyn) {
 		return;
 	}
-	listnode_delete(dyn_cache, dyn);
-	XFREE(MTYPE_ISIS_DYNHN, dyn);
+	dynhn_free(dyn);
 	return;
 }
 
@@ -28,6 +28,8 @@ struct isis_dynhn {
 	struct hostname name;
 	time_t refresh;
 	int level;
+	struct listnode *node; /* in dyn_cache */
+	struct thread *t_expire;
 };
 
 void dyn_cache_init(void);
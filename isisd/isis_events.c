@@ -32,7 +32,6 @@
 #include "stream.h"
 #include "table.h"
 
-#include "isisd/dict.h"
 #include "isisd/include-netbsd/iso.h"
 #include "isisd/isis_constants.h"
 #include "isisd/isis_common.h"
@@ -33,12 +33,12 @@
 #include "prefix.h"
 #include "command.h"
 #include "hash.h"
+#include "jhash.h"
 #include "if.h"
 #include "checksum.h"
 #include "md5.h"
 #include "table.h"
 
-#include "isisd/dict.h"
 #include "isisd/isis_constants.h"
 #include "isisd/isis_common.h"
 #include "isisd/isis_flags.h"
@@ -46,6 +46,7 @@
 #include "isisd/isisd.h"
 #include "isisd/isis_tlv.h"
 #include "isisd/isis_lsp.h"
+#include "isisd/isis_lspdb.h"
 #include "isisd/isis_pdu.h"
 #include "isisd/isis_dynhn.h"
 #include "isisd/isis_misc.h"
@@ -70,33 +71,22 @@ int lsp_id_cmp(u_char *id1, u_char *id2) {
 	return memcmp(id1, id2, ISIS_SYS_ID_LEN + 2);
 }
 
-dict_t *lsp_db_init(void) {
-	dict_t *dict;
-
-	dict = dict_create(DICTCOUNT_T_MAX, (dict_comp_t) lsp_id_cmp);
-
-	return dict;
+struct isis_lspdb *lsp_db_init(void) {
+	return lspdb_new();
 }
 
-struct isis_lsp *lsp_search(u_char *id, dict_t *lspdb) {
-	dnode_t *node;
-
+struct isis_lsp *lsp_search(u_char *id, struct isis_lspdb *lspdb) {
 #ifdef EXTREME_DEBUG
-	dnode_t *dn;
+	struct isis_lsp *lsp;
+	unsigned int i;
 
 	zlog_debug("searching db");
-	for(dn = dict_first(lspdb); dn; dn = dict_next(lspdb, dn)) {
-		zlog_debug("%s\t%pX", rawlspid_print((u_char *) dnode_getkey(dn)), dnode_get(dn));
+	for(i = 0; (lsp = lspdb_nth(lspdb, i)); i++) {
+		zlog_debug("%s\t%pX", rawlspid_print(lsp->lsp_header->lsp_id), lsp);
 	}
 #endif /* EXTREME DEBUG */
 
-	node = dict_lookup(lspdb, id);
-
-	if(node) {
-		return (struct isis_lsp *) dnode_get(node);
-	}
-
-	return NULL;
+	return lspdb_lookup(lspdb, id);
 }
 
 static void lsp_clear_data(struct isis_lsp *lsp) {
@@ -124,28 +114,33 @@ static void lsp_clear_data(struct isis_lsp *lsp) {
 }
 
 static void lsp_destroy(struct isis_lsp *lsp) {
-	struct listnode *cnode, *lnode, *lnnode;
-	struct isis_lsp *lsp_in_list;
+	struct listnode *cnode;
 	struct isis_circuit *circuit;
 
 	if(!lsp) {
 		return;
 	}
 
-	if(lsp->area->circuit_list) {
+	THREAD_TIMER_OFF(lsp->t_aging);
+
+	if(lsp->area->circuit_list && (flags_any_set(lsp->SRMqueued) || flags_any_set(lsp->SSNqueued))) {
 		for(ALL_LIST_ELEMENTS_RO(lsp->area->circuit_list, cnode, circuit)) {
-			if(circuit->lsp_queue == NULL) {
-				continue;
+			if(circuit->lsp_queue && ISIS_CHECK_FLAG(lsp->SRMqueued, circuit)) {
+				listnode_delete(circuit->lsp_queue, lsp);
 			}
-			for(ALL_LIST_ELEMENTS(circuit->lsp_queue, lnode, lnnode, lsp_in_list)) {
-				if(lsp_in_list == lsp) {
-					list_delete_node(circuit->lsp_queue, lnode);
-				}
+			if(circuit->psnp_queue[lsp->level - 1] && ISIS_CHECK_FLAG(lsp->SSNqueued, circuit)) {
+				listnode_delete(circuit->psnp_queue[lsp->level - 1], lsp);
 			}
 		}
 	}
+	if(lsp->srm_node) {
+		list_delete_node(lsp->area->lsp_srm_list, lsp->srm_node);
+		lsp->srm_node = NULL;
+	}
 	ISIS_FLAGS_CLEAR_ALL(lsp->SSNflags);
+	ISIS_FLAGS_CLEAR_ALL(lsp->SSNqueued);
 	ISIS_FLAGS_CLEAR_ALL(lsp->SRMflags);
+	ISIS_FLAGS_CLEAR_ALL(lsp->SRMqueued);
 
 	lsp_clear_data(lsp);
 
@@ -154,10 +149,7 @@ static void lsp_destroy(struct isis_lsp *lsp) {
 		lsp->lspu.frags = NULL;
 	}
 
-	isis_spf_schedule(lsp->area, lsp->level);
-#ifdef HAVE_IPV6
-	isis_spf_schedule6(lsp->area, lsp->level);
-#endif
+	isis_spf_schedule_lsp(lsp->area, lsp->level, lsp->lsp_header->lsp_id, 1);
 
 	if(lsp->pdu) {
 		stream_free(lsp->pdu);
@@ -165,20 +157,9 @@ static void lsp_destroy(struct isis_lsp *lsp) {
 	XFREE(MTYPE_ISIS_LSP, lsp);
 }
 
-void lsp_db_destroy(dict_t *lspdb) {
-	dnode_t *dnode, *next;
-	struct isis_lsp *lsp;
-
-	dnode = dict_first(lspdb);
-	while(dnode) {
-		next = dict_next(lspdb, dnode);
-		lsp = dnode_get(dnode);
-		lsp_destroy(lsp);
-		dict_delete_free(lspdb, dnode);
-		dnode = next;
-	}
-
-	dict_free(lspdb);
+void lsp_db_destroy(struct isis_lspdb *lspdb) {
+	lspdb_iterate(lspdb, lsp_destroy);
+	lspdb_free(lspdb);
 
 	return;
 }
@@ -186,15 +167,13 @@ void lsp_db_destroy(dict_t *lspdb) {
 /*
  * Remove all the frags belonging to the given lsp
  */
-static void lsp_remove_frags(struct list *frags, dict_t *lspdb) {
-	dnode_t *dnode;
+static void lsp_remove_frags(struct list *frags, struct isis_lspdb *lspdb) {
 	struct listnode *lnode, *lnnode;
 	struct isis_lsp *lsp;
 
 	for(ALL_LIST_ELEMENTS(frags, lnode, lnnode, lsp)) {
-		dnode = dict_lookup(lspdb, lsp->lsp_header->lsp_id);
+		lspdb_del(lspdb, lsp);
 		lsp_destroy(lsp);
-		dnode_destroy(dict_delete(lspdb, dnode));
 	}
 
 	list_delete_all_node(frags);
@@ -202,14 +181,12 @@ static void lsp_remove_frags(struct list *frags, dict_t *lspdb) {
 	return;
 }
 
-void lsp_search_and_destroy(u_char *id, dict_t *lspdb) {
-	dnode_t *node;
+void lsp_search_and_destroy(u_char *id, struct isis_lspdb *lspdb) {
 	struct isis_lsp *lsp;
 
-	node = dict_lookup(lspdb, id);
-	if(node) {
-		node = dict_delete(lspdb, node);
-		lsp = dnode_get(node);
+	lsp = lspdb_lookup(lspdb, id);
+	if(lsp) {
+		lspdb_del(lspdb, lsp);
 		/*
        * If this is a zero lsp, remove all the frags now
        */
@@ -226,7 +203,6 @@ void lsp_search_and_destroy(u_char *id, dict_t *lspdb) {
 			}
 		}
 		lsp_destroy(lsp);
-		dnode_destroy(node);
 	}
 }
 
@@ -453,21 +429,21 @@ static void lsp_update_data(struct isis_lsp *lsp, struct stream *stream, struct
 	expected |= TLVFLAG_AREA_ADDRS;
 	expected |= TLVFLAG_IS_NEIGHS;
 	expected |= TLVFLAG_NLPID;
+	expected |= TLVFLAG_MT_ROUTER_INFO;
+	expected |= TLVFLAG_MT_IS_NEIGHS;
 	if(area->dynhostname) {
 		expected |= TLVFLAG_DYN_HOSTNAME;
 	}
 	if(area->newmetric) {
 		expected |= TLVFLAG_TE_IS_NEIGHS;
-		expected |= TLVFLAG_TE_IPV4_REACHABILITY;
 		expected |= TLVFLAG_TE_ROUTER_ID;
 	}
 	expected |= TLVFLAG_IPV4_ADDR;
-	expected |= TLVFLAG_IPV4_INT_REACHABILITY;
-	expected |= TLVFLAG_IPV4_EXT_REACHABILITY;
 #ifdef HAVE_IPV6
 	expected |= TLVFLAG_IPV6_ADDR;
-	expected |= TLVFLAG_IPV6_REACHABILITY;
 #endif /* HAVE_IPV6 */
+	/* the IP reachability TLVs are read off lsp->pdu when needed, see
+   * lsp_reach_iter_init() */
 
 	retval = parse_tlvs(area->area_tag, STREAM_DATA(lsp->pdu) + ISIS_FIXED_HDR_LEN + ISIS_LSP_HDR_LEN, ntohs(lsp->lsp_header->pdu_len) - ISIS_FIXED_HDR_LEN - ISIS_LSP_HDR_LEN, &expected, &found, &lsp->tlv_data, NULL);
 	if(retval != ISIS_OK) {
@@ -482,22 +458,92 @@ static void lsp_update_data(struct isis_lsp *lsp, struct stream *stream, struct
 	return;
 }
 
-void lsp_update(struct isis_lsp *lsp, struct stream *stream, struct isis_area *area, int level) {
-	dnode_t *dnode = NULL;
+static void lsp_install(struct isis_lsp *lsp, int topology);
+
+/*
+ * What the SPF takes from an LSP other than its IP reachability, laid
+ * out for lsp_update() to compare and tell when the PRC is enough.
+ */
+static struct stream *lsp_topology(struct isis_lsp *lsp) {
+	struct listnode *node;
+	struct is_neigh *is_neigh;
+	struct te_is_neigh *te_is_neigh;
+	struct mt_is_neigh *mt_is_neigh;
+	struct mt_router_info *mt_info;
+	struct stream *s;
+	size_t size = 3;
 
-	/* Remove old LSP from database. This is required since the
-   * lsp_update_data will free the lsp->pdu (which has the key, lsp_id)
-   * and will update it with the new data in the stream. */
-	dnode = dict_lookup(area->lspdb[level - 1], lsp->lsp_header->lsp_id);
-	if(dnode) {
-		dnode_destroy(dict_delete(area->lspdb[level - 1], dnode));
+	if(lsp->tlv_data.nlpids) {
+		size += lsp->tlv_data.nlpids->count;
+	}
+	if(lsp->tlv_data.is_neighs) {
+		size += listcount(lsp->tlv_data.is_neighs) * (ISIS_SYS_ID_LEN + 2);
+	}
+	if(lsp->tlv_data.te_is_neighs) {
+		size += listcount(lsp->tlv_data.te_is_neighs) * (ISIS_SYS_ID_LEN + 4);
+	}
+	if(lsp->tlv_data.mt_router_info) {
+		size += listcount(lsp->tlv_data.mt_router_info) * (MT_ID_LEN + 2);
+	}
+	if(lsp->tlv_data.mt_is_neighs) {
+		size += listcount(lsp->tlv_data.mt_is_neighs) * (MT_ID_LEN + ISIS_SYS_ID_LEN + 4);
+	}
+	s = stream_new(size);
+
+	stream_putc(s, ISIS_MASK_LSP_OL_BIT(lsp->lsp_header->lsp_bits) ? 1 : 0);
+	stream_putc(s, lsp->lsp_header->rem_lifetime != 0 && lsp->lsp_header->seq_num != 0);
+	if(lsp->tlv_data.nlpids) {
+		stream_putc(s, lsp->tlv_data.nlpids->count);
+		stream_put(s, lsp->tlv_data.nlpids->nlpids, lsp->tlv_data.nlpids->count);
+	} else {
+		stream_putc(s, 0);
+	}
+	if(lsp->tlv_data.is_neighs) {
+		for(ALL_LIST_ELEMENTS_RO(lsp->tlv_data.is_neighs, node, is_neigh)) {
+			stream_put(s, is_neigh->neigh_id, ISIS_SYS_ID_LEN + 1);
+			stream_putc(s, is_neigh->metrics.metric_default);
+		}
+	}
+	if(lsp->tlv_data.te_is_neighs) {
+		for(ALL_LIST_ELEMENTS_RO(lsp->tlv_data.te_is_neighs, node, te_is_neigh)) {
+			stream_put(s, te_is_neigh->neigh_id, ISIS_SYS_ID_LEN + 1);
+			stream_put(s, te_is_neigh->te_metric, 3);
+		}
 	}
+	if(lsp->tlv_data.mt_router_info) {
+		for(ALL_LIST_ELEMENTS_RO(lsp->tlv_data.mt_router_info, node, mt_info)) {
+			stream_putw(s, mt_info->mtid);
+			stream_putc(s, mt_info->overload);
+			stream_putc(s, mt_info->attached);
+		}
+	}
+	if(lsp->tlv_data.mt_is_neighs) {
+		for(ALL_LIST_ELEMENTS_RO(lsp->tlv_data.mt_is_neighs, node, mt_is_neigh)) {
+			stream_putw(s, mt_is_neigh->mtid);
+			stream_put(s, mt_is_neigh->neigh_id, ISIS_SYS_ID_LEN + 1);
+			stream_put(s, mt_is_neigh->te_metric, 3);
+		}
+	}
+
+	return s;
+}
 
-	/* rebuild the lsp data */
+void lsp_update(struct isis_lsp *lsp, struct stream *stream, struct isis_area *area, int level) {
+	struct stream *old_topology, *new_topology;
+	int topology;
+
+	old_topology = lsp_topology(lsp);
+
+	/* rebuild the lsp data, the lspdb keeps its own copy of the lsp_id
+   * so the lsp stays in place while lsp->pdu is replaced */
 	lsp_update_data(lsp, stream, area, level);
 
-	/* insert the lsp back into the database */
-	lsp_insert(lsp, area->lspdb[level - 1]);
+	new_topology = lsp_topology(lsp);
+	topology = stream_get_endp(old_topology) != stream_get_endp(new_topology) || memcmp(STREAM_DATA(old_topology), STREAM_DATA(new_topology), stream_get_endp(new_topology)) != 0;
+	stream_free(old_topology);
+	stream_free(new_topology);
+
+	lsp_install(lsp, topology);
 }
 
 /* creation of LSP directly from what we received */
@@ -561,117 +607,140 @@ struct isis_lsp *lsp_new(struct isis_area *area, u_char *lsp_id, u_int16_t rem_l
 	return lsp;
 }
 
-void lsp_insert(struct isis_lsp *lsp, dict_t *lspdb) {
-	dict_alloc_insert(lspdb, lsp->lsp_header->lsp_id, lsp);
-	if(lsp->lsp_header->seq_num != 0) {
-		isis_spf_schedule(lsp->area, lsp->level);
-#ifdef HAVE_IPV6
-		isis_spf_schedule6(lsp->area, lsp->level);
-#endif
-	}
-}
+static void lsp_schedule_aging(struct isis_lsp *lsp);
 
 /*
- * Build a list of LSPs with non-zero ht bounded by start and stop ids
+ * ZeroAgeLifetime (or MaxAge for purges) has elapsed - remove the lsp
  */
-void lsp_build_list_nonzero_ht(u_char *start_id, u_char *stop_id, struct list *list, dict_t *lspdb) {
-	dnode_t *first, *last, *curr;
-
-	first = dict_lower_bound(lspdb, start_id);
-	if(!first) {
-		return;
-	}
-
-	last = dict_upper_bound(lspdb, stop_id);
+static int lsp_age_out(struct thread *thread) {
+	struct isis_lsp *lsp;
 
-	curr = first;
+	lsp = THREAD_ARG(thread);
+	assert(lsp);
+	lsp->t_aging = NULL;
 
-	if(((struct isis_lsp *) (curr->dict_data))->lsp_header->rem_lifetime) {
-		listnode_add(list, first->dict_data);
+	zlog_debug("ISIS-Upd (%s): L%u LSP %s seq 0x%08x aged out", lsp->area->area_tag, lsp->level, rawlspid_print(lsp->lsp_header->lsp_id), ntohl(lsp->lsp_header->seq_num));
+#ifdef TOPOLOGY_GENERATE
+	if(lsp->from_topology) {
+		THREAD_TIMER_OFF(lsp->t_lsp_top_ref);
 	}
+#endif /* TOPOLOGY_GENERATE */
 
-	while(curr) {
-		curr = dict_next(lspdb, curr);
-		if(curr && ((struct isis_lsp *) (curr->dict_data))->lsp_header->rem_lifetime) {
-			listnode_add(list, curr->dict_data);
-		}
-		if(curr == last) {
-			break;
-		}
+	if(lsp->area->lspdb[lsp->level - 1]) {
+		lspdb_del(lsp->area->lspdb[lsp->level - 1], lsp);
 	}
+	lsp_destroy(lsp);
 
-	return;
+	return ISIS_OK;
 }
 
 /*
- * Build a list of num_lsps LSPs bounded by start_id and stop_id.
+ * The remaining lifetime of the lsp has reached zero
  */
-void lsp_build_list(u_char *start_id, u_char *stop_id, u_char num_lsps, struct list *list, dict_t *lspdb) {
-	u_char count;
-	dnode_t *first, *last, *curr;
+static int lsp_expire(struct thread *thread) {
+	struct isis_lsp *lsp;
 
-	first = dict_lower_bound(lspdb, start_id);
-	if(!first) {
-		return;
+	lsp = THREAD_ARG(thread);
+	assert(lsp);
+	lsp->t_aging = NULL;
+
+	lsp->lsp_header->rem_lifetime = 0;
+
+	/*
+   * Schedule may run spf which should be done only after
+   * the lsp rem_lifetime becomes 0 for the first time.
+   * ISO 10589 - 7.3.16.4 first paragraph.
+   */
+	if(lsp->lsp_header->seq_num != 0) {
+		/* 7.3.16.4 a) set SRM flags on all */
+		lsp_set_all_srmflags(lsp);
+		/* 7.3.16.4 b) retain only the header FIXME  */
+		/* 7.3.16.4 c) record the time to purge FIXME */
+		/* run/schedule spf */
+		/* isis_spf_schedule is called inside lsp_destroy() once
+       * the lsp ages out; so it is not needed here. */
 	}
 
-	last = dict_upper_bound(lspdb, stop_id);
+	lsp_schedule_aging(lsp);
 
-	curr = first;
+	return ISIS_OK;
+}
 
-	listnode_add(list, first->dict_data);
-	count = 1;
+/*
+ * (Re)arm the aging timer after rem_lifetime or age_out was set.
+ * The header lifetime is only brought up to date by lsp_set_time()
+ * when someone looks at it, so LSPs cost nothing per second.
+ */
+static void lsp_schedule_aging(struct isis_lsp *lsp) {
+	THREAD_TIMER_OFF(lsp->t_aging);
+	lsp->lifetime_at = recent_relative_time().tv_sec;
 
-	while(curr) {
-		curr = dict_next(lspdb, curr);
-		if(curr) {
-			listnode_add(list, curr->dict_data);
-			count++;
-		}
-		if(count == num_lsps || curr == last) {
-			break;
-		}
+	if(lsp->lsp_header->rem_lifetime != 0) {
+		THREAD_TIMER_ON(master, lsp->t_aging, lsp_expire, lsp, ntohs(lsp->lsp_header->rem_lifetime));
+	} else {
+		THREAD_TIMER_ON(master, lsp->t_aging, lsp_age_out, lsp, lsp->age_out);
+	}
+}
+
+/* topology 0: only the IP reachability of the lsp changed */
+static void lsp_install(struct isis_lsp *lsp, int topology) {
+	lsp_schedule_aging(lsp);
+	if(lsp->lsp_header->seq_num != 0) {
+		isis_spf_schedule_lsp(lsp->area, lsp->level, lsp->lsp_header->lsp_id, topology);
 	}
+}
 
-	return;
+void lsp_insert(struct isis_lsp *lsp, struct isis_lspdb *lspdb) {
+	lspdb_add(lspdb, lsp);
+	lsp_install(lsp, 1);
 }
 
 /*
- * Build a list of LSPs with SSN flag set for the given circuit
+ * Build a list of LSPs with non-zero ht bounded by start and stop ids
  */
-void lsp_build_list_ssn(struct isis_circuit *circuit, u_char num_lsps, struct list *list, dict_t *lspdb) {
-	dnode_t *dnode, *next;
+void lsp_build_list_nonzero_ht(u_char *start_id, u_char *stop_id, struct list *list, struct isis_lspdb *lspdb) {
 	struct isis_lsp *lsp;
-	u_char count = 0;
+	unsigned int i, last;
 
-	dnode = dict_first(lspdb);
-	while(dnode != NULL) {
-		next = dict_next(lspdb, dnode);
-		lsp = dnode_get(dnode);
-		if(ISIS_CHECK_FLAG(lsp->SSNflags, circuit)) {
+	last = lspdb_upper_bound(lspdb, stop_id);
+	for(i = lspdb_lower_bound(lspdb, start_id); i < last; i++) {
+		lsp = lspdb_nth(lspdb, i);
+		if(lsp->lsp_header->rem_lifetime) {
 			listnode_add(list, lsp);
-			++count;
 		}
-		if(count == num_lsps) {
-			break;
-		}
-		dnode = next;
 	}
 
 	return;
 }
 
-static void lsp_set_time(struct isis_lsp *lsp) {
+void lsp_set_time(struct isis_lsp *lsp) {
+	u_int16_t rem_lifetime;
+	time_t now;
+
 	assert(lsp);
 
-	if(lsp->lsp_header->rem_lifetime == 0) {
-		if(lsp->age_out > 0) {
-			lsp->age_out--;
-		}
+	rem_lifetime = ntohs(lsp->lsp_header->rem_lifetime);
+	if(rem_lifetime == 0 || lsp->t_aging == NULL) {
 		return;
 	}
 
-	lsp->lsp_header->rem_lifetime = htons(ntohs(lsp->lsp_header->rem_lifetime) - 1);
+	now = recent_relative_time().tv_sec;
+	if(now <= lsp->lifetime_at) {
+		return;
+	}
+
+	/* reaching zero is left to lsp_expire() */
+	if(now - lsp->lifetime_at >= rem_lifetime) {
+		rem_lifetime = 1;
+	} else {
+		rem_lifetime -= now - lsp->lifetime_at;
+	}
+	lsp->lsp_header->rem_lifetime = htons(rem_lifetime);
+	lsp->lifetime_at = now;
+}
+
+void lsp_reach_iter_init(struct tlv_reach_iter *iter, struct isis_lsp *lsp, u_int32_t types) {
+	tlv_reach_iter_init(iter, STREAM_DATA(lsp->pdu) + ISIS_FIXED_HDR_LEN + ISIS_LSP_HDR_LEN, ntohs(lsp->lsp_header->pdu_len) - ISIS_FIXED_HDR_LEN - ISIS_LSP_HDR_LEN, types);
 }
 
 static void lspid_print(u_char *lsp_id, u_char *trg, char dynhost, char frag) {
@@ -723,13 +792,14 @@ void lsp_print(struct isis_lsp *lsp, struct vty *vty, char dynhost) {
 	u_char LSPid[255];
 	char age_out[8];
 
+	lsp_set_time(lsp);
 	lspid_print(lsp->lsp_header->lsp_id, LSPid, dynhost, 1);
 	vty_out(vty, "%-21s%c  ", LSPid, lsp->own_lsp ? '*' : ' ');
 	vty_out(vty, "%5u   ", ntohs(lsp->lsp_header->pdu_len));
 	vty_out(vty, "0x%08x  ", ntohl(lsp->lsp_header->seq_num));
 	vty_out(vty, "0x%04x  ", ntohs(lsp->lsp_header->checksum));
 	if(ntohs(lsp->lsp_header->rem_lifetime) == 0) {
-		snprintf(age_out, 8, "(%u)", lsp->age_out);
+		snprintf(age_out, 8, "(%lu)", lsp->t_aging ? thread_timer_remain_second(lsp->t_aging) : 0UL);
 		age_out[7] = '\0';
 		vty_out(vty, "%7s   ", age_out);
 	} else {
@@ -744,14 +814,13 @@ void lsp_print_detail(struct isis_lsp *lsp, struct vty *vty, char dynhost) {
 	struct listnode *lnode;
 	struct is_neigh *is_neigh;
 	struct te_is_neigh *te_is_neigh;
-	struct ipv4_reachability *ipv4_reach;
+	struct mt_is_neigh *mt_is_neigh;
+	struct mt_router_info *mt_info;
 	struct in_addr *ipv4_addr;
-	struct te_ipv4_reachability *te_ipv4_reach;
-#ifdef HAVE_IPV6
-	struct ipv6_reachability *ipv6_reach;
-	struct in6_addr in6;
+	struct tlv_reach_iter iter;
+	struct tlv_reach reach;
+	struct in_addr mask;
 	u_char buff[BUFSIZ];
-#endif
 	u_char LSPid[255];
 	u_char hostname[255];
 	u_char ipv4_reach_prefix[20];
@@ -817,36 +886,29 @@ void lsp_print_detail(struct isis_lsp *lsp, struct vty *vty, char dynhost) {
 	}
 
 	/* for the internal reachable tlv */
-	if(lsp->tlv_data.ipv4_int_reachs) {
-		for(ALL_LIST_ELEMENTS_RO(lsp->tlv_data.ipv4_int_reachs, lnode, ipv4_reach)) {
-			memcpy(ipv4_reach_prefix, inet_ntoa(ipv4_reach->prefix), sizeof(ipv4_reach_prefix));
-			memcpy(ipv4_reach_mask, inet_ntoa(ipv4_reach->mask), sizeof(ipv4_reach_mask));
-			vty_out(vty, "  Metric      : %-8d IPv4-Internal : %s %s%s", ipv4_reach->metrics.metric_default, ipv4_reach_prefix, ipv4_reach_mask, VTY_NEWLINE);
-		}
+	lsp_reach_iter_init(&iter, lsp, TLVFLAG_IPV4_INT_REACHABILITY);
+	while(tlv_reach_iter_next(&iter, &reach)) {
+		masklen2ip(reach.prefix.prefixlen, &mask);
+		memcpy(ipv4_reach_prefix, inet_ntoa(reach.prefix.u.prefix4), sizeof(ipv4_reach_prefix));
+		memcpy(ipv4_reach_mask, inet_ntoa(mask), sizeof(ipv4_reach_mask));
+		vty_out(vty, "  Metric      : %-8d IPv4-Internal : %s %s%s", reach.metric, ipv4_reach_prefix, ipv4_reach_mask, VTY_NEWLINE);
 	}
 
 	/* for the external reachable tlv */
-	if(lsp->tlv_data.ipv4_ext_reachs) {
-		for(ALL_LIST_ELEMENTS_RO(lsp->tlv_data.ipv4_ext_reachs, lnode, ipv4_reach)) {
-			memcpy(ipv4_reach_prefix, inet_ntoa(ipv4_reach->prefix), sizeof(ipv4_reach_prefix));
-			memcpy(ipv4_reach_mask, inet_ntoa(ipv4_reach->mask), sizeof(ipv4_reach_mask));
-			vty_out(vty, "  Metric      : %-8d IPv4-External : %s %s%s", ipv4_reach->metrics.metric_default, ipv4_reach_prefix, ipv4_reach_mask, VTY_NEWLINE);
-		}
+	lsp_reach_iter_init(&iter, lsp, TLVFLAG_IPV4_EXT_REACHABILITY);
+	while(tlv_reach_iter_next(&iter, &reach)) {
+		masklen2ip(reach.prefix.prefixlen, &mask);
+		memcpy(ipv4_reach_prefix, inet_ntoa(reach.prefix.u.prefix4), sizeof(ipv4_reach_prefix));
+		memcpy(ipv4_reach_mask, inet_ntoa(mask), sizeof(ipv4_reach_mask));
+		vty_out(vty, "  Metric      : %-8d IPv4-External : %s %s%s", reach.metric, ipv4_reach_prefix, ipv4_reach_mask, VTY_NEWLINE);
 	}
 
 	/* IPv6 tlv */
 #ifdef HAVE_IPV6
-	if(lsp->tlv_data.ipv6_reachs) {
-		for(ALL_LIST_ELEMENTS_RO(lsp->tlv_data.ipv6_reachs, lnode, ipv6_reach)) {
-			memset(&in6, 0, sizeof(in6));
-			memcpy(in6.s6_addr, ipv6_reach->prefix, PSIZE(ipv6_reach->prefix_len));
-			inet_ntop(AF_INET6, &in6, (char *) buff, BUFSIZ);
-			if((ipv6_reach->control_info & CTRL_INFO_DISTRIBUTION) == DISTRIBUTION_INTERNAL) {
-				vty_out(vty, "  Metric      : %-8d IPv6-Internal : %s/%d%s", ntohl(ipv6_reach->metric), buff, ipv6_reach->prefix_len, VTY_NEWLINE);
-			} else {
-				vty_out(vty, "  Metric      : %-8d IPv6-External : %s/%d%s", ntohl(ipv6_reach->metric), buff, ipv6_reach->prefix_len, VTY_NEWLINE);
-			}
-		}
+	lsp_reach_iter_init(&iter, lsp, TLVFLAG_IPV6_REACHABILITY);
+	while(tlv_reach_iter_next(&iter, &reach)) {
+		inet_ntop(AF_INET6, &reach.prefix.u.prefix6, (char *) buff, BUFSIZ);
+		vty_out(vty, "  Metric      : %-8d IPv6-%s : %s/%d%s", reach.metric, reach.external ? "External" : "Internal", buff, reach.prefix.prefixlen, VTY_NEWLINE);
 	}
 #endif
 
@@ -862,37 +924,46 @@ void lsp_print_detail(struct isis_lsp *lsp, struct vty *vty, char dynhost) {
 	}
 
 	/* TE IPv4 tlv */
-	if(lsp->tlv_data.te_ipv4_reachs) {
-		for(ALL_LIST_ELEMENTS_RO(lsp->tlv_data.te_ipv4_reachs, lnode, te_ipv4_reach)) {
-			/* FIXME: There should be better way to output this stuff. */
-			vty_out(vty, "  Metric      : %-8d IPv4-Extended : %s/%d%s", ntohl(te_ipv4_reach->te_metric), inet_ntoa(newprefix2inaddr(&te_ipv4_reach->prefix_start, te_ipv4_reach->control)), te_ipv4_reach->control & 0x3F,
-				VTY_NEWLINE);
+	lsp_reach_iter_init(&iter, lsp, TLVFLAG_TE_IPV4_REACHABILITY);
+	while(tlv_reach_iter_next(&iter, &reach)) {
+		vty_out(vty, "  Metric      : %-8d IPv4-Extended : %s/%d%s", reach.metric, inet_ntoa(reach.prefix.u.prefix4), reach.prefix.prefixlen, VTY_NEWLINE);
+	}
+
+	/* MT tlvs */
+	if(lsp->tlv_data.mt_router_info) {
+		for(ALL_LIST_ELEMENTS_RO(lsp->tlv_data.mt_router_info, lnode, mt_info)) {
+			vty_out(vty, "  Topology    : %-8s %s%s%s", isis_mt_name(mt_info->mtid), mt_info->overload ? "O " : "", mt_info->attached ? "A" : "", VTY_NEWLINE);
+		}
+	}
+	if(lsp->tlv_data.mt_is_neighs) {
+		for(ALL_LIST_ELEMENTS_RO(lsp->tlv_data.mt_is_neighs, lnode, mt_is_neigh)) {
+			lspid_print(mt_is_neigh->neigh_id, LSPid, dynhost, 0);
+			vty_out(vty, "  Metric      : %-8d IS-MT         : %s (%s)%s", GET_TE_METRIC(mt_is_neigh), LSPid, isis_mt_name(mt_is_neigh->mtid), VTY_NEWLINE);
 		}
 	}
+	lsp_reach_iter_init(&iter, lsp, TLVFLAG_MT_IPV4_REACHABILITY | TLVFLAG_MT_IPV6_REACHABILITY);
+	while(tlv_reach_iter_next(&iter, &reach)) {
+		prefix2str(&reach.prefix, (char *) buff, BUFSIZ);
+		vty_out(vty, "  Metric      : %-8d IP-MT         : %s (%s)%s", reach.metric, buff, isis_mt_name(reach.mtid), VTY_NEWLINE);
+	}
 	vty_out(vty, "%s", VTY_NEWLINE);
 
 	return;
 }
 
 /* print all the lsps info in the local lspdb */
-int lsp_print_all(struct vty *vty, dict_t *lspdb, char detail, char dynhost) {
-	dnode_t *node = dict_first(lspdb), *next;
+int lsp_print_all(struct vty *vty, struct isis_lspdb *lspdb, char detail, char dynhost) {
+	struct isis_lsp *lsp;
 	int lsp_count = 0;
 
 	if(detail == ISIS_UI_LEVEL_BRIEF) {
-		while(node != NULL) {
-			/* I think it is unnecessary, so I comment it out */
-			/* dict_contains (lspdb, node); */
-			next = dict_next(lspdb, node);
-			lsp_print(dnode_get(node), vty, dynhost);
-			node = next;
+		while((lsp = lspdb_nth(lspdb, lsp_count)) != NULL) {
+			lsp_print(lsp, vty, dynhost);
 			lsp_count++;
 		}
 	} else if(detail == ISIS_UI_LEVEL_DETAIL) {
-		while(node != NULL) {
-			next = dict_next(lspdb, node);
-			lsp_print_detail(dnode_get(node), vty, dynhost);
-			node = next;
+		while((lsp = lspdb_nth(lspdb, lsp_count)) != NULL) {
+			lsp_print_detail(lsp, vty, dynhost);
 			lsp_count++;
 		}
 	}
@@ -990,8 +1061,11 @@ static struct isis_lsp *lsp_next_frag(u_char frag_num, struct isis_lsp *lsp0, st
 	if(lsp) {
 		/* Clear the TLVs */
 		lsp_clear_data(lsp);
+		stream_reset(lsp->pdu);
+		stream_forward_endp(lsp->pdu, ISIS_FIXED_HDR_LEN + ISIS_LSP_HDR_LEN);
 		return lsp;
 	}
+	lsp_set_time(lsp0);
 	lsp = lsp_new(area, frag_id, ntohs(lsp0->lsp_header->rem_lifetime), 0, lsp_bits_generate(level, area->overload_bit, area->attached_bit), 0, level);
 	lsp->area = area;
 	lsp->own_lsp = 1;
@@ -1060,6 +1134,19 @@ static void lsp_build_ext_reach_ipv4(struct isis_lsp *lsp, struct isis_area *are
 	}
 }
 
+#ifdef HAVE_IPV6
+/* TLV 236, or TLV 237 when IPv6 has its own topology */
+static struct list *lsp_ipv6_reachs(struct isis_area *area, struct tlvs *tlv_data) {
+	struct list **list = area->mt_ipv6 ? &tlv_data->mt_ipv6_reachs : &tlv_data->ipv6_reachs;
+
+	if(*list == NULL) {
+		*list = list_new();
+		(*list)->del = free_tlv;
+	}
+	return *list;
+}
+#endif /* HAVE_IPV6 */
+
 static void lsp_build_ext_reach_ipv6(struct isis_lsp *lsp, struct isis_area *area, struct tlvs *tlv_data) {
 	struct route_table *er_table;
 	struct route_node *rn;
@@ -1080,10 +1167,6 @@ static void lsp_build_ext_reach_ipv6(struct isis_lsp *lsp, struct isis_area *are
 		ipv6 = (struct prefix_ipv6 *) &rn->p;
 		info = rn->info;
 
-		if(tlv_data->ipv6_reachs == NULL) {
-			tlv_data->ipv6_reachs = list_new();
-			tlv_data->ipv6_reachs->del = free_tlv;
-		}
 		ip6reach = XCALLOC(MTYPE_ISIS_TLV, sizeof(*ip6reach));
 		if(info->metric > MAX_WIDE_PATH_METRIC) {
 			ip6reach->metric = htonl(MAX_WIDE_PATH_METRIC);
@@ -1093,7 +1176,7 @@ static void lsp_build_ext_reach_ipv6(struct isis_lsp *lsp, struct isis_area *are
 		ip6reach->control_info = DISTRIBUTION_EXTERNAL;
 		ip6reach->prefix_len = ipv6->prefixlen;
 		memcpy(ip6reach->prefix, ipv6->prefix.s6_addr, sizeof(ip6reach->prefix));
-		listnode_add(tlv_data->ipv6_reachs, ip6reach);
+		listnode_add(lsp_ipv6_reachs(area, tlv_data), ip6reach);
 	}
 }
 
@@ -1102,11 +1185,401 @@ static void lsp_build_ext_reach(struct isis_lsp *lsp, struct isis_area *area, st
 	lsp_build_ext_reach_ipv6(lsp, area, tlv_data);
 }
 
+/*
+ * Stable fragment placement for our own LSP. Every reachability and
+ * neighbor entry stays in the fragment it was in last time as long as it
+ * still fits there, so a change only alters the fragments whose content
+ * really changed. New entries, and entries that no longer fit, go to the
+ * first fragment with room. A fragment is only repacked once it drains
+ * below LSP_FRAG_LOW percent of its capacity.
+ */
+#define LSP_FRAG_MAX 256
+#define LSP_FRAG_LOW 25
+
+static const struct lsp_frag_type {
+	u_char type;
+	size_t offset; /* of the list in struct tlvs */
+	int (*tlv_build_func)(struct list *, struct stream *);
+} lsp_frag_types[] = {
+	{IPV4_INT_REACHABILITY, offsetof(struct tlvs, ipv4_int_reachs), tlv_add_ipv4_int_reachs},
+	{IPV4_EXT_REACHABILITY, offsetof(struct tlvs, ipv4_ext_reachs), tlv_add_ipv4_ext_reachs},
+	{TE_IPV4_REACHABILITY, offsetof(struct tlvs, te_ipv4_reachs), tlv_add_te_ipv4_reachs},
+#ifdef HAVE_IPV6
+	{IPV6_REACHABILITY, offsetof(struct tlvs, ipv6_reachs), tlv_add_ipv6_reachs},
+	{MT_IPV6_REACHABILITY, offsetof(struct tlvs, mt_ipv6_reachs), tlv_add_mt_ipv6_reachs},
+#endif /* HAVE_IPV6 */
+	{IS_NEIGHBOURS, offsetof(struct tlvs, is_neighs), tlv_add_is_neighs},
+	{TE_IS_NEIGHBOURS, offsetof(struct tlvs, te_is_neighs), tlv_add_te_is_neighs},
+	{MT_IS_NEIGHBOURS, offsetof(struct tlvs, mt_is_neighs), tlv_add_mt_is_neighs},
+};
+
+#define LSP_FRAG_TYPES array_size(lsp_frag_types)
+#define LSP_FRAG_LIST(T, I) ((struct list **) ((char *) (T) + lsp_frag_types[I].offset))
+
+/* where an entry was placed by the previous build */
+struct lsp_frag_slot {
+	u_char type;
+	u_char len;
+	u_char id[IPV6_MAX_BYTELEN + 1];
+	u_char frag;
+};
+
+struct lsp_frag_map {
+	struct hash *hash;
+	struct lsp_frag_slot *slots;
+};
+
+struct lsp_frag {
+	int exists; /* fragment is in the lspdb already */
+	int used;   /* pdu bytes, header included */
+	int fill[LSP_FRAG_TYPES]; /* bytes in the last TLV of each type */
+	struct list *elems[LSP_FRAG_TYPES];
+};
+
+static void lsp_frag_slot_init(struct lsp_frag_slot *slot, u_char type, void *elem) {
+	struct ipv4_reachability *ipreach;
+	struct te_ipv4_reachability *te_ipreach;
+#ifdef HAVE_IPV6
+	struct ipv6_reachability *ip6reach;
+#endif /* HAVE_IPV6 */
+
+	memset(slot, 0, sizeof(*slot));
+	slot->type = type;
+	switch(type) {
+		case IPV4_INT_REACHABILITY:
+		case IPV4_EXT_REACHABILITY:
+			ipreach = elem;
+			slot->len = 2 * IPV4_MAX_BYTELEN;
+			memcpy(slot->id, &ipreach->prefix, IPV4_MAX_BYTELEN);
+			memcpy(slot->id + IPV4_MAX_BYTELEN, &ipreach->mask, IPV4_MAX_BYTELEN);
+			break;
+		case TE_IPV4_REACHABILITY:
+			te_ipreach = elem;
+			slot->id[0] = te_ipreach->control & 0x3F;
+			slot->len = 1 + PSIZE(slot->id[0]);
+			memcpy(slot->id + 1, &te_ipreach->prefix_start, slot->len - 1);
+			break;
+#ifdef HAVE_IPV6
+		case IPV6_REACHABILITY:
+		case MT_IPV6_REACHABILITY:
+			ip6reach = elem;
+			slot->id[0] = MIN(ip6reach->prefix_len, IPV6_MAX_BITLEN);
+			slot->len = 1 + PSIZE(slot->id[0]);
+			memcpy(slot->id + 1, ip6reach->prefix, slot->len - 1);
+			break;
+#endif /* HAVE_IPV6 */
+		case IS_NEIGHBOURS:
+			slot->len = ISIS_SYS_ID_LEN + 1;
+			memcpy(slot->id, ((struct is_neigh *) elem)->neigh_id, slot->len);
+			break;
+		case TE_IS_NEIGHBOURS:
+			slot->len = ISIS_SYS_ID_LEN + 1;
+			memcpy(slot->id, ((struct te_is_neigh *) elem)->neigh_id, slot->len);
+			break;
+		case MT_IS_NEIGHBOURS:
+			slot->len = MT_ID_LEN + ISIS_SYS_ID_LEN + 1;
+			memcpy(slot->id, &((struct mt_is_neigh *) elem)->mtid, MT_ID_LEN);
+			memcpy(slot->id + MT_ID_LEN, ((struct mt_is_neigh *) elem)->neigh_id, ISIS_SYS_ID_LEN + 1);
+			break;
+	}
+}
+
+static unsigned int lsp_frag_slot_key(void *arg) {
+	struct lsp_frag_slot *slot = arg;
+
+	return jhash(slot->id, slot->len, slot->type);
+}
+
+static int lsp_frag_slot_cmp(const void *arg1, const void *arg2) {
+	const struct lsp_frag_slot *slot1 = arg1, *slot2 = arg2;
+
+	return slot1->type == slot2->type && slot1->len == slot2->len && !memcmp(slot1->id, slot2->id, slot1->len);
+}
+
+static unsigned int lsp_frag_map_count(struct isis_lsp *lsp) {
+	struct list *list;
+	unsigned int i, count = 0;
+
+	for(i = 0; i < LSP_FRAG_TYPES; i++) {
+		list = *LSP_FRAG_LIST(&lsp->tlv_data, i);
+		if(list) {
+			count += listcount(list);
+		}
+	}
+	return count;
+}
+
+static struct lsp_frag_slot *lsp_frag_map_fill(struct lsp_frag_map *map, struct lsp_frag_slot *slot, struct isis_lsp *lsp) {
+	struct listnode *node;
+	struct list *list;
+	void *elem;
+	unsigned int i;
+
+	for(i = 0; i < LSP_FRAG_TYPES; i++) {
+		list = *LSP_FRAG_LIST(&lsp->tlv_data, i);
+		if(!list) {
+			continue;
+		}
+		for(ALL_LIST_ELEMENTS_RO(list, node, elem)) {
+			lsp_frag_slot_init(slot, lsp_frag_types[i].type, elem);
+			slot->frag = LSP_FRAGMENT(lsp->lsp_header->lsp_id);
+			if(hash_get(map->hash, slot, hash_alloc_intern) == slot) {
+				slot++;
+			}
+		}
+	}
+	return slot;
+}
+
+/*
+ * Remember which fragment every entry of our own LSP went to. Must be
+ * called before the fragments are rebuilt.
+ */
+static struct lsp_frag_map *lsp_frag_map_new(struct isis_lsp *lsp0) {
+	struct lsp_frag_map *map;
+	struct lsp_frag_slot *slot;
+	struct listnode *node;
+	struct isis_lsp *lsp;
+	unsigned int count;
+
+	count = lsp_frag_map_count(lsp0);
+	for(ALL_LIST_ELEMENTS_RO(lsp0->lspu.frags, node, lsp)) {
+		count += lsp_frag_map_count(lsp);
+	}
+
+	map = XCALLOC(MTYPE_ISIS_TMP, sizeof(struct lsp_frag_map));
+	map->hash = hash_create_open(lsp_frag_slot_key, lsp_frag_slot_cmp);
+	if(count == 0) {
+		return map;
+	}
+
+	map->slots = XCALLOC(MTYPE_ISIS_TMP, sizeof(struct lsp_frag_slot) * count);
+	slot = lsp_frag_map_fill(map, map->slots, lsp0);
+	for(ALL_LIST_ELEMENTS_RO(lsp0->lspu.frags, node, lsp)) {
+		slot = lsp_frag_map_fill(map, slot, lsp);
+	}
+
+	return map;
+}
+
+static void lsp_frag_map_free(struct lsp_frag_map *map) {
+	hash_free(map->hash);
+	if(map->slots) {
+		XFREE(MTYPE_ISIS_TMP, map->slots);
+	}
+	XFREE(MTYPE_ISIS_TMP, map);
+}
+
+/* bytes the entry takes in its TLV, and what the tlv_add_* func checks */
+static int lsp_frag_elem_size(u_char type, void *elem, int *guard) {
+	struct te_ipv4_reachability *te_ipreach;
+	int size;
+
+	switch(type) {
+		case TE_IPV4_REACHABILITY:
+			te_ipreach = elem;
+			size = 5 + ((((te_ipreach->control & 0x3F) - 1) >> 3) + 1);
+			*guard = size;
+			return size;
+#ifdef HAVE_IPV6
+		case IPV6_REACHABILITY:
+		case MT_IPV6_REACHABILITY:
+			*guard = IPV6_MAX_BYTELEN + 6;
+			return 6 + ((((struct ipv6_reachability *) elem)->prefix_len + 7) / 8);
+#endif /* HAVE_IPV6 */
+		case IS_NEIGHBOURS:
+		case MT_IS_NEIGHBOURS: *guard = IS_NEIGHBOURS_LEN; return IS_NEIGHBOURS_LEN;
+		case TE_IS_NEIGHBOURS:
+			size = IS_NEIGHBOURS_LEN + ((struct te_is_neigh *) elem)->sub_tlvs_length;
+			*guard = size;
+			return size;
+		default: *guard = IPV4_REACH_LEN; return IPV4_REACH_LEN;
+	}
+}
+
+/* bytes a new TLV of the type takes before its first entry */
+static int lsp_frag_tlv_hdr(unsigned int i, int first) {
+	switch(lsp_frag_types[i].type) {
+		/* the first IS neighbors TLV carries the virtual flag */
+		case IS_NEIGHBOURS: return 2 + (first ? 1 : 0);
+		case MT_IS_NEIGHBOURS:
+		case MT_IPV6_REACHABILITY: return 2 + MT_ID_LEN;
+		default: return 2;
+	}
+}
+
+/* pdu bytes adding the entry to the frag costs, TLV headers included */
+static int lsp_frag_cost(struct lsp_frag *frag, unsigned int i, int size, int guard) {
+	if(!frag->elems[i] || listcount(frag->elems[i]) == 0) {
+		return lsp_frag_tlv_hdr(i, 1) + size;
+	}
+	if(frag->fill[i] + guard > 255) {
+		return lsp_frag_tlv_hdr(i, 0) + size;
+	}
+	return size;
+}
+
+static void lsp_frag_add(struct lsp_frag *frag, unsigned int i, void *elem, int size, int guard) {
+	int cost;
+
+	cost = lsp_frag_cost(frag, i, size, guard);
+	if(!frag->elems[i]) {
+		frag->elems[i] = list_new();
+	}
+	if(listcount(frag->elems[i]) == 0 || cost > size) {
+		frag->fill[i] = cost - 2;
+	} else {
+		frag->fill[i] += size;
+	}
+	frag->used += cost;
+	listnode_add(frag->elems[i], elem);
+}
+
+/*
+ * Distribute the entries of tlv_data over lsp0 and its fragments and
+ * serialize them. lsp0 already holds its area wide TLVs.
+ */
+static void lsp_build_frags(struct isis_lsp *lsp0, struct isis_area *area, struct tlvs *tlv_data, struct lsp_frag_map *map) {
+	struct lsp_frag *frags, *frag;
+	struct lsp_frag_slot key, *slot;
+	struct list *list, *deferred[LSP_FRAG_TYPES];
+	struct listnode *node;
+	struct isis_lsp *lsp;
+	struct tlvs tlvs;
+	uint32_t expected = 0, found = 0;
+	void *elem;
+	unsigned int i;
+	int f, base, budget, size, guard, retval;
+
+	frags = XCALLOC(MTYPE_ISIS_TMP, sizeof(struct lsp_frag) * LSP_FRAG_MAX);
+	base = ISIS_FIXED_HDR_LEN + ISIS_LSP_HDR_LEN;
+	budget = FRAG_THOLD(lsp0->pdu, area->lsp_frag_threshold);
+	frags[0].used = stream_get_endp(lsp0->pdu);
+	for(f = 1; f < LSP_FRAG_MAX; f++) {
+		frags[f].used = base;
+	}
+	for(ALL_LIST_ELEMENTS_RO(lsp0->lspu.frags, node, lsp)) {
+		frags[LSP_FRAGMENT(lsp->lsp_header->lsp_id)].exists = 1;
+	}
+
+	/* Entries go back where they were, as long as they fit */
+	for(i = 0; i < LSP_FRAG_TYPES; i++) {
+		deferred[i] = list_new();
+		list = *LSP_FRAG_LIST(tlv_data, i);
+		if(!list) {
+			continue;
+		}
+		/* the frags own the entries from here on */
+		list->del = NULL;
+		for(ALL_LIST_ELEMENTS_RO(list, node, elem)) {
+			size = lsp_frag_elem_size(lsp_frag_types[i].type, elem, &guard);
+			slot = NULL;
+			if(map) {
+				lsp_frag_slot_init(&key, lsp_frag_types[i].type, elem);
+				slot = hash_lookup(map->hash, &key);
+			}
+			if(slot && frags[slot->frag].used + lsp_frag_cost(&frags[slot->frag], i, size, guard) <= budget) {
+				lsp_frag_add(&frags[slot->frag], i, elem, size, guard);
+			} else {
+				listnode_add(deferred[i], elem);
+			}
+		}
+	}
+
+	/* Repack fragments that drained below the low watermark */
+	for(f = 1; f < LSP_FRAG_MAX; f++) {
+		frag = &frags[f];
+		if(frag->used == base || (frag->used - base) * 100 >= (budget - base) * LSP_FRAG_LOW) {
+			continue;
+		}
+		for(i = 0; i < LSP_FRAG_TYPES; i++) {
+			if(!frag->elems[i]) {
+				continue;
+			}
+			for(ALL_LIST_ELEMENTS_RO(frag->elems[i], node, elem)) {
+				listnode_add(deferred[i], elem);
+			}
+			list_delete_all_node(frag->elems[i]);
+		}
+		frag->used = base;
+	}
+
+	/* Everything else goes to the first fragment with room */
+	for(i = 0; i < LSP_FRAG_TYPES; i++) {
+		for(ALL_LIST_ELEMENTS_RO(deferred[i], node, elem)) {
+			size = lsp_frag_elem_size(lsp_frag_types[i].type, elem, &guard);
+			for(f = 0; f < LSP_FRAG_MAX; f++) {
+				if(frags[f].used + lsp_frag_cost(&frags[f], i, size, guard) <= budget) {
+					break;
+				}
+			}
+			if(f == LSP_FRAG_MAX) {
+				zlog_warn("ISIS (%s): L%d LSP is full, dropping a type %d entry", area->area_tag, lsp0->level, lsp_frag_types[i].type);
+				free_tlv(elem);
+				continue;
+			}
+			lsp_frag_add(&frags[f], i, elem, size, guard);
+		}
+		list_delete(deferred[i]);
+	}
+
+	for(f = 0; f < LSP_FRAG_MAX; f++) {
+		frag = &frags[f];
+		if(f > 0 && frag->used == base && !frag->exists) {
+			continue;
+		}
+
+		lsp = f ? lsp_next_frag(f, lsp0, area, lsp0->level) : lsp0;
+		for(i = 0; i < LSP_FRAG_TYPES; i++) {
+			if(!frag->elems[i]) {
+				continue;
+			}
+			if(listcount(frag->elems[i]) == 0) {
+				list_delete(frag->elems[i]);
+				continue;
+			}
+			frag->elems[i]->del = free_tlv;
+			lsp_frag_types[i].tlv_build_func(frag->elems[i], lsp->pdu);
+			*LSP_FRAG_LIST(&lsp->tlv_data, i) = frag->elems[i];
+		}
+		lsp->lsp_header->pdu_len = htons(stream_get_endp(lsp->pdu));
+
+		/* Validate the LSP */
+		memset(&tlvs, 0, sizeof(struct tlvs));
+		retval = parse_tlvs(area->area_tag, STREAM_DATA(lsp->pdu) + base, stream_get_endp(lsp->pdu) - base, &expected, &found, &tlvs, NULL);
+		assert(retval == ISIS_OK);
+	}
+
+	XFREE(MTYPE_ISIS_TMP, frags);
+}
+
+/* an IS neighbor of a topology other than the standard one */
+static void lsp_build_mt_is_neigh(struct isis_area *area, struct tlvs *tlv_data, u_int16_t mtid, const u_char *id, int id_len, u_int32_t metric) {
+	static const u_char zero_id[ISIS_SYS_ID_LEN + 1];
+	struct mt_is_neigh *mt_is_neigh;
+
+	/* no DIS yet */
+	if(!memcmp(id, zero_id, id_len)) {
+		return;
+	}
+
+	if(tlv_data->mt_is_neighs == NULL) {
+		tlv_data->mt_is_neighs = list_new();
+		tlv_data->mt_is_neighs->del = free_tlv;
+	}
+	mt_is_neigh = XCALLOC(MTYPE_ISIS_TLV, sizeof(struct mt_is_neigh));
+	mt_is_neigh->mtid = mtid;
+	memcpy(mt_is_neigh->neigh_id, id, id_len);
+	SET_TE_METRIC(mt_is_neigh, metric);
+	listnode_add(tlv_data->mt_is_neighs, mt_is_neigh);
+	lsp_debug("ISIS (%s): Adding %s.%02x as %s neighbor", area->area_tag, sysid_print(mt_is_neigh->neigh_id), LSP_PSEUDO_ID(mt_is_neigh->neigh_id), isis_mt_name(mtid));
+}
+
 /*
  * Builds the LSP data part. This func creates a new frag whenever
  * area->lsp_frag_threshold is exceeded.
  */
-static void lsp_build(struct isis_lsp *lsp, struct isis_area *area) {
+static void lsp_build(struct isis_lsp *lsp, struct isis_area *area, struct lsp_frag_map *map) {
 	struct is_neigh *is_neigh;
 	struct te_is_neigh *te_is_neigh;
 	struct listnode *node, *ipnode;
@@ -1123,11 +1596,14 @@ static void lsp_build(struct isis_lsp *lsp, struct isis_area *area) {
 	struct tlvs tlv_data;
 	struct isis_lsp *lsp0 = lsp;
 	struct in_addr *routerid;
-	uint32_t expected = 0, found = 0;
 	uint32_t metric;
 	u_char zero_id[ISIS_SYS_ID_LEN + 1];
-	int retval = ISIS_OK;
 	char buf[BUFSIZ];
+#ifdef HAVE_IPV6
+	static const u_int16_t mtids[] = {ISIS_MT_IPV4_UNICAST, ISIS_MT_IPV6_UNICAST};
+	struct mt_router_info *mt_info;
+	unsigned int i;
+#endif /* HAVE_IPV6 */
 
 	lsp_debug("ISIS (%s): Constructing local system LSP for level %d", area->area_tag, level);
 
@@ -1183,6 +1659,23 @@ static void lsp_build(struct isis_lsp *lsp, struct isis_area *area) {
 		tlv_add_nlpid(lsp->tlv_data.nlpids, lsp->pdu);
 	}
 
+#ifdef HAVE_IPV6
+	/* Multi Topology, the standard one and the IPv6 one */
+	if(area->mt_ipv6) {
+		lsp->tlv_data.mt_router_info = list_new();
+		lsp->tlv_data.mt_router_info->del = free_tlv;
+		for(i = 0; i < array_size(mtids); i++) {
+			mt_info = XCALLOC(MTYPE_ISIS_TLV, sizeof(struct mt_router_info));
+			mt_info->mtid = mtids[i];
+			mt_info->overload = area->overload_bit ? 1 : 0;
+			mt_info->attached = area->attached_bit ? 1 : 0;
+			listnode_add(lsp->tlv_data.mt_router_info, mt_info);
+		}
+		lsp_debug("ISIS (%s): Adding the ipv6-unicast topology", area->area_tag);
+		tlv_add_mt_router_info(lsp->tlv_data.mt_router_info, lsp->pdu);
+	}
+#endif /* HAVE_IPV6 */
+
 	/* Dynamic Hostname */
 	if(area->dynhostname) {
 		const char *hostname = unix_hostname();
@@ -1323,10 +1816,6 @@ static void lsp_build(struct isis_lsp *lsp, struct isis_area *area) {
        * Add IPv6 reachability of this circuit
        */
 		if(circuit->ipv6_router && circuit->ipv6_non_link && circuit->ipv6_non_link->count > 0) {
-			if(tlv_data.ipv6_reachs == NULL) {
-				tlv_data.ipv6_reachs = list_new();
-				tlv_data.ipv6_reachs->del = free_tlv;
-			}
 			for(ALL_LIST_ELEMENTS_RO(circuit->ipv6_non_link, ipnode, ipv6)) {
 				ip6reach = XCALLOC(MTYPE_ISIS_TLV, sizeof(struct ipv6_reachability));
 
@@ -1345,7 +1834,7 @@ static void lsp_build(struct isis_lsp *lsp, struct isis_area *area) {
 				lsp_debug("ISIS (%s): Adding IPv6 reachability for %s/%d", area->area_tag, buf, ipv6->prefixlen);
 
 				memcpy(ip6reach->prefix, ip6prefix.prefix.s6_addr, sizeof(ip6reach->prefix));
-				listnode_add(tlv_data.ipv6_reachs, ip6reach);
+				listnode_add(lsp_ipv6_reachs(area, &tlv_data), ip6reach);
 			}
 		}
 #endif /* HAVE_IPV6 */
@@ -1410,6 +1899,11 @@ static void lsp_build(struct isis_lsp *lsp, struct isis_area *area) {
 							lsp_debug("ISIS (%s): Adding DIS %s.%02x as te-style neighbor", area->area_tag, sysid_print(te_is_neigh->neigh_id), LSP_PSEUDO_ID(te_is_neigh->neigh_id));
 						}
 					}
+#ifdef HAVE_IPV6
+					if(area->mt_ipv6 && circuit->ipv6_router) {
+						lsp_build_mt_is_neigh(area, &tlv_data, ISIS_MT_IPV6_UNICAST, level == IS_LEVEL_1 ? circuit->u.bc.l1_desig_is : circuit->u.bc.l2_desig_is, ISIS_SYS_ID_LEN + 1, circuit->te_metric[level - 1]);
+					}
+#endif /* HAVE_IPV6 */
 				} else {
 					lsp_debug("ISIS (%s): Circuit is not active for current level. Not adding IS neighbors", area->area_tag);
 				}
@@ -1458,6 +1952,11 @@ static void lsp_build(struct isis_lsp *lsp, struct isis_area *area) {
 						listnode_add(tlv_data.te_is_neighs, te_is_neigh);
 						lsp_debug("ISIS (%s): Adding te-style is reach for %s", area->area_tag, sysid_print(te_is_neigh->neigh_id));
 					}
+#ifdef HAVE_IPV6
+					if(area->mt_ipv6 && circuit->ipv6_router && ISIS_ADJ_HAS_MT(nei, ISIS_MT_IPV6_UNICAST)) {
+						lsp_build_mt_is_neigh(area, &tlv_data, ISIS_MT_IPV6_UNICAST, nei->sysid, ISIS_SYS_ID_LEN, circuit->te_metric[level - 1]);
+					}
+#endif /* HAVE_IPV6 */
 				} else {
 					lsp_debug("ISIS (%s): No adjacency for given level on this circuit. Not adding IS neighbors", area->area_tag);
 				}
@@ -1471,78 +1970,9 @@ static void lsp_build(struct isis_lsp *lsp, struct isis_area *area) {
 
 	lsp_debug("ISIS (%s): LSP construction is complete. Serializing...", area->area_tag);
 
-	while(tlv_data.ipv4_int_reachs && listcount(tlv_data.ipv4_int_reachs)) {
-		if(lsp->tlv_data.ipv4_int_reachs == NULL) {
-			lsp->tlv_data.ipv4_int_reachs = list_new();
-		}
-		lsp_tlv_fit(lsp, &tlv_data.ipv4_int_reachs, &lsp->tlv_data.ipv4_int_reachs, IPV4_REACH_LEN, area->lsp_frag_threshold, tlv_add_ipv4_int_reachs);
-		if(tlv_data.ipv4_int_reachs && listcount(tlv_data.ipv4_int_reachs)) {
-			lsp = lsp_next_frag(LSP_FRAGMENT(lsp->lsp_header->lsp_id) + 1, lsp0, area, level);
-		}
-	}
-
-	while(tlv_data.ipv4_ext_reachs && listcount(tlv_data.ipv4_ext_reachs)) {
-		if(lsp->tlv_data.ipv4_ext_reachs == NULL) {
-			lsp->tlv_data.ipv4_ext_reachs = list_new();
-		}
-		lsp_tlv_fit(lsp, &tlv_data.ipv4_ext_reachs, &lsp->tlv_data.ipv4_ext_reachs, IPV4_REACH_LEN, area->lsp_frag_threshold, tlv_add_ipv4_ext_reachs);
-		if(tlv_data.ipv4_ext_reachs && listcount(tlv_data.ipv4_ext_reachs)) {
-			lsp = lsp_next_frag(LSP_FRAGMENT(lsp->lsp_header->lsp_id) + 1, lsp0, area, level);
-		}
-	}
-
-	/* FIXME: We pass maximum te_ipv4_reachability length to the lsp_tlv_fit()
-   * for now. lsp_tlv_fit() needs to be fixed to deal with variable length
-   * TLVs (sub TLVs!). */
-	while(tlv_data.te_ipv4_reachs && listcount(tlv_data.te_ipv4_reachs)) {
-		if(lsp->tlv_data.te_ipv4_reachs == NULL) {
-			lsp->tlv_data.te_ipv4_reachs = list_new();
-		}
-		lsp_tlv_fit(lsp, &tlv_data.te_ipv4_reachs, &lsp->tlv_data.te_ipv4_reachs, TE_IPV4_REACH_LEN, area->lsp_frag_threshold, tlv_add_te_ipv4_reachs);
-		if(tlv_data.te_ipv4_reachs && listcount(tlv_data.te_ipv4_reachs)) {
-			lsp = lsp_next_frag(LSP_FRAGMENT(lsp->lsp_header->lsp_id) + 1, lsp0, area, level);
-		}
-	}
-
-#ifdef HAVE_IPV6
-	while(tlv_data.ipv6_reachs && listcount(tlv_data.ipv6_reachs)) {
-		if(lsp->tlv_data.ipv6_reachs == NULL) {
-			lsp->tlv_data.ipv6_reachs = list_new();
-		}
-		lsp_tlv_fit(lsp, &tlv_data.ipv6_reachs, &lsp->tlv_data.ipv6_reachs, IPV6_REACH_LEN, area->lsp_frag_threshold, tlv_add_ipv6_reachs);
-		if(tlv_data.ipv6_reachs && listcount(tlv_data.ipv6_reachs)) {
-			lsp = lsp_next_frag(LSP_FRAGMENT(lsp->lsp_header->lsp_id) + 1, lsp0, area, level);
-		}
-	}
-#endif /* HAVE_IPV6 */
-
-	while(tlv_data.is_neighs && listcount(tlv_data.is_neighs)) {
-		if(lsp->tlv_data.is_neighs == NULL) {
-			lsp->tlv_data.is_neighs = list_new();
-		}
-		lsp_tlv_fit(lsp, &tlv_data.is_neighs, &lsp->tlv_data.is_neighs, IS_NEIGHBOURS_LEN, area->lsp_frag_threshold, tlv_add_is_neighs);
-		if(tlv_data.is_neighs && listcount(tlv_data.is_neighs)) {
-			lsp = lsp_next_frag(LSP_FRAGMENT(lsp->lsp_header->lsp_id) + 1, lsp0, area, level);
-		}
-	}
-
-	while(tlv_data.te_is_neighs && listcount(tlv_data.te_is_neighs)) {
-		if(lsp->tlv_data.te_is_neighs == NULL) {
-			lsp->tlv_data.te_is_neighs = list_new();
-		}
-		lsp_tlv_fit(lsp, &tlv_data.te_is_neighs, &lsp->tlv_data.te_is_neighs, IS_NEIGHBOURS_LEN, area->lsp_frag_threshold, tlv_add_te_is_neighs);
-		if(tlv_data.te_is_neighs && listcount(tlv_data.te_is_neighs)) {
-			lsp = lsp_next_frag(LSP_FRAGMENT(lsp->lsp_header->lsp_id) + 1, lsp0, area, level);
-		}
-	}
-	lsp->lsp_header->pdu_len = htons(stream_get_endp(lsp->pdu));
-
+	lsp_build_frags(lsp0, area, &tlv_data, map);
 	free_tlvs(&tlv_data);
 
-	/* Validate the LSP */
-	retval = parse_tlvs(area->area_tag, STREAM_DATA(lsp->pdu) + ISIS_FIXED_HDR_LEN + ISIS_LSP_HDR_LEN, stream_get_endp(lsp->pdu) - ISIS_FIXED_HDR_LEN - ISIS_LSP_HDR_LEN, &expected, &found, &tlv_data, NULL);
-	assert(retval == ISIS_OK);
-
 	return;
 }
 
@@ -1576,7 +2006,7 @@ int lsp_generate(struct isis_area *area, int level) {
 
 	lsp_insert(newlsp, area->lspdb[level - 1]);
 	/* build_lsp_data (newlsp, area); */
-	lsp_build(newlsp, area);
+	lsp_build(newlsp, area, NULL);
 	/* time to calculate our checksum */
 	lsp_seqnum_update(newlsp);
 	newlsp->last_generated = time(NULL);
@@ -1606,14 +2036,49 @@ int lsp_generate(struct isis_area *area, int level) {
 }
 
 /*
- * Search own LSPs, update holding time and set SRM
+ * Give a fragment of our own LSP a new seqnum and lifetime and flood it.
+ * Outside the periodic refresh a fragment whose content did not change is
+ * left alone, as long as it stays alive until that refresh.
+ */
+static int lsp_frag_reissue(struct isis_lsp *lsp, struct stream *prev, u_int16_t rem_lifetime, u_int16_t refresh_time, int refresh) {
+	struct isis_link_state_hdr *prev_hdr;
+	size_t len;
+
+	if(!refresh && prev) {
+		prev_hdr = (struct isis_link_state_hdr *) (STREAM_DATA(prev) + ISIS_FIXED_HDR_LEN);
+		len = stream_get_endp(lsp->pdu);
+		if(prev_hdr->lsp_bits == lsp->lsp_header->lsp_bits && stream_get_endp(prev) == len
+		   && !memcmp(STREAM_DATA(prev) + ISIS_FIXED_HDR_LEN + ISIS_LSP_HDR_LEN, STREAM_DATA(lsp->pdu) + ISIS_FIXED_HDR_LEN + ISIS_LSP_HDR_LEN, len - ISIS_FIXED_HDR_LEN - ISIS_LSP_HDR_LEN)) {
+			lsp_set_time(lsp);
+			if(ntohs(lsp->lsp_header->rem_lifetime) > refresh_time + 300) {
+				return 0;
+			}
+		}
+	}
+
+	/* Set the lifetime values of all the fragments to the same value,
+   * so that no fragment expires before the lsp is refreshed.
+   */
+	lsp->lsp_header->rem_lifetime = htons(rem_lifetime);
+	lsp_schedule_aging(lsp);
+	lsp_inc_seqnum(lsp, 0);
+	lsp_set_all_srmflags(lsp);
+	return 1;
+}
+
+/*
+ * Search own LSPs, update holding time and set SRM. Unless this is the
+ * periodic refresh only the fragments that changed are reissued.
  */
-static int lsp_regenerate(struct isis_area *area, int level) {
-	dict_t *lspdb;
+static int lsp_regenerate(struct isis_area *area, int level, int refresh) {
+	struct isis_lspdb *lspdb;
 	struct isis_lsp *lsp, *frag;
+	struct lsp_frag_map *map;
+	struct stream *prev[LSP_FRAG_MAX];
 	struct listnode *node;
 	u_char lspid[ISIS_SYS_ID_LEN + 2];
 	u_int16_t rem_lifetime, refresh_time;
+	int i, count = 1, reissued;
 
 	if((area == NULL) || (area->is_type & level) != level) {
 		return ISIS_ERROR;
@@ -1631,25 +2096,35 @@ static int lsp_regenerate(struct isis_area *area, int level) {
 		return ISIS_ERROR;
 	}
 
+	memset(prev, 0, sizeof(prev));
+	prev[0] = stream_dup(lsp->pdu);
+	for(ALL_LIST_ELEMENTS_RO(lsp->lspu.frags, node, frag)) {
+		prev[LSP_FRAGMENT(frag->lsp_header->lsp_id)] = stream_dup(frag->pdu);
+	}
+
+	map = lsp_frag_map_new(lsp);
 	lsp_clear_data(lsp);
-	lsp_build(lsp, area);
-	lsp->lsp_header->lsp_bits = lsp_bits_generate(level, area->overload_bit, area->attached_bit);
+	lsp_build(lsp, area, map);
+	lsp_frag_map_free(map);
+
 	rem_lifetime = lsp_rem_lifetime(area, level);
-	lsp->lsp_header->rem_lifetime = htons(rem_lifetime);
-	lsp_seqnum_update(lsp);
+	refresh_time = lsp_refresh_time(lsp, rem_lifetime);
 
+	lsp->lsp_header->lsp_bits = lsp_bits_generate(level, area->overload_bit, area->attached_bit);
+	reissued = lsp_frag_reissue(lsp, prev[0], rem_lifetime, refresh_time, refresh);
 	lsp->last_generated = time(NULL);
-	lsp_set_all_srmflags(lsp);
 	for(ALL_LIST_ELEMENTS_RO(lsp->lspu.frags, node, frag)) {
 		frag->lsp_header->lsp_bits = lsp_bits_generate(level, area->overload_bit, area->attached_bit);
-		/* Set the lifetime values of all the fragments to the same value,
-       * so that no fragment expires before the lsp is refreshed.
-       */
-		frag->lsp_header->rem_lifetime = htons(rem_lifetime);
-		lsp_set_all_srmflags(frag);
+		reissued += lsp_frag_reissue(frag, prev[LSP_FRAGMENT(frag->lsp_header->lsp_id)], rem_lifetime, refresh_time, refresh);
+		count++;
+	}
+
+	for(i = 0; i < LSP_FRAG_MAX; i++) {
+		if(prev[i]) {
+			stream_free(prev[i]);
+		}
 	}
 
-	refresh_time = lsp_refresh_time(lsp, rem_lifetime);
 	if(level == IS_LEVEL_1) {
 		THREAD_TIMER_ON(master, area->t_lsp_refresh[level - 1], lsp_l1_refresh, area, refresh_time);
 	} else if(level == IS_LEVEL_2) {
@@ -1660,8 +2135,9 @@ static int lsp_regenerate(struct isis_area *area, int level) {
 	if(isis->debugs & DEBUG_UPDATE_PACKETS) {
 		zlog_debug(
 			"ISIS-Upd (%s): Refreshing our L%d LSP %s, len %d, "
-			"seq 0x%08x, cksum 0x%04x, lifetime %us refresh %us",
-			area->area_tag, level, rawlspid_print(lsp->lsp_header->lsp_id), ntohl(lsp->lsp_header->pdu_len), ntohl(lsp->lsp_header->seq_num), ntohs(lsp->lsp_header->checksum), ntohs(lsp->lsp_header->rem_lifetime), refresh_time
+			"seq 0x%08x, cksum 0x%04x, lifetime %us refresh %us, "
+			"reissued %d of %d fragments",
+			area->area_tag, level, rawlspid_print(lsp->lsp_header->lsp_id), ntohl(lsp->lsp_header->pdu_len), ntohl(lsp->lsp_header->seq_num), ntohs(lsp->lsp_header->checksum), ntohs(lsp->lsp_header->rem_lifetime), refresh_time, reissued, count
 		);
 	}
 	sched_debug("ISIS (%s): Rebuilt L%d LSP. Set triggered regenerate to non-pending.", area->area_tag, level);
@@ -1674,11 +2150,13 @@ static int lsp_regenerate(struct isis_area *area, int level) {
  */
 static int lsp_l1_refresh(struct thread *thread) {
 	struct isis_area *area;
+	int refresh;
 
 	area = THREAD_ARG(thread);
 	assert(area);
 
 	area->t_lsp_refresh[0] = NULL;
+	refresh = !area->lsp_regenerate_pending[0];
 	area->lsp_regenerate_pending[0] = 0;
 
 	if((area->is_type & IS_LEVEL_1) == 0) {
@@ -1686,16 +2164,18 @@ static int lsp_l1_refresh(struct thread *thread) {
 	}
 
 	sched_debug("ISIS (%s): LSP L1 refresh timer expired. Refreshing LSP...", area->area_tag);
-	return lsp_regenerate(area, IS_LEVEL_1);
+	return lsp_regenerate(area, IS_LEVEL_1, refresh);
 }
 
 static int lsp_l2_refresh(struct thread *thread) {
 	struct isis_area *area;
+	int refresh;
 
 	area = THREAD_ARG(thread);
 	assert(area);
 
 	area->t_lsp_refresh[1] = NULL;
+	refresh = !area->lsp_regenerate_pending[1];
 	area->lsp_regenerate_pending[1] = 0;
 
 	if((area->is_type & IS_LEVEL_2) == 0) {
@@ -1703,7 +2183,7 @@ static int lsp_l2_refresh(struct thread *thread) {
 	}
 
 	sched_debug("ISIS (%s): LSP L2 refresh timer expired. Refreshing LSP...", area->area_tag);
-	return lsp_regenerate(area, IS_LEVEL_2);
+	return lsp_regenerate(area, IS_LEVEL_2, refresh);
 }
 
 int lsp_regenerate_schedule(struct isis_area *area, int level, int all_pseudo) {
@@ -1911,7 +2391,7 @@ static void lsp_build_pseudo(struct isis_lsp *lsp, struct isis_circuit *circuit,
 }
 
 int lsp_generate_pseudo(struct isis_circuit *circuit, int level) {
-	dict_t *lspdb = circuit->area->lspdb[level - 1];
+	struct isis_lspdb *lspdb = circuit->area->lspdb[level - 1];
 	struct isis_lsp *lsp;
 	u_char lsp_id[ISIS_SYS_ID_LEN + 2];
 	u_int16_t rem_lifetime, refresh_time;
@@ -1964,7 +2444,7 @@ int lsp_generate_pseudo(struct isis_circuit *circuit, int level) {
 }
 
 static int lsp_regenerate_pseudo(struct isis_circuit *circuit, int level) {
-	dict_t *lspdb = circuit->area->lspdb[level - 1];
+	struct isis_lspdb *lspdb = circuit->area->lspdb[level - 1];
 	struct isis_lsp *lsp;
 	u_char lsp_id[ISIS_SYS_ID_LEN + 2];
 	u_int16_t rem_lifetime, refresh_time;
@@ -1991,6 +2471,7 @@ static int lsp_regenerate_pseudo(struct isis_circuit *circuit, int level) {
 	lsp->lsp_header->lsp_bits = lsp_bits_generate(level, 0, circuit->area->attached_bit);
 	rem_lifetime = lsp_rem_lifetime(circuit->area, level);
 	lsp->lsp_header->rem_lifetime = htons(rem_lifetime);
+	lsp_schedule_aging(lsp);
 	lsp_inc_seqnum(lsp, 0);
 	lsp->last_generated = time(NULL);
 	lsp_set_all_srmflags(lsp);
@@ -2136,21 +2617,15 @@ int lsp_regenerate_schedule_pseudo(struct isis_circuit *circuit, int level) {
 }
 
 /*
- * Walk through LSPs for an area
- *  - set remaining lifetime
- *  - set LSPs with SRMflag set for sending
+ * Walk through the LSPs of an area with SRMflags set
+ *  - queue them for sending on the flagged circuits
  */
 int lsp_tick(struct thread *thread) {
 	struct isis_area *area;
 	struct isis_circuit *circuit;
 	struct isis_lsp *lsp;
-	struct list *lsp_list;
-	struct listnode *lspnode, *cnode;
-	dnode_t *dnode, *dnode_next;
-	int level;
-	u_int16_t rem_lifetime;
-
-	lsp_list = list_new();
+	struct listnode *lspnode, *lspnnode, *cnode;
+	time_t now;
 
 	area = THREAD_ARG(thread);
 	assert(area);
@@ -2158,82 +2633,42 @@ int lsp_tick(struct thread *thread) {
 	THREAD_TIMER_ON(master, area->t_tick, lsp_tick, area, 1);
 
 	/*
-   * Build a list of LSPs with (any) SRMflag set
-   * and removed the ones that have aged out
+   * Aging is done by the per LSP timers (see lsp_schedule_aging), so
+   * only the LSPs which had a SRMflag set since are looked at here.
+   * Forget the ones which have no SRMflag left.
    */
-	for(level = 0; level < ISIS_LEVELS; level++) {
-		if(area->lspdb[level] && dict_count(area->lspdb[level]) > 0) {
-			for(dnode = dict_first(area->lspdb[level]); dnode != NULL; dnode = dnode_next) {
-				dnode_next = dict_next(area->lspdb[level], dnode);
-				lsp = dnode_get(dnode);
-
-				/*
-               * The lsp rem_lifetime is kept at 0 for MaxAge or
-               * ZeroAgeLifetime depending on explicit purge or
-               * natural age out. So schedule spf only once when
-               * the first time rem_lifetime becomes 0.
-               */
-				rem_lifetime = ntohs(lsp->lsp_header->rem_lifetime);
-				lsp_set_time(lsp);
-
-				/*
-               * Schedule may run spf which should be done only after
-               * the lsp rem_lifetime becomes 0 for the first time.
-               * ISO 10589 - 7.3.16.4 first paragraph.
-               */
-				if(rem_lifetime == 1 && lsp->lsp_header->seq_num != 0) {
-					/* 7.3.16.4 a) set SRM flags on all */
-					lsp_set_all_srmflags(lsp);
-					/* 7.3.16.4 b) retain only the header FIXME  */
-					/* 7.3.16.4 c) record the time to purge FIXME */
-					/* run/schedule spf */
-					/* isis_spf_schedule is called inside lsp_destroy() below;
-                   * so it is not needed here. */
-					/* isis_spf_schedule (lsp->area, lsp->level); */
-				}
+	for(ALL_LIST_ELEMENTS(area->lsp_srm_list, lspnode, lspnnode, lsp)) {
+		if(!flags_any_set(lsp->SRMflags)) {
+			list_delete_node(area->lsp_srm_list, lspnode);
+			lsp->srm_node = NULL;
+		}
+	}
 
-				if(lsp->age_out == 0) {
-					zlog_debug("ISIS-Upd (%s): L%u LSP %s seq 0x%08x aged out", area->area_tag, lsp->level, rawlspid_print(lsp->lsp_header->lsp_id), ntohl(lsp->lsp_header->seq_num));
-#ifdef TOPOLOGY_GENERATE
-					if(lsp->from_topology) {
-						THREAD_TIMER_OFF(lsp->t_lsp_top_ref);
-					}
-#endif /* TOPOLOGY_GENERATE */
-					lsp_destroy(lsp);
-					lsp = NULL;
-					dict_delete_free(area->lspdb[level], dnode);
-				} else if(flags_any_set(lsp->SRMflags)) {
-					listnode_add(lsp_list, lsp);
-				}
-			}
+	if(listcount(area->lsp_srm_list) == 0) {
+		return ISIS_OK;
+	}
 
-			/*
-           * Send LSPs on circuits indicated by the SRMflags
-           */
-			if(listcount(lsp_list) > 0) {
-				for(ALL_LIST_ELEMENTS_RO(area->circuit_list, cnode, circuit)) {
-					int diff = time(NULL) - circuit->lsp_queue_last_cleared;
-					if(circuit->lsp_queue == NULL || diff < MIN_LSP_TRANS_INTERVAL) {
-						continue;
-					}
-					for(ALL_LIST_ELEMENTS_RO(lsp_list, lspnode, lsp)) {
-						if(circuit->upadjcount[lsp->level - 1] && ISIS_CHECK_FLAG(lsp->SRMflags, circuit)) {
-							/* Add the lsp only if it is not already in lsp
-                           * queue */
-							if(!listnode_lookup(circuit->lsp_queue, lsp)) {
-								listnode_add(circuit->lsp_queue, lsp);
-								thread_add_event(master, send_lsp, circuit, 0);
-							}
-						}
-					}
+	/*
+   * Send LSPs on circuits indicated by the SRMflags
+   */
+	now = time(NULL);
+	for(ALL_LIST_ELEMENTS_RO(area->circuit_list, cnode, circuit)) {
+		int diff = now - circuit->lsp_queue_last_cleared;
+		if(circuit->lsp_queue == NULL || diff < MIN_LSP_TRANS_INTERVAL) {
+			continue;
+		}
+		for(ALL_LIST_ELEMENTS_RO(area->lsp_srm_list, lspnode, lsp)) {
+			if(circuit->upadjcount[lsp->level - 1] && ISIS_CHECK_FLAG(lsp->SRMflags, circuit)) {
+				/* Add the lsp only if it is not already in lsp queue */
+				if(!ISIS_CHECK_FLAG(lsp->SRMqueued, circuit)) {
+					listnode_add(circuit->lsp_queue, lsp);
+					ISIS_SET_FLAG(lsp->SRMqueued, circuit);
+					thread_add_event(master, send_lsp, circuit, 0);
 				}
-				list_delete_all_node(lsp_list);
 			}
 		}
 	}
 
-	list_delete(lsp_list);
-
 	return ISIS_OK;
 }
 
@@ -2264,6 +2699,7 @@ void lsp_purge_pseudo(u_char *id, struct isis_circuit *circuit, int level) {
 	lsp->lsp_header->lsp_bits = lsp_bits;
 	lsp->level = level;
 	lsp->age_out = lsp->area->max_lsp_lifetime[level - 1];
+	lsp_schedule_aging(lsp);
 	stream_forward_endp(lsp->pdu, ISIS_FIXED_HDR_LEN + ISIS_LSP_HDR_LEN);
 
 	/*
@@ -2329,6 +2765,15 @@ void lsp_purge_non_exist(int level, struct isis_link_state_hdr *lsp_hdr, struct
 }
 
 void lsp_set_all_srmflags(struct isis_lsp *lsp) {
+	lsp_flood(lsp, NULL);
+}
+
+/*
+ * Set SRM on every circuit but the one the LSP came in on. RFC 2973:
+ * circuits in the same mesh group as that one, and blocked circuits,
+ * are skipped as well.
+ */
+void lsp_flood(struct isis_lsp *lsp, struct isis_circuit *from) {
 	struct listnode *node;
 	struct isis_circuit *circuit;
 
@@ -2339,11 +2784,68 @@ void lsp_set_all_srmflags(struct isis_lsp *lsp) {
 	if(lsp->area) {
 		struct list *circuit_list = lsp->area->circuit_list;
 		for(ALL_LIST_ELEMENTS_RO(circuit_list, node, circuit)) {
-			ISIS_SET_FLAG(lsp->SRMflags, circuit);
+			if(circuit == from || circuit->mesh_blocked) {
+				continue;
+			}
+			if(from && from->mesh_group && circuit->mesh_group == from->mesh_group) {
+				continue;
+			}
+			lsp_set_srmflag(lsp, circuit);
 		}
 	}
 }
 
+void lsp_set_srmflag(struct isis_lsp *lsp, struct isis_circuit *circuit) {
+	ISIS_SET_FLAG(lsp->SRMflags, circuit);
+
+	if(lsp->srm_node == NULL && lsp->area && lsp->area->lsp_srm_list) {
+		listnode_add(lsp->area->lsp_srm_list, lsp);
+		lsp->srm_node = listtail(lsp->area->lsp_srm_list);
+	}
+}
+
+void lsp_set_ssnflag(struct isis_lsp *lsp, struct isis_circuit *circuit) {
+	struct list *queue;
+
+	ISIS_SET_FLAG(lsp->SSNflags, circuit);
+
+	queue = circuit->psnp_queue[lsp->level - 1];
+	if(queue && !ISIS_CHECK_FLAG(lsp->SSNqueued, circuit)) {
+		listnode_add(queue, lsp);
+		ISIS_SET_FLAG(lsp->SSNqueued, circuit);
+	}
+}
+
+void lsp_psnp_queue_flush(struct isis_circuit *circuit) {
+	struct listnode *node;
+	struct isis_lsp *lsp;
+	int i;
+
+	for(i = 0; i < ISIS_LEVELS; i++) {
+		if(circuit->psnp_queue[i] == NULL) {
+			continue;
+		}
+		for(ALL_LIST_ELEMENTS_RO(circuit->psnp_queue[i], node, lsp)) {
+			ISIS_CLEAR_FLAG(lsp->SSNqueued, circuit);
+		}
+		list_delete_all_node(circuit->psnp_queue[i]);
+	}
+}
+
+void lsp_queue_flush(struct isis_circuit *circuit) {
+	struct listnode *node;
+	struct isis_lsp *lsp;
+
+	if(circuit->lsp_queue == NULL) {
+		return;
+	}
+
+	for(ALL_LIST_ELEMENTS_RO(circuit->lsp_queue, node, lsp)) {
+		ISIS_CLEAR_FLAG(lsp->SRMqueued, circuit);
+	}
+	list_delete_all_node(circuit->lsp_queue);
+}
+
 #ifdef TOPOLOGY_GENERATE
 static int top_lsp_refresh(struct thread *thread) {
 	struct isis_lsp *lsp;
@@ -2366,6 +2868,7 @@ static int top_lsp_refresh(struct thread *thread) {
 	lsp->lsp_header->lsp_bits = lsp_bits_generate(lsp->level, lsp->area->overload_bit, lsp->area->attached_bit);
 	rem_lifetime = lsp_rem_lifetime(lsp->area, IS_LEVEL_1);
 	lsp->lsp_header->rem_lifetime = htons(rem_lifetime);
+	lsp_schedule_aging(lsp);
 
 	/* refresh_time = lsp_refresh_time (lsp, rem_lifetime); */
 	THREAD_TIMER_ON(master, lsp->t_lsp_top_ref, top_lsp_refresh, lsp, lsp->area->lsp_refresh[0]);
@@ -2421,19 +2924,22 @@ void generate_topology_lsps(struct isis_area *area) {
 
 void remove_topology_lsps(struct isis_area *area) {
 	struct isis_lsp *lsp;
-	dnode_t *dnode, *dnode_next;
+	struct list *list;
+	struct listnode *node;
+	unsigned int i;
 
-	dnode = dict_first(area->lspdb[0]);
-	while(dnode != NULL) {
-		dnode_next = dict_next(area->lspdb[0], dnode);
-		lsp = dnode_get(dnode);
+	list = list_new();
+	for(i = 0; (lsp = lspdb_nth(area->lspdb[0], i)); i++) {
 		if(lsp->from_topology) {
-			THREAD_TIMER_OFF(lsp->t_lsp_top_ref);
-			lsp_destroy(lsp);
-			dict_delete(area->lspdb[0], dnode);
+			listnode_add(list, lsp);
 		}
-		dnode = dnode_next;
 	}
+	for(ALL_LIST_ELEMENTS_RO(list, node, lsp)) {
+		THREAD_TIMER_OFF(lsp->t_lsp_top_ref);
+		lspdb_del(area->lspdb[0], lsp);
+		lsp_destroy(lsp);
+	}
+	list_delete(list);
 }
 
 void build_topology_lsp_data(struct isis_lsp *lsp, struct isis_area *area, int lsp_top_num) {
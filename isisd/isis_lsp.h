@@ -41,6 +41,9 @@ struct isis_lsp {
 	u_int32_t auth_tlv_offset; /* authentication TLV position in the pdu */
 	u_int32_t SRMflags[ISIS_MAX_CIRCUITS];
 	u_int32_t SSNflags[ISIS_MAX_CIRCUITS];
+	u_int32_t SRMqueued[ISIS_MAX_CIRCUITS]; /* on circuit->lsp_queue */
+	u_int32_t SSNqueued[ISIS_MAX_CIRCUITS]; /* on circuit->psnp_queue */
+	struct listnode *srm_node;		 /* on area->lsp_srm_list */
 	int level;     /* L1 or L2? */
 	int scheduled; /* scheduled for sending */
 	time_t installed;
@@ -52,12 +55,15 @@ struct isis_lsp {
 #endif
 	/* used for 60 second counting when rem_lifetime is zero */
 	int age_out;
+	/* expiry or age out of this lsp, see lsp_schedule_aging() */
+	struct thread *t_aging;
+	time_t lifetime_at; /* when lsp_header->rem_lifetime was last current */
 	struct isis_area *area;
 	struct tlvs tlv_data; /* Simplifies TLV access */
 };
 
-dict_t *lsp_db_init(void);
-void lsp_db_destroy(dict_t *lspdb);
+struct isis_lspdb *lsp_db_init(void);
+void lsp_db_destroy(struct isis_lspdb *lspdb);
 int lsp_tick(struct thread *thread);
 
 int lsp_generate(struct isis_area *area, int level);
@@ -67,14 +73,12 @@ int lsp_regenerate_schedule_pseudo(struct isis_circuit *circuit, int level);
 
 struct isis_lsp *lsp_new(struct isis_area *area, u_char *lsp_id, u_int16_t rem_lifetime, u_int32_t seq_num, u_int8_t lsp_bits, u_int16_t checksum, int level);
 struct isis_lsp *lsp_new_from_stream_ptr(struct stream *stream, u_int16_t pdu_len, struct isis_lsp *lsp0, struct isis_area *area, int level);
-void lsp_insert(struct isis_lsp *lsp, dict_t *lspdb);
-struct isis_lsp *lsp_search(u_char *id, dict_t *lspdb);
+void lsp_insert(struct isis_lsp *lsp, struct isis_lspdb *lspdb);
+struct isis_lsp *lsp_search(u_char *id, struct isis_lspdb *lspdb);
 
-void lsp_build_list(u_char *start_id, u_char *stop_id, u_char num_lsps, struct list *list, dict_t *lspdb);
-void lsp_build_list_nonzero_ht(u_char *start_id, u_char *stop_id, struct list *list, dict_t *lspdb);
-void lsp_build_list_ssn(struct isis_circuit *circuit, u_char num_lsps, struct list *list, dict_t *lspdb);
+void lsp_build_list_nonzero_ht(u_char *start_id, u_char *stop_id, struct list *list, struct isis_lspdb *lspdb);
 
-void lsp_search_and_destroy(u_char *id, dict_t *lspdb);
+void lsp_search_and_destroy(u_char *id, struct isis_lspdb *lspdb);
 void lsp_purge_pseudo(u_char *id, struct isis_circuit *circuit, int level);
 void lsp_purge_non_exist(int level, struct isis_link_state_hdr *lsp_hdr, struct isis_area *area);
 
@@ -94,11 +98,25 @@ void lsp_update(struct isis_lsp *lsp, struct stream *stream, struct isis_area *a
 void lsp_inc_seqnum(struct isis_lsp *lsp, u_int32_t seq_num);
 void lsp_print(struct isis_lsp *lsp, struct vty *vty, char dynhost);
 void lsp_print_detail(struct isis_lsp *lsp, struct vty *vty, char dynhost);
-int lsp_print_all(struct vty *vty, dict_t *lspdb, char detail, char dynhost);
+int lsp_print_all(struct vty *vty, struct isis_lspdb *lspdb, char detail, char dynhost);
 const char *lsp_bits2string(u_char *);
 
 /* sets SRMflags for all active circuits of an lsp */
 void lsp_set_all_srmflags(struct isis_lsp *lsp);
+/* sets SRMflags for flooding an lsp received on circuit, RFC 2973 aware */
+void lsp_flood(struct isis_lsp *lsp, struct isis_circuit *circuit);
+/* sets the SRMflag of one circuit and marks the lsp for lsp_tick */
+void lsp_set_srmflag(struct isis_lsp *lsp, struct isis_circuit *circuit);
+/* sets the SSNflag of one circuit and queues the lsp for the next PSNP */
+void lsp_set_ssnflag(struct isis_lsp *lsp, struct isis_circuit *circuit);
+/* empties the transmit queue of a circuit */
+void lsp_queue_flush(struct isis_circuit *circuit);
+/* empties the PSNP queues of a circuit */
+void lsp_psnp_queue_flush(struct isis_circuit *circuit);
+/* brings lsp_header->rem_lifetime up to date */
+void lsp_set_time(struct isis_lsp *lsp);
+/* walks the IP reachability TLVs of the lsp in its pdu */
+void lsp_reach_iter_init(struct tlv_reach_iter *iter, struct isis_lsp *lsp, u_int32_t types);
 
 #ifdef TOPOLOGY_GENERATE
 void generate_topology_lsps(struct isis_area *area);
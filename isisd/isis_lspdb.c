@@ -0,0 +1,223 @@
+/*
+ * IS-IS Rout(e)ing protocol - isis_lspdb.c
+ *                             LSP database index
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public Licenseas published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ */
+
+#include <zebra.h>
+
+#include "linklist.h"
+#include "thread.h"
+#include "vty.h"
+#include "stream.h"
+#include "memory.h"
+#include "prefix.h"
+#include "if.h"
+#include "jhash.h"
+
+#include "isisd/isis_constants.h"
+#include "isisd/isis_common.h"
+#include "isisd/isis_flags.h"
+#include "isisd/isis_circuit.h"
+#include "isisd/isisd.h"
+#include "isisd/isis_tlv.h"
+#include "isisd/isis_lsp.h"
+#include "isisd/isis_pdu.h"
+#include "isisd/isis_lspdb.h"
+
+#define LSPDB_MIN_SIZE 64
+
+static u_int64_t lspdb_key(const u_char *lsp_id) {
+	u_int64_t id = 0;
+	int i;
+
+	for(i = 0; i < ISIS_SYS_ID_LEN + 2; i++) {
+		id = (id << 8) | lsp_id[i];
+	}
+
+	return id;
+}
+
+static unsigned int lspdb_home(const struct isis_lspdb *db, u_int64_t id) {
+	return jhash_2words((u_int32_t) (id >> 32), (u_int32_t) id, 0) & (db->size - 1);
+}
+
+/* slot holding id, or the empty slot ending its probe sequence */
+static unsigned int lspdb_slot(const struct isis_lspdb *db, u_int64_t id) {
+	unsigned int i = lspdb_home(db, id);
+
+	while(db->slots[i].lsp && db->slots[i].id != id) {
+		i = (i + 1) & (db->size - 1);
+	}
+
+	return i;
+}
+
+static void lspdb_flush_sorted(struct isis_lspdb *db) {
+	if(db->sorted) {
+		XFREE(MTYPE_ISIS_DICT, db->sorted);
+		db->sorted = NULL;
+	}
+}
+
+static void lspdb_resize(struct isis_lspdb *db, unsigned int size) {
+	struct lspdb_entry *old = db->slots;
+	unsigned int old_size = db->size, i;
+
+	db->slots = XCALLOC(MTYPE_ISIS_DICT, sizeof(struct lspdb_entry) * size);
+	db->size = size;
+
+	for(i = 0; i < old_size; i++) {
+		if(old[i].lsp) {
+			db->slots[lspdb_slot(db, old[i].id)] = old[i];
+		}
+	}
+
+	if(old) {
+		XFREE(MTYPE_ISIS_DICT, old);
+	}
+}
+
+struct isis_lspdb *lspdb_new(void) {
+	struct isis_lspdb *db;
+
+	db = XCALLOC(MTYPE_ISIS_DICT, sizeof(struct isis_lspdb));
+	lspdb_resize(db, LSPDB_MIN_SIZE);
+
+	return db;
+}
+
+void lspdb_free(struct isis_lspdb *db) {
+	lspdb_flush_sorted(db);
+	XFREE(MTYPE_ISIS_DICT, db->slots);
+	XFREE(MTYPE_ISIS_DICT, db);
+}
+
+unsigned int lspdb_count(const struct isis_lspdb *db) {
+	return db ? db->count : 0;
+}
+
+struct isis_lsp *lspdb_lookup(const struct isis_lspdb *db, const u_char *lsp_id) {
+	return db->slots[lspdb_slot(db, lspdb_key(lsp_id))].lsp;
+}
+
+void lspdb_add(struct isis_lspdb *db, struct isis_lsp *lsp) {
+	u_int64_t id = lspdb_key(lsp->lsp_header->lsp_id);
+	unsigned int i;
+
+	/* keep the load below 3/4 so probe sequences stay short */
+	if((db->count + 1) * 4 > db->size * 3) {
+		lspdb_resize(db, db->size * 2);
+	}
+
+	i = lspdb_slot(db, id);
+	assert(db->slots[i].lsp == NULL);
+	db->slots[i].id = id;
+	db->slots[i].lsp = lsp;
+	db->count++;
+	lspdb_flush_sorted(db);
+}
+
+void lspdb_del(struct isis_lspdb *db, struct isis_lsp *lsp) {
+	unsigned int i, j, home, mask = db->size - 1;
+
+	i = lspdb_slot(db, lspdb_key(lsp->lsp_header->lsp_id));
+	if(db->slots[i].lsp != lsp) {
+		return;
+	}
+
+	/* shift back the entries that probed past the freed slot */
+	for(j = (i + 1) & mask; db->slots[j].lsp; j = (j + 1) & mask) {
+		home = lspdb_home(db, db->slots[j].id);
+		if(((j - home) & mask) >= ((j - i) & mask)) {
+			db->slots[i] = db->slots[j];
+			i = j;
+		}
+	}
+	db->slots[i].lsp = NULL;
+	db->count--;
+	lspdb_flush_sorted(db);
+}
+
+/* in no particular order, func must not add or delete */
+void lspdb_iterate(struct isis_lspdb *db, void (*func)(struct isis_lsp *)) {
+	unsigned int i;
+
+	for(i = 0; i < db->size; i++) {
+		if(db->slots[i].lsp) {
+			(*func)(db->slots[i].lsp);
+		}
+	}
+}
+
+static int lspdb_entry_cmp(const void *a, const void *b) {
+	const struct lspdb_entry *ea = a, *eb = b;
+
+	if(ea->id == eb->id) {
+		return 0;
+	}
+	return ea->id < eb->id ? -1 : 1;
+}
+
+static struct lspdb_entry *lspdb_sorted(struct isis_lspdb *db) {
+	unsigned int i, n = 0;
+
+	if(db->sorted == NULL && db->count > 0) {
+		db->sorted = XMALLOC(MTYPE_ISIS_DICT, sizeof(struct lspdb_entry) * db->count);
+		for(i = 0; i < db->size; i++) {
+			if(db->slots[i].lsp) {
+				db->sorted[n++] = db->slots[i];
+			}
+		}
+		qsort(db->sorted, n, sizeof(struct lspdb_entry), lspdb_entry_cmp);
+	}
+
+	return db->sorted;
+}
+
+struct isis_lsp *lspdb_nth(struct isis_lspdb *db, unsigned int i) {
+	if(i >= db->count) {
+		return NULL;
+	}
+
+	return lspdb_sorted(db)[i].lsp;
+}
+
+/* first index whose id is above id, or at or above it for lower */
+static unsigned int lspdb_bound(struct isis_lspdb *db, const u_char *lsp_id, int lower) {
+	struct lspdb_entry *sorted = lspdb_sorted(db);
+	u_int64_t id = lspdb_key(lsp_id);
+	unsigned int lo = 0, hi = db->count, mid;
+
+	while(lo < hi) {
+		mid = lo + (hi - lo) / 2;
+		if(sorted[mid].id < id || (!lower && sorted[mid].id == id)) {
+			lo = mid + 1;
+		} else {
+			hi = mid;
+		}
+	}
+
+	return lo;
+}
+
+unsigned int lspdb_lower_bound(struct isis_lspdb *db, const u_char *lsp_id) {
+	return lspdb_bound(db, lsp_id, 1);
+}
+
+unsigned int lspdb_upper_bound(struct isis_lspdb *db, const u_char *lsp_id) {
+	return lspdb_bound(db, lsp_id, 0);
+}
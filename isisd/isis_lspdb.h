@@ -0,0 +1,59 @@
+/*
+ * IS-IS Rout(e)ing protocol - isis_lspdb.h
+ *                             LSP database index
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public Licenseas published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ */
+
+#ifndef _ZEBRA_ISIS_LSPDB_H
+#define _ZEBRA_ISIS_LSPDB_H
+
+struct isis_lsp;
+
+/*
+ * An LSP ID (system id, pseudonode id and fragment number) read as a
+ * big endian integer, so that comparing keys orders LSPs like memcmp.
+ */
+struct lspdb_entry {
+	u_int64_t id;
+	struct isis_lsp *lsp; /* NULL for an empty slot */
+};
+
+/*
+ * The lspdb is an open addressed hash on the LSP ID for lookups. The
+ * ordered walks (CSNPs, PSNP ranges, show) use an array of the entries
+ * sorted on the id, which is built on the first walk after a change.
+ */
+struct isis_lspdb {
+	struct lspdb_entry *slots;
+	unsigned int size; /* power of two */
+	unsigned int count;
+	struct lspdb_entry *sorted;
+};
+
+struct isis_lspdb *lspdb_new(void);
+void lspdb_free(struct isis_lspdb *db);
+unsigned int lspdb_count(const struct isis_lspdb *db);
+struct isis_lsp *lspdb_lookup(const struct isis_lspdb *db, const u_char *lsp_id);
+void lspdb_add(struct isis_lspdb *db, struct isis_lsp *lsp);
+void lspdb_del(struct isis_lspdb *db, struct isis_lsp *lsp);
+void lspdb_iterate(struct isis_lspdb *db, void (*func)(struct isis_lsp *));
+
+/* ordered access, an index is valid until the next lspdb_add/del */
+struct isis_lsp *lspdb_nth(struct isis_lspdb *db, unsigned int i);
+unsigned int lspdb_lower_bound(struct isis_lspdb *db, const u_char *lsp_id);
+unsigned int lspdb_upper_bound(struct isis_lspdb *db, const u_char *lsp_id);
+
+#endif /* _ZEBRA_ISIS_LSPDB_H */
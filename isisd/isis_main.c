@@ -38,7 +38,6 @@
 #include "zclient.h"
 #include "vrf.h"
 
-#include "isisd/dict.h"
 #include "include-netbsd/iso.h"
 #include "isisd/isis_constants.h"
 #include "isisd/isis_common.h"
@@ -87,6 +86,7 @@ struct option longopts[] = {
 	{ "user", required_argument, NULL, 'u' },
 	{ "group", required_argument, NULL, 'g' },
 	{ "skip_runas", no_argument, NULL, 'S' },
+	{ "spf_threads", required_argument, NULL, 't' },
 	{ "version", no_argument, NULL, 'v' },
 	{ "dryrun", no_argument, NULL, 'C' },
 	{ "help", no_argument, NULL, 'h' },
@@ -140,6 +140,7 @@ Daemon which manages IS-IS routing\n\n\
 -u, --user         User to run as\n\
 -g, --group        Group to run as\n\
 -S, --skip_runas   Skip user and group run as\n\
+-t, --spf_threads  Number of threads calculating SPFs in parallel\n\
 -v, --version      Print program version\n\
 -C, --dryrun       Check configuration for validity and exit\n\
 -h, --help         Display this help and exit\n\
@@ -219,6 +220,7 @@ int main(int argc, char **argv, char **envp) {
 	char *vty_addr = NULL;
 	int dryrun = 0;
 	int skip_runas = 0;
+	unsigned int spf_threads = 0;
 
 	/* Get the programname without the preceding path. */
 	progname = ((p = strrchr(argv[0], '/')) ? ++p : argv[0]);
@@ -238,7 +240,7 @@ int main(int argc, char **argv, char **envp) {
 
 	/* Command line argument treatment. */
 	while(1) {
-		opt = getopt_long(argc, argv, "df:i:z:hA:p:P:u:g:vCS", longopts, 0);
+		opt = getopt_long(argc, argv, "df:i:z:hA:p:P:u:g:vCSt:", longopts, 0);
 
 		if(opt == EOF) {
 			break;
@@ -264,6 +266,11 @@ int main(int argc, char **argv, char **envp) {
 			case 'u': isisd_privs.user = optarg; break;
 			case 'g': isisd_privs.group = optarg; break;
 			case 'S': skip_runas = 1; break;
+			case 't':
+				if(atoi(optarg) > 0) {
+					spf_threads = atoi(optarg);
+				}
+				break;
 			case 'v':
 				printf("ISISd version %s\n", ISISD_VERSION);
 				printf("Copyright (c) 2001-2002 Sampo Saaristo,"
@@ -279,6 +286,8 @@ int main(int argc, char **argv, char **envp) {
 
 	/* thread master */
 	master = thread_master_create();
+	/* every LSP in the databases carries an aging timer */
+	thread_master_timer_wheel_enable(master);
 
 	/* random seed from time */
 	srandom(time(NULL));
@@ -306,6 +315,7 @@ int main(int argc, char **argv, char **envp) {
 
 	/* create the global 'isis' instance */
 	isis_new(1);
+	isis->spf_threads = spf_threads;
 
 	isis_zebra_init(master);
 
@@ -29,7 +29,6 @@
 #include "if.h"
 #include "command.h"
 
-#include "isisd/dict.h"
 #include "isisd/isis_constants.h"
 #include "isisd/isis_common.h"
 #include "isisd/isis_flags.h"
@@ -280,6 +279,20 @@ const char *circuit_t2string(int circuit_t) {
 	return NULL; /* not reached */
 }
 
+const char *isis_mt_name(u_int16_t mtid) {
+	switch(mtid) {
+		case ISIS_MT_IPV4_UNICAST: return "ipv4-unicast";
+		case ISIS_MT_IPV4_MGMT: return "ipv4-mgmt";
+		case ISIS_MT_IPV6_UNICAST: return "ipv6-unicast";
+		case ISIS_MT_IPV4_MULTICAST: return "ipv4-multicast";
+		case ISIS_MT_IPV6_MULTICAST: return "ipv6-multicast";
+		case ISIS_MT_IPV6_MGMT: return "ipv6-mgmt";
+		default: return "??";
+	}
+
+	return NULL; /* not reached */
+}
+
 const char *syst2string(int type) {
 	switch(type) {
 		case ISIS_SYSTYPE_ES: return "ES";
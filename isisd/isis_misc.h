@@ -29,6 +29,7 @@ const char *circuit_t2string(int);
 const char *circuit_state2string(int state);
 const char *circuit_type2string(int type);
 const char *syst2string(int);
+const char *isis_mt_name(u_int16_t mtid);
 struct in_addr newprefix2inaddr(u_char *prefix_start, u_char prefix_masklen);
 /*
  * Converting input to memory stored format
@@ -27,6 +27,7 @@ extern u_char ALL_L1_ISYSTEMS[];
 extern u_char ALL_L2_ISYSTEMS[];
 
 int isis_sock_init(struct isis_circuit *circuit);
+void isis_sock_close(struct isis_circuit *circuit);
 
 int isis_recv_pdu_bcast(struct isis_circuit *circuit, u_char *ssnpa);
 int isis_recv_pdu_p2p(struct isis_circuit *circuit, u_char *ssnpa);
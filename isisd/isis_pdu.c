@@ -35,7 +35,6 @@
 #include "checksum.h"
 #include "md5.h"
 
-#include "isisd/dict.h"
 #include "isisd/include-netbsd/iso.h"
 #include "isisd/isis_constants.h"
 #include "isisd/isis_common.h"
@@ -295,6 +294,30 @@ static int tlvs_to_adj_nlpids(struct tlvs *tlvs, struct isis_adjacency *adj) {
 	return 0;
 }
 
+/* no MT TLV means the standard topology only */
+static void tlvs_to_adj_mt(struct tlvs *tlvs, struct isis_adjacency *adj) {
+	struct listnode *node;
+	struct mt_router_info *mt_info;
+	u_int32_t mt_mask = 0;
+
+	if(tlvs->mt_router_info) {
+		for(ALL_LIST_ELEMENTS_RO(tlvs->mt_router_info, node, mt_info)) {
+			if(mt_info->mtid < 32) {
+				mt_mask |= 1 << mt_info->mtid;
+			}
+		}
+	} else {
+		mt_mask = 1 << ISIS_MT_IPV4_UNICAST;
+	}
+
+	if(adj->mt_mask != mt_mask) {
+		adj->mt_mask = mt_mask;
+		if(adj->adj_state == ISIS_ADJ_UP && adj->circuit->area->mt_ipv6) {
+			lsp_regenerate_schedule(adj->circuit->area, IS_LEVEL_1 | IS_LEVEL_2, 0);
+		}
+	}
+}
+
 static void tlvs_to_adj_ipv4_addrs(struct tlvs *tlvs, struct isis_adjacency *adj) {
 	struct listnode *node;
 	struct in_addr *ipv4_addr, *malloced;
@@ -337,6 +360,41 @@ static void tlvs_to_adj_ipv6_addrs(struct tlvs *tlvs, struct isis_adjacency *adj
  *  RECEIVE SIDE                           
  */
 
+/*
+ * The IIH as the fast path compares it: the hello header followed by the
+ * TLVs, without the padding. Returns the length or -1 if a TLV runs past
+ * the PDU, which is left to parse_tlvs() to complain about.
+ */
+static u_char hello_image_buf[65535];
+
+static int hello_image(const u_char *hdr, int hdr_len, const u_char *tlv, int tlv_len) {
+	const u_char *end = tlv + tlv_len;
+	int len = hdr_len;
+
+	memcpy(hello_image_buf, hdr, hdr_len);
+	while(tlv + 2 <= end) {
+		if(tlv + 2 + tlv[1] > end) {
+			return -1;
+		}
+		if(tlv[0] != PADDING) {
+			memcpy(hello_image_buf + len, tlv, 2 + tlv[1]);
+			len += 2 + tlv[1];
+		}
+		tlv += 2 + tlv[1];
+	}
+
+	return tlv == end ? len : -1;
+}
+
+/* an up adjacency sending the hello it sent before, just keep it alive */
+static void hello_refresh(struct isis_adjacency *adj, u_int16_t hold_time) {
+	adj->hold_time = hold_time;
+	adj->last_upd = time(NULL);
+
+	THREAD_TIMER_OFF(adj->t_expire);
+	THREAD_TIMER_ON(master, adj->t_expire, isis_adj_expire, adj, (long) adj->hold_time);
+}
+
 /*
  * Process P2P IIH
  * ISO - 10589
@@ -351,6 +409,7 @@ static int process_p2p_hello(struct isis_circuit *circuit) {
 	uint16_t pdu_len;
 	struct tlvs tlvs;
 	int v4_usable = 0, v6_usable = 0;
+	int image_len;
 
 	if(isis->debugs & DEBUG_ADJ_PACKETS) {
 		zlog_debug("ISIS-Adj (%s): Rcvd P2P IIH on %s, cirType %s, cirID %u", circuit->area->area_tag, circuit->interface->name, circuit_t2string(circuit->is_type), circuit->circuit_id);
@@ -407,6 +466,13 @@ static int process_p2p_hello(struct isis_circuit *circuit) {
 
 	stream_forward_getp(circuit->rcv_stream, ISIS_P2PHELLO_HDRLEN);
 
+	image_len = hello_image((u_char *) hdr, ISIS_P2PHELLO_HDRLEN, STREAM_PNT(circuit->rcv_stream), pdu_len - ISIS_P2PHELLO_HDRLEN - ISIS_FIXED_HDR_LEN);
+	adj = circuit->u.p2p.neighbor;
+	if(image_len > 0 && adj && adj->adj_state == ISIS_ADJ_UP && isis_adj_hello_same(adj, hello_image_buf, image_len)) {
+		hello_refresh(adj, ntohs(hdr->hold_time));
+		return ISIS_OK;
+	}
+
 	/*
    * Lets get the TLVS now
    */
@@ -415,6 +481,7 @@ static int process_p2p_hello(struct isis_circuit *circuit) {
 	expected |= TLVFLAG_NLPID;
 	expected |= TLVFLAG_IPV4_ADDR;
 	expected |= TLVFLAG_IPV6_ADDR;
+	expected |= TLVFLAG_MT_ROUTER_INFO;
 
 	auth_tlv_offset = stream_get_getp(circuit->rcv_stream);
 	retval = parse_tlvs(circuit->area->area_tag, STREAM_PNT(circuit->rcv_stream), pdu_len - ISIS_P2PHELLO_HDRLEN - ISIS_FIXED_HDR_LEN, &expected, &found, &tlvs, &auth_tlv_offset);
@@ -555,6 +622,7 @@ static int process_p2p_hello(struct isis_circuit *circuit) {
 		free_tlvs(&tlvs);
 		return ISIS_WARNING;
 	}
+	tlvs_to_adj_mt(&tlvs, adj);
 
 	/* we need to copy addresses to the adj */
 	if(found & TLVFLAG_IPV4_ADDR) {
@@ -756,6 +824,10 @@ static int process_p2p_hello(struct isis_circuit *circuit) {
 		case ISIS_ADJ_NONE: adj->sys_type = ISIS_SYSTYPE_UNKNOWN; break;
 	}
 
+	if(image_len > 0 && circuit->u.p2p.neighbor == adj && adj->adj_state == ISIS_ADJ_UP) {
+		isis_adj_hello_set(adj, hello_image_buf, image_len);
+	}
+
 	if(isis->debugs & DEBUG_ADJ_PACKETS) {
 		zlog_debug(
 			"ISIS-Adj (%s): Rcvd P2P IIH from (%s), cir type %s,"
@@ -769,6 +841,25 @@ static int process_p2p_hello(struct isis_circuit *circuit) {
 	return retval;
 }
 
+static void lan_hello_dis_check(struct isis_circuit *circuit, struct isis_adjacency *adj, int level, const u_char *lan_id) {
+	if(adj->dis_record[level - 1].dis == ISIS_IS_DIS) {
+		switch(level) {
+			case 1:
+				if(memcmp(circuit->u.bc.l1_desig_is, lan_id, ISIS_SYS_ID_LEN + 1)) {
+					thread_add_event(master, isis_event_dis_status_change, circuit, 0);
+					memcpy(&circuit->u.bc.l1_desig_is, lan_id, ISIS_SYS_ID_LEN + 1);
+				}
+				break;
+			case 2:
+				if(memcmp(circuit->u.bc.l2_desig_is, lan_id, ISIS_SYS_ID_LEN + 1)) {
+					thread_add_event(master, isis_event_dis_status_change, circuit, 0);
+					memcpy(&circuit->u.bc.l2_desig_is, lan_id, ISIS_SYS_ID_LEN + 1);
+				}
+				break;
+		}
+	}
+}
+
 /*
  * Process IS-IS LAN Level 1/2 Hello PDU
  */
@@ -781,6 +872,7 @@ static int process_lan_hello(int level, struct isis_circuit *circuit, const u_ch
 	u_char *snpa;
 	struct listnode *node;
 	int v4_usable = 0, v6_usable = 0;
+	int image_len;
 
 	if(isis->debugs & DEBUG_ADJ_PACKETS) {
 		zlog_debug(
@@ -863,6 +955,14 @@ static int process_lan_hello(int level, struct isis_circuit *circuit, const u_ch
 		return ISIS_ERROR;
 	}
 
+	image_len = hello_image(STREAM_PNT(circuit->rcv_stream) - ISIS_LANHELLO_HDRLEN, ISIS_LANHELLO_HDRLEN, STREAM_PNT(circuit->rcv_stream), hdr.pdu_len - ISIS_LANHELLO_HDRLEN - ISIS_FIXED_HDR_LEN);
+	adj = isis_adj_lookup(hdr.source_id, circuit->u.bc.adjdb[level - 1]);
+	if(image_len > 0 && adj && ssnpa && !memcmp(adj->snpa, ssnpa, ETH_ALEN) && adj->level == level && adj->adj_state == ISIS_ADJ_UP && isis_adj_hello_same(adj, hello_image_buf, image_len)) {
+		lan_hello_dis_check(circuit, adj, level, hdr.lan_id);
+		hello_refresh(adj, hdr.hold_time);
+		return ISIS_OK;
+	}
+
 	/*
    * Then get the tlvs
    */
@@ -872,6 +972,7 @@ static int process_lan_hello(int level, struct isis_circuit *circuit, const u_ch
 	expected |= TLVFLAG_NLPID;
 	expected |= TLVFLAG_IPV4_ADDR;
 	expected |= TLVFLAG_IPV6_ADDR;
+	expected |= TLVFLAG_MT_ROUTER_INFO;
 
 	auth_tlv_offset = stream_get_getp(circuit->rcv_stream);
 	retval = parse_tlvs(circuit->area->area_tag, STREAM_PNT(circuit->rcv_stream), hdr.pdu_len - ISIS_LANHELLO_HDRLEN - ISIS_FIXED_HDR_LEN, &expected, &found, &tlvs, &auth_tlv_offset);
@@ -1012,22 +1113,7 @@ static int process_lan_hello(int level, struct isis_circuit *circuit, const u_ch
 		isis_adj_build_neigh_list(circuit->u.bc.adjdb[level - 1], circuit->u.bc.lan_neighs[level - 1]);
 	}
 
-	if(adj->dis_record[level - 1].dis == ISIS_IS_DIS) {
-		switch(level) {
-			case 1:
-				if(memcmp(circuit->u.bc.l1_desig_is, hdr.lan_id, ISIS_SYS_ID_LEN + 1)) {
-					thread_add_event(master, isis_event_dis_status_change, circuit, 0);
-					memcpy(&circuit->u.bc.l1_desig_is, hdr.lan_id, ISIS_SYS_ID_LEN + 1);
-				}
-				break;
-			case 2:
-				if(memcmp(circuit->u.bc.l2_desig_is, hdr.lan_id, ISIS_SYS_ID_LEN + 1)) {
-					thread_add_event(master, isis_event_dis_status_change, circuit, 0);
-					memcpy(&circuit->u.bc.l2_desig_is, hdr.lan_id, ISIS_SYS_ID_LEN + 1);
-				}
-				break;
-		}
-	}
+	lan_hello_dis_check(circuit, adj, level, hdr.lan_id);
 
 	adj->hold_time = hdr.hold_time;
 	adj->last_upd = time(NULL);
@@ -1042,6 +1128,7 @@ static int process_lan_hello(int level, struct isis_circuit *circuit, const u_ch
 		retval = ISIS_WARNING;
 		goto out;
 	}
+	tlvs_to_adj_mt(&tlvs, adj);
 
 	/* we need to copy addresses to the adj */
 	if(found & TLVFLAG_IPV4_ADDR) {
@@ -1088,6 +1175,10 @@ static int process_lan_hello(int level, struct isis_circuit *circuit, const u_ch
 		isis_adj_state_change(adj, ISIS_ADJ_INITIALIZING, "no LAN Neighbours TLV found");
 	}
 
+	if(image_len > 0 && adj->adj_state == ISIS_ADJ_UP) {
+		isis_adj_hello_set(adj, hello_image_buf, image_len);
+	}
+
 out:
 	if(isis->debugs & DEBUG_ADJ_PACKETS) {
 		zlog_debug(
@@ -1277,8 +1368,8 @@ dontcheckadj:
 				/* 7.3.16.4 b) 1)  */
 				if(comp == LSP_NEWER) {
 					lsp_update(lsp, circuit->rcv_stream, circuit->area, level);
-					/* ii */
-					lsp_set_all_srmflags(lsp);
+					/* ii, and iii unless confused */
+					lsp_flood(lsp, lsp_confusion ? NULL : circuit);
 					/* v */
 					ISIS_FLAGS_CLEAR_ALL(lsp->SSNflags); /* FIXME: OTHER than c */
 
@@ -1286,11 +1377,9 @@ dontcheckadj:
 		   * originator so that it can react. Otherwise, don't reflood
 		   * through incoming circuit as usual */
 					if(!lsp_confusion) {
-						/* iii */
-						ISIS_CLEAR_FLAG(lsp->SRMflags, circuit);
 						/* iv */
 						if(circuit->circ_type != CIRCUIT_T_BROADCAST) {
-							ISIS_SET_FLAG(lsp->SSNflags, circuit);
+							lsp_set_ssnflag(lsp, circuit);
 						}
 					}
 				} /* 7.3.16.4 b) 2) */
@@ -1299,11 +1388,11 @@ dontcheckadj:
 					ISIS_CLEAR_FLAG(lsp->SRMflags, circuit);
 					/* ii */
 					if(circuit->circ_type != CIRCUIT_T_BROADCAST) {
-						ISIS_SET_FLAG(lsp->SSNflags, circuit);
+						lsp_set_ssnflag(lsp, circuit);
 					}
 				} /* 7.3.16.4 b) 3) */
 				else {
-					ISIS_SET_FLAG(lsp->SRMflags, circuit);
+					lsp_set_srmflag(lsp, circuit);
 					ISIS_CLEAR_FLAG(lsp->SSNflags, circuit);
 				}
 			} else if(lsp->lsp_header->rem_lifetime != 0) {
@@ -1312,7 +1401,7 @@ dontcheckadj:
 					lsp_inc_seqnum(lsp, ntohl(hdr->seq_num));
 					lsp_set_all_srmflags(lsp);
 				} else {
-					ISIS_SET_FLAG(lsp->SRMflags, circuit);
+					lsp_set_srmflag(lsp, circuit);
 					ISIS_CLEAR_FLAG(lsp->SSNflags, circuit);
 				}
 				if(isis->debugs & DEBUG_UPDATE_PACKETS) {
@@ -1379,14 +1468,12 @@ dontcheckadj:
 			{
 				lsp_update(lsp, circuit->rcv_stream, circuit->area, level);
 			}
-			/* ii */
-			lsp_set_all_srmflags(lsp);
-			/* iii */
-			ISIS_CLEAR_FLAG(lsp->SRMflags, circuit);
+			/* ii, iii */
+			lsp_flood(lsp, circuit);
 
 			/* iv */
 			if(circuit->circ_type != CIRCUIT_T_BROADCAST) {
-				ISIS_SET_FLAG(lsp->SSNflags, circuit);
+				lsp_set_ssnflag(lsp, circuit);
 			}
 			/* FIXME: v) */
 		}
@@ -1395,12 +1482,12 @@ dontcheckadj:
 			ISIS_CLEAR_FLAG(lsp->SRMflags, circuit);
 			lsp_update(lsp, circuit->rcv_stream, circuit->area, level);
 			if(circuit->circ_type != CIRCUIT_T_BROADCAST) {
-				ISIS_SET_FLAG(lsp->SSNflags, circuit);
+				lsp_set_ssnflag(lsp, circuit);
 			}
 		}
 		/* 7.3.15.1 e) 3) LSP older than the one in db */
 		else {
-			ISIS_SET_FLAG(lsp->SRMflags, circuit);
+			lsp_set_srmflag(lsp, circuit);
 			ISIS_CLEAR_FLAG(lsp->SSNflags, circuit);
 		}
 	}
@@ -1587,15 +1674,15 @@ static int process_snp(int snp_type, int level, struct isis_circuit *circuit, co
 				/* 7.3.15.2 b) 3) if it is older, clear SSN and set SRM */
 				else if(cmp == LSP_OLDER) {
 					ISIS_CLEAR_FLAG(lsp->SSNflags, circuit);
-					ISIS_SET_FLAG(lsp->SRMflags, circuit);
+					lsp_set_srmflag(lsp, circuit);
 				}
 				/* 7.3.15.2 b) 4) if it is newer, set SSN and clear SRM on p2p */
 				else {
 					if(own_lsp) {
 						lsp_inc_seqnum(lsp, ntohl(entry->seq_num));
-						ISIS_SET_FLAG(lsp->SRMflags, circuit);
+						lsp_set_srmflag(lsp, circuit);
 					} else {
-						ISIS_SET_FLAG(lsp->SSNflags, circuit);
+						lsp_set_ssnflag(lsp, circuit);
 						/* if (circuit->circ_type != CIRCUIT_T_BROADCAST) */
 						ISIS_CLEAR_FLAG(lsp->SRMflags, circuit);
 					}
@@ -1607,7 +1694,7 @@ static int process_snp(int snp_type, int level, struct isis_circuit *circuit, co
 					lsp = lsp_new(circuit->area, entry->lsp_id, ntohs(entry->rem_lifetime), 0, 0, entry->checksum, level);
 					lsp_insert(lsp, circuit->area->lspdb[level - 1]);
 					ISIS_FLAGS_CLEAR_ALL(lsp->SRMflags);
-					ISIS_SET_FLAG(lsp->SSNflags, circuit);
+					lsp_set_ssnflag(lsp, circuit);
 				}
 			}
 		}
@@ -1635,7 +1722,7 @@ static int process_snp(int snp_type, int level, struct isis_circuit *circuit, co
 		}
 		/* on remaining LSPs we set SRM (neighbor knew not of) */
 		for(ALL_LIST_ELEMENTS_RO(lsp_list, node, lsp)) {
-			ISIS_SET_FLAG(lsp->SRMflags, circuit);
+			lsp_set_srmflag(lsp, circuit);
 		}
 		/* lets free it */
 		list_delete(lsp_list);
@@ -1766,10 +1853,13 @@ static int isis_handle_pdu(struct isis_circuit *circuit, u_char *ssnpa) {
 }
 
 #ifdef GNU_LINUX
+/* PDUs handled a wakeup at most, when the socket has a ring of them */
+	#define ISIS_RX_BATCH 64
+
 int isis_receive(struct thread *thread) {
 	struct isis_circuit *circuit;
 	u_char ssnpa[ETH_ALEN];
-	int retval;
+	int retval, n = 0;
 
 	/*
    * Get the circuit 
@@ -1777,14 +1867,16 @@ int isis_receive(struct thread *thread) {
 	circuit = THREAD_ARG(thread);
 	assert(circuit);
 
-	isis_circuit_stream(circuit, &circuit->rcv_stream);
-
-	retval = circuit->rx(circuit, ssnpa);
 	circuit->t_read = NULL;
+	do {
+		isis_circuit_stream(circuit, &circuit->rcv_stream);
 
-	if(retval == ISIS_OK) {
-		retval = isis_handle_pdu(circuit, ssnpa);
-	}
+		retval = circuit->rx(circuit, ssnpa);
+
+		if(retval == ISIS_OK) {
+			retval = isis_handle_pdu(circuit, ssnpa);
+		}
+	} while(circuit->rx_pending && ++n < ISIS_RX_BATCH && circuit->rx_pending(circuit));
 
 	/* 
    * prepare for next packet. 
@@ -2003,6 +2095,27 @@ int send_hello(struct isis_circuit *circuit, int level) {
 			return ISIS_WARNING;
 		}
 	}
+
+	/* MT TLV, the topologies of the circuit */
+	if(circuit->area->mt_ipv6) {
+		struct mt_router_info mt_info[2];
+		struct list *mt_list = list_new();
+
+		memset(mt_info, 0, sizeof(mt_info));
+		mt_info[0].mtid = ISIS_MT_IPV4_UNICAST;
+		mt_info[1].mtid = ISIS_MT_IPV6_UNICAST;
+		if(circuit->ip_router) {
+			listnode_add(mt_list, &mt_info[0]);
+		}
+		if(circuit->ipv6_router) {
+			listnode_add(mt_list, &mt_info[1]);
+		}
+		retval = listcount(mt_list) ? tlv_add_mt_router_info(mt_list, circuit->snd_stream) : ISIS_OK;
+		list_delete(mt_list);
+		if(retval) {
+			return ISIS_WARNING;
+		}
+	}
 #endif /* HAVE_IPV6 */
 
 	if(circuit->pad_hellos) {
@@ -2262,39 +2375,42 @@ static uint16_t max_lsps_per_snp(int snp_type, int level, struct isis_circuit *c
 }
 
 /*
- * FIXME: support multiple CSNPs
+ * The entries come from the sorted lspdb of the level, which all
+ * circuits share and which is only re-sorted when LSPs come or go.
  */
-
 int send_csnp(struct isis_circuit *circuit, int level) {
 	u_char start[ISIS_SYS_ID_LEN + 2];
 	u_char stop[ISIS_SYS_ID_LEN + 2];
 	struct list *list = NULL;
 	struct listnode *node;
 	struct isis_lsp *lsp;
-	u_char num_lsps, loop = 1;
-	int i, retval = ISIS_OK;
+	unsigned int count, i, next = 0;
+	u_char num_lsps;
+	int retval = ISIS_OK;
 
-	if(circuit->area->lspdb[level - 1] == NULL || dict_count(circuit->area->lspdb[level - 1]) == 0) {
+	count = lspdb_count(circuit->area->lspdb[level - 1]);
+	if(count == 0) {
 		return retval;
 	}
 
 	memset(start, 0x00, ISIS_SYS_ID_LEN + 2);
-	memset(stop, 0xff, ISIS_SYS_ID_LEN + 2);
 
 	num_lsps = max_lsps_per_snp(ISIS_SNP_CSNP_FLAG, level, circuit);
 
-	while(loop) {
+	while(next < count) {
 		list = list_new();
-		lsp_build_list(start, stop, num_lsps, list, circuit->area->lspdb[level - 1]);
+		for(i = next; i < count && i < next + num_lsps; i++) {
+			listnode_add(list, lspdb_nth(circuit->area->lspdb[level - 1], i));
+		}
+		next = i;
+
 		/*
        * Update the stop lsp_id before encoding this CSNP.
        */
-		if(listcount(list) < num_lsps) {
+		if(next == count) {
 			memset(stop, 0xff, ISIS_SYS_ID_LEN + 2);
 		} else {
-			node = listtail(list);
-			lsp = listgetdata(node);
-			memcpy(stop, lsp->lsp_header->lsp_id, ISIS_SYS_ID_LEN + 2);
+			memcpy(stop, lspdb_nth(circuit->area->lspdb[level - 1], next - 1)->lsp_header->lsp_id, ISIS_SYS_ID_LEN + 2);
 		}
 
 		retval = build_csnp(level, start, stop, list, circuit);
@@ -2317,11 +2433,11 @@ int send_csnp(struct isis_circuit *circuit, int level) {
 				zlog_dump_data(STREAM_DATA(circuit->snd_stream), stream_get_endp(circuit->snd_stream));
 			}
 		}
+		list_delete(list);
 
 		retval = circuit->tx(circuit, level);
 		if(retval != ISIS_OK) {
 			zlog_err("ISIS-Snp (%s): Send L%d CSNP on %s failed", circuit->area->area_tag, level, circuit->interface->name);
-			list_delete(list);
 			return retval;
 		}
 
@@ -2330,16 +2446,11 @@ int send_csnp(struct isis_circuit *circuit, int level) {
        * stop lsp_id in this current CSNP.
        */
 		memcpy(start, stop, ISIS_SYS_ID_LEN + 2);
-		loop = 0;
-		for(i = ISIS_SYS_ID_LEN + 1; i >= 0; --i) {
-			if(start[i] < (u_char) 0xff) {
-				start[i] += 1;
-				loop = 1;
+		for(i = ISIS_SYS_ID_LEN + 2; i-- > 0;) {
+			if(++start[i] != 0) {
 				break;
 			}
 		}
-		memset(stop, 0xff, ISIS_SYS_ID_LEN + 2);
-		list_delete(list);
 	}
 
 	return retval;
@@ -2473,31 +2584,44 @@ static int build_psnp(int level, struct isis_circuit *circuit, struct list *lsps
 /*
  *  7.3.15.4 action on expiration of partial SNP interval
  *  level 1
+ *
+ *  The entries come from the PSNP queue of the circuit. At most
+ *  PSNP_MAX_BURST PSNPs go out per run, the caller comes back after
+ *  PSNP_PACE_INTERVAL for the rest.
  */
 static int send_psnp(int level, struct isis_circuit *circuit) {
 	struct isis_lsp *lsp;
-	struct list *list = NULL;
+	struct list *list = NULL, *queue;
 	struct listnode *node;
 	u_char num_lsps;
-	int retval = ISIS_OK;
+	int burst, retval = ISIS_OK;
 
 	if(circuit->circ_type == CIRCUIT_T_BROADCAST && circuit->u.bc.is_dr[level - 1]) {
 		return ISIS_OK;
 	}
 
-	if(circuit->area->lspdb[level - 1] == NULL || dict_count(circuit->area->lspdb[level - 1]) == 0) {
+	if(lspdb_count(circuit->area->lspdb[level - 1]) == 0) {
 		return ISIS_OK;
 	}
 
-	if(!circuit->snd_stream) {
+	queue = circuit->psnp_queue[level - 1];
+	if(!circuit->snd_stream || !queue) {
 		return ISIS_ERROR;
 	}
 
 	num_lsps = max_lsps_per_snp(ISIS_SNP_PSNP_FLAG, level, circuit);
 
-	while(1) {
+	for(burst = 0; burst < PSNP_MAX_BURST; burst++) {
 		list = list_new();
-		lsp_build_list_ssn(circuit, num_lsps, list, circuit->area->lspdb[level - 1]);
+		while(listcount(list) < num_lsps && (node = listhead(queue))) {
+			lsp = listgetdata(node);
+			list_delete_node(queue, node);
+			ISIS_CLEAR_FLAG(lsp->SSNqueued, circuit);
+			/* the flag may have been cleared since */
+			if(ISIS_CHECK_FLAG(lsp->SSNflags, circuit)) {
+				listnode_add(list, lsp);
+			}
+		}
 
 		if(listcount(list) == 0) {
 			list_delete(list);
@@ -2505,34 +2629,38 @@ static int send_psnp(int level, struct isis_circuit *circuit) {
 		}
 
 		retval = build_psnp(level, circuit, list);
-		if(retval != ISIS_OK) {
+		if(retval == ISIS_OK) {
+			if(isis->debugs & DEBUG_SNP_PACKETS) {
+				zlog_debug("ISIS-Snp (%s): Sending L%d PSNP on %s, length %zd", circuit->area->area_tag, level, circuit->interface->name, stream_get_endp(circuit->snd_stream));
+				if(isis->debugs & DEBUG_PACKET_DUMP) {
+					zlog_dump_data(STREAM_DATA(circuit->snd_stream), stream_get_endp(circuit->snd_stream));
+				}
+			}
+			retval = circuit->tx(circuit, level);
+			if(retval != ISIS_OK) {
+				zlog_err("ISIS-Snp (%s): Send L%d PSNP on %s failed", circuit->area->area_tag, level, circuit->interface->name);
+			}
+		} else {
 			zlog_err("ISIS-Snp (%s): Build L%d PSNP on %s failed", circuit->area->area_tag, level, circuit->interface->name);
-			list_delete(list);
-			return retval;
 		}
 
-		if(isis->debugs & DEBUG_SNP_PACKETS) {
-			zlog_debug("ISIS-Snp (%s): Sending L%d PSNP on %s, length %zd", circuit->area->area_tag, level, circuit->interface->name, stream_get_endp(circuit->snd_stream));
-			if(isis->debugs & DEBUG_PACKET_DUMP) {
-				zlog_dump_data(STREAM_DATA(circuit->snd_stream), stream_get_endp(circuit->snd_stream));
+		for(ALL_LIST_ELEMENTS_RO(list, node, lsp)) {
+			if(retval == ISIS_OK) {
+				/*
+	       * sending succeeded, we can clear SSN flags of this circuit
+	       * for the LSPs in list
+	       */
+				ISIS_CLEAR_FLAG(lsp->SSNflags, circuit);
+			} else {
+				/* try again next time */
+				lsp_set_ssnflag(lsp, circuit);
 			}
 		}
+		list_delete(list);
 
-		retval = circuit->tx(circuit, level);
 		if(retval != ISIS_OK) {
-			zlog_err("ISIS-Snp (%s): Send L%d PSNP on %s failed", circuit->area->area_tag, level, circuit->interface->name);
-			list_delete(list);
 			return retval;
 		}
-
-		/*
-       * sending succeeded, we can clear SSN flags of this circuit
-       * for the LSPs in list
-       */
-		for(ALL_LIST_ELEMENTS_RO(list, node, lsp)) {
-			ISIS_CLEAR_FLAG(lsp->SSNflags, circuit);
-		}
-		list_delete(list);
 	}
 
 	return retval;
@@ -2549,7 +2677,11 @@ int send_l1_psnp(struct thread *thread) {
 
 	send_psnp(1, circuit);
 	/* set next timer thread */
-	THREAD_TIMER_ON(master, circuit->t_send_psnp[0], send_l1_psnp, circuit, isis_jitter(circuit->psnp_interval[0], PSNP_JITTER));
+	if(circuit->psnp_queue[0] && listcount(circuit->psnp_queue[0])) {
+		THREAD_TIMER_MSEC_ON(master, circuit->t_send_psnp[0], send_l1_psnp, circuit, PSNP_PACE_INTERVAL);
+	} else {
+		THREAD_TIMER_ON(master, circuit->t_send_psnp[0], send_l1_psnp, circuit, isis_jitter(circuit->psnp_interval[0], PSNP_JITTER));
+	}
 
 	return retval;
 }
@@ -2570,7 +2702,11 @@ int send_l2_psnp(struct thread *thread) {
 	send_psnp(2, circuit);
 
 	/* set next timer thread */
-	THREAD_TIMER_ON(master, circuit->t_send_psnp[1], send_l2_psnp, circuit, isis_jitter(circuit->psnp_interval[1], PSNP_JITTER));
+	if(circuit->psnp_queue[1] && listcount(circuit->psnp_queue[1])) {
+		THREAD_TIMER_MSEC_ON(master, circuit->t_send_psnp[1], send_l2_psnp, circuit, PSNP_PACE_INTERVAL);
+	} else {
+		THREAD_TIMER_ON(master, circuit->t_send_psnp[1], send_l2_psnp, circuit, isis_jitter(circuit->psnp_interval[1], PSNP_JITTER));
+	}
 
 	return retval;
 }
@@ -2610,6 +2746,7 @@ int send_lsp(struct thread *thread) {
    */
 	lsp = listgetdata(node);
 	list_delete_node(circuit->lsp_queue, node);
+	ISIS_CLEAR_FLAG(lsp->SRMqueued, circuit);
 
 	/* Set the last-cleared time if the queue is empty. */
 	/* TODO: Is is possible that new lsps keep being added to the queue
@@ -2654,6 +2791,7 @@ int send_lsp(struct thread *thread) {
 	}
 
 	/* copy our lsp to the send buffer */
+	lsp_set_time(lsp);
 	stream_copy(circuit->snd_stream, lsp->pdu);
 
 	if(isis->debugs & DEBUG_UPDATE_PACKETS) {
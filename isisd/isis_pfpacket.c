@@ -23,14 +23,17 @@
 #include <zebra.h>
 #if ISIS_METHOD == ISIS_METHOD_PFPACKET
 	#include <net/ethernet.h> /* the L2 protocols */
-	#include <netpacket/packet.h>
+	#include <linux/if_packet.h>
+	#include <linux/filter.h>
+	#include <sys/mman.h>
 
 	#include "log.h"
 	#include "network.h"
 	#include "stream.h"
 	#include "if.h"
+	#include "thread.h"
+	#include "memory.h"
 
-	#include "isisd/dict.h"
 	#include "isisd/include-netbsd/iso.h"
 	#include "isisd/isis_constants.h"
 	#include "isisd/isis_common.h"
@@ -58,6 +61,287 @@ u_char ALL_ESS[6] = { 0x09, 0x00, 0x2B, 0x00, 0x00, 0x04 };
 static uint8_t discard_buff[8192];
 static uint8_t sock_buff[8192];
 
+/* Only IS-IS frames get as far as the socket: on a LAN those with the
+ * ISO LLC header, SOCK_DGRAM handing the filter the frame from there,
+ * and on a p2p link, ISO over GRE.  Our own outgoing frames neither. */
+static struct sock_filter isis_bcast_filter[] = {
+	BPF_STMT(BPF_LD | BPF_B | BPF_ABS, SKF_AD_OFF + SKF_AD_PKTTYPE),
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, PACKET_OUTGOING, 5, 0),
+	BPF_STMT(BPF_LD | BPF_H | BPF_ABS, 0),
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, (ISO_SAP << 8) | ISO_SAP, 0, 3),
+	BPF_STMT(BPF_LD | BPF_B | BPF_ABS, 2),
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 0x03, 0, 1),
+	BPF_STMT(BPF_RET | BPF_K, 0xffff),
+	BPF_STMT(BPF_RET | BPF_K, 0),
+};
+
+static struct sock_filter isis_p2p_filter[] = {
+	BPF_STMT(BPF_LD | BPF_B | BPF_ABS, SKF_AD_OFF + SKF_AD_PKTTYPE),
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, PACKET_OUTGOING, 3, 0),
+	BPF_STMT(BPF_LD | BPF_H | BPF_ABS, SKF_AD_OFF + SKF_AD_PROTOCOL),
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 0x00FE, 0, 1),
+	BPF_STMT(BPF_RET | BPF_K, 0xffff),
+	BPF_STMT(BPF_RET | BPF_K, 0),
+};
+
+static inline int llc_check(u_char *llc) {
+	if(*llc != ISO_SAP || *(llc + 1) != ISO_SAP || *(llc + 2) != 3) {
+		return 0;
+	}
+
+	return 1;
+}
+
+	#ifdef TPACKET3_HDRLEN
+/*
+ * On a LAN, PDUs come in through a TPACKET_V3 ring mapped from the
+ * kernel, one block of them per wakeup rather than two recvfrom()s
+ * each, and go out through a ring of frames sent by one sendto() at
+ * the end of the thread callback that queued them.  If the kernel will
+ * not give us the rings, the socket is read and written as before.
+ */
+		#define ISIS_RX_BLOCK_SIZE (1 << 16)
+		#define ISIS_RX_BLOCK_NR 16
+		#define ISIS_RX_BLOCK_TOV 4 /* msecs before a part filled block is ours */
+		#define ISIS_TX_BLOCK_SIZE (1 << 16)
+		#define ISIS_TX_BLOCK_NR 2
+		#define ISIS_FRAME_SIZE 2048
+		/* where frame data starts, without PACKET_TX_HAS_OFF */
+		#define ISIS_TX_DATA (TPACKET3_HDRLEN - sizeof(struct sockaddr_ll))
+
+struct isis_pfring {
+	u_char *map;
+	size_t map_size;
+
+	unsigned int rx_block;	     /* the block in hand, or to look at next */
+	int rx_held;		     /* the block in hand is ours */
+	struct tpacket3_hdr *rx_pkt; /* its next packet */
+	unsigned int rx_left;	     /* and how many are left */
+
+	u_char *tx_map; /* NULL for no tx ring */
+	unsigned int tx_frame_nr;
+	unsigned int tx_frame;	 /* next frame to fill */
+	unsigned int tx_queued;	 /* frames filled, not yet sent */
+	struct sockaddr_ll tx_sa; /* where they go */
+	struct thread *t_kick;
+};
+
+static struct tpacket_block_desc *isis_pfring_block(struct isis_pfring *ring, unsigned int block) {
+	return (struct tpacket_block_desc *) (ring->map + block * ISIS_RX_BLOCK_SIZE);
+}
+
+static void isis_pfring_open(struct isis_circuit *circuit) {
+	struct isis_pfring *ring;
+	struct tpacket_req3 rx, tx;
+	int version = TPACKET_V3, one = 1;
+	u_char *map;
+	size_t rx_size, tx_size = 0;
+
+	if(setsockopt(circuit->fd, SOL_PACKET, PACKET_VERSION, &version, sizeof(version)) < 0) {
+		return;
+	}
+
+	memset(&rx, 0, sizeof(rx));
+	rx.tp_block_size = ISIS_RX_BLOCK_SIZE;
+	rx.tp_block_nr = ISIS_RX_BLOCK_NR;
+	rx.tp_frame_size = ISIS_FRAME_SIZE;
+	rx.tp_frame_nr = ISIS_RX_BLOCK_SIZE / ISIS_FRAME_SIZE * ISIS_RX_BLOCK_NR;
+	rx.tp_retire_blk_tov = ISIS_RX_BLOCK_TOV;
+	if(setsockopt(circuit->fd, SOL_PACKET, PACKET_RX_RING, &rx, sizeof(rx)) < 0) {
+		zlog_warn("%s: no rx ring on %s, reading the socket: %s", __func__, circuit->interface->name, safe_strerror(errno));
+		return;
+	}
+	rx_size = ISIS_RX_BLOCK_SIZE * ISIS_RX_BLOCK_NR;
+
+	/* The kernels with V3 rx and not tx just keep to sendmsg(), and a
+	 * frame the kernel will not send is dropped rather than stop it. */
+	memset(&tx, 0, sizeof(tx));
+	tx.tp_block_size = ISIS_TX_BLOCK_SIZE;
+	tx.tp_block_nr = ISIS_TX_BLOCK_NR;
+	tx.tp_frame_size = ISIS_FRAME_SIZE;
+	tx.tp_frame_nr = ISIS_TX_BLOCK_SIZE / ISIS_FRAME_SIZE * ISIS_TX_BLOCK_NR;
+	if(setsockopt(circuit->fd, SOL_PACKET, PACKET_LOSS, &one, sizeof(one)) == 0 && setsockopt(circuit->fd, SOL_PACKET, PACKET_TX_RING, &tx, sizeof(tx)) == 0) {
+		tx_size = ISIS_TX_BLOCK_SIZE * ISIS_TX_BLOCK_NR;
+	}
+
+	map = mmap(NULL, rx_size + tx_size, PROT_READ | PROT_WRITE, MAP_SHARED, circuit->fd, 0);
+	if(map == MAP_FAILED) {
+		zlog_warn("%s: could not map the rings of %s: %s", __func__, circuit->interface->name, safe_strerror(errno));
+		memset(&rx, 0, sizeof(rx));
+		setsockopt(circuit->fd, SOL_PACKET, PACKET_RX_RING, &rx, sizeof(rx));
+		if(tx_size) {
+			setsockopt(circuit->fd, SOL_PACKET, PACKET_TX_RING, &rx, sizeof(rx));
+		}
+		return;
+	}
+
+	ring = XCALLOC(MTYPE_ISIS_PFRING, sizeof(struct isis_pfring));
+	ring->map = map;
+	ring->map_size = rx_size + tx_size;
+	if(tx_size) {
+		ring->tx_map = map + rx_size;
+		ring->tx_frame_nr = tx.tp_frame_nr;
+	}
+	circuit->pfring = ring;
+}
+
+/* The next packet in the ring, NULL for none yet */
+static struct tpacket3_hdr *isis_pfring_next(struct isis_pfring *ring) {
+	struct tpacket_block_desc *bd;
+	struct tpacket3_hdr *pkt;
+
+	while(!ring->rx_held || !ring->rx_left) {
+		if(ring->rx_held) {
+			/* done with it, back to the kernel */
+			__sync_synchronize();
+			isis_pfring_block(ring, ring->rx_block)->hdr.bh1.block_status = TP_STATUS_KERNEL;
+			ring->rx_held = 0;
+			ring->rx_block = (ring->rx_block + 1) % ISIS_RX_BLOCK_NR;
+		}
+		bd = isis_pfring_block(ring, ring->rx_block);
+		if(!(bd->hdr.bh1.block_status & TP_STATUS_USER)) {
+			return NULL;
+		}
+		__sync_synchronize();
+		ring->rx_held = 1;
+		ring->rx_left = bd->hdr.bh1.num_pkts;
+		ring->rx_pkt = (struct tpacket3_hdr *) ((u_char *) bd + bd->hdr.bh1.offset_to_first_pkt);
+	}
+
+	pkt = ring->rx_pkt;
+	ring->rx_left--;
+	ring->rx_pkt = (struct tpacket3_hdr *) ((u_char *) pkt + pkt->tp_next_offset);
+	return pkt;
+}
+
+static int isis_pfring_pending(struct isis_circuit *circuit) {
+	struct isis_pfring *ring = circuit->pfring;
+	unsigned int block = ring->rx_block;
+
+	if(ring->rx_held) {
+		if(ring->rx_left) {
+			return 1;
+		}
+		block = (block + 1) % ISIS_RX_BLOCK_NR;
+	}
+	return (isis_pfring_block(ring, block)->hdr.bh1.block_status & TP_STATUS_USER) != 0;
+}
+
+static int isis_recv_pdu_ring(struct isis_circuit *circuit, u_char *ssnpa) {
+	struct isis_pfring *ring = circuit->pfring;
+	struct tpacket3_hdr *pkt;
+	struct sockaddr_ll *sll;
+	u_char *data;
+	int retval = ISIS_WARNING;
+
+	pkt = isis_pfring_next(ring);
+	if(!pkt) {
+		return ISIS_WARNING;
+	}
+	sll = (struct sockaddr_ll *) ((u_char *) pkt + TPACKET_ALIGN(sizeof(struct tpacket3_hdr)));
+	data = (u_char *) pkt + pkt->tp_net;
+
+	/* the filter did most of this */
+	if(pkt->tp_snaplen >= LLC_LEN && llc_check(data) && sll->sll_pkttype != PACKET_OUTGOING && pkt->tp_snaplen - LLC_LEN <= STREAM_WRITEABLE(circuit->rcv_stream)) {
+		stream_write(circuit->rcv_stream, data + LLC_LEN, pkt->tp_snaplen - LLC_LEN);
+		memcpy(ssnpa, &sll->sll_addr, MIN(sll->sll_halen, ETH_ALEN));
+		retval = ISIS_OK;
+	}
+
+	/* copied out, so the block can go back if that was its last */
+	if(!ring->rx_left) {
+		isis_pfring_next(ring);
+	}
+	return retval;
+}
+
+/* Send what the callbacks queued since the last time */
+static void isis_pfring_flush(struct isis_circuit *circuit) {
+	struct isis_pfring *ring = circuit->pfring;
+
+	if(!ring->tx_queued) {
+		return;
+	}
+	ring->tx_queued = 0;
+	if(sendto(circuit->fd, NULL, 0, MSG_DONTWAIT, (struct sockaddr *) &ring->tx_sa, sizeof(struct sockaddr_ll)) < 0 && !ERRNO_IO_RETRY(errno)) {
+		zlog_warn("IS-IS pfpacket: could not transmit packets on %s: %s", circuit->interface->name, safe_strerror(errno));
+	}
+}
+
+static int isis_pfring_kick(struct thread *thread) {
+	struct isis_circuit *circuit = THREAD_ARG(thread);
+
+	circuit->pfring->t_kick = NULL;
+	isis_pfring_flush(circuit);
+	return 0;
+}
+
+static int isis_send_pdu_ring(struct isis_circuit *circuit, int level) {
+	struct isis_pfring *ring = circuit->pfring;
+	struct tpacket3_hdr *hdr;
+	size_t len = stream_get_endp(circuit->snd_stream);
+	u_char *dst;
+
+	/* RFC5309 section 4.1 recommends ALL_ISS */
+	if(circuit->circ_type == CIRCUIT_T_P2P) {
+		dst = ALL_ISS;
+	} else if(level == 1) {
+		dst = ALL_L1_ISS;
+	} else {
+		dst = ALL_L2_ISS;
+	}
+
+	/* one sendto() has one destination */
+	if(ring->tx_queued && memcmp(ring->tx_sa.sll_addr, dst, ETH_ALEN)) {
+		isis_pfring_flush(circuit);
+	}
+
+	hdr = (struct tpacket3_hdr *) (ring->tx_map + ring->tx_frame * ISIS_FRAME_SIZE);
+	if(hdr->tp_status != TP_STATUS_AVAILABLE) {
+		isis_pfring_flush(circuit);
+	}
+	if(hdr->tp_status != TP_STATUS_AVAILABLE || LLC_LEN + len > ISIS_FRAME_SIZE - ISIS_TX_DATA) {
+		return isis_send_pdu_bcast(circuit, level);
+	}
+
+	if(!ring->tx_queued) {
+		memset(&ring->tx_sa, 0, sizeof(struct sockaddr_ll));
+		ring->tx_sa.sll_family = AF_PACKET;
+		/* the kernel puts each frame's length in the 802.3 header */
+		ring->tx_sa.sll_protocol = htons(ETH_P_802_2);
+		ring->tx_sa.sll_ifindex = circuit->interface->ifindex;
+		ring->tx_sa.sll_halen = ETH_ALEN;
+		memcpy(ring->tx_sa.sll_addr, dst, ETH_ALEN);
+	}
+
+	((u_char *) hdr)[ISIS_TX_DATA] = ISO_SAP;
+	((u_char *) hdr)[ISIS_TX_DATA + 1] = ISO_SAP;
+	((u_char *) hdr)[ISIS_TX_DATA + 2] = 0x03;
+	memcpy((u_char *) hdr + ISIS_TX_DATA + LLC_LEN, circuit->snd_stream->data, len);
+	hdr->tp_len = LLC_LEN + len;
+	hdr->tp_next_offset = 0;
+	__sync_synchronize();
+	hdr->tp_status = TP_STATUS_SEND_REQUEST;
+
+	ring->tx_frame = (ring->tx_frame + 1) % ring->tx_frame_nr;
+	ring->tx_queued++;
+	if(!ring->t_kick) {
+		ring->t_kick = thread_add_event(master, isis_pfring_kick, circuit, 0);
+	}
+	return ISIS_OK;
+}
+
+static void isis_pfring_close(struct isis_circuit *circuit) {
+	struct isis_pfring *ring = circuit->pfring;
+
+	THREAD_OFF(ring->t_kick);
+	isis_pfring_flush(circuit);
+	munmap(ring->map, ring->map_size);
+	XFREE(MTYPE_ISIS_PFRING, ring);
+	circuit->pfring = NULL;
+}
+	#endif /* TPACKET3_HDRLEN */
+
 /*
  * if level is 0 we are joining p2p multicast
  * FIXME: and the p2p multicast being ???
@@ -124,6 +408,20 @@ static int open_packet_socket(struct isis_circuit *circuit) {
 
 	circuit->fd = fd;
 
+	if(if_is_broadcast(circuit->interface)) {
+		struct sock_fprog prog = { .len = array_size(isis_bcast_filter), .filter = isis_bcast_filter };
+
+		if(setsockopt(fd, SOL_SOCKET, SO_ATTACH_FILTER, &prog, sizeof(prog)) < 0) {
+			zlog_warn("open_packet_socket(): could not attach filter: %s", safe_strerror(errno));
+		}
+	} else {
+		struct sock_fprog prog = { .len = array_size(isis_p2p_filter), .filter = isis_p2p_filter };
+
+		if(setsockopt(fd, SOL_SOCKET, SO_ATTACH_FILTER, &prog, sizeof(prog)) < 0) {
+			zlog_warn("open_packet_socket(): could not attach filter: %s", safe_strerror(errno));
+		}
+	}
+
 	if(if_is_broadcast(circuit->interface)) {
 		/*
        * Join to multicast groups
@@ -162,9 +460,20 @@ int isis_sock_init(struct isis_circuit *circuit) {
 	}
 
 	/* Assign Rx and Tx callbacks are based on real if type */
+	circuit->rx_pending = NULL;
 	if(if_is_broadcast(circuit->interface)) {
 		circuit->tx = isis_send_pdu_bcast;
 		circuit->rx = isis_recv_pdu_bcast;
+	#ifdef TPACKET3_HDRLEN
+		isis_pfring_open(circuit);
+		if(circuit->pfring) {
+			circuit->rx = isis_recv_pdu_ring;
+			circuit->rx_pending = isis_pfring_pending;
+			if(circuit->pfring->tx_map) {
+				circuit->tx = isis_send_pdu_ring;
+			}
+		}
+	#endif /* TPACKET3_HDRLEN */
 	} else if(if_is_pointopoint(circuit->interface)) {
 		circuit->tx = isis_send_pdu_p2p;
 		circuit->rx = isis_recv_pdu_p2p;
@@ -182,12 +491,15 @@ end:
 	return retval;
 }
 
-static inline int llc_check(u_char *llc) {
-	if(*llc != ISO_SAP || *(llc + 1) != ISO_SAP || *(llc + 2) != 3) {
-		return 0;
+void isis_sock_close(struct isis_circuit *circuit) {
+	#ifdef TPACKET3_HDRLEN
+	if(circuit->pfring) {
+		isis_pfring_close(circuit);
 	}
-
-	return 1;
+	#endif /* TPACKET3_HDRLEN */
+	circuit->rx_pending = NULL;
+	close(circuit->fd);
+	circuit->fd = 0;
 }
 
 int isis_recv_pdu_bcast(struct isis_circuit *circuit, u_char *ssnpa) {
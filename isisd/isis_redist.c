@@ -31,7 +31,6 @@
 #include "table.h"
 #include "vty.h"
 
-#include "isisd/dict.h"
 #include "isisd/isis_constants.h"
 #include "isisd/isis_common.h"
 #include "isisd/isis_flags.h"
@@ -102,6 +101,35 @@ static void isis_redist_route_node_destroy(route_table_delegate_t *delegate, str
 
 static route_table_delegate_t isis_redist_rt_delegate = { .create_node = isis_redist_route_node_create, .destroy_node = isis_redist_route_node_destroy };
 
+static int isis_redist_batch_timer(struct thread *thread) {
+	struct isis_area *area = THREAD_ARG(thread);
+	int level = area->redist_pending;
+
+	area->t_redist = NULL;
+	area->redist_pending = 0;
+	area->redist_batches++;
+	lsp_regenerate_schedule(area, level, 0);
+	return 0;
+}
+
+/* External reachability of a level changed.  The LSPs are regenerated
+ * once the redistribute-delay is over, with whatever else changed by
+ * then, rather than on the first of many routes zebra sends. */
+static void isis_redist_schedule(struct isis_area *area, int level) {
+	area->redist_changes++;
+	if(area->t_redist) {
+		area->redist_coalesced++;
+		area->redist_pending |= level;
+		return;
+	}
+	if(!area->redist_delay) {
+		lsp_regenerate_schedule(area, level, 0);
+		return;
+	}
+	area->redist_pending = level;
+	THREAD_TIMER_MSEC_ON(master, area->t_redist, isis_redist_batch_timer, area, area->redist_delay);
+}
+
 /* Install external reachability information into a
  * specific area for a specific level.
  * Schedule an lsp regenerate if necessary */
@@ -132,7 +160,7 @@ static void isis_redist_install(struct isis_area *area, int level, struct prefix
 	}
 
 	memcpy(er_node->info, info, sizeof(*info));
-	lsp_regenerate_schedule(area, level, 0);
+	isis_redist_schedule(area, level);
 }
 
 /* Remove external reachability information from a
@@ -165,7 +193,7 @@ static void isis_redist_uninstall(struct isis_area *area, int level, struct pref
 
 	XFREE(MTYPE_ISIS, er_node->info);
 	route_unlock_node(er_node);
-	lsp_regenerate_schedule(area, level, 0);
+	isis_redist_schedule(area, level);
 }
 
 /* Update external reachability info of area for a given level
@@ -241,10 +269,12 @@ void isis_redist_add(int type, struct prefix *p, u_char distance, uint32_t metri
 	int level;
 	struct isis_redist *redist;
 
-	char debug_buf[BUFSIZ];
-	prefix2str(p, debug_buf, sizeof(debug_buf));
+	if(isis->debugs & DEBUG_ZEBRA) {
+		char debug_buf[BUFSIZ];
+		prefix2str(p, debug_buf, sizeof(debug_buf));
 
-	zlog_debug("%s: New route %s from %s.", __func__, debug_buf, zebra_route_string(type));
+		zlog_debug("%s: New route %s from %s.", __func__, debug_buf, zebra_route_string(type));
+	}
 
 	if(!ei_table) {
 		zlog_warn("%s: External information table not initialized.", __func__);
@@ -288,10 +318,12 @@ void isis_redist_delete(int type, struct prefix *p) {
 	int level;
 	struct isis_redist *redist;
 
-	char debug_buf[BUFSIZ];
-	prefix2str(p, debug_buf, sizeof(debug_buf));
+	if(isis->debugs & DEBUG_ZEBRA) {
+		char debug_buf[BUFSIZ];
+		prefix2str(p, debug_buf, sizeof(debug_buf));
 
-	zlog_debug("%s: Removing route %s from %s.", __func__, debug_buf, zebra_route_string(type));
+		zlog_debug("%s: Removing route %s from %s.", __func__, debug_buf, zebra_route_string(type));
+	}
 
 	if(is_default(p)) {
 		/* Don't remove default route but add synthetic route for use
@@ -323,7 +355,7 @@ void isis_redist_delete(int type, struct prefix *p) {
 	route_unlock_node(ei_node);
 
 	for(ALL_LIST_ELEMENTS_RO(isis->area_list, node, area)) {
-		for(level = 1; level < ISIS_LEVELS; level++) {
+		for(level = 1; level <= ISIS_LEVELS; level++) {
 			redist = get_redist_settings(area, family, type, level);
 			if(!redist->redist) {
 				continue;
@@ -496,6 +528,7 @@ void isis_redist_area_finish(struct isis_area *area) {
 			route_table_finish(area->ext_reach[protocol][level]);
 		}
 	}
+	THREAD_TIMER_OFF(area->t_redist);
 
 	isis_redist_update_zebra_subscriptions(area->isis);
 }
@@ -708,6 +741,26 @@ DEFUN(no_isis_default_originate, no_isis_default_originate_cmd, "no default-info
 	return 0;
 }
 
+DEFUN(isis_redistribute_delay, isis_redistribute_delay_cmd, "redistribute-delay <0-10000>",
+      "Delay before redistributed routes are put in LSPs\n"
+      "Delay in milliseconds, 0 to regenerate on the first change\n") {
+	struct isis_area *area = vty->index;
+
+	area->redist_delay = strtoul(argv[0], NULL, 10);
+	return CMD_SUCCESS;
+}
+
+DEFUN(no_isis_redistribute_delay, no_isis_redistribute_delay_cmd, "no redistribute-delay", NO_STR "Delay before redistributed routes are put in LSPs\n") {
+	struct isis_area *area = vty->index;
+
+	area->redist_delay = DEFAULT_REDIST_DELAY;
+	return CMD_SUCCESS;
+}
+
+ALIAS(no_isis_redistribute_delay, no_isis_redistribute_delay_arg_cmd, "no redistribute-delay <0-10000>",
+      NO_STR "Delay before redistributed routes are put in LSPs\n"
+	     "Delay in milliseconds, 0 to regenerate on the first change\n")
+
 int isis_redist_config_write(struct vty *vty, struct isis_area *area, int family) {
 	int type;
 	int level;
@@ -772,4 +825,7 @@ void isis_redist_init(void) {
 	install_element(ISIS_NODE, &no_isis_redistribute_cmd);
 	install_element(ISIS_NODE, &isis_default_originate_cmd);
 	install_element(ISIS_NODE, &no_isis_default_originate_cmd);
+	install_element(ISIS_NODE, &isis_redistribute_delay_cmd);
+	install_element(ISIS_NODE, &no_isis_redistribute_delay_cmd);
+	install_element(ISIS_NODE, &no_isis_redistribute_delay_arg_cmd);
 }
@@ -31,13 +31,15 @@
 #include "memory.h"
 #include "prefix.h"
 #include "hash.h"
+#include "jhash.h"
 #include "if.h"
 #include "table.h"
+#include "workpool.h"
+#include "trace.h"
 
 #include "isis_constants.h"
 #include "isis_common.h"
 #include "isis_flags.h"
-#include "dict.h"
 #include "isisd.h"
 #include "isis_misc.h"
 #include "isis_adjacency.h"
@@ -53,6 +55,56 @@
 int isis_run_spf_l1(struct thread *thread);
 int isis_run_spf_l2(struct thread *thread);
 
+/*
+ * A full SPF run, in the three steps isis_spf_run_scheduled() takes the
+ * due trees of an area through: prepared and finished on the main
+ * thread, the SPT worked out in between by the SPF threads, where there
+ * are some and more than one tree to go.  The trees only read the
+ * lspdbs, which stay as they are while the main thread waits for them,
+ * and the routes are added tree by tree once all are in.
+ */
+struct isis_spf_job {
+	struct isis_spftree *spftree;
+	int level;
+	int family;
+	u_char *sysid;
+	int retval;
+	int ready;    /* TENT preloaded, there's a tree to work out */
+	int threaded; /* on an SPF thread: no zlog, see workpool.h */
+	unsigned long long start_time;
+
+	/* the first warning of the run, logged once finished */
+	unsigned int warnings;
+	const char *warning;
+	int warning_has_id;
+	u_char warning_id[ISIS_SYS_ID_LEN + 2];
+};
+
+static struct work_pool *isis_spf_pool;
+
+/* Log a warning of a run, with the LSP ID if given, or keep it for
+ * later if that is on an SPF thread. */
+static void isis_spf_warn(struct isis_spftree *spftree, const char *msg, u_char *lsp_id) {
+	struct isis_spf_job *job = spftree->job;
+
+	if(job && job->threaded) {
+		if(job->warnings++ == 0) {
+			job->warning = msg;
+			job->warning_has_id = lsp_id != NULL;
+			if(lsp_id) {
+				memcpy(job->warning_id, lsp_id, ISIS_SYS_ID_LEN + 2);
+			}
+		}
+		return;
+	}
+
+	if(lsp_id) {
+		zlog_warn("%s %s", msg, rawlspid_print(lsp_id));
+	} else {
+		zlog_warn("%s", msg);
+	}
+}
+
 /* 7.2.7 */
 static void remove_excess_adjs(struct list *adjs) {
 	struct listnode *node, *excess = NULL;
@@ -148,11 +200,7 @@ static const char *vid2string(struct isis_vertex *vertex, u_char *buff) {
 	return (char *) buff;
 }
 
-static struct isis_vertex *isis_vertex_new(void *id, enum vertextype vtype) {
-	struct isis_vertex *vertex;
-
-	vertex = XCALLOC(MTYPE_ISIS_VERTEX, sizeof(struct isis_vertex));
-
+static void isis_vertex_id_init(struct isis_vertex *vertex, void *id, enum vertextype vtype) {
 	vertex->type = vtype;
 	switch(vtype) {
 		case VTYPE_ES:
@@ -171,24 +219,49 @@ static struct isis_vertex *isis_vertex_new(void *id, enum vertextype vtype) {
 			break;
 		default: zlog_err("WTF!");
 	}
+}
 
+static int isis_vertex_match(struct isis_vertex *vertex, void *id, enum vertextype vtype);
+
+/* vertices on TENT and PATHS are indexed by type and id */
+static unsigned int isis_vertex_hash_key(void *arg) {
+	struct isis_vertex *vertex = arg;
+
+	switch(vertex->type) {
+		case VTYPE_ES:
+		case VTYPE_NONPSEUDO_IS:
+		case VTYPE_NONPSEUDO_TE_IS: return jhash(vertex->N.id, ISIS_SYS_ID_LEN, vertex->type);
+		case VTYPE_PSEUDO_IS:
+		case VTYPE_PSEUDO_TE_IS: return jhash(vertex->N.id, ISIS_SYS_ID_LEN + 1, vertex->type);
+		default: return jhash(&vertex->N.prefix.u.prefix, PSIZE(vertex->N.prefix.prefixlen), (vertex->type << 16) | (vertex->N.prefix.family << 8) | vertex->N.prefix.prefixlen);
+	}
+}
+
+static int isis_vertex_hash_cmp(const void *arg1, const void *arg2) {
+	const struct isis_vertex *vertex = arg2;
+
+	return isis_vertex_match((struct isis_vertex *) arg1, (void *) &vertex->N, vertex->type);
+}
+
+static struct isis_vertex *isis_vertex_new(struct isis_spftree *spftree, void *id, enum vertextype vtype) {
+	struct isis_vertex *vertex;
+
+	vertex = spf_pool_get(spftree->pool);
+	isis_vertex_id_init(vertex, id, vtype);
 	vertex->Adj_N = list_new();
-	vertex->parents = list_new();
-	vertex->children = list_new();
+	hash_get(spftree->vertex_hash, vertex, hash_alloc_intern);
 
 	return vertex;
 }
 
-static void isis_vertex_del(struct isis_vertex *vertex) {
+static void isis_vertex_del(struct isis_spftree *spftree, struct isis_vertex *vertex) {
+	hash_release(spftree->vertex_hash, vertex);
 	list_delete(vertex->Adj_N);
 	vertex->Adj_N = NULL;
-	list_delete(vertex->parents);
-	vertex->parents = NULL;
-	list_delete(vertex->children);
-	vertex->children = NULL;
+	spf_array_free(&vertex->parents);
+	spf_array_free(&vertex->children);
 
-	memset(vertex, 0, sizeof(struct isis_vertex));
-	XFREE(MTYPE_ISIS_VERTEX, vertex);
+	spf_pool_put(spftree->pool, vertex);
 
 	return;
 }
@@ -216,8 +289,10 @@ struct isis_spftree *isis_spftree_new(struct isis_area *area) {
 		return NULL;
 	}
 
-	tree->tents = list_new();
-	tree->paths = list_new();
+	tree->tents = spf_heap_new();
+	TAILQ_INIT(&tree->paths);
+	tree->pool = spf_pool_new(sizeof(struct isis_vertex), MTYPE_ISIS_VERTEX);
+	tree->vertex_hash = hash_create_open(isis_vertex_hash_key, isis_vertex_hash_cmp);
 	tree->area = area;
 	tree->last_run_timestamp = 0;
 	tree->last_run_duration = 0;
@@ -226,16 +301,18 @@ struct isis_spftree *isis_spftree_new(struct isis_area *area) {
 	return tree;
 }
 
+static void init_spt(struct isis_spftree *spftree);
+
 void isis_spftree_del(struct isis_spftree *spftree) {
 	THREAD_TIMER_OFF(spftree->t_spf);
 
-	spftree->tents->del = (void (*)(void *)) isis_vertex_del;
-	list_delete(spftree->tents);
+	init_spt(spftree);
+	spf_heap_free(spftree->tents);
 	spftree->tents = NULL;
-
-	spftree->paths->del = (void (*)(void *)) isis_vertex_del;
-	list_delete(spftree->paths);
-	spftree->paths = NULL;
+	spf_pool_free(spftree->pool);
+	spftree->pool = NULL;
+	hash_free(spftree->vertex_hash);
+	spftree->vertex_hash = NULL;
 
 	XFREE(MTYPE_ISIS_SPFTREE, spftree);
 
@@ -243,15 +320,16 @@ void isis_spftree_del(struct isis_spftree *spftree) {
 }
 
 void isis_spftree_adj_del(struct isis_spftree *spftree, struct isis_adjacency *adj) {
-	struct listnode *node;
+	struct isis_vertex *vertex;
+	unsigned int i;
 	if(!adj) {
 		return;
 	}
-	for(node = listhead(spftree->tents); node; node = listnextnode(node)) {
-		isis_vertex_adj_del(listgetdata(node), adj);
+	for(i = 0; i < spf_heap_count(spftree->tents); i++) {
+		isis_vertex_adj_del(spf_heap_item(spftree->tents, i), adj);
 	}
-	for(node = listhead(spftree->paths); node; node = listnextnode(node)) {
-		isis_vertex_adj_del(listgetdata(node), adj);
+	TAILQ_FOREACH(vertex, &spftree->paths, path_entry) {
+		isis_vertex_adj_del(vertex, adj);
 	}
 	return;
 }
@@ -372,12 +450,13 @@ static struct isis_vertex *isis_spf_add_root(struct isis_spftree *spftree, int l
 	}
 
 	if(!spftree->area->oldmetric) {
-		vertex = isis_vertex_new(sysid, VTYPE_NONPSEUDO_TE_IS);
+		vertex = isis_vertex_new(spftree, sysid, VTYPE_NONPSEUDO_TE_IS);
 	} else {
-		vertex = isis_vertex_new(sysid, VTYPE_NONPSEUDO_IS);
+		vertex = isis_vertex_new(spftree, sysid, VTYPE_NONPSEUDO_IS);
 	}
 
-	listnode_add(spftree->paths, vertex);
+	TAILQ_INSERT_TAIL(&spftree->paths, vertex, path_entry);
+	vertex->on_paths = 1;
 
 #ifdef EXTREME_DEBUG
 	zlog_debug("ISIS-Spf: added this IS  %s %s depth %d dist %d to PATHS", vtype2string(vertex->type), vid2string(vertex, buff), vertex->depth, vertex->d_N);
@@ -386,69 +465,71 @@ static struct isis_vertex *isis_spf_add_root(struct isis_spftree *spftree, int l
 	return vertex;
 }
 
-static struct isis_vertex *isis_find_vertex(struct list *list, void *id, enum vertextype vtype) {
-	struct listnode *node;
-	struct isis_vertex *vertex;
+static int isis_vertex_match(struct isis_vertex *vertex, void *id, enum vertextype vtype) {
 	struct prefix *p1, *p2;
 
-	for(ALL_LIST_ELEMENTS_RO(list, node, vertex)) {
-		if(vertex->type != vtype) {
-			continue;
-		}
-		switch(vtype) {
-			case VTYPE_ES:
-			case VTYPE_NONPSEUDO_IS:
-			case VTYPE_NONPSEUDO_TE_IS:
-				if(memcmp((u_char *) id, vertex->N.id, ISIS_SYS_ID_LEN) == 0) {
-					return vertex;
-				}
-				break;
-			case VTYPE_PSEUDO_IS:
-			case VTYPE_PSEUDO_TE_IS:
-				if(memcmp((u_char *) id, vertex->N.id, ISIS_SYS_ID_LEN + 1) == 0) {
-					return vertex;
-				}
-				break;
-			case VTYPE_IPREACH_INTERNAL:
-			case VTYPE_IPREACH_EXTERNAL:
-			case VTYPE_IPREACH_TE:
+	if(vertex->type != vtype) {
+		return 0;
+	}
+	switch(vtype) {
+		case VTYPE_ES:
+		case VTYPE_NONPSEUDO_IS:
+		case VTYPE_NONPSEUDO_TE_IS: return memcmp((u_char *) id, vertex->N.id, ISIS_SYS_ID_LEN) == 0;
+		case VTYPE_PSEUDO_IS:
+		case VTYPE_PSEUDO_TE_IS: return memcmp((u_char *) id, vertex->N.id, ISIS_SYS_ID_LEN + 1) == 0;
+		case VTYPE_IPREACH_INTERNAL:
+		case VTYPE_IPREACH_EXTERNAL:
+		case VTYPE_IPREACH_TE:
 #ifdef HAVE_IPV6
-			case VTYPE_IP6REACH_INTERNAL:
-			case VTYPE_IP6REACH_EXTERNAL:
+		case VTYPE_IP6REACH_INTERNAL:
+		case VTYPE_IP6REACH_EXTERNAL:
 #endif /* HAVE_IPV6 */
-				p1 = (struct prefix *) id;
-				p2 = (struct prefix *) &vertex->N.id;
-				if(p1->family == p2->family && p1->prefixlen == p2->prefixlen && memcmp(&p1->u.prefix, &p2->u.prefix, PSIZE(p1->prefixlen)) == 0) {
-					return vertex;
-				}
-				break;
-		}
+			p1 = (struct prefix *) id;
+			p2 = (struct prefix *) &vertex->N.id;
+			return p1->family == p2->family && p1->prefixlen == p2->prefixlen && memcmp(&p1->u.prefix, &p2->u.prefix, PSIZE(p1->prefixlen)) == 0;
 	}
 
-	return NULL;
+	return 0;
+}
+
+static struct isis_vertex *isis_lookup_vertex(struct isis_spftree *spftree, void *id, enum vertextype vtype) {
+	struct isis_vertex key;
+
+	isis_vertex_id_init(&key, id, vtype);
+	return hash_lookup(spftree->vertex_hash, &key);
+}
+
+static struct isis_vertex *isis_find_vertex(struct isis_spftree *spftree, void *id, enum vertextype vtype) {
+	struct isis_vertex *vertex;
+
+	vertex = isis_lookup_vertex(spftree, id, vtype);
+	return (vertex && vertex->on_paths) ? vertex : NULL;
+}
+
+static struct isis_vertex *isis_find_tent(struct isis_spftree *spftree, void *id, enum vertextype vtype) {
+	struct isis_vertex *vertex;
+
+	vertex = isis_lookup_vertex(spftree, id, vtype);
+	return (vertex && !vertex->on_paths) ? vertex : NULL;
 }
 
 /*
- * Add a vertex to TENT sorted by cost and by vertextype on tie break situation
+ * Sorted by cost and by vertextype on tie break situation, then in the
+ * order added
  */
-static struct isis_vertex *isis_spf_add2tent(struct isis_spftree *spftree, enum vertextype vtype, void *id, uint32_t cost, int depth, int family, struct isis_adjacency *adj, struct isis_vertex *parent) {
-	struct isis_vertex *vertex, *v;
+static u_int64_t isis_tent_key(struct isis_spftree *spftree, struct isis_vertex *vertex) {
+	return ((u_int64_t) vertex->d_N << 32) | ((u_int64_t) vertex->type << 24) | (spftree->tent_seq++ & 0xffffff);
+}
+
+/* Reach the vertex from parent, or from adj for the neighbors of the root */
+static void isis_vertex_set_parent(struct isis_vertex *vertex, struct isis_adjacency *adj, struct isis_vertex *parent) {
 	struct listnode *node;
 	struct isis_adjacency *parent_adj;
-#ifdef EXTREME_DEBUG
-	u_char buff[BUFSIZ];
-#endif
-
-	assert(isis_find_vertex(spftree->paths, id, vtype) == NULL);
-	assert(isis_find_vertex(spftree->tents, id, vtype) == NULL);
-	vertex = isis_vertex_new(id, vtype);
-	vertex->d_N = cost;
-	vertex->depth = depth;
 
 	if(parent) {
-		listnode_add(vertex->parents, parent);
-		if(listnode_lookup(parent->children, vertex) == NULL) {
-			listnode_add(parent->children, vertex);
+		spf_array_add(&vertex->parents, parent);
+		if(spf_array_lookup(&parent->children, vertex) < 0) {
+			spf_array_add(&parent->children, vertex);
 		}
 	}
 
@@ -459,32 +540,48 @@ static struct isis_vertex *isis_spf_add2tent(struct isis_spftree *spftree, enum
 	} else if(adj) {
 		listnode_add(vertex->Adj_N, adj);
 	}
+}
 
-#ifdef EXTREME_DEBUG
-	zlog_debug("ISIS-Spf: add to TENT %s %s %s depth %d dist %d adjcount %d", print_sys_hostname(vertex->N.id), vtype2string(vertex->type), vid2string(vertex, buff), vertex->depth, vertex->d_N, listcount(vertex->Adj_N));
-#endif /* EXTREME_DEBUG */
+/* A shorter path was found to a vertex on TENT: it replaces the others */
+static void isis_tent_decrease(struct isis_spftree *spftree, struct isis_vertex *vertex, uint32_t cost, int depth, struct isis_adjacency *adj, struct isis_vertex *parent) {
+	struct isis_vertex *pvertex;
+	unsigned int i;
 
-	if(list_isempty(spftree->tents)) {
-		listnode_add(spftree->tents, vertex);
-		return vertex;
+	assert(spf_array_count(&vertex->children) == 0);
+	for(SPF_ARRAY_ELEMENTS(&vertex->parents, i, pvertex)) {
+		spf_array_delete(&pvertex->children, vertex);
 	}
+	spf_array_clear(&vertex->parents);
+	list_delete_all_node(vertex->Adj_N);
 
-	/* XXX: This cant use the standard ALL_LIST_ELEMENTS macro */
-	for(node = listhead(spftree->tents); node; node = listnextnode(node)) {
-		v = listgetdata(node);
-		if(v->d_N > vertex->d_N) {
-			list_add_node_prev(spftree->tents, node, vertex);
-			break;
-		} else if(v->d_N == vertex->d_N && v->type > vertex->type) {
-			/*  Tie break, add according to type */
-			list_add_node_prev(spftree->tents, node, vertex);
-			break;
-		}
-	}
+	vertex->d_N = cost;
+	vertex->depth = depth;
+	isis_vertex_set_parent(vertex, adj, parent);
 
-	if(node == NULL) {
-		listnode_add(spftree->tents, vertex);
-	}
+	spf_heap_decrease(spftree->tents, vertex->tent_pos, isis_tent_key(spftree, vertex));
+}
+
+/*
+ * Add a vertex to TENT sorted by cost and by vertextype on tie break situation,
+ * then in the order added
+ */
+static struct isis_vertex *isis_spf_add2tent(struct isis_spftree *spftree, enum vertextype vtype, void *id, uint32_t cost, int depth, int family, struct isis_adjacency *adj, struct isis_vertex *parent) {
+	struct isis_vertex *vertex;
+#ifdef EXTREME_DEBUG
+	u_char buff[BUFSIZ];
+#endif
+
+	assert(isis_lookup_vertex(spftree, id, vtype) == NULL);
+	vertex = isis_vertex_new(spftree, id, vtype);
+	vertex->d_N = cost;
+	vertex->depth = depth;
+	isis_vertex_set_parent(vertex, adj, parent);
+
+#ifdef EXTREME_DEBUG
+	zlog_debug("ISIS-Spf: add to TENT %s %s %s depth %d dist %d adjcount %d", print_sys_hostname(vertex->N.id), vtype2string(vertex->type), vid2string(vertex, buff), vertex->depth, vertex->d_N, listcount(vertex->Adj_N));
+#endif /* EXTREME_DEBUG */
+
+	spf_heap_push(spftree->tents, vertex, &vertex->tent_pos, isis_tent_key(spftree, vertex));
 
 	return vertex;
 }
@@ -492,7 +589,7 @@ static struct isis_vertex *isis_spf_add2tent(struct isis_spftree *spftree, enum
 static void isis_spf_add_local(struct isis_spftree *spftree, enum vertextype vtype, void *id, struct isis_adjacency *adj, uint32_t cost, int family, struct isis_vertex *parent) {
 	struct isis_vertex *vertex;
 
-	vertex = isis_find_vertex(spftree->tents, id, vtype);
+	vertex = isis_find_tent(spftree, id, vtype);
 
 	if(vertex) {
 		/* C.2.5   c) */
@@ -504,11 +601,11 @@ static void isis_spf_add_local(struct isis_spftree *spftree, enum vertextype vty
 			if(listcount(vertex->Adj_N) > ISIS_MAX_PATH_SPLITS) {
 				remove_excess_adjs(vertex->Adj_N);
 			}
-			if(parent && (listnode_lookup(vertex->parents, parent) == NULL)) {
-				listnode_add(vertex->parents, parent);
+			if(parent && spf_array_lookup(&vertex->parents, parent) < 0) {
+				spf_array_add(&vertex->parents, parent);
 			}
-			if(parent && (listnode_lookup(parent->children, vertex) == NULL)) {
-				listnode_add(parent->children, vertex);
+			if(parent && spf_array_lookup(&parent->children, vertex) < 0) {
+				spf_array_add(&parent->children, vertex);
 			}
 			return;
 		} else if(vertex->d_N < cost) {
@@ -516,14 +613,8 @@ static void isis_spf_add_local(struct isis_spftree *spftree, enum vertextype vty
 			return;
 		} else { /* vertex->d_N > cost */
 			/*         f) */
-			struct listnode *pnode, *pnextnode;
-			struct isis_vertex *pvertex;
-			listnode_delete(spftree->tents, vertex);
-			assert(listcount(vertex->children) == 0);
-			for(ALL_LIST_ELEMENTS(vertex->parents, pnode, pnextnode, pvertex)) {
-				listnode_delete(pvertex->children, vertex);
-			}
-			isis_vertex_del(vertex);
+			isis_tent_decrease(spftree, vertex, cost, 1, adj, parent);
+			return;
 		}
 	}
 
@@ -553,7 +644,7 @@ static void process_N(struct isis_spftree *spftree, enum vertextype vtype, void
 	}
 
 	/*       c)    */
-	vertex = isis_find_vertex(spftree->paths, id, vtype);
+	vertex = isis_find_vertex(spftree, id, vtype);
 	if(vertex) {
 #ifdef EXTREME_DEBUG
 		zlog_debug("ISIS-Spf: process_N %s %s %s dist %d already found from PATH", print_sys_hostname(vertex->N.id), vtype2string(vtype), vid2string(vertex, buff), dist);
@@ -562,7 +653,7 @@ static void process_N(struct isis_spftree *spftree, enum vertextype vtype, void
 		return;
 	}
 
-	vertex = isis_find_vertex(spftree->tents, id, vtype);
+	vertex = isis_find_tent(spftree, id, vtype);
 	/*       d)    */
 	if(vertex) {
 		/*        1) */
@@ -584,11 +675,11 @@ static void process_N(struct isis_spftree *spftree, enum vertextype vtype, void
 			if(listcount(vertex->Adj_N) > ISIS_MAX_PATH_SPLITS) {
 				remove_excess_adjs(vertex->Adj_N);
 			}
-			if(listnode_lookup(vertex->parents, parent) == NULL) {
-				listnode_add(vertex->parents, parent);
+			if(spf_array_lookup(&vertex->parents, parent) < 0) {
+				spf_array_add(&vertex->parents, parent);
 			}
-			if(listnode_lookup(parent->children, vertex) == NULL) {
-				listnode_add(parent->children, vertex);
+			if(spf_array_lookup(&parent->children, vertex) < 0) {
+				spf_array_add(&parent->children, vertex);
 			}
 			/*      3) */
 			return;
@@ -596,14 +687,8 @@ static void process_N(struct isis_spftree *spftree, enum vertextype vtype, void
 			return;
 			/*      4) */
 		} else {
-			struct listnode *pnode, *pnextnode;
-			struct isis_vertex *pvertex;
-			listnode_delete(spftree->tents, vertex);
-			assert(listcount(vertex->children) == 0);
-			for(ALL_LIST_ELEMENTS(vertex->parents, pnode, pnextnode, pvertex)) {
-				listnode_delete(pvertex->children, vertex);
-			}
-			isis_vertex_del(vertex);
+			isis_tent_decrease(spftree, vertex, dist, depth, NULL, parent);
+			return;
 		}
 	}
 
@@ -615,6 +700,48 @@ static void process_N(struct isis_spftree *spftree, enum vertextype vtype, void
 	return;
 }
 
+/*
+ * The IP prefixes of one LSP fragment, for both the SPF and the PRC
+ */
+static void isis_spf_process_reachs(struct isis_spftree *spftree, struct isis_lsp *lsp, uint32_t cost, uint16_t depth, int family, struct isis_vertex *parent) {
+	struct tlv_reach_iter iter;
+	struct tlv_reach reach;
+	enum vertextype vtype;
+	u_int32_t types = 0;
+
+	if(family == AF_INET) {
+		types = TLVFLAG_IPV4_INT_REACHABILITY | TLVFLAG_IPV4_EXT_REACHABILITY;
+		if(spftree->area->newmetric) {
+			types |= TLVFLAG_TE_IPV4_REACHABILITY;
+		}
+	}
+#ifdef HAVE_IPV6
+	if(family == AF_INET6) {
+		types = spftree->mtid ? TLVFLAG_MT_IPV6_REACHABILITY : TLVFLAG_IPV6_REACHABILITY;
+	}
+#endif /* HAVE_IPV6 */
+
+	/* straight off the pdu, nothing is decoded into lists for this */
+	lsp_reach_iter_init(&iter, lsp, types);
+	while(tlv_reach_iter_next(&iter, &reach)) {
+		if(reach.mtid != spftree->mtid) {
+			continue;
+		}
+		switch(reach.type) {
+			case IPV4_INT_REACHABILITY: vtype = VTYPE_IPREACH_INTERNAL; break;
+			case IPV4_EXT_REACHABILITY: vtype = VTYPE_IPREACH_EXTERNAL; break;
+			case TE_IPV4_REACHABILITY: vtype = VTYPE_IPREACH_TE; break;
+#ifdef HAVE_IPV6
+			case IPV6_REACHABILITY:
+			case MT_IPV6_REACHABILITY: vtype = reach.external ? VTYPE_IP6REACH_EXTERNAL : VTYPE_IP6REACH_INTERNAL; break;
+#endif /* HAVE_IPV6 */
+			default: continue;
+		}
+		apply_mask(&reach.prefix);
+		process_N(spftree, vtype, (void *) &reach.prefix, cost + reach.metric, depth + 1, family, parent);
+	}
+}
+
 /*
  * C.2.6 Step 1
  */
@@ -623,22 +750,29 @@ static int isis_spf_process_lsp(struct isis_spftree *spftree, struct isis_lsp *l
 	uint32_t dist;
 	struct is_neigh *is_neigh;
 	struct te_is_neigh *te_is_neigh;
-	struct ipv4_reachability *ipreach;
-	struct te_ipv4_reachability *te_ipv4_reach;
+	struct mt_is_neigh *mt_is_neigh;
+	struct mt_router_info *mt_info;
 	enum vertextype vtype;
-	struct prefix prefix;
-#ifdef HAVE_IPV6
-	struct ipv6_reachability *ip6reach;
-#endif /* HAVE_IPV6 */
+	int overload;
 	static const u_char null_sysid[ISIS_SYS_ID_LEN];
 
 	if(!speaks(lsp->tlv_data.nlpids, family)) {
 		return ISIS_OK;
 	}
 
+	/* the MT TLV is in the first fragment, and says if we are in */
+	overload = ISIS_MASK_LSP_OL_BIT(lsp->lsp_header->lsp_bits);
+	if(spftree->mtid != ISIS_MT_IPV4_UNICAST) {
+		mt_info = tlv_mt_router_info(lsp->tlv_data.mt_router_info, spftree->mtid);
+		if(mt_info == NULL) {
+			return ISIS_OK;
+		}
+		overload = mt_info->overload;
+	}
+
 lspfragloop:
 	if(lsp->lsp_header->seq_num == 0) {
-		zlog_warn("isis_spf_process_lsp(): lsp with 0 seq_num - ignore");
+		isis_spf_warn(spftree, "isis_spf_process_lsp(): lsp with 0 seq_num - ignore", NULL);
 		return ISIS_WARNING;
 	}
 
@@ -646,7 +780,24 @@ lspfragloop:
 	zlog_debug("ISIS-Spf: process_lsp %s", print_sys_hostname(lsp->lsp_header->lsp_id));
 #endif /* EXTREME_DEBUG */
 
-	if(!ISIS_MASK_LSP_OL_BIT(lsp->lsp_header->lsp_bits)) {
+	if(!overload && spftree->mtid != ISIS_MT_IPV4_UNICAST) {
+		if(lsp->tlv_data.mt_is_neighs) {
+			for(ALL_LIST_ELEMENTS_RO(lsp->tlv_data.mt_is_neighs, node, mt_is_neigh)) {
+				if(mt_is_neigh->mtid != spftree->mtid) {
+					continue;
+				}
+				if(!memcmp(mt_is_neigh->neigh_id, root_sysid, ISIS_SYS_ID_LEN)) {
+					continue;
+				}
+				if(!memcmp(mt_is_neigh->neigh_id, null_sysid, ISIS_SYS_ID_LEN)) {
+					continue;
+				}
+				dist = cost + GET_TE_METRIC(mt_is_neigh);
+				vtype = LSP_PSEUDO_ID(mt_is_neigh->neigh_id) ? VTYPE_PSEUDO_TE_IS : VTYPE_NONPSEUDO_TE_IS;
+				process_N(spftree, vtype, (void *) mt_is_neigh->neigh_id, dist, depth + 1, family, parent);
+			}
+		}
+	} else if(!overload) {
 		if(lsp->tlv_data.is_neighs) {
 			for(ALL_LIST_ELEMENTS_RO(lsp->tlv_data.is_neighs, node, is_neigh)) {
 				/* C.2.6 a) */
@@ -677,56 +828,7 @@ lspfragloop:
 		}
 	}
 
-	if(family == AF_INET && lsp->tlv_data.ipv4_int_reachs) {
-		prefix.family = AF_INET;
-		for(ALL_LIST_ELEMENTS_RO(lsp->tlv_data.ipv4_int_reachs, node, ipreach)) {
-			dist = cost + ipreach->metrics.metric_default;
-			vtype = VTYPE_IPREACH_INTERNAL;
-			prefix.u.prefix4 = ipreach->prefix;
-			prefix.prefixlen = ip_masklen(ipreach->mask);
-			apply_mask(&prefix);
-			process_N(spftree, vtype, (void *) &prefix, dist, depth + 1, family, parent);
-		}
-	}
-	if(family == AF_INET && lsp->tlv_data.ipv4_ext_reachs) {
-		prefix.family = AF_INET;
-		for(ALL_LIST_ELEMENTS_RO(lsp->tlv_data.ipv4_ext_reachs, node, ipreach)) {
-			dist = cost + ipreach->metrics.metric_default;
-			vtype = VTYPE_IPREACH_EXTERNAL;
-			prefix.u.prefix4 = ipreach->prefix;
-			prefix.prefixlen = ip_masklen(ipreach->mask);
-			apply_mask(&prefix);
-			process_N(spftree, vtype, (void *) &prefix, dist, depth + 1, family, parent);
-		}
-	}
-	if(family == AF_INET && lsp->tlv_data.te_ipv4_reachs) {
-		prefix.family = AF_INET;
-		for(ALL_LIST_ELEMENTS_RO(lsp->tlv_data.te_ipv4_reachs, node, te_ipv4_reach)) {
-			assert((te_ipv4_reach->control & 0x3F) <= IPV4_MAX_BITLEN);
-
-			dist = cost + ntohl(te_ipv4_reach->te_metric);
-			vtype = VTYPE_IPREACH_TE;
-			prefix.u.prefix4 = newprefix2inaddr(&te_ipv4_reach->prefix_start, te_ipv4_reach->control);
-			prefix.prefixlen = (te_ipv4_reach->control & 0x3F);
-			apply_mask(&prefix);
-			process_N(spftree, vtype, (void *) &prefix, dist, depth + 1, family, parent);
-		}
-	}
-#ifdef HAVE_IPV6
-	if(family == AF_INET6 && lsp->tlv_data.ipv6_reachs) {
-		prefix.family = AF_INET6;
-		for(ALL_LIST_ELEMENTS_RO(lsp->tlv_data.ipv6_reachs, node, ip6reach)) {
-			assert(ip6reach->prefix_len <= IPV6_MAX_BITLEN);
-
-			dist = cost + ntohl(ip6reach->metric);
-			vtype = (ip6reach->control_info & CTRL_INFO_DISTRIBUTION) ? VTYPE_IP6REACH_EXTERNAL : VTYPE_IP6REACH_INTERNAL;
-			prefix.prefixlen = ip6reach->prefix_len;
-			memcpy(&prefix.u.prefix6.s6_addr, ip6reach->prefix, PSIZE(ip6reach->prefix_len));
-			apply_mask(&prefix);
-			process_N(spftree, vtype, (void *) &prefix, dist, depth + 1, family, parent);
-		}
-	}
-#endif /* HAVE_IPV6 */
+	isis_spf_process_reachs(spftree, lsp, cost, depth, family, parent);
 
 	if(fragnode == NULL) {
 		fragnode = listhead(lsp->lspu.frags);
@@ -752,8 +854,12 @@ static int isis_spf_process_pseudo_lsp(struct isis_spftree *spftree, struct isis
 pseudofragloop:
 
 	if(lsp->lsp_header->seq_num == 0) {
-		zlog_warn("isis_spf_process_pseudo_lsp(): lsp with 0 seq_num"
-			  " - do not process");
+		isis_spf_warn(
+			spftree,
+			"isis_spf_process_pseudo_lsp(): lsp with 0 seq_num"
+			" - do not process",
+			NULL
+		);
 		return ISIS_WARNING;
 	}
 
@@ -800,60 +906,79 @@ pseudofragloop:
 	return ISIS_OK;
 }
 
+/* Does the SPT of this level and family go through the circuit? */
+static int isis_spf_circuit_used(struct isis_circuit *circuit, int level, int family) {
+	if(circuit->state != C_STATE_UP) {
+		return 0;
+	}
+	if(!(circuit->is_type & level)) {
+		return 0;
+	}
+	if(family == AF_INET && !circuit->ip_router) {
+		return 0;
+	}
+#ifdef HAVE_IPV6
+	if(family == AF_INET6 && !circuit->ipv6_router) {
+		return 0;
+	}
+#endif /* HAVE_IPV6 */
+	return 1;
+}
+
+/* the standard topology takes any adjacency, as it always did */
+static int isis_spf_adj_in_topology(struct isis_spftree *spftree, struct isis_adjacency *adj) {
+	return spftree->mtid == ISIS_MT_IPV4_UNICAST || ISIS_ADJ_HAS_MT(adj, spftree->mtid);
+}
+
+/*
+ * Add IP(v6) addresses of this circuit
+ */
+static void isis_spf_preload_prefixes(struct isis_spftree *spftree, struct isis_circuit *circuit, int family, struct isis_vertex *parent) {
+	struct listnode *ipnode;
+	struct prefix_ipv4 *ipv4;
+	struct prefix prefix;
+#ifdef HAVE_IPV6
+	struct prefix_ipv6 *ipv6;
+#endif /* HAVE_IPV6 */
+
+	if(family == AF_INET) {
+		prefix.family = AF_INET;
+		for(ALL_LIST_ELEMENTS_RO(circuit->ip_addrs, ipnode, ipv4)) {
+			prefix.u.prefix4 = ipv4->prefix;
+			prefix.prefixlen = ipv4->prefixlen;
+			apply_mask(&prefix);
+			isis_spf_add_local(spftree, VTYPE_IPREACH_INTERNAL, &prefix, NULL, 0, family, parent);
+		}
+	}
+#ifdef HAVE_IPV6
+	if(family == AF_INET6) {
+		prefix.family = AF_INET6;
+		for(ALL_LIST_ELEMENTS_RO(circuit->ipv6_non_link, ipnode, ipv6)) {
+			prefix.prefixlen = ipv6->prefixlen;
+			prefix.u.prefix6 = ipv6->prefix;
+			apply_mask(&prefix);
+			isis_spf_add_local(spftree, VTYPE_IP6REACH_INTERNAL, &prefix, NULL, 0, family, parent);
+		}
+	}
+#endif /* HAVE_IPV6 */
+}
+
 static int isis_spf_preload_tent(struct isis_spftree *spftree, int level, int family, u_char *root_sysid, struct isis_vertex *parent) {
 	struct isis_circuit *circuit;
-	struct listnode *cnode, *anode, *ipnode;
+	struct listnode *cnode, *anode;
 	struct isis_adjacency *adj;
 	struct isis_lsp *lsp;
 	struct list *adj_list;
 	struct list *adjdb;
-	struct prefix_ipv4 *ipv4;
-	struct prefix prefix;
 	int retval = ISIS_OK;
 	u_char lsp_id[ISIS_SYS_ID_LEN + 2];
 	static u_char null_lsp_id[ISIS_SYS_ID_LEN + 2];
-#ifdef HAVE_IPV6
-	struct prefix_ipv6 *ipv6;
-#endif /* HAVE_IPV6 */
 
 	for(ALL_LIST_ELEMENTS_RO(spftree->area->circuit_list, cnode, circuit)) {
-		if(circuit->state != C_STATE_UP) {
-			continue;
-		}
-		if(!(circuit->is_type & level)) {
+		if(!isis_spf_circuit_used(circuit, level, family)) {
 			continue;
 		}
-		if(family == AF_INET && !circuit->ip_router) {
-			continue;
-		}
-#ifdef HAVE_IPV6
-		if(family == AF_INET6 && !circuit->ipv6_router) {
-			continue;
-		}
-#endif /* HAVE_IPV6 */
-		/* 
-       * Add IP(v6) addresses of this circuit
-       */
-		if(family == AF_INET) {
-			prefix.family = AF_INET;
-			for(ALL_LIST_ELEMENTS_RO(circuit->ip_addrs, ipnode, ipv4)) {
-				prefix.u.prefix4 = ipv4->prefix;
-				prefix.prefixlen = ipv4->prefixlen;
-				apply_mask(&prefix);
-				isis_spf_add_local(spftree, VTYPE_IPREACH_INTERNAL, &prefix, NULL, 0, family, parent);
-			}
-		}
-#ifdef HAVE_IPV6
-		if(family == AF_INET6) {
-			prefix.family = AF_INET6;
-			for(ALL_LIST_ELEMENTS_RO(circuit->ipv6_non_link, ipnode, ipv6)) {
-				prefix.prefixlen = ipv6->prefixlen;
-				prefix.u.prefix6 = ipv6->prefix;
-				apply_mask(&prefix);
-				isis_spf_add_local(spftree, VTYPE_IP6REACH_INTERNAL, &prefix, NULL, 0, family, parent);
-			}
-		}
-#endif /* HAVE_IPV6 */
+		isis_spf_preload_prefixes(spftree, circuit, family, parent);
 		if(circuit->circ_type == CIRCUIT_T_BROADCAST) {
 			/*
 	   * Add the adjacencies
@@ -869,7 +994,7 @@ static int isis_spf_preload_tent(struct isis_spftree *spftree, int level, int fa
 				continue;
 			}
 			for(ALL_LIST_ELEMENTS_RO(adj_list, anode, adj)) {
-				if(!speaks(&adj->nlpids, family)) {
+				if(!speaks(&adj->nlpids, family) || !isis_spf_adj_in_topology(spftree, adj)) {
 					continue;
 				}
 				switch(adj->sys_type) {
@@ -940,7 +1065,7 @@ static int isis_spf_preload_tent(struct isis_spftree *spftree, int level, int fa
 				case ISIS_SYSTYPE_IS:
 				case ISIS_SYSTYPE_L1_IS:
 				case ISIS_SYSTYPE_L2_IS:
-					if(speaks(&adj->nlpids, family)) {
+					if(speaks(&adj->nlpids, family) && isis_spf_adj_in_topology(spftree, adj)) {
 						isis_spf_add_local(spftree, spftree->area->oldmetric ? VTYPE_NONPSEUDO_IS : VTYPE_NONPSEUDO_TE_IS, adj->sysid, adj, circuit->te_metric[level - 1], family, parent);
 					}
 					break;
@@ -962,18 +1087,28 @@ static int isis_spf_preload_tent(struct isis_spftree *spftree, int level, int fa
  * The parent(s) for vertex is set when added to TENT list
  * now we just put the child pointer(s) in place
  */
-static void add_to_paths(struct isis_spftree *spftree, struct isis_vertex *vertex, int level) {
+static int add_to_paths(struct isis_spftree *spftree, struct isis_vertex *vertex) {
+#ifdef EXTREME_DEBUG
 	u_char buff[BUFSIZ];
+#endif /* EXTREME_DEBUG */
 
-	if(isis_find_vertex(spftree->paths, vertex->N.id, vertex->type)) {
-		return;
+	if(isis_find_vertex(spftree, vertex->N.id, vertex->type)) {
+		return 0;
 	}
-	listnode_add(spftree->paths, vertex);
+	TAILQ_INSERT_TAIL(&spftree->paths, vertex, path_entry);
+	vertex->on_paths = 1;
 
 #ifdef EXTREME_DEBUG
 	zlog_debug("ISIS-Spf: added %s %s %s depth %d dist %d to PATHS", print_sys_hostname(vertex->N.id), vtype2string(vertex->type), vid2string(vertex, buff), vertex->depth, vertex->d_N);
 #endif /* EXTREME_DEBUG */
 
+	return 1;
+}
+
+/* The route to a prefix on PATHS */
+static void isis_spf_route(struct isis_spftree *spftree, struct isis_vertex *vertex, int level) {
+	u_char buff[BUFSIZ];
+
 	if(vertex->type > VTYPE_ES) {
 		if(listcount(vertex->Adj_N) > 0) {
 			isis_route_create((struct prefix *) &vertex->N.prefix, vertex->d_N, vertex->depth, vertex->Adj_N, spftree->area, level);
@@ -990,85 +1125,120 @@ static void add_to_paths(struct isis_spftree *spftree, struct isis_vertex *verte
 }
 
 static void init_spt(struct isis_spftree *spftree) {
-	spftree->tents->del = spftree->paths->del = (void (*)(void *)) isis_vertex_del;
-	list_delete_all_node(spftree->tents);
-	list_delete_all_node(spftree->paths);
-	spftree->tents->del = spftree->paths->del = NULL;
-	return;
-}
-
-static int isis_run_spf(struct isis_area *area, int level, int family, u_char *sysid) {
-	int retval = ISIS_OK;
-	struct listnode *node;
 	struct isis_vertex *vertex;
-	struct isis_vertex *root_vertex;
-	struct isis_spftree *spftree = NULL;
-	u_char lsp_id[ISIS_SYS_ID_LEN + 2];
-	struct isis_lsp *lsp;
-	struct route_table *table = NULL;
-	struct timeval time_now;
-	unsigned long long start_time, end_time;
-
-	/* Get time that can't roll backwards. */
-	quagga_gettime(QUAGGA_CLK_MONOTONIC, &time_now);
-	start_time = time_now.tv_sec;
-	start_time = (start_time * 1000000) + time_now.tv_usec;
 
-	if(family == AF_INET) {
-		spftree = area->spftree[level - 1];
+	while((vertex = spf_heap_pop(spftree->tents))) {
+		isis_vertex_del(spftree, vertex);
 	}
+	while((vertex = TAILQ_FIRST(&spftree->paths))) {
+		TAILQ_REMOVE(&spftree->paths, vertex, path_entry);
+		isis_vertex_del(spftree, vertex);
+	}
+	spftree->tent_seq = 0;
+	return;
+}
+
+static struct isis_spftree *isis_spftree_get(struct isis_area *area, int level, int family) {
 #ifdef HAVE_IPV6
-	else if(family == AF_INET6) {
-		spftree = area->spftree6[level - 1];
+	if(family == AF_INET6) {
+		return area->spftree6[level - 1];
 	}
 #endif
-	assert(spftree);
-	assert(sysid);
+	return area->spftree[level - 1];
+}
 
-	/* Make all routes in current route table inactive. */
-	if(family == AF_INET) {
-		table = area->route_table[level - 1];
+/* IPv6 runs in its own topology if asked to, everything else in the standard one */
+static u_int16_t isis_spf_mtid(struct isis_area *area, int family) {
+#ifdef HAVE_IPV6
+	if(family == AF_INET6 && area->mt_ipv6) {
+		return ISIS_MT_IPV6_UNICAST;
 	}
+#endif
+	return ISIS_MT_IPV4_UNICAST;
+}
+
+static struct route_table *isis_spf_route_table(struct isis_area *area, int level, int family) {
 #ifdef HAVE_IPV6
-	else if(family == AF_INET6) {
-		table = area->route_table6[level - 1];
+	if(family == AF_INET6) {
+		return area->route_table6[level - 1];
 	}
 #endif
+	return area->route_table[level - 1];
+}
 
-	isis_route_invalidate_table(area, table);
+static unsigned long long isis_spf_time_usec(void) {
+	struct timeval time_now;
+	unsigned long long usec;
+
+	/* Get time that can't roll backwards. */
+	quagga_gettime(QUAGGA_CLK_MONOTONIC, &time_now);
+	usec = time_now.tv_sec;
+	return (usec * 1000000) + time_now.tv_usec;
+}
+
+/*
+ * C.2.5 Step 0: what the run starts from, on the main thread as it looks
+ * at the circuits and adjacencies
+ */
+static void isis_spf_prepare(struct isis_spf_job *job, struct isis_area *area, int level, int family, u_char *sysid) {
+	struct isis_spftree *spftree = isis_spftree_get(area, level, family);
+	struct isis_vertex *root_vertex;
+
+	assert(spftree);
+	assert(sysid);
+
+	memset(job, 0, sizeof(struct isis_spf_job));
+	job->spftree = spftree;
+	job->level = level;
+	job->family = family;
+	job->sysid = sysid;
+	job->retval = ISIS_OK;
+	job->start_time = isis_spf_time_usec();
+	spftree->job = job;
+	spftree->mtid = isis_spf_mtid(area, family);
+	QUAGGA_TRACE(isis, spf_start, area->area_tag, level, family);
 
-	/*
-   * C.2.5 Step 0
-   */
 	init_spt(spftree);
 	/*              a) */
 	root_vertex = isis_spf_add_root(spftree, level, sysid);
 	/*              b) */
-	retval = isis_spf_preload_tent(spftree, level, family, sysid, root_vertex);
-	if(retval != ISIS_OK) {
+	job->retval = isis_spf_preload_tent(spftree, level, family, sysid, root_vertex);
+	if(job->retval != ISIS_OK) {
 		zlog_warn("ISIS-Spf: failed to load TENT SPF-root:%s", print_sys_hostname(sysid));
-		goto out;
+		return;
 	}
 
 	/*
    * C.2.7 Step 2
    */
-	if(listcount(spftree->tents) == 0) {
+	if(spf_heap_count(spftree->tents) == 0) {
 		zlog_warn("ISIS-Spf: TENT is empty SPF-root:%s", print_sys_hostname(sysid));
-		goto out;
+		return;
+	}
+
+	job->ready = 1;
+}
+
+/* C.2.6, C.2.7: the SPT, on an SPF thread or not */
+static void isis_spf_compute(void *arg) {
+	struct isis_spf_job *job = arg;
+	struct isis_spftree *spftree = job->spftree;
+	struct isis_vertex *vertex;
+	u_char lsp_id[ISIS_SYS_ID_LEN + 2];
+	struct isis_lsp *lsp;
+
+	if(!job->ready) {
+		return;
 	}
 
-	while(listcount(spftree->tents) > 0) {
-		node = listhead(spftree->tents);
-		vertex = listgetdata(node);
+	while((vertex = spf_heap_pop(spftree->tents))) {
 
 #ifdef EXTREME_DEBUG
 		zlog_debug("ISIS-Spf: get TENT node %s %s depth %d dist %d to PATHS", print_sys_hostname(vertex->N.id), vtype2string(vertex->type), vertex->depth, vertex->d_N);
 #endif /* EXTREME_DEBUG */
 
-		/* Remove from tent list and add to paths list */
-		list_delete_node(spftree->tents, node);
-		add_to_paths(spftree, vertex, level);
+		/* Removed from tent list, add to paths list */
+		add_to_paths(spftree, vertex);
 		switch(vertex->type) {
 			case VTYPE_PSEUDO_IS:
 			case VTYPE_NONPSEUDO_IS:
@@ -1076,31 +1246,271 @@ static int isis_run_spf(struct isis_area *area, int level, int family, u_char *s
 			case VTYPE_NONPSEUDO_TE_IS:
 				memcpy(lsp_id, vertex->N.id, ISIS_SYS_ID_LEN + 1);
 				LSP_FRAGMENT(lsp_id) = 0;
-				lsp = lsp_search(lsp_id, area->lspdb[level - 1]);
+				lsp = lsp_search(lsp_id, spftree->area->lspdb[job->level - 1]);
 				if(lsp && lsp->lsp_header->rem_lifetime != 0) {
 					if(LSP_PSEUDO_ID(lsp_id)) {
-						isis_spf_process_pseudo_lsp(spftree, lsp, vertex->d_N, vertex->depth, family, sysid, vertex);
+						isis_spf_process_pseudo_lsp(spftree, lsp, vertex->d_N, vertex->depth, job->family, job->sysid, vertex);
 					} else {
-						isis_spf_process_lsp(spftree, lsp, vertex->d_N, vertex->depth, family, sysid, vertex);
+						isis_spf_process_lsp(spftree, lsp, vertex->d_N, vertex->depth, job->family, job->sysid, vertex);
 					}
 				} else {
-					zlog_warn("ISIS-Spf: No LSP found for %s", rawlspid_print(lsp_id));
+					isis_spf_warn(spftree, "ISIS-Spf: No LSP found for", lsp_id);
 				}
 				break;
 			default:;
 		}
 	}
+}
+
+/*
+ * Work out the SPTs of the jobs, on the SPF threads if there are any and
+ * it's worth it.  With SPF event debugging on, they stay on the main
+ * thread to log as they go.
+ */
+static void isis_spf_compute_all(struct isis_spf_job **jobs, unsigned int n) {
+	unsigned int i;
+
+#ifndef EXTREME_DEBUG
+	if(isis->spf_threads && isis_spf_pool == NULL) {
+		isis_spf_pool = work_pool_new(master, "IS-IS SPF", isis->spf_threads);
+	}
+
+	if(isis_spf_pool && n > 1 && !(isis->debugs & DEBUG_SPF_EVENTS)) {
+		for(i = 0; i < n; i++) {
+			jobs[i]->threaded = 1;
+		}
+		work_pool_run(isis_spf_pool, isis_spf_compute, (void **) jobs, n);
+		return;
+	}
+#endif /* EXTREME_DEBUG */
+
+	for(i = 0; i < n; i++) {
+		isis_spf_compute(jobs[i]);
+	}
+}
+
+/* The routes of the level (family) from the SPT, on the main thread */
+static int isis_spf_finish(struct isis_spf_job *job) {
+	struct isis_spftree *spftree = job->spftree;
+	struct isis_area *area = spftree->area;
+	struct isis_vertex *vertex;
+
+	spftree->job = NULL;
+	if(job->warnings) {
+		zlog_warn(
+			"%s%s%s%s", job->warning, job->warning_has_id ? " " : "", job->warning_has_id ? rawlspid_print(job->warning_id) : "",
+			job->warnings > 1 ? " (and more in this SPF run)" : ""
+		);
+	}
+
+	/* Make all routes in current route table inactive. */
+	isis_route_invalidate_table(area, isis_spf_route_table(area, job->level, job->family));
+	TAILQ_FOREACH(vertex, &spftree->paths, path_entry) {
+		isis_spf_route(spftree, vertex, job->level);
+	}
 
-out:
 	isis_route_validate(area);
 	spftree->pending = 0;
 	spftree->runcount++;
 	spftree->last_run_timestamp = time(NULL);
+	/* with SPF threads, the time until the tree was in */
+	spftree->last_run_duration = isis_spf_time_usec() - job->start_time;
+	QUAGGA_TRACE(isis, spf_done, area->area_tag, job->level, job->family, spftree->last_run_duration);
+
+	return job->retval;
+}
+
+/* One tree on its own */
+static int isis_run_spf(struct isis_area *area, int level, int family, u_char *sysid) {
+	struct isis_spf_job job, *jobs = &job;
+
+	isis_spf_prepare(&job, area, level, family, sysid);
+	isis_spf_compute_all(&jobs, 1);
+	return isis_spf_finish(&job);
+}
+
+/*
+ * Partial route computation, for when only the IP reachability of LSPs
+ * changed: the SPT of the last run stays, its prefixes are dropped and
+ * found again from our circuits and from the LSPs of the systems on it.
+ */
+static int isis_run_prc(struct isis_area *area, int level, int family, u_char *sysid) {
+	struct listnode *node, *fragnode;
+	struct isis_vertex *vertex, *nvertex, *root_vertex, *pvertex;
+	struct isis_spftree *spftree = NULL;
+	struct isis_circuit *circuit;
+	struct isis_lsp *lsp, *frag;
+	struct route_table *table = NULL;
+	u_char lsp_id[ISIS_SYS_ID_LEN + 2];
+	struct timeval time_now;
+	unsigned long long start_time, end_time;
+	unsigned int i;
+
+	quagga_gettime(QUAGGA_CLK_MONOTONIC, &time_now);
+	start_time = time_now.tv_sec;
+	start_time = (start_time * 1000000) + time_now.tv_usec;
+
+	if(family == AF_INET) {
+		spftree = area->spftree[level - 1];
+		table = area->route_table[level - 1];
+	}
+#ifdef HAVE_IPV6
+	else if(family == AF_INET6) {
+		spftree = area->spftree6[level - 1];
+		table = area->route_table6[level - 1];
+	}
+#endif
+	assert(spftree);
+	assert(sysid);
+
+	root_vertex = TAILQ_FIRST(&spftree->paths);
+	if(root_vertex == NULL) {
+		return isis_run_spf(area, level, family, sysid);
+	}
+
+	isis_route_invalidate_table(area, table);
+
+	TAILQ_FOREACH_SAFE(vertex, &spftree->paths, path_entry, nvertex) {
+		if(vertex->type <= VTYPE_ES) {
+			continue;
+		}
+		for(SPF_ARRAY_ELEMENTS(&vertex->parents, i, pvertex)) {
+			spf_array_delete(&pvertex->children, vertex);
+		}
+		TAILQ_REMOVE(&spftree->paths, vertex, path_entry);
+		isis_vertex_del(spftree, vertex);
+	}
+
+	for(ALL_LIST_ELEMENTS_RO(area->circuit_list, node, circuit)) {
+		if(isis_spf_circuit_used(circuit, level, family)) {
+			isis_spf_preload_prefixes(spftree, circuit, family, root_vertex);
+		}
+	}
+
+	TAILQ_FOREACH(vertex, &spftree->paths, path_entry) {
+		if(vertex == root_vertex || (vertex->type != VTYPE_NONPSEUDO_IS && vertex->type != VTYPE_NONPSEUDO_TE_IS)) {
+			continue;
+		}
+		memcpy(lsp_id, vertex->N.id, ISIS_SYS_ID_LEN);
+		LSP_PSEUDO_ID(lsp_id) = 0;
+		LSP_FRAGMENT(lsp_id) = 0;
+		lsp = lsp_search(lsp_id, area->lspdb[level - 1]);
+		if(lsp == NULL || lsp->lsp_header->rem_lifetime == 0 || !speaks(lsp->tlv_data.nlpids, family)) {
+			continue;
+		}
+		/* the fragments are taken as far as isis_spf_process_lsp() does */
+		if(lsp->lsp_header->seq_num == 0) {
+			continue;
+		}
+		isis_spf_process_reachs(spftree, lsp, vertex->d_N, vertex->depth, family, vertex);
+		for(ALL_LIST_ELEMENTS_RO(lsp->lspu.frags, fragnode, frag)) {
+			if(frag->lsp_header->seq_num == 0) {
+				break;
+			}
+			isis_spf_process_reachs(spftree, frag, vertex->d_N, vertex->depth, family, vertex);
+		}
+	}
+
+	while((vertex = spf_heap_pop(spftree->tents))) {
+		if(add_to_paths(spftree, vertex)) {
+			isis_spf_route(spftree, vertex, level);
+		}
+	}
+
+	isis_route_validate(area);
+	spftree->pending = 0;
+	spftree->prc_runcount++;
+	spftree->last_run_timestamp = time(NULL);
 	quagga_gettime(QUAGGA_CLK_MONOTONIC, &time_now);
 	end_time = time_now.tv_sec;
 	end_time = (end_time * 1000000) + time_now.tv_usec;
 	spftree->last_run_duration = end_time - start_time;
 
+	return ISIS_OK;
+}
+
+/* clears the full flag: the run about to be made rebuilds the SPT */
+static int isis_spf_full(struct isis_spftree *spftree) {
+	int full = spftree->full || spftree->runcount == 0;
+
+	spftree->full = 0;
+	return full;
+}
+
+/*
+ * Would the level's (family's) tree be run now, if its timer fired? With
+ * SPF threads, the trees so due are taken along by the one that fires.
+ */
+static int isis_spf_due(struct isis_area *area, int level, int family, time_t now) {
+	struct isis_spftree *spftree;
+
+	if(!(area->is_type & level)) {
+		return 0;
+	}
+	if(family == AF_INET && !area->ip_circuits) {
+		return 0;
+	}
+#ifdef HAVE_IPV6
+	if(family == AF_INET6 && !area->ipv6_circuits) {
+		return 0;
+	}
+#endif
+	spftree = isis_spftree_get(area, level, family);
+	return spftree && spftree->pending && spftree->t_spf && now - spftree->last_run_timestamp >= area->min_spf_interval[level - 1];
+}
+
+/* run what was scheduled: the SPF, or the PRC if that is enough */
+static int isis_spf_run_scheduled(struct isis_area *area, int level, int family) {
+	static const int families[] = {
+		AF_INET,
+#ifdef HAVE_IPV6
+		AF_INET6,
+#endif
+	};
+	struct isis_spf_job jobs[ISIS_LEVELS * array_size(families)];
+	struct isis_spf_job *args[ISIS_LEVELS * array_size(families)];
+	struct isis_spftree *spftree;
+	time_t now = time(NULL);
+	unsigned int i, n = 0;
+	int lvl, full, ret, retval = ISIS_OK;
+
+	full = isis_spf_full(isis_spftree_get(area, level, family));
+	if(full) {
+		isis_spf_prepare(&jobs[n], area, level, family, isis->sysid);
+		args[n] = &jobs[n];
+		n++;
+	} else {
+		retval = isis_run_prc(area, level, family, isis->sysid);
+	}
+
+	if(isis->spf_threads) {
+		for(lvl = IS_LEVEL_1; lvl <= IS_LEVEL_2; lvl++) {
+			for(i = 0; i < array_size(families); i++) {
+				if((lvl == level && families[i] == family) || !isis_spf_due(area, lvl, families[i], now)) {
+					continue;
+				}
+				spftree = isis_spftree_get(area, lvl, families[i]);
+				THREAD_TIMER_OFF(spftree->t_spf);
+				spftree->pending = 0;
+				if(isis_spf_full(spftree)) {
+					isis_spf_prepare(&jobs[n], area, lvl, families[i], isis->sysid);
+					args[n] = &jobs[n];
+					n++;
+				} else {
+					isis_run_prc(area, lvl, families[i], isis->sysid);
+				}
+			}
+		}
+	}
+
+	isis_spf_compute_all(args, n);
+	for(i = 0; i < n; i++) {
+		ret = isis_spf_finish(args[i]);
+		if(i == 0 && full) {
+			retval = ret;
+		}
+	}
+
 	return retval;
 }
 
@@ -1126,7 +1536,7 @@ int isis_run_spf_l1(struct thread *thread) {
 	}
 
 	if(area->ip_circuits) {
-		retval = isis_run_spf(area, 1, AF_INET, isis->sysid);
+		retval = isis_spf_run_scheduled(area, 1, AF_INET);
 	}
 
 	return retval;
@@ -1154,22 +1564,44 @@ int isis_run_spf_l2(struct thread *thread) {
 	}
 
 	if(area->ip_circuits) {
-		retval = isis_run_spf(area, 2, AF_INET, isis->sysid);
+		retval = isis_spf_run_scheduled(area, 2, AF_INET);
 	}
 
 	return retval;
 }
 
-int isis_spf_schedule(struct isis_area *area, int level) {
+#ifdef HAVE_IPV6
+static int isis_run_spf6_l1(struct thread *thread);
+static int isis_run_spf6_l2(struct thread *thread);
+#endif
+
+/*
+ * Schedule a run of the level's (family's) SPT after min_spf_interval,
+ * the full SPF if 'full' here or by an earlier call, else the PRC
+ */
+static int spf_schedule(struct isis_area *area, int level, int family, int full) {
 	struct isis_spftree *spftree = area->spftree[level - 1];
+	int (*func)(struct thread *) = (level == 1) ? isis_run_spf_l1 : isis_run_spf_l2;
 	time_t now = time(NULL);
-	int diff = now - spftree->last_run_timestamp;
+	time_t diff;
+
+#ifdef HAVE_IPV6
+	if(family == AF_INET6) {
+		spftree = area->spftree6[level - 1];
+		func = (level == 1) ? isis_run_spf6_l1 : isis_run_spf6_l2;
+	}
+#endif
+	diff = now - spftree->last_run_timestamp;
 
 	assert(diff >= 0);
 	assert(area->is_type & level);
 
 	if(isis->debugs & DEBUG_SPF_EVENTS) {
-		zlog_debug("ISIS-Spf (%s) L%d SPF schedule called, lastrun %d sec ago", area->area_tag, level, diff);
+		zlog_debug("ISIS-Spf (%s) L%d %s schedule called, lastrun %lld sec ago", area->area_tag, level, full ? "SPF" : "PRC", (long long) diff);
+	}
+
+	if(full) {
+		spftree->full = 1;
 	}
 
 	if(spftree->pending) {
@@ -1178,19 +1610,20 @@ int isis_spf_schedule(struct isis_area *area, int level) {
 
 	THREAD_TIMER_OFF(spftree->t_spf);
 
-	/* wait configured min_spf_interval before doing the SPF */
+	/* wait configured min_spf_interval before doing the SPF; with SPF
+   * threads through the timer all the same, for the other trees of the
+   * area scheduled meanwhile to be run along */
 	if(diff >= area->min_spf_interval[level - 1]) {
-		return isis_run_spf(area, level, AF_INET, isis->sysid);
+		if(!isis->spf_threads) {
+			return isis_spf_run_scheduled(area, level, family);
+		}
+		diff = area->min_spf_interval[level - 1];
 	}
 
-	if(level == 1) {
-		THREAD_TIMER_ON(master, spftree->t_spf, isis_run_spf_l1, area, area->min_spf_interval[0] - diff);
-	} else {
-		THREAD_TIMER_ON(master, spftree->t_spf, isis_run_spf_l2, area, area->min_spf_interval[1] - diff);
-	}
+	THREAD_TIMER_ON(master, spftree->t_spf, func, area, area->min_spf_interval[level - 1] - diff);
 
 	if(isis->debugs & DEBUG_SPF_EVENTS) {
-		zlog_debug("ISIS-Spf (%s) L%d SPF scheduled %d sec from now", area->area_tag, level, area->min_spf_interval[level - 1] - diff);
+		zlog_debug("ISIS-Spf (%s) L%d SPF scheduled %lld sec from now", area->area_tag, level, (long long) (area->min_spf_interval[level - 1] - diff));
 	}
 
 	spftree->pending = 1;
@@ -1198,6 +1631,60 @@ int isis_spf_schedule(struct isis_area *area, int level) {
 	return ISIS_OK;
 }
 
+int isis_spf_schedule(struct isis_area *area, int level) {
+	return spf_schedule(area, level, AF_INET, 1);
+}
+
+/* Is the system or pseudonode of the LSP on the SPT? */
+static int isis_spf_lsp_on_spt(struct isis_spftree *spftree, u_char *lsp_id) {
+	if(LSP_PSEUDO_ID(lsp_id)) {
+		return isis_find_vertex(spftree, lsp_id, VTYPE_PSEUDO_IS) || isis_find_vertex(spftree, lsp_id, VTYPE_PSEUDO_TE_IS);
+	}
+	return isis_find_vertex(spftree, lsp_id, VTYPE_NONPSEUDO_IS) || isis_find_vertex(spftree, lsp_id, VTYPE_NONPSEUDO_TE_IS);
+}
+
+static int spf_schedule_lsp(struct isis_area *area, int level, int family, u_char *lsp_id, int topology) {
+	struct isis_spftree *spftree = area->spftree[level - 1];
+
+#ifdef HAVE_IPV6
+	if(family == AF_INET6) {
+		spftree = area->spftree6[level - 1];
+	}
+#endif
+
+	if(spftree->runcount > 0 && !isis_spf_lsp_on_spt(spftree, lsp_id)) {
+		if(isis->debugs & DEBUG_SPF_EVENTS) {
+			zlog_debug("ISIS-Spf (%s) L%d LSP %s is off the SPT, no SPF needed", area->area_tag, level, rawlspid_print(lsp_id));
+		}
+		return ISIS_OK;
+	}
+
+	return spf_schedule(area, level, family, topology);
+}
+
+/*
+ * An LSP was installed, changed or removed.  Nothing reaches a system off
+ * the SPT through its LSP, so then neither the SPT nor the routes change;
+ * if only its IP reachability changed ('topology' 0) the PRC does.  Our
+ * own LSPs stand for our circuits and adjacencies: always the full SPF.
+ */
+int isis_spf_schedule_lsp(struct isis_area *area, int level, u_char *lsp_id, int topology) {
+	if(memcmp(lsp_id, isis->sysid, ISIS_SYS_ID_LEN) == 0) {
+		isis_spf_schedule(area, level);
+#ifdef HAVE_IPV6
+		isis_spf_schedule6(area, level);
+#endif
+		return ISIS_OK;
+	}
+
+	spf_schedule_lsp(area, level, AF_INET, lsp_id, topology);
+#ifdef HAVE_IPV6
+	spf_schedule_lsp(area, level, AF_INET6, lsp_id, topology);
+#endif
+
+	return ISIS_OK;
+}
+
 #ifdef HAVE_IPV6
 static int isis_run_spf6_l1(struct thread *thread) {
 	struct isis_area *area;
@@ -1221,7 +1708,7 @@ static int isis_run_spf6_l1(struct thread *thread) {
 	}
 
 	if(area->ipv6_circuits) {
-		retval = isis_run_spf(area, 1, AF_INET6, isis->sysid);
+		retval = isis_spf_run_scheduled(area, 1, AF_INET6);
 	}
 
 	return retval;
@@ -1249,54 +1736,18 @@ static int isis_run_spf6_l2(struct thread *thread) {
 	}
 
 	if(area->ipv6_circuits) {
-		retval = isis_run_spf(area, 2, AF_INET6, isis->sysid);
+		retval = isis_spf_run_scheduled(area, 2, AF_INET6);
 	}
 
 	return retval;
 }
 
 int isis_spf_schedule6(struct isis_area *area, int level) {
-	int retval = ISIS_OK;
-	struct isis_spftree *spftree = area->spftree6[level - 1];
-	time_t now = time(NULL);
-	time_t diff = now - spftree->last_run_timestamp;
-
-	assert(diff >= 0);
-	assert(area->is_type & level);
-
-	if(isis->debugs & DEBUG_SPF_EVENTS) {
-		zlog_debug("ISIS-Spf (%s) L%d SPF schedule called, lastrun %lld sec ago", area->area_tag, level, (long long) diff);
-	}
-
-	if(spftree->pending) {
-		return ISIS_OK;
-	}
-
-	THREAD_TIMER_OFF(spftree->t_spf);
-
-	/* wait configured min_spf_interval before doing the SPF */
-	if(diff >= area->min_spf_interval[level - 1]) {
-		return isis_run_spf(area, level, AF_INET6, isis->sysid);
-	}
-
-	if(level == 1) {
-		THREAD_TIMER_ON(master, spftree->t_spf, isis_run_spf6_l1, area, area->min_spf_interval[0] - diff);
-	} else {
-		THREAD_TIMER_ON(master, spftree->t_spf, isis_run_spf6_l2, area, area->min_spf_interval[1] - diff);
-	}
-
-	if(isis->debugs & DEBUG_SPF_EVENTS) {
-		zlog_debug("ISIS-Spf (%s) L%d SPF scheduled %lld sec from now", area->area_tag, level, (long long) (area->min_spf_interval[level - 1] - diff));
-	}
-
-	spftree->pending = 1;
-
-	return retval;
+	return spf_schedule(area, level, AF_INET6, 1);
 }
 #endif
 
-static void isis_print_paths(struct vty *vty, struct list *paths, u_char *root_sysid) {
-	struct listnode *node;
+static void isis_print_paths(struct vty *vty, struct isis_paths *paths, u_char *root_sysid) {
 	struct listnode *anode;
 	struct isis_vertex *vertex;
 	struct isis_adjacency *adj;
@@ -1307,7 +1758,7 @@ static void isis_print_paths(struct vty *vty, struct list *paths, u_char *root_s
 		"Next-Hop             Interface Parent%s",
 		VTY_NEWLINE);
 
-	for(ALL_LIST_ELEMENTS_RO(paths, node, vertex)) {
+	TAILQ_FOREACH(vertex, paths, path_entry) {
 		if(memcmp(vertex->N.id, root_sysid, ISIS_SYS_ID_LEN) == 0) {
 			vty_out(vty, "%-20s %-12s %-6s", print_sys_hostname(root_sysid), "", "");
 			vty_out(vty, "%-30s", "");
@@ -1330,11 +1781,11 @@ static void isis_print_paths(struct vty *vty, struct list *paths, u_char *root_s
 		}
 
 		/* Print list of parents for the ECMP DAG */
-		if(listcount(vertex->parents) > 0) {
-			struct listnode *pnode;
+		if(spf_array_count(&vertex->parents) > 0) {
 			struct isis_vertex *pvertex;
+			unsigned int i;
 			int rows = 0;
-			for(ALL_LIST_ELEMENTS_RO(vertex->parents, pnode, pvertex)) {
+			for(SPF_ARRAY_ELEMENTS(&vertex->parents, i, pvertex)) {
 				if(rows) {
 					vty_out(vty, "%s", VTY_NEWLINE);
 					vty_out(vty, "%-72s", "");
@@ -1347,10 +1798,10 @@ static void isis_print_paths(struct vty *vty, struct list *paths, u_char *root_s
 		}
 
 #if 0
-      if (listcount (vertex->children) > 0) {
-	  struct listnode *cnode;
+      if (spf_array_count (&vertex->children) > 0) {
 	  struct isis_vertex *cvertex;
-	  for (ALL_LIST_ELEMENTS_RO (vertex->children, cnode, cvertex)) {
+	  unsigned int i;
+	  for (SPF_ARRAY_ELEMENTS (&vertex->children, i, cvertex)) {
 	      vty_out (vty, "%s", VTY_NEWLINE);
 	      vty_out (vty, "%-72s", "");
 	      vty_out (vty, "%s(%d) ", 
@@ -1377,15 +1828,15 @@ DEFUN(show_isis_topology, show_isis_topology_cmd, "show isis topology",
 		vty_out(vty, "Area %s:%s", area->area_tag ? area->area_tag : "null", VTY_NEWLINE);
 
 		for(level = 0; level < ISIS_LEVELS; level++) {
-			if(area->ip_circuits > 0 && area->spftree[level] && area->spftree[level]->paths->count > 0) {
+			if(area->ip_circuits > 0 && area->spftree[level] && !TAILQ_EMPTY(&area->spftree[level]->paths)) {
 				vty_out(vty, "IS-IS paths to level-%d routers that speak IP%s", level + 1, VTY_NEWLINE);
-				isis_print_paths(vty, area->spftree[level]->paths, isis->sysid);
+				isis_print_paths(vty, &area->spftree[level]->paths, isis->sysid);
 				vty_out(vty, "%s", VTY_NEWLINE);
 			}
 #ifdef HAVE_IPV6
-			if(area->ipv6_circuits > 0 && area->spftree6[level] && area->spftree6[level]->paths->count > 0) {
+			if(area->ipv6_circuits > 0 && area->spftree6[level] && !TAILQ_EMPTY(&area->spftree6[level]->paths)) {
 				vty_out(vty, "IS-IS paths to level-%d routers that speak IPv6%s", level + 1, VTY_NEWLINE);
-				isis_print_paths(vty, area->spftree6[level]->paths, isis->sysid);
+				isis_print_paths(vty, &area->spftree6[level]->paths, isis->sysid);
 				vty_out(vty, "%s", VTY_NEWLINE);
 			}
 #endif /* HAVE_IPV6 */
@@ -1411,15 +1862,15 @@ DEFUN(show_isis_topology_l1, show_isis_topology_l1_cmd, "show isis topology leve
 	for(ALL_LIST_ELEMENTS_RO(isis->area_list, node, area)) {
 		vty_out(vty, "Area %s:%s", area->area_tag ? area->area_tag : "null", VTY_NEWLINE);
 
-		if(area->ip_circuits > 0 && area->spftree[0] && area->spftree[0]->paths->count > 0) {
+		if(area->ip_circuits > 0 && area->spftree[0] && !TAILQ_EMPTY(&area->spftree[0]->paths)) {
 			vty_out(vty, "IS-IS paths to level-1 routers that speak IP%s", VTY_NEWLINE);
-			isis_print_paths(vty, area->spftree[0]->paths, isis->sysid);
+			isis_print_paths(vty, &area->spftree[0]->paths, isis->sysid);
 			vty_out(vty, "%s", VTY_NEWLINE);
 		}
 #ifdef HAVE_IPV6
-		if(area->ipv6_circuits > 0 && area->spftree6[0] && area->spftree6[0]->paths->count > 0) {
+		if(area->ipv6_circuits > 0 && area->spftree6[0] && !TAILQ_EMPTY(&area->spftree6[0]->paths)) {
 			vty_out(vty, "IS-IS paths to level-1 routers that speak IPv6%s", VTY_NEWLINE);
-			isis_print_paths(vty, area->spftree6[0]->paths, isis->sysid);
+			isis_print_paths(vty, &area->spftree6[0]->paths, isis->sysid);
 			vty_out(vty, "%s", VTY_NEWLINE);
 		}
 #endif /* HAVE_IPV6 */
@@ -1443,15 +1894,15 @@ DEFUN(show_isis_topology_l2, show_isis_topology_l2_cmd, "show isis topology leve
 	for(ALL_LIST_ELEMENTS_RO(isis->area_list, node, area)) {
 		vty_out(vty, "Area %s:%s", area->area_tag ? area->area_tag : "null", VTY_NEWLINE);
 
-		if(area->ip_circuits > 0 && area->spftree[1] && area->spftree[1]->paths->count > 0) {
+		if(area->ip_circuits > 0 && area->spftree[1] && !TAILQ_EMPTY(&area->spftree[1]->paths)) {
 			vty_out(vty, "IS-IS paths to level-2 routers that speak IP%s", VTY_NEWLINE);
-			isis_print_paths(vty, area->spftree[1]->paths, isis->sysid);
+			isis_print_paths(vty, &area->spftree[1]->paths, isis->sysid);
 			vty_out(vty, "%s", VTY_NEWLINE);
 		}
 #ifdef HAVE_IPV6
-		if(area->ipv6_circuits > 0 && area->spftree6[1] && area->spftree6[1]->paths->count > 0) {
+		if(area->ipv6_circuits > 0 && area->spftree6[1] && !TAILQ_EMPTY(&area->spftree6[1]->paths)) {
 			vty_out(vty, "IS-IS paths to level-2 routers that speak IPv6%s", VTY_NEWLINE);
-			isis_print_paths(vty, area->spftree6[1]->paths, isis->sysid);
+			isis_print_paths(vty, &area->spftree6[1]->paths, isis->sysid);
 			vty_out(vty, "%s", VTY_NEWLINE);
 		}
 #endif /* HAVE_IPV6 */
@@ -24,6 +24,11 @@
 #ifndef _ZEBRA_ISIS_SPF_H
 #define _ZEBRA_ISIS_SPF_H
 
+#include "queue.h"
+#include "spf.h"
+
+struct isis_spf_job;
+
 enum vertextype {
 	VTYPE_PSEUDO_IS = 1,
 	VTYPE_PSEUDO_TE_IS,
@@ -53,18 +58,30 @@ struct isis_vertex {
 
 	u_int32_t d_N;	       /* d(N) Distance from this IS      */
 	u_int16_t depth;       /* The depth in the imaginary tree */
-	struct list *Adj_N;    /* {Adj(N)} next hop or neighbor list */
-	struct list *parents;  /* list of parents for ECMP */
-	struct list *children; /* list of children used for tree dump */
+	struct list *Adj_N;	   /* {Adj(N)} next hop or neighbor list */
+	struct spf_array parents;  /* parents for ECMP */
+	struct spf_array children; /* children used for tree dump */
+	int tent_pos;		   /* position on TENT */
+	int on_paths;		   /* moved from TENT to PATHS */
+	TAILQ_ENTRY(isis_vertex) path_entry; /* on PATHS */
 };
 
+TAILQ_HEAD(isis_paths, isis_vertex);
+
 struct isis_spftree {
 	struct thread *t_spf;	   /* spf threads */
-	struct list *paths;	   /* the SPT */
-	struct list *tents;	   /* TENT */
+	struct isis_paths paths;   /* the SPT, in the order found */
+	struct spf_heap *tents;	   /* TENT */
+	u_int32_t tent_seq;	   /* vertices added to TENT this run */
+	struct spf_pool *pool;	   /* vertices are allocated from */
+	struct hash *vertex_hash;  /* TENT and PATHS by type and id */
 	struct isis_area *area;	   /* back pointer to area */
+	u_int16_t mtid;		   /* topology of the last full run */
+	struct isis_spf_job *job;  /* the run under way */
 	int pending;		   /* already scheduled */
+	int full;		   /* the run has to rebuild the SPT, not just the PRC */
 	unsigned int runcount;	   /* number of runs since uptime */
+	unsigned int prc_runcount; /* number of PRC runs since uptime */
 	time_t last_run_timestamp; /* last run timestamp for scheduling */
 	time_t last_run_duration;  /* last run duration in msec */
 };
@@ -76,6 +93,7 @@ void spftree_area_init(struct isis_area *area);
 void spftree_area_del(struct isis_area *area);
 void spftree_area_adj_del(struct isis_area *area, struct isis_adjacency *adj);
 int isis_spf_schedule(struct isis_area *area, int level);
+int isis_spf_schedule_lsp(struct isis_area *area, int level, u_char *lsp_id, int topology);
 void isis_spf_cmds_init(void);
 #ifdef HAVE_IPV6
 int isis_spf_schedule6(struct isis_area *area, int level);
@@ -42,7 +42,6 @@
 #include "sockunion.h"
 #include "network.h"
 
-#include "isisd/dict.h"
 #include "isisd/isis_constants.h"
 #include "isisd/isis_common.h"
 #include "isisd/isis_flags.h"
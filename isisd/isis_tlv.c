@@ -31,7 +31,6 @@
 #include "vty.h"
 #include "if.h"
 
-#include "isisd/dict.h"
 #include "isisd/isis_constants.h"
 #include "isisd/isis_common.h"
 #include "isisd/isis_flags.h"
@@ -64,6 +63,12 @@ void free_tlvs(struct tlvs *tlvs) {
 	if(tlvs->te_is_neighs) {
 		list_delete(tlvs->te_is_neighs);
 	}
+	if(tlvs->mt_is_neighs) {
+		list_delete(tlvs->mt_is_neighs);
+	}
+	if(tlvs->mt_router_info) {
+		list_delete(tlvs->mt_router_info);
+	}
 	if(tlvs->es_neighs) {
 		list_delete(tlvs->es_neighs);
 	}
@@ -95,6 +100,9 @@ void free_tlvs(struct tlvs *tlvs) {
 	if(tlvs->ipv6_reachs) {
 		list_delete(tlvs->ipv6_reachs);
 	}
+	if(tlvs->mt_ipv6_reachs) {
+		list_delete(tlvs->mt_ipv6_reachs);
+	}
 #endif /* HAVE_IPV6 */
 
 	memset(tlvs, 0, sizeof(struct tlvs));
@@ -112,6 +120,8 @@ int parse_tlvs(char *areatag, u_char *stream, int size, u_int32_t *expected, u_i
 	struct area_addr *area_addr;
 	struct is_neigh *is_nei;
 	struct te_is_neigh *te_is_nei;
+	struct mt_is_neigh *mt_is_nei;
+	struct mt_router_info *mt_info;
 	struct es_neigh *es_nei;
 	struct lsp_entry *lsp_entry;
 	struct in_addr *ipv4_addr;
@@ -123,6 +133,7 @@ int parse_tlvs(char *areatag, u_char *stream, int size, u_int32_t *expected, u_i
 	int prefix_octets;
 #endif /* HAVE_IPV6 */
 	int value_len, retval = ISIS_OK;
+	u_int16_t mtid;
 	u_char *start = stream, *pnt = stream, *endpnt;
 
 	*found = 0;
@@ -254,6 +265,66 @@ int parse_tlvs(char *areatag, u_char *stream, int size, u_int32_t *expected, u_i
 				}
 				break;
 
+			case MT_IS_NEIGHBOURS:
+				/* +-------+-------+-------+-------+-------+-------+-------+-------+
+	   * |   R   |   R   |   R   |   R   |          MT ID                | 2
+	   * +---------------------------------------------------------------+
+	   * |              Extended IS Reachability entries                 |
+	   * +---------------------------------------------------------------+
+	   * :                                                               :
+	   */
+				*found |= TLVFLAG_MT_IS_NEIGHS;
+				endpnt = pnt + length;
+				if((TLVFLAG_MT_IS_NEIGHS & *expected) && length >= MT_ID_LEN) {
+					mtid = ((pnt[0] << 8) | pnt[1]) & ISIS_MT_MASK;
+					pnt += MT_ID_LEN;
+					while(pnt + IS_NEIGHBOURS_LEN <= endpnt) {
+						te_is_nei = (struct te_is_neigh *) pnt;
+						/* sub-TLVs are skipped, TE is done in the standard topology */
+						if(pnt + IS_NEIGHBOURS_LEN + te_is_nei->sub_tlvs_length > endpnt) {
+							break;
+						}
+						mt_is_nei = XCALLOC(MTYPE_ISIS_TLV, sizeof(struct mt_is_neigh));
+						mt_is_nei->mtid = mtid;
+						memcpy(mt_is_nei->neigh_id, te_is_nei->neigh_id, ISIS_SYS_ID_LEN + 1);
+						memcpy(mt_is_nei->te_metric, te_is_nei->te_metric, 3);
+						pnt += IS_NEIGHBOURS_LEN + te_is_nei->sub_tlvs_length;
+						if(!tlvs->mt_is_neighs) {
+							tlvs->mt_is_neighs = list_new();
+							tlvs->mt_is_neighs->del = free_tlv;
+						}
+						listnode_add(tlvs->mt_is_neighs, mt_is_nei);
+					}
+				}
+				pnt = endpnt;
+				break;
+
+			case MT_ROUTER_INFO:
+				/* +-------+-------+-------+-------+-------+-------+-------+-------+
+	   * |   O   |   A   |   R   |   R   |          MT ID                | 2
+	   * +---------------------------------------------------------------+
+	   * :                                                               :
+	   */
+				*found |= TLVFLAG_MT_ROUTER_INFO;
+				if(TLVFLAG_MT_ROUTER_INFO & *expected) {
+					while(length >= value_len + MT_ID_LEN) {
+						mtid = (pnt[0] << 8) | pnt[1];
+						mt_info = XCALLOC(MTYPE_ISIS_TLV, sizeof(struct mt_router_info));
+						mt_info->mtid = mtid & ISIS_MT_MASK;
+						mt_info->overload = (mtid & ISIS_MT_OL_MASK) ? 1 : 0;
+						mt_info->attached = (mtid & ISIS_MT_AT_MASK) ? 1 : 0;
+						value_len += MT_ID_LEN;
+						pnt += MT_ID_LEN;
+						if(!tlvs->mt_router_info) {
+							tlvs->mt_router_info = list_new();
+							tlvs->mt_router_info->del = free_tlv;
+						}
+						listnode_add(tlvs->mt_router_info, mt_info);
+					}
+				}
+				pnt += length - value_len;
+				break;
+
 			case ES_NEIGHBOURS:
 				/* +-------+-------+-------+-------+-------+-------+-------+-------+
 	   * |   0   |  I/E  |               Default Metric                  | 
@@ -652,6 +723,19 @@ int parse_tlvs(char *areatag, u_char *stream, int size, u_int32_t *expected, u_i
 				break;
 #endif /* HAVE_IPV6 */
 
+			case MT_IPV4_REACHABILITY:
+				/* read in place by tlv_reach_iter_next() */
+				*found |= TLVFLAG_MT_IPV4_REACHABILITY;
+				pnt += length;
+				break;
+
+#ifdef HAVE_IPV6
+			case MT_IPV6_REACHABILITY:
+				*found |= TLVFLAG_MT_IPV6_REACHABILITY;
+				pnt += length;
+				break;
+#endif /* HAVE_IPV6 */
+
 			case WAY3_HELLO:
 				/* +---------------------------------------------------------------+
 	   * |                  Adjacency state                              | 1
@@ -711,6 +795,147 @@ int parse_tlvs(char *areatag, u_char *stream, int size, u_int32_t *expected, u_i
 	return retval;
 }
 
+void tlv_reach_iter_init(struct tlv_reach_iter *iter, u_char *stream, int size, u_int32_t types) {
+	iter->pnt = stream;
+	iter->end = stream + size;
+	iter->vpnt = iter->vend = NULL;
+	iter->type = 0;
+	iter->mtid = 0;
+	iter->types = types;
+}
+
+static u_int32_t tlv_reach_flag(u_char type) {
+	switch(type) {
+		case IPV4_INT_REACHABILITY: return TLVFLAG_IPV4_INT_REACHABILITY;
+		case IPV4_EXT_REACHABILITY: return TLVFLAG_IPV4_EXT_REACHABILITY;
+		case TE_IPV4_REACHABILITY: return TLVFLAG_TE_IPV4_REACHABILITY;
+		case MT_IPV4_REACHABILITY: return TLVFLAG_MT_IPV4_REACHABILITY;
+#ifdef HAVE_IPV6
+		case IPV6_REACHABILITY: return TLVFLAG_IPV6_REACHABILITY;
+		case MT_IPV6_REACHABILITY: return TLVFLAG_MT_IPV6_REACHABILITY;
+#endif /* HAVE_IPV6 */
+		default: return 0;
+	}
+}
+
+/*
+ * Next entry of the TLVs asked for, returns 0 when there are no more.
+ * An entry that doesn't fit its TLV, or has a bad prefix length, ends
+ * that TLV; a TLV that doesn't fit the PDU ends the walk, as it ends
+ * parse_tlvs().
+ */
+int tlv_reach_iter_next(struct tlv_reach_iter *iter, struct tlv_reach *reach) {
+	u_char *pnt, *next;
+	u_char control;
+	u_int32_t metric;
+	struct in_addr mask;
+	int prefixlen;
+
+	for(;;) {
+		while(iter->vpnt == NULL || iter->vpnt >= iter->vend) {
+			if(iter->pnt + 2 > iter->end) {
+				return 0;
+			}
+			iter->type = iter->pnt[0];
+			iter->vpnt = iter->pnt + 2;
+			iter->vend = iter->vpnt + iter->pnt[1];
+			if(iter->vend > iter->end) {
+				iter->pnt = iter->end;
+				return 0;
+			}
+			iter->pnt = iter->vend;
+			iter->mtid = 0;
+			if(!(tlv_reach_flag(iter->type) & iter->types)) {
+				iter->vpnt = iter->vend;
+			} else if(iter->type == MT_IPV4_REACHABILITY || iter->type == MT_IPV6_REACHABILITY) {
+				if(iter->vpnt + MT_ID_LEN > iter->vend) {
+					iter->vpnt = iter->vend;
+					continue;
+				}
+				iter->mtid = ((iter->vpnt[0] << 8) | iter->vpnt[1]) & ISIS_MT_MASK;
+				iter->vpnt += MT_ID_LEN;
+			}
+		}
+
+		pnt = iter->vpnt;
+		memset(&reach->prefix, 0, sizeof(struct prefix));
+		reach->type = iter->type;
+		reach->mtid = iter->mtid;
+		next = NULL;
+
+		switch(iter->type) {
+			case IPV4_INT_REACHABILITY:
+			case IPV4_EXT_REACHABILITY:
+				if(pnt + 12 > iter->vend) {
+					break;
+				}
+				reach->external = (iter->type == IPV4_EXT_REACHABILITY);
+				reach->metric = pnt[0];
+				reach->prefix.family = AF_INET;
+				memcpy(&reach->prefix.u.prefix4, pnt + 4, IPV4_MAX_BYTELEN);
+				memcpy(&mask, pnt + 8, IPV4_MAX_BYTELEN);
+				reach->prefix.prefixlen = ip_masklen(mask);
+				next = pnt + 12;
+				break;
+
+			case TE_IPV4_REACHABILITY:
+			case MT_IPV4_REACHABILITY:
+				if(pnt + 5 > iter->vend) {
+					break;
+				}
+				control = pnt[4];
+				prefixlen = control & 0x3F;
+				if(prefixlen > IPV4_MAX_BITLEN || pnt + 5 + PSIZE(prefixlen) > iter->vend) {
+					break;
+				}
+				memcpy(&metric, pnt, sizeof(metric));
+				reach->external = 0;
+				reach->metric = ntohl(metric);
+				reach->prefix.family = AF_INET;
+				reach->prefix.u.prefix4 = newprefix2inaddr(pnt + 5, control);
+				reach->prefix.prefixlen = prefixlen;
+				next = pnt + 5 + PSIZE(prefixlen);
+				/* sub-TLVs present */
+				if((control & 0x40) && next < iter->vend) {
+					next += 1 + *next;
+				}
+				break;
+
+#ifdef HAVE_IPV6
+			case IPV6_REACHABILITY:
+			case MT_IPV6_REACHABILITY:
+				if(pnt + 6 > iter->vend) {
+					break;
+				}
+				control = pnt[4];
+				prefixlen = pnt[5];
+				if(prefixlen > IPV6_MAX_BITLEN || pnt + 6 + PSIZE(prefixlen) > iter->vend) {
+					break;
+				}
+				memcpy(&metric, pnt, sizeof(metric));
+				reach->external = (control & CTRL_INFO_DISTRIBUTION) ? 1 : 0;
+				reach->metric = ntohl(metric);
+				reach->prefix.family = AF_INET6;
+				memcpy(&reach->prefix.u.prefix6, pnt + 6, PSIZE(prefixlen));
+				reach->prefix.prefixlen = prefixlen;
+				next = pnt + 6 + PSIZE(prefixlen);
+				if((control & CTRL_INFO_SUBTLVS) && next < iter->vend) {
+					next += 1 + *next;
+				}
+				break;
+#endif /* HAVE_IPV6 */
+		}
+
+		if(next == NULL || next > iter->vend) {
+			/* malformed, skip the rest of the TLV */
+			iter->vpnt = iter->vend;
+			continue;
+		}
+		iter->vpnt = next;
+		return 1;
+	}
+}
+
 int add_tlv(u_char tag, u_char len, u_char *value, struct stream *stream) {
 	if((stream_get_size(stream) - stream_get_endp(stream)) < (((unsigned) len) + 2)) {
 		zlog_warn(
@@ -822,6 +1047,80 @@ int tlv_add_te_is_neighs(struct list *te_is_neighs, struct stream *stream) {
 	return add_tlv(TE_IS_NEIGHBOURS, pos - value, value, stream);
 }
 
+/* one TLV per MT ID, the entries of an MT ID are expected to be together */
+int tlv_add_mt_is_neighs(struct list *mt_is_neighs, struct stream *stream) {
+	struct listnode *node;
+	struct mt_is_neigh *mt_is_neigh;
+	u_char value[255];
+	u_char *pos = value;
+	int retval;
+
+	for(ALL_LIST_ELEMENTS_RO(mt_is_neighs, node, mt_is_neigh)) {
+		if(pos != value && (pos - value + IS_NEIGHBOURS_LEN > 255 || (((value[0] << 8) | value[1]) != mt_is_neigh->mtid))) {
+			retval = add_tlv(MT_IS_NEIGHBOURS, pos - value, value, stream);
+			if(retval != ISIS_OK) {
+				return retval;
+			}
+			pos = value;
+		}
+		if(pos == value) {
+			*pos++ = mt_is_neigh->mtid >> 8;
+			*pos++ = mt_is_neigh->mtid & 0xff;
+		}
+
+		memcpy(pos, mt_is_neigh->neigh_id, ISIS_SYS_ID_LEN + 1);
+		pos += ISIS_SYS_ID_LEN + 1;
+		memcpy(pos, mt_is_neigh->te_metric, 3);
+		pos += 3;
+		*pos++ = 0; /* no sub-TLVs */
+	}
+
+	if(pos == value) {
+		return ISIS_OK;
+	}
+	return add_tlv(MT_IS_NEIGHBOURS, pos - value, value, stream);
+}
+
+int tlv_add_mt_router_info(struct list *mt_router_info, struct stream *stream) {
+	struct listnode *node;
+	struct mt_router_info *mt_info;
+	u_char value[255];
+	u_char *pos = value;
+	u_int16_t mtid;
+
+	for(ALL_LIST_ELEMENTS_RO(mt_router_info, node, mt_info)) {
+		if(pos - value + MT_ID_LEN > 255) {
+			break;
+		}
+		mtid = mt_info->mtid & ISIS_MT_MASK;
+		if(mt_info->overload) {
+			mtid |= ISIS_MT_OL_MASK;
+		}
+		if(mt_info->attached) {
+			mtid |= ISIS_MT_AT_MASK;
+		}
+		*pos++ = mtid >> 8;
+		*pos++ = mtid & 0xff;
+	}
+
+	return add_tlv(MT_ROUTER_INFO, pos - value, value, stream);
+}
+
+struct mt_router_info *tlv_mt_router_info(struct list *mt_router_info, u_int16_t mtid) {
+	struct listnode *node;
+	struct mt_router_info *mt_info;
+
+	if(mt_router_info) {
+		for(ALL_LIST_ELEMENTS_RO(mt_router_info, node, mt_info)) {
+			if(mt_info->mtid == mtid) {
+				return mt_info;
+			}
+		}
+	}
+
+	return NULL;
+}
+
 int tlv_add_lan_neighs(struct list *lan_neighs, struct stream *stream) {
 	struct listnode *node;
 	u_char *snpa;
@@ -913,6 +1212,7 @@ int tlv_add_lsp_entries(struct list *lsps, struct stream *stream) {
 			}
 			pos = value;
 		}
+		lsp_set_time(lsp);
 		*((u_int16_t *) pos) = lsp->lsp_header->rem_lifetime;
 		pos += 2;
 		memcpy(pos, lsp->lsp_header->lsp_id, ISIS_SYS_ID_LEN + 2);
@@ -1018,20 +1318,25 @@ int tlv_add_ipv6_addrs(struct list *ipv6_addrs, struct stream *stream) {
 	return add_tlv(IPV6_ADDR, pos - value, value, stream);
 }
 
-int tlv_add_ipv6_reachs(struct list *ipv6_reachs, struct stream *stream) {
+/* TLV 236, or TLV 237 when there is an MT ID to start each TLV with */
+static int tlv_add_ipv6_reachs_mt(u_char tag, u_char *mtid, struct list *ipv6_reachs, struct stream *stream) {
 	struct listnode *node;
 	struct ipv6_reachability *ip6reach;
 	u_char value[255];
-	u_char *pos = value;
+	u_char *start = value + (mtid ? MT_ID_LEN : 0);
+	u_char *pos = start;
 	int retval, prefix_octets;
 
+	if(mtid) {
+		memcpy(value, mtid, MT_ID_LEN);
+	}
 	for(ALL_LIST_ELEMENTS_RO(ipv6_reachs, node, ip6reach)) {
 		if(pos - value + IPV6_MAX_BYTELEN + 6 > 255) {
-			retval = add_tlv(IPV6_REACHABILITY, pos - value, value, stream);
+			retval = add_tlv(tag, pos - value, value, stream);
 			if(retval != ISIS_OK) {
 				return retval;
 			}
-			pos = value;
+			pos = start;
 		}
 		*(uint32_t *) pos = ip6reach->metric;
 		pos += 4;
@@ -1044,7 +1349,17 @@ int tlv_add_ipv6_reachs(struct list *ipv6_reachs, struct stream *stream) {
 		pos += prefix_octets;
 	}
 
-	return add_tlv(IPV6_REACHABILITY, pos - value, value, stream);
+	return add_tlv(tag, pos - value, value, stream);
+}
+
+int tlv_add_ipv6_reachs(struct list *ipv6_reachs, struct stream *stream) {
+	return tlv_add_ipv6_reachs_mt(IPV6_REACHABILITY, NULL, ipv6_reachs, stream);
+}
+
+int tlv_add_mt_ipv6_reachs(struct list *ipv6_reachs, struct stream *stream) {
+	u_char mtid[MT_ID_LEN] = {ISIS_MT_IPV6_UNICAST >> 8, ISIS_MT_IPV6_UNICAST & 0xff};
+
+	return tlv_add_ipv6_reachs_mt(MT_IPV6_REACHABILITY, mtid, ipv6_reachs, stream);
 }
 #endif /* HAVE_IPV6 */
 
@@ -99,6 +99,7 @@
 #define AUTH_INFO 10
 #define CHECKSUM 12
 #define TE_IS_NEIGHBOURS 22
+#define MT_IS_NEIGHBOURS 222
 #define IS_ALIAS 24
 #define IPV4_INT_REACHABILITY 128
 #define PROTOCOLS_SUPPORTED 129
@@ -109,8 +110,11 @@
 #define TE_IPV4_REACHABILITY 135
 #define DYNAMIC_HOSTNAME 137
 #define GRACEFUL_RESTART 211
+#define MT_ROUTER_INFO 229
 #define IPV6_ADDR 232
+#define MT_IPV4_REACHABILITY 235
 #define IPV6_REACHABILITY 236
+#define MT_IPV6_REACHABILITY 237
 #define WAY3_HELLO 240
 #define ROUTER_INFORMATION 242
 
@@ -124,6 +128,18 @@
 #define IPV4_REACH_LEN 12
 #define IPV6_REACH_LEN 22
 #define TE_IPV4_REACH_LEN 9
+#define MT_ID_LEN 2
+
+/* RFC5120 topologies, and the bits around the MT ID */
+#define ISIS_MT_IPV4_UNICAST 0
+#define ISIS_MT_IPV4_MGMT 1
+#define ISIS_MT_IPV6_UNICAST 2
+#define ISIS_MT_IPV4_MULTICAST 3
+#define ISIS_MT_IPV6_MULTICAST 4
+#define ISIS_MT_IPV6_MGMT 5
+#define ISIS_MT_MASK 0x0fff
+#define ISIS_MT_OL_MASK 0x8000
+#define ISIS_MT_AT_MASK 0x4000
 
 #define MAX_SUBTLV_SIZE 256
 
@@ -146,6 +162,20 @@ struct te_is_neigh {
 	u_char sub_tlvs[MAX_SUBTLV_SIZE]; /* SUB TLVs storage */
 };
 
+/* struct for MT IS reachability, decoded since the MT ID is per TLV */
+struct mt_is_neigh {
+	u_int16_t mtid;
+	u_char neigh_id[ISIS_SYS_ID_LEN + 1];
+	u_char te_metric[3];
+};
+
+/* struct for a topology of the MT TLV */
+struct mt_router_info {
+	u_int16_t mtid;
+	u_char overload;
+	u_char attached;
+};
+
 /* Decode and encode three-octet metric into host byte order integer */
 #define GET_TE_METRIC(t) (((unsigned) (t)->te_metric[0] << 16) | ((t)->te_metric[1] << 8) | (t)->te_metric[2])
 #define SET_TE_METRIC(t, m) (((t)->te_metric[0] = (m) >> 16), ((t)->te_metric[1] = (m) >> 8), ((t)->te_metric[2] = (m)))
@@ -243,6 +273,8 @@ struct tlvs {
 	struct list *area_addrs;
 	struct list *is_neighs;
 	struct list *te_is_neighs;
+	struct list *mt_is_neighs;
+	struct list *mt_router_info;
 	struct list *es_neighs;
 	struct list *lsp_entries;
 	struct list *prefix_neighs;
@@ -254,6 +286,7 @@ struct tlvs {
 #ifdef HAVE_IPV6
 	struct list *ipv6_addrs;
 	struct list *ipv6_reachs;
+	struct list *mt_ipv6_reachs; /* own LSPs, ipv6-unicast topology */
 #endif
 	struct isis_passwd auth_info;
 };
@@ -284,16 +317,51 @@ struct tlvs {
 #define TLVFLAG_TE_ROUTER_ID (1 << 19)
 #define TLVFLAG_CHECKSUM (1 << 20)
 #define TLVFLAG_GRACEFUL_RESTART (1 << 21)
+#define TLVFLAG_MT_IS_NEIGHS (1 << 22)
+#define TLVFLAG_MT_ROUTER_INFO (1 << 23)
+#define TLVFLAG_MT_IPV4_REACHABILITY (1 << 24)
+#define TLVFLAG_MT_IPV6_REACHABILITY (1 << 25)
+
+/*
+ * One IP reachability entry (TLV 128, 130, 135, 235, 236 or 237) as read
+ * by tlv_reach_iter_next(), the prefix as sent, not masked
+ */
+struct tlv_reach {
+	u_char type;	  /* of the TLV it came in */
+	u_int16_t mtid;	  /* of TLV 235 and 237, 0 for the others */
+	int external;	  /* TLV 130, or the distribution bit of TLV 236/237 */
+	u_int32_t metric; /* default metric, host order */
+	struct prefix prefix;
+};
+
+/*
+ * Walks the IP reachability TLVs of a PDU in place, so they need not be
+ * decoded to lists by parse_tlvs()
+ */
+struct tlv_reach_iter {
+	u_char *pnt;	 /* next TLV */
+	u_char *end;	 /* end of the TLVs */
+	u_char *vpnt;	 /* next entry in the TLV at hand */
+	u_char *vend;	 /* end of the TLV at hand */
+	u_char type;	 /* of the TLV at hand */
+	u_int16_t mtid;	 /* of the TLV at hand */
+	u_int32_t types; /* TLVFLAG_*_REACHABILITY to walk */
+};
 
 void init_tlvs(struct tlvs *tlvs, uint32_t expected);
 void free_tlvs(struct tlvs *tlvs);
 int parse_tlvs(char *areatag, u_char *stream, int size, u_int32_t *expected, u_int32_t *found, struct tlvs *tlvs, u_int32_t *auth_tlv_offset);
 int add_tlv(u_char, u_char, u_char *, struct stream *);
+void tlv_reach_iter_init(struct tlv_reach_iter *iter, u_char *stream, int size, u_int32_t types);
+int tlv_reach_iter_next(struct tlv_reach_iter *iter, struct tlv_reach *reach);
 void free_tlv(void *val);
 
 int tlv_add_area_addrs(struct list *area_addrs, struct stream *stream);
 int tlv_add_is_neighs(struct list *is_neighs, struct stream *stream);
 int tlv_add_te_is_neighs(struct list *te_is_neighs, struct stream *stream);
+int tlv_add_mt_is_neighs(struct list *mt_is_neighs, struct stream *stream);
+int tlv_add_mt_router_info(struct list *mt_router_info, struct stream *stream);
+struct mt_router_info *tlv_mt_router_info(struct list *mt_router_info, u_int16_t mtid);
 int tlv_add_lan_neighs(struct list *lan_neighs, struct stream *stream);
 int tlv_add_nlpid(struct nlpids *nlpids, struct stream *stream);
 int tlv_add_checksum(struct checksum *checksum, struct stream *stream);
@@ -308,6 +376,7 @@ int tlv_add_te_ipv4_reachs(struct list *te_ipv4_reachs, struct stream *stream);
 #ifdef HAVE_IPV6
 int tlv_add_ipv6_addrs(struct list *ipv6_addrs, struct stream *stream);
 int tlv_add_ipv6_reachs(struct list *ipv6_reachs, struct stream *stream);
+int tlv_add_mt_ipv6_reachs(struct list *ipv6_reachs, struct stream *stream);
 #endif /* HAVE_IPV6 */
 
 int tlv_add_padding(struct stream *stream);
@@ -28,6 +28,7 @@
 #include "isis_csm.h"
 #include "isis_misc.h"
 #include "isisd.h"
+#include "isis_bfd.h"
 
 static struct isis_circuit *isis_circuit_lookup(struct vty *vty) {
 	struct interface *ifp;
@@ -165,6 +166,86 @@ DEFUN(no_isis_passive, no_isis_passive_cmd, "no isis passive",
 	return CMD_SUCCESS;
 }
 
+DEFUN(isis_mesh_group, isis_mesh_group_cmd, "isis mesh-group <1-4294967295>",
+      "IS-IS commands\n"
+      "Set mesh group membership, RFC 2973\n"
+      "Mesh group number\n") {
+	u_int32_t mesh_group;
+	struct isis_circuit *circuit = isis_circuit_lookup(vty);
+	if(!circuit) {
+		return CMD_ERR_NO_MATCH;
+	}
+
+	VTY_GET_INTEGER_RANGE("mesh group", mesh_group, argv[0], 1, 4294967295U);
+	circuit->mesh_group = mesh_group;
+	circuit->mesh_blocked = 0;
+
+	return CMD_SUCCESS;
+}
+
+DEFUN(isis_mesh_group_blocked, isis_mesh_group_blocked_cmd, "isis mesh-group blocked",
+      "IS-IS commands\n"
+      "Set mesh group membership, RFC 2973\n"
+      "Don't flood LSPs on this interface\n") {
+	struct isis_circuit *circuit = isis_circuit_lookup(vty);
+	if(!circuit) {
+		return CMD_ERR_NO_MATCH;
+	}
+
+	circuit->mesh_group = 0;
+	circuit->mesh_blocked = 1;
+
+	return CMD_SUCCESS;
+}
+
+DEFUN(no_isis_mesh_group, no_isis_mesh_group_cmd, "no isis mesh-group",
+      NO_STR "IS-IS commands\n"
+	     "Set mesh group membership, RFC 2973\n") {
+	struct isis_circuit *circuit = isis_circuit_lookup(vty);
+	if(!circuit) {
+		return CMD_ERR_NO_MATCH;
+	}
+
+	circuit->mesh_group = 0;
+	circuit->mesh_blocked = 0;
+
+	return CMD_SUCCESS;
+}
+
+ALIAS(no_isis_mesh_group, no_isis_mesh_group_arg_cmd, "no isis mesh-group (<1-4294967295>|blocked)",
+      NO_STR "IS-IS commands\n"
+	     "Set mesh group membership, RFC 2973\n"
+	     "Mesh group number\n"
+	     "Don't flood LSPs on this interface\n")
+
+DEFUN(isis_bfd, isis_bfd_cmd, "isis bfd",
+      "IS-IS commands\n"
+      "Detect adjacency failures with BFD\n") {
+	struct isis_circuit *circuit = isis_circuit_lookup(vty);
+	if(!circuit) {
+		return CMD_ERR_NO_MATCH;
+	}
+
+	circuit->bfd = 1;
+	isis_bfd_circuit_update(circuit);
+
+	return CMD_SUCCESS;
+}
+
+DEFUN(no_isis_bfd, no_isis_bfd_cmd, "no isis bfd",
+      NO_STR "IS-IS commands\n"
+	     "Detect adjacency failures with BFD\n") {
+	struct isis_circuit *circuit = isis_circuit_lookup(vty);
+	if(!circuit) {
+		return CMD_ERR_NO_MATCH;
+	}
+
+	circuit->bfd = 0;
+	isis_bfd_circuit_update(circuit);
+
+	return CMD_SUCCESS;
+}
+
 DEFUN(isis_circuit_type, isis_circuit_type_cmd, "isis circuit-type (level-1|level-1-2|level-2-only)",
       "IS-IS commands\n"
       "Configure circuit type for interface\n"
@@ -1236,6 +1317,29 @@ DEFUN(no_set_attached_bit, no_set_attached_bit_cmd, "no set-attached-bit", "Rese
 	return CMD_SUCCESS;
 }
 
+#ifdef HAVE_IPV6
+DEFUN(topology_ipv6, topology_ipv6_cmd, "topology ipv6-unicast",
+      "Configure IS-IS topologies\n"
+      "IPv6 unicast topology (RFC5120)\n") {
+	struct isis_area *area = vty->index;
+	assert(area);
+
+	isis_area_mt_ipv6_set(area, true);
+	return CMD_SUCCESS;
+}
+
+DEFUN(no_topology_ipv6, no_topology_ipv6_cmd, "no topology ipv6-unicast",
+      NO_STR
+      "Configure IS-IS topologies\n"
+      "IPv6 unicast topology (RFC5120)\n") {
+	struct isis_area *area = vty->index;
+	assert(area);
+
+	isis_area_mt_ipv6_set(area, false);
+	return CMD_SUCCESS;
+}
+#endif /* HAVE_IPV6 */
+
 DEFUN(dynamic_hostname, dynamic_hostname_cmd, "hostname dynamic",
       "Dynamic hostname for IS-IS\n"
       "Dynamic hostname\n") {
@@ -1828,6 +1932,13 @@ void isis_vty_init(void) {
 	install_element(INTERFACE_NODE, &isis_passive_cmd);
 	install_element(INTERFACE_NODE, &no_isis_passive_cmd);
 
+	install_element(INTERFACE_NODE, &isis_mesh_group_cmd);
+	install_element(INTERFACE_NODE, &isis_mesh_group_blocked_cmd);
+	install_element(INTERFACE_NODE, &no_isis_mesh_group_cmd);
+	install_element(INTERFACE_NODE, &no_isis_mesh_group_arg_cmd);
+	install_element(INTERFACE_NODE, &isis_bfd_cmd);
+	install_element(INTERFACE_NODE, &no_isis_bfd_cmd);
+
 	install_element(INTERFACE_NODE, &isis_circuit_type_cmd);
 	install_element(INTERFACE_NODE, &no_isis_circuit_type_cmd);
 
@@ -1909,6 +2020,10 @@ void isis_vty_init(void) {
 
 	install_element(ISIS_NODE, &set_attached_bit_cmd);
 	install_element(ISIS_NODE, &no_set_attached_bit_cmd);
+#ifdef HAVE_IPV6
+	install_element(ISIS_NODE, &topology_ipv6_cmd);
+	install_element(ISIS_NODE, &no_topology_ipv6_cmd);
+#endif /* HAVE_IPV6 */
 
 	install_element(ISIS_NODE, &dynamic_hostname_cmd);
 	install_element(ISIS_NODE, &no_dynamic_hostname_cmd);
@@ -35,7 +35,6 @@
 #include "linklist.h"
 #include "vrf.h"
 
-#include "isisd/dict.h"
 #include "isisd/isis_constants.h"
 #include "isisd/isis_common.h"
 #include "isisd/isis_flags.h"
@@ -49,6 +48,7 @@
 #include "isisd/isis_route.h"
 #include "isisd/isis_zebra.h"
 #include "isisd/isis_te.h"
+#include "isisd/isis_bfd.h"
 
 struct zclient *zclient = NULL;
 
@@ -122,7 +122,7 @@ static int isis_zebra_if_del(int command, struct zclient *zclient, zebra_size_t
      in case there is configuration info attached to it. */
 	if_delete_retain(ifp);
 
-	ifp->ifindex = IFINDEX_INTERNAL;
+	if_set_index(ifp, IFINDEX_INTERNAL);
 
 	return 0;
 }
@@ -645,6 +645,7 @@ void isis_zebra_redistribute_unset(int type) {
 
 static void isis_zebra_connected(struct zclient *zclient) {
 	zclient_send_requests(zclient, VRF_DEFAULT);
+	isis_bfd_register_all();
 }
 
 void isis_zebra_init(struct thread_master *master) {
@@ -661,6 +662,7 @@ void isis_zebra_init(struct thread_master *master) {
 	zclient->interface_link_params = isis_zebra_link_params;
 	zclient->ipv4_route_add = isis_zebra_read_ipv4;
 	zclient->ipv4_route_delete = isis_zebra_read_ipv4;
+	zclient->bfd_update = isis_bfd_update;
 #ifdef HAVE_IPV6
 	zclient->ipv6_route_add = isis_zebra_read_ipv6;
 	zclient->ipv6_route_delete = isis_zebra_read_ipv6;
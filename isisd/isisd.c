@@ -35,7 +35,6 @@
 #include "prefix.h"
 #include "table.h"
 
-#include "isisd/dict.h"
 #include "isisd/include-netbsd/iso.h"
 #include "isisd/isis_constants.h"
 #include "isisd/isis_common.h"
@@ -135,6 +134,7 @@ struct isis_area *isis_area_create(const char *area_tag) {
 
 	area->circuit_list = list_new();
 	area->area_addrs = list_new();
+	area->lsp_srm_list = list_new();
 	THREAD_TIMER_ON(master, area->t_tick, lsp_tick, area, 1);
 	flags_initialize(&area->flags);
 
@@ -153,6 +153,7 @@ struct isis_area *isis_area_create(const char *area_tag) {
 	area->oldmetric = 0;
 	area->newmetric = 1;
 	area->lsp_frag_threshold = 90;
+	area->redist_delay = DEFAULT_REDIST_DELAY;
 	area->lsp_mtu = DEFAULT_LSP_MTU;
 #ifdef TOPOLOGY_GENERATE
 	memcpy(area->topology_baseis, DEFAULT_TOPOLOGY_BASEIS, ISIS_SYS_ID_LEN);
@@ -234,6 +235,8 @@ int isis_area_destroy(struct vty *vty, const char *area_tag) {
 		lsp_db_destroy(area->lspdb[1]);
 		area->lspdb[1] = NULL;
 	}
+	list_delete(area->lsp_srm_list);
+	area->lsp_srm_list = NULL;
 
 	spftree_area_del(area);
 
@@ -1077,6 +1080,8 @@ DEFUN(show_isis_summary, show_isis_summary_cmd, "show isis summary",
 			}
 		}
 
+		vty_out(vty, "  Redistribution: delay %u msec, %u changes, %u coalesced in %u batches%s", area->redist_delay, area->redist_changes, area->redist_coalesced, area->redist_batches, VTY_NEWLINE);
+
 		for(level = ISIS_LEVEL1; level <= ISIS_LEVELS; level++) {
 			if((area->is_type & level) == 0) {
 				continue;
@@ -1100,6 +1105,8 @@ DEFUN(show_isis_summary, show_isis_summary_cmd, "show isis summary",
 
 			vty_out(vty, "      run count         : %d%s", spftree->runcount, VTY_NEWLINE);
 
+			vty_out(vty, "      PRC run count     : %u%s", spftree->prc_runcount, VTY_NEWLINE);
+
 #ifdef HAVE_IPV6
 			spftree = area->spftree6[level - 1];
 			if(spftree->pending) {
@@ -1117,6 +1124,8 @@ DEFUN(show_isis_summary, show_isis_summary_cmd, "show isis summary",
 			vty_out(vty, "      last run duration : %llu msec%s", (unsigned long long) spftree->last_run_duration, VTY_NEWLINE);
 
 			vty_out(vty, "      run count         : %d%s", spftree->runcount, VTY_NEWLINE);
+
+			vty_out(vty, "      PRC run count     : %u%s", spftree->prc_runcount, VTY_NEWLINE);
 #endif
 		}
 	}
@@ -1192,7 +1201,7 @@ static int show_isis_database(struct vty *vty, const char *argv, int ui_level) {
 		vty_out(vty, "Area %s:%s", area->area_tag ? area->area_tag : "null", VTY_NEWLINE);
 
 		for(level = 0; level < ISIS_LEVELS; level++) {
-			if(area->lspdb[level] && dict_count(area->lspdb[level]) > 0) {
+			if(lspdb_count(area->lspdb[level]) > 0) {
 				lsp = NULL;
 				if(argv != NULL) {
 					/*
@@ -1498,6 +1507,23 @@ void isis_area_attached_bit_set(struct isis_area *area, bool attached_bit) {
 	}
 }
 
+void isis_area_mt_ipv6_set(struct isis_area *area, bool mt_ipv6) {
+	struct listnode *node;
+	struct isis_circuit *circuit;
+
+	if(area->mt_ipv6 != mt_ipv6) {
+		area->mt_ipv6 = mt_ipv6;
+		/* the neighbors learn of it from our hellos first */
+		for(ALL_LIST_ELEMENTS_RO(area->circuit_list, node, circuit)) {
+			if(circuit->state == C_STATE_UP) {
+				send_hello(circuit, IS_LEVEL_1);
+				send_hello(circuit, IS_LEVEL_2);
+			}
+		}
+		lsp_regenerate_schedule(area, IS_LEVEL_1 | IS_LEVEL_2, 1);
+	}
+}
+
 void isis_area_dynhostname_set(struct isis_area *area, bool dynhostname) {
 	if(area->dynhostname != dynhostname) {
 		area->dynhostname = dynhostname;
@@ -1703,6 +1729,11 @@ int isis_config_write(struct vty *vty) {
 				vty_out(vty, " set-overload-bit%s", VTY_NEWLINE);
 				write++;
 			}
+			/* ISIS - multi topology */
+			if(area->mt_ipv6) {
+				vty_out(vty, " topology ipv6-unicast%s", VTY_NEWLINE);
+				write++;
+			}
 			/* ISIS - Area is-type (level-1-2 is default) */
 			if(area->is_type == IS_LEVEL_1) {
 				vty_out(vty, " is-type level-1%s", VTY_NEWLINE);
@@ -1713,6 +1744,10 @@ int isis_config_write(struct vty *vty) {
 			}
 			write += isis_redist_config_write(vty, area, AF_INET);
 			write += isis_redist_config_write(vty, area, AF_INET6);
+			if(area->redist_delay != DEFAULT_REDIST_DELAY) {
+				vty_out(vty, " redistribute-delay %u%s", area->redist_delay, VTY_NEWLINE);
+				write++;
+			}
 			/* ISIS - Lsp generation interval */
 			if(area->lsp_gen_interval[0] == area->lsp_gen_interval[1]) {
 				if(area->lsp_gen_interval[0] != DEFAULT_MIN_LSP_GEN_INTERVAL) {
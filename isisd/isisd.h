@@ -25,7 +25,7 @@
 
 #define ISISD_VERSION "0.0.7"
 
-#include "dict.h"
+#include "isis_lspdb.h"
 #include "isis_flags.h"
 #include "isisd/isis_common.h"
 #include "isisd/isis_constants.h"
@@ -50,7 +50,7 @@ struct isis {
 	struct area_addr *man_area_addrs; /* manualAreaAddresses */
 	u_int32_t debugs;		  /* bitmap for debug */
 	time_t uptime;			  /* when did we start */
-	struct thread *t_dync_clean;	  /* dynamic hostname cache cleanup thread */
+	unsigned int spf_threads;	  /* SPF threads, -t/--spf_threads */
 
 	struct route_table *ext_info[REDIST_PROTOCOL_COUNT];
 };
@@ -59,7 +59,7 @@ extern struct isis *isis;
 
 struct isis_area {
 	struct isis *isis;			      /* back pointer */
-	dict_t *lspdb[ISIS_LEVELS];		      /* link-state dbs */
+	struct isis_lspdb *lspdb[ISIS_LEVELS];		      /* link-state dbs */
 	struct isis_spftree *spftree[ISIS_LEVELS];    /* The v4 SPTs */
 	struct route_table *route_table[ISIS_LEVELS]; /* IPv4 routes */
 #ifdef HAVE_IPV6
@@ -71,6 +71,7 @@ struct isis_area {
 	struct list *circuit_list; /* IS-IS circuits */
 	struct flags flags;
 	struct thread *t_tick; /* LSP walker */
+	struct list *lsp_srm_list; /* LSPs which may have SRMflags set */
 	struct thread *t_lsp_refresh[ISIS_LEVELS];
 	/* t_lsp_refresh is used in two ways:
    * a) regular refresh of LSPs
@@ -95,6 +96,8 @@ struct isis_area {
 	/* do we support new style metrics?  */
 	char newmetric;
 	char oldmetric;
+	/* IPv6 in its own topology (RFC5120)? */
+	char mt_ipv6;
 	/* identifies the routing instance   */
 	char *area_tag;
 	/* area addresses for this area      */
@@ -122,6 +125,13 @@ struct isis_area {
 	u_int32_t circuit_state_changes;
 	struct isis_redist redist_settings[REDIST_PROTOCOL_COUNT][ZEBRA_ROUTE_MAX + 1][ISIS_LEVELS];
 	struct route_table *ext_reach[REDIST_PROTOCOL_COUNT][ISIS_LEVELS];
+	/* redistribution changes batched for LSP regeneration */
+	unsigned int redist_delay; /* msec */
+	struct thread *t_redist;
+	int redist_pending; /* levels */
+	u_int32_t redist_changes;
+	u_int32_t redist_coalesced;
+	u_int32_t redist_batches;
 
 #ifdef TOPOLOGY_GENERATE
 	struct list *topology;
@@ -140,6 +150,7 @@ void print_debug(struct vty *, int, int);
 
 void isis_area_overload_bit_set(struct isis_area *area, bool overload_bit);
 void isis_area_attached_bit_set(struct isis_area *area, bool attached_bit);
+void isis_area_mt_ipv6_set(struct isis_area *area, bool mt_ipv6);
 void isis_area_dynhostname_set(struct isis_area *area, bool dynhostname);
 void isis_area_metricstyle_set(struct isis_area *area, bool old_metric, bool new_metric);
 void isis_area_lsp_mtu_set(struct isis_area *area, unsigned int lsp_mtu);
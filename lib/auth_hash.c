@@ -0,0 +1,404 @@
+/*
+ * Digests for routing protocol cryptographic authentication.
+ *
+ * This file is part of Quagga.
+ *
+ * Quagga is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2, or (at your option) any
+ * later version.
+ *
+ * Quagga is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Quagga; see the file COPYING.  If not, write to the Free
+ * Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ * 02111-1307, USA.
+ */
+
+#include <zebra.h>
+
+#include "auth_hash.h"
+
+static const struct {
+	const char *name;
+	size_t size;
+	size_t block;
+} auth_hashes[AUTH_HASH_MAX] = {
+	[AUTH_HASH_MD5] = { "md5", 16, 64 },
+	[AUTH_HASH_SHA1] = { "hmac-sha-1", 20, 64 },
+	[AUTH_HASH_SHA256] = { "hmac-sha-256", 32, 64 },
+	[AUTH_HASH_SHA384] = { "hmac-sha-384", 48, 128 },
+	[AUTH_HASH_SHA512] = { "hmac-sha-512", 64, 128 },
+};
+
+const char *auth_hash_name(int type) {
+	return (type >= 0 && type < AUTH_HASH_MAX) ? auth_hashes[type].name : "unknown";
+}
+
+int auth_hash_lookup(const char *name) {
+	int type, found = -1;
+
+	for(type = 0; type < AUTH_HASH_MAX; type++) {
+		if(strcmp(auth_hashes[type].name, name) == 0) {
+			return type;
+		}
+		if(strncmp(auth_hashes[type].name, name, strlen(name)) == 0) {
+			/* the CLI passes on words as typed */
+			if(found >= 0) {
+				return -1;
+			}
+			found = type;
+		}
+	}
+	return found;
+}
+
+size_t auth_hash_size(int type) {
+	return auth_hashes[type].size;
+}
+
+#define ROL32(x, n) (((x) << (n)) | ((x) >> (32 - (n))))
+#define ROR32(x, n) (((x) >> (n)) | ((x) << (32 - (n))))
+#define ROR64(x, n) (((x) >> (n)) | ((x) << (64 - (n))))
+
+static inline u_int32_t get_be32(const u_char *p) {
+	return ((u_int32_t) p[0] << 24) | ((u_int32_t) p[1] << 16) | ((u_int32_t) p[2] << 8) | p[3];
+}
+
+static inline u_int64_t get_be64(const u_char *p) {
+	return ((u_int64_t) get_be32(p) << 32) | get_be32(p + 4);
+}
+
+static inline void put_be32(u_char *p, u_int32_t v) {
+	p[0] = v >> 24;
+	p[1] = v >> 16;
+	p[2] = v >> 8;
+	p[3] = v;
+}
+
+static inline void put_be64(u_char *p, u_int64_t v) {
+	put_be32(p, v >> 32);
+	put_be32(p + 4, v);
+}
+
+/* SHA-1, FIPS 180-4 */
+static void sha1_block(u_int32_t *h, const u_char *p) {
+	u_int32_t w[16];
+	u_int32_t a = h[0], b = h[1], c = h[2], d = h[3], e = h[4], f, k, t;
+	int i;
+
+	for(i = 0; i < 80; i++) {
+		if(i < 16) {
+			w[i] = get_be32(p + 4 * i);
+		} else {
+			t = w[(i + 13) & 15] ^ w[(i + 8) & 15] ^ w[(i + 2) & 15] ^ w[i & 15];
+			w[i & 15] = ROL32(t, 1);
+		}
+		if(i < 20) {
+			f = (b & c) | (~b & d);
+			k = 0x5a827999;
+		} else if(i < 40) {
+			f = b ^ c ^ d;
+			k = 0x6ed9eba1;
+		} else if(i < 60) {
+			f = (b & c) | (b & d) | (c & d);
+			k = 0x8f1bbcdc;
+		} else {
+			f = b ^ c ^ d;
+			k = 0xca62c1d6;
+		}
+		t = ROL32(a, 5) + f + e + k + w[i & 15];
+		e = d;
+		d = c;
+		c = ROL32(b, 30);
+		b = a;
+		a = t;
+	}
+	h[0] += a;
+	h[1] += b;
+	h[2] += c;
+	h[3] += d;
+	h[4] += e;
+}
+
+/* SHA-256 */
+static const u_int32_t sha256_k[64] = {
+	0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5, 0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+	0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da, 0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+	0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85, 0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+	0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3, 0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2,
+};
+
+static void sha256_block(u_int32_t *h, const u_char *p) {
+	u_int32_t w[64];
+	u_int32_t a = h[0], b = h[1], c = h[2], d = h[3], e = h[4], f = h[5], g = h[6], hh = h[7], t1, t2;
+	int i;
+
+	for(i = 0; i < 16; i++) {
+		w[i] = get_be32(p + 4 * i);
+	}
+	for(; i < 64; i++) {
+		t1 = ROR32(w[i - 2], 17) ^ ROR32(w[i - 2], 19) ^ (w[i - 2] >> 10);
+		t2 = ROR32(w[i - 15], 7) ^ ROR32(w[i - 15], 18) ^ (w[i - 15] >> 3);
+		w[i] = t1 + w[i - 7] + t2 + w[i - 16];
+	}
+	for(i = 0; i < 64; i++) {
+		t1 = hh + (ROR32(e, 6) ^ ROR32(e, 11) ^ ROR32(e, 25)) + ((e & f) ^ (~e & g)) + sha256_k[i] + w[i];
+		t2 = (ROR32(a, 2) ^ ROR32(a, 13) ^ ROR32(a, 22)) + ((a & b) ^ (a & c) ^ (b & c));
+		hh = g;
+		g = f;
+		f = e;
+		e = d + t1;
+		d = c;
+		c = b;
+		b = a;
+		a = t1 + t2;
+	}
+	h[0] += a;
+	h[1] += b;
+	h[2] += c;
+	h[3] += d;
+	h[4] += e;
+	h[5] += f;
+	h[6] += g;
+	h[7] += hh;
+}
+
+/* SHA-512, and SHA-384 from other initial values */
+static const u_int64_t sha512_k[80] = {
+	0x428a2f98d728ae22ULL, 0x7137449123ef65cdULL, 0xb5c0fbcfec4d3b2fULL, 0xe9b5dba58189dbbcULL, 0x3956c25bf348b538ULL, 0x59f111f1b605d019ULL, 0x923f82a4af194f9bULL, 0xab1c5ed5da6d8118ULL,
+	0xd807aa98a3030242ULL, 0x12835b0145706fbeULL, 0x243185be4ee4b28cULL, 0x550c7dc3d5ffb4e2ULL, 0x72be5d74f27b896fULL, 0x80deb1fe3b1696b1ULL, 0x9bdc06a725c71235ULL, 0xc19bf174cf692694ULL,
+	0xe49b69c19ef14ad2ULL, 0xefbe4786384f25e3ULL, 0x0fc19dc68b8cd5b5ULL, 0x240ca1cc77ac9c65ULL, 0x2de92c6f592b0275ULL, 0x4a7484aa6ea6e483ULL, 0x5cb0a9dcbd41fbd4ULL, 0x76f988da831153b5ULL,
+	0x983e5152ee66dfabULL, 0xa831c66d2db43210ULL, 0xb00327c898fb213fULL, 0xbf597fc7beef0ee4ULL, 0xc6e00bf33da88fc2ULL, 0xd5a79147930aa725ULL, 0x06ca6351e003826fULL, 0x142929670a0e6e70ULL,
+	0x27b70a8546d22ffcULL, 0x2e1b21385c26c926ULL, 0x4d2c6dfc5ac42aedULL, 0x53380d139d95b3dfULL, 0x650a73548baf63deULL, 0x766a0abb3c77b2a8ULL, 0x81c2c92e47edaee6ULL, 0x92722c851482353bULL,
+	0xa2bfe8a14cf10364ULL, 0xa81a664bbc423001ULL, 0xc24b8b70d0f89791ULL, 0xc76c51a30654be30ULL, 0xd192e819d6ef5218ULL, 0xd69906245565a910ULL, 0xf40e35855771202aULL, 0x106aa07032bbd1b8ULL,
+	0x19a4c116b8d2d0c8ULL, 0x1e376c085141ab53ULL, 0x2748774cdf8eeb99ULL, 0x34b0bcb5e19b48a8ULL, 0x391c0cb3c5c95a63ULL, 0x4ed8aa4ae3418acbULL, 0x5b9cca4f7763e373ULL, 0x682e6ff3d6b2b8a3ULL,
+	0x748f82ee5defb2fcULL, 0x78a5636f43172f60ULL, 0x84c87814a1f0ab72ULL, 0x8cc702081a6439ecULL, 0x90befffa23631e28ULL, 0xa4506cebde82bde9ULL, 0xbef9a3f7b2c67915ULL, 0xc67178f2e372532bULL,
+	0xca273eceea26619cULL, 0xd186b8c721c0c207ULL, 0xeada7dd6cde0eb1eULL, 0xf57d4f7fee6ed178ULL, 0x06f067aa72176fbaULL, 0x0a637dc5a2c898a6ULL, 0x113f9804bef90daeULL, 0x1b710b35131c471bULL,
+	0x28db77f523047d84ULL, 0x32caab7b40c72493ULL, 0x3c9ebe0a15c9bebcULL, 0x431d67c49c100d4cULL, 0x4cc5d4becb3e42b6ULL, 0x597f299cfc657e2aULL, 0x5fcb6fab3ad6faecULL, 0x6c44198c4a475817ULL,
+};
+
+static void sha512_block(u_int64_t *h, const u_char *p) {
+	u_int64_t w[80];
+	u_int64_t a = h[0], b = h[1], c = h[2], d = h[3], e = h[4], f = h[5], g = h[6], hh = h[7], t1, t2;
+	int i;
+
+	for(i = 0; i < 16; i++) {
+		w[i] = get_be64(p + 8 * i);
+	}
+	for(; i < 80; i++) {
+		t1 = ROR64(w[i - 2], 19) ^ ROR64(w[i - 2], 61) ^ (w[i - 2] >> 6);
+		t2 = ROR64(w[i - 15], 1) ^ ROR64(w[i - 15], 8) ^ (w[i - 15] >> 7);
+		w[i] = t1 + w[i - 7] + t2 + w[i - 16];
+	}
+	for(i = 0; i < 80; i++) {
+		t1 = hh + (ROR64(e, 14) ^ ROR64(e, 18) ^ ROR64(e, 41)) + ((e & f) ^ (~e & g)) + sha512_k[i] + w[i];
+		t2 = (ROR64(a, 28) ^ ROR64(a, 34) ^ ROR64(a, 39)) + ((a & b) ^ (a & c) ^ (b & c));
+		hh = g;
+		g = f;
+		f = e;
+		e = d + t1;
+		d = c;
+		c = b;
+		b = a;
+		a = t1 + t2;
+	}
+	h[0] += a;
+	h[1] += b;
+	h[2] += c;
+	h[3] += d;
+	h[4] += e;
+	h[5] += f;
+	h[6] += g;
+	h[7] += hh;
+}
+
+static const u_int32_t sha1_h0[5] = { 0x67452301, 0xefcdab89, 0x98badcfe, 0x10325476, 0xc3d2e1f0 };
+static const u_int32_t sha256_h0[8] = { 0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19 };
+static const u_int64_t sha384_h0[8] = {
+	0xcbbb9d5dc1059ed8ULL, 0x629a292a367cd507ULL, 0x9159015a3070dd17ULL, 0x152fecd8f70e5939ULL, 0x67332667ffc00b31ULL, 0x8eb44a8768581511ULL, 0xdb0c2e0d64f98fa7ULL, 0x47b5481dbefa4fa4ULL,
+};
+static const u_int64_t sha512_h0[8] = {
+	0x6a09e667f3bcc908ULL, 0xbb67ae8584caa73bULL, 0x3c6ef372fe94f82bULL, 0xa54ff53a5f1d36f1ULL, 0x510e527fade682d1ULL, 0x9b05688c2b3e6c1fULL, 0x1f83d9abfb41bd6bULL, 0x5be0cd19137e2179ULL,
+};
+
+void auth_hash_init(struct auth_hash_ctx *ctx, int type) {
+	ctx->type = type;
+	switch(type) {
+		case AUTH_HASH_MD5: md5_init(&ctx->u.md5); break;
+		case AUTH_HASH_SHA1:
+			memcpy(ctx->u.sha1.h, sha1_h0, sizeof(sha1_h0));
+			ctx->u.sha1.count = 0;
+			break;
+		case AUTH_HASH_SHA256:
+			memcpy(ctx->u.sha256.h, sha256_h0, sizeof(sha256_h0));
+			ctx->u.sha256.count = 0;
+			break;
+		case AUTH_HASH_SHA384:
+			memcpy(ctx->u.sha512.h, sha384_h0, sizeof(sha384_h0));
+			ctx->u.sha512.count = 0;
+			break;
+		case AUTH_HASH_SHA512:
+			memcpy(ctx->u.sha512.h, sha512_h0, sizeof(sha512_h0));
+			ctx->u.sha512.count = 0;
+			break;
+	}
+}
+
+/* Whole blocks are hashed where they lie, only the ends are copied */
+#define AUTH_HASH_UPDATE(C, BLOCK, BLEN, P, LEN)                      \
+	do {                                                          \
+		size_t used = (C)->count % (BLEN);                    \
+		(C)->count += (LEN);                                  \
+		if(used) {                                            \
+			size_t n = MIN((LEN), (BLEN) - used);         \
+			memcpy((C)->buf + used, (P), n);              \
+			(P) += n;                                     \
+			(LEN) -= n;                                   \
+			if(used + n < (BLEN)) {                       \
+				break;                                \
+			}                                             \
+			BLOCK((C)->h, (C)->buf);                      \
+		}                                                     \
+		for(; (LEN) >= (BLEN); (P) += (BLEN), (LEN) -= (BLEN)) { \
+			BLOCK((C)->h, (P));                           \
+		}                                                     \
+		memcpy((C)->buf, (P), (LEN));                         \
+	} while(0)
+
+void auth_hash_update(struct auth_hash_ctx *ctx, const void *data, size_t len) {
+	const u_char *p = data;
+
+	switch(ctx->type) {
+		case AUTH_HASH_MD5: md5_loop(&ctx->u.md5, data, len); break;
+		case AUTH_HASH_SHA1: AUTH_HASH_UPDATE(&ctx->u.sha1, sha1_block, 64, p, len); break;
+		case AUTH_HASH_SHA256: AUTH_HASH_UPDATE(&ctx->u.sha256, sha256_block, 64, p, len); break;
+		case AUTH_HASH_SHA384:
+		case AUTH_HASH_SHA512: AUTH_HASH_UPDATE(&ctx->u.sha512, sha512_block, 128, p, len); break;
+	}
+}
+
+/* Pad to a whole block with the bit length at its end, big-endian, in
+ * a field of lenlen bytes */
+#define AUTH_HASH_PAD(C, BLOCK, BLEN, LENLEN)                         \
+	do {                                                          \
+		size_t used = (C)->count % (BLEN);                    \
+		(C)->buf[used++] = 0x80;                              \
+		if(used > (BLEN) - (LENLEN)) {                        \
+			memset((C)->buf + used, 0, (BLEN) - used);    \
+			BLOCK((C)->h, (C)->buf);                      \
+			used = 0;                                     \
+		}                                                     \
+		memset((C)->buf + used, 0, (BLEN) - 8 - used);        \
+		put_be64((C)->buf + (BLEN) - 8, (C)->count << 3);     \
+		BLOCK((C)->h, (C)->buf);                              \
+	} while(0)
+
+void auth_hash_final(struct auth_hash_ctx *ctx, u_char *digest) {
+	int i;
+
+	switch(ctx->type) {
+		case AUTH_HASH_MD5: MD5Final(digest, &ctx->u.md5); break;
+		case AUTH_HASH_SHA1:
+			AUTH_HASH_PAD(&ctx->u.sha1, sha1_block, 64, 8);
+			for(i = 0; i < 5; i++) {
+				put_be32(digest + 4 * i, ctx->u.sha1.h[i]);
+			}
+			break;
+		case AUTH_HASH_SHA256:
+			AUTH_HASH_PAD(&ctx->u.sha256, sha256_block, 64, 8);
+			for(i = 0; i < 8; i++) {
+				put_be32(digest + 4 * i, ctx->u.sha256.h[i]);
+			}
+			break;
+		case AUTH_HASH_SHA384:
+		case AUTH_HASH_SHA512:
+			AUTH_HASH_PAD(&ctx->u.sha512, sha512_block, 128, 16);
+			for(i = 0; i < (ctx->type == AUTH_HASH_SHA384 ? 6 : 8); i++) {
+				put_be64(digest + 8 * i, ctx->u.sha512.h[i]);
+			}
+			break;
+	}
+}
+
+/* RFC 5709 section 3.3: a key shorter than the digest is padded with
+ * zeroes to its length, a longer one hashed to it, before it is padded
+ * to the block for HMAC */
+void auth_key_set(struct auth_key *key, int type, const void *str, size_t len) {
+	u_char k[AUTH_HASH_BLOCK_MAX];
+	u_char pad[AUTH_HASH_BLOCK_MAX];
+	size_t size, block, i;
+
+	memset(key, 0, sizeof(struct auth_key));
+	key->type = type;
+	if(type == AUTH_HASH_MD5) {
+		memcpy(key->md5, str, MIN(len, AUTH_MD5_KEY_SIZE));
+		return;
+	}
+
+	size = auth_hashes[type].size;
+	block = auth_hashes[type].block;
+	memset(k, 0, sizeof(k));
+	if(len > size) {
+		auth_hash_init(&key->inner, type);
+		auth_hash_update(&key->inner, str, len);
+		auth_hash_final(&key->inner, k);
+	} else {
+		memcpy(k, str, len);
+	}
+
+	for(i = 0; i < block; i++) {
+		pad[i] = k[i] ^ 0x36;
+	}
+	auth_hash_init(&key->inner, type);
+	auth_hash_update(&key->inner, pad, block);
+	for(i = 0; i < block; i++) {
+		pad[i] = k[i] ^ 0x5c;
+	}
+	auth_hash_init(&key->outer, type);
+	auth_hash_update(&key->outer, pad, block);
+}
+
+static const u_char auth_apad[AUTH_HASH_SIZE_MAX] = {
+	0x87, 0x8f, 0xe1, 0xf3, 0x87, 0x8f, 0xe1, 0xf3, 0x87, 0x8f, 0xe1, 0xf3, 0x87, 0x8f, 0xe1, 0xf3, 0x87, 0x8f, 0xe1, 0xf3, 0x87, 0x8f, 0xe1, 0xf3, 0x87, 0x8f, 0xe1, 0xf3, 0x87, 0x8f, 0xe1, 0xf3,
+	0x87, 0x8f, 0xe1, 0xf3, 0x87, 0x8f, 0xe1, 0xf3, 0x87, 0x8f, 0xe1, 0xf3, 0x87, 0x8f, 0xe1, 0xf3, 0x87, 0x8f, 0xe1, 0xf3, 0x87, 0x8f, 0xe1, 0xf3, 0x87, 0x8f, 0xe1, 0xf3, 0x87, 0x8f, 0xe1, 0xf3,
+};
+
+void auth_digest(const struct auth_key *key, const void *data, size_t len, u_char *digest) {
+	struct auth_hash_ctx ctx;
+	u_char inner[AUTH_HASH_SIZE_MAX];
+	size_t size;
+
+	if(key->type == AUTH_HASH_MD5) {
+		md5_init(&ctx.u.md5);
+		md5_loop(&ctx.u.md5, data, len);
+		md5_loop(&ctx.u.md5, key->md5, AUTH_MD5_KEY_SIZE);
+		MD5Final(digest, &ctx.u.md5);
+		return;
+	}
+
+	size = auth_hashes[key->type].size;
+	ctx = key->inner;
+	auth_hash_update(&ctx, data, len);
+	auth_hash_update(&ctx, auth_apad, size);
+	auth_hash_final(&ctx, inner);
+	ctx = key->outer;
+	auth_hash_update(&ctx, inner, size);
+	auth_hash_final(&ctx, digest);
+}
+
+int auth_digest_check(const struct auth_key *key, const void *data, size_t len, const u_char *digest) {
+	u_char mine[AUTH_HASH_SIZE_MAX];
+	u_char diff = 0;
+	size_t i, size = auth_hashes[key->type].size;
+
+	auth_digest(key, data, len, mine);
+	for(i = 0; i < size; i++) {
+		diff |= mine[i] ^ digest[i];
+	}
+	return diff == 0;
+}
@@ -0,0 +1,102 @@
+/*
+ * Digests for routing protocol cryptographic authentication.
+ *
+ * This file is part of Quagga.
+ *
+ * Quagga is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2, or (at your option) any
+ * later version.
+ *
+ * Quagga is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Quagga; see the file COPYING.  If not, write to the Free
+ * Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ * 02111-1307, USA.
+ */
+
+#ifndef _QUAGGA_AUTH_HASH_H
+#define _QUAGGA_AUTH_HASH_H
+
+#include "md5.h"
+
+/* What OSPFv2 and RIPv2 sign their packets with: keyed MD5 (RFC 2328
+ * appendix D, RFC 2082), where the digest is of the packet followed by
+ * the key padded to 16 bytes, and HMAC-SHA (RFC 5709, RFC 4822), where
+ * it is the HMAC of the packet followed by Apad, the digest's length of
+ * 0x878FE1F3 repeated.  Either way the digest is of what goes before the
+ * digest on the wire, with the key material after it.
+ *
+ * An auth_key holds a key made ready for a hash: for HMAC, the states
+ * after the inner and the outer padded key, so that a packet costs
+ * its own blocks and one more for the outer hash, no more. */
+enum auth_hash_type {
+	AUTH_HASH_MD5 = 0,
+	AUTH_HASH_SHA1,
+	AUTH_HASH_SHA256,
+	AUTH_HASH_SHA384,
+	AUTH_HASH_SHA512,
+	AUTH_HASH_MAX,
+};
+
+#define AUTH_HASH_SIZE_MAX 64
+#define AUTH_HASH_BLOCK_MAX 128
+/* Keyed MD5 keys are padded or cut to this */
+#define AUTH_MD5_KEY_SIZE 16
+
+struct auth_sha1_ctx {
+	u_int32_t h[5];
+	u_int64_t count; /* bytes */
+	u_char buf[64];
+};
+
+struct auth_sha256_ctx {
+	u_int32_t h[8];
+	u_int64_t count;
+	u_char buf[64];
+};
+
+struct auth_sha512_ctx {
+	u_int64_t h[8];
+	u_int64_t count; /* no packet comes near 2^64 bytes */
+	u_char buf[128];
+};
+
+struct auth_hash_ctx {
+	int type;
+	union {
+		md5_ctxt md5;
+		struct auth_sha1_ctx sha1;
+		struct auth_sha256_ctx sha256;
+		struct auth_sha512_ctx sha512; /* and SHA-384 */
+	} u;
+};
+
+struct auth_key {
+	int type;
+	u_char md5[AUTH_MD5_KEY_SIZE];
+	struct auth_hash_ctx inner, outer; /* HMAC only */
+};
+
+/* "md5", "hmac-sha-1", ..., "hmac-sha-512", as in the CLI */
+extern const char *auth_hash_name(int type);
+/* The type by name or an unambiguous start of one, -1 for none */
+extern int auth_hash_lookup(const char *name);
+/* The digest's length in bytes */
+extern size_t auth_hash_size(int type);
+
+extern void auth_hash_init(struct auth_hash_ctx *, int type);
+extern void auth_hash_update(struct auth_hash_ctx *, const void *, size_t);
+extern void auth_hash_final(struct auth_hash_ctx *, u_char *digest);
+
+extern void auth_key_set(struct auth_key *, int type, const void *key, size_t len);
+/* The digest of len bytes of packet by the key, auth_hash_size() long */
+extern void auth_digest(const struct auth_key *, const void *data, size_t len, u_char *digest);
+/* 1 if the digest matches, compared in constant time */
+extern int auth_digest_check(const struct auth_key *, const void *data, size_t len, const u_char *digest);
+
+#endif /* _QUAGGA_AUTH_HASH_H */
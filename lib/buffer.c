@@ -37,6 +37,9 @@ struct buffer {
 
 	/* Size of each buffer_data chunk. */
 	size_t size;
+
+	/* Bytes not yet flushed. */
+	size_t length;
 };
 
 /* Data container. */
@@ -114,6 +117,11 @@ int buffer_empty(struct buffer *b) {
 	return (b->head == NULL);
 }
 
+/* Return the number of bytes waiting to be flushed. */
+size_t buffer_pending(struct buffer *b) {
+	return b->length;
+}
+
 /* Clear and free all allocated data. */
 void buffer_reset(struct buffer *b) {
 	struct buffer_data *data;
@@ -124,6 +132,7 @@ void buffer_reset(struct buffer *b) {
 		BUFFER_DATA_FREE(data);
 	}
 	b->head = b->tail = NULL;
+	b->length = 0;
 }
 
 /* Add buffer_data to the end of buffer. */
@@ -149,6 +158,8 @@ void buffer_put(struct buffer *b, const void *p, size_t size) {
 	struct buffer_data *data = b->tail;
 	const char *ptr = p;
 
+	b->length += size;
+
 	/* We use even last one byte of data buffer. */
 	while(size) {
 		size_t chunk;
@@ -265,6 +276,7 @@ buffer_status_t buffer_flush_window(struct buffer *b, int fd, int width, int hei
 		}
 		iov[iov_index].iov_base = (char *) (data->data + data->sp);
 		iov[iov_index++].iov_len = cp - data->sp;
+		b->length -= cp - data->sp;
 		data->sp = cp;
 
 		if(iov_index == iov_alloc)
@@ -384,6 +396,7 @@ in one shot. */
 	}
 
 	/* Free printed buffer data. */
+	b->length -= written;
 	while(written > 0) {
 		struct buffer_data *d;
 		if(!(d = b->head)) {
@@ -52,6 +52,9 @@ char *buffer_getstr(struct buffer *);
 /* Returns 1 if there is no pending data in the buffer.  Otherwise returns 0. */
 int buffer_empty(struct buffer *);
 
+/* Returns the number of bytes of pending data in the buffer. */
+extern size_t buffer_pending(struct buffer *);
+
 typedef enum {
 	/* An I/O error occurred.  The buffer should be destroyed and the
        file descriptor should be closed. */
@@ -75,14 +78,14 @@ extern buffer_status_t buffer_write(struct buffer *, int fd, const void *, size_
    the queued data to the given file descriptor. */
 extern buffer_status_t buffer_flush_available(struct buffer *, int fd);
 
-/* The following 2 functions (buffer_flush_all and buffer_flush_window)
-   are for use in lib/vty.c only.  They should not be used elsewhere. */
-
 /* Call buffer_flush_available repeatedly until either all data has been
    flushed, or an I/O error has been encountered, or the operation would
    block. */
 extern buffer_status_t buffer_flush_all(struct buffer *, int fd);
 
+/* The following function is for use in lib/vty.c only.  It should not be
+   used elsewhere. */
+
 /* Attempt to write enough data to the given fd to fill a window of the
    given width and height (and remove the data written from the buffer).
 
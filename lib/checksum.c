@@ -48,16 +48,48 @@ int /* return checksum in low-order 16 bits */
 /* Fletcher Checksum -- Refer to RFC1008. */
 #define MODX 4102 /* 5802 should be fine */
 
-/* To be consistent, offset is 0-based index, rather than the 1-based 
-   index required in the specification ISO 8473, Annex C.1 */
-/* calling with offset == FLETCHER_CHECKSUM_VALIDATE will validate the checksum
-   without modifying the buffer; a valid checksum returns 0 */
+/* The byte-at-a-time sums feed every byte's c0 into c1, a chain of
+ * dependent adds.  Summing the bytes at i, i + 4, i + 8, ... apart, four
+ * chains at once, and putting them together after comes to the same:
+ * over n bytes b[k] each lane j gives a[j], the sum of its bytes, and
+ * s[j], the sum of its running a[j], and
+ *   c1 += n * c0 + sum((n - k) * b[k]) = n * c0 + 4 * sum(s[j]) - sum(j * a[j])
+ *   c0 += sum(a[j])
+ * None of the sums overflows 32 bits within MODX bytes. */
+static void fletcher_sums(const u_int8_t *p, size_t len, u_int32_t *pc0, u_int32_t *pc1) {
+	u_int32_t c0 = *pc0, c1 = *pc1;
+	u_int32_t a0 = 0, a1 = 0, a2 = 0, a3 = 0, s0 = 0, s1 = 0, s2 = 0, s3 = 0;
+	size_t i, n = len & ~(size_t) 3;
+
+	for(i = 0; i < n; i += 4) {
+		a0 += p[i];
+		s0 += a0;
+		a1 += p[i + 1];
+		s1 += a1;
+		a2 += p[i + 2];
+		s2 += a2;
+		a3 += p[i + 3];
+		s3 += a3;
+	}
+	c1 += n * c0 + 4 * (s0 + s1 + s2 + s3) - (a1 + 2 * a2 + 3 * a3);
+	c0 += a0 + a1 + a2 + a3;
+
+	for(p += n, len -= n; len > 0; len--) {
+		c0 += *(p++);
+		c1 += c0;
+	}
+
+	*pc0 = c0;
+	*pc1 = c1;
+}
+
 u_int16_t fletcher_checksum(u_char *buffer, const size_t len, const uint16_t offset) {
 	u_int8_t *p;
-	int x, y, c0, c1;
+	int x, y;
+	u_int32_t c0, c1;
 	u_int16_t checksum;
 	u_int16_t *csum;
-	size_t partial_len, i, left = len;
+	size_t partial_len, left = len;
 
 	checksum = 0;
 
@@ -76,10 +108,8 @@ u_int16_t fletcher_checksum(u_char *buffer, const size_t len, const uint16_t off
 	while(left != 0) {
 		partial_len = MIN(left, MODX);
 
-		for(i = 0; i < partial_len; i++) {
-			c0 = c0 + *(p++);
-			c1 += c0;
-		}
+		fletcher_sums(p, partial_len, &c0, &c1);
+		p += partial_len;
 
 		c0 = c0 % 255;
 		c1 = c1 % 255;
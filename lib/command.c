@@ -32,6 +32,7 @@ Boston, MA 02111-1307, USA.  */
 #include "vty.h"
 #include "command.h"
 #include "workqueue.h"
+#include "placement.h"
 
 /* Command vector which includes some level of command lists. Normally
    each daemon maintains each own cmdvec. */
@@ -196,12 +197,149 @@ static int cmd_hash_cmp(const void *a, const void *b) {
 	return a == b;
 }
 
+/* Commands of a node indexed by their leading run of literal words.
+   Strict matching (config files) takes its candidates from here rather
+   than trying every command of the node, see cmd_trie_collect(). */
+struct cmd_trie {
+	char *word;		  /* literal leading to this node */
+	struct cmd_element *any;  /* some command of this subtree */
+	vector cmds;		  /* commands whose literal run ends here */
+	struct cmd_trie **child;  /* sorted by word */
+	unsigned int nchild;
+};
+
+static struct cmd_trie *cmd_trie_new(const char *word) {
+	struct cmd_trie *t;
+
+	t = XCALLOC(MTYPE_CMD_TRIE, sizeof(struct cmd_trie));
+	if(word) {
+		t->word = XSTRDUP(MTYPE_CMD_TRIE, word);
+	}
+	t->cmds = vector_init(1);
+	return t;
+}
+
+static void cmd_trie_free(struct cmd_trie *t) {
+	unsigned int i;
+
+	for(i = 0; i < t->nchild; i++) {
+		cmd_trie_free(t->child[i]);
+	}
+	if(t->child) {
+		XFREE(MTYPE_CMD_TRIE, t->child);
+	}
+	if(t->word) {
+		XFREE(MTYPE_CMD_TRIE, t->word);
+	}
+	vector_free(t->cmds);
+	XFREE(MTYPE_CMD_TRIE, t);
+}
+
+/* Find the child for word, optionally creating it. */
+static struct cmd_trie *cmd_trie_child(struct cmd_trie *t, const char *word, int create) {
+	unsigned int lo = 0, hi = t->nchild, mid;
+	int cmp;
+
+	while(lo < hi) {
+		mid = (lo + hi) / 2;
+		cmp = strcmp(word, t->child[mid]->word);
+		if(cmp == 0) {
+			return t->child[mid];
+		}
+		if(cmp < 0) {
+			hi = mid;
+		} else {
+			lo = mid + 1;
+		}
+	}
+
+	if(!create) {
+		return NULL;
+	}
+
+	t->child = XREALLOC(MTYPE_CMD_TRIE, t->child, (t->nchild + 1) * sizeof(struct cmd_trie *));
+	memmove(&t->child[lo + 1], &t->child[lo], (t->nchild - lo) * sizeof(struct cmd_trie *));
+	t->child[lo] = cmd_trie_new(word);
+	t->nchild++;
+	return t->child[lo];
+}
+
+static void cmd_trie_add(struct cmd_trie *t, struct cmd_element *cmd) {
+	struct cmd_token *token;
+	unsigned int i;
+
+	for(i = 0; i < vector_active(cmd->tokens); i++) {
+		token = vector_slot(cmd->tokens, i);
+		if(token->type != TOKEN_TERMINAL || token->terminal != TERMINAL_LITERAL) {
+			break;
+		}
+		if(!t->any) {
+			t->any = cmd;
+		}
+		t = cmd_trie_child(t, token->cmd, 1);
+	}
+	if(!t->any) {
+		t->any = cmd;
+	}
+	vector_set(t->cmds, cmd);
+}
+
+static void cmd_trie_add_subtree(struct cmd_trie *t, vector v) {
+	unsigned int i;
+
+	for(i = 0; i < vector_active(t->cmds); i++) {
+		vector_set(v, vector_slot(t->cmds, i));
+	}
+	for(i = 0; i < t->nchild; i++) {
+		cmd_trie_add_subtree(t->child[i], v);
+	}
+}
+
+/* Put into v every command that strict matching of vline would not
+   drop on a literal word, i.e. what cmd_vector_filter() would keep of
+   the whole node.  Where the path ends on a word no literal matches,
+   one command of the branches given up is added as well: those only
+   fail on that word, and until then they match literally, which
+   outranks any variable still in the running.  One of them is enough
+   to have the earlier words ranked the same way. */
+static void cmd_trie_collect(struct cmd_trie *t, vector vline, vector v) {
+	struct cmd_trie *next;
+	const char *word;
+	unsigned int depth, i;
+
+	for(depth = 0;; depth++) {
+		for(i = 0; i < vector_active(t->cmds); i++) {
+			vector_set(v, vector_slot(t->cmds, i));
+		}
+
+		/* Literals past the end of the line are not checked. */
+		if(depth >= vector_active(vline)) {
+			for(i = 0; i < t->nchild; i++) {
+				cmd_trie_add_subtree(t->child[i], v);
+			}
+			return;
+		}
+
+		word = vector_slot(vline, depth);
+		next = word ? cmd_trie_child(t, word, 0) : NULL;
+
+		if(!next) {
+			if(t->nchild) {
+				vector_set(v, t->child[0]->any);
+			}
+			return;
+		}
+		t = next;
+	}
+}
+
 /* Install top node of command vector. */
 void install_node(struct cmd_node *node, int (*func)(struct vty *)) {
 	vector_set_index(cmdvec, node->node, node);
 	node->func = func;
 	node->cmd_vector = vector_init(VECTOR_MIN_SIZE);
 	node->cmd_hash = hash_create(cmd_hash_key, cmd_hash_cmp);
+	node->cmd_trie = cmd_trie_new(NULL);
 }
 
 /* Breaking up string into each command piece. I assume given
@@ -588,6 +726,7 @@ void install_element(enum node_type ntype, struct cmd_element *cmd) {
 	if(cmd->tokens == NULL) {
 		cmd->tokens = cmd_parse_format(cmd->string, cmd->doc);
 	}
+	cmd_trie_add(cnode->cmd_trie, cmd);
 
 	if(ntype == VIEW_NODE) {
 		install_element(ENABLE_NODE, cmd);
@@ -686,6 +825,10 @@ static int config_write_host(struct vty *vty) {
 		vty_out(vty, "log timestamp precision %d%s", zlog_default->timestamp_precision, VTY_NEWLINE);
 	}
 
+	if(zlog_default->async) {
+		vty_out(vty, "log async%s", VTY_NEWLINE);
+	}
+
 	if(host.advanced) {
 		vty_out(vty, "service advanced-vty%s", VTY_NEWLINE);
 	}
@@ -704,6 +847,8 @@ static int config_write_host(struct vty *vty) {
 		vty_out(vty, "no banner motd%s", VTY_NEWLINE);
 	}
 
+	thread_placement_config_write(vty);
+
 	return 1;
 }
 
@@ -2366,8 +2511,16 @@ static int cmd_execute_command_real(vector vline, enum filter_type filter, struc
 	int ret;
 	vector matches;
 
-	/* Make copy of command elements. */
-	cmd_vector = vector_copy(cmd_node_vector(cmdvec, vty->node));
+	/* Make copy of command elements.  Strict matching only needs the
+	   commands the leading literal words can lead to. */
+	if(filter == FILTER_STRICT) {
+		struct cmd_node *cnode = vector_slot(cmdvec, vty->node);
+
+		cmd_vector = vector_init(VECTOR_MIN_SIZE);
+		cmd_trie_collect(cnode->cmd_trie, vline, cmd_vector);
+	} else {
+		cmd_vector = vector_copy(cmd_node_vector(cmdvec, vty->node));
+	}
 
 	for(index = 0; index < vector_active(vline); index++) {
 		command = vector_slot(vline, index);
@@ -2590,6 +2743,78 @@ int config_from_file(struct vty *vty, FILE *fp, unsigned int *line_num) {
 	return CMD_SUCCESS;
 }
 
+/* Deferred work of the open configuration batches, run at the last
+   commit. */
+#define CMD_BATCH_DEFER_MAX 16
+static int cmd_batch_depth;
+static void (*cmd_batch_deferred[CMD_BATCH_DEFER_MAX])(void);
+static int cmd_batch_deferred_count;
+
+void cmd_batch_begin(struct vty *vty) {
+	if(vty->config_batch) {
+		return;
+	}
+	vty->config_batch = 1;
+	cmd_batch_depth++;
+}
+
+void cmd_batch_commit(struct vty *vty) {
+	void (*deferred[CMD_BATCH_DEFER_MAX])(void);
+	int count;
+	int i;
+
+	if(!vty->config_batch) {
+		return;
+	}
+	vty->config_batch = 0;
+	if(--cmd_batch_depth > 0) {
+		return;
+	}
+
+	count = cmd_batch_deferred_count;
+	memcpy(deferred, cmd_batch_deferred, count * sizeof(deferred[0]));
+	cmd_batch_deferred_count = 0;
+
+	for(i = 0; i < count; i++) {
+		(*deferred[i])();
+	}
+}
+
+int cmd_batch_defer(void (*func)(void)) {
+	int i;
+
+	if(cmd_batch_depth == 0) {
+		return 0;
+	}
+
+	for(i = 0; i < cmd_batch_deferred_count; i++) {
+		if(cmd_batch_deferred[i] == func) {
+			return 1;
+		}
+	}
+
+	/* no room: the caller does it now */
+	if(cmd_batch_deferred_count == CMD_BATCH_DEFER_MAX) {
+		return 0;
+	}
+	cmd_batch_deferred[cmd_batch_deferred_count++] = func;
+	return 1;
+}
+
+DEFUN(config_batch, config_batch_cmd, "configuration batch",
+      "Configuration transaction\n"
+      "Hold back policy updates until commit or end of configuration\n") {
+	cmd_batch_begin(vty);
+	return CMD_SUCCESS;
+}
+
+DEFUN(config_commit, config_commit_cmd, "configuration commit",
+      "Configuration transaction\n"
+      "Apply the policy updates held back since batch\n") {
+	cmd_batch_commit(vty);
+	return CMD_SUCCESS;
+}
+
 /* Configration from terminal */
 DEFUN(config_terminal, config_terminal_cmd, "configure terminal",
       "Configuration from vty interface\n"
@@ -3242,6 +3467,13 @@ DEFUN(show_logging, show_logging_cmd, "show logging", SHOW_STR "Show current log
 	vty_out(vty, "Protocol name: %s%s", zlog_proto_names[zl->protocol], VTY_NEWLINE);
 	vty_out(vty, "Record priority: %s%s", (zl->record_priority ? "enabled" : "disabled"), VTY_NEWLINE);
 	vty_out(vty, "Timestamp precision: %d%s", zl->timestamp_precision, VTY_NEWLINE);
+	vty_out(vty, "Asynchronous logging: ");
+	if(!zl->async) {
+		vty_out(vty, "disabled");
+	} else {
+		vty_out(vty, "enabled, %lu messages dropped", zlog_async_dropped());
+	}
+	vty_out(vty, "%s", VTY_NEWLINE);
 
 	return CMD_SUCCESS;
 }
@@ -3521,6 +3753,23 @@ DEFUN(no_config_log_timestamp_precision, no_config_log_timestamp_precision_cmd,
 	return CMD_SUCCESS;
 }
 
+DEFUN(config_log_async, config_log_async_cmd, "log async",
+      "Logging control\n"
+      "Write log files and syslog from a separate thread\n") {
+	if(!zlog_set_async(NULL, 1)) {
+		vty_out(vty, "Cannot start the log writer thread%s", VTY_NEWLINE);
+		return CMD_WARNING;
+	}
+	return CMD_SUCCESS;
+}
+
+DEFUN(no_config_log_async, no_config_log_async_cmd, "no log async",
+      NO_STR "Logging control\n"
+	     "Write log files and syslog from a separate thread\n") {
+	zlog_set_async(NULL, 0);
+	return CMD_SUCCESS;
+}
+
 DEFUN(banner_motd_file, banner_motd_file_cmd, "banner motd file [FILE]",
       "Set banner\n"
       "Banner for motd\n"
@@ -3691,6 +3940,9 @@ void cmd_init(int terminal) {
 		install_element(CONFIG_NODE, &enable_password_text_cmd);
 		install_element(CONFIG_NODE, &no_enable_password_cmd);
 
+		install_element(CONFIG_NODE, &config_batch_cmd);
+		install_element(CONFIG_NODE, &config_commit_cmd);
+
 		install_element(CONFIG_NODE, &config_log_stdout_cmd);
 		install_element(CONFIG_NODE, &config_log_stdout_level_cmd);
 		install_element(CONFIG_NODE, &no_config_log_stdout_cmd);
@@ -3714,6 +3966,8 @@ void cmd_init(int terminal) {
 		install_element(CONFIG_NODE, &no_config_log_record_priority_cmd);
 		install_element(CONFIG_NODE, &config_log_timestamp_precision_cmd);
 		install_element(CONFIG_NODE, &no_config_log_timestamp_precision_cmd);
+		install_element(CONFIG_NODE, &config_log_async_cmd);
+		install_element(CONFIG_NODE, &no_config_log_async_cmd);
 		install_element(CONFIG_NODE, &service_password_encrypt_cmd);
 		install_element(CONFIG_NODE, &no_service_password_encrypt_cmd);
 		install_element(CONFIG_NODE, &banner_motd_default_cmd);
@@ -3724,9 +3978,13 @@ void cmd_init(int terminal) {
 
 		install_element(VIEW_NODE, &show_thread_cpu_cmd);
 		install_element(RESTRICTED_NODE, &show_thread_cpu_cmd);
+		install_element(VIEW_NODE, &show_thread_latency_cmd);
+		install_element(RESTRICTED_NODE, &show_thread_latency_cmd);
 
 		install_element(ENABLE_NODE, &clear_thread_cpu_cmd);
 		install_element(VIEW_NODE, &show_work_queues_cmd);
+
+		thread_placement_init();
 	}
 	install_element(CONFIG_NODE, &show_commandtree_cmd);
 	srandom(time(NULL));
@@ -3798,6 +4056,8 @@ void cmd_terminate() {
 				hash_clean(cmd_node->cmd_hash, NULL);
 				hash_free(cmd_node->cmd_hash);
 				cmd_node->cmd_hash = NULL;
+				cmd_trie_free(cmd_node->cmd_trie);
+				cmd_node->cmd_trie = NULL;
 			}
 		}
 
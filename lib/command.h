@@ -132,6 +132,9 @@ struct cmd_node {
 
 	/* Hashed index of command node list, for de-dupping primarily */
 	struct hash *cmd_hash;
+
+	/* Commands indexed by their leading literal words */
+	struct cmd_trie *cmd_trie;
 };
 
 enum {
@@ -532,6 +535,16 @@ extern enum node_type node_parent(enum node_type);
 extern int cmd_execute_command(vector, struct vty *, struct cmd_element **, int);
 extern int cmd_execute_command_strict(vector, struct vty *, struct cmd_element **);
 extern void cmd_init(int);
+
+/* Configuration batches: between "configuration batch" and its commit
+ * (or the vty leaving configuration mode), daemons may put the work a
+ * config change triggers off with cmd_batch_defer(), returning nonzero
+ * if it was, so that it runs once at commit instead of per line.  Only
+ * work that is safe to delay may be deferred: references to objects
+ * that are already freed must still be dropped at once. */
+extern void cmd_batch_begin(struct vty *);
+extern void cmd_batch_commit(struct vty *);
+extern int cmd_batch_defer(void (*func)(void));
 extern void cmd_terminate(void);
 
 /* Export typical functions. */
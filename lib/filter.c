@@ -28,8 +28,12 @@
 #include "command.h"
 #include "sockunion.h"
 #include "buffer.h"
+#include "table.h"
 #include "log.h"
 
+/* Lists at least this long are looked up through a trie */
+#define ACCESS_LIST_TRIE_MIN 16
+
 struct filter_cisco {
 	/* Cisco access-list */
 	int extended;
@@ -63,6 +67,13 @@ struct filter {
 		struct filter_cisco cfilter;
 		struct filter_zebra zfilter;
 	} u;
+
+	/* Position in the list, increasing from head to tail. */
+	u_int32_t seq;
+
+	/* Next filter on the same trie node or, for one that can't be put
+	   on the trie, next such filter; either way in list order. */
+	struct filter *trie_next;
 };
 
 /* List of access_list. */
@@ -180,6 +191,137 @@ static int filter_match_zebra(struct filter *mfilter, struct prefix *p) {
 	}
 }
 
+static int filter_match(struct filter *filter, struct prefix *p) {
+	if(filter->cisco) {
+		return filter_match_cisco(filter, p);
+	}
+	return filter_match_zebra(filter, p);
+}
+
+/* The trie node a filter goes on: the prefix of a zebra filter, or
+   address and wildcard of a standard cisco one, if the wildcard only
+   covers host bits.  A prefix can only match filters on nodes which
+   hold its address, so the trie is looked up by the address alone.
+   Returns 0 for a filter that has to be tried one by one. */
+static int filter_trie_prefix(struct filter *filter, struct prefix *p) {
+	struct filter_cisco *cfilter;
+	u_int32_t wildcard;
+
+	memset(p, 0, sizeof(struct prefix));
+	if(!filter->cisco) {
+		prefix_copy(p, &filter->u.zfilter.prefix);
+		apply_mask(p);
+		return 1;
+	}
+
+	cfilter = &filter->u.cfilter;
+	wildcard = ntohl(cfilter->addr_mask.s_addr);
+	if(cfilter->extended || (wildcard & (wildcard + 1))) {
+		return 0;
+	}
+	p->family = AF_INET;
+	p->prefixlen = IPV4_MAX_BITLEN;
+	for(; wildcard; wildcard >>= 1) {
+		p->prefixlen--;
+	}
+	p->u.prefix4 = cfilter->addr;
+	return 1;
+}
+
+/* The address family of the filters the list can hold. */
+static int access_list_family(struct access_list *access) {
+#ifdef HAVE_IPV6
+	if(access->master == &access_master_ipv6) {
+		return AF_INET6;
+	}
+#endif /* HAVE_IPV6 */
+	return AF_INET;
+}
+
+static void access_list_trie_add(struct access_list *access, struct filter *filter) {
+	struct filter **point;
+	struct route_node *rn;
+	struct prefix p;
+
+	if(!filter_trie_prefix(filter, &p) || p.family != access_list_family(access)) {
+		for(point = &access->unindexed; *point; point = &(*point)->trie_next)
+			;
+		*point = filter;
+		return;
+	}
+
+	if(!access->trie) {
+		access->trie = route_table_init();
+	}
+
+	/* filters are only ever added at the tail, so last on the node too;
+	   the node stays locked for it */
+	rn = route_node_get(access->trie, &p);
+	for(point = (struct filter **) &rn->info; *point; point = &(*point)->trie_next)
+		;
+	*point = filter;
+}
+
+static void access_list_trie_delete(struct access_list *access, struct filter *filter) {
+	struct filter **point;
+	struct route_node *rn;
+	struct prefix p;
+
+	if(!filter_trie_prefix(filter, &p) || p.family != access_list_family(access)) {
+		for(point = &access->unindexed; *point != filter; point = &(*point)->trie_next)
+			;
+		*point = filter->trie_next;
+		return;
+	}
+
+	rn = route_node_lookup(access->trie, &p);
+	assert(rn);
+
+	for(point = (struct filter **) &rn->info; *point != filter; point = &(*point)->trie_next)
+		;
+	*point = filter->trie_next;
+
+	/* route_node_lookup()'s lock, and the filter's */
+	route_unlock_node(rn);
+	route_unlock_node(rn);
+}
+
+/* The filters that can match p sit on the path from the root of the
+   trie down to p's address, or are among the unindexed ones, so only
+   those have to be tried, however long the list. */
+static struct filter *access_list_trie_match(struct access_list *access, struct prefix *p) {
+	struct filter *filter, *best = NULL;
+	struct route_node *rn, *matched = NULL;
+	struct prefix host;
+
+	if(access->trie) {
+		prefix_copy(&host, p);
+		host.prefixlen = p->family == AF_INET ? IPV4_MAX_BITLEN : IPV6_MAX_BITLEN;
+		matched = route_node_match(access->trie, &host);
+	}
+	for(rn = matched; rn; rn = rn->parent) {
+		for(filter = rn->info; filter; filter = filter->trie_next) {
+			if(best && filter->seq >= best->seq) {
+				break;
+			}
+			if(filter_match(filter, p)) {
+				best = filter;
+				break;
+			}
+		}
+	}
+	if(matched) {
+		route_unlock_node(matched);
+	}
+
+	for(filter = access->unindexed; filter && (!best || filter->seq < best->seq); filter = filter->trie_next) {
+		if(filter_match(filter, p)) {
+			return filter;
+		}
+	}
+	return best;
+}
+
 /* Allocate new access list structure. */
 static struct access_list *access_list_new(void) {
 	return (struct access_list *) XCALLOC(MTYPE_ACCESS_LIST, sizeof(struct access_list));
@@ -201,6 +343,9 @@ static void access_list_delete(struct access_list *access) {
 		next = filter->next;
 		filter_free(filter);
 	}
+	if(access->trie) {
+		route_table_finish(access->trie);
+	}
 
 	master = access->master;
 
@@ -375,15 +520,14 @@ enum filter_type access_list_apply(struct access_list *access, void *object) {
 		return FILTER_DENY;
 	}
 
+	if(access->count >= ACCESS_LIST_TRIE_MIN && p->family == access_list_family(access)) {
+		filter = access_list_trie_match(access, p);
+		return filter ? filter->type : FILTER_DENY;
+	}
+
 	for(filter = access->head; filter; filter = filter->next) {
-		if(filter->cisco) {
-			if(filter_match_cisco(filter, p)) {
-				return filter->type;
-			}
-		} else {
-			if(filter_match_zebra(filter, p)) {
-				return filter->type;
-			}
+		if(filter_match(filter, p)) {
+			return filter->type;
 		}
 	}
 
@@ -418,6 +562,11 @@ static void access_list_filter_add(struct access_list *access, struct filter *fi
 	}
 	access->tail = filter;
 
+	filter->seq = ++access->seq;
+	filter->trie_next = NULL;
+	access_list_trie_add(access, filter);
+	access->count++;
+
 	/* Run hook function. */
 	if(access->master->add_hook) {
 		(*access->master->add_hook)(access->name);
@@ -467,11 +616,16 @@ static void access_list_filter_delete(struct access_list *access, struct filter
 		access->head = filter->next;
 	}
 
+	access_list_trie_delete(access, filter);
+	access->count--;
 	filter_free(filter);
 
-	/* If access_list becomes empty delete it from access_master. */
+	/* If access_list becomes empty delete it from access_master,
+	   otherwise it keeps its name. */
 	if(access_list_empty(access)) {
 		access_list_delete(access);
+	} else {
+		access->name = XSTRDUP(MTYPE_ACCESS_LIST_STR, name);
 	}
 
 	/* Run hook function. */
@@ -57,6 +57,13 @@ struct access_list {
 
 	struct filter *head;
 	struct filter *tail;
+	unsigned int count;
+
+	/* Filters by prefix, kept up to date as filters are added and
+	   deleted, and those which can't be put on it; see filter.c. */
+	struct route_table *trie;
+	struct filter *unindexed;
+	u_int32_t seq;
 };
 
 /* Prototypes for access-list. */
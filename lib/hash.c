@@ -30,7 +30,7 @@ struct hash *hash_create_size(unsigned int size, unsigned int (*hash_key)(void *
 	struct hash *hash;
 
 	assert((size & (size - 1)) == 0);
-	hash = XMALLOC(MTYPE_HASH, sizeof(struct hash));
+	hash = XCALLOC(MTYPE_HASH, sizeof(struct hash));
 	hash->index = XCALLOC(MTYPE_HASH_INDEX, sizeof(struct hash_backet *) * size);
 	hash->size = size;
 	hash->no_expand = 0;
@@ -46,6 +46,250 @@ struct hash *hash_create(unsigned int (*hash_key)(void *), int (*hash_cmp)(const
 	return hash_create_size(HASH_INITIAL_SIZE, hash_key, hash_cmp);
 }
 
+/* Open addressing.
+
+   A hash created with hash_create_open() keeps its backets inline in
+   one array, probed linearly Robin Hood style: an entry further from its
+   home slot takes the place of one closer to its own, which keeps probe
+   sequences short and lets a failed lookup stop early.  Release shifts
+   the rest of the run back by one instead of leaving tombstones.  The
+   backet's next pointer is unused.
+
+   The array doubles when 7/8 full.  The old one is kept and moved over
+   a few runs at a time by each insertion, so no single hash_get() pays
+   for rehashing everything; lookups check both until that's done. */
+#define HASH_OPEN_MAX_LOAD(size) ((size) - (size) / 8)
+#define HASH_OPEN_MIGRATE 8
+
+/* Distance of a backet in 'slot' from its home slot. */
+#define HASH_OPEN_DIST(key, slot, size) (((slot) - (key)) & ((size) - 1))
+
+/* Allocate a new open addressed hash. */
+struct hash *hash_create_open(unsigned int (*hash_key)(void *), int (*hash_cmp)(const void *, const void *)) {
+	struct hash *hash;
+
+	hash = XCALLOC(MTYPE_HASH, sizeof(struct hash));
+	hash->open = 1;
+	hash->slot = XCALLOC(MTYPE_HASH_INDEX, sizeof(struct hash_backet) * HASH_INITIAL_SIZE);
+	hash->size = HASH_INITIAL_SIZE;
+	hash->hash_key = hash_key;
+	hash->hash_cmp = hash_cmp;
+
+	return hash;
+}
+
+static struct hash_backet *hash_open_find(struct hash *hash, struct hash_backet *slot, unsigned int size, unsigned int key, void *data) {
+	unsigned int i, dist;
+
+	for(i = key & (size - 1), dist = 0;; i = (i + 1) & (size - 1), dist++) {
+		struct hash_backet *hb = &slot[i];
+
+		if(hb->data == NULL || HASH_OPEN_DIST(hb->key, i, size) < dist) {
+			return NULL;
+		}
+		if(hb->key == key && (*hash->hash_cmp)(hb->data, data)) {
+			return hb;
+		}
+	}
+}
+
+static void hash_open_insert(struct hash_backet *slot, unsigned int size, unsigned int key, void *data) {
+	unsigned int i, dist;
+
+	for(i = key & (size - 1), dist = 0;; i = (i + 1) & (size - 1), dist++) {
+		struct hash_backet *hb = &slot[i];
+		unsigned int hb_dist;
+
+		if(hb->data == NULL) {
+			hb->key = key;
+			hb->data = data;
+			return;
+		}
+
+		/* Rob the richer: carry on inserting the displaced backet. */
+		hb_dist = HASH_OPEN_DIST(hb->key, i, size);
+		if(hb_dist < dist) {
+			unsigned int tmp_key = hb->key;
+			void *tmp_data = hb->data;
+
+			hb->key = key;
+			hb->data = data;
+			key = tmp_key;
+			data = tmp_data;
+			dist = hb_dist;
+		}
+	}
+}
+
+/* Empty slot i, shifting back the rest of its run. */
+static void hash_open_remove(struct hash_backet *slot, unsigned int size, unsigned int i) {
+	unsigned int next;
+
+	for(next = (i + 1) & (size - 1); slot[next].data && HASH_OPEN_DIST(slot[next].key, next, size); next = (next + 1) & (size - 1)) {
+		slot[i] = slot[next];
+		i = next;
+	}
+	slot[i].key = 0;
+	slot[i].data = NULL;
+}
+
+/* Move at least n slots of the old array over, stopping only at the
+   start of a run so lookups in what's left of it still work. */
+static void hash_open_migrate(struct hash *hash, unsigned int n) {
+	struct hash_backet *hb;
+
+	while(hash->migrated < hash->old_size) {
+		hb = &hash->old_slot[hash->migrated];
+		if(n == 0 && (hb->data == NULL || HASH_OPEN_DIST(hb->key, hash->migrated, hash->old_size) == 0)) {
+			return;
+		}
+		if(n > 0) {
+			n--;
+		}
+
+		if(hb->data) {
+			hash_open_insert(hash->slot, hash->size, hb->key, hb->data);
+			hb->data = NULL;
+		}
+		hash->migrated++;
+	}
+
+	XFREE(MTYPE_HASH_INDEX, hash->old_slot);
+	hash->old_slot = NULL;
+	hash->old_size = 0;
+	hash->migrated = 0;
+}
+
+static void hash_open_expand(struct hash *hash) {
+	if(hash->old_slot) {
+		hash_open_migrate(hash, hash->old_size);
+	}
+
+	hash->old_slot = hash->slot;
+	hash->old_size = hash->size;
+	hash->migrated = 0;
+
+	hash->size *= 2;
+	hash->slot = XCALLOC(MTYPE_HASH_INDEX, sizeof(struct hash_backet) * hash->size);
+
+	hash_open_migrate(hash, HASH_OPEN_MIGRATE);
+}
+
+static void *hash_open_get(struct hash *hash, void *data, void *(*alloc_func)(void *) ) {
+	unsigned int key;
+	void *newdata;
+	struct hash_backet *hb;
+
+	key = (*hash->hash_key)(data);
+
+	hb = hash_open_find(hash, hash->slot, hash->size, key, data);
+	if(hb == NULL && hash->old_slot) {
+		hb = hash_open_find(hash, hash->old_slot, hash->old_size, key, data);
+	}
+	if(hb) {
+		return hb->data;
+	}
+
+	if(alloc_func) {
+		newdata = (*alloc_func)(data);
+		if(newdata == NULL) {
+			return NULL;
+		}
+
+		if(hash->count + 1 > HASH_OPEN_MAX_LOAD(hash->size)) {
+			hash_open_expand(hash);
+		} else if(hash->old_slot) {
+			hash_open_migrate(hash, HASH_OPEN_MIGRATE);
+		}
+
+		hash_open_insert(hash->slot, hash->size, key, newdata);
+		hash->count++;
+		return newdata;
+	}
+	return NULL;
+}
+
+static void *hash_open_release(struct hash *hash, void *data) {
+	void *ret;
+	unsigned int key;
+	struct hash_backet *hb;
+
+	key = (*hash->hash_key)(data);
+
+	hb = hash_open_find(hash, hash->slot, hash->size, key, data);
+	if(hb) {
+		ret = hb->data;
+		hash_open_remove(hash->slot, hash->size, hb - hash->slot);
+	} else if(hash->old_slot && (hb = hash_open_find(hash, hash->old_slot, hash->old_size, key, data))) {
+		ret = hb->data;
+		hash_open_remove(hash->old_slot, hash->old_size, hb - hash->old_slot);
+	} else {
+		return NULL;
+	}
+
+	hash->count--;
+	return ret;
+}
+
+/* Visit n slots from 'start' on.  func may release the backet it's
+   given, in which case the slot is looked at again as the rest of the
+   run has moved back into it.  Starting on a slot that begins a run
+   means nothing is shifted back past the start and seen twice. */
+static void hash_open_iterate_slots(struct hash *hash, struct hash_backet *slot, unsigned int size, unsigned int start, unsigned int n, void (*func)(struct hash_backet *, void *), void *arg) {
+	while(n > 0) {
+		struct hash_backet *hb = &slot[start & (size - 1)];
+
+		if(hb->data) {
+			unsigned long count = hash->count;
+
+			(*func)(hb, arg);
+			if(hash->count < count) {
+				continue;
+			}
+		}
+		start++;
+		n--;
+	}
+}
+
+static void hash_open_iterate(struct hash *hash, void (*func)(struct hash_backet *, void *), void *arg) {
+	unsigned int start;
+
+	/* Everything below 'migrated' is empty, so it's a run start. */
+	if(hash->old_slot) {
+		hash_open_iterate_slots(hash, hash->old_slot, hash->old_size, hash->migrated, hash->old_size - hash->migrated, func, arg);
+	}
+
+	for(start = 0; start < hash->size; start++) {
+		struct hash_backet *hb = &hash->slot[start];
+
+		if(hb->data == NULL || HASH_OPEN_DIST(hb->key, start, hash->size) == 0) {
+			break;
+		}
+	}
+	hash_open_iterate_slots(hash, hash->slot, hash->size, start, hash->size, func, arg);
+}
+
+static void hash_open_clean(struct hash *hash, void (*free_func)(void *)) {
+	unsigned int i;
+
+	if(hash->old_slot) {
+		hash_open_migrate(hash, hash->old_size);
+	}
+
+	for(i = 0; i < hash->size; i++) {
+		if(hash->slot[i].data == NULL) {
+			continue;
+		}
+		if(free_func) {
+			(*free_func)(hash->slot[i].data);
+		}
+		hash->slot[i].key = 0;
+		hash->slot[i].data = NULL;
+		hash->count--;
+	}
+}
+
 /* Utility function for hash_get().  When this function is specified
    as alloc_func, return arugment as it is.  This function is used for
    intern already allocated value.  */
@@ -110,6 +354,10 @@ void *hash_get(struct hash *hash, void *data, void *(*alloc_func)(void *) ) {
 	unsigned int len;
 	struct hash_backet *backet;
 
+	if(hash->open) {
+		return hash_open_get(hash, data, alloc_func);
+	}
+
 	key = (*hash->hash_key)(data);
 	index = key & (hash->size - 1);
 	len = 0;
@@ -169,6 +417,10 @@ void *hash_release(struct hash *hash, void *data) {
 	struct hash_backet *backet;
 	struct hash_backet *pp;
 
+	if(hash->open) {
+		return hash_open_release(hash, data);
+	}
+
 	key = (*hash->hash_key)(data);
 	index = key & (hash->size - 1);
 
@@ -196,6 +448,11 @@ void hash_iterate(struct hash *hash, void (*func)(struct hash_backet *, void *),
 	struct hash_backet *hb;
 	struct hash_backet *hbnext;
 
+	if(hash->open) {
+		hash_open_iterate(hash, func, arg);
+		return;
+	}
+
 	for(i = 0; i < hash->size; i++) {
 		for(hb = hash->index[i]; hb; hb = hbnext) {
 			/* get pointer to next hash backet here, in case (*func)
@@ -213,6 +470,11 @@ void hash_clean(struct hash *hash, void (*free_func)(void *)) {
 	struct hash_backet *hb;
 	struct hash_backet *next;
 
+	if(hash->open) {
+		hash_open_clean(hash, free_func);
+		return;
+	}
+
 	for(i = 0; i < hash->size; i++) {
 		for(hb = hash->index[i]; hb; hb = next) {
 			next = hb->next;
@@ -231,6 +493,8 @@ void hash_clean(struct hash *hash, void (*free_func)(void *)) {
 /* Free hash memory.  You may call hash_clean before call this
    function.  */
 void hash_free(struct hash *hash) {
+	XFREE(MTYPE_HASH_INDEX, hash->slot);
+	XFREE(MTYPE_HASH_INDEX, hash->old_slot);
 	XFREE(MTYPE_HASH_INDEX, hash->index);
 	XFREE(MTYPE_HASH, hash);
 }
@@ -55,10 +55,22 @@ struct hash {
 
 	/* Backet alloc. */
 	unsigned long count;
+
+	/* Open addressing, see hash_create_open().  Backets are kept
+     inline in 'slot', 'size' of them, and 'index' is unused. */
+	int open;
+	struct hash_backet *slot;
+
+	/* Previous slot array while it's being migrated after an expand,
+     slots below 'migrated' have been moved already. */
+	struct hash_backet *old_slot;
+	unsigned int old_size;
+	unsigned int migrated;
 };
 
 extern struct hash *hash_create(unsigned int (*)(void *), int (*)(const void *, const void *));
 extern struct hash *hash_create_size(unsigned int, unsigned int (*)(void *), int (*)(const void *, const void *));
+extern struct hash *hash_create_open(unsigned int (*)(void *), int (*)(const void *, const void *));
 
 extern void *hash_get(struct hash *, void *, void *(*) (void *) );
 extern void *hash_alloc_intern(void *);
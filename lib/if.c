@@ -37,6 +37,8 @@
 #include "buffer.h"
 #include "str.h"
 #include "log.h"
+#include "hash.h"
+#include "jhash.h"
 
 /* List of interfaces in only the default VRF */
 struct list *iflist;
@@ -49,6 +51,179 @@ struct if_master {
 	0,
 };
 
+/* Lookup indexes over one VRF's interfaces, kept in step with its
+ * interface list: by ifindex and by name, and, per address family, each
+ * host address and each subnet pointing to the list of connected
+ * structures carrying it.  An address is filed under its own subnet and,
+ * since peer flags may be set once it's linked, under its destination's
+ * as well; lookups check the candidates against CONNECTED_PREFIX.
+ */
+struct if_vrf_index {
+	vrf_id_t vrf_id;
+	struct hash *by_index;
+	struct hash *by_name;
+	struct route_table *addr[AFI_MAX];
+	struct route_table *subnet[AFI_MAX];
+};
+
+static struct if_vrf_index *if_index_default;
+static struct hash *if_index_vrfs;
+
+static unsigned int if_index_vrf_key(void *arg) {
+	return jhash_1word(((struct if_vrf_index *) arg)->vrf_id, 0);
+}
+
+static int if_index_vrf_cmp(const void *a, const void *b) {
+	return ((const struct if_vrf_index *) a)->vrf_id == ((const struct if_vrf_index *) b)->vrf_id;
+}
+
+static unsigned int if_index_key(void *arg) {
+	return jhash_1word(((struct interface *) arg)->ifindex, 0);
+}
+
+static int if_index_cmp(const void *a, const void *b) {
+	return ((const struct interface *) a)->ifindex == ((const struct interface *) b)->ifindex;
+}
+
+static unsigned int if_name_key(void *arg) {
+	return string_hash_make(((struct interface *) arg)->name);
+}
+
+static int if_name_cmp(const void *a, const void *b) {
+	return strcmp(((const struct interface *) a)->name, ((const struct interface *) b)->name) == 0;
+}
+
+static struct if_vrf_index *if_vrf_index(vrf_id_t vrf_id) {
+	struct if_vrf_index key;
+
+	if(vrf_id == VRF_DEFAULT) {
+		return if_index_default;
+	}
+	if(!if_index_vrfs) {
+		return NULL;
+	}
+	key.vrf_id = vrf_id;
+	return hash_lookup(if_index_vrfs, &key);
+}
+
+static struct route_table *if_index_table(struct route_table **tables, int family) {
+	afi_t afi = family2afi(family);
+
+	return (afi == AFI_IP || afi == AFI_IP6) ? tables[afi] : NULL;
+}
+
+static struct route_node *if_index_link(struct route_table *table, struct prefix *p, struct connected *ifc) {
+	struct route_node *rn;
+
+	/* One lock is held for as long as the node has a list */
+	rn = route_node_get(table, p);
+	if(rn->info) {
+		route_unlock_node(rn);
+	} else {
+		rn->info = list_new();
+	}
+	listnode_add(rn->info, ifc);
+	return rn;
+}
+
+static void if_index_unlink(struct route_node *rn, struct connected *ifc) {
+	struct list *list = rn->info;
+
+	listnode_delete(list, ifc);
+	if(list_isempty(list)) {
+		list_delete(list);
+		rn->info = NULL;
+		route_unlock_node(rn);
+	}
+}
+
+/* File the address under its host route and subnet(s). */
+static void connected_index(struct connected *ifc) {
+	struct if_vrf_index *idx;
+	struct route_table *addr;
+	struct route_table *subnet;
+	struct prefix p;
+	struct prefix q;
+
+	idx = if_vrf_index(ifc->ifp->vrf_id);
+	if(!idx || !ifc->address) {
+		return;
+	}
+	addr = if_index_table(idx->addr, ifc->address->family);
+	subnet = if_index_table(idx->subnet, ifc->address->family);
+	if(!addr || !subnet) {
+		return;
+	}
+
+	prefix_copy(&p, ifc->address);
+	p.prefixlen = (p.family == AF_INET) ? IPV4_MAX_BITLEN : IPV6_MAX_BITLEN;
+	ifc->index_node[0] = if_index_link(addr, &p, ifc);
+
+	prefix_copy(&p, ifc->address);
+	apply_mask(&p);
+	ifc->index_node[1] = if_index_link(subnet, &p, ifc);
+
+	if(ifc->destination && ifc->destination->family == p.family) {
+		prefix_copy(&q, ifc->destination);
+		q.prefixlen = p.prefixlen;
+		apply_mask(&q);
+		if(!prefix_same(&p, &q)) {
+			ifc->index_node[2] = if_index_link(subnet, &q, ifc);
+		}
+	}
+}
+
+static void connected_unindex(struct connected *ifc) {
+	int i;
+
+	for(i = 0; i < 3; i++) {
+		if(ifc->index_node[i]) {
+			if_index_unlink(ifc->index_node[i], ifc);
+			ifc->index_node[i] = NULL;
+		}
+	}
+}
+
+/* The longest subnet of an interface address holding p, a host address. */
+static struct interface *if_index_match(struct route_table *table, struct prefix *p) {
+	struct route_node *top;
+	struct route_node *rn;
+	struct listnode *node;
+	struct connected *c;
+
+	if(!table || !(top = route_node_match(table, p))) {
+		return NULL;
+	}
+
+	/* Candidates are filed under their address' prefix length, so the
+	 * first that really holds p, walking up, is the longest. */
+	for(rn = top; rn && rn->p.prefixlen > 0; rn = rn->parent) {
+		if(!rn->info) {
+			continue;
+		}
+		for(ALL_LIST_ELEMENTS_RO((struct list *) rn->info, node, c)) {
+			if(prefix_match(CONNECTED_PREFIX(c), p)) {
+				route_unlock_node(top);
+				return c->ifp;
+			}
+		}
+	}
+	route_unlock_node(top);
+	return NULL;
+}
+
+static struct interface *if_index_exact(struct route_table *table, struct prefix *p) {
+	struct route_node *rn;
+	struct connected *c;
+
+	if(!table || !(rn = route_node_lookup(table, p))) {
+		return NULL;
+	}
+	route_unlock_node(rn);
+	c = listnode_head(rn->info);
+	return c ? c->ifp : NULL;
+}
+
 /* Compare interface names, returning an integer greater than, equal to, or
  * less than 0, (following the strcmp convention), according to the
  * relationship between ifp1 and ifp2.  Interface names consist of an
@@ -135,6 +310,7 @@ struct interface *if_create_vrf(const char *name, int namelen, vrf_id_t vrf_id)
 	ifp->vrf_id = vrf_id;
 	if(if_lookup_by_name_vrf(ifp->name, vrf_id) == NULL) {
 		listnode_add_sort(intf_list, ifp);
+		hash_get(if_vrf_index(vrf_id)->by_name, ifp, hash_alloc_intern);
 	} else {
 		zlog_err(
 			"if_create(%s): corruption detected -- interface with this "
@@ -158,16 +334,30 @@ struct interface *if_create(const char *name, int namelen) {
 
 /* Delete interface structure. */
 void if_delete_retain(struct interface *ifp) {
+	struct listnode *node;
+	struct connected *ifc;
+
 	if(if_master.if_delete_hook) {
 		(*if_master.if_delete_hook)(ifp);
 	}
 
 	/* Free connected address list */
+	for(ALL_LIST_ELEMENTS_RO(ifp->connected, node, ifc)) {
+		connected_unindex(ifc);
+	}
 	list_delete_all_node(ifp->connected);
 }
 
 /* Delete and free interface structure. */
 void if_delete(struct interface *ifp) {
+	struct if_vrf_index *idx = if_vrf_index(ifp->vrf_id);
+
+	if(idx && hash_lookup(idx->by_name, ifp) == ifp) {
+		if(hash_lookup(idx->by_index, ifp) == ifp) {
+			hash_release(idx->by_index, ifp);
+		}
+		hash_release(idx->by_name, ifp);
+	}
 	listnode_delete(vrf_iflist(ifp->vrf_id), ifp);
 
 	if_delete_retain(ifp);
@@ -179,6 +369,30 @@ void if_delete(struct interface *ifp) {
 	XFREE(MTYPE_IF, ifp);
 }
 
+void if_set_index(struct interface *ifp, ifindex_t ifindex) {
+	struct if_vrf_index *idx = if_vrf_index(ifp->vrf_id);
+	struct interface *other;
+
+	/* Interfaces that didn't make it into the list aren't indexed */
+	if(!idx || hash_lookup(idx->by_name, ifp) != ifp) {
+		ifp->ifindex = ifindex;
+		return;
+	}
+
+	if(ifp->ifindex != IFINDEX_INTERNAL && hash_lookup(idx->by_index, ifp) == ifp) {
+		hash_release(idx->by_index, ifp);
+	}
+	ifp->ifindex = ifindex;
+	if(ifindex != IFINDEX_INTERNAL) {
+		/* The kernel has the last word if an index is reused before its
+		 * old interface is gone */
+		if((other = hash_lookup(idx->by_index, ifp)) != NULL) {
+			hash_release(idx->by_index, other);
+		}
+		hash_get(idx->by_index, ifp, hash_alloc_intern);
+	}
+}
+
 /* Add hook to interface master. */
 void if_add_hook(int type, int (*func)(struct interface *ifp)) {
 	switch(type) {
@@ -190,15 +404,14 @@ void if_add_hook(int type, int (*func)(struct interface *ifp)) {
 
 /* Interface existance check by index. */
 struct interface *if_lookup_by_index_vrf(ifindex_t ifindex, vrf_id_t vrf_id) {
-	struct listnode *node;
-	struct interface *ifp;
+	struct if_vrf_index *idx = if_vrf_index(vrf_id);
+	struct interface key;
 
-	for(ALL_LIST_ELEMENTS_RO(vrf_iflist(vrf_id), node, ifp)) {
-		if(ifp->ifindex == ifindex) {
-			return ifp;
-		}
+	if(!idx) {
+		return NULL;
 	}
-	return NULL;
+	key.ifindex = ifindex;
+	return hash_lookup(idx->by_index, &key);
 }
 
 struct interface *if_lookup_by_index(ifindex_t ifindex) {
@@ -227,17 +440,7 @@ ifindex_t ifname2ifindex(const char *name) {
 
 /* Interface existance check by interface name. */
 struct interface *if_lookup_by_name_vrf(const char *name, vrf_id_t vrf_id) {
-	struct listnode *node;
-	struct interface *ifp;
-
-	if(name) {
-		for(ALL_LIST_ELEMENTS_RO(vrf_iflist(vrf_id), node, ifp)) {
-			if(strcmp(name, ifp->name) == 0) {
-				return ifp;
-			}
-		}
-	}
-	return NULL;
+	return name ? if_lookup_by_name_len_vrf(name, strlen(name), vrf_id) : NULL;
 }
 
 struct interface *if_lookup_by_name(const char *name) {
@@ -245,19 +448,15 @@ struct interface *if_lookup_by_name(const char *name) {
 }
 
 struct interface *if_lookup_by_name_len_vrf(const char *name, size_t namelen, vrf_id_t vrf_id) {
-	struct listnode *node;
-	struct interface *ifp;
+	struct if_vrf_index *idx = if_vrf_index(vrf_id);
+	struct interface key;
 
-	if(namelen > INTERFACE_NAMSIZ) {
+	if(!idx || namelen > INTERFACE_NAMSIZ) {
 		return NULL;
 	}
-
-	for(ALL_LIST_ELEMENTS_RO(vrf_iflist(vrf_id), node, ifp)) {
-		if(!memcmp(name, ifp->name, namelen) && (ifp->name[namelen] == '\0')) {
-			return ifp;
-		}
-	}
-	return NULL;
+	memcpy(key.name, name, namelen);
+	key.name[namelen] = '\0';
+	return hash_lookup(idx->by_name, &key);
 }
 
 struct interface *if_lookup_by_name_len(const char *name, size_t namelen) {
@@ -266,24 +465,16 @@ struct interface *if_lookup_by_name_len(const char *name, size_t namelen) {
 
 /* Lookup interface by IPv4 address. */
 struct interface *if_lookup_exact_address_vrf(struct in_addr src, vrf_id_t vrf_id) {
-	struct listnode *node;
-	struct listnode *cnode;
-	struct interface *ifp;
-	struct prefix *p;
-	struct connected *c;
-
-	for(ALL_LIST_ELEMENTS_RO(vrf_iflist(vrf_id), node, ifp)) {
-		for(ALL_LIST_ELEMENTS_RO(ifp->connected, cnode, c)) {
-			p = c->address;
+	struct if_vrf_index *idx = if_vrf_index(vrf_id);
+	struct prefix_ipv4 p;
 
-			if(p && p->family == AF_INET) {
-				if(IPV4_ADDR_SAME(&p->u.prefix4, &src)) {
-					return ifp;
-				}
-			}
-		}
+	if(!idx) {
+		return NULL;
 	}
-	return NULL;
+	p.family = AF_INET;
+	p.prefix = src;
+	p.prefixlen = IPV4_MAX_BITLEN;
+	return if_index_exact(idx->addr[AFI_IP], (struct prefix *) &p);
 }
 
 struct interface *if_lookup_exact_address(struct in_addr src) {
@@ -292,29 +483,16 @@ struct interface *if_lookup_exact_address(struct in_addr src) {
 
 /* Lookup interface by IPv4 address. */
 struct interface *if_lookup_address_vrf(struct in_addr src, vrf_id_t vrf_id) {
-	struct listnode *node;
-	struct prefix addr;
-	int bestlen = 0;
-	struct listnode *cnode;
-	struct interface *ifp;
-	struct connected *c;
-	struct interface *match;
-
-	addr.family = AF_INET;
-	addr.u.prefix4 = src;
-	addr.prefixlen = IPV4_MAX_BITLEN;
+	struct if_vrf_index *idx = if_vrf_index(vrf_id);
+	struct prefix_ipv4 p;
 
-	match = NULL;
-
-	for(ALL_LIST_ELEMENTS_RO(vrf_iflist(vrf_id), node, ifp)) {
-		for(ALL_LIST_ELEMENTS_RO(ifp->connected, cnode, c)) {
-			if(c->address && (c->address->family == AF_INET) && prefix_match(CONNECTED_PREFIX(c), &addr) && (c->address->prefixlen > bestlen)) {
-				bestlen = c->address->prefixlen;
-				match = ifp;
-			}
-		}
+	if(!idx) {
+		return NULL;
 	}
-	return match;
+	p.family = AF_INET;
+	p.prefix = src;
+	p.prefixlen = IPV4_MAX_BITLEN;
+	return if_index_match(idx->subnet[AFI_IP], (struct prefix *) &p);
 }
 
 struct interface *if_lookup_address(struct in_addr src) {
@@ -323,16 +501,26 @@ struct interface *if_lookup_address(struct in_addr src) {
 
 /* Lookup interface by prefix */
 struct interface *if_lookup_prefix_vrf(struct prefix *prefix, vrf_id_t vrf_id) {
+	struct if_vrf_index *idx = if_vrf_index(vrf_id);
+	struct route_table *table;
+	struct route_node *rn;
 	struct listnode *node;
-	struct listnode *cnode;
-	struct interface *ifp;
 	struct connected *c;
+	struct prefix p;
 
-	for(ALL_LIST_ELEMENTS_RO(vrf_iflist(vrf_id), node, ifp)) {
-		for(ALL_LIST_ELEMENTS_RO(ifp->connected, cnode, c)) {
-			if(prefix_cmp(c->address, prefix) == 0) {
-				return ifp;
-			}
+	if(!idx || !(table = if_index_table(idx->subnet, prefix->family))) {
+		return NULL;
+	}
+	prefix_copy(&p, prefix);
+	apply_mask(&p);
+	if(!(rn = route_node_lookup(table, &p))) {
+		return NULL;
+	}
+	route_unlock_node(rn);
+
+	for(ALL_LIST_ELEMENTS_RO((struct list *) rn->info, node, c)) {
+		if(prefix_cmp(c->address, prefix) == 0) {
+			return c->ifp;
 		}
 	}
 	return NULL;
@@ -342,6 +530,42 @@ struct interface *if_lookup_prefix(struct prefix *prefix) {
 	return if_lookup_prefix_vrf(prefix, VRF_DEFAULT);
 }
 
+/* Lookup interface by IPv6 address. */
+struct interface *if_lookup_exact_address6_vrf(struct in6_addr *src, vrf_id_t vrf_id) {
+	struct if_vrf_index *idx = if_vrf_index(vrf_id);
+	struct prefix_ipv6 p;
+
+	if(!idx) {
+		return NULL;
+	}
+	p.family = AF_INET6;
+	p.prefix = *src;
+	p.prefixlen = IPV6_MAX_BITLEN;
+	return if_index_exact(idx->addr[AFI_IP6], (struct prefix *) &p);
+}
+
+struct interface *if_lookup_exact_address6(struct in6_addr *src) {
+	return if_lookup_exact_address6_vrf(src, VRF_DEFAULT);
+}
+
+/* Lookup interface by IPv6 address. */
+struct interface *if_lookup_address6_vrf(struct in6_addr *src, vrf_id_t vrf_id) {
+	struct if_vrf_index *idx = if_vrf_index(vrf_id);
+	struct prefix_ipv6 p;
+
+	if(!idx) {
+		return NULL;
+	}
+	p.family = AF_INET6;
+	p.prefix = *src;
+	p.prefixlen = IPV6_MAX_BITLEN;
+	return if_index_match(idx->subnet[AFI_IP6], (struct prefix *) &p);
+}
+
+struct interface *if_lookup_address6(struct in6_addr *src) {
+	return if_lookup_address6_vrf(src, VRF_DEFAULT);
+}
+
 /* Get interface by name if given name interface doesn't exist create
    one. */
 struct interface *if_get_by_name_vrf(const char *name, vrf_id_t vrf_id) {
@@ -687,6 +911,8 @@ struct connected *connected_new(void) {
 
 /* Free connected structure. */
 void connected_free(struct connected *connected) {
+	connected_unindex(connected);
+
 	if(connected->address) {
 		prefix_free(connected->address);
 	}
@@ -747,7 +973,7 @@ struct connected *connected_delete_by_prefix(struct interface *ifp, struct prefi
 		next = node->next;
 
 		if(connected_same_prefix(ifc->address, p)) {
-			listnode_delete(ifp->connected, ifc);
+			connected_delete(ifp, ifc);
 			return ifc;
 		}
 	}
@@ -794,10 +1020,20 @@ struct connected *connected_add_by_prefix(struct interface *ifp, struct prefix *
 	}
 
 	/* Add connected address to the interface. */
-	listnode_add(ifp->connected, ifc);
+	connected_add(ifp, ifc);
 	return ifc;
 }
 
+void connected_add(struct interface *ifp, struct connected *ifc) {
+	listnode_add(ifp->connected, ifc);
+	connected_index(ifc);
+}
+
+void connected_delete(struct interface *ifp, struct connected *ifc) {
+	connected_unindex(ifc);
+	listnode_delete(ifp->connected, ifc);
+}
+
 #ifndef HAVE_IF_NAMETOINDEX
 ifindex_t if_nametoindex(const char *name) {
 	struct interface *ifp;
@@ -818,100 +1054,38 @@ char *if_indextoname(ifindex_t ifindex, char *name) {
 }
 #endif
 
-#if 0  /* this route_table of struct connected's is unused
-       * however, it would be good to use a route_table rather than
-       * a list..
-       */
-/* Interface looking up by interface's address. */
-/* Interface's IPv4 address reverse lookup table. */
-struct route_table *ifaddr_ipv4_table;
-/* struct route_table *ifaddr_ipv6_table; */
-
-static void
-ifaddr_ipv4_add (struct in_addr *ifaddr, struct interface *ifp)
-{
-  struct route_node *rn;
-  struct prefix_ipv4 p;
-
-  p.family = AF_INET;
-  p.prefixlen = IPV4_MAX_PREFIXLEN;
-  p.prefix = *ifaddr;
-
-  rn = route_node_get (ifaddr_ipv4_table, (struct prefix *) &p);
-  if (rn)
-    {
-      route_unlock_node (rn);
-      zlog_info ("ifaddr_ipv4_add(): address %s is already added",
-		 inet_ntoa (*ifaddr));
-      return;
-    }
-  rn->info = ifp;
-}
-
-static void
-ifaddr_ipv4_delete (struct in_addr *ifaddr, struct interface *ifp)
-{
-  struct route_node *rn;
-  struct prefix_ipv4 p;
-
-  p.family = AF_INET;
-  p.prefixlen = IPV4_MAX_PREFIXLEN;
-  p.prefix = *ifaddr;
-
-  rn = route_node_lookup (ifaddr_ipv4_table, (struct prefix *) &p);
-  if (! rn)
-    {
-      zlog_info ("ifaddr_ipv4_delete(): can't find address %s",
-		 inet_ntoa (*ifaddr));
-      return;
-    }
-  rn->info = NULL;
-  route_unlock_node (rn);
-  route_unlock_node (rn);
-}
-
-/* Lookup interface by interface's IP address or interface index. */
-static struct interface *
-ifaddr_ipv4_lookup (struct in_addr *addr, ifindex_t ifindex)
-{
-  struct prefix_ipv4 p;
-  struct route_node *rn;
-  struct interface *ifp;
-
-  if (addr)
-    {
-      p.family = AF_INET;
-      p.prefixlen = IPV4_MAX_PREFIXLEN;
-      p.prefix = *addr;
-
-      rn = route_node_lookup (ifaddr_ipv4_table, (struct prefix *) &p);
-      if (! rn)
-	return NULL;
-
-      ifp = rn->info;
-      route_unlock_node (rn);
-      return ifp;
-    }
-  else
-    return if_lookup_by_index(ifindex);
-}
-#endif /* ifaddr_ipv4_table */
-
 /* Initialize interface list. */
 void if_init(vrf_id_t vrf_id, struct list **intf_list) {
+	struct if_vrf_index *idx;
+
 	*intf_list = list_new();
-#if 0
-  ifaddr_ipv4_table = route_table_init ();
-#endif /* ifaddr_ipv4_table */
 
 	(*intf_list)->cmp = (int (*)(void *, void *)) if_cmp_func;
 
+	idx = XCALLOC(MTYPE_IF_INDEX, sizeof(struct if_vrf_index));
+	idx->vrf_id = vrf_id;
+	idx->by_index = hash_create_open(if_index_key, if_index_cmp);
+	idx->by_name = hash_create_open(if_name_key, if_name_cmp);
+	idx->addr[AFI_IP] = route_table_init();
+	idx->addr[AFI_IP6] = route_table_init();
+	idx->subnet[AFI_IP] = route_table_init();
+	idx->subnet[AFI_IP6] = route_table_init();
+
 	if(vrf_id == VRF_DEFAULT) {
 		iflist = *intf_list;
+		if_index_default = idx;
+	} else {
+		if(!if_index_vrfs) {
+			if_index_vrfs = hash_create(if_index_vrf_key, if_index_vrf_cmp);
+		}
+		hash_get(if_index_vrfs, idx, hash_alloc_intern);
 	}
 }
 
 void if_terminate(vrf_id_t vrf_id, struct list **intf_list) {
+	struct if_vrf_index *idx = if_vrf_index(vrf_id);
+	afi_t afi;
+
 	for(;;) {
 		struct interface *ifp;
 
@@ -928,6 +1102,19 @@ void if_terminate(vrf_id_t vrf_id, struct list **intf_list) {
 
 	if(vrf_id == VRF_DEFAULT) {
 		iflist = NULL;
+		if_index_default = NULL;
+	} else if(idx) {
+		hash_release(if_index_vrfs, idx);
+	}
+
+	if(idx) {
+		hash_free(idx->by_index);
+		hash_free(idx->by_name);
+		for(afi = AFI_IP; afi <= AFI_IP6; afi++) {
+			route_table_finish(idx->addr[afi]);
+			route_table_finish(idx->subnet[afi]);
+		}
+		XFREE(MTYPE_IF_INDEX, idx);
 	}
 }
 
@@ -297,6 +297,11 @@ struct connected {
 
 	/* Label for Linux 2.2.X and upper. */
 	char *label;
+
+	/* Nodes of the VRF's address indexes this address is linked in, see
+     connected_add(): the host address, its subnet and, when it falls
+     elsewhere, the destination's subnet. */
+	struct route_node *index_node[3];
 };
 
 /* Does the destination field contain a peer address? */
@@ -357,12 +362,20 @@ extern struct interface *if_lookup_by_index(ifindex_t);
 extern struct interface *if_lookup_exact_address(struct in_addr);
 extern struct interface *if_lookup_address(struct in_addr);
 extern struct interface *if_lookup_prefix(struct prefix *prefix);
+extern struct interface *if_lookup_exact_address6(struct in6_addr *);
+extern struct interface *if_lookup_address6(struct in6_addr *);
 
 extern struct interface *if_create_vrf(const char *name, int namelen, vrf_id_t vrf_id);
 extern struct interface *if_lookup_by_index_vrf(ifindex_t, vrf_id_t vrf_id);
 extern struct interface *if_lookup_exact_address_vrf(struct in_addr, vrf_id_t vrf_id);
 extern struct interface *if_lookup_address_vrf(struct in_addr, vrf_id_t vrf_id);
 extern struct interface *if_lookup_prefix_vrf(struct prefix *prefix, vrf_id_t vrf_id);
+extern struct interface *if_lookup_exact_address6_vrf(struct in6_addr *, vrf_id_t vrf_id);
+extern struct interface *if_lookup_address6_vrf(struct in6_addr *, vrf_id_t vrf_id);
+
+/* Change the interface's ifindex, keeping the index by ifindex in step:
+   ifp->ifindex must not be assigned directly. */
+extern void if_set_index(struct interface *, ifindex_t);
 
 /* These 2 functions are to be used when the ifname argument is terminated
    by a '\0' character: */
@@ -419,7 +432,10 @@ extern ifindex_t ifname2ifindex_vrf(const char *ifname, vrf_id_t vrf_id);
 /* Connected address functions. */
 extern struct connected *connected_new(void);
 extern void connected_free(struct connected *);
+/* Link an address into, or out of, the interface's connected list and
+   the VRF's address indexes; ifp->connected must not be changed directly. */
 extern void connected_add(struct interface *, struct connected *);
+extern void connected_delete(struct interface *, struct connected *);
 extern struct connected *connected_add_by_prefix(struct interface *, struct prefix *, struct prefix *);
 extern struct connected *connected_delete_by_prefix(struct interface *, struct prefix *);
 extern struct connected *connected_lookup_address(struct interface *, struct in_addr);
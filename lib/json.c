@@ -0,0 +1,188 @@
+/*
+ * Streaming JSON output for show commands.
+ *
+ * This file is part of Quagga.
+ *
+ * Quagga is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2, or (at your option) any
+ * later version.
+ *
+ * Quagga is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Quagga; see the file COPYING.  If not, write to the Free
+ * Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ * 02111-1307, USA.
+ */
+
+#include <zebra.h>
+
+#include "vty.h"
+#include "prefix.h"
+#include "json.h"
+
+#define json_out_lit(j, s) vty_out_raw((j)->vty, (s), sizeof(s) - 1)
+
+void json_out_init(struct json_out *j, struct vty *vty) {
+	memset(j, 0, sizeof(*j));
+	j->vty = vty;
+}
+
+void json_out_finish(struct json_out *j) {
+	assert(j->depth == 0);
+	json_out_lit(j, "\n");
+}
+
+/* Write s as a quoted JSON string, copying unescaped runs in one go. */
+static void json_out_quoted(struct json_out *j, const char *s) {
+	static const char hex[] = "0123456789abcdef";
+	const char *run = s;
+	char esc[6];
+
+	json_out_lit(j, "\"");
+	for(; *s; s++) {
+		u_char c = *s;
+
+		if(c >= 0x20 && c != '"' && c != '\\') {
+			continue;
+		}
+		if(s > run) {
+			vty_out_raw(j->vty, run, s - run);
+		}
+		run = s + 1;
+
+		esc[0] = '\\';
+		switch(c) {
+		case '"':
+		case '\\':
+			esc[1] = c;
+			vty_out_raw(j->vty, esc, 2);
+			break;
+		case '\n':
+			json_out_lit(j, "\\n");
+			break;
+		case '\t':
+			json_out_lit(j, "\\t");
+			break;
+		default:
+			esc[1] = 'u';
+			esc[2] = '0';
+			esc[3] = '0';
+			esc[4] = hex[c >> 4];
+			esc[5] = hex[c & 0xf];
+			vty_out_raw(j->vty, esc, 6);
+			break;
+		}
+	}
+	if(s > run) {
+		vty_out_raw(j->vty, run, s - run);
+	}
+	json_out_lit(j, "\"");
+}
+
+/* The separator and key that go before every value. */
+static void json_out_member(struct json_out *j, const char *key) {
+	if(j->more[j->depth]) {
+		json_out_lit(j, ",");
+	}
+	j->more[j->depth] = 1;
+
+	if(key) {
+		json_out_quoted(j, key);
+		json_out_lit(j, ":");
+	}
+}
+
+static void json_out_open(struct json_out *j, const char *key, const char *bracket) {
+	json_out_member(j, key);
+	vty_out_raw(j->vty, bracket, 1);
+
+	assert(j->depth < JSON_OUT_DEPTH - 1);
+	j->more[++j->depth] = 0;
+}
+
+static void json_out_close(struct json_out *j, const char *bracket) {
+	assert(j->depth > 0);
+	j->depth--;
+	vty_out_raw(j->vty, bracket, 1);
+}
+
+void json_out_object(struct json_out *j, const char *key) {
+	json_out_open(j, key, "{");
+}
+
+void json_out_object_end(struct json_out *j) {
+	json_out_close(j, "}");
+}
+
+void json_out_array(struct json_out *j, const char *key) {
+	json_out_open(j, key, "[");
+}
+
+void json_out_array_end(struct json_out *j) {
+	json_out_close(j, "]");
+}
+
+void json_out_str(struct json_out *j, const char *key, const char *val) {
+	json_out_member(j, key);
+	json_out_quoted(j, val);
+}
+
+static void json_out_digits(struct json_out *j, unsigned long long val) {
+	char buf[24];
+	char *p = buf + sizeof(buf);
+
+	do {
+		*--p = '0' + val % 10;
+		val /= 10;
+	} while(val);
+
+	vty_out_raw(j->vty, p, buf + sizeof(buf) - p);
+}
+
+void json_out_uint(struct json_out *j, const char *key, unsigned long long val) {
+	json_out_member(j, key);
+	json_out_digits(j, val);
+}
+
+void json_out_int(struct json_out *j, const char *key, long long val) {
+	json_out_member(j, key);
+	if(val < 0) {
+		json_out_lit(j, "-");
+		json_out_digits(j, -(unsigned long long) val);
+	} else {
+		json_out_digits(j, val);
+	}
+}
+
+void json_out_bool(struct json_out *j, const char *key, int val) {
+	json_out_member(j, key);
+	if(val) {
+		json_out_lit(j, "true");
+	} else {
+		json_out_lit(j, "false");
+	}
+}
+
+void json_out_null(struct json_out *j, const char *key) {
+	json_out_member(j, key);
+	json_out_lit(j, "null");
+}
+
+void json_out_in_addr(struct json_out *j, const char *key, struct in_addr addr) {
+	char buf[INET_ADDRSTRLEN];
+
+	inet_ntop(AF_INET, &addr, buf, sizeof(buf));
+	json_out_str(j, key, buf);
+}
+
+void json_out_prefix(struct json_out *j, const char *key, const struct prefix *p) {
+	char buf[PREFIX_STRLEN];
+
+	prefix2str(p, buf, sizeof(buf));
+	json_out_str(j, key, buf);
+}
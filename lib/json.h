@@ -0,0 +1,63 @@
+/*
+ * Streaming JSON output for show commands.
+ *
+ * This file is part of Quagga.
+ *
+ * Quagga is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2, or (at your option) any
+ * later version.
+ *
+ * Quagga is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Quagga; see the file COPYING.  If not, write to the Free
+ * Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ * 02111-1307, USA.
+ */
+
+#ifndef _QUAGGA_JSON_H
+#define _QUAGGA_JSON_H
+
+#include "vty.h"
+#include "prefix.h"
+
+#define JSON_OUT_DEPTH 16
+
+/* A json_out writes one JSON document straight into the vty output as
+ * its values are given, with no tree built and no printf per field.
+ * It holds no memory, so a show command whose output is continued (see
+ * vty_output_continue()) keeps it in its walk state and carries on.
+ *
+ * 'key' names the member inside an object and must be NULL inside an
+ * array or for the document itself.  Keys are written as given, so they
+ * should be plain identifiers; string values are escaped.
+ */
+struct json_out {
+	struct vty *vty;
+	int depth;
+	/* whether a value was already written at each level */
+	u_char more[JSON_OUT_DEPTH];
+};
+
+extern void json_out_init(struct json_out *, struct vty *);
+/* end the document with a newline; all containers must be closed */
+extern void json_out_finish(struct json_out *);
+
+extern void json_out_object(struct json_out *, const char *key);
+extern void json_out_object_end(struct json_out *);
+extern void json_out_array(struct json_out *, const char *key);
+extern void json_out_array_end(struct json_out *);
+
+extern void json_out_str(struct json_out *, const char *key, const char *);
+extern void json_out_int(struct json_out *, const char *key, long long);
+extern void json_out_uint(struct json_out *, const char *key, unsigned long long);
+extern void json_out_bool(struct json_out *, const char *key, int);
+extern void json_out_null(struct json_out *, const char *key);
+extern void json_out_in_addr(struct json_out *, const char *key, struct in_addr);
+extern void json_out_prefix(struct json_out *, const char *key, const struct prefix *);
+
+#endif /* _QUAGGA_JSON_H */
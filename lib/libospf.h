@@ -70,6 +70,8 @@
 #define OSPF_ROUTER_PRIORITY_DEFAULT 1
 #define OSPF_RETRANSMIT_INTERVAL_DEFAULT 5
 #define OSPF_TRANSMIT_DELAY_DEFAULT 1
+#define OSPF_FLOOD_PACING_DEFAULT 33 /* msec between rounds of LS Updates */
+#define OSPF_FLOOD_BURST_DEFAULT 4   /* LS Update packets in a round */
 #define OSPF_DEFAULT_BANDWIDTH 10000 /* Kbps */
 
 #define OSPF_DEFAULT_REF_BANDWIDTH 100000 /* Kbps */
@@ -87,6 +89,13 @@
 #define OSPF_SPF_HOLDTIME_DEFAULT 50
 #define OSPF_SPF_MAX_HOLDTIME_DEFAULT 5000
 
+/* RFC 8405 SPF back-off timer values. */
+#define OSPF_SPF_INITIAL_DELAY_DEFAULT 10
+#define OSPF_SPF_SHORT_DELAY_DEFAULT 100
+#define OSPF_SPF_LONG_DELAY_DEFAULT 5000
+#define OSPF_SPF_HOLDDOWN_DEFAULT 10000
+#define OSPF_SPF_TIME_TO_LEARN_DEFAULT 500
+
 #define OSPF_LSA_MAXAGE_CHECK_INTERVAL 30
 #define OSPF_LSA_MAXAGE_REMOVE_DELAY_DEFAULT 60
 
@@ -25,9 +25,16 @@
 
 #include <zebra.h>
 
+#ifdef HAVE_PTHREAD
+	#include <pthread.h>
+	#include <poll.h>
+#endif
+
 #include "log.h"
 #include "memory.h"
 #include "command.h"
+#include "network.h"
+#include "placement.h"
 #ifndef SUNOS_5
 	#include <sys/un.h>
 #endif
@@ -112,9 +119,413 @@ static void time_print(FILE *fp, struct timestamp_control *ctl) {
 	fprintf(fp, "%s ", ctl->buf);
 }
 
+#ifdef HAVE_PTHREAD
+/* Asynchronous logging ("log async").  A thread that logs formats its
+ * file and syslog lines into a ring of its own and goes on; the writer
+ * thread takes them from all the rings, and batches the file lines into
+ * few write()s.  A line that finds its ring full is dropped, counted,
+ * and the count logged by the writer.  Stdout and the vty monitors are
+ * still written to on the spot, as is everything once the threads run
+ * out of rings.
+ */
+#define ZLOG_ASYNC_RINGS 16
+#define ZLOG_ASYNC_RING_SIZE (256 * 1024) /* a power of 2 */
+#define ZLOG_ASYNC_LINE_MAX 1024
+#define ZLOG_ASYNC_BATCH (64 * 1024)
+
+#define ZLOG_ASYNC_FILE 0x01
+#define ZLOG_ASYNC_SYSLOG 0x02
+
+/* A line in a ring, padded to ZLOG_ASYNC_ALIGN.  A header with len
+ * ZLOG_ASYNC_WRAP says the rest of the ring is unused. */
+struct zlog_async_rec {
+	u_int16_t len; /* of the text after the header, '\n' included */
+	u_char priority;
+	u_char dests;
+	u_int16_t msg_off; /* where the message starts, for syslog */
+	u_int16_t unused;
+};
+#define ZLOG_ASYNC_ALIGN sizeof(struct zlog_async_rec)
+#define ZLOG_ASYNC_WRAP 0xffff
+#define ZLOG_ASYNC_RECLEN(len) ((sizeof(struct zlog_async_rec) + (len) + ZLOG_ASYNC_ALIGN - 1) & ~(ZLOG_ASYNC_ALIGN - 1))
+
+/* One producer, the thread that owns it, and one consumer, the writer */
+struct zlog_async_ring {
+	u_int32_t head; /* next to read, writer only */
+	u_int32_t tail; /* next to write, producer only */
+	u_char data[ZLOG_ASYNC_RING_SIZE];
+};
+
+static struct {
+	int running;
+	int stop;
+	int exited;
+	pthread_t thread;
+	int wakeup[2];
+	u_int32_t sleeping;
+
+	u_int32_t nrings;
+	struct zlog_async_ring *rings[ZLOG_ASYNC_RINGS];
+
+	unsigned long dropped;
+	unsigned long reported; /* writer only */
+} zlog_async = { .wakeup = { -1, -1 } };
+
+/* taken by the writer around its write()s, and around log file changes */
+static pthread_mutex_t zlog_file_mtx = PTHREAD_MUTEX_INITIALIZER;
+
+/* the calling thread's ring, or (void *) -1 if there was none left */
+static __thread struct zlog_async_ring *zlog_async_self;
+
+static struct zlog_async_ring *zlog_async_ring(void) {
+	struct zlog_async_ring *ring = zlog_async_self;
+	u_int32_t i;
+
+	if(ring) {
+		return (ring == (void *) -1) ? NULL : ring;
+	}
+
+	i = __atomic_fetch_add(&zlog_async.nrings, 1, __ATOMIC_RELAXED);
+	if(i >= ZLOG_ASYNC_RINGS) {
+		zlog_async_self = (void *) -1;
+		return NULL;
+	}
+	ring = XCALLOC(MTYPE_ZLOG_RING, sizeof(struct zlog_async_ring));
+	__atomic_store_n(&zlog_async.rings[i], ring, __ATOMIC_RELEASE);
+	zlog_async_self = ring;
+	return ring;
+}
+
+/* Queue the file and syslog line of a message; returns the dests it
+ * took, none if the threads have run out of rings. */
+static int zlog_async_put(struct zlog *zl, int priority, int dests, struct timestamp_control *ctl, const char *format, va_list args) {
+	struct zlog_async_ring *ring;
+	struct zlog_async_rec *rec;
+	char line[ZLOG_ASYNC_LINE_MAX];
+	u_int32_t head, off, reclen, skip;
+	size_t len, msg_off;
+	va_list ac;
+	int ret;
+	u_char one = 1;
+
+	if((ring = zlog_async_ring()) == NULL) {
+		return 0;
+	}
+
+	if(!ctl->already_rendered) {
+		ctl->len = quagga_timestamp(ctl->precision, ctl->buf, sizeof(ctl->buf));
+		ctl->already_rendered = 1;
+	}
+	if(zl->record_priority) {
+		ret = snprintf(line, sizeof(line), "%s %s: %s: ", ctl->buf, zlog_priority[priority], zlog_proto_names[zl->protocol]);
+	} else {
+		ret = snprintf(line, sizeof(line), "%s %s: ", ctl->buf, zlog_proto_names[zl->protocol]);
+	}
+	msg_off = (ret < 0) ? 0 : MIN((size_t) ret, sizeof(line) - 2);
+
+	va_copy(ac, args);
+	ret = vsnprintf(line + msg_off, sizeof(line) - msg_off - 1, format, ac);
+	va_end(ac);
+	len = msg_off + ((ret < 0) ? 0 : MIN((size_t) ret, sizeof(line) - msg_off - 2));
+	line[len++] = '\n';
+
+	/* Room for it, after the end of the ring if it doesn't fit there */
+	reclen = ZLOG_ASYNC_RECLEN(len);
+	head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+	off = ring->tail & (ZLOG_ASYNC_RING_SIZE - 1);
+	skip = (ZLOG_ASYNC_RING_SIZE - off < reclen) ? ZLOG_ASYNC_RING_SIZE - off : 0;
+	if(skip + reclen > ZLOG_ASYNC_RING_SIZE - (ring->tail - head)) {
+		__atomic_fetch_add(&zlog_async.dropped, 1, __ATOMIC_RELAXED);
+		return dests;
+	}
+
+	if(skip) {
+		rec = (struct zlog_async_rec *) (ring->data + off);
+		rec->len = ZLOG_ASYNC_WRAP;
+		off = 0;
+	}
+	rec = (struct zlog_async_rec *) (ring->data + off);
+	rec->len = len;
+	rec->priority = priority;
+	rec->dests = dests;
+	rec->msg_off = msg_off;
+	memcpy(rec + 1, line, len);
+	__atomic_store_n(&ring->tail, ring->tail + skip + reclen, __ATOMIC_RELEASE);
+
+	/* Wake the writer, if it said it went to sleep */
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+	if(__atomic_load_n(&zlog_async.sleeping, __ATOMIC_RELAXED) && __atomic_exchange_n(&zlog_async.sleeping, 0, __ATOMIC_SEQ_CST)) {
+		if(write(zlog_async.wakeup[1], &one, 1) < 0) {
+			/* a wakeup is pending already */
+		}
+	}
+	return dests;
+}
+
+static void zlog_async_write(const char *buf, size_t len) {
+	ssize_t ret;
+
+	while(len > 0 && logfile_fd >= 0) {
+		if((ret = write(logfile_fd, buf, len)) < 0) {
+			if(errno == EINTR) {
+				continue;
+			}
+			return;
+		}
+		buf += ret;
+		len -= ret;
+	}
+}
+
+/* Writer: pass on all that is queued; returns the # of lines. */
+static unsigned long zlog_async_drain(void) {
+	static char batch[ZLOG_ASYNC_BATCH];
+	size_t blen = 0;
+	unsigned long count = 0;
+	struct zlog_async_ring *ring;
+	struct zlog_async_rec *rec;
+	const char *text;
+	u_int32_t i, nrings, tail;
+	unsigned long dropped;
+	char line[80];
+	int len;
+
+	pthread_mutex_lock(&zlog_file_mtx);
+
+	nrings = MIN(__atomic_load_n(&zlog_async.nrings, __ATOMIC_RELAXED), ZLOG_ASYNC_RINGS);
+	for(i = 0; i < nrings; i++) {
+		if((ring = __atomic_load_n(&zlog_async.rings[i], __ATOMIC_ACQUIRE)) == NULL) {
+			continue;
+		}
+		tail = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+		while(ring->head != tail) {
+			rec = (struct zlog_async_rec *) (ring->data + (ring->head & (ZLOG_ASYNC_RING_SIZE - 1)));
+			if(rec->len == ZLOG_ASYNC_WRAP) {
+				ring->head += ZLOG_ASYNC_RING_SIZE - (ring->head & (ZLOG_ASYNC_RING_SIZE - 1));
+				continue;
+			}
+			text = (const char *) (rec + 1);
+
+			if(rec->dests & ZLOG_ASYNC_FILE) {
+				if(blen + rec->len > sizeof(batch)) {
+					zlog_async_write(batch, blen);
+					blen = 0;
+				}
+				memcpy(batch + blen, text, rec->len);
+				blen += rec->len;
+			}
+			if(rec->dests & ZLOG_ASYNC_SYSLOG) {
+				syslog(rec->priority | zlog_default->facility, "%.*s", (int) (rec->len - rec->msg_off - 1), text + rec->msg_off);
+			}
+
+			ring->head += ZLOG_ASYNC_RECLEN(rec->len);
+			__atomic_store_n(&ring->head, ring->head, __ATOMIC_RELEASE);
+			count++;
+		}
+	}
+	zlog_async_write(batch, blen);
+
+	dropped = __atomic_load_n(&zlog_async.dropped, __ATOMIC_RELAXED);
+	if(dropped != zlog_async.reported) {
+		len = snprintf(line, sizeof(line), "%s: %lu log messages dropped\n", zlog_proto_names[zlog_default->protocol], dropped - zlog_async.reported);
+		zlog_async_write(line, len);
+		syslog(LOG_WARNING | zlog_default->facility, "%.*s", len - 1, line);
+		zlog_async.reported = dropped;
+	}
+
+	pthread_mutex_unlock(&zlog_file_mtx);
+	return count;
+}
+
+static int zlog_async_pending(void) {
+	struct zlog_async_ring *ring;
+	u_int32_t i, nrings;
+
+	nrings = MIN(__atomic_load_n(&zlog_async.nrings, __ATOMIC_RELAXED), ZLOG_ASYNC_RINGS);
+	for(i = 0; i < nrings; i++) {
+		ring = __atomic_load_n(&zlog_async.rings[i], __ATOMIC_ACQUIRE);
+		if(ring && __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE) != ring->head) {
+			return 1;
+		}
+	}
+	return 0;
+}
+
+static void *zlog_async_writer(void *arg) {
+	struct pollfd pfd;
+	char buf[64];
+
+	pfd.fd = zlog_async.wakeup[0];
+	pfd.events = POLLIN;
+
+	thread_placement_enter(THREAD_PLACE_IO, "log writer");
+
+	while(1) {
+		if(zlog_async_drain()) {
+			continue;
+		}
+		if(__atomic_load_n(&zlog_async.stop, __ATOMIC_ACQUIRE)) {
+			break;
+		}
+
+		/* Say we go to sleep, unless a line came meanwhile */
+		__atomic_store_n(&zlog_async.sleeping, 1, __ATOMIC_SEQ_CST);
+		__atomic_thread_fence(__ATOMIC_SEQ_CST);
+		if(!zlog_async_pending() && !__atomic_load_n(&zlog_async.stop, __ATOMIC_ACQUIRE)) {
+			poll(&pfd, 1, 1000);
+		}
+		__atomic_store_n(&zlog_async.sleeping, 0, __ATOMIC_SEQ_CST);
+		while(read(zlog_async.wakeup[0], buf, sizeof(buf)) > 0) {
+			;
+		}
+		thread_placement_check();
+	}
+
+	thread_placement_leave();
+	__atomic_store_n(&zlog_async.exited, 1, __ATOMIC_RELEASE);
+	return NULL;
+}
+
+static int zlog_async_start(void);
+
+/* The writer is started while the config is read, before daemonizing,
+ * and doesn't survive the fork: hold the file lock over it, so no drain
+ * is cut in half, and start a new writer in the child. */
+static void zlog_async_fork_prepare(void) {
+	pthread_mutex_lock(&zlog_file_mtx);
+}
+
+static void zlog_async_fork_parent(void) {
+	pthread_mutex_unlock(&zlog_file_mtx);
+}
+
+static void zlog_async_fork_child(void) {
+	pthread_mutex_unlock(&zlog_file_mtx);
+	if(zlog_async.running) {
+		zlog_async.running = 0;
+		zlog_async.sleeping = 0;
+		zlog_async_start();
+	}
+}
+
+static int zlog_async_start(void) {
+	static int atfork;
+	sigset_t all, old;
+	int err;
+
+	if(zlog_async.running) {
+		return 1;
+	}
+
+	if(!atfork) {
+		pthread_atfork(zlog_async_fork_prepare, zlog_async_fork_parent, zlog_async_fork_child);
+		atfork = 1;
+	}
+
+	if(zlog_async.wakeup[0] < 0) {
+		if(pipe(zlog_async.wakeup) < 0) {
+			return 0;
+		}
+		set_nonblocking(zlog_async.wakeup[0]);
+		set_nonblocking(zlog_async.wakeup[1]);
+	}
+
+	/* signals are for the main thread */
+	zlog_async.stop = 0;
+	zlog_async.exited = 0;
+	sigfillset(&all);
+	pthread_sigmask(SIG_BLOCK, &all, &old);
+	err = pthread_create(&zlog_async.thread, NULL, zlog_async_writer, NULL);
+	pthread_sigmask(SIG_SETMASK, &old, NULL);
+	if(err) {
+		return 0;
+	}
+
+	__atomic_store_n(&zlog_async.running, 1, __ATOMIC_RELEASE);
+	return 1;
+}
+
+/* Stop the writer, once it has passed on all that is queued. */
+static void zlog_async_stop(void) {
+	u_char one = 1;
+
+	if(!zlog_async.running) {
+		return;
+	}
+
+	__atomic_store_n(&zlog_async.running, 0, __ATOMIC_RELEASE);
+	__atomic_store_n(&zlog_async.stop, 1, __ATOMIC_RELEASE);
+	if(write(zlog_async.wakeup[1], &one, 1) < 0) {
+		/* a wakeup is pending already */
+	}
+	pthread_join(zlog_async.thread, NULL);
+}
+
+/* Before a crash, or an abort, takes the writer away: let it pass on
+ * what is queued, and have the lines about the crash written directly.
+ * Signal safe, as it neither locks nor joins, and given up on after a
+ * second, in case it is the writer that is stuck or crashed. */
+static void zlog_async_flush(void) {
+	struct timespec tick = { 0, 10 * 1000 * 1000 };
+	u_char one = 1;
+	int i;
+
+	if(!__atomic_exchange_n(&zlog_async.running, 0, __ATOMIC_SEQ_CST)) {
+		return;
+	}
+	if(pthread_equal(pthread_self(), zlog_async.thread)) {
+		return;
+	}
+
+	__atomic_store_n(&zlog_async.stop, 1, __ATOMIC_RELEASE);
+	if(write(zlog_async.wakeup[1], &one, 1) < 0) {
+		/* a wakeup is pending already */
+	}
+	for(i = 0; i < 100 && !__atomic_load_n(&zlog_async.exited, __ATOMIC_ACQUIRE); i++) {
+		nanosleep(&tick, NULL);
+	}
+}
+
+int zlog_set_async(struct zlog *zl, int on) {
+	if(zl == NULL) {
+		zl = zlog_default;
+	}
+
+	if(!on) {
+		zlog_async_stop();
+	} else if(!zlog_async_start()) {
+		return 0;
+	}
+	zl->async = on;
+	return 1;
+}
+
+unsigned long zlog_async_dropped(void) {
+	return __atomic_load_n(&zlog_async.dropped, __ATOMIC_RELAXED);
+}
+
+	#define ZLOG_FILE_LOCK() pthread_mutex_lock(&zlog_file_mtx)
+	#define ZLOG_FILE_UNLOCK() pthread_mutex_unlock(&zlog_file_mtx)
+#else
+static void zlog_async_flush(void) {
+}
+
+int zlog_set_async(struct zlog *zl, int on) {
+	return !on;
+}
+
+unsigned long zlog_async_dropped(void) {
+	return 0;
+}
+
+	#define ZLOG_FILE_LOCK()
+	#define ZLOG_FILE_UNLOCK()
+#endif /* HAVE_PTHREAD */
+
 /* va_list version of zlog. */
 static void vzlog(struct zlog *zl, int priority, const char *format, va_list args) {
 	int original_errno = errno;
+	int async = 0;
 	struct timestamp_control tsctl;
 	tsctl.already_rendered = 0;
 
@@ -138,8 +549,25 @@ static void vzlog(struct zlog *zl, int priority, const char *format, va_list arg
 	}
 	tsctl.precision = zl->timestamp_precision;
 
+#ifdef HAVE_PTHREAD
+	/* File and syslog output, by the writer thread */
+	if(__atomic_load_n(&zlog_async.running, __ATOMIC_ACQUIRE) && zl == zlog_default) {
+		int dests = 0;
+
+		if(priority <= zl->maxlvl[ZLOG_DEST_SYSLOG]) {
+			dests |= ZLOG_ASYNC_SYSLOG;
+		}
+		if((priority <= zl->maxlvl[ZLOG_DEST_FILE]) && zl->fp) {
+			dests |= ZLOG_ASYNC_FILE;
+		}
+		if(dests) {
+			async = zlog_async_put(zl, priority, dests, &tsctl, format, args);
+		}
+	}
+#endif /* HAVE_PTHREAD */
+
 	/* Syslog output */
-	if(priority <= zl->maxlvl[ZLOG_DEST_SYSLOG]) {
+	if(priority <= zl->maxlvl[ZLOG_DEST_SYSLOG] && !(async & ZLOG_ASYNC_SYSLOG)) {
 		va_list ac;
 		va_copy(ac, args);
 		vsyslog(priority | zlog_default->facility, format, ac);
@@ -147,7 +575,7 @@ static void vzlog(struct zlog *zl, int priority, const char *format, va_list arg
 	}
 
 	/* File output. */
-	if((priority <= zl->maxlvl[ZLOG_DEST_FILE]) && zl->fp) {
+	if((priority <= zl->maxlvl[ZLOG_DEST_FILE]) && zl->fp && !(async & ZLOG_ASYNC_FILE)) {
 		va_list ac;
 		time_print(zl->fp, &tsctl);
 		if(zl->record_priority) {
@@ -323,6 +751,8 @@ void zlog_signal(
 	char *msgstart = buf;
 #define LOC s, buf + sizeof(buf) - s
 
+	zlog_async_flush();
+
 	time(&now);
 	if(zlog_default) {
 		s = str_append(LOC, zlog_proto_names[zlog_default->protocol]);
@@ -606,6 +1036,8 @@ void zlog_thread_info(int log_level) {
 }
 
 void _zlog_assert_failed(const char *assertion, const char *file, unsigned int line, const char *function) {
+	zlog_async_flush();
+
 	/* Force fallback file logging? */
 	if(zlog_default && !zlog_default->fp && ((logfile_fd = open_crashlog()) >= 0) && ((zlog_default->fp = fdopen(logfile_fd, "w")) != NULL)) {
 		zlog_default->maxlvl[ZLOG_DEST_FILE] = LOG_ERR;
@@ -641,6 +1073,9 @@ struct zlog *openzlog(const char *progname, zlog_proto_t protocol, int syslog_fl
 }
 
 void closezlog(struct zlog *zl) {
+	if(zl->async) {
+		zlog_set_async(zl, 0);
+	}
 	closelog();
 
 	if(zl->fp != NULL) {
@@ -684,10 +1119,12 @@ int zlog_set_file(struct zlog *zl, const char *filename, int log_level) {
 	}
 
 	/* Set flags. */
+	ZLOG_FILE_LOCK();
 	zl->filename = strdup(filename);
 	zl->maxlvl[ZLOG_DEST_FILE] = log_level;
 	zl->fp = fp;
 	logfile_fd = fileno(fp);
+	ZLOG_FILE_UNLOCK();
 
 	return 1;
 }
@@ -698,6 +1135,7 @@ int zlog_reset_file(struct zlog *zl) {
 		zl = zlog_default;
 	}
 
+	ZLOG_FILE_LOCK();
 	if(zl->fp) {
 		fclose(zl->fp);
 	}
@@ -709,6 +1147,7 @@ int zlog_reset_file(struct zlog *zl) {
 		free(zl->filename);
 	}
 	zl->filename = NULL;
+	ZLOG_FILE_UNLOCK();
 
 	return 1;
 }
@@ -721,6 +1160,7 @@ int zlog_rotate(struct zlog *zl) {
 		zl = zlog_default;
 	}
 
+	ZLOG_FILE_LOCK();
 	if(zl->fp) {
 		fclose(zl->fp);
 	}
@@ -738,12 +1178,14 @@ int zlog_rotate(struct zlog *zl) {
 		save_errno = errno;
 		umask(oldumask);
 		if(zl->fp == NULL) {
+			ZLOG_FILE_UNLOCK();
 			zlog_err("Log rotate failed: cannot open file %s for append: %s", zl->filename, safe_strerror(save_errno));
 			return -1;
 		}
 		logfile_fd = fileno(zl->fp);
 		zl->maxlvl[ZLOG_DEST_FILE] = level;
 	}
+	ZLOG_FILE_UNLOCK();
 
 	return 1;
 }
@@ -831,6 +1273,14 @@ static const struct zebra_desc_table command_types[] = {
 	DESC_ENTRY(ZEBRA_NEXTHOP_REGISTER),
 	DESC_ENTRY(ZEBRA_NEXTHOP_UNREGISTER),
 	DESC_ENTRY(ZEBRA_NEXTHOP_UPDATE),
+	DESC_ENTRY(ZEBRA_NEXTHOP_GROUP_ADD),
+	DESC_ENTRY(ZEBRA_NEXTHOP_GROUP_DELETE),
+	DESC_ENTRY(ZEBRA_ROUTE_BULK),
+	DESC_ENTRY(ZEBRA_SHM_RING),
+	DESC_ENTRY(ZEBRA_GRACEFUL_RESTART),
+	DESC_ENTRY(ZEBRA_BFD_DEST_REGISTER),
+	DESC_ENTRY(ZEBRA_BFD_DEST_DEREGISTER),
+	DESC_ENTRY(ZEBRA_BFD_DEST_UPDATE),
 };
 #undef DESC_ENTRY
 
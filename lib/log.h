@@ -85,6 +85,7 @@ struct zlog {
   			   priority of the message? */
 	int syslog_options;	 /* 2nd arg to openlog */
 	int timestamp_precision; /* # of digits of subsecond precision */
+	int async;		 /* file and syslog output by a writer thread */
 };
 
 /* Message structure. */
@@ -109,6 +110,12 @@ extern void closezlog(struct zlog *zl);
 	#define PRINTF_ATTRIBUTE(a, b)
 #endif /* __GNUC__ */
 
+/* Hand file and syslog output to a writer thread, or take it back.
+ * Returns 0 if there are no threads to do it with. */
+extern int zlog_set_async(struct zlog *zl, int on);
+/* # of messages the writer thread had no room for */
+extern unsigned long zlog_async_dropped(void);
+
 /* Generic function for zlog. */
 extern void zlog(struct zlog *zl, int priority, const char *format, ...) PRINTF_ATTRIBUTE(3, 4);
 
@@ -23,17 +23,77 @@
 
 #include <zebra.h>
 /* malloc.h is generally obsolete, however GNU Libc mallinfo wants it. */
-#if !defined(HAVE_STDLIB_H) || (defined(GNU_LINUX) && defined(HAVE_MALLINFO))
+#if !defined(HAVE_STDLIB_H) || (defined(GNU_LINUX) && defined(HAVE_MALLINFO)) || defined(HAVE_MALLOC_USABLE_SIZE)
 	#include <malloc.h>
-#endif /* !HAVE_STDLIB_H || HAVE_MALLINFO */
+#endif /* !HAVE_STDLIB_H || HAVE_MALLINFO || HAVE_MALLOC_USABLE_SIZE */
+#ifdef HAVE_PTHREAD
+	#include <pthread.h>
+#endif
 
 #include "log.h"
 #include "memory.h"
+#include "jhash.h"
 
-static void alloc_inc(int);
-static void alloc_dec(int);
+static void alloc_inc(int, size_t);
+static void alloc_dec(int, size_t);
+static void alloc_resize(int, size_t, size_t);
+static size_t alloc_size(int, void *);
 static void log_memstats(int log_priority);
 
+static unsigned long mprof_rate;
+static unsigned long mprof_count;
+static unsigned long mprof_tracked;
+static void mprof_alloc(int type, void *ptr, size_t size, void *caller);
+static void mprof_free(void *ptr);
+static long mprof_take(void *ptr);
+static void mprof_put(long site, void *ptr, size_t size);
+
+/* Whether to take a sample of this allocation. */
+static inline int mprof_sample(void) {
+	unsigned long rate = __atomic_load_n(&mprof_rate, __ATOMIC_RELAXED);
+
+	return rate && __atomic_add_fetch(&mprof_count, 1, __ATOMIC_RELAXED) % rate == 0;
+}
+
+static void *slab_alloc(int type, size_t size);
+static void slab_free(int type, void *ptr);
+
+/* Slab allocator, for memtypes that opted in with mtype_slab_init().
+ *
+ * Objects are carved out of chunks of MSLAB_CHUNK_SIZE bytes, aligned to
+ * that size so the chunk an object belongs to is found by masking its
+ * address.  Each chunk has its own free list, and a chunk whose objects
+ * have all been freed is given back to the system, unless it's the only
+ * one of the type with room left. */
+#define MSLAB_CHUNK_SIZE (64 * 1024)
+#define MSLAB_ALIGN 8
+
+struct mslab_chunk {
+	struct mslab_chunk *next;
+	struct mslab_chunk *prev;
+	void *free;	      /* freed objects */
+	unsigned int carved; /* objects handed out at least once */
+	unsigned int used;
+};
+
+#define MSLAB_HDR_SIZE ((sizeof(struct mslab_chunk) + MSLAB_ALIGN - 1) & ~(MSLAB_ALIGN - 1))
+#define MSLAB_CHUNK(ptr) ((struct mslab_chunk *) ((uintptr_t) (ptr) & ~(uintptr_t) (MSLAB_CHUNK_SIZE - 1)))
+#define MSLAB_OBJ(chunk, size, i) ((char *) (chunk) + MSLAB_HDR_SIZE + (size_t) (i) * (size))
+
+struct mslab {
+	size_t size; /* object size, 0 if not a slab type */
+	unsigned int per_chunk;
+
+	/* chunks with room, and full ones */
+	struct mslab_chunk *avail;
+	struct mslab_chunk *full;
+
+	unsigned long chunks;
+	unsigned long used;
+	unsigned long chunks_freed;
+};
+static struct mslab mslab[MTYPE_MAX];
+
 static const struct message mstr[] = {
 	{MTYPE_THREAD,		"thread"	 },
 	    { MTYPE_THREAD_MASTER, "thread_master"},
@@ -63,13 +123,20 @@ static void __attribute__((noreturn)) zerror(const char *fname, int type, size_t
 void *zmalloc(int type, size_t size) {
 	void *memory;
 
-	memory = malloc(size);
+	if(mslab[type].size) {
+		memory = slab_alloc(type, size);
+	} else {
+		memory = malloc(size);
+	}
 
 	if(memory == NULL) {
 		zerror("malloc", type, size);
 	}
 
-	alloc_inc(type);
+	alloc_inc(type, alloc_size(type, memory));
+	if(mprof_sample()) {
+		mprof_alloc(type, memory, alloc_size(type, memory), __builtin_return_address(0));
+	}
 
 	return memory;
 }
@@ -82,13 +149,23 @@ void *zmalloc(int type, size_t size) {
 void *zzcalloc(int type, size_t size) {
 	void *memory;
 
-	memory = calloc(1, size);
+	if(mslab[type].size) {
+		memory = slab_alloc(type, size);
+		if(memory) {
+			memset(memory, 0, size);
+		}
+	} else {
+		memory = calloc(1, size);
+	}
 
 	if(memory == NULL) {
 		zerror("calloc", type, size);
 	}
 
-	alloc_inc(type);
+	alloc_inc(type, alloc_size(type, memory));
+	if(mprof_sample()) {
+		mprof_alloc(type, memory, alloc_size(type, memory), __builtin_return_address(0));
+	}
 
 	return memory;
 }
@@ -102,17 +179,33 @@ void *zzcalloc(int type, size_t size) {
  */
 void *zrealloc(int type, void *ptr, size_t size) {
 	void *memory;
+	size_t old_size;
+	long site = -1;
 
 	if(ptr == NULL) { /* is really alloc */
 		return zzcalloc(type, size);
 	}
 
+	/* Slab objects are fixed size, no need to move them. */
+	if(mslab[type].size) {
+		if(size > mslab[type].size) {
+			errno = EINVAL;
+			zerror("realloc", type, size);
+		}
+		return ptr;
+	}
+
+	old_size = alloc_size(type, ptr);
+	if(__atomic_load_n(&mprof_tracked, __ATOMIC_RELAXED)) {
+		site = mprof_take(ptr);
+	}
 	memory = realloc(ptr, size);
 	if(memory == NULL) {
 		zerror("realloc", type, size);
 	}
-	if(ptr == NULL) {
-		alloc_inc(type);
+	alloc_resize(type, old_size, alloc_size(type, memory));
+	if(site >= 0) {
+		mprof_put(site, memory, alloc_size(type, memory));
 	}
 
 	return memory;
@@ -126,8 +219,15 @@ void *zrealloc(int type, void *ptr, size_t size) {
  */
 void zfree(int type, void *ptr) {
 	if(ptr != NULL) {
-		alloc_dec(type);
-		free(ptr);
+		alloc_dec(type, alloc_size(type, ptr));
+		if(__atomic_load_n(&mprof_tracked, __ATOMIC_RELAXED)) {
+			mprof_free(ptr);
+		}
+		if(mslab[type].size) {
+			slab_free(type, ptr);
+		} else {
+			free(ptr);
+		}
 	}
 }
 
@@ -144,10 +244,132 @@ char *zstrdup(int type, const char *str) {
 	if(dup == NULL) {
 		zerror("strdup", type, strlen(str));
 	}
-	alloc_inc(type);
+	alloc_inc(type, alloc_size(type, dup));
+	if(mprof_sample()) {
+		mprof_alloc(type, dup, alloc_size(type, dup), __builtin_return_address(0));
+	}
 	return dup;
 }
 
+/* Unlink a chunk from a list. */
+static void slab_chunk_unlink(struct mslab_chunk **head, struct mslab_chunk *chunk) {
+	if(chunk->prev) {
+		chunk->prev->next = chunk->next;
+	} else {
+		*head = chunk->next;
+	}
+	if(chunk->next) {
+		chunk->next->prev = chunk->prev;
+	}
+	chunk->next = chunk->prev = NULL;
+}
+
+static void slab_chunk_link(struct mslab_chunk **head, struct mslab_chunk *chunk) {
+	chunk->prev = NULL;
+	chunk->next = *head;
+	if(*head) {
+		(*head)->prev = chunk;
+	}
+	*head = chunk;
+}
+
+static void *slab_alloc(int type, size_t size) {
+	struct mslab *slab = &mslab[type];
+	struct mslab_chunk *chunk;
+	void *obj;
+
+	if(size > slab->size) {
+		errno = EINVAL;
+		return NULL;
+	}
+
+	chunk = slab->avail;
+	if(chunk == NULL) {
+		void *mem;
+
+		if(posix_memalign(&mem, MSLAB_CHUNK_SIZE, MSLAB_CHUNK_SIZE) != 0) {
+			return NULL;
+		}
+		chunk = mem;
+		memset(chunk, 0, sizeof(*chunk));
+		slab_chunk_link(&slab->avail, chunk);
+		slab->chunks++;
+	}
+
+	if(chunk->free) {
+		obj = chunk->free;
+		chunk->free = *(void **) obj;
+	} else {
+		obj = MSLAB_OBJ(chunk, slab->size, chunk->carved);
+		chunk->carved++;
+	}
+	chunk->used++;
+	slab->used++;
+
+	if(chunk->used == slab->per_chunk) {
+		slab_chunk_unlink(&slab->avail, chunk);
+		slab_chunk_link(&slab->full, chunk);
+	}
+
+	return obj;
+}
+
+static void slab_free(int type, void *ptr) {
+	struct mslab *slab = &mslab[type];
+	struct mslab_chunk *chunk = MSLAB_CHUNK(ptr);
+
+	if(chunk->used == slab->per_chunk) {
+		slab_chunk_unlink(&slab->full, chunk);
+		slab_chunk_link(&slab->avail, chunk);
+	}
+
+	*(void **) ptr = chunk->free;
+	chunk->free = ptr;
+	chunk->used--;
+	slab->used--;
+
+	/* Release it if empty, keeping one chunk with room around so an
+     alloc/free cycle at the boundary doesn't hit the system allocator
+     every time. */
+	if(chunk->used == 0 && (chunk->prev || chunk->next)) {
+		slab_chunk_unlink(&slab->avail, chunk);
+		free(chunk);
+		slab->chunks--;
+		slab->chunks_freed++;
+	}
+}
+
+/* Bytes held in slab chunks, over all types. */
+static unsigned long mslab_bytes(void) {
+	unsigned long chunks = 0;
+	int type;
+
+	for(type = 1; type < MTYPE_MAX; type++) {
+		chunks += mslab[type].chunks;
+	}
+	return chunks * MSLAB_CHUNK_SIZE;
+}
+
+void mtype_slab_init(int type, size_t size) {
+	struct mslab *slab = &mslab[type];
+
+	if(slab->size || mtype_stats_alloc(type)) {
+		return;
+	}
+
+	/* room for the free list link, and aligned */
+	if(size < sizeof(void *)) {
+		size = sizeof(void *);
+	}
+	size = (size + MSLAB_ALIGN - 1) & ~(size_t) (MSLAB_ALIGN - 1);
+	if(size > (MSLAB_CHUNK_SIZE - MSLAB_HDR_SIZE) / 8) {
+		return;
+	}
+
+	slab->per_chunk = (MSLAB_CHUNK_SIZE - MSLAB_HDR_SIZE) / size;
+	slab->size = size;
+}
+
 #ifdef MEMORY_LOG
 static struct {
 	const char *name;
@@ -159,6 +381,10 @@ static struct {
 	unsigned long t_realloc;
 	unsigned long t_free;
 	unsigned long c_strdup;
+	long bytes;
+	long max_alloc;
+	long max_bytes;
+	unsigned long total;
 } mstat[MTYPE_MAX];
 
 static void mtype_log(char *func, void *memory, const char *file, int line, int type) {
@@ -226,17 +452,272 @@ char *mtype_zstrdup(const char *file, int line, int type, const char *str) {
 static struct {
 	char *name;
 	long alloc;
+	long bytes;
+	long max_alloc;
+	long max_bytes;
+	unsigned long total;
 } mstat[MTYPE_MAX];
 #endif /* MEMORY_LOG */
 
-/* Increment allocation counter. */
-static void alloc_inc(int type) {
-	mstat[type].alloc++;
+/* Raise a high-water mark to val, from any thread. */
+static void alloc_peak(long *max, long val) {
+	long old = __atomic_load_n(max, __ATOMIC_RELAXED);
+
+	while(val > old && !__atomic_compare_exchange_n(max, &old, val, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+		;
+	}
+}
+
+/* Increment allocation counter, from any thread. */
+static void alloc_inc(int type, size_t size) {
+	__atomic_fetch_add(&mstat[type].total, 1, __ATOMIC_RELAXED);
+	alloc_peak(&mstat[type].max_alloc, __atomic_add_fetch(&mstat[type].alloc, 1, __ATOMIC_RELAXED));
+	alloc_peak(&mstat[type].max_bytes, __atomic_add_fetch(&mstat[type].bytes, size, __ATOMIC_RELAXED));
 }
 
 /* Decrement allocation counter. */
-static void alloc_dec(int type) {
-	mstat[type].alloc--;
+static void alloc_dec(int type, size_t size) {
+	__atomic_fetch_sub(&mstat[type].alloc, 1, __ATOMIC_RELAXED);
+	__atomic_fetch_sub(&mstat[type].bytes, size, __ATOMIC_RELAXED);
+}
+
+static void alloc_resize(int type, size_t old_size, size_t size) {
+	alloc_peak(&mstat[type].max_bytes, __atomic_add_fetch(&mstat[type].bytes, (long) size - (long) old_size, __ATOMIC_RELAXED));
+}
+
+/* Bytes an allocation takes, as far as we can tell: what the allocator
+ * really set aside, which may be a little more than was asked for.
+ * Without malloc_usable_size(), only slab types have a size. */
+static size_t alloc_size(int type, void *ptr) {
+	if(mslab[type].size) {
+		return mslab[type].size;
+	}
+#ifdef HAVE_MALLOC_USABLE_SIZE
+	return malloc_usable_size(ptr);
+#else
+	return 0;
+#endif
+}
+
+/* Allocation-site profiling ("memory profile sample N").  One in N
+ * allocations, over all types, records the stack it came from; sites
+ * are keyed by type and stack, and count how many of their samples are
+ * still allocated, found again on free through a table of the sampled
+ * pointers.  Multiplied by N, that estimates what each site holds.
+ * Off, it costs a load per allocation and per free.
+ */
+#define MPROF_DEPTH 8
+#define MPROF_SITES 1024	/* a power of 2 */
+#define MPROF_PTRS (64 * 1024) /* a power of 2 */
+
+struct mprof_site {
+	int type;
+	int depth;
+	void *frames[MPROF_DEPTH];
+	unsigned long samples;
+	unsigned long live;
+	unsigned long live_bytes;
+};
+
+struct mprof_ptr {
+	uintptr_t ptr; /* 0 if unused */
+	u_int32_t site;
+	size_t size;
+};
+
+static struct mprof {
+	struct mprof_site *sites;
+	struct mprof_ptr *ptrs;
+	unsigned long nsites;
+	unsigned long samples;
+	unsigned long lost; /* samples with no room for their site or pointer */
+} mprof;
+
+#ifdef HAVE_PTHREAD
+static pthread_mutex_t mprof_mtx = PTHREAD_MUTEX_INITIALIZER;
+	#define MPROF_LOCK() pthread_mutex_lock(&mprof_mtx)
+	#define MPROF_UNLOCK() pthread_mutex_unlock(&mprof_mtx)
+#else
+	#define MPROF_LOCK()
+	#define MPROF_UNLOCK()
+#endif
+
+#define MPROF_PTR_HASH(ptr) (((ptr) >> 4) * 2654435761u)
+
+/* Pointers are only keys here, and may have been freed already. */
+static struct mprof_ptr *mprof_ptr_find(uintptr_t ptr) {
+	u_int32_t i = MPROF_PTR_HASH(ptr) & (MPROF_PTRS - 1);
+
+	while(mprof.ptrs[i].ptr) {
+		if(mprof.ptrs[i].ptr == ptr) {
+			return &mprof.ptrs[i];
+		}
+		i = (i + 1) & (MPROF_PTRS - 1);
+	}
+	return NULL;
+}
+
+/* Remove an entry, moving up those that would not be found past the hole. */
+static void mprof_ptr_remove(struct mprof_ptr *entry) {
+	u_int32_t hole = entry - mprof.ptrs, i = hole, home;
+
+	while(1) {
+		i = (i + 1) & (MPROF_PTRS - 1);
+		if(!mprof.ptrs[i].ptr) {
+			break;
+		}
+		home = MPROF_PTR_HASH(mprof.ptrs[i].ptr) & (MPROF_PTRS - 1);
+		if(((i - home) & (MPROF_PTRS - 1)) >= ((i - hole) & (MPROF_PTRS - 1))) {
+			mprof.ptrs[hole] = mprof.ptrs[i];
+			hole = i;
+		}
+	}
+	mprof.ptrs[hole].ptr = 0;
+	__atomic_fetch_sub(&mprof_tracked, 1, __ATOMIC_RELAXED);
+}
+
+static int mprof_ptr_add(uintptr_t ptr, u_int32_t site, size_t size) {
+	u_int32_t i = MPROF_PTR_HASH(ptr) & (MPROF_PTRS - 1);
+
+	/* keep probe sequences short */
+	if(__atomic_load_n(&mprof_tracked, __ATOMIC_RELAXED) >= MPROF_PTRS / 4 * 3) {
+		return 0;
+	}
+	while(mprof.ptrs[i].ptr) {
+		i = (i + 1) & (MPROF_PTRS - 1);
+	}
+	mprof.ptrs[i].ptr = ptr;
+	mprof.ptrs[i].site = site;
+	mprof.ptrs[i].size = size;
+	__atomic_fetch_add(&mprof_tracked, 1, __ATOMIC_RELAXED);
+	return 1;
+}
+
+static struct mprof_site *mprof_site_get(int type, void **frames, int depth) {
+	u_int32_t i = jhash(frames, depth * sizeof(void *), type) & (MPROF_SITES - 1);
+	struct mprof_site *site;
+
+	while((site = &mprof.sites[i])->depth) {
+		if(site->type == type && site->depth == depth && !memcmp(site->frames, frames, depth * sizeof(void *))) {
+			return site;
+		}
+		i = (i + 1) & (MPROF_SITES - 1);
+	}
+
+	if(mprof.nsites >= MPROF_SITES / 4 * 3) {
+		return NULL;
+	}
+	site->type = type;
+	site->depth = depth;
+	memcpy(site->frames, frames, depth * sizeof(void *));
+	mprof.nsites++;
+	return site;
+}
+
+static void __attribute__((noinline)) mprof_alloc(int type, void *ptr, size_t size, void *caller) {
+	void *frames[MPROF_DEPTH + 2];
+	struct mprof_site *site;
+	int depth = 0;
+
+#ifdef HAVE_GLIBC_BACKTRACE
+	/* less this function and the allocation function */
+	depth = backtrace(frames, array_size(frames)) - 2;
+	if(depth > 0) {
+		memmove(frames, frames + 2, depth * sizeof(void *));
+	}
+#endif
+	if(depth <= 0) {
+		frames[0] = caller;
+		depth = 1;
+	}
+
+	MPROF_LOCK();
+	if(mprof.sites == NULL) {
+		MPROF_UNLOCK();
+		return;
+	}
+	mprof.samples++;
+	if((site = mprof_site_get(type, frames, depth)) == NULL) {
+		mprof.lost++;
+	} else {
+		site->samples++;
+		if(mprof_ptr_add((uintptr_t) ptr, site - mprof.sites, size)) {
+			site->live++;
+			site->live_bytes += size;
+		} else {
+			mprof.lost++;
+		}
+	}
+	MPROF_UNLOCK();
+}
+
+static void mprof_free(void *ptr) {
+	struct mprof_ptr *entry;
+	struct mprof_site *site;
+
+	MPROF_LOCK();
+	if(mprof.ptrs && (entry = mprof_ptr_find((uintptr_t) ptr))) {
+		site = &mprof.sites[entry->site];
+		site->live--;
+		site->live_bytes -= entry->size;
+		mprof_ptr_remove(entry);
+	}
+	MPROF_UNLOCK();
+}
+
+/* A sampled allocation that realloc may move stays sampled: taken out
+ * of the table before, with its site returned, and put back after. */
+static long mprof_take(void *ptr) {
+	struct mprof_ptr *entry;
+	struct mprof_site *site;
+	long index = -1;
+
+	MPROF_LOCK();
+	if(mprof.ptrs && (entry = mprof_ptr_find((uintptr_t) ptr))) {
+		index = entry->site;
+		site = &mprof.sites[index];
+		site->live--;
+		site->live_bytes -= entry->size;
+		mprof_ptr_remove(entry);
+	}
+	MPROF_UNLOCK();
+	return index;
+}
+
+static void mprof_put(long index, void *ptr, size_t size) {
+	struct mprof_site *site;
+
+	MPROF_LOCK();
+	/* unless profiling was stopped meanwhile */
+	if(mprof.ptrs && mprof.sites[index].depth && mprof_ptr_add((uintptr_t) ptr, index, size)) {
+		site = &mprof.sites[index];
+		site->live++;
+		site->live_bytes += size;
+	}
+	MPROF_UNLOCK();
+}
+
+/* Start sampling one in rate allocations, from scratch; 0 stops. */
+static void mprof_set(unsigned long rate) {
+	MPROF_LOCK();
+	__atomic_store_n(&mprof_rate, 0, __ATOMIC_RELAXED);
+	__atomic_store_n(&mprof_tracked, 0, __ATOMIC_RELAXED);
+	free(mprof.sites);
+	free(mprof.ptrs);
+	memset(&mprof, 0, sizeof(mprof));
+
+	if(rate) {
+		mprof.sites = calloc(MPROF_SITES, sizeof(struct mprof_site));
+		mprof.ptrs = calloc(MPROF_PTRS, sizeof(struct mprof_ptr));
+		if(mprof.sites && mprof.ptrs) {
+			__atomic_store_n(&mprof_rate, rate, __ATOMIC_RELAXED);
+		} else {
+			free(mprof.sites);
+			free(mprof.ptrs);
+			memset(&mprof, 0, sizeof(mprof));
+		}
+	}
+	MPROF_UNLOCK();
 }
 
 /* Looking up memory status from vty interface. */
@@ -293,8 +774,18 @@ static void show_separator(struct vty *vty) {
 	vty_out(vty, "-----------------------------\r\n");
 }
 
+/* Whether the bytes of a type are counted, see alloc_size(). */
+static int mtype_bytes_known(int type) {
+#ifdef HAVE_MALLOC_USABLE_SIZE
+	return 1;
+#else
+	return mslab[type].size != 0;
+#endif
+}
+
 static int show_memory_vty(struct vty *vty, struct memory_list *list) {
 	struct memory_list *m;
+	char bytes[MTYPE_MEMSTR_LEN], max_bytes[MTYPE_MEMSTR_LEN];
 	int needsep = 0;
 
 	for(m = list; m->index >= 0; m++) {
@@ -304,13 +795,65 @@ static int show_memory_vty(struct vty *vty, struct memory_list *list) {
 				needsep = 0;
 			}
 		} else if(mstat[m->index].alloc) {
-			vty_out(vty, "%-30s: %10ld\r\n", m->format, mstat[m->index].alloc);
+			if(mtype_bytes_known(m->index)) {
+				vty_out(vty, "%-30s: %10ld %10ld %10s %10s\r\n", m->format, mstat[m->index].alloc, mstat[m->index].max_alloc, mtype_memstr(bytes, MTYPE_MEMSTR_LEN, mstat[m->index].bytes),
+					mtype_memstr(max_bytes, MTYPE_MEMSTR_LEN, mstat[m->index].max_bytes));
+			} else {
+				vty_out(vty, "%-30s: %10ld %10ld %10s %10s\r\n", m->format, mstat[m->index].alloc, mstat[m->index].max_alloc, "-", "-");
+			}
 			needsep = 1;
 		}
 	}
 	return needsep;
 }
 
+static const char *mtype_name(int type) {
+	struct mlist *ml;
+	struct memory_list *m;
+
+	for(ml = mlists; ml->list; ml++) {
+		for(m = ml->list; m->index >= 0; m++) {
+			if(m->index == type) {
+				return m->format;
+			}
+		}
+	}
+	return "?";
+}
+
+static int show_memory_slab(struct vty *vty, int needsep) {
+	char buf[MTYPE_MEMSTR_LEN];
+	int type, header = 1;
+
+	for(type = 1; type < MTYPE_MAX; type++) {
+		struct mslab *slab = &mslab[type];
+		unsigned long capacity;
+
+		if(!slab->size) {
+			continue;
+		}
+		if(header) {
+			if(needsep) {
+				show_separator(vty);
+			}
+			vty_out(vty, "Slab allocator statistics:%s", VTY_NEWLINE);
+			vty_out(vty, "%-30s %6s %7s %10s %10s %5s %9s%s", "Type", "Size", "Chunks", "In use", "Capacity", "Frag", "Freed", VTY_NEWLINE);
+			header = 0;
+		}
+
+		/* fragmentation: share of the chunks' objects not in use */
+		capacity = slab->chunks * slab->per_chunk;
+		vty_out(vty, "%-30s %6lu %7lu %10lu %10lu %4lu%% %9lu%s", mtype_name(type), (unsigned long) slab->size, slab->chunks, slab->used, capacity, capacity ? (capacity - slab->used) * 100 / capacity : 0, slab->chunks_freed,
+			VTY_NEWLINE);
+	}
+
+	if(header) {
+		return needsep;
+	}
+	vty_out(vty, "Held in slabs: %s%s", mtype_memstr(buf, MTYPE_MEMSTR_LEN, mslab_bytes()), VTY_NEWLINE);
+	return 1;
+}
+
 #ifdef HAVE_MALLINFO
 static int show_memory_mallinfo(struct vty *vty) {
 	struct mallinfo2 minfo = mallinfo2();
@@ -340,7 +883,13 @@ DEFUN(show_memory, show_memory_cmd, "show memory",
 #ifdef HAVE_MALLINFO
 	needsep = show_memory_mallinfo(vty);
 #endif /* HAVE_MALLINFO */
+	needsep = show_memory_slab(vty, needsep);
 
+	if(needsep) {
+		show_separator(vty);
+		needsep = 0;
+	}
+	vty_out(vty, "%-30s  %10s %10s %10s %10s%s", "Type", "Count", "Peak", "Bytes", "Peak bytes", VTY_NEWLINE);
 	for(ml = mlists; ml->list; ml++) {
 		if(needsep) {
 			show_separator(vty);
@@ -351,10 +900,114 @@ DEFUN(show_memory, show_memory_cmd, "show memory",
 	return CMD_SUCCESS;
 }
 
+/* Sites that hold the most first */
+static int mprof_site_cmp(const void *a, const void *b) {
+	const struct mprof_site *sa = a, *sb = b;
+
+	if(sa->live_bytes != sb->live_bytes) {
+		return (sa->live_bytes < sb->live_bytes) ? 1 : -1;
+	}
+	if(sa->samples != sb->samples) {
+		return (sa->samples < sb->samples) ? 1 : -1;
+	}
+	return 0;
+}
+
+#define MPROF_SHOW_SITES 20
+
+DEFUN(show_memory_profile, show_memory_profile_cmd, "show memory profile",
+      SHOW_STR "Memory statistics\n"
+	       "Allocation sites, from sampled allocations\n") {
+	struct mprof_site *sites;
+	unsigned long rate, samples, lost, nsites = 0, i;
+	char buf[MTYPE_MEMSTR_LEN];
+	char **symbols;
+	int j;
+
+	/* a copy, to print without holding up allocations */
+	MPROF_LOCK();
+	rate = mprof_rate;
+	samples = mprof.samples;
+	lost = mprof.lost;
+	sites = rate ? calloc(mprof.nsites + 1, sizeof(struct mprof_site)) : NULL;
+	if(sites) {
+		for(i = 0; i < MPROF_SITES; i++) {
+			if(mprof.sites[i].depth && mprof.sites[i].live) {
+				sites[nsites++] = mprof.sites[i];
+			}
+		}
+	}
+	MPROF_UNLOCK();
+
+	if(!rate) {
+		vty_out(vty, "Allocation-site profiling is off, see 'memory profile sample'%s", VTY_NEWLINE);
+		return CMD_SUCCESS;
+	}
+	if(!sites) {
+		vty_out(vty, "%% Out of memory%s", VTY_NEWLINE);
+		return CMD_WARNING;
+	}
+
+	vty_out(vty, "Sampling 1 in %lu allocations: %lu samples, %lu not recorded%s", rate, samples, lost, VTY_NEWLINE);
+	vty_out(vty, "Sites still holding sampled allocations, estimated from the samples:%s", VTY_NEWLINE);
+	vty_out(vty, "%10s %10s %10s  %s%s", "Bytes", "Count", "Samples", "Type", VTY_NEWLINE);
+
+	qsort(sites, nsites, sizeof(struct mprof_site), mprof_site_cmp);
+	for(i = 0; i < nsites && i < MPROF_SHOW_SITES; i++) {
+		vty_out(vty, "%10s %10lu %10lu  %s%s", mtype_memstr(buf, MTYPE_MEMSTR_LEN, sites[i].live_bytes * rate), sites[i].live * rate, sites[i].samples, mtype_name(sites[i].type), VTY_NEWLINE);
+#ifdef HAVE_GLIBC_BACKTRACE
+		symbols = backtrace_symbols(sites[i].frames, sites[i].depth);
+#else
+		symbols = NULL;
+#endif
+		for(j = 0; j < sites[i].depth; j++) {
+			if(symbols) {
+				vty_out(vty, "%34s%s%s", "", symbols[j], VTY_NEWLINE);
+			} else {
+				vty_out(vty, "%34s%p%s", "", sites[i].frames[j], VTY_NEWLINE);
+			}
+		}
+		free(symbols);
+	}
+	if(nsites > MPROF_SHOW_SITES) {
+		vty_out(vty, "(%lu more sites)%s", nsites - MPROF_SHOW_SITES, VTY_NEWLINE);
+	}
+
+	free(sites);
+	return CMD_SUCCESS;
+}
+
+DEFUN(memory_profile, memory_profile_cmd, "memory profile sample <1-1000000>",
+      "Memory allocation\n"
+      "Allocation-site profiling\n"
+      "Sample one in so many allocations, starting over\n"
+      "Allocations per sample\n") {
+	unsigned long rate;
+
+	VTY_GET_INTEGER_RANGE("sample rate", rate, argv[0], 1, 1000000);
+	mprof_set(rate);
+	if(!__atomic_load_n(&mprof_rate, __ATOMIC_RELAXED)) {
+		vty_out(vty, "%% Out of memory%s", VTY_NEWLINE);
+		return CMD_WARNING;
+	}
+	return CMD_SUCCESS;
+}
+
+DEFUN(no_memory_profile, no_memory_profile_cmd, "no memory profile",
+      NO_STR "Memory allocation\n"
+	     "Allocation-site profiling\n") {
+	mprof_set(0);
+	return CMD_SUCCESS;
+}
+
 void memory_init(void) {
 	install_element(RESTRICTED_NODE, &show_memory_cmd);
 
 	install_element(VIEW_NODE, &show_memory_cmd);
+	install_element(VIEW_NODE, &show_memory_profile_cmd);
+
+	install_element(ENABLE_NODE, &memory_profile_cmd);
+	install_element(ENABLE_NODE, &no_memory_profile_cmd);
 }
 
 /* Stats querying from users */
@@ -410,3 +1063,11 @@ const char *mtype_memstr(char *buf, size_t len, unsigned long bytes) {
 unsigned long mtype_stats_alloc(int type) {
 	return mstat[type].alloc;
 }
+
+unsigned long mtype_stats_bytes(int type) {
+	return mstat[type].bytes;
+}
+
+unsigned long mtype_stats_total(int type) {
+	return __atomic_load_n(&mstat[type].total, __ATOMIC_RELAXED);
+}
@@ -84,6 +84,17 @@ extern void log_memstats_stderr(const char *);
 /* return number of allocations outstanding for the type */
 extern unsigned long mtype_stats_alloc(int);
 
+/* return number of bytes outstanding for the type */
+extern unsigned long mtype_stats_bytes(int);
+
+/* return number of allocations ever made of the type */
+extern unsigned long mtype_stats_total(int);
+
+/* Serve all further allocations of the type, which must be no larger
+ * than size, from fixed-size slabs.  Only takes effect if nothing of the
+ * type is currently allocated. */
+extern void mtype_slab_init(int type, size_t size);
+
 /* Human friendly string for given byte count */
 #define MTYPE_MEMSTR_LEN 20
 extern const char *mtype_memstr(char *, size_t, unsigned long);
@@ -25,6 +25,7 @@ struct memory_list memory_list_lib[] =
   { MTYPE_VTY_OUT_BUF,		"VTY output buffer"		},
   { MTYPE_VTY_HIST,		"VTY history"			},
   { MTYPE_IF,			"Interface"			},
+  { MTYPE_IF_INDEX,		"Interface index"		},
   { MTYPE_CONNECTED,		"Connected" 			},
   { MTYPE_CONNECTED_LABEL,	"Connected interface label"	},
   { MTYPE_BUFFER,		"Buffer"			},
@@ -55,6 +56,7 @@ struct memory_list memory_list_lib[] =
   { MTYPE_ROUTE_MAP_RULE_STR,	"Route map rule str"		},
   { MTYPE_ROUTE_MAP_COMPILED,	"Route map compiled"		},
   { MTYPE_CMD_TOKENS,		"Command desc"			},
+  { MTYPE_CMD_TRIE,		"Command trie"			},
   { MTYPE_KEY,			"Key"				},
   { MTYPE_KEYCHAIN,		"Key chain"			},
   { MTYPE_IF_RMAP,		"Interface route map"		},
@@ -62,12 +64,21 @@ struct memory_list memory_list_lib[] =
   { MTYPE_SOCKUNION,		"Socket union"			},
   { MTYPE_PRIVS,		"Privilege information"		},
   { MTYPE_ZLOG,			"Logging"			},
+  { MTYPE_ZLOG_RING,		"Logging ring"			},
   { MTYPE_ZCLIENT,		"Zclient"			},
   { MTYPE_WORK_QUEUE,		"Work queue"			},
   { MTYPE_WORK_QUEUE_ITEM,	"Work queue item"		},
   { MTYPE_WORK_QUEUE_NAME,	"Work queue name string"	},
+  { MTYPE_WORK_POOL,		"Work pool"			},
+  { MTYPE_WORK_POOL_JOB,	"Work pool job"			},
+  { MTYPE_ZRING,		"Zserv ring"			},
   { MTYPE_PQUEUE,		"Priority queue"		},
   { MTYPE_PQUEUE_DATA,		"Priority queue data"		},
+  { MTYPE_SPF_POOL,		"SPF vertex pool"		},
+  { MTYPE_SPF_HEAP,		"SPF candidate heap"		},
+  { MTYPE_SPF_ARRAY,		"SPF vertex array"		},
+  { MTYPE_REGEX_DFA,		"Linear-time regex"		},
+  { MTYPE_REGEX_DFA_STATE,	"Linear-time regex state"	},
   { MTYPE_HOST,			"Host config"			},
   { MTYPE_VRF,			"VRF"				},
   { MTYPE_VRF_NAME,		"VRF name"			},
@@ -79,6 +90,7 @@ struct memory_list memory_list_lib[] =
 struct memory_list memory_list_zebra[] = 
 {
   { MTYPE_RTADV_PREFIX,		"Router Advertisement Prefix"	},
+  { MTYPE_RTADV_PAYLOAD,		"Router Advertisement payload"	},
   { MTYPE_ZEBRA_VRF,		"ZEBRA VRF"				},
   { MTYPE_NEXTHOP,		"Nexthop"			},
   { MTYPE_RIB,			"RIB"				},
@@ -89,6 +101,17 @@ struct memory_list memory_list_zebra[] =
   { MTYPE_NETLINK_NAME,	"Netlink name"			},
   { MTYPE_NETLINK_RCVBUF,	"Netlink receive buffer"	},
   { MTYPE_RNH,		        "Nexthop tracking object"	},
+  { MTYPE_ZEBRA_NHG,		"Nexthop group"			},
+  { MTYPE_RIB_RESOLVE,		"Nexthop resolution"		},
+  { MTYPE_RIB_IFDEP,		"Interface dependents"		},
+  { MTYPE_ZEBRA_REDIST_HELD,	"Redistribution held back"	},
+  { MTYPE_ZEBRA_REDIST_SUBS,	"Redistribution subscribers"	},
+  { MTYPE_ZEBRA_FPM_SERVER,	"FPM server"			},
+  { MTYPE_ZEBRA_IF_NOTIFY,	"Interface notification"	},
+  { MTYPE_ZEBRA_FPM_QUEUE,	"FPM server queue"		},
+  { MTYPE_ZEBRA_SHOW,		"Route show state"		},
+  { MTYPE_ZEBRA_BFD,		"BFD session"			},
+  { MTYPE_ZEBRA_BFD_REG,	"BFD session registration"	},
   { -1, NULL },
 };
 
@@ -103,6 +126,7 @@ struct memory_list memory_list_bgp[] =
   { MTYPE_PEER_PASSWORD,	"Peer password string"		},
   { MTYPE_ATTR,			"BGP attribute"			},
   { MTYPE_ATTR_EXTRA,		"BGP extra attributes"		},
+  { MTYPE_ATTR_ENCODE,		"BGP attribute encoding"	},
   { MTYPE_AS_PATH,		"BGP aspath"			},
   { MTYPE_AS_SEG,		"BGP aspath seg"		},
   { MTYPE_AS_SEG_DATA,		"BGP aspath segment data"	},
@@ -119,7 +143,26 @@ struct memory_list memory_list_bgp[] =
   { MTYPE_BGP_SYNCHRONISE,	"BGP synchronise"		},
   { MTYPE_BGP_ADJ_IN,		"BGP adj in"			},
   { MTYPE_BGP_ADJ_OUT,		"BGP adj out"			},
+  { MTYPE_BGP_ADJ_SHARED,	"BGP adj out shared"		},
+  { MTYPE_BGP_UPDGRP,		"BGP update group"		},
+  { MTYPE_BGP_UPDGRP_ENCODE,	"BGP update group encoding"	},
+  { MTYPE_BGP_IO,		"BGP I/O thread"		},
+  { MTYPE_BGP_IO_BUF,		"BGP I/O thread buffer"		},
+  { MTYPE_BGP_RMAP_CACHE,	"BGP route-map cache"		},
   { MTYPE_BGP_MPATH_INFO,	"BGP multipath info"		},
+  { MTYPE_BGP_MPATH_AGG,	"BGP multipath aggregate"	},
+  { MTYPE_BGP_DUMP,		"BGP dump buffer"		},
+  { MTYPE_BGP_BMP,		"BGP BMP collector"		},
+  { MTYPE_BGP_BMP_BUF,		"BGP BMP collector buffer"	},
+  { MTYPE_BGP_RS_SHARED,	"BGP shared RS-client table"	},
+  { MTYPE_BGP_ANNOUNCE_WALK,	"BGP announce walk"		},
+  { MTYPE_BGP_RS_PATH,		"BGP shared RS-client verdicts"	},
+  { MTYPE_BGP_RPKI_CACHE,	"BGP RPKI cache"		},
+  { MTYPE_BGP_RPKI_ROA,		"BGP RPKI ROA"			},
+  { MTYPE_BGP_RTC,		"BGP RT memberships"		},
+  { MTYPE_BGP_RTC_MEMBER,	"BGP RT membership"		},
+  { MTYPE_BGP_ARENA,		"BGP UPDATE parse arena"	},
+  { MTYPE_BGP_SNAPSHOT,		"BGP RIB snapshot"		},
   { 0, NULL },
   { MTYPE_AS_LIST,		"BGP AS list"			},
   { MTYPE_AS_FILTER,		"BGP AS filter"			},
@@ -137,6 +180,7 @@ struct memory_list memory_list_bgp[] =
   { MTYPE_COMMUNITY_LIST_NAME,	"community-list name"		},
   { MTYPE_COMMUNITY_LIST_ENTRY,	"community-list entry"		},
   { MTYPE_COMMUNITY_LIST_CONFIG,  "community-list config"	},
+  { MTYPE_COMMUNITY_LIST_INDEX,	"community-list index"		},
   { MTYPE_COMMUNITY_LIST_HANDLER, "community-list handler"	},
   { 0, NULL },
   { MTYPE_CLUSTER,		"Cluster list"			},
@@ -155,8 +199,11 @@ struct memory_list memory_list_bgp[] =
   { MTYPE_BGP_DAMP_INFO,	"Dampening info"		},
   { MTYPE_BGP_DAMP_ARRAY,	"BGP Dampening array"		},
   { MTYPE_BGP_REGEXP,		"BGP regexp"			},
+  { MTYPE_BGP_ASPATH_REGEXP,	"BGP AS path regexp"		},
+  { MTYPE_BGP_REGEXP_STR,	"BGP regexp string"		},
   { MTYPE_BGP_AGGREGATE,	"BGP aggregate"			},
   { MTYPE_BGP_ADDR,		"BGP own address"		},
+  { MTYPE_BGP_SHOW,		"BGP show state"		},
   { MTYPE_ENCAP_TLV,		"ENCAP TLV",			},
   { MTYPE_LCOMMUNITY,           "Large Community",              },
   { MTYPE_LCOMMUNITY_STR,       "Large Community str",          },
@@ -172,6 +219,7 @@ struct memory_list memory_list_rip[] =
   { MTYPE_RIP_PEER,           "RIP peer"			},
   { MTYPE_RIP_OFFSET_LIST,    "RIP offset list"			},
   { MTYPE_RIP_DISTANCE,       "RIP distance"			},
+  { MTYPE_RIP_CHANGED,        "RIP changed routes"		},
   { -1, NULL }
 };
 
@@ -183,6 +231,7 @@ struct memory_list memory_list_ripng[] =
   { MTYPE_RIPNG_PEER,         "RIPng peer"			},
   { MTYPE_RIPNG_OFFSET_LIST,  "RIPng offset lst"		},
   { MTYPE_RIPNG_RTE_DATA,     "RIPng rte data"			},
+  { MTYPE_RIPNG_UPDATE,       "RIPng update sweep"		},
   { -1, NULL }
 };
 
@@ -207,6 +256,7 @@ struct memory_list memory_list_ospf[] =
   { MTYPE_OSPF_LSA,           "OSPF LSA"			},
   { MTYPE_OSPF_LSA_DATA,      "OSPF LSA data"			},
   { MTYPE_OSPF_LSDB,          "OSPF LSDB"			},
+  { MTYPE_OSPF_RXMT,          "OSPF retransmit entry"		},
   { MTYPE_OSPF_PACKET,        "OSPF packet"			},
   { MTYPE_OSPF_FIFO,          "OSPF FIFO queue"			},
   { MTYPE_OSPF_VERTEX,        "OSPF vertex"			},
@@ -222,6 +272,7 @@ struct memory_list memory_list_ospf[] =
   { MTYPE_OSPF_MESSAGE,		"OSPF message"			},
   { MTYPE_OSPF_MPLS_TE,       "OSPF MPLS parameters"            },
   { MTYPE_OSPF_PCE_PARAMS,    "OSPF PCE parameters"             },
+  { MTYPE_OSPF_GR,            "OSPF graceful restart"           },
   { -1, NULL },
 };
 
@@ -265,6 +316,7 @@ struct memory_list memory_list_isis[] =
   { MTYPE_ISIS_DICT,          "ISIS dictionary"			},
   { MTYPE_ISIS_DICT_NODE,     "ISIS dictionary node"		},
   { MTYPE_ISIS_MPLS_TE,       "ISIS MPLS_TE parameters"         },
+  { MTYPE_ISIS_PFRING,        "ISIS packet ring"		},
   { -1, NULL },
 };
 
@@ -281,6 +333,9 @@ struct memory_list memory_list_pim[] =
   { MTYPE_PIM_UPSTREAM,          "PIM upstream (S,G) state"       },
   { MTYPE_PIM_SSMPINGD,          "PIM sspimgd socket"             },
   { MTYPE_PIM_STATIC_ROUTE,      "PIM Static Route"               },
+  { MTYPE_PIM_JP_AGG,            "PIM Join/Prune aggregate"       },
+  { MTYPE_PIM_MFC_UPDATE,        "PIM pending MFC update"         },
+  { MTYPE_PIM_ZLOOKUP_CACHE,     "PIM zclient lookup cache"       },
   { -1, NULL },
 };
 
@@ -18,6 +18,7 @@ enum {
 	MTYPE_VTY_OUT_BUF,
 	MTYPE_VTY_HIST,
 	MTYPE_IF,
+	MTYPE_IF_INDEX,
 	MTYPE_CONNECTED,
 	MTYPE_CONNECTED_LABEL,
 	MTYPE_BUFFER,
@@ -48,6 +49,7 @@ enum {
 	MTYPE_ROUTE_MAP_RULE_STR,
 	MTYPE_ROUTE_MAP_COMPILED,
 	MTYPE_CMD_TOKENS,
+	MTYPE_CMD_TRIE,
 	MTYPE_KEY,
 	MTYPE_KEYCHAIN,
 	MTYPE_IF_RMAP,
@@ -55,18 +57,28 @@ enum {
 	MTYPE_SOCKUNION,
 	MTYPE_PRIVS,
 	MTYPE_ZLOG,
+	MTYPE_ZLOG_RING,
 	MTYPE_ZCLIENT,
 	MTYPE_WORK_QUEUE,
 	MTYPE_WORK_QUEUE_ITEM,
 	MTYPE_WORK_QUEUE_NAME,
+	MTYPE_WORK_POOL,
+	MTYPE_WORK_POOL_JOB,
+	MTYPE_ZRING,
 	MTYPE_PQUEUE,
 	MTYPE_PQUEUE_DATA,
+	MTYPE_SPF_POOL,
+	MTYPE_SPF_HEAP,
+	MTYPE_SPF_ARRAY,
+	MTYPE_REGEX_DFA,
+	MTYPE_REGEX_DFA_STATE,
 	MTYPE_HOST,
 	MTYPE_VRF,
 	MTYPE_VRF_NAME,
 	MTYPE_VRF_BITMAP,
 	MTYPE_IF_LINK_PARAMS,
 	MTYPE_RTADV_PREFIX,
+	MTYPE_RTADV_PAYLOAD,
 	MTYPE_ZEBRA_VRF,
 	MTYPE_NEXTHOP,
 	MTYPE_RIB,
@@ -77,6 +89,17 @@ enum {
 	MTYPE_NETLINK_NAME,
 	MTYPE_NETLINK_RCVBUF,
 	MTYPE_RNH,
+	MTYPE_ZEBRA_NHG,
+	MTYPE_RIB_RESOLVE,
+	MTYPE_RIB_IFDEP,
+	MTYPE_ZEBRA_REDIST_HELD,
+	MTYPE_ZEBRA_REDIST_SUBS,
+	MTYPE_ZEBRA_FPM_SERVER,
+	MTYPE_ZEBRA_IF_NOTIFY,
+	MTYPE_ZEBRA_FPM_QUEUE,
+	MTYPE_ZEBRA_SHOW,
+	MTYPE_ZEBRA_BFD,
+	MTYPE_ZEBRA_BFD_REG,
 	MTYPE_BGP,
 	MTYPE_BGP_LISTENER,
 	MTYPE_BGP_PEER,
@@ -86,6 +109,7 @@ enum {
 	MTYPE_PEER_PASSWORD,
 	MTYPE_ATTR,
 	MTYPE_ATTR_EXTRA,
+	MTYPE_ATTR_ENCODE,
 	MTYPE_AS_PATH,
 	MTYPE_AS_SEG,
 	MTYPE_AS_SEG_DATA,
@@ -101,7 +125,26 @@ enum {
 	MTYPE_BGP_SYNCHRONISE,
 	MTYPE_BGP_ADJ_IN,
 	MTYPE_BGP_ADJ_OUT,
+	MTYPE_BGP_ADJ_SHARED,
+	MTYPE_BGP_UPDGRP,
+	MTYPE_BGP_UPDGRP_ENCODE,
+	MTYPE_BGP_IO,
+	MTYPE_BGP_IO_BUF,
+	MTYPE_BGP_RMAP_CACHE,
 	MTYPE_BGP_MPATH_INFO,
+	MTYPE_BGP_MPATH_AGG,
+	MTYPE_BGP_DUMP,
+	MTYPE_BGP_BMP,
+	MTYPE_BGP_BMP_BUF,
+	MTYPE_BGP_RS_SHARED,
+	MTYPE_BGP_ANNOUNCE_WALK,
+	MTYPE_BGP_RS_PATH,
+	MTYPE_BGP_RPKI_CACHE,
+	MTYPE_BGP_RPKI_ROA,
+	MTYPE_BGP_RTC,
+	MTYPE_BGP_RTC_MEMBER,
+	MTYPE_BGP_ARENA,
+	MTYPE_BGP_SNAPSHOT,
 	MTYPE_AS_LIST,
 	MTYPE_AS_FILTER,
 	MTYPE_AS_FILTER_STR,
@@ -115,6 +158,7 @@ enum {
 	MTYPE_COMMUNITY_LIST_NAME,
 	MTYPE_COMMUNITY_LIST_ENTRY,
 	MTYPE_COMMUNITY_LIST_CONFIG,
+	MTYPE_COMMUNITY_LIST_INDEX,
 	MTYPE_COMMUNITY_LIST_HANDLER,
 	MTYPE_CLUSTER,
 	MTYPE_CLUSTER_VAL,
@@ -129,8 +173,11 @@ enum {
 	MTYPE_BGP_DAMP_INFO,
 	MTYPE_BGP_DAMP_ARRAY,
 	MTYPE_BGP_REGEXP,
+	MTYPE_BGP_ASPATH_REGEXP,
+	MTYPE_BGP_REGEXP_STR,
 	MTYPE_BGP_AGGREGATE,
 	MTYPE_BGP_ADDR,
+	MTYPE_BGP_SHOW,
 	MTYPE_ENCAP_TLV,
 	MTYPE_LCOMMUNITY,
 	MTYPE_LCOMMUNITY_STR,
@@ -141,12 +188,14 @@ enum {
 	MTYPE_RIP_PEER,
 	MTYPE_RIP_OFFSET_LIST,
 	MTYPE_RIP_DISTANCE,
+	MTYPE_RIP_CHANGED,
 	MTYPE_RIPNG,
 	MTYPE_RIPNG_ROUTE,
 	MTYPE_RIPNG_AGGREGATE,
 	MTYPE_RIPNG_PEER,
 	MTYPE_RIPNG_OFFSET_LIST,
 	MTYPE_RIPNG_RTE_DATA,
+	MTYPE_RIPNG_UPDATE,
 	MTYPE_BABEL,
 	MTYPE_BABEL_IF,
 	MTYPE_OSPF_TOP,
@@ -161,6 +210,7 @@ enum {
 	MTYPE_OSPF_LSA,
 	MTYPE_OSPF_LSA_DATA,
 	MTYPE_OSPF_LSDB,
+	MTYPE_OSPF_RXMT,
 	MTYPE_OSPF_PACKET,
 	MTYPE_OSPF_FIFO,
 	MTYPE_OSPF_VERTEX,
@@ -176,6 +226,7 @@ enum {
 	MTYPE_OSPF_MESSAGE,
 	MTYPE_OSPF_MPLS_TE,
 	MTYPE_OSPF_PCE_PARAMS,
+	MTYPE_OSPF_GR,
 	MTYPE_OSPF6_TOP,
 	MTYPE_OSPF6_AREA,
 	MTYPE_OSPF6_IF,
@@ -209,6 +260,7 @@ enum {
 	MTYPE_ISIS_DICT,
 	MTYPE_ISIS_DICT_NODE,
 	MTYPE_ISIS_MPLS_TE,
+	MTYPE_ISIS_PFRING,
 	MTYPE_PIM_CHANNEL_OIL,
 	MTYPE_PIM_INTERFACE,
 	MTYPE_PIM_IGMP_JOIN,
@@ -220,6 +272,9 @@ enum {
 	MTYPE_PIM_UPSTREAM,
 	MTYPE_PIM_SSMPINGD,
 	MTYPE_PIM_STATIC_ROUTE,
+	MTYPE_PIM_JP_AGG,
+	MTYPE_PIM_MFC_UPDATE,
+	MTYPE_PIM_ZLOOKUP_CACHE,
 	MTYPE_NHRP_IF,
 	MTYPE_NHRP_VC,
 	MTYPE_NHRP_PEER,
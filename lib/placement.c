@@ -0,0 +1,589 @@
+/*
+ * Thread placement: CPU affinity and NUMA memory policy of the main
+ * thread, I/O threads and worker pools of a daemon.
+ *
+ * This file is part of Quagga.
+ *
+ * Quagga is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2, or (at your option) any
+ * later version.
+ *
+ * Quagga is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Quagga; see the file COPYING.  If not, write to the Free
+ * Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ * 02111-1307, USA.
+ */
+
+#include <zebra.h>
+
+#ifdef HAVE_PTHREAD
+	#include <pthread.h>
+#endif
+#ifdef GNU_LINUX
+	#include <sched.h>
+	#include <sys/syscall.h>
+#endif
+
+#include "command.h"
+#include "vty.h"
+#include "placement.h"
+
+#if defined(HAVE_PTHREAD_SETAFFINITY_NP) && defined(HAVE_PTHREAD_GETAFFINITY_NP)
+	#define PLACEMENT_AFFINITY
+#endif
+#if defined(GNU_LINUX) && defined(SYS_set_mempolicy)
+	#define PLACEMENT_MEMPOLICY
+	/* from <linux/mempolicy.h>, which not every libc install has */
+	#ifndef MPOL_DEFAULT
+		#define MPOL_DEFAULT 0
+	#endif
+	#ifndef MPOL_PREFERRED
+		#define MPOL_PREFERRED 1
+	#endif
+#endif
+
+/* CPUs, and NUMA nodes, that can be named */
+#define PLACEMENT_CPUS 1024
+#define PLACEMENT_NODES 64
+
+#define PLACEMENT_SYSFS_NODE "/sys/devices/system/node/node%d/cpulist"
+
+static const char *placement_names[THREAD_PLACE_MAX] = {
+	[THREAD_PLACE_MAIN] = "main",
+	[THREAD_PLACE_IO] = "io",
+	[THREAD_PLACE_WORKERS] = "workers",
+};
+
+struct placement_conf {
+	int cpus_set;
+	unsigned char cpus[PLACEMENT_CPUS / 8];
+	int node; /* -1 for none */
+};
+
+struct placement_slot {
+	int used;
+	enum thread_place place;
+	char name[32];
+	long tid;
+#ifdef HAVE_PTHREAD
+	pthread_t pthread;
+#endif
+};
+
+/* All of it protected by mtx, but for gen, which is bumped on every
+ * change of a memory policy and read by thread_placement_check(). */
+static struct {
+	struct placement_conf conf[THREAD_PLACE_MAX];
+	struct placement_slot slots[THREAD_PLACEMENT_SLOTS];
+	unsigned int gen;
+
+	/* the CPUs the daemon was started with, for a class placed nowhere */
+	int default_set;
+	unsigned char default_cpus[PLACEMENT_CPUS / 8];
+} placement = {
+	.conf = {
+		[THREAD_PLACE_MAIN] = { .node = -1 },
+		[THREAD_PLACE_IO] = { .node = -1 },
+		[THREAD_PLACE_WORKERS] = { .node = -1 },
+	},
+};
+
+#ifdef HAVE_PTHREAD
+static pthread_mutex_t placement_mtx = PTHREAD_MUTEX_INITIALIZER;
+	#define PLACEMENT_LOCK() pthread_mutex_lock(&placement_mtx)
+	#define PLACEMENT_UNLOCK() pthread_mutex_unlock(&placement_mtx)
+#else
+	#define PLACEMENT_LOCK()
+	#define PLACEMENT_UNLOCK()
+#endif
+
+/* the calling thread's slot, and the gen its memory policy is of */
+static __thread int placement_self = -1;
+static __thread unsigned int placement_self_gen;
+
+#define PLACEMENT_ISSET(mask, cpu) ((mask)[(cpu) / 8] & (1 << ((cpu) % 8)))
+#define PLACEMENT_SET(mask, cpu) ((mask)[(cpu) / 8] |= (1 << ((cpu) % 8)))
+
+int thread_placement_parse_cpus(const char *str, unsigned char *mask, size_t n) {
+	unsigned long first, last, cpu;
+	char *end;
+
+	memset(mask, 0, n);
+	do {
+		if(!isdigit((int) *str)) {
+			return -1;
+		}
+		first = last = strtoul(str, &end, 10);
+		if(*end == '-') {
+			if(!isdigit((int) end[1])) {
+				return -1;
+			}
+			last = strtoul(end + 1, &end, 10);
+		}
+		if(first > last || last >= n * 8) {
+			return -1;
+		}
+		for(cpu = first; cpu <= last; cpu++) {
+			PLACEMENT_SET(mask, cpu);
+		}
+		str = end;
+	} while(*str++ == ',');
+
+	/* a newline ends the lists sysfs has */
+	return (str[-1] == '\0' || str[-1] == '\n') ? 0 : -1;
+}
+
+/* Write a mask as a list of ranges, like "0-3,8" */
+static const char *placement_format(const unsigned char *mask, char *buf, size_t size) {
+	unsigned int cpu, last;
+	size_t len = 0;
+
+	buf[0] = '\0';
+	for(cpu = 0; cpu < PLACEMENT_CPUS; cpu++) {
+		if(!PLACEMENT_ISSET(mask, cpu)) {
+			continue;
+		}
+		for(last = cpu; last + 1 < PLACEMENT_CPUS && PLACEMENT_ISSET(mask, last + 1); last++) {
+			;
+		}
+		if(len < size) {
+			if(last > cpu) {
+				len += snprintf(buf + len, size - len, "%s%u-%u", len ? "," : "", cpu, last);
+			} else {
+				len += snprintf(buf + len, size - len, "%s%u", len ? "," : "", cpu);
+			}
+		}
+		cpu = last;
+	}
+	return len ? buf : "-";
+}
+
+/* The CPUs of a NUMA node, as the kernel has them */
+static int placement_node_cpus(int node, unsigned char *mask) {
+	char path[64], buf[1024];
+	ssize_t len;
+	int fd;
+
+	snprintf(path, sizeof(path), PLACEMENT_SYSFS_NODE, node);
+	if((fd = open(path, O_RDONLY)) < 0) {
+		return -1;
+	}
+	len = read(fd, buf, sizeof(buf) - 1);
+	close(fd);
+	if(len <= 0) {
+		return -1;
+	}
+	buf[len] = '\0';
+	return thread_placement_parse_cpus(buf, mask, PLACEMENT_CPUS / 8);
+}
+
+#ifdef PLACEMENT_AFFINITY
+/* The CPUs a class runs on: configured, or those of its node, or those
+ * the daemon started with.  Called with mtx held. */
+static int placement_cpuset(enum thread_place place, cpu_set_t *set) {
+	struct placement_conf *conf = &placement.conf[place];
+	unsigned char node_cpus[PLACEMENT_CPUS / 8];
+	const unsigned char *mask;
+	unsigned int cpu;
+
+	if(conf->cpus_set) {
+		mask = conf->cpus;
+	} else if(conf->node >= 0 && placement_node_cpus(conf->node, node_cpus) == 0) {
+		mask = node_cpus;
+	} else if(placement.default_set) {
+		mask = placement.default_cpus;
+	} else {
+		return -1;
+	}
+
+	CPU_ZERO(set);
+	for(cpu = 0; cpu < PLACEMENT_CPUS && cpu < CPU_SETSIZE; cpu++) {
+		if(PLACEMENT_ISSET(mask, cpu)) {
+			CPU_SET(cpu, set);
+		}
+	}
+	return 0;
+}
+#endif /* PLACEMENT_AFFINITY */
+
+/* Set the calling thread's memory policy to its class' node */
+static void placement_mempolicy(int node) {
+#ifdef PLACEMENT_MEMPOLICY
+	unsigned long nodemask;
+
+	if(node >= 0) {
+		nodemask = 1UL << node;
+		/* the kernel takes one bit fewer than maxnode says */
+		syscall(SYS_set_mempolicy, MPOL_PREFERRED, &nodemask, sizeof(nodemask) * 8 + 1);
+	} else {
+		syscall(SYS_set_mempolicy, MPOL_DEFAULT, NULL, 0);
+	}
+#endif
+}
+
+void thread_placement_enter(enum thread_place place, const char *name) {
+	struct placement_slot *slot;
+	unsigned int i;
+	int node;
+#ifdef PLACEMENT_AFFINITY
+	cpu_set_t set;
+	int placed;
+#endif
+
+	PLACEMENT_LOCK();
+	for(i = 0; i < THREAD_PLACEMENT_SLOTS; i++) {
+		if(!placement.slots[i].used) {
+			break;
+		}
+	}
+	if(i < THREAD_PLACEMENT_SLOTS) {
+		slot = &placement.slots[i];
+		slot->used = 1;
+		slot->place = place;
+		strlcpy(slot->name, name, sizeof(slot->name));
+#ifdef GNU_LINUX
+		slot->tid = syscall(SYS_gettid);
+#else
+		slot->tid = getpid();
+#endif
+#ifdef HAVE_PTHREAD
+		slot->pthread = pthread_self();
+#endif
+		placement_self = i;
+	}
+
+	node = placement.conf[place].node;
+	placement_self_gen = __atomic_load_n(&placement.gen, __ATOMIC_RELAXED);
+#ifdef PLACEMENT_AFFINITY
+	placed = placement_cpuset(place, &set);
+#endif
+	PLACEMENT_UNLOCK();
+
+	/* before the thread touches memory of its own */
+#ifdef PLACEMENT_AFFINITY
+	if(placed == 0) {
+		pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+	}
+#endif
+	placement_mempolicy(node);
+}
+
+void thread_placement_leave(void) {
+	if(placement_self < 0) {
+		return;
+	}
+
+	PLACEMENT_LOCK();
+	placement.slots[placement_self].used = 0;
+	PLACEMENT_UNLOCK();
+	placement_self = -1;
+}
+
+void thread_placement_check(void) {
+	unsigned int gen = __atomic_load_n(&placement.gen, __ATOMIC_RELAXED);
+	int node;
+
+	if(gen == placement_self_gen || placement_self < 0) {
+		return;
+	}
+
+	PLACEMENT_LOCK();
+	node = placement.conf[placement.slots[placement_self].place].node;
+	gen = placement.gen;
+	PLACEMENT_UNLOCK();
+
+	placement_mempolicy(node);
+	placement_self_gen = gen;
+}
+
+/* A class' configuration changed: move its threads over.  Each running
+ * thread takes on a memory policy itself, at its next check. */
+static void placement_apply(enum thread_place place) {
+#ifdef PLACEMENT_AFFINITY
+	cpu_set_t set;
+	unsigned int i;
+#endif
+
+	PLACEMENT_LOCK();
+	__atomic_add_fetch(&placement.gen, 1, __ATOMIC_RELAXED);
+#ifdef PLACEMENT_AFFINITY
+	if(placement_cpuset(place, &set) == 0) {
+		for(i = 0; i < THREAD_PLACEMENT_SLOTS; i++) {
+			if(placement.slots[i].used && placement.slots[i].place == place) {
+				pthread_setaffinity_np(placement.slots[i].pthread, sizeof(set), &set);
+			}
+		}
+	}
+#endif
+	PLACEMENT_UNLOCK();
+
+	/* config is applied by the main thread, which can check at once */
+	thread_placement_check();
+}
+
+static enum thread_place placement_lookup(const char *str) {
+	enum thread_place place;
+
+	for(place = 0; place < THREAD_PLACE_MAX; place++) {
+		if(strncmp(str, placement_names[place], strlen(str)) == 0) {
+			break;
+		}
+	}
+	return place;
+}
+
+#define PLACEMENT_CLASS_STR "Main thread\nI/O threads\nWorker pool threads\n"
+
+DEFUN(thread_placement_cpus, thread_placement_cpus_cmd, "thread placement (main|io|workers) cpus LIST", "Thread settings\nWhere threads run\n" PLACEMENT_CLASS_STR "CPUs to run on\nCPU numbers or ranges joined by commas\n") {
+	enum thread_place place = placement_lookup(argv[0]);
+	unsigned char mask[PLACEMENT_CPUS / 8];
+	unsigned int cpu;
+
+#ifndef PLACEMENT_AFFINITY
+	vty_out(vty, "%% CPU affinity is not supported on this platform%s", VTY_NEWLINE);
+	return CMD_WARNING;
+#endif
+
+	if(thread_placement_parse_cpus(argv[1], mask, sizeof(mask)) < 0) {
+		vty_out(vty, "%% Invalid CPU list: %s%s", argv[1], VTY_NEWLINE);
+		return CMD_WARNING;
+	}
+	for(cpu = 0; cpu < PLACEMENT_CPUS; cpu++) {
+		if(PLACEMENT_ISSET(mask, cpu) && (!placement.default_set || PLACEMENT_ISSET(placement.default_cpus, cpu))) {
+			break;
+		}
+	}
+	if(cpu == PLACEMENT_CPUS) {
+		vty_out(vty, "%% None of CPUs %s is available%s", argv[1], VTY_NEWLINE);
+		return CMD_WARNING;
+	}
+
+	PLACEMENT_LOCK();
+	placement.conf[place].cpus_set = 1;
+	memcpy(placement.conf[place].cpus, mask, sizeof(mask));
+	PLACEMENT_UNLOCK();
+
+	placement_apply(place);
+	return CMD_SUCCESS;
+}
+
+DEFUN(thread_placement_node, thread_placement_node_cmd, "thread placement (main|io|workers) numa-node <0-63>", "Thread settings\nWhere threads run\n" PLACEMENT_CLASS_STR "NUMA node to run on and allocate memory from\nNode number\n") {
+	enum thread_place place = placement_lookup(argv[0]);
+	unsigned char mask[PLACEMENT_CPUS / 8];
+	int node;
+
+	VTY_GET_INTEGER_RANGE("NUMA node", node, argv[1], 0, PLACEMENT_NODES - 1);
+
+	if(placement_node_cpus(node, mask) < 0) {
+		vty_out(vty, "%% No NUMA node %d%s", node, VTY_NEWLINE);
+		return CMD_WARNING;
+	}
+
+	PLACEMENT_LOCK();
+	placement.conf[place].node = node;
+	PLACEMENT_UNLOCK();
+
+	placement_apply(place);
+	return CMD_SUCCESS;
+}
+
+DEFUN(no_thread_placement, no_thread_placement_cmd, "no thread placement (main|io|workers)", NO_STR "Thread settings\nWhere threads run\n" PLACEMENT_CLASS_STR) {
+	enum thread_place place = placement_lookup(argv[0]);
+
+	PLACEMENT_LOCK();
+	placement.conf[place].cpus_set = 0;
+	placement.conf[place].node = -1;
+	PLACEMENT_UNLOCK();
+
+	placement_apply(place);
+	return CMD_SUCCESS;
+}
+
+/* The CPU a thread last ran on, from field 39 of its stat */
+static int placement_last_cpu(long tid) {
+#ifdef GNU_LINUX
+	char path[64], buf[1024], *p;
+	ssize_t len;
+	int fd, field;
+
+	snprintf(path, sizeof(path), "/proc/self/task/%ld/stat", tid);
+	if((fd = open(path, O_RDONLY)) < 0) {
+		return -1;
+	}
+	len = read(fd, buf, sizeof(buf) - 1);
+	close(fd);
+	if(len <= 0) {
+		return -1;
+	}
+	buf[len] = '\0';
+
+	/* the name, field 2, may have spaces: count from its ')' */
+	if(!(p = strrchr(buf, ')'))) {
+		return -1;
+	}
+	for(field = 2; field < 39 && p; field++) {
+		p = strchr(p + 1, ' ');
+	}
+	return p ? atoi(p + 1) : -1;
+#else
+	return -1;
+#endif
+}
+
+DEFUN(show_thread_placement, show_thread_placement_cmd, "show thread placement", SHOW_STR "Thread information\nWhere threads run\n") {
+	struct placement_conf *conf;
+	struct placement_slot *slot;
+	signed char cpu_node[PLACEMENT_CPUS];
+	unsigned char mask[PLACEMENT_CPUS / 8];
+	char buf[128];
+	unsigned int i, cpu;
+	int node, last;
+	long tid;
+#ifdef PLACEMENT_AFFINITY
+	cpu_set_t set;
+#endif
+
+	memset(cpu_node, -1, sizeof(cpu_node));
+	for(node = 0; node < PLACEMENT_NODES; node++) {
+		if(placement_node_cpus(node, mask) < 0) {
+			continue;
+		}
+		for(cpu = 0; cpu < PLACEMENT_CPUS; cpu++) {
+			if(PLACEMENT_ISSET(mask, cpu)) {
+				cpu_node[cpu] = node;
+			}
+		}
+		vty_out(vty, "NUMA node %d: CPUs %s%s", node, placement_format(mask, buf, sizeof(buf)), VTY_NEWLINE);
+	}
+
+	PLACEMENT_LOCK();
+	vty_out(vty, "%s%-8s %-24s %s%s", VTY_NEWLINE, "Class", "CPUs", "NUMA node", VTY_NEWLINE);
+	for(i = 0; i < THREAD_PLACE_MAX; i++) {
+		conf = &placement.conf[i];
+		vty_out(vty, "%-8s %-24s ", placement_names[i], conf->cpus_set ? placement_format(conf->cpus, buf, sizeof(buf)) : "-");
+		if(conf->node >= 0) {
+			vty_out(vty, "%d%s", conf->node, VTY_NEWLINE);
+		} else {
+			vty_out(vty, "-%s", VTY_NEWLINE);
+		}
+	}
+
+	vty_out(vty, "%s%-8s %8s %4s %4s %-24s %s%s", VTY_NEWLINE, "Class", "TID", "CPU", "Node", "Allowed CPUs", "Thread", VTY_NEWLINE);
+	for(i = 0; i < THREAD_PLACEMENT_SLOTS; i++) {
+		slot = &placement.slots[i];
+		if(!slot->used) {
+			continue;
+		}
+
+		tid = slot->tid;
+		strlcpy(buf, "-", sizeof(buf));
+#ifdef PLACEMENT_AFFINITY
+		if(pthread_getaffinity_np(slot->pthread, sizeof(set), &set) == 0) {
+			memset(mask, 0, sizeof(mask));
+			for(cpu = 0; cpu < PLACEMENT_CPUS && cpu < CPU_SETSIZE; cpu++) {
+				if(CPU_ISSET(cpu, &set)) {
+					PLACEMENT_SET(mask, cpu);
+				}
+			}
+			placement_format(mask, buf, sizeof(buf));
+		}
+#endif
+		last = placement_last_cpu(tid);
+		vty_out(vty, "%-8s %8ld ", placement_names[slot->place], tid);
+		if(last >= 0) {
+			vty_out(vty, "%4d ", last);
+		} else {
+			vty_out(vty, "%4s ", "-");
+		}
+		if(last >= 0 && last < PLACEMENT_CPUS && cpu_node[last] >= 0) {
+			vty_out(vty, "%4d ", cpu_node[last]);
+		} else {
+			vty_out(vty, "%4s ", "-");
+		}
+		vty_out(vty, "%-24s %s%s", buf, slot->name, VTY_NEWLINE);
+	}
+	PLACEMENT_UNLOCK();
+
+	return CMD_SUCCESS;
+}
+
+int thread_placement_config_write(struct vty *vty) {
+	struct placement_conf *conf;
+	char buf[128];
+	unsigned int i;
+
+	for(i = 0; i < THREAD_PLACE_MAX; i++) {
+		conf = &placement.conf[i];
+		if(conf->cpus_set) {
+			vty_out(vty, "thread placement %s cpus %s%s", placement_names[i], placement_format(conf->cpus, buf, sizeof(buf)), VTY_NEWLINE);
+		}
+		if(conf->node >= 0) {
+			vty_out(vty, "thread placement %s numa-node %d%s", placement_names[i], conf->node, VTY_NEWLINE);
+		}
+	}
+	return 0;
+}
+
+#ifdef HAVE_PTHREAD
+/* The config is read, and threads started with it, before daemonizing.
+ * Only the forking thread goes on in the child: drop the slots of the
+ * others, whose pthread_t mean nothing there, and take the new TID. */
+static void placement_fork_prepare(void) {
+	pthread_mutex_lock(&placement_mtx);
+}
+
+static void placement_fork_parent(void) {
+	pthread_mutex_unlock(&placement_mtx);
+}
+
+static void placement_fork_child(void) {
+	unsigned int i;
+
+	for(i = 0; i < THREAD_PLACEMENT_SLOTS; i++) {
+		if((int) i != placement_self) {
+			placement.slots[i].used = 0;
+		}
+	}
+	if(placement_self >= 0) {
+#ifdef GNU_LINUX
+		placement.slots[placement_self].tid = syscall(SYS_gettid);
+#else
+		placement.slots[placement_self].tid = getpid();
+#endif
+		placement.slots[placement_self].pthread = pthread_self();
+	}
+	pthread_mutex_unlock(&placement_mtx);
+}
+#endif /* HAVE_PTHREAD */
+
+void thread_placement_init(void) {
+#ifdef HAVE_PTHREAD
+	pthread_atfork(placement_fork_prepare, placement_fork_parent, placement_fork_child);
+#endif
+#ifdef PLACEMENT_AFFINITY
+	cpu_set_t set;
+	unsigned int cpu;
+
+	if(pthread_getaffinity_np(pthread_self(), sizeof(set), &set) == 0) {
+		for(cpu = 0; cpu < PLACEMENT_CPUS && cpu < CPU_SETSIZE; cpu++) {
+			if(CPU_ISSET(cpu, &set)) {
+				PLACEMENT_SET(placement.default_cpus, cpu);
+			}
+		}
+		placement.default_set = 1;
+	}
+#endif
+
+	thread_placement_enter(THREAD_PLACE_MAIN, "main");
+
+	install_element(CONFIG_NODE, &thread_placement_cpus_cmd);
+	install_element(CONFIG_NODE, &thread_placement_node_cmd);
+	install_element(CONFIG_NODE, &no_thread_placement_cmd);
+	install_element(VIEW_NODE, &show_thread_placement_cmd);
+}
@@ -0,0 +1,71 @@
+/*
+ * Thread placement: CPU affinity and NUMA memory policy of the main
+ * thread, I/O threads and worker pools of a daemon.
+ *
+ * This file is part of Quagga.
+ *
+ * Quagga is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2, or (at your option) any
+ * later version.
+ *
+ * Quagga is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Quagga; see the file COPYING.  If not, write to the Free
+ * Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ * 02111-1307, USA.
+ */
+
+#ifndef _QUAGGA_PLACEMENT_H
+#define _QUAGGA_PLACEMENT_H
+
+/* Each thread of a daemon belongs to a class, and 'thread placement'
+ * configures, per class, the CPUs its threads may run on and the NUMA
+ * node their memory comes from:
+ *
+ *   thread placement (main|io|workers) cpus 0-3,8
+ *   thread placement (main|io|workers) numa-node 1
+ *
+ * A NUMA node alone also stands for its CPUs.  CPU affinity is applied
+ * at once to the threads of the class running.  The memory policy is a
+ * property of each thread that only it can set: a thread takes it on in
+ * thread_placement_enter(), and again at its next thread_placement_check()
+ * after a change, so that its stack, and the malloc arena it gets on its
+ * first allocation, are local to the node.
+ *
+ * Threads register themselves, from the thread, on start; the main
+ * thread is registered by cmd_init().  Forking keeps the slot of the
+ * forking thread only, as the others don't go on in the child.  None of these functions allocate
+ * memory or log, so they are safe to call from worker threads.
+ */
+
+enum thread_place {
+	THREAD_PLACE_MAIN = 0,
+	THREAD_PLACE_IO,
+	THREAD_PLACE_WORKERS,
+	THREAD_PLACE_MAX,
+};
+
+/* most threads shown, and placed, per daemon */
+#define THREAD_PLACEMENT_SLOTS 128
+
+/* Register the calling thread, under a name, and place it. */
+extern void thread_placement_enter(enum thread_place, const char *name);
+/* Unregister the calling thread, before it exits. */
+extern void thread_placement_leave(void);
+/* Take on the memory policy of the thread's class, if changed since it
+ * last did.  A single atomic load when nothing changed. */
+extern void thread_placement_check(void);
+
+/* Parse a CPU list like "0-3,8" into a bit per CPU, of n bytes.
+ * Returns 0, or -1 if it isn't one or names a CPU past n * 8. */
+extern int thread_placement_parse_cpus(const char *str, unsigned char *mask, size_t n);
+
+extern void thread_placement_init(void);
+extern int thread_placement_config_write(struct vty *);
+
+#endif /* _QUAGGA_PLACEMENT_H */
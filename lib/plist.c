@@ -27,12 +27,16 @@
 #include "memory.h"
 #include "plist.h"
 #include "sockunion.h"
+#include "table.h"
 #include "buffer.h"
 #include "stream.h"
 #include "log.h"
 
 #include "plist_int.h"
 
+/* Lists at least this long are looked up through a trie */
+#define PREFIX_LIST_TRIE_MIN 16
+
 /* List of struct prefix_list. */
 struct prefix_list_list {
 	struct prefix_list *head;
@@ -163,6 +167,58 @@ static void prefix_list_entry_free(struct prefix_list_entry *pentry) {
 	XFREE(MTYPE_PREFIX_LIST_ENTRY, pentry);
 }
 
+static void prefix_list_trie_free(struct prefix_list *plist) {
+	if(plist->trie) {
+		route_table_finish(plist->trie);
+		plist->trie = NULL;
+	}
+}
+
+/* Put the entry on the trie node of its prefix, whose chain is kept in
+   sequence order.  Each entry holds a lock on its node. */
+static void prefix_list_trie_add(struct prefix_list *plist, struct prefix_list_entry *pentry) {
+	struct prefix_list_entry **point;
+	struct route_node *rn;
+	struct prefix p;
+
+	if(!plist->trie) {
+		plist->trie = route_table_init();
+	}
+
+	prefix_copy(&p, &pentry->prefix);
+	apply_mask(&p);
+
+	rn = route_node_get(plist->trie, &p);
+	for(point = (struct prefix_list_entry **) &rn->info; *point; point = &(*point)->trie_next) {
+		if((*point)->seq >= pentry->seq) {
+			break;
+		}
+	}
+	pentry->trie_next = *point;
+	*point = pentry;
+}
+
+static void prefix_list_trie_delete(struct prefix_list *plist, struct prefix_list_entry *pentry) {
+	struct prefix_list_entry **point;
+	struct route_node *rn;
+	struct prefix p;
+
+	prefix_copy(&p, &pentry->prefix);
+	apply_mask(&p);
+
+	rn = route_node_lookup(plist->trie, &p);
+	assert(rn);
+
+	for(point = (struct prefix_list_entry **) &rn->info; *point != pentry; point = &(*point)->trie_next)
+		;
+	*point = pentry->trie_next;
+	pentry->trie_next = NULL;
+
+	/* route_node_lookup()'s lock, and the entry's */
+	route_unlock_node(rn);
+	route_unlock_node(rn);
+}
+
 /* Insert new prefix list to list of prefix_list.  Each prefix_list
    is sorted by the name. */
 static struct prefix_list *prefix_list_insert(afi_t afi, int orf, const char *name) {
@@ -271,6 +327,8 @@ static void prefix_list_delete(struct prefix_list *plist) {
 	struct prefix_list_entry *pentry;
 	struct prefix_list_entry *next;
 
+	prefix_list_trie_free(plist);
+
 	/* If prefix-list contain prefix_list_entry free all of it. */
 	for(pentry = plist->head; pentry; pentry = next) {
 		next = pentry->next;
@@ -332,6 +390,16 @@ static struct prefix_list_entry *prefix_list_entry_make(struct prefix *prefix, e
 	pentry->le = le;
 	pentry->ge = ge;
 
+	/* In case of le nor ge is specified, exact match is performed. */
+	pentry->len_min = ge ? ge : prefix->prefixlen;
+	if(le) {
+		pentry->len_max = le;
+	} else if(ge) {
+		pentry->len_max = prefix_blen(prefix) * 8;
+	} else {
+		pentry->len_max = prefix->prefixlen;
+	}
+
 	return pentry;
 }
 
@@ -409,6 +477,8 @@ static void prefix_list_entry_delete(struct prefix_list *plist, struct prefix_li
 	if(plist == NULL || pentry == NULL) {
 		return;
 	}
+	prefix_list_trie_delete(plist, pentry);
+
 	if(pentry->prev) {
 		pentry->prev->next = pentry->next;
 	} else {
@@ -482,6 +552,8 @@ static void prefix_list_entry_add(struct prefix_list *plist, struct prefix_list_
 		plist->tail = pentry;
 	}
 
+	prefix_list_trie_add(plist, pentry);
+
 	/* Increment count. */
 	plist->count++;
 
@@ -510,25 +582,41 @@ static int prefix_list_entry_match(struct prefix_list_entry *pentry, struct pref
 		return 0;
 	}
 
-	/* In case of le nor ge is specified, exact match is performed. */
-	if(!pentry->le && !pentry->ge) {
-		if(pentry->prefix.prefixlen != p->prefixlen) {
-			return 0;
-		}
-	} else {
-		if(pentry->le) {
-			if(p->prefixlen > pentry->le) {
-				return 0;
-			}
-		}
+	if(p->prefixlen < pentry->len_min || p->prefixlen > pentry->len_max) {
+		return 0;
+	}
+	return 1;
+}
 
-		if(pentry->ge) {
-			if(p->prefixlen < pentry->ge) {
-				return 0;
+/* The entries that can match p all sit on the path from the root of the
+   trie down to p, so at most one node per bit of p has to be looked at,
+   however long the list. */
+static struct prefix_list_entry *prefix_list_trie_match(struct prefix_list *plist, struct prefix *p) {
+	struct prefix_list_entry *pentry;
+	struct prefix_list_entry *best = NULL;
+	struct route_node *rn, *matched;
+
+	if(p->family != plist->head->prefix.family) {
+		return NULL;
+	}
+
+	matched = route_node_match(plist->trie, p);
+	for(rn = matched; rn; rn = rn->parent) {
+		for(pentry = rn->info; pentry; pentry = pentry->trie_next) {
+			if(best && pentry->seq >= best->seq) {
+				break;
+			}
+			pentry->refcnt++;
+			if(p->prefixlen >= pentry->len_min && p->prefixlen <= pentry->len_max) {
+				best = pentry;
+				break;
 			}
 		}
 	}
-	return 1;
+	if(matched) {
+		route_unlock_node(matched);
+	}
+	return best;
 }
 
 enum prefix_list_type prefix_list_apply(struct prefix_list *plist, void *object) {
@@ -545,6 +633,15 @@ enum prefix_list_type prefix_list_apply(struct prefix_list *plist, void *object)
 		return PREFIX_PERMIT;
 	}
 
+	if(plist->count >= PREFIX_LIST_TRIE_MIN) {
+		pentry = prefix_list_trie_match(plist, p);
+		if(pentry) {
+			pentry->hitcnt++;
+			return pentry->type;
+		}
+		return PREFIX_DENY;
+	}
+
 	for(pentry = plist->head; pentry; pentry = pentry->next) {
 		pentry->refcnt++;
 		if(prefix_list_entry_match(pentry, p)) {
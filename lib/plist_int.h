@@ -43,6 +43,10 @@ struct prefix_list {
 	struct prefix_list_entry *head;
 	struct prefix_list_entry *tail;
 
+	/* Entries by prefix, kept up to date as entries are added and
+	   deleted, and used by prefix_list_apply() for long lists. */
+	struct route_table *trie;
+
 	struct prefix_list *next;
 	struct prefix_list *prev;
 };
@@ -54,6 +58,10 @@ struct prefix_list_entry {
 	int le;
 	int ge;
 
+	/* Prefix lengths le and ge amount to */
+	u_char len_min;
+	u_char len_max;
+
 	enum prefix_list_type type;
 
 	int any;
@@ -64,6 +72,9 @@ struct prefix_list_entry {
 
 	struct prefix_list_entry *next;
 	struct prefix_list_entry *prev;
+
+	/* Next entry of the same prefix in the trie, by sequence number */
+	struct prefix_list_entry *trie_next;
 };
 
 #endif /* _QUAGGA_PLIST_INT_H */
@@ -243,6 +243,50 @@ const char *safi2str(safi_t safi) {
 	return NULL;
 }
 
+/* Network order mask of the first len bits of a 32 bit word */
+static inline u_int32_t prefix_mask32(int len) {
+	return len >= 32 ? 0xffffffff : htonl(len <= 0 ? 0 : ~(0xffffffffU >> len));
+}
+
+/* Do the first len bits of two addresses of the family agree?  IPv4 is
+ * compared as one word and IPv6 as two 64 bit ones; -1 for a family, or
+ * a length, that has to be compared bytewise. */
+static inline int prefix_bits_same(u_char family, const void *a, const void *b, int len) {
+	if(family == AF_INET && len <= IPV4_MAX_BITLEN) {
+		u_int32_t x, y;
+
+		memcpy(&x, a, sizeof(x));
+		memcpy(&y, b, sizeof(y));
+		return !((x ^ y) & prefix_mask32(len));
+	}
+#ifdef HAVE_IPV6
+	if(family == AF_INET6 && len <= IPV6_MAX_BITLEN) {
+		union {
+			u_int64_t q;
+			u_int32_t w[2];
+		} x[2], y[2], mask;
+
+		memcpy(x, a, sizeof(x));
+		memcpy(y, b, sizeof(y));
+		if(len >= 64) {
+			if(x[0].q != y[0].q) {
+				return 0;
+			}
+			if(len == 64) {
+				return 1;
+			}
+			x[0] = x[1];
+			y[0] = y[1];
+			len -= 64;
+		}
+		mask.w[0] = prefix_mask32(len);
+		mask.w[1] = prefix_mask32(len - 32);
+		return !((x[0].q ^ y[0].q) & mask.q);
+	}
+#endif /* HAVE_IPV6 */
+	return -1;
+}
+
 /* If n includes p prefix then return 1 else return 0. */
 int prefix_match(const struct prefix *n, const struct prefix *p) {
 	int offset;
@@ -254,6 +298,14 @@ int prefix_match(const struct prefix *n, const struct prefix *p) {
 		return 0;
 	}
 
+	if(n->family == p->family) {
+		int same = prefix_bits_same(n->family, &n->u.prefix, &p->u.prefix, n->prefixlen);
+
+		if(same >= 0) {
+			return same;
+		}
+	}
+
 	/* Set both prefix's head pointer. */
 	np = (const u_char *) &n->u.prefix;
 	pp = (const u_char *) &p->u.prefix;
@@ -343,6 +395,7 @@ int prefix_same(const struct prefix *p1, const struct prefix *p2) {
 int prefix_cmp(const struct prefix *p1, const struct prefix *p2) {
 	int offset;
 	int shift;
+	int same;
 
 	/* Set both prefix's head pointer. */
 	const u_char *pp1 = (const u_char *) &p1->u.prefix;
@@ -352,6 +405,10 @@ int prefix_cmp(const struct prefix *p1, const struct prefix *p2) {
 		return 1;
 	}
 
+	if((same = prefix_bits_same(p1->family, pp1, pp2, p1->prefixlen)) >= 0) {
+		return !same;
+	}
+
 	offset = p1->prefixlen / PNBBY;
 	shift = p1->prefixlen % PNBBY;
 
@@ -179,9 +179,19 @@ static pset_t *zcaps2sys(zebra_capabilities_t *zcaps, int num) {
 	return syscaps;
 }
 
+/* Capabilities are each thread's own: whether the calling thread raised
+   them last, so that zprivs_state_caps() answers for it rather than for
+   the working storage all threads share. */
+#ifdef HAVE_PTHREAD
+static __thread int zprivs_caps_raised;
+#else
+static int zprivs_caps_raised;
+#endif
+
 /* set or clear the effective capabilities to/from permitted */
 int zprivs_change_caps(zebra_privs_ops_t op) {
 	cap_flag_value_t cflag;
+	int ret;
 
 	/* should be no possibility of being called without valid caps */
 	assert(zprivs_state.syscaps_p && zprivs_state.caps);
@@ -198,31 +208,23 @@ int zprivs_change_caps(zebra_privs_ops_t op) {
 	}
 
 	if(!cap_set_flag(zprivs_state.caps, CAP_EFFECTIVE, zprivs_state.syscaps_p->num, zprivs_state.syscaps_p->caps, cflag)) {
-		return cap_set_proc(zprivs_state.caps);
+		ret = cap_set_proc(zprivs_state.caps);
+		if(ret == 0) {
+			zprivs_caps_raised = (op == ZPRIVS_RAISE);
+		}
+		return ret;
 	}
 	return -1;
 }
 
 zebra_privs_current_t zprivs_state_caps(void) {
-	int i;
-	cap_flag_value_t val;
-
 	/* should be no possibility of being called without valid caps */
 	assert(zprivs_state.syscaps_p && zprivs_state.caps);
 	if(!(zprivs_state.syscaps_p && zprivs_state.caps)) {
 		exit(1);
 	}
 
-	for(i = 0; i < zprivs_state.syscaps_p->num; i++) {
-		if(cap_get_flag(zprivs_state.caps, zprivs_state.syscaps_p->caps[i], CAP_EFFECTIVE, &val)) {
-			zlog_warn("zprivs_state_caps: could not cap_get_flag, %s", safe_strerror(errno));
-			return ZPRIVS_UNKNOWN;
-		}
-		if(val == CAP_SET) {
-			return ZPRIVS_RAISED;
-		}
-	}
-	return ZPRIVS_LOWERED;
+	return zprivs_caps_raised ? ZPRIVS_RAISED : ZPRIVS_LOWERED;
 }
 
 static void zprivs_caps_init(struct zebra_privs_t *zprivs) {
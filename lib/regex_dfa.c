@@ -0,0 +1,736 @@
+/*
+ * Linear-time matching of POSIX extended regular expressions.
+ *
+ * This file is part of Quagga.
+ *
+ * Quagga is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2, or (at your option) any
+ * later version.
+ *
+ * Quagga is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Quagga; see the file COPYING.  If not, write to the Free
+ * Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ * 02111-1307, USA.
+ */
+
+#include <zebra.h>
+
+#include "memory.h"
+#include "hash.h"
+#include "jhash.h"
+#include "regex_dfa.h"
+
+/* Nesting of parentheses, and bounds of intervals, beyond which a
+ * pattern is left to regexec() */
+#define RE_DEPTH_MAX 64
+#define RE_DUP_LIMIT 255
+
+/* The pattern, parsed */
+enum re_type {
+	RE_SET,	  /* a byte of the set */
+	RE_EMPTY, /* nothing at all */
+	RE_CAT,
+	RE_ALT,
+	RE_STAR,
+	RE_PLUS,
+	RE_QUEST,
+	RE_REPEAT, /* {min,max}, max -1 for no bound */
+	RE_BOL,
+	RE_EOL,
+};
+
+struct re_node {
+	enum re_type type;
+	int l, r;
+	int set;
+	int min, max;
+};
+
+struct re_set {
+	u_int32_t bits[8];
+};
+
+#define RE_SET_TEST(S, C) ((S)->bits[(C) >> 5] & (1U << ((C) &31)))
+#define RE_SET_ADD(S, C) ((S)->bits[(C) >> 5] |= (1U << ((C) &31)))
+
+/* ... and compiled to an NFA, whose SET states take a byte, SPLIT
+ * states go either way, and BOL and EOL states only at the start and
+ * the end of the string */
+enum nfa_type {
+	NFA_SET,
+	NFA_SPLIT,
+	NFA_BOL,
+	NFA_EOL,
+	NFA_MATCH,
+};
+
+struct nfa_state {
+	enum nfa_type type;
+	int set;
+	int out, out1;
+};
+
+/* A DFA state is the set of NFA states, SET, EOL and MATCH ones only,
+ * that the string so far may have got to */
+struct dfa_state {
+	struct dfa_state **next; /* by byte class, NULL until made */
+	int *set;
+	int n;
+	u_char match; /* MATCH is in the set: the search is over */
+	u_char eol;   /* 0 not known yet, else 1 + whether it matches at the end */
+};
+
+struct regex_dfa {
+	struct re_set *sets;
+	int nsets;
+	struct nfa_state *nfa;
+	int nnfa;
+	int start;
+
+	/* bytes alike to all the sets share a class, whose first byte
+	 * stands for it */
+	u_char class[256];
+	u_char rep[256];
+	int nclass;
+
+	/* the NFA states a search may start over from, at every byte */
+	int *restart;
+	int nrestart;
+
+	struct hash *states;
+	struct dfa_state *init;
+
+	/* scratch for making the sets */
+	int *mark;
+	unsigned int gen;
+	int *stack;
+	int *work;
+
+	struct regex_dfa_stats stats;
+};
+
+struct re_parse {
+	const char *p;
+	struct re_node *node;
+	int nnodes;
+	int nodes_size;
+	struct re_set *sets;
+	int nsets;
+	int sets_size;
+	int depth;
+	int error;
+};
+
+static int re_node_new(struct re_parse *rp, enum re_type type, int l, int r) {
+	struct re_node *node;
+
+	if(rp->nnodes == rp->nodes_size) {
+		rp->nodes_size = rp->nodes_size ? rp->nodes_size * 2 : 32;
+		rp->node = XREALLOC(MTYPE_TMP, rp->node, rp->nodes_size * sizeof(struct re_node));
+	}
+	node = &rp->node[rp->nnodes];
+	memset(node, 0, sizeof(struct re_node));
+	node->type = type;
+	node->l = l;
+	node->r = r;
+	return rp->nnodes++;
+}
+
+static int re_set_new(struct re_parse *rp) {
+	if(rp->nsets == rp->sets_size) {
+		rp->sets_size = rp->sets_size ? rp->sets_size * 2 : 16;
+		rp->sets = XREALLOC(MTYPE_REGEX_DFA, rp->sets, rp->sets_size * sizeof(struct re_set));
+	}
+	memset(&rp->sets[rp->nsets], 0, sizeof(struct re_set));
+	return rp->nsets++;
+}
+
+static int re_set_node(struct re_parse *rp, int set) {
+	int n = re_node_new(rp, RE_SET, -1, -1);
+
+	rp->node[n].set = set;
+	return n;
+}
+
+static const struct {
+	const char *name;
+	int (*is)(int);
+} re_classes[] = {
+	{"alpha", isalpha},
+	{"digit", isdigit},
+	{"alnum", isalnum},
+	{"upper", isupper},
+	{"lower", islower},
+	{"space", isspace},
+	{"blank", isblank},
+	{"punct", ispunct},
+	{"print", isprint},
+	{"graph", isgraph},
+	{"cntrl", iscntrl},
+	{"xdigit", isxdigit},
+};
+
+/* [...], from just after the '[' */
+static int re_bracket(struct re_parse *rp) {
+	struct re_set *set;
+	int s, c, hi, i, neg = 0, first = 1;
+
+	s = re_set_new(rp);
+	if(*rp->p == '^') {
+		neg = 1;
+		rp->p++;
+	}
+
+	while(1) {
+		set = &rp->sets[s];
+		if(*rp->p == '\0') {
+			rp->error = 1;
+			return -1;
+		}
+		if(*rp->p == ']' && !first) {
+			rp->p++;
+			break;
+		}
+		first = 0;
+
+		if(rp->p[0] == '[' && rp->p[1] == ':') {
+			const char *end = strstr(rp->p + 2, ":]");
+
+			for(i = 0; end && i < (int) array_size(re_classes); i++) {
+				if(strlen(re_classes[i].name) == (size_t) (end - rp->p - 2) && strncmp(re_classes[i].name, rp->p + 2, end - rp->p - 2) == 0) {
+					break;
+				}
+			}
+			if(!end || i == (int) array_size(re_classes)) {
+				rp->error = 1;
+				return -1;
+			}
+			for(c = 1; c < 256; c++) {
+				if(re_classes[i].is(c)) {
+					RE_SET_ADD(set, c);
+				}
+			}
+			rp->p = end + 2;
+			continue;
+		}
+		/* collating elements and equivalence classes */
+		if(rp->p[0] == '[' && (rp->p[1] == '=' || rp->p[1] == '.')) {
+			rp->error = 1;
+			return -1;
+		}
+
+		c = (u_char) *rp->p++;
+		if(rp->p[0] == '-' && rp->p[1] != ']' && rp->p[1] != '\0') {
+			hi = (u_char) rp->p[1];
+			if(hi == '[' || hi < c) {
+				rp->error = 1;
+				return -1;
+			}
+			rp->p += 2;
+			/* a-m-z */
+			if(rp->p[0] == '-' && rp->p[1] != ']') {
+				rp->error = 1;
+				return -1;
+			}
+		} else {
+			hi = c;
+		}
+		for(; c <= hi; c++) {
+			RE_SET_ADD(set, c);
+		}
+	}
+
+	if(neg) {
+		for(i = 0; i < 8; i++) {
+			set->bits[i] = ~set->bits[i];
+		}
+	}
+	/* strings end there */
+	set->bits[0] &= ~1U;
+	return re_set_node(rp, s);
+}
+
+static int re_alt(struct re_parse *rp);
+
+static int re_atom(struct re_parse *rp) {
+	int n, s, c;
+
+	switch(*rp->p) {
+		case '(':
+			if(++rp->depth > RE_DEPTH_MAX) {
+				rp->error = 1;
+				return -1;
+			}
+			rp->p++;
+			n = re_alt(rp);
+			if(rp->error || *rp->p != ')') {
+				rp->error = 1;
+				return -1;
+			}
+			rp->p++;
+			rp->depth--;
+			return n;
+		case '[': rp->p++; return re_bracket(rp);
+		case '^': rp->p++; return re_node_new(rp, RE_BOL, -1, -1);
+		case '$': rp->p++; return re_node_new(rp, RE_EOL, -1, -1);
+		case '.':
+			rp->p++;
+			s = re_set_new(rp);
+			memset(rp->sets[s].bits, 0xff, sizeof(rp->sets[s].bits));
+			rp->sets[s].bits[0] &= ~1U;
+			return re_set_node(rp, s);
+		case '\\':
+			/* only escaped specials: no GNU \w, \<, \1 and the like */
+			if(!rp->p[1] || !strchr("^.[]$()|*+?{}\\", rp->p[1])) {
+				rp->error = 1;
+				return -1;
+			}
+			rp->p++;
+			break;
+		case ')':
+		case '*':
+		case '+':
+		case '?':
+		case '{': rp->error = 1; return -1;
+	}
+
+	c = (u_char) *rp->p++;
+	s = re_set_new(rp);
+	RE_SET_ADD(&rp->sets[s], c);
+	return re_set_node(rp, s);
+}
+
+static int re_number(struct re_parse *rp) {
+	int n = 0;
+
+	if(!isdigit((int) *rp->p)) {
+		return -1;
+	}
+	while(isdigit((int) *rp->p)) {
+		n = n * 10 + (*rp->p++ - '0');
+		if(n > RE_DUP_LIMIT) {
+			return -1;
+		}
+	}
+	return n;
+}
+
+static int re_has_anchor(struct re_parse *rp, int n) {
+	struct re_node *node = &rp->node[n];
+
+	switch(node->type) {
+		case RE_BOL:
+		case RE_EOL: return 1;
+		case RE_CAT:
+		case RE_ALT: return re_has_anchor(rp, node->l) || re_has_anchor(rp, node->r);
+		case RE_STAR:
+		case RE_PLUS:
+		case RE_QUEST:
+		case RE_REPEAT: return re_has_anchor(rp, node->l);
+		default: return 0;
+	}
+}
+
+static int re_postfix(struct re_parse *rp) {
+	int n, min, max;
+
+	n = re_atom(rp);
+	/* regcomp() will not repeat an anchor, and glibc's regexec() is
+	 * not to be trusted with one in a repeated group: leave it those */
+	if(!rp->error && *rp->p && strchr("*+?{", *rp->p) && re_has_anchor(rp, n)) {
+		rp->error = 1;
+		return -1;
+	}
+	while(!rp->error) {
+		switch(*rp->p) {
+			case '*': n = re_node_new(rp, RE_STAR, n, -1); break;
+			case '+': n = re_node_new(rp, RE_PLUS, n, -1); break;
+			case '?': n = re_node_new(rp, RE_QUEST, n, -1); break;
+			case '{':
+				rp->p++;
+				min = max = re_number(rp);
+				if(*rp->p == ',') {
+					rp->p++;
+					max = (*rp->p == '}') ? -1 : re_number(rp);
+					if(max == -1 && *rp->p != '}') {
+						min = -1;
+					}
+				}
+				if(min < 0 || *rp->p != '}' || (max >= 0 && max < min)) {
+					rp->error = 1;
+					return -1;
+				}
+				n = re_node_new(rp, RE_REPEAT, n, -1);
+				rp->node[n].min = min;
+				rp->node[n].max = max;
+				break;
+			default: return n;
+		}
+		rp->p++;
+	}
+	return -1;
+}
+
+static int re_cat(struct re_parse *rp) {
+	int n = -1, r;
+
+	while(!rp->error && *rp->p && *rp->p != '|' && *rp->p != ')') {
+		r = re_postfix(rp);
+		n = (n < 0) ? r : re_node_new(rp, RE_CAT, n, r);
+	}
+	return (n < 0) ? re_node_new(rp, RE_EMPTY, -1, -1) : n;
+}
+
+static int re_alt(struct re_parse *rp) {
+	int n;
+
+	n = re_cat(rp);
+	while(!rp->error && *rp->p == '|') {
+		rp->p++;
+		n = re_node_new(rp, RE_ALT, n, re_cat(rp));
+	}
+	return n;
+}
+
+static int nfa_new(struct regex_dfa *re, int *size, enum nfa_type type, int out, int out1) {
+	if(re->nnfa == *size) {
+		*size *= 2;
+		re->nfa = XREALLOC(MTYPE_REGEX_DFA, re->nfa, *size * sizeof(struct nfa_state));
+	}
+	re->nfa[re->nnfa].type = type;
+	re->nfa[re->nnfa].set = -1;
+	re->nfa[re->nnfa].out = out;
+	re->nfa[re->nnfa].out1 = out1;
+	return re->nnfa++;
+}
+
+/* The NFA for node, leading on to state next; -1 if too big */
+static int nfa_compile(struct regex_dfa *re, int *size, struct re_node *nodes, int n, int next) {
+	struct re_node *node = &nodes[n];
+	int s, start, i;
+
+	if(next < 0 || re->nnfa > REGEX_DFA_NFA_MAX) {
+		return -1;
+	}
+
+	switch(node->type) {
+		case RE_SET:
+			s = nfa_new(re, size, NFA_SET, next, -1);
+			re->nfa[s].set = node->set;
+			return s;
+		case RE_EMPTY: return next;
+		case RE_CAT: return nfa_compile(re, size, nodes, node->l, nfa_compile(re, size, nodes, node->r, next));
+		case RE_ALT:
+			start = nfa_compile(re, size, nodes, node->l, next);
+			return nfa_new(re, size, NFA_SPLIT, start, nfa_compile(re, size, nodes, node->r, next));
+		case RE_QUEST: return nfa_new(re, size, NFA_SPLIT, nfa_compile(re, size, nodes, node->l, next), next);
+		case RE_STAR:
+			s = nfa_new(re, size, NFA_SPLIT, -1, next);
+			re->nfa[s].out = nfa_compile(re, size, nodes, node->l, s);
+			return s;
+		case RE_PLUS:
+			s = nfa_new(re, size, NFA_SPLIT, -1, next);
+			start = nfa_compile(re, size, nodes, node->l, s);
+			re->nfa[s].out = start;
+			return start;
+		case RE_REPEAT:
+			/* x{2,4} is xx(x(x)?)? and x{2,} is xxx* */
+			s = next;
+			if(node->max < 0) {
+				s = nfa_new(re, size, NFA_SPLIT, -1, next);
+				re->nfa[s].out = nfa_compile(re, size, nodes, node->l, s);
+			} else {
+				for(i = node->min; i < node->max && s >= 0; i++) {
+					s = nfa_new(re, size, NFA_SPLIT, nfa_compile(re, size, nodes, node->l, s), next);
+				}
+			}
+			for(i = 0; i < node->min && s >= 0; i++) {
+				s = nfa_compile(re, size, nodes, node->l, s);
+			}
+			return s;
+		case RE_BOL: return nfa_new(re, size, NFA_BOL, next, -1);
+		case RE_EOL: return nfa_new(re, size, NFA_EOL, next, -1);
+	}
+	return -1;
+}
+
+/* Split the bytes into the classes no set tells apart */
+static void regex_dfa_classes(struct regex_dfa *re) {
+	int id[512];
+	u_char class[256];
+	int b, k, s, n;
+
+	memset(re->class, 0, sizeof(re->class));
+	re->nclass = 1;
+	for(s = 0; s < re->nsets; s++) {
+		for(k = 0; k < re->nclass * 2; k++) {
+			id[k] = -1;
+		}
+		n = 0;
+		for(b = 0; b < 256; b++) {
+			k = re->class[b] * 2 + (RE_SET_TEST(&re->sets[s], b) ? 1 : 0);
+			if(id[k] < 0) {
+				id[k] = n++;
+			}
+			class[b] = id[k];
+		}
+		memcpy(re->class, class, sizeof(class));
+		re->nclass = n;
+	}
+	for(b = 255; b >= 0; b--) {
+		re->rep[re->class[b]] = b;
+	}
+}
+
+/* Add the NFA states s leads to without taking a byte to re->work; bol
+ * and eol say whether BOL and EOL states may be passed */
+static void nfa_closure(struct regex_dfa *re, int s, int *n, int bol, int eol) {
+	int sp = 0;
+
+	re->stack[sp++] = s;
+	while(sp) {
+		struct nfa_state *state;
+
+		s = re->stack[--sp];
+		if(re->mark[s] == (int) re->gen) {
+			continue;
+		}
+		re->mark[s] = re->gen;
+		state = &re->nfa[s];
+
+		switch(state->type) {
+			case NFA_SPLIT:
+				re->stack[sp++] = state->out1;
+				re->stack[sp++] = state->out;
+				break;
+			case NFA_BOL:
+				if(bol) {
+					re->stack[sp++] = state->out;
+				}
+				break;
+			case NFA_EOL:
+				if(eol) {
+					re->stack[sp++] = state->out;
+				} else {
+					re->work[(*n)++] = s;
+				}
+				break;
+			default: re->work[(*n)++] = s; break;
+		}
+	}
+}
+
+static int int_cmp(const void *a, const void *b) {
+	return *(const int *) a - *(const int *) b;
+}
+
+static unsigned int dfa_state_key(void *p) {
+	struct dfa_state *d = p;
+
+	return jhash(d->set, d->n * sizeof(int), d->n);
+}
+
+static int dfa_state_cmp(const void *p1, const void *p2) {
+	const struct dfa_state *d1 = p1;
+	const struct dfa_state *d2 = p2;
+
+	return d1->n == d2->n && memcmp(d1->set, d2->set, d1->n * sizeof(int)) == 0;
+}
+
+static void dfa_state_free(void *p) {
+	XFREE(MTYPE_REGEX_DFA_STATE, p);
+}
+
+/* The DFA state for the n NFA states in re->work, made if need be */
+static struct dfa_state *dfa_state_get(struct regex_dfa *re, int n) {
+	struct dfa_state tmp, *d;
+	int i;
+
+	qsort(re->work, n, sizeof(int), int_cmp);
+	tmp.set = re->work;
+	tmp.n = n;
+	if((d = hash_lookup(re->states, &tmp))) {
+		return d;
+	}
+
+	d = XCALLOC(MTYPE_REGEX_DFA_STATE, sizeof(struct dfa_state) + re->nclass * sizeof(struct dfa_state *) + n * sizeof(int));
+	d->next = (struct dfa_state **) (d + 1);
+	d->set = (int *) (d->next + re->nclass);
+	d->n = n;
+	memcpy(d->set, re->work, n * sizeof(int));
+	for(i = 0; i < n; i++) {
+		if(re->nfa[d->set[i]].type == NFA_MATCH) {
+			d->match = 1;
+		}
+	}
+	hash_get(re->states, d, hash_alloc_intern);
+	re->stats.states++;
+	return d;
+}
+
+static void dfa_init(struct regex_dfa *re) {
+	int n = 0;
+
+	re->gen++;
+	nfa_closure(re, re->start, &n, 1, 0);
+	re->init = dfa_state_get(re, n);
+}
+
+/* The state d goes to on a byte of class c.  If the DFA has to start
+ * over, d goes with it */
+static struct dfa_state *dfa_step(struct regex_dfa *re, struct dfa_state *d, int c) {
+	struct dfa_state *next;
+	int i, n = 0;
+
+	re->gen++;
+	for(i = 0; i < d->n; i++) {
+		struct nfa_state *state = &re->nfa[d->set[i]];
+
+		if(state->type == NFA_SET && RE_SET_TEST(&re->sets[state->set], re->rep[c])) {
+			nfa_closure(re, state->out, &n, 0, 0);
+		}
+	}
+	/* a match may start at any byte */
+	for(i = 0; i < re->nrestart; i++) {
+		if(re->mark[re->restart[i]] != (int) re->gen) {
+			re->mark[re->restart[i]] = re->gen;
+			re->work[n++] = re->restart[i];
+		}
+	}
+
+	if(re->states->count >= REGEX_DFA_STATES_MAX) {
+		hash_clean(re->states, dfa_state_free);
+		re->stats.resets++;
+		/* the set made above first, as dfa_init() reuses re->work */
+		next = dfa_state_get(re, n);
+		dfa_init(re);
+		return next;
+	}
+	next = dfa_state_get(re, n);
+	d->next[c] = next;
+	return next;
+}
+
+/* Whether the pattern matches with the string ending in state d */
+static int dfa_match_at_end(struct regex_dfa *re, struct dfa_state *d, int bol) {
+	int i, n = 0, match = 0;
+
+	if(d->eol && !bol) {
+		return d->eol - 1;
+	}
+	re->gen++;
+	for(i = 0; i < d->n; i++) {
+		if(re->nfa[d->set[i]].type == NFA_EOL) {
+			nfa_closure(re, re->nfa[d->set[i]].out, &n, bol, 1);
+		}
+	}
+	for(i = 0; i < n; i++) {
+		if(re->nfa[re->work[i]].type == NFA_MATCH) {
+			match = 1;
+		}
+	}
+	if(!bol) {
+		d->eol = 1 + match;
+	}
+	return match;
+}
+
+int regex_dfa_exec(struct regex_dfa *re, const char *str) {
+	struct dfa_state *d = re->init, *next;
+	const u_char *p;
+
+	re->stats.execs++;
+	for(p = (const u_char *) str; *p && !d->match; p++) {
+		/* nothing left to match, and nowhere to start again */
+		if(!d->n && !re->nrestart) {
+			break;
+		}
+		next = d->next[re->class[*p]];
+		if(!next) {
+			next = dfa_step(re, d, re->class[*p]);
+		}
+		d = next;
+	}
+	re->stats.bytes += p - (const u_char *) str;
+
+	if(d->match) {
+		return 1;
+	}
+	if(*p) {
+		return 0;
+	}
+	return dfa_match_at_end(re, d, p == (const u_char *) str);
+}
+
+struct regex_dfa *regex_dfa_compile(const char *pattern) {
+	struct regex_dfa *re;
+	struct re_parse rp;
+	int root, size = 64, n;
+
+	memset(&rp, 0, sizeof(struct re_parse));
+	rp.p = pattern;
+	root = re_alt(&rp);
+	if(rp.error || *rp.p) {
+		XFREE(MTYPE_TMP, rp.node);
+		if(rp.sets) {
+			XFREE(MTYPE_REGEX_DFA, rp.sets);
+		}
+		return NULL;
+	}
+
+	re = XCALLOC(MTYPE_REGEX_DFA, sizeof(struct regex_dfa));
+	re->sets = rp.sets;
+	re->nsets = rp.nsets;
+	re->nfa = XMALLOC(MTYPE_REGEX_DFA, size * sizeof(struct nfa_state));
+	re->start = nfa_compile(re, &size, rp.node, root, nfa_new(re, &size, NFA_MATCH, -1, -1));
+	XFREE(MTYPE_TMP, rp.node);
+	if(re->start < 0 || re->nnfa > REGEX_DFA_NFA_MAX) {
+		re->states = NULL;
+		regex_dfa_free(re);
+		return NULL;
+	}
+
+	regex_dfa_classes(re);
+	re->mark = XCALLOC(MTYPE_REGEX_DFA, re->nnfa * sizeof(int));
+	re->stack = XMALLOC(MTYPE_REGEX_DFA, 2 * re->nnfa * sizeof(int));
+	re->work = XMALLOC(MTYPE_REGEX_DFA, re->nnfa * sizeof(int));
+
+	n = 0;
+	re->gen++;
+	nfa_closure(re, re->start, &n, 0, 0);
+	re->restart = XMALLOC(MTYPE_REGEX_DFA, (n ? n : 1) * sizeof(int));
+	memcpy(re->restart, re->work, n * sizeof(int));
+	re->nrestart = n;
+
+	re->states = hash_create(dfa_state_key, dfa_state_cmp);
+	dfa_init(re);
+	return re;
+}
+
+const struct regex_dfa_stats *regex_dfa_stats(struct regex_dfa *re) {
+	return &re->stats;
+}
+
+void regex_dfa_free(struct regex_dfa *re) {
+	if(re->states) {
+		hash_clean(re->states, dfa_state_free);
+		hash_free(re->states);
+	}
+	if(re->sets) {
+		XFREE(MTYPE_REGEX_DFA, re->sets);
+	}
+	XFREE(MTYPE_REGEX_DFA, re->nfa);
+	if(re->mark) {
+		XFREE(MTYPE_REGEX_DFA, re->mark);
+		XFREE(MTYPE_REGEX_DFA, re->stack);
+		XFREE(MTYPE_REGEX_DFA, re->work);
+		XFREE(MTYPE_REGEX_DFA, re->restart);
+	}
+	XFREE(MTYPE_REGEX_DFA, re);
+}
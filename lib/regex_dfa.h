@@ -0,0 +1,55 @@
+/*
+ * Linear-time matching of POSIX extended regular expressions.
+ *
+ * This file is part of Quagga.
+ *
+ * Quagga is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2, or (at your option) any
+ * later version.
+ *
+ * Quagga is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Quagga; see the file COPYING.  If not, write to the Free
+ * Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ * 02111-1307, USA.
+ */
+
+#ifndef _QUAGGA_REGEX_DFA_H
+#define _QUAGGA_REGEX_DFA_H
+
+/* What regcomp(REG_EXTENDED | REG_NOSUB) and regexec() do, whether a
+ * pattern matches anywhere in a string, without backtracking: the
+ * pattern is compiled to an NFA, and the DFA states are made from it as
+ * the strings being matched need them, so that each byte of a string
+ * costs one table lookup once the DFA is warm, whatever the pattern.
+ *
+ * Only byte-wise POSIX ERE is understood: no back-references, GNU
+ * escapes like \w or \<, or collating elements.  regex_dfa_compile()
+ * returns NULL for those, and for patterns that make too big an NFA,
+ * for the caller to fall back to regexec().  Once it holds too many
+ * DFA states, the DFA starts over, which shows as a reset.
+ */
+#define REGEX_DFA_NFA_MAX 4096
+#define REGEX_DFA_STATES_MAX 256
+
+struct regex_dfa;
+
+struct regex_dfa_stats {
+	unsigned long execs;  /* strings matched against */
+	unsigned long bytes;  /* and their bytes looked at */
+	unsigned long states; /* DFA states made */
+	unsigned long resets; /* times the DFA was thrown away, full */
+};
+
+extern struct regex_dfa *regex_dfa_compile(const char *pattern);
+/* 1 if the pattern matches somewhere in str */
+extern int regex_dfa_exec(struct regex_dfa *, const char *str);
+extern const struct regex_dfa_stats *regex_dfa_stats(struct regex_dfa *);
+extern void regex_dfa_free(struct regex_dfa *);
+
+#endif /* _QUAGGA_REGEX_DFA_H */
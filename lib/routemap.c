@@ -701,6 +701,47 @@ static route_map_result_t route_map_apply_match(struct route_map_rule_list *matc
 	return ret;
 }
 
+static int route_map_rule_walk_depth(struct route_map *map, int (*func)(const char *, const char *, int, void *), void *arg, int depth) {
+	struct route_map_index *index;
+	struct route_map_rule *rule;
+	int ret;
+
+	if(depth > RMAP_RECURSION_LIMIT) {
+		return -1;
+	}
+
+	for(index = map->head; index; index = index->next) {
+		for(rule = index->match_list.head; rule; rule = rule->next) {
+			if((ret = func(rule->cmd->str, rule->rule_str, 0, arg)) != 0) {
+				return ret;
+			}
+		}
+		for(rule = index->set_list.head; rule; rule = rule->next) {
+			if((ret = func(rule->cmd->str, rule->rule_str, 1, arg)) != 0) {
+				return ret;
+			}
+		}
+		if(index->nextrm) {
+			struct route_map *nextrm = route_map_lookup_by_name(index->nextrm);
+
+			if((ret = func("call", index->nextrm, 0, arg)) != 0) {
+				return ret;
+			}
+			if(nextrm && (ret = route_map_rule_walk_depth(nextrm, func, arg, depth + 1)) != 0) {
+				return ret;
+			}
+		}
+	}
+	return 0;
+}
+
+int route_map_rule_walk(struct route_map *map, int (*func)(const char *cmd, const char *rule_str, int set, void *arg), void *arg) {
+	if(map == NULL) {
+		return 0;
+	}
+	return route_map_rule_walk_depth(map, func, arg, 0);
+}
+
 /* Apply route map to the object. */
 route_map_result_t route_map_apply(struct route_map *map, struct prefix *prefix, route_map_object_t type, void *object) {
 	static int recursion = 0;
@@ -928,6 +969,13 @@ DEFUN(no_route_map, no_route_map_cmd, "no route-map WORD (deny|permit) <1-65535>
 	return CMD_SUCCESS;
 }
 
+/* Exit policy or call of an index changed */
+static void route_map_index_changed(struct route_map_index *index) {
+	if(route_map_master.event_hook) {
+		(*route_map_master.event_hook)(RMAP_EVENT_INDEX_CHANGED, index->map->name);
+	}
+}
+
 DEFUN(rmap_onmatch_next, rmap_onmatch_next_cmd, "on-match next",
       "Exit policy on matches\n"
       "Next clause\n") {
@@ -937,6 +985,7 @@ DEFUN(rmap_onmatch_next, rmap_onmatch_next_cmd, "on-match next",
 
 	if(index) {
 		index->exitpolicy = RMAP_NEXT;
+		route_map_index_changed(index);
 	}
 
 	return CMD_SUCCESS;
@@ -951,6 +1000,7 @@ DEFUN(no_rmap_onmatch_next, no_rmap_onmatch_next_cmd, "no on-match next",
 
 	if(index) {
 		index->exitpolicy = RMAP_EXIT;
+		route_map_index_changed(index);
 	}
 
 	return CMD_SUCCESS;
@@ -977,6 +1027,7 @@ DEFUN(rmap_onmatch_goto, rmap_onmatch_goto_cmd, "on-match goto <1-65535>",
 		} else {
 			index->exitpolicy = RMAP_GOTO;
 			index->nextpref = d;
+			route_map_index_changed(index);
 		}
 	}
 	return CMD_SUCCESS;
@@ -991,6 +1042,7 @@ DEFUN(no_rmap_onmatch_goto, no_rmap_onmatch_goto_cmd, "no on-match goto",
 
 	if(index) {
 		index->exitpolicy = RMAP_EXIT;
+		route_map_index_changed(index);
 	}
 
 	return CMD_SUCCESS;
@@ -1035,6 +1087,7 @@ DEFUN(rmap_call, rmap_call_cmd, "call WORD",
 			XFREE(MTYPE_ROUTE_MAP_NAME, index->nextrm);
 		}
 		index->nextrm = XSTRDUP(MTYPE_ROUTE_MAP_NAME, argv[0]);
+		route_map_index_changed(index);
 	}
 	return CMD_SUCCESS;
 }
@@ -1047,6 +1100,7 @@ DEFUN(no_rmap_call, no_rmap_call_cmd, "no call", NO_STR "Jump to another Route-M
 	if(index->nextrm) {
 		XFREE(MTYPE_ROUTE_MAP_NAME, index->nextrm);
 		index->nextrm = NULL;
+		route_map_index_changed(index);
 	}
 
 	return CMD_SUCCESS;
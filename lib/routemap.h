@@ -65,7 +65,8 @@ typedef enum {
 	RMAP_EVENT_MATCH_DELETED,
 	RMAP_EVENT_MATCH_REPLACED,
 	RMAP_EVENT_INDEX_ADDED,
-	RMAP_EVENT_INDEX_DELETED
+	RMAP_EVENT_INDEX_DELETED,
+	RMAP_EVENT_INDEX_CHANGED /* on-match or call */
 } route_map_event_t;
 
 /* Depth limit in RMAP recursion using RMAP_CALL. */
@@ -173,6 +174,12 @@ extern struct route_map *route_map_lookup_by_name(const char *name);
 /* Apply route map to the object. */
 extern route_map_result_t route_map_apply(struct route_map *map, struct prefix *, route_map_object_t object_type, void *object);
 
+/* Call func on each match and set rule of the map, and any map it calls,
+   could apply, until func returns non-zero.  A call to another map is
+   passed as a "call" match with the map's name.  Returns that value, or
+   -1 if the calls nest too deep to tell. */
+extern int route_map_rule_walk(struct route_map *map, int (*func)(const char *cmd, const char *rule_str, int set, void *arg), void *arg);
+
 extern void route_map_add_hook(void (*func)(const char *));
 extern void route_map_delete_hook(void (*func)(const char *));
 extern void route_map_event_hook(void (*func)(route_map_event_t, const char *));
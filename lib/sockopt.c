@@ -61,6 +61,17 @@ int getsockopt_so_sendbuf(const int sock) {
 	return optval;
 }
 
+int getsockopt_so_recvbuf(const int sock) {
+	u_int32_t optval;
+	socklen_t optlen = sizeof(optval);
+	int ret = getsockopt(sock, SOL_SOCKET, SO_RCVBUF, (char *) &optval, &optlen);
+	if(ret < 0) {
+		zlog_err("fd %d: can't getsockopt SO_RCVBUF: %d (%s)", sock, errno, safe_strerror(errno));
+		return ret;
+	}
+	return optval;
+}
+
 static void *getsockopt_cmsg_data(struct msghdr *msgh, int level, int type) {
 	struct cmsghdr *cmsg;
 	void *ptr = NULL;
@@ -503,6 +514,22 @@ int sockopt_tcp_rtt(int sock) {
 #endif
 }
 
+#if defined(GNU_LINUX) && !defined(TCP_NOTSENT_LOWAT)
+	#define TCP_NOTSENT_LOWAT 25
+#endif
+
+/* Have the socket take written data only while less than bytes of it
+ * are yet to be sent, and poll writable again once below that, so that
+ * what is written stays fresh rather than queued up in the kernel. */
+int sockopt_tcp_notsent_lowat(int sock, int bytes) {
+#ifdef TCP_NOTSENT_LOWAT
+	return setsockopt(sock, IPPROTO_TCP, TCP_NOTSENT_LOWAT, &bytes, sizeof(bytes));
+#else
+	errno = ENOPROTOOPT;
+	return -1;
+#endif
+}
+
 int sockopt_tcp_signature(int sock, union sockunion *su, const char *password) {
 #if defined(HAVE_TCP_MD5_LINUX24) && defined(GNU_LINUX)
 	/* Support for the old Linux 2.4 TCP-MD5 patch, taken from Hasso Tepper's
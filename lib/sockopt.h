@@ -28,6 +28,7 @@
 extern int setsockopt_so_recvbuf(int sock, int size);
 extern int setsockopt_so_sendbuf(const int sock, int size);
 extern int getsockopt_so_sendbuf(const int sock);
+extern int getsockopt_so_recvbuf(const int sock);
 
 #ifdef HAVE_IPV6
 extern int setsockopt_ipv6_pktinfo(int, int);
@@ -99,5 +100,6 @@ extern void sockopt_iphdrincl_swab_htosys(struct ip *iph);
 extern void sockopt_iphdrincl_swab_systoh(struct ip *iph);
 
 extern int sockopt_tcp_rtt(int);
+extern int sockopt_tcp_notsent_lowat(int sock, int bytes);
 extern int sockopt_tcp_signature(int sock, union sockunion *su, const char *password);
 #endif /*_ZEBRA_SOCKOPT_H */
@@ -0,0 +1,279 @@
+/*
+ * Shortest-path calculation helpers: vertex pools, candidate heaps and
+ * compact arrays.
+ *
+ * This file is part of Quagga.
+ *
+ * Quagga is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2, or (at your option) any
+ * later version.
+ *
+ * Quagga is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Quagga; see the file COPYING.  If not, write to the Free
+ * Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ * 02111-1307, USA.
+ */
+
+#include <zebra.h>
+
+#include "memory.h"
+#include "spf.h"
+
+/* Pools. */
+
+#define SPF_POOL_CHUNK 64 /* objects per chunk */
+
+struct spf_pool_chunk {
+	struct spf_pool_chunk *next;
+	/* the objects follow, aligned as a union of the widest types */
+};
+
+struct spf_pool {
+	size_t size;
+	int mtype;
+	struct spf_pool_chunk *chunks;
+	void *free;	   /* objects put back, linked through their first word */
+	char *fresh;	   /* never handed out, in the last chunk */
+	unsigned int left; /* of them */
+	unsigned long count;
+};
+
+union spf_pool_align {
+	void *p;
+	u_int64_t u;
+	double d;
+};
+
+#define SPF_POOL_ROUND(S) (((S) + sizeof(union spf_pool_align) - 1) & ~(sizeof(union spf_pool_align) - 1))
+
+struct spf_pool *spf_pool_new(size_t size, int mtype) {
+	struct spf_pool *pool;
+
+	pool = XCALLOC(MTYPE_SPF_POOL, sizeof(struct spf_pool));
+	pool->size = SPF_POOL_ROUND(size < sizeof(void *) ? sizeof(void *) : size);
+	pool->mtype = mtype;
+	return pool;
+}
+
+void spf_pool_free(struct spf_pool *pool) {
+	struct spf_pool_chunk *chunk, *next;
+
+	if(pool == NULL) {
+		return;
+	}
+	for(chunk = pool->chunks; chunk; chunk = next) {
+		next = chunk->next;
+		XFREE(pool->mtype, chunk);
+	}
+	XFREE(MTYPE_SPF_POOL, pool);
+}
+
+void *spf_pool_get(struct spf_pool *pool) {
+	struct spf_pool_chunk *chunk;
+	void *obj;
+
+	if(pool->free) {
+		obj = pool->free;
+		pool->free = *(void **) obj;
+	} else {
+		if(pool->left == 0) {
+			chunk = XMALLOC(pool->mtype, SPF_POOL_ROUND(sizeof(struct spf_pool_chunk)) + SPF_POOL_CHUNK * pool->size);
+			chunk->next = pool->chunks;
+			pool->chunks = chunk;
+			pool->fresh = (char *) chunk + SPF_POOL_ROUND(sizeof(struct spf_pool_chunk));
+			pool->left = SPF_POOL_CHUNK;
+		}
+		obj = pool->fresh;
+		pool->fresh += pool->size;
+		pool->left--;
+	}
+
+	pool->count++;
+	memset(obj, 0, pool->size);
+	return obj;
+}
+
+void spf_pool_put(struct spf_pool *pool, void *obj) {
+	*(void **) obj = pool->free;
+	pool->free = obj;
+	pool->count--;
+}
+
+unsigned long spf_pool_count(struct spf_pool *pool) {
+	return pool->count;
+}
+
+/* Heaps.  Four children to a node halve the depth of a binary heap, and
+ * the four share a cache line or two. */
+
+#define SPF_HEAP_D 4
+#define SPF_HEAP_PARENT(i) (((i) - 1) / SPF_HEAP_D)
+#define SPF_HEAP_CHILD(i) ((i) * SPF_HEAP_D + 1)
+
+struct spf_heap *spf_heap_new(void) {
+	return XCALLOC(MTYPE_SPF_HEAP, sizeof(struct spf_heap));
+}
+
+void spf_heap_free(struct spf_heap *heap) {
+	if(heap == NULL) {
+		return;
+	}
+	if(heap->entry) {
+		XFREE(MTYPE_SPF_HEAP, heap->entry);
+	}
+	XFREE(MTYPE_SPF_HEAP, heap);
+}
+
+static void spf_heap_set(struct spf_heap *heap, unsigned int i, struct spf_heap_entry *e) {
+	heap->entry[i] = *e;
+	*e->pos = i;
+}
+
+static void spf_heap_sift_up(struct spf_heap *heap, unsigned int i) {
+	struct spf_heap_entry e = heap->entry[i];
+
+	while(i > 0 && e.key < heap->entry[SPF_HEAP_PARENT(i)].key) {
+		spf_heap_set(heap, i, &heap->entry[SPF_HEAP_PARENT(i)]);
+		i = SPF_HEAP_PARENT(i);
+	}
+	spf_heap_set(heap, i, &e);
+}
+
+static void spf_heap_sift_down(struct spf_heap *heap, unsigned int i) {
+	struct spf_heap_entry e = heap->entry[i];
+	unsigned int c, first, last, min;
+
+	for(;;) {
+		first = SPF_HEAP_CHILD(i);
+		if(first >= heap->count) {
+			break;
+		}
+		last = first + SPF_HEAP_D < heap->count ? first + SPF_HEAP_D : heap->count;
+		for(min = first, c = first + 1; c < last; c++) {
+			if(heap->entry[c].key < heap->entry[min].key) {
+				min = c;
+			}
+		}
+		if(e.key <= heap->entry[min].key) {
+			break;
+		}
+		spf_heap_set(heap, i, &heap->entry[min]);
+		i = min;
+	}
+	spf_heap_set(heap, i, &e);
+}
+
+void spf_heap_push(struct spf_heap *heap, void *item, int *pos, u_int64_t key) {
+	if(heap->count == heap->size) {
+		heap->size = heap->size ? heap->size * 2 : 64;
+		heap->entry = XREALLOC(MTYPE_SPF_HEAP, heap->entry, heap->size * sizeof(struct spf_heap_entry));
+	}
+	heap->entry[heap->count].key = key;
+	heap->entry[heap->count].item = item;
+	heap->entry[heap->count].pos = pos;
+	spf_heap_sift_up(heap, heap->count++);
+}
+
+void *spf_heap_pop(struct spf_heap *heap) {
+	void *item;
+
+	if(heap->count == 0) {
+		return NULL;
+	}
+	item = heap->entry[0].item;
+	if(--heap->count > 0) {
+		heap->entry[0] = heap->entry[heap->count];
+		spf_heap_sift_down(heap, 0);
+	}
+	return item;
+}
+
+void spf_heap_decrease(struct spf_heap *heap, int pos, u_int64_t key) {
+	assert(pos >= 0 && (unsigned int) pos < heap->count && key <= heap->entry[pos].key);
+
+	heap->entry[pos].key = key;
+	spf_heap_sift_up(heap, pos);
+}
+
+void spf_heap_remove(struct spf_heap *heap, int pos) {
+	u_int64_t key;
+
+	assert(pos >= 0 && (unsigned int) pos < heap->count);
+
+	if((unsigned int) pos == --heap->count) {
+		return;
+	}
+	key = heap->entry[pos].key;
+	heap->entry[pos] = heap->entry[heap->count];
+	if(heap->entry[pos].key < key) {
+		spf_heap_sift_up(heap, pos);
+	} else {
+		spf_heap_sift_down(heap, pos);
+	}
+}
+
+/* Arrays. */
+
+static void spf_array_grow(struct spf_array *array) {
+	if(array->count < array->size) {
+		return;
+	}
+	array->size = array->size ? array->size * 2 : 4;
+	array->item = XREALLOC(MTYPE_SPF_ARRAY, array->item, array->size * sizeof(void *));
+}
+
+void spf_array_add(struct spf_array *array, void *item) {
+	spf_array_grow(array);
+	array->item[array->count++] = item;
+}
+
+void spf_array_add_sort(struct spf_array *array, void *item, int (*cmp)(void *, void *)) {
+	unsigned int i;
+
+	spf_array_grow(array);
+	for(i = array->count; i > 0 && (*cmp)(array->item[i - 1], item) > 0; i--) {
+		array->item[i] = array->item[i - 1];
+	}
+	array->item[i] = item;
+	array->count++;
+}
+
+int spf_array_lookup(struct spf_array *array, void *item) {
+	unsigned int i;
+
+	for(i = 0; i < array->count; i++) {
+		if(array->item[i] == item) {
+			return i;
+		}
+	}
+	return -1;
+}
+
+void spf_array_delete_index(struct spf_array *array, unsigned int i) {
+	assert(i < array->count);
+
+	array->count--;
+	memmove(&array->item[i], &array->item[i + 1], (array->count - i) * sizeof(void *));
+}
+
+void spf_array_delete(struct spf_array *array, void *item) {
+	int i;
+
+	if((i = spf_array_lookup(array, item)) >= 0) {
+		spf_array_delete_index(array, i);
+	}
+}
+
+void spf_array_free(struct spf_array *array) {
+	if(array->item) {
+		XFREE(MTYPE_SPF_ARRAY, array->item);
+	}
+	array->item = NULL;
+	array->count = array->size = 0;
+}
@@ -0,0 +1,99 @@
+/*
+ * Shortest-path calculation helpers: vertex pools, candidate heaps and
+ * compact arrays.
+ *
+ * This file is part of Quagga.
+ *
+ * Quagga is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2, or (at your option) any
+ * later version.
+ *
+ * Quagga is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Quagga; see the file COPYING.  If not, write to the Free
+ * Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ * 02111-1307, USA.
+ */
+
+#ifndef _QUAGGA_SPF_H
+#define _QUAGGA_SPF_H
+
+/* An spf_pool hands out zeroed objects of one size from chunks of many,
+ * so that the vertices of a calculation sit together in memory and cost
+ * an allocation per chunk rather than one each.  Objects put back are
+ * reused first; the chunks go only with the pool.
+ */
+struct spf_pool;
+
+/* a pool of objects of 'size' bytes, with its chunks counted as 'mtype' */
+extern struct spf_pool *spf_pool_new(size_t size, int mtype);
+extern void spf_pool_free(struct spf_pool *);
+extern void *spf_pool_get(struct spf_pool *);
+extern void spf_pool_put(struct spf_pool *, void *);
+/* # of objects handed out and not put back */
+extern unsigned long spf_pool_count(struct spf_pool *);
+
+/* An spf_heap is the candidate list: a 4-ary min-heap of items by a
+ * 64 bit key, the cost and whatever breaks ties, kept next to the item
+ * so that sifting doesn't chase pointers.  Each item has an int the heap
+ * keeps its position in, for spf_heap_decrease() and spf_heap_remove();
+ * the position isn't touched once the item leaves the heap, for the
+ * caller to mark it as it wants.
+ */
+struct spf_heap_entry {
+	u_int64_t key;
+	void *item;
+	int *pos;
+};
+
+struct spf_heap {
+	struct spf_heap_entry *entry;
+	unsigned int count;
+	unsigned int size;
+};
+
+extern struct spf_heap *spf_heap_new(void);
+extern void spf_heap_free(struct spf_heap *);
+extern void spf_heap_push(struct spf_heap *, void *item, int *pos, u_int64_t key);
+/* the item with the lowest key, NULL if none left */
+extern void *spf_heap_pop(struct spf_heap *);
+/* the item at position 'pos' now has the lower key given */
+extern void spf_heap_decrease(struct spf_heap *, int pos, u_int64_t key);
+extern void spf_heap_remove(struct spf_heap *, int pos);
+
+#define spf_heap_count(H) ((H)->count)
+/* the items in no particular order, for lookups */
+#define spf_heap_item(H, I) ((H)->entry[(I)].item)
+
+/* An spf_array holds the parents, children or nexthops of a vertex: one
+ * allocation for all of them instead of a list node each, in the order
+ * they were added.  It is embedded in the vertex and starts out zeroed.
+ */
+struct spf_array {
+	void **item;
+	unsigned int count;
+	unsigned int size;
+};
+
+extern void spf_array_add(struct spf_array *, void *);
+/* keeping the array sorted by cmp, after those equal to the item */
+extern void spf_array_add_sort(struct spf_array *, void *, int (*cmp)(void *, void *));
+/* index of the item, -1 if not there */
+extern int spf_array_lookup(struct spf_array *, void *);
+/* remove the item, if there, keeping the order of the others */
+extern void spf_array_delete(struct spf_array *, void *);
+extern void spf_array_delete_index(struct spf_array *, unsigned int);
+extern void spf_array_free(struct spf_array *);
+
+#define spf_array_count(A) ((A)->count)
+#define spf_array_clear(A) ((A)->count = 0)
+
+/* for each item D of array A, with index I; the array must not change */
+#define SPF_ARRAY_ELEMENTS(A, I, D) (I) = 0; (I) < (A)->count && (((D) = (A)->item[(I)]), 1); (I)++
+
+#endif /* _QUAGGA_SPF_H */
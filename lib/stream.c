@@ -99,17 +99,45 @@ struct stream *stream_new(size_t size) {
 	}
 
 	s->size = size;
+	s->refcnt = 1;
 	return s;
 }
 
-/* Free it now. */
+/* Free it now, or once the last share of its data is freed. */
 void stream_free(struct stream *s) {
+	struct stream *owner;
+
 	if(!s) {
 		return;
 	}
 
-	XFREE(MTYPE_STREAM_DATA, s->data);
-	XFREE(MTYPE_STREAM, s);
+	owner = s->owner ? s->owner : s;
+	if(s->owner) {
+		XFREE(MTYPE_STREAM, s);
+	}
+
+	if(--owner->refcnt > 0) {
+		return;
+	}
+
+	XFREE(MTYPE_STREAM_DATA, owner->data);
+	XFREE(MTYPE_STREAM, owner);
+}
+
+/* A read-only stream over the readable data of s, without copying it. */
+struct stream *stream_share(struct stream *s) {
+	struct stream *new;
+
+	STREAM_VERIFY_SANE(s);
+
+	new = XCALLOC(MTYPE_STREAM, sizeof(struct stream));
+	new->owner = s->owner ? s->owner : s;
+	new->owner->refcnt++;
+
+	new->data = s->data;
+	new->getp = s->getp;
+	new->endp = new->size = s->endp;
+	return new;
 }
 
 struct stream *stream_copy(struct stream *new, struct stream *src) {
@@ -158,6 +186,7 @@ struct stream *stream_dupcat(struct stream *s1, struct stream *s2, size_t offset
 size_t stream_resize(struct stream *s, size_t newsize) {
 	u_char *newdata;
 	STREAM_VERIFY_SANE(s);
+	assert(!s->owner && s->refcnt == 1);
 
 	newdata = XREALLOC(MTYPE_STREAM_DATA, s->data, newsize);
 
@@ -849,6 +878,7 @@ void stream_discard(struct stream *s) {
 		return;
 	}
 
+	assert(!s->owner && s->refcnt == 1);
 	s->data = memmove(s->data, s->data + s->getp, s->endp - s->getp);
 	s->endp -= s->getp;
 	s->getp = 0;
@@ -927,3 +957,55 @@ void stream_fifo_free(struct stream_fifo *fifo) {
 	stream_fifo_clean(fifo);
 	XFREE(MTYPE_STREAM_FIFO, fifo);
 }
+
+/* Write the readable data of up to 'max' streams from the head of the
+ * fifo with a single writev(), and move their getp on by what was
+ * written.  Streams stay on the fifo, the caller pops those that are
+ * no longer readable.  A message can be pushed as several streams, e.g.
+ * a small header and a shared body, and goes out without being copied
+ * together.  Returns what writev() did.
+ */
+#ifdef IOV_MAX
+	#define STREAM_FIFO_IOV ((IOV_MAX >= 64) ? 64 : IOV_MAX)
+#else
+	#define STREAM_FIFO_IOV 16
+#endif
+
+ssize_t stream_fifo_flush(struct stream_fifo *fifo, int fd, unsigned int max) {
+	struct iovec iov[STREAM_FIFO_IOV];
+	struct stream *s;
+	unsigned int iovcnt = 0;
+	ssize_t nbytes, left;
+
+	if(max > STREAM_FIFO_IOV) {
+		max = STREAM_FIFO_IOV;
+	}
+
+	for(s = fifo->head; s && iovcnt < max; s = s->next) {
+		STREAM_VERIFY_SANE(s);
+		if(!STREAM_READABLE(s)) {
+			continue;
+		}
+		iov[iovcnt].iov_base = s->data + s->getp;
+		iov[iovcnt].iov_len = STREAM_READABLE(s);
+		iovcnt++;
+	}
+
+	if(iovcnt == 0) {
+		return 0;
+	}
+
+	nbytes = writev(fd, iov, iovcnt);
+	if(nbytes <= 0) {
+		return nbytes;
+	}
+
+	for(s = fifo->head, left = nbytes; s && left > 0; s = s->next) {
+		size_t n = MIN((size_t) left, STREAM_READABLE(s));
+
+		s->getp += n;
+		left -= n;
+	}
+
+	return nbytes;
+}
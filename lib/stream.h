@@ -90,6 +90,13 @@
  *
  * Best practice is to use stream_put (<stream *>, NULL, <size>) to zero out
  * any part of a stream which isn't otherwise written to.
+ *
+ * Sharing:
+ * stream_share() returns a new stream over the same data, without copying
+ * it, so one encoded message can sit in many output FIFOs at once.  The
+ * share has its own getp, for the writer, and can't be written to.  The
+ * data is freed with the last of the streams using it.  Once shared, the
+ * original stream must not be modified either.
  */
 
 /* Stream buffer. */
@@ -104,6 +111,9 @@ struct stream {
 	size_t endp;	     /* last valid data position */
 	size_t size;	     /* size of data segment */
 	unsigned char *data; /* data pointer */
+
+	struct stream *owner; /* for a share, the stream owning data */
+	unsigned int refcnt;  /* for an owner, streams using its data */
 };
 
 /* First in first out queue structure. */
@@ -138,6 +148,7 @@ struct stream_fifo {
  */
 extern struct stream *stream_new(size_t);
 extern void stream_free(struct stream *);
+extern struct stream *stream_share(struct stream *);
 extern struct stream *stream_copy(struct stream *, struct stream *src);
 extern struct stream *stream_dup(struct stream *);
 extern size_t stream_resize(struct stream *, size_t);
@@ -227,5 +238,6 @@ extern struct stream *stream_fifo_pop(struct stream_fifo *fifo);
 extern struct stream *stream_fifo_head(struct stream_fifo *fifo);
 extern void stream_fifo_clean(struct stream_fifo *fifo);
 extern void stream_fifo_free(struct stream_fifo *fifo);
+extern ssize_t stream_fifo_flush(struct stream_fifo *fifo, int fd, unsigned int max);
 
 #endif /* _ZEBRA_STREAM_H */
@@ -31,6 +31,74 @@
 static void route_node_delete(struct route_node *);
 static void route_table_free(struct route_table *);
 
+/*
+ * Multi-bit stride index.
+ *
+ * Longest-prefix match in the binary trie costs a pointer chase per
+ * branching bit.  For tables of some size, route_node_match() instead
+ * starts from a 2^ROUTE_STRIDE_BITS slot array indexed by the leading
+ * address bits.  Each slot remembers where a walk for any address in
+ * the slot leaves the top ROUTE_STRIDE_BITS levels of the trie:
+ *
+ *   jump:  the first node with prefixlen >= ROUTE_STRIDE_BITS, the walk
+ *          continues from here as usual;
+ *   above: the last node with prefixlen < ROUTE_STRIDE_BITS on the path,
+ *          whose ancestors are checked for a match if nothing deeper is.
+ *
+ * The index only holds node pointers, never route info, so users may
+ * set and clear node->info freely.  Adding or removing a node in the
+ * top levels marks it dirty, and it's rebuilt on the next lookup.
+ */
+#define ROUTE_STRIDE_BITS 8
+#define ROUTE_STRIDE_SLOTS (1 << ROUTE_STRIDE_BITS)
+
+/* Smaller tables are walked directly. */
+#define ROUTE_STRIDE_MIN_COUNT 64
+
+struct route_stride {
+	u_char family;
+	u_char dirty;
+	struct {
+		struct route_node *jump;
+		struct route_node *above;
+	} slot[ROUTE_STRIDE_SLOTS];
+};
+
+/* Note that a node is being added or removed. */
+static void route_stride_touch(struct route_table *table, struct route_node *node) {
+	if(!table->stride || table->stride->dirty) {
+		return;
+	}
+	if(node->p.prefixlen < ROUTE_STRIDE_BITS || !node->parent || node->parent->p.prefixlen < ROUTE_STRIDE_BITS) {
+		table->stride->dirty = 1;
+	}
+}
+
+static void route_stride_build(struct route_table *table, u_char family) {
+	struct route_stride *stride = table->stride;
+	struct prefix p;
+	unsigned int s;
+
+	memset(&p, 0, sizeof(p));
+	p.family = family;
+	p.prefixlen = ROUTE_STRIDE_BITS;
+
+	for(s = 0; s < ROUTE_STRIDE_SLOTS; s++) {
+		struct route_node *node = table->top;
+		struct route_node *above = NULL;
+
+		p.u.val[0] = s;
+		while(node && node->p.prefixlen < ROUTE_STRIDE_BITS && prefix_match(&node->p, &p)) {
+			above = node;
+			node = node->link[prefix_bit(&p.u.prefix, node->p.prefixlen)];
+		}
+		stride->slot[s].jump = node;
+		stride->slot[s].above = above;
+	}
+	stride->family = family;
+	stride->dirty = 0;
+}
+
 /*
  * route_table_init_with_delegate
  */
@@ -77,6 +145,10 @@ static void route_table_free(struct route_table *rt) {
 		return;
 	}
 
+	if(rt->stride) {
+		XFREE(MTYPE_ROUTE_TABLE, rt->stride);
+	}
+
 	node = rt->top;
 
 	/* Bulk deletion of nodes remaining in this table.  This function is not
@@ -178,10 +250,31 @@ void route_unlock_node(struct route_node *node) {
 struct route_node *route_node_match(const struct route_table *table, const struct prefix *p) {
 	struct route_node *node;
 	struct route_node *matched;
+	struct route_node *above = NULL;
 
 	matched = NULL;
 	node = table->top;
 
+	/* The stride index is only a cache, so it's fine to fill it in
+     through a const table. */
+	if(p->prefixlen >= ROUTE_STRIDE_BITS && table->count >= ROUTE_STRIDE_MIN_COUNT) {
+		struct route_table *rt = (struct route_table *) table;
+
+		if(!rt->stride) {
+			rt->stride = XCALLOC(MTYPE_ROUTE_TABLE, sizeof(struct route_stride));
+			rt->stride->dirty = 1;
+		}
+		if(rt->stride->dirty) {
+			route_stride_build(rt, p->family);
+		}
+		if(rt->stride->family == p->family) {
+			unsigned int s = p->u.val[0] >> (8 - ROUTE_STRIDE_BITS);
+
+			node = rt->stride->slot[s].jump;
+			above = rt->stride->slot[s].above;
+		}
+	}
+
 	/* Walk down tree.  If there is matched route then store it to
      matched. */
 	while(node && node->p.prefixlen <= p->prefixlen && prefix_match(&node->p, p)) {
@@ -196,6 +289,13 @@ struct route_node *route_node_match(const struct route_table *table, const struc
 		node = node->link[prefix_bit(&p->u.prefix, node->p.prefixlen)];
 	}
 
+	/* Started below the top of the tree, check the levels skipped. */
+	for(; !matched && above; above = above->parent) {
+		if(above->info) {
+			matched = above;
+		}
+	}
+
 	/* If matched route found, return it. */
 	if(matched) {
 		return route_lock_node(matched);
@@ -273,6 +373,7 @@ struct route_node *route_node_get(struct route_table *const table, const struct
 		} else {
 			table->top = new;
 		}
+		route_stride_touch(table, new);
 	} else {
 		new = route_node_new(table);
 		route_common(&node->p, p, &new->p);
@@ -285,6 +386,7 @@ struct route_node *route_node_get(struct route_table *const table, const struct
 		} else {
 			table->top = new;
 		}
+		route_stride_touch(table, new);
 
 		if(new->p.prefixlen != p->prefixlen) {
 			match = new;
@@ -319,6 +421,7 @@ static void route_node_delete(struct route_node *node) {
 
 	parent = node->parent;
 
+	route_stride_touch(node->table, node);
 	if(child) {
 		child->parent = parent;
 	}
@@ -391,6 +494,45 @@ struct route_node *route_next(struct route_node *node) {
 	return NULL;
 }
 
+/* Next node in iteration order, without touching reference counts. */
+static struct route_node *route_next_nolock(struct route_node *node) {
+	if(node->l_left) {
+		return node->l_left;
+	}
+	if(node->l_right) {
+		return node->l_right;
+	}
+
+	while(node->parent) {
+		if(node->parent->l_left == node && node->parent->l_right) {
+			return node->parent->l_right;
+		}
+		node = node->parent;
+	}
+	return NULL;
+}
+
+/* First node with info, or NULL.  Unlike route_top() the node isn't
+   locked, so the table must not change while it's being walked with
+   route_next_info(). */
+struct route_node *route_top_info(const struct route_table *table) {
+	struct route_node *node = table->top;
+
+	if(node && !node->info) {
+		node = route_next_info(node);
+	}
+	return node;
+}
+
+/* Next node with info after node, or NULL.  No locking. */
+struct route_node *route_next_info(struct route_node *node) {
+	do {
+		node = route_next_nolock(node);
+	} while(node && !node->info);
+
+	return node;
+}
+
 /* Unlock current node and lock next node until limit. */
 struct route_node *route_next_until(struct route_node *node, struct route_node *limit) {
 	struct route_node *next;
@@ -687,6 +829,62 @@ void route_table_iter_pause(route_table_iter_t *iter) {
 	}
 }
 
+/*
+ * route_table_walk_init
+ */
+void route_table_walk_init(route_table_walk_t *walk, struct route_table *table) {
+	memset(walk, 0, sizeof(*walk));
+	walk->table = table;
+	if(table) {
+		walk->next = route_top_info(table);
+	}
+}
+
+/*
+ * route_table_walk_next
+ *
+ * Get the next node with info.  The following node is found before
+ * this one is returned, so the caller may delete the node it's given.
+ */
+struct route_node *route_table_walk_next(route_table_walk_t *walk) {
+	struct route_node *node;
+
+	if(walk->paused) {
+		walk->paused = 0;
+		node = route_node_lookup(walk->table, &walk->pause_prefix);
+		if(node) {
+			route_unlock_node(node);
+		} else {
+			node = route_table_get_next_internal(walk->table, &walk->pause_prefix);
+			if(node && !node->info) {
+				node = route_next_info(node);
+			}
+		}
+		walk->next = node;
+	}
+
+	node = walk->next;
+	if(node) {
+		walk->next = route_next_info(node);
+	}
+	return node;
+}
+
+/*
+ * route_table_walk_pause
+ *
+ * Pause a walk, so that it may be resumed with route_table_walk_next()
+ * after arbitrary additions/deletions from the table.
+ */
+void route_table_walk_pause(route_table_walk_t *walk) {
+	if(walk->paused || !walk->next) {
+		return;
+	}
+
+	prefix_copy(&walk->pause_prefix, &walk->next->p);
+	walk->paused = 1;
+}
+
 /*
  * route_table_iter_cleanup
  *
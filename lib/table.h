@@ -29,6 +29,7 @@
  */
 struct route_node;
 struct route_table;
+struct route_stride;
 
 /*
  * route_table_delegate_t
@@ -58,6 +59,11 @@ struct route_table {
 
 	unsigned long count;
 
+	/*
+   * Multi-bit stride index for route_node_match(), built on demand.
+   */
+	struct route_stride *stride;
+
 	/*
    * User data.
    */
@@ -127,6 +133,31 @@ struct route_table_iter_t_ {
 	struct prefix pause_prefix;
 };
 
+typedef struct route_table_walk_t_ route_table_walk_t;
+
+/*
+ * route_table_walk_t
+ *
+ * Like route_table_iter_t, but takes no references on the nodes it
+ * returns and skips nodes without info.  The node last returned may be
+ * deleted before asking for the next one; nothing else in the table may
+ * change unless the walk is paused first.
+ */
+struct route_table_walk_t_ {
+	struct route_table *table;
+
+	/*
+   * The node to be returned next, NULL once the walk is done.
+   */
+	struct route_node *next;
+
+	/*
+   * Set when paused, pause_prefix is then the prefix of 'next'.
+   */
+	int paused;
+	struct prefix pause_prefix;
+};
+
 /* Prototypes. */
 extern struct route_table *route_table_init(void);
 
@@ -137,6 +168,8 @@ extern void route_unlock_node(struct route_node *node);
 extern struct route_node *route_top(struct route_table *);
 extern struct route_node *route_next(struct route_node *);
 extern struct route_node *route_next_until(struct route_node *, struct route_node *);
+extern struct route_node *route_top_info(const struct route_table *);
+extern struct route_node *route_next_info(struct route_node *);
 extern struct route_node *route_node_get(struct route_table *const, const struct prefix *);
 extern struct route_node *route_node_lookup(const struct route_table *, const struct prefix *);
 extern struct route_node *route_lock_node(struct route_node *node);
@@ -158,6 +191,10 @@ extern void route_table_iter_init(route_table_iter_t *iter, struct route_table *
 extern void route_table_iter_pause(route_table_iter_t *iter);
 extern void route_table_iter_cleanup(route_table_iter_t *iter);
 
+extern void route_table_walk_init(route_table_walk_t *walk, struct route_table *table);
+extern struct route_node *route_table_walk_next(route_table_walk_t *walk);
+extern void route_table_walk_pause(route_table_walk_t *walk);
+
 /*
  * Inline functions.
  */
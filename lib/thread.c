@@ -32,12 +32,19 @@
 #include "pqueue.h"
 #include "command.h"
 #include "sigevent.h"
+#include "trace.h"
 
 #if defined(__APPLE__)
 	#include <mach/mach.h>
 	#include <mach/mach_time.h>
 #endif
 
+#if defined(THREAD_POLL_EPOLL)
+	#include <sys/epoll.h>
+#elif defined(THREAD_POLL_KQUEUE)
+	#include <sys/event.h>
+#endif
+
 /* Recent absolute time of day */
 struct timeval recent_time;
 static struct timeval last_recent_time;
@@ -229,43 +236,153 @@ static void cpu_record_hash_free(void *a) {
 	XFREE(MTYPE_THREAD_STATS, hist);
 }
 
+static void time_stats_add(struct time_stats *ts, unsigned long usec) {
+	int bucket = 0;
+
+	ts->total += usec;
+	if(ts->max < usec) {
+		ts->max = usec;
+	}
+	while(usec && bucket < THREAD_HIST_BUCKETS - 1) {
+		usec >>= 1;
+		bucket++;
+	}
+	ts->hist[bucket]++;
+}
+
+static void time_stats_merge(struct time_stats *to, const struct time_stats *from) {
+	int i;
+
+	to->total += from->total;
+	if(to->max < from->max) {
+		to->max = from->max;
+	}
+	for(i = 0; i < THREAD_HIST_BUCKETS; i++) {
+		to->hist[i] += from->hist[i];
+	}
+}
+
+/* Upper bound of the bucket holding the given per-mille rank, capped to
+ * the observed maximum. */
+static unsigned long time_stats_percentile(const struct time_stats *ts, unsigned int count, unsigned int permille) {
+	unsigned long long rank, seen = 0;
+	int i;
+
+	if(!count) {
+		return 0;
+	}
+	rank = ((unsigned long long) count * permille + 999) / 1000;
+	for(i = 0; i < THREAD_HIST_BUCKETS; i++) {
+		seen += ts->hist[i];
+		if(seen >= rank) {
+			break;
+		}
+	}
+	if(i == 0) {
+		return 0;
+	}
+	if(i >= THREAD_HIST_BUCKETS - 1 || ((1UL << i) - 1) > ts->max) {
+		return ts->max;
+	}
+	return (1UL << i) - 1;
+}
+
+static void vty_out_time_stats_percentiles(struct vty *vty, const struct time_stats *ts, unsigned int count) {
+	vty_out(vty, " %7lu %7lu %7lu", time_stats_percentile(ts, count, 500), time_stats_percentile(ts, count, 990), time_stats_percentile(ts, count, 999));
+}
+
+static void vty_out_thread_types(struct vty *vty, struct cpu_thread_history *a) {
+	vty_out(vty, " %c%c%c%c%c%c %s%s", a->types & (1 << THREAD_READ) ? 'R' : ' ', a->types & (1 << THREAD_WRITE) ? 'W' : ' ', a->types & (1 << THREAD_TIMER) ? 'T' : ' ', a->types & (1 << THREAD_EVENT) ? 'E' : ' ',
+		a->types & (1 << THREAD_EXECUTE) ? 'X' : ' ', a->types & (1 << THREAD_BACKGROUND) ? 'B' : ' ', a->funcname, VTY_NEWLINE);
+}
+
+static void vty_out_cpu_thread_latency(struct vty *vty, struct cpu_thread_history *a) {
+	vty_out(vty, "%9u", a->total_calls);
+	vty_out_time_stats_percentiles(vty, &a->real, a->total_calls);
+#ifdef HAVE_RUSAGE
+	vty_out_time_stats_percentiles(vty, &a->cpu, a->total_calls);
+#endif
+	vty_out(vty, " %9u", a->delay_calls);
+	vty_out_time_stats_percentiles(vty, &a->delay, a->delay_calls);
+	vty_out_thread_types(vty, a);
+}
+
 static void vty_out_cpu_thread_history(struct vty *vty, struct cpu_thread_history *a) {
 #ifdef HAVE_RUSAGE
 	vty_out(vty, "%7ld.%03ld %9d %8ld %9ld %8ld %9ld", a->cpu.total / 1000, a->cpu.total % 1000, a->total_calls, a->cpu.total / a->total_calls, a->cpu.max, a->real.total / a->total_calls, a->real.max);
 #else
 	vty_out(vty, "%7ld.%03ld %9d %8ld %9ld", a->real.total / 1000, a->real.total % 1000, a->total_calls, a->real.total / a->total_calls, a->real.max);
 #endif
-	vty_out(vty, " %c%c%c%c%c%c %s%s", a->types & (1 << THREAD_READ) ? 'R' : ' ', a->types & (1 << THREAD_WRITE) ? 'W' : ' ', a->types & (1 << THREAD_TIMER) ? 'T' : ' ', a->types & (1 << THREAD_EVENT) ? 'E' : ' ',
-		a->types & (1 << THREAD_EXECUTE) ? 'X' : ' ', a->types & (1 << THREAD_BACKGROUND) ? 'B' : ' ', a->funcname, VTY_NEWLINE);
+	vty_out_thread_types(vty, a);
+}
+
+/* Parse a "rwtexb" display filter, NULL meaning all types. */
+static int thread_filter_parse(struct vty *vty, const char *str, thread_type *filter) {
+	int i = 0;
+
+	*filter = (thread_type) -1U;
+	if(!str) {
+		return 0;
+	}
+
+	*filter = 0;
+	while(str[i] != '\0') {
+		switch(str[i]) {
+			case 'r':
+			case 'R': *filter |= (1 << THREAD_READ); break;
+			case 'w':
+			case 'W': *filter |= (1 << THREAD_WRITE); break;
+			case 't':
+			case 'T': *filter |= (1 << THREAD_TIMER); break;
+			case 'e':
+			case 'E': *filter |= (1 << THREAD_EVENT); break;
+			case 'x':
+			case 'X': *filter |= (1 << THREAD_EXECUTE); break;
+			case 'b':
+			case 'B': *filter |= (1 << THREAD_BACKGROUND); break;
+			default: break;
+		}
+		++i;
+	}
+	if(*filter == 0) {
+		vty_out(vty,
+			"Invalid filter \"%s\" specified,"
+			" must contain at least one of 'RWTEXB'%s",
+			str, VTY_NEWLINE);
+		return -1;
+	}
+	return 0;
 }
 
 static void cpu_record_hash_print(struct hash_backet *bucket, void *args[]) {
 	struct cpu_thread_history *totals = args[0];
 	struct vty *vty = args[1];
 	thread_type *filter = args[2];
+	int latency = *(int *) args[3];
 	struct cpu_thread_history *a = bucket->data;
 
 	a = bucket->data;
 	if(!(a->types & *filter)) {
 		return;
 	}
-	vty_out_cpu_thread_history(vty, a);
-	totals->total_calls += a->total_calls;
-	totals->real.total += a->real.total;
-	if(totals->real.max < a->real.max) {
-		totals->real.max = a->real.max;
+	if(latency) {
+		vty_out_cpu_thread_latency(vty, a);
+	} else {
+		vty_out_cpu_thread_history(vty, a);
 	}
+	totals->total_calls += a->total_calls;
+	time_stats_merge(&totals->real, &a->real);
 #ifdef HAVE_RUSAGE
-	totals->cpu.total += a->cpu.total;
-	if(totals->cpu.max < a->cpu.max) {
-		totals->cpu.max = a->cpu.max;
-	}
+	time_stats_merge(&totals->cpu, &a->cpu);
 #endif
+	totals->delay_calls += a->delay_calls;
+	time_stats_merge(&totals->delay, &a->delay);
 }
 
 static void cpu_record_print(struct vty *vty, thread_type filter) {
 	struct cpu_thread_history tmp;
-	void *args[3] = { &tmp, vty, &filter };
+	int latency = 0;
+	void *args[4] = { &tmp, vty, &filter, &latency };
 
 	memset(&tmp, 0, sizeof tmp);
 	tmp.funcname = "TOTAL";
@@ -286,46 +403,58 @@ static void cpu_record_print(struct vty *vty, thread_type filter) {
 	}
 }
 
+static void cpu_record_latency_print(struct vty *vty, thread_type filter) {
+	struct cpu_thread_history tmp;
+	int latency = 1;
+	void *args[4] = { &tmp, vty, &filter, &latency };
+
+	memset(&tmp, 0, sizeof tmp);
+	tmp.funcname = "TOTAL";
+	tmp.types = filter;
+
+#ifdef HAVE_RUSAGE
+	vty_out(vty, "%9s %-23s %-23s %-33s%s", "", " Real (wall-clock) uSec:", " CPU (user+system) uSec:", " Scheduling delay uSec:", VTY_NEWLINE);
+	vty_out(vty, "  Invoked     p50     p99    p999     p50     p99    p999   Delayed     p50     p99    p999");
+#else
+	vty_out(vty, "%9s %-23s %-33s%s", "", " Real (wall-clock) uSec:", " Scheduling delay uSec:", VTY_NEWLINE);
+	vty_out(vty, "  Invoked     p50     p99    p999   Delayed     p50     p99    p999");
+#endif
+	vty_out(vty, "  Type  Thread%s", VTY_NEWLINE);
+	hash_iterate(cpu_record, (void (*)(struct hash_backet *, void *)) cpu_record_hash_print, args);
+
+	if(tmp.total_calls > 0) {
+		vty_out_cpu_thread_latency(vty, &tmp);
+	}
+}
+
 DEFUN(show_thread_cpu, show_thread_cpu_cmd, "show thread cpu [FILTER]",
       SHOW_STR "Thread information\n"
 	       "Thread CPU usage\n"
 	       "Display filter (rwtexb)\n") {
-	int i = 0;
-	thread_type filter = (thread_type) -1U;
-
-	if(argc > 0) {
-		filter = 0;
-		while(argv[0][i] != '\0') {
-			switch(argv[0][i]) {
-				case 'r':
-				case 'R': filter |= (1 << THREAD_READ); break;
-				case 'w':
-				case 'W': filter |= (1 << THREAD_WRITE); break;
-				case 't':
-				case 'T': filter |= (1 << THREAD_TIMER); break;
-				case 'e':
-				case 'E': filter |= (1 << THREAD_EVENT); break;
-				case 'x':
-				case 'X': filter |= (1 << THREAD_EXECUTE); break;
-				case 'b':
-				case 'B': filter |= (1 << THREAD_BACKGROUND); break;
-				default: break;
-			}
-			++i;
-		}
-		if(filter == 0) {
-			vty_out(vty,
-				"Invalid filter \"%s\" specified,"
-				" must contain at least one of 'RWTEXB'%s",
-				argv[0], VTY_NEWLINE);
-			return CMD_WARNING;
-		}
+	thread_type filter;
+
+	if(thread_filter_parse(vty, argc > 0 ? argv[0] : NULL, &filter) < 0) {
+		return CMD_WARNING;
 	}
 
 	cpu_record_print(vty, filter);
 	return CMD_SUCCESS;
 }
 
+DEFUN(show_thread_latency, show_thread_latency_cmd, "show thread latency [FILTER]",
+      SHOW_STR "Thread information\n"
+	       "Thread latency percentiles\n"
+	       "Display filter (rwtexb)\n") {
+	thread_type filter;
+
+	if(thread_filter_parse(vty, argc > 0 ? argv[0] : NULL, &filter) < 0) {
+		return CMD_WARNING;
+	}
+
+	cpu_record_latency_print(vty, filter);
+	return CMD_SUCCESS;
+}
+
 static void cpu_record_hash_clear(struct hash_backet *bucket, void *args) {
 	thread_type *filter = args;
 	struct cpu_thread_history *a = bucket->data;
@@ -348,36 +477,10 @@ DEFUN(clear_thread_cpu, clear_thread_cpu_cmd, "clear thread cpu [FILTER]",
       "Thread information\n"
       "Thread CPU usage\n"
       "Display filter (rwtexb)\n") {
-	int i = 0;
-	thread_type filter = (thread_type) -1U;
-
-	if(argc > 0) {
-		filter = 0;
-		while(argv[0][i] != '\0') {
-			switch(argv[0][i]) {
-				case 'r':
-				case 'R': filter |= (1 << THREAD_READ); break;
-				case 'w':
-				case 'W': filter |= (1 << THREAD_WRITE); break;
-				case 't':
-				case 'T': filter |= (1 << THREAD_TIMER); break;
-				case 'e':
-				case 'E': filter |= (1 << THREAD_EVENT); break;
-				case 'x':
-				case 'X': filter |= (1 << THREAD_EXECUTE); break;
-				case 'b':
-				case 'B': filter |= (1 << THREAD_BACKGROUND); break;
-				default: break;
-			}
-			++i;
-		}
-		if(filter == 0) {
-			vty_out(vty,
-				"Invalid filter \"%s\" specified,"
-				" must contain at least one of 'RWTEXB'%s",
-				argv[0], VTY_NEWLINE);
-			return CMD_WARNING;
-		}
+	thread_type filter;
+
+	if(thread_filter_parse(vty, argc > 0 ? argv[0] : NULL, &filter) < 0) {
+		return CMD_WARNING;
 	}
 
 	cpu_record_clear(filter);
@@ -405,6 +508,204 @@ static void thread_timer_update(void *node, int actual_position) {
 	thread->index = actual_position;
 }
 
+/* File descriptor poller.
+ *
+ * The select() backend keeps the historic fd_set bitmaps and has to scan
+ * them after every wakeup.  The epoll and kqueue backends instead keep
+ * the kernel's interest set in step with the read/write thread arrays,
+ * so that fetching ready descriptors costs in proportion to the number
+ * of descriptors that are actually active, and descriptors beyond
+ * FD_SETSIZE can be watched.
+ *
+ * Interest is expressed as a mask of (1 << THREAD_READ) and
+ * (1 << THREAD_WRITE), derived from the thread arrays.
+ */
+#define FD_POLL_READ (1 << THREAD_READ)
+#define FD_POLL_WRITE (1 << THREAD_WRITE)
+
+#define FD_POLL_EVENTS_MIN 64
+
+static int fd_poll_mask(struct thread_master *m, int fd) {
+	return (m->read[fd] ? FD_POLL_READ : 0) | (m->write[fd] ? FD_POLL_WRITE : 0);
+}
+
+#if defined(THREAD_POLL_EPOLL)
+static const char *fd_poll_name = "epoll_wait";
+
+static int fd_poll_init(struct thread_master *m) {
+	m->poll_fd = epoll_create1(EPOLL_CLOEXEC);
+	if(m->poll_fd < 0) {
+		zlog_err("epoll_create1() failed: %s", safe_strerror(errno));
+		return -1;
+	}
+	m->poll_pid = getpid();
+	m->poll_events_size = FD_POLL_EVENTS_MIN;
+	m->poll_events = XCALLOC(MTYPE_THREAD, sizeof(struct epoll_event) * m->poll_events_size);
+	return 0;
+}
+
+static void fd_poll_finish(struct thread_master *m) {
+	close(m->poll_fd);
+	XFREE(MTYPE_THREAD, m->poll_events);
+}
+
+/* Bring the kernel interest set for fd from 'old' to 'new'.  Descriptors
+ * may have been closed (and their number reused) behind our back, so
+ * fall back between ADD and MOD as the kernel tells us. */
+static int fd_poll_set(struct thread_master *m, int fd, int old, int new) {
+	struct epoll_event ev;
+	int op, ret;
+
+	if(old == new) {
+		return 0;
+	}
+
+	memset(&ev, 0, sizeof(ev));
+	ev.data.fd = fd;
+	ev.events = ((new & FD_POLL_READ) ? EPOLLIN : 0) | ((new & FD_POLL_WRITE) ? EPOLLOUT : 0);
+
+	if(!new) {
+		/* Failure just means the fd was already closed. */
+		epoll_ctl(m->poll_fd, EPOLL_CTL_DEL, fd, &ev);
+		return 0;
+	}
+
+	op = old ? EPOLL_CTL_MOD : EPOLL_CTL_ADD;
+	ret = epoll_ctl(m->poll_fd, op, fd, &ev);
+	if(ret < 0 && op == EPOLL_CTL_ADD && errno == EEXIST) {
+		ret = epoll_ctl(m->poll_fd, EPOLL_CTL_MOD, fd, &ev);
+	} else if(ret < 0 && op == EPOLL_CTL_MOD && errno == ENOENT) {
+		ret = epoll_ctl(m->poll_fd, EPOLL_CTL_ADD, fd, &ev);
+	}
+	return ret;
+}
+
+static int fd_poll_wait(struct thread_master *m, struct timeval *t) {
+	int timeout = -1;
+	int num;
+
+	if(t) {
+		timeout = t->tv_sec * 1000 + (t->tv_usec + 999) / 1000;
+	}
+
+	num = epoll_wait(m->poll_fd, m->poll_events, m->poll_events_size, timeout);
+	return num;
+}
+#elif defined(THREAD_POLL_KQUEUE)
+static const char *fd_poll_name = "kevent";
+
+static int fd_poll_init(struct thread_master *m) {
+	m->poll_fd = kqueue();
+	if(m->poll_fd < 0) {
+		zlog_err("kqueue() failed: %s", safe_strerror(errno));
+		return -1;
+	}
+	m->poll_pid = getpid();
+	m->poll_events_size = FD_POLL_EVENTS_MIN;
+	m->poll_events = XCALLOC(MTYPE_THREAD, sizeof(struct kevent) * m->poll_events_size);
+	return 0;
+}
+
+static void fd_poll_finish(struct thread_master *m) {
+	close(m->poll_fd);
+	XFREE(MTYPE_THREAD, m->poll_events);
+}
+
+static int fd_poll_set(struct thread_master *m, int fd, int old, int new) {
+	struct kevent ch[2];
+	int n = 0;
+
+	if((old ^ new) & FD_POLL_READ) {
+		EV_SET(&ch[n++], fd, EVFILT_READ, (new & FD_POLL_READ) ? EV_ADD : EV_DELETE, 0, 0, NULL);
+	}
+	if((old ^ new) & FD_POLL_WRITE) {
+		EV_SET(&ch[n++], fd, EVFILT_WRITE, (new & FD_POLL_WRITE) ? EV_ADD : EV_DELETE, 0, 0, NULL);
+	}
+	if(!n) {
+		return 0;
+	}
+	/* Deleting filters of an already closed fd fails harmlessly. */
+	if(kevent(m->poll_fd, ch, n, NULL, 0, NULL) < 0 && new) {
+		return -1;
+	}
+	return 0;
+}
+
+/* A kqueue is not inherited by fork(), and daemon() is normally called
+ * after the master was created.  Rebuild the queue in the child. */
+static void fd_poll_check_fork(struct thread_master *m) {
+	int fd;
+
+	if(m->poll_pid == getpid()) {
+		return;
+	}
+
+	close(m->poll_fd);
+	m->poll_fd = kqueue();
+	m->poll_pid = getpid();
+	for(fd = 0; fd < m->fd_limit; fd++) {
+		fd_poll_set(m, fd, 0, fd_poll_mask(m, fd));
+	}
+}
+
+static int fd_poll_wait(struct thread_master *m, struct timeval *t) {
+	struct timespec ts, *tsp = NULL;
+	int num;
+
+	fd_poll_check_fork(m);
+
+	if(t) {
+		ts.tv_sec = t->tv_sec;
+		ts.tv_nsec = t->tv_usec * 1000;
+		tsp = &ts;
+	}
+
+	num = kevent(m->poll_fd, NULL, 0, m->poll_events, m->poll_events_size, tsp);
+	return num;
+}
+#else  /* THREAD_POLL_SELECT */
+static const char *fd_poll_name = "select";
+
+static int fd_poll_init(struct thread_master *m) {
+	FD_ZERO(&m->readfd);
+	FD_ZERO(&m->writefd);
+	FD_ZERO(&m->exceptfd);
+	return 0;
+}
+
+static void fd_poll_finish(struct thread_master *m) {
+}
+
+static int fd_poll_set(struct thread_master *m, int fd, int old, int new) {
+	if(fd >= FD_SETSIZE) {
+		errno = EINVAL;
+		return -1;
+	}
+	if(new & FD_POLL_READ) {
+		FD_SET(fd, &m->readfd);
+	} else {
+		FD_CLR(fd, &m->readfd);
+	}
+	if(new & FD_POLL_WRITE) {
+		FD_SET(fd, &m->writefd);
+	} else {
+		FD_CLR(fd, &m->writefd);
+	}
+	return 0;
+}
+
+static int fd_poll_wait(struct thread_master *m, struct timeval *t) {
+	thread_fd_set exceptfd;
+
+	/* Structure copy.  */
+	m->readfd_ready = m->readfd;
+	m->writefd_ready = m->writefd;
+	exceptfd = m->exceptfd;
+
+	return select(FD_SETSIZE, &m->readfd_ready, &m->writefd_ready, &exceptfd, t);
+}
+#endif /* THREAD_POLL_SELECT */
+
 /* Allocate new thread master.  */
 struct thread_master *thread_master_create() {
 	struct thread_master *rv;
@@ -435,6 +736,13 @@ struct thread_master *thread_master_create() {
 		return NULL;
 	}
 
+	if(fd_poll_init(rv) < 0) {
+		XFREE(MTYPE_THREAD, rv->write);
+		XFREE(MTYPE_THREAD, rv->read);
+		XFREE(MTYPE_THREAD_MASTER, rv);
+		return NULL;
+	}
+
 	/* Initialize the timer queues */
 	rv->timer = pqueue_create();
 	rv->background = pqueue_create();
@@ -444,6 +752,31 @@ struct thread_master *thread_master_create() {
 	return rv;
 }
 
+/* Second-granularity timers can be kept on a hashed timing wheel, making
+ * arm and cancel O(1) instead of O(log n) heap operations.  A timer
+ * fires on the first tick at or after its exact expiry, i.e. up to a
+ * second late, so only timers added with whole-second resolution
+ * (thread_add_timer) go there; msec timers always use the heap.
+ *
+ * Wheel timers keep their slot in thread->index, offset below -1 so it
+ * can't be mistaken for a heap position. */
+#define WHEEL_INDEX(slot) (-2 - (slot))
+#define WHEEL_SLOT(index) (-2 - (index))
+
+void thread_master_timer_wheel_enable(struct thread_master *m) {
+	if(m->wheel) {
+		return;
+	}
+	quagga_get_relative(NULL);
+	m->wheel = XCALLOC(MTYPE_THREAD_MASTER, sizeof(struct thread_timer_wheel));
+	m->wheel->last = relative_time.tv_sec;
+}
+
+/* Second on whose tick the timer becomes due. */
+static time_t thread_timer_wheel_due(struct thread *thread) {
+	return thread->u.sands.tv_sec + (thread->u.sands.tv_usec ? 1 : 0);
+}
+
 /* Add a new thread to the list.  */
 static void thread_list_add(struct thread_list *list, struct thread *thread) {
 	thread->next = NULL;
@@ -491,6 +824,30 @@ static void thread_add_unuse(struct thread *thread) {
 	thread_list_add(&thread->master->unuse, thread);
 }
 
+static void thread_timer_wheel_add(struct thread_timer_wheel *wheel, struct thread *thread) {
+	time_t due = thread_timer_wheel_due(thread);
+	int slot;
+
+	/* Ticks up to 'last' have been processed already. */
+	if(due <= wheel->last) {
+		due = wheel->last + 1;
+	}
+	slot = due & (THREAD_TIMER_WHEEL_SLOTS - 1);
+
+	thread->index = WHEEL_INDEX(slot);
+	thread_list_add(&wheel->slot[slot], thread);
+	wheel->count++;
+}
+
+static void thread_timer_wheel_delete(struct thread_timer_wheel *wheel, struct thread *thread) {
+	int slot = WHEEL_SLOT(thread->index);
+
+	assert(slot >= 0 && slot < THREAD_TIMER_WHEEL_SLOTS);
+	thread_list_delete(&wheel->slot[slot], thread);
+	thread->index = -1;
+	wheel->count--;
+}
+
 /* Free all unused thread. */
 static void thread_list_free(struct thread_master *m, struct thread_list *list) {
 	struct thread *t;
@@ -539,6 +896,15 @@ void thread_master_free(struct thread_master *m) {
 	thread_list_free(m, &m->ready);
 	thread_list_free(m, &m->unuse);
 	thread_queue_free(m, m->background);
+	if(m->wheel) {
+		int i;
+
+		for(i = 0; i < THREAD_TIMER_WHEEL_SLOTS; i++) {
+			thread_list_free(m, &m->wheel->slot[i]);
+		}
+		XFREE(MTYPE_THREAD_MASTER, m->wheel);
+	}
+	fd_poll_finish(m);
 
 	XFREE(MTYPE_THREAD_MASTER, m);
 
@@ -604,48 +970,41 @@ static struct thread *thread_get(struct thread_master *m, u_char type, int (*fun
 	return thread;
 }
 
-#define fd_copy_fd_set(X) (X)
-
-static int fd_select(int size, thread_fd_set *read, thread_fd_set *write, thread_fd_set *except, struct timeval *t) {
-	return (select(size, read, write, except, t));
-}
-
-static int fd_is_set(int fd, thread_fd_set *fdset) {
-	return FD_ISSET(fd, fdset);
-}
-
-static int fd_clear_read_write(int fd, thread_fd_set *fdset) {
-	if(!FD_ISSET(fd, fdset)) {
-		return 0;
-	}
-
-	FD_CLR(fd, fdset);
-	return 1;
-}
-
 static struct thread *funcname_thread_add_read_write(int dir, struct thread_master *m, int (*func)(struct thread *), void *arg, int fd, debugargdef) {
 	struct thread *thread = NULL;
-	thread_fd_set *fdset = NULL;
+	struct thread **thread_array;
+	int old;
 
-	if(dir == THREAD_READ) {
-		fdset = &m->readfd;
-	} else {
-		fdset = &m->writefd;
+	if(fd < 0 || fd >= m->fd_limit) {
+		zlog(NULL, LOG_WARNING, "Invalid %s fd [%d]", (dir == THREAD_READ) ? "read" : "write", fd);
+		return NULL;
 	}
 
-	if(FD_ISSET(fd, fdset)) {
-		zlog(NULL, LOG_WARNING, "There is already %s fd [%d]", (dir = THREAD_READ) ? "read" : "write", fd);
+	thread_array = (dir == THREAD_READ) ? m->read : m->write;
+
+	if(thread_array[fd]) {
+		zlog(NULL, LOG_WARNING, "There is already %s fd [%d]", (dir == THREAD_READ) ? "read" : "write", fd);
 		return NULL;
 	}
 
-	FD_SET(fd, fdset);
-
+	old = fd_poll_mask(m, fd);
 	thread = thread_get(m, dir, func, arg, debugargpass);
 	thread->u.fd = fd;
-	if(dir == THREAD_READ) {
-		thread_add_fd(m->read, thread);
-	} else {
-		thread_add_fd(m->write, thread);
+	thread_add_fd(thread_array, thread);
+
+	if(fd_poll_set(m, fd, old, fd_poll_mask(m, fd)) < 0) {
+		if(errno == EPERM) {
+			/* Regular files can't be polled, and select() always
+			 * reports them as ready.  Do the same. */
+			thread_delete_fd(thread_array, thread);
+			thread->type = THREAD_READY;
+			thread_list_add(&m->ready, thread);
+			return thread;
+		}
+		zlog(NULL, LOG_WARNING, "Can't poll %s fd [%d]: %s", (dir == THREAD_READ) ? "read" : "write", fd, safe_strerror(errno));
+		thread_delete_fd(thread_array, thread);
+		thread_add_unuse(thread);
+		return NULL;
 	}
 
 	return thread;
@@ -693,6 +1052,16 @@ struct thread *funcname_thread_add_timer(struct thread_master *m, int (*func)(st
 	trel.tv_sec = timer;
 	trel.tv_usec = 0;
 
+	if(m->wheel) {
+		struct thread *thread = thread_get(m, THREAD_TIMER, func, arg, debugargpass);
+
+		quagga_get_relative(NULL);
+		thread->u.sands.tv_sec = relative_time.tv_sec + trel.tv_sec;
+		thread->u.sands.tv_usec = relative_time.tv_usec;
+		thread_timer_wheel_add(m->wheel, thread);
+		return thread;
+	}
+
 	return funcname_thread_add_timer_timeval(m, func, THREAD_TIMER, arg, &trel, debugargpass);
 }
 
@@ -738,6 +1107,8 @@ struct thread *funcname_thread_add_event(struct thread_master *m, int (*func)(st
 
 	thread = thread_get(m, THREAD_EVENT, func, arg, debugargpass);
 	thread->u.val = val;
+	/* remember when it was scheduled, for the delay statistics */
+	quagga_get_relative(&thread->real);
 	thread_list_add(&m->event, thread);
 
 	return thread;
@@ -750,15 +1121,16 @@ void thread_cancel(struct thread *thread) {
 	struct thread **thread_array = NULL;
 
 	switch(thread->type) {
-		case THREAD_READ:
-			assert(fd_clear_read_write(thread->u.fd, &thread->master->readfd));
-			thread_array = thread->master->read;
-			break;
-		case THREAD_WRITE:
-			assert(fd_clear_read_write(thread->u.fd, &thread->master->writefd));
-			thread_array = thread->master->write;
+		case THREAD_READ: thread_array = thread->master->read; break;
+		case THREAD_WRITE: thread_array = thread->master->write; break;
+		case THREAD_TIMER:
+			if(thread->index < -1) {
+				thread_timer_wheel_delete(thread->master->wheel, thread);
+				thread_add_unuse(thread);
+				return;
+			}
+			queue = thread->master->timer;
 			break;
-		case THREAD_TIMER: queue = thread->master->timer; break;
 		case THREAD_EVENT: list = &thread->master->event; break;
 		case THREAD_READY: list = &thread->master->ready; break;
 		case THREAD_BACKGROUND: queue = thread->master->background; break;
@@ -772,7 +1144,11 @@ void thread_cancel(struct thread *thread) {
 	} else if(list) {
 		thread_list_delete(list, thread);
 	} else if(thread_array) {
+		int old = fd_poll_mask(thread->master, thread->u.fd);
+
+		assert(thread_array[thread->u.fd] == thread);
 		thread_delete_fd(thread_array, thread);
+		fd_poll_set(thread->master, thread->u.fd, old, fd_poll_mask(thread->master, thread->u.fd));
 	} else {
 		assert(!"Thread should be either in queue or list or array!");
 	}
@@ -825,41 +1201,95 @@ static struct timeval *thread_timer_wait(struct pqueue *queue, struct timeval *t
 	return NULL;
 }
 
-static int thread_process_fds_helper(struct thread_master *m, struct thread *thread, thread_fd_set *fdset) {
-	thread_fd_set *mfdset = NULL;
-	struct thread **thread_array;
+/* Move the read and/or write thread of fd, as selected by 'events', to
+ * the ready list. */
+static int thread_process_fd(struct thread_master *m, int fd, int events) {
+	struct thread *thread;
+	int old = fd_poll_mask(m, fd);
+	int ready = 0;
 
-	if(!thread) {
-		return 0;
+	if((events & FD_POLL_READ) && (thread = m->read[fd]) != NULL) {
+		thread_delete_fd(m->read, thread);
+		thread_list_add(&m->ready, thread);
+		thread->type = THREAD_READY;
+		ready++;
 	}
+	if((events & FD_POLL_WRITE) && (thread = m->write[fd]) != NULL) {
+		thread_delete_fd(m->write, thread);
+		thread_list_add(&m->ready, thread);
+		thread->type = THREAD_READY;
+		ready++;
+	}
+	if(ready) {
+		fd_poll_set(m, fd, old, fd_poll_mask(m, fd));
+	}
+	return ready;
+}
 
-	if(thread->type == THREAD_READ) {
-		mfdset = &m->readfd;
-		thread_array = m->read;
-	} else {
-		mfdset = &m->writefd;
-		thread_array = m->write;
+#if defined(THREAD_POLL_EPOLL)
+static void thread_process_fds(struct thread_master *m, int num) {
+	struct epoll_event *ev = m->poll_events;
+	int i;
+
+	for(i = 0; i < num; i++) {
+		int events = 0;
+
+		if(ev[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR)) {
+			events |= FD_POLL_READ;
+		}
+		if(ev[i].events & (EPOLLOUT | EPOLLHUP | EPOLLERR)) {
+			events |= FD_POLL_WRITE;
+		}
+		thread_process_fd(m, ev[i].data.fd, events);
 	}
 
-	if(fd_is_set(THREAD_FD(thread), fdset)) {
-		fd_clear_read_write(THREAD_FD(thread), mfdset);
-		thread_delete_fd(thread_array, thread);
-		thread_list_add(&m->ready, thread);
-		thread->type = THREAD_READY;
-		return 1;
+	/* Buffer filled up, let the next round see more at once. */
+	if(num == m->poll_events_size && m->poll_events_size < m->fd_limit) {
+		m->poll_events_size *= 2;
+		m->poll_events = XREALLOC(MTYPE_THREAD, m->poll_events, sizeof(struct epoll_event) * m->poll_events_size);
 	}
-	return 0;
 }
+#elif defined(THREAD_POLL_KQUEUE)
+static void thread_process_fds(struct thread_master *m, int num) {
+	struct kevent *ev = m->poll_events;
+	int i;
 
-static int thread_process_fds(struct thread_master *m, thread_fd_set *rset, thread_fd_set *wset, int num) {
+	for(i = 0; i < num; i++) {
+		if(ev[i].flags & EV_ERROR) {
+			continue;
+		}
+		if(ev[i].filter == EVFILT_READ) {
+			thread_process_fd(m, ev[i].ident, FD_POLL_READ);
+		} else if(ev[i].filter == EVFILT_WRITE) {
+			thread_process_fd(m, ev[i].ident, FD_POLL_WRITE);
+		}
+	}
+
+	if(num == m->poll_events_size && m->poll_events_size < 2 * m->fd_limit) {
+		m->poll_events_size *= 2;
+		m->poll_events = XREALLOC(MTYPE_THREAD, m->poll_events, sizeof(struct kevent) * m->poll_events_size);
+	}
+}
+#else  /* THREAD_POLL_SELECT */
+static void thread_process_fds(struct thread_master *m, int num) {
 	int ready = 0, index;
+	int limit = MIN(m->fd_limit, FD_SETSIZE);
+
+	for(index = 0; index < limit && ready < num; ++index) {
+		int events = 0;
 
-	for(index = 0; index < m->fd_limit && ready < num; ++index) {
-		ready += thread_process_fds_helper(m, m->read[index], rset);
-		ready += thread_process_fds_helper(m, m->write[index], wset);
+		if(FD_ISSET(index, &m->readfd_ready)) {
+			events |= FD_POLL_READ;
+		}
+		if(FD_ISSET(index, &m->writefd_ready)) {
+			events |= FD_POLL_WRITE;
+		}
+		if(events) {
+			ready += thread_process_fd(m, index, events);
+		}
 	}
-	return num - ready;
 }
+#endif /* THREAD_POLL_SELECT */
 
 /* Add all timers that have popped to the ready list. */
 static unsigned int thread_timer_process(struct pqueue *queue, struct timeval *timenow) {
@@ -879,6 +1309,67 @@ static unsigned int thread_timer_process(struct pqueue *queue, struct timeval *t
 	return ready;
 }
 
+/* Fire wheel timers whose tick has passed. */
+static unsigned int thread_timer_wheel_process(struct thread_timer_wheel *wheel, struct timeval *timenow) {
+	struct thread *thread, *next;
+	unsigned int ready = 0;
+	time_t sec, end;
+
+	if(!wheel) {
+		return 0;
+	}
+
+	sec = wheel->last + 1;
+	end = timenow->tv_sec;
+	if(!wheel->count || sec > end) {
+		if(end > wheel->last) {
+			wheel->last = end;
+		}
+		return 0;
+	}
+
+	/* Once a whole lap has gone by, every slot needs a visit. */
+	if(end - sec >= THREAD_TIMER_WHEEL_SLOTS) {
+		sec = end - THREAD_TIMER_WHEEL_SLOTS + 1;
+	}
+
+	for(; sec <= end && wheel->count; sec++) {
+		struct thread_list *list = &wheel->slot[sec & (THREAD_TIMER_WHEEL_SLOTS - 1)];
+
+		for(thread = list->head; thread; thread = next) {
+			next = thread->next;
+			if(thread_timer_wheel_due(thread) > end) {
+				continue; /* a later lap */
+			}
+			thread_timer_wheel_delete(wheel, thread);
+			thread->type = THREAD_READY;
+			thread_list_add(&thread->master->ready, thread);
+			ready++;
+		}
+	}
+	wheel->last = end;
+	return ready;
+}
+
+/* Time until the next non-empty wheel tick, if any. */
+static struct timeval *thread_timer_wheel_wait(struct thread_timer_wheel *wheel, struct timeval *timer_val) {
+	time_t sec;
+
+	if(!wheel || !wheel->count) {
+		return NULL;
+	}
+
+	for(sec = wheel->last + 1; sec <= wheel->last + THREAD_TIMER_WHEEL_SLOTS; sec++) {
+		if(wheel->slot[sec & (THREAD_TIMER_WHEEL_SLOTS - 1)].head) {
+			break;
+		}
+	}
+	timer_val->tv_sec = sec;
+	timer_val->tv_usec = 0;
+	*timer_val = timeval_subtract(*timer_val, relative_time);
+	return timer_val;
+}
+
 /* process a list en masse, e.g. for event thread lists */
 static unsigned int thread_process(struct thread_list *list) {
 	struct thread *thread;
@@ -898,13 +1389,12 @@ static unsigned int thread_process(struct thread_list *list) {
 /* Fetch next ready thread. */
 static struct thread *thread_fetch(struct thread_master *m) {
 	struct thread *thread;
-	thread_fd_set readfd;
-	thread_fd_set writefd;
-	thread_fd_set exceptfd;
 	struct timeval timer_val = { .tv_sec = 0, .tv_usec = 0 };
 	struct timeval timer_val_bg;
+	struct timeval timer_val_wheel;
 	struct timeval *timer_wait = &timer_val;
 	struct timeval *timer_wait_bg;
+	struct timeval *timer_wait_wheel;
 
 	while(1) {
 		int num = 0;
@@ -927,30 +1417,30 @@ static struct thread *thread_fetch(struct thread_master *m) {
 		/* Normal event are the next highest priority.  */
 		thread_process(&m->event);
 
-		/* Structure copy.  */
-		readfd = fd_copy_fd_set(m->readfd);
-		writefd = fd_copy_fd_set(m->writefd);
-		exceptfd = fd_copy_fd_set(m->exceptfd);
-
 		/* Calculate select wait timer if nothing else to do */
 		if(m->ready.count == 0) {
 			quagga_get_relative(NULL);
 			timer_wait = thread_timer_wait(m->timer, &timer_val);
 			timer_wait_bg = thread_timer_wait(m->background, &timer_val_bg);
+			timer_wait_wheel = thread_timer_wheel_wait(m->wheel, &timer_val_wheel);
+
+			if(timer_wait_wheel && (!timer_wait || (timeval_cmp(*timer_wait, *timer_wait_wheel) > 0))) {
+				timer_wait = timer_wait_wheel;
+			}
 
 			if(timer_wait_bg && (!timer_wait || (timeval_cmp(*timer_wait, *timer_wait_bg) > 0))) {
 				timer_wait = timer_wait_bg;
 			}
 		}
 
-		num = fd_select(FD_SETSIZE, &readfd, &writefd, &exceptfd, timer_wait);
+		num = fd_poll_wait(m, timer_wait);
 
 		/* Signals should get quick treatment */
 		if(num < 0) {
 			if(errno == EINTR) {
 				continue; /* signal received - process it */
 			}
-			zlog_warn("select() error: %s", safe_strerror(errno));
+			zlog_warn("%s() error: %s", fd_poll_name, safe_strerror(errno));
 			return NULL;
 		}
 
@@ -959,10 +1449,11 @@ static struct thread *thread_fetch(struct thread_master *m) {
 	 list in front of the I/O threads. */
 		quagga_get_relative(NULL);
 		thread_timer_process(m->timer, &relative_time);
+		thread_timer_wheel_process(m->wheel, &relative_time);
 
 		/* Got IO, process it */
 		if(num > 0) {
-			thread_process_fds(m, &readfd, &writefd, num);
+			thread_process_fds(m, num);
 		}
 
 #if 0
@@ -1025,6 +1516,7 @@ void thread_getrusage(RUSAGE_T *r) {
 }
 
 struct thread *thread_current = NULL;
+unsigned long thread_call_seq = 0;
 
 /* We check thread consumed time. If the system has getrusage, we'll
    use that to get in-depth stats on the performance of the thread in addition
@@ -1054,24 +1546,31 @@ static void thread_call(struct thread *thread) {
 	}
 
 	GETRUSAGE(&before);
+
+	if(thread->add_type == THREAD_EVENT) {
+		time_stats_add(&thread->hist->delay, timeval_elapsed(before.real, thread->real));
+		thread->hist->delay_calls++;
+	} else if(thread->add_type == THREAD_TIMER || thread->add_type == THREAD_BACKGROUND) {
+		struct timeval late = timeval_subtract(before.real, thread->u.sands);
+
+		time_stats_add(&thread->hist->delay, late.tv_sec * TIMER_SECOND_MICRO + late.tv_usec);
+		thread->hist->delay_calls++;
+	}
 	thread->real = before.real;
 
 	thread_current = thread;
+	thread_call_seq++;
+	QUAGGA_TRACE(lib, thread_call, thread->funcname, thread->schedfrom, thread->schedfrom_line);
 	(*thread->func)(thread);
 	thread_current = NULL;
 
 	GETRUSAGE(&after);
 
 	realtime = thread_consumed_time(&after, &before, &cputime);
-	thread->hist->real.total += realtime;
-	if(thread->hist->real.max < realtime) {
-		thread->hist->real.max = realtime;
-	}
+	QUAGGA_TRACE(lib, thread_done, thread->funcname, realtime, cputime);
+	time_stats_add(&thread->hist->real, realtime);
 #ifdef HAVE_RUSAGE
-	thread->hist->cpu.total += cputime;
-	if(thread->hist->cpu.max < cputime) {
-		thread->hist->cpu.max = cputime;
-	}
+	time_stats_add(&thread->hist->cpu, cputime);
 #endif
 
 	++(thread->hist->total_calls);
@@ -45,10 +45,29 @@ struct thread_list {
 
 struct pqueue;
 
+/* Hashed timing wheel for second-granularity timers.  Each slot covers
+ * one second of monotonic time; timers due further ahead than the
+ * wheel spans simply stay in their slot for another lap. */
+#define THREAD_TIMER_WHEEL_SLOTS 512
+
+struct thread_timer_wheel {
+	struct thread_list slot[THREAD_TIMER_WHEEL_SLOTS];
+	time_t last; /* last second processed */
+	unsigned int count;
+};
+
 /*
  * Abstract it so we can use different methodologies to
  * select on data.
  */
+#if defined(HAVE_SYS_EPOLL_H) && defined(HAVE_EPOLL_CREATE1)
+	#define THREAD_POLL_EPOLL
+#elif defined(HAVE_SYS_EVENT_H) && defined(HAVE_KQUEUE)
+	#define THREAD_POLL_KQUEUE
+#else
+	#define THREAD_POLL_SELECT
+#endif
+
 typedef fd_set thread_fd_set;
 
 /* Master of the theads. */
@@ -56,14 +75,24 @@ struct thread_master {
 	struct thread **read;
 	struct thread **write;
 	struct pqueue *timer;
+	struct thread_timer_wheel *wheel; /* NULL unless enabled */
 	struct thread_list event;
 	struct thread_list ready;
 	struct thread_list unuse;
 	struct pqueue *background;
 	int fd_limit;
+#ifdef THREAD_POLL_SELECT
 	thread_fd_set readfd;
 	thread_fd_set writefd;
 	thread_fd_set exceptfd;
+	thread_fd_set readfd_ready;
+	thread_fd_set writefd_ready;
+#else
+	int poll_fd;	    /* epoll/kqueue descriptor */
+	pid_t poll_pid;	    /* process poll_fd was created by */
+	void *poll_events;  /* buffer for returned events */
+	int poll_events_size;
+#endif
 	unsigned long alloc;
 };
 
@@ -85,7 +114,7 @@ struct thread {
 		struct timeval sands; /* rest of time sands value. */
 	} u;
 
-	int index; /* used for timers to store position in queue */
+	int index; /* used for timers to store position in queue or wheel */
 	struct timeval real;
 	struct cpu_thread_history *hist; /* cache pointer to cpu_history */
 	const char *funcname;
@@ -93,16 +122,25 @@ struct thread {
 	int schedfrom_line;
 };
 
+/* Log2-scale latency histogram, in microseconds.  Bucket 0 counts
+ * zero durations, bucket i > 0 those in [2^(i-1), 2^i). */
+#define THREAD_HIST_BUCKETS 32
+
 struct cpu_thread_history {
 	int (*func)(struct thread *);
 	unsigned int total_calls;
 
 	struct time_stats {
 		unsigned long total, max;
+		unsigned int hist[THREAD_HIST_BUCKETS];
 	} real;
 #ifdef HAVE_RUSAGE
 	struct time_stats cpu;
 #endif
+	/* Scheduling delay of events and timers: from the time they became
+	 * due to the time they ran. */
+	struct time_stats delay;
+	unsigned int delay_calls;
 	thread_type types;
 	const char *funcname;
 };
@@ -180,6 +218,7 @@ enum quagga_clkid {
 /* Prototypes. */
 extern struct thread_master *thread_master_create(void);
 extern void thread_master_free(struct thread_master *);
+extern void thread_master_timer_wheel_enable(struct thread_master *);
 
 extern struct thread *funcname_thread_add_read(struct thread_master *, int (*)(struct thread *), void *, int, debugargdef);
 extern struct thread *funcname_thread_add_write(struct thread_master *, int (*)(struct thread *), void *, int, debugargdef);
@@ -202,6 +241,7 @@ extern unsigned long timeval_elapsed(struct timeval a, struct timeval b);
 /* Internal libzebra exports */
 extern void thread_getrusage(RUSAGE_T *);
 extern struct cmd_element show_thread_cpu_cmd;
+extern struct cmd_element show_thread_latency_cmd;
 extern struct cmd_element clear_thread_cpu_cmd;
 
 /* replacements for the system gettimeofday(), clock_gettime() and
@@ -224,4 +264,8 @@ extern struct timeval recent_relative_time(void);
 /* only for use in logging functions! */
 extern struct thread *thread_current;
 
+/* Bumped as each thread callback starts.  State that only ever changes
+   from within some other callback can be cached against it. */
+extern unsigned long thread_call_seq;
+
 #endif /* _ZEBRA_THREAD_H */
@@ -0,0 +1,63 @@
+/*
+ * Quagga static tracepoints.
+ *
+ * This file is part of Quagga.
+ *
+ * Quagga is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2, or (at your option) any
+ * later version.
+ *
+ * Quagga is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Quagga; see the file COPYING.  If not, write to the Free
+ * Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ * 02111-1307, USA.
+ */
+
+#ifndef _QUAGGA_TRACE_H
+#define _QUAGGA_TRACE_H
+
+/* QUAGGA_TRACE(provider, name, args...) marks a USDT probe point, as
+ * declared by systemtap's <sys/sdt.h>.  A probe compiles to a single
+ * nop plus a note in the binary; bpftrace, perf or systemtap can attach
+ * to it in a running daemon, e.g.
+ *
+ *   bpftrace -e 'usdt:/usr/sbin/bgpd:bgp:update_receive
+ *                { @[str(arg0)] = count(); }'
+ *
+ * Arguments are evaluated even while nothing is attached, so keep them
+ * to fields and pointers at hand; tools can dereference pointers
+ * themselves.  At most 12 arguments.
+ *
+ * Probes in use, by provider:
+ *   lib:   thread_call (funcname, schedfrom, schedfrom_line)
+ *          thread_done (funcname, real usecs, cpu usecs)
+ *   bgp:   update_receive (peer host, size)
+ *          process (struct prefix *, afi, safi)
+ *   zebra: rib_process (struct prefix *, vrf_id)
+ *          netlink_talk (nlmsg_type, nlmsg_seq, vrf_id)
+ *   ospf:  spf_start (area id, incremental)
+ *          spf_done (area id, vertices, incremental, usecs)
+ *   isis:  spf_start (area tag, level, family)
+ *          spf_done (area tag, level, family, usecs)
+ *
+ * The SPF probes fire once per tree, whether the trees of a run are
+ * computed on SPF threads or not.
+ *
+ * Without <sys/sdt.h>, or with --disable-usdt, they compile to nothing.
+ */
+#ifdef HAVE_USDT
+	#include <sys/sdt.h>
+	#define QUAGGA_TRACE(provider, name, ...) STAP_PROBEV(provider, name, ##__VA_ARGS__)
+#else
+	#define QUAGGA_TRACE(provider, name, ...) \
+		do {                              \
+		} while(0)
+#endif
+
+#endif /* _QUAGGA_TRACE_H */
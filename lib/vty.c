@@ -166,6 +166,62 @@ int vty_out(struct vty *vty, const char *format, ...) {
 	return len;
 }
 
+/* Output bytes already formatted, bypassing printf. */
+void vty_out_raw(struct vty *vty, const void *buf, size_t len) {
+	if(vty_shell(vty)) {
+		fwrite(buf, 1, len, stdout);
+	} else {
+		buffer_put(vty->obuf, buf, len);
+	}
+}
+
+/* Whether a show command should stop here and leave the rest of its
+   output to vty_output_continue().  Only vtys whose output is written
+   from the event loop can wait; files and the local shell never fill. */
+int vty_output_full(struct vty *vty) {
+	if(vty->type != VTY_TERM && vty->type != VTY_SHELL_SERV) {
+		return 0;
+	}
+	return buffer_pending(vty->obuf) >= VTY_OUTPUT_WATERMARK;
+}
+
+/* Have func(vty, arg) called again whenever the output buffer has
+   drained below the watermark.  func returns nonzero while it has more
+   to print, which it should only do once vty_output_full(); clean(arg)
+   runs when it is done or the output is abandoned.  The command's
+   prompt or vtysh status is not sent until then. */
+void vty_output_continue(struct vty *vty, int (*func)(struct vty *, void *), void (*clean)(void *), void *arg) {
+	assert(!vty->output_func);
+
+	vty->output_func = func;
+	vty->output_clean = clean;
+	vty->output_arg = arg;
+}
+
+static void vty_output_end(struct vty *vty) {
+	void (*clean)(void *) = vty->output_clean;
+	void *arg = vty->output_arg;
+
+	vty->output_func = NULL;
+	vty->output_clean = NULL;
+	vty->output_arg = NULL;
+	if(clean) {
+		clean(arg);
+	}
+}
+
+/* Refill the output buffer from a pending continuation.  Returns 1
+   when the continuation finished on this call. */
+static int vty_output_step(struct vty *vty) {
+	while(vty->output_func && buffer_pending(vty->obuf) < VTY_OUTPUT_WATERMARK) {
+		if(!vty->output_func(vty, vty->output_arg)) {
+			vty_output_end(vty);
+			return 1;
+		}
+	}
+	return 0;
+}
+
 static int vty_log_out(struct vty *vty, const char *level, const char *proto_str, const char *format, struct timestamp_control *ctl, va_list va) {
 	int ret;
 	int len;
@@ -1264,7 +1320,8 @@ static int vty_execute(struct vty *vty) {
 	vty->cp = vty->length = 0;
 	vty_clear_buf(vty);
 
-	if(vty->status != VTY_CLOSE) {
+	/* A continued show prompts when it is done, see vty_flush(). */
+	if(vty->status != VTY_CLOSE && !vty->output_func) {
 		vty_prompt(vty);
 	}
 
@@ -1294,6 +1351,7 @@ static void vty_escape_map(unsigned char c, struct vty *vty) {
 /* Quit print out to the buffer. */
 static void vty_buffer_reset(struct vty *vty) {
 	buffer_reset(vty->obuf);
+	vty_output_end(vty);
 	vty_prompt(vty);
 	vty_redraw_line(vty);
 }
@@ -1349,7 +1407,8 @@ static int vty_read(struct thread *thread) {
 			continue;
 		}
 
-		if(vty->status == VTY_MORE) {
+		/* While a show is continued, keys only page or quit. */
+		if(vty->status == VTY_MORE || vty->output_func) {
 			switch(buf[i]) {
 				case CONTROL('C'):
 				case 'q':
@@ -1477,6 +1536,11 @@ static int vty_flush(struct thread *thread) {
 	/* Function execution continue. */
 	erase = ((vty->status == VTY_MORE || vty->status == VTY_MORELINE));
 
+	/* Let a continued show add to what is left to write. */
+	if(vty->status != VTY_CLOSE && vty_output_step(vty)) {
+		vty_prompt(vty);
+	}
+
 	/* N.B. if width is 0, that means we don't know the window size. */
 	if((vty->lines == 0) || (vty->width == 0) || (vty->height == 0)) {
 		flushrc = buffer_flush_available(vty->obuf, vty_sock);
@@ -1495,6 +1559,9 @@ static int vty_flush(struct thread *thread) {
 		case BUFFER_EMPTY:
 			if(vty->status == VTY_CLOSE) {
 				vty_close(vty);
+			} else if(vty->output_func) {
+				/* Everything fit; the show has more. */
+				vty_event(VTY_WRITE, vty_sock, vty);
 			} else {
 				vty->status = VTY_NORMAL;
 				if(vty->lines == 0) {
@@ -1969,14 +2036,60 @@ static int vtysh_flush(struct vty *vty) {
 	return 0;
 }
 
-static int vtysh_read(struct thread *thread) {
+/* Execute the NUL terminated commands in buf, answering each with its
+   status.  Stops at a command whose output is continued and keeps the
+   rest of buf until that is done; returns 1 then, -1 if the vty was
+   closed, 0 otherwise. */
+static int vtysh_execute(struct vty *vty, unsigned char *buf, int nbytes) {
 	int ret;
+	unsigned char *p;
+	u_char header[4] = { 0, 0, 0, 0 };
+
+	for(p = buf; p < buf + nbytes; p++) {
+		vty->buf[vty->length++] = *p;
+		if(*p == '\0') {
+			/* Pass this line to parser. */
+			ret = vty_execute(vty);
+			/* Note that vty_execute clears the command buffer and resets
+	     vty->length to 0. */
+
+			/* Return result. */
+	#ifdef VTYSH_DEBUG
+			printf("result: %d\n", ret);
+			printf("vtysh node: %d\n", vty->node);
+	#endif /* VTYSH_DEBUG */
+
+			if(vty->output_func) {
+				vty->output_status = ret;
+				vty->held_len = buf + nbytes - (p + 1);
+				if(vty->held_len) {
+					vty->held = XMALLOC(MTYPE_VTY, vty->held_len);
+					memcpy(vty->held, p + 1, vty->held_len);
+				}
+				if(!vty->t_write) {
+					vty_event(VTYSH_WRITE, vty->wfd, vty);
+				}
+				return 1;
+			}
+
+			header[3] = ret;
+			buffer_put(vty->obuf, header, 4);
+
+			if(!vty->t_write && (vtysh_flush(vty) < 0)) {
+				/* Try to flush results; exit if a write error occurs. */
+				return -1;
+			}
+		}
+	}
+
+	return 0;
+}
+
+static int vtysh_read(struct thread *thread) {
 	int sock;
 	int nbytes;
 	struct vty *vty;
 	unsigned char buf[VTY_READ_BUFSIZ];
-	unsigned char *p;
-	u_char header[4] = { 0, 0, 0, 0 };
 
 	sock = THREAD_FD(thread);
 	vty = THREAD_ARG(thread);
@@ -2011,28 +2124,9 @@ static int vtysh_read(struct thread *thread) {
 		goto out;
 	}
 
-	for(p = buf; p < buf + nbytes; p++) {
-		vty->buf[vty->length++] = *p;
-		if(*p == '\0') {
-			/* Pass this line to parser. */
-			ret = vty_execute(vty);
-			/* Note that vty_execute clears the command buffer and resets
-	     vty->length to 0. */
-
-			/* Return result. */
-	#ifdef VTYSH_DEBUG
-			printf("result: %d\n", ret);
-			printf("vtysh node: %d\n", vty->node);
-	#endif /* VTYSH_DEBUG */
-
-			header[3] = ret;
-			buffer_put(vty->obuf, header, 4);
-
-			if(!vty->t_write && (vtysh_flush(vty) < 0)) {
-				/* Try to flush results; exit if a write error occurs. */
-				return 0;
-			}
-		}
+	/* Input is not read again until continued output is done. */
+	if(vtysh_execute(vty, buf, nbytes)) {
+		return 0;
 	}
 
 out:
@@ -2043,9 +2137,39 @@ out:
 
 static int vtysh_write(struct thread *thread) {
 	struct vty *vty = THREAD_ARG(thread);
+	u_char header[4] = { 0, 0, 0, 0 };
+	unsigned char *held;
+	int done;
 
 	vty->t_write = NULL;
-	vtysh_flush(vty);
+
+	done = vty->output_func && vty_output_step(vty);
+	if(done) {
+		header[3] = vty->output_status;
+		buffer_put(vty->obuf, header, 4);
+	}
+
+	if(vtysh_flush(vty) < 0) {
+		return 0;
+	}
+
+	if(vty->output_func) {
+		if(!vty->t_write) {
+			vty_event(VTYSH_WRITE, vty->wfd, vty);
+		}
+	} else if(done) {
+		/* Pick up the input that arrived with the continued command. */
+		held = vty->held;
+		vty->held = NULL;
+		if(held) {
+			done = vtysh_execute(vty, held, vty->held_len);
+			XFREE(MTYPE_VTY, held);
+			if(done) {
+				return 0;
+			}
+		}
+		vty_event(VTYSH_READ, vty->fd, vty);
+	}
 	return 0;
 }
 
@@ -2085,6 +2209,12 @@ void vty_close(struct vty *vty) {
 		thread_cancel(vty->t_timeout);
 	}
 
+	/* Abandon continued output. */
+	vty_output_end(vty);
+	if(vty->held) {
+		XFREE(MTYPE_VTY, vty->held);
+	}
+
 	/* Flush buffer. */
 	buffer_flush_all(vty->obuf, vty->wfd);
 
@@ -2159,8 +2289,10 @@ static void vty_read_file(FILE *confp) {
 	vty->type = VTY_FILE;
 	vty->node = CONFIG_NODE;
 
-	/* Execute configuration file */
+	/* Execute configuration file, its policy updates done once */
+	cmd_batch_begin(vty);
 	ret = config_from_file(vty, confp, &line_num);
+	cmd_batch_commit(vty);
 
 	/* Flush any previous errors before printing messages below */
 	buffer_flush_all(vty->obuf, vty->fd);
@@ -2379,6 +2511,7 @@ int vty_config_lock(struct vty *vty) {
 }
 
 int vty_config_unlock(struct vty *vty) {
+	cmd_batch_commit(vty);
 	if(vty_config == 1 && vty->config == 1) {
 		vty->config = 0;
 		vty_config = 0;
@@ -121,6 +121,9 @@ struct vty {
 	/* In configure mode. */
 	int config;
 
+	/* Has a configuration batch open. */
+	int config_batch;
+
 	/* Read and write thread. */
 	struct thread *t_read;
 	struct thread *t_write;
@@ -131,6 +134,17 @@ struct vty {
 
 	/* What address is this vty comming from. */
 	char address[SU_ADDRSTRLEN];
+
+	/* Rest of a show command's output, produced as the output buffer
+	   drains; see vty_output_continue(). */
+	int (*output_func)(struct vty *, void *);
+	void (*output_clean)(void *);
+	void *output_arg;
+	int output_status;
+
+	/* vtysh input held back until that output is complete. */
+	u_char *held;
+	int held_len;
 };
 
 /* Integrated configuration file. */
@@ -145,6 +159,9 @@ struct vty {
 /* Vty read buffer size. */
 #define VTY_READ_BUFSIZ 512
 
+/* Output buffered at which a long show command should yield. */
+#define VTY_OUTPUT_WATERMARK (64 * 1024)
+
 /* Directory separator. */
 #ifndef DIRECTORY_SEP
 	#define DIRECTORY_SEP '/'
@@ -244,6 +261,9 @@ extern void vty_reset(void);
 extern struct vty *vty_new(void);
 extern struct vty *vty_stdio(void (*atclose)(void));
 extern int vty_out(struct vty *, const char *, ...) PRINTF_ATTRIBUTE(2, 3);
+extern void vty_out_raw(struct vty *, const void *, size_t);
+extern int vty_output_full(struct vty *);
+extern void vty_output_continue(struct vty *, int (*func)(struct vty *, void *), void (*clean)(void *), void *arg);
 extern void vty_read_config(char *, char *);
 extern void vty_time_print(struct vty *, int);
 extern void vty_serv_sock(const char *, unsigned short, const char *);
@@ -0,0 +1,425 @@
+/*
+ * Quagga Work Pools: worker threads for CPU-only jobs.
+ *
+ * This file is part of Quagga.
+ *
+ * Quagga is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2, or (at your option) any
+ * later version.
+ *
+ * Quagga is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Quagga; see the file COPYING.  If not, write to the Free
+ * Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ * 02111-1307, USA.
+ */
+
+#include <zebra.h>
+
+#ifdef HAVE_PTHREAD
+	#include <pthread.h>
+#endif
+#ifdef HAVE_SYS_EVENTFD_H
+	#include <sys/eventfd.h>
+#endif
+
+#include "thread.h"
+#include "memory.h"
+#include "linklist.h"
+#include "command.h"
+#include "log.h"
+#include "network.h"
+#include "workpool.h"
+#include "placement.h"
+
+struct work_pool_job {
+	struct work_pool_job *next;
+	work_pool_func run;
+	work_pool_func done;
+	void *arg;
+
+	/* jobs of work_pool_run() left to run, protected by mtx */
+	unsigned int *batch;
+};
+
+struct work_pool {
+	struct thread_master *master;
+	char *name;
+	unsigned int workers;
+
+	/* Jobs waiting for a worker, FIFO, protected by mtx */
+	struct work_pool_job *head;
+	struct work_pool_job *tail;
+	int shutdown;
+
+	/* work_pool_submit() jobs queued or running, protected by mtx */
+	unsigned int busy;
+
+	/* Finished jobs.  Workers push onto this lock-free stack, the
+	 * master takes the whole of it at once with an atomic exchange. */
+	struct work_pool_job *finished;
+
+	/* Wakeup for the master: an eventfd, or a pipe where there is
+	 * none, written by whichever worker finds 'finished' empty. */
+	int wakeup[2];
+	struct thread *t_finished;
+
+	/* stats, master only */
+	unsigned long submitted;
+	unsigned long completed;
+	unsigned long worst_batch;
+
+#ifdef HAVE_PTHREAD
+	pthread_mutex_t mtx;
+	pthread_cond_t cond;
+	pthread_cond_t batch_cond;
+	pthread_t *threads;
+#endif
+};
+
+/* master list of work_pools */
+static struct list _work_pools;
+static struct list *work_pools = &_work_pools;
+
+static int work_pool_finished(struct thread *);
+
+/* Push a finished job, and wake the master if it may be asleep on an
+ * empty stack.  Callable from any thread. */
+static void work_pool_finish(struct work_pool *pool, struct work_pool_job *job) {
+	struct work_pool_job *old = __atomic_load_n(&pool->finished, __ATOMIC_RELAXED);
+
+	do {
+		job->next = old;
+	} while(!__atomic_compare_exchange_n(&pool->finished, &old, job, 1, __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+
+	if(old == NULL) {
+		uint64_t one = 1;
+		ssize_t ret;
+
+		do {
+			ret = write(pool->wakeup[1], &one, sizeof(one));
+		} while(ret < 0 && errno == EINTR);
+	}
+}
+
+/* Called on the master whenever the wakeup fd is readable: run the 'done'
+ * callbacks of everything finished so far, in submission order as far as
+ * each worker is concerned. */
+static void work_pool_collect(struct work_pool *pool) {
+	struct work_pool_job *job, *next, *list = NULL;
+	unsigned long batch = 0;
+	uint64_t buf[16];
+
+	/* drain the wakeup first, so a push racing with us re-arms it */
+	while(read(pool->wakeup[0], buf, sizeof(buf)) > 0) {
+		;
+	}
+
+	job = __atomic_exchange_n(&pool->finished, NULL, __ATOMIC_ACQUIRE);
+	for(; job; job = next) {
+		next = job->next;
+		job->next = list;
+		list = job;
+	}
+
+	for(job = list; job; job = next) {
+		next = job->next;
+		pool->completed++;
+		if(job->done) {
+			job->done(job->arg);
+		}
+		XFREE(MTYPE_WORK_POOL_JOB, job);
+		batch++;
+	}
+
+	if(batch > pool->worst_batch) {
+		pool->worst_batch = batch;
+	}
+}
+
+static int work_pool_finished(struct thread *thread) {
+	struct work_pool *pool = THREAD_ARG(thread);
+
+	pool->t_finished = NULL;
+	work_pool_collect(pool);
+	pool->t_finished = thread_add_read(pool->master, work_pool_finished, pool, pool->wakeup[0]);
+	return 0;
+}
+
+#ifdef HAVE_PTHREAD
+/* Count a job as run, waking work_pool_run() or work_pool_wait() callers
+ * on the last one they wait for */
+static void work_pool_batch_done(struct work_pool *pool, unsigned int *batch) {
+	pthread_mutex_lock(&pool->mtx);
+	if(batch ? --(*batch) == 0 : --pool->busy == 0) {
+		pthread_cond_broadcast(&pool->batch_cond);
+	}
+	pthread_mutex_unlock(&pool->mtx);
+}
+
+static void *work_pool_worker(void *arg) {
+	struct work_pool *pool = arg;
+	struct work_pool_job *job;
+	unsigned int *batch;
+
+	thread_placement_enter(THREAD_PLACE_WORKERS, pool->name);
+
+	pthread_mutex_lock(&pool->mtx);
+	while(!pool->shutdown) {
+		if(!pool->head) {
+			pthread_cond_wait(&pool->cond, &pool->mtx);
+			continue;
+		}
+
+		job = pool->head;
+		pool->head = job->next;
+		if(!pool->head) {
+			pool->tail = NULL;
+		}
+		pthread_mutex_unlock(&pool->mtx);
+
+		thread_placement_check();
+		batch = job->batch;
+		job->run(job->arg);
+		/* pushed before it is counted, for work_pool_wait() */
+		work_pool_finish(pool, job);
+		work_pool_batch_done(pool, batch);
+
+		pthread_mutex_lock(&pool->mtx);
+	}
+	pthread_mutex_unlock(&pool->mtx);
+
+	thread_placement_leave();
+	return NULL;
+}
+
+static unsigned int work_pool_start(struct work_pool *pool) {
+	sigset_t all, old;
+	unsigned int i;
+
+	pthread_mutex_init(&pool->mtx, NULL);
+	pthread_cond_init(&pool->cond, NULL);
+	pthread_cond_init(&pool->batch_cond, NULL);
+	pool->threads = XCALLOC(MTYPE_WORK_POOL, sizeof(pthread_t) * pool->workers);
+
+	/* Signals are for the master's sigevent handling only; workers
+	 * inherit this mask. */
+	sigfillset(&all);
+	pthread_sigmask(SIG_BLOCK, &all, &old);
+
+	for(i = 0; i < pool->workers; i++) {
+		int err = pthread_create(&pool->threads[i], NULL, work_pool_worker, pool);
+
+		if(err != 0) {
+			zlog_warn("%s: can't start worker %u for pool %s: %s", __func__, i, pool->name, safe_strerror(err));
+			break;
+		}
+	}
+
+	pthread_sigmask(SIG_SETMASK, &old, NULL);
+	return i;
+}
+
+static void work_pool_stop(struct work_pool *pool) {
+	struct work_pool_job *job;
+	unsigned int i;
+
+	pthread_mutex_lock(&pool->mtx);
+	pool->shutdown = 1;
+	pthread_cond_broadcast(&pool->cond);
+	pthread_mutex_unlock(&pool->mtx);
+
+	for(i = 0; i < pool->workers; i++) {
+		pthread_join(pool->threads[i], NULL);
+	}
+
+	while((job = pool->head) != NULL) {
+		pool->head = job->next;
+		XFREE(MTYPE_WORK_POOL_JOB, job);
+	}
+	pool->tail = NULL;
+
+	XFREE(MTYPE_WORK_POOL, pool->threads);
+	pthread_cond_destroy(&pool->batch_cond);
+	pthread_cond_destroy(&pool->cond);
+	pthread_mutex_destroy(&pool->mtx);
+}
+#endif /* HAVE_PTHREAD */
+
+struct work_pool *work_pool_new(struct thread_master *m, const char *name, unsigned int workers) {
+	struct work_pool *pool;
+
+	pool = XCALLOC(MTYPE_WORK_POOL, sizeof(struct work_pool));
+	pool->master = m;
+	pool->name = XSTRDUP(MTYPE_WORK_QUEUE_NAME, name);
+
+#ifdef HAVE_SYS_EVENTFD_H
+	pool->wakeup[0] = pool->wakeup[1] = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	if(pool->wakeup[0] < 0) {
+#else
+	if(pipe(pool->wakeup) < 0) {
+#endif
+		zlog_err("%s: can't create wakeup for pool %s: %s", __func__, name, safe_strerror(errno));
+		XFREE(MTYPE_WORK_QUEUE_NAME, pool->name);
+		XFREE(MTYPE_WORK_POOL, pool);
+		return NULL;
+	}
+#ifndef HAVE_SYS_EVENTFD_H
+	set_nonblocking(pool->wakeup[0]);
+	set_nonblocking(pool->wakeup[1]);
+#endif
+
+#ifdef HAVE_PTHREAD
+	pool->workers = workers;
+	if(pool->workers) {
+		pool->workers = work_pool_start(pool);
+	}
+#endif
+
+	pool->t_finished = thread_add_read(m, work_pool_finished, pool, pool->wakeup[0]);
+	listnode_add(work_pools, pool);
+
+	return pool;
+}
+
+void work_pool_free(struct work_pool *pool) {
+	struct work_pool_job *job, *next;
+
+#ifdef HAVE_PTHREAD
+	work_pool_stop(pool);
+#endif
+	THREAD_OFF(pool->t_finished);
+
+	for(job = pool->finished; job; job = next) {
+		next = job->next;
+		XFREE(MTYPE_WORK_POOL_JOB, job);
+	}
+
+	close(pool->wakeup[0]);
+	if(pool->wakeup[1] != pool->wakeup[0]) {
+		close(pool->wakeup[1]);
+	}
+
+	listnode_delete(work_pools, pool);
+	XFREE(MTYPE_WORK_QUEUE_NAME, pool->name);
+	XFREE(MTYPE_WORK_POOL, pool);
+}
+
+void work_pool_submit(struct work_pool *pool, work_pool_func run, work_pool_func done, void *arg) {
+	struct work_pool_job *job;
+
+	job = XCALLOC(MTYPE_WORK_POOL_JOB, sizeof(struct work_pool_job));
+	job->run = run;
+	job->done = done;
+	job->arg = arg;
+	pool->submitted++;
+
+#ifdef HAVE_PTHREAD
+	if(pool->workers) {
+		pthread_mutex_lock(&pool->mtx);
+		if(pool->tail) {
+			pool->tail->next = job;
+		} else {
+			pool->head = job;
+		}
+		pool->tail = job;
+		pool->busy++;
+		pthread_cond_signal(&pool->cond);
+		pthread_mutex_unlock(&pool->mtx);
+		return;
+	}
+#endif
+
+	job->run(job->arg);
+	work_pool_finish(pool, job);
+}
+
+void work_pool_run(struct work_pool *pool, work_pool_func run, void **args, unsigned int n) {
+	unsigned int i;
+
+#ifdef HAVE_PTHREAD
+	if(pool->workers && n > 1) {
+		struct work_pool_job *job;
+		unsigned int remaining = n;
+
+		pthread_mutex_lock(&pool->mtx);
+		for(i = 0; i < n; i++) {
+			job = XCALLOC(MTYPE_WORK_POOL_JOB, sizeof(struct work_pool_job));
+			job->run = run;
+			job->arg = args[i];
+			job->batch = &remaining;
+			if(pool->tail) {
+				pool->tail->next = job;
+			} else {
+				pool->head = job;
+			}
+			pool->tail = job;
+		}
+		pool->submitted += n;
+		pthread_cond_broadcast(&pool->cond);
+
+		/* take a share of the jobs, rather than just wait */
+		while(remaining) {
+			job = pool->head;
+			if(job == NULL || job->batch != &remaining) {
+				pthread_cond_wait(&pool->batch_cond, &pool->mtx);
+				continue;
+			}
+
+			pool->head = job->next;
+			if(!pool->head) {
+				pool->tail = NULL;
+			}
+			pthread_mutex_unlock(&pool->mtx);
+
+			job->run(job->arg);
+			work_pool_finish(pool, job);
+
+			pthread_mutex_lock(&pool->mtx);
+			remaining--;
+		}
+		pthread_mutex_unlock(&pool->mtx);
+		return;
+	}
+#endif
+
+	for(i = 0; i < n; i++) {
+		run(args[i]);
+	}
+}
+
+void work_pool_wait(struct work_pool *pool) {
+#ifdef HAVE_PTHREAD
+	if(pool->workers) {
+		pthread_mutex_lock(&pool->mtx);
+		while(pool->busy) {
+			pthread_cond_wait(&pool->batch_cond, &pool->mtx);
+		}
+		pthread_mutex_unlock(&pool->mtx);
+	}
+#endif
+	work_pool_collect(pool);
+}
+
+unsigned int work_pool_pending(struct work_pool *pool) {
+	return pool->submitted - pool->completed;
+}
+
+void work_pool_show(struct vty *vty) {
+	struct listnode *node;
+	struct work_pool *pool;
+
+	if(!listcount(work_pools)) {
+		return;
+	}
+
+	vty_out(vty, "%s%7s %8s %10s %10s %5s %s%s", VTY_NEWLINE, "Workers", "Pending", "Submitted", "Completed", "Batch", "Pool", VTY_NEWLINE);
+	for(ALL_LIST_ELEMENTS_RO(work_pools, node, pool)) {
+		vty_out(vty, "%7u %8u %10lu %10lu %5lu %s%s", pool->workers, work_pool_pending(pool), pool->submitted, pool->completed, pool->worst_batch, pool->name, VTY_NEWLINE);
+	}
+}
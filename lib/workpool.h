@@ -0,0 +1,71 @@
+/*
+ * Quagga Work Pools: worker threads for CPU-only jobs.
+ *
+ * This file is part of Quagga.
+ *
+ * Quagga is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2, or (at your option) any
+ * later version.
+ *
+ * Quagga is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Quagga; see the file COPYING.  If not, write to the Free
+ * Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ * 02111-1307, USA.
+ */
+
+#ifndef _QUAGGA_WORK_POOL_H
+#define _QUAGGA_WORK_POOL_H
+
+/* A work pool runs jobs on a set of worker threads and hands the results
+ * back to the thread_master it was created on.
+ *
+ * A job's 'run' function is executed on a worker thread.  It must only
+ * do pure computation on data it owns for the duration of the job: no
+ * XMALLOC/XFREE of memtypes on the slab allocator (mtype_slab_init()),
+ * no zlog, no thread_add_*, no access to shared daemon state.  Its 'done'
+ * function is then called from the thread_master, like any other thread
+ * callback, and may do all of those.
+ *
+ * Without pthread support, or with zero workers, 'run' is executed
+ * inline at submission and 'done' is still called asynchronously.
+ */
+
+struct work_pool;
+struct vty;
+
+typedef void (*work_pool_func)(void *arg);
+
+/* create a pool of 'workers' threads, of given name, attached to master */
+extern struct work_pool *work_pool_new(struct thread_master *, const char *name, unsigned int workers);
+/* destroy the pool.  Blocks until running jobs finish; jobs that haven't
+ * completed yet are dropped without calling 'done'.  Must not be called
+ * from one of the pool's own 'done' callbacks. */
+extern void work_pool_free(struct work_pool *);
+
+/* Queue a job.  'done' is optional. */
+extern void work_pool_submit(struct work_pool *, work_pool_func run, work_pool_func done, void *arg);
+
+/* Run 'run' on each of the n args, spread over the workers and the
+ * calling thread, and return once all of them have run.  As the caller
+ * does nothing else meanwhile, the jobs may read shared daemon state,
+ * but the other rules above still hold. */
+extern void work_pool_run(struct work_pool *, work_pool_func run, void **args, unsigned int n);
+
+/* Block until every job submitted so far has run, and call the 'done'
+ * of those not called yet, from the caller.  Must not be called from one
+ * of the pool's own 'done' callbacks. */
+extern void work_pool_wait(struct work_pool *);
+
+/* # of jobs submitted whose 'done' hasn't been called yet */
+extern unsigned int work_pool_pending(struct work_pool *);
+
+/* Helpers, exported for workqueue.c */
+extern void work_pool_show(struct vty *);
+
+#endif /* _QUAGGA_WORK_POOL_H */
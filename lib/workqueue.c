@@ -25,6 +25,7 @@
 #include "thread.h"
 #include "memory.h"
 #include "workqueue.h"
+#include "workpool.h"
 #include "linklist.h"
 #include "command.h"
 #include "log.h"
@@ -38,6 +39,43 @@ static struct list *work_queues = &_work_queues;
 
 #define WORK_QUEUE_MIN_GRANULARITY 1
 
+/* Weight of a new sample in the per-item cost average, as a shift */
+#define WORK_QUEUE_EWMA_SHIFT 3
+
+static unsigned long work_queue_elapsed(struct thread *thread) {
+	struct timeval now;
+
+	quagga_gettime(QUAGGA_CLK_MONOTONIC, &now);
+	return timeval_elapsed(now, thread->real);
+}
+
+static void work_queue_cost_update(struct work_queue *wq, unsigned long usec, unsigned int items) {
+	unsigned long sample;
+
+	if(!items) {
+		return;
+	}
+	sample = usec * 1000 / items;
+	if(!wq->slice.item_nsec) {
+		wq->slice.item_nsec = sample;
+	} else if(sample > wq->slice.item_nsec) {
+		wq->slice.item_nsec += (sample - wq->slice.item_nsec) >> WORK_QUEUE_EWMA_SHIFT;
+	} else {
+		wq->slice.item_nsec -= (wq->slice.item_nsec - sample) >> WORK_QUEUE_EWMA_SHIFT;
+	}
+}
+
+/* # of items expected to fit in 'usec', at least one */
+static unsigned int work_queue_batch(struct work_queue *wq, unsigned long usec) {
+	unsigned long items;
+
+	if(!wq->slice.item_nsec) {
+		return WORK_QUEUE_MIN_GRANULARITY;
+	}
+	items = usec * 1000 / wq->slice.item_nsec;
+	return (items > 0) ? MIN(items, UINT_MAX) : 1;
+}
+
 static struct work_queue_item *work_queue_item_new(struct work_queue *wq) {
 	struct work_queue_item *item;
 	assert(wq);
@@ -165,6 +203,14 @@ DEFUN(show_work_queues, show_work_queues_cmd, "show work-queues", SHOW_STR "Work
 			wq->cycles.granularity, (wq->runs) ? (unsigned int) (wq->cycles.total / wq->runs) : 0, wq->worst_usec, wq->name, VTY_NEWLINE);
 	}
 
+	vty_out(vty, "%s%8s %8s %8s %9s %8s %s%s", VTY_NEWLINE, "Slice", "Last", "Avg.", "Item", "Over-", "", VTY_NEWLINE);
+	vty_out(vty, "%8s %8s %8s %9s %8s %s%s", "(us)", "(us)", "(us)", "(ns)", "runs", "Name", VTY_NEWLINE);
+	for(ALL_LIST_ELEMENTS_RO(work_queues, node, wq)) {
+		vty_out(vty, "%8lu %8lu %8lu %9lu %8lu %s%s", wq->spec.timeslice, wq->slice.last_usec, (wq->runs) ? wq->slice.total_usec / wq->runs : 0, wq->slice.item_nsec, wq->slice.overruns, wq->name, VTY_NEWLINE);
+	}
+
+	work_pool_show(vty);
+
 	return CMD_SUCCESS;
 }
 
@@ -198,9 +244,11 @@ void work_queue_unplug(struct work_queue *wq) {
 int work_queue_run(struct thread *thread) {
 	struct work_queue *wq;
 	struct work_queue_item *item;
-	unsigned long took;
+	unsigned long took = 0;
 	wq_item_status ret;
 	unsigned int cycles = 0;
+	unsigned int batch, mark = 0;
+	unsigned long marked = 0;
 	struct listnode *node, *nnode;
 	char yielded = 0;
 
@@ -232,6 +280,15 @@ int work_queue_run(struct thread *thread) {
 		wq->cycles.granularity = WORK_QUEUE_MIN_GRANULARITY;
 	}
 
+	/* In latency-target mode, check the clock only after as many items
+   * as should fit in the time slice, going by the average cost so far.
+   */
+	batch = wq->spec.timeslice ? work_queue_batch(wq, wq->spec.timeslice) : 0;
+
+	if(wq->spec.run_begin) {
+		wq->spec.run_begin(wq);
+	}
+
 	for(ALL_LIST_ELEMENTS(wq->items, node, nnode, item)) {
 		assert(item && item->data);
 
@@ -267,6 +324,11 @@ int work_queue_run(struct thread *thread) {
 				{
 					item->ran--;
 					work_queue_item_requeue(wq, node);
+					/* an item alone on the queue, such as a meta-queue, runs
+					   on until the yield, not once per thread run */
+					if(nnode == NULL) {
+						nnode = node;
+					}
 					break;
 				}
 			case WQ_RETRY_NOW:
@@ -290,7 +352,25 @@ int work_queue_run(struct thread *thread) {
 		cycles++;
 
 		/* test if we should yield */
-		if(!(cycles % wq->cycles.granularity) && (took = thread_should_yield(thread))) {
+		if(batch) {
+			unsigned long elapsed;
+
+			if(cycles < batch) {
+				continue;
+			}
+
+			elapsed = work_queue_elapsed(thread);
+			work_queue_cost_update(wq, elapsed - marked, cycles - mark);
+			mark = cycles;
+			marked = elapsed;
+
+			if(elapsed >= wq->spec.timeslice || wq->spec.timeslice - elapsed < wq->slice.item_nsec / 1000) {
+				took = elapsed;
+				yielded = 1;
+				goto stats;
+			}
+			batch = cycles + work_queue_batch(wq, wq->spec.timeslice - elapsed);
+		} else if(!(cycles % wq->cycles.granularity) && (took = thread_should_yield(thread))) {
 			yielded = 1;
 			goto stats;
 		}
@@ -298,6 +378,15 @@ int work_queue_run(struct thread *thread) {
 
 stats:
 
+	wq->slice.last_usec = work_queue_elapsed(thread);
+	wq->slice.total_usec += wq->slice.last_usec;
+	if(cycles > mark) {
+		work_queue_cost_update(wq, wq->slice.last_usec - marked, cycles - mark);
+	}
+	if(wq->spec.timeslice && wq->slice.last_usec > wq->spec.timeslice) {
+		wq->slice.overruns++;
+	}
+
 #define WQ_HYSTERESIS_FACTOR 4
 
 	if(cycles > wq->cycles.best) {
@@ -344,5 +433,9 @@ stats:
 		wq->spec.completion_func(wq);
 	}
 
+	if(wq->spec.run_end) {
+		wq->spec.run_end(wq);
+	}
+
 	return 0;
 }
@@ -77,10 +77,21 @@ struct work_queue {
 		/* completion callback, called when queue is emptied, optional */
 		void (*completion_func)(struct work_queue *);
 
+		/* called before and after each run of the queue, completion
+     * callback included, optional */
+		void (*run_begin)(struct work_queue *);
+		void (*run_end)(struct work_queue *);
+
 		/* max number of retries to make for item that errors */
 		unsigned int max_retries;
 
 		unsigned int hold; /* hold time for first run, in ms */
+
+		/* Latency target for a single run, in usec.  When set, batch
+     * sizes are derived from the measured per-item cost instead of
+     * the granularity heuristic.  0 disables.
+     */
+		unsigned long timeslice;
 	} spec;
 
 	/* remaining fields should be opaque to users */
@@ -95,6 +106,13 @@ struct work_queue {
 		unsigned long total;
 	} cycles; /* cycle counts */
 
+	struct {
+		unsigned long item_nsec;  /* EWMA of per-item cost */
+		unsigned long last_usec;  /* length of the last run */
+		unsigned long total_usec; /* all runs */
+		unsigned long overruns;	  /* runs which went past spec.timeslice */
+	} slice; /* time slice stats */
+
 	/* private state */
 	u_int16_t flags; /* user set flag */
 };
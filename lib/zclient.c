@@ -33,6 +33,7 @@
 #include "zclient.h"
 #include "memory.h"
 #include "table.h"
+#include "zring.h"
 
 /* Zebra client events. */
 enum event {
@@ -55,7 +56,9 @@ struct zclient *zclient_new(struct thread_master *master) {
 	zclient = XCALLOC(MTYPE_ZCLIENT, sizeof(struct zclient));
 
 	zclient->ibuf = stream_new(ZEBRA_MAX_PACKET_SIZ);
+	zclient->rbuf = stream_new(ZCLIENT_READ_BUF_SIZ);
 	zclient->obuf = stream_new(ZEBRA_MAX_PACKET_SIZ);
+	zclient->bulk = stream_new(ZEBRA_MAX_PACKET_SIZ);
 	zclient->wb = buffer_new(0);
 	zclient->master = master;
 
@@ -71,12 +74,24 @@ void zclient_free(struct zclient *zclient) {
 	if(zclient->ibuf) {
 		stream_free(zclient->ibuf);
 	}
+	if(zclient->rbuf) {
+		stream_free(zclient->rbuf);
+	}
 	if(zclient->obuf) {
 		stream_free(zclient->obuf);
 	}
+	if(zclient->bulk) {
+		stream_free(zclient->bulk);
+	}
 	if(zclient->wb) {
 		buffer_free(zclient->wb);
 	}
+	if(zclient->ring) {
+		zring_free(zclient->ring);
+	}
+	if(zclient->ring_fifo) {
+		stream_fifo_free(zclient->ring_fifo);
+	}
 
 	XFREE(MTYPE_ZCLIENT, zclient);
 }
@@ -124,10 +139,26 @@ void zclient_stop(struct zclient *zclient) {
 	THREAD_OFF(zclient->t_read);
 	THREAD_OFF(zclient->t_connect);
 	THREAD_OFF(zclient->t_write);
+	THREAD_OFF(zclient->t_ring);
+
+	/* Drop the ring, and what waits for room in it. */
+	if(zclient->ring) {
+		zring_free(zclient->ring);
+		zclient->ring = NULL;
+	}
+	if(zclient->ring_fifo) {
+		stream_fifo_free(zclient->ring_fifo);
+		zclient->ring_fifo = NULL;
+	}
+	zclient->ring_state = 0;
 
 	/* Reset streams. */
 	stream_reset(zclient->ibuf);
+	stream_reset(zclient->rbuf);
 	stream_reset(zclient->obuf);
+	stream_reset(zclient->bulk);
+	zclient->bulk_count = 0;
+	zclient->route_batch = 0;
 
 	/* Empty the write buffer. */
 	buffer_reset(zclient->wb);
@@ -244,6 +275,8 @@ static int zclient_failed(struct zclient *zclient) {
 	return -1;
 }
 
+static int zclient_bulk_close(struct zclient *);
+
 static int zclient_flush_data(struct thread *thread) {
 	struct zclient *zclient = THREAD_ARG(thread);
 
@@ -251,6 +284,9 @@ static int zclient_flush_data(struct thread *thread) {
 	if(zclient->sock < 0) {
 		return -1;
 	}
+	if(zclient_bulk_close(zclient) < 0) {
+		return -1;
+	}
 	switch(buffer_flush_available(zclient->wb, zclient->sock)) {
 		case BUFFER_ERROR:
 			zlog_warn("%s: buffer_flush_available failed on zclient fd %d, closing", __func__, zclient->sock);
@@ -262,11 +298,8 @@ static int zclient_flush_data(struct thread *thread) {
 	return 0;
 }
 
-int zclient_send_message(struct zclient *zclient) {
-	if(zclient->sock < 0) {
-		return -1;
-	}
-	switch(buffer_write(zclient->wb, zclient->sock, STREAM_DATA(zclient->obuf), stream_get_endp(zclient->obuf))) {
+static int zclient_socket_send(struct zclient *zclient, struct stream *s) {
+	switch(buffer_write(zclient->wb, zclient->sock, STREAM_DATA(s), stream_get_endp(s))) {
 		case BUFFER_ERROR:
 			zlog_warn("%s: buffer_write failed to zclient fd %d, closing", __func__, zclient->sock);
 			return zclient_failed(zclient);
@@ -277,6 +310,255 @@ int zclient_send_message(struct zclient *zclient) {
 	return 0;
 }
 
+static int zclient_ring_flush(struct thread *);
+
+/* Wait for room for s in the ring */
+static void zclient_ring_wait(struct zclient *zclient, struct stream *s) {
+	if(zring_sleep_space(zclient->ring, stream_get_endp(s))) {
+		zclient->t_ring = thread_add_read(zclient->master, zclient_ring_flush, zclient, zclient->ring->space_fd);
+	} else {
+		zclient->t_ring = thread_add_event(zclient->master, zclient_ring_flush, zclient, 0);
+	}
+}
+
+/* Move the messages waiting for room into the ring, in order */
+static int zclient_ring_flush(struct thread *thread) {
+	struct zclient *zclient = THREAD_ARG(thread);
+	struct stream *s;
+
+	zclient->t_ring = NULL;
+	while((s = stream_fifo_head(zclient->ring_fifo)) != NULL) {
+		if(zring_put(zclient->ring, STREAM_DATA(s), stream_get_endp(s)) < 0) {
+			zclient_ring_wait(zclient, s);
+			break;
+		}
+		stream_free(stream_fifo_pop(zclient->ring_fifo));
+	}
+	return 0;
+}
+
+/* Send s through the ring once zebra reads from it, else the socket */
+static int zclient_send_stream(struct zclient *zclient, struct stream *s) {
+	if(zclient->ring_state != ZSERV_RING_START) {
+		return zclient_socket_send(zclient, s);
+	}
+	if(stream_fifo_head(zclient->ring_fifo) == NULL && zring_put(zclient->ring, STREAM_DATA(s), stream_get_endp(s)) == 0) {
+		return 0;
+	}
+	stream_fifo_push(zclient->ring_fifo, stream_dup(s));
+	if(!zclient->t_ring) {
+		zclient_ring_wait(zclient, s);
+	}
+	return 0;
+}
+
+/* Offer zebra a ring, passing its descriptors along with the message.
+ * A zebra that doesn't know of rings ignores it, and the socket stays in
+ * use. */
+static void zclient_ring_offer(struct zclient *zclient) {
+	struct stream *s = zclient->obuf;
+	struct sockaddr_storage ss;
+	socklen_t sslen = sizeof(ss);
+	struct zring *ring;
+	struct msghdr msg;
+	struct iovec iov;
+	struct cmsghdr *cmsg;
+	union {
+		char buf[CMSG_SPACE(sizeof(int) * 3)];
+		struct cmsghdr align;
+	} control;
+	int fds[3];
+	ssize_t nbytes;
+
+	if(!zclient->ring_size || !buffer_empty(zclient->wb)) {
+		return;
+	}
+	/* descriptors only go through UNIX sockets */
+	if(getsockname(zclient->sock, (struct sockaddr *) &ss, &sslen) < 0 || ss.ss_family != AF_UNIX) {
+		return;
+	}
+	if((ring = zring_new(zclient->ring_size)) == NULL) {
+		return;
+	}
+
+	stream_reset(s);
+	zclient_create_header(s, ZEBRA_SHM_RING, VRF_DEFAULT);
+	stream_putc(s, ZSERV_RING_OFFER);
+	stream_putl(s, zclient->ring_size);
+	stream_putw_at(s, 0, stream_get_endp(s));
+
+	fds[0] = ring->mem_fd;
+	fds[1] = ring->data_fd;
+	fds[2] = ring->space_fd;
+	memset(&msg, 0, sizeof(msg));
+	memset(&control, 0, sizeof(control));
+	iov.iov_base = STREAM_DATA(s);
+	iov.iov_len = stream_get_endp(s);
+	msg.msg_iov = &iov;
+	msg.msg_iovlen = 1;
+	msg.msg_control = control.buf;
+	msg.msg_controllen = sizeof(control.buf);
+	cmsg = CMSG_FIRSTHDR(&msg);
+	cmsg->cmsg_level = SOL_SOCKET;
+	cmsg->cmsg_type = SCM_RIGHTS;
+	cmsg->cmsg_len = CMSG_LEN(sizeof(fds));
+	memcpy(CMSG_DATA(cmsg), fds, sizeof(fds));
+
+	if((nbytes = sendmsg(zclient->sock, &msg, 0)) < 0) {
+		zlog_warn("%s: can't pass the ring to zebra: %s", __func__, safe_strerror(errno));
+		zring_free(ring);
+		return;
+	}
+	if((size_t) nbytes < stream_get_endp(s)) {
+		buffer_put(zclient->wb, STREAM_DATA(s) + nbytes, stream_get_endp(s) - nbytes);
+		THREAD_WRITE_ON(zclient->master, zclient->t_write, zclient_flush_data, zclient, zclient->sock);
+	}
+
+	/* zebra has a descriptor of its own now, if it wants one */
+	close(ring->mem_fd);
+	ring->mem_fd = -1;
+	zclient->ring = ring;
+	zclient->ring_state = ZSERV_RING_OFFER;
+}
+
+/* zebra's answer to the ring offered */
+static void zclient_ring_answer(struct zclient *zclient) {
+	u_char state = stream_getc(zclient->ibuf);
+
+	if(zclient->ring_state != ZSERV_RING_OFFER) {
+		return;
+	}
+	if(state != ZSERV_RING_ACCEPT) {
+		zlog_info("zebra refused the ring, using the socket");
+		zring_free(zclient->ring);
+		zclient->ring = NULL;
+		zclient->ring_state = 0;
+		return;
+	}
+
+	/* the last message through the socket; everything after it goes
+	 * through the ring */
+	stream_reset(zclient->obuf);
+	zclient_create_header(zclient->obuf, ZEBRA_SHM_RING, VRF_DEFAULT);
+	stream_putc(zclient->obuf, ZSERV_RING_START);
+	stream_putw_at(zclient->obuf, 0, stream_get_endp(zclient->obuf));
+	zclient_send_message(zclient);
+
+	zclient->ring_fifo = stream_fifo_new();
+	zclient->ring_state = ZSERV_RING_START;
+	if(zclient_debug) {
+		zlog_debug("zclient sends through a ring of %u bytes", zclient->ring_size);
+	}
+}
+
+/* Queue the bulk message held back, if any, behind what is pending */
+static int zclient_bulk_close(struct zclient *zclient) {
+	struct stream *s = zclient->bulk;
+
+	if(zclient->bulk_count == 0) {
+		return 0;
+	}
+	stream_putw_at(s, 0, stream_get_endp(s));
+	stream_putw_at(s, zclient->bulk_count_at, zclient->bulk_count);
+	zclient->bulk_count = 0;
+	return zclient_send_stream(zclient, s);
+}
+
+int zclient_send_message(struct zclient *zclient) {
+	if(zclient->sock < 0) {
+		return -1;
+	}
+	/* after the routes held back, in order */
+	if(zclient_bulk_close(zclient) < 0) {
+		return -1;
+	}
+	return zclient_send_stream(zclient, zclient->obuf);
+}
+
+/* Send the route add or delete in obuf, as built by zapi_ipv4_route() or
+ * zapi_ipv6_route(): header, type, flags, message, safi, prefix, then
+ * the rest.  While zebra is behind on reading, it is merged into the
+ * ZEBRA_ROUTE_BULK held back instead, if that can take it:
+ *
+ *   command, type, flags, message, safi, length of the rest, the rest,
+ *   count, then count prefixes, each a length and its bytes.
+ *
+ * The bulk goes out once the socket is writable again, or ahead of any
+ * other message or route that can't be merged.
+ *
+ * Inside zclient_route_batch() routes are merged whatever their rest,
+ * which the bulk's length of the rest, ZAPI_BULK_EACH, says follows each
+ * prefix, as its length and its bytes.
+ */
+int zclient_route_send(struct zclient *zclient, u_int16_t cmd) {
+	struct stream *s = zclient->obuf;
+	struct stream *bulk = zclient->bulk;
+	u_char *data = STREAM_DATA(s);
+	size_t pfx = ZEBRA_HEADER_SIZE + ZAPI_ROUTE_HEAD;
+	size_t plen = 1 + PSIZE(data[pfx]);
+	size_t rest = pfx + plen;
+	size_t rest_len = stream_get_endp(s) - rest;
+	size_t add = zclient->route_batch ? plen + 2 + rest_len : plen;
+	u_char *b = STREAM_DATA(bulk);
+
+	if(zclient->sock < 0) {
+		return -1;
+	}
+
+	if(zclient->bulk_count) {
+		/* the same vrf, command and all but the prefix, or each route
+		   with its own rest, and room */
+		if(memcmp(b + 4, data + 4, 2) || stream_getw_from(bulk, ZEBRA_HEADER_SIZE) != cmd || memcmp(b + ZEBRA_HEADER_SIZE + 2, data + ZEBRA_HEADER_SIZE, ZAPI_ROUTE_HEAD)
+		   || (!zclient->route_batch && (stream_getw_from(bulk, ZEBRA_HEADER_SIZE + 2 + ZAPI_ROUTE_HEAD) != rest_len || memcmp(b + ZEBRA_HEADER_SIZE + 4 + ZAPI_ROUTE_HEAD, data + rest, rest_len))) || zclient->bulk_count == UINT16_MAX
+		   || STREAM_WRITEABLE(bulk) < add) {
+			if(zclient_bulk_close(zclient) < 0) {
+				return -1;
+			}
+		}
+	}
+
+	if(zclient->bulk_count == 0) {
+		/* nothing to wait for, or it wouldn't be worth it */
+		if((zclient->t_write == NULL && !zclient->route_batch) || ZEBRA_HEADER_SIZE + 6 + ZAPI_ROUTE_HEAD + rest_len + add > ZEBRA_MAX_PACKET_SIZ) {
+			return zclient_send_stream(zclient, s);
+		}
+
+		stream_reset(bulk);
+		zclient_create_header(bulk, ZEBRA_ROUTE_BULK, stream_getw_from(s, 4));
+		stream_putw(bulk, cmd);
+		stream_put(bulk, data + ZEBRA_HEADER_SIZE, ZAPI_ROUTE_HEAD);
+		if(zclient->route_batch) {
+			stream_putw(bulk, ZAPI_BULK_EACH);
+		} else {
+			stream_putw(bulk, rest_len);
+			stream_put(bulk, data + rest, rest_len);
+		}
+		zclient->bulk_count_at = stream_get_endp(bulk);
+		stream_putw(bulk, 0);
+	}
+
+	stream_put(bulk, data + pfx, plen);
+	if(zclient->route_batch) {
+		stream_putw(bulk, rest_len);
+		stream_put(bulk, data + rest, rest_len);
+	}
+	zclient->bulk_count++;
+	return 0;
+}
+
+int zclient_route_batch(struct zclient *zclient, int on) {
+	on = !!on;
+	if(zclient->route_batch == on) {
+		return 0;
+	}
+	/* a bulk is of one kind or the other */
+	zclient->route_batch = on;
+	if(zclient->sock < 0) {
+		return -1;
+	}
+	return zclient_bulk_close(zclient);
+}
+
 void zclient_create_header(struct stream *s, uint16_t command, vrf_id_t vrf_id) {
 	/* length placeholder, caller can update */
 	stream_putw(s, ZEBRA_HEADER_SIZE);
@@ -340,6 +622,83 @@ static int zebra_hello_send(struct zclient *zclient) {
 	return 0;
 }
 
+/* Tell zebra to keep our routes for 'secs' seconds once we go, as we are
+ * restarting gracefully, or with 0 that we have announced them all again,
+ * those we didn't to go. */
+int zebra_graceful_restart_send(struct zclient *zclient, u_int32_t secs) {
+	struct stream *s;
+
+	if(zclient->sock < 0) {
+		return -1;
+	}
+
+	s = zclient->obuf;
+	stream_reset(s);
+
+	zclient_create_header(s, ZEBRA_GRACEFUL_RESTART, VRF_DEFAULT);
+	stream_putl(s, secs);
+	stream_putw_at(s, 0, stream_get_endp(s));
+	return zclient_send_message(zclient);
+}
+
+void zapi_bfd_encode(struct stream *s, struct zapi_bfd *bfd) {
+	stream_putc(s, bfd->dst.family);
+	stream_put(s, &bfd->dst.u.prefix, prefix_blen(&bfd->dst));
+	stream_put(s, &bfd->src.u.prefix, prefix_blen(&bfd->dst));
+	stream_putl(s, bfd->ifindex);
+	stream_putl(s, bfd->min_rx);
+	stream_putl(s, bfd->min_tx);
+	stream_putc(s, bfd->detect_mult);
+	stream_putc(s, bfd->state);
+}
+
+/* -1 if it is malformed */
+int zapi_bfd_decode(struct stream *s, struct zapi_bfd *bfd) {
+	int family, blen;
+
+	memset(bfd, 0, sizeof(struct zapi_bfd));
+	family = stream_getc(s);
+	if(family == AF_INET) {
+		blen = IPV4_MAX_BYTELEN;
+#ifdef HAVE_IPV6
+	} else if(family == AF_INET6) {
+		blen = IPV6_MAX_BYTELEN;
+#endif /* HAVE_IPV6 */
+	} else {
+		return -1;
+	}
+	if(STREAM_READABLE(s) < (size_t) (2 * blen + 14)) {
+		return -1;
+	}
+
+	bfd->dst.family = bfd->src.family = family;
+	bfd->dst.prefixlen = bfd->src.prefixlen = blen * 8;
+	stream_get(&bfd->dst.u.prefix, s, blen);
+	stream_get(&bfd->src.u.prefix, s, blen);
+	bfd->ifindex = stream_getl(s);
+	bfd->min_rx = stream_getl(s);
+	bfd->min_tx = stream_getl(s);
+	bfd->detect_mult = stream_getc(s);
+	bfd->state = stream_getc(s);
+	return 0;
+}
+
+int zebra_bfd_send(struct zclient *zclient, int command, struct zapi_bfd *bfd) {
+	struct stream *s;
+
+	if(zclient->sock < 0) {
+		return -1;
+	}
+
+	s = zclient->obuf;
+	stream_reset(s);
+
+	zclient_create_header(s, command, VRF_DEFAULT);
+	zapi_bfd_encode(s, bfd);
+	stream_putw_at(s, 0, stream_get_endp(s));
+	return zclient_send_message(zclient);
+}
+
 /* Send requests to zebra daemon for the information in a VRF. */
 void zclient_send_requests(struct zclient *zclient, vrf_id_t vrf_id) {
 	int i;
@@ -435,6 +794,7 @@ int zclient_start(struct zclient *zclient) {
 	zclient_event(ZCLIENT_READ, zclient);
 
 	zebra_hello_send(zclient);
+	zclient_ring_offer(zclient);
 
 	/* Inform the successful connection. */
 	if(zclient->zebra_connected) {
@@ -560,11 +920,14 @@ int zapi_ipv4_route(u_char cmd, struct zclient *zclient, struct prefix_ipv4 *p,
 	if(CHECK_FLAG(api->message, ZAPI_MESSAGE_TAG)) {
 		stream_putl(s, api->tag);
 	}
+	if(CHECK_FLAG(api->message, ZAPI_MESSAGE_NHG)) {
+		stream_putl(s, api->nhg_id);
+	}
 
 	/* Put length at the first point of the stream. */
 	stream_putw_at(s, 0, stream_get_endp(s));
 
-	return zclient_send_message(zclient);
+	return zclient_route_send(zclient, cmd);
 }
 
 #ifdef HAVE_IPV6
@@ -620,7 +983,7 @@ int zapi_ipv6_route(u_char cmd, struct zclient *zclient, struct prefix_ipv6 *p,
 	/* Put length at the first point of the stream. */
 	stream_putw_at(s, 0, stream_get_endp(s));
 
-	return zclient_send_message(zclient);
+	return zclient_route_send(zclient, cmd);
 }
 #endif /* HAVE_IPV6 */
 
@@ -813,7 +1176,7 @@ void zebra_interface_if_set_value(struct stream *s, struct interface *ifp) {
 	u_char link_params_status = 0;
 
 	/* Read interface's index. */
-	ifp->ifindex = stream_getl(s);
+	if_set_index(ifp, stream_getl(s));
 	ifp->status = stream_getc(s);
 
 	/* Read interface's value. */
@@ -986,87 +1349,15 @@ struct connected *zebra_interface_address_read(int type, struct stream *s, vrf_i
 }
 
 /* Zebra client message read function. */
-static int zclient_read(struct thread *thread) {
-	size_t already;
-	uint16_t length, command;
-	uint8_t marker, version;
-	vrf_id_t vrf_id;
-	struct zclient *zclient;
-
-	/* Get socket to zebra. */
-	zclient = THREAD_ARG(thread);
-	zclient->t_read = NULL;
-
-	/* Read zebra header (if we don't have it already). */
-	if((already = stream_get_endp(zclient->ibuf)) < ZEBRA_HEADER_SIZE) {
-		ssize_t nbyte;
-		if(((nbyte = stream_read_try(zclient->ibuf, zclient->sock, ZEBRA_HEADER_SIZE - already)) == 0) || (nbyte == -1)) {
-			if(zclient_debug) {
-				zlog_debug("zclient connection closed socket [%d].", zclient->sock);
-			}
-			return zclient_failed(zclient);
-		}
-		if(nbyte != (ssize_t) (ZEBRA_HEADER_SIZE - already)) {
-			/* Try again later. */
-			zclient_event(ZCLIENT_READ, zclient);
-			return 0;
-		}
-		already = ZEBRA_HEADER_SIZE;
-	}
-
-	/* Reset to read from the beginning of the incoming packet. */
-	stream_set_getp(zclient->ibuf, 0);
-
-	/* Fetch header values. */
-	length = stream_getw(zclient->ibuf);
-	marker = stream_getc(zclient->ibuf);
-	version = stream_getc(zclient->ibuf);
-	vrf_id = stream_getw(zclient->ibuf);
-	command = stream_getw(zclient->ibuf);
-
-	if(marker != ZEBRA_HEADER_MARKER || version != ZSERV_VERSION) {
-		zlog_err("%s: socket %d version mismatch, marker %d, version %d", __func__, zclient->sock, marker, version);
-		return zclient_failed(zclient);
-	}
-
-	if(length < ZEBRA_HEADER_SIZE) {
-		zlog_err("%s: socket %d message length %u is less than %d ", __func__, zclient->sock, length, ZEBRA_HEADER_SIZE);
-		return zclient_failed(zclient);
-	}
-
-	/* Length check. */
-	if(length > STREAM_SIZE(zclient->ibuf)) {
-		struct stream *ns;
-		zlog_warn("%s: message size %u exceeds buffer size %lu, expanding...", __func__, length, (u_long) STREAM_SIZE(zclient->ibuf));
-		ns = stream_new(length);
-		stream_copy(ns, zclient->ibuf);
-		stream_free(zclient->ibuf);
-		zclient->ibuf = ns;
-	}
-
-	/* Read rest of zebra packet. */
-	if(already < length) {
-		ssize_t nbyte;
-		if(((nbyte = stream_read_try(zclient->ibuf, zclient->sock, length - already)) == 0) || (nbyte == -1)) {
-			if(zclient_debug) {
-				zlog_debug("zclient connection closed socket [%d].", zclient->sock);
-			}
-			return zclient_failed(zclient);
-		}
-		if(nbyte != (ssize_t) (length - already)) {
-			/* Try again later. */
-			zclient_event(ZCLIENT_READ, zclient);
-			return 0;
-		}
-	}
-
-	length -= ZEBRA_HEADER_SIZE;
-
+/* Hand one message, copied into ibuf with the header already read, to
+ * its handler. */
+static void zclient_dispatch(struct zclient *zclient, uint16_t command, uint16_t length, vrf_id_t vrf_id) {
 	if(zclient_debug) {
 		zlog_debug("zclient 0x%p command 0x%x VRF %u\n", (void *) zclient, command, vrf_id);
 	}
 
 	switch(command) {
+		case ZEBRA_SHM_RING: zclient_ring_answer(zclient); break;
 		case ZEBRA_ROUTER_ID_UPDATE:
 			if(zclient->router_id_update) {
 				(*zclient->router_id_update)(command, zclient, length, vrf_id);
@@ -1126,21 +1417,118 @@ static int zclient_read(struct thread *thread) {
 			if(zclient->interface_link_params) {
 				(*zclient->interface_link_params)(command, zclient, length);
 			}
+			break;
 		case ZEBRA_NEXTHOP_UPDATE:
 			if(zclient->nexthop_update) {
 				(*zclient->nexthop_update)(command, zclient, length, vrf_id);
 			}
 			break;
+		case ZEBRA_BFD_DEST_UPDATE:
+			if(zclient->bfd_update) {
+				(*zclient->bfd_update)(command, zclient, length, vrf_id);
+			}
+			break;
 		default: break;
 	}
+}
 
-	if(zclient->sock < 0) {
-		/* Connection was closed during packet processing. */
-		return -1;
+/* Read what zebra has sent, as much as rbuf takes, and handle every
+ * complete message in it, so that a burst of routes costs a wakeup per
+ * buffer rather than one per route.  A partial message stays at the
+ * start of rbuf for the next read. */
+static int zclient_read(struct thread *thread) {
+	struct zclient *zclient;
+	struct stream *rbuf;
+	ssize_t nbyte;
+	uint16_t length, command;
+	uint8_t marker, version;
+	vrf_id_t vrf_id;
+	size_t getp, left;
+
+	/* Get socket to zebra. */
+	zclient = THREAD_ARG(thread);
+	zclient->t_read = NULL;
+	rbuf = zclient->rbuf;
+
+	nbyte = stream_read_try(rbuf, zclient->sock, STREAM_WRITEABLE(rbuf));
+	if(nbyte == 0 || nbyte == -1) {
+		if(zclient_debug) {
+			zlog_debug("zclient connection closed socket [%d].", zclient->sock);
+		}
+		return zclient_failed(zclient);
+	}
+	if(nbyte == -2) {
+		/* Try again later. */
+		zclient_event(ZCLIENT_READ, zclient);
+		return 0;
+	}
+
+	while(STREAM_READABLE(rbuf) >= ZEBRA_HEADER_SIZE) {
+		getp = stream_get_getp(rbuf);
+
+		/* Fetch header values. */
+		length = stream_getw_from(rbuf, getp);
+		marker = stream_getc_from(rbuf, getp + 2);
+		version = stream_getc_from(rbuf, getp + 3);
+		vrf_id = stream_getw_from(rbuf, getp + 4);
+		command = stream_getw_from(rbuf, getp + 6);
+
+		if(marker != ZEBRA_HEADER_MARKER || version != ZSERV_VERSION) {
+			zlog_err("%s: socket %d version mismatch, marker %d, version %d", __func__, zclient->sock, marker, version);
+			return zclient_failed(zclient);
+		}
+
+		if(length < ZEBRA_HEADER_SIZE) {
+			zlog_err("%s: socket %d message length %u is less than %d ", __func__, zclient->sock, length, ZEBRA_HEADER_SIZE);
+			return zclient_failed(zclient);
+		}
+
+		if(length > STREAM_READABLE(rbuf)) {
+			break;
+		}
+
+		/* Length check. */
+		if(length > STREAM_SIZE(zclient->ibuf)) {
+			zlog_warn("%s: message size %u exceeds buffer size %lu, expanding...", __func__, length, (u_long) STREAM_SIZE(zclient->ibuf));
+			stream_free(zclient->ibuf);
+			zclient->ibuf = stream_new(length);
+		}
+
+		/* Handlers read the message from ibuf, just past the header. */
+		stream_reset(zclient->ibuf);
+		stream_put(zclient->ibuf, STREAM_DATA(rbuf) + getp, length);
+		stream_set_getp(zclient->ibuf, ZEBRA_HEADER_SIZE);
+		stream_forward_getp(rbuf, length);
+
+		zclient_dispatch(zclient, command, length - ZEBRA_HEADER_SIZE, vrf_id);
+
+		if(zclient->sock < 0) {
+			/* Connection was closed during packet processing. */
+			return -1;
+		}
+	}
+
+	/* Move what is left of a partial message to the front. */
+	left = STREAM_READABLE(rbuf);
+	if(left && stream_get_getp(rbuf)) {
+		memmove(STREAM_DATA(rbuf), STREAM_PNT(rbuf), left);
+	}
+	stream_set_getp(rbuf, 0);
+	stream_set_endp(rbuf, left);
+
+	/* A message bigger than rbuf: make room for the whole of it. */
+	if(left >= ZEBRA_HEADER_SIZE && stream_getw_from(rbuf, 0) > STREAM_SIZE(rbuf)) {
+		struct stream *ns;
+
+		length = stream_getw_from(rbuf, 0);
+		zlog_warn("%s: message size %u exceeds buffer size %lu, expanding...", __func__, length, (u_long) STREAM_SIZE(rbuf));
+		ns = stream_new(length);
+		stream_put(ns, STREAM_DATA(rbuf), left);
+		stream_free(rbuf);
+		zclient->rbuf = ns;
 	}
 
 	/* Register read thread. */
-	stream_reset(zclient->ibuf);
 	zclient_event(ZCLIENT_READ, zclient);
 
 	return 0;
@@ -35,6 +35,9 @@
 /* For input/output buffer to zebra. */
 #define ZEBRA_MAX_PACKET_SIZ 4096
 
+/* What zclient_read() takes from the socket at once */
+#define ZCLIENT_READ_BUF_SIZ 65536
+
 /* Zebra header size. */
 #define ZEBRA_HEADER_SIZE 8
 
@@ -56,12 +59,27 @@ struct zclient {
 	/* Input buffer for zebra message. */
 	struct stream *ibuf;
 
+	/* Bytes read from zebra, complete messages handed to ibuf in turn */
+	struct stream *rbuf;
+
 	/* Output buffer for zebra message. */
 	struct stream *obuf;
 
 	/* Buffer of data waiting to be written to zebra. */
 	struct buffer *wb;
 
+	/* Route messages held back while wb has data pending, merged into
+	   one ZEBRA_ROUTE_BULK as long as all but the prefix match; see
+	   zclient_route_send(). */
+	struct stream *bulk;
+	u_int16_t bulk_count;
+	size_t bulk_count_at;
+
+	/* Inside zclient_route_batch(): routes are held back and merged
+	   whether or not anything is pending, each with the rest of its
+	   own. */
+	int route_batch;
+
 	/* Read and connect thread. */
 	struct thread *t_read;
 	struct thread *t_connect;
@@ -69,6 +87,15 @@ struct zclient {
 	/* Thread to write buffered data to zebra. */
 	struct thread *t_write;
 
+	/* Shared memory ring of ring_size bytes to send through once zebra
+	   accepted it, if ring_size is set, and the messages waiting for
+	   room in it. */
+	u_int32_t ring_size;
+	struct zring *ring;
+	u_char ring_state;
+	struct stream_fifo *ring_fifo;
+	struct thread *t_ring;
+
 	/* Redistribute information. */
 	u_char redist_default;
 	vrf_bitmap_t redist[ZEBRA_ROUTE_MAX];
@@ -91,6 +118,7 @@ struct zclient {
 	int (*ipv6_route_add)(int, struct zclient *, uint16_t, vrf_id_t);
 	int (*ipv6_route_delete)(int, struct zclient *, uint16_t, vrf_id_t);
 	int (*nexthop_update)(int, struct zclient *, uint16_t, vrf_id_t);
+	int (*bfd_update)(int, struct zclient *, uint16_t, vrf_id_t);
 };
 
 /* Zebra API message flag. */
@@ -100,6 +128,24 @@ struct zclient {
 #define ZAPI_MESSAGE_METRIC 0x08
 #define ZAPI_MESSAGE_MTU 0x10
 #define ZAPI_MESSAGE_TAG 0x20
+#define ZAPI_MESSAGE_NHG 0x40 /* IPv4 only, nexthops from a nexthop group */
+
+/* The fixed part of a route add or delete ahead of its prefix: type,
+   flags, message and safi */
+#define ZAPI_ROUTE_HEAD 5
+
+/* The length of the rest in a ZEBRA_ROUTE_BULK whose routes each carry
+   their own rest, after their prefix. */
+#define ZAPI_BULK_EACH 0xffff
+
+/* ZEBRA_SHM_RING states.  The client offers zebra a zring, with its
+   descriptors passed along; zebra accepts or refuses it.  Once accepted,
+   the client sends START, the last message it sends zebra through the
+   socket; zebra reads the ring from there on. */
+#define ZSERV_RING_OFFER 1
+#define ZSERV_RING_ACCEPT 2
+#define ZSERV_RING_REFUSE 3
+#define ZSERV_RING_START 4
 
 /* Zserv protocol message header */
 struct zserv_header {
@@ -137,9 +183,36 @@ struct zapi_ipv4 {
 
 	u_int32_t mtu;
 
+	u_int32_t nhg_id;
+
 	vrf_id_t vrf_id;
 };
 
+/* A BFD session to a directly connected neighbour, from the source
+   address given, which zebra runs for as long as a client is registered
+   for it.  Registered clients are sent ZEBRA_BFD_DEST_UPDATE when it
+   comes up, and when it goes down after having been up: a neighbour that
+   does not do BFD is never reported down. */
+#define ZEBRA_BFD_DOWN 0
+#define ZEBRA_BFD_UP 1
+
+/* Intervals in milliseconds */
+#define ZEBRA_BFD_MIN_RX_DEFAULT 300
+#define ZEBRA_BFD_MIN_TX_DEFAULT 300
+#define ZEBRA_BFD_DETECT_MULT_DEFAULT 3
+
+struct zapi_bfd {
+	struct prefix dst;
+	struct prefix src;
+	ifindex_t ifindex;
+
+	u_int32_t min_rx;
+	u_int32_t min_tx;
+	u_char detect_mult;
+
+	u_char state; /* in updates */
+};
+
 /* Prototypes of zebra client service functions. */
 extern struct zclient *zclient_new(struct thread_master *);
 extern void zclient_init(struct zclient *, int);
@@ -167,6 +240,26 @@ extern void zclient_redistribute_default(int command, struct zclient *, vrf_id_t
    Returns 0 for success or -1 on an I/O error. */
 extern int zclient_send_message(struct zclient *);
 
+/* Send the route add or delete 'cmd' in zclient->obuf, laid out as
+   zapi_ipv4_route() does it, merging it into a bulk where it can. */
+extern int zclient_route_send(struct zclient *, u_int16_t cmd);
+
+/* Between zclient_route_batch(zclient, 1) and zclient_route_batch
+   (zclient, 0), route adds and deletes go out as few bulk messages as
+   they fit in, whatever their nexthops, for a whole table's changes at
+   once.  Other messages still go out in order. */
+extern int zclient_route_batch(struct zclient *, int);
+
+/* Ask zebra to keep the routes for so many seconds after we go, or with
+   0 to remove those we haven't announced again since. */
+extern int zebra_graceful_restart_send(struct zclient *, u_int32_t secs);
+
+/* ZEBRA_BFD_DEST_REGISTER or _DEREGISTER, and reading what either they
+   or ZEBRA_BFD_DEST_UPDATE carry */
+extern int zebra_bfd_send(struct zclient *, int command, struct zapi_bfd *);
+extern void zapi_bfd_encode(struct stream *, struct zapi_bfd *);
+extern int zapi_bfd_decode(struct stream *, struct zapi_bfd *);
+
 /* create header for command, length to be filled in by user later */
 extern void zclient_create_header(struct stream *, uint16_t, vrf_id_t);
 extern int zclient_read_header(struct stream *s, int sock, u_int16_t *size, u_char *marker, u_char *version, u_int16_t *vrf_id, u_int16_t *cmd);
@@ -414,7 +414,15 @@ struct in_pktinfo {
 #define ZEBRA_NEXTHOP_REGISTER 27
 #define ZEBRA_NEXTHOP_UNREGISTER 28
 #define ZEBRA_NEXTHOP_UPDATE 29
-#define ZEBRA_MESSAGE_MAX 30
+#define ZEBRA_NEXTHOP_GROUP_ADD 30
+#define ZEBRA_NEXTHOP_GROUP_DELETE 31
+#define ZEBRA_ROUTE_BULK 32
+#define ZEBRA_SHM_RING 33
+#define ZEBRA_GRACEFUL_RESTART 34
+#define ZEBRA_BFD_DEST_REGISTER 35
+#define ZEBRA_BFD_DEST_DEREGISTER 36
+#define ZEBRA_BFD_DEST_UPDATE 37
+#define ZEBRA_MESSAGE_MAX 38
 
 /* Marker value used in new Zserv, in the byte location corresponding
  * the command value in the old zserv header. To allow old and new
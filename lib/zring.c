@@ -0,0 +1,294 @@
+/*
+ * Quagga zserv rings: zserv messages through shared memory.
+ *
+ * This file is part of Quagga.
+ *
+ * Quagga is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2, or (at your option) any
+ * later version.
+ *
+ * Quagga is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Quagga; see the file COPYING.  If not, write to the Free
+ * Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ * 02111-1307, USA.
+ */
+
+#include <zebra.h>
+
+#include <sys/mman.h>
+#ifdef HAVE_SYS_EVENTFD_H
+	#include <sys/eventfd.h>
+#endif
+
+#include "memory.h"
+#include "log.h"
+#include "zring.h"
+
+#define ZRING_MAGIC 0x5a52494e
+
+/* Messages start on 4 byte boundaries, so that a skip marker fits */
+#define ZRING_ALIGN(len) (((len) + 3) & ~(size_t) 3)
+
+struct zring_shm {
+	u_int32_t magic;
+	u_int32_t size;
+
+	/* written by the consumer; data_sleep cleared by the producer */
+	u_int32_t head __attribute__((aligned(64)));
+	u_int32_t data_sleep;
+
+	/* written by the producer; space_sleep cleared by the consumer */
+	u_int32_t tail __attribute__((aligned(64)));
+	u_int32_t space_sleep;
+
+	u_char data[] __attribute__((aligned(64)));
+};
+
+static struct zring *zring_alloc(u_int32_t size) {
+	struct zring *ring;
+
+	ring = XCALLOC(MTYPE_ZRING, sizeof(struct zring));
+	ring->size = size;
+	ring->map_size = sizeof(struct zring_shm) + size;
+	ring->mem_fd = ring->data_fd = ring->space_fd = -1;
+	return ring;
+}
+
+void zring_free(struct zring *ring) {
+	if(ring->shm) {
+		munmap(ring->shm, ring->map_size);
+	}
+	if(ring->mem_fd >= 0) {
+		close(ring->mem_fd);
+	}
+	if(ring->data_fd >= 0) {
+		close(ring->data_fd);
+	}
+	if(ring->space_fd >= 0) {
+		close(ring->space_fd);
+	}
+	XFREE(MTYPE_ZRING, ring);
+}
+
+static int zring_size_ok(u_int32_t size) {
+	return size >= ZRING_SIZE_MIN && size <= ZRING_SIZE_MAX && (size & (size - 1)) == 0;
+}
+
+#if defined(HAVE_SYS_EVENTFD_H) && defined(MFD_CLOEXEC) && defined(MFD_ALLOW_SEALING) && defined(F_ADD_SEALS)
+
+/* Seals the consumer insists on: were the memfd to shrink under its
+ * mapping, its next access to the ring would take a SIGBUS */
+#define ZRING_SEALS (F_SEAL_SHRINK | F_SEAL_GROW)
+
+struct zring *zring_new(u_int32_t size) {
+	struct zring *ring;
+	void *map;
+
+	if(!zring_size_ok(size)) {
+		return NULL;
+	}
+
+	ring = zring_alloc(size);
+	if((ring->mem_fd = memfd_create("zring", MFD_CLOEXEC | MFD_ALLOW_SEALING)) < 0 || ftruncate(ring->mem_fd, ring->map_size) < 0 || fcntl(ring->mem_fd, F_ADD_SEALS, ZRING_SEALS | F_SEAL_SEAL) < 0) {
+		zlog_warn("%s: can't create memory for the ring: %s", __func__, safe_strerror(errno));
+		zring_free(ring);
+		return NULL;
+	}
+	if((map = mmap(NULL, ring->map_size, PROT_READ | PROT_WRITE, MAP_SHARED, ring->mem_fd, 0)) == MAP_FAILED) {
+		zlog_warn("%s: mmap failed: %s", __func__, safe_strerror(errno));
+		zring_free(ring);
+		return NULL;
+	}
+	ring->shm = map;
+	if((ring->data_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)) < 0 || (ring->space_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)) < 0) {
+		zlog_warn("%s: eventfd failed: %s", __func__, safe_strerror(errno));
+		zring_free(ring);
+		return NULL;
+	}
+
+	ring->shm->magic = ZRING_MAGIC;
+	ring->shm->size = size;
+	return ring;
+}
+
+struct zring *zring_attach(u_int32_t size, int mem_fd, int data_fd, int space_fd) {
+	struct zring *ring;
+	struct stat st;
+	void *map;
+	int seals;
+
+	ring = zring_alloc(size);
+	ring->mem_fd = mem_fd;
+	ring->data_fd = data_fd;
+	ring->space_fd = space_fd;
+
+	if(!zring_size_ok(size) || fstat(mem_fd, &st) < 0 || (size_t) st.st_size < ring->map_size) {
+		zring_free(ring);
+		return NULL;
+	}
+	if((seals = fcntl(mem_fd, F_GET_SEALS)) < 0 || (seals & ZRING_SEALS) != ZRING_SEALS) {
+		zlog_warn("%s: the ring's memory isn't sealed against resizing", __func__);
+		zring_free(ring);
+		return NULL;
+	}
+	if((map = mmap(NULL, ring->map_size, PROT_READ | PROT_WRITE, MAP_SHARED, mem_fd, 0)) == MAP_FAILED) {
+		zlog_warn("%s: mmap failed: %s", __func__, safe_strerror(errno));
+		zring_free(ring);
+		return NULL;
+	}
+	ring->shm = map;
+	if(ring->shm->magic != ZRING_MAGIC || ring->shm->size != size) {
+		zring_free(ring);
+		return NULL;
+	}
+
+	/* the mapping is all that's needed of it */
+	close(ring->mem_fd);
+	ring->mem_fd = -1;
+	ring->pos = __atomic_load_n(&ring->shm->head, __ATOMIC_ACQUIRE);
+	return ring;
+}
+
+#else
+
+struct zring *zring_new(u_int32_t size) {
+	return NULL;
+}
+
+struct zring *zring_attach(u_int32_t size, int mem_fd, int data_fd, int space_fd) {
+	close(mem_fd);
+	close(data_fd);
+	close(space_fd);
+	return NULL;
+}
+
+#endif /* HAVE_SYS_EVENTFD_H && MFD_CLOEXEC && MFD_ALLOW_SEALING && F_ADD_SEALS */
+
+/* Wake the other side, if it said it went to sleep */
+static void zring_kick(u_int32_t *sleep, int fd) {
+	u_int32_t asleep = 1;
+	u_int64_t one = 1;
+
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+	if(__atomic_load_n(sleep, __ATOMIC_RELAXED) && __atomic_compare_exchange_n(sleep, &asleep, 0, 0, __ATOMIC_SEQ_CST, __ATOMIC_RELAXED)) {
+		if(write(fd, &one, sizeof(one)) < 0 && errno != EAGAIN) {
+			zlog_warn("%s: write to eventfd %d failed: %s", __func__, fd, safe_strerror(errno));
+		}
+	}
+}
+
+/* Say we go to sleep on fd, unless ready() turns true meanwhile */
+static int zring_sleep(struct zring *ring, u_int32_t *sleep, int fd, int (*ready)(struct zring *, size_t), size_t len) {
+	u_int32_t asleep = 1;
+	u_int64_t count;
+
+	/* wakeups from before are of no use now */
+	while(read(fd, &count, sizeof(count)) > 0) {
+		;
+	}
+
+	__atomic_store_n(sleep, 1, __ATOMIC_SEQ_CST);
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+	if(!ready(ring, len)) {
+		return 1;
+	}
+	/* still awake; if the other side saw us asleep already, its
+	 * wakeup is left over for next time */
+	__atomic_compare_exchange_n(sleep, &asleep, 0, 0, __ATOMIC_SEQ_CST, __ATOMIC_RELAXED);
+	return 0;
+}
+
+/* Producer: bytes to skip to the start of the ring first, if the next
+ * message can't go right where the ring is at */
+static u_int32_t zring_skip(struct zring *ring, size_t len) {
+	u_int32_t off = ring->pos & (ring->size - 1);
+
+	return (ring->size - off < ZRING_ALIGN(len)) ? ring->size - off : 0;
+}
+
+static int zring_room(struct zring *ring, size_t len) {
+	u_int32_t head = __atomic_load_n(&ring->shm->head, __ATOMIC_ACQUIRE);
+
+	return zring_skip(ring, len) + ZRING_ALIGN(len) <= ring->size - (ring->pos - head);
+}
+
+int zring_put(struct zring *ring, const void *data, size_t len) {
+	u_int32_t skip;
+
+	if(len < 2 || !zring_room(ring, len)) {
+		return -1;
+	}
+
+	if((skip = zring_skip(ring, len)) != 0) {
+		ring->shm->data[ring->pos & (ring->size - 1)] = 0;
+		ring->shm->data[(ring->pos & (ring->size - 1)) + 1] = 0;
+		ring->pos += skip;
+	}
+	memcpy(ring->shm->data + (ring->pos & (ring->size - 1)), data, len);
+	ring->pos += ZRING_ALIGN(len);
+	__atomic_store_n(&ring->shm->tail, ring->pos, __ATOMIC_RELEASE);
+
+	zring_kick(&ring->shm->data_sleep, ring->data_fd);
+	return 0;
+}
+
+int zring_sleep_space(struct zring *ring, size_t len) {
+	return zring_sleep(ring, &ring->shm->space_sleep, ring->space_fd, zring_room, len);
+}
+
+int zring_get(struct zring *ring, const u_char **data, size_t *len) {
+	u_int32_t tail, avail, off, size;
+
+	for(;;) {
+		tail = __atomic_load_n(&ring->shm->tail, __ATOMIC_ACQUIRE);
+		if(tail == ring->pos) {
+			return 0;
+		}
+		if((avail = tail - ring->pos) > ring->size) {
+			return -1;
+		}
+
+		off = ring->pos & (ring->size - 1);
+		size = (ring->shm->data[off] << 8) | ring->shm->data[off + 1];
+		if(size != 0) {
+			break;
+		}
+
+		/* skip marker */
+		if(ring->size - off > avail) {
+			return -1;
+		}
+		ring->pos += ring->size - off;
+		__atomic_store_n(&ring->shm->head, ring->pos, __ATOMIC_RELEASE);
+	}
+
+	if(size < 2 || ZRING_ALIGN(size) > avail || ZRING_ALIGN(size) > ring->size - off) {
+		return -1;
+	}
+	*data = ring->shm->data + off;
+	*len = size;
+	ring->peeked = ZRING_ALIGN(size);
+	return 1;
+}
+
+void zring_consume(struct zring *ring) {
+	ring->pos += ring->peeked;
+	ring->peeked = 0;
+	__atomic_store_n(&ring->shm->head, ring->pos, __ATOMIC_RELEASE);
+
+	zring_kick(&ring->shm->space_sleep, ring->space_fd);
+}
+
+static int zring_readable(struct zring *ring, size_t len) {
+	return __atomic_load_n(&ring->shm->tail, __ATOMIC_ACQUIRE) != ring->pos;
+}
+
+int zring_sleep_data(struct zring *ring) {
+	return zring_sleep(ring, &ring->shm->data_sleep, ring->data_fd, zring_readable, 0);
+}
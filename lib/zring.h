@@ -0,0 +1,82 @@
+/*
+ * Quagga zserv rings: zserv messages through shared memory.
+ *
+ * This file is part of Quagga.
+ *
+ * Quagga is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2, or (at your option) any
+ * later version.
+ *
+ * Quagga is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Quagga; see the file COPYING.  If not, write to the Free
+ * Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ * 02111-1307, USA.
+ */
+
+#ifndef _QUAGGA_ZRING_H
+#define _QUAGGA_ZRING_H
+
+/* A zring carries zserv messages, as they are, from one producer process
+ * to one consumer process, through a shared memory mapping instead of
+ * the zserv socket.  Each message is framed by its own length field, the
+ * first two bytes of the zserv header, and is laid out contiguously:
+ * where one doesn't fit before the end of the ring, a zero length marks
+ * the rest as skipped.
+ *
+ * The producer creates the ring, a memfd and two eventfds (data, space),
+ * and hands the three descriptors to the consumer.  The memfd is sealed
+ * against shrinking or growing first, as the consumer maps it only if
+ * it is.  Neither side makes a
+ * system call per message: the eventfds are written only when the other
+ * side said it went to sleep on them, and each side keeps its own copy
+ * of its position, so a misbehaving producer can at worst make the
+ * consumer see a bad message, which zring_get() reports.
+ *
+ * Where sealed memfds or eventfds aren't available, zring_new() and
+ * zring_attach() fail and the socket is used as before.
+ */
+
+struct zring {
+	struct zring_shm *shm;
+	size_t map_size;
+	u_int32_t size;
+	u_int32_t pos;	  /* own position: tail for the producer, head for the consumer */
+	u_int32_t peeked; /* bytes of the message zring_get() returned */
+
+	int mem_fd;   /* the producer's, until handed over */
+	int data_fd;  /* the consumer sleeps on it */
+	int space_fd; /* the producer sleeps on it */
+};
+
+#define ZRING_SIZE_MIN (256 * 1024)
+#define ZRING_SIZE_MAX (64 * 1024 * 1024)
+
+/* Producer: a ring of 'size' bytes, a power of two, NULL if unsupported */
+extern struct zring *zring_new(u_int32_t size);
+/* Consumer: map the ring the producer handed over, taking the fds */
+extern struct zring *zring_attach(u_int32_t size, int mem_fd, int data_fd, int space_fd);
+extern void zring_free(struct zring *);
+
+/* Producer: queue a message of len bytes, of which the first two are its
+ * length in network order.  Returns -1 if there isn't room for it. */
+extern int zring_put(struct zring *, const void *, size_t len);
+/* Producer, with no room for a message of len bytes: returns 1 if it
+ * should wait for space_fd to be readable, 0 if there's room after all */
+extern int zring_sleep_space(struct zring *, size_t len);
+
+/* Consumer: point to the next message and its length.  Returns 1 for
+ * a message, 0 if the ring is empty, -1 if what's queued is corrupt. */
+extern int zring_get(struct zring *, const u_char **, size_t *len);
+/* Consumer: done with the message zring_get() returned */
+extern void zring_consume(struct zring *);
+/* Consumer, with the ring empty: returns 1 if it should wait for
+ * data_fd to be readable, 0 if something was queued meanwhile */
+extern int zring_sleep_data(struct zring *);
+
+#endif /* _QUAGGA_ZRING_H */
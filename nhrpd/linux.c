@@ -7,6 +7,10 @@
  * (at your option) any later version.
  */
 
+#ifndef _GNU_SOURCE
+	#define _GNU_SOURCE /* recvmmsg */
+#endif
+
 #include <fcntl.h>
 #include <stdio.h>
 #include <unistd.h>
@@ -68,38 +72,45 @@ int os_sendmsg(const uint8_t *buf, size_t len, int ifindex, const uint8_t *addr,
 	return 0;
 }
 
-int os_recvmsg(uint8_t *buf, size_t *len, int *ifindex, uint8_t *addr, size_t *addrlen) {
-	struct sockaddr_ll lladdr;
-	struct iovec iov = {
-		.iov_base = buf,
-		.iov_len = *len,
-	};
-	struct msghdr msg = {
-		.msg_name = &lladdr,
-		.msg_namelen = sizeof(lladdr),
-		.msg_iov = &iov,
-		.msg_iovlen = 1,
-	};
-	int r;
+/* Receive up to n pending packets with one system call; returns the
+ * number received, or -1 if none could be read. */
+int os_recvmsg(struct os_rxmsg *msgs, int n) {
+	struct sockaddr_ll lladdr[n];
+	struct iovec iov[n];
+	struct mmsghdr mmsg[n];
+	int i, r;
+
+	for(i = 0; i < n; i++) {
+		iov[i] = (struct iovec) {
+			.iov_base = msgs[i].buf,
+			.iov_len = msgs[i].len,
+		};
+		mmsg[i] = (struct mmsghdr) {
+			.msg_hdr = {
+				.msg_name = &lladdr[i],
+				.msg_namelen = sizeof(lladdr[i]),
+				.msg_iov = &iov[i],
+				.msg_iovlen = 1,
+			},
+		};
+	}
 
-	r = recvmsg(nhrp_socket_fd, &msg, MSG_DONTWAIT);
+	r = recvmmsg(nhrp_socket_fd, mmsg, n, MSG_DONTWAIT, NULL);
 	if(r < 0) {
 		return r;
 	}
 
-	*len = r;
-	*ifindex = lladdr.sll_ifindex;
-
-	if(*addrlen <= (size_t) lladdr.sll_addr) {
-		if(memcmp(lladdr.sll_addr, "\x00\x00\x00\x00", 4) != 0) {
-			memcpy(addr, lladdr.sll_addr, lladdr.sll_halen);
-			*addrlen = lladdr.sll_halen;
-		} else {
-			*addrlen = 0;
+	for(i = 0; i < r; i++) {
+		msgs[i].len = mmsg[i].msg_len;
+		msgs[i].ifindex = lladdr[i].sll_ifindex;
+		msgs[i].addrlen = 0;
+		if(lladdr[i].sll_halen <= sizeof(msgs[i].addr) && memcmp(lladdr[i].sll_addr, "\x00\x00\x00\x00", 4) != 0) {
+			memcpy(msgs[i].addr, lladdr[i].sll_addr, lladdr[i].sll_halen);
+			msgs[i].addrlen = lladdr[i].sll_halen;
 		}
 	}
 
-	return 0;
+	return r;
 }
 
 static int linux_configure_arp(const char *iface, int on) {
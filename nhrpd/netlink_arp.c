@@ -24,13 +24,23 @@ int netlink_nflog_group;
 static int netlink_log_fd = -1;
 static struct thread *netlink_log_thread;
 static int netlink_listen_fd = -1;
+static struct znl_batch netlink_neigh_batch;
+static struct thread *netlink_neigh_thread;
 
 typedef void (*netlink_dispatch_f)(struct nlmsghdr *msg, struct zbuf *zb);
 
+static int netlink_neigh_flush(struct thread *t) {
+	netlink_neigh_thread = NULL;
+	znl_batch_flush(&netlink_neigh_batch);
+	return 0;
+}
+
+/* Neighbor updates made while handling a burst of packets go to the
+ * kernel together once the current thread is done. */
 void netlink_update_binding(struct interface *ifp, union sockunion *proto, union sockunion *nbma) {
 	struct nlmsghdr *n;
 	struct ndmsg *ndm;
-	struct zbuf *zb = zbuf_alloc(512);
+	struct zbuf *zb = znl_batch_reserve(&netlink_neigh_batch, 128);
 
 	n = znl_nlmsg_push(zb, nbma ? RTM_NEWNEIGH : RTM_DELNEIGH, NLM_F_REQUEST | NLM_F_REPLACE | NLM_F_CREATE);
 	ndm = znl_push(zb, sizeof(*ndm));
@@ -45,9 +55,10 @@ void netlink_update_binding(struct interface *ifp, union sockunion *proto, union
 		znl_rta_push(zb, NDA_LLADDR, sockunion_get_addr(nbma), family2addrsize(sockunion_family(nbma)));
 	}
 	znl_nlmsg_complete(zb, n);
-	zbuf_send(zb, netlink_req_fd);
-	zbuf_recv(zb, netlink_req_fd);
-	zbuf_free(zb);
+
+	if(!netlink_neigh_thread) {
+		netlink_neigh_thread = thread_add_event(master, netlink_neigh_flush, NULL, 0);
+	}
 }
 
 static void netlink_neigh_msg(struct nlmsghdr *msg, struct zbuf *zb) {
@@ -222,6 +233,7 @@ void netlink_set_nflog_group(int nlgroup) {
 
 int netlink_init(void) {
 	netlink_req_fd = znl_open(NETLINK_ROUTE, 0);
+	znl_batch_init(&netlink_neigh_batch, netlink_req_fd);
 	netlink_listen_fd = znl_open(NETLINK_ROUTE, RTMGRP_NEIGH);
 	thread_add_read(master, netlink_route_recv, 0, netlink_listen_fd);
 
@@ -22,6 +22,13 @@ const char *const nhrp_cache_type_str[] = {
 	[NHRP_CACHE_NHS] = "nhs",	  [NHRP_CACHE_STATIC] = "static",	  [NHRP_CACHE_LOCAL] = "local",
 };
 
+static void nhrp_cache_count(struct nhrp_cache *c, enum nhrp_cache_type type, long delta) {
+	struct nhrp_interface *nifp = c->ifp->info;
+
+	nhrp_cache_counts[type] += delta;
+	nifp->afi[family2afi(sockunion_family(&c->remote_addr))].cache_counts[type] += delta;
+}
+
 static unsigned int nhrp_cache_protocol_key(void *peer_data) {
 	struct nhrp_cache *p = peer_data;
 	return sockunion_hash(&p->remote_addr);
@@ -45,7 +52,7 @@ static void *nhrp_cache_alloc(void *data) {
 			.ifp = key->ifp,
 			.notifier_list = NOTIFIER_LIST_INITIALIZER(&p->notifier_list),
 		};
-		nhrp_cache_counts[p->cur.type]++;
+		nhrp_cache_count(p, p->cur.type, 1);
 	}
 
 	return p;
@@ -56,7 +63,7 @@ static void nhrp_cache_free(struct nhrp_cache *c) {
 
 	zassert(c->cur.type == NHRP_CACHE_INVALID && c->cur.peer == NULL);
 	zassert(c->new.type == NHRP_CACHE_INVALID && c->new.peer == NULL);
-	nhrp_cache_counts[c->cur.type]--;
+	nhrp_cache_count(c, c->cur.type, -1);
 	notifier_call(&c->notifier_list, NOTIFY_CACHE_DELETE);
 	zassert(!notifier_active(&c->notifier_list));
 	hash_release(nifp->cache_hash, c);
@@ -80,20 +87,19 @@ struct nhrp_cache *nhrp_cache_get(struct interface *ifp, union sockunion *remote
 	return hash_get(nifp->cache_hash, &key, create ? nhrp_cache_alloc : NULL);
 }
 
-static int nhrp_cache_do_free(struct thread *t) {
-	struct nhrp_cache *c = THREAD_ARG(t);
-	c->t_timeout = NULL;
+static void nhrp_cache_do_free(struct nhrp_timer *t) {
+	struct nhrp_cache *c = container_of(t, struct nhrp_cache, timeout);
 	nhrp_cache_free(c);
-	return 0;
 }
 
-static int nhrp_cache_do_timeout(struct thread *t) {
-	struct nhrp_cache *c = THREAD_ARG(t);
-	c->t_timeout = NULL;
+static void nhrp_cache_do_timeout(struct nhrp_timer *t) {
+	struct nhrp_cache *c = container_of(t, struct nhrp_cache, timeout);
+	struct nhrp_interface *nifp = c->ifp->info;
+
 	if(c->cur.type != NHRP_CACHE_INVALID) {
+		nifp->afi[family2afi(sockunion_family(&c->remote_addr))].cache_expired++;
 		nhrp_cache_update_binding(c, c->cur.type, -1, NULL, 0, NULL);
 	}
-	return 0;
 }
 
 static void nhrp_cache_update_route(struct nhrp_cache *c) {
@@ -149,7 +155,7 @@ static void nhrp_cache_peer_notifier(struct notifier_block *n, unsigned long cmd
 }
 
 static void nhrp_cache_reset_new(struct nhrp_cache *c) {
-	THREAD_OFF(c->t_auth);
+	nhrp_timer_del(&c->auth);
 	if(list_hashed(&c->newpeer_notifier.notifier_entry)) {
 		nhrp_peer_notify_del(c->new.peer, &c->newpeer_notifier);
 	}
@@ -159,17 +165,17 @@ static void nhrp_cache_reset_new(struct nhrp_cache *c) {
 }
 
 static void nhrp_cache_update_timers(struct nhrp_cache *c) {
-	THREAD_OFF(c->t_timeout);
+	nhrp_timer_del(&c->timeout);
 
 	switch(c->cur.type) {
 		case NHRP_CACHE_INVALID:
-			if(!c->t_auth) {
-				THREAD_TIMER_MSEC_ON(master, c->t_timeout, nhrp_cache_do_free, c, 10);
+			if(!nhrp_timer_pending(&c->auth)) {
+				nhrp_timer_add_msec(&c->timeout, nhrp_cache_do_free, 10);
 			}
 			break;
 		default:
 			if(c->cur.expires) {
-				THREAD_TIMER_ON(master, c->t_timeout, nhrp_cache_do_timeout, c, c->cur.expires - recent_relative_time().tv_sec);
+				nhrp_timer_add(&c->timeout, nhrp_cache_do_timeout, c->cur.expires - recent_relative_time().tv_sec);
 			}
 			break;
 	}
@@ -189,8 +195,8 @@ static void nhrp_cache_authorize_binding(struct nhrp_reqid *r, void *arg) {
 			nhrp_peer_notify_del(c->cur.peer, &c->peer_notifier);
 			nhrp_peer_unref(c->cur.peer);
 		}
-		nhrp_cache_counts[c->cur.type]--;
-		nhrp_cache_counts[c->new.type]++;
+		nhrp_cache_count(c, c->cur.type, -1);
+		nhrp_cache_count(c, c->new.type, 1);
 		c->cur = c->new;
 		c->cur.peer = nhrp_peer_ref(c->cur.peer);
 		nhrp_cache_reset_new(c);
@@ -206,11 +212,9 @@ static void nhrp_cache_authorize_binding(struct nhrp_reqid *r, void *arg) {
 	nhrp_cache_update_timers(c);
 }
 
-static int nhrp_cache_do_auth_timeout(struct thread *t) {
-	struct nhrp_cache *c = THREAD_ARG(t);
-	c->t_auth = NULL;
+static void nhrp_cache_do_auth_timeout(struct nhrp_timer *t) {
+	struct nhrp_cache *c = container_of(t, struct nhrp_cache, auth);
 	nhrp_cache_authorize_binding(&c->eventid, (void *) "timeout");
-	return 0;
 }
 
 static void nhrp_cache_newpeer_notifier(struct notifier_block *n, unsigned long cmd) {
@@ -220,7 +224,9 @@ static void nhrp_cache_newpeer_notifier(struct notifier_block *n, unsigned long
 		case NOTIFY_PEER_UP:
 			if(nhrp_peer_check(c->new.peer, 1)) {
 				evmgr_notify("authorize-binding", c, nhrp_cache_authorize_binding);
-				THREAD_TIMER_ON(master, c->t_auth, nhrp_cache_do_auth_timeout, c, 10);
+				if(!nhrp_timer_pending(&c->auth)) {
+					nhrp_timer_add(&c->auth, nhrp_cache_do_auth_timeout, 10);
+				}
 			}
 			break;
 		case NOTIFY_PEER_DOWN:
@@ -279,7 +285,9 @@ int nhrp_cache_update_binding(struct nhrp_cache *c, enum nhrp_cache_type type, i
 		} else {
 			nhrp_peer_notify_add(c->new.peer, &c->newpeer_notifier, nhrp_cache_newpeer_notifier);
 			nhrp_cache_newpeer_notifier(&c->newpeer_notifier, NOTIFY_PEER_UP);
-			THREAD_TIMER_ON(master, c->t_auth, nhrp_cache_do_auth_timeout, c, 60);
+			if(!nhrp_timer_pending(&c->auth)) {
+				nhrp_timer_add(&c->auth, nhrp_cache_do_auth_timeout, 60);
+			}
 		}
 	}
 	nhrp_cache_update_timers(c);
@@ -142,6 +142,7 @@ static void nhrp_request_stop(void) {
 	vici_terminate();
 	evmgr_terminate();
 	nhrp_vc_terminate();
+	nhrp_timer_terminate();
 	vrf_terminate();
 	/* memory_terminate(); */
 	/* vty_terminate(); */
@@ -198,6 +199,7 @@ int main(int argc, char **argv) {
 	cmd_init(1);
 	vty_init(master);
 	memory_init();
+	nhrp_timer_init();
 	nhrp_interface_init();
 	vrf_init();
 	resolver_init();
@@ -16,7 +16,28 @@
 #include "nhrp_protocol.h"
 #include "os.h"
 
+/* Packets read per socket wakeup */
+#define NHRP_RECV_BATCH 32
+
+/* Registration requests are queued and handled NHRP_REG_BATCH at a
+ * time, so a hub restart answered by every spoke at once does not
+ * hold the daemon; past NHRP_REG_QUEUE_SIZE pending they are dropped
+ * and left to the spokes' retransmission. */
+#define NHRP_REG_QUEUE_SIZE 4096
+#define NHRP_REG_BATCH 128
+
 struct nhrp_reqid_pool nhrp_packet_reqid;
+unsigned long nhrp_packet_reg_queued;
+unsigned long nhrp_packet_reg_dropped;
+
+static struct zbuf *rx_zb[NHRP_RECV_BATCH];
+
+static struct {
+	struct nhrp_peer *peer;
+	struct zbuf *zb;
+} reg_queue[NHRP_REG_QUEUE_SIZE];
+static unsigned int reg_head, reg_count;
+static struct thread *reg_thread;
 
 static uint16_t family2proto(int family) {
 	switch(family) {
@@ -236,37 +257,68 @@ err:
 	return -1;
 }
 
-static int nhrp_packet_recvraw(struct thread *t) {
-	int fd = THREAD_FD(t), ifindex;
-	struct zbuf *zb;
-	struct interface *ifp;
+static int nhrp_packet_do_registrations(struct thread *t) {
 	struct nhrp_peer *p;
-	union sockunion remote_nbma;
-	uint8_t addr[64];
-	size_t len, addrlen;
+	struct zbuf *zb;
+	int n;
 
-	thread_add_read(master, nhrp_packet_recvraw, 0, fd);
+	reg_thread = NULL;
 
-	zb = zbuf_alloc(1500);
-	if(!zb) {
-		return 0;
+	for(n = 0; n < NHRP_REG_BATCH && reg_count; n++) {
+		p = reg_queue[reg_head].peer;
+		zb = reg_queue[reg_head].zb;
+		reg_head = (reg_head + 1) % NHRP_REG_QUEUE_SIZE;
+		reg_count--;
+
+		nhrp_peer_recv(p, zb);
+		nhrp_peer_unref(p);
 	}
 
-	len = zbuf_size(zb);
-	addrlen = sizeof(addr);
-	if(os_recvmsg(zb->buf, &len, &ifindex, addr, &addrlen) < 0) {
-		goto err;
+	/* let packet reads and timers run before the next batch */
+	if(reg_count) {
+		THREAD_TIMER_MSEC_ON(master, reg_thread, nhrp_packet_do_registrations, NULL, 0);
+	}
+
+	return 0;
+}
+
+static void nhrp_packet_queue_registration(struct nhrp_peer *p, struct zbuf *zb) {
+	unsigned int tail;
+
+	if(reg_count >= NHRP_REG_QUEUE_SIZE) {
+		/* the spoke retries; answering it late is no better */
+		nhrp_packet_reg_dropped++;
+		nhrp_peer_unref(p);
+		zbuf_free(zb);
+		return;
+	}
+
+	tail = (reg_head + reg_count) % NHRP_REG_QUEUE_SIZE;
+	reg_queue[tail].peer = p;
+	reg_queue[tail].zb = zb;
+	reg_count++;
+	nhrp_packet_reg_queued++;
+
+	if(!reg_thread) {
+		THREAD_TIMER_MSEC_ON(master, reg_thread, nhrp_packet_do_registrations, NULL, 0);
 	}
+}
+
+static void nhrp_packet_dispatch(struct zbuf *zb, struct os_rxmsg *msg) {
+	struct nhrp_packet_header *hdr;
+	struct interface *ifp;
+	struct nhrp_peer *p;
+	union sockunion remote_nbma;
 
 	zb->head = zb->buf;
-	zb->tail = zb->buf + len;
+	zb->tail = zb->buf + msg->len;
 
-	switch(addrlen) {
-		case 4: sockunion_set(&remote_nbma, AF_INET, addr, addrlen); break;
+	switch(msg->addrlen) {
+		case 4: sockunion_set(&remote_nbma, AF_INET, msg->addr, msg->addrlen); break;
 		default: goto err;
 	}
 
-	ifp = if_lookup_by_index(ifindex);
+	ifp = if_lookup_by_index(msg->ifindex);
 	if(!ifp) {
 		goto err;
 	}
@@ -276,12 +328,49 @@ static int nhrp_packet_recvraw(struct thread *t) {
 		goto err;
 	}
 
+	hdr = (struct nhrp_packet_header *) zb->head;
+	if(zbuf_used(zb) >= sizeof(*hdr) && hdr->type == NHRP_PACKET_REGISTRATION_REQUEST) {
+		nhrp_packet_queue_registration(p, zb);
+		return;
+	}
+
 	nhrp_peer_recv(p, zb);
 	nhrp_peer_unref(p);
-	return 0;
+	return;
 
 err:
 	zbuf_free(zb);
+}
+
+static int nhrp_packet_recvraw(struct thread *t) {
+	struct os_rxmsg msgs[NHRP_RECV_BATCH];
+	struct zbuf *zb;
+	int fd = THREAD_FD(t), i, n;
+
+	thread_add_read(master, nhrp_packet_recvraw, 0, fd);
+
+	for(n = 0; n < NHRP_RECV_BATCH; n++) {
+		if(!rx_zb[n]) {
+			rx_zb[n] = zbuf_alloc(1500);
+			if(!rx_zb[n]) {
+				break;
+			}
+		}
+		msgs[n].buf = rx_zb[n]->buf;
+		msgs[n].len = zbuf_size(rx_zb[n]);
+	}
+
+	if(n == 0) {
+		return 0;
+	}
+
+	n = os_recvmsg(msgs, n);
+	for(i = 0; i < n; i++) {
+		zb = rx_zb[i];
+		rx_zb[i] = NULL;
+		nhrp_packet_dispatch(zb, &msgs[i]);
+	}
+
 	return 0;
 }
 
@@ -14,30 +14,56 @@
 #include "log.h"
 #include "nhrp_protocol.h"
 
+/* Resolution requests renewing used shortcuts sent per refresh run */
+#define NHRP_SHORTCUT_REFRESH_BATCH 64
+
 static struct route_table *shortcut_rib[AFI_MAX];
 
-static int nhrp_shortcut_do_purge(struct thread *t);
+/* Expiring shortcuts waiting for their renewal request; a hub route
+ * change soft-expires many at once, and they are sent in runs of
+ * NHRP_SHORTCUT_REFRESH_BATCH instead of in one burst. */
+static struct list_head refresh_list = LIST_INITIALIZER(refresh_list);
+static struct nhrp_timer refresh_timer;
+
+static void nhrp_shortcut_do_purge(struct nhrp_timer *t);
 static void nhrp_shortcut_delete(struct nhrp_shortcut *s);
 static void nhrp_shortcut_send_resolution_req(struct nhrp_shortcut *s);
 
+static void nhrp_shortcut_do_refresh(struct nhrp_timer *t) {
+	struct nhrp_shortcut *s;
+	int n;
+
+	for(n = 0; n < NHRP_SHORTCUT_REFRESH_BATCH && list_hashed(&refresh_list); n++) {
+		s = list_entry(refresh_list.next, struct nhrp_shortcut, refresh_entry);
+		list_del(&s->refresh_entry);
+		if(s->expiring) {
+			nhrp_shortcut_send_resolution_req(s);
+		}
+	}
+
+	if(list_hashed(&refresh_list)) {
+		nhrp_timer_add_msec(&refresh_timer, nhrp_shortcut_do_refresh, 0);
+	}
+}
+
 static void nhrp_shortcut_check_use(struct nhrp_shortcut *s) {
 	char buf[PREFIX_STRLEN];
 
-	if(s->expiring && s->cache && s->cache->used) {
+	if(s->expiring && s->cache && s->cache->used && !list_hashed(&s->refresh_entry)) {
 		debugf(NHRP_DEBUG_ROUTE, "Shortcut %s used and expiring", prefix2str(s->p, buf, sizeof buf));
-		nhrp_shortcut_send_resolution_req(s);
+		list_add_tail(&s->refresh_entry, &refresh_list);
+		if(!nhrp_timer_pending(&refresh_timer)) {
+			nhrp_timer_add_msec(&refresh_timer, nhrp_shortcut_do_refresh, 0);
+		}
 	}
 }
 
-static int nhrp_shortcut_do_expire(struct thread *t) {
-	struct nhrp_shortcut *s = THREAD_ARG(t);
+static void nhrp_shortcut_do_expire(struct nhrp_timer *t) {
+	struct nhrp_shortcut *s = container_of(t, struct nhrp_shortcut, timer);
 
-	s->t_timer = NULL;
-	THREAD_TIMER_ON(master, s->t_timer, nhrp_shortcut_do_purge, s, s->holding_time / 3);
+	nhrp_timer_add(&s->timer, nhrp_shortcut_do_purge, s->holding_time / 3);
 	s->expiring = 1;
 	nhrp_shortcut_check_use(s);
-
-	return 0;
 }
 
 static void nhrp_shortcut_cache_notify(struct notifier_block *n, unsigned long cmd) {
@@ -92,11 +118,11 @@ static void nhrp_shortcut_update_binding(struct nhrp_shortcut *s, enum nhrp_cach
 		s->route_installed = 0;
 	}
 
-	THREAD_OFF(s->t_timer);
+	nhrp_timer_del(&s->timer);
 	if(holding_time) {
 		s->expiring = 0;
 		s->holding_time = holding_time;
-		THREAD_TIMER_ON(master, s->t_timer, nhrp_shortcut_do_expire, s, 2 * holding_time / 3);
+		nhrp_timer_add(&s->timer, nhrp_shortcut_do_expire, 2 * holding_time / 3);
 	}
 }
 
@@ -105,7 +131,10 @@ static void nhrp_shortcut_delete(struct nhrp_shortcut *s) {
 	afi_t afi = family2afi(PREFIX_FAMILY(s->p));
 	char buf[PREFIX_STRLEN];
 
-	THREAD_OFF(s->t_timer);
+	nhrp_timer_del(&s->timer);
+	if(list_hashed(&s->refresh_entry)) {
+		list_del(&s->refresh_entry);
+	}
 	nhrp_reqid_free(&nhrp_packet_reqid, &s->reqid);
 
 	debugf(NHRP_DEBUG_ROUTE, "Shortcut %s purged", prefix2str(s->p, buf, sizeof buf));
@@ -122,11 +151,9 @@ static void nhrp_shortcut_delete(struct nhrp_shortcut *s) {
 	}
 }
 
-static int nhrp_shortcut_do_purge(struct thread *t) {
-	struct nhrp_shortcut *s = THREAD_ARG(t);
-	s->t_timer = NULL;
+static void nhrp_shortcut_do_purge(struct nhrp_timer *t) {
+	struct nhrp_shortcut *s = container_of(t, struct nhrp_shortcut, timer);
 	nhrp_shortcut_delete(s);
-	return 0;
 }
 
 static struct nhrp_shortcut *nhrp_shortcut_get(struct prefix *p) {
@@ -167,8 +194,7 @@ static void nhrp_shortcut_recv_resolution_rep(struct nhrp_reqid *reqid, void *ar
 	int holding_time = pp->if_ad->holdtime;
 
 	nhrp_reqid_free(&nhrp_packet_reqid, &s->reqid);
-	THREAD_OFF(s->t_timer);
-	THREAD_TIMER_ON(master, s->t_timer, nhrp_shortcut_do_purge, s, 1);
+	nhrp_timer_add(&s->timer, nhrp_shortcut_do_purge, 1);
 
 	if(pp->hdr->type != NHRP_PACKET_RESOLUTION_REPLY) {
 		if(pp->hdr->type == NHRP_PACKET_ERROR_INDICATION && pp->hdr->u.error.code == NHRP_ERROR_PROTOCOL_ADDRESS_UNREACHABLE) {
@@ -300,8 +326,7 @@ void nhrp_shortcut_initiate(union sockunion *addr) {
 	s = nhrp_shortcut_get(&p);
 	if(s && s->type != NHRP_CACHE_INCOMPLETE) {
 		s->addr = *addr;
-		THREAD_OFF(s->t_timer);
-		THREAD_TIMER_ON(master, s->t_timer, nhrp_shortcut_do_purge, s, 30);
+		nhrp_timer_add(&s->timer, nhrp_shortcut_do_purge, 30);
 		nhrp_shortcut_send_resolution_req(s);
 	}
 }
@@ -312,6 +337,7 @@ void nhrp_shortcut_init(void) {
 }
 
 void nhrp_shortcut_terminate(void) {
+	nhrp_timer_del(&refresh_timer);
 	route_table_finish(shortcut_rib[AFI_IP]);
 	route_table_finish(shortcut_rib[AFI_IP6]);
 }
@@ -340,12 +366,12 @@ struct purge_ctx {
 };
 
 void nhrp_shortcut_purge(struct nhrp_shortcut *s, int force) {
-	THREAD_OFF(s->t_timer);
+	nhrp_timer_del(&s->timer);
 	nhrp_reqid_free(&nhrp_packet_reqid, &s->reqid);
 
 	if(force) {
 		/* Immediate purge on route with draw or pending shortcut */
-		THREAD_TIMER_MSEC_ON(master, s->t_timer, nhrp_shortcut_do_purge, s, 5);
+		nhrp_timer_add_msec(&s->timer, nhrp_shortcut_do_purge, 5);
 	} else {
 		/* Soft expire - force immediate renewal, but purge
 		 * in few seconds to make sure stale route is not
@@ -354,7 +380,7 @@ void nhrp_shortcut_purge(struct nhrp_shortcut *s, int force) {
 		 * This allows to keep nhrp route up, and to not
 		 * cause temporary rerouting via hubs causing latency
 		 * jitter. */
-		THREAD_TIMER_MSEC_ON(master, s->t_timer, nhrp_shortcut_do_purge, s, 3000);
+		nhrp_timer_add_msec(&s->timer, nhrp_shortcut_do_purge, 3000);
 		s->expiring = 1;
 		nhrp_shortcut_check_use(s);
 	}
@@ -0,0 +1,116 @@
+/* NHRP timer wheel
+ *
+ * This file is free software: you may copy, redistribute and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ */
+
+/* Cache entries and shortcuts each carry a lifetime timer, and a hub
+ * with thousands of spokes would otherwise keep as many threads on the
+ * master timer heap. They are hashed here into a wheel of
+ * NHRP_TIMER_SLOTS lists, NHRP_TIMER_TICK_MSEC apart, driven by a
+ * single thread that only runs while some timer is pending. Arming
+ * and cancelling are O(1); a tick visits one slot. */
+
+#include "zebra.h"
+#include "thread.h"
+#include "nhrpd.h"
+
+#define NHRP_TIMER_TICK_MSEC 100
+#define NHRP_TIMER_SLOTS 1024
+
+static struct list_head wheel[NHRP_TIMER_SLOTS];
+static struct thread *t_wheel;
+static unsigned long wheel_count;
+static int64_t wheel_tick; /* last tick processed */
+
+static int64_t nhrp_timer_now(void) {
+	struct timeval tv = recent_relative_time();
+	return ((int64_t) tv.tv_sec * 1000 + tv.tv_usec / 1000) / NHRP_TIMER_TICK_MSEC;
+}
+
+static int nhrp_timer_run(struct thread *t) {
+	struct list_head expired = LIST_INITIALIZER(expired);
+	struct nhrp_timer *tm, *n;
+	int64_t now = nhrp_timer_now();
+	int64_t tick, last;
+
+	t_wheel = NULL;
+
+	/* after a stall, one lap covers every slot */
+	last = now;
+	if(last - wheel_tick > NHRP_TIMER_SLOTS) {
+		last = wheel_tick + NHRP_TIMER_SLOTS;
+	}
+
+	for(tick = wheel_tick + 1; tick <= last; tick++) {
+		list_for_each_entry_safe(tm, n, &wheel[tick % NHRP_TIMER_SLOTS], timer_entry) {
+			if(tm->expires <= now) {
+				list_del(&tm->timer_entry);
+				list_add_tail(&tm->timer_entry, &expired);
+			}
+		}
+	}
+	wheel_tick = now;
+
+	/* callbacks may arm or cancel any timer, including expired ones */
+	while(list_hashed(&expired)) {
+		tm = list_entry(expired.next, struct nhrp_timer, timer_entry);
+		list_del(&tm->timer_entry);
+		wheel_count--;
+		tm->cb(tm);
+	}
+
+	if(wheel_count && !t_wheel) {
+		THREAD_TIMER_MSEC_ON(master, t_wheel, nhrp_timer_run, NULL, NHRP_TIMER_TICK_MSEC);
+	}
+
+	return 0;
+}
+
+void nhrp_timer_add_msec(struct nhrp_timer *tm, void (*cb)(struct nhrp_timer *), long msec) {
+	struct timeval tv = recent_relative_time();
+	int64_t expires;
+
+	nhrp_timer_del(tm);
+
+	if(!wheel_count) {
+		wheel_tick = nhrp_timer_now();
+	}
+
+	expires = ((int64_t) tv.tv_sec * 1000 + tv.tv_usec / 1000 + msec + NHRP_TIMER_TICK_MSEC - 1) / NHRP_TIMER_TICK_MSEC;
+	if(expires <= wheel_tick) {
+		expires = wheel_tick + 1;
+	}
+
+	tm->cb = cb;
+	tm->expires = expires;
+	list_add_tail(&tm->timer_entry, &wheel[expires % NHRP_TIMER_SLOTS]);
+	wheel_count++;
+
+	if(!t_wheel) {
+		THREAD_TIMER_MSEC_ON(master, t_wheel, nhrp_timer_run, NULL, NHRP_TIMER_TICK_MSEC);
+	}
+}
+
+void nhrp_timer_del(struct nhrp_timer *tm) {
+	if(!nhrp_timer_pending(tm)) {
+		return;
+	}
+
+	list_del(&tm->timer_entry);
+	wheel_count--;
+}
+
+void nhrp_timer_init(void) {
+	int i;
+
+	for(i = 0; i < NHRP_TIMER_SLOTS; i++) {
+		list_init(&wheel[i]);
+	}
+}
+
+void nhrp_timer_terminate(void) {
+	THREAD_OFF(t_wheel);
+}
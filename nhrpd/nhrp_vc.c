@@ -19,6 +19,7 @@
 
 struct child_sa {
 	uint32_t id;
+	unsigned stale : 1;
 	struct nhrp_vc *vc;
 	struct list_head childlist_entry;
 };
@@ -116,6 +117,10 @@ int nhrp_vc_ipsec_updown(uint32_t child_id, struct nhrp_vc *vc) {
 		list_add_tail(&sa->childlist_entry, &childlist_head[child_hash]);
 	}
 
+	if(vc) {
+		sa->stale = 0;
+	}
+
 	if(sa->vc == vc) {
 		return 0;
 	}
@@ -196,6 +201,32 @@ void nhrp_vc_reset(void) {
 	}
 }
 
+/* IKE state is resynchronized from a full SA listing: every known
+ * child SA is marked stale first, the listing refreshes the ones that
+ * still exist, and the remaining stale ones are then dropped. VCs whose
+ * SAs survived never see a down/up cycle. */
+void nhrp_vc_ipsec_mark_stale(void) {
+	struct child_sa *sa;
+	size_t i;
+
+	for(i = 0; i < ZEBRA_NUM_OF(childlist_head); i++) {
+		list_for_each_entry(sa, &childlist_head[i], childlist_entry) sa->stale = 1;
+	}
+}
+
+void nhrp_vc_ipsec_sweep_stale(void) {
+	struct child_sa *sa, *n;
+	size_t i;
+
+	for(i = 0; i < ZEBRA_NUM_OF(childlist_head); i++) {
+		list_for_each_entry_safe(sa, n, &childlist_head[i], childlist_entry) {
+			if(sa->stale) {
+				nhrp_vc_ipsec_updown(sa->id, 0);
+			}
+		}
+	}
+}
+
 void nhrp_vc_terminate(void) {
 	nhrp_vc_reset();
 	hash_clean(nhrp_vc_hash, nhrp_vc_free);
@@ -506,7 +506,7 @@ static void show_ip_nhrp_cache(struct nhrp_cache *c, void *pctx) {
 	ctx->count++;
 
 	vty_out(ctx->vty, "%-8s %-8s %-24s %-24s %c%c%c    %s%s", c->ifp->name, nhrp_cache_type_str[c->cur.type], sockunion2str(&c->remote_addr, buf[0], sizeof buf[0]),
-		c->cur.peer ? sockunion2str(&c->cur.peer->vc->remote.nbma, buf[1], sizeof buf[1]) : "-", c->used ? 'U' : ' ', c->t_timeout ? 'T' : ' ', c->t_auth ? 'A' : ' ', c->cur.peer ? c->cur.peer->vc->remote.id : "-", VTY_NEWLINE);
+		c->cur.peer ? sockunion2str(&c->cur.peer->vc->remote.nbma, buf[1], sizeof buf[1]) : "-", c->used ? 'U' : ' ', nhrp_timer_pending(&c->timeout) ? 'T' : ' ', nhrp_timer_pending(&c->auth) ? 'A' : ' ', c->cur.peer ? c->cur.peer->vc->remote.id : "-", VTY_NEWLINE);
 }
 
 static void show_ip_nhrp_nhs(struct nhrp_nhs *n, struct nhrp_registration *reg, void *pctx) {
@@ -539,6 +539,34 @@ static void show_ip_nhrp_shortcut(struct nhrp_shortcut *s, void *pctx) {
 		VTY_NEWLINE);
 }
 
+static void show_ip_nhrp_statistics(struct interface *ifp, struct info_ctx *ctx) {
+	struct nhrp_interface *nifp = ifp->info;
+	struct vty *vty = ctx->vty;
+	struct nhrp_afi_data *ad;
+	unsigned long total = 0;
+	int i;
+
+	if(!nifp) {
+		return;
+	}
+
+	ad = &nifp->afi[ctx->afi];
+	for(i = 0; i < NHRP_CACHE_NUM_TYPES; i++) {
+		total += ad->cache_counts[i];
+	}
+	if(!total && !ad->cache_expired) {
+		return;
+	}
+
+	if(!ctx->count) {
+		vty_out(vty, "%-8s %8s %10s %8s %8s %8s %8s %8s %8s %8s%s", "Iface", "Total", "Incomplete", "Negative", "Cached", "Dynamic", "NHS", "Static", "Local", "Expired", VTY_NEWLINE);
+	}
+	ctx->count++;
+
+	vty_out(vty, "%-8s %8lu %10lu %8lu %8lu %8lu %8lu %8lu %8lu %8lu%s", ifp->name, total, ad->cache_counts[NHRP_CACHE_INCOMPLETE], ad->cache_counts[NHRP_CACHE_NEGATIVE], ad->cache_counts[NHRP_CACHE_CACHED],
+		ad->cache_counts[NHRP_CACHE_DYNAMIC], ad->cache_counts[NHRP_CACHE_NHS], ad->cache_counts[NHRP_CACHE_STATIC], ad->cache_counts[NHRP_CACHE_LOCAL], ad->cache_expired, VTY_NEWLINE);
+}
+
 static void show_ip_opennhrp_cache(struct nhrp_cache *c, void *pctx) {
 	struct info_ctx *ctx = pctx;
 	struct vty *vty = ctx->vty;
@@ -566,11 +594,12 @@ static void show_ip_opennhrp_cache(struct nhrp_cache *c, void *pctx) {
 	vty_out(ctx->vty, "%s", VTY_NEWLINE);
 }
 
-DEFUN(show_ip_nhrp, show_ip_nhrp_cmd, "show " AFI_CMD " nhrp (cache|nhs|shortcut|opennhrp|)",
+DEFUN(show_ip_nhrp, show_ip_nhrp_cmd, "show " AFI_CMD " nhrp (cache|nhs|shortcut|statistics|opennhrp|)",
       SHOW_STR AFI_STR "NHRP information\n"
 		       "Forwarding cache information\n"
 		       "Next hop server information\n"
 		       "Shortcut information\n"
+		       "Per interface cache statistics\n"
 		       "opennhrpctl style cache dump\n") {
 	struct listnode *node;
 	struct interface *ifp;
@@ -587,6 +616,12 @@ DEFUN(show_ip_nhrp, show_ip_nhrp_cmd, "show " AFI_CMD " nhrp (cache|nhs|shortcut
 		for(ALL_LIST_ELEMENTS_RO(iflist, node, ifp)) {
 			nhrp_nhs_foreach(ifp, ctx.afi, show_ip_nhrp_nhs, &ctx);
 		}
+	} else if(argv[1][0] == 's' && argv[1][1] == 't') {
+		for(ALL_LIST_ELEMENTS_RO(iflist, node, ifp)) {
+			show_ip_nhrp_statistics(ifp, &ctx);
+		}
+		vty_out(vty, "%sRegistration requests: %lu queued, %lu dropped%s", ctx.count ? VTY_NEWLINE : "", nhrp_packet_reg_queued, nhrp_packet_reg_dropped, VTY_NEWLINE);
+		ctx.count++;
 	} else if(argv[1][0] == 's') {
 		nhrp_shortcut_foreach(ctx.afi, show_ip_nhrp_shortcut, &ctx);
 	} else {
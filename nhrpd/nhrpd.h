@@ -72,6 +72,23 @@ static inline int notifier_active(struct notifier_list *l) {
 	return !list_empty(&l->notifier_head);
 }
 
+struct nhrp_timer {
+	struct list_head timer_entry;
+	int64_t expires;
+	void (*cb)(struct nhrp_timer *);
+};
+
+static inline int nhrp_timer_pending(const struct nhrp_timer *t) {
+	return list_hashed(&t->timer_entry);
+}
+
+void nhrp_timer_init(void);
+void nhrp_timer_terminate(void);
+void nhrp_timer_add_msec(struct nhrp_timer *t, void (*cb)(struct nhrp_timer *), long msec);
+void nhrp_timer_del(struct nhrp_timer *t);
+
+#define nhrp_timer_add(t, cb, sec) nhrp_timer_add_msec(t, cb, (sec) * 1000L)
+
 struct resolver_query {
 	void (*callback)(struct resolver_query *, int n, union sockunion *);
 };
@@ -173,6 +190,8 @@ struct nhrp_reqid {
 };
 
 extern struct nhrp_reqid_pool nhrp_packet_reqid;
+extern unsigned long nhrp_packet_reg_queued;
+extern unsigned long nhrp_packet_reg_dropped;
 extern struct nhrp_reqid_pool nhrp_event_reqid;
 
 enum nhrp_cache_type {
@@ -203,8 +222,8 @@ struct nhrp_cache {
 	struct notifier_block newpeer_notifier;
 	struct notifier_list notifier_list;
 	struct nhrp_reqid eventid;
-	struct thread *t_timeout;
-	struct thread *t_auth;
+	struct nhrp_timer timeout;
+	struct nhrp_timer auth;
 
 	struct {
 		enum nhrp_cache_type type;
@@ -220,7 +239,8 @@ struct nhrp_shortcut {
 	union sockunion addr;
 
 	struct nhrp_reqid reqid;
-	struct thread *t_timer;
+	struct nhrp_timer timer;
+	struct list_head refresh_entry;
 
 	enum nhrp_cache_type type;
 	unsigned int holding_time;
@@ -289,6 +309,8 @@ struct nhrp_interface {
 		unsigned short mtu;
 		unsigned int holdtime;
 		struct list_head nhslist_head;
+		unsigned long cache_counts[NHRP_CACHE_NUM_TYPES];
+		unsigned long cache_expired;
 	} afi[AFI_MAX];
 };
 
@@ -346,6 +368,8 @@ void nhrp_vc_notify_add(struct nhrp_vc *, struct notifier_block *, notifier_fn_t
 void nhrp_vc_notify_del(struct nhrp_vc *, struct notifier_block *);
 void nhrp_vc_foreach(void (*cb)(struct nhrp_vc *, void *), void *ctx);
 void nhrp_vc_reset(void);
+void nhrp_vc_ipsec_mark_stale(void);
+void nhrp_vc_ipsec_sweep_stale(void);
 
 void vici_init(void);
 void vici_terminate(void);
@@ -1,5 +1,13 @@
 
+struct os_rxmsg {
+	uint8_t *buf;
+	size_t len; /* buffer size in, packet length out */
+	int ifindex;
+	uint8_t addr[16];
+	size_t addrlen;
+};
+
 int os_socket(void);
 int os_sendmsg(const uint8_t *buf, size_t len, int ifindex, const uint8_t *addr, size_t addrlen);
-int os_recvmsg(uint8_t *buf, size_t *len, int *ifindex, uint8_t *addr, size_t *addrlen);
+int os_recvmsg(struct os_rxmsg *msgs, int n);
 int os_configure_dmvpn(unsigned int ifindex, const char *ifname, int af);
@@ -41,8 +41,13 @@ static int blob2buf(const struct blob *b, char *buf, size_t n) {
 	return 1;
 }
 
+/* Seconds SA state is kept after losing strongSwan, waiting for a
+ * reconnect and listing to confirm it */
+#define VICI_RESYNC_GRACE 30
+
 struct vici_conn {
-	struct thread *t_reconnect, *t_read, *t_write;
+	struct thread *t_reconnect, *t_read, *t_write, *t_grace;
+	unsigned int cmd_sent, cmd_done, list_cmd;
 	struct zbuf ibuf;
 	struct zbuf_queue obuf;
 	int fd;
@@ -63,9 +68,23 @@ static void vici_zbuf_puts(struct zbuf *obuf, const char *str) {
 	zbuf_put(obuf, str, len);
 }
 
-static void vici_connection_error(struct vici_conn *vici) {
+static int vici_grace_expired(struct thread *t) {
+	struct vici_conn *vici = THREAD_ARG(t);
+
+	vici->t_grace = NULL;
+	debugf(NHRP_DEBUG_COMMON, "VICI: SA state not confirmed, resetting");
 	nhrp_vc_reset();
 
+	return 0;
+}
+
+static void vici_connection_error(struct vici_conn *vici) {
+	/* SAs outlive a strongSwan connection loss; keep them until a
+	 * fresh listing says otherwise, instead of bouncing every VC */
+	if(!vici->t_grace) {
+		THREAD_TIMER_ON(master, vici->t_grace, vici_grace_expired, vici, VICI_RESYNC_GRACE);
+	}
+
 	THREAD_OFF(vici->t_read);
 	THREAD_OFF(vici->t_write);
 	zbuf_reset(&vici->ibuf);
@@ -239,6 +258,19 @@ static void vici_recv_sa(struct vici_conn *vici, struct zbuf *msg, int event) {
 	}
 }
 
+/* Commands are answered in order; the listing's answer comes after
+ * all of its list-sa events */
+static void vici_cmd_done(struct vici_conn *vici) {
+	if(++vici->cmd_done != vici->list_cmd) {
+		return;
+	}
+
+	debugf(NHRP_DEBUG_COMMON, "VICI: SA listing complete");
+	vici->list_cmd = 0;
+	THREAD_OFF(vici->t_grace);
+	nhrp_vc_ipsec_sweep_stale();
+}
+
 static void vici_recv_message(struct vici_conn *vici, struct zbuf *msg) {
 	uint32_t msglen;
 	uint8_t msgtype;
@@ -262,9 +294,13 @@ static void vici_recv_message(struct vici_conn *vici, struct zbuf *msg) {
 				vici_recv_sa(vici, msg, 2);
 			}
 			break;
-		case VICI_CMD_RESPONSE: vici_parse_message(vici, msg, parse_cmd_response, 0); break;
-		case VICI_EVENT_UNKNOWN:
-		case VICI_CMD_UNKNOWN: zlog_err("VICI: StrongSwan does not support mandatory events (unpatched?)"); break;
+		case VICI_CMD_RESPONSE:
+			vici_parse_message(vici, msg, parse_cmd_response, 0);
+			vici_cmd_done(vici);
+			break;
+		case VICI_CMD_UNKNOWN: vici_cmd_done(vici);
+		/* fallthrough */
+		case VICI_EVENT_UNKNOWN: zlog_err("VICI: StrongSwan does not support mandatory events (unpatched?)"); break;
 		case VICI_EVENT_CONFIRM: break;
 		default: zlog_notice("VICI: Unrecognized message type %d", msgtype); break;
 	}
@@ -358,6 +394,9 @@ static void vici_submit_request(struct vici_conn *vici, const char *name, ...) {
 	}
 	va_end(va);
 	*hdrlen = htonl(zbuf_used(obuf) - 4);
+	if(vici->fd >= 0) {
+		vici->cmd_sent++;
+	}
 	vici_submit(vici, obuf);
 }
 
@@ -399,6 +438,7 @@ static int vici_reconnect(struct thread *t) {
 
 	debugf(NHRP_DEBUG_COMMON, "VICI: Connected");
 	vici->fd = fd;
+	vici->cmd_sent = vici->cmd_done = 0;
 	THREAD_READ_ON(master, vici->t_read, vici_read, vici, vici->fd);
 
 	/* Send event subscribtions */
@@ -408,7 +448,11 @@ static int vici_reconnect(struct thread *t) {
 	vici_register_event(vici, "child-state-rekeyed");
 	vici_register_event(vici, "child-state-destroying");
 	vici_register_event(vici, "list-sa");
+
+	/* One bulk listing rebuilds the SA index */
+	nhrp_vc_ipsec_mark_stale();
 	vici_submit_request(vici, "list-sas", VICI_END);
+	vici->list_cmd = vici->cmd_sent;
 
 	return 0;
 }
@@ -428,8 +472,16 @@ void vici_terminate(void) {}
 
 void vici_request_vc(const char *profile, union sockunion *src, union sockunion *dst, int prio) {
 	struct vici_conn *vici = &vici_connection;
+	struct nhrp_vc *vc;
 	char buf[2][SU_ADDRSTRLEN];
 
+	/* The SA index already has a child SA for this pair; its VC comes
+	 * up without another IKE exchange */
+	vc = nhrp_vc_get(src, dst, 0);
+	if(vc && vc->ipsec) {
+		return;
+	}
+
 	sockunion2str(src, buf[0], sizeof buf[0]);
 	sockunion2str(dst, buf[1], sizeof buf[1]);
 
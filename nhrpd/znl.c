@@ -161,3 +161,38 @@ error:
 	close(fd);
 	return -1;
 }
+
+void znl_batch_init(struct znl_batch *b, int fd) {
+	b->fd = fd;
+	zbuf_init(&b->zb, b->buf, sizeof(b->buf), 0);
+}
+
+/* Room for one more message of up to len bytes, flushing if needed */
+struct zbuf *znl_batch_reserve(struct znl_batch *b, size_t len) {
+	if(zbuf_tailroom(&b->zb) < ZNL_ALIGN(len)) {
+		znl_batch_flush(b);
+	}
+	return &b->zb;
+}
+
+int znl_batch_flush(struct znl_batch *b) {
+	uint8_t buf[ZNL_BUFFER_SIZE];
+	struct zbuf zb;
+	int r;
+
+	if(!zbuf_used(&b->zb)) {
+		return 0;
+	}
+
+	r = zbuf_send(&b->zb, b->fd);
+	zbuf_reset(&b->zb);
+
+	/* the kernel handles the whole datagram before send returns, so
+	 * any error replies are already queued */
+	zbuf_init(&zb, buf, sizeof(buf), 0);
+	while(zbuf_recv(&zb, b->fd) > 0) {
+		zbuf_reset(&zb);
+	}
+
+	return r;
+}
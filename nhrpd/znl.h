@@ -7,10 +7,21 @@
  * (at your option) any later version.
  */
 
+#ifndef ZNL_H
+#define ZNL_H
+
 #include "zbuf.h"
 
 #define ZNL_BUFFER_SIZE 8192
 
+/* Requests queued to be sent in one datagram. Only errors are read
+ * back, so the messages must not ask for acks or dumps. */
+struct znl_batch {
+	int fd;
+	struct zbuf zb;
+	uint8_t buf[ZNL_BUFFER_SIZE];
+};
+
 void *znl_push(struct zbuf *zb, size_t n);
 void *znl_pull(struct zbuf *zb, size_t n);
 
@@ -26,3 +37,9 @@ void znl_rta_nested_complete(struct zbuf *zb, struct rtattr *rta);
 struct rtattr *znl_rta_pull(struct zbuf *zb, struct zbuf *payload);
 
 int znl_open(int protocol, int groups);
+
+void znl_batch_init(struct znl_batch *b, int fd);
+struct zbuf *znl_batch_reserve(struct znl_batch *b, size_t len);
+int znl_batch_flush(struct znl_batch *b);
+
+#endif
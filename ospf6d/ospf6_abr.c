@@ -225,7 +225,7 @@ void ospf6_abr_originate_summary_to_area(struct ospf6_route *route, struct ospf6
 	}
 
 	/* do not generate if the nexthops belongs to the target area */
-	oi = ospf6_interface_lookup_by_ifindex(route->nexthop[0].ifindex);
+	oi = ospf6_interface_lookup_by_ifindex(ospf6_route_nexthop(route, 0)->ifindex);
 	if(oi && oi->area && oi->area == area) {
 		if(is_debug) {
 			zlog_debug("The route's nexthop is in the same area, ignore");
@@ -387,7 +387,7 @@ void ospf6_abr_originate_summary_to_area(struct ospf6_route *route, struct ospf6
 	summary->path.area_id = area->area_id;
 	summary->path.type = OSPF6_PATH_TYPE_INTER;
 	summary->path.cost = route->path.cost;
-	summary->nexthop[0] = route->nexthop[0];
+	ospf6_route_set_nexthops(summary, ospf6_route_nexthop(route, 0), 1);
 
 	/* prepare buffer */
 	memset(buffer, 0, sizeof(buffer));
@@ -493,7 +493,6 @@ void ospf6_abr_examin_summary(struct ospf6_lsa *lsa, struct ospf6_area *oa) {
 	u_int8_t prefix_options = 0;
 	u_int32_t cost = 0;
 	u_char router_bits = 0;
-	int i;
 	char buf[64];
 	int is_debug = 0;
 	struct ospf6_inter_prefix_lsa *prefix_lsa = NULL;
@@ -695,9 +694,7 @@ void ospf6_abr_examin_summary(struct ospf6_lsa *lsa, struct ospf6_area *oa) {
 	route->path.area_id = oa->area_id;
 	route->path.type = OSPF6_PATH_TYPE_INTER;
 	route->path.cost = abr_entry->path.cost + cost;
-	for(i = 0; i < OSPF6_MULTI_PATH_LIMIT; i++) {
-		route->nexthop[i] = abr_entry->nexthop[i];
-	}
+	ospf6_route_copy_nexthops(route, abr_entry);
 
 	if(is_debug) {
 		zlog_debug("Install route: %s", buf);
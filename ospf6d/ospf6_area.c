@@ -60,6 +60,7 @@ static void ospf6_area_lsdb_hook_add(struct ospf6_lsa *lsa) {
 				zlog_debug("Examin %s", lsa->name);
 				zlog_debug("Schedule SPF Calculation for %s", OSPF6_AREA(lsa->lsdb->data)->name);
 			}
+			SET_FLAG(OSPF6_AREA(lsa->lsdb->data)->flag, OSPF6_AREA_SPF_PENDING);
 			ospf6_spf_schedule(OSPF6_PROCESS(OSPF6_AREA(lsa->lsdb->data)->ospf6), ospf6_lsadd_to_spf_reason(lsa));
 			break;
 
@@ -80,6 +81,7 @@ static void ospf6_area_lsdb_hook_remove(struct ospf6_lsa *lsa) {
 				zlog_debug("LSA disappearing: %s", lsa->name);
 				zlog_debug("Schedule SPF Calculation for %s", OSPF6_AREA(lsa->lsdb->data)->name);
 			}
+			SET_FLAG(OSPF6_AREA(lsa->lsdb->data)->flag, OSPF6_AREA_SPF_PENDING);
 			ospf6_spf_schedule(OSPF6_PROCESS(OSPF6_AREA(lsa->lsdb->data)->ospf6), ospf6_lsremove_to_spf_reason(lsa));
 			break;
 
@@ -183,6 +185,7 @@ void ospf6_area_delete(struct ospf6_area *oa) {
 	ospf6_spf_table_finish(oa->spf_table);
 	ospf6_route_table_delete(oa->spf_table);
 	ospf6_route_table_delete(oa->route_table);
+	spf_pool_free(oa->spf_pool);
 
 	THREAD_OFF(oa->thread_spf_calculation);
 	THREAD_OFF(oa->thread_route_calculation);
@@ -52,6 +52,7 @@ struct ospf6_area {
 	struct ospf6_lsdb *lsdb_self;
 
 	struct ospf6_route_table *spf_table;
+	struct spf_pool *spf_pool; /* its vertices */
 	struct ospf6_route_table *route_table;
 
 	struct thread *thread_spf_calculation;
@@ -102,6 +103,7 @@ struct ospf6_area {
 #define OSPF6_AREA_ACTIVE 0x02
 #define OSPF6_AREA_TRANSIT 0x04 /* TransitCapability */
 #define OSPF6_AREA_STUB 0x08
+#define OSPF6_AREA_SPF_PENDING 0x10 /* topology changed since last SPF */
 
 #define IS_AREA_ENABLED(oa) (CHECK_FLAG((oa)->flag, OSPF6_AREA_ENABLE))
 #define IS_AREA_ACTIVE(oa) (CHECK_FLAG((oa)->flag, OSPF6_AREA_ACTIVE))
@@ -174,7 +174,6 @@ void ospf6_asbr_lsa_add(struct ospf6_lsa *lsa) {
 	struct prefix asbr_id;
 	struct ospf6_route *asbr_entry, *route;
 	char buf[64];
-	int i;
 
 	external = (struct ospf6_as_external_lsa *) OSPF6_LSA_HEADER_END(lsa->header);
 
@@ -239,9 +238,7 @@ void ospf6_asbr_lsa_add(struct ospf6_lsa *lsa) {
 
 	route->path.tag = ospf6_as_external_lsa_get_tag(lsa);
 
-	for(i = 0; i < OSPF6_MULTI_PATH_LIMIT; i++) {
-		ospf6_nexthop_copy(&route->nexthop[i], &asbr_entry->nexthop[i]);
-	}
+	ospf6_route_copy_nexthops(route, asbr_entry);
 
 	if(IS_OSPF6_DEBUG_EXAMIN(AS_EXTERNAL)) {
 		prefix2str(&route->prefix, buf, sizeof(buf));
@@ -397,7 +394,7 @@ static void ospf6_asbr_redistribute_unset(int type) {
 			continue;
 		}
 
-		ospf6_asbr_redistribute_remove(info->type, route->nexthop[0].ifindex, &route->prefix);
+		ospf6_asbr_redistribute_remove(info->type, ospf6_route_nexthop(route, 0)->ifindex, &route->prefix);
 	}
 
 	ospf6_asbr_routemap_unset(type);
@@ -474,10 +471,7 @@ void ospf6_asbr_redistribute_add(int type, ifindex_t ifindex, struct prefix *pre
 		}
 
 		info->type = type;
-		match->nexthop[0].ifindex = ifindex;
-		if(nexthop_num && nexthop) {
-			memcpy(&match->nexthop[0].address, nexthop, sizeof(struct in6_addr));
-		}
+		ospf6_route_set_nexthop(match, ifindex, (nexthop_num ? nexthop : NULL));
 
 		/* create/update binding in external_id_table */
 		prefix_id.family = AF_INET;
@@ -523,10 +517,7 @@ void ospf6_asbr_redistribute_add(int type, ifindex_t ifindex, struct prefix *pre
 	}
 
 	info->type = type;
-	route->nexthop[0].ifindex = ifindex;
-	if(nexthop_num && nexthop) {
-		memcpy(&route->nexthop[0].address, nexthop, sizeof(struct in6_addr));
-	}
+	ospf6_route_set_nexthop(route, ifindex, (nexthop_num ? nexthop : NULL));
 
 	/* create/update binding in external_id_table */
 	prefix_id.family = AF_INET;
@@ -1192,7 +1183,7 @@ static void ospf6_asbr_external_route_show(struct vty *vty, struct ospf6_route *
 	if(!IN6_IS_ADDR_UNSPECIFIED(&info->forwarding)) {
 		inet_ntop(AF_INET6, &info->forwarding, forwarding, sizeof(forwarding));
 	} else {
-		snprintf(forwarding, sizeof(forwarding), ":: (ifindex %d)", route->nexthop[0].ifindex);
+		snprintf(forwarding, sizeof(forwarding), ":: (ifindex %d)", ospf6_route_nexthop(route, 0)->ifindex);
 	}
 
 	vty_out(vty, "%c %-32s %-15s type-%d %5lu %s%s", zebra_route_char(info->type), prefix, id, route->path.metric_type, (u_long) (route->path.metric_type == 2 ? route->path.cost_e2 : route->path.cost), forwarding, VNL);
@@ -450,6 +450,10 @@ static void ospf6_flood_clear_process(struct ospf6_lsa *lsa, struct ospf6 *proce
 }
 
 void ospf6_flood_clear(struct ospf6_lsa *lsa) {
+	/* No neighbor holds a copy, nothing to walk */
+	if(lsa->retrans_count == 0) {
+		return;
+	}
 	ospf6_flood_clear_process(lsa, ospf6);
 }
 
@@ -74,6 +74,7 @@ static void ospf6_interface_lsdb_hook(struct ospf6_lsa *lsa, unsigned int reason
 			if(oi->state == OSPF6_INTERFACE_DR) {
 				OSPF6_INTRA_PREFIX_LSA_SCHEDULE_TRANSIT(oi);
 			}
+			SET_FLAG(oi->area->flag, OSPF6_AREA_SPF_PENDING);
 			ospf6_spf_schedule(oi->area->ospf6, reason);
 			break;
 
@@ -392,8 +393,7 @@ void ospf6_interface_connected_route_update(struct interface *ifp) {
 		route->path.area_id = oi->area->area_id;
 		route->path.type = OSPF6_PATH_TYPE_INTRA;
 		route->path.cost = oi->cost;
-		route->nexthop[0].ifindex = oi->interface->ifindex;
-		inet_pton(AF_INET6, "::1", &route->nexthop[0].address);
+		ospf6_route_set_nexthop(route, oi->interface->ifindex, &in6addr_loopback);
 		ospf6_route_add(route, oi->route_connected);
 	}
 
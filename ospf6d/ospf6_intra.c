@@ -1036,12 +1036,67 @@ int ospf6_intra_prefix_lsa_originate_transit(struct thread *thread) {
 	return 0;
 }
 
+/* Look up the SPF table entry of the Router/Network LSA an
+   Intra-Area-Prefix LSA refers to. */
+static struct ospf6_route *ospf6_intra_prefix_lsa_ls_entry(struct ospf6_lsa *lsa, struct ospf6_area *oa) {
+	struct ospf6_intra_prefix_lsa *intra_prefix_lsa;
+	struct prefix ls_prefix;
+	struct ospf6_route *ls_entry;
+	char buf[64];
+
+	intra_prefix_lsa = (struct ospf6_intra_prefix_lsa *) OSPF6_LSA_HEADER_END(lsa->header);
+	if(intra_prefix_lsa->ref_type == htons(OSPF6_LSTYPE_ROUTER)) {
+		ospf6_linkstate_prefix(intra_prefix_lsa->ref_adv_router, htonl(0), &ls_prefix);
+	} else if(intra_prefix_lsa->ref_type == htons(OSPF6_LSTYPE_NETWORK)) {
+		ospf6_linkstate_prefix(intra_prefix_lsa->ref_adv_router, intra_prefix_lsa->ref_id, &ls_prefix);
+	} else {
+		if(IS_OSPF6_DEBUG_EXAMIN(INTRA_PREFIX)) {
+			zlog_debug("Unknown reference LS-type: %#hx", ntohs(intra_prefix_lsa->ref_type));
+		}
+		return NULL;
+	}
+
+	ls_entry = ospf6_route_lookup(&ls_prefix, oa->spf_table);
+	if(ls_entry == NULL) {
+		if(IS_OSPF6_DEBUG_EXAMIN(INTRA_PREFIX)) {
+			ospf6_linkstate_prefix2str(&ls_prefix, buf, sizeof(buf));
+			zlog_debug("LS entry does not exist: %s", buf);
+		}
+	}
+	return ls_entry;
+}
+
+/* Does the LSA announce the prefix as one that ospf6_intra_prefix_lsa_add()
+   would install? */
+static int ospf6_intra_prefix_lsa_has_prefix(struct ospf6_lsa *lsa, struct ospf6_prefix *prefix) {
+	struct ospf6_intra_prefix_lsa *intra_prefix_lsa;
+	struct ospf6_prefix *op;
+	char *current, *end;
+	int prefix_num;
+
+	intra_prefix_lsa = (struct ospf6_intra_prefix_lsa *) OSPF6_LSA_HEADER_END(lsa->header);
+	prefix_num = ntohs(intra_prefix_lsa->prefix_num);
+	end = OSPF6_LSA_END(lsa->header);
+	for(current = (caddr_t) intra_prefix_lsa + sizeof(struct ospf6_intra_prefix_lsa); current < end && prefix_num; current += OSPF6_PREFIX_SIZE(op), prefix_num--) {
+		op = (struct ospf6_prefix *) current;
+		if(end < current + OSPF6_PREFIX_SIZE(op)) {
+			break;
+		}
+		if(CHECK_FLAG(op->prefix_options, OSPF6_PREFIX_OPTION_NU)) {
+			continue;
+		}
+		if(op->prefix_length == prefix->prefix_length && !memcmp(OSPF6_PREFIX_BODY(op), OSPF6_PREFIX_BODY(prefix), OSPF6_PREFIX_SPACE(op->prefix_length))) {
+			return 1;
+		}
+	}
+	return 0;
+}
+
 void ospf6_intra_prefix_lsa_add(struct ospf6_lsa *lsa) {
 	struct ospf6_area *oa;
 	struct ospf6_intra_prefix_lsa *intra_prefix_lsa;
-	struct prefix ls_prefix;
 	struct ospf6_route *route, *ls_entry;
-	int i, prefix_num;
+	int prefix_num;
 	struct ospf6_prefix *op;
 	char *start, *current, *end;
 	char buf[64];
@@ -1059,23 +1114,8 @@ void ospf6_intra_prefix_lsa_add(struct ospf6_lsa *lsa) {
 	oa = OSPF6_AREA(lsa->lsdb->data);
 
 	intra_prefix_lsa = (struct ospf6_intra_prefix_lsa *) OSPF6_LSA_HEADER_END(lsa->header);
-	if(intra_prefix_lsa->ref_type == htons(OSPF6_LSTYPE_ROUTER)) {
-		ospf6_linkstate_prefix(intra_prefix_lsa->ref_adv_router, htonl(0), &ls_prefix);
-	} else if(intra_prefix_lsa->ref_type == htons(OSPF6_LSTYPE_NETWORK)) {
-		ospf6_linkstate_prefix(intra_prefix_lsa->ref_adv_router, intra_prefix_lsa->ref_id, &ls_prefix);
-	} else {
-		if(IS_OSPF6_DEBUG_EXAMIN(INTRA_PREFIX)) {
-			zlog_debug("Unknown reference LS-type: %#hx", ntohs(intra_prefix_lsa->ref_type));
-		}
-		return;
-	}
-
-	ls_entry = ospf6_route_lookup(&ls_prefix, oa->spf_table);
+	ls_entry = ospf6_intra_prefix_lsa_ls_entry(lsa, oa);
 	if(ls_entry == NULL) {
-		if(IS_OSPF6_DEBUG_EXAMIN(INTRA_PREFIX)) {
-			ospf6_linkstate_prefix2str(&ls_prefix, buf, sizeof(buf));
-			zlog_debug("LS entry does not exist: %s", buf);
-		}
 		return;
 	}
 
@@ -1125,12 +1165,10 @@ void ospf6_intra_prefix_lsa_add(struct ospf6_lsa *lsa) {
 		if(direct_connect) {
 			ifp = if_lookup_prefix(&route->prefix);
 			if(ifp) {
-				route->nexthop[0].ifindex = ifp->ifindex;
+				ospf6_route_set_nexthop(route, ifp->ifindex, NULL);
 			}
 		} else {
-			for(i = 0; i < OSPF6_MULTI_PATH_LIMIT && ospf6_nexthop_is_set(&ls_entry->nexthop[i]); i++) {
-				ospf6_nexthop_copy(&route->nexthop[i], &ls_entry->nexthop[i]);
-			}
+			ospf6_route_copy_nexthops(route, ls_entry);
 		}
 
 		if(IS_OSPF6_DEBUG_EXAMIN(INTRA_PREFIX)) {
@@ -1152,6 +1190,7 @@ void ospf6_intra_prefix_lsa_remove(struct ospf6_lsa *lsa) {
 	struct ospf6_intra_prefix_lsa *intra_prefix_lsa;
 	struct prefix prefix;
 	struct ospf6_route *route, *nroute;
+	struct ospf6_lsa *new = NULL;
 	int prefix_num;
 	struct ospf6_prefix *op;
 	char *start, *current, *end;
@@ -1163,6 +1202,17 @@ void ospf6_intra_prefix_lsa_remove(struct ospf6_lsa *lsa) {
 
 	oa = OSPF6_AREA(lsa->lsdb->data);
 
+	/* When a newer instance is replacing this one, ospf6_lsdb_add() calls
+	   the add hook for it right after.  Leave the prefixes it announces
+	   to ospf6_route_add() so unchanged routes are not withdrawn and
+	   installed again, and only remove what has gone away. */
+	if(lsa->rn && lsa->rn->info && lsa->rn->info != lsa) {
+		new = (struct ospf6_lsa *) lsa->rn->info;
+		if(OSPF6_LSA_IS_MAXAGE(new) || ospf6_intra_prefix_lsa_ls_entry(new, oa) == NULL) {
+			new = NULL;
+		}
+	}
+
 	intra_prefix_lsa = (struct ospf6_intra_prefix_lsa *) OSPF6_LSA_HEADER_END(lsa->header);
 
 	prefix_num = ntohs(intra_prefix_lsa->prefix_num);
@@ -1178,6 +1228,10 @@ void ospf6_intra_prefix_lsa_remove(struct ospf6_lsa *lsa) {
 		}
 		prefix_num--;
 
+		if(new && ospf6_intra_prefix_lsa_has_prefix(new, op)) {
+			continue;
+		}
+
 		memset(&prefix, 0, sizeof(struct prefix));
 		prefix.family = AF_INET6;
 		prefix.prefixlen = op->prefix_length;
@@ -1220,50 +1274,21 @@ void ospf6_intra_prefix_lsa_remove(struct ospf6_lsa *lsa) {
 }
 
 void ospf6_intra_route_calculation(struct ospf6_area *oa) {
-	struct ospf6_route *route, *nroute;
 	u_int16_t type;
 	struct ospf6_lsa *lsa;
-	void (*hook_add)(struct ospf6_route *) = NULL;
-	void (*hook_remove)(struct ospf6_route *) = NULL;
 
 	if(IS_OSPF6_DEBUG_EXAMIN(INTRA_PREFIX)) {
 		zlog_debug("Re-examin intra-routes for area %s", oa->name);
 	}
 
-	hook_add = oa->route_table->hook_add;
-	hook_remove = oa->route_table->hook_remove;
-	oa->route_table->hook_add = NULL;
-	oa->route_table->hook_remove = NULL;
-
-	for(route = ospf6_route_head(oa->route_table); route; route = ospf6_route_next(route)) {
-		route->flag = OSPF6_ROUTE_REMOVE;
-	}
+	ospf6_route_bulk_begin(oa->route_table);
 
 	type = htons(OSPF6_LSTYPE_INTRA_PREFIX);
 	for(lsa = ospf6_lsdb_type_head(type, oa->lsdb); lsa; lsa = ospf6_lsdb_type_next(type, lsa)) {
 		ospf6_intra_prefix_lsa_add(lsa);
 	}
 
-	oa->route_table->hook_add = hook_add;
-	oa->route_table->hook_remove = hook_remove;
-
-	for(route = ospf6_route_head(oa->route_table); route; route = nroute) {
-		nroute = ospf6_route_next(route);
-		if(CHECK_FLAG(route->flag, OSPF6_ROUTE_REMOVE) && CHECK_FLAG(route->flag, OSPF6_ROUTE_ADD)) {
-			UNSET_FLAG(route->flag, OSPF6_ROUTE_REMOVE);
-			UNSET_FLAG(route->flag, OSPF6_ROUTE_ADD);
-		}
-
-		if(CHECK_FLAG(route->flag, OSPF6_ROUTE_REMOVE)) {
-			ospf6_route_remove(route, oa->route_table);
-		} else if(CHECK_FLAG(route->flag, OSPF6_ROUTE_ADD) || CHECK_FLAG(route->flag, OSPF6_ROUTE_CHANGE)) {
-			if(hook_add) {
-				(*hook_add)(route);
-			}
-		}
-
-		route->flag = 0;
-	}
+	ospf6_route_bulk_end(oa->route_table);
 
 	if(IS_OSPF6_DEBUG_EXAMIN(INTRA_PREFIX)) {
 		zlog_debug("Re-examin intra-routes for area %s: Done", oa->name);
@@ -27,6 +27,8 @@
 #include "prefix.h"
 #include "table.h"
 #include "vty.h"
+#include "hash.h"
+#include "jhash.h"
 
 #include "ospf6_proto.h"
 #include "ospf6_lsa.h"
@@ -52,6 +54,9 @@ void ospf6_lsdb_delete(struct ospf6_lsdb *lsdb) {
 	if(lsdb != NULL) {
 		ospf6_lsdb_remove_all(lsdb);
 		route_table_finish(lsdb->table);
+		if(lsdb->hash) {
+			hash_free(lsdb->hash);
+		}
 		XFREE(MTYPE_OSPF6_LSDB, lsdb);
 	}
 }
@@ -64,6 +69,31 @@ static void ospf6_lsdb_set_key(struct prefix_ipv6 *key, void *value, int len) {
 	key->prefixlen += len * 8;
 }
 
+static unsigned int ospf6_lsdb_hash_key(void *data) {
+	struct ospf6_lsa *lsa = data;
+
+	return jhash_3words(lsa->header->type, lsa->header->id, lsa->header->adv_router, 0);
+}
+
+static int ospf6_lsdb_hash_cmp(const void *a, const void *b) {
+	const struct ospf6_lsa *l1 = a;
+	const struct ospf6_lsa *l2 = b;
+
+	return l1->header->type == l2->header->type && l1->header->id == l2->header->id && l1->header->adv_router == l2->header->adv_router;
+}
+
+/* Index the LSDB by hash, now that it has grown past a few LSAs. */
+static void ospf6_lsdb_hash_build(struct ospf6_lsdb *lsdb) {
+	struct route_node *rn;
+
+	lsdb->hash = hash_create_open(ospf6_lsdb_hash_key, ospf6_lsdb_hash_cmp);
+	for(rn = route_top(lsdb->table); rn; rn = route_next(rn)) {
+		if(rn->info) {
+			hash_get(lsdb->hash, rn->info, hash_alloc_intern);
+		}
+	}
+}
+
 #ifdef DEBUG
 static void _lsdb_count_assert(struct ospf6_lsdb *lsdb) {
 	struct ospf6_lsa *debug;
@@ -106,6 +136,15 @@ void ospf6_lsdb_add(struct ospf6_lsa *lsa, struct ospf6_lsdb *lsdb) {
 	lsa->rn = current;
 	ospf6_lsa_lock(lsa);
 
+	if(lsdb->hash) {
+		if(old) {
+			hash_release(lsdb->hash, old);
+		}
+		hash_get(lsdb->hash, lsa, hash_alloc_intern);
+	} else if(!old && lsdb->count >= OSPF6_LSDB_HASH_THRESHOLD) {
+		ospf6_lsdb_hash_build(lsdb);
+	}
+
 	if(!old) {
 		lsdb->count++;
 
@@ -158,6 +197,9 @@ void ospf6_lsdb_remove(struct ospf6_lsa *lsa, struct ospf6_lsdb *lsdb) {
 
 	node->info = NULL;
 	lsdb->count--;
+	if(lsdb->hash) {
+		hash_release(lsdb->hash, lsa);
+	}
 
 	if(lsdb->hook_remove) {
 		(*lsdb->hook_remove)(lsa);
@@ -178,6 +220,17 @@ struct ospf6_lsa *ospf6_lsdb_lookup(u_int16_t type, u_int32_t id, u_int32_t adv_
 		return NULL;
 	}
 
+	if(lsdb->hash) {
+		struct ospf6_lsa_header header;
+		struct ospf6_lsa lsa;
+
+		header.type = type;
+		header.id = id;
+		header.adv_router = adv_router;
+		lsa.header = &header;
+		return hash_lookup(lsdb->hash, &lsa);
+	}
+
 	memset(&key, 0, sizeof(key));
 	ospf6_lsdb_set_key(&key, &type, sizeof(type));
 	ospf6_lsdb_set_key(&key, &adv_router, sizeof(adv_router));
@@ -31,8 +31,16 @@ struct ospf6_lsdb {
 	u_int32_t count;
 	void (*hook_add)(struct ospf6_lsa *);
 	void (*hook_remove)(struct ospf6_lsa *);
+
+	/* The LSAs by (type, id, adv_router), for lookups once there are
+	 * more than OSPF6_LSDB_HASH_THRESHOLD.  The table above stays, for
+	 * walking them in order.
+	 */
+	struct hash *hash;
 };
 
+#define OSPF6_LSDB_HASH_THRESHOLD 32
+
 /* Function Prototypes */
 extern struct ospf6_lsdb *ospf6_lsdb_create(void *data);
 extern void ospf6_lsdb_delete(struct ospf6_lsdb *lsdb);
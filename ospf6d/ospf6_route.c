@@ -28,6 +28,8 @@
 #include "vty.h"
 #include "command.h"
 #include "linklist.h"
+#include "hash.h"
+#include "jhash.h"
 
 #include "ospf6_proto.h"
 #include "ospf6_lsa.h"
@@ -129,6 +131,132 @@ const char *ospf6_path_type_substr[OSPF6_PATH_TYPE_MAX] = {
 	"??", "IA", "IE", "E1", "E2",
 };
 
+const struct ospf6_nexthop ospf6_nexthop_unspec;
+
+/* Interned nexthop sets.  Routes towards destinations behind the same
+   neighbors all refer to one set instead of carrying their own array. */
+static struct hash *ospf6_nexthop_hash;
+
+#define OSPF6_NEXTHOP_SET_SIZE(n) (offsetof(struct ospf6_nexthop_set, nexthop) + (n) * sizeof(struct ospf6_nexthop))
+
+static unsigned int ospf6_nexthop_set_key(void *data) {
+	struct ospf6_nexthop_set *set = data;
+	return jhash(set->nexthop, set->count * sizeof(struct ospf6_nexthop), set->count);
+}
+
+static int ospf6_nexthop_set_cmp(const void *a, const void *b) {
+	const struct ospf6_nexthop_set *sa = a, *sb = b;
+	return (sa->count == sb->count && memcmp(sa->nexthop, sb->nexthop, sa->count * sizeof(struct ospf6_nexthop)) == 0);
+}
+
+static void *ospf6_nexthop_set_alloc(void *data) {
+	struct ospf6_nexthop_set *key = data;
+	struct ospf6_nexthop_set *set;
+
+	set = XMALLOC(MTYPE_OSPF6_NEXTHOP, OSPF6_NEXTHOP_SET_SIZE(key->count));
+	set->refcnt = 0;
+	set->count = key->count;
+	memcpy(set->nexthop, key->nexthop, key->count * sizeof(struct ospf6_nexthop));
+	return set;
+}
+
+static struct ospf6_nexthop_set *ospf6_nexthop_set_intern(struct ospf6_nexthop_set *key) {
+	struct ospf6_nexthop_set *set;
+
+	if(key->count == 0) {
+		return NULL;
+	}
+	if(ospf6_nexthop_hash == NULL) {
+		ospf6_nexthop_hash = hash_create(ospf6_nexthop_set_key, ospf6_nexthop_set_cmp);
+	}
+	set = hash_get(ospf6_nexthop_hash, key, ospf6_nexthop_set_alloc);
+	set->refcnt++;
+	return set;
+}
+
+static void ospf6_nexthop_set_unintern(struct ospf6_nexthop_set *set) {
+	if(set == NULL) {
+		return;
+	}
+	assert(set->refcnt > 0);
+	if(--set->refcnt == 0) {
+		hash_release(ospf6_nexthop_hash, set);
+		XFREE(MTYPE_OSPF6_NEXTHOP, set);
+	}
+}
+
+unsigned long ospf6_nexthop_set_count(void) {
+	return (ospf6_nexthop_hash ? ospf6_nexthop_hash->count : 0);
+}
+
+/* Replace the nexthops of the route with the set ones among nexthop[] */
+void ospf6_route_set_nexthops(struct ospf6_route *route, const struct ospf6_nexthop *nexthop, int count) {
+	struct ospf6_nexthop_set key;
+	struct ospf6_nexthop_set *old = route->nh;
+	int i;
+
+	key.count = 0;
+	for(i = 0; i < count && key.count < OSPF6_MULTI_PATH_LIMIT; i++) {
+		if(ospf6_nexthop_is_set(&nexthop[i])) {
+			ospf6_nexthop_copy(&key.nexthop[key.count], &nexthop[i]);
+			key.count++;
+		}
+	}
+
+	route->nh = ospf6_nexthop_set_intern(&key);
+	ospf6_nexthop_set_unintern(old);
+}
+
+void ospf6_route_set_nexthop(struct ospf6_route *route, ifindex_t ifindex, const struct in6_addr *address) {
+	struct ospf6_nexthop nexthop;
+
+	nexthop.ifindex = ifindex;
+	if(address) {
+		memcpy(&nexthop.address, address, sizeof(struct in6_addr));
+	} else {
+		memset(&nexthop.address, 0, sizeof(struct in6_addr));
+	}
+	ospf6_route_set_nexthops(route, &nexthop, 1);
+}
+
+void ospf6_route_copy_nexthops(struct ospf6_route *dst, struct ospf6_route *src) {
+	struct ospf6_nexthop_set *old = dst->nh;
+
+	dst->nh = src->nh;
+	if(dst->nh) {
+		dst->nh->refcnt++;
+	}
+	ospf6_nexthop_set_unintern(old);
+}
+
+/* Add the nexthops the route does not have yet, up to the ECMP limit */
+void ospf6_route_merge_nexthops(struct ospf6_route *route, const struct ospf6_nexthop *nexthop, int count) {
+	struct ospf6_nexthop merged[OSPF6_MULTI_PATH_LIMIT];
+	int i, j, num;
+
+	num = ospf6_route_num_nexthops(route);
+	for(i = 0; i < num; i++) {
+		ospf6_nexthop_copy(&merged[i], &route->nh->nexthop[i]);
+	}
+	for(i = 0; i < count && num < OSPF6_MULTI_PATH_LIMIT; i++) {
+		if(!ospf6_nexthop_is_set(&nexthop[i])) {
+			continue;
+		}
+		for(j = 0; j < num; j++) {
+			if(ospf6_nexthop_is_same(&merged[j], &nexthop[i])) {
+				break;
+			}
+		}
+		if(j == num) {
+			ospf6_nexthop_copy(&merged[num], &nexthop[i]);
+			num++;
+		}
+	}
+	if(num != ospf6_route_num_nexthops(route)) {
+		ospf6_route_set_nexthops(route, merged, num);
+	}
+}
+
 struct ospf6_route *ospf6_route_create(void) {
 	struct ospf6_route *route;
 	route = XCALLOC(MTYPE_OSPF6_ROUTE, sizeof(struct ospf6_route));
@@ -136,6 +264,7 @@ struct ospf6_route *ospf6_route_create(void) {
 }
 
 void ospf6_route_delete(struct ospf6_route *route) {
+	ospf6_nexthop_set_unintern(route->nh);
 	XFREE(MTYPE_OSPF6_ROUTE, route);
 }
 
@@ -149,6 +278,9 @@ struct ospf6_route *ospf6_route_copy(struct ospf6_route *route) {
 	new->next = NULL;
 	new->table = NULL;
 	new->lock = 0;
+	if(new->nh) {
+		new->nh->refcnt++;
+	}
 	return new;
 }
 
@@ -687,6 +819,54 @@ void ospf6_route_remove_all(struct ospf6_route_table *table) {
 	}
 }
 
+/* Bulk update of a table that a calculation rebuilds as a whole.  Every
+   route is marked, the hooks are held back while the calculation adds
+   its result, and ospf6_route_bulk_end() then removes what was not added
+   again and runs the add hook only for new or changed routes. */
+void ospf6_route_bulk_begin(struct ospf6_route_table *table) {
+	struct ospf6_route *route;
+
+	assert(!table->bulk);
+	table->bulk = 1;
+	table->bulk_hook_add = table->hook_add;
+	table->bulk_hook_remove = table->hook_remove;
+	table->hook_add = NULL;
+	table->hook_remove = NULL;
+
+	for(route = ospf6_route_head(table); route; route = ospf6_route_next(route)) {
+		route->flag = OSPF6_ROUTE_REMOVE;
+	}
+}
+
+void ospf6_route_bulk_end(struct ospf6_route_table *table) {
+	struct ospf6_route *route, *nroute;
+
+	assert(table->bulk);
+	table->bulk = 0;
+	table->hook_add = table->bulk_hook_add;
+	table->hook_remove = table->bulk_hook_remove;
+	table->bulk_hook_add = NULL;
+	table->bulk_hook_remove = NULL;
+
+	for(route = ospf6_route_head(table); route; route = nroute) {
+		nroute = ospf6_route_next(route);
+		if(CHECK_FLAG(route->flag, OSPF6_ROUTE_REMOVE) && CHECK_FLAG(route->flag, OSPF6_ROUTE_ADD)) {
+			UNSET_FLAG(route->flag, OSPF6_ROUTE_REMOVE);
+			UNSET_FLAG(route->flag, OSPF6_ROUTE_ADD);
+		}
+
+		if(CHECK_FLAG(route->flag, OSPF6_ROUTE_REMOVE)) {
+			ospf6_route_remove(route, table);
+		} else if(CHECK_FLAG(route->flag, OSPF6_ROUTE_ADD) || CHECK_FLAG(route->flag, OSPF6_ROUTE_CHANGE)) {
+			if(table->hook_add) {
+				(*table->hook_add)(route);
+			}
+		}
+
+		route->flag = 0;
+	}
+}
+
 struct ospf6_route_table *ospf6_route_table_create(int s, int t) {
 	struct ospf6_route_table *new;
 	new = XCALLOC(MTYPE_OSPF6_ROUTE, sizeof(struct ospf6_route_table));
@@ -724,15 +904,15 @@ void ospf6_route_show(struct vty *vty, struct ospf6_route *route) {
 	}
 
 	/* nexthop */
-	inet_ntop(AF_INET6, &route->nexthop[0].address, nexthop, sizeof(nexthop));
-	ifname = ifindex2ifname(route->nexthop[0].ifindex);
+	inet_ntop(AF_INET6, &ospf6_route_nexthop(route, 0)->address, nexthop, sizeof(nexthop));
+	ifname = ifindex2ifname(ospf6_route_nexthop(route, 0)->ifindex);
 
 	vty_out(vty, "%c%1s %2s %-30s %-25s %6.*s %s%s", (ospf6_route_is_best(route) ? '*' : ' '), OSPF6_DEST_TYPE_SUBSTR(route->type), OSPF6_PATH_TYPE_SUBSTR(route->path.type), destination, nexthop, IFNAMSIZ, ifname, duration, VNL);
 
-	for(i = 1; i < OSPF6_MULTI_PATH_LIMIT && ospf6_nexthop_is_set(&route->nexthop[i]); i++) {
+	for(i = 1; i < ospf6_route_num_nexthops(route); i++) {
 		/* nexthop */
-		inet_ntop(AF_INET6, &route->nexthop[i].address, nexthop, sizeof(nexthop));
-		ifname = ifindex2ifname(route->nexthop[i].ifindex);
+		inet_ntop(AF_INET6, &route->nh->nexthop[i].address, nexthop, sizeof(nexthop));
+		ifname = ifindex2ifname(route->nh->nexthop[i].ifindex);
 
 		vty_out(vty, "%c%1s %2s %-30s %-25s %6.*s %s%s", ' ', "", "", "", nexthop, IFNAMSIZ, ifname, "", VNL);
 	}
@@ -806,10 +986,10 @@ void ospf6_route_show_detail(struct vty *vty, struct ospf6_route *route) {
 
 	/* Nexthops */
 	vty_out(vty, "Nexthop:%s", VNL);
-	for(i = 0; i < OSPF6_MULTI_PATH_LIMIT && ospf6_nexthop_is_set(&route->nexthop[i]); i++) {
+	for(i = 0; i < ospf6_route_num_nexthops(route); i++) {
 		/* nexthop */
-		inet_ntop(AF_INET6, &route->nexthop[i].address, nexthop, sizeof(nexthop));
-		ifname = ifindex2ifname(route->nexthop[i].ifindex);
+		inet_ntop(AF_INET6, &route->nh->nexthop[i].address, nexthop, sizeof(nexthop));
+		ifname = ifindex2ifname(route->nh->nexthop[i].ifindex);
 		vty_out(vty, "  %s %.*s%s", nexthop, IFNAMSIZ, ifname, VNL);
 	}
 	vty_out(vty, "%s", VNL);
@@ -832,9 +1012,9 @@ static void ospf6_route_show_table_summary(struct vty *vty, struct ospf6_route_t
 		} else {
 			alternative++;
 		}
-		if(!ospf6_nexthop_is_set(&route->nexthop[0])) {
+		if(ospf6_route_num_nexthops(route) == 0) {
 			nhinval++;
-		} else if(ospf6_nexthop_is_set(&route->nexthop[1])) {
+		} else if(ospf6_route_num_nexthops(route) > 1) {
 			ecmp++;
 		}
 		pathtype[route->path.type]++;
@@ -849,6 +1029,7 @@ static void ospf6_route_show_table_summary(struct vty *vty, struct ospf6_route_t
 	vty_out(vty, "Number of Destination: %d%s", destination, VNL);
 	vty_out(vty, "Number of Alternative routes: %d%s", alternative, VNL);
 	vty_out(vty, "Number of Equal Cost Multi Path: %d%s", ecmp, VNL);
+	vty_out(vty, "Number of shared nexthop sets: %lu%s", ospf6_nexthop_set_count(), VNL);
 	for(i = OSPF6_PATH_TYPE_INTRA; i <= OSPF6_PATH_TYPE_EXTERNAL2; i++) {
 		vty_out(vty, "Number of %s routes: %d%s", OSPF6_PATH_TYPE_NAME(i), pathtype[i], VNL);
 	}
@@ -56,6 +56,14 @@ struct ospf6_nexthop {
 		memcpy(&(a)->address, &(b)->address, sizeof(struct in6_addr)); \
 	} while(0)
 
+/* Set of nexthops, interned and shared by all routes using it.  Only
+   the first "count" entries of the array are allocated. */
+struct ospf6_nexthop_set {
+	unsigned long refcnt;
+	u_int32_t count;
+	struct ospf6_nexthop nexthop[OSPF6_MULTI_PATH_LIMIT];
+};
+
 /* Path */
 struct ospf6_ls_origin {
 	u_int16_t type;
@@ -129,8 +137,8 @@ struct ospf6_route {
 	/* path */
 	struct ospf6_path path;
 
-	/* nexthop */
-	struct ospf6_nexthop nexthop[OSPF6_MULTI_PATH_LIMIT];
+	/* nexthop, shared, NULL when there is none */
+	struct ospf6_nexthop_set *nh;
 
 	/* route option */
 	void *route_option;
@@ -169,6 +177,11 @@ struct ospf6_route_table {
 	void (*hook_add)(struct ospf6_route *);
 	void (*hook_change)(struct ospf6_route *);
 	void (*hook_remove)(struct ospf6_route *);
+
+	/* hooks held back during a bulk update */
+	void (*bulk_hook_add)(struct ospf6_route *);
+	void (*bulk_hook_remove)(struct ospf6_route *);
+	u_char bulk;
 };
 
 #define OSPF6_SCOPE_TYPE_NONE 0
@@ -207,9 +220,13 @@ extern const char *ospf6_path_type_substr[OSPF6_PATH_TYPE_MAX];
 #define ospf6_route_is_same_origin(ra, rb) ((ra)->path.area_id == (rb)->path.area_id && memcmp(&(ra)->path.origin, &(rb)->path.origin, sizeof(struct ospf6_ls_origin)) == 0)
 #define ospf6_route_is_identical(ra, rb) \
 	((ra)->type == (rb)->type && memcmp(&(ra)->prefix, &(rb)->prefix, sizeof(struct prefix)) == 0 && memcmp(&(ra)->path, &(rb)->path, sizeof(struct ospf6_path)) == 0 \
-	 && memcmp(&(ra)->nexthop, &(rb)->nexthop, sizeof(struct ospf6_nexthop) * OSPF6_MULTI_PATH_LIMIT) == 0)
+	 && (ra)->nh == (rb)->nh)
 #define ospf6_route_is_best(r) (CHECK_FLAG((r)->flag, OSPF6_ROUTE_BEST))
 
+/* Nexthops of a route; out of range entries read as unset */
+#define ospf6_route_num_nexthops(r) ((r)->nh ? (int) (r)->nh->count : 0)
+#define ospf6_route_nexthop(r, i) ((i) < ospf6_route_num_nexthops(r) ? &(r)->nh->nexthop[(i)] : &ospf6_nexthop_unspec)
+
 #define ospf6_linkstate_prefix_adv_router(x) ((x)->u.lp.id.s_addr)
 #define ospf6_linkstate_prefix_id(x) ((x)->u.lp.adv_router.s_addr)
 
@@ -220,6 +237,14 @@ extern const char *ospf6_path_type_substr[OSPF6_PATH_TYPE_MAX];
 extern void ospf6_linkstate_prefix(u_int32_t adv_router, u_int32_t id, struct prefix *prefix);
 extern void ospf6_linkstate_prefix2str(struct prefix *prefix, char *buf, int size);
 
+extern const struct ospf6_nexthop ospf6_nexthop_unspec;
+
+extern void ospf6_route_set_nexthops(struct ospf6_route *route, const struct ospf6_nexthop *nexthop, int count);
+extern void ospf6_route_set_nexthop(struct ospf6_route *route, ifindex_t ifindex, const struct in6_addr *address);
+extern void ospf6_route_copy_nexthops(struct ospf6_route *dst, struct ospf6_route *src);
+extern void ospf6_route_merge_nexthops(struct ospf6_route *route, const struct ospf6_nexthop *nexthop, int count);
+extern unsigned long ospf6_nexthop_set_count(void);
+
 extern struct ospf6_route *ospf6_route_create(void);
 extern void ospf6_route_delete(struct ospf6_route *);
 extern struct ospf6_route *ospf6_route_copy(struct ospf6_route *route);
@@ -242,6 +267,9 @@ extern struct ospf6_route *ospf6_route_match_head(struct prefix *prefix, struct
 extern struct ospf6_route *ospf6_route_match_next(struct prefix *prefix, struct ospf6_route *route);
 
 extern void ospf6_route_remove_all(struct ospf6_route_table *);
+
+extern void ospf6_route_bulk_begin(struct ospf6_route_table *table);
+extern void ospf6_route_bulk_end(struct ospf6_route_table *table);
 extern struct ospf6_route_table *ospf6_route_table_create(int s, int t);
 extern void ospf6_route_table_delete(struct ospf6_route_table *);
 extern void ospf6_route_dump(struct ospf6_route_table *table);
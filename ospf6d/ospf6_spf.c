@@ -28,7 +28,7 @@
 #include "command.h"
 #include "vty.h"
 #include "prefix.h"
-#include "pqueue.h"
+#include "spf.h"
 #include "linklist.h"
 #include "thread.h"
 
@@ -44,15 +44,9 @@
 
 unsigned char conf_debug_ospf6_spf = 0;
 
-static int ospf6_vertex_cmp(void *a, void *b) {
-	struct ospf6_vertex *va = (struct ospf6_vertex *) a;
-	struct ospf6_vertex *vb = (struct ospf6_vertex *) b;
-
-	/* ascending order */
-	if(va->cost != vb->cost) {
-		return (va->cost - vb->cost);
-	}
-	return (va->hops - vb->hops);
+/* Candidates in ascending order of cost, then of hops */
+static u_int64_t ospf6_vertex_key(struct ospf6_vertex *v) {
+	return ((u_int64_t) v->cost << 8) | v->hops;
 }
 
 static int ospf6_vertex_id_cmp(void *a, void *b) {
@@ -69,11 +63,15 @@ static int ospf6_vertex_id_cmp(void *a, void *b) {
 	return ret;
 }
 
-static struct ospf6_vertex *ospf6_vertex_create(struct ospf6_lsa *lsa) {
+static struct ospf6_vertex *ospf6_vertex_create(struct ospf6_area *oa, struct ospf6_lsa *lsa) {
 	struct ospf6_vertex *v;
 	int i;
 
-	v = (struct ospf6_vertex *) XMALLOC(MTYPE_OSPF6_VERTEX, sizeof(struct ospf6_vertex));
+	if(oa->spf_pool == NULL) {
+		oa->spf_pool = spf_pool_new(sizeof(struct ospf6_vertex), MTYPE_OSPF6_VERTEX);
+	}
+	v = spf_pool_get(oa->spf_pool);
+	v->area = oa;
 
 	/* type */
 	if(ntohs(lsa->header->type) == OSPF6_LSTYPE_ROUTER) {
@@ -104,15 +102,13 @@ static struct ospf6_vertex *ospf6_vertex_create(struct ospf6_lsa *lsa) {
 	}
 
 	v->parent = NULL;
-	v->child_list = list_new();
-	v->child_list->cmp = ospf6_vertex_id_cmp;
 
 	return v;
 }
 
 static void ospf6_vertex_delete(struct ospf6_vertex *v) {
-	list_delete(v->child_list);
-	XFREE(MTYPE_OSPF6_VERTEX, v);
+	spf_array_free(&v->child_list);
+	spf_pool_put(v->area->spf_pool, v);
 }
 
 static struct ospf6_lsa *ospf6_lsdesc_lsa(caddr_t lsdesc, struct ospf6_vertex *v) {
@@ -245,7 +241,6 @@ static void ospf6_nexthop_calc(struct ospf6_vertex *w, struct ospf6_vertex *v, c
 
 static int ospf6_spf_install(struct ospf6_vertex *v, struct ospf6_route_table *result_table) {
 	struct ospf6_route *route;
-	int i, j;
 	struct ospf6_vertex *prev;
 
 	if(IS_OSPF6_DEBUG_SPF(PROCESS)) {
@@ -264,19 +259,7 @@ static int ospf6_spf_install(struct ospf6_vertex *v, struct ospf6_route_table *r
 			zlog_debug("  another path found, merge");
 		}
 
-		for(i = 0; i < OSPF6_MULTI_PATH_LIMIT && ospf6_nexthop_is_set(&v->nexthop[i]); i++) {
-			for(j = 0; j < OSPF6_MULTI_PATH_LIMIT; j++) {
-				if(ospf6_nexthop_is_set(&route->nexthop[j])) {
-					if(ospf6_nexthop_is_same(&route->nexthop[j], &v->nexthop[i])) {
-						break;
-					} else {
-						continue;
-					}
-				}
-				ospf6_nexthop_copy(&route->nexthop[j], &v->nexthop[i]);
-				break;
-			}
-		}
+		ospf6_route_merge_nexthops(route, v->nexthop, OSPF6_MULTI_PATH_LIMIT);
 
 		prev = (struct ospf6_vertex *) route->route_option;
 		assert(prev->hops <= v->hops);
@@ -309,12 +292,10 @@ static int ospf6_spf_install(struct ospf6_vertex *v, struct ospf6_route_table *r
 	route->path.options[1] = v->options[1];
 	route->path.options[2] = v->options[2];
 
-	for(i = 0; i < OSPF6_MULTI_PATH_LIMIT && ospf6_nexthop_is_set(&v->nexthop[i]); i++) {
-		ospf6_nexthop_copy(&route->nexthop[i], &v->nexthop[i]);
-	}
+	ospf6_route_set_nexthops(route, v->nexthop, OSPF6_MULTI_PATH_LIMIT);
 
 	if(v->parent) {
-		listnode_add_sort(v->parent->child_list, v);
+		spf_array_add_sort(&v->parent->child_list, v, ospf6_vertex_id_cmp);
 	}
 	route->route_option = v;
 
@@ -355,7 +336,7 @@ void ospf6_spf_reason_string(unsigned int reason, char *buf, int size) {
 /* RFC2328 16.1.  Calculating the shortest-path tree for an area */
 /* RFC2740 3.8.1.  Calculating the shortest path tree for an area */
 void ospf6_spf_calculation(u_int32_t router_id, struct ospf6_route_table *result_table, struct ospf6_area *oa) {
-	struct pqueue *candidate_list;
+	struct spf_heap *candidate_list;
 	struct ospf6_vertex *root, *v, *w;
 	int i;
 	int size;
@@ -372,23 +353,21 @@ void ospf6_spf_calculation(u_int32_t router_id, struct ospf6_route_table *result
 	}
 
 	/* initialize */
-	candidate_list = pqueue_create();
-	candidate_list->cmp = ospf6_vertex_cmp;
+	candidate_list = spf_heap_new();
 
-	root = ospf6_vertex_create(lsa);
-	root->area = oa;
+	root = ospf6_vertex_create(oa, lsa);
 	root->cost = 0;
 	root->hops = 0;
 	root->nexthop[0].ifindex = 0; /* loopbak I/F is better ... */
 	inet_pton(AF_INET6, "::1", &root->nexthop[0].address);
 
 	/* Actually insert root to the candidate-list as the only candidate */
-	pqueue_enqueue(root, candidate_list);
+	spf_heap_push(candidate_list, root, &root->heap_pos, ospf6_vertex_key(root));
 
 	/* Iterate until candidate-list becomes empty */
-	while(candidate_list->size) {
+	while(spf_heap_count(candidate_list)) {
 		/* get closest candidate from priority queue */
-		v = pqueue_dequeue(candidate_list);
+		v = spf_heap_pop(candidate_list);
 
 		/* installing may result in merging or rejecting of the vertex */
 		if(ospf6_spf_install(v, result_table) < 0) {
@@ -412,8 +391,7 @@ void ospf6_spf_calculation(u_int32_t router_id, struct ospf6_route_table *result
 				continue;
 			}
 
-			w = ospf6_vertex_create(lsa);
-			w->area = oa;
+			w = ospf6_vertex_create(oa, lsa);
 			w->parent = v;
 			if(VERTEX_IS_TYPE(ROUTER, v)) {
 				w->cost = v->cost + ROUTER_LSDESC_GET_METRIC(lsdesc);
@@ -439,11 +417,11 @@ void ospf6_spf_calculation(u_int32_t router_id, struct ospf6_route_table *result
 			if(IS_OSPF6_DEBUG_SPF(PROCESS)) {
 				zlog_debug("  New candidate: %s hops %d cost %d", w->name, w->hops, w->cost);
 			}
-			pqueue_enqueue(w, candidate_list);
+			spf_heap_push(candidate_list, w, &w->heap_pos, ospf6_vertex_key(w));
 		}
 	}
 
-	pqueue_delete(candidate_list);
+	spf_heap_free(candidate_list);
 
 	oa->spf_calculation++;
 }
@@ -488,6 +466,12 @@ static int ospf6_spf_calculation_thread(struct thread *t) {
 		if(oa == ospf6->backbone) {
 			continue;
 		}
+		/* Intra-Area-Prefix LSA changes are applied as they arrive, an
+		   area whose Router/Network/Link LSAs did not change keeps its tree. */
+		if(!CHECK_FLAG(oa->flag, OSPF6_AREA_SPF_PENDING)) {
+			continue;
+		}
+		UNSET_FLAG(oa->flag, OSPF6_AREA_SPF_PENDING);
 
 		if(IS_OSPF6_DEBUG_SPF(PROCESS)) {
 			zlog_debug("SPF calculation for Area %s", oa->name);
@@ -503,7 +487,8 @@ static int ospf6_spf_calculation_thread(struct thread *t) {
 		areas_processed++;
 	}
 
-	if(ospf6->backbone) {
+	if(ospf6->backbone && CHECK_FLAG(ospf6->backbone->flag, OSPF6_AREA_SPF_PENDING)) {
+		UNSET_FLAG(ospf6->backbone->flag, OSPF6_AREA_SPF_PENDING);
 		if(IS_OSPF6_DEBUG_SPF(PROCESS)) {
 			zlog_debug("SPF calculation for Backbone area %s", ospf6->backbone->name);
 		}
@@ -613,11 +598,11 @@ void ospf6_spf_schedule(struct ospf6 *ospf6, unsigned int reason) {
 }
 
 void ospf6_spf_display_subtree(struct vty *vty, const char *prefix, int rest, struct ospf6_vertex *v) {
-	struct listnode *node, *nnode;
 	struct ospf6_vertex *c;
 	char *next_prefix;
 	int len;
 	int restnum;
+	unsigned int i;
 
 	/* "prefix" is the space prefix of the display line */
 	vty_out(vty, "%s+-%s [%d]%s", prefix, v->name, v->cost, VNL);
@@ -630,8 +615,8 @@ void ospf6_spf_display_subtree(struct vty *vty, const char *prefix, int rest, st
 	}
 	snprintf(next_prefix, len, "%s%s", prefix, (rest ? "|  " : "   "));
 
-	restnum = listcount(v->child_list);
-	for(ALL_LIST_ELEMENTS(v->child_list, node, nnode, c)) {
+	restnum = spf_array_count(&v->child_list);
+	for(SPF_ARRAY_ELEMENTS(&v->child_list, i, c)) {
 		restnum--;
 		ospf6_spf_display_subtree(vty, next_prefix, restnum, c);
 	}
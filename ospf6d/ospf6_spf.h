@@ -22,6 +22,7 @@
 #ifndef OSPF6_SPF_H
 #define OSPF6_SPF_H
 
+#include "spf.h"
 #include "ospf6_top.h"
 
 /* Debug option */
@@ -65,9 +66,12 @@ struct ospf6_vertex {
 	/* Optional capabilities */
 	u_char options[3];
 
+	/* Position on the candidate heap */
+	int heap_pos;
+
 	/* For tree display */
 	struct ospf6_vertex *parent;
-	struct list *child_list;
+	struct spf_array child_list;
 };
 
 #define OSPF6_VERTEX_TYPE_ROUTER 0x01
@@ -113,7 +113,7 @@ static int ospf6_zebra_if_del(int command, struct zclient *zclient, zebra_size_t
 		zlog_debug("Zebra Interface delete: %s index %d mtu %d", ifp->name, ifp->ifindex, ifp->mtu6);
 	}
 
-	ifp->ifindex = IFINDEX_INTERNAL;
+	if_set_index(ifp, IFINDEX_INTERNAL);
 	return 0;
 }
 
@@ -361,12 +361,7 @@ static void ospf6_zebra_route_update(int type, struct ospf6_route *request) {
 		return;
 	}
 
-	nhcount = 0;
-	for(i = 0; i < OSPF6_MULTI_PATH_LIMIT; i++) {
-		if(ospf6_nexthop_is_set(&request->nexthop[i])) {
-			nhcount++;
-		}
-	}
+	nhcount = ospf6_route_num_nexthops(request);
 
 	if(nhcount == 0) {
 		if(IS_OSPF6_DEBUG_ZEBRA(SEND)) {
@@ -393,12 +388,12 @@ static void ospf6_zebra_route_update(int type, struct ospf6_route *request) {
 	for(i = 0; i < nhcount; i++) {
 		if(IS_OSPF6_DEBUG_ZEBRA(SEND)) {
 			const char *ifname;
-			inet_ntop(AF_INET6, &request->nexthop[i].address, buf, sizeof(buf));
-			ifname = ifindex2ifname(request->nexthop[i].ifindex);
-			zlog_debug("  nexthop: %s%%%.*s(%d)", buf, IFNAMSIZ, ifname, request->nexthop[i].ifindex);
+			inet_ntop(AF_INET6, &request->nh->nexthop[i].address, buf, sizeof(buf));
+			ifname = ifindex2ifname(request->nh->nexthop[i].ifindex);
+			zlog_debug("  nexthop: %s%%%.*s(%d)", buf, IFNAMSIZ, ifname, request->nh->nexthop[i].ifindex);
 		}
-		nexthops[i] = &request->nexthop[i].address;
-		ifindexes[i] = request->nexthop[i].ifindex;
+		nexthops[i] = &request->nh->nexthop[i].address;
+		ifindexes[i] = request->nh->nexthop[i].ifindex;
 	}
 
 	api.vrf_id = VRF_DEFAULT;
@@ -21,6 +21,7 @@
  */
 
 #include <zebra.h>
+#include <poll.h>
 
 #include <lib/version.h>
 #include "getopt.h"
@@ -35,6 +36,8 @@
 #include "stream.h"
 #include "log.h"
 #include "memory.h"
+#include "buffer.h"
+#include "network.h"
 
 #include "ospfd/ospfd.h"
 #include "ospfd/ospf_interface.h"
@@ -229,12 +232,18 @@ struct ospf_apiclient *ospf_apiclient_connect(char *host, int syncport) {
      connections */
 	close(async_server_sock);
 
+	/* Requests may be pipelined, and notifications are read as many as
+     are there: neither channel blocks */
+	set_nonblocking(fd1);
+	set_nonblocking(fd2);
+
 	/* Create new client-side instance */
 	new = XCALLOC(MTYPE_OSPF_APICLIENT, sizeof(struct ospf_apiclient));
 
 	/* Initialize socket descriptors for sync and async channels */
 	new->fd_sync = fd1;
 	new->fd_async = fd2;
+	new->wb_sync = buffer_new(0);
 
 	return new;
 }
@@ -248,6 +257,8 @@ int ospf_apiclient_close(struct ospf_apiclient *oclient) {
 		close(oclient->fd_async);
 	}
 
+	buffer_free(oclient->wb_sync);
+
 	/* Free client structure */
 	XFREE(MTYPE_OSPF_APICLIENT, oclient);
 	return 0;
@@ -258,39 +269,126 @@ int ospf_apiclient_close(struct ospf_apiclient *oclient) {
  * -----------------------------------------------------------
  */
 
-/* Send synchronous request, wait for reply */
-static int ospf_apiclient_send_request(struct ospf_apiclient *oclient, struct msg *msg) {
-	u_int32_t reqseq;
-	struct msg_reply *msgreply;
-	int rc;
+/* Read what is there on fd into rb: 1 if anything came, 0 if nothing
+   is there yet, -1 if the connection broke */
+static int ospf_apiclient_rbuf_fill(int fd, struct ospf_apiclient_rbuf *rb) {
+	ssize_t n;
 
-	/* NB: Given "msg" is freed inside this function. */
+	if(rb->start > 0) {
+		memmove(rb->data, rb->data + rb->start, rb->end - rb->start);
+		rb->end -= rb->start;
+		rb->start = 0;
+	}
 
-	/* Remember the sequence number of the request */
-	reqseq = ntohl(msg->hdr.msgseq);
+	n = read(fd, rb->data + rb->end, sizeof(rb->data) - rb->end);
+	if(n > 0) {
+		rb->end += n;
+		return 1;
+	}
+	if(n == 0) {
+		fprintf(stderr, "ospf_apiclient: connection closed by peer\n");
+		return -1;
+	}
+	if(ERRNO_IO_RETRY(errno)) {
+		return 0;
+	}
+	fprintf(stderr, "ospf_apiclient: read: %s\n", safe_strerror(errno));
+	return -1;
+}
+
+/* Take the next whole message out of rb: 1 if there was one, 0 if it
+   isn't all in yet, -1 if it can't be one */
+static int ospf_apiclient_rbuf_next(struct ospf_apiclient_rbuf *rb, struct msg **msgp) {
+	struct apimsghdr hdr;
+	size_t bodylen;
+
+	if(rb->end - rb->start < sizeof(struct apimsghdr)) {
+		return 0;
+	}
+	memcpy(&hdr, rb->data + rb->start, sizeof(struct apimsghdr));
+	if(hdr.version != OSPF_API_VERSION) {
+		fprintf(stderr, "ospf_apiclient: OSPF API protocol version mismatch\n");
+		return -1;
+	}
+	bodylen = ntohs(hdr.msglen);
+	if(rb->end - rb->start < sizeof(struct apimsghdr) + bodylen) {
+		return 0;
+	}
+
+	*msgp = msg_new(hdr.msgtype, rb->data + rb->start + sizeof(struct apimsghdr), ntohl(hdr.msgseq), bodylen);
+	rb->start += sizeof(struct apimsghdr) + bodylen;
+	return 1;
+}
 
-	/* Write message to OSPFd */
-	rc = msg_write(oclient->fd_sync, msg);
+/* Queue a request behind those not yet written, return its sequence
+   number */
+static u_int32_t ospf_apiclient_queue(struct ospf_apiclient *oclient, struct msg *msg) {
+	u_int32_t seq;
+
+	/* NB: Given "msg" is freed inside this function. */
+	seq = ntohl(msg->hdr.msgseq);
+	buffer_put(oclient->wb_sync, &msg->hdr, sizeof(struct apimsghdr));
+	buffer_put(oclient->wb_sync, STREAM_DATA(msg->s), ntohs(msg->hdr.msglen));
 	msg_free(msg);
 
-	if(rc < 0) {
+	oclient->outstanding++;
+	return seq;
+}
+
+/* Handle the replies there are on the sync channel: 0 once there are no
+   more for now, -1 if the connection broke */
+static int ospf_apiclient_read_replies(struct ospf_apiclient *oclient) {
+	struct msg *msg;
+	int rc;
+
+	for(;;) {
+		while((rc = ospf_apiclient_rbuf_next(&oclient->rbuf_sync, &msg)) > 0) {
+			ospf_apiclient_handle_reply(oclient, msg);
+			msg_free(msg);
+		}
+		if(rc < 0) {
+			return -1;
+		}
+		if((rc = ospf_apiclient_rbuf_fill(oclient->fd_sync, &oclient->rbuf_sync)) <= 0) {
+			return rc;
+		}
+	}
+}
+
+/* Write what can be of the queued requests, wait for the socket, and
+   handle the replies that came */
+static int ospf_apiclient_pump(struct ospf_apiclient *oclient) {
+	struct pollfd pfd;
+	int pending;
+
+	if((pending = ospf_apiclient_flush(oclient)) < 0) {
 		return -1;
 	}
 
-	/* Wait for reply */ /* NB: New "msg" is allocated by "msg_read()". */
-	msg = msg_read(oclient->fd_sync);
-	if(!msg) {
+	pfd.fd = oclient->fd_sync;
+	pfd.events = POLLIN | (pending ? POLLOUT : 0);
+	pfd.revents = 0;
+	if(poll(&pfd, 1, -1) < 0 && errno != EINTR) {
+		fprintf(stderr, "ospf_apiclient: poll: %s\n", safe_strerror(errno));
 		return -1;
 	}
 
-	assert(msg->hdr.msgtype == MSG_REPLY);
-	assert(ntohl(msg->hdr.msgseq) == reqseq);
+	return ospf_apiclient_read_replies(oclient);
+}
 
-	msgreply = (struct msg_reply *) STREAM_DATA(msg->s);
-	rc = msgreply->errcode;
-	msg_free(msg);
+/* Send synchronous request, wait for reply.  Replies to pipelined
+   requests queued before it are handled meanwhile. */
+static int ospf_apiclient_send_request(struct ospf_apiclient *oclient, struct msg *msg) {
+	/* NB: Given "msg" is freed inside this function. */
+	oclient->wait_seq = ospf_apiclient_queue(oclient, msg);
 
-	return rc;
+	while(oclient->wait_seq) {
+		if(ospf_apiclient_pump(oclient) < 0) {
+			oclient->wait_seq = 0;
+			return -1;
+		}
+	}
+	return oclient->wait_rc;
 }
 
 /* -----------------------------------------------------------
@@ -371,21 +469,15 @@ out:
 	return rc;
 }
 
-/* 
- * Synchronous request to originate or update an LSA.
- */
-
-int ospf_apiclient_lsa_originate(struct ospf_apiclient *oclient, struct in_addr ifaddr, struct in_addr area_id, u_char lsa_type, u_char opaque_type, u_int32_t opaque_id, void *opaquedata, int opaquelen) {
-	struct msg *msg;
-	int rc;
+/* A request to originate or update an opaque LSA, made of parameters */
+static struct msg *ospf_apiclient_originate_msg(struct in_addr ifaddr, struct in_addr area_id, u_char lsa_type, u_char opaque_type, u_int32_t opaque_id, void *opaquedata, int opaquelen) {
 	u_char buf[OSPF_MAX_LSA_SIZE];
 	struct lsa_header *lsah;
 	u_int32_t tmp;
 
-	/* We can only originate opaque LSAs */
-	if(!IS_OPAQUE_LSA(lsa_type)) {
-		fprintf(stderr, "Cannot originate non-opaque LSA type %d\n", lsa_type);
-		return OSPF_API_ILLEGALLSATYPE;
+	if(opaquelen < 0 || sizeof(struct lsa_header) + opaquelen > sizeof(buf)) {
+		fprintf(stderr, "Opaque data of %d bytes too long\n", opaquelen);
+		return NULL;
 	}
 
 	/* Make a new LSA from parameters */
@@ -403,7 +495,24 @@ int ospf_apiclient_lsa_originate(struct ospf_apiclient *oclient, struct in_addr
 
 	memcpy(((u_char *) lsah) + sizeof(struct lsa_header), opaquedata, opaquelen);
 
-	msg = new_msg_originate_request(ospf_apiclient_get_seqnr(), ifaddr, area_id, lsah);
+	return new_msg_originate_request(ospf_apiclient_get_seqnr(), ifaddr, area_id, lsah);
+}
+
+/* 
+ * Synchronous request to originate or update an LSA.
+ */
+
+int ospf_apiclient_lsa_originate(struct ospf_apiclient *oclient, struct in_addr ifaddr, struct in_addr area_id, u_char lsa_type, u_char opaque_type, u_int32_t opaque_id, void *opaquedata, int opaquelen) {
+	struct msg *msg;
+	int rc;
+
+	/* We can only originate opaque LSAs */
+	if(!IS_OPAQUE_LSA(lsa_type)) {
+		fprintf(stderr, "Cannot originate non-opaque LSA type %d\n", lsa_type);
+		return OSPF_API_ILLEGALLSATYPE;
+	}
+
+	msg = ospf_apiclient_originate_msg(ifaddr, area_id, lsa_type, opaque_type, opaque_id, opaquedata, opaquelen);
 	if(!msg) {
 		fprintf(stderr, "new_msg_originate_request failed\n");
 		return OSPF_API_NOMEMORY;
@@ -431,6 +540,91 @@ int ospf_apiclient_lsa_delete(struct ospf_apiclient *oclient, struct in_addr are
 	return rc;
 }
 
+/* -----------------------------------------------------------
+ * Pipelined requests
+ * -----------------------------------------------------------
+ */
+
+u_int32_t ospf_apiclient_lsa_originate_async(struct ospf_apiclient *oclient, struct in_addr ifaddr, struct in_addr area_id, u_char lsa_type, u_char opaque_type, u_int32_t opaque_id, void *opaquedata, int opaquelen) {
+	struct msg *msg;
+
+	if(!IS_OPAQUE_LSA(lsa_type)) {
+		fprintf(stderr, "Cannot originate non-opaque LSA type %d\n", lsa_type);
+		return 0;
+	}
+
+	msg = ospf_apiclient_originate_msg(ifaddr, area_id, lsa_type, opaque_type, opaque_id, opaquedata, opaquelen);
+	if(!msg) {
+		fprintf(stderr, "new_msg_originate_request failed\n");
+		return 0;
+	}
+	return ospf_apiclient_queue(oclient, msg);
+}
+
+u_int32_t ospf_apiclient_lsa_delete_async(struct ospf_apiclient *oclient, struct in_addr area_id, u_char lsa_type, u_char opaque_type, u_int32_t opaque_id) {
+	struct msg *msg;
+
+	if(!IS_OPAQUE_LSA(lsa_type)) {
+		fprintf(stderr, "Cannot delete non-opaque LSA type %d\n", lsa_type);
+		return 0;
+	}
+
+	msg = new_msg_delete_request(ospf_apiclient_get_seqnr(), area_id, lsa_type, opaque_type, opaque_id);
+	if(!msg) {
+		fprintf(stderr, "new_msg_delete_request failed\n");
+		return 0;
+	}
+	return ospf_apiclient_queue(oclient, msg);
+}
+
+u_int32_t ospf_apiclient_sync_lsdb_async(struct ospf_apiclient *oclient) {
+	struct msg *msg;
+	struct lsa_filter_type filter;
+
+	filter.typemask = 0xFFFF; /* all LSAs */
+	filter.origin = ANY_ORIGIN;
+	filter.num_areas = 0; /* all Areas. */
+
+	msg = new_msg_register_event(ospf_apiclient_get_seqnr(), &filter);
+	if(!msg) {
+		fprintf(stderr, "new_msg_register_event failed\n");
+		return 0;
+	}
+	ospf_apiclient_queue(oclient, msg);
+
+	msg = new_msg_sync_lsdb(ospf_apiclient_get_seqnr(), &filter);
+	if(!msg) {
+		fprintf(stderr, "new_msg_sync_lsdb failed\n");
+		return 0;
+	}
+	return ospf_apiclient_queue(oclient, msg);
+}
+
+int ospf_apiclient_flush(struct ospf_apiclient *oclient) {
+	switch(buffer_flush_available(oclient->wb_sync, oclient->fd_sync)) {
+		case BUFFER_ERROR: fprintf(stderr, "ospf_apiclient_flush: write failed\n"); return -1;
+		case BUFFER_PENDING: return 1;
+		case BUFFER_EMPTY: break;
+	}
+	return 0;
+}
+
+int ospf_apiclient_handle_replies(struct ospf_apiclient *oclient) {
+	if(ospf_apiclient_read_replies(oclient) < 0) {
+		return -1;
+	}
+	return oclient->outstanding;
+}
+
+int ospf_apiclient_wait(struct ospf_apiclient *oclient) {
+	while(oclient->outstanding) {
+		if(ospf_apiclient_pump(oclient) < 0) {
+			return -1;
+		}
+	}
+	return 0;
+}
+
 /* -----------------------------------------------------------
  * Followings are handlers for messages from OSPF daemon
  * -----------------------------------------------------------
@@ -536,6 +730,34 @@ static void ospf_apiclient_handle_lsa_delete(struct ospf_apiclient *oclient, str
 	XFREE(MTYPE_OSPF_APICLIENT, lsa);
 }
 
+void ospf_apiclient_handle_reply(struct ospf_apiclient *oclient, struct msg *msg) {
+	struct msg_reply *r;
+	u_int32_t seq;
+
+	if(msg->hdr.msgtype != MSG_REPLY) {
+		fprintf(stderr, "ospf_apiclient_handle_reply: Unexpected message type: %d\n", msg->hdr.msgtype);
+		return;
+	}
+	r = (struct msg_reply *) STREAM_DATA(msg->s);
+	seq = ntohl(msg->hdr.msgseq);
+
+	if(oclient->outstanding) {
+		oclient->outstanding--;
+	}
+
+	/* The reply a synchronous request waits for is its own */
+	if(oclient->wait_seq && seq == oclient->wait_seq) {
+		oclient->wait_rc = r->errcode;
+		oclient->wait_seq = 0;
+		return;
+	}
+
+	/* Invoke registered callback function. */
+	if(oclient->reply_notify) {
+		(oclient->reply_notify)(seq, r->errcode);
+	}
+}
+
 static void ospf_apiclient_msghandle(struct ospf_apiclient *oclient, struct msg *msg) {
 	/* Call message handler function. */
 	switch(msg->hdr.msgtype) {
@@ -573,27 +795,53 @@ void ospf_apiclient_register_callback(
 	oclient->delete_notify = delete_notify;
 }
 
+void ospf_apiclient_register_reply(struct ospf_apiclient *oclient, void (*reply_notify)(u_int32_t seqnum, int errcode)) {
+	assert(oclient);
+	oclient->reply_notify = reply_notify;
+}
+
 /* -----------------------------------------------------------
  * Asynchronous message handling
  * -----------------------------------------------------------
  */
 
 int ospf_apiclient_handle_async(struct ospf_apiclient *oclient) {
+	struct pollfd pfd;
 	struct msg *msg;
+	int handled = 0;
+	int rc;
 
-	/* Get a message */
-	msg = msg_read(oclient->fd_async);
-
-	if(!msg) {
-		/* Connection broke down */
-		return -1;
+	/* Handle all there is: an LSDB sync or a burst of changes is read
+	   many messages at a time */
+	for(;;) {
+		while((rc = ospf_apiclient_rbuf_next(&oclient->rbuf_async, &msg)) > 0) {
+			/* Handle message */
+			ospf_apiclient_msghandle(oclient, msg);
+
+			/* Don't forget to free this message */
+			msg_free(msg);
+			handled++;
+		}
+		if(rc < 0) {
+			return -1;
+		}
+
+		if((rc = ospf_apiclient_rbuf_fill(oclient->fd_async, &oclient->rbuf_async)) < 0) {
+			/* Connection broke down */
+			return -1;
+		}
+		if(rc == 0) {
+			if(handled) {
+				return 0;
+			}
+
+			/* Nothing yet, wait for a message as ever */
+			pfd.fd = oclient->fd_async;
+			pfd.events = POLLIN;
+			pfd.revents = 0;
+			if(poll(&pfd, 1, -1) < 0 && errno != EINTR) {
+				return -1;
+			}
+		}
 	}
-
-	/* Handle message */
-	ospf_apiclient_msghandle(oclient, msg);
-
-	/* Don't forget to free this message */
-	msg_free(msg);
-
-	return 0;
 }
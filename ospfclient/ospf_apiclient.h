@@ -25,12 +25,33 @@
 
 #define MTYPE_OSPF_APICLIENT MTYPE_TMP
 
+/* Room for what is read of a channel and not yet handled: a few
+   messages of the largest size */
+#define OSPF_APICLIENT_RBUF 65536
+
+struct ospf_apiclient_rbuf {
+	u_char data[OSPF_APICLIENT_RBUF];
+	size_t start, end;
+};
+
 /* Structure for the OSPF API client */
 struct ospf_apiclient {
-	/* Sockets for sync requests and async notifications */
+	/* Sockets for sync requests and async notifications, both
+	   non-blocking */
 	int fd_sync;
 	int fd_async;
 
+	/* Requests not yet written, requests written and not yet
+	   answered, and what was read of either channel */
+	struct buffer *wb_sync;
+	unsigned long outstanding;
+	struct ospf_apiclient_rbuf rbuf_sync;
+	struct ospf_apiclient_rbuf rbuf_async;
+
+	/* The request a synchronous call waits for, and its reply */
+	u_int32_t wait_seq;
+	int wait_rc;
+
 	/* Pointer to callback functions */
 	void (*ready_notify)(u_char lsa_type, u_char opaque_type, struct in_addr addr);
 	void (*new_if)(struct in_addr ifaddr, struct in_addr area_id);
@@ -39,6 +60,7 @@ struct ospf_apiclient {
 	void (*nsm_change)(struct in_addr ifaddr, struct in_addr nbraddr, struct in_addr router_id, u_char status);
 	void (*update_notify)(struct in_addr ifaddr, struct in_addr area_id, u_char self_origin, struct lsa_header *lsa);
 	void (*delete_notify)(struct in_addr ifaddr, struct in_addr area_id, u_char self_origin, struct lsa_header *lsa);
+	void (*reply_notify)(u_int32_t seqnum, int errcode);
 };
 
 /* ---------------------------------------------------------
@@ -75,7 +97,43 @@ int ospf_apiclient_lsa_originate(struct ospf_apiclient *oclient, struct in_addr
    host byte order */
 int ospf_apiclient_lsa_delete(struct ospf_apiclient *oclient, struct in_addr area_id, u_char lsa_type, u_char opaque_type, u_int32_t opaque_id);
 
-/* Fetch async message and handle it  */
+/* Fetch async messages and handle them: waits for one, then handles
+   every one read along with it */
 int ospf_apiclient_handle_async(struct ospf_apiclient *oclient);
 
+/* ---------------------------------------------------------
+ * Pipelined requests.  An _async request is queued, and its sequence
+ * number returned, 0 if it could not be made.  Queued requests go out
+ * many to a write with ospf_apiclient_flush(), and the reply to each
+ * comes to the reply callback from ospf_apiclient_handle_replies(),
+ * in the order of the requests.  ospf_apiclient_wait() does both until
+ * every request is answered.  The synchronous requests above wait for
+ * those queued before them.
+ * --------------------------------------------------------- */
+
+/* Register the callback for replies to pipelined requests. */
+void ospf_apiclient_register_reply(struct ospf_apiclient *oclient, void (*reply_notify)(u_int32_t seqnum, int errcode));
+
+/* Queue a request to originate or update opaque LSA. */
+u_int32_t ospf_apiclient_lsa_originate_async(struct ospf_apiclient *oclient, struct in_addr ifaddr, struct in_addr area_id, u_char lsa_type, u_char opaque_type, u_int32_t opaque_id, void *opaquedata, int opaquelen);
+
+/* Queue a request to delete opaque LSA, opaque_id in host byte order. */
+u_int32_t ospf_apiclient_lsa_delete_async(struct ospf_apiclient *oclient, struct in_addr area_id, u_char lsa_type, u_char opaque_type, u_int32_t opaque_id);
+
+/* Queue the requests to synchronize LSDB: the LSAs then come as update
+   notifications, many to a read.  Returns the sequence number of the
+   last request. */
+u_int32_t ospf_apiclient_sync_lsdb_async(struct ospf_apiclient *oclient);
+
+/* Write what the socket takes of the queued requests: 0 once all are
+   out, 1 if fd_sync is to be waited on for writing, -1 on error. */
+int ospf_apiclient_flush(struct ospf_apiclient *oclient);
+
+/* Handle the replies read on fd_sync, without waiting for more:
+   returns the requests left unanswered, -1 if the connection broke. */
+int ospf_apiclient_handle_replies(struct ospf_apiclient *oclient);
+
+/* Flush and handle replies until no request is unanswered. */
+int ospf_apiclient_wait(struct ospf_apiclient *oclient);
+
 #endif /* _OSPF_APICLIENT_H */
@@ -49,6 +49,7 @@
 #include "ospfd/ospf_ase.h"
 #include "ospfd/ospf_zebra.h"
 #include "ospfd/ospf_dump.h"
+#include "ospfd/ospf_gr.h"
 
 static struct ospf_area_range *ospf_area_range_new(struct prefix_ipv4 *p) {
 	struct ospf_area_range *range;
@@ -516,6 +517,7 @@ void ospf_check_abr_status(struct ospf *ospf) {
 	}
 
 	if(new_flags != ospf->flags) {
+		ospf->abr_resync = 1;
 		ospf_spf_calculate_schedule(ospf, SPF_FLAG_ABR_STATUS_CHANGE);
 		if(IS_DEBUG_OSPF_EVENT) {
 			zlog_debug("ospf_check_abr_status(): new router flags: %x", new_flags);
@@ -814,91 +816,105 @@ static int ospf_abr_plist_out_check(struct ospf_area *area, struct ospf_route *
 	return 1;
 }
 
-static void ospf_abr_announce_network(struct ospf *ospf, struct prefix_ipv4 *p, struct ospf_route * or) {
+/* What an intra- or inter-area network route announces into another area */
+#define OSPF_ABR_ANNOUNCE_NONE 0
+#define OSPF_ABR_ANNOUNCE_DIRECT 1 /* a summary-LSA of its own */
+#define OSPF_ABR_ANNOUNCE_RANGE 2  /* a contribution to an area range */
+
+static int ospf_abr_network_announcement(struct prefix_ipv4 *p, struct ospf_route * or, struct ospf_area *or_area, struct ospf_area *area, struct ospf_area_range **rangep) {
 	struct ospf_area_range *range;
-	struct ospf_area *area, *or_area;
-	struct listnode *node;
 
 	if(IS_DEBUG_OSPF_EVENT) {
-		zlog_debug("ospf_abr_announce_network(): Start");
+		zlog_debug("ospf_abr_announce_network(): looking at area %s", inet_ntoa(area->area_id));
 	}
 
-	or_area = ospf_area_lookup_by_area_id(ospf, or->u.std.area_id);
-	assert(or_area);
+	if(IPV4_ADDR_SAME(& or->u.std.area_id, &area->area_id)) {
+		return OSPF_ABR_ANNOUNCE_NONE;
+	}
 
-	for(ALL_LIST_ELEMENTS_RO(ospf->areas, node, area)) {
+	if(ospf_abr_nexthops_belong_to_area(or, area)) {
+		return OSPF_ABR_ANNOUNCE_NONE;
+	}
+
+	if(!ospf_abr_should_accept(p, area)) {
 		if(IS_DEBUG_OSPF_EVENT) {
-			zlog_debug("ospf_abr_announce_network(): looking at area %s", inet_ntoa(area->area_id));
+			zlog_debug(
+				"ospf_abr_announce_network(): "
+				"prefix %s/%d was denied by import-list",
+				inet_ntoa(p->prefix), p->prefixlen
+			);
 		}
+		return OSPF_ABR_ANNOUNCE_NONE;
+	}
 
-		if(IPV4_ADDR_SAME(& or->u.std.area_id, &area->area_id)) {
-			continue;
+	if(!ospf_abr_plist_in_check(area, or, p)) {
+		if(IS_DEBUG_OSPF_EVENT) {
+			zlog_debug(
+				"ospf_abr_announce_network(): "
+				"prefix %s/%d was denied by prefix-list",
+				inet_ntoa(p->prefix), p->prefixlen
+			);
 		}
+		return OSPF_ABR_ANNOUNCE_NONE;
+	}
 
-		if(ospf_abr_nexthops_belong_to_area(or, area)) {
-			continue;
+	if(area->external_routing != OSPF_AREA_DEFAULT && area->no_summary) {
+		if(IS_DEBUG_OSPF_EVENT) {
+			zlog_debug(
+				"ospf_abr_announce_network(): "
+				"area %s is stub and no_summary",
+				inet_ntoa(area->area_id)
+			);
 		}
+		return OSPF_ABR_ANNOUNCE_NONE;
+	}
 
-		if(!ospf_abr_should_accept(p, area)) {
-			if(IS_DEBUG_OSPF_EVENT) {
-				zlog_debug(
-					"ospf_abr_announce_network(): "
-					"prefix %s/%d was denied by import-list",
-					inet_ntoa(p->prefix), p->prefixlen
-				);
-			}
-			continue;
+	if(or->path_type == OSPF_PATH_INTER_AREA) {
+		if(IS_DEBUG_OSPF_EVENT) {
+			zlog_debug(
+				"ospf_abr_announce_network(): this is "
+				"inter-area route to %s/%d",
+				inet_ntoa(p->prefix), p->prefixlen
+			);
 		}
 
-		if(!ospf_abr_plist_in_check(area, or, p)) {
-			if(IS_DEBUG_OSPF_EVENT) {
-				zlog_debug(
-					"ospf_abr_announce_network(): "
-					"prefix %s/%d was denied by prefix-list",
-					inet_ntoa(p->prefix), p->prefixlen
-				);
-			}
-			continue;
+		if(!OSPF_IS_AREA_BACKBONE(area)) {
+			return OSPF_ABR_ANNOUNCE_DIRECT;
 		}
+	}
 
-		if(area->external_routing != OSPF_AREA_DEFAULT && area->no_summary) {
-			if(IS_DEBUG_OSPF_EVENT) {
-				zlog_debug(
-					"ospf_abr_announce_network(): "
-					"area %s is stub and no_summary",
-					inet_ntoa(area->area_id)
-				);
-			}
-			continue;
+	if(or->path_type == OSPF_PATH_INTRA_AREA) {
+		if(IS_DEBUG_OSPF_EVENT) {
+			zlog_debug(
+				"ospf_abr_announce_network(): "
+				"this is intra-area route to %s/%d",
+				inet_ntoa(p->prefix), p->prefixlen
+			);
+		}
+		if((range = ospf_area_range_match(or_area, p)) && !ospf_area_is_transit(area)) {
+			*rangep = range;
+			return OSPF_ABR_ANNOUNCE_RANGE;
 		}
+		return OSPF_ABR_ANNOUNCE_DIRECT;
+	}
 
-		if(or->path_type == OSPF_PATH_INTER_AREA) {
-			if(IS_DEBUG_OSPF_EVENT) {
-				zlog_debug(
-					"ospf_abr_announce_network(): this is "
-					"inter-area route to %s/%d",
-					inet_ntoa(p->prefix), p->prefixlen
-				);
-			}
+	return OSPF_ABR_ANNOUNCE_NONE;
+}
 
-			if(!OSPF_IS_AREA_BACKBONE(area)) {
-				ospf_abr_announce_network_to_area(p, or->cost, area);
-			}
-		}
+static void ospf_abr_announce_network(struct ospf *ospf, struct prefix_ipv4 *p, struct ospf_route * or, struct ospf_area *or_area) {
+	struct ospf_area_range *range;
+	struct ospf_area *area;
+	struct listnode *node;
 
-		if(or->path_type == OSPF_PATH_INTRA_AREA) {
-			if(IS_DEBUG_OSPF_EVENT) {
-				zlog_debug(
-					"ospf_abr_announce_network(): "
-					"this is intra-area route to %s/%d",
-					inet_ntoa(p->prefix), p->prefixlen
-				);
-			}
-			if((range = ospf_area_range_match(or_area, p)) && !ospf_area_is_transit(area)) {
-				ospf_abr_update_aggregate(range, or, area);
-			} else {
-				ospf_abr_announce_network_to_area(p, or->cost, area);
-			}
+	if(IS_DEBUG_OSPF_EVENT) {
+		zlog_debug("ospf_abr_announce_network(): Start");
+	}
+
+	for(ALL_LIST_ELEMENTS_RO(ospf->areas, node, area)) {
+		switch(ospf_abr_network_announcement(p, or, or_area, area, &range)) {
+			case OSPF_ABR_ANNOUNCE_DIRECT: ospf_abr_announce_network_to_area(p, or->cost, area); break;
+			case OSPF_ABR_ANNOUNCE_RANGE: ospf_abr_update_aggregate(range, or, area); break;
+			default: break;
 		}
 	}
 }
@@ -967,90 +983,102 @@ static void ospf_abr_process_nssa_translates(struct ospf *ospf) {
 	}
 }
 
-static void ospf_abr_process_network_rt(struct ospf *ospf, struct route_table *rt) {
+/* The area a network route is summarized from, NULL if it is not
+   announced to other areas at all */
+static struct ospf_area *ospf_abr_network_source(struct ospf *ospf, struct prefix_ipv4 *p, struct ospf_route * or) {
 	struct ospf_area *area;
-	struct ospf_route * or ;
-	struct route_node *rn;
 
-	if(IS_DEBUG_OSPF_EVENT) {
-		zlog_debug("ospf_abr_process_network_rt(): Start");
+	if(!(area = ospf_area_lookup_by_area_id(ospf, or->u.std.area_id))) {
+		if(IS_DEBUG_OSPF_EVENT) {
+			zlog_debug("ospf_abr_network_source(): area %s no longer exists", inet_ntoa(or->u.std.area_id));
+		}
+		return NULL;
 	}
 
-	for(rn = route_top(rt); rn; rn = route_next(rn)) {
-		if((or = rn->info) == NULL) {
-			continue;
+	if(IS_DEBUG_OSPF_EVENT) {
+		zlog_debug("ospf_abr_network_source(): this is a route to %s/%d", inet_ntoa(p->prefix), p->prefixlen);
+	}
+	if(or->path_type >= OSPF_PATH_TYPE1_EXTERNAL) {
+		if(IS_DEBUG_OSPF_EVENT) {
+			zlog_debug("ospf_abr_network_source(): "
+				   "this is an External router, skipping");
 		}
+		return NULL;
+	}
 
-		if(!(area = ospf_area_lookup_by_area_id(ospf, or->u.std.area_id))) {
-			if(IS_DEBUG_OSPF_EVENT) {
-				zlog_debug("ospf_abr_process_network_rt(): area %s no longer exists", inet_ntoa(or->u.std.area_id));
-			}
-			continue;
+	if(or->cost >= OSPF_LS_INFINITY) {
+		if(IS_DEBUG_OSPF_EVENT) {
+			zlog_debug("ospf_abr_network_source():"
+				   " this route's cost is infinity, skipping");
 		}
+		return NULL;
+	}
 
+	if(or->type == OSPF_DESTINATION_DISCARD) {
 		if(IS_DEBUG_OSPF_EVENT) {
-			zlog_debug("ospf_abr_process_network_rt(): this is a route to %s/%d", inet_ntoa(rn->p.u.prefix4), rn->p.prefixlen);
-		}
-		if(or->path_type >= OSPF_PATH_TYPE1_EXTERNAL) {
-			if(IS_DEBUG_OSPF_EVENT) {
-				zlog_debug("ospf_abr_process_network_rt(): "
-					   "this is an External router, skipping");
-			}
-			continue;
+			zlog_debug("ospf_abr_network_source():"
+				   " this is a discard entry, skipping");
 		}
+		return NULL;
+	}
 
-		if(or->cost >= OSPF_LS_INFINITY) {
-			if(IS_DEBUG_OSPF_EVENT) {
-				zlog_debug("ospf_abr_process_network_rt():"
-					   " this route's cost is infinity, skipping");
-			}
-			continue;
+	if(or->path_type == OSPF_PATH_INTRA_AREA && !ospf_abr_should_announce(ospf, p, or)) {
+		if(IS_DEBUG_OSPF_EVENT) {
+			zlog_debug("ospf_abr_network_source(): denied by export-list");
 		}
+		return NULL;
+	}
 
-		if(or->type == OSPF_DESTINATION_DISCARD) {
-			if(IS_DEBUG_OSPF_EVENT) {
-				zlog_debug("ospf_abr_process_network_rt():"
-					   " this is a discard entry, skipping");
-			}
-			continue;
+	if(or->path_type == OSPF_PATH_INTRA_AREA && !ospf_abr_plist_out_check(area, or, p)) {
+		if(IS_DEBUG_OSPF_EVENT) {
+			zlog_debug("ospf_abr_network_source(): denied by prefix-list");
 		}
+		return NULL;
+	}
 
-		if(or->path_type == OSPF_PATH_INTRA_AREA && !ospf_abr_should_announce(ospf, (struct prefix_ipv4 *) &rn->p, or)) {
-			if(IS_DEBUG_OSPF_EVENT) {
-				zlog_debug("ospf_abr_process_network_rt(): denied by export-list");
-			}
-			continue;
+	if((or->path_type == OSPF_PATH_INTER_AREA) && !OSPF_IS_AREA_ID_BACKBONE(or->u.std.area_id)) {
+		if(IS_DEBUG_OSPF_EVENT) {
+			zlog_debug("ospf_abr_network_source():"
+				   " this is route is not backbone one, skipping");
 		}
+		return NULL;
+	}
 
-		if(or->path_type == OSPF_PATH_INTRA_AREA && !ospf_abr_plist_out_check(area, or, (struct prefix_ipv4 *) &rn->p)) {
+	if((ospf->abr_type == OSPF_ABR_CISCO) || (ospf->abr_type == OSPF_ABR_IBM)) {
+		if(!ospf_act_bb_connection(ospf) && or->path_type != OSPF_PATH_INTRA_AREA) {
 			if(IS_DEBUG_OSPF_EVENT) {
-				zlog_debug("ospf_abr_process_network_rt(): denied by prefix-list");
+				zlog_debug("ospf_abr_network_source(): ALT ABR: "
+					   "No BB connection, skip not intra-area routes");
 			}
-			continue;
+			return NULL;
 		}
+	}
 
-		if((or->path_type == OSPF_PATH_INTER_AREA) && !OSPF_IS_AREA_ID_BACKBONE(or->u.std.area_id)) {
-			if(IS_DEBUG_OSPF_EVENT) {
-				zlog_debug("ospf_abr_process_network_rt():"
-					   " this is route is not backbone one, skipping");
-			}
+	return area;
+}
+
+static void ospf_abr_process_network_rt(struct ospf *ospf, struct route_table *rt) {
+	struct ospf_area *area;
+	struct ospf_route * or ;
+	struct route_node *rn;
+
+	if(IS_DEBUG_OSPF_EVENT) {
+		zlog_debug("ospf_abr_process_network_rt(): Start");
+	}
+
+	for(rn = route_top(rt); rn; rn = route_next(rn)) {
+		if((or = rn->info) == NULL) {
 			continue;
 		}
 
-		if((ospf->abr_type == OSPF_ABR_CISCO) || (ospf->abr_type == OSPF_ABR_IBM)) {
-			if(!ospf_act_bb_connection(ospf) && or->path_type != OSPF_PATH_INTRA_AREA) {
-				if(IS_DEBUG_OSPF_EVENT) {
-					zlog_debug("ospf_abr_process_network_rt(): ALT ABR: "
-						   "No BB connection, skip not intra-area routes");
-				}
-				continue;
-			}
+		if(!(area = ospf_abr_network_source(ospf, (struct prefix_ipv4 *) &rn->p, or))) {
+			continue;
 		}
 
 		if(IS_DEBUG_OSPF_EVENT) {
 			zlog_debug("ospf_abr_process_network_rt(): announcing");
 		}
-		ospf_abr_announce_network(ospf, (struct prefix_ipv4 *) &rn->p, or);
+		ospf_abr_announce_network(ospf, (struct prefix_ipv4 *) &rn->p, or, area);
 	}
 
 	if(IS_DEBUG_OSPF_EVENT) {
@@ -1307,7 +1335,8 @@ static void ospf_abr_unapprove_translates(struct ospf *ospf) /* For NSSA Transla
 	}
 }
 
-static void ospf_abr_unapprove_summaries(struct ospf *ospf) {
+/* Of the ASBR-summary-LSAs alone, with network set of summary-LSAs too */
+static void ospf_abr_unapprove_summaries(struct ospf *ospf, int network) {
 	struct listnode *node;
 	struct ospf_area *area;
 	struct route_node *rn;
@@ -1325,16 +1354,18 @@ static void ospf_abr_unapprove_summaries(struct ospf *ospf) {
 				inet_ntoa(area->area_id)
 			);
 		}
-		LSDB_LOOP(SUMMARY_LSDB(area), rn, lsa)
-		if(ospf_lsa_is_self_originated(ospf, lsa)) {
-			if(IS_DEBUG_OSPF_EVENT) {
-				zlog_debug(
-					"ospf_abr_unapprove_summaries(): "
-					"approved unset on summary link id %s",
-					inet_ntoa(lsa->data->id)
-				);
+		if(network) {
+			LSDB_LOOP(SUMMARY_LSDB(area), rn, lsa)
+			if(ospf_lsa_is_self_originated(ospf, lsa)) {
+				if(IS_DEBUG_OSPF_EVENT) {
+					zlog_debug(
+						"ospf_abr_unapprove_summaries(): "
+						"approved unset on summary link id %s",
+						inet_ntoa(lsa->data->id)
+					);
+				}
+				UNSET_FLAG(lsa->flags, OSPF_LSA_APPROVED);
 			}
-			UNSET_FLAG(lsa->flags, OSPF_LSA_APPROVED);
 		}
 
 		LSDB_LOOP(ASBR_SUMMARY_LSDB(area), rn, lsa)
@@ -1379,12 +1410,75 @@ static void ospf_abr_prepare_aggregates(struct ospf *ospf) {
 	}
 }
 
+/* The prefix a range is announced as */
+static void ospf_abr_range_prefix(struct ospf_area_range *range, struct prefix_ipv4 *p) {
+	p->family = AF_INET;
+	if(CHECK_FLAG(range->flags, OSPF_AREA_RANGE_SUBSTITUTE)) {
+		p->prefix = range->subst_addr;
+		p->prefixlen = range->subst_masklen;
+	} else {
+		p->prefix = range->addr;
+		p->prefixlen = range->masklen;
+	}
+}
+
+/* Backbone routes are not summarized when announced into transit areas */
+static int ospf_abr_range_announced_to(struct ospf_area *area, struct ospf_area *ar) {
+	return ar != area && !(ospf_area_is_transit(ar) && OSPF_IS_AREA_BACKBONE(area));
+}
+
+static void ospf_abr_announce_range(struct ospf *ospf, struct ospf_area *area, struct ospf_area_range *range) {
+	struct ospf_area *ar;
+	struct prefix_ipv4 p;
+	struct listnode *n;
+
+	if(!CHECK_FLAG(range->flags, OSPF_AREA_RANGE_ADVERTISE)) {
+		if(IS_DEBUG_OSPF_EVENT) {
+			zlog_debug("ospf_abr_announce_aggregates():"
+				   " discarding suppress-ranges");
+		}
+		return;
+	}
+
+	ospf_abr_range_prefix(range, &p);
+
+	if(IS_DEBUG_OSPF_EVENT) {
+		zlog_debug(
+			"ospf_abr_announce_aggregates():"
+			" this is range: %s/%d",
+			inet_ntoa(p.prefix), p.prefixlen
+		);
+	}
+
+	if(!range->specifics) {
+		return;
+	}
+
+	if(IS_DEBUG_OSPF_EVENT) {
+		zlog_debug("ospf_abr_announce_aggregates(): active range");
+	}
+
+	for(ALL_LIST_ELEMENTS_RO(ospf->areas, n, ar)) {
+		/* We do not check nexthops here, because
+	   intra-area routes can be associated with
+	   one area only */
+		if(!ospf_abr_range_announced_to(area, ar)) {
+			if(ar != area && IS_DEBUG_OSPF_EVENT) {
+				zlog_debug("ospf_abr_announce_aggregates(): Skipping "
+					   "announcement of BB aggregate into"
+					   " a transit area");
+			}
+			continue;
+		}
+		ospf_abr_announce_network_to_area(&p, range->cost, ar);
+	}
+}
+
 static void ospf_abr_announce_aggregates(struct ospf *ospf) {
-	struct ospf_area *area, *ar;
+	struct ospf_area *area;
 	struct ospf_area_range *range;
 	struct route_node *rn;
-	struct prefix p;
-	struct listnode *node, *n;
+	struct listnode *node;
 
 	if(IS_DEBUG_OSPF_EVENT) {
 		zlog_debug("ospf_abr_announce_aggregates(): Start");
@@ -1397,60 +1491,7 @@ static void ospf_abr_announce_aggregates(struct ospf *ospf) {
 
 		for(rn = route_top(area->ranges); rn; rn = route_next(rn)) {
 			if((range = rn->info)) {
-				if(!CHECK_FLAG(range->flags, OSPF_AREA_RANGE_ADVERTISE)) {
-					if(IS_DEBUG_OSPF_EVENT) {
-						zlog_debug("ospf_abr_announce_aggregates():"
-							   " discarding suppress-ranges");
-					}
-					continue;
-				}
-
-				p.family = AF_INET;
-				p.u.prefix4 = range->addr;
-				p.prefixlen = range->masklen;
-
-				if(IS_DEBUG_OSPF_EVENT) {
-					zlog_debug(
-						"ospf_abr_announce_aggregates():"
-						" this is range: %s/%d",
-						inet_ntoa(p.u.prefix4), p.prefixlen
-					);
-				}
-
-				if(CHECK_FLAG(range->flags, OSPF_AREA_RANGE_SUBSTITUTE)) {
-					p.family = AF_INET;
-					p.u.prefix4 = range->subst_addr;
-					p.prefixlen = range->subst_masklen;
-				}
-
-				if(range->specifics) {
-					if(IS_DEBUG_OSPF_EVENT) {
-						zlog_debug("ospf_abr_announce_aggregates(): active range");
-					}
-
-					for(ALL_LIST_ELEMENTS_RO(ospf->areas, n, ar)) {
-						if(ar == area) {
-							continue;
-						}
-
-						/* We do not check nexthops here, because
-		       intra-area routes can be associated with
-		       one area only */
-
-						/* backbone routes are not summarized
-		       when announced into transit areas */
-
-						if(ospf_area_is_transit(ar) && OSPF_IS_AREA_BACKBONE(area)) {
-							if(IS_DEBUG_OSPF_EVENT) {
-								zlog_debug("ospf_abr_announce_aggregates(): Skipping "
-									   "announcement of BB aggregate into"
-									   " a transit area");
-							}
-							continue;
-						}
-						ospf_abr_announce_network_to_area((struct prefix_ipv4 *) &p, range->cost, ar);
-					}
-				}
+				ospf_abr_announce_range(ospf, area, range);
 			}
 		}
 	}
@@ -1611,7 +1652,7 @@ static void ospf_abr_remove_unapproved_translates(struct ospf *ospf) {
 	}
 }
 
-static void ospf_abr_remove_unapproved_summaries(struct ospf *ospf) {
+static void ospf_abr_remove_unapproved_summaries(struct ospf *ospf, int network) {
 	struct listnode *node;
 	struct ospf_area *area;
 	struct route_node *rn;
@@ -1630,10 +1671,12 @@ static void ospf_abr_remove_unapproved_summaries(struct ospf *ospf) {
 			);
 		}
 
-		LSDB_LOOP(SUMMARY_LSDB(area), rn, lsa)
-		if(ospf_lsa_is_self_originated(ospf, lsa)) {
-			if(!CHECK_FLAG(lsa->flags, OSPF_LSA_APPROVED)) {
-				ospf_lsa_flush_area(lsa, area);
+		if(network) {
+			LSDB_LOOP(SUMMARY_LSDB(area), rn, lsa)
+			if(ospf_lsa_is_self_originated(ospf, lsa)) {
+				if(!CHECK_FLAG(lsa->flags, OSPF_LSA_APPROVED)) {
+					ospf_lsa_flush_area(lsa, area);
+				}
 			}
 		}
 
@@ -1767,6 +1810,8 @@ static void ospf_abr_nssa_task(struct ospf *ospf) /* called only if any_nssa */
 	}
 }
 
+static void ospf_abr_state_save(struct ospf *);
+
 /* This is the function taking care about ABR stuff, i.e.
    summary-LSA origination and flooding. */
 void ospf_abr_task(struct ospf *ospf) {
@@ -1774,17 +1819,24 @@ void ospf_abr_task(struct ospf *ospf) {
 		zlog_debug("ospf_abr_task(): Start");
 	}
 
+	/* Restarting, the summaries from before are still out there. */
+	if(OSPF_GR_RESTARTING_P(ospf)) {
+		ospf->abr_resync = 1;
+		return;
+	}
+
 	if(ospf->new_table == NULL || ospf->new_rtrs == NULL) {
 		if(IS_DEBUG_OSPF_EVENT) {
 			zlog_debug("ospf_abr_task(): Routing tables are not yet ready");
 		}
+		ospf->abr_resync = 1;
 		return;
 	}
 
 	if(IS_DEBUG_OSPF_EVENT) {
 		zlog_debug("ospf_abr_task(): unapprove summaries");
 	}
-	ospf_abr_unapprove_summaries(ospf);
+	ospf_abr_unapprove_summaries(ospf, 1);
 
 	if(IS_DEBUG_OSPF_EVENT) {
 		zlog_debug("ospf_abr_task(): prepare aggregates");
@@ -1816,15 +1868,292 @@ void ospf_abr_task(struct ospf *ospf) {
 	if(IS_DEBUG_OSPF_EVENT) {
 		zlog_debug("ospf_abr_task(): remove unapproved summaries");
 	}
-	ospf_abr_remove_unapproved_summaries(ospf);
+	ospf_abr_remove_unapproved_summaries(ospf, 1);
 
 	ospf_abr_manage_discard_routes(ospf);
 
+	ospf_abr_state_save(ospf);
+	ospf->abr_resync = 0;
+
 	if(IS_DEBUG_OSPF_EVENT) {
 		zlog_debug("ospf_abr_task(): Stop");
 	}
 }
 
+/* A summary-LSA for prefix p in area, which nothing may announce anymore */
+struct ospf_abr_withdrawal {
+	struct prefix_ipv4 p;
+	struct ospf_area *area;
+};
+
+/* A range whose contributions changed, with the area it is of */
+struct ospf_abr_range_change {
+	struct ospf_area_range *range;
+	struct ospf_area *area;
+};
+
+static void ospf_abr_withdraw_later(struct list *withdrawals, struct prefix_ipv4 *p, struct ospf_area *area) {
+	struct ospf_abr_withdrawal *w;
+
+	w = XMALLOC(MTYPE_OSPF_TMP, sizeof(struct ospf_abr_withdrawal));
+	w->p = *p;
+	w->area = area;
+	listnode_add(withdrawals, w);
+}
+
+static void ospf_abr_range_changed(struct list *changes, struct ospf_area *area, struct ospf_area_range *range) {
+	struct ospf_abr_range_change *c;
+
+	if(CHECK_FLAG(range->flags, OSPF_AREA_RANGE_CHANGED)) {
+		return;
+	}
+	SET_FLAG(range->flags, OSPF_AREA_RANGE_CHANGED);
+
+	c = XMALLOC(MTYPE_OSPF_TMP, sizeof(struct ospf_abr_range_change));
+	c->range = range;
+	c->area = area;
+	listnode_add(changes, c);
+}
+
+/* What decides the announcements besides the routes: filters, area
+   ranges and such are configured, and their changes schedule the full
+   ABR task, but these go with adjacencies and SPF. */
+static u_char ospf_abr_area_state(struct ospf_area *area) {
+	return (ospf_area_is_transit(area) ? 1 : 0) | (CHECK_FLAG(area->stub_router_state, OSPF_AREA_IS_STUB_ROUTED) ? 2 : 0);
+}
+
+static void ospf_abr_state_save(struct ospf *ospf) {
+	struct listnode *node;
+	struct ospf_area *area;
+
+	for(ALL_LIST_ELEMENTS_RO(ospf->areas, node, area)) {
+		area->abr_state = ospf_abr_area_state(area);
+	}
+	ospf->abr_bb_connection = ospf_act_bb_connection(ospf) ? 1 : 0;
+}
+
+static int ospf_abr_state_changed(struct ospf *ospf) {
+	struct listnode *node;
+	struct ospf_area *area;
+
+	for(ALL_LIST_ELEMENTS_RO(ospf->areas, node, area)) {
+		if(area->abr_state != ospf_abr_area_state(area)) {
+			return 1;
+		}
+	}
+	return ospf->abr_bb_connection != (ospf_act_bb_connection(ospf) ? 1 : 0);
+}
+
+/* Does the ABR task, as it stands, announce p into area? */
+static int ospf_abr_summary_wanted(struct ospf *ospf, struct prefix_ipv4 *p, struct ospf_area *area) {
+	struct ospf_area_range *range;
+	struct ospf_area *or_area, *ar;
+	struct ospf_route * or ;
+	struct route_node *rn;
+	struct listnode *node;
+	struct prefix_ipv4 rp;
+
+	if((rn = route_node_lookup(ospf->new_table, (struct prefix *) p))) {
+		or = rn->info;
+		route_unlock_node(rn);
+		if(or && (or_area = ospf_abr_network_source(ospf, p, or)) && ospf_abr_network_announcement(p, or, or_area, area, &range) == OSPF_ABR_ANNOUNCE_DIRECT) {
+			return 1;
+		}
+	}
+
+	for(ALL_LIST_ELEMENTS_RO(ospf->areas, node, ar)) {
+		for(rn = route_top(ar->ranges); rn; rn = route_next(rn)) {
+			if(!(range = rn->info) || !range->specifics || !CHECK_FLAG(range->flags, OSPF_AREA_RANGE_ADVERTISE)) {
+				continue;
+			}
+			ospf_abr_range_prefix(range, &rp);
+			if(prefix_same((struct prefix *) &rp, (struct prefix *) p) && ospf_abr_range_announced_to(ar, area)) {
+				route_unlock_node(rn);
+				return 1;
+			}
+		}
+	}
+
+	/* see ospf_abr_announce_stub_defaults() */
+	return p->prefixlen == 0 && (area->external_routing == OSPF_AREA_STUB || area->external_routing == OSPF_AREA_NSSA) && !OSPF_IS_AREA_BACKBONE(area);
+}
+
+/* The cost of a range from its contributors, when the costliest went */
+static void ospf_abr_range_recount(struct ospf *ospf, struct ospf_area *range_area, struct ospf_area_range *range) {
+	struct ospf_area_range *match;
+	struct ospf_area *or_area, *area;
+	struct ospf_route * or ;
+	struct route_node *top, *rn;
+	struct listnode *node;
+	struct prefix_ipv4 p;
+
+	range->cost = 0;
+	range->specifics = 0;
+
+	p.family = AF_INET;
+	p.prefix = range->addr;
+	p.prefixlen = range->masklen;
+
+	top = route_node_get(ospf->new_table, (struct prefix *) &p);
+	for(rn = top; rn; rn = route_next_until(rn, top)) {
+		if(!(or = rn->info) || !(or_area = ospf_abr_network_source(ospf, (struct prefix_ipv4 *) &rn->p, or)) || or_area != range_area) {
+			continue;
+		}
+		for(ALL_LIST_ELEMENTS_RO(ospf->areas, node, area)) {
+			if(ospf_abr_network_announcement((struct prefix_ipv4 *) &rn->p, or, or_area, area, &match) == OSPF_ABR_ANNOUNCE_RANGE && match == range) {
+				ospf_abr_update_aggregate(range, or, area);
+			}
+		}
+	}
+}
+
+static int ospf_abr_route_same(struct ospf_route *old, struct ospf_route *new) {
+	return old->type == new->type && old->path_type == new->path_type && old->cost == new->cost && IPV4_ADDR_SAME(&old->u.std.area_id, &new->u.std.area_id) && ospf_route_paths_same(old, new);
+}
+
+/* Take back what the old route to p announced and announce the new one */
+static void ospf_abr_network_update(struct ospf *ospf, struct prefix_ipv4 *p, struct ospf_route *old, struct ospf_route *new, struct list *changes, struct list *withdrawals) {
+	struct ospf_area *old_area, *new_area, *area;
+	struct ospf_area_range *old_range, *new_range;
+	struct listnode *node;
+	int old_ann, new_ann;
+
+	old_area = old ? ospf_abr_network_source(ospf, p, old) : NULL;
+	new_area = new ? ospf_abr_network_source(ospf, p, new) : NULL;
+	if(!old_area && !new_area) {
+		return;
+	}
+
+	for(ALL_LIST_ELEMENTS_RO(ospf->areas, node, area)) {
+		old_ann = old_area ? ospf_abr_network_announcement(p, old, old_area, area, &old_range) : OSPF_ABR_ANNOUNCE_NONE;
+		new_ann = new_area ? ospf_abr_network_announcement(p, new, new_area, area, &new_range) : OSPF_ABR_ANNOUNCE_NONE;
+
+		if(old_ann == OSPF_ABR_ANNOUNCE_RANGE) {
+			old_range->specifics--;
+			if(old->cost >= old_range->cost) {
+				SET_FLAG(old_range->flags, OSPF_AREA_RANGE_RECOUNT);
+			}
+			ospf_abr_range_changed(changes, old_area, old_range);
+		}
+		if(new_ann == OSPF_ABR_ANNOUNCE_RANGE) {
+			ospf_abr_update_aggregate(new_range, new, area);
+			ospf_abr_range_changed(changes, new_area, new_range);
+		}
+
+		if(new_ann == OSPF_ABR_ANNOUNCE_DIRECT) {
+			ospf_abr_announce_network_to_area(p, new->cost, area);
+		} else if(old_ann == OSPF_ABR_ANNOUNCE_DIRECT) {
+			ospf_abr_withdraw_later(withdrawals, p, area);
+		}
+	}
+}
+
+/* ABR processing after an SPF run: the summary-LSAs and area ranges are
+   updated for the routes that changed since the last run alone, as long
+   as nothing else they depend on changed in between.  Otherwise, or
+   with no previous run to build on, it is the full ABR task. */
+void ospf_abr_spf_update(struct ospf *ospf) {
+	struct ospf_abr_range_change *c;
+	struct ospf_abr_withdrawal *w;
+	struct list *changes, *withdrawals;
+	struct route_node *rn, *orn;
+	struct listnode *node, *n;
+	struct ospf_lsa *lsa;
+	struct ospf_area *ar;
+	struct prefix_ipv4 p;
+	unsigned long updated = 0;
+
+	if(!IS_OSPF_ABR(ospf)) {
+		ospf->abr_resync = 1;
+		return;
+	}
+
+	if(ospf->abr_resync || OSPF_GR_RESTARTING_P(ospf) || !ospf->old_table || !ospf->new_table || !ospf->new_rtrs || ospf_abr_state_changed(ospf)) {
+		ospf_abr_task(ospf);
+		return;
+	}
+
+	changes = list_new();
+	withdrawals = list_new();
+
+	/* Routes added or changed, then gone */
+	for(rn = route_top(ospf->new_table); rn; rn = route_next(rn)) {
+		struct ospf_route *old = NULL;
+
+		if(!rn->info) {
+			continue;
+		}
+		if((orn = route_node_lookup(ospf->old_table, &rn->p))) {
+			old = orn->info;
+			route_unlock_node(orn);
+		}
+		if(old && ospf_abr_route_same(old, rn->info)) {
+			continue;
+		}
+		ospf_abr_network_update(ospf, (struct prefix_ipv4 *) &rn->p, old, rn->info, changes, withdrawals);
+		updated++;
+	}
+	for(rn = route_top(ospf->old_table); rn; rn = route_next(rn)) {
+		if(!rn->info) {
+			continue;
+		}
+		if((orn = route_node_lookup(ospf->new_table, &rn->p))) {
+			route_unlock_node(orn);
+			if(orn->info) {
+				continue;
+			}
+		}
+		ospf_abr_network_update(ospf, (struct prefix_ipv4 *) &rn->p, rn->info, NULL, changes, withdrawals);
+		updated++;
+	}
+
+	for(ALL_LIST_ELEMENTS_RO(changes, node, c)) {
+		if(CHECK_FLAG(c->range->flags, OSPF_AREA_RANGE_RECOUNT)) {
+			ospf_abr_range_recount(ospf, c->area, c->range);
+		}
+		UNSET_FLAG(c->range->flags, OSPF_AREA_RANGE_CHANGED | OSPF_AREA_RANGE_RECOUNT);
+
+		if(c->range->specifics) {
+			ospf_abr_announce_range(ospf, c->area, c->range);
+		} else if(CHECK_FLAG(c->range->flags, OSPF_AREA_RANGE_ADVERTISE)) {
+			ospf_abr_range_prefix(c->range, &p);
+			for(ALL_LIST_ELEMENTS_RO(ospf->areas, n, ar)) {
+				if(ospf_abr_range_announced_to(c->area, ar)) {
+					ospf_abr_withdraw_later(withdrawals, &p, ar);
+				}
+			}
+		}
+		XFREE(MTYPE_OSPF_TMP, c);
+	}
+	list_delete(changes);
+
+	for(ALL_LIST_ELEMENTS_RO(withdrawals, node, w)) {
+		if(!ospf_abr_summary_wanted(ospf, &w->p, w->area) && (lsa = ospf_lsa_lookup_by_prefix(w->area->lsdb, OSPF_SUMMARY_LSA, &w->p, ospf->router_id))) {
+			if(IS_DEBUG_OSPF_EVENT) {
+				zlog_debug("ospf_abr_spf_update(): flushing summary %s/%d from area %s", inet_ntoa(w->p.prefix), w->p.prefixlen, inet_ntoa(w->area->area_id));
+			}
+			ospf_lsa_flush_area(lsa, w->area);
+		}
+		XFREE(MTYPE_OSPF_TMP, w);
+	}
+	list_delete(withdrawals);
+
+	ospf_abr_announce_stub_defaults(ospf);
+
+	/* Routes to ASBRs are few, those are done in full */
+	ospf_abr_unapprove_summaries(ospf, 0);
+	ospf_abr_process_router_rt(ospf, ospf->new_rtrs);
+	ospf_abr_remove_unapproved_summaries(ospf, 0);
+
+	ospf_abr_manage_discard_routes(ospf);
+
+	ospf_abr_state_save(ospf);
+
+	if(IS_DEBUG_OSPF_EVENT) {
+		zlog_debug("ospf_abr_spf_update(): %lu routes changed", updated);
+	}
+}
+
 static int ospf_abr_task_timer(struct thread *thread) {
 	struct ospf *ospf = THREAD_ARG(thread);
 
@@ -1838,7 +2167,9 @@ static int ospf_abr_task_timer(struct thread *thread) {
 	ospf_abr_nssa_check_status(ospf);
 
 	ospf_abr_task(ospf);
-	ospf_abr_nssa_task(ospf); /* if nssa-abr, then scan Type-7 LSDB */
+	if(!OSPF_GR_RESTARTING_P(ospf)) {
+		ospf_abr_nssa_task(ospf); /* if nssa-abr, then scan Type-7 LSDB */
+	}
 
 	return 0;
 }
@@ -1848,6 +2179,9 @@ void ospf_schedule_abr_task(struct ospf *ospf) {
 		zlog_debug("Scheduling ABR task");
 	}
 
+	/* what changed is not in the routes alone */
+	ospf->abr_resync = 1;
+
 	if(ospf->t_abr_task == NULL) {
 		ospf->t_abr_task = thread_add_timer(master, ospf_abr_task_timer, ospf, OSPF_ABR_TASK_DELAY);
 	}
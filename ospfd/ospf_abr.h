@@ -27,6 +27,8 @@
 
 #define OSPF_AREA_RANGE_ADVERTISE (1 << 0)
 #define OSPF_AREA_RANGE_SUBSTITUTE (1 << 1)
+#define OSPF_AREA_RANGE_CHANGED (1 << 2) /* within ospf_abr_spf_update() */
+#define OSPF_AREA_RANGE_RECOUNT (1 << 3)
 
 /* Area range. */
 struct ospf_area_range {
@@ -72,6 +74,7 @@ extern int ospf_act_bb_connection(struct ospf *);
 
 extern void ospf_check_abr_status(struct ospf *);
 extern void ospf_abr_task(struct ospf *);
+extern void ospf_abr_spf_update(struct ospf *);
 extern void ospf_schedule_abr_task(struct ospf *);
 
 extern void ospf_abr_announce_network_to_area(struct prefix_ipv4 *, u_int32_t, struct ospf_area *);
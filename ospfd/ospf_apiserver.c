@@ -37,6 +37,8 @@
 #include "hash.h"
 #include "sockunion.h"		/* for inet_aton() */
 #include "buffer.h"
+#include "network.h"
+#include "jhash.h"
 
 #include <sys/types.h>
 
@@ -256,6 +258,150 @@ ospf_apiserver_del_lsa_hook (struct ospf_lsa *lsa)
 }
 
 /* Allocate new connection structure. */
+/* -----------------------------------------------------------
+ * Pending asynchronous notifications
+ * -----------------------------------------------------------
+ */
+
+/* A client that reads its notifications slower than they come would
+   otherwise have them pile up without bound in ospfd.  Those saying
+   how an LSA, interface or neighbor stands now supersede any still
+   queued about the same one, in its place in the fifo, so the backlog
+   is never larger than the state it describes, and once the client
+   catches up it has the latest of it. */
+struct apiserv_pending
+{
+  u_char msgtype;		/* update and delete share LSA_UPDATE */
+  u_char lsa_type;
+  u_char pad[2];
+  struct in_addr addr[4];
+  struct msg *msg;		/* in out_async_fifo */
+};
+
+/* What msg is about, or 0 if it stands on its own. */
+static int
+ospf_apiserver_msg_key (struct msg *msg, struct apiserv_pending *key)
+{
+  memset (key, 0, sizeof (struct apiserv_pending));
+
+  switch (msg->hdr.msgtype)
+    {
+    case MSG_LSA_UPDATE_NOTIFY:
+    case MSG_LSA_DELETE_NOTIFY:
+      {
+	struct msg_lsa_change_notify *cn =
+	  (struct msg_lsa_change_notify *) STREAM_DATA (msg->s);
+
+	key->msgtype = MSG_LSA_UPDATE_NOTIFY;
+	key->lsa_type = cn->data.type;
+	key->addr[0] = cn->ifaddr;
+	key->addr[1] = cn->area_id;
+	key->addr[2] = cn->data.id;
+	key->addr[3] = cn->data.adv_router;
+	return 1;
+      }
+    case MSG_ISM_CHANGE:
+      {
+	struct msg_ism_change *ism =
+	  (struct msg_ism_change *) STREAM_DATA (msg->s);
+
+	key->msgtype = MSG_ISM_CHANGE;
+	key->addr[0] = ism->ifaddr;
+	key->addr[1] = ism->area_id;
+	return 1;
+      }
+    case MSG_NSM_CHANGE:
+      {
+	struct msg_nsm_change *nsm =
+	  (struct msg_nsm_change *) STREAM_DATA (msg->s);
+
+	key->msgtype = MSG_NSM_CHANGE;
+	key->addr[0] = nsm->ifaddr;
+	key->addr[1] = nsm->nbraddr;
+	return 1;
+      }
+    default:
+      return 0;
+    }
+}
+
+static unsigned int
+ospf_apiserver_pending_key (void *data)
+{
+  struct apiserv_pending *pend = data;
+
+  return jhash2 ((u_int32_t *) pend, offsetof (struct apiserv_pending, msg)
+		 / sizeof (u_int32_t), 0);
+}
+
+static int
+ospf_apiserver_pending_cmp (const void *a, const void *b)
+{
+  return memcmp (a, b, offsetof (struct apiserv_pending, msg)) == 0;
+}
+
+static void *
+ospf_apiserver_pending_alloc (void *data)
+{
+  struct apiserv_pending *pend;
+
+  pend = XMALLOC (MTYPE_OSPF_APISERVER, sizeof (struct apiserv_pending));
+  *pend = *(struct apiserv_pending *) data;
+  pend->msg = NULL;
+  return pend;
+}
+
+static void
+ospf_apiserver_pending_free (void *data)
+{
+  XFREE (MTYPE_OSPF_APISERVER, data);
+}
+
+/* Queue msg, now the fifo's, on the async channel. */
+static void
+ospf_apiserver_queue_async (struct ospf_apiserver *apiserv, struct msg *msg)
+{
+  struct apiserv_pending key, *pend;
+
+  if (ospf_apiserver_msg_key (msg, &key))
+    {
+      pend = hash_get (apiserv->out_async_pending, &key,
+		       ospf_apiserver_pending_alloc);
+      if (pend->msg)
+	{
+	  stream_free (pend->msg->s);
+	  pend->msg->hdr = msg->hdr;
+	  pend->msg->s = msg->s;
+	  msg->s = NULL;
+	  msg_free (msg);
+	  apiserv->out_async_superseded++;
+	  return;
+	}
+      pend->msg = msg;
+    }
+
+  msg_fifo_push (apiserv->out_async_fifo, msg);
+  ospf_apiserver_event (OSPF_APISERVER_ASYNC_WRITE, apiserv->fd_async,
+			apiserv);
+}
+
+/* Take the next message off the async fifo. */
+static struct msg *
+ospf_apiserver_pop_async (struct ospf_apiserver *apiserv)
+{
+  struct apiserv_pending key, *pend;
+  struct msg *msg;
+
+  if ((msg = msg_fifo_pop (apiserv->out_async_fifo)) == NULL)
+    return NULL;
+
+  if (ospf_apiserver_msg_key (msg, &key)
+      && (pend = hash_release (apiserv->out_async_pending, &key)) != NULL)
+    ospf_apiserver_pending_free (pend);
+
+  return msg;
+}
+
 struct ospf_apiserver *
 ospf_apiserver_new (int fd_sync, int fd_async)
 {
@@ -280,6 +426,10 @@ ospf_apiserver_new (int fd_sync, int fd_async)
 
   new->out_sync_fifo = msg_fifo_new ();
   new->out_async_fifo = msg_fifo_new ();
+  new->out_async_pending = hash_create (ospf_apiserver_pending_key,
+					ospf_apiserver_pending_cmp);
+  new->out_async_superseded = 0;
+  new->out_async_wb = buffer_new (0);
   new->t_sync_read = NULL;
 #ifdef USE_ASYNC_READ
   new->t_async_read = NULL;
@@ -383,8 +533,11 @@ ospf_apiserver_free (struct ospf_apiserver *apiserv)
     }
 
   /* Free fifos */
+  hash_clean (apiserv->out_async_pending, ospf_apiserver_pending_free);
+  hash_free (apiserv->out_async_pending);
   msg_fifo_free (apiserv->out_sync_fifo);
   msg_fifo_free (apiserv->out_async_fifo);
+  buffer_free (apiserv->out_async_wb);
 
   /* Clear temporary strage for LSA instances to be refreshed. */
   ospf_lsdb_delete_all (&apiserv->reserve);
@@ -394,13 +547,17 @@ ospf_apiserver_free (struct ospf_apiserver *apiserv)
   listnode_delete (apiserver_list, apiserv);
 
   if (IS_DEBUG_OSPF_EVENT)
-    zlog_debug ("API: Delete apiserv(%p), total#(%d)",
-                (void *)apiserv, apiserver_list->count);
+    zlog_debug ("API: Delete apiserv(%p), total#(%d), %lu notifications superseded",
+                (void *)apiserv, apiserver_list->count,
+                apiserv->out_async_superseded);
 
   /* And free instance. */
   XFREE (MTYPE_OSPF_APISERVER, apiserv);
 }
 
+/* Most requests handled for one wakeup of the read thread. */
+#define OSPF_APISERVER_READ_BATCH 64
+
 int
 ospf_apiserver_read (struct thread *thread)
 {
@@ -408,6 +565,7 @@ ospf_apiserver_read (struct thread *thread)
   struct msg *msg;
   int fd;
   int rc = -1;
+  int n, avail;
   enum event event;
 
   apiserv = THREAD_ARG (thread);
@@ -442,37 +600,50 @@ ospf_apiserver_read (struct thread *thread)
       goto out;
     }
 
-  /* Read message from fd. */
-  msg = msg_read (fd);
-  if (msg == NULL)
+  /* A client may pipeline its requests: handle those already in, up
+     to a batch, before going back to the event loop. */
+  for (n = 0; n < OSPF_APISERVER_READ_BATCH; n++)
     {
-      zlog_warn
-	("ospf_apiserver_read: read failed on fd=%d, closing connection", fd);
+      if (n > 0 && (ioctl (fd, FIONREAD, &avail) < 0
+		    || avail < (int) sizeof (struct apimsghdr)))
+	break;
 
-      /* Perform cleanup. */
-      ospf_apiserver_free (apiserv);
-      goto out;
-    }
+      /* Read message from fd. */
+      msg = msg_read (fd);
+      if (msg == NULL)
+	{
+	  zlog_warn
+	    ("ospf_apiserver_read: read failed on fd=%d, closing connection", fd);
 
-  if (IS_DEBUG_OSPF_EVENT)
-    msg_print (msg);
+	  /* Perform cleanup. */
+	  ospf_apiserver_free (apiserv);
+	  return -1;
+	}
+
+      if (IS_DEBUG_OSPF_EVENT)
+	msg_print (msg);
 
-  /* Dispatch to corresponding message handler. */
-  rc = ospf_apiserver_handle_msg (apiserv, msg);
+      /* Dispatch to corresponding message handler. */
+      rc = ospf_apiserver_handle_msg (apiserv, msg);
+
+      msg_free (msg);
+    }
 
   /* Prepare for next message, add read thread. */
   ospf_apiserver_event (event, fd, apiserv);
 
-  msg_free (msg);
-
 out:
   return rc;
 }
 
+/* Most to put together from the fifo for one write. */
+#define OSPF_APISERVER_WRITE_CHUNK 65536
+
 int
 ospf_apiserver_sync_write (struct thread *thread)
 {
   struct ospf_apiserver *apiserv;
+  struct buffer *wb;
   struct msg *msg;
   int fd;
   int rc = -1;
@@ -496,20 +667,29 @@ ospf_apiserver_sync_write (struct thread *thread)
                 ntohs (apiserv->peer_sync.sin_port));
 
   /* Check whether there is really a message in the fifo. */
-  msg = msg_fifo_pop (apiserv->out_sync_fifo);
-  if (!msg)
+  if (!msg_fifo_head (apiserv->out_sync_fifo))
     {
       zlog_warn ("API: ospf_apiserver_sync_write: No message in Sync-FIFO?");
       return 0;
     }
 
-  if (IS_DEBUG_OSPF_EVENT)
-    msg_print (msg);
+  /* The replies to a pipelined batch of requests go out in one write. */
+  wb = buffer_new (0);
+  while (buffer_pending (wb) < OSPF_APISERVER_WRITE_CHUNK
+	 && (msg = msg_fifo_pop (apiserv->out_sync_fifo)) != NULL)
+    {
+      if (IS_DEBUG_OSPF_EVENT)
+	msg_print (msg);
 
-  rc = msg_write (fd, msg);
+      buffer_put (wb, &msg->hdr, sizeof (struct apimsghdr));
+      buffer_put (wb, STREAM_DATA (msg->s), ntohs (msg->hdr.msglen));
 
-  /* Once a message is dequeued, it should be freed anyway. */
-  msg_free (msg);
+      /* Once a message is dequeued, it should be freed anyway. */
+      msg_free (msg);
+    }
+
+  rc = (buffer_flush_all (wb, fd) == BUFFER_ERROR) ? -1 : 0;
+  buffer_free (wb);
 
   if (rc < 0)
     {
@@ -537,14 +717,12 @@ ospf_apiserver_sync_write (struct thread *thread)
   return rc;
 }
 
-
 int
 ospf_apiserver_async_write (struct thread *thread)
 {
   struct ospf_apiserver *apiserv;
   struct msg *msg;
   int fd;
-  int rc = -1;
 
   apiserv = THREAD_ARG (thread);
   assert (apiserv);
@@ -556,7 +734,8 @@ ospf_apiserver_async_write (struct thread *thread)
   if (fd != apiserv->fd_async)
     {
       zlog_warn ("ospf_apiserver_async_write: Unknown fd=%d", fd);
-      goto out;
+      ospf_apiserver_free (apiserv);
+      return -1;
     }
 
   if (IS_DEBUG_OSPF_EVENT)
@@ -564,46 +743,40 @@ ospf_apiserver_async_write (struct thread *thread)
                 inet_ntoa (apiserv->peer_async.sin_addr),
                 ntohs (apiserv->peer_async.sin_port));
 
-  /* Check whether there is really a message in the fifo. */
-  msg = msg_fifo_pop (apiserv->out_async_fifo);
-  if (!msg)
+  /* Messages go out many to a write, and the socket doesn't block: a
+     client that doesn't read holds up only itself. */
+  while (buffer_pending (apiserv->out_async_wb) < OSPF_APISERVER_WRITE_CHUNK
+	 && (msg = ospf_apiserver_pop_async (apiserv)) != NULL)
     {
-      zlog_warn ("API: ospf_apiserver_async_write: No message in Async-FIFO?");
-      return 0;
-    }
-
-  if (IS_DEBUG_OSPF_EVENT)
-    msg_print (msg);
-
-  rc = msg_write (fd, msg);
+      if (IS_DEBUG_OSPF_EVENT)
+	msg_print (msg);
 
-  /* Once a message is dequeued, it should be freed anyway. */
-  msg_free (msg);
+      buffer_put (apiserv->out_async_wb, &msg->hdr, sizeof (struct apimsghdr));
+      buffer_put (apiserv->out_async_wb, STREAM_DATA (msg->s),
+		  ntohs (msg->hdr.msglen));
+      msg_free (msg);
+    }
 
-  if (rc < 0)
+  switch (buffer_flush_available (apiserv->out_async_wb, fd))
     {
+    case BUFFER_ERROR:
       zlog_warn
         ("ospf_apiserver_async_write: write failed on fd=%d", fd);
-      goto out;
-    }
-
 
-  /* If more messages are in async message fifo, schedule write thread. */
-  if (msg_fifo_head (apiserv->out_async_fifo))
-    {
-      ospf_apiserver_event (OSPF_APISERVER_ASYNC_WRITE, apiserv->fd_async,
-                            apiserv);
-    }
-
- out:
-
-  if (rc < 0)
-    {
       /* Perform cleanup and disconnect with peer */
       ospf_apiserver_free (apiserv);
+      return -1;
+    case BUFFER_PENDING:
+      ospf_apiserver_event (OSPF_APISERVER_ASYNC_WRITE, fd, apiserv);
+      break;
+    case BUFFER_EMPTY:
+      /* If more messages are in async message fifo, schedule write thread. */
+      if (msg_fifo_head (apiserv->out_async_fifo))
+	ospf_apiserver_event (OSPF_APISERVER_ASYNC_WRITE, fd, apiserv);
+      break;
     }
 
-  return rc;
+  return 0;
 }
 
 
@@ -738,6 +911,9 @@ ospf_apiserver_accept (struct thread *thread)
       close (new_async_sock);
       return -1;
     }
+
+  /* Written to from the fifo as the client takes it. */
+  set_nonblocking (new_async_sock);
 #endif /* USE_ASYNC_READ */
 
   /* Allocate new server-side connection structure */
@@ -789,10 +965,8 @@ ospf_apiserver_send_msg (struct ospf_apiserver *apiserv, struct msg *msg)
     case MSG_DEL_IF:
     case MSG_ISM_CHANGE:
     case MSG_NSM_CHANGE:
-      fifo = apiserv->out_async_fifo;
-      fd = apiserv->fd_async;
-      event = OSPF_APISERVER_ASYNC_WRITE;
-      break;
+      ospf_apiserver_queue_async (apiserv, msg_dup (msg));
+      return 0;
     default:
       zlog_warn ("ospf_apiserver_send_msg: Unknown message type %d",
 		 msg->hdr.msgtype);
@@ -1324,8 +1498,7 @@ apiserver_sync_callback (struct ospf_lsa *lsa, void *p_arg, int int_arg)
 	}
 
       /* Send LSA */
-      ospf_apiserver_send_msg (apiserv, msg);
-      msg_free (msg);
+      ospf_apiserver_queue_async (apiserv, msg);
     }
   rc = 0;
 
@@ -59,6 +59,14 @@ struct ospf_apiserver {
 	struct msg_fifo *out_sync_fifo;
 	struct msg_fifo *out_async_fifo;
 
+	/* Notifications in out_async_fifo by the LSA, interface or neighbor
+	   they are about, see ospf_apiserver_queue_async() */
+	struct hash *out_async_pending;
+	unsigned long out_async_superseded;
+
+	/* What the non-blocking async socket hasn't taken yet */
+	struct buffer *out_async_wb;
+
 	/* Read and write threads */
 	struct thread *t_sync_read;
 #ifdef USE_ASYNC_READ
@@ -242,6 +242,11 @@ void ospf_redistribute_withdraw(struct ospf *ospf, u_char type) {
 					}
 					ospf_external_lsa_flush(ospf, type, &ei->p, ei->ifindex /*, ei->nexthop */);
 
+					/* Still in use by another instance. */
+					if(ospf_is_type_redistributed(NULL, type)) {
+						continue;
+					}
+
 					ospf_external_info_free(ei);
 					route_unlock_node(rn);
 					rn->info = NULL;
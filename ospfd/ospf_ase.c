@@ -543,75 +543,15 @@ ospf_ase_calculate_route (struct ospf *ospf, struct ospf_lsa * lsa)
   return 0;
 }
 
-static int
-ospf_ase_route_match_same (struct route_table *rt, struct prefix *prefix,
-			   struct ospf_route *newor)
-{
-  struct route_node *rn;
-  struct ospf_route *or;
-  struct ospf_path *op;
-  struct ospf_path *newop;
-  struct listnode *n1;
-  struct listnode *n2;
-
-  if (! rt || ! prefix)
-    return 0;
-
-   rn = route_node_lookup (rt, prefix);
-   if (! rn)
-     return 0;
- 
-   route_unlock_node (rn);
-
-   or = rn->info;
-   if (or->path_type != newor->path_type)
-     return 0;
-
-   switch (or->path_type)
-     {
-     case OSPF_PATH_TYPE1_EXTERNAL:
-       if (or->cost != newor->cost)
-	 return 0;
-       break;
-     case OSPF_PATH_TYPE2_EXTERNAL:
-       if ((or->cost != newor->cost) ||
-	   (or->u.ext.type2_cost != newor->u.ext.type2_cost))
-	 return 0;
-       break;
-     default:
-       assert (0);
-       return 0;
-     }
-   
-   if (or->paths->count != newor->paths->count)
-     return 0;
-       
-   /* Check each path. */
-   for (n1 = listhead (or->paths), n2 = listhead (newor->paths);
-	n1 && n2; n1 = listnextnode (n1), n2 = listnextnode (n2))
-     { 
-       op = listgetdata (n1);
-       newop = listgetdata (n2);
-       
-       if (! IPV4_ADDR_SAME (&op->nexthop, &newop->nexthop))
-	 return 0;
-       if (op->ifindex != newop->ifindex)
-	 return 0;
-     }
-
-   if (or->u.ext.tag != newor->u.ext.tag)
-     return 0;
-
-   return 1;
-}
-
 static int
 ospf_ase_compare_tables (struct route_table *new_external_route,
 			 struct route_table *old_external_route)
 {
   struct route_node *rn, *new_rn;
   struct ospf_route *or;
-  
+
+  ospf_zebra_batch_start ();
+
   /* Remove deleted routes */
   for (rn = route_top (old_external_route); rn; rn = route_next (rn))
     if ((or = rn->info))
@@ -623,12 +563,15 @@ ospf_ase_compare_tables (struct route_table *new_external_route,
       }
   
 	
-  /* Install new routes */
+  /* Install new routes, those zebra already has as they are aside */
   for (rn = route_top (new_external_route); rn; rn = route_next (rn))
     if ((or = rn->info) != NULL)
-      if (! ospf_ase_route_match_same (old_external_route, &rn->p, or))
+      if (! ospf_route_match_installed (old_external_route,
+					(struct prefix_ipv4 *) &rn->p, or))
 	ospf_zebra_add ((struct prefix_ipv4 *) &rn->p, or);
-				       
+
+  ospf_zebra_batch_end ();
+
   return 0;
 }
 
@@ -682,6 +625,7 @@ ospf_ase_calculate_timer (struct thread *t)
       ospf->new_external_route = route_table_init ();
 
       quagga_gettime(QUAGGA_CLK_MONOTONIC, &stop_time);
+      ospf_spf_log_ase (ospf, timeval_elapsed (stop_time, start_time));
 
       zlog_info ("SPF Processing Time(usecs): External Routes: %lld\n",
 		 (stop_time.tv_sec - start_time.tv_sec)*1000000LL+
@@ -733,6 +677,9 @@ ospf_ase_register_external_lsa (struct ospf_lsa *lsa, struct ospf *top)
   /* We assume that if LSA is deleted from DB
      is is also deleted from this RT */
   listnode_add (lst, ospf_lsa_lock (lsa)); /* external_lsas lst */
+
+  if (al->e[0].fwd_addr.s_addr != 0)
+    top->ase_fwd_count++;
 }
 
 void
@@ -753,6 +700,8 @@ ospf_ase_unregister_external_lsa (struct ospf_lsa *lsa, struct ospf *top)
 
   if (rn) {
     lst = rn->info;
+    if (al->e[0].fwd_addr.s_addr != 0 && listnode_lookup (lst, lsa))
+      top->ase_fwd_count--;
     listnode_delete (lst, lsa);
     ospf_lsa_unlock (&lsa); /* external_lsas list */
     route_unlock_node (rn);
@@ -778,21 +727,41 @@ ospf_ase_external_lsas_finish (struct route_table *rt)
   route_table_finish (rt);
 }
 
+/* Withdraw the external route to p, if there is one, for an
+   intra-area or inter-area route now overriding it. */
+static void
+ospf_ase_prefix_withdraw (struct ospf *ospf, struct prefix_ipv4 *p)
+{
+  struct route_node *rn;
+
+  if (! ospf->old_external_route)
+    return;
+
+  rn = route_node_lookup (ospf->old_external_route, (struct prefix *) p);
+  if (rn == NULL)
+    return;
+  route_unlock_node (rn);
+
+  if (rn->info)
+    {
+      ospf_zebra_delete (p, rn->info);
+      ospf_route_free (rn->info);
+      rn->info = NULL;
+      route_unlock_node (rn);
+    }
+}
+
+/* Calculate again the external route to p, from the AS-external-LSAs
+   for it, and install the difference into zebra.  An intra-area or
+   inter-area route to p, if there is one now, withdraws it. */
 void
-ospf_ase_incremental_update (struct ospf *ospf, struct ospf_lsa *lsa)
+ospf_ase_prefix_update (struct ospf *ospf, struct prefix_ipv4 *p)
 {
   struct list *lsas;
   struct listnode *node;
   struct route_node *rn, *rn2;
-  struct prefix_ipv4 p;
   struct route_table *tmp_old;
-  struct as_external_lsa *al;
-
-  al = (struct as_external_lsa *) lsa->data;
-  p.family = AF_INET;
-  p.prefix = lsa->data->id;
-  p.prefixlen = ip_masklen (al->mask);
-  apply_mask_ipv4 (&p);
+  struct ospf_lsa *lsa;
 
   /* if new_table is NULL, there was no spf calculation, thus
      incremental update is unneeded */
@@ -803,17 +772,20 @@ ospf_ase_incremental_update (struct ospf *ospf, struct ospf_lsa *lsa)
      to the destination, no recalculation is necessary
      (internal routes take precedence). */
   
-  rn = route_node_lookup (ospf->new_table, (struct prefix *) &p);
+  rn = route_node_lookup (ospf->new_table, (struct prefix *) p);
   if (rn)
     {
       route_unlock_node (rn);
       if (rn->info)
-	return;
+	{
+	  ospf_ase_prefix_withdraw (ospf, p);
+	  return;
+	}
     }
 
-  rn = route_node_lookup (ospf->external_lsas, (struct prefix *) &p);
-  assert (rn); 
-  assert (rn->info);
+  rn = route_node_lookup (ospf->external_lsas, (struct prefix *) p);
+  if (rn == NULL)
+    return;
   lsas = rn->info;
   route_unlock_node (rn);
 
@@ -822,10 +794,10 @@ ospf_ase_incremental_update (struct ospf *ospf, struct ospf_lsa *lsa)
 
   /* prepare temporary old routing table for compare */
   tmp_old = route_table_init ();
-  rn = route_node_lookup (ospf->old_external_route, (struct prefix *) &p);
+  rn = route_node_lookup (ospf->old_external_route, (struct prefix *) p);
   if (rn && rn->info)
     {
-      rn2 = route_node_get (tmp_old, (struct prefix *) &p);
+      rn2 = route_node_get (tmp_old, (struct prefix *) p);
       rn2->info = rn->info;
       route_unlock_node (rn);
     }
@@ -837,12 +809,12 @@ ospf_ase_incremental_update (struct ospf *ospf, struct ospf_lsa *lsa)
   if (rn && rn->info)
     ospf_route_free ((struct ospf_route *) rn->info);
 
-  rn2 = route_node_lookup (ospf->new_external_route, (struct prefix *) &p);
+  rn2 = route_node_lookup (ospf->new_external_route, (struct prefix *) p);
   /* if new route exists, install it to ospf->old_external_route */
   if (rn2 && rn2->info)
     {
       if (!rn)
-	rn = route_node_get (ospf->old_external_route, (struct prefix *) &p);
+	rn = route_node_get (ospf->old_external_route, (struct prefix *) p);
       rn->info = rn2->info;
     }
   else
@@ -865,3 +837,164 @@ ospf_ase_incremental_update (struct ospf *ospf, struct ospf_lsa *lsa)
 
   route_table_finish (tmp_old);
 }
+
+void
+ospf_ase_incremental_update (struct ospf *ospf, struct ospf_lsa *lsa)
+{
+  struct prefix_ipv4 p;
+  struct as_external_lsa *al;
+
+  al = (struct as_external_lsa *) lsa->data;
+  p.family = AF_INET;
+  p.prefix = lsa->data->id;
+  p.prefixlen = ip_masklen (al->mask);
+  apply_mask_ipv4 (&p);
+
+  ospf_ase_prefix_update (ospf, &p);
+}
+
+/* What the external routes take from the route to their ASBR, RFC2328
+   16.4 (3) to (6): return 1 if it is the same through both routes. */
+int
+ospf_ase_asbr_route_same (struct ospf_route *or1, struct ospf_route *or2)
+{
+  /* either way, not a route to use */
+  if (or1 && !(or1->u.std.flags & ROUTER_LSA_EXTERNAL))
+    or1 = NULL;
+  if (or2 && !(or2->u.std.flags & ROUTER_LSA_EXTERNAL))
+    or2 = NULL;
+
+  if (or1 == NULL || or2 == NULL)
+    return or1 == or2;
+
+  if (or1->path_type != or2->path_type
+      || ! IPV4_ADDR_SAME (&or1->u.std.area_id, &or2->u.std.area_id))
+    return 0;
+
+  return or1->cost == or2->cost && ospf_route_paths_same (or1, or2);
+}
+
+/* Return 1 if no best route to an ASBR differs between the two
+   router routing tables. */
+static int
+ospf_ase_rtrs_same (struct ospf *ospf, struct route_table *old_rtrs,
+		    struct route_table *new_rtrs)
+{
+  struct route_node *rn;
+  struct ospf_route *old_or, *new_or;
+
+  for (rn = route_top (new_rtrs); rn; rn = route_next (rn))
+    if (rn->info)
+      {
+	new_or = ospf_find_asbr_route (ospf, new_rtrs,
+				       (struct prefix_ipv4 *) &rn->p);
+	old_or = ospf_find_asbr_route (ospf, old_rtrs,
+				       (struct prefix_ipv4 *) &rn->p);
+	if (! ospf_ase_asbr_route_same (old_or, new_or))
+	  {
+	    route_unlock_node (rn);
+	    return 0;
+	  }
+      }
+
+  for (rn = route_top (old_rtrs); rn; rn = route_next (rn))
+    if (rn->info)
+      {
+	old_or = ospf_find_asbr_route (ospf, old_rtrs,
+				       (struct prefix_ipv4 *) &rn->p);
+	new_or = ospf_find_asbr_route (ospf, new_rtrs,
+				       (struct prefix_ipv4 *) &rn->p);
+	if (new_or == NULL && ! ospf_ase_asbr_route_same (old_or, NULL))
+	  {
+	    route_unlock_node (rn);
+	    return 0;
+	  }
+      }
+
+  return 1;
+}
+
+/* Return 1 if the two network routing tables hold the same routes. */
+static int
+ospf_ase_tables_same (struct route_table *old_table,
+		      struct route_table *new_table)
+{
+  struct route_node *rn;
+
+  for (rn = route_top (new_table); rn; rn = route_next (rn))
+    if (rn->info
+	&& ! ospf_route_match_same (old_table, (struct prefix_ipv4 *) &rn->p,
+				    rn->info))
+      {
+	route_unlock_node (rn);
+	return 0;
+      }
+
+  for (rn = route_top (old_table); rn; rn = route_next (rn))
+    if (rn->info
+	&& ! ospf_route_match_same (new_table, (struct prefix_ipv4 *) &rn->p,
+				    rn->info))
+      {
+	route_unlock_node (rn);
+	return 0;
+      }
+
+  return 1;
+}
+
+/* After an SPF calculation, calculate again the external routes it
+   can have changed, RFC2328 16.6, instead of all of them: as long as
+   the routes to the ASBRs stay the same, only those to destinations
+   which lost their intra-area or inter-area route.  Those gaining one
+   had the external route withdrawn as the routes were installed.
+
+   Forwarding addresses, and the NSSA translation of type-7 LSAs, make
+   external routes depend on more than that; those cases schedule the
+   whole calculation. */
+void
+ospf_ase_spf_update (struct ospf *ospf)
+{
+  struct route_node *rn, *new_rn;
+
+  if (ospf->ase_calc)
+    return;
+
+  if (ospf->old_rtrs == NULL || ospf->old_table == NULL || ospf->anyNSSA
+      || ! ospf_ase_rtrs_same (ospf, ospf->old_rtrs, ospf->new_rtrs)
+      || (ospf->ase_fwd_count
+	  && ! ospf_ase_tables_same (ospf->old_table, ospf->new_table)))
+    {
+      ospf_ase_calculate_schedule (ospf);
+      return;
+    }
+
+  for (rn = route_top (ospf->old_table); rn; rn = route_next (rn))
+    if (rn->info)
+      {
+	if ((new_rn = route_node_lookup (ospf->new_table, &rn->p)))
+	  {
+	    route_unlock_node (new_rn);
+	    if (new_rn->info)
+	      continue;
+	  }
+	ospf_ase_prefix_update (ospf, (struct prefix_ipv4 *) &rn->p);
+      }
+}
+
+/* The best route to the ASBR asbr changed: calculate again the
+   external routes through it alone. */
+void
+ospf_ase_asbr_update (struct ospf *ospf, struct in_addr asbr)
+{
+  struct route_node *rn;
+  struct ospf_lsa *lsa;
+
+  /* the whole calculation is due anyway */
+  if (ospf->ase_calc)
+    return;
+
+  /* type-7 LSAs are not reached through ASBR-summary-LSAs */
+  LSDB_LOOP (EXTERNAL_LSDB (ospf), rn, lsa)
+    if (IPV4_ADDR_SAME (&lsa->data->adv_router, &asbr))
+      ospf_ase_incremental_update (ospf, lsa);
+}
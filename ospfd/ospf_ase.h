@@ -32,6 +32,10 @@ extern void ospf_ase_calculate_timer_add(struct ospf *);
 
 extern void ospf_ase_external_lsas_finish(struct route_table *);
 extern void ospf_ase_incremental_update(struct ospf *, struct ospf_lsa *);
+extern void ospf_ase_prefix_update(struct ospf *, struct prefix_ipv4 *);
+extern void ospf_ase_asbr_update(struct ospf *, struct in_addr);
+extern void ospf_ase_spf_update(struct ospf *);
+extern int ospf_ase_asbr_route_same(struct ospf_route *, struct ospf_route *);
 extern void ospf_ase_register_external_lsa(struct ospf_lsa *, struct ospf *);
 extern void ospf_ase_unregister_external_lsa(struct ospf_lsa *, struct ospf *);
 
@@ -0,0 +1,182 @@
+/*
+ * OSPF neighbours watched by BFD sessions run in zebra
+ *
+ * This file is part of GNU Zebra.
+ *
+ * GNU Zebra is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2, or (at your option) any
+ * later version.
+ *
+ * GNU Zebra is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with GNU Zebra; see the file COPYING.  If not, write to the Free
+ * Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ * 02111-1307, USA.
+ */
+
+#include <zebra.h>
+
+#include "linklist.h"
+#include "prefix.h"
+#include "if.h"
+#include "table.h"
+#include "thread.h"
+#include "stream.h"
+#include "log.h"
+#include "zclient.h"
+
+#include "ospfd/ospfd.h"
+#include "ospfd/ospf_interface.h"
+#include "ospfd/ospf_asbr.h"
+#include "ospfd/ospf_lsa.h"
+#include "ospfd/ospf_lsdb.h"
+#include "ospfd/ospf_neighbor.h"
+#include "ospfd/ospf_nsm.h"
+#include "ospfd/ospf_dump.h"
+#include "ospfd/ospf_bfd.h"
+
+static void ospf_bfd_zapi(struct ospf_neighbor *nbr, struct zapi_bfd *bfd) {
+	struct ospf_interface *oi = nbr->oi;
+
+	memset(bfd, 0, sizeof(struct zapi_bfd));
+	bfd->dst.family = AF_INET;
+	bfd->dst.prefixlen = IPV4_MAX_BITLEN;
+	bfd->dst.u.prefix4 = nbr->src;
+	bfd->src.family = AF_INET;
+	bfd->src.prefixlen = IPV4_MAX_BITLEN;
+	bfd->src.u.prefix4 = oi->address->u.prefix4;
+	bfd->ifindex = oi->ifp->ifindex;
+	bfd->min_rx = ZEBRA_BFD_MIN_RX_DEFAULT;
+	bfd->min_tx = ZEBRA_BFD_MIN_TX_DEFAULT;
+	bfd->detect_mult = ZEBRA_BFD_DETECT_MULT_DEFAULT;
+}
+
+/* Whether the neighbour should have a session */
+static int ospf_bfd_wanted(struct ospf_neighbor *nbr) {
+	struct ospf_interface *oi = nbr->oi;
+
+	return nbr != oi->nbr_self && oi->type != OSPF_IFTYPE_VIRTUALLINK && oi->address && OSPF_IF_PARAM(oi, bfd) && nbr->state >= NSM_TwoWay;
+}
+
+static void ospf_bfd_nbr_register(struct ospf_neighbor *nbr) {
+	struct zapi_bfd bfd;
+
+	if(nbr->bfd || !ospf_bfd_wanted(nbr)) {
+		return;
+	}
+	ospf_bfd_zapi(nbr, &bfd);
+	if(zebra_bfd_send(zclient, ZEBRA_BFD_DEST_REGISTER, &bfd) < 0) {
+		return;
+	}
+	nbr->bfd = 1;
+	if(IS_DEBUG_OSPF_EVENT) {
+		zlog_debug("BFD: session registered for neighbor %s on %s", inet_ntoa(nbr->src), IF_NAME(nbr->oi));
+	}
+}
+
+void ospf_bfd_nbr_deregister(struct ospf_neighbor *nbr) {
+	struct zapi_bfd bfd;
+
+	if(!nbr->bfd) {
+		return;
+	}
+	nbr->bfd = 0;
+	if(!nbr->oi->address) {
+		return;
+	}
+	ospf_bfd_zapi(nbr, &bfd);
+	zebra_bfd_send(zclient, ZEBRA_BFD_DEST_DEREGISTER, &bfd);
+}
+
+void ospf_bfd_nbr_change(struct ospf_neighbor *nbr, u_char old_state) {
+	if(old_state < NSM_TwoWay && nbr->state >= NSM_TwoWay) {
+		ospf_bfd_nbr_register(nbr);
+	} else if(old_state >= NSM_TwoWay && nbr->state < NSM_TwoWay) {
+		ospf_bfd_nbr_deregister(nbr);
+	}
+}
+
+static void ospf_bfd_oi_update(struct ospf_interface *oi) {
+	struct route_node *rn;
+	struct ospf_neighbor *nbr;
+
+	for(rn = route_top(oi->nbrs); rn; rn = route_next(rn)) {
+		if((nbr = rn->info) == NULL) {
+			continue;
+		}
+		if(ospf_bfd_wanted(nbr)) {
+			ospf_bfd_nbr_register(nbr);
+		} else {
+			ospf_bfd_nbr_deregister(nbr);
+		}
+	}
+}
+
+void ospf_bfd_if_update(struct interface *ifp) {
+	struct listnode *node, *inode;
+	struct ospf *ospf;
+	struct ospf_interface *oi;
+
+	for(ALL_LIST_ELEMENTS_RO(om->ospf, node, ospf)) {
+		for(ALL_LIST_ELEMENTS_RO(ospf->oiflist, inode, oi)) {
+			if(oi->ifp == ifp) {
+				ospf_bfd_oi_update(oi);
+			}
+		}
+	}
+}
+
+void ospf_bfd_register_all(void) {
+	struct listnode *node, *inode;
+	struct ospf *ospf;
+	struct ospf_interface *oi;
+	struct route_node *rn;
+	struct ospf_neighbor *nbr;
+
+	for(ALL_LIST_ELEMENTS_RO(om->ospf, node, ospf)) {
+		for(ALL_LIST_ELEMENTS_RO(ospf->oiflist, inode, oi)) {
+			for(rn = route_top(oi->nbrs); rn; rn = route_next(rn)) {
+				if((nbr = rn->info) != NULL) {
+					nbr->bfd = 0;
+				}
+			}
+			ospf_bfd_oi_update(oi);
+		}
+	}
+}
+
+int ospf_bfd_update(int command, struct zclient *zclient, zebra_size_t length, vrf_id_t vrf_id) {
+	struct zapi_bfd bfd;
+	struct listnode *node, *inode;
+	struct ospf *ospf;
+	struct ospf_interface *oi;
+	struct route_node *rn;
+	struct ospf_neighbor *nbr;
+
+	if(zapi_bfd_decode(zclient->ibuf, &bfd) < 0 || bfd.state != ZEBRA_BFD_DOWN || bfd.dst.family != AF_INET) {
+		return 0;
+	}
+
+	for(ALL_LIST_ELEMENTS_RO(om->ospf, node, ospf)) {
+		for(ALL_LIST_ELEMENTS_RO(ospf->oiflist, inode, oi)) {
+			if(!oi->address || !IPV4_ADDR_SAME(&oi->address->u.prefix4, &bfd.src.u.prefix4)) {
+				continue;
+			}
+			for(rn = route_top(oi->nbrs); rn; rn = route_next(rn)) {
+				if((nbr = rn->info) == NULL || !nbr->bfd || !IPV4_ADDR_SAME(&nbr->src, &bfd.dst.u.prefix4)) {
+					continue;
+				}
+				zlog_info("BFD: session to neighbor %s on %s went down", inet_ntoa(nbr->router_id), IF_NAME(oi));
+				route_unlock_node(rn);
+				OSPF_NSM_EVENT_EXECUTE(nbr, NSM_KillNbr);
+				break;
+			}
+		}
+	}
+	return 0;
+}
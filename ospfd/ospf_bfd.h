@@ -0,0 +1,40 @@
+/*
+ * OSPF neighbours watched by BFD sessions run in zebra
+ *
+ * This file is part of GNU Zebra.
+ *
+ * GNU Zebra is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2, or (at your option) any
+ * later version.
+ *
+ * GNU Zebra is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with GNU Zebra; see the file COPYING.  If not, write to the Free
+ * Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ * 02111-1307, USA.
+ */
+
+#ifndef _ZEBRA_OSPF_BFD_H
+#define _ZEBRA_OSPF_BFD_H
+
+/* On an interface with "ip ospf bfd", each neighbour in TwoWay or above
+ * has a session from the interface address to its own, and the session
+ * going down kills the neighbour without waiting for the dead interval.
+ * Virtual links are not single-hop, and have none. */
+struct zclient;
+
+/* For the neighbour's state changed from old_state */
+extern void ospf_bfd_nbr_change(struct ospf_neighbor *, u_char old_state);
+extern void ospf_bfd_nbr_deregister(struct ospf_neighbor *);
+/* For "ip ospf bfd" set or unset on the interface */
+extern void ospf_bfd_if_update(struct interface *);
+/* For zebra connected again, which knows of no session then */
+extern void ospf_bfd_register_all(void);
+extern int ospf_bfd_update(int, struct zclient *, zebra_size_t, vrf_id_t);
+
+#endif /* _ZEBRA_OSPF_BFD_H */
@@ -31,6 +31,8 @@
 #include "memory.h"
 #include "log.h"
 #include "zclient.h"
+#include "hash.h"
+#include "jhash.h"
 
 #include "ospfd/ospfd.h"
 #include "ospfd/ospf_interface.h"
@@ -47,6 +49,7 @@
 #include "ospfd/ospf_route.h"
 #include "ospfd/ospf_zebra.h"
 #include "ospfd/ospf_dump.h"
+#include "ospfd/ospf_gr.h"
 
 extern struct zclient *zclient;
 
@@ -74,8 +77,8 @@ static void ospf_flood_delayed_lsa_ack(struct ospf_neighbor *inbr, struct ospf_l
 	listnode_add(inbr->oi->ls_ack, ospf_lsa_lock(lsa)); /* delayed LSA Ack */
 }
 
-/* Check LSA is related to external info. */
-struct external_info *ospf_external_info_check(struct ospf_lsa *lsa) {
+/* Check LSA is related to external info the instance redistributes. */
+struct external_info *ospf_external_info_check(struct ospf *ospf, struct ospf_lsa *lsa) {
 	struct as_external_lsa *al;
 	struct prefix_ipv4 p;
 	struct route_node *rn;
@@ -89,7 +92,7 @@ struct external_info *ospf_external_info_check(struct ospf_lsa *lsa) {
 
 	for(type = 0; type <= ZEBRA_ROUTE_MAX; type++) {
 		int redist_type = is_prefix_default(&p) ? DEFAULT_ROUTE : type;
-		if(ospf_is_type_redistributed(redist_type)) {
+		if(ospf_is_type_redistributed(ospf, redist_type)) {
 			if(EXTERNAL_INFO(type)) {
 				rn = route_node_lookup(EXTERNAL_INFO(type), (struct prefix *) &p);
 				if(rn) {
@@ -105,7 +108,7 @@ struct external_info *ospf_external_info_check(struct ospf_lsa *lsa) {
 	return NULL;
 }
 
-static void ospf_process_self_originated_lsa(struct ospf *ospf, struct ospf_lsa *new, struct ospf_area *area) {
+void ospf_process_self_originated_lsa(struct ospf *ospf, struct ospf_lsa *new, struct ospf_area *area) {
 	struct ospf_interface *oi;
 	struct external_info *ei;
 	struct listnode *node;
@@ -114,6 +117,20 @@ static void ospf_process_self_originated_lsa(struct ospf *ospf, struct ospf_lsa
 		zlog_debug("LSA[Type%d:%s]: Process self-originated LSA seq 0x%x", new->data->type, inet_ntoa(new->data->id), ntohl(new->data->ls_seqnum));
 	}
 
+	/* Restarting, what neighbors give back of ours is kept as it is
+     until the restart is over, see ospf_gr.c. */
+	if(OSPF_GR_RESTARTING_P(ospf)) {
+		switch(new->data->type) {
+			case OSPF_ROUTER_LSA:
+			case OSPF_NETWORK_LSA:
+			case OSPF_SUMMARY_LSA:
+			case OSPF_ASBR_SUMMARY_LSA:
+			case OSPF_AS_EXTERNAL_LSA:
+			case OSPF_AS_NSSA_LSA: return;
+			default: break;
+		}
+	}
+
 	/* If we're here, we installed a self-originated LSA that we received
      from a neighbor, i.e. it's more recent.  We must see whether we want
      to originate it.
@@ -167,7 +184,7 @@ static void ospf_process_self_originated_lsa(struct ospf *ospf, struct ospf_lsa
 				ospf_translated_nssa_refresh(ospf, NULL, new);
 				return;
 			}
-			ei = ospf_external_info_check(new);
+			ei = ospf_external_info_check(ospf, new);
 			if(ei) {
 				ospf_external_lsa_refresh(ospf, new, ei, LSA_REFRESH_FORCE);
 			} else {
@@ -744,31 +761,114 @@ struct ospf_lsa *ospf_ls_request_new(struct lsa_header *lsah) {
 	return new;
 }
 
-/* Management functions for neighbor's ls-retransmit list. */
+/* Management functions for neighbor's ls-retransmit list.
+
+   Each LSA on the list has an entry, found by the LSA's type, ID and
+   advertising router in the neighbor's hash, and queued in the order
+   it falls due for retransmission.  Adding and deleting don't depend on
+   the size of the list, and the retransmit timer stops at the first
+   entry that isn't due yet. */
+struct ospf_rxmt {
+	struct ospf_lsa *lsa;
+	struct timeval due; /* relative time, see recent_relative_time() */
+	struct ospf_rxmt *prev;
+	struct ospf_rxmt *next;
+};
+
+static unsigned int ospf_ls_retransmit_hash_key(void *data) {
+	struct ospf_rxmt *rxmt = data;
+
+	return jhash_3words(rxmt->lsa->data->type, rxmt->lsa->data->id.s_addr, rxmt->lsa->data->adv_router.s_addr, 0);
+}
+
+static int ospf_ls_retransmit_hash_cmp(const void *a, const void *b) {
+	const struct lsa_header *l1 = ((const struct ospf_rxmt *) a)->lsa->data;
+	const struct lsa_header *l2 = ((const struct ospf_rxmt *) b)->lsa->data;
+
+	return l1->type == l2->type && IPV4_ADDR_SAME(&l1->id, &l2->id) && IPV4_ADDR_SAME(&l1->adv_router, &l2->adv_router);
+}
+
+static struct ospf_rxmt *ospf_ls_retransmit_entry(struct ospf_neighbor *nbr, struct ospf_lsa *lsa) {
+	struct ospf_rxmt key;
+
+	if(nbr->ls_rxmt == NULL) {
+		return NULL;
+	}
+	key.lsa = lsa;
+	return hash_lookup(nbr->ls_rxmt, &key);
+}
+
+/* Put the entry at the tail of the queue, due at 'due'. */
+static void ospf_ls_retransmit_enqueue(struct ospf_neighbor *nbr, struct ospf_rxmt *rxmt, struct timeval due) {
+	rxmt->due = due;
+	rxmt->next = NULL;
+	rxmt->prev = nbr->ls_rxmt_tail;
+	if(nbr->ls_rxmt_tail) {
+		nbr->ls_rxmt_tail->next = rxmt;
+	} else {
+		nbr->ls_rxmt_head = rxmt;
+	}
+	nbr->ls_rxmt_tail = rxmt;
+}
+
+static void ospf_ls_retransmit_dequeue(struct ospf_neighbor *nbr, struct ospf_rxmt *rxmt) {
+	if(rxmt->prev) {
+		rxmt->prev->next = rxmt->next;
+	} else {
+		nbr->ls_rxmt_head = rxmt->next;
+	}
+	if(rxmt->next) {
+		rxmt->next->prev = rxmt->prev;
+	} else {
+		nbr->ls_rxmt_tail = rxmt->prev;
+	}
+}
+
 unsigned long ospf_ls_retransmit_count(struct ospf_neighbor *nbr) {
-	return ospf_lsdb_count_all(&nbr->ls_rxmt);
+	return nbr->ls_rxmt ? nbr->ls_rxmt->count : 0;
 }
 
 unsigned long ospf_ls_retransmit_count_self(struct ospf_neighbor *nbr, int lsa_type) {
-	return ospf_lsdb_count_self(&nbr->ls_rxmt, lsa_type);
+	struct ospf_rxmt *rxmt;
+	unsigned long count = 0;
+
+	for(rxmt = nbr->ls_rxmt_head; rxmt; rxmt = rxmt->next) {
+		if(rxmt->lsa->data->type == lsa_type && IS_LSA_SELF(rxmt->lsa)) {
+			count++;
+		}
+	}
+	return count;
 }
 
 int ospf_ls_retransmit_isempty(struct ospf_neighbor *nbr) {
-	return ospf_lsdb_isempty(&nbr->ls_rxmt);
+	return ospf_ls_retransmit_count(nbr) == 0;
 }
 
 /* Add LSA to be retransmitted to neighbor's ls-retransmit list. */
 void ospf_ls_retransmit_add(struct ospf_neighbor *nbr, struct ospf_lsa *lsa) {
+	struct ospf_rxmt *rxmt;
 	struct ospf_lsa *old;
 
-	old = ospf_ls_retransmit_lookup(nbr, lsa);
+	rxmt = ospf_ls_retransmit_entry(nbr, lsa);
+	old = rxmt ? rxmt->lsa : NULL;
 
 	if(ospf_lsa_more_recent(old, lsa) < 0) {
 		if(old) {
+			/* the hash key doesn't change, only the instance */
 			old->retransmit_counter--;
-			ospf_lsdb_delete(&nbr->ls_rxmt, old);
+			ospf_lsa_unlock(&rxmt->lsa); /* nbr->ls_rxmt */
+			ospf_ls_retransmit_dequeue(nbr, rxmt);
+		} else {
+			if(nbr->ls_rxmt == NULL) {
+				nbr->ls_rxmt = hash_create_open(ospf_ls_retransmit_hash_key, ospf_ls_retransmit_hash_cmp);
+			}
+			rxmt = XCALLOC(MTYPE_OSPF_RXMT, sizeof(struct ospf_rxmt));
+			rxmt->lsa = lsa;
+			hash_get(nbr->ls_rxmt, rxmt, hash_alloc_intern);
 		}
+		rxmt->lsa = ospf_lsa_lock(lsa); /* nbr->ls_rxmt */
 		lsa->retransmit_counter++;
+		ospf_ls_retransmit_enqueue(nbr, rxmt, tv_add(recent_relative_time(), int2tv(OSPF_IF_PARAM(nbr->oi, retransmit_interval))));
 		/*
        * We cannot make use of the newly introduced callback function
        * "lsdb->new_lsa_hook" to replace debug output below, just because
@@ -778,47 +878,74 @@ void ospf_ls_retransmit_add(struct ospf_neighbor *nbr, struct ospf_lsa *lsa) {
 		if(IS_DEBUG_OSPF(lsa, LSA_FLOODING)) {
 			zlog_debug("RXmtL(%lu)++, NBR(%s), LSA[%s]", ospf_ls_retransmit_count(nbr), inet_ntoa(nbr->router_id), dump_lsa_key(lsa));
 		}
-		ospf_lsdb_add(&nbr->ls_rxmt, lsa);
 	}
 }
 
 /* Remove LSA from neibghbor's ls-retransmit list. */
 void ospf_ls_retransmit_delete(struct ospf_neighbor *nbr, struct ospf_lsa *lsa) {
-	if(ospf_ls_retransmit_lookup(nbr, lsa)) {
-		lsa->retransmit_counter--;
+	struct ospf_rxmt *rxmt;
+
+	if((rxmt = ospf_ls_retransmit_entry(nbr, lsa)) != NULL) {
+		hash_release(nbr->ls_rxmt, rxmt);
+		ospf_ls_retransmit_dequeue(nbr, rxmt);
+		rxmt->lsa->retransmit_counter--;
 		if(IS_DEBUG_OSPF(lsa, LSA_FLOODING)) { /* -- endo. */
 			zlog_debug("RXmtL(%lu)--, NBR(%s), LSA[%s]", ospf_ls_retransmit_count(nbr), inet_ntoa(nbr->router_id), dump_lsa_key(lsa));
 		}
-		ospf_lsdb_delete(&nbr->ls_rxmt, lsa);
+		ospf_lsa_unlock(&rxmt->lsa); /* nbr->ls_rxmt */
+		XFREE(MTYPE_OSPF_RXMT, rxmt);
 	}
 }
 
 /* Clear neighbor's ls-retransmit list. */
 void ospf_ls_retransmit_clear(struct ospf_neighbor *nbr) {
-	struct ospf_lsdb *lsdb;
-	int i;
-
-	lsdb = &nbr->ls_rxmt;
-
-	for(i = OSPF_MIN_LSA; i < OSPF_MAX_LSA; i++) {
-		struct route_table *table = lsdb->type[i].db;
-		struct route_node *rn;
-		struct ospf_lsa *lsa;
-
-		for(rn = route_top(table); rn; rn = route_next(rn)) {
-			if((lsa = rn->info) != NULL) {
-				ospf_ls_retransmit_delete(nbr, lsa);
-			}
-		}
+	while(nbr->ls_rxmt_head) {
+		ospf_ls_retransmit_delete(nbr, nbr->ls_rxmt_head->lsa);
 	}
 
 	ospf_lsa_unlock(&nbr->ls_req_last);
 	nbr->ls_req_last = NULL;
 }
 
+/* Free what's left of the list along with the neighbor. */
+void ospf_ls_retransmit_cleanup(struct ospf_neighbor *nbr) {
+	ospf_ls_retransmit_clear(nbr);
+	if(nbr->ls_rxmt) {
+		hash_free(nbr->ls_rxmt);
+		nbr->ls_rxmt = NULL;
+	}
+}
+
 /* Lookup LSA from neighbor's ls-retransmit list. */
 struct ospf_lsa *ospf_ls_retransmit_lookup(struct ospf_neighbor *nbr, struct ospf_lsa *lsa) {
-	return ospf_lsdb_lookup(&nbr->ls_rxmt, lsa);
+	struct ospf_rxmt *rxmt = ospf_ls_retransmit_entry(nbr, lsa);
+
+	return rxmt ? rxmt->lsa : NULL;
+}
+
+/* Add the LSAs due for retransmission to 'update' and queue them again
+   an interval on.  Don't retransmit an LSA if we received it within the
+   last RxmtInterval seconds - this is to allow the neighbour a chance to
+   acknowledge the LSA as it may have ben just received before the
+   retransmit timer fired.  This is a small tweak to what is in the RFC,
+   but it will cut out out a lot of retransmit traffic - MAG */
+void ospf_ls_retransmit_due(struct ospf_neighbor *nbr, struct list *update) {
+	struct timeval now = recent_relative_time();
+	struct timeval interval = int2tv(OSPF_IF_PARAM(nbr->oi, retransmit_interval));
+	struct ospf_rxmt *rxmt, *last = nbr->ls_rxmt_tail;
+
+	while((rxmt = nbr->ls_rxmt_head) != NULL && tv_cmp(rxmt->due, now) <= 0) {
+		ospf_ls_retransmit_dequeue(nbr, rxmt);
+		if(tv_cmp(tv_sub(now, rxmt->lsa->tv_recv), interval) >= 0) {
+			listnode_add(update, rxmt->lsa);
+			ospf_ls_retransmit_enqueue(nbr, rxmt, tv_add(now, interval));
+		} else {
+			ospf_ls_retransmit_enqueue(nbr, rxmt, tv_add(rxmt->lsa->tv_recv, interval));
+		}
+		if(rxmt == last) {
+			break;
+		}
+	}
 }
 
 static void ospf_ls_retransmit_delete_nbr_if(struct ospf_interface *oi, struct ospf_lsa *lsa) {
@@ -27,6 +27,7 @@ extern int ospf_flood(struct ospf *, struct ospf_neighbor *, struct ospf_lsa *,
 extern int ospf_flood_through(struct ospf *, struct ospf_neighbor *, struct ospf_lsa *);
 extern int ospf_flood_through_area(struct ospf_area *, struct ospf_neighbor *, struct ospf_lsa *);
 extern int ospf_flood_through_as(struct ospf *, struct ospf_neighbor *, struct ospf_lsa *);
+extern void ospf_process_self_originated_lsa(struct ospf *, struct ospf_lsa *, struct ospf_area *);
 
 extern unsigned long ospf_ls_request_count(struct ospf_neighbor *);
 extern int ospf_ls_request_isempty(struct ospf_neighbor *);
@@ -43,7 +44,9 @@ extern int ospf_ls_retransmit_isempty(struct ospf_neighbor *);
 extern void ospf_ls_retransmit_add(struct ospf_neighbor *, struct ospf_lsa *);
 extern void ospf_ls_retransmit_delete(struct ospf_neighbor *, struct ospf_lsa *);
 extern void ospf_ls_retransmit_clear(struct ospf_neighbor *);
+extern void ospf_ls_retransmit_cleanup(struct ospf_neighbor *);
 extern struct ospf_lsa *ospf_ls_retransmit_lookup(struct ospf_neighbor *, struct ospf_lsa *);
+extern void ospf_ls_retransmit_due(struct ospf_neighbor *, struct list *);
 extern void ospf_ls_retransmit_delete_nbr_area(struct ospf_area *, struct ospf_lsa *);
 extern void ospf_ls_retransmit_delete_nbr_as(struct ospf *, struct ospf_lsa *);
 extern void ospf_ls_retransmit_add_nbr_all(struct ospf_interface *, struct ospf_lsa *);
@@ -53,7 +56,7 @@ extern void ospf_flood_lsa_as(struct ospf_lsa *);
 extern void ospf_lsa_flush_area(struct ospf_lsa *, struct ospf_area *);
 extern void ospf_lsa_flush_as(struct ospf *, struct ospf_lsa *);
 extern void ospf_lsa_flush(struct ospf *, struct ospf_lsa *);
-extern struct external_info *ospf_external_info_check(struct ospf_lsa *);
+extern struct external_info *ospf_external_info_check(struct ospf *, struct ospf_lsa *);
 
 extern void ospf_lsdb_init(struct ospf_lsdb *);
 
@@ -0,0 +1,1025 @@
+/*
+ * OSPF graceful restart, RFC3623: helping neighbors through theirs and
+ * restarting with the forwarding kept in zebra, from a checkpoint of the
+ * self-originated LSAs.
+ *
+ * This file is part of GNU Zebra.
+ *
+ * GNU Zebra is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2, or (at your option) any
+ * later version.
+ *
+ * GNU Zebra is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with GNU Zebra; see the file COPYING.  If not, write to the Free
+ * Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ * 02111-1307, USA.
+ */
+
+/* A planned restart goes like this.  "graceful-restart prepare ip ospf"
+ * sends a Grace-LSA out of every interface, writes the sequence numbers
+ * of the self-originated LSAs and the number of full neighbors on each
+ * interface to the checkpoint file, and has zebra keep the OSPF routes
+ * for the grace period once ospfd is gone.  The next ospfd reads the
+ * checkpoint back and, until the adjacencies are all back up or the
+ * grace period is over, originates nothing but Grace-LSAs and leaves the
+ * routes in zebra as they are, while the neighbors helping it carry on
+ * as if it had never gone.  At the end it originates its LSAs anew, each
+ * numbered past what was checkpointed and what the neighbors gave back,
+ * so none is refused nor has to be flushed and originated twice, and
+ * hands zebra the whole routing table before letting it sweep away the
+ * routes it still holds stale.
+ */
+
+#include <zebra.h>
+
+#include "linklist.h"
+#include "prefix.h"
+#include "if.h"
+#include "table.h"
+#include "memory.h"
+#include "command.h"
+#include "vty.h"
+#include "stream.h"
+#include "log.h"
+#include "thread.h"
+#include "hash.h"
+#include "jhash.h"
+
+#include "ospfd/ospfd.h"
+#include "ospfd/ospf_interface.h"
+#include "ospfd/ospf_ism.h"
+#include "ospfd/ospf_asbr.h"
+#include "ospfd/ospf_lsa.h"
+#include "ospfd/ospf_lsdb.h"
+#include "ospfd/ospf_neighbor.h"
+#include "ospfd/ospf_nsm.h"
+#include "ospfd/ospf_flood.h"
+#include "ospfd/ospf_packet.h"
+#include "ospfd/ospf_spf.h"
+#include "ospfd/ospf_dump.h"
+#include "ospfd/ospf_route.h"
+#include "ospfd/ospf_abr.h"
+#include "ospfd/ospf_zebra.h"
+#include "ospfd/ospf_opaque.h"
+#include "ospfd/ospf_gr.h"
+
+/* A self-originated LSA in the checkpoint: the area it's in, the
+   interface address for a type-9 one, 0.0.0.0 for AS scope. */
+struct ospf_gr_lsa {
+	u_char type;
+	struct in_addr scope;
+	struct in_addr id;
+	u_int32_t seqnum;
+};
+
+/* An interface and how many full neighbors it had. */
+struct ospf_gr_if {
+	struct in_addr addr;
+	u_int32_t full_nbrs;
+};
+
+struct ospf_gr {
+	struct in_addr router_id;
+	struct hash *lsas;
+	struct list *ifs;
+};
+
+/* Grace-LSA TLV header, the value follows padded to 4 bytes. */
+struct ospf_gr_tlv {
+	u_int16_t type;
+	u_int16_t length;
+};
+
+#define OSPF_GR_TLV_SIZE(L) (sizeof(struct ospf_gr_tlv) + (((L) + 3) & ~3))
+
+static int ospf_gr_sweep_timer(struct thread *);
+
+/*------------------------------------------------------------------------*
+ * The checkpoint.
+ *------------------------------------------------------------------------*/
+
+static unsigned int ospf_gr_lsa_key(void *data) {
+	struct ospf_gr_lsa *gl = data;
+
+	return jhash_3words(gl->type, gl->scope.s_addr, gl->id.s_addr, 0);
+}
+
+static int ospf_gr_lsa_cmp(const void *a, const void *b) {
+	const struct ospf_gr_lsa *ga = a, *gb = b;
+
+	return ga->type == gb->type && ga->scope.s_addr == gb->scope.s_addr && ga->id.s_addr == gb->id.s_addr;
+}
+
+static void *ospf_gr_lsa_alloc(void *data) {
+	struct ospf_gr_lsa *gl;
+
+	gl = XMALLOC(MTYPE_OSPF_GR, sizeof(struct ospf_gr_lsa));
+	*gl = *(struct ospf_gr_lsa *) data;
+	return gl;
+}
+
+static void ospf_gr_lsa_free(void *data) {
+	XFREE(MTYPE_OSPF_GR, data);
+}
+
+static void ospf_gr_if_free(void *data) {
+	XFREE(MTYPE_OSPF_GR, data);
+}
+
+static struct ospf_gr *ospf_gr_new(void) {
+	struct ospf_gr *gr;
+
+	gr = XCALLOC(MTYPE_OSPF_GR, sizeof(struct ospf_gr));
+	gr->lsas = hash_create(ospf_gr_lsa_key, ospf_gr_lsa_cmp);
+	gr->ifs = list_new();
+	gr->ifs->del = ospf_gr_if_free;
+	return gr;
+}
+
+static void ospf_gr_free(struct ospf_gr *gr) {
+	hash_clean(gr->lsas, ospf_gr_lsa_free);
+	hash_free(gr->lsas);
+	list_delete(gr->ifs);
+	XFREE(MTYPE_OSPF_GR, gr);
+}
+
+static struct in_addr ospf_gr_lsa_scope(struct ospf_lsa *lsa) {
+	struct in_addr scope;
+
+	scope.s_addr = 0;
+	switch(lsa->data->type) {
+		case OSPF_AS_EXTERNAL_LSA:
+		case OSPF_OPAQUE_AS_LSA: break;
+		case OSPF_OPAQUE_LINK_LSA:
+			if(lsa->oi && lsa->oi->address) {
+				scope = lsa->oi->address->u.prefix4;
+			}
+			break;
+		default:
+			if(lsa->area) {
+				scope = lsa->area->area_id;
+			}
+			break;
+	}
+	return scope;
+}
+
+static void ospf_gr_write_lsdb(FILE *fp, struct ospf *ospf, struct ospf_lsdb *lsdb) {
+	struct route_node *rn;
+	struct ospf_lsa *lsa;
+	char scope[INET_ADDRSTRLEN], id[INET_ADDRSTRLEN];
+	int type;
+
+	for(type = OSPF_MIN_LSA; type < OSPF_MAX_LSA; type++) {
+		LSDB_LOOP(lsdb->type[type].db, rn, lsa) {
+			if(!IS_LSA_SELF(lsa) || IS_LSA_MAXAGE(lsa) || !IPV4_ADDR_SAME(&lsa->data->adv_router, &ospf->router_id)) {
+				continue;
+			}
+			strlcpy(scope, inet_ntoa(ospf_gr_lsa_scope(lsa)), sizeof(scope));
+			strlcpy(id, inet_ntoa(lsa->data->id), sizeof(id));
+			fprintf(fp, "lsa %d %s %s %08x\n", type, scope, id, ntohl(lsa->data->ls_seqnum));
+		}
+	}
+}
+
+/* Write the checkpoint for the next ospfd, to a temporary file renamed
+   over the old one so that it never reads half of one. */
+static int ospf_gr_checkpoint_write(struct ospf *ospf) {
+	char tmp[MAXPATHLEN];
+	struct listnode *node;
+	struct ospf_area *area;
+	struct ospf_interface *oi;
+	FILE *fp;
+
+	snprintf(tmp, sizeof(tmp), "%s.tmp", om->gr_file);
+	if((fp = fopen(tmp, "w")) == NULL) {
+		zlog_warn("Graceful restart: can't write %s: %s", tmp, safe_strerror(errno));
+		return -1;
+	}
+
+	fprintf(fp, "router-id %s\n", inet_ntoa(ospf->router_id));
+	fprintf(fp, "time %lld\n", (long long) time(NULL));
+	fprintf(fp, "grace-period %u\n", ospf->gr_period);
+
+	for(ALL_LIST_ELEMENTS_RO(ospf->oiflist, node, oi)) {
+		if(oi->type == OSPF_IFTYPE_VIRTUALLINK || oi->type == OSPF_IFTYPE_LOOPBACK || oi->state == ISM_Down) {
+			continue;
+		}
+		fprintf(fp, "interface %s %u\n", inet_ntoa(oi->address->u.prefix4), oi->full_nbrs);
+	}
+
+	for(ALL_LIST_ELEMENTS_RO(ospf->areas, node, area)) {
+		ospf_gr_write_lsdb(fp, ospf, area->lsdb);
+	}
+	ospf_gr_write_lsdb(fp, ospf, ospf->lsdb);
+
+	if(fclose(fp) != 0 || rename(tmp, om->gr_file) != 0) {
+		zlog_warn("Graceful restart: can't write %s: %s", om->gr_file, safe_strerror(errno));
+		unlink(tmp);
+		return -1;
+	}
+	return 0;
+}
+
+/* Read the checkpoint back, NULL if there's none or it's out of date;
+   it goes once read, the next ospfd is no longer restarting. */
+static struct ospf_gr *ospf_gr_checkpoint_read(u_int32_t *remain) {
+	struct ospf_gr *gr;
+	struct ospf_gr_lsa gl;
+	struct ospf_gr_if *gi;
+	char buf[256], a1[INET_ADDRSTRLEN], a2[INET_ADDRSTRLEN];
+	long long then = -1;
+	unsigned int period = 0, n, type, seqnum;
+	time_t now;
+	int line = 0, bad = 0;
+	FILE *fp;
+
+	if((fp = fopen(om->gr_file, "r")) == NULL) {
+		return NULL;
+	}
+
+	gr = ospf_gr_new();
+	while(!bad && fgets(buf, sizeof(buf), fp)) {
+		line++;
+		if(sscanf(buf, "router-id %15s", a1) == 1) {
+			bad = !inet_aton(a1, &gr->router_id);
+		} else if(sscanf(buf, "time %lld", &then) == 1) {
+			continue;
+		} else if(sscanf(buf, "grace-period %u", &period) == 1) {
+			continue;
+		} else if(sscanf(buf, "interface %15s %u", a1, &n) == 2) {
+			gi = XCALLOC(MTYPE_OSPF_GR, sizeof(struct ospf_gr_if));
+			gi->full_nbrs = n;
+			listnode_add(gr->ifs, gi);
+			bad = !inet_aton(a1, &gi->addr);
+		} else if(sscanf(buf, "lsa %u %15s %15s %x", &type, a1, a2, &seqnum) == 4) {
+			memset(&gl, 0, sizeof(gl));
+			gl.type = type;
+			gl.seqnum = seqnum;
+			bad = !inet_aton(a1, &gl.scope) || !inet_aton(a2, &gl.id);
+			hash_get(gr->lsas, &gl, ospf_gr_lsa_alloc);
+		} else {
+			bad = 1;
+		}
+	}
+	fclose(fp);
+	unlink(om->gr_file);
+
+	now = time(NULL);
+	if(bad || then < 0 || period == 0) {
+		zlog_warn("Graceful restart: %s is garbled at line %d, starting afresh", om->gr_file, line);
+	} else if(then > now || now - then >= period) {
+		zlog_warn("Graceful restart: the checkpoint in %s is out of date, starting afresh", om->gr_file);
+	} else {
+		*remain = period - (now - then);
+		return gr;
+	}
+	ospf_gr_free(gr);
+	return NULL;
+}
+
+/* Number a self-originated LSA about to go in the LSDB past both the
+   instance checkpointed for it and the one "old" neighbors gave back. */
+void ospf_gr_lsa_seqnum(struct ospf *ospf, struct ospf_lsa *lsa, struct ospf_lsa *old) {
+	struct ospf_gr_lsa key, *gl;
+	u_int32_t seqnum;
+
+	if(ospf->gr == NULL || !IS_LSA_SELF(lsa) || CHECK_FLAG(lsa->flags, OSPF_LSA_RECEIVED) || IS_LSA_MAXAGE(lsa)) {
+		return;
+	}
+
+	seqnum = ntohl(lsa->data->ls_seqnum);
+
+	memset(&key, 0, sizeof(key));
+	key.type = lsa->data->type;
+	key.scope = ospf_gr_lsa_scope(lsa);
+	key.id = lsa->data->id;
+	if((gl = hash_lookup(ospf->gr->lsas, &key)) && (int32_t) seqnum <= (int32_t) gl->seqnum) {
+		seqnum = gl->seqnum + 1;
+	}
+	if(old && (int32_t) seqnum <= (int32_t) ntohl(old->data->ls_seqnum)) {
+		seqnum = ntohl(old->data->ls_seqnum) + 1;
+	}
+
+	if(seqnum != ntohl(lsa->data->ls_seqnum)) {
+		if(IS_DEBUG_OSPF(lsa, LSA_GENERATE)) {
+			zlog_debug("LSA[Type%d:%s]: Graceful restart, seq 0x%x -> 0x%x", lsa->data->type, inet_ntoa(lsa->data->id), ntohl(lsa->data->ls_seqnum), seqnum);
+		}
+		lsa->data->ls_seqnum = htonl(seqnum);
+	}
+}
+
+/*------------------------------------------------------------------------*
+ * Grace-LSAs.
+ *------------------------------------------------------------------------*/
+
+static void ospf_gr_tlv_put(struct stream *s, u_int16_t type, u_int16_t length) {
+	stream_putw(s, type);
+	stream_putw(s, length);
+}
+
+static struct ospf_lsa *ospf_gr_lsa_new(struct ospf_interface *oi, u_int32_t period) {
+	struct stream *s;
+	struct lsa_header *lsah;
+	struct ospf_lsa *new;
+	struct in_addr lsa_id;
+	u_int16_t length;
+
+	s = stream_new(OSPF_MAX_LSA_SIZE);
+	lsah = (struct lsa_header *) STREAM_DATA(s);
+
+	lsa_id.s_addr = htonl(SET_OPAQUE_LSID(OPAQUE_TYPE_GRACE_LSA, 0));
+	lsa_header_set(s, OPTIONS(oi) | OSPF_OPTION_O, OSPF_OPAQUE_LINK_LSA, lsa_id, oi->ospf->router_id);
+
+	ospf_gr_tlv_put(s, OSPF_GR_TLV_PERIOD, 4);
+	stream_putl(s, period);
+	ospf_gr_tlv_put(s, OSPF_GR_TLV_REASON, 1);
+	stream_putc(s, OSPF_GR_REASON_RESTART);
+	stream_putc(s, 0);
+	stream_putw(s, 0);
+	ospf_gr_tlv_put(s, OSPF_GR_TLV_ADDRESS, 4);
+	stream_put_ipv4(s, oi->address->u.prefix4.s_addr);
+
+	length = stream_get_endp(s);
+	lsah->length = htons(length);
+
+	new = ospf_lsa_new();
+	new->data = ospf_lsa_data_new(length);
+	memcpy(new->data, lsah, length);
+	stream_free(s);
+
+	new->area = oi->area;
+	new->oi = oi;
+	SET_FLAG(new->flags, OSPF_LSA_SELF | OSPF_LSA_SELF_CHECKED);
+
+	return new;
+}
+
+/* Send out a Grace-LSA on the interface.  Type-9 LSAs sit in the area's
+   LSDB keyed only by type, id and router, so those of an area's
+   interfaces replace each other there, each having gone out of its own
+   interface first. */
+static struct ospf_lsa *ospf_gr_lsa_originate(struct ospf_interface *oi, u_int32_t period) {
+	struct ospf_lsa *new, *old;
+
+	if(oi->type == OSPF_IFTYPE_LOOPBACK || oi->address == NULL || period == 0) {
+		return NULL;
+	}
+
+	new = ospf_gr_lsa_new(oi, period);
+	if((old = ospf_lsdb_lookup(oi->area->lsdb, new))) {
+		new->data->ls_seqnum = lsa_seqnum_increment(old);
+	}
+
+	if((new = ospf_lsa_install(oi->ospf, oi, new)) == NULL) {
+		zlog_warn("Graceful restart: can't install the Grace-LSA for %s", IF_NAME(oi));
+		return NULL;
+	}
+	oi->gr_lsa_self = 1;
+	oi->ospf->lsa_originate_count++;
+
+	ospf_flood_through_area(oi->area, NULL, new);
+
+	if(IS_DEBUG_OSPF(lsa, LSA_GENERATE)) {
+		zlog_debug("LSA[Type%d:%s]: Originate Grace-LSA on %s, %us", new->data->type, inet_ntoa(new->data->id), IF_NAME(oi), period);
+		ospf_lsa_header_dump(new->data);
+	}
+	return new;
+}
+
+static void ospf_gr_lsa_flush(struct ospf_interface *oi) {
+	struct ospf_lsa lsa;
+	struct lsa_header lsah;
+
+	if(!oi->gr_lsa_self) {
+		return;
+	}
+	oi->gr_lsa_self = 0;
+
+	memset(&lsa, 0, sizeof(lsa));
+	memset(&lsah, 0, sizeof(lsah));
+	lsah.type = OSPF_OPAQUE_LINK_LSA;
+	lsah.id.s_addr = htonl(SET_OPAQUE_LSID(OPAQUE_TYPE_GRACE_LSA, 0));
+	lsah.adv_router = oi->ospf->router_id;
+	lsa.data = &lsah;
+	lsa.oi = oi;
+	lsa.area = oi->area;
+	ospf_opaque_lsa_flush_schedule(&lsa);
+}
+
+static void ospf_gr_lsa_flush_all(struct ospf *ospf) {
+	struct listnode *node;
+	struct ospf_interface *oi;
+
+	for(ALL_LIST_ELEMENTS_RO(ospf->oiflist, node, oi)) {
+		ospf_gr_lsa_flush(oi);
+	}
+}
+
+/* What a Grace-LSA says: the grace period and why, 0 if not there. */
+static u_int32_t ospf_gr_lsa_parse(struct ospf_lsa *lsa, int *reason) {
+	u_char *p = (u_char *) lsa->data + OSPF_LSA_HEADER_SIZE;
+	u_char *end = (u_char *) lsa->data + ntohs(lsa->data->length);
+	struct ospf_gr_tlv tlv;
+	u_int32_t period = 0;
+
+	*reason = OSPF_GR_REASON_UNKNOWN;
+	while(p + sizeof(struct ospf_gr_tlv) <= end) {
+		memcpy(&tlv, p, sizeof(tlv));
+		tlv.type = ntohs(tlv.type);
+		tlv.length = ntohs(tlv.length);
+		p += sizeof(struct ospf_gr_tlv);
+		if(p + tlv.length > end) {
+			break;
+		}
+		if(tlv.type == OSPF_GR_TLV_PERIOD && tlv.length == 4) {
+			memcpy(&period, p, 4);
+			period = ntohl(period);
+		} else if(tlv.type == OSPF_GR_TLV_REASON && tlv.length == 1) {
+			*reason = *p;
+		}
+		p += OSPF_GR_TLV_SIZE(tlv.length) - sizeof(struct ospf_gr_tlv);
+	}
+	return period;
+}
+
+static const char *ospf_gr_reason_str(int reason) {
+	switch(reason) {
+		case OSPF_GR_REASON_RESTART: return "software restart";
+		case OSPF_GR_REASON_UPGRADE: return "software upgrade";
+		case OSPF_GR_REASON_SWITCH: return "switch to redundant control processor";
+		default: return "unknown";
+	}
+}
+
+/*------------------------------------------------------------------------*
+ * Restarting.
+ *------------------------------------------------------------------------*/
+
+/* What's left of the grace period, prepared or restarting. */
+static u_int32_t ospf_gr_remain(struct ospf *ospf) {
+	if(ospf->t_gr_restart && ospf->t_gr_restart->type == THREAD_TIMER) {
+		return thread_timer_remain_second(ospf->t_gr_restart);
+	}
+	return 0;
+}
+
+/* Whether every interface is back to at least as many full neighbors as
+   it had; one that isn't up yet isn't. */
+static int ospf_gr_adjacencies_back(struct ospf *ospf) {
+	struct listnode *node, *inode;
+	struct ospf_gr_if *gi;
+	struct ospf_interface *oi;
+
+	for(ALL_LIST_ELEMENTS_RO(ospf->gr->ifs, node, gi)) {
+		for(ALL_LIST_ELEMENTS_RO(ospf->oiflist, inode, oi)) {
+			if(oi->type != OSPF_IFTYPE_VIRTUALLINK && IPV4_ADDR_SAME(&oi->address->u.prefix4, &gi->addr)) {
+				break;
+			}
+		}
+		if(oi == NULL || oi->full_nbrs < gi->full_nbrs) {
+			return 0;
+		}
+	}
+	return 1;
+}
+
+/* The restart is over: originate everything anew, give up what other
+   routers no longer need, and have the routes recalculated. */
+static void ospf_gr_restart_exit(struct ospf *ospf, const char *reason) {
+	struct listnode *node;
+	struct ospf_area *area;
+	struct ospf_interface *oi;
+	struct route_node *rn;
+	struct ospf_lsa *lsa;
+	struct list *self;
+	int type;
+
+	zlog_info("Graceful restart: done, %s", reason);
+
+	OSPF_TIMER_OFF(ospf->t_gr_restart);
+	ospf->gr_state = OSPF_GR_NONE;
+
+	ospf_gr_lsa_flush_all(ospf);
+
+	for(ALL_LIST_ELEMENTS_RO(ospf->areas, node, area)) {
+		ospf_router_lsa_update_area(area);
+	}
+
+	/* What neighbors gave back of our own and this ospfd doesn't
+	   refresh yet goes through what it was spared while restarting. */
+	self = list_new();
+	for(ALL_LIST_ELEMENTS_RO(ospf->areas, node, area)) {
+		for(type = OSPF_NETWORK_LSA; type < OSPF_MAX_LSA; type++) {
+			if(type == OSPF_AS_EXTERNAL_LSA || type >= OSPF_OPAQUE_LINK_LSA) {
+				continue;
+			}
+			LSDB_LOOP(AREA_LSDB(area, type), rn, lsa) {
+				if(IS_LSA_SELF(lsa) && !IS_LSA_MAXAGE(lsa) && lsa->refresh_list < 0) {
+					listnode_add(self, ospf_lsa_lock(lsa));
+				}
+			}
+		}
+	}
+	LSDB_LOOP(EXTERNAL_LSDB(ospf), rn, lsa) {
+		if(IS_LSA_SELF(lsa) && !IS_LSA_MAXAGE(lsa) && lsa->refresh_list < 0) {
+			listnode_add(self, ospf_lsa_lock(lsa));
+		}
+	}
+	for(ALL_LIST_ELEMENTS_RO(self, node, lsa)) {
+		if(!IS_LSA_MAXAGE(lsa) && lsa->refresh_list < 0) {
+			ospf_process_self_originated_lsa(ospf, lsa, lsa->area);
+		}
+		ospf_lsa_unlock(&lsa);
+	}
+	list_delete(self);
+
+	for(ALL_LIST_ELEMENTS_RO(ospf->oiflist, node, oi)) {
+		if(oi->state == ISM_DR && oi->network_lsa_self == NULL) {
+			ospf_network_lsa_update(oi);
+		}
+	}
+
+	ospf_schedule_abr_task(ospf);
+
+	for(type = 0; type < ZEBRA_ROUTE_MAX; type++) {
+		if(type != ZEBRA_ROUTE_OSPF && ospf_is_type_redistributed(ospf, type)) {
+			ospf_external_lsa_refresh_type(ospf, type, LSA_REFRESH_IF_CHANGED);
+		}
+	}
+	ospf_external_lsa_refresh_default(ospf);
+
+	ospf_spf_calculate_schedule(ospf, SPF_FLAG_CONFIG_CHANGE);
+
+	/* the routes go to zebra once they're recalculated */
+	OSPF_TIMER_OFF(ospf->t_gr_sweep);
+	ospf->t_gr_sweep = thread_add_timer(master, ospf_gr_sweep_timer, ospf, 1);
+}
+
+static int ospf_gr_restart_timer(struct thread *t) {
+	struct ospf *ospf = THREAD_ARG(t);
+
+	ospf->t_gr_restart = NULL;
+	ospf_gr_restart_exit(ospf, ospf_gr_adjacencies_back(ospf) ? "adjacencies all back" : "grace period over");
+	return 0;
+}
+
+/* With the routes worked out again, give zebra all of them, those it
+   has kept included, and let it drop whatever it kept on top. */
+static int ospf_gr_sweep_timer(struct thread *t) {
+	struct ospf *ospf = THREAD_ARG(t);
+	struct route_node *rn;
+	struct ospf_route * or ;
+
+	ospf->t_gr_sweep = NULL;
+
+	if(ospf->t_spf_calc || ospf->t_ase_calc || ospf->t_abr_task) {
+		ospf->t_gr_sweep = thread_add_timer(master, ospf_gr_sweep_timer, ospf, 1);
+		return 0;
+	}
+
+	ospf_zebra_batch_start();
+	if(ospf->new_table) {
+		for(rn = route_top(ospf->new_table); rn; rn = route_next(rn)) {
+			if((or = rn->info) == NULL) {
+				continue;
+			}
+			if(or->type == OSPF_DESTINATION_NETWORK) {
+				ospf_zebra_add((struct prefix_ipv4 *) &rn->p, or);
+			} else if(or->type == OSPF_DESTINATION_DISCARD) {
+				ospf_zebra_add_discard((struct prefix_ipv4 *) &rn->p);
+			}
+		}
+	}
+	if(ospf->old_external_route) {
+		for(rn = route_top(ospf->old_external_route); rn; rn = route_next(rn)) {
+			if((or = rn->info)) {
+				ospf_zebra_add((struct prefix_ipv4 *) &rn->p, or);
+			}
+		}
+	}
+	ospf_zebra_batch_end();
+	ospf_zebra_graceful_restart(0);
+
+	if(ospf->gr) {
+		ospf_gr_free(ospf->gr);
+		ospf->gr = NULL;
+	}
+	zlog_info("Graceful restart: routes handed to zebra");
+	return 0;
+}
+
+/* A new instance: restart from the checkpoint, if there's one. */
+void ospf_gr_start(struct ospf *ospf) {
+	u_int32_t remain = 0;
+
+	if((ospf->gr = ospf_gr_checkpoint_read(&remain)) == NULL) {
+		return;
+	}
+
+	zlog_info("Graceful restart: restarting as %s, %us left of the grace period, %lu LSAs checkpointed", inet_ntoa(ospf->gr->router_id), remain, ospf->gr->lsas->count);
+
+	ospf->gr_state = OSPF_GR_RESTARTING;
+	ospf->t_gr_restart = thread_add_timer(master, ospf_gr_restart_timer, ospf, remain);
+}
+
+/* ospfd is going down: 1 if it's to restart gracefully, and what it
+   originated and gave zebra are to be left as they are. */
+int ospf_gr_shutdown(struct ospf *ospf) {
+	if(ospf->gr_state == OSPF_GR_PREPARED && CHECK_FLAG(om->options, OSPF_MASTER_SHUTDOWN)) {
+		zlog_info("Graceful restart: going down to restart");
+		OSPF_TIMER_OFF(ospf->t_gr_restart);
+		ospf->gr_state = OSPF_GR_RESTARTING;
+		return 1;
+	}
+	ospf->gr_state = OSPF_GR_NONE;
+	return 0;
+}
+
+void ospf_gr_finish(struct ospf *ospf) {
+	OSPF_TIMER_OFF(ospf->t_gr_restart);
+	OSPF_TIMER_OFF(ospf->t_gr_sweep);
+	if(ospf->gr) {
+		ospf_gr_free(ospf->gr);
+		ospf->gr = NULL;
+	}
+}
+
+/* Prepared, but not gone by the end of the grace period. */
+static int ospf_gr_prepare_timer(struct thread *t) {
+	struct ospf *ospf = THREAD_ARG(t);
+
+	ospf->t_gr_restart = NULL;
+	zlog_info("Graceful restart: didn't restart within the grace period");
+	ospf->gr_state = OSPF_GR_NONE;
+	ospf_gr_lsa_flush_all(ospf);
+	ospf_zebra_graceful_restart(0);
+	return 0;
+}
+
+/*------------------------------------------------------------------------*
+ * Helping.
+ *------------------------------------------------------------------------*/
+
+u_int32_t ospf_gr_full_nbrs(struct ospf_interface *oi) {
+	struct route_node *rn;
+	struct ospf_neighbor *nbr;
+	u_int32_t count = oi->full_nbrs;
+
+	for(rn = route_top(oi->nbrs); rn; rn = route_next(rn)) {
+		if((nbr = rn->info) && nbr->gr_helper && nbr->state != NSM_Full) {
+			count++;
+		}
+	}
+	return count;
+}
+
+void ospf_gr_helper_exit(struct ospf_neighbor *nbr, const char *reason) {
+	struct ospf_interface *oi = nbr->oi;
+
+	if(!nbr->gr_helper) {
+		return;
+	}
+	nbr->gr_helper = 0;
+	OSPF_NSM_TIMER_OFF(nbr->t_gr_helper);
+
+	zlog_info("Graceful restart: no longer helping %s on %s, %s", inet_ntoa(nbr->router_id), IF_NAME(oi), reason);
+
+	ospf_router_lsa_update_area(oi->area);
+	if(oi->state == ISM_DR) {
+		if(oi->network_lsa_self && oi->full_nbrs == 0) {
+			ospf_lsa_flush_area(oi->network_lsa_self, oi->area);
+			ospf_lsa_unlock(&oi->network_lsa_self);
+			oi->network_lsa_self = NULL;
+		} else {
+			ospf_network_lsa_update(oi);
+		}
+	}
+}
+
+static int ospf_gr_helper_timer(struct thread *t) {
+	struct ospf_neighbor *nbr = THREAD_ARG(t);
+
+	nbr->t_gr_helper = NULL;
+	ospf_gr_helper_exit(nbr, "grace period over");
+	return 0;
+}
+
+static void ospf_gr_helper_grace_lsa(struct ospf *ospf, struct ospf_lsa *lsa) {
+	struct ospf_neighbor *nbr;
+	u_int32_t period;
+	int reason, remain;
+
+	if(lsa->oi == NULL || (nbr = ospf_nbr_lookup_by_routerid(lsa->oi->nbrs, &lsa->data->adv_router)) == NULL) {
+		return;
+	}
+
+	if(IS_LSA_MAXAGE(lsa)) {
+		ospf_gr_helper_exit(nbr, "Grace-LSA flushed");
+		return;
+	}
+
+	period = ospf_gr_lsa_parse(lsa, &reason);
+	remain = (int) period - LS_AGE(lsa);
+	if(remain <= 0) {
+		ospf_gr_helper_exit(nbr, "grace period over");
+		return;
+	}
+
+	if(!nbr->gr_helper) {
+		if(ospf->gr_helper_disable) {
+			zlog_info("Graceful restart: not helping %s on %s, helping is disabled", inet_ntoa(nbr->router_id), IF_NAME(lsa->oi));
+			return;
+		}
+		if(nbr->state != NSM_Full) {
+			zlog_info("Graceful restart: can't help %s on %s, not fully adjacent", inet_ntoa(nbr->router_id), IF_NAME(lsa->oi));
+			return;
+		}
+		nbr->gr_helper = 1;
+		zlog_info("Graceful restart: helping %s on %s for %ds, %s", inet_ntoa(nbr->router_id), IF_NAME(lsa->oi), remain, ospf_gr_reason_str(reason));
+	}
+
+	OSPF_NSM_TIMER_OFF(nbr->t_gr_helper);
+	OSPF_NSM_TIMER_ON(nbr->t_gr_helper, ospf_gr_helper_timer, remain);
+}
+
+/* An LSA went in the LSDB: a Grace-LSA, or, if its contents changed, a
+   topology change that ends helping the neighbors it floods to. */
+void ospf_gr_lsa_installed(struct ospf *ospf, struct ospf_lsa *lsa, int rt_recalc) {
+	struct listnode *node;
+	struct ospf_interface *oi;
+	struct route_node *rn;
+	struct ospf_neighbor *nbr;
+
+	if(lsa->data->type == OSPF_OPAQUE_LINK_LSA) {
+		if(GET_OPAQUE_TYPE(ntohl(lsa->data->id.s_addr)) == OPAQUE_TYPE_GRACE_LSA && !IS_LSA_SELF(lsa)) {
+			ospf_gr_helper_grace_lsa(ospf, lsa);
+		}
+		return;
+	}
+
+	if(!rt_recalc) {
+		return;
+	}
+	switch(lsa->data->type) {
+		case OSPF_ROUTER_LSA:
+		case OSPF_NETWORK_LSA:
+		case OSPF_SUMMARY_LSA:
+		case OSPF_ASBR_SUMMARY_LSA:
+		case OSPF_AS_EXTERNAL_LSA:
+		case OSPF_AS_NSSA_LSA: break;
+		default: return;
+	}
+
+	for(ALL_LIST_ELEMENTS_RO(ospf->oiflist, node, oi)) {
+		if(lsa->data->type != OSPF_AS_EXTERNAL_LSA && oi->area != lsa->area) {
+			continue;
+		}
+		for(rn = route_top(oi->nbrs); rn; rn = route_next(rn)) {
+			if((nbr = rn->info) && nbr->gr_helper && !IPV4_ADDR_SAME(&nbr->router_id, &lsa->data->adv_router)) {
+				ospf_gr_helper_exit(nbr, "topology changed");
+			}
+		}
+	}
+}
+
+/*------------------------------------------------------------------------*
+ * Opaque functab hooks.
+ *------------------------------------------------------------------------*/
+
+static void ospf_gr_ism_change(struct ospf_interface *oi, int old_state) {
+	struct ospf *ospf = oi->ospf;
+
+	if(!OSPF_GR_RESTARTING_P(ospf) || ospf->gr == NULL || old_state != ISM_Down || oi->state == ISM_Down) {
+		return;
+	}
+
+	if(ospf->router_id.s_addr != 0 && !IPV4_ADDR_SAME(&ospf->router_id, &ospf->gr->router_id)) {
+		ospf_gr_restart_exit(ospf, "the router-id changed");
+		return;
+	}
+
+	/* Before its first hello, the interface's neighbors are told again,
+	   in case they had already let the grace period go. */
+	ospf_gr_lsa_originate(oi, ospf_gr_remain(ospf));
+}
+
+static void ospf_gr_nsm_change(struct ospf_neighbor *nbr, int old_state) {
+	struct ospf *ospf = nbr->oi->ospf;
+
+	if(!OSPF_GR_RESTARTING_P(ospf) || ospf->gr == NULL || nbr->state != NSM_Full) {
+		return;
+	}
+
+	/* out of the NSM event, rather than from within it */
+	if(ospf_gr_adjacencies_back(ospf) && ospf_gr_remain(ospf) > 0) {
+		OSPF_TIMER_OFF(ospf->t_gr_restart);
+		ospf->t_gr_restart = thread_add_event(master, ospf_gr_restart_timer, ospf, 0);
+	}
+}
+
+static struct ospf_lsa *ospf_gr_lsa_refresh(struct ospf_lsa *lsa) {
+	struct ospf_interface *oi = lsa->oi;
+	struct ospf *ospf;
+
+	if(oi == NULL || (ospf = oi->ospf) == NULL) {
+		return NULL;
+	}
+
+	if(ospf->gr_state == OSPF_GR_NONE || IS_LSA_MAXAGE(lsa) || ospf_gr_remain(ospf) == 0) {
+		oi->gr_lsa_self = 0;
+		ospf_opaque_lsa_flush_schedule(lsa);
+		return NULL;
+	}
+
+	return ospf_gr_lsa_originate(oi, ospf_gr_remain(ospf));
+}
+
+static void ospf_gr_show_info(struct vty *vty, struct ospf_lsa *lsa) {
+	u_int32_t period;
+	int reason;
+
+	period = ospf_gr_lsa_parse(lsa, &reason);
+	vty_out(vty, "  Grace-LSA: grace period %us, reason %s%s", period, ospf_gr_reason_str(reason), VTY_NEWLINE);
+}
+
+/*------------------------------------------------------------------------*
+ * Commands.
+ *------------------------------------------------------------------------*/
+
+#define GRACEFUL_RESTART_STR "OSPF graceful restart, RFC3623\n"
+
+DEFUN(ospf_graceful_restart, ospf_graceful_restart_cmd, "graceful-restart", GRACEFUL_RESTART_STR) {
+	struct ospf *ospf = vty->index;
+
+	ospf->gr_enable = 1;
+	ospf->gr_period = OSPF_GR_PERIOD_DEFAULT;
+	if(argc == 1) {
+		VTY_GET_INTEGER_RANGE("grace period", ospf->gr_period, argv[0], OSPF_GR_PERIOD_MIN, OSPF_GR_PERIOD_MAX);
+	}
+	return CMD_SUCCESS;
+}
+
+ALIAS(ospf_graceful_restart, ospf_graceful_restart_period_cmd, "graceful-restart grace-period <1-1800>",
+      GRACEFUL_RESTART_STR "How long neighbors are to wait for the restart\n"
+			   "Seconds\n")
+
+DEFUN(no_ospf_graceful_restart, no_ospf_graceful_restart_cmd, "no graceful-restart", NO_STR GRACEFUL_RESTART_STR) {
+	struct ospf *ospf = vty->index;
+
+	ospf->gr_enable = 0;
+	ospf->gr_period = OSPF_GR_PERIOD_DEFAULT;
+	return CMD_SUCCESS;
+}
+
+DEFUN(ospf_graceful_restart_helper_disable, ospf_graceful_restart_helper_disable_cmd, "graceful-restart helper-disable",
+      GRACEFUL_RESTART_STR "Don't help neighbors restart\n") {
+	struct ospf *ospf = vty->index;
+	struct listnode *node;
+	struct ospf_interface *oi;
+	struct route_node *rn;
+	struct ospf_neighbor *nbr;
+
+	ospf->gr_helper_disable = 1;
+	for(ALL_LIST_ELEMENTS_RO(ospf->oiflist, node, oi)) {
+		for(rn = route_top(oi->nbrs); rn; rn = route_next(rn)) {
+			if((nbr = rn->info)) {
+				ospf_gr_helper_exit(nbr, "helping disabled");
+			}
+		}
+	}
+	return CMD_SUCCESS;
+}
+
+DEFUN(no_ospf_graceful_restart_helper_disable, no_ospf_graceful_restart_helper_disable_cmd, "no graceful-restart helper-disable",
+      NO_STR GRACEFUL_RESTART_STR "Don't help neighbors restart\n") {
+	struct ospf *ospf = vty->index;
+
+	ospf->gr_helper_disable = 0;
+	return CMD_SUCCESS;
+}
+
+DEFUN(graceful_restart_prepare, graceful_restart_prepare_cmd, "graceful-restart prepare ip ospf",
+      "Graceful restart\n"
+      "Get ready to restart, with the routes kept meanwhile\n" IP_STR OSPF_STR) {
+	struct ospf *ospf;
+	struct listnode *node;
+	struct ospf_interface *oi;
+
+	if((ospf = ospf_lookup()) == NULL) {
+		vty_out(vty, "%% OSPF is not running%s", VTY_NEWLINE);
+		return CMD_WARNING;
+	}
+	if(!ospf->gr_enable) {
+		vty_out(vty, "%% Graceful restart is not enabled%s", VTY_NEWLINE);
+		return CMD_WARNING;
+	}
+	if(!CHECK_FLAG(ospf->config, OSPF_OPAQUE_CAPABLE)) {
+		vty_out(vty, "%% The Grace-LSAs need \"capability opaque\"%s", VTY_NEWLINE);
+		return CMD_WARNING;
+	}
+	if(OSPF_GR_RESTARTING_P(ospf)) {
+		vty_out(vty, "%% Still restarting%s", VTY_NEWLINE);
+		return CMD_WARNING;
+	}
+
+	for(ALL_LIST_ELEMENTS_RO(ospf->oiflist, node, oi)) {
+		if(oi->state != ISM_Down) {
+			ospf_gr_lsa_originate(oi, ospf->gr_period);
+		}
+	}
+
+	if(ospf_gr_checkpoint_write(ospf) != 0) {
+		vty_out(vty, "%% Can't write %s%s", om->gr_file, VTY_NEWLINE);
+		ospf_gr_lsa_flush_all(ospf);
+		return CMD_WARNING;
+	}
+	ospf_zebra_graceful_restart(ospf->gr_period);
+
+	ospf->gr_state = OSPF_GR_PREPARED;
+	OSPF_TIMER_OFF(ospf->t_gr_restart);
+	ospf->t_gr_restart = thread_add_timer(master, ospf_gr_prepare_timer, ospf, ospf->gr_period);
+
+	zlog_info("Graceful restart: prepared, restart within %us", ospf->gr_period);
+	vty_out(vty, "Ready to restart within %u seconds%s", ospf->gr_period, VTY_NEWLINE);
+	return CMD_SUCCESS;
+}
+
+DEFUN(show_ip_ospf_graceful_restart, show_ip_ospf_graceful_restart_cmd, "show ip ospf graceful-restart",
+      SHOW_STR IP_STR "OSPF information\n"
+		      "Graceful restart\n") {
+	struct ospf *ospf;
+	struct listnode *node;
+	struct ospf_interface *oi;
+	struct route_node *rn;
+	struct ospf_neighbor *nbr;
+	const char *state;
+
+	if((ospf = ospf_lookup()) == NULL) {
+		vty_out(vty, " OSPF Routing Process not enabled%s", VTY_NEWLINE);
+		return CMD_SUCCESS;
+	}
+
+	if(ospf->gr_enable) {
+		vty_out(vty, " Graceful restart is enabled, grace period %us%s", ospf->gr_period, VTY_NEWLINE);
+	} else {
+		vty_out(vty, " Graceful restart is disabled%s", VTY_NEWLINE);
+	}
+	vty_out(vty, " Helping neighbors restart is %s%s", ospf->gr_helper_disable ? "disabled" : "enabled", VTY_NEWLINE);
+
+	switch(ospf->gr_state) {
+		case OSPF_GR_PREPARED: state = "prepared to restart"; break;
+		case OSPF_GR_RESTARTING: state = "restarting"; break;
+		default: state = NULL; break;
+	}
+	if(state) {
+		vty_out(vty, " State: %s, %us of the grace period left%s", state, ospf_gr_remain(ospf), VTY_NEWLINE);
+	}
+	if(ospf->gr) {
+		vty_out(vty, " Checkpoint: %lu LSAs, %u interfaces, as %s%s", ospf->gr->lsas->count, listcount(ospf->gr->ifs), inet_ntoa(ospf->gr->router_id), VTY_NEWLINE);
+	}
+
+	for(ALL_LIST_ELEMENTS_RO(ospf->oiflist, node, oi)) {
+		for(rn = route_top(oi->nbrs); rn; rn = route_next(rn)) {
+			if((nbr = rn->info) && nbr->gr_helper) {
+				vty_out(vty, " Helping %s on %s, %lus left%s", inet_ntoa(nbr->router_id), IF_NAME(oi), thread_timer_remain_second(nbr->t_gr_helper), VTY_NEWLINE);
+			}
+		}
+	}
+	return CMD_SUCCESS;
+}
+
+void ospf_gr_config_write_router(struct vty *vty, struct ospf *ospf) {
+	if(ospf->gr_enable) {
+		if(ospf->gr_period != OSPF_GR_PERIOD_DEFAULT) {
+			vty_out(vty, " graceful-restart grace-period %u%s", ospf->gr_period, VTY_NEWLINE);
+		} else {
+			vty_out(vty, " graceful-restart%s", VTY_NEWLINE);
+		}
+	}
+	if(ospf->gr_helper_disable) {
+		vty_out(vty, " graceful-restart helper-disable%s", VTY_NEWLINE);
+	}
+}
+
+void ospf_gr_init(void) {
+	ospf_register_opaque_functab(
+		OSPF_OPAQUE_LINK_LSA, OPAQUE_TYPE_GRACE_LSA, NULL /* new interface */, NULL /* del interface */, ospf_gr_ism_change, ospf_gr_nsm_change, NULL /* config write router */, NULL /* config write interface */,
+		NULL /* config write debug */, ospf_gr_show_info, NULL /* originator */, ospf_gr_lsa_refresh, NULL /* new_lsa_hook */, NULL /* del_lsa_hook */
+	);
+
+	install_element(VIEW_NODE, &show_ip_ospf_graceful_restart_cmd);
+	install_element(ENABLE_NODE, &graceful_restart_prepare_cmd);
+
+	install_element(OSPF_NODE, &ospf_graceful_restart_cmd);
+	install_element(OSPF_NODE, &ospf_graceful_restart_period_cmd);
+	install_element(OSPF_NODE, &no_ospf_graceful_restart_cmd);
+	install_element(OSPF_NODE, &ospf_graceful_restart_helper_disable_cmd);
+	install_element(OSPF_NODE, &no_ospf_graceful_restart_helper_disable_cmd);
+}
@@ -0,0 +1,70 @@
+/*
+ * OSPF graceful restart, RFC3623: helping neighbors through theirs and
+ * restarting with the forwarding kept in zebra, from a checkpoint of the
+ * self-originated LSAs.
+ *
+ * This file is part of GNU Zebra.
+ *
+ * GNU Zebra is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2, or (at your option) any
+ * later version.
+ *
+ * GNU Zebra is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with GNU Zebra; see the file COPYING.  If not, write to the Free
+ * Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ * 02111-1307, USA.
+ */
+
+#ifndef _ZEBRA_OSPF_GR_H
+#define _ZEBRA_OSPF_GR_H
+
+/* Grace-LSA TLVs, RFC3623 Appendix A. */
+#define OSPF_GR_TLV_PERIOD 1
+#define OSPF_GR_TLV_REASON 2
+#define OSPF_GR_TLV_ADDRESS 3
+
+#define OSPF_GR_REASON_UNKNOWN 0
+#define OSPF_GR_REASON_RESTART 1
+#define OSPF_GR_REASON_UPGRADE 2
+#define OSPF_GR_REASON_SWITCH 3
+
+/* Grace period, seconds. */
+#define OSPF_GR_PERIOD_MIN 1
+#define OSPF_GR_PERIOD_MAX 1800
+#define OSPF_GR_PERIOD_DEFAULT 120
+
+/* Where "graceful-restart prepare" leaves the checkpoint for the next
+   ospfd to start from. */
+#define OSPF_GR_FILE_DEFAULT DAEMON_VTY_DIR "/ospfd.gr"
+
+/* ospf->gr_state */
+#define OSPF_GR_NONE 0
+#define OSPF_GR_PREPARED 1   /* Grace-LSAs out, to restart */
+#define OSPF_GR_RESTARTING 2 /* LSAs and routes kept as they were */
+
+#define OSPF_GR_RESTARTING_P(O) ((O)->gr_state == OSPF_GR_RESTARTING)
+
+/* Fully adjacent, or as good as while it restarts. */
+#define OSPF_GR_NBR_FULL(N) ((N)->state == NSM_Full || (N)->gr_helper)
+
+extern void ospf_gr_init(void);
+extern void ospf_gr_config_write_router(struct vty *, struct ospf *);
+
+/* Restarter */
+extern void ospf_gr_start(struct ospf *);
+extern int ospf_gr_shutdown(struct ospf *);
+extern void ospf_gr_finish(struct ospf *);
+extern void ospf_gr_lsa_seqnum(struct ospf *, struct ospf_lsa *, struct ospf_lsa *);
+
+/* Helper */
+extern void ospf_gr_lsa_installed(struct ospf *, struct ospf_lsa *, int);
+extern void ospf_gr_helper_exit(struct ospf_neighbor *, const char *);
+extern u_int32_t ospf_gr_full_nbrs(struct ospf_interface *);
+
+#endif /* _ZEBRA_OSPF_GR_H */
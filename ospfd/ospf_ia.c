@@ -44,6 +44,7 @@
 #include "ospfd/ospf_abr.h"
 #include "ospfd/ospf_ia.h"
 #include "ospfd/ospf_dump.h"
+#include "ospfd/ospf_zebra.h"
 
 static struct ospf_route *ospf_find_abr_route(struct route_table *rtrs, struct prefix_ipv4 *abr, struct ospf_area *area) {
 	struct route_node *rn;
@@ -174,6 +175,22 @@ static void ospf_ia_router_route(struct ospf *ospf, struct route_table *rtrs, st
 	listnode_add(rn->info, new_or);
 }
 
+/* The destination a summary-LSA describes. */
+static void ospf_summary_lsa_prefix(struct ospf_lsa *lsa, struct prefix_ipv4 *p) {
+	struct summary_lsa *sl = (struct summary_lsa *) lsa->data;
+
+	p->family = AF_INET;
+	p->prefix = sl->header.id;
+
+	if(sl->header.type == OSPF_SUMMARY_LSA) {
+		p->prefixlen = ip_masklen(sl->mask);
+	} else {
+		p->prefixlen = IPV4_MAX_BITLEN;
+	}
+
+	apply_mask_ipv4(p);
+}
+
 static int process_summary_lsa(struct ospf_area *area, struct route_table *rt, struct route_table *rtrs, struct ospf_lsa *lsa) {
 	struct ospf *ospf = area->ospf;
 	struct ospf_area_range *range;
@@ -206,16 +223,7 @@ static int process_summary_lsa(struct ospf_area *area, struct route_table *rt, s
 		return 0;
 	}
 
-	p.family = AF_INET;
-	p.prefix = sl->header.id;
-
-	if(sl->header.type == OSPF_SUMMARY_LSA) {
-		p.prefixlen = ip_masklen(sl->mask);
-	} else {
-		p.prefixlen = IPV4_MAX_BITLEN;
-	}
-
-	apply_mask_ipv4(&p);
+	ospf_summary_lsa_prefix(lsa, &p);
 
 	if(sl->header.type == OSPF_SUMMARY_LSA && (range = ospf_area_range_match_any(ospf, &p)) && ospf_area_range_active(range)) {
 		return 0;
@@ -270,6 +278,175 @@ static void ospf_examine_summaries(struct ospf_area *area, struct route_table *l
 	process_summary_lsa(area, rt, rtrs, lsa);
 }
 
+/* Examine the summary-LSAs for destination p alone.  The LSDB is keyed
+   by Link State ID first: the LSAs for p, host bits set in their ID or
+   not, all sort under p. */
+static void ospf_examine_summaries_prefix(struct ospf_area *area, struct route_table *lsdb_rt, struct prefix_ipv4 *p, struct route_table *rt, struct route_table *rtrs) {
+	struct prefix_ipv4 lsa_p;
+	struct prefix_ls lp;
+	struct route_node *rn;
+	struct ospf_lsa *lsa;
+
+	memset(&lp, 0, sizeof(struct prefix_ls));
+	lp.prefixlen = p->prefixlen;
+	lp.id = p->prefix;
+
+	for(rn = route_table_get_next(lsdb_rt, (struct prefix *) &lp); rn; rn = route_next(rn)) {
+		if(!prefix_match((struct prefix *) &lp, &rn->p)) {
+			route_unlock_node(rn);
+			break;
+		}
+		if((lsa = rn->info) == NULL) {
+			continue;
+		}
+		ospf_summary_lsa_prefix(lsa, &lsa_p);
+		if(prefix_same((struct prefix *) &lsa_p, (struct prefix *) p)) {
+			process_summary_lsa(area, rt, rtrs, lsa);
+		}
+	}
+}
+
+/* The inter-area route to network p, again. */
+static void ospf_ia_network_update(struct ospf *ospf, struct prefix_ipv4 *p) {
+	struct ospf_route *old = NULL, *new = NULL;
+	struct ospf_area *area;
+	struct route_node *rn;
+	struct listnode *node;
+
+	if((rn = route_node_lookup(ospf->new_table, (struct prefix *) p))) {
+		old = rn->info;
+
+		/* Intra-area routes are preferred over any summary. */
+		if(old && old->path_type != OSPF_PATH_INTER_AREA) {
+			route_unlock_node(rn);
+			return;
+		}
+		if(old) {
+			rn->info = NULL;
+			route_unlock_node(rn);
+		}
+		route_unlock_node(rn);
+	}
+
+	for(ALL_LIST_ELEMENTS_RO(ospf->areas, node, area)) {
+		ospf_examine_summaries_prefix(area, SUMMARY_LSDB(area), p, ospf->new_table, ospf->new_rtrs);
+	}
+
+	if((rn = route_node_lookup(ospf->new_table, (struct prefix *) p))) {
+		new = rn->info;
+		route_unlock_node(rn);
+	}
+
+	if(IS_DEBUG_OSPF_EVENT) {
+		zlog_debug("%s: %s/%d, %s", __func__, inet_ntoa(p->prefix), p->prefixlen, new ? (old ? "updated" : "added") : (old ? "removed" : "unreachable"));
+	}
+
+	if(new) {
+		/* withdraws the external route it overrides, if any */
+		if(old == NULL) {
+			ospf_ase_prefix_update(ospf, p);
+		}
+		if(old == NULL || !ospf_route_same(old, new)) {
+			ospf_zebra_add(p, new);
+		}
+	} else if(old) {
+		ospf_zebra_delete(p, old);
+		/* an external route may take over */
+		ospf_ase_prefix_update(ospf, p);
+	}
+
+	/* Forwarding addresses of AS-external-LSAs are looked up in here. */
+	if((old || new) && (old == NULL || new == NULL || !ospf_route_same(old, new)) && ospf->ase_fwd_count) {
+		ospf_ase_calculate_schedule(ospf);
+		ospf_ase_calculate_timer_add(ospf);
+	}
+
+	if(old) {
+		ospf_route_free(old);
+	}
+}
+
+/* The inter-area routes to ASBR p, again. */
+static void ospf_ia_asbr_update(struct ospf *ospf, struct prefix_ipv4 *p) {
+	struct ospf_route * or, *old_best, *new_best;
+	struct listnode *node, *nnode;
+	struct ospf_area *area;
+	struct route_node *rn;
+	struct list *old;
+
+	old = list_new();
+	old_best = ospf_find_asbr_route(ospf, ospf->new_rtrs, p);
+
+	/* Routes from the areas' SPF stay, those from summaries go. */
+	if((rn = route_node_lookup(ospf->new_rtrs, (struct prefix *) p))) {
+		for(ALL_LIST_ELEMENTS((struct list *) rn->info, node, nnode, or)) {
+			if(or->path_type == OSPF_PATH_INTER_AREA) {
+				list_delete_node((struct list *) rn->info, node);
+				listnode_add(old, or);
+			}
+		}
+		route_unlock_node(rn);
+	}
+
+	for(ALL_LIST_ELEMENTS_RO(ospf->areas, node, area)) {
+		ospf_examine_summaries_prefix(area, ASBR_SUMMARY_LSDB(area), p, ospf->new_table, ospf->new_rtrs);
+	}
+
+	new_best = ospf_find_asbr_route(ospf, ospf->new_rtrs, p);
+
+	if(IS_DEBUG_OSPF_EVENT) {
+		zlog_debug("%s: ASBR %s, %s", __func__, inet_ntoa(p->prefix), ospf_ase_asbr_route_same(old_best, new_best) ? "unchanged" : "changed");
+	}
+
+	if(!ospf_ase_asbr_route_same(old_best, new_best)) {
+		ospf_ase_asbr_update(ospf, p->prefix);
+	}
+
+	for(ALL_LIST_ELEMENTS_RO(old, node, or)) {
+		ospf_route_free(or);
+	}
+	list_delete(old);
+
+	/* as ospf_prune_unreachable_routers() would */
+	if((rn = route_node_lookup(ospf->new_rtrs, (struct prefix *) p))) {
+		route_unlock_node(rn);
+		if(rn->info && listcount((struct list *) rn->info) == 0) {
+			list_delete(rn->info);
+			rn->info = NULL;
+			route_unlock_node(rn);
+		}
+	}
+}
+
+/* Partial route calculation, RFC2328 16.5: a summary-LSA changed, or is
+ * going, so examine the summaries for its destination alone, on top of
+ * the routes from the last SPF calculation.  Returns 0 if the routing
+ * table is to be calculated again instead.
+ */
+int ospf_ia_incremental_update(struct ospf *ospf, struct ospf_lsa *lsa) {
+	struct prefix_ipv4 p;
+
+	/* Nothing to build on, or it is about to be rebuilt. */
+	if(ospf->new_table == NULL || ospf->new_rtrs == NULL || ospf->t_spf_calc) {
+		return 0;
+	}
+
+	/* Area border routers examine the summaries of some areas only,
+     by transit capability, and originate their own from the result. */
+	if(IS_OSPF_ABR(ospf)) {
+		return 0;
+	}
+
+	ospf_summary_lsa_prefix(lsa, &p);
+
+	if(lsa->data->type == OSPF_SUMMARY_LSA) {
+		ospf_ia_network_update(ospf, &p);
+	} else {
+		ospf_ia_asbr_update(ospf, &p);
+	}
+	return 1;
+}
+
 int ospf_area_is_transit(struct ospf_area *area) {
 	return (area->transit == OSPF_TRANSIT_TRUE) || ospf_full_virtual_nbrs(area); /* Cisco forgets to set the V-bit :( */
 }
@@ -363,17 +363,15 @@ int ospf_if_is_up(struct ospf_interface *oi) {
 }
 
 struct ospf_interface *ospf_if_exists(struct ospf_interface *oic) {
-	struct listnode *node;
+	struct listnode *node, *onode;
 	struct ospf *ospf;
 	struct ospf_interface *oi;
 
-	if((ospf = ospf_lookup()) == NULL) {
-		return NULL;
-	}
-
-	for(ALL_LIST_ELEMENTS_RO(ospf->oiflist, node, oi)) {
-		if(oi == oic) {
-			return oi;
+	for(ALL_LIST_ELEMENTS_RO(om->ospf, onode, ospf)) {
+		for(ALL_LIST_ELEMENTS_RO(ospf->oiflist, node, oi)) {
+			if(oi == oic) {
+				return oi;
+			}
 		}
 	}
 
@@ -476,16 +474,14 @@ void ospf_if_stream_set(struct ospf_interface *oi) {
 }
 
 void ospf_if_stream_unset(struct ospf_interface *oi) {
-	struct ospf *ospf = oi->ospf;
-
 	if(oi->obuf) {
 		ospf_fifo_free(oi->obuf);
 		oi->obuf = NULL;
 
 		if(oi->on_write_q) {
-			listnode_delete(ospf->oi_write_q, oi);
-			if(list_isempty(ospf->oi_write_q)) {
-				OSPF_TIMER_OFF(ospf->t_write);
+			listnode_delete(om->oi_write_q, oi);
+			if(list_isempty(om->oi_write_q)) {
+				OSPF_TIMER_OFF(om->t_write);
 			}
 			oi->on_write_q = 0;
 		}
@@ -507,6 +503,8 @@ static struct ospf_if_params *ospf_new_if_params(void) {
 	UNSET_IF_PARAM(oip, passive_interface);
 	UNSET_IF_PARAM(oip, v_hello);
 	UNSET_IF_PARAM(oip, fast_hello);
+	UNSET_IF_PARAM(oip, flood_pacing);
+	UNSET_IF_PARAM(oip, flood_burst);
 	UNSET_IF_PARAM(oip, v_wait);
 	UNSET_IF_PARAM(oip, priority);
 	UNSET_IF_PARAM(oip, type);
@@ -543,7 +541,7 @@ void ospf_free_if_params(struct interface *ifp, struct in_addr addr) {
 	route_unlock_node(rn);
 
 	if(!OSPF_IF_PARAM_CONFIGURED(oip, output_cost_cmd) && !OSPF_IF_PARAM_CONFIGURED(oip, transmit_delay) && !OSPF_IF_PARAM_CONFIGURED(oip, retransmit_interval) && !OSPF_IF_PARAM_CONFIGURED(oip, passive_interface)
-	   && !OSPF_IF_PARAM_CONFIGURED(oip, v_hello) && !OSPF_IF_PARAM_CONFIGURED(oip, fast_hello) && !OSPF_IF_PARAM_CONFIGURED(oip, v_wait) && !OSPF_IF_PARAM_CONFIGURED(oip, priority) && !OSPF_IF_PARAM_CONFIGURED(oip, type)
+	   && !OSPF_IF_PARAM_CONFIGURED(oip, v_hello) && !OSPF_IF_PARAM_CONFIGURED(oip, fast_hello) && !OSPF_IF_PARAM_CONFIGURED(oip, flood_pacing) && !OSPF_IF_PARAM_CONFIGURED(oip, flood_burst) && !OSPF_IF_PARAM_CONFIGURED(oip, v_wait) && !OSPF_IF_PARAM_CONFIGURED(oip, priority) && !OSPF_IF_PARAM_CONFIGURED(oip, type)
 	   && !OSPF_IF_PARAM_CONFIGURED(oip, auth_simple) && !OSPF_IF_PARAM_CONFIGURED(oip, auth_type) && listcount(oip->auth_crypt) == 0 && ntohl(oip->network_lsa_seqnum) != OSPF_INITIAL_SEQUENCE_NUMBER) {
 		ospf_del_if_params(oip);
 		rn->info = NULL;
@@ -619,11 +617,19 @@ int ospf_if_new_hook(struct interface *ifp) {
 	SET_IF_PARAM(IF_DEF_PARAMS(ifp), retransmit_interval);
 	IF_DEF_PARAMS(ifp)->retransmit_interval = OSPF_RETRANSMIT_INTERVAL_DEFAULT;
 
+	SET_IF_PARAM(IF_DEF_PARAMS(ifp), flood_pacing);
+	IF_DEF_PARAMS(ifp)->flood_pacing = OSPF_FLOOD_PACING_DEFAULT;
+
+	SET_IF_PARAM(IF_DEF_PARAMS(ifp), flood_burst);
+	IF_DEF_PARAMS(ifp)->flood_burst = OSPF_FLOOD_BURST_DEFAULT;
+
 	SET_IF_PARAM(IF_DEF_PARAMS(ifp), priority);
 	IF_DEF_PARAMS(ifp)->priority = OSPF_ROUTER_PRIORITY_DEFAULT;
 
 	IF_DEF_PARAMS(ifp)->mtu_ignore = OSPF_MTU_IGNORE_DEFAULT;
 
+	IF_DEF_PARAMS(ifp)->bfd = 0;
+
 	SET_IF_PARAM(IF_DEF_PARAMS(ifp), v_hello);
 	IF_DEF_PARAMS(ifp)->v_hello = OSPF_HELLO_INTERVAL_DEFAULT;
 
@@ -648,6 +654,7 @@ static int ospf_if_delete_hook(struct interface *ifp) {
 	struct route_node *rn;
 	rc = ospf_opaque_del_if(ifp);
 
+	ospf_read_if_flush(ifp);
 	route_table_finish(IF_OIFS(ifp));
 
 	for(rn = route_top(IF_OIFS_PARAMS(ifp)); rn; rn = route_next(rn)) {
@@ -734,6 +741,7 @@ int ospf_if_up(struct ospf_interface *oi) {
 		ospf_if_stream_set(oi);
 		OSPF_ISM_EVENT_SCHEDULE(oi, ISM_InterfaceUp);
 	}
+	ospf_sock_filter_update();
 
 	return 1;
 }
@@ -749,6 +757,7 @@ int ospf_if_down(struct ospf_interface *oi) {
 	oi->lsa_pos_end = 0;
 	/* Shutdown packet reception and sending */
 	ospf_if_stream_unset(oi);
+	ospf_sock_filter_update();
 
 	return 1;
 }
@@ -931,9 +940,8 @@ void ospf_vl_delete(struct ospf *ospf, struct ospf_vl_data *vl_data) {
 static int ospf_vl_set_params(struct ospf_vl_data *vl_data, struct vertex *v) {
 	int changed = 0;
 	struct ospf_interface *voi;
-	struct listnode *node;
 	struct vertex_parent *vp = NULL;
-	unsigned int i;
+	unsigned int i, n;
 	struct router_lsa *rl;
 
 	voi = vl_data->vl_oi;
@@ -943,7 +951,7 @@ static int ospf_vl_set_params(struct ospf_vl_data *vl_data, struct vertex *v) {
 		changed = 1;
 	}
 
-	for(ALL_LIST_ELEMENTS_RO(v->parents, node, vp)) {
+	for(SPF_ARRAY_ELEMENTS(&v->parents, n, vp)) {
 		vl_data->nexthop.oi = vp->nexthop->oi;
 		vl_data->nexthop.router = vp->nexthop->router;
 
@@ -1092,6 +1100,15 @@ struct crypt_key *ospf_crypt_key_new() {
 	return XCALLOC(MTYPE_OSPF_CRYPT_KEY, sizeof(struct crypt_key));
 }
 
+void ospf_crypt_key_set(struct crypt_key *ck, int hash, const char *key) {
+	size_t max = (hash == AUTH_HASH_MD5) ? OSPF_AUTH_MD5_SIZE : OSPF_AUTH_CRYPT_KEY_SIZE;
+
+	ck->hash = hash;
+	memset(ck->auth_key, 0, sizeof(ck->auth_key));
+	strncpy((char *) ck->auth_key, key, max);
+	auth_key_set(&ck->key, hash, ck->auth_key, strlen((char *) ck->auth_key));
+}
+
 void ospf_crypt_key_add(struct list *crypt, struct crypt_key *ck) {
 	listnode_add(crypt, ck);
 }
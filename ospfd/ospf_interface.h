@@ -23,6 +23,7 @@
 #ifndef _ZEBRA_OSPF_INTERFACE_H
 #define _ZEBRA_OSPF_INTERFACE_H
 
+#include "auth_hash.h"
 #include "ospfd/ospf_packet.h"
 #include "ospfd/ospf_spf.h"
 
@@ -68,9 +69,16 @@ struct ospf_if_params {
 	/* MTU mismatch check (see RFC2328, chap 10.6) */
 	DECLARE_IF_PARAM(u_char, mtu_ignore);
 
+	/* BFD sessions to the neighbours, see ospf_bfd.c */
+	DECLARE_IF_PARAM(u_char, bfd);
+
 	/* Fast-Hellos */
 	DECLARE_IF_PARAM(u_char, fast_hello);
 
+	/* LS Update pacing: msec between rounds, 0 for none, packets a round */
+	DECLARE_IF_PARAM(u_int32_t, flood_pacing);
+	DECLARE_IF_PARAM(u_int32_t, flood_burst);
+
 	/* Authentication data. */
 	u_char auth_simple[OSPF_AUTH_SIMPLE_SIZE + 1]; /* Simple password. */
 	u_char auth_simple__config : 1;
@@ -93,6 +101,11 @@ struct ospf_if_info {
 	struct route_table *params;
 	struct route_table *oifs;
 	unsigned int membership_counts[MEMBER_MAX]; /* multicast group refcnts */
+
+	/* Received packets, Hellos and LS Acks apart, see ospf_read(). */
+	struct ospf_fifo *read_urgent;
+	struct ospf_fifo *read_normal;
+	u_char on_read_q;
 };
 
 struct ospf_interface;
@@ -114,7 +127,9 @@ struct ospf_vl_data {
 
 struct crypt_key {
 	u_char key_id;
-	u_char auth_key[OSPF_AUTH_MD5_SIZE + 1];
+	u_char hash; /* enum auth_hash_type */
+	u_char auth_key[OSPF_AUTH_CRYPT_KEY_SIZE + 1];
+	struct auth_key key; /* auth_key made ready for it */
 };
 
 /* OSPF interface structure. */
@@ -181,8 +196,12 @@ struct ospf_interface {
 	/* self-originated LSAs. */
 	struct ospf_lsa *network_lsa_self; /* network-LSA. */
 	struct list *opaque_lsa_self;	   /* Type-9 Opaque-LSAs */
+	u_char gr_lsa_self;		   /* a Grace-LSA is out, see ospf_gr.c */
 
 	struct route_table *ls_upd_queue;
+	unsigned long ls_upd_count;	/* LSAs on it */
+	unsigned long ls_upd_count_max; /* most there have been */
+	struct timeval ls_upd_last;	/* last round of updates sent */
 
 	struct list *ls_ack; /* Link State Acknowledgment list. */
 
@@ -199,7 +218,7 @@ struct ospf_interface {
 	struct thread *t_wait;		  /* timer */
 	struct thread *t_ls_ack;	  /* timer */
 	struct thread *t_ls_ack_direct;	  /* event */
-	struct thread *t_ls_upd_event;	  /* event */
+	struct thread *t_ls_upd_event;	  /* event, or pacing timer */
 	struct thread *t_opaque_lsa_self; /* Type-9 Opaque-LSAs */
 
 	int on_write_q;
@@ -272,6 +291,7 @@ extern int ospf_vls_in_area(struct ospf_area *);
 
 extern struct crypt_key *ospf_crypt_key_lookup(struct list *, u_char);
 extern struct crypt_key *ospf_crypt_key_new(void);
+extern void ospf_crypt_key_set(struct crypt_key *, int hash, const char *key);
 extern void ospf_crypt_key_add(struct list *, struct crypt_key *);
 extern int ospf_crypt_key_delete(struct list *, u_char);
 
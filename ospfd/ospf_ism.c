@@ -44,6 +44,7 @@
 #include "ospfd/ospf_flood.h"
 #include "ospfd/ospf_abr.h"
 #include "ospfd/ospf_snmp.h"
+#include "ospfd/ospf_gr.h"
 
 /* elect DR and BDR. Refer to RFC2319 section 9.4 */
 static struct ospf_neighbor *ospf_dr_election_sub(struct list *routers) {
@@ -553,7 +554,7 @@ static void ism_change_state(struct ospf_interface *oi, int state) {
 	} else if(old_state == ISM_DR && state != ISM_DR) {
 		/* Free self originated network LSA. */
 		lsa = oi->network_lsa_self;
-		if(lsa) {
+		if(lsa && !OSPF_GR_RESTARTING_P(oi->ospf)) {
 			ospf_lsa_flush_area(lsa, oi->area);
 		}
 
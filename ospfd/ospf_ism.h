@@ -49,13 +49,13 @@
 #define ISM_InterfaceDown 7
 #define OSPF_ISM_EVENT_MAX 8
 
-#define OSPF_ISM_WRITE_ON(O) \
+#define OSPF_ISM_WRITE_ON() \
 	do { \
 		if(oi->on_write_q == 0) { \
-			listnode_add((O)->oi_write_q, oi); \
+			listnode_add(om->oi_write_q, oi); \
 			oi->on_write_q = 1; \
 		} \
-		if((O)->t_write == NULL) (O)->t_write = thread_add_write(master, ospf_write, (O), (O)->fd); \
+		if(om->t_write == NULL) om->t_write = thread_add_write(master, ospf_write, NULL, om->fd); \
 	} while(0)
 
 /* Macro for OSPF ISM timer turn on. */
@@ -48,8 +48,10 @@
 #include "ospfd/ospf_dump.h"
 #include "ospfd/ospf_route.h"
 #include "ospfd/ospf_ase.h"
+#include "ospfd/ospf_ia.h"
 #include "ospfd/ospf_zebra.h"
 #include "ospfd/ospf_abr.h"
+#include "ospfd/ospf_gr.h"
 
 u_int32_t get_metric(u_char *metric) {
 	u_int32_t m;
@@ -401,7 +403,7 @@ struct ospf_neighbor *ospf_nbr_lookup_ptop(struct ospf_interface *oi) {
 	for(rn = route_top(oi->nbrs); rn; rn = route_next(rn)) {
 		if((nbr = rn->info)) {
 			if(!IPV4_ADDR_SAME(&nbr->router_id, &oi->ospf->router_id)) {
-				if(nbr->state == NSM_Full) {
+				if(OSPF_GR_NBR_FULL(nbr)) {
 					route_unlock_node(rn);
 					break;
 				}
@@ -480,7 +482,7 @@ static int lsa_link_ptop_set(struct stream *s, struct ospf_interface *oi) {
 	}
 
 	if((nbr = ospf_nbr_lookup_ptop(oi))) {
-		if(nbr->state == NSM_Full) {
+		if(OSPF_GR_NBR_FULL(nbr)) {
 			/* For unnumbered point-to-point networks, the Link Data field
 	   should specify the interface's MIB-II ifIndex value. */
 			links += link_info_set(s, nbr->router_id, oi->address->u.prefix4, LSA_LINK_TYPE_POINTOPOINT, 0, cost);
@@ -518,7 +520,7 @@ static int lsa_link_broadcast_set(struct stream *s, struct ospf_interface *oi) {
 
 	dr = ospf_nbr_lookup_by_addr(oi->nbrs, &DR(oi));
 	/* Describe Type 2 link. */
-	if(dr && (dr->state == NSM_Full || IPV4_ADDR_SAME(&oi->address->u.prefix4, &DR(oi))) && ospf_nbr_count(oi, NSM_Full) > 0) {
+	if(dr && (OSPF_GR_NBR_FULL(dr) || IPV4_ADDR_SAME(&oi->address->u.prefix4, &DR(oi))) && ospf_gr_full_nbrs(oi) > 0) {
 		if(IS_DEBUG_OSPF(lsa, LSA_GENERATE)) {
 			zlog_debug(
 				"LSA[Type1]: Interface %s has a DR. "
@@ -563,7 +565,7 @@ static int lsa_link_virtuallink_set(struct stream *s, struct ospf_interface *oi)
 
 	if(oi->state == ISM_PointToPoint) {
 		if((nbr = ospf_nbr_lookup_ptop(oi))) {
-			if(nbr->state == NSM_Full) {
+			if(OSPF_GR_NBR_FULL(nbr)) {
 				return link_info_set(s, nbr->router_id, oi->address->u.prefix4, LSA_LINK_TYPE_VIRTUALLINK, 0, cost);
 			}
 		}
@@ -598,7 +600,7 @@ static int lsa_link_ptomp_set(struct stream *s, struct ospf_interface *oi) {
 		if((nbr = rn->info) != NULL) {
 			/* Ignore myself. */
 			if(!IPV4_ADDR_SAME(&nbr->router_id, &oi->ospf->router_id)) {
-				if(nbr->state == NSM_Full)
+				if(OSPF_GR_NBR_FULL(nbr))
 
 				{
 					links += link_info_set(s, nbr->router_id, oi->address->u.prefix4, LSA_LINK_TYPE_POINTOPOINT, 0, cost);
@@ -843,6 +845,11 @@ int ospf_router_lsa_update_area(struct ospf_area *area) {
 		zlog_debug("[router-LSA]: (router-LSA area update)");
 	}
 
+	/* Restarting, the neighbors still have the one from before. */
+	if(OSPF_GR_RESTARTING_P(area->ospf)) {
+		return 0;
+	}
+
 	/* Now refresh router-LSA. */
 	if(area->router_lsa_self) {
 		ospf_lsa_refresh(area->ospf, area->router_lsa_self);
@@ -863,6 +870,10 @@ int ospf_router_lsa_update(struct ospf *ospf) {
 		zlog_debug("Timer[router-LSA Update]: (timer expire)");
 	}
 
+	if(OSPF_GR_RESTARTING_P(ospf)) {
+		return 0;
+	}
+
 	for(ALL_LIST_ELEMENTS(ospf->areas, node, nnode, area)) {
 		struct ospf_lsa *lsa = area->router_lsa_self;
 		struct router_lsa *rl;
@@ -921,7 +932,7 @@ static void ospf_network_lsa_body_set(struct stream *s, struct ospf_interface *o
 
 	for(rn = route_top(oi->nbrs); rn; rn = route_next(rn)) {
 		if((nbr = rn->info) != NULL) {
-			if(nbr->state == NSM_Full || nbr == oi->nbr_self) {
+			if(OSPF_GR_NBR_FULL(nbr) || nbr == oi->nbr_self) {
 				stream_put_ipv4(s, nbr->router_id.s_addr);
 			}
 		}
@@ -937,7 +948,7 @@ static struct ospf_lsa *ospf_network_lsa_new(struct ospf_interface *oi) {
 
 	/* If there are no neighbours on this network (the net is stub),
      the router does not originate network-LSA (see RFC 12.4.2) */
-	if(oi->full_nbrs == 0) {
+	if(ospf_gr_full_nbrs(oi) == 0) {
 		return NULL;
 	}
 
@@ -992,6 +1003,10 @@ static struct ospf_lsa *ospf_network_lsa_new(struct ospf_interface *oi) {
 void ospf_network_lsa_update(struct ospf_interface *oi) {
 	struct ospf_lsa *new;
 
+	if(OSPF_GR_RESTARTING_P(oi->ospf)) {
+		return;
+	}
+
 	if(oi->network_lsa_self != NULL) {
 		ospf_lsa_refresh(oi->ospf, oi->network_lsa_self);
 		return;
@@ -1845,6 +1860,11 @@ int is_prefix_default(struct prefix_ipv4 *p) {
 struct ospf_lsa *ospf_external_lsa_originate(struct ospf *ospf, struct external_info *ei) {
 	struct ospf_lsa *new;
 
+	/* Restarting: what was redistributed is still out there. */
+	if(OSPF_GR_RESTARTING_P(ospf)) {
+		return NULL;
+	}
+
 	/* Added for NSSA project....
 
        External LSAs are originated in ASBRs as usual, but for NSSA systems.
@@ -1928,14 +1948,13 @@ int ospf_external_lsa_originate_timer(struct thread *thread) {
 
 	ospf->t_external_lsa = NULL;
 
-	/* Originate As-external-LSA from all type of distribute source. */
+	/* Originate As-external-LSA from all type of distribute source,
+	 * paced with what zebra sends. */
 	if((rt = EXTERNAL_INFO(type))) {
 		for(rn = route_top(rt); rn; rn = route_next(rn)) {
 			if((ei = rn->info) != NULL) {
 				if(!is_prefix_default((struct prefix_ipv4 *) &ei->p)) {
-					if(!ospf_external_lsa_originate(ospf, ei)) {
-						zlog_warn("LSA: AS-external-LSA was not originated.");
-					}
+					ospf_external_pending_add(ospf, &ei->p);
 				}
 			}
 		}
@@ -2128,6 +2147,10 @@ struct ospf_lsa *ospf_external_lsa_refresh(struct ospf *ospf, struct ospf_lsa *l
 	struct ospf_lsa *new;
 	int changed;
 
+	if(OSPF_GR_RESTARTING_P(ospf)) {
+		return NULL;
+	}
+
 	/* Check the AS-external-LSA should be originated. */
 	if(!ospf_redistribute_check(ospf, ei, &changed)) {
 		if(IS_DEBUG_OSPF(lsa, LSA_GENERATE)) {
@@ -2262,13 +2285,9 @@ static struct ospf_lsa *ospf_summary_lsa_install(struct ospf *ospf, struct ospf_
 	 destination is an AS boundary router, it may also be
 	 necessary to re-examine all the AS-external-LSAs.
       */
-
-#if 0
-      /* This doesn't exist yet... */
-      ospf_summary_incremental_update(new); */
-#else /* #if 0 */
-		ospf_spf_calculate_schedule(ospf, SPF_FLAG_SUMMARY_LSA_INSTALL);
-#endif /* #if 0 */
+		if(!ospf_ia_incremental_update(ospf, new)) {
+			ospf_spf_calculate_schedule(ospf, SPF_FLAG_SUMMARY_LSA_INSTALL);
+		}
 	}
 
 	if(IS_LSA_SELF(new)) {
@@ -2287,15 +2306,9 @@ static struct ospf_lsa *ospf_summary_asbr_lsa_install(struct ospf *ospf, struct
 	 destination is an AS boundary router, it may also be
 	 necessary to re-examine all the AS-external-LSAs.
       */
-#if 0
-      /* These don't exist yet... */
-      ospf_summary_incremental_update(new);
-      /* Isn't this done by the above call? 
-	 - RFC 2328 Section 16.5 implies it should be */
-      /* ospf_ase_calculate_schedule(); */
-#else /* #if 0 */
-		ospf_spf_calculate_schedule(ospf, SPF_FLAG_ASBR_SUMMARY_LSA_INSTALL);
-#endif /* #if 0 */
+		if(!ospf_ia_incremental_update(ospf, new)) {
+			ospf_spf_calculate_schedule(ospf, SPF_FLAG_ASBR_SUMMARY_LSA_INSTALL);
+		}
 	}
 
 	/* register LSA to refresh-list. */
@@ -2435,6 +2448,9 @@ struct ospf_lsa *ospf_lsa_install(struct ospf *ospf, struct ospf_interface *oi,
      update is needed */
 	old = ospf_lsdb_lookup(lsdb, lsa);
 
+	/* Restarted, number it past what was there before. */
+	ospf_gr_lsa_seqnum(ospf, lsa, old);
+
 	/* Do comparision and record if recalc needed. */
 	rt_recalc = 0;
 	if(old == NULL || ospf_lsa_different(old, lsa)) {
@@ -2545,6 +2561,8 @@ struct ospf_lsa *ospf_lsa_install(struct ospf *ospf, struct ospf_interface *oi,
 		ospf_lsa_maxage(ospf, lsa);
 	}
 
+	ospf_gr_lsa_installed(ospf, new, rt_recalc);
+
 	return new;
 }
 
@@ -2737,6 +2755,12 @@ static int ospf_lsa_maxage_walker_remover(struct ospf *ospf, struct ospf_lsa *ls
 					break;
 				case OSPF_AS_EXTERNAL_LSA:
 				case OSPF_AS_NSSA_LSA: ospf_ase_incremental_update(ospf, lsa); break;
+				case OSPF_SUMMARY_LSA:
+				case OSPF_ASBR_SUMMARY_LSA:
+					if(!ospf_ia_incremental_update(ospf, lsa)) {
+						ospf_spf_calculate_schedule(ospf, SPF_FLAG_MAXAGE);
+					}
+					break;
 				default: ospf_spf_calculate_schedule(ospf, SPF_FLAG_MAXAGE); break;
 			}
 			ospf_lsa_maxage(ospf, lsa);
@@ -2821,7 +2845,7 @@ struct ospf_lsa *ospf_lsa_lookup_by_prefix(struct ospf_lsdb *lsdb, u_char type,
 }
 
 struct ospf_lsa *ospf_lsa_lookup(struct ospf_area *area, u_int32_t type, struct in_addr id, struct in_addr adv_router) {
-	struct ospf *ospf = ospf_lookup();
+	struct ospf *ospf = area->ospf;
 	assert(ospf);
 
 	switch(type) {
@@ -3283,7 +3307,7 @@ struct ospf_lsa *ospf_lsa_refresh(struct ospf *ospf, struct ospf_lsa *lsa) {
 			if(CHECK_FLAG(lsa->flags, OSPF_LSA_LOCAL_XLT)) {
 				break;
 			}
-			ei = ospf_external_info_check(lsa);
+			ei = ospf_external_info_check(ospf, lsa);
 			if(ei) {
 				new = ospf_external_lsa_refresh(ospf, lsa, ei, LSA_REFRESH_FORCE);
 			} else {
@@ -3298,6 +3322,46 @@ struct ospf_lsa *ospf_lsa_refresh(struct ospf *ospf, struct ospf_lsa *lsa) {
 	return new;
 }
 
+/* LSAs a slot takes before registering spreads them over earlier slots:
+ * a little more than an even share of one refresh period. */
+unsigned long ospf_refresher_slot_limit(struct ospf *ospf) {
+	return ospf->lsa_refresh_queue.count / OSPF_LSA_REFRESHER_WINDOW + OSPF_LSA_REFRESHER_SLOT_MIN;
+}
+
+/* The slot 'offset' slots after the current one, or if that is full the
+ * nearest earlier one with room, up to a refresh period earlier, failing
+ * which the nearest later one within the jitter.  Refreshing early only
+ * costs a refresh, so this evens out bursts such as a restart or a mass
+ * redistribution, whose LSAs would otherwise stay due together. */
+static u_int16_t ospf_refresher_slot(struct ospf *ospf, u_int16_t current_index, int offset) {
+	unsigned long limit = ospf_refresher_slot_limit(ospf);
+	struct list *slot;
+	int i;
+
+#define OSPF_REFRESHER_SLOT_FULL(O)                                                                  \
+	((slot = ospf->lsa_refresh_queue.qs[(current_index + (O)) % OSPF_LSA_REFRESHER_SLOTS]) != NULL \
+	 && listcount(slot) >= limit)
+
+	if(!OSPF_REFRESHER_SLOT_FULL(offset)) {
+		return (current_index + offset) % OSPF_LSA_REFRESHER_SLOTS;
+	}
+	for(i = offset - 1; i >= 0 && i >= offset - OSPF_LSA_REFRESHER_WINDOW; i--) {
+		if(!OSPF_REFRESHER_SLOT_FULL(i)) {
+			ospf->lsa_refresh_queue.spread++;
+			return (current_index + i) % OSPF_LSA_REFRESHER_SLOTS;
+		}
+	}
+	for(i = offset + 1; i < OSPF_LSA_REFRESHER_SLOTS && i <= offset + OSPF_LS_REFRESH_JITTER / OSPF_LSA_REFRESHER_GRANULARITY; i++) {
+		if(!OSPF_REFRESHER_SLOT_FULL(i)) {
+			ospf->lsa_refresh_queue.spread++;
+			return (current_index + i) % OSPF_LSA_REFRESHER_SLOTS;
+		}
+	}
+#undef OSPF_REFRESHER_SLOT_FULL
+
+	return (current_index + offset) % OSPF_LSA_REFRESHER_SLOTS;
+}
+
 void ospf_refresher_register_lsa(struct ospf *ospf, struct ospf_lsa *lsa) {
 	u_int16_t index, current_index;
 
@@ -3321,7 +3385,7 @@ void ospf_refresher_register_lsa(struct ospf *ospf, struct ospf_lsa *lsa) {
 
 		current_index = ospf->lsa_refresh_queue.index + (quagga_time(NULL) - ospf->lsa_refresher_started) / OSPF_LSA_REFRESHER_GRANULARITY;
 
-		index = (current_index + delay / OSPF_LSA_REFRESHER_GRANULARITY) % (OSPF_LSA_REFRESHER_SLOTS);
+		index = ospf_refresher_slot(ospf, current_index, delay / OSPF_LSA_REFRESHER_GRANULARITY);
 
 		if(IS_DEBUG_OSPF(lsa, LSA_REFRESH)) {
 			zlog_debug("LSA[Refresh]: lsa %s with age %d added to index %d", inet_ntoa(lsa->data->id), LS_AGE(lsa), index);
@@ -3331,6 +3395,7 @@ void ospf_refresher_register_lsa(struct ospf *ospf, struct ospf_lsa *lsa) {
 		}
 		listnode_add(ospf->lsa_refresh_queue.qs[index], ospf_lsa_lock(lsa)); /* lsa_refresh_queue */
 		lsa->refresh_list = index;
+		ospf->lsa_refresh_queue.count++;
 		if(IS_DEBUG_OSPF(lsa, LSA_REFRESH)) {
 			zlog_debug(
 				"LSA[Refresh:%s]: ospf_refresher_register_lsa(): "
@@ -3351,6 +3416,7 @@ void ospf_refresher_unregister_lsa(struct ospf *ospf, struct ospf_lsa *lsa) {
 			list_free(refresh_list);
 			ospf->lsa_refresh_queue.qs[lsa->refresh_list] = NULL;
 		}
+		ospf->lsa_refresh_queue.count--;
 		ospf_lsa_unlock(&lsa); /* lsa_refresh_queue */
 		lsa->refresh_list = -1;
 	}
@@ -3362,6 +3428,7 @@ int ospf_lsa_refresh_walker(struct thread *t) {
 	struct ospf *ospf = THREAD_ARG(t);
 	struct ospf_lsa *lsa;
 	int i;
+	unsigned long limit;
 	struct list *lsa_to_refresh = list_new();
 
 	if(IS_DEBUG_OSPF(lsa, LSA_REFRESH)) {
@@ -3379,6 +3446,8 @@ int ospf_lsa_refresh_walker(struct thread *t) {
 		zlog_debug("LSA[Refresh]: ospf_lsa_refresh_walker(): next index %d", ospf->lsa_refresh_queue.index);
 	}
 
+	limit = 2 * ospf_refresher_slot_limit(ospf) * ((ospf->lsa_refresh_queue.index + OSPF_LSA_REFRESHER_SLOTS - i) % OSPF_LSA_REFRESHER_SLOTS);
+
 	for(; i != ospf->lsa_refresh_queue.index; i = (i + 1) % OSPF_LSA_REFRESHER_SLOTS) {
 		if(IS_DEBUG_OSPF(lsa, LSA_REFRESH)) {
 			zlog_debug(
@@ -3407,12 +3476,34 @@ int ospf_lsa_refresh_walker(struct thread *t) {
 				assert(lsa->lock > 0);
 				list_delete_node(refresh_list, node);
 				lsa->refresh_list = -1;
+				ospf->lsa_refresh_queue.count--;
 				listnode_add(lsa_to_refresh, lsa);
 			}
 			list_free(refresh_list);
 		}
 	}
 
+	/* Originate no more than twice a slot's share for each slot walked,
+	 * and leave the rest to the next walk, so that a burst is paced out
+	 * rather than flooded at once.  The share counts the LSAs queued, so
+	 * a backlog drains. */
+	i = ospf->lsa_refresh_queue.index;
+	for(ALL_LIST_ELEMENTS(lsa_to_refresh, node, nnode, lsa)) {
+		if(limit > 0) {
+			limit--;
+			continue;
+		}
+		list_delete_node(lsa_to_refresh, node);
+		if(!ospf->lsa_refresh_queue.qs[i]) {
+			ospf->lsa_refresh_queue.qs[i] = list_new();
+		}
+		listnode_add(ospf->lsa_refresh_queue.qs[i], lsa);
+		lsa->refresh_list = i;
+		ospf->lsa_refresh_queue.count++;
+		ospf->lsa_refresh_queue.deferred++;
+	}
+	ospf->lsa_refresh_queue.refreshed += listcount(lsa_to_refresh);
+
 	ospf->t_lsa_refresher = thread_add_timer(master, ospf_lsa_refresh_walker, ospf, ospf->lsa_refresh_interval);
 	ospf->lsa_refresher_started = quagga_time(NULL);
 
@@ -298,6 +298,7 @@ extern struct in_addr ospf_lsa_unique_id(struct ospf *, struct ospf_lsdb *, u_ch
 extern void ospf_schedule_lsa_flood_area(struct ospf_area *, struct ospf_lsa *);
 extern void ospf_schedule_lsa_flush_area(struct ospf_area *, struct ospf_lsa *);
 
+extern unsigned long ospf_refresher_slot_limit(struct ospf *);
 extern void ospf_refresher_register_lsa(struct ospf *, struct ospf_lsa *);
 extern void ospf_refresher_unregister_lsa(struct ospf *, struct ospf_lsa *);
 extern int ospf_lsa_refresh_walker(struct thread *);
@@ -27,6 +27,8 @@
 #include "table.h"
 #include "memory.h"
 #include "log.h"
+#include "hash.h"
+#include "jhash.h"
 
 #include "ospfd/ospfd.h"
 #include "ospfd/ospf_asbr.h"
@@ -65,6 +67,50 @@ void ospf_lsdb_cleanup(struct ospf_lsdb *lsdb) {
 	for(i = OSPF_MIN_LSA; i < OSPF_MAX_LSA; i++) {
 		route_table_finish(lsdb->type[i].db);
 	}
+
+	if(lsdb->hash) {
+		hash_free(lsdb->hash);
+		lsdb->hash = NULL;
+	}
+}
+
+static unsigned int ospf_lsdb_hash_key(void *data) {
+	struct ospf_lsa *lsa = data;
+
+	return jhash_3words(lsa->data->type, lsa->data->id.s_addr, lsa->data->adv_router.s_addr, 0);
+}
+
+static int ospf_lsdb_hash_cmp(const void *a, const void *b) {
+	const struct ospf_lsa *l1 = a;
+	const struct ospf_lsa *l2 = b;
+
+	return l1->data->type == l2->data->type && IPV4_ADDR_SAME(&l1->data->id, &l2->data->id) && IPV4_ADDR_SAME(&l1->data->adv_router, &l2->data->adv_router);
+}
+
+/* Index the LSDB by hash, now that it has grown past a few LSAs. */
+static void ospf_lsdb_hash_build(struct ospf_lsdb *lsdb) {
+	struct route_node *rn;
+	int i;
+
+	lsdb->hash = hash_create_open(ospf_lsdb_hash_key, ospf_lsdb_hash_cmp);
+	for(i = OSPF_MIN_LSA; i < OSPF_MAX_LSA; i++) {
+		for(rn = route_top(lsdb->type[i].db); rn; rn = route_next(rn)) {
+			if(rn->info) {
+				hash_get(lsdb->hash, rn->info, hash_alloc_intern);
+			}
+		}
+	}
+}
+
+static struct ospf_lsa *ospf_lsdb_hash_lookup(struct ospf_lsdb *lsdb, u_char type, struct in_addr id, struct in_addr adv_router) {
+	struct lsa_header header;
+	struct ospf_lsa key;
+
+	header.type = type;
+	header.id = id;
+	header.adv_router = adv_router;
+	key.data = &header;
+	return hash_lookup(lsdb->hash, &key);
 }
 
 void ls_prefix_set(struct prefix_ls *lp, struct ospf_lsa *lsa) {
@@ -93,6 +139,9 @@ static void ospf_lsdb_delete_entry(struct ospf_lsdb *lsdb, struct route_node *rn
 	lsdb->total--;
 	rn->info = NULL;
 	route_unlock_node(rn);
+	if(lsdb->hash) {
+		hash_release(lsdb->hash, lsa);
+	}
 #ifdef MONITOR_LSDB_CHANGE
 	if(lsdb->del_lsa_hook != NULL) {
 		(*lsdb->del_lsa_hook)(lsa);
@@ -136,6 +185,12 @@ void ospf_lsdb_add(struct ospf_lsdb *lsdb, struct ospf_lsa *lsa) {
 #endif /* MONITOR_LSDB_CHANGE */
 	lsdb->type[lsa->data->type].checksum += ntohs(lsa->data->checksum);
 	rn->info = ospf_lsa_lock(lsa); /* lsdb */
+
+	if(lsdb->hash) {
+		hash_get(lsdb->hash, lsa, hash_alloc_intern);
+	} else if(lsdb->total > OSPF_LSDB_HASH_THRESHOLD) {
+		ospf_lsdb_hash_build(lsdb);
+	}
 }
 
 void ospf_lsdb_delete(struct ospf_lsdb *lsdb, struct ospf_lsa *lsa) {
@@ -204,6 +259,10 @@ struct ospf_lsa *ospf_lsdb_lookup(struct ospf_lsdb *lsdb, struct ospf_lsa *lsa)
 	struct route_node *rn;
 	struct ospf_lsa *find;
 
+	if(lsdb->hash) {
+		return hash_lookup(lsdb->hash, lsa);
+	}
+
 	table = lsdb->type[lsa->data->type].db;
 	ls_prefix_set(&lp, lsa);
 	rn = route_node_lookup(table, (struct prefix *) &lp);
@@ -221,6 +280,10 @@ struct ospf_lsa *ospf_lsdb_lookup_by_id(struct ospf_lsdb *lsdb, u_char type, str
 	struct route_node *rn;
 	struct ospf_lsa *find;
 
+	if(lsdb->hash) {
+		return ospf_lsdb_hash_lookup(lsdb, type, id, adv_router);
+	}
+
 	table = lsdb->type[type].db;
 
 	memset(&lp, 0, sizeof(struct prefix_ls));
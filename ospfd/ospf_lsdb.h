@@ -34,6 +34,12 @@ struct ospf_lsdb {
 	} type[OSPF_MAX_LSA];
 
 	unsigned long total;
+
+	/* The LSAs of all types by (type, id, adv_router), for lookups once
+	 * there are more than OSPF_LSDB_HASH_THRESHOLD.  The tables above
+	 * stay, for walking them in order.
+	 */
+	struct hash *hash;
 #define MONITOR_LSDB_CHANGE 1 /* XXX */
 #ifdef MONITOR_LSDB_CHANGE
 	/* Hooks for callback functions to catch every add/del event. */
@@ -42,6 +48,8 @@ struct ospf_lsdb {
 #endif /* MONITOR_LSDB_CHANGE */
 };
 
+#define OSPF_LSDB_HASH_THRESHOLD 32
+
 /* Macros. */
 #define LSDB_LOOP(T, N, L) \
 	if((T) != NULL) \
@@ -42,6 +42,7 @@
 #include "sigevent.h"
 #include "zclient.h"
 #include "vrf.h"
+#include "table.h"
 
 #include "ospfd/ospfd.h"
 #include "ospfd/ospf_interface.h"
@@ -52,6 +53,7 @@
 #include "ospfd/ospf_dump.h"
 #include "ospfd/ospf_zebra.h"
 #include "ospfd/ospf_vty.h"
+#include "ospfd/ospf_gr.h"
 
 /* ospfd privileges */
 zebra_capabilities_t _caps_p[] = {
@@ -90,6 +92,8 @@ struct option longopts[] = {
 	{ "group", required_argument, NULL, 'g' },
 	{ "skip_runas", no_argument, NULL, 'S' },
 	{ "apiserver", no_argument, NULL, 'a' },
+	{ "spf_threads", required_argument, NULL, 't' },
+	{ "gr_file", required_argument, NULL, 'r' },
 	{ "version", no_argument, NULL, 'v' },
 	{ 0 }
 };
@@ -123,6 +127,8 @@ Daemon which manages OSPF.\n\n\
 -g, --group        Group to run as\n\
 -S, --skip_runas   Skip user and group run as\n\
 -a. --apiserver    Enable OSPF apiserver\n\
+-t, --spf_threads  Number of threads calculating area SPFs in parallel\n\
+-r, --gr_file      Set graceful restart checkpoint file name\n\
 -v, --version      Print program version\n\
 -C, --dryrun       Check configuration for validity and exit\n\
 -h, --help         Display this help and exit\n\
@@ -178,6 +184,9 @@ int main(int argc, char **argv) {
 	char *progname;
 	int dryrun = 0;
 	int skip_runas = 0;
+	unsigned int spf_threads = 0;
+	const char *gr_file = OSPF_GR_FILE_DEFAULT;
+	struct ospf *ospf;
 
 	/* Set umask before anything for security */
 	umask(0027);
@@ -193,7 +202,7 @@ int main(int argc, char **argv) {
 	while(1) {
 		int opt;
 
-		opt = getopt_long(argc, argv, "df:i:z:hA:P:u:g:avCS", longopts, 0);
+		opt = getopt_long(argc, argv, "df:i:z:hA:P:u:g:avCSt:r:", longopts, 0);
 
 		if(opt == EOF) {
 			break;
@@ -221,6 +230,12 @@ int main(int argc, char **argv) {
 			case 'u': ospfd_privs.user = optarg; break;
 			case 'g': ospfd_privs.group = optarg; break;
 			case 'S': skip_runas = 1; break;
+			case 't':
+				if(atoi(optarg) > 0) {
+					spf_threads = atoi(optarg);
+				}
+				break;
+			case 'r': gr_file = optarg; break;
 #ifdef SUPPORT_OSPF_API
 			case 'a': ospf_apiserver_enable = 1; break;
 #endif /* SUPPORT_OSPF_API */
@@ -245,6 +260,8 @@ int main(int argc, char **argv) {
 
 	/* OSPF master init. */
 	ospf_master_init();
+	om->spf_threads = spf_threads;
+	om->gr_file = gr_file;
 
 	/* Initializations. */
 	master = om->master;
@@ -259,6 +276,8 @@ int main(int argc, char **argv) {
 	debug_init();
 	vty_init(master);
 	memory_init();
+	mtype_slab_init(MTYPE_ROUTE_NODE, sizeof(struct route_node));
+	mtype_slab_init(MTYPE_OSPF_LSA, sizeof(struct ospf_lsa));
 	vrf_init();
 
 	access_list_init();
@@ -287,6 +306,11 @@ int main(int argc, char **argv) {
 		return (0);
 	}
 
+	/* Restarting gracefully, from where the last ospfd left off? */
+	if((ospf = ospf_lookup()) != NULL) {
+		ospf_gr_start(ospf);
+	}
+
 	/* Change to the daemon program. */
 	if(daemon_mode && daemon(0, 0) < 0) {
 		zlog_err("OSPFd daemon failed: %s", strerror(errno));
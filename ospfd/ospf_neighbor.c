@@ -42,6 +42,7 @@
 #include "ospfd/ospf_network.h"
 #include "ospfd/ospf_flood.h"
 #include "ospfd/ospf_dump.h"
+#include "ospfd/ospf_bfd.h"
 
 /* Fill in the the 'key' as appropriate to retrieve the entry for nbr
  * from the ospf_interface's nbrs table. Indexed by interface address
@@ -88,8 +89,7 @@ struct ospf_neighbor *ospf_nbr_new(struct ospf_interface *oi) {
 
 	nbr->nbr_nbma = NULL;
 
-	ospf_lsdb_init(&nbr->db_sum);
-	ospf_lsdb_init(&nbr->ls_rxmt);
+	ospf_lsdb_init(&nbr->db_sum.skip);
 	ospf_lsdb_init(&nbr->ls_req);
 
 	nbr->crypt_seqnum = 0;
@@ -99,10 +99,7 @@ struct ospf_neighbor *ospf_nbr_new(struct ospf_interface *oi) {
 
 void ospf_nbr_free(struct ospf_neighbor *nbr) {
 	/* Free DB summary list. */
-	if(ospf_db_summary_count(nbr)) {
-		ospf_db_summary_clear(nbr);
-	}
-	/* ospf_db_summary_delete_all (nbr); */
+	ospf_db_summary_clear(nbr);
 
 	/* Free ls request list. */
 	if(ospf_ls_request_count(nbr)) {
@@ -110,14 +107,11 @@ void ospf_nbr_free(struct ospf_neighbor *nbr) {
 	}
 
 	/* Free retransmit list. */
-	if(ospf_ls_retransmit_count(nbr)) {
-		ospf_ls_retransmit_clear(nbr);
-	}
+	ospf_ls_retransmit_cleanup(nbr);
 
 	/* Cleanup LSDBs. */
-	ospf_lsdb_cleanup(&nbr->db_sum);
+	ospf_lsdb_cleanup(&nbr->db_sum.skip);
 	ospf_lsdb_cleanup(&nbr->ls_req);
-	ospf_lsdb_cleanup(&nbr->ls_rxmt);
 
 	/* Clear last send packet. */
 	if(nbr->last_send) {
@@ -129,11 +123,14 @@ void ospf_nbr_free(struct ospf_neighbor *nbr) {
 		nbr->nbr_nbma = NULL;
 	}
 
+	ospf_bfd_nbr_deregister(nbr);
+
 	/* Cancel all timers. */
 	OSPF_NSM_TIMER_OFF(nbr->t_inactivity);
 	OSPF_NSM_TIMER_OFF(nbr->t_db_desc);
 	OSPF_NSM_TIMER_OFF(nbr->t_ls_req);
 	OSPF_NSM_TIMER_OFF(nbr->t_ls_upd);
+	OSPF_NSM_TIMER_OFF(nbr->t_gr_helper);
 
 	/* Cancel all events. */ /* Thread lookup cost would be negligible. */
 	thread_cancel_event(master, nbr);
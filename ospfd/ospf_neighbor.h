@@ -25,6 +25,16 @@
 
 #include <ospfd/ospf_packet.h>
 
+/* The Database summary list, kept as a cursor over the LSDB rather
+   than a copy of it, see ospf_db_summary_next(). */
+struct ospf_db_sum {
+	u_int16_t types;       /* bit per LSA type still to describe */
+	u_char type;	       /* the one being walked */
+	struct route_node *rn; /* locked, where the walk is */
+	struct ospf_lsdb skip; /* ahead of it, described by the neighbor */
+	long count;	       /* of those left, roughly */
+};
+
 /* Neighbor Data Structure */
 struct ospf_neighbor {
 	/* This neighbor's parent ospf interface. */
@@ -58,8 +68,10 @@ struct ospf_neighbor {
 	} last_recv;
 
 	/* LSA data. */
-	struct ospf_lsdb ls_rxmt;
-	struct ospf_lsdb db_sum;
+	struct hash *ls_rxmt;		    /* retransmit list, see ospf_flood.c */
+	struct ospf_rxmt *ls_rxmt_head;	    /* in the order they fall due */
+	struct ospf_rxmt *ls_rxmt_tail;
+	struct ospf_db_sum db_sum;
 	struct ospf_lsdb ls_req;
 	struct ospf_lsa *ls_req_last;
 
@@ -78,6 +90,13 @@ struct ospf_neighbor {
 	struct thread *t_ls_upd;
 	struct thread *t_hello_reply;
 
+	/* RFC3623 helper for this neighbor's restart, see ospf_gr.c */
+	u_char gr_helper;
+	struct thread *t_gr_helper; /* grace period */
+
+	/* BFD session registered with zebra, see ospf_bfd.c */
+	u_char bfd;
+
 	/* NBMA configured neighbour */
 	struct ospf_nbr_nbma *nbr_nbma;
 
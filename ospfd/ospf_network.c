@@ -31,6 +31,10 @@
 #include "sockopt.h"
 #include "privs.h"
 
+#ifdef GNU_LINUX
+	#include <linux/filter.h>
+#endif /* GNU_LINUX */
+
 extern struct zebra_privs_t ospfd_privs;
 
 #include "ospfd/ospfd.h"
@@ -47,13 +51,13 @@ extern struct zebra_privs_t ospfd_privs;
 int ospf_if_add_allspfrouters(struct ospf *top, struct prefix *p, ifindex_t ifindex) {
 	int ret;
 
-	ret = setsockopt_ipv4_multicast(top->fd, IP_ADD_MEMBERSHIP, htonl(OSPF_ALLSPFROUTERS), ifindex);
+	ret = setsockopt_ipv4_multicast(om->fd, IP_ADD_MEMBERSHIP, htonl(OSPF_ALLSPFROUTERS), ifindex);
 	if(ret < 0) {
 		zlog_warn(
 			"can't setsockopt IP_ADD_MEMBERSHIP (fd %d, addr %s, "
 			"ifindex %u, AllSPFRouters): %s; perhaps a kernel limit "
 			"on # of multicast group memberships has been exceeded?",
-			top->fd, inet_ntoa(p->u.prefix4), ifindex, safe_strerror(errno)
+			om->fd, inet_ntoa(p->u.prefix4), ifindex, safe_strerror(errno)
 		);
 	} else {
 		zlog_debug("interface %s [%u] join AllSPFRouters Multicast group.", inet_ntoa(p->u.prefix4), ifindex);
@@ -65,12 +69,12 @@ int ospf_if_add_allspfrouters(struct ospf *top, struct prefix *p, ifindex_t ifin
 int ospf_if_drop_allspfrouters(struct ospf *top, struct prefix *p, ifindex_t ifindex) {
 	int ret;
 
-	ret = setsockopt_ipv4_multicast(top->fd, IP_DROP_MEMBERSHIP, htonl(OSPF_ALLSPFROUTERS), ifindex);
+	ret = setsockopt_ipv4_multicast(om->fd, IP_DROP_MEMBERSHIP, htonl(OSPF_ALLSPFROUTERS), ifindex);
 	if(ret < 0) {
 		zlog_warn(
 			"can't setsockopt IP_DROP_MEMBERSHIP (fd %d, addr %s, "
 			"ifindex %u, AllSPFRouters): %s",
-			top->fd, inet_ntoa(p->u.prefix4), ifindex, safe_strerror(errno)
+			om->fd, inet_ntoa(p->u.prefix4), ifindex, safe_strerror(errno)
 		);
 	} else {
 		zlog_debug("interface %s [%u] leave AllSPFRouters Multicast group.", inet_ntoa(p->u.prefix4), ifindex);
@@ -83,13 +87,13 @@ int ospf_if_drop_allspfrouters(struct ospf *top, struct prefix *p, ifindex_t ifi
 int ospf_if_add_alldrouters(struct ospf *top, struct prefix *p, ifindex_t ifindex) {
 	int ret;
 
-	ret = setsockopt_ipv4_multicast(top->fd, IP_ADD_MEMBERSHIP, htonl(OSPF_ALLDROUTERS), ifindex);
+	ret = setsockopt_ipv4_multicast(om->fd, IP_ADD_MEMBERSHIP, htonl(OSPF_ALLDROUTERS), ifindex);
 	if(ret < 0) {
 		zlog_warn(
 			"can't setsockopt IP_ADD_MEMBERSHIP (fd %d, addr %s, "
 			"ifindex %u, AllDRouters): %s; perhaps a kernel limit "
 			"on # of multicast group memberships has been exceeded?",
-			top->fd, inet_ntoa(p->u.prefix4), ifindex, safe_strerror(errno)
+			om->fd, inet_ntoa(p->u.prefix4), ifindex, safe_strerror(errno)
 		);
 	} else {
 		zlog_debug("interface %s [%u] join AllDRouters Multicast group.", inet_ntoa(p->u.prefix4), ifindex);
@@ -101,12 +105,12 @@ int ospf_if_add_alldrouters(struct ospf *top, struct prefix *p, ifindex_t ifinde
 int ospf_if_drop_alldrouters(struct ospf *top, struct prefix *p, ifindex_t ifindex) {
 	int ret;
 
-	ret = setsockopt_ipv4_multicast(top->fd, IP_DROP_MEMBERSHIP, htonl(OSPF_ALLDROUTERS), ifindex);
+	ret = setsockopt_ipv4_multicast(om->fd, IP_DROP_MEMBERSHIP, htonl(OSPF_ALLDROUTERS), ifindex);
 	if(ret < 0) {
 		zlog_warn(
 			"can't setsockopt IP_DROP_MEMBERSHIP (fd %d, addr %s, "
 			"ifindex %u, AllDRouters): %s",
-			top->fd, inet_ntoa(p->u.prefix4), ifindex, safe_strerror(errno)
+			om->fd, inet_ntoa(p->u.prefix4), ifindex, safe_strerror(errno)
 		);
 	} else {
 		zlog_debug("interface %s [%u] leave AllDRouters Multicast group.", inet_ntoa(p->u.prefix4), ifindex);
@@ -123,24 +127,24 @@ int ospf_if_ipmulticast(struct ospf *top, struct prefix *p, ifindex_t ifindex) {
 	len = sizeof(val);
 
 	/* Prevent receiving self-origined multicast packets. */
-	ret = setsockopt(top->fd, IPPROTO_IP, IP_MULTICAST_LOOP, (void *) &val, len);
+	ret = setsockopt(om->fd, IPPROTO_IP, IP_MULTICAST_LOOP, (void *) &val, len);
 	if(ret < 0) {
-		zlog_warn("can't setsockopt IP_MULTICAST_LOOP(0) for fd %d: %s", top->fd, safe_strerror(errno));
+		zlog_warn("can't setsockopt IP_MULTICAST_LOOP(0) for fd %d: %s", om->fd, safe_strerror(errno));
 	}
 
 	/* Explicitly set multicast ttl to 1 -- endo. */
 	val = 1;
-	ret = setsockopt(top->fd, IPPROTO_IP, IP_MULTICAST_TTL, (void *) &val, len);
+	ret = setsockopt(om->fd, IPPROTO_IP, IP_MULTICAST_TTL, (void *) &val, len);
 	if(ret < 0) {
-		zlog_warn("can't setsockopt IP_MULTICAST_TTL(1) for fd %d: %s", top->fd, safe_strerror(errno));
+		zlog_warn("can't setsockopt IP_MULTICAST_TTL(1) for fd %d: %s", om->fd, safe_strerror(errno));
 	}
 
-	ret = setsockopt_ipv4_multicast_if(top->fd, ifindex);
+	ret = setsockopt_ipv4_multicast_if(om->fd, ifindex);
 	if(ret < 0) {
 		zlog_warn(
 			"can't setsockopt IP_MULTICAST_IF(fd %d, addr %s, "
 			"ifindex %u): %s",
-			top->fd, inet_ntoa(p->u.prefix4), ifindex, safe_strerror(errno)
+			om->fd, inet_ntoa(p->u.prefix4), ifindex, safe_strerror(errno)
 		);
 	}
 
@@ -206,10 +210,121 @@ int ospf_sock_init(void) {
 	return ospf_sock;
 }
 
+#ifdef SKF_AD_IFINDEX
+/* The kernel drops what ospf_read_packet() would: packets in on an
+   interface we run no OSPF on, not OSPFv2, for an area we have no
+   interface in, or from an address of ours, such as a router sees of
+   its own on a LAN it has two interfaces on.  Each set is a run of
+   jeq; a set that grows past OSPF_FILTER_SET_MAX, where the jumps
+   would no longer fit, is not checked. */
+	#define OSPF_FILTER_SET_MAX 64
+	#define OSPF_FILTER_ACCEPT 0xFFFFFFFF
+
+struct ospf_filter_set {
+	int n;
+	u_int32_t k[OSPF_FILTER_SET_MAX];
+};
+
+static void ospf_filter_set_add(struct ospf_filter_set *set, u_int32_t k) {
+	int i;
+
+	if(set->n > OSPF_FILTER_SET_MAX) {
+		return;
+	}
+	for(i = 0; i < set->n; i++) {
+		if(set->k[i] == k) {
+			return;
+		}
+	}
+	if(set->n == OSPF_FILTER_SET_MAX) {
+		set->n++;
+		return;
+	}
+	set->k[set->n++] = k;
+}
+
+/* Go on past the set if A is in it, else return ret. */
+static struct sock_filter *ospf_filter_in(struct sock_filter *pc, const struct ospf_filter_set *set, u_int32_t ret) {
+	int i;
+
+	if(set->n > OSPF_FILTER_SET_MAX) {
+		return pc;
+	}
+	for(i = 0; i < set->n; i++) {
+		*pc++ = (struct sock_filter) BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, set->k[i], set->n - i, 0);
+	}
+	*pc++ = (struct sock_filter) BPF_STMT(BPF_RET | BPF_K, ret);
+	return pc;
+}
+
+static void ospf_sock_filter(void) {
+	struct ospf_filter_set ifindexes, areas, addrs;
+	struct sock_filter insns[3 * (OSPF_FILTER_SET_MAX + 2) + 8], *pc = insns;
+	struct sock_fprog prog;
+	struct listnode *node, *onode;
+	struct ospf *ospf;
+	struct ospf_interface *oi;
+
+	ifindexes.n = areas.n = addrs.n = 0;
+	for(ALL_LIST_ELEMENTS_RO(om->ospf, node, ospf)) {
+		for(ALL_LIST_ELEMENTS_RO(ospf->oiflist, onode, oi)) {
+			/* Virtual links come in on the transit area's interfaces. */
+			if(oi->type != OSPF_IFTYPE_VIRTUALLINK && oi->ifp->ifindex != IFINDEX_INTERNAL) {
+				ospf_filter_set_add(&ifindexes, oi->ifp->ifindex);
+			}
+			if(oi->area) {
+				ospf_filter_set_add(&areas, ntohl(oi->area->area_id.s_addr));
+			}
+			if(oi->address && oi->type != OSPF_IFTYPE_VIRTUALLINK) {
+				ospf_filter_set_add(&addrs, ntohl(oi->address->u.prefix4.s_addr));
+			}
+		}
+	}
+
+	*pc++ = (struct sock_filter) BPF_STMT(BPF_LD | BPF_W | BPF_ABS, SKF_AD_OFF + SKF_AD_IFINDEX);
+	pc = ospf_filter_in(pc, &ifindexes, 0);
+	/* X = IP header length, then the OSPF header's version and area */
+	*pc++ = (struct sock_filter) BPF_STMT(BPF_LDX | BPF_B | BPF_MSH, 0);
+	*pc++ = (struct sock_filter) BPF_STMT(BPF_LD | BPF_B | BPF_IND, 0);
+	*pc++ = (struct sock_filter) BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, OSPF_VERSION, 1, 0);
+	*pc++ = (struct sock_filter) BPF_STMT(BPF_RET | BPF_K, 0);
+	*pc++ = (struct sock_filter) BPF_STMT(BPF_LD | BPF_W | BPF_IND, 8);
+	pc = ospf_filter_in(pc, &areas, 0);
+	/* and the IP source, which is to be none of ours */
+	*pc++ = (struct sock_filter) BPF_STMT(BPF_LD | BPF_W | BPF_ABS, 12);
+	pc = ospf_filter_in(pc, &addrs, OSPF_FILTER_ACCEPT);
+	*pc++ = (struct sock_filter) BPF_STMT(BPF_RET | BPF_K, addrs.n > OSPF_FILTER_SET_MAX ? OSPF_FILTER_ACCEPT : 0);
+
+	prog.len = pc - insns;
+	prog.filter = insns;
+	if(setsockopt(om->fd, SOL_SOCKET, SO_ATTACH_FILTER, &prog, sizeof(prog)) < 0) {
+		zlog_warn("can't attach packet filter to fd %d: %s", om->fd, safe_strerror(errno));
+	} else if(IS_DEBUG_OSPF(zebra, ZEBRA_INTERFACE)) {
+		zlog_debug("%s: %d interfaces, %d areas, %d addresses", __func__, ifindexes.n, areas.n, addrs.n);
+	}
+}
+
+static int ospf_sock_filter_event(struct thread *thread) {
+	om->t_filter = NULL;
+	ospf_sock_filter();
+	return 0;
+}
+#endif /* SKF_AD_IFINDEX */
+
+/* Have the socket's filter made again from the interfaces, once they
+   are done changing. */
+void ospf_sock_filter_update(void) {
+#ifdef SKF_AD_IFINDEX
+	if(om->fd >= 0 && om->t_filter == NULL) {
+		om->t_filter = thread_add_event(master, ospf_sock_filter_event, NULL, 0);
+	}
+#endif /* SKF_AD_IFINDEX */
+}
+
 void ospf_adjust_sndbuflen(struct ospf *ospf, unsigned int buflen) {
 	int ret, newbuflen;
 	/* Check if any work has to be done at all. */
-	if(ospf->maxsndbuflen >= buflen) {
+	if(om->maxsndbuflen >= buflen) {
 		return;
 	}
 	if(IS_DEBUG_OSPF(zebra, ZEBRA_INTERFACE)) {
@@ -225,13 +340,13 @@ void ospf_adjust_sndbuflen(struct ospf *ospf, unsigned int buflen) {
    * may allocate more buffer space, than requested, this isn't
    * a error.
    */
-	ret = setsockopt_so_sendbuf(ospf->fd, buflen);
-	newbuflen = getsockopt_so_sendbuf(ospf->fd);
+	ret = setsockopt_so_sendbuf(om->fd, buflen);
+	newbuflen = getsockopt_so_sendbuf(om->fd);
 	if(ret < 0 || newbuflen < 0 || newbuflen < (int) buflen) {
 		zlog_warn("%s: tried to set SO_SNDBUF to %u, but got %d", __func__, buflen, newbuflen);
 	}
 	if(newbuflen >= 0) {
-		ospf->maxsndbuflen = (unsigned int) newbuflen;
+		om->maxsndbuflen = (unsigned int) newbuflen;
 	} else {
 		zlog_warn("%s: failed to get SO_SNDBUF", __func__);
 	}
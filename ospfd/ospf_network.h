@@ -30,6 +30,7 @@ extern int ospf_if_add_alldrouters(struct ospf *, struct prefix *, ifindex_t);
 extern int ospf_if_drop_alldrouters(struct ospf *, struct prefix *, ifindex_t);
 extern int ospf_if_ipmulticast(struct ospf *, struct prefix *, ifindex_t);
 extern int ospf_sock_init(void);
+extern void ospf_sock_filter_update(void);
 extern void ospf_adjust_sndbuflen(struct ospf *, unsigned int);
 
 #endif /* _ZEBRA_OSPF_NETWORK_H */
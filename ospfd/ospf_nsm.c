@@ -48,6 +48,8 @@
 #include "ospfd/ospf_flood.h"
 #include "ospfd/ospf_abr.h"
 #include "ospfd/ospf_snmp.h"
+#include "ospfd/ospf_gr.h"
+#include "ospfd/ospf_bfd.h"
 
 static void nsm_clear_adj (struct ospf_neighbor *);
 
@@ -64,6 +66,15 @@ ospf_inactivity_timer (struct thread *thread)
     zlog (NULL, LOG_DEBUG, "NSM[%s:%s]: Timer (Inactivity timer expire)",
 	  IF_NAME (nbr->oi), inet_ntoa (nbr->router_id));
 
+  /* Restarting, it's given the grace period rather than the dead
+     interval. */
+  if (nbr->gr_helper)
+    {
+      OSPF_NSM_TIMER_ON (nbr->t_inactivity, ospf_inactivity_timer,
+			 nbr->v_inactivity);
+      return 0;
+    }
+
   OSPF_NSM_EVENT_SCHEDULE (nbr, NSM_InactivityTimer);
 
   return 0;
@@ -193,118 +204,202 @@ nsm_twoway_received (struct ospf_neighbor *nbr)
   return (nsm_should_adj (nbr) ? NSM_ExStart : NSM_TwoWay);
 }
 
-int
-ospf_db_summary_count (struct ospf_neighbor *nbr)
-{
-  return ospf_lsdb_count_all (&nbr->db_sum);
-}
-
-int
-ospf_db_summary_isempty (struct ospf_neighbor *nbr)
+/* The Database summary list is walked from the LSDB as DD packets are
+   built instead of being copied into each neighbor when the exchange
+   starts: with many adjacencies coming up against a big LSDB, one copy
+   apiece of it is a lot of memory and time.  The list is what's in the
+   LSDB once the cursor gets there, newer than it was at the start if
+   anything, and what's flooded meanwhile reaches the neighbor anyway.
+   What the neighbor describes to us as recent as ours, and we haven't
+   got to yet, goes on the skip list. */
+static struct ospf_lsdb *
+ospf_db_summary_lsdb (struct ospf_neighbor *nbr, int type)
 {
-  return ospf_lsdb_isempty (&nbr->db_sum);
+  if (type == OSPF_AS_EXTERNAL_LSA || type == OSPF_OPAQUE_AS_LSA)
+    return nbr->oi->ospf->lsdb;
+  return nbr->oi->area->lsdb;
 }
 
+/* Whether the cursor stops at lsa to describe it. */
 static int
-ospf_db_summary_add (struct ospf_neighbor *nbr, struct ospf_lsa *lsa)
+ospf_db_summary_want (struct ospf_neighbor *nbr, struct ospf_lsa *lsa)
 {
-  switch (lsa->data->type)
-    {
-    case OSPF_OPAQUE_LINK_LSA:
-      /* Exclude type-9 LSAs that does not have the same "oi" with "nbr". */
-      if (nbr->oi && ospf_if_exists (lsa->oi) != nbr->oi)
-          return 0;
-      break;
-    case OSPF_OPAQUE_AREA_LSA:
-      /*
-       * It is assured by the caller function "nsm_negotiation_done()"
-       * that every given LSA belongs to the same area with "nbr".
-       */
-      break;
-    case OSPF_OPAQUE_AS_LSA:
-    default:
-      break;
-    }
+  struct ospf_lsa *skip;
+
+  /* Exclude type-9 LSAs that does not have the same "oi" with "nbr". */
+  if (lsa->data->type == OSPF_OPAQUE_LINK_LSA
+      && ospf_if_exists (lsa->oi) != nbr->oi)
+    return 0;
 
   /* Stay away from any Local Translated Type-7 LSAs */
-  if (CHECK_FLAG (lsa->flags, OSPF_LSA_LOCAL_XLT))
+  if (CHECK_FLAG (lsa->flags, OSPF_LSA_LOCAL_XLT | OSPF_LSA_DISCARD))
     return 0;
 
+  if (!ospf_lsdb_isempty (&nbr->db_sum.skip)
+      && (skip = ospf_lsdb_lookup (&nbr->db_sum.skip, lsa)) != NULL)
+    {
+      ospf_lsdb_delete (&nbr->db_sum.skip, skip);
+      if (skip == lsa)
+	return 0;
+    }
+
   if (IS_LSA_MAXAGE (lsa))
-    ospf_ls_retransmit_add (nbr, lsa);                      
-  else 
-    ospf_lsdb_add (&nbr->db_sum, lsa);
+    {
+      ospf_ls_retransmit_add (nbr, lsa);
+      return 0;
+    }
 
-  return 0;
+  return 1;
 }
 
-void
-ospf_db_summary_clear (struct ospf_neighbor *nbr)
+/* Move the cursor on to the next LSA to describe, unless it's on one. */
+static void
+ospf_db_summary_settle (struct ospf_neighbor *nbr)
 {
-  struct ospf_lsdb *lsdb;
-  int i;
+  struct ospf_db_sum *sum = &nbr->db_sum;
+  struct ospf_lsa *lsa;
 
-  lsdb = &nbr->db_sum;
-  for (i = OSPF_MIN_LSA; i < OSPF_MAX_LSA; i++)
+  while (sum->types)
     {
-      struct route_table *table = lsdb->type[i].db;
-      struct route_node *rn;
+      if (sum->rn == NULL)
+	{
+	  /* That type is done, on to the next. */
+	  UNSET_FLAG (sum->types, 1 << sum->type);
+	  if (!sum->types)
+	    break;
+	  while (!CHECK_FLAG (sum->types, 1 << sum->type))
+	    sum->type++;
+	  sum->rn = route_top (ospf_db_summary_lsdb (nbr, sum->type)->type[sum->type].db);
+	  continue;
+	}
 
-      for (rn = route_top (table); rn; rn = route_next (rn))
-	if (rn->info)
-	  ospf_lsdb_delete (&nbr->db_sum, rn->info);
+      if ((lsa = sum->rn->info) != NULL)
+	{
+	  if (ospf_db_summary_want (nbr, lsa))
+	    break;
+	  sum->count--;
+	}
+      sum->rn = route_next (sum->rn);
     }
 }
 
-
-
 /* The area link state database consists of the router-LSAs,
    network-LSAs and summary-LSAs contained in the area structure,
    along with the AS-external-LSAs contained in the global structure.
    AS-external-LSAs are omitted from a virtual neighbor's Database
    summary list.  AS-external-LSAs are omitted from the Database
    summary list if the area has been configured as a stub. */
-static int
-nsm_negotiation_done (struct ospf_neighbor *nbr)
+static void
+ospf_db_summary_start (struct ospf_neighbor *nbr)
 {
+  struct ospf_db_sum *sum = &nbr->db_sum;
   struct ospf_area *area = nbr->oi->area;
-  struct ospf_lsa *lsa;
-  struct route_node *rn;
+  int type;
 
-  LSDB_LOOP (ROUTER_LSDB (area), rn, lsa)
-    ospf_db_summary_add (nbr, lsa);
-  LSDB_LOOP (NETWORK_LSDB (area), rn, lsa)
-    ospf_db_summary_add (nbr, lsa);
-  LSDB_LOOP (SUMMARY_LSDB (area), rn, lsa)
-    ospf_db_summary_add (nbr, lsa);
-  LSDB_LOOP (ASBR_SUMMARY_LSDB (area), rn, lsa)
-    ospf_db_summary_add (nbr, lsa);
+  ospf_db_summary_clear (nbr);
+
+  sum->types = (1 << OSPF_ROUTER_LSA) | (1 << OSPF_NETWORK_LSA)
+    | (1 << OSPF_SUMMARY_LSA) | (1 << OSPF_ASBR_SUMMARY_LSA);
 
   /* Process only if the neighbor is opaque capable. */
   if (CHECK_FLAG (nbr->options, OSPF_OPTION_O))
+    sum->types |= (1 << OSPF_OPAQUE_LINK_LSA) | (1 << OSPF_OPAQUE_AREA_LSA);
+
+  if (CHECK_FLAG (nbr->options, OSPF_OPTION_NP))
+    sum->types |= (1 << OSPF_AS_NSSA_LSA);
+
+  if (nbr->oi->type != OSPF_IFTYPE_VIRTUALLINK
+      && area->external_routing == OSPF_AREA_DEFAULT)
     {
-      LSDB_LOOP (OPAQUE_LINK_LSDB (area), rn, lsa)
-	ospf_db_summary_add (nbr, lsa);
-      LSDB_LOOP (OPAQUE_AREA_LSDB (area), rn, lsa)
-	ospf_db_summary_add (nbr, lsa);
+      sum->types |= (1 << OSPF_AS_EXTERNAL_LSA);
+      if (CHECK_FLAG (nbr->options, OSPF_OPTION_O))
+	sum->types |= (1 << OSPF_OPAQUE_AS_LSA);
     }
 
-  if (CHECK_FLAG (nbr->options, OSPF_OPTION_NP))
+  for (type = OSPF_MIN_LSA; type < OSPF_MAX_LSA; type++)
+    if (CHECK_FLAG (sum->types, 1 << type))
+      sum->count += ospf_lsdb_count (ospf_db_summary_lsdb (nbr, type), type);
+
+  /* The walk starts from an empty type 0. */
+  SET_FLAG (sum->types, 1);
+  sum->type = 0;
+  ospf_db_summary_settle (nbr);
+}
+
+int
+ospf_db_summary_count (struct ospf_neighbor *nbr)
+{
+  return nbr->db_sum.count > 0 ? nbr->db_sum.count : 0;
+}
+
+int
+ospf_db_summary_isempty (struct ospf_neighbor *nbr)
+{
+  ospf_db_summary_settle (nbr);
+  return nbr->db_sum.types == 0;
+}
+
+/* The next LSA to describe, NULL once they're all done. */
+struct ospf_lsa *
+ospf_db_summary_next (struct ospf_neighbor *nbr)
+{
+  struct ospf_db_sum *sum = &nbr->db_sum;
+  struct ospf_lsa *lsa;
+
+  ospf_db_summary_settle (nbr);
+  if (!sum->types)
+    return NULL;
+
+  lsa = sum->rn->info;
+  sum->count--;
+  sum->rn = route_next (sum->rn);
+  ospf_db_summary_settle (nbr);
+  return lsa;
+}
+
+/* The neighbor described lsa, our copy, as recent as we have it. */
+void
+ospf_db_summary_skip (struct ospf_neighbor *nbr, struct ospf_lsa *lsa)
+{
+  struct ospf_db_sum *sum = &nbr->db_sum;
+  struct prefix_ls lp;
+
+  /* Described already, or not to be. */
+  if (!CHECK_FLAG (sum->types, 1 << lsa->data->type)
+      || (lsa->data->type == sum->type && sum->rn == NULL))
+    return;
+
+  /* The walk goes through a table in key order. */
+  if (lsa->data->type == sum->type)
     {
-      LSDB_LOOP (NSSA_LSDB (area), rn, lsa)
-	ospf_db_summary_add (nbr, lsa);
+      ls_prefix_set (&lp, lsa);
+      if (memcmp (&lp.id, &((struct prefix_ls *) &sum->rn->p)->id,
+		  2 * sizeof (struct in_addr)) < 0)
+	return;
     }
 
-  if (nbr->oi->type != OSPF_IFTYPE_VIRTUALLINK
-      && area->external_routing == OSPF_AREA_DEFAULT)
-    LSDB_LOOP (EXTERNAL_LSDB (nbr->oi->ospf), rn, lsa)
-      ospf_db_summary_add (nbr, lsa);
+  ospf_lsdb_add (&sum->skip, lsa);
+}
 
-  if (CHECK_FLAG (nbr->options, OSPF_OPTION_O)
-      && (nbr->oi->type != OSPF_IFTYPE_VIRTUALLINK
-	  && area->external_routing == OSPF_AREA_DEFAULT))
-    LSDB_LOOP (OPAQUE_AS_LSDB (nbr->oi->ospf), rn, lsa)
-      ospf_db_summary_add (nbr, lsa);
+void
+ospf_db_summary_clear (struct ospf_neighbor *nbr)
+{
+  struct ospf_db_sum *sum = &nbr->db_sum;
+
+  if (sum->rn)
+    route_unlock_node (sum->rn);
+  sum->rn = NULL;
+  sum->types = 0;
+  sum->type = 0;
+  sum->count = 0;
+  if (!ospf_lsdb_isempty (&sum->skip))
+    ospf_lsdb_delete_all (&sum->skip);
+}
+
+static int
+nsm_negotiation_done (struct ospf_neighbor *nbr)
+{
+  ospf_db_summary_start (nbr);
 
   /* Send Link State Request. */
   if (nbr->t_ls_req == NULL)
@@ -347,8 +442,7 @@ static void
 nsm_clear_adj (struct ospf_neighbor *nbr)
 {
   /* Clear Database Summary list. */
-  if (!ospf_db_summary_isempty (nbr))
-    ospf_db_summary_clear (nbr);
+  ospf_db_summary_clear (nbr);
 
   /* Clear Link State Request list. */
   if (!ospf_ls_request_isempty (nbr))
@@ -631,6 +725,10 @@ nsm_change_state (struct ospf_neighbor *nbr, int state)
   /* Preserve old status. */
   old_state = nbr->state;
 
+  /* Helping it restart ends with the neighbor gone altogether. */
+  if (state == NSM_Down)
+    ospf_gr_helper_exit (nbr, "neighbor down");
+
   /* Change to new status. */
   nbr->state = state;
 
@@ -720,7 +818,7 @@ nsm_change_state (struct ospf_neighbor *nbr, int state)
       /* Originate network-LSA. */
       if (oi->state == ISM_DR)
 	{
-	  if (oi->network_lsa_self && oi->full_nbrs == 0)
+	  if (oi->network_lsa_self && ospf_gr_full_nbrs (oi) == 0)
 	    {
 	      ospf_lsa_flush_area (oi->network_lsa_self, oi->area);
 	      ospf_lsa_unlock (&oi->network_lsa_self);
@@ -733,6 +831,8 @@ nsm_change_state (struct ospf_neighbor *nbr, int state)
 
   ospf_opaque_nsm_change (nbr, old_state);
 
+  ospf_bfd_nbr_change (nbr, old_state);
+
   /* State changes from > ExStart to <= ExStart should clear any Exchange
    * or Full/LSA Update related lists and state.
    * Potential causal events: BadLSReq, SeqNumberMismatch, AdjOK?
@@ -81,5 +81,7 @@ extern void ospf_check_nbr_loading(struct ospf_neighbor *);
 extern int ospf_db_summary_isempty(struct ospf_neighbor *);
 extern int ospf_db_summary_count(struct ospf_neighbor *);
 extern void ospf_db_summary_clear(struct ospf_neighbor *);
+extern struct ospf_lsa *ospf_db_summary_next(struct ospf_neighbor *);
+extern void ospf_db_summary_skip(struct ospf_neighbor *, struct ospf_lsa *);
 
 #endif /* _ZEBRA_OSPF_NSM_H */
@@ -63,6 +63,7 @@
 
 #include "ospfd/ospf_te.h"
 #include "ospfd/ospf_ri.h"
+#include "ospfd/ospf_gr.h"
 
 #ifdef SUPPORT_OSPF_API
 int ospf_apiserver_init(void);
@@ -91,6 +92,8 @@ void ospf_opaque_init(void) {
 		exit(1);
 	}
 
+	ospf_gr_init();
+
 #ifdef SUPPORT_OSPF_API
 	if((ospf_apiserver_enable) && (ospf_apiserver_init() != 0)) {
 		exit(1);
@@ -1026,6 +1029,12 @@ void ospf_opaque_config_write_router(struct vty *vty, struct ospf *ospf) {
 		vty_out(vty, " capability opaque%s", VTY_NEWLINE);
 	}
 
+	/* The opaque applications keep a single, process-wide state,
+	   which belongs to the first instance. */
+	if(ospf != ospf_lookup()) {
+		return;
+	}
+
 	funclist = ospf_opaque_wildcard_funclist;
 	opaque_lsa_config_write_router_callback(funclist, vty);
 
@@ -32,8 +32,9 @@
 #include "stream.h"
 #include "log.h"
 #include "sockopt.h"
+#include "network.h"
 #include "checksum.h"
-#include "md5.h"
+#include "auth_hash.h"
 
 #include "ospfd/ospfd.h"
 #include "ospfd/ospf_network.h"
@@ -48,6 +49,7 @@
 #include "ospfd/ospf_spf.h"
 #include "ospfd/ospf_flood.h"
 #include "ospfd/ospf_dump.h"
+#include "ospfd/ospf_gr.h"
 
 /* Packet Type String. */
 const struct message ospf_packet_type_str[] = {
@@ -242,8 +244,8 @@ struct ospf_packet *ospf_packet_dup(struct ospf_packet *op) {
 		zlog_warn("ospf_packet_dup stream %lu ospf_packet %u size mismatch", (u_long) STREAM_SIZE(op->s), op->length);
 	}
 
-	/* Reserve space for MD5 authentication that may be added later. */
-	new = ospf_packet_new(stream_get_endp(op->s) + OSPF_AUTH_MD5_SIZE);
+	/* Reserve space for a digest that may be added later. */
+	new = ospf_packet_new(stream_get_endp(op->s) + OSPF_AUTH_CRYPT_SIZE_MAX);
 	stream_copy(new->s, op->s);
 
 	new->dst = op->dst;
@@ -254,10 +256,15 @@ struct ospf_packet *ospf_packet_dup(struct ospf_packet *op) {
 
 /* XXX inline */
 static unsigned int ospf_packet_authspace(struct ospf_interface *oi) {
+	struct crypt_key *ck;
 	int auth = 0;
 
 	if(ospf_auth_type(oi) == OSPF_AUTH_CRYPTOGRAPHIC) {
 		auth = OSPF_AUTH_MD5_SIZE;
+		if(!list_isempty(OSPF_IF_PARAM(oi, auth_crypt))) {
+			ck = listgetdata(listtail(OSPF_IF_PARAM(oi, auth_crypt)));
+			auth = auth_hash_size(ck->hash);
+		}
 	}
 
 	return auth;
@@ -273,9 +280,7 @@ static unsigned int ospf_packet_max(struct ospf_interface *oi) {
 	return max;
 }
 
-static int ospf_check_md5_digest(struct ospf_interface *oi, struct ospf_header *ospfh) {
-	MD5_CTX ctx;
-	unsigned char digest[OSPF_AUTH_MD5_SIZE];
+static int ospf_check_crypt_digest(struct ospf_interface *oi, struct ospf_header *ospfh) {
 	struct crypt_key *ck;
 	struct ospf_neighbor *nbr;
 	u_int16_t length = ntohs(ospfh->length);
@@ -283,7 +288,11 @@ static int ospf_check_md5_digest(struct ospf_interface *oi, struct ospf_header *
 	/* Get secret key. */
 	ck = ospf_crypt_key_lookup(OSPF_IF_PARAM(oi, auth_crypt), ospfh->u.crypt.key_id);
 	if(ck == NULL) {
-		zlog_warn("interface %s: ospf_check_md5 no key %d", IF_NAME(oi), ospfh->u.crypt.key_id);
+		zlog_warn("interface %s: ospf_check_crypt no key %d", IF_NAME(oi), ospfh->u.crypt.key_id);
+		return 0;
+	}
+	if(ospfh->u.crypt.auth_data_len != auth_hash_size(ck->hash)) {
+		zlog_warn("interface %s: ospf_check_crypt key %d is %s, digest length %u", IF_NAME(oi), ck->key_id, auth_hash_name(ck->hash), ospfh->u.crypt.auth_data_len);
 		return 0;
 	}
 
@@ -291,20 +300,13 @@ static int ospf_check_md5_digest(struct ospf_interface *oi, struct ospf_header *
 	nbr = ospf_nbr_lookup_by_routerid(oi->nbrs, &ospfh->router_id);
 
 	if(nbr && ntohl(nbr->crypt_seqnum) > ntohl(ospfh->u.crypt.crypt_seqnum)) {
-		zlog_warn("interface %s: ospf_check_md5 bad sequence %d (expect %d)", IF_NAME(oi), ntohl(ospfh->u.crypt.crypt_seqnum), ntohl(nbr->crypt_seqnum));
+		zlog_warn("interface %s: ospf_check_crypt bad sequence %d (expect %d)", IF_NAME(oi), ntohl(ospfh->u.crypt.crypt_seqnum), ntohl(nbr->crypt_seqnum));
 		return 0;
 	}
 
-	/* Generate a digest for the ospf packet - their digest + our digest. */
-	memset(&ctx, 0, sizeof(ctx));
-	MD5Init(&ctx);
-	MD5Update(&ctx, ospfh, length);
-	MD5Update(&ctx, ck->auth_key, OSPF_AUTH_MD5_SIZE);
-	MD5Final(digest, &ctx);
-
-	/* compare the two */
-	if(memcmp((caddr_t) ospfh + length, digest, OSPF_AUTH_MD5_SIZE)) {
-		zlog_warn("interface %s: ospf_check_md5 checksum mismatch", IF_NAME(oi));
+	/* Digest the packet with our key and compare with theirs. */
+	if(!auth_digest_check(&ck->key, ospfh, length, (u_char *) ospfh + length)) {
+		zlog_warn("interface %s: ospf_check_crypt checksum mismatch", IF_NAME(oi));
 		return 0;
 	}
 
@@ -316,16 +318,17 @@ static int ospf_check_md5_digest(struct ospf_interface *oi, struct ospf_header *
 }
 
 /* This function is called from ospf_write(), it will detect the
-   authentication scheme and if it is MD5, it will change the sequence
-   and update the MD5 digest. */
-static int ospf_make_md5_digest(struct ospf_interface *oi, struct ospf_packet *op) {
+   authentication scheme and if it is cryptographic, it will change the
+   sequence and update the digest. */
+static int ospf_make_crypt_digest(struct ospf_interface *oi, struct ospf_packet *op) {
 	struct ospf_header *ospfh;
-	unsigned char digest[OSPF_AUTH_MD5_SIZE] = { 0 };
-	MD5_CTX ctx;
+	unsigned char digest[OSPF_AUTH_CRYPT_SIZE_MAX] = { 0 };
 	void *ibuf;
 	u_int32_t t;
 	struct crypt_key *ck;
-	const u_int8_t *auth_key;
+	struct auth_key zero_key;
+	const struct auth_key *key;
+	size_t size;
 
 	ibuf = STREAM_DATA(op->s);
 	ospfh = (struct ospf_header *) ibuf;
@@ -347,33 +350,31 @@ static int ospf_make_md5_digest(struct ospf_interface *oi, struct ospf_packet *o
 
 	ospfh->u.crypt.crypt_seqnum = htonl(oi->crypt_seqnum);
 
-	/* Get MD5 Authentication key from auth_key list. */
+	/* Get the key from auth_key list, MD5 with a zero key if none. */
 	if(list_isempty(OSPF_IF_PARAM(oi, auth_crypt))) {
-		auth_key = (const u_int8_t *) digest;
+		auth_key_set(&zero_key, AUTH_HASH_MD5, digest, OSPF_AUTH_MD5_SIZE);
+		key = &zero_key;
 	} else {
 		ck = listgetdata(listtail(OSPF_IF_PARAM(oi, auth_crypt)));
-		auth_key = ck->auth_key;
+		key = &ck->key;
 	}
+	size = auth_hash_size(key->type);
 
 	/* Generate a digest for the entire packet + our secret key. */
-	memset(&ctx, 0, sizeof(ctx));
-	MD5Init(&ctx);
-	MD5Update(&ctx, ibuf, ntohs(ospfh->length));
-	MD5Update(&ctx, auth_key, OSPF_AUTH_MD5_SIZE);
-	MD5Final(digest, &ctx);
+	auth_digest(key, ibuf, ntohs(ospfh->length), digest);
 
-	/* Append md5 digest to the end of the stream. */
-	stream_put(op->s, digest, OSPF_AUTH_MD5_SIZE);
+	/* Append the digest to the end of the stream. */
+	stream_put(op->s, digest, size);
 
 	/* We do *NOT* increment the OSPF header length. */
-	op->length = ntohs(ospfh->length) + OSPF_AUTH_MD5_SIZE;
+	op->length = ntohs(ospfh->length) + size;
 
 	if(stream_get_endp(op->s) != op->length) {
 		/* XXX size_t */
-		zlog_warn("ospf_make_md5_digest: length mismatch stream %lu ospf_packet %u", (u_long) stream_get_endp(op->s), op->length);
+		zlog_warn("ospf_make_crypt_digest: length mismatch stream %lu ospf_packet %u", (u_long) stream_get_endp(op->s), op->length);
 	}
 
-	return OSPF_AUTH_MD5_SIZE;
+	return size;
 }
 
 static int ospf_ls_req_timer(struct thread *thread) {
@@ -412,36 +413,9 @@ int ospf_ls_upd_timer(struct thread *thread) {
 	/* Send Link State Update. */
 	if(ospf_ls_retransmit_count(nbr) > 0) {
 		struct list *update;
-		struct ospf_lsdb *lsdb;
-		int i;
-		int retransmit_interval;
-
-		retransmit_interval = OSPF_IF_PARAM(nbr->oi, retransmit_interval);
 
-		lsdb = &nbr->ls_rxmt;
 		update = list_new();
-
-		for(i = OSPF_MIN_LSA; i < OSPF_MAX_LSA; i++) {
-			struct route_table *table = lsdb->type[i].db;
-			struct route_node *rn;
-
-			for(rn = route_top(table); rn; rn = route_next(rn)) {
-				struct ospf_lsa *lsa;
-
-				if((lsa = rn->info) != NULL) {
-					/* Don't retransmit an LSA if we received it within
-		  the last RxmtInterval seconds - this is to allow the
-		  neighbour a chance to acknowledge the LSA as it may
-		  have ben just received before the retransmit timer
-		  fired.  This is a small tweak to what is in the RFC,
-		  but it will cut out out a lot of retransmit traffic
-		  - MAG */
-					if(tv_cmp(tv_sub(recent_relative_time(), lsa->tv_recv), int2tv(retransmit_interval)) >= 0) {
-						listnode_add(update, rn->info);
-					}
-				}
-			}
-		}
+		ospf_ls_retransmit_due(nbr, update);
 
 		if(listcount(update) > 0) {
 			ospf_ls_upd_send(nbr, update, OSPF_SEND_PACKET_DIRECT);
@@ -545,95 +519,78 @@ static void ospf_write_frags(int fd, struct ospf_packet *op, struct ip *iph, str
 }
 #endif /* WANT_OSPF_WRITE_FRAGMENT */
 
-static int ospf_write(struct thread *thread) {
-	struct ospf *ospf = THREAD_ARG(thread);
-	struct ospf_interface *oi;
+/* A packet made ready to go out, with its IP header. */
+struct ospf_write_msg {
 	struct ospf_packet *op;
-	struct sockaddr_in sa_dst;
 	struct ip iph;
-	struct msghdr msg;
+	struct sockaddr_in sa_dst;
 	struct iovec iov[2];
+	struct msghdr msg;
+	int flags;
+	int digest;
 	u_char type;
-	int ret;
-	int flags = 0;
-	struct listnode *node;
-#ifdef WANT_OSPF_WRITE_FRAGMENT
-	static u_int16_t ipid = 0;
-	u_int16_t maxdatasize;
-#endif /* WANT_OSPF_WRITE_FRAGMENT */
-#define OSPF_WRITE_IPHL_SHIFT 2
-
-	ospf->t_write = NULL;
+};
 
-	node = listhead(ospf->oi_write_q);
-	assert(node);
-	oi = listgetdata(node);
-	assert(oi);
+/* Set DONTROUTE flag if dst is unicast. */
+static int ospf_write_flags(struct ospf_interface *oi, struct ospf_packet *op) {
+	if(oi->type != OSPF_IFTYPE_VIRTUALLINK) {
+		if(!IN_MULTICAST(htonl(op->dst.s_addr))) {
+			return MSG_DONTROUTE;
+		}
+	}
+	return 0;
+}
 
+static void ospf_write_prepare(struct ospf_interface *oi, struct ospf_packet *op, struct ospf_write_msg *wm) {
 #ifdef WANT_OSPF_WRITE_FRAGMENT
+	static u_int16_t ipid = 0;
+
 	/* seed ipid static with low order bits of time */
 	if(ipid == 0) {
 		ipid = (time(NULL) & 0xffff);
 	}
-
-	/* convenience - max OSPF data per packet,
-   * and reliability - not more data, than our
-   * socket can accept
-   */
-	maxdatasize = MIN(oi->ifp->mtu, ospf->maxsndbuflen) - sizeof(struct ip);
 #endif /* WANT_OSPF_WRITE_FRAGMENT */
+#define OSPF_WRITE_IPHL_SHIFT 2
 
-	/* Get one packet from queue. */
-	op = ospf_fifo_head(oi->obuf);
-	assert(op);
-	assert(op->length >= OSPF_HEADER_SIZE);
-
-	if(op->dst.s_addr == htonl(OSPF_ALLSPFROUTERS) || op->dst.s_addr == htonl(OSPF_ALLDROUTERS)) {
-		ospf_if_ipmulticast(ospf, oi->address, oi->ifp->ifindex);
-	}
+	wm->op = op;
 
-	/* Rewrite the md5 signature & update the seq */
-	ospf_make_md5_digest(oi, op);
+	/* Rewrite the digest & update the seq */
+	wm->digest = ospf_make_crypt_digest(oi, op);
 
 	/* Retrieve OSPF packet type. */
 	stream_set_getp(op->s, 1);
-	type = stream_getc(op->s);
+	wm->type = stream_getc(op->s);
 
 	/* reset get pointer */
 	stream_set_getp(op->s, 0);
 
-	memset(&iph, 0, sizeof(struct ip));
-	memset(&sa_dst, 0, sizeof(sa_dst));
+	memset(&wm->iph, 0, sizeof(struct ip));
+	memset(&wm->sa_dst, 0, sizeof(wm->sa_dst));
 
-	sa_dst.sin_family = AF_INET;
+	wm->sa_dst.sin_family = AF_INET;
 #ifdef HAVE_STRUCT_SOCKADDR_IN_SIN_LEN
-	sa_dst.sin_len = sizeof(sa_dst);
+	wm->sa_dst.sin_len = sizeof(wm->sa_dst);
 #endif /* HAVE_STRUCT_SOCKADDR_IN_SIN_LEN */
-	sa_dst.sin_addr = op->dst;
-	sa_dst.sin_port = htons(0);
+	wm->sa_dst.sin_addr = op->dst;
+	wm->sa_dst.sin_port = htons(0);
 
-	/* Set DONTROUTE flag if dst is unicast. */
-	if(oi->type != OSPF_IFTYPE_VIRTUALLINK) {
-		if(!IN_MULTICAST(htonl(op->dst.s_addr))) {
-			flags = MSG_DONTROUTE;
-		}
-	}
+	wm->flags = ospf_write_flags(oi, op);
 
-	iph.ip_hl = sizeof(struct ip) >> OSPF_WRITE_IPHL_SHIFT;
+	wm->iph.ip_hl = sizeof(struct ip) >> OSPF_WRITE_IPHL_SHIFT;
 	/* it'd be very strange for header to not be 4byte-word aligned but.. */
-	if(sizeof(struct ip) > (unsigned int) (iph.ip_hl << OSPF_WRITE_IPHL_SHIFT)) {
-		iph.ip_hl++; /* we presume sizeof struct ip cant overflow ip_hl.. */
+	if(sizeof(struct ip) > (unsigned int) (wm->iph.ip_hl << OSPF_WRITE_IPHL_SHIFT)) {
+		wm->iph.ip_hl++; /* we presume sizeof struct ip cant overflow ip_hl.. */
 	}
 
-	iph.ip_v = IPVERSION;
-	iph.ip_tos = IPTOS_PREC_INTERNETCONTROL;
-	iph.ip_len = (iph.ip_hl << OSPF_WRITE_IPHL_SHIFT) + op->length;
+	wm->iph.ip_v = IPVERSION;
+	wm->iph.ip_tos = IPTOS_PREC_INTERNETCONTROL;
+	wm->iph.ip_len = (wm->iph.ip_hl << OSPF_WRITE_IPHL_SHIFT) + op->length;
 
 #if defined(__DragonFly__)
 	/*
    * DragonFly's raw socket expects ip_len/ip_off in network byte order.
    */
-	iph.ip_len = htons(iph.ip_len);
+	wm->iph.ip_len = htons(wm->iph.ip_len);
 #endif
 
 #ifdef WANT_OSPF_WRITE_FRAGMENT
@@ -641,82 +598,176 @@ static int ospf_write(struct thread *thread) {
    * XXX: this presumes this is only programme sending OSPF packets 
    * otherwise, no guarantee ipid will be unique
    */
-	iph.ip_id = ++ipid;
+	wm->iph.ip_id = ++ipid;
 #endif /* WANT_OSPF_WRITE_FRAGMENT */
 
-	iph.ip_off = 0;
+	wm->iph.ip_off = 0;
 	if(oi->type == OSPF_IFTYPE_VIRTUALLINK) {
-		iph.ip_ttl = OSPF_VL_IP_TTL;
+		wm->iph.ip_ttl = OSPF_VL_IP_TTL;
 	} else {
-		iph.ip_ttl = OSPF_IP_TTL;
-	}
-	iph.ip_p = IPPROTO_OSPFIGP;
-	iph.ip_sum = 0;
-	iph.ip_src.s_addr = oi->address->u.prefix4.s_addr;
-	iph.ip_dst.s_addr = op->dst.s_addr;
-
-	memset(&msg, 0, sizeof(msg));
-	msg.msg_name = (caddr_t) &sa_dst;
-	msg.msg_namelen = sizeof(sa_dst);
-	msg.msg_iov = iov;
-	msg.msg_iovlen = 2;
-	iov[0].iov_base = (char *) &iph;
-	iov[0].iov_len = iph.ip_hl << OSPF_WRITE_IPHL_SHIFT;
-	iov[1].iov_base = STREAM_PNT(op->s);
-	iov[1].iov_len = op->length;
+		wm->iph.ip_ttl = OSPF_IP_TTL;
+	}
+	wm->iph.ip_p = IPPROTO_OSPFIGP;
+	wm->iph.ip_sum = 0;
+	wm->iph.ip_src.s_addr = oi->address->u.prefix4.s_addr;
+	wm->iph.ip_dst.s_addr = op->dst.s_addr;
+
+	memset(&wm->msg, 0, sizeof(wm->msg));
+	wm->msg.msg_name = (caddr_t) &wm->sa_dst;
+	wm->msg.msg_namelen = sizeof(wm->sa_dst);
+	wm->msg.msg_iov = wm->iov;
+	wm->msg.msg_iovlen = 2;
+	wm->iov[0].iov_base = (char *) &wm->iph;
+	wm->iov[0].iov_len = wm->iph.ip_hl << OSPF_WRITE_IPHL_SHIFT;
+	wm->iov[1].iov_base = STREAM_PNT(op->s);
+	wm->iov[1].iov_len = op->length;
+}
+
+/* Show debug sending packet. */
+static void ospf_write_debug(struct ospf_interface *oi, struct ospf_write_msg *wm) {
+	if(IS_DEBUG_OSPF_PACKET(wm->type - 1, SEND)) {
+		if(IS_DEBUG_OSPF_PACKET(wm->type - 1, DETAIL)) {
+			zlog_debug("-----------------------------------------------------");
+			ospf_ip_header_dump(&wm->iph);
+			stream_set_getp(wm->op->s, 0);
+			ospf_packet_dump(wm->op->s);
+		}
 
-	/* Sadly we can not rely on kernels to fragment packets because of either
-   * IP_HDRINCL and/or multicast destination being set.
-   */
-#ifdef WANT_OSPF_WRITE_FRAGMENT
-	if(op->length > maxdatasize) {
-		ospf_write_frags(ospf->fd, op, &iph, &msg, maxdatasize, oi->ifp->mtu, flags, type);
+		zlog_debug("%s sent to [%s] via [%s].", LOOKUP(ospf_packet_type_str, wm->type), inet_ntoa(wm->op->dst), IF_NAME(oi));
+
+		if(IS_DEBUG_OSPF_PACKET(wm->type - 1, DETAIL)) {
+			zlog_debug("-----------------------------------------------------");
+		}
 	}
+}
+
+/* Send what the interfaces have queued: for each in turn, as much of
+   its queue as goes in one sendmmsg(), that is up to OSPF_WRITE_BATCH
+   packets with the same send flags, where sendmmsg() is there. */
+static int ospf_write(struct thread *thread) {
+	struct ospf *ospf;
+	struct ospf_interface *oi;
+	struct ospf_packet *op;
+	struct ospf_write_msg wm[OSPF_WRITE_BATCH];
+#ifdef HAVE_SENDMMSG
+	struct mmsghdr msgs[OSPF_WRITE_BATCH];
+#endif /* HAVE_SENDMMSG */
+	struct listnode *node;
+	unsigned int count;
+	int i, n, sent, mcast;
+#ifdef WANT_OSPF_WRITE_FRAGMENT
+	u_int16_t maxdatasize;
 #endif /* WANT_OSPF_WRITE_FRAGMENT */
 
-	/* send final fragment (could be first) */
-	sockopt_iphdrincl_swab_htosys(&iph);
-	ret = sendmsg(ospf->fd, &msg, flags);
-	sockopt_iphdrincl_swab_systoh(&iph);
+	om->t_write = NULL;
 
-	if(ret < 0) {
-		zlog_warn(
-			"*** sendmsg in ospf_write failed to %s, "
-			"id %d, off %d, len %d, interface %s, mtu %u: %s",
-			inet_ntoa(iph.ip_dst), iph.ip_id, iph.ip_off, iph.ip_len, oi->ifp->name, oi->ifp->mtu, safe_strerror(errno)
-		);
-	}
+	for(count = listcount(om->oi_write_q); count > 0; count--) {
+		node = listhead(om->oi_write_q);
+		assert(node);
+		oi = listgetdata(node);
+		assert(oi);
+		ospf = oi->ospf;
 
-	/* Show debug sending packet. */
-	if(IS_DEBUG_OSPF_PACKET(type - 1, SEND)) {
-		if(IS_DEBUG_OSPF_PACKET(type - 1, DETAIL)) {
-			zlog_debug("-----------------------------------------------------");
-			ospf_ip_header_dump(&iph);
-			stream_set_getp(op->s, 0);
-			ospf_packet_dump(op->s);
+#ifdef WANT_OSPF_WRITE_FRAGMENT
+		/* convenience - max OSPF data per packet,
+     * and reliability - not more data, than our
+     * socket can accept
+     */
+		maxdatasize = MIN(oi->ifp->mtu, om->maxsndbuflen) - sizeof(struct ip);
+#endif /* WANT_OSPF_WRITE_FRAGMENT */
+
+		mcast = 0;
+		for(n = 0, op = ospf_fifo_head(oi->obuf); op != NULL && n < OSPF_WRITE_BATCH; n++, op = op->next) {
+			assert(op->length >= OSPF_HEADER_SIZE);
+
+			if(n > 0 && ospf_write_flags(oi, op) != wm[0].flags) {
+				break;
+			}
+#ifdef WANT_OSPF_WRITE_FRAGMENT
+			/* A packet that may need fragments goes by itself. */
+			if(n > 0 && op->length + OSPF_AUTH_CRYPT_SIZE_MAX > maxdatasize) {
+				break;
+			}
+#endif /* WANT_OSPF_WRITE_FRAGMENT */
+
+			if(!mcast && (op->dst.s_addr == htonl(OSPF_ALLSPFROUTERS) || op->dst.s_addr == htonl(OSPF_ALLDROUTERS))) {
+				ospf_if_ipmulticast(ospf, oi->address, oi->ifp->ifindex);
+				mcast = 1;
+			}
+
+			ospf_write_prepare(oi, op, &wm[n]);
+
+	/* Sadly we can not rely on kernels to fragment packets because of either
+     * IP_HDRINCL and/or multicast destination being set.
+     */
+#ifdef WANT_OSPF_WRITE_FRAGMENT
+			if(op->length > maxdatasize) {
+				ospf_write_frags(om->fd, op, &wm[n].iph, &wm[n].msg, maxdatasize, oi->ifp->mtu, wm[n].flags, wm[n].type);
+			}
+#endif /* WANT_OSPF_WRITE_FRAGMENT */
 		}
 
-		zlog_debug("%s sent to [%s] via [%s].", LOOKUP(ospf_packet_type_str, type), inet_ntoa(op->dst), IF_NAME(oi));
+		/* send final fragments (could be first) */
+		for(i = 0; i < n; i++) {
+			sockopt_iphdrincl_swab_htosys(&wm[i].iph);
+		}
+#ifdef HAVE_SENDMMSG
+		memset(msgs, 0, sizeof(msgs));
+		for(i = 0; i < n; i++) {
+			msgs[i].msg_hdr = wm[i].msg;
+		}
+		sent = sendmmsg(om->fd, msgs, n, wm[0].flags);
+#else
+		for(sent = 0; sent < n; sent++) {
+			if(sendmsg(om->fd, &wm[sent].msg, wm[sent].flags) < 0) {
+				break;
+			}
+		}
+		if(sent == 0) {
+			sent = -1;
+		}
+#endif /* HAVE_SENDMMSG */
+		for(i = 0; i < n; i++) {
+			sockopt_iphdrincl_swab_systoh(&wm[i].iph);
+		}
 
-		if(IS_DEBUG_OSPF_PACKET(type - 1, DETAIL)) {
-			zlog_debug("-----------------------------------------------------");
+		/* A packet the kernel would not take is dropped. */
+		if(sent < 0) {
+			zlog_warn(
+				"*** sendmsg in ospf_write failed to %s, "
+				"id %d, off %d, len %d, interface %s, mtu %u: %s",
+				inet_ntoa(wm[0].iph.ip_dst), wm[0].iph.ip_id, wm[0].iph.ip_off, wm[0].iph.ip_len, oi->ifp->name, oi->ifp->mtu, safe_strerror(errno)
+			);
+			sent = 1;
 		}
-	}
 
-	/* Now delete packet from queue. */
-	ospf_packet_delete(oi);
+		for(i = 0; i < n; i++) {
+			if(i < sent) {
+				ospf_write_debug(oi, &wm[i]);
+
+				/* Now delete packet from queue. */
+				ospf_packet_delete(oi);
+			} else {
+				/* Not sent yet: the digest is made again next time. */
+				op = wm[i].op;
+				op->length -= wm[i].digest;
+				stream_set_endp(op->s, op->length);
+			}
+		}
 
-	/* Move this interface to the tail of write_q to
-	 serve everyone in a round robin fashion */
-	listnode_move_to_tail(ospf->oi_write_q, node);
-	if(ospf_fifo_head(oi->obuf) == NULL) {
-		oi->on_write_q = 0;
-		list_delete_node(ospf->oi_write_q, node);
+		/* Move this interface to the tail of write_q to
+	   serve everyone in a round robin fashion */
+		if(ospf_fifo_head(oi->obuf) == NULL) {
+			oi->on_write_q = 0;
+			list_delete_node(om->oi_write_q, node);
+		} else {
+			listnode_move_to_tail(om->oi_write_q, node);
+		}
 	}
 
 	/* If packets still remain in queue, call write thread. */
-	if(!list_isempty(ospf->oi_write_q)) {
-		ospf->t_write = thread_add_write(master, ospf_write, ospf, ospf->fd);
+	if(!list_isempty(om->oi_write_q)) {
+		om->t_write = thread_add_write(master, ospf_write, NULL, om->fd);
 	}
 
 	return 0;
@@ -872,6 +923,10 @@ static void ospf_hello(struct ip *iph, struct ospf_header *ospfh, struct stream
 		OSPF_NSM_EVENT_SCHEDULE(nbr, NSM_TwoWayReceived);
 		nbr->options |= hello->options;
 	} else {
+		/* Restarting, it doesn't list us until it has heard from us. */
+		if(nbr->gr_helper) {
+			return;
+		}
 		OSPF_NSM_EVENT_SCHEDULE(nbr, NSM_OneWayReceived);
 		/* Set neighbor information. */
 		nbr->priority = hello->priority;
@@ -880,6 +935,11 @@ static void ospf_hello(struct ip *iph, struct ospf_header *ospfh, struct stream
 		return;
 	}
 
+	/* Nor does it know the DR and BDR yet: they stay as they were. */
+	if(nbr->gr_helper) {
+		return;
+	}
+
 	/* If neighbor itself declares DR and no BDR exists,
      cause event BackupSeen */
 	if(IPV4_ADDR_SAME(&nbr->address.u.prefix4, &hello->d_router)) {
@@ -893,6 +953,12 @@ static void ospf_hello(struct ip *iph, struct ospf_header *ospfh, struct stream
 		OSPF_ISM_EVENT_SCHEDULE(oi, ISM_BackupSeen);
 	}
 
+	/* Restarting, the DR the neighbors name is the one to keep (RFC3623
+	   3.1), there is no waiting for the election to settle. */
+	if(oi->state == ISM_Waiting && OSPF_GR_RESTARTING_P(oi->ospf) && hello->d_router.s_addr != 0) {
+		OSPF_ISM_EVENT_SCHEDULE(oi, ISM_BackupSeen);
+	}
+
 	/* had not previously. */
 	if((IPV4_ADDR_SAME(&nbr->address.u.prefix4, &hello->d_router) && IPV4_ADDR_CMP(&nbr->address.u.prefix4, &nbr->d_router))
 	   || (IPV4_ADDR_CMP(&nbr->address.u.prefix4, &hello->d_router) && IPV4_ADDR_SAME(&nbr->address.u.prefix4, &nbr->d_router))) {
@@ -985,7 +1051,7 @@ static void ospf_db_desc_proc(struct stream *s, struct ospf_interface *oi, struc
              * DB Description process implemented here.
              */
 				if(find) {
-					ospf_lsdb_delete(&nbr->db_sum, find);
+					ospf_db_summary_skip(nbr, find);
 				}
 				ospf_lsa_discard(new);
 				break;
@@ -1866,27 +1932,13 @@ static void ospf_ls_ack(struct ip *iph, struct ospf_header *ospfh, struct stream
 	return;
 }
 
-static struct stream *ospf_recv_packet(int fd, struct interface **ifp, struct stream *ibuf) {
-	int ret;
+/* Sanity check a packet read off the socket into ibuf, ret bytes long,
+   and find the interface it came in on from the ancillary data. */
+static struct stream *ospf_recv_packet(struct stream *ibuf, int ret, struct msghdr *msgh, struct interface **ifp) {
 	struct ip *iph;
 	u_int16_t ip_len;
 	ifindex_t ifindex = 0;
-	struct iovec iov;
-	/* Header and data both require alignment. */
-	char buff[CMSG_SPACE(SOPT_SIZE_CMSG_IFINDEX_IPV4())];
-	struct msghdr msgh;
-
-	memset(&msgh, 0, sizeof(struct msghdr));
-	msgh.msg_iov = &iov;
-	msgh.msg_iovlen = 1;
-	msgh.msg_control = (caddr_t) buff;
-	msgh.msg_controllen = sizeof(buff);
 
-	ret = stream_recvmsg(ibuf, fd, &msgh, 0, OSPF_MAX_PACKET_SIZE + 1);
-	if(ret < 0) {
-		zlog_warn("stream_recvmsg failed: %s", safe_strerror(errno));
-		return NULL;
-	}
 	if((unsigned int) ret < sizeof(iph)) /* ret must be > 0 now */
 	{
 		zlog_warn(
@@ -1931,7 +1983,7 @@ static struct stream *ospf_recv_packet(int fd, struct interface **ifp, struct st
 	ip_len = ntohs(iph->ip_len) + (iph->ip_hl << 2);
 #endif
 
-	ifindex = getsockopt_ifindex(AF_INET, &msgh);
+	ifindex = getsockopt_ifindex(AF_INET, msgh);
 
 	*ifp = if_lookup_by_index(ifindex);
 
@@ -2081,13 +2133,13 @@ static int ospf_check_auth(struct ospf_interface *oi, struct ospf_header *ospfh)
 				}
 				return 0;
 			}
-			/* only MD5 crypto method can pass ospf_packet_examin() */
+			/* only a known digest length can pass ospf_packet_examin() */
 			if(NULL == (ck = listgetdata(listtail(OSPF_IF_PARAM(oi, auth_crypt)))) || ospfh->u.crypt.key_id != ck->key_id ||
 			   /* Condition above uses the last key ID on the list, which is
          different from what ospf_crypt_key_lookup() does. A bug? */
-			   !ospf_check_md5_digest(oi, ospfh)) {
+			   !ospf_check_crypt_digest(oi, ospfh)) {
 				if(IS_DEBUG_OSPF_PACKET(ospfh->type - 1, RECV)) {
-					zlog_warn("interface %s: MD5 auth failed", IF_NAME(oi));
+					zlog_warn("interface %s: cryptographic auth failed", IF_NAME(oi));
 				}
 				return 0;
 			}
@@ -2277,6 +2329,7 @@ static unsigned ospf_lsaseq_examin(
 /* Verify a complete OSPF packet for proper sizing/alignment. */
 static unsigned ospf_packet_examin(struct ospf_header *oh, const unsigned bytesonwire) {
 	u_int16_t bytesdeclared, bytesauth;
+	int hash;
 	unsigned ret;
 	struct ospf_ls_update *lsupd;
 
@@ -2300,13 +2353,18 @@ static unsigned ospf_packet_examin(struct ospf_header *oh, const unsigned byteso
 	if(ntohs(oh->auth_type) != OSPF_AUTH_CRYPTOGRAPHIC) {
 		bytesauth = 0;
 	} else {
-		if(oh->u.crypt.auth_data_len != OSPF_AUTH_MD5_SIZE) {
+		for(hash = 0; hash < AUTH_HASH_MAX; hash++) {
+			if(oh->u.crypt.auth_data_len == auth_hash_size(hash)) {
+				break;
+			}
+		}
+		if(hash == AUTH_HASH_MAX) {
 			if(IS_DEBUG_OSPF_PACKET(0, RECV)) {
 				zlog_debug("%s: unsupported crypto auth length (%u B)", __func__, oh->u.crypt.auth_data_len);
 			}
 			return MSG_NG;
 		}
-		bytesauth = OSPF_AUTH_MD5_SIZE;
+		bytesauth = oh->u.crypt.auth_data_len;
 	}
 	if(bytesdeclared + bytesauth > bytesonwire) {
 		if(IS_DEBUG_OSPF_PACKET(0, RECV)) {
@@ -2390,27 +2448,15 @@ static int ospf_verify_header(struct stream *ibuf, struct ospf_interface *oi, st
 	return 0;
 }
 
-/* Starting point of packet process function. */
-int ospf_read(struct thread *thread) {
+/* Process one packet received on an interface. */
+static int ospf_read_packet(struct stream *ibuf, struct interface *ifp) {
 	int ret;
-	struct stream *ibuf;
 	struct ospf *ospf;
 	struct ospf_interface *oi;
 	struct ip *iph;
 	struct ospf_header *ospfh;
 	u_int16_t length;
-	struct interface *ifp;
 
-	/* first of all get interface pointer. */
-	ospf = THREAD_ARG(thread);
-
-	/* prepare for next packet. */
-	ospf->t_read = thread_add_read(master, ospf_read, ospf, ospf->fd);
-
-	stream_reset(ospf->ibuf);
-	if(!(ibuf = ospf_recv_packet(ospf->fd, &ifp, ospf->ibuf))) {
-		return -1;
-	}
 	/* This raw packet is known to be at least as big as its IP header. */
 
 	/* Note that there should not be alignment problems with this assignment
@@ -2418,14 +2464,9 @@ int ospf_read(struct thread *thread) {
 	iph = (struct ip *) STREAM_DATA(ibuf);
 	/* Note that sockopt_iphdrincl_swab_systoh was called in ospf_recv_packet. */
 
-	if(ifp == NULL) {
-		/* Handle cases where the platform does not support retrieving the ifindex,
-       and also platforms (such as Solaris 8) that claim to support ifindex
-       retrieval but do not. */
-		ifp = if_lookup_address(iph->ip_src);
-	}
-
-	if(ifp == NULL) {
+	/* The socket is shared, hand the packet to the instance running
+	   on the interface it came in on. */
+	if((ospf = ospf_if_instance(ifp)) == NULL) {
 		return 0;
 	}
 
@@ -2587,6 +2628,211 @@ int ospf_read(struct thread *thread) {
 	return 0;
 }
 
+static int ospf_read_event(struct thread *);
+
+/* Hellos and LS Acks keep adjacencies up and retransmissions down;
+   queued apart, they are not held up behind a backlog of updates. */
+static int ospf_read_urgent(struct stream *ibuf) {
+	struct ip *iph = (struct ip *) STREAM_DATA(ibuf);
+	size_t hlen = iph->ip_hl * 4;
+	u_char type;
+
+	/* Short packets are told off by ospf_read_packet(). */
+	if(stream_get_endp(ibuf) < hlen + OSPF_HEADER_SIZE) {
+		return 0;
+	}
+
+	type = stream_getc_from(ibuf, hlen + 1);
+	return type == OSPF_MSG_HELLO || type == OSPF_MSG_LS_ACK;
+}
+
+/* Queue a packet just read on the interface it came in on. */
+static void ospf_read_enqueue(struct stream *ibuf, struct interface *ifp) {
+	struct ospf_if_info *info;
+	struct ospf_fifo *fifo;
+	struct ospf_packet *op;
+
+	if(ifp == NULL) {
+		/* Handle cases where the platform does not support retrieving the ifindex,
+       and also platforms (such as Solaris 8) that claim to support ifindex
+       retrieval but do not. */
+		ifp = if_lookup_address(((struct ip *) STREAM_DATA(ibuf))->ip_src);
+	}
+
+	if(ifp == NULL || (info = IF_OSPF_IF_INFO(ifp)) == NULL) {
+		return;
+	}
+
+	if(info->read_urgent == NULL) {
+		info->read_urgent = ospf_fifo_new();
+		info->read_normal = ospf_fifo_new();
+	}
+	fifo = ospf_read_urgent(ibuf) ? info->read_urgent : info->read_normal;
+
+	/* The socket buffer used to bound the backlog, do so here. */
+	if(fifo->count >= OSPF_READ_QUEUE_MAX) {
+		if(IS_DEBUG_OSPF_PACKET(0, RECV)) {
+			zlog_debug("ospf_read[%s]: input queue full, dropping packet", ifp->name);
+		}
+		return;
+	}
+
+	op = ospf_packet_new(stream_get_endp(ibuf));
+	stream_copy(op->s, ibuf);
+	op->length = stream_get_endp(ibuf);
+	ospf_fifo_push(fifo, op);
+
+	if(!info->on_read_q) {
+		listnode_add(om->if_read_q, ifp);
+		info->on_read_q = 1;
+	}
+	if(om->t_read_event == NULL) {
+		om->t_read_event = thread_add_event(master, ospf_read_event, NULL, 0);
+	}
+}
+
+/* Process what the interfaces received: all the urgent packets, then
+   the others in turn until it is time to let the socket be read again. */
+static int ospf_read_event(struct thread *thread) {
+	struct listnode *node, *nnode;
+	struct interface *ifp;
+	struct ospf_if_info *info;
+	struct ospf_packet *op;
+
+	om->t_read_event = NULL;
+
+	for(ALL_LIST_ELEMENTS_RO(om->if_read_q, node, ifp)) {
+		info = IF_OSPF_IF_INFO(ifp);
+		while((op = ospf_fifo_pop(info->read_urgent)) != NULL) {
+			ospf_read_packet(op->s, ifp);
+			ospf_packet_free(op);
+		}
+	}
+
+	for(node = listhead(om->if_read_q); node; node = nnode) {
+		ifp = listgetdata(node);
+		info = IF_OSPF_IF_INFO(ifp);
+
+		if((op = ospf_fifo_pop(info->read_normal)) != NULL) {
+			ospf_read_packet(op->s, ifp);
+			ospf_packet_free(op);
+		}
+
+		if(ospf_fifo_head(info->read_normal) == NULL && ospf_fifo_head(info->read_urgent) == NULL) {
+			info->on_read_q = 0;
+			nnode = listnextnode(node);
+			list_delete_node(om->if_read_q, node);
+		} else {
+			/* Round robin on interfaces. */
+			listnode_move_to_tail(om->if_read_q, node);
+			nnode = listhead(om->if_read_q);
+		}
+
+		if(thread_should_yield(thread)) {
+			break;
+		}
+	}
+
+	if(!list_isempty(om->if_read_q)) {
+		om->t_read_event = thread_add_event(master, ospf_read_event, NULL, 0);
+	}
+
+	return 0;
+}
+
+/* Drop what an interface has waiting, it is going away. */
+void ospf_read_if_flush(struct interface *ifp) {
+	struct ospf_if_info *info = IF_OSPF_IF_INFO(ifp);
+
+	if(info->on_read_q) {
+		listnode_delete(om->if_read_q, ifp);
+		info->on_read_q = 0;
+	}
+	if(info->read_urgent != NULL) {
+		ospf_fifo_free(info->read_urgent);
+		ospf_fifo_free(info->read_normal);
+		info->read_urgent = info->read_normal = NULL;
+	}
+}
+
+/* And what all interfaces have, with the socket closed. */
+void ospf_read_flush(void) {
+	struct interface *ifp;
+
+	while(!list_isempty(om->if_read_q)) {
+		ifp = listgetdata(listhead(om->if_read_q));
+		ospf_read_if_flush(ifp);
+	}
+	OSPF_TIMER_OFF(om->t_read_event);
+}
+
+/* Starting point of packet process function: take what the socket has,
+   up to OSPF_READ_BATCH packets at a time where recvmmsg() is there,
+   and queue it for ospf_read_event(). */
+int ospf_read(struct thread *thread) {
+	struct interface *ifp;
+	/* Header and data both require alignment. */
+	char buff[OSPF_READ_BATCH][CMSG_SPACE(SOPT_SIZE_CMSG_IFINDEX_IPV4())];
+	struct iovec iov[OSPF_READ_BATCH];
+	int i, ret;
+#ifdef MSG_WAITFORONE
+	struct mmsghdr msgs[OSPF_READ_BATCH];
+#else
+	struct msghdr msgh;
+#endif /* MSG_WAITFORONE */
+
+	/* prepare for next packet. */
+	om->t_read = thread_add_read(master, ospf_read, NULL, om->fd);
+
+#ifdef MSG_WAITFORONE
+	memset(msgs, 0, sizeof(msgs));
+	for(i = 0; i < OSPF_READ_BATCH; i++) {
+		stream_reset(om->ibuf[i]);
+		iov[i].iov_base = STREAM_DATA(om->ibuf[i]);
+		iov[i].iov_len = OSPF_MAX_PACKET_SIZE + 1;
+		msgs[i].msg_hdr.msg_iov = &iov[i];
+		msgs[i].msg_hdr.msg_iovlen = 1;
+		msgs[i].msg_hdr.msg_control = (caddr_t) buff[i];
+		msgs[i].msg_hdr.msg_controllen = sizeof(buff[i]);
+	}
+
+	/* The socket is readable, so there is one at least. */
+	ret = recvmmsg(om->fd, msgs, OSPF_READ_BATCH, MSG_DONTWAIT, NULL);
+	if(ret < 0) {
+		if(!ERRNO_IO_RETRY(errno)) {
+			zlog_warn("recvmmsg failed: %s", safe_strerror(errno));
+		}
+		return -1;
+	}
+
+	for(i = 0; i < ret; i++) {
+		stream_set_endp(om->ibuf[i], msgs[i].msg_len);
+		if(ospf_recv_packet(om->ibuf[i], msgs[i].msg_len, &msgs[i].msg_hdr, &ifp)) {
+			ospf_read_enqueue(om->ibuf[i], ifp);
+		}
+	}
+#else
+	memset(&msgh, 0, sizeof(struct msghdr));
+	msgh.msg_iov = &iov[0];
+	msgh.msg_iovlen = 1;
+	msgh.msg_control = (caddr_t) buff[0];
+	msgh.msg_controllen = sizeof(buff[0]);
+
+	stream_reset(om->ibuf[0]);
+	ret = stream_recvmsg(om->ibuf[0], om->fd, &msgh, 0, OSPF_MAX_PACKET_SIZE + 1);
+	if(ret < 0) {
+		zlog_warn("stream_recvmsg failed: %s", safe_strerror(errno));
+		return -1;
+	}
+
+	if(ospf_recv_packet(om->ibuf[0], ret, &msgh, &ifp)) {
+		ospf_read_enqueue(om->ibuf[0], ifp);
+	}
+#endif /* MSG_WAITFORONE */
+
+	return 0;
+}
+
 /* Make OSPF header. */
 static void ospf_make_header(int type, struct ospf_interface *oi, struct stream *s) {
 	struct ospf_header *ospfh;
@@ -2626,9 +2872,9 @@ static int ospf_make_auth(struct ospf_interface *oi, struct ospf_header *ospfh)
 				ck = listgetdata(listtail(OSPF_IF_PARAM(oi, auth_crypt)));
 				ospfh->u.crypt.zero = 0;
 				ospfh->u.crypt.key_id = ck->key_id;
-				ospfh->u.crypt.auth_data_len = OSPF_AUTH_MD5_SIZE;
+				ospfh->u.crypt.auth_data_len = auth_hash_size(ck->hash);
 			}
-			/* note: the seq is done in ospf_make_md5_digest() */
+			/* note: the seq is done in ospf_make_crypt_digest() */
 			break;
 		default:
 			/* memset (ospfh->u.auth_data, 0, sizeof (ospfh->u.auth_data)); */
@@ -2736,8 +2982,6 @@ static int ospf_make_db_desc(struct ospf_interface *oi, struct ospf_neighbor *nb
 	u_int16_t length = OSPF_DB_DESC_MIN_SIZE;
 	u_char options;
 	unsigned long pp;
-	int i;
-	struct ospf_lsdb *lsdb;
 
 	/* Set Interface MTU. */
 	if(oi->type == OSPF_IFTYPE_VIRTUALLINK) {
@@ -2766,46 +3010,25 @@ static int ospf_make_db_desc(struct ospf_interface *oi, struct ospf_neighbor *nb
 	}
 
 	/* Describe LSA Header from Database Summary List. */
-	lsdb = &nbr->db_sum;
-
-	for(i = OSPF_MIN_LSA; i < OSPF_MAX_LSA; i++) {
-		struct route_table *table = lsdb->type[i].db;
-		struct route_node *rn;
-
-		for(rn = route_top(table); rn; rn = route_next(rn)) {
-			if((lsa = rn->info) != NULL) {
-				if(IS_OPAQUE_LSA(lsa->data->type) && (!CHECK_FLAG(options, OSPF_OPTION_O))) {
-					/* Suppress advertising opaque-informations. */
-					/* Remove LSA from DB summary list. */
-					ospf_lsdb_delete(lsdb, lsa);
-					continue;
-				}
-
-				if(!CHECK_FLAG(lsa->flags, OSPF_LSA_DISCARD)) {
-					struct lsa_header *lsah;
-					u_int16_t ls_age;
-
-					/* DD packet overflows interface MTU. */
-					if(length + OSPF_LSA_HEADER_SIZE > ospf_packet_max(oi)) {
-						break;
-					}
+	while(length + OSPF_LSA_HEADER_SIZE <= ospf_packet_max(oi) && (lsa = ospf_db_summary_next(nbr)) != NULL) {
+		struct lsa_header *lsah;
+		u_int16_t ls_age;
 
-					/* Keep pointer to LS age. */
-					lsah = (struct lsa_header *) (STREAM_DATA(s) + stream_get_endp(s));
+		/* Suppress advertising opaque-informations. */
+		if(IS_OPAQUE_LSA(lsa->data->type) && (!CHECK_FLAG(options, OSPF_OPTION_O))) {
+			continue;
+		}
 
-					/* Proceed stream pointer. */
-					stream_put(s, lsa->data, OSPF_LSA_HEADER_SIZE);
-					length += OSPF_LSA_HEADER_SIZE;
+		/* Keep pointer to LS age. */
+		lsah = (struct lsa_header *) (STREAM_DATA(s) + stream_get_endp(s));
 
-					/* Set LS age. */
-					ls_age = LS_AGE(lsa);
-					lsah->ls_age = htons(ls_age);
-				}
+		/* Proceed stream pointer. */
+		stream_put(s, lsa->data, OSPF_LSA_HEADER_SIZE);
+		length += OSPF_LSA_HEADER_SIZE;
 
-				/* Remove LSA from DB summary list. */
-				ospf_lsdb_delete(lsdb, lsa);
-			}
-		}
+		/* Set LS age. */
+		ls_age = LS_AGE(lsa);
+		lsah->ls_age = htons(ls_age);
 	}
 
 	/* Update 'More' bit */
@@ -2990,7 +3213,7 @@ static void ospf_hello_send_sub(struct ospf_interface *oi, in_addr_t addr) {
 	ospf_packet_add_top(oi, op);
 
 	/* Hook thread to write packet. */
-	OSPF_ISM_WRITE_ON(oi->ospf);
+	OSPF_ISM_WRITE_ON();
 }
 
 static void ospf_poll_send(struct ospf_nbr_nbma *nbr_nbma) {
@@ -3140,7 +3363,7 @@ void ospf_db_desc_send(struct ospf_neighbor *nbr) {
 	ospf_packet_add(oi, op);
 
 	/* Hook thread to write packet. */
-	OSPF_ISM_WRITE_ON(oi->ospf);
+	OSPF_ISM_WRITE_ON();
 
 	/* Remove old DD packet, then copy new one and keep in neighbor structure. */
 	if(nbr->last_send) {
@@ -3160,7 +3383,7 @@ void ospf_db_desc_resend(struct ospf_neighbor *nbr) {
 	ospf_packet_add(oi, ospf_packet_dup(nbr->last_send));
 
 	/* Hook thread to write packet. */
-	OSPF_ISM_WRITE_ON(oi->ospf);
+	OSPF_ISM_WRITE_ON();
 }
 
 /* Send Link State Request. */
@@ -3199,7 +3422,7 @@ void ospf_ls_req_send(struct ospf_neighbor *nbr) {
 	ospf_packet_add(oi, op);
 
 	/* Hook thread to write packet. */
-	OSPF_ISM_WRITE_ON(oi->ospf);
+	OSPF_ISM_WRITE_ON();
 
 	/* Add Link State Request Retransmission Timer. */
 	OSPF_NSM_TIMER_ON(nbr->t_ls_req, ospf_ls_req_timer, nbr->v_ls_req);
@@ -3267,6 +3490,7 @@ static struct ospf_packet *ospf_ls_upd_packet_new(struct list *update, struct os
 			inet_ntoa(lsa->data->id), ntohs(lsa->data->length), (long int) size
 		);
 		list_delete_node(update, ln);
+		ospf_lsa_unlock(&lsa); /* oi->ls_upd_queue */
 		return NULL;
 	}
 
@@ -3291,6 +3515,9 @@ static void ospf_ls_upd_queue_send(struct ospf_interface *oi, struct list *updat
 	}
 
 	op = ospf_ls_upd_packet_new(update, oi);
+	if(op == NULL) {
+		return;
+	}
 
 	/* Prepare OSPF common header. */
 	ospf_make_header(OSPF_MSG_LS_UPD, oi, op->s);
@@ -3317,7 +3544,37 @@ static void ospf_ls_upd_queue_send(struct ospf_interface *oi, struct list *updat
 	ospf_packet_add(oi, op);
 
 	/* Hook thread to write packet. */
-	OSPF_ISM_WRITE_ON(oi->ospf);
+	OSPF_ISM_WRITE_ON();
+}
+
+static int ospf_ls_upd_send_queue_event(struct thread *);
+
+/* Schedule the next round of LS Updates on the interface.  Without pacing
+ * it goes out as soon as possible; with it, no sooner than the pacing
+ * interval after the last round, so that a burst of LSAs is packed into
+ * full packets rather than sent as they come one or two to a packet.
+ */
+static void ospf_ls_upd_queue_schedule(struct ospf_interface *oi) {
+	u_int32_t pacing = OSPF_IF_PARAM(oi, flood_pacing);
+	struct timeval now;
+	unsigned long elapsed;
+
+	if(oi->t_ls_upd_event) {
+		return;
+	}
+
+	if(pacing == 0 || (oi->ls_upd_last.tv_sec == 0 && oi->ls_upd_last.tv_usec == 0)) {
+		oi->t_ls_upd_event = thread_add_event(master, ospf_ls_upd_send_queue_event, oi, 0);
+		return;
+	}
+
+	quagga_gettime(QUAGGA_CLK_MONOTONIC, &now);
+	elapsed = timeval_elapsed(now, oi->ls_upd_last) / 1000;
+	if(elapsed >= pacing) {
+		oi->t_ls_upd_event = thread_add_event(master, ospf_ls_upd_send_queue_event, oi, 0);
+	} else {
+		oi->t_ls_upd_event = thread_add_timer_msec(master, ospf_ls_upd_send_queue_event, oi, pacing - elapsed);
+	}
 }
 
 static int ospf_ls_upd_send_queue_event(struct thread *thread) {
@@ -3325,7 +3582,10 @@ static int ospf_ls_upd_send_queue_event(struct thread *thread) {
 	struct route_node *rn;
 	struct route_node *rnext;
 	struct list *update;
-	char again = 0;
+	u_int32_t burst = OSPF_IF_PARAM(oi, flood_burst);
+	u_int32_t sent = 0;
+	unsigned int before;
+	char again;
 
 	oi->t_ls_upd_event = NULL;
 
@@ -3333,36 +3593,46 @@ static int ospf_ls_upd_send_queue_event(struct thread *thread) {
 		zlog_debug("ospf_ls_upd_send_queue start");
 	}
 
-	for(rn = route_top(oi->ls_upd_queue); rn; rn = rnext) {
-		rnext = route_next(rn);
+	/* A packet to each destination a round, as full as the MTU allows,
+	 * until the burst is spent or nothing is left. */
+	do {
+		again = 0;
+		for(rn = route_top(oi->ls_upd_queue); rn; rn = rnext) {
+			rnext = route_next(rn);
 
-		if(rn->info == NULL) {
-			continue;
-		}
+			if(rn->info == NULL) {
+				continue;
+			}
 
-		update = (struct list *) rn->info;
+			update = (struct list *) rn->info;
 
-		ospf_ls_upd_queue_send(oi, update, rn->p.u.prefix4);
+			before = listcount(update);
+			ospf_ls_upd_queue_send(oi, update, rn->p.u.prefix4);
+			oi->ls_upd_count -= before - listcount(update);
+			sent++;
 
-		/* list might not be empty. */
-		if(listcount(update) == 0) {
-			list_delete(rn->info);
-			rn->info = NULL;
-			route_unlock_node(rn);
-		} else {
-			again = 1;
+			/* list might not be empty. */
+			if(listcount(update) == 0) {
+				list_delete(rn->info);
+				rn->info = NULL;
+				route_unlock_node(rn);
+			} else {
+				again = 1;
+			}
 		}
-	}
+	} while(again != 0 && sent < burst);
+
+	quagga_gettime(QUAGGA_CLK_MONOTONIC, &oi->ls_upd_last);
 
 	if(again != 0) {
 		if(IS_DEBUG_OSPF_EVENT) {
 			zlog_debug(
 				"ospf_ls_upd_send_queue: update lists not cleared,"
-				" %d nodes to try again, raising new event",
-				again
+				" %lu LSAs to try again, %u msec on",
+				oi->ls_upd_count, OSPF_IF_PARAM(oi, flood_pacing)
 			);
 		}
-		oi->t_ls_upd_event = thread_add_event(master, ospf_ls_upd_send_queue_event, oi, 0);
+		ospf_ls_upd_queue_schedule(oi);
 	}
 
 	if(IS_DEBUG_OSPF_EVENT) {
@@ -3419,10 +3689,12 @@ void ospf_ls_upd_send(struct ospf_neighbor *nbr, struct list *update, int flag)
 	for(ALL_LIST_ELEMENTS_RO(update, node, lsa)) {
 		listnode_add(rn->info, ospf_lsa_lock(lsa)); /* oi->ls_upd_queue */
 	}
-
-	if(oi->t_ls_upd_event == NULL) {
-		oi->t_ls_upd_event = thread_add_event(master, ospf_ls_upd_send_queue_event, oi, 0);
+	oi->ls_upd_count += listcount(update);
+	if(oi->ls_upd_count > oi->ls_upd_count_max) {
+		oi->ls_upd_count_max = oi->ls_upd_count;
 	}
+
+	ospf_ls_upd_queue_schedule(oi);
 }
 
 static void ospf_ls_ack_send_list(struct ospf_interface *oi, struct list *ack, struct in_addr dst) {
@@ -3454,7 +3726,7 @@ static void ospf_ls_ack_send_list(struct ospf_interface *oi, struct list *ack, s
 	ospf_packet_add(oi, op);
 
 	/* Hook thread to write packet. */
-	OSPF_ISM_WRITE_ON(oi->ospf);
+	OSPF_ISM_WRITE_ON();
 }
 
 static int ospf_ls_ack_send_event(struct thread *thread) {
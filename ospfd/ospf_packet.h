@@ -26,8 +26,13 @@
 #define OSPF_HEADER_SIZE 24U
 #define OSPF_AUTH_SIMPLE_SIZE 8U
 #define OSPF_AUTH_MD5_SIZE 16U
+/* Longest digest, of HMAC-SHA-512 (RFC 5709) */
+#define OSPF_AUTH_CRYPT_SIZE_MAX 64U
+/* Longest key string taken for HMAC-SHA; MD5 keys are cut to 16 */
+#define OSPF_AUTH_CRYPT_KEY_SIZE 80U
 
 #define OSPF_MAX_PACKET_SIZE 65535U /* includes IP Header size. */
+#define OSPF_READ_QUEUE_MAX 1024    /* received, per interface and queue. */
 #define OSPF_HELLO_MIN_SIZE 20U	    /* not including neighbors */
 #define OSPF_DB_DESC_MIN_SIZE 8U
 #define OSPF_LS_REQ_MIN_SIZE 0U
@@ -148,6 +153,8 @@ extern struct stream *ospf_stream_dup(struct stream *);
 extern struct ospf_packet *ospf_packet_dup(struct ospf_packet *);
 
 extern int ospf_read(struct thread *);
+extern void ospf_read_if_flush(struct interface *);
+extern void ospf_read_flush(void);
 extern void ospf_hello_send(struct ospf_interface *);
 extern void ospf_db_desc_send(struct ospf_neighbor *);
 extern void ospf_db_desc_resend(struct ospf_neighbor *);
@@ -136,16 +136,50 @@ static int ospf_route_exist_new_table(struct route_table *rt, struct prefix_ipv4
 	return 1;
 }
 
-/* If a prefix and a nexthop match any route in the routing table,
-   then return 1, otherwise return 0. */
-int ospf_route_match_same(struct route_table *rt, struct prefix_ipv4 *prefix, struct ospf_route *newor) {
-	struct route_node *rn;
-	struct ospf_route * or ;
+/* If two routes go through the same nexthops, in the same order, then
+   return 1, otherwise return 0. */
+int ospf_route_paths_same(struct ospf_route * or, struct ospf_route *newor) {
 	struct ospf_path *op;
 	struct ospf_path *newop;
 	struct listnode *n1;
 	struct listnode *n2;
 
+	if(or->paths->count != newor->paths->count) {
+		return 0;
+	}
+
+	/* Check each path. */
+	for(n1 = listhead(or->paths), n2 = listhead(newor->paths); n1 && n2; n1 = listnextnode(n1), n2 = listnextnode(n2)) {
+		op = listgetdata(n1);
+		newop = listgetdata(n2);
+
+		if(!IPV4_ADDR_SAME(&op->nexthop, &newop->nexthop)) {
+			return 0;
+		}
+		if(op->ifindex != newop->ifindex) {
+			return 0;
+		}
+	}
+	return 1;
+}
+
+/* If two routes are of the same type and cost, and networks go through
+   the same nexthops, then return 1, otherwise return 0. */
+int ospf_route_same(struct ospf_route * or, struct ospf_route *newor) {
+	if(or->type != newor->type || or->cost != newor->cost) {
+		return 0;
+	}
+	if(or->type == OSPF_DESTINATION_NETWORK) {
+		return ospf_route_paths_same(or, newor);
+	}
+	return 1;
+}
+
+/* If a prefix and a nexthop match any route in the routing table,
+   then return 1, otherwise return 0. */
+int ospf_route_match_same(struct route_table *rt, struct prefix_ipv4 *prefix, struct ospf_route *newor) {
+	struct route_node *rn;
+
 	if(!rt || !prefix) {
 		return 0;
 	}
@@ -157,31 +191,27 @@ int ospf_route_match_same(struct route_table *rt, struct prefix_ipv4 *prefix, st
 
 	route_unlock_node(rn);
 
-	or = rn->info;
-	if(or->type == newor->type && or->cost == newor->cost) {
-		if(or->type == OSPF_DESTINATION_NETWORK) {
-			if(or->paths->count != newor->paths->count) {
-				return 0;
-			}
+	return ospf_route_same(rn->info, newor);
+}
 
-			/* Check each path. */
-			for(n1 = listhead(or->paths), n2 = listhead(newor->paths); n1 && n2; n1 = listnextnode(n1), n2 = listnextnode(n2)) {
-				op = listgetdata(n1);
-				newop = listgetdata(n2);
+/* If a prefix has a route in the routing table which zebra was told
+   the same as it would be about a new one, then return 1, otherwise
+   return 0. */
+int ospf_route_match_installed(struct route_table *rt, struct prefix_ipv4 *prefix, struct ospf_route *newor) {
+	struct route_node *rn;
 
-				if(!IPV4_ADDR_SAME(&op->nexthop, &newop->nexthop)) {
-					return 0;
-				}
-				if(op->ifindex != newop->ifindex) {
-					return 0;
-				}
-			}
-			return 1;
-		} else if(prefix_same(&rn->p, (struct prefix *) prefix)) {
-			return 1;
-		}
+	if(!rt || !prefix) {
+		return 0;
 	}
-	return 0;
+
+	rn = route_node_lookup(rt, (struct prefix *) prefix);
+	if(!rn || !rn->info) {
+		return 0;
+	}
+
+	route_unlock_node(rn);
+
+	return ospf_zebra_route_same(prefix, rn->info, newor);
 }
 
 /* delete routes generated from AS-External routes if there is a inter/intra
@@ -246,6 +276,8 @@ void ospf_route_install(struct ospf *ospf, struct route_table *rt) {
 	ospf->old_table = ospf->new_table;
 	ospf->new_table = rt;
 
+	ospf_zebra_batch_start();
+
 	/* Delete old routes. */
 	if(ospf->old_table) {
 		ospf_route_delete_uniq(ospf->old_table, rt);
@@ -254,20 +286,22 @@ void ospf_route_install(struct ospf *ospf, struct route_table *rt) {
 		ospf_route_delete_same_ext(ospf->old_external_route, rt);
 	}
 
-	/* Install new routes. */
+	/* Install new routes, those zebra already has as they are aside. */
 	for(rn = route_top(rt); rn; rn = route_next(rn)) {
 		if((or = rn->info) != NULL) {
 			if(or->type == OSPF_DESTINATION_NETWORK) {
-				if(!ospf_route_match_same(ospf->old_table, (struct prefix_ipv4 *) &rn->p, or)) {
+				if(!ospf_route_match_installed(ospf->old_table, (struct prefix_ipv4 *) &rn->p, or)) {
 					ospf_zebra_add((struct prefix_ipv4 *) &rn->p, or);
 				}
 			} else if(or->type == OSPF_DESTINATION_DISCARD) {
-				if(!ospf_route_match_same(ospf->old_table, (struct prefix_ipv4 *) &rn->p, or)) {
+				if(!ospf_route_match_installed(ospf->old_table, (struct prefix_ipv4 *) &rn->p, or)) {
 					ospf_zebra_add_discard((struct prefix_ipv4 *) &rn->p);
 				}
 			}
 		}
 	}
+
+	ospf_zebra_batch_end();
 }
 
 /* RFC2328 16.1. (4). For "router". */
@@ -707,14 +741,14 @@ static int ospf_path_exist(struct list *plist, struct in_addr nexthop, struct os
 }
 
 void ospf_route_copy_nexthops_from_vertex(struct ospf_route *to, struct vertex *v) {
-	struct listnode *node;
+	unsigned int i;
 	struct ospf_path *path;
 	struct vertex_nexthop *nexthop;
 	struct vertex_parent *vp;
 
 	assert(to->paths);
 
-	for(ALL_LIST_ELEMENTS_RO(v->parents, node, vp)) {
+	for(SPF_ARRAY_ELEMENTS(&v->parents, i, vp)) {
 		nexthop = vp->nexthop;
 
 		if(nexthop->oi != NULL) {
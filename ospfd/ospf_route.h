@@ -145,6 +145,9 @@ extern void ospf_prune_unreachable_networks(struct route_table *);
 extern void ospf_prune_unreachable_routers(struct route_table *);
 extern int ospf_add_discard_route(struct route_table *, struct ospf_area *, struct prefix_ipv4 *);
 extern void ospf_delete_discard_route(struct route_table *, struct prefix_ipv4 *);
+extern int ospf_route_paths_same(struct ospf_route *, struct ospf_route *);
+extern int ospf_route_same(struct ospf_route *, struct ospf_route *);
 extern int ospf_route_match_same(struct route_table *, struct prefix_ipv4 *, struct ospf_route *);
+extern int ospf_route_match_installed(struct route_table *, struct prefix_ipv4 *, struct ospf_route *);
 
 #endif /* _ZEBRA_OSPF_ROUTE_H */
@@ -42,47 +42,41 @@
 /* Hook function for updating route_map assignment. */
 static void ospf_route_map_update(const char *name) {
 	struct ospf *ospf;
+	struct listnode *node;
 	int type;
 
-	/* If OSPF instatnce does not exist, return right now. */
-	ospf = ospf_lookup();
-	if(ospf == NULL) {
-		return;
-	}
+	/* Update route-map, of each instance. */
+	for(ALL_LIST_ELEMENTS_RO(om->ospf, node, ospf)) {
+		for(type = 0; type <= ZEBRA_ROUTE_MAX; type++) {
+			if(ROUTEMAP_NAME(ospf, type) && strcmp(ROUTEMAP_NAME(ospf, type), name) == 0) {
+				/* Keep old route-map. */
+				struct route_map *old = ROUTEMAP(ospf, type);
 
-	/* Update route-map */
-	for(type = 0; type <= ZEBRA_ROUTE_MAX; type++) {
-		if(ROUTEMAP_NAME(ospf, type) && strcmp(ROUTEMAP_NAME(ospf, type), name) == 0) {
-			/* Keep old route-map. */
-			struct route_map *old = ROUTEMAP(ospf, type);
+				/* Update route-map. */
+				ROUTEMAP(ospf, type) = route_map_lookup_by_name(ROUTEMAP_NAME(ospf, type));
 
-			/* Update route-map. */
-			ROUTEMAP(ospf, type) = route_map_lookup_by_name(ROUTEMAP_NAME(ospf, type));
+				/* No update for this distribute type. */
+				if(old == NULL && ROUTEMAP(ospf, type) == NULL) {
+					continue;
+				}
 
-			/* No update for this distribute type. */
-			if(old == NULL && ROUTEMAP(ospf, type) == NULL) {
-				continue;
+				ospf_distribute_list_update(ospf, type);
 			}
-
-			ospf_distribute_list_update(ospf, type);
 		}
 	}
 }
 
 static void ospf_route_map_event(route_map_event_t event, const char *name) {
 	struct ospf *ospf;
+	struct listnode *node;
 	int type;
 
-	/* If OSPF instatnce does not exist, return right now. */
-	ospf = ospf_lookup();
-	if(ospf == NULL) {
-		return;
-	}
-
-	/* Update route-map. */
-	for(type = 0; type <= ZEBRA_ROUTE_MAX; type++) {
-		if(ROUTEMAP_NAME(ospf, type) && ROUTEMAP(ospf, type) && !strcmp(ROUTEMAP_NAME(ospf, type), name)) {
-			ospf_distribute_list_update(ospf, type);
+	/* Update route-map, of each instance. */
+	for(ALL_LIST_ELEMENTS_RO(om->ospf, node, ospf)) {
+		for(type = 0; type <= ZEBRA_ROUTE_MAX; type++) {
+			if(ROUTEMAP_NAME(ospf, type) && ROUTEMAP(ospf, type) && !strcmp(ROUTEMAP_NAME(ospf, type), name)) {
+				ospf_distribute_list_update(ospf, type);
+			}
 		}
 	}
 }
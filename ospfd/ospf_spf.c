@@ -30,7 +30,10 @@ Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
 #include "table.h"
 #include "log.h"
 #include "sockunion.h" /* for inet_ntop () */
-#include "pqueue.h"
+#include "spf.h"
+#include "jhash.h"
+#include "workpool.h"
+#include "trace.h"
 
 #include "ospfd/ospfd.h"
 #include "ospfd/ospf_interface.h"
@@ -47,83 +50,110 @@ Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
 #include "ospfd/ospf_abr.h"
 #include "ospfd/ospf_dump.h"
 
-/* Variables to ensure a SPF scheduled log message is printed only once */
+#define SPF_REASON(flags, reason) ((flags) & (1 << (reason)))
 
-static unsigned int spf_reason_flags = 0;
-
-static void ospf_clear_spf_reason_flags() {
-	spf_reason_flags = 0;
-}
+/* An area's calculation, in the three steps ospf_spf_calculate_timer()
+   takes all areas through: prepared and finished on the main thread, the
+   shortest-path tree worked out in between by the SPF threads, where
+   there are some and more than one area to go.  A tree only depends on
+   its own area's LSDB and vertices, and the routes are still added area
+   by area in the order they always were, so the result is the same. */
+struct ospf_spf_job {
+	struct ospf_area *area;
+	struct list *changed;
+	struct list *gone; /* vertices out of the tree, freed once finished */
+	int incremental;
+	int threaded; /* on an SPF thread: no zlog, see workpool.h */
+
+	/* the first message the calculation had, logged once finished */
+	int warn_priority;
+	unsigned int warnings;
+	char warning[128];
+};
+
+static struct work_pool *ospf_spf_pool;
+
+static void ospf_spf_warn(struct ospf_area *, int, const char *, ...) PRINTF_ATTRIBUTE(3, 4);
+
+/* Log from the calculation of an area, or keep it for later if that is
+   on an SPF thread. */
+static void ospf_spf_warn(struct ospf_area *area, int priority, const char *format, ...) {
+	struct ospf_spf_job *job = area->spf_job;
+	char buf[sizeof(job->warning)];
+	va_list args;
+
+	if(job && job->threaded) {
+		if(job->warnings++ == 0) {
+			job->warn_priority = priority;
+			va_start(args, format);
+			vsnprintf(job->warning, sizeof(job->warning), format, args);
+			va_end(args);
+		}
+		return;
+	}
 
-static void ospf_spf_set_reason(ospf_spf_reason_t reason) {
-	spf_reason_flags |= 1 << reason;
+	va_start(args, format);
+	vsnprintf(buf, sizeof(buf), format, args);
+	va_end(args);
+	zlog(NULL, priority, "%s", buf);
 }
 
-static void ospf_get_spf_reason_str(char *buf) {
+/* The reasons an SPF calculation was scheduled for, at least
+   OSPF_SPF_REASON_STR_SIZE long. */
+void ospf_get_spf_reason_str(u_int32_t flags, char *buf) {
 	if(!buf) {
 		return;
 	}
 
 	buf[0] = '\0';
-	if(spf_reason_flags) {
-		if(spf_reason_flags & SPF_FLAG_ROUTER_LSA_INSTALL) {
+	if(flags) {
+		if(SPF_REASON(flags, SPF_FLAG_ROUTER_LSA_INSTALL)) {
 			strcat(buf, "R, ");
 		}
-		if(spf_reason_flags & SPF_FLAG_NETWORK_LSA_INSTALL) {
+		if(SPF_REASON(flags, SPF_FLAG_NETWORK_LSA_INSTALL)) {
 			strcat(buf, "N, ");
 		}
-		if(spf_reason_flags & SPF_FLAG_SUMMARY_LSA_INSTALL) {
+		if(SPF_REASON(flags, SPF_FLAG_SUMMARY_LSA_INSTALL)) {
 			strcat(buf, "S, ");
 		}
-		if(spf_reason_flags & SPF_FLAG_ASBR_SUMMARY_LSA_INSTALL) {
+		if(SPF_REASON(flags, SPF_FLAG_ASBR_SUMMARY_LSA_INSTALL)) {
 			strcat(buf, "AS, ");
 		}
-		if(spf_reason_flags & SPF_FLAG_ABR_STATUS_CHANGE) {
+		if(SPF_REASON(flags, SPF_FLAG_ABR_STATUS_CHANGE)) {
 			strcat(buf, "ABR, ");
 		}
-		if(spf_reason_flags & SPF_FLAG_ASBR_STATUS_CHANGE) {
+		if(SPF_REASON(flags, SPF_FLAG_ASBR_STATUS_CHANGE)) {
 			strcat(buf, "ASBR, ");
 		}
-		if(spf_reason_flags & SPF_FLAG_MAXAGE) {
+		if(SPF_REASON(flags, SPF_FLAG_MAXAGE)) {
 			strcat(buf, "M, ");
 		}
+		if(SPF_REASON(flags, SPF_FLAG_CONFIG_CHANGE)) {
+			strcat(buf, "C, ");
+		}
 		buf[strlen(buf) - 2] = '\0'; /* skip the last ", " */
 	}
 }
 
-static void ospf_vertex_free(void *);
-/* List of allocated vertices, to simplify cleanup of SPF.
- * Not thread-safe obviously. If it ever needs to be, it'd have to be
- * dynamically allocated at begin of ospf_spf_calculate
- */
-static struct list vertex_list = { .del = ospf_vertex_free };
-
-/* Heap related functions, for the managment of the candidates, to
- * be used with pqueue. */
-static int cmp(void *node1, void *node2) {
-	struct vertex *v1 = (struct vertex *) node1;
-	struct vertex *v2 = (struct vertex *) node2;
-	if(v1 != NULL && v2 != NULL) {
-		/* network vertices must be chosen before router vertices of same
-       * cost in order to find all shortest paths
-       */
-		if(((v1->distance - v2->distance) == 0) && (v1->type != v2->type)) {
-			switch(v1->type) {
-				case OSPF_VERTEX_NETWORK: return -1;
-				case OSPF_VERTEX_ROUTER: return 1;
-			}
-		} else {
-			return (v1->distance - v2->distance);
-		}
-	}
-	return 0;
+static unsigned int ospf_vertex_hash_key(void *data) {
+	struct vertex *v = data;
+
+	return jhash_2words(v->type, v->id.s_addr, 0);
 }
 
-static void update_stat(void *node, int position) {
-	struct vertex *v = node;
+static int ospf_vertex_hash_cmp(const void *a, const void *b) {
+	const struct vertex *v1 = a;
+	const struct vertex *v2 = b;
 
-	/* Set the status of the vertex, when its position changes. */
-	*(v->stat) = position;
+	return v1->type == v2->type && IPV4_ADDR_SAME(&v1->id, &v2->id);
+}
+
+/* Key of a vertex on the candidate heap, which keeps its position in the
+ * LSA's stat.  Network vertices must be chosen before router vertices of
+ * same cost in order to find all shortest paths.
+ */
+static u_int64_t ospf_vertex_key(struct vertex *v) {
+	return ((u_int64_t) v->distance << 1) | (v->type == OSPF_VERTEX_ROUTER);
 }
 
 static struct vertex_nexthop *vertex_nexthop_new(void) {
@@ -134,42 +164,15 @@ static void vertex_nexthop_free(struct vertex_nexthop *nh) {
 	XFREE(MTYPE_OSPF_NEXTHOP, nh);
 }
 
-/* Free the canonical nexthop objects for an area, ie the nexthop objects
- * attached to the first-hop router vertices, and any intervening network
- * vertices.
- */
-static void ospf_canonical_nexthops_free(struct vertex *root) {
-	struct listnode *node, *nnode;
-	struct vertex *child;
-
-	for(ALL_LIST_ELEMENTS(root->children, node, nnode, child)) {
-		struct listnode *n2, *nn2;
-		struct vertex_parent *vp;
-
-		/* router vertices through an attached network each
-       * have a distinct (canonical / not inherited) nexthop
-       * which must be freed.
-       *
-       * A network vertex can only have router vertices as its
-       * children, so only one level of recursion is possible.
-       */
-		if(child->type == OSPF_VERTEX_NETWORK) {
-			ospf_canonical_nexthops_free(child);
-		}
-
-		/* Free child nexthops pointing back to this root vertex */
-		for(ALL_LIST_ELEMENTS(child->parents, n2, nn2, vp)) {
-			if(vp->parent == root && vp->nexthop) {
-				vertex_nexthop_free(vp->nexthop);
-			}
-		}
-	}
-}
-
 /* TODO: Parent list should be excised, in favour of maintaining only
  * vertex_nexthop, with refcounts.
+ *
+ * Meanwhile the nexthop objects calculated for the first-hop router
+ * vertices, and any intervening network vertices, are owned by the parent
+ * entry they were made for.  The others are inherited from a parent
+ * vertex higher up in the tree.
  */
-static struct vertex_parent *vertex_parent_new(struct vertex *v, int backlink, struct vertex_nexthop *hop) {
+static struct vertex_parent *vertex_parent_new(struct vertex *v, int backlink, struct vertex_nexthop *hop, int canonical) {
 	struct vertex_parent *new;
 
 	new = XMALLOC(MTYPE_OSPF_VERTEX_PARENT, sizeof(struct vertex_parent));
@@ -181,28 +184,46 @@ static struct vertex_parent *vertex_parent_new(struct vertex *v, int backlink, s
 	new->parent = v;
 	new->backlink = backlink;
 	new->nexthop = hop;
+	new->canonical = canonical;
 	return new;
 }
 
 static void vertex_parent_free(void *p) {
+	struct vertex_parent *vp = p;
+
+	if(vp->canonical) {
+		vertex_nexthop_free(vp->nexthop);
+	}
 	XFREE(MTYPE_OSPF_VERTEX_PARENT, p);
 }
 
-static struct vertex *ospf_vertex_new(struct ospf_lsa *lsa) {
+/* Point a vertex at the instance of its LSA to calculate from. */
+static void ospf_vertex_bind(struct vertex *v, struct ospf_lsa *lsa) {
+	struct ospf_lsa *old = v->origin;
+
+	v->origin = ospf_lsa_lock(lsa);
+	v->lsa = lsa->data;
+	v->stat = &(lsa->stat);
+	ospf_lsa_unlock(&old);
+}
+
+static struct vertex *ospf_vertex_new(struct ospf_area *area, struct ospf_lsa *lsa) {
 	struct vertex *new;
 
-	new = XCALLOC(MTYPE_OSPF_VERTEX, sizeof(struct vertex));
+	if(!area->spf_pool) {
+		area->spf_pool = spf_pool_new(sizeof(struct vertex), MTYPE_OSPF_VERTEX);
+	}
+	new = spf_pool_get(area->spf_pool);
 
 	new->flags = 0;
-	new->stat = &(lsa->stat);
 	new->type = lsa->data->type;
 	new->id = lsa->data->id;
-	new->lsa = lsa->data;
-	new->children = list_new();
-	new->parents = list_new();
-	new->parents->del = vertex_parent_free;
+	ospf_vertex_bind(new, lsa);
 
-	listnode_add(&vertex_list, new);
+	if(!area->spf_vertices) {
+		area->spf_vertices = hash_create(ospf_vertex_hash_key, ospf_vertex_hash_cmp);
+	}
+	hash_get(area->spf_vertices, new, hash_alloc_intern);
 
 	if(IS_DEBUG_OSPF_EVENT) {
 		zlog_debug("%s: Created %s vertex %s", __func__, new->type == OSPF_VERTEX_ROUTER ? "Router" : "Network", inet_ntoa(new->lsa->id));
@@ -210,32 +231,121 @@ static struct vertex *ospf_vertex_new(struct ospf_lsa *lsa) {
 	return new;
 }
 
-static void ospf_vertex_free(void *data) {
+static void ospf_vertex_flush_parents(struct vertex *v) {
+	struct vertex_parent *vp;
+	unsigned int i;
+
+	for(SPF_ARRAY_ELEMENTS(&v->parents, i, vp)) {
+		vertex_parent_free(vp);
+	}
+	spf_array_clear(&v->parents);
+}
+
+/* Everything the vertex holds, but not the vertex itself, which is
+ * in the area's pool.
+ */
+static void ospf_vertex_release(void *data) {
 	struct vertex *v = data;
 
 	if(IS_DEBUG_OSPF_EVENT) {
-		zlog_debug("%s: Free %s vertex %s", __func__, v->type == OSPF_VERTEX_ROUTER ? "Router" : "Network", inet_ntoa(v->lsa->id));
+		zlog_debug("%s: Free %s vertex %s", __func__, v->type == OSPF_VERTEX_ROUTER ? "Router" : "Network", inet_ntoa(v->id));
 	}
 
 	/* There should be no parents potentially holding references to this vertex
    * Children however may still be there, but presumably referenced by other
    * vertices
    */
-	//assert (listcount (v->parents) == 0);
+	ospf_vertex_flush_parents(v);
+	spf_array_free(&v->parents);
+	spf_array_free(&v->children);
 
-	if(v->children) {
-		list_delete(v->children);
+	v->lsa = NULL;
+	ospf_lsa_unlock(&v->origin);
+}
+
+static void ospf_vertex_free(struct ospf_area *area, struct vertex *v) {
+	ospf_vertex_release(v);
+	spf_pool_put(area->spf_pool, v);
+}
+
+static struct vertex *ospf_vertex_lookup(struct ospf_area *area, u_char type, struct in_addr id) {
+	struct vertex key;
+
+	if(!area->spf_vertices) {
+		return NULL;
 	}
-	v->children = NULL;
 
-	if(v->parents) {
-		list_delete(v->parents);
+	key.type = type;
+	key.id = id;
+	return hash_lookup(area->spf_vertices, &key);
+}
+
+static int ospf_vertex_in_tree(struct ospf_area *area, struct vertex *v) {
+	return v == area->spf || spf_array_count(&v->parents) > 0;
+}
+
+/* Take a vertex out of the tree, forgetting how it was reached. */
+static void ospf_vertex_detach(struct vertex *v) {
+	struct vertex_parent *vp;
+	unsigned int i;
+
+	for(SPF_ARRAY_ELEMENTS(&v->parents, i, vp)) {
+		spf_array_delete(&vp->parent->children, v);
 	}
-	v->parents = NULL;
+	ospf_vertex_flush_parents(v);
+	spf_array_clear(&v->children);
+	v->distance = 0;
+}
 
-	v->lsa = NULL;
+/* A snapshot of an area's vertices, to walk while the hash changes or
+ * in another order.
+ */
+struct vertex_array {
+	struct vertex **vertices;
+	unsigned int count;
+};
+
+static void ospf_vertex_array_add(struct hash_backet *hb, void *arg) {
+	struct vertex_array *va = arg;
+
+	va->vertices[va->count++] = hb->data;
+}
+
+static void ospf_vertex_array_get(struct ospf_area *area, struct vertex_array *va) {
+	va->count = 0;
+	va->vertices = XMALLOC(MTYPE_OSPF_TMP, (area->spf_vertices->count + 1) * sizeof(struct vertex *));
+	hash_iterate(area->spf_vertices, ospf_vertex_array_add, va);
+}
 
-	XFREE(MTYPE_OSPF_VERTEX, v);
+/* Order in which Dijkstra adds vertices to the tree, see ospf_vertex_key(). */
+static int ospf_vertex_array_cmp(const void *a, const void *b) {
+	const struct vertex *v1 = *(struct vertex * const *) a;
+	const struct vertex *v2 = *(struct vertex * const *) b;
+
+	if(v1->distance != v2->distance) {
+		return v1->distance < v2->distance ? -1 : 1;
+	}
+	if(v1->type != v2->type) {
+		return v1->type == OSPF_VERTEX_NETWORK ? -1 : 1;
+	}
+	return IPV4_ADDR_CMP(&v1->id, &v2->id);
+}
+
+/* Free an area's shortest-path tree, the next SPF starts afresh. */
+void ospf_spf_free(struct ospf_area *area) {
+	if(area->spf_vertices) {
+		hash_clean(area->spf_vertices, ospf_vertex_release);
+		hash_free(area->spf_vertices);
+		area->spf_vertices = NULL;
+	}
+	spf_pool_free(area->spf_pool);
+	area->spf_pool = NULL;
+	area->spf = NULL;
+
+	if(area->spf_ifs) {
+		XFREE(MTYPE_OSPF_TMP, area->spf_ifs);
+	}
+	area->spf_ifs_count = 0;
 }
 
 static void ospf_vertex_dump(const char *msg, struct vertex *v, int print_parents, int print_children) {
@@ -246,10 +356,10 @@ static void ospf_vertex_dump(const char *msg, struct vertex *v, int print_parent
 	zlog_debug("%s %s vertex %s  distance %u flags %u", msg, v->type == OSPF_VERTEX_ROUTER ? "Router" : "Network", inet_ntoa(v->lsa->id), v->distance, (unsigned int) v->flags);
 
 	if(print_parents) {
-		struct listnode *node;
 		struct vertex_parent *vp;
+		unsigned int i;
 
-		for(ALL_LIST_ELEMENTS_RO(v->parents, node, vp)) {
+		for(SPF_ARRAY_ELEMENTS(&v->parents, i, vp)) {
 			char buf1[BUFSIZ];
 
 			if(vp) {
@@ -262,10 +372,10 @@ static void ospf_vertex_dump(const char *msg, struct vertex *v, int print_parent
 	}
 
 	if(print_children) {
-		struct listnode *cnode;
 		struct vertex *cv;
+		unsigned int i;
 
-		for(ALL_LIST_ELEMENTS_RO(v->children, cnode, cv)) {
+		for(SPF_ARRAY_ELEMENTS(&v->children, i, cv)) {
 			ospf_vertex_dump(" child:", cv, 0, 0);
 		}
 	}
@@ -274,33 +384,20 @@ static void ospf_vertex_dump(const char *msg, struct vertex *v, int print_parent
 /* Add a vertex to the list of children in each of its parents. */
 static void ospf_vertex_add_parent(struct vertex *v) {
 	struct vertex_parent *vp;
-	struct listnode *node;
+	unsigned int i;
 
-	assert(v && v->parents);
+	assert(v);
 
-	for(ALL_LIST_ELEMENTS_RO(v->parents, node, vp)) {
-		assert(vp->parent && vp->parent->children);
+	for(SPF_ARRAY_ELEMENTS(&v->parents, i, vp)) {
+		assert(vp->parent);
 
 		/* No need to add two links from the same parent. */
-		if(listnode_lookup(vp->parent->children, v) == NULL) {
-			listnode_add(vp->parent->children, v);
+		if(spf_array_lookup(&vp->parent->children, v) < 0) {
+			spf_array_add(&vp->parent->children, v);
 		}
 	}
 }
 
-static void ospf_spf_init(struct ospf_area *area) {
-	struct vertex *v;
-
-	/* Create root node. */
-	v = ospf_vertex_new(area->router_lsa_self);
-
-	area->spf = v;
-
-	/* Reset ABR and ASBR router counts. */
-	area->abr_count = 0;
-	area->asbr_count = 0;
-}
-
 /* return index of link back to V from W, or -1 if no link found */
 static int ospf_lsa_has_link(struct lsa_header *w, struct lsa_header *v) {
 	unsigned int i, length;
@@ -395,24 +492,13 @@ static struct router_lsa_link *ospf_get_next_link(struct vertex *v, struct verte
 	return NULL;
 }
 
-static void ospf_spf_flush_parents(struct vertex *w) {
-	struct vertex_parent *vp;
-	struct listnode *ln, *nn;
-
-	/* delete the existing nexthops */
-	for(ALL_LIST_ELEMENTS(w->parents, ln, nn, vp)) {
-		list_delete_node(w->parents, ln);
-		vertex_parent_free(vp);
-	}
-}
-
 /*
  * Consider supplied next-hop for inclusion to the supplied list of
  * equal-cost next-hops, adjust list as neccessary.
  */
-static void ospf_spf_add_parent(struct vertex *v, struct vertex *w, struct vertex_nexthop *newhop, unsigned int distance) {
+static void ospf_spf_add_parent(struct vertex *v, struct vertex *w, struct vertex_nexthop *newhop, unsigned int distance, int canonical) {
 	struct vertex_parent *vp, *wp;
-	struct listnode *node;
+	unsigned int i;
 
 	/* we must have a newhop, and a distance */
 	assert(v && w && newhop);
@@ -438,24 +524,27 @@ static void ospf_spf_add_parent(struct vertex *v, struct vertex *w, struct verte
 		if(IS_DEBUG_OSPF_EVENT) {
 			zlog_debug("%s: distance %d better than %d, flushing existing parents", __func__, distance, w->distance);
 		}
-		ospf_spf_flush_parents(w);
+		ospf_vertex_flush_parents(w);
 		w->distance = distance;
 	}
 
 	/* new parent is <= existing parents, add it to parent list (if nexthop
    * not on parent list)
    */
-	for(ALL_LIST_ELEMENTS_RO(w->parents, node, wp)) {
+	for(SPF_ARRAY_ELEMENTS(&w->parents, i, wp)) {
 		if(memcmp(newhop, wp->nexthop, sizeof(*newhop)) == 0) {
 			if(IS_DEBUG_OSPF_EVENT) {
 				zlog_debug("%s: ... nexthop already on parent list, skipping add", __func__);
 			}
+			if(canonical) {
+				vertex_nexthop_free(newhop);
+			}
 			return;
 		}
 	}
 
-	vp = vertex_parent_new(v, ospf_lsa_has_link(w->lsa, v->lsa), newhop);
-	listnode_add(w->parents, vp);
+	vp = vertex_parent_new(v, ospf_lsa_has_link(w->lsa, v->lsa), newhop, canonical);
+	spf_array_add(&w->parents, vp);
 
 	return;
 }
@@ -472,11 +561,11 @@ static void ospf_spf_add_parent(struct vertex *v, struct vertex *w, struct verte
  * provided distance as appropriate.
  */
 static unsigned int ospf_nexthop_calculation(struct ospf_area *area, struct vertex *v, struct vertex *w, struct router_lsa_link *l, unsigned int distance, int lsa_pos) {
-	struct listnode *node, *nnode;
 	struct vertex_nexthop *nh;
 	struct vertex_parent *vp;
 	struct ospf_interface *oi = NULL;
 	unsigned int added = 0;
+	unsigned int i;
 	char buf1[BUFSIZ];
 	char buf2[BUFSIZ];
 
@@ -579,10 +668,10 @@ static unsigned int ospf_nexthop_calculation(struct ospf_area *area, struct vert
 					nh = vertex_nexthop_new();
 					nh->oi = oi;
 					nh->router = nexthop;
-					ospf_spf_add_parent(v, w, nh, distance);
+					ospf_spf_add_parent(v, w, nh, distance, 1);
 					return 1;
 				} else {
-					zlog_info("%s: could not determine nexthop for link %s", __func__, oi->ifp->name);
+					ospf_spf_warn(area, LOG_INFO, "%s: could not determine nexthop for link %s", __func__, oi->ifp->name);
 				}
 			} /* end point-to-point link from V to W */
 			else if(l->m[0].type == LSA_LINK_TYPE_VIRTUALLINK) {
@@ -601,11 +690,11 @@ static unsigned int ospf_nexthop_calculation(struct ospf_area *area, struct vert
 					nh = vertex_nexthop_new();
 					nh->oi = vl_data->nexthop.oi;
 					nh->router = vl_data->nexthop.router;
-					ospf_spf_add_parent(v, w, nh, distance);
+					ospf_spf_add_parent(v, w, nh, distance, 1);
 					return 1;
 				} else {
-					zlog_info("ospf_nexthop_calculation(): "
-						  "vl_data for VL link not found");
+					ospf_spf_warn(area, LOG_INFO, "ospf_nexthop_calculation(): "
+								       "vl_data for VL link not found");
 				}
 			} /* end virtual-link from V to W */
 			return 0;
@@ -616,14 +705,14 @@ static unsigned int ospf_nexthop_calculation(struct ospf_area *area, struct vert
 			nh = vertex_nexthop_new();
 			nh->oi = oi;
 			nh->router.s_addr = 0; /* Nexthop not required */
-			ospf_spf_add_parent(v, w, nh, distance);
+			ospf_spf_add_parent(v, w, nh, distance, 1);
 			return 1;
 		}
 	} /* end V is the root */
 	/* Check if W's parent is a network connected to root. */
 	else if(v->type == OSPF_VERTEX_NETWORK) {
 		/* See if any of V's parents are the root. */
-		for(ALL_LIST_ELEMENTS(v->parents, node, nnode, vp)) {
+		for(SPF_ARRAY_ELEMENTS(&v->parents, i, vp)) {
 			if(vp->parent == area->spf) /* connects to root? */
 			{
 				/* 16.1.1 para 5. ...the parent vertex is a network that
@@ -644,7 +733,7 @@ static unsigned int ospf_nexthop_calculation(struct ospf_area *area, struct vert
 					nh->oi = vp->nexthop->oi;
 					nh->router = l->link_data;
 					added = 1;
-					ospf_spf_add_parent(v, w, nh, distance);
+					ospf_spf_add_parent(v, w, nh, distance, 1);
 				}
 				/* Note lack of return is deliberate. See next comment. */
 			}
@@ -689,9 +778,9 @@ static unsigned int ospf_nexthop_calculation(struct ospf_area *area, struct vert
 		zlog_debug("%s: Intervening routers, adding parent(s)", __func__);
 	}
 
-	for(ALL_LIST_ELEMENTS(v->parents, node, nnode, vp)) {
+	for(SPF_ARRAY_ELEMENTS(&v->parents, i, vp)) {
 		added = 1;
-		ospf_spf_add_parent(v, w, vp->nexthop, distance);
+		ospf_spf_add_parent(v, w, vp->nexthop, distance, 0);
 	}
 
 	return added;
@@ -701,8 +790,12 @@ static unsigned int ospf_nexthop_calculation(struct ospf_area *area, struct vert
  * v is on the SPF tree.  Examine the links in v's LSA.  Update the list
  * of candidates with any vertices not already on the list.  If a lower-cost
  * path is found to a vertex already on the candidate list, store the new cost.
+ *
+ * When v was placed again by an incremental run, vertices kept on the tree
+ * which v gives as short a path to are added to stale: their place, and
+ * that of the vertices behind them, has to be recalculated too.
  */
-static void ospf_spf_next(struct vertex *v, struct ospf_area *area, struct pqueue *candidate) {
+static void ospf_spf_next(struct vertex *v, struct ospf_area *area, struct spf_heap *candidate, struct list *stale) {
 	struct ospf_lsa *w_lsa = NULL;
 	u_char *p;
 	u_char *lim;
@@ -710,14 +803,6 @@ static void ospf_spf_next(struct vertex *v, struct ospf_area *area, struct pqueu
 	struct in_addr *r;
 	int type = 0, lsa_pos = -1, lsa_pos_next = 0;
 
-	/* If this is a router-LSA, and bit V of the router-LSA (see Section
-     A.4.2:RFC2328) is set, set Area A's TransitCapability to TRUE.  */
-	if(v->type == OSPF_VERTEX_ROUTER) {
-		if(IS_ROUTER_LSA_VIRTUAL((struct router_lsa *) v->lsa)) {
-			area->transit = OSPF_TRANSIT_TRUE;
-		}
-	}
-
 	if(IS_DEBUG_OSPF_EVENT) {
 		zlog_debug("%s: Next vertex of %s vertex %s", __func__, v->type == OSPF_VERTEX_ROUTER ? "Router" : "Network", inet_ntoa(v->lsa->id));
 	}
@@ -783,7 +868,7 @@ static void ospf_spf_next(struct vertex *v, struct ospf_area *area, struct pqueu
 						}
 					}
 					break;
-				default: zlog_warn("Invalid LSA link type %d", type); continue;
+				default: ospf_spf_warn(area, LOG_WARNING, "Invalid LSA link type %d", type); continue;
 			}
 		} else {
 			/* In case of V is Network-LSA. */
@@ -823,13 +908,10 @@ static void ospf_spf_next(struct vertex *v, struct ospf_area *area, struct pqueu
 			continue;
 		}
 
-		/* (c) If vertex W is already on the shortest-path tree, examine
-         the next link in the LSA. */
-		if(w_lsa->stat == LSA_SPF_IN_SPFTREE) {
-			if(IS_DEBUG_OSPF_EVENT) {
-				zlog_debug("The LSA is already in SPF");
-			}
-			continue;
+		/* The vertex W, bound to this LSA at the start of the run. */
+		w = ospf_vertex_lookup(area, w_lsa->data->type, w_lsa->data->id);
+		if(w == NULL) {
+			w = ospf_vertex_new(area, w_lsa);
 		}
 
 		/* (d) Calculate the link state cost D of the resulting path
@@ -845,20 +927,28 @@ static void ospf_spf_next(struct vertex *v, struct ospf_area *area, struct pqueu
 			distance = v->distance;
 		}
 
-		/* Is there already vertex W in candidate list? */
-		if(w_lsa->stat == LSA_SPF_NOT_EXPLORED) {
-			/* prepare vertex W. */
-			w = ospf_vertex_new(w_lsa);
+		/* (c) If vertex W is already on the shortest-path tree, examine
+         the next link in the LSA. */
+		if(*(w->stat) == LSA_SPF_IN_SPFTREE) {
+			if(IS_DEBUG_OSPF_EVENT) {
+				zlog_debug("The LSA is already in SPF");
+			}
+			if(stale && w != area->spf && CHECK_FLAG(v->flags, OSPF_VERTEX_AFFECTED) && !CHECK_FLAG(w->flags, OSPF_VERTEX_AFFECTED | OSPF_VERTEX_STALE) && distance <= w->distance) {
+				SET_FLAG(w->flags, OSPF_VERTEX_STALE);
+				listnode_add(stale, w);
+			}
+			continue;
+		}
 
+		/* Is there already vertex W in candidate list? */
+		if(*(w->stat) == LSA_SPF_NOT_EXPLORED) {
 			/* Calculate nexthop to W. */
 			if(ospf_nexthop_calculation(area, v, w, l, distance, lsa_pos)) {
-				pqueue_enqueue(w, candidate);
+				spf_heap_push(candidate, w, w->stat, ospf_vertex_key(w));
 			} else if(IS_DEBUG_OSPF_EVENT) {
 				zlog_debug("Nexthop Calc failed");
 			}
-		} else if(w_lsa->stat >= 0) {
-			/* Get the vertex from candidates. */
-			w = candidate->array[w_lsa->stat];
+		} else if(*(w->stat) >= 0) {
 
 			/* if D is greater than. */
 			if(w->distance < distance) {
@@ -878,12 +968,8 @@ static void ospf_spf_next(struct vertex *v, struct ospf_area *area, struct pqueu
                * will flush the old parents
                */
 				if(ospf_nexthop_calculation(area, v, w, l, distance, lsa_pos)) {
-					/* Decrease the key of the node in the heap.
-                 * trickle-sort it up towards root, just in case this
-                 * node should now be the new root due the cost change.
-                 * (next pqueu_{de,en}queue will fully re-heap the queue).
-                 */
-					trickle_up(w_lsa->stat, candidate);
+					/* Decrease the key of the node in the heap. */
+					spf_heap_decrease(candidate, *(w->stat), ospf_vertex_key(w));
 				}
 			}
 		} /* end W is already on the candidate list */
@@ -891,9 +977,9 @@ static void ospf_spf_next(struct vertex *v, struct ospf_area *area, struct pqueu
 }
 
 static void ospf_spf_dump(struct vertex *v, int i) {
-	struct listnode *cnode;
-	struct listnode *nnode;
 	struct vertex_parent *parent;
+	struct vertex *child;
+	unsigned int n;
 
 	if(v->type == OSPF_VERTEX_ROUTER) {
 		if(IS_DEBUG_OSPF_EVENT) {
@@ -907,22 +993,22 @@ static void ospf_spf_dump(struct vertex *v, int i) {
 	}
 
 	if(IS_DEBUG_OSPF_EVENT) {
-		for(ALL_LIST_ELEMENTS_RO(v->parents, nnode, parent)) {
+		for(SPF_ARRAY_ELEMENTS(&v->parents, n, parent)) {
 			zlog_debug(" nexthop %p %s %s", (void *) parent->nexthop, inet_ntoa(parent->nexthop->router), parent->nexthop->oi ? IF_NAME(parent->nexthop->oi) : "NULL");
 		}
 	}
 
 	i++;
 
-	for(ALL_LIST_ELEMENTS_RO(v->children, cnode, v)) {
-		ospf_spf_dump(v, i);
+	for(SPF_ARRAY_ELEMENTS(&v->children, n, child)) {
+		ospf_spf_dump(child, i);
 	}
 }
 
 /* Second stage of SPF calculation. */
 static void ospf_spf_process_stubs(struct ospf_area *area, struct vertex *v, struct route_table *rt, int parent_is_root) {
-	struct listnode *cnode, *cnnode;
 	struct vertex *child;
+	unsigned int i;
 
 	if(IS_DEBUG_OSPF_EVENT) {
 		zlog_debug("ospf_process_stub():processing stubs for area %s", inet_ntoa(area->area_id));
@@ -959,7 +1045,7 @@ static void ospf_spf_process_stubs(struct ospf_area *area, struct vertex *v, str
 
 	ospf_vertex_dump("ospf_process_stubs(): after examining links: ", v, 1, 1);
 
-	for(ALL_LIST_ELEMENTS(v->children, cnode, cnnode, child)) {
+	for(SPF_ARRAY_ELEMENTS(&v->children, i, child)) {
 		if(CHECK_FLAG(child->flags, OSPF_VERTEX_PROCESSED)) {
 			continue;
 		}
@@ -1068,86 +1154,419 @@ ospf_rtrs_print (struct route_table *rtrs)
 }
 #endif
 
-/* Calculating the shortest-path tree for an area. */
-static void ospf_spf_calculate(struct ospf_area *area, struct route_table *new_table, struct route_table *new_rtrs) {
-	struct pqueue *candidate;
-	struct vertex *v;
+/* What the nexthops from the root are calculated from, besides the LSAs. */
+static struct spf_if_state *ospf_spf_if_state(struct ospf_area *area, unsigned int *count) {
+	struct spf_if_state *ifs, *s;
+	struct ospf_interface *oi;
+	struct ospf_neighbor *nbr;
+	struct route_node *rn;
+	struct listnode *node;
+	unsigned int n = 0;
+
+	for(ALL_LIST_ELEMENTS_RO(area->oiflist, node, oi)) {
+		n++;
+		if(oi->type == OSPF_IFTYPE_POINTOPOINT) {
+			for(rn = route_top(oi->nbrs); rn; rn = route_next(rn)) {
+				if(rn->info) {
+					n++;
+				}
+			}
+		}
+	}
 
-	if(IS_DEBUG_OSPF_EVENT) {
-		zlog_debug("ospf_spf_calculate: Start");
-		zlog_debug("ospf_spf_calculate: running Dijkstra for area %s", inet_ntoa(area->area_id));
+	*count = n;
+	if(n == 0) {
+		return NULL;
 	}
 
-	/* Check router-lsa-self.  If self-router-lsa is not yet allocated,
-     return this area's calculation. */
-	if(!area->router_lsa_self) {
-		if(IS_DEBUG_OSPF_EVENT) {
-			zlog_debug(
-				"ospf_spf_calculate: "
-				"Skip area %s's calculation due to empty router_lsa_self",
-				inet_ntoa(area->area_id)
-			);
+	/* zeroed, padding included, to compare with memcmp() */
+	ifs = s = XCALLOC(MTYPE_OSPF_TMP, n * sizeof(struct spf_if_state));
+	for(ALL_LIST_ELEMENTS_RO(area->oiflist, node, oi)) {
+		s->oi = oi;
+		s->ifindex = oi->ifp ? oi->ifp->ifindex : IFINDEX_INTERNAL;
+		s->lsa_pos_beg = oi->lsa_pos_beg;
+		s->lsa_pos_end = oi->lsa_pos_end;
+		s->type = oi->type;
+		if(oi->address) {
+			s->address = oi->address->u.prefix4;
+			s->prefixlen = oi->address->prefixlen;
 		}
+		s++;
+
+		if(oi->type == OSPF_IFTYPE_POINTOPOINT) {
+			for(rn = route_top(oi->nbrs); rn; rn = route_next(rn)) {
+				if((nbr = rn->info)) {
+					memcpy(s, s - 1, sizeof(struct spf_if_state));
+					s->nbr_id = nbr->router_id;
+					s->nbr_src = nbr->src;
+					s++;
+				}
+			}
+		}
+	}
+	return ifs;
+}
+
+static void ospf_spf_lsa_change(struct ospf_area *area, struct ospf_lsa *lsa, struct list *changed) {
+	struct vertex *v;
+
+	/* MaxAge LSAs are passed over by the calculation, as if gone */
+	if(IS_LSA_MAXAGE(lsa)) {
 		return;
 	}
 
-	/* RFC2328 16.1. (1). */
-	/* Initialize the algorithm's data structures. */
+	v = ospf_vertex_lookup(area, lsa->data->type, lsa->data->id);
+	if(v == NULL) {
+		v = ospf_vertex_new(area, lsa);
+		listnode_add(changed, v);
+	} else if(v->origin != lsa) {
+		/* a refresh with the same contents changes nothing */
+		if(ospf_lsa_different(v->origin, lsa)) {
+			listnode_add(changed, v);
+		}
+		ospf_vertex_bind(v, lsa);
+	}
+	SET_FLAG(v->flags, OSPF_VERTEX_SEEN);
+}
+
+/* RFC2328 16.1. (1), keeping what still holds from the previous run.
+ *
+ * Bind a vertex to each router-LSA and network-LSA the calculation would
+ * look up, and collect those whose LSA is new, different or gone since
+ * the last run.  Returns whether the rest of the previous tree can be
+ * kept, which needs the root, its interfaces and neighbours as they were.
+ */
+static int ospf_spf_changes(struct ospf_area *area, struct list *changed) {
+	struct route_node *rn;
+	struct ospf_lsa *lsa, *prev = NULL;
+	struct spf_if_state *ifs;
+	struct vertex_array va;
+	struct vertex *root;
+	unsigned int i, count;
+	int keep = (area->spf != NULL);
+
+	root = ospf_vertex_lookup(area, OSPF_VERTEX_ROUTER, area->router_lsa_self->data->id);
+	if(root != area->spf) {
+		keep = 0;
+	}
+	if(root == NULL) {
+		root = ospf_vertex_new(area, area->router_lsa_self);
+	} else if(root->origin != area->router_lsa_self) {
+		if(ospf_lsa_different(root->origin, area->router_lsa_self)) {
+			keep = 0;
+		}
+		ospf_vertex_bind(root, area->router_lsa_self);
+	}
+	area->spf = root;
+	SET_FLAG(root->flags, OSPF_VERTEX_SEEN);
+
+	/* Router-LSAs are looked up by ID and advertising router alike. */
+	LSDB_LOOP(ROUTER_LSDB(area), rn, lsa) {
+		if(IPV4_ADDR_SAME(&lsa->data->id, &lsa->data->adv_router) && !IPV4_ADDR_SAME(&lsa->data->id, &root->id)) {
+			ospf_spf_lsa_change(area, lsa, changed);
+		}
+	}
+
+	/* Network-LSAs by ID only, the first one found for it. */
+	LSDB_LOOP(NETWORK_LSDB(area), rn, lsa) {
+		if(prev == NULL || !IPV4_ADDR_SAME(&lsa->data->id, &prev->data->id)) {
+			ospf_spf_lsa_change(area, lsa, changed);
+		}
+		prev = lsa;
+	}
+
+	ospf_vertex_array_get(area, &va);
+	for(i = 0; i < va.count; i++) {
+		if(!CHECK_FLAG(va.vertices[i]->flags, OSPF_VERTEX_SEEN)) {
+			SET_FLAG(va.vertices[i]->flags, OSPF_VERTEX_GONE);
+			listnode_add(changed, va.vertices[i]);
+		}
+		UNSET_FLAG(va.vertices[i]->flags, OSPF_VERTEX_SEEN);
+	}
+	XFREE(MTYPE_OSPF_TMP, va.vertices);
+
+	ifs = ospf_spf_if_state(area, &count);
+	if(count != area->spf_ifs_count || (count && memcmp(ifs, area->spf_ifs, count * sizeof(struct spf_if_state)) != 0)) {
+		keep = 0;
+	}
+	if(area->spf_ifs) {
+		XFREE(MTYPE_OSPF_TMP, area->spf_ifs);
+	}
+	area->spf_ifs = ifs;
+	area->spf_ifs_count = count;
+
+	/* Nexthops through virtual links come from the transit areas. */
+	if(OSPF_IS_AREA_BACKBONE(area) && listcount(area->ospf->vlinks) > 0) {
+		keep = 0;
+	}
+
+	return keep;
+}
+
+/* Take the vertices whose LSA is gone out of the area, once out of the
+   tree.  They are freed when the calculation is finished, as that may
+   free their LSAs too, which a SPF thread mustn't. */
+static void ospf_spf_release_gone(struct ospf_area *area, struct list *changed) {
+	struct listnode *node, *nnode;
+	struct vertex *v;
+
+	for(ALL_LIST_ELEMENTS(changed, node, nnode, v)) {
+		if(CHECK_FLAG(v->flags, OSPF_VERTEX_GONE)) {
+			list_delete_node(changed, node);
+			hash_release(area->spf_vertices, v);
+			listnode_add(area->spf_job->gone, v);
+		}
+	}
+}
+
+/* RFC2328 16.1. (3) to (5). */
+static void ospf_spf_dijkstra(struct ospf_area *area, struct spf_heap *candidate, struct list *stale) {
+	struct vertex *v;
+
+	/* If at this step the candidate list is empty, the shortest-
+     path tree (of transit vertices) has been completely built and
+     this stage of the procedure terminates. */
+	while(spf_heap_count(candidate) > 0) {
+		/* Otherwise, choose the vertex belonging to the candidate list
+	 that is closest to the root, and add it to the shortest-path
+	 tree (removing it from the candidate list in the
+	 process). */
+		/* Extract from the candidates the node with the lower key. */
+		v = spf_heap_pop(candidate);
+		/* Update stat field in vertex. */
+		*(v->stat) = LSA_SPF_IN_SPFTREE;
+
+		ospf_vertex_add_parent(v);
+
+		/* Iterate the algorithm by returning to Step 2. */
+		ospf_spf_next(v, area, candidate, stale);
+	}
+}
+
+/* The whole tree, starting from the root alone. */
+static void ospf_spf_full(struct ospf_area *area, struct list *changed) {
+	struct spf_heap *candidate;
+	struct vertex_array va;
+	unsigned int i;
+
+	ospf_vertex_array_get(area, &va);
+	for(i = 0; i < va.count; i++) {
+		ospf_vertex_flush_parents(va.vertices[i]);
+		spf_array_clear(&va.vertices[i]->children);
+		va.vertices[i]->distance = 0;
+	}
+	XFREE(MTYPE_OSPF_TMP, va.vertices);
+	ospf_spf_release_gone(area, changed);
 
 	/* This function scans all the LSA database and set the stat field to
    * LSA_SPF_NOT_EXPLORED. */
 	ospf_lsdb_clean_stat(area->lsdb);
 	/* Create a new heap for the candidates. */
-	candidate = pqueue_create();
-	candidate->cmp = cmp;
-	candidate->update = update_stat;
-
-	/* Initialize the shortest-path tree to only the root (which is the
-     router doing the calculation). */
-	ospf_spf_init(area);
-	v = area->spf;
+	candidate = spf_heap_new();
+
 	/* Set LSA position to LSA_SPF_IN_SPFTREE. This vertex is the root of the
    * spanning tree. */
-	*(v->stat) = LSA_SPF_IN_SPFTREE;
+	*(area->spf->stat) = LSA_SPF_IN_SPFTREE;
+
+	ospf_spf_next(area->spf, area, candidate, NULL);
+	ospf_spf_dijkstra(area, candidate, NULL);
+
+	spf_heap_free(candidate);
+}
+
+/* Mark v, and the vertices whose path goes through it, as affected. */
+static void ospf_spf_mark_subtree(struct vertex *v, struct list *affected) {
+	struct listnode *node;
+	struct vertex *w, *child;
+	unsigned int i;
+
+	if(CHECK_FLAG(v->flags, OSPF_VERTEX_AFFECTED)) {
+		return;
+	}
+	SET_FLAG(v->flags, OSPF_VERTEX_AFFECTED);
+	listnode_add(affected, v);
+
+	/* breadth first, the end of the list serving as the queue */
+	for(node = listtail(affected); node; node = listnextnode(node)) {
+		w = listgetdata(node);
+		for(SPF_ARRAY_ELEMENTS(&w->children, i, child)) {
+			if(!CHECK_FLAG(child->flags, OSPF_VERTEX_AFFECTED)) {
+				SET_FLAG(child->flags, OSPF_VERTEX_AFFECTED);
+				listnode_add(affected, child);
+			}
+		}
+	}
+}
+
+/* Collect the unaffected vertices of the tree which v has links to: the
+ * only ones it can be reached from, as links must go both ways.
+ */
+static void ospf_spf_boundary(struct ospf_area *area, struct vertex *v, struct list *boundary) {
+	struct router_lsa_link *l;
+	struct vertex *u;
+	u_char *p;
+	u_char *lim;
+
+	p = ((u_char *) v->lsa) + OSPF_LSA_HEADER_SIZE + 4;
+	lim = ((u_char *) v->lsa) + ntohs(v->lsa->length);
+
+	while(p < lim) {
+		u = NULL;
+		if(v->type == OSPF_VERTEX_ROUTER) {
+			l = (struct router_lsa_link *) p;
+			p += (OSPF_ROUTER_LSA_LINK_SIZE + (l->m[0].tos_count * OSPF_ROUTER_LSA_TOS_SIZE));
+
+			switch(l->m[0].type) {
+				case LSA_LINK_TYPE_POINTOPOINT:
+				case LSA_LINK_TYPE_VIRTUALLINK: u = ospf_vertex_lookup(area, OSPF_VERTEX_ROUTER, l->link_id); break;
+				case LSA_LINK_TYPE_TRANSIT: u = ospf_vertex_lookup(area, OSPF_VERTEX_NETWORK, l->link_id); break;
+				default: break;
+			}
+		} else {
+			u = ospf_vertex_lookup(area, OSPF_VERTEX_ROUTER, *(struct in_addr *) p);
+			p += sizeof(struct in_addr);
+		}
+
+		if(u && !CHECK_FLAG(u->flags, OSPF_VERTEX_AFFECTED | OSPF_VERTEX_BOUNDARY) && ospf_vertex_in_tree(area, u)) {
+			SET_FLAG(u->flags, OSPF_VERTEX_BOUNDARY);
+			listnode_add(boundary, u);
+		}
+	}
+}
+
+/* Incremental SPF: keep the vertices of the previous tree whose path does
+ * not go through a changed one, and run Dijkstra again for the others
+ * only, from their neighbours on the kept part of the tree.
+ *
+ * A changed vertex may also give a shorter, or equally short, path to a
+ * kept one; those are found as the affected vertices are placed, and all
+ * behind them is then placed again in a further round.  Returns 0, to run
+ * the whole calculation instead, once half of the vertices are affected.
+ */
+static int ospf_spf_incremental(struct ospf_area *area, struct list *changed) {
+	struct list *affected, *boundary, *stale;
+	struct listnode *node, *nnode;
+	struct spf_heap *candidate;
+	struct vertex_array va;
+	struct vertex *v;
+	unsigned int i, rounds = 0;
+	int done = 0;
+
+	affected = list_new();
+	boundary = list_new();
+	stale = list_new();
+
+	for(ALL_LIST_ELEMENTS_RO(changed, node, v)) {
+		ospf_spf_mark_subtree(v, affected);
+	}
+
+	while(listcount(affected) * 2 <= area->spf_vertices->count) {
+		rounds++;
+
+		for(ALL_LIST_ELEMENTS(affected, node, nnode, v)) {
+			ospf_vertex_detach(v);
+			if(CHECK_FLAG(v->flags, OSPF_VERTEX_GONE)) {
+				list_delete_node(affected, node);
+			}
+		}
+		ospf_spf_release_gone(area, changed);
+
+		ospf_lsdb_clean_stat(area->lsdb);
+		ospf_vertex_array_get(area, &va);
+		for(i = 0; i < va.count; i++) {
+			if(ospf_vertex_in_tree(area, va.vertices[i])) {
+				*(va.vertices[i]->stat) = LSA_SPF_IN_SPFTREE;
+			}
+		}
+		XFREE(MTYPE_OSPF_TMP, va.vertices);
+
+		candidate = spf_heap_new();
+		for(ALL_LIST_ELEMENTS_RO(affected, node, v)) {
+			ospf_spf_boundary(area, v, boundary);
+		}
+		for(ALL_LIST_ELEMENTS_RO(boundary, node, v)) {
+			UNSET_FLAG(v->flags, OSPF_VERTEX_BOUNDARY);
+			ospf_spf_next(v, area, candidate, stale);
+		}
+		list_delete_all_node(boundary);
+
+		ospf_spf_dijkstra(area, candidate, stale);
+		spf_heap_free(candidate);
+
+		if(listcount(stale) == 0) {
+			done = 1;
+			break;
+		}
+
+		for(ALL_LIST_ELEMENTS_RO(stale, node, v)) {
+			UNSET_FLAG(v->flags, OSPF_VERTEX_STALE);
+			ospf_spf_mark_subtree(v, affected);
+		}
+		list_delete_all_node(stale);
+	}
+
+	if(IS_DEBUG_OSPF_EVENT) {
+		zlog_debug("%s: area %s, %d changed, %d of %lu vertices placed again in %u rounds%s", __func__, inet_ntoa(area->area_id), listcount(changed), listcount(affected), area->spf_vertices->count, rounds, done ? "" : ", giving up");
+	}
+
+	for(ALL_LIST_ELEMENTS_RO(affected, node, v)) {
+		UNSET_FLAG(v->flags, OSPF_VERTEX_AFFECTED);
+	}
+
+	list_delete(affected);
+	list_delete(boundary);
+	list_delete(stale);
+
+	return done;
+}
+
+/* RFC2328 16.1. (4), and the second stage, from the whole tree. */
+static void ospf_spf_routes(struct ospf_area *area, struct route_table *new_table, struct route_table *new_rtrs) {
+	struct vertex_array va;
+	struct vertex *v;
+	unsigned int i, n = 0;
 
 	/* Set Area A's TransitCapability to FALSE. */
 	area->transit = OSPF_TRANSIT_FALSE;
 	area->shortcut_capability = 1;
 
-	for(;;) {
-		/* RFC2328 16.1. (2). */
-		ospf_spf_next(v, area, candidate);
+	/* Reset ABR and ASBR router counts. */
+	area->abr_count = 0;
+	area->asbr_count = 0;
+
+	ospf_vertex_array_get(area, &va);
+	for(i = 0; i < va.count; i++) {
+		v = va.vertices[i];
+		UNSET_FLAG(v->flags, OSPF_VERTEX_PROCESSED);
 
-		/* RFC2328 16.1. (3). */
-		/* If at this step the candidate list is empty, the shortest-
-         path tree (of transit vertices) has been completely built and
-         this stage of the procedure terminates. */
-		if(candidate->size == 0) {
-			break;
+		if(!ospf_vertex_in_tree(area, v)) {
+			continue;
 		}
 
-		/* Otherwise, choose the vertex belonging to the candidate list
-         that is closest to the root, and add it to the shortest-path
-         tree (removing it from the candidate list in the
-         process). */
-		/* Extract from the candidates the node with the lower key. */
-		v = (struct vertex *) pqueue_dequeue(candidate);
-		/* Update stat field in vertex. */
-		*(v->stat) = LSA_SPF_IN_SPFTREE;
+		/* If this is a router-LSA, and bit V of the router-LSA (see Section
+	 A.4.2:RFC2328) is set, set Area A's TransitCapability to TRUE.  */
+		if(v->type == OSPF_VERTEX_ROUTER && IS_ROUTER_LSA_VIRTUAL((struct router_lsa *) v->lsa)) {
+			area->transit = OSPF_TRANSIT_TRUE;
+		}
 
-		ospf_vertex_add_parent(v);
+		if(v != area->spf) {
+			va.vertices[n++] = v;
+		}
+	}
 
-		/* RFC2328 16.1. (4). */
+	/* In the order they were added to the tree, as multiple network
+     vertices for one IP network are settled by distance. */
+	qsort(va.vertices, n, sizeof(struct vertex *), ospf_vertex_array_cmp);
+
+	for(i = 0; i < n; i++) {
+		v = va.vertices[i];
 		if(v->type == OSPF_VERTEX_ROUTER) {
 			ospf_intra_add_router(new_rtrs, v, area);
 		} else {
 			ospf_intra_add_transit(new_table, v, area);
 		}
-
-		/* RFC2328 16.1. (5). */
-		/* Iterate the algorithm by returning to Step 2. */
-
-	} /* end loop until no more candidate vertices */
+	}
+	XFREE(MTYPE_OSPF_TMP, va.vertices);
 
 	if(IS_DEBUG_OSPF_EVENT) {
 		ospf_spf_dump(area->spf, 0);
@@ -1156,44 +1575,185 @@ static void ospf_spf_calculate(struct ospf_area *area, struct route_table *new_t
 
 	/* Second stage of SPF calculation procedure's  */
 	ospf_spf_process_stubs(area, area->spf, new_table, 0);
+}
+
+/* Calculating the shortest-path tree for an area, RFC2328 16.1. (1):
+   what the calculation starts from.  Returns 0 if there's nothing to
+   calculate. */
+static int ospf_spf_prepare(struct ospf_spf_job *job, struct ospf_area *area) {
+	struct ospf_spf_log *log = &area->spf_log[area->spf_log_next];
 
-	/* Free candidate queue. */
-	pqueue_delete(candidate);
+	memset(log, 0, sizeof(struct ospf_spf_log));
+	memset(job, 0, sizeof(struct ospf_spf_job));
+
+	if(IS_DEBUG_OSPF_EVENT) {
+		zlog_debug("ospf_spf_calculate: Start");
+		zlog_debug("ospf_spf_calculate: running Dijkstra for area %s", inet_ntoa(area->area_id));
+	}
+
+	/* Check router-lsa-self.  If self-router-lsa is not yet allocated,
+     return this area's calculation. */
+	if(!area->router_lsa_self) {
+		if(IS_DEBUG_OSPF_EVENT) {
+			zlog_debug(
+				"ospf_spf_calculate: "
+				"Skip area %s's calculation due to empty router_lsa_self",
+				inet_ntoa(area->area_id)
+			);
+		}
+		ospf_spf_free(area);
+		return 0;
+	}
+
+	/* Initialize the algorithm's data structures. */
+	quagga_gettime(QUAGGA_CLK_MONOTONIC, &log->ts);
+	job->area = area;
+	job->changed = list_new();
+	job->gone = list_new();
+	job->incremental = ospf_spf_changes(area, job->changed);
+	area->spf_job = job;
+	QUAGGA_TRACE(ospf, spf_start, area->area_id.s_addr, job->incremental);
+
+	return 1;
+}
+
+/* The shortest-path tree, on an SPF thread or not. */
+static void ospf_spf_compute(void *arg) {
+	struct ospf_spf_job *job = arg;
+
+	if(job->incremental && listcount(job->changed) > 0) {
+		job->incremental = ospf_spf_incremental(job->area, job->changed);
+	}
+	if(!job->incremental) {
+		ospf_spf_full(job->area, job->changed);
+	}
+}
+
+/* Work out the trees of the jobs, on the SPF threads if there are any
+   and it's worth it.  With event debugging on, they stay on the main
+   thread to log as they go. */
+static void ospf_spf_compute_all(struct ospf_spf_job **jobs, unsigned int n) {
+	unsigned int i;
+
+	if(om->spf_threads && ospf_spf_pool == NULL) {
+		ospf_spf_pool = work_pool_new(om->master, "OSPF SPF", om->spf_threads);
+	}
+
+	if(ospf_spf_pool && n > 1 && !IS_DEBUG_OSPF_EVENT) {
+		for(i = 0; i < n; i++) {
+			jobs[i]->threaded = 1;
+		}
+		work_pool_run(ospf_spf_pool, ospf_spf_compute, (void **) jobs, n);
+	} else {
+		for(i = 0; i < n; i++) {
+			ospf_spf_compute(jobs[i]);
+		}
+	}
+}
+
+/* The routes of an area from its tree, in the tables shared by all. */
+static void ospf_spf_finish(struct ospf_spf_job *job, struct route_table *new_table, struct route_table *new_rtrs) {
+	struct ospf_area *area = job->area;
+	struct ospf_spf_log *log = &area->spf_log[area->spf_log_next];
+	struct listnode *node;
+	struct vertex *v;
+
+	area->spf_job = NULL;
+	if(job->warnings) {
+		zlog(NULL, job->warn_priority, "%s%s", job->warning, job->warnings > 1 ? " (and more in this SPF run)" : "");
+	}
+
+	for(ALL_LIST_ELEMENTS_RO(job->gone, node, v)) {
+		ospf_vertex_free(area, v);
+	}
+	list_delete(job->gone);
+	list_delete(job->changed);
+
+	if(job->incremental) {
+		area->spf_incremental++;
+		log->incremental = 1;
+	}
+
+	ospf_spf_routes(area, new_table, new_rtrs);
 
 	ospf_vertex_dump(__func__, area->spf, 0, 1);
-	/* Free nexthop information, canonical versions of which are attached
-   * the first level of router vertices attached to the root vertex, see
-   * ospf_nexthop_calculation.
-   */
-	ospf_canonical_nexthops_free(area->spf);
 
 	/* Increment SPF Calculation Counter. */
 	area->spf_calculation++;
 
+	/* with SPF threads, the time until the area's tree was in */
 	quagga_gettime(QUAGGA_CLK_MONOTONIC, &area->ospf->ts_spf);
 	area->ts_spf = area->ospf->ts_spf;
+	log->spf = timeval_elapsed(area->ts_spf, log->ts);
+	QUAGGA_TRACE(ospf, spf_done, area->area_id.s_addr, spf_pool_count(area->spf_pool), job->incremental, log->spf);
 
 	if(IS_DEBUG_OSPF_EVENT) {
-		zlog_debug("ospf_spf_calculate: Stop. %zd vertices", mtype_stats_alloc(MTYPE_OSPF_VERTEX));
+		zlog_debug("ospf_spf_calculate: Stop. %lu vertices%s", spf_pool_count(area->spf_pool), job->incremental ? ", incremental" : "");
 	}
+}
 
-	/* Free SPF vertices, but not the list. List has ospf_vertex_free
-   * as deconstructor.
-   */
-	list_delete_all_node(&vertex_list);
+/* One area on its own. */
+static void ospf_spf_calculate(struct ospf_area *area, struct route_table *new_table, struct route_table *new_rtrs) {
+	struct ospf_spf_job job, *jobs = &job;
+
+	if(ospf_spf_prepare(&job, area)) {
+		ospf_spf_compute_all(&jobs, 1);
+		ospf_spf_finish(&job, new_table, new_rtrs);
+	}
+}
+
+/* Complete the log entry of an area calculated in this SPF run. */
+static void ospf_spf_log(struct ospf_area *area, u_int32_t reason, unsigned long ia_time, unsigned long ase_time, unsigned long rt_time) {
+	struct ospf_spf_log *log = &area->spf_log[area->spf_log_next];
+	unsigned long total, limit;
+	int i;
+
+	if(log->ts.tv_sec == 0 && log->ts.tv_usec == 0) {
+		return;
+	}
+
+	log->reason = reason;
+	log->ia = ia_time;
+	log->ase = ase_time;
+	log->install = rt_time;
+
+	total = log->spf + log->ia + log->ase + log->install;
+	for(i = 0, limit = 1000; i < OSPF_SPF_HISTOGRAM_SIZE - 1 && total >= limit; i++) {
+		limit *= 10;
+	}
+	area->spf_histogram[i]++;
+
+	area->spf_log_next = (area->spf_log_next + 1) % OSPF_SPF_LOG_SIZE;
+}
+
+/* A full AS-external calculation follows the SPF run that asked for it:
+   count its time into that run. */
+void ospf_spf_log_ase(struct ospf *ospf, unsigned long ase_time) {
+	struct ospf_spf_log *log;
+	struct ospf_area *area;
+	struct listnode *node;
+
+	for(ALL_LIST_ELEMENTS_RO(ospf->areas, node, area)) {
+		log = &area->spf_log[(area->spf_log_next + OSPF_SPF_LOG_SIZE - 1) % OSPF_SPF_LOG_SIZE];
+		if(log->ts.tv_sec || log->ts.tv_usec) {
+			log->ase += ase_time;
+		}
+	}
 }
 
 /* Timer for SPF calculation. */
 static int ospf_spf_calculate_timer(struct thread *thread) {
 	struct ospf *ospf = THREAD_ARG(thread);
 	struct route_table *new_table, *new_rtrs;
+	struct ospf_spf_job *jobs, **args;
 	struct ospf_area *area;
-	struct listnode *node, *nnode;
+	struct listnode *node;
 	struct timeval start_time, stop_time, spf_start_time;
-	int areas_processed = 0;
-	unsigned long ia_time, prune_time, rt_time;
+	int areas_processed = 0, backbone_apart;
+	unsigned int i, n = 0;
+	unsigned long ia_time, prune_time, rt_time, ase_time;
 	unsigned long abr_time, total_spf_time, spf_time;
-	char rbuf[32]; /* reason_buf */
+	char rbuf[OSPF_SPF_REASON_STR_SIZE]; /* reason_buf */
 
 	if(IS_DEBUG_OSPF_EVENT) {
 		zlog_debug("SPF: Timer (SPF calculation expire)");
@@ -1208,21 +1768,40 @@ static int ospf_spf_calculate_timer(struct thread *thread) {
 
 	ospf_vl_unapprove(ospf);
 
-	/* Calculate SPF for each area. */
-	for(ALL_LIST_ELEMENTS(ospf->areas, node, nnode, area)) {
-		/* Do backbone last, so as to first discover intra-area paths
-       * for any back-bone virtual-links
-       */
+	/* Calculate SPF for each area.  Do backbone last, so as to first
+     discover intra-area paths for any back-bone virtual-links: with
+     those, only once the other areas' routes are in. */
+	jobs = XCALLOC(MTYPE_OSPF_TMP, listcount(ospf->areas) * sizeof(struct ospf_spf_job));
+	args = XCALLOC(MTYPE_OSPF_TMP, listcount(ospf->areas) * sizeof(struct ospf_spf_job *));
+	backbone_apart = ospf->backbone && listcount(ospf->vlinks) > 0;
+
+	for(ALL_LIST_ELEMENTS_RO(ospf->areas, node, area)) {
 		if(ospf->backbone && ospf->backbone == area) {
 			continue;
 		}
-
-		ospf_spf_calculate(area, new_table, new_rtrs);
+		if(ospf_spf_prepare(&jobs[n], area)) {
+			args[n] = &jobs[n];
+			n++;
+		}
 		areas_processed++;
 	}
+	if(ospf->backbone && !backbone_apart) {
+		if(ospf_spf_prepare(&jobs[n], ospf->backbone)) {
+			args[n] = &jobs[n];
+			n++;
+		}
+		areas_processed++;
+	}
+
+	ospf_spf_compute_all(args, n);
+	for(i = 0; i < n; i++) {
+		ospf_spf_finish(args[i], new_table, new_rtrs);
+	}
+	XFREE(MTYPE_OSPF_TMP, args);
+	XFREE(MTYPE_OSPF_TMP, jobs);
 
 	/* SPF for backbone, if required */
-	if(ospf->backbone) {
+	if(backbone_apart) {
 		ospf_spf_calculate(ospf->backbone, new_table, new_rtrs);
 		areas_processed++;
 	}
@@ -1247,14 +1826,6 @@ static int ospf_spf_calculate_timer(struct thread *thread) {
 	prune_time = timeval_elapsed(stop_time, start_time);
 	/* AS-external-LSA calculation should not be performed here. */
 
-	/* If new Router Route is installed,
-     then schedule re-calculate External routes. */
-	if(1) {
-		ospf_ase_calculate_schedule(ospf);
-	}
-
-	ospf_ase_calculate_timer_add(ospf);
-
 	quagga_gettime(QUAGGA_CLK_MONOTONIC, &start_time);
 
 	/* Update routing table. */
@@ -1272,10 +1843,17 @@ static int ospf_spf_calculate_timer(struct thread *thread) {
 	ospf->old_rtrs = ospf->new_rtrs;
 	ospf->new_rtrs = new_rtrs;
 
+	/* Recalculate the external routes the new routes can change, or
+     schedule recalculating them all. */
 	quagga_gettime(QUAGGA_CLK_MONOTONIC, &start_time);
-	if(IS_OSPF_ABR(ospf)) {
-		ospf_abr_task(ospf);
-	}
+	ospf_ase_spf_update(ospf);
+	ospf_ase_calculate_timer_add(ospf);
+
+	quagga_gettime(QUAGGA_CLK_MONOTONIC, &stop_time);
+	ase_time = timeval_elapsed(stop_time, start_time);
+
+	quagga_gettime(QUAGGA_CLK_MONOTONIC, &start_time);
+	ospf_abr_spf_update(ospf);
 
 	quagga_gettime(QUAGGA_CLK_MONOTONIC, &stop_time);
 	abr_time = timeval_elapsed(stop_time, start_time);
@@ -1285,7 +1863,7 @@ static int ospf_spf_calculate_timer(struct thread *thread) {
 	ospf->ts_spf_duration.tv_sec = total_spf_time / 1000000;
 	ospf->ts_spf_duration.tv_usec = total_spf_time % 1000000;
 
-	ospf_get_spf_reason_str(rbuf);
+	ospf_get_spf_reason_str(ospf->spf_reason, rbuf);
 
 	if(IS_DEBUG_OSPF_EVENT) {
 		zlog_info("SPF Processing Time(usecs): %ld", total_spf_time);
@@ -1293,41 +1871,90 @@ static int ospf_spf_calculate_timer(struct thread *thread) {
 		zlog_info("\t   InterArea: %ld", ia_time);
 		zlog_info("\t       Prune: %ld", prune_time);
 		zlog_info("\tRouteInstall: %ld", rt_time);
+		zlog_info("\t    External: %ld", ase_time);
 		if(IS_OSPF_ABR(ospf)) {
 			zlog_info("\t         ABR: %ld (%d areas)", abr_time, areas_processed);
 		}
 		zlog_info("Reason(s) for SPF: %s", rbuf);
 	}
 
-	ospf_clear_spf_reason_flags();
+	for(ALL_LIST_ELEMENTS_RO(ospf->areas, node, area)) {
+		ospf_spf_log(area, ospf->spf_reason, ia_time, ase_time, rt_time);
+	}
+	ospf->spf_reason = 0;
 
 	return 0;
 }
 
-/* Add schedule for SPF calculation.  To avoid frequenst SPF calc, we
-   set timer for SPF calc. */
-void ospf_spf_calculate_schedule(struct ospf *ospf, ospf_spf_reason_t reason) {
-	unsigned long delay, elapsed, ht;
-	struct timeval result;
+/* RFC 8405 SPF back-off: no event for the holddown interval, so the
+   next one is dealt with quickly again. */
+static int ospf_spf_holddown_timer(struct thread *thread) {
+	struct ospf *ospf = THREAD_ARG(thread);
+
+	ospf->t_spf_holddown = NULL;
+	OSPF_TIMER_OFF(ospf->t_spf_learn);
+	ospf->spf_backoff_state = OSPF_SPF_BACKOFF_QUIET;
 
 	if(IS_DEBUG_OSPF_EVENT) {
-		zlog_debug("SPF: calculation timer scheduled");
+		zlog_debug("SPF: back-off holddown expired, quiet");
 	}
+	return 0;
+}
 
-	/* OSPF instance does not exist. */
-	if(ospf == NULL) {
-		return;
+/* More than a single event to learn, it seems: wait longer. */
+static int ospf_spf_learn_timer(struct thread *thread) {
+	struct ospf *ospf = THREAD_ARG(thread);
+
+	ospf->t_spf_learn = NULL;
+	ospf->spf_backoff_state = OSPF_SPF_BACKOFF_LONG_WAIT;
+
+	if(IS_DEBUG_OSPF_EVENT) {
+		zlog_debug("SPF: back-off time to learn expired, long wait");
 	}
+	return 0;
+}
 
-	ospf_spf_set_reason(reason);
+/* An IGP event for the RFC 8405 state machine; returns the SPF delay,
+   should the SPF timer not be running already. */
+static unsigned long ospf_spf_backoff_event(struct ospf *ospf) {
+	unsigned long delay;
+
+	switch(ospf->spf_backoff_state) {
+		case OSPF_SPF_BACKOFF_QUIET:
+			delay = ospf->spf_initial_delay;
+			ospf->spf_backoff_state = OSPF_SPF_BACKOFF_SHORT_WAIT;
+			OSPF_TIMER_OFF(ospf->t_spf_learn);
+			ospf->t_spf_learn = thread_add_timer_msec(master, ospf_spf_learn_timer, ospf, ospf->spf_time_to_learn);
+			break;
+		case OSPF_SPF_BACKOFF_SHORT_WAIT: delay = ospf->spf_short_delay; break;
+		default: delay = ospf->spf_long_delay; break;
+	}
 
-	/* SPF calculation timer is already scheduled. */
-	if(ospf->t_spf_calc) {
-		if(IS_DEBUG_OSPF_EVENT) {
-			zlog_debug("SPF: calculation timer is already scheduled: %p", (void *) ospf->t_spf_calc);
-		}
-		return;
+	OSPF_TIMER_OFF(ospf->t_spf_holddown);
+	ospf->t_spf_holddown = thread_add_timer_msec(master, ospf_spf_holddown_timer, ospf, ospf->spf_holddown);
+
+	return delay;
+}
+
+/* Back to the hold time multiplier, once the back-off is unconfigured. */
+void ospf_spf_backoff_reset(struct ospf *ospf) {
+	OSPF_TIMER_OFF(ospf->t_spf_holddown);
+	OSPF_TIMER_OFF(ospf->t_spf_learn);
+	ospf->spf_backoff_state = OSPF_SPF_BACKOFF_QUIET;
+}
+
+const char *ospf_spf_backoff_state_str(struct ospf *ospf) {
+	switch(ospf->spf_backoff_state) {
+		case OSPF_SPF_BACKOFF_QUIET: return "quiet";
+		case OSPF_SPF_BACKOFF_SHORT_WAIT: return "short wait";
+		default: return "long wait";
 	}
+}
+
+/* The SPF delay by the hold time, multiplied for each event within it. */
+static unsigned long ospf_spf_hold_delay(struct ospf *ospf) {
+	unsigned long delay, elapsed, ht;
+	struct timeval result;
 
 	/* XXX Monotic timers: we only care about relative time here. */
 	result = tv_sub(recent_relative_time(), ospf->ts_spf);
@@ -1360,6 +1987,41 @@ void ospf_spf_calculate_schedule(struct ospf *ospf, ospf_spf_reason_t reason) {
 		delay = ospf->spf_delay;
 		ospf->spf_hold_multiplier = 1;
 	}
+	return delay;
+}
+
+/* Add schedule for SPF calculation.  To avoid frequenst SPF calc, we
+   set timer for SPF calc. */
+void ospf_spf_calculate_schedule(struct ospf *ospf, ospf_spf_reason_t reason) {
+	unsigned long delay = 0;
+
+	if(IS_DEBUG_OSPF_EVENT) {
+		zlog_debug("SPF: calculation timer scheduled");
+	}
+
+	/* OSPF instance does not exist. */
+	if(ospf == NULL) {
+		return;
+	}
+
+	ospf->spf_reason |= 1 << reason;
+
+	/* Every event restarts the back-off holddown, SPF timer due or not. */
+	if(ospf->spf_backoff) {
+		delay = ospf_spf_backoff_event(ospf);
+	}
+
+	/* SPF calculation timer is already scheduled. */
+	if(ospf->t_spf_calc) {
+		if(IS_DEBUG_OSPF_EVENT) {
+			zlog_debug("SPF: calculation timer is already scheduled: %p", (void *) ospf->t_spf_calc);
+		}
+		return;
+	}
+
+	if(!ospf->spf_backoff) {
+		delay = ospf_spf_hold_delay(ospf);
+	}
 
 	if(IS_DEBUG_OSPF_EVENT) {
 		zlog_debug("SPF: calculation timer delay = %ld", delay);
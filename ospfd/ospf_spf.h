@@ -24,25 +24,36 @@
 #ifndef _QUAGGA_OSPF_SPF_H
 #define _QUAGGA_OSPF_SPF_H
 
+#include "spf.h"
+
 /* values for vertex->type */
 #define OSPF_VERTEX_ROUTER 1  /* for a Router-LSA */
 #define OSPF_VERTEX_NETWORK 2 /* for a Network-LSA */
 
 /* values for vertex->flags */
 #define OSPF_VERTEX_PROCESSED 0x01
+#define OSPF_VERTEX_SEEN 0x02	  /* LSA found in the LSDB this run */
+#define OSPF_VERTEX_GONE 0x04	  /* LSA left the LSDB, or is MaxAge */
+#define OSPF_VERTEX_AFFECTED 0x08 /* to be placed again by this run */
+#define OSPF_VERTEX_BOUNDARY 0x10 /* unaffected, next to affected ones */
+#define OSPF_VERTEX_STALE 0x20	  /* reached better through affected ones */
 
 /* The "root" is the node running the SPF calculation */
 
-/* A router or network in an area */
+/* A router or network in an area.  Vertices are kept from one SPF run
+ * to the next, one for each router and network LSA of the area, so that
+ * only the part of the tree behind changed LSAs has to be recalculated.
+ */
 struct vertex {
 	u_char flags;
 	u_char type;		/* copied from LSA header */
 	struct in_addr id;	/* copied from LSA header */
+	struct ospf_lsa *origin; /* LSA calculated from, locked */
 	struct lsa_header *lsa; /* Router or Network LSA */
 	int *stat;		/* Link to LSA status. */
 	u_int32_t distance;	/* from root to this vertex */
-	struct list *parents;	/* list of parents in SPF tree */
-	struct list *children;	/* list of children in SPF tree*/
+	struct spf_array parents;  /* of vertex_parent, in SPF tree */
+	struct spf_array children; /* of vertex, in SPF tree */
 };
 
 /* A nexthop taken on the root node to get to this (parent) vertex */
@@ -55,6 +66,23 @@ struct vertex_parent {
 	struct vertex_nexthop *nexthop; /* link to nexthop info for this parent */
 	struct vertex *parent;		/* parent vertex */
 	int backlink;			/* index back to parent for router-lsa's */
+	int canonical;			/* nexthop is ours, not inherited */
+};
+
+/* What the nexthops from the root were calculated from, besides the
+ * router-LSAs: an entry for each interface of the area, and for each
+ * neighbour on point-to-point ones.
+ */
+struct spf_if_state {
+	struct ospf_interface *oi;
+	ifindex_t ifindex;
+	int lsa_pos_beg;
+	int lsa_pos_end;
+	u_char type;
+	u_char prefixlen;
+	struct in_addr address;
+	struct in_addr nbr_id;
+	struct in_addr nbr_src;
 };
 
 /* What triggered the SPF ? */
@@ -69,8 +97,16 @@ typedef enum {
 	SPF_FLAG_CONFIG_CHANGE,
 } ospf_spf_reason_t;
 
+/* "R, N, S, AS, ABR, ASBR, M, C" */
+#define OSPF_SPF_REASON_STR_SIZE 32
+
 extern void ospf_spf_calculate_schedule(struct ospf *, ospf_spf_reason_t);
 extern void ospf_rtrs_free(struct route_table *);
+extern void ospf_spf_free(struct ospf_area *);
+extern void ospf_get_spf_reason_str(u_int32_t, char *);
+extern void ospf_spf_log_ase(struct ospf *, unsigned long);
+extern void ospf_spf_backoff_reset(struct ospf *);
+extern const char *ospf_spf_backoff_state_str(struct ospf *);
 
 /* void ospf_spf_calculate_timer_add (); */
 #endif /* _QUAGGA_OSPF_SPF_H */
@@ -43,6 +43,7 @@
 #include "hash.h"
 #include "sockunion.h" /* for inet_aton() */
 #include "network.h"
+#include "jhash.h"
 
 #include "ospfd/ospfd.h"
 #include "ospfd/ospf_interface.h"
@@ -91,6 +92,10 @@ static int ospf_mpls_te_lsa_originate_as(void *arg);
 static struct ospf_lsa *ospf_mpls_te_lsa_refresh(struct ospf_lsa *lsa);
 
 static void del_mpls_te_link(void *val);
+static unsigned int mpls_te_link_ifp_key(void *data);
+static int mpls_te_link_ifp_cmp(const void *a, const void *b);
+static unsigned int mpls_te_link_inst_key(void *data);
+static int mpls_te_link_inst_cmp(const void *a, const void *b);
 static void ospf_mpls_te_register_vty(void);
 
 int ospf_mpls_te_init(void) {
@@ -112,6 +117,8 @@ int ospf_mpls_te_init(void) {
 	OspfMplsTE.inter_as = Disable;
 	OspfMplsTE.iflist = list_new();
 	OspfMplsTE.iflist->del = del_mpls_te_link;
+	OspfMplsTE.ifhash = hash_create(mpls_te_link_ifp_key, mpls_te_link_ifp_cmp);
+	OspfMplsTE.insthash = hash_create(mpls_te_link_inst_key, mpls_te_link_inst_cmp);
 
 	ospf_mpls_te_register_vty();
 
@@ -163,6 +170,13 @@ static int ospf_mpls_te_unregister() {
 }
 
 void ospf_mpls_te_term(void) {
+	hash_clean(OspfMplsTE.ifhash, NULL);
+	hash_free(OspfMplsTE.ifhash);
+	OspfMplsTE.ifhash = NULL;
+	hash_clean(OspfMplsTE.insthash, NULL);
+	hash_free(OspfMplsTE.insthash);
+	OspfMplsTE.insthash = NULL;
+
 	list_delete(OspfMplsTE.iflist);
 	OspfMplsTE.iflist = NULL;
 
@@ -184,6 +198,26 @@ static void del_mpls_te_link(void *val) {
 	return;
 }
 
+/* Links are looked up by interface on every link parameter, ISM and
+   interface change, and by instance on every refresh. */
+static unsigned int mpls_te_link_ifp_key(void *data) {
+	struct mpls_te_link *lp = data;
+
+	return jhash_1word((u_int32_t)(uintptr_t) lp->ifp, 0);
+}
+
+static int mpls_te_link_ifp_cmp(const void *a, const void *b) {
+	return ((const struct mpls_te_link *) a)->ifp == ((const struct mpls_te_link *) b)->ifp;
+}
+
+static unsigned int mpls_te_link_inst_key(void *data) {
+	return jhash_1word(((struct mpls_te_link *) data)->instance, 0);
+}
+
+static int mpls_te_link_inst_cmp(const void *a, const void *b) {
+	return ((const struct mpls_te_link *) a)->instance == ((const struct mpls_te_link *) b)->instance;
+}
+
 u_int32_t get_mpls_te_instance_value(void) {
 	static u_int32_t seqno = 0;
 
@@ -229,27 +263,20 @@ out:
 }
 
 static struct mpls_te_link *lookup_linkparams_by_ifp(struct interface *ifp) {
-	struct listnode *node, *nnode;
-	struct mpls_te_link *lp;
+	struct mpls_te_link key;
 
-	for(ALL_LIST_ELEMENTS(OspfMplsTE.iflist, node, nnode, lp)) {
-		if(lp->ifp == ifp) {
-			return lp;
-		}
-	}
-
-	return NULL;
+	key.ifp = ifp;
+	return hash_lookup(OspfMplsTE.ifhash, &key);
 }
 
 static struct mpls_te_link *lookup_linkparams_by_instance(struct ospf_lsa *lsa) {
-	struct listnode *node;
 	struct mpls_te_link *lp;
+	struct mpls_te_link lkey;
 	unsigned int key = GET_OPAQUE_ID(ntohl(lsa->data->id.s_addr));
 
-	for(ALL_LIST_ELEMENTS_RO(OspfMplsTE.iflist, node, lp)) {
-		if(lp->instance == key) {
-			return lp;
-		}
+	lkey.instance = key;
+	if((lp = hash_lookup(OspfMplsTE.insthash, &lkey)) != NULL) {
+		return lp;
 	}
 
 	zlog_warn("lookup_linkparams_by_instance: Entry not found: key(%x)", key);
@@ -841,7 +868,10 @@ static int ospf_mpls_te_new_if(struct interface *ifp) {
 		goto out;
 	}
 
-	new->instance = get_mpls_te_instance_value();
+	/* An instance no other link has, should the counter have wrapped. */
+	do {
+		new->instance = get_mpls_te_instance_value();
+	} while(hash_lookup(OspfMplsTE.insthash, new) != NULL);
 	new->ifp = ifp;
 	/* By default TE-Link is RFC3630 compatible flooding in Area and not active */
 	/* This default behavior will be adapted with call to ospf_mpls_te_update_if() */
@@ -856,6 +886,8 @@ static int ospf_mpls_te_new_if(struct interface *ifp) {
 
 	/* Add Link Parameters structure to the list */
 	listnode_add(OspfMplsTE.iflist, new);
+	hash_get(OspfMplsTE.ifhash, new, hash_alloc_intern);
+	hash_get(OspfMplsTE.insthash, new, hash_alloc_intern);
 
 	if(IS_DEBUG_OSPF_TE) {
 		zlog_debug("OSPF MPLS-TE New IF: Add new LP context for %s[%d/%d]", ifp->name, new->flags, new->type);
@@ -877,6 +909,8 @@ static int ospf_mpls_te_del_if(struct interface *ifp) {
 
 		/* Dequeue listnode entry from the list. */
 		listnode_delete(iflist, lp);
+		hash_release(OspfMplsTE.ifhash, lp);
+		hash_release(OspfMplsTE.insthash, lp);
 
 		/* Avoid misjudgement in the next lookup. */
 		if(listcount(iflist) == 0) {
@@ -911,11 +945,25 @@ void ospf_mpls_te_update_if(struct interface *ifp) {
 
 	/* Fulfill MPLS-TE Link TLV from Interface TE Link parameters */
 	if(HAS_LINK_PARAMS(ifp)) {
+		struct mpls_te_link old;
+
 		SET_FLAG(lp->flags, LPFLG_LSA_ACTIVE);
 
 		/* Update TE parameters */
+		memcpy(&old, lp, sizeof(struct mpls_te_link));
 		update_linkparams(lp);
 
+		/* Zebra sends the parameters again on interface events, and a
+		   Link TLV the same as the one out there needs no new
+		   instance.  Changes are held to MinLSInterval apart by the
+		   opaque refresh, one refresh covering all of them. */
+		if(CHECK_FLAG(lp->flags, LPFLG_LSA_ENGAGED) && lp->flags == old.flags && lp->type == old.type && memcmp(&lp->link_header, &old.link_header, offsetof(struct mpls_te_link, adv_router) - offsetof(struct mpls_te_link, link_header)) == 0) {
+			if(IS_DEBUG_OSPF_TE) {
+				zlog_debug("OSPF MPLS-TE Update IF: %s parameters unchanged", ifp->name);
+			}
+			return;
+		}
+
 		/* Finally Re-Originate or Refresh Opaque LSA if MPLS_TE is enabled */
 		if(OspfMplsTE.status == enabled) {
 			if(lp->area != NULL) {
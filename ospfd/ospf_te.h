@@ -395,6 +395,10 @@ struct ospf_mpls_te {
 	/* List elements are zebra-interfaces (ifp), not ospf-interfaces (oi). */
 	struct list *iflist;
 
+	/* The same links, by interface and by instance. */
+	struct hash *ifhash;
+	struct hash *insthash;
+
 	/* Store Router-TLV in network byte order. */
 	struct te_tlv_router_addr router_addr;
 };
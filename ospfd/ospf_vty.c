@@ -31,6 +31,7 @@
 #include "plist.h"
 #include "log.h"
 #include "zclient.h"
+#include "json.h"
 
 #include "ospfd/ospfd.h"
 #include "ospfd/ospf_asbr.h"
@@ -48,6 +49,8 @@
 /*#include "ospfd/ospf_routemap.h" */
 #include "ospfd/ospf_vty.h"
 #include "ospfd/ospf_dump.h"
+#include "ospfd/ospf_gr.h"
+#include "ospfd/ospf_bfd.h"
 
 static const char *ospf_network_type_str[] = { "Null", "POINTOPOINT", "BROADCAST", "NBMA", "POINTOMULTIPOINT", "VIRTUALLINK", "LOOPBACK" };
 
@@ -130,18 +133,34 @@ int ospf_oi_count(struct interface *ifp) {
 DEFUN(router_ospf, router_ospf_cmd, "router ospf",
       "Enable a routing process\n"
       "Start OSPF configuration\n") {
+	u_short instance = 0;
+
+	if(argc > 0) {
+		VTY_GET_INTEGER_RANGE("Instance", instance, argv[0], 1, 65535);
+	}
+
 	vty->node = OSPF_NODE;
-	vty->index = ospf_get();
+	vty->index = ospf_get_instance(instance);
 
 	return CMD_SUCCESS;
 }
 
+ALIAS(router_ospf, router_ospf_instance_cmd, "router ospf <1-65535>",
+      "Enable a routing process\n"
+      "Start OSPF configuration\n"
+      "Instance ID\n")
+
 DEFUN(no_router_ospf, no_router_ospf_cmd, "no router ospf",
       NO_STR "Enable a routing process\n"
 	     "Start OSPF configuration\n") {
 	struct ospf *ospf;
+	u_short instance = 0;
 
-	ospf = ospf_lookup();
+	if(argc > 0) {
+		VTY_GET_INTEGER_RANGE("Instance", instance, argv[0], 1, 65535);
+	}
+
+	ospf = ospf_lookup_instance(instance);
 	if(ospf == NULL) {
 		vty_out(vty, "There isn't active ospf instance%s", VTY_NEWLINE);
 		return CMD_WARNING;
@@ -152,6 +171,11 @@ DEFUN(no_router_ospf, no_router_ospf_cmd, "no router ospf",
 	return CMD_SUCCESS;
 }
 
+ALIAS(no_router_ospf, no_router_ospf_instance_cmd, "no router ospf <1-65535>",
+      NO_STR "Enable a routing process\n"
+	     "Start OSPF configuration\n"
+	     "Instance ID\n")
+
 DEFUN(ospf_router_id, ospf_router_id_cmd, "ospf router-id A.B.C.D",
       "OSPF specific commands\n"
       "router-id for the OSPF process\n"
@@ -706,8 +730,7 @@ static int ospf_vl_set_security(struct ospf_vl_data *vl_data, struct ospf_vl_con
 		}
 		ck = ospf_crypt_key_new();
 		ck->key_id = vl_config->crypto_key_id;
-		memset(ck->auth_key, 0, OSPF_AUTH_MD5_SIZE + 1);
-		strncpy((char *) ck->auth_key, vl_config->md5_key, OSPF_AUTH_MD5_SIZE);
+		ospf_crypt_key_set(ck, AUTH_HASH_MD5, vl_config->md5_key);
 
 		ospf_crypt_key_add(IF_DEF_PARAMS(ifp)->auth_crypt, ck);
 	} else if(vl_config->crypto_key_id != 0) {
@@ -1934,6 +1957,37 @@ DEFUN(no_ospf_timers_min_ls_arrival, no_ospf_timers_min_ls_arrival_cmd, "no time
 	return CMD_SUCCESS;
 }
 
+DEFUN(ospf_timers_external_lsa_rate, ospf_timers_external_lsa_rate_cmd, "timers lsa external-rate <1-100000>",
+      "Adjust routing timers\n"
+      "Throttling link state advertisement delays\n"
+      "Rate of redistributed AS-external-LSA origination\n"
+      "AS-external-LSAs originated, refreshed or flushed per second\n") {
+	struct ospf *ospf = vty->index;
+	unsigned int rate;
+
+	VTY_GET_INTEGER_RANGE("AS-external-LSA rate", rate, argv[0], 1, 100000);
+
+	ospf->external_lsa_rate = rate;
+
+	return CMD_SUCCESS;
+}
+
+DEFUN(no_ospf_timers_external_lsa_rate, no_ospf_timers_external_lsa_rate_cmd, "no timers lsa external-rate",
+      NO_STR "Adjust routing timers\n"
+	     "Throttling link state advertisement delays\n"
+	     "Rate of redistributed AS-external-LSA origination\n") {
+	struct ospf *ospf = vty->index;
+	ospf->external_lsa_rate = OSPF_EXTERNAL_LSA_RATE_DEFAULT;
+
+	return CMD_SUCCESS;
+}
+
+ALIAS(no_ospf_timers_external_lsa_rate, no_ospf_timers_external_lsa_rate_val_cmd, "no timers lsa external-rate <1-100000>",
+      NO_STR "Adjust routing timers\n"
+	     "Throttling link state advertisement delays\n"
+	     "Rate of redistributed AS-external-LSA origination\n"
+	     "AS-external-LSAs originated, refreshed or flushed per second\n")
+
 DEFUN(ospf_timers_throttle_spf, ospf_timers_throttle_spf_cmd, "timers throttle spf <0-600000> <0-600000> <0-600000>",
       "Adjust routing timers\n"
       "Throttling adaptive timer\n"
@@ -1993,6 +2047,58 @@ DEFUN(no_ospf_timers_throttle_spf, no_ospf_timers_throttle_spf_cmd, "no timers t
 	return ospf_timers_spf_set(vty, OSPF_SPF_DELAY_DEFAULT, OSPF_SPF_HOLDTIME_DEFAULT, OSPF_SPF_MAX_HOLDTIME_DEFAULT);
 }
 
+DEFUN(ospf_timers_throttle_spf_ietf, ospf_timers_throttle_spf_ietf_cmd, "timers throttle spf ietf <0-600000> <0-600000> <0-600000> <0-600000> <0-600000>",
+      "Adjust routing timers\n"
+      "Throttling adaptive timer\n"
+      "OSPF SPF timers\n"
+      "RFC 8405 SPF back-off\n"
+      "Delay (msec) from the first change after a quiet period till SPF calculation\n"
+      "Delay (msec) while changes come in short succession\n"
+      "Delay (msec) once they have kept coming for the time to learn\n"
+      "Time (msec) without changes for the network to be quiet again\n"
+      "Time (msec) to learn the changes of a single event\n") {
+	struct ospf *ospf = vty->index;
+	unsigned int initial, short_delay, long_delay, holddown, learn;
+
+	if(argc != 5) {
+		vty_out(vty, "Insufficient arguments%s", VTY_NEWLINE);
+		return CMD_WARNING;
+	}
+
+	VTY_GET_INTEGER_RANGE("SPF initial delay", initial, argv[0], 0, 600000);
+	VTY_GET_INTEGER_RANGE("SPF short delay", short_delay, argv[1], 0, 600000);
+	VTY_GET_INTEGER_RANGE("SPF long delay", long_delay, argv[2], 0, 600000);
+	VTY_GET_INTEGER_RANGE("SPF holddown", holddown, argv[3], 0, 600000);
+	VTY_GET_INTEGER_RANGE("SPF time to learn", learn, argv[4], 0, 600000);
+
+	ospf->spf_initial_delay = initial;
+	ospf->spf_short_delay = short_delay;
+	ospf->spf_long_delay = long_delay;
+	ospf->spf_holddown = holddown;
+	ospf->spf_time_to_learn = learn;
+	ospf->spf_backoff = 1;
+
+	return CMD_SUCCESS;
+}
+
+DEFUN(no_ospf_timers_throttle_spf_ietf, no_ospf_timers_throttle_spf_ietf_cmd, "no timers throttle spf ietf",
+      NO_STR "Adjust routing timers\n"
+	     "Throttling adaptive timer\n"
+	     "OSPF SPF timers\n"
+	     "RFC 8405 SPF back-off\n") {
+	struct ospf *ospf = vty->index;
+
+	ospf->spf_initial_delay = OSPF_SPF_INITIAL_DELAY_DEFAULT;
+	ospf->spf_short_delay = OSPF_SPF_SHORT_DELAY_DEFAULT;
+	ospf->spf_long_delay = OSPF_SPF_LONG_DELAY_DEFAULT;
+	ospf->spf_holddown = OSPF_SPF_HOLDDOWN_DEFAULT;
+	ospf->spf_time_to_learn = OSPF_SPF_TIME_TO_LEARN_DEFAULT;
+	ospf->spf_backoff = 0;
+	ospf_spf_backoff_reset(ospf);
+
+	return CMD_SUCCESS;
+}
+
 ALIAS_DEPRECATED(
 	no_ospf_timers_throttle_spf, no_ospf_timers_spf_cmd, "no timers spf",
 	NO_STR "Adjust routing timers\n"
@@ -2280,6 +2386,7 @@ static void show_ip_ospf_area(struct vty *vty, struct ospf_area *area) {
 
 	/* Show SPF calculation times. */
 	vty_out(vty, "   SPF algorithm executed %d times%s", area->spf_calculation, VTY_NEWLINE);
+	vty_out(vty, "   Of which incrementally %u times%s", area->spf_incremental, VTY_NEWLINE);
 
 	/* Show number of LSA. */
 	vty_out(vty, "   Number of LSA %ld%s", area->lsdb->total, VTY_NEWLINE);
@@ -2293,20 +2400,12 @@ static void show_ip_ospf_area(struct vty *vty, struct ospf_area *area) {
 	vty_out(vty, "%s", VTY_NEWLINE);
 }
 
-DEFUN(show_ip_ospf, show_ip_ospf_cmd, "show ip ospf", SHOW_STR IP_STR "OSPF information\n") {
+static void show_ip_ospf_sub(struct vty *vty, struct ospf *ospf) {
 	struct listnode *node, *nnode;
 	struct ospf_area *area;
-	struct ospf *ospf;
 	struct timeval result;
 	char timebuf[OSPF_TIME_DUMP_SIZE];
 
-	/* Check OSPF is enable. */
-	ospf = ospf_lookup();
-	if(ospf == NULL) {
-		vty_out(vty, " OSPF Routing Process not enabled%s", VTY_NEWLINE);
-		return CMD_SUCCESS;
-	}
-
 	/* Show Router ID. */
 	vty_out(vty, " OSPF Routing Process, Router ID: %s%s", inet_ntoa(ospf->router_id), VTY_NEWLINE);
 
@@ -2332,12 +2431,20 @@ DEFUN(show_ip_ospf, show_ip_ospf_cmd, "show ip ospf", SHOW_STR IP_STR "OSPF info
 	}
 
 	/* Show SPF timers. */
-	vty_out(vty,
-		" Initial SPF scheduling delay %d millisec(s)%s"
-		" Minimum hold time between consecutive SPFs %d millisec(s)%s"
-		" Maximum hold time between consecutive SPFs %d millisec(s)%s"
-		" Hold time multiplier is currently %d%s",
-		ospf->spf_delay, VTY_NEWLINE, ospf->spf_holdtime, VTY_NEWLINE, ospf->spf_max_holdtime, VTY_NEWLINE, ospf->spf_hold_multiplier, VTY_NEWLINE);
+	if(ospf->spf_backoff) {
+		vty_out(vty,
+			" SPF back-off (RFC 8405) is %s%s"
+			"   Initial delay %d, short delay %d, long delay %d millisec(s)%s"
+			"   Holddown %d, time to learn %d millisec(s)%s",
+			ospf_spf_backoff_state_str(ospf), VTY_NEWLINE, ospf->spf_initial_delay, ospf->spf_short_delay, ospf->spf_long_delay, VTY_NEWLINE, ospf->spf_holddown, ospf->spf_time_to_learn, VTY_NEWLINE);
+	} else {
+		vty_out(vty,
+			" Initial SPF scheduling delay %d millisec(s)%s"
+			" Minimum hold time between consecutive SPFs %d millisec(s)%s"
+			" Maximum hold time between consecutive SPFs %d millisec(s)%s"
+			" Hold time multiplier is currently %d%s",
+			ospf->spf_delay, VTY_NEWLINE, ospf->spf_holdtime, VTY_NEWLINE, ospf->spf_max_holdtime, VTY_NEWLINE, ospf->spf_hold_multiplier, VTY_NEWLINE);
+	}
 	vty_out(vty, " SPF algorithm ");
 	if(ospf->ts_spf.tv_sec || ospf->ts_spf.tv_usec) {
 		result = tv_sub(recent_relative_time(), ospf->ts_spf);
@@ -2363,6 +2470,9 @@ DEFUN(show_ip_ospf, show_ip_ospf_cmd, "show ip ospf", SHOW_STR IP_STR "OSPF info
 			VTY_NEWLINE);
 	}
 
+	/* Show redistributed prefixes waiting for their AS-external-LSA. */
+	vty_out(vty, " External LSA rate %u per second, %lu prefixes pending, %lu changes coalesced%s", ospf->external_lsa_rate, ospf->external_pending_count, ospf->external_pending_coalesced, VTY_NEWLINE);
+
 	/* Show Number of AS-external-LSAs. */
 	vty_out(vty, " Number of external LSA %ld. Checksum Sum 0x%08x%s", ospf_lsdb_count(ospf->lsdb, OSPF_AS_EXTERNAL_LSA), ospf_lsdb_checksum(ospf->lsdb, OSPF_AS_EXTERNAL_LSA), VTY_NEWLINE);
 	vty_out(vty, " Number of opaque AS LSA %ld. Checksum Sum 0x%08x%s", ospf_lsdb_count(ospf->lsdb, OSPF_OPAQUE_AS_LSA), ospf_lsdb_checksum(ospf->lsdb, OSPF_OPAQUE_AS_LSA), VTY_NEWLINE);
@@ -2383,6 +2493,54 @@ DEFUN(show_ip_ospf, show_ip_ospf_cmd, "show ip ospf", SHOW_STR IP_STR "OSPF info
 	for(ALL_LIST_ELEMENTS(ospf->areas, node, nnode, area)) {
 		show_ip_ospf_area(vty, area);
 	}
+}
+
+/* Header separating the instances in the output of a show command. */
+static void show_ip_ospf_instance_header(struct vty *vty, struct ospf *ospf) {
+	if(listcount(om->ospf) > 1 || ospf->instance != 0) {
+		vty_out(vty, "%sOSPF Instance: %u%s%s", VTY_NEWLINE, ospf->instance, VTY_NEWLINE, VTY_NEWLINE);
+	}
+}
+
+/* Instance named by a "show ip ospf <1-65535> ..." argument. */
+static struct ospf *show_ip_ospf_instance_lookup(struct vty *vty, const char *arg) {
+	struct ospf *ospf;
+	u_short instance;
+
+	instance = strtoul(arg, NULL, 10);
+	if((ospf = ospf_lookup_instance(instance)) == NULL) {
+		vty_out(vty, " OSPF Routing Process %u not enabled%s", instance, VTY_NEWLINE);
+	}
+
+	return ospf;
+}
+
+DEFUN(show_ip_ospf, show_ip_ospf_cmd, "show ip ospf", SHOW_STR IP_STR "OSPF information\n") {
+	struct listnode *node;
+	struct ospf *ospf;
+
+	/* Check OSPF is enable. */
+	if(listcount(om->ospf) == 0) {
+		vty_out(vty, " OSPF Routing Process not enabled%s", VTY_NEWLINE);
+		return CMD_SUCCESS;
+	}
+
+	for(ALL_LIST_ELEMENTS_RO(om->ospf, node, ospf)) {
+		show_ip_ospf_instance_header(vty, ospf);
+		show_ip_ospf_sub(vty, ospf);
+	}
+
+	return CMD_SUCCESS;
+}
+
+DEFUN(show_ip_ospf_instance, show_ip_ospf_instance_cmd, "show ip ospf <1-65535>",
+      SHOW_STR IP_STR "OSPF information\n"
+		      "Instance ID\n") {
+	struct ospf *ospf;
+
+	if((ospf = show_ip_ospf_instance_lookup(vty, argv[0])) != NULL) {
+		show_ip_ospf_sub(vty, ospf);
+	}
 
 	return CMD_SUCCESS;
 }
@@ -2445,6 +2603,8 @@ static void show_ip_ospf_interface_sub(struct vty *vty, struct ospf *ospf, struc
 
 		vty_out(vty, "  Transmit Delay is %d sec, State %s, Priority %d%s", OSPF_IF_PARAM(oi, transmit_delay), LOOKUP(ospf_ism_state_msg, oi->state), PRIORITY(oi), VTY_NEWLINE);
 
+		vty_out(vty, "  Flood queue %lu LSAs (max %lu), pacing %u msec, burst %u%s", oi->ls_upd_count, oi->ls_upd_count_max, OSPF_IF_PARAM(oi, flood_pacing), OSPF_IF_PARAM(oi, flood_burst), VTY_NEWLINE);
+
 		/* Show DR information. */
 		if(DR(oi).s_addr == 0) {
 			vty_out(vty, "  No designated router on this network%s", VTY_NEWLINE);
@@ -2580,14 +2740,37 @@ DEFUN(show_ip_ospf_neighbor, show_ip_ospf_neighbor_cmd, "show ip ospf neighbor",
 		      "Neighbor list\n") {
 	struct ospf *ospf;
 	struct ospf_interface *oi;
-	struct listnode *node;
+	struct listnode *node, *onode;
 
-	ospf = ospf_lookup();
-	if(ospf == NULL) {
+	if(listcount(om->ospf) == 0) {
 		vty_out(vty, " OSPF Routing Process not enabled%s", VTY_NEWLINE);
 		return CMD_SUCCESS;
 	}
 
+	for(ALL_LIST_ELEMENTS_RO(om->ospf, onode, ospf)) {
+		show_ip_ospf_instance_header(vty, ospf);
+		show_ip_ospf_neighbour_header(vty);
+
+		for(ALL_LIST_ELEMENTS_RO(ospf->oiflist, node, oi)) {
+			show_ip_ospf_neighbor_sub(vty, oi);
+		}
+	}
+
+	return CMD_SUCCESS;
+}
+
+DEFUN(show_ip_ospf_instance_neighbor, show_ip_ospf_instance_neighbor_cmd, "show ip ospf <1-65535> neighbor",
+      SHOW_STR IP_STR "OSPF information\n"
+		      "Instance ID\n"
+		      "Neighbor list\n") {
+	struct ospf *ospf;
+	struct ospf_interface *oi;
+	struct listnode *node;
+
+	if((ospf = show_ip_ospf_instance_lookup(vty, argv[0])) == NULL) {
+		return CMD_SUCCESS;
+	}
+
 	show_ip_ospf_neighbour_header(vty);
 
 	for(ALL_LIST_ELEMENTS_RO(ospf->oiflist, node, oi)) {
@@ -3319,6 +3502,62 @@ static void show_ip_ospf_database_summary(struct vty *vty, struct ospf *ospf, in
 	vty_out(vty, "%s", VTY_NEWLINE);
 }
 
+static void show_ip_ospf_database_json_lsdb(struct json_out *j, struct route_table *rt) {
+	struct route_node *rn;
+	struct ospf_lsa *lsa;
+
+	LSDB_LOOP(rt, rn, lsa) {
+		json_out_object(j, NULL);
+		json_out_uint(j, "type", lsa->data->type);
+		json_out_in_addr(j, "id", lsa->data->id);
+		json_out_in_addr(j, "advRouter", lsa->data->adv_router);
+		json_out_uint(j, "age", LS_AGE(lsa));
+		json_out_uint(j, "seq", (u_int32_t) ntohl(lsa->data->ls_seqnum));
+		json_out_uint(j, "checksum", ntohs(lsa->data->checksum));
+		json_out_uint(j, "length", ntohs(lsa->data->length));
+		if(IS_LSA_SELF(lsa)) {
+			json_out_bool(j, "self", 1);
+		}
+		if(CHECK_FLAG(lsa->flags, OSPF_LSA_LOCAL_XLT)) {
+			json_out_bool(j, "translated", 1);
+		}
+		json_out_object_end(j);
+	}
+}
+
+/* The LSA headers of an instance, as a JSON object. */
+static void show_ip_ospf_database_json_instance(struct json_out *j, struct ospf *ospf) {
+	struct ospf_area *area;
+	struct listnode *node;
+	int type;
+
+	json_out_object(j, NULL);
+	json_out_uint(j, "instance", ospf->instance);
+	json_out_in_addr(j, "routerId", ospf->router_id);
+
+	json_out_array(j, "areas");
+	for(ALL_LIST_ELEMENTS_RO(ospf->areas, node, area)) {
+		json_out_object(j, NULL);
+		json_out_in_addr(j, "area", area->area_id);
+		json_out_array(j, "lsas");
+		for(type = OSPF_MIN_LSA; type < OSPF_MAX_LSA; type++) {
+			if(type != OSPF_AS_EXTERNAL_LSA && type != OSPF_OPAQUE_AS_LSA) {
+				show_ip_ospf_database_json_lsdb(j, AREA_LSDB(area, type));
+			}
+		}
+		json_out_array_end(j);
+		json_out_object_end(j);
+	}
+	json_out_array_end(j);
+
+	json_out_array(j, "external");
+	show_ip_ospf_database_json_lsdb(j, AS_LSDB(ospf, OSPF_AS_EXTERNAL_LSA));
+	show_ip_ospf_database_json_lsdb(j, AS_LSDB(ospf, OSPF_OPAQUE_AS_LSA));
+	json_out_array_end(j);
+
+	json_out_object_end(j);
+}
+
 static void show_ip_ospf_database_maxage(struct vty *vty, struct ospf *ospf) {
 	struct route_node *rn;
 
@@ -3358,6 +3597,7 @@ DEFUN(show_ip_ospf_database, show_ip_ospf_database_cmd, "show ip ospf database",
       SHOW_STR IP_STR "OSPF information\n"
 		      "Database summary\n") {
 	struct ospf *ospf;
+	struct listnode *node;
 	int type, ret;
 	struct in_addr id, adv_router;
 
@@ -3367,14 +3607,18 @@ DEFUN(show_ip_ospf_database, show_ip_ospf_database_cmd, "show ip ospf database",
 		return CMD_SUCCESS;
 	}
 
-	vty_out(vty, "%s       OSPF Router with ID (%s)%s%s", VTY_NEWLINE, inet_ntoa(ospf->router_id), VTY_NEWLINE, VTY_NEWLINE);
-
-	/* Show all LSA. */
+	/* Show all LSA, of every instance. */
 	if(argc == 0) {
-		show_ip_ospf_database_summary(vty, ospf, 0);
+		for(ALL_LIST_ELEMENTS_RO(om->ospf, node, ospf)) {
+			show_ip_ospf_instance_header(vty, ospf);
+			vty_out(vty, "%s       OSPF Router with ID (%s)%s%s", VTY_NEWLINE, inet_ntoa(ospf->router_id), VTY_NEWLINE, VTY_NEWLINE);
+			show_ip_ospf_database_summary(vty, ospf, 0);
+		}
 		return CMD_SUCCESS;
 	}
 
+	vty_out(vty, "%s       OSPF Router with ID (%s)%s%s", VTY_NEWLINE, inet_ntoa(ospf->router_id), VTY_NEWLINE, VTY_NEWLINE);
+
 	/* Set database type to show. */
 	if(strncmp(argv[0], "r", 1) == 0) {
 		type = OSPF_ROUTER_LSA;
@@ -3455,6 +3699,39 @@ ALIAS(show_ip_ospf_database, show_ip_ospf_database_type_id_self_cmd, "show ip os
 		      "Self-originated link states\n"
 		      "\n")
 
+DEFUN(show_ip_ospf_database_json, show_ip_ospf_database_json_cmd, "show ip ospf database json",
+      SHOW_STR IP_STR "OSPF information\n"
+		      "Database summary\n"
+		      "JavaScript Object Notation\n") {
+	struct json_out json;
+	struct listnode *node;
+	struct ospf *ospf;
+
+	json_out_init(&json, vty);
+	json_out_array(&json, NULL);
+	for(ALL_LIST_ELEMENTS_RO(om->ospf, node, ospf)) {
+		show_ip_ospf_database_json_instance(&json, ospf);
+	}
+	json_out_array_end(&json);
+	json_out_finish(&json);
+
+	return CMD_SUCCESS;
+}
+
+DEFUN(show_ip_ospf_instance_database, show_ip_ospf_instance_database_cmd, "show ip ospf <1-65535> database",
+      SHOW_STR IP_STR "OSPF information\n"
+		      "Instance ID\n"
+		      "Database summary\n") {
+	struct ospf *ospf;
+
+	if((ospf = show_ip_ospf_instance_lookup(vty, argv[0])) != NULL) {
+		vty_out(vty, "%s       OSPF Router with ID (%s)%s%s", VTY_NEWLINE, inet_ntoa(ospf->router_id), VTY_NEWLINE, VTY_NEWLINE);
+		show_ip_ospf_database_summary(vty, ospf, 0);
+	}
+
+	return CMD_SUCCESS;
+}
+
 DEFUN(show_ip_ospf_database_type_adv_router, show_ip_ospf_database_type_adv_router_cmd, "show ip ospf database (" OSPF_LSA_TYPES_CMD_STR ") adv-router A.B.C.D",
       SHOW_STR IP_STR "OSPF information\n"
 		      "Database summary\n" OSPF_LSA_TYPES_DESC "Advertising Router link states\n"
@@ -3734,26 +4011,34 @@ ALIAS(no_ip_ospf_authentication_key, no_ospf_authentication_key_cmd, "no ospf au
       NO_STR "OSPF interface commands\n"
 	     "Authentication password (key)\n")
 
-DEFUN(ip_ospf_message_digest_key, ip_ospf_message_digest_key_addr_cmd, "ip ospf message-digest-key <1-255> md5 KEY A.B.C.D",
+#define OSPF_CRYPT_ALGO_CMD "(md5|hmac-sha-1|hmac-sha-256|hmac-sha-384|hmac-sha-512)"
+#define OSPF_CRYPT_ALGO_STR \
+	"Use MD5 algorithm\n" \
+	"Use HMAC-SHA-1 algorithm (RFC 5709)\n" \
+	"Use HMAC-SHA-256 algorithm (RFC 5709)\n" \
+	"Use HMAC-SHA-384 algorithm (RFC 5709)\n" \
+	"Use HMAC-SHA-512 algorithm (RFC 5709)\n"
+
+DEFUN(ip_ospf_message_digest_key, ip_ospf_message_digest_key_addr_cmd, "ip ospf message-digest-key <1-255> " OSPF_CRYPT_ALGO_CMD " KEY A.B.C.D",
       "IP Information\n"
       "OSPF interface commands\n"
       "Message digest authentication password (key)\n"
       "Key ID\n"
-      "Use MD5 algorithm\n"
+      OSPF_CRYPT_ALGO_STR
       "The OSPF password (key)"
       "Address of interface") {
 	struct interface *ifp;
 	struct crypt_key *ck;
 	u_char key_id;
 	struct in_addr addr;
-	int ret;
+	int ret, hash;
 	struct ospf_if_params *params;
 
 	ifp = vty->index;
 	params = IF_DEF_PARAMS(ifp);
 
-	if(argc == 3) {
-		ret = inet_aton(argv[2], &addr);
+	if(argc == 4) {
+		ret = inet_aton(argv[3], &addr);
 		if(!ret) {
 			vty_out(vty, "Please specify interface address by A.B.C.D%s", VTY_NEWLINE);
 			return CMD_WARNING;
@@ -3763,6 +4048,16 @@ DEFUN(ip_ospf_message_digest_key, ip_ospf_message_digest_key_addr_cmd, "ip ospf
 		ospf_if_update_params(ifp, addr);
 	}
 
+	hash = auth_hash_lookup(argv[1]);
+	if(hash < 0) {
+		vty_out(vty, "OSPF: Unknown algorithm %s%s", argv[1], VTY_NEWLINE);
+		return CMD_WARNING;
+	}
+	if(hash != AUTH_HASH_MD5 && strlen(argv[2]) > OSPF_AUTH_CRYPT_KEY_SIZE) {
+		vty_out(vty, "OSPF: Key is longer than %u characters%s", OSPF_AUTH_CRYPT_KEY_SIZE, VTY_NEWLINE);
+		return CMD_WARNING;
+	}
+
 	key_id = strtol(argv[0], NULL, 10);
 	if(ospf_crypt_key_lookup(params->auth_crypt, key_id) != NULL) {
 		vty_out(vty, "OSPF: Key %d already exists%s", key_id, VTY_NEWLINE);
@@ -3771,8 +4066,7 @@ DEFUN(ip_ospf_message_digest_key, ip_ospf_message_digest_key_addr_cmd, "ip ospf
 
 	ck = ospf_crypt_key_new();
 	ck->key_id = (u_char) key_id;
-	memset(ck->auth_key, 0, OSPF_AUTH_MD5_SIZE + 1);
-	strncpy((char *) ck->auth_key, argv[1], OSPF_AUTH_MD5_SIZE);
+	ospf_crypt_key_set(ck, hash, argv[2]);
 
 	ospf_crypt_key_add(params->auth_crypt, ck);
 	SET_IF_PARAM(params, auth_crypt);
@@ -3780,19 +4074,19 @@ DEFUN(ip_ospf_message_digest_key, ip_ospf_message_digest_key_addr_cmd, "ip ospf
 	return CMD_SUCCESS;
 }
 
-ALIAS(ip_ospf_message_digest_key, ip_ospf_message_digest_key_cmd, "ip ospf message-digest-key <1-255> md5 KEY",
+ALIAS(ip_ospf_message_digest_key, ip_ospf_message_digest_key_cmd, "ip ospf message-digest-key <1-255> " OSPF_CRYPT_ALGO_CMD " KEY",
       "IP Information\n"
       "OSPF interface commands\n"
       "Message digest authentication password (key)\n"
       "Key ID\n"
-      "Use MD5 algorithm\n"
+      OSPF_CRYPT_ALGO_STR
       "The OSPF password (key)")
 
-ALIAS(ip_ospf_message_digest_key, ospf_message_digest_key_cmd, "ospf message-digest-key <1-255> md5 KEY",
+ALIAS(ip_ospf_message_digest_key, ospf_message_digest_key_cmd, "ospf message-digest-key <1-255> " OSPF_CRYPT_ALGO_CMD " KEY",
       "OSPF interface commands\n"
       "Message digest authentication password (key)\n"
       "Key ID\n"
-      "Use MD5 algorithm\n"
+      OSPF_CRYPT_ALGO_STR
       "The OSPF password (key)")
 
 DEFUN(no_ip_ospf_message_digest_key, no_ip_ospf_message_digest_key_addr_cmd, "no ip ospf message-digest-key <1-255> A.B.C.D",
@@ -4712,6 +5006,174 @@ ALIAS(no_ip_ospf_transmit_delay, no_ospf_transmit_delay_cmd, "no ospf transmit-d
       NO_STR "OSPF interface commands\n"
 	     "Link state transmit delay\n")
 
+DEFUN(ip_ospf_flood_pacing, ip_ospf_flood_pacing_addr_cmd, "ip ospf flood-pacing <0-1000> A.B.C.D",
+      "IP Information\n"
+      "OSPF interface commands\n"
+      "Pacing of link state updates\n"
+      "Milliseconds, 0 to send at once\n"
+      "Address of interface") {
+	struct interface *ifp = vty->index;
+	u_int32_t value;
+	struct in_addr addr;
+	int ret;
+	struct ospf_if_params *params;
+
+	params = IF_DEF_PARAMS(ifp);
+	value = strtoul(argv[0], NULL, 10);
+
+	if(value > 1000) {
+		vty_out(vty, "Flood pacing is invalid%s", VTY_NEWLINE);
+		return CMD_WARNING;
+	}
+
+	if(argc == 2) {
+		ret = inet_aton(argv[1], &addr);
+		if(!ret) {
+			vty_out(vty, "Please specify interface address by A.B.C.D%s", VTY_NEWLINE);
+			return CMD_WARNING;
+		}
+
+		params = ospf_get_if_params(ifp, addr);
+		ospf_if_update_params(ifp, addr);
+	}
+
+	SET_IF_PARAM(params, flood_pacing);
+	params->flood_pacing = value;
+
+	return CMD_SUCCESS;
+}
+
+ALIAS(ip_ospf_flood_pacing, ip_ospf_flood_pacing_cmd, "ip ospf flood-pacing <0-1000>",
+      "IP Information\n"
+      "OSPF interface commands\n"
+      "Pacing of link state updates\n"
+      "Milliseconds, 0 to send at once\n")
+
+DEFUN(no_ip_ospf_flood_pacing, no_ip_ospf_flood_pacing_addr_cmd, "no ip ospf flood-pacing A.B.C.D",
+      NO_STR "IP Information\n"
+	     "OSPF interface commands\n"
+	     "Pacing of link state updates\n"
+	     "Address of interface") {
+	struct interface *ifp = vty->index;
+	struct in_addr addr;
+	int ret;
+	struct ospf_if_params *params;
+
+	params = IF_DEF_PARAMS(ifp);
+
+	if(argc == 1) {
+		ret = inet_aton(argv[0], &addr);
+		if(!ret) {
+			vty_out(vty, "Please specify interface address by A.B.C.D%s", VTY_NEWLINE);
+			return CMD_WARNING;
+		}
+
+		params = ospf_lookup_if_params(ifp, addr);
+		if(params == NULL) {
+			return CMD_SUCCESS;
+		}
+	}
+
+	UNSET_IF_PARAM(params, flood_pacing);
+	params->flood_pacing = OSPF_FLOOD_PACING_DEFAULT;
+
+	if(params != IF_DEF_PARAMS(ifp)) {
+		ospf_free_if_params(ifp, addr);
+		ospf_if_update_params(ifp, addr);
+	}
+
+	return CMD_SUCCESS;
+}
+
+ALIAS(no_ip_ospf_flood_pacing, no_ip_ospf_flood_pacing_cmd, "no ip ospf flood-pacing",
+      NO_STR "IP Information\n"
+	     "OSPF interface commands\n"
+	     "Pacing of link state updates\n")
+
+DEFUN(ip_ospf_flood_burst, ip_ospf_flood_burst_addr_cmd, "ip ospf flood-burst <1-100> A.B.C.D",
+      "IP Information\n"
+      "OSPF interface commands\n"
+      "Link state update packets sent at a time\n"
+      "Packets\n"
+      "Address of interface") {
+	struct interface *ifp = vty->index;
+	u_int32_t value;
+	struct in_addr addr;
+	int ret;
+	struct ospf_if_params *params;
+
+	params = IF_DEF_PARAMS(ifp);
+	value = strtoul(argv[0], NULL, 10);
+
+	if(value < 1 || value > 100) {
+		vty_out(vty, "Flood burst is invalid%s", VTY_NEWLINE);
+		return CMD_WARNING;
+	}
+
+	if(argc == 2) {
+		ret = inet_aton(argv[1], &addr);
+		if(!ret) {
+			vty_out(vty, "Please specify interface address by A.B.C.D%s", VTY_NEWLINE);
+			return CMD_WARNING;
+		}
+
+		params = ospf_get_if_params(ifp, addr);
+		ospf_if_update_params(ifp, addr);
+	}
+
+	SET_IF_PARAM(params, flood_burst);
+	params->flood_burst = value;
+
+	return CMD_SUCCESS;
+}
+
+ALIAS(ip_ospf_flood_burst, ip_ospf_flood_burst_cmd, "ip ospf flood-burst <1-100>",
+      "IP Information\n"
+      "OSPF interface commands\n"
+      "Link state update packets sent at a time\n"
+      "Packets\n")
+
+DEFUN(no_ip_ospf_flood_burst, no_ip_ospf_flood_burst_addr_cmd, "no ip ospf flood-burst A.B.C.D",
+      NO_STR "IP Information\n"
+	     "OSPF interface commands\n"
+	     "Link state update packets sent at a time\n"
+	     "Address of interface") {
+	struct interface *ifp = vty->index;
+	struct in_addr addr;
+	int ret;
+	struct ospf_if_params *params;
+
+	params = IF_DEF_PARAMS(ifp);
+
+	if(argc == 1) {
+		ret = inet_aton(argv[0], &addr);
+		if(!ret) {
+			vty_out(vty, "Please specify interface address by A.B.C.D%s", VTY_NEWLINE);
+			return CMD_WARNING;
+		}
+
+		params = ospf_lookup_if_params(ifp, addr);
+		if(params == NULL) {
+			return CMD_SUCCESS;
+		}
+	}
+
+	UNSET_IF_PARAM(params, flood_burst);
+	params->flood_burst = OSPF_FLOOD_BURST_DEFAULT;
+
+	if(params != IF_DEF_PARAMS(ifp)) {
+		ospf_free_if_params(ifp, addr);
+		ospf_if_update_params(ifp, addr);
+	}
+
+	return CMD_SUCCESS;
+}
+
+ALIAS(no_ip_ospf_flood_burst, no_ip_ospf_flood_burst_cmd, "no ip ospf flood-burst",
+      NO_STR "IP Information\n"
+	     "OSPF interface commands\n"
+	     "Link state update packets sent at a time\n")
+
 DEFUN(ip_ospf_area, ip_ospf_area_cmd, "ip ospf area (A.B.C.D|<0-4294967295>) [A.B.C.D]",
       "IP Information\n"
       "OSPF interface commands\n"
@@ -5173,6 +5635,33 @@ ALIAS(no_ip_ospf_mtu_ignore, no_ip_ospf_mtu_ignore_cmd, "no ip ospf mtu-ignore",
       "OSPF interface commands\n"
       "Disable mtu mismatch detection\n")
 
+DEFUN(ip_ospf_bfd, ip_ospf_bfd_cmd, "ip ospf bfd",
+      "IP Information\n"
+      "OSPF interface commands\n"
+      "Detect neighbor failures with BFD\n") {
+	struct interface *ifp = vty->index;
+	struct ospf_if_params *params = IF_DEF_PARAMS(ifp);
+
+	SET_IF_PARAM(params, bfd);
+	params->bfd = 1;
+	ospf_bfd_if_update(ifp);
+	return CMD_SUCCESS;
+}
+
+DEFUN(no_ip_ospf_bfd, no_ip_ospf_bfd_cmd, "no ip ospf bfd",
+      NO_STR
+      "IP Information\n"
+      "OSPF interface commands\n"
+      "Detect neighbor failures with BFD\n") {
+	struct interface *ifp = vty->index;
+	struct ospf_if_params *params = IF_DEF_PARAMS(ifp);
+
+	UNSET_IF_PARAM(params, bfd);
+	params->bfd = 0;
+	ospf_bfd_if_update(ifp);
+	return CMD_SUCCESS;
+}
+
 DEFUN(ospf_max_metric_router_lsa_admin, ospf_max_metric_router_lsa_admin_cmd, "max-metric router-lsa administrative",
       "OSPF maximum / infinite-distance metric\n"
       "Advertise own Router-LSA with infinite distance (stub router)\n"
@@ -5444,19 +5933,114 @@ DEFUN(show_ip_ospf_border_routers, show_ip_ospf_border_routers_cmd, "show ip osp
 	return CMD_SUCCESS;
 }
 
-DEFUN(show_ip_ospf_route, show_ip_ospf_route_cmd, "show ip ospf route",
+static void show_ip_ospf_spf_log_area(struct vty *vty, struct ospf_area *area) {
+	static const char *histogram[OSPF_SPF_HISTOGRAM_SIZE] = { "<1ms", "<10ms", "<100ms", "<1s", ">=1s" };
+	struct ospf_spf_log *log;
+	struct timeval result;
+	char timebuf[OSPF_TIME_DUMP_SIZE];
+	char rbuf[OSPF_SPF_REASON_STR_SIZE];
+	unsigned int i;
+
+	vty_out(vty, " Area ID: %s%s", inet_ntoa(area->area_id), VTY_NEWLINE);
+	vty_out(vty, "   SPF algorithm executed %d times, %u incrementally%s", area->spf_calculation, area->spf_incremental, VTY_NEWLINE);
+
+	vty_out(vty, "   Durations:");
+	for(i = 0; i < OSPF_SPF_HISTOGRAM_SIZE; i++) {
+		vty_out(vty, " %s %u", histogram[i], area->spf_histogram[i]);
+	}
+	vty_out(vty, "%s%s", VTY_NEWLINE, VTY_NEWLINE);
+
+	vty_out(vty, "   %-12s %8s %8s %8s %8s  %s%s", "Ago", "SPF", "IA", "ASE", "Install", "Reason", VTY_NEWLINE);
+
+	/* the most recent first */
+	for(i = 1; i <= OSPF_SPF_LOG_SIZE; i++) {
+		log = &area->spf_log[(area->spf_log_next + OSPF_SPF_LOG_SIZE - i) % OSPF_SPF_LOG_SIZE];
+		if(log->ts.tv_sec == 0 && log->ts.tv_usec == 0) {
+			break;
+		}
+		result = tv_sub(recent_relative_time(), log->ts);
+		ospf_get_spf_reason_str(log->reason, rbuf);
+		vty_out(vty, "   %-12s %8u %8u %8u %8u  %s%s%s", ospf_timeval_dump(&result, timebuf, sizeof(timebuf)), log->spf, log->ia, log->ase, log->install, rbuf, log->incremental ? " (incremental)" : "", VTY_NEWLINE);
+	}
+	vty_out(vty, "%s", VTY_NEWLINE);
+}
+
+DEFUN(show_ip_ospf_spf_log, show_ip_ospf_spf_log_cmd, "show ip ospf spf log",
       SHOW_STR IP_STR "OSPF information\n"
-		      "OSPF routing table\n") {
+		      "SPF calculations\n"
+		      "The last SPF calculations of each area, and their durations in usecs\n") {
+	struct ospf_area *area;
+	struct listnode *node;
+	struct ospf *ospf;
+
+	if((ospf = ospf_lookup()) == NULL) {
+		vty_out(vty, " OSPF Routing Process not enabled%s", VTY_NEWLINE);
+		return CMD_SUCCESS;
+	}
+
+	for(ALL_LIST_ELEMENTS_RO(ospf->areas, node, area)) {
+		show_ip_ospf_spf_log_area(vty, area);
+	}
+
+	return CMD_SUCCESS;
+}
+
+/* slots to a line of "show ip ospf refresher" */
+#define OSPF_REFRESHER_SHOW_SLOTS (60 / OSPF_LSA_REFRESHER_GRANULARITY)
+
+DEFUN(show_ip_ospf_refresher, show_ip_ospf_refresher_cmd, "show ip ospf refresher",
+      SHOW_STR IP_STR "OSPF information\n"
+		      "Self-originated LSAs queued for refresh, by the minute they are due in\n") {
 	struct ospf *ospf;
+	struct list *slot;
+	unsigned long lsas, max, fullest;
+	unsigned int i, j, used;
 
 	if((ospf = ospf_lookup()) == NULL) {
 		vty_out(vty, " OSPF Routing Process not enabled%s", VTY_NEWLINE);
 		return CMD_SUCCESS;
 	}
 
+	for(i = used = fullest = 0; i < OSPF_LSA_REFRESHER_SLOTS; i++) {
+		if((slot = ospf->lsa_refresh_queue.qs[i])) {
+			used++;
+			if(listcount(slot) > fullest) {
+				fullest = listcount(slot);
+			}
+		}
+	}
+
+	vty_out(vty, " %lu LSAs in %u of %d slots of %d secs, walked every %d secs%s", ospf->lsa_refresh_queue.count, used, OSPF_LSA_REFRESHER_SLOTS, OSPF_LSA_REFRESHER_GRANULARITY, ospf->lsa_refresh_interval, VTY_NEWLINE);
+	vty_out(vty, " Slot limit %lu LSAs, fullest slot %lu%s", ospf_refresher_slot_limit(ospf), fullest, VTY_NEWLINE);
+	vty_out(vty, " Refreshed %lu, spread to another slot %lu, deferred to the next walk %lu%s", ospf->lsa_refresh_queue.refreshed, ospf->lsa_refresh_queue.spread, ospf->lsa_refresh_queue.deferred, VTY_NEWLINE);
+
+	if(ospf->lsa_refresh_queue.count == 0) {
+		return CMD_SUCCESS;
+	}
+
+	vty_out(vty, "%s   %-8s %8s %8s%s", VTY_NEWLINE, "Due in", "LSAs", "Fullest", VTY_NEWLINE);
+	for(i = 0; i < OSPF_LSA_REFRESHER_SLOTS; i += OSPF_REFRESHER_SHOW_SLOTS) {
+		for(j = i, lsas = max = 0; j < i + OSPF_REFRESHER_SHOW_SLOTS && j < OSPF_LSA_REFRESHER_SLOTS; j++) {
+			slot = ospf->lsa_refresh_queue.qs[(ospf->lsa_refresh_queue.index + j) % OSPF_LSA_REFRESHER_SLOTS];
+			if(slot) {
+				lsas += listcount(slot);
+				if(listcount(slot) > max) {
+					max = listcount(slot);
+				}
+			}
+		}
+		if(lsas) {
+			vty_out(vty, "   %3u min   %8lu %8lu%s", i / OSPF_REFRESHER_SHOW_SLOTS, lsas, max, VTY_NEWLINE);
+		}
+	}
+
+	return CMD_SUCCESS;
+}
+
+static void show_ip_ospf_route_sub(struct vty *vty, struct ospf *ospf) {
 	if(ospf->new_table == NULL) {
 		vty_out(vty, "No OSPF routing information exist%s", VTY_NEWLINE);
-		return CMD_SUCCESS;
+		return;
 	}
 
 	/* Show Network routes. */
@@ -5467,6 +6051,36 @@ DEFUN(show_ip_ospf_route, show_ip_ospf_route_cmd, "show ip ospf route",
 
 	/* Show AS External routes. */
 	show_ip_ospf_route_external(vty, ospf->old_external_route);
+}
+
+DEFUN(show_ip_ospf_route, show_ip_ospf_route_cmd, "show ip ospf route",
+      SHOW_STR IP_STR "OSPF information\n"
+		      "OSPF routing table\n") {
+	struct ospf *ospf;
+	struct listnode *node;
+
+	if(listcount(om->ospf) == 0) {
+		vty_out(vty, " OSPF Routing Process not enabled%s", VTY_NEWLINE);
+		return CMD_SUCCESS;
+	}
+
+	for(ALL_LIST_ELEMENTS_RO(om->ospf, node, ospf)) {
+		show_ip_ospf_instance_header(vty, ospf);
+		show_ip_ospf_route_sub(vty, ospf);
+	}
+
+	return CMD_SUCCESS;
+}
+
+DEFUN(show_ip_ospf_instance_route, show_ip_ospf_instance_route_cmd, "show ip ospf <1-65535> route",
+      SHOW_STR IP_STR "OSPF information\n"
+		      "Instance ID\n"
+		      "OSPF routing table\n") {
+	struct ospf *ospf;
+
+	if((ospf = show_ip_ospf_instance_lookup(vty, argv[0])) != NULL) {
+		show_ip_ospf_route_sub(vty, ospf);
+	}
 
 	return CMD_SUCCESS;
 }
@@ -5559,7 +6173,7 @@ static int config_write_interface(struct vty *vty) {
 
 			/* Cryptographic Authentication Key print. */
 			for(ALL_LIST_ELEMENTS_RO(params->auth_crypt, n2, ck)) {
-				vty_out(vty, " ip ospf message-digest-key %d md5 %s", ck->key_id, ck->auth_key);
+				vty_out(vty, " ip ospf message-digest-key %d %s %s", ck->key_id, auth_hash_name(ck->hash), ck->auth_key);
 				if(params != IF_DEF_PARAMS(ifp)) {
 					vty_out(vty, " %s", inet_ntoa(rn->p.u.prefix4));
 				}
@@ -5628,6 +6242,22 @@ static int config_write_interface(struct vty *vty) {
 				vty_out(vty, "%s", VTY_NEWLINE);
 			}
 
+			/* Flood pacing and burst print. */
+			if(OSPF_IF_PARAM_CONFIGURED(params, flood_pacing) && params->flood_pacing != OSPF_FLOOD_PACING_DEFAULT) {
+				vty_out(vty, " ip ospf flood-pacing %u", params->flood_pacing);
+				if(params != IF_DEF_PARAMS(ifp)) {
+					vty_out(vty, " %s", inet_ntoa(rn->p.u.prefix4));
+				}
+				vty_out(vty, "%s", VTY_NEWLINE);
+			}
+			if(OSPF_IF_PARAM_CONFIGURED(params, flood_burst) && params->flood_burst != OSPF_FLOOD_BURST_DEFAULT) {
+				vty_out(vty, " ip ospf flood-burst %u", params->flood_burst);
+				if(params != IF_DEF_PARAMS(ifp)) {
+					vty_out(vty, " %s", inet_ntoa(rn->p.u.prefix4));
+				}
+				vty_out(vty, "%s", VTY_NEWLINE);
+			}
+
 			/* Area  print. */
 			if(OSPF_IF_PARAM_CONFIGURED(params, if_area)) {
 				vty_out(vty, " ip ospf area %s", inet_ntoa(params->if_area));
@@ -5650,6 +6280,11 @@ static int config_write_interface(struct vty *vty) {
 				vty_out(vty, "%s", VTY_NEWLINE);
 			}
 
+			/* BFD print. */
+			if(params == IF_DEF_PARAMS(ifp) && OSPF_IF_PARAM_CONFIGURED(params, bfd) && params->bfd) {
+				vty_out(vty, " ip ospf bfd%s", VTY_NEWLINE);
+			}
+
 			while(1) {
 				if(rn == NULL) {
 					rn = route_top(IF_OIFS_PARAMS(ifp));
@@ -5863,7 +6498,7 @@ static int config_write_ospf_redistribute(struct vty *vty, struct ospf *ospf) {
 
 	/* redistribute print. */
 	for(type = 0; type < ZEBRA_ROUTE_MAX; type++) {
-		if(type != zclient->redist_default && vrf_bitmap_check(zclient->redist[type], VRF_DEFAULT)) {
+		if(type != zclient->redist_default && ospf_is_type_redistributed(ospf, type)) {
 			vty_out(vty, " redistribute %s", zebra_route_string(type));
 			if(ospf->dmetric[type].value >= 0) {
 				vty_out(vty, " metric %d", ospf->dmetric[type].value);
@@ -5964,18 +6599,21 @@ static int ospf_config_write(struct vty *vty) {
 	struct ospf *ospf;
 	struct interface *ifp;
 	struct ospf_interface *oi;
-	struct listnode *node;
+	struct listnode *node, *onode;
 	int write = 0;
 
-	ospf = ospf_lookup();
-	if(ospf != NULL) {
+	for(ALL_LIST_ELEMENTS_RO(om->ospf, onode, ospf)) {
 		/* `router ospf' print. */
-		vty_out(vty, "router ospf%s", VTY_NEWLINE);
+		if(ospf->instance) {
+			vty_out(vty, "router ospf %u%s", ospf->instance, VTY_NEWLINE);
+		} else {
+			vty_out(vty, "router ospf%s", VTY_NEWLINE);
+		}
 
 		write++;
 
 		if(!ospf->networks) {
-			return write;
+			continue;
 		}
 
 		/* Router ID print. */
@@ -6018,15 +6656,24 @@ static int ospf_config_write(struct vty *vty) {
 		if(ospf->min_ls_arrival != OSPF_MIN_LS_ARRIVAL) {
 			vty_out(vty, " timers lsa arrival %d%s", ospf->min_ls_arrival, VTY_NEWLINE);
 		}
+		if(ospf->external_lsa_rate != OSPF_EXTERNAL_LSA_RATE_DEFAULT) {
+			vty_out(vty, " timers lsa external-rate %u%s", ospf->external_lsa_rate, VTY_NEWLINE);
+		}
 
 		/* SPF timers print. */
 		if(ospf->spf_delay != OSPF_SPF_DELAY_DEFAULT || ospf->spf_holdtime != OSPF_SPF_HOLDTIME_DEFAULT || ospf->spf_max_holdtime != OSPF_SPF_MAX_HOLDTIME_DEFAULT) {
 			vty_out(vty, " timers throttle spf %d %d %d%s", ospf->spf_delay, ospf->spf_holdtime, ospf->spf_max_holdtime, VTY_NEWLINE);
 		}
+		if(ospf->spf_backoff) {
+			vty_out(vty, " timers throttle spf ietf %d %d %d %d %d%s", ospf->spf_initial_delay, ospf->spf_short_delay, ospf->spf_long_delay, ospf->spf_holddown, ospf->spf_time_to_learn, VTY_NEWLINE);
+		}
 
 		/* Max-metric router-lsa print */
 		config_write_stub_router(vty, ospf);
 
+		/* Graceful restart print. */
+		ospf_gr_config_write_router(vty, ospf);
+
 		/* SPF refresh parameters print. */
 		if(ospf->lsa_refresh_interval != OSPF_LSA_REFRESH_INTERVAL_DEFAULT) {
 			vty_out(vty, " refresh timer %d%s", ospf->lsa_refresh_interval, VTY_NEWLINE);
@@ -6082,6 +6729,10 @@ static int ospf_config_write(struct vty *vty) {
 		config_write_ospf_distance(vty, ospf);
 
 		ospf_opaque_config_write_router(vty, ospf);
+
+		if(listnextnode(onode) != NULL) {
+			vty_out(vty, "!%s", VTY_NEWLINE);
+		}
 	}
 
 	return write;
@@ -6090,6 +6741,10 @@ static int ospf_config_write(struct vty *vty) {
 void ospf_vty_show_init(void) {
 	/* "show ip ospf" commands. */
 	install_element(VIEW_NODE, &show_ip_ospf_cmd);
+	install_element(VIEW_NODE, &show_ip_ospf_instance_cmd);
+	install_element(VIEW_NODE, &show_ip_ospf_instance_neighbor_cmd);
+	install_element(VIEW_NODE, &show_ip_ospf_instance_route_cmd);
+	install_element(VIEW_NODE, &show_ip_ospf_instance_database_cmd);
 
 	/* "show ip ospf database" commands. */
 	install_element(VIEW_NODE, &show_ip_ospf_database_type_cmd);
@@ -6099,6 +6754,7 @@ void ospf_vty_show_init(void) {
 	install_element(VIEW_NODE, &show_ip_ospf_database_type_id_self_cmd);
 	install_element(VIEW_NODE, &show_ip_ospf_database_type_self_cmd);
 	install_element(VIEW_NODE, &show_ip_ospf_database_cmd);
+	install_element(VIEW_NODE, &show_ip_ospf_database_json_cmd);
 
 	/* "show ip ospf interface" commands. */
 	install_element(VIEW_NODE, &show_ip_ospf_interface_cmd);
@@ -6115,6 +6771,12 @@ void ospf_vty_show_init(void) {
 	/* "show ip ospf route" commands. */
 	install_element(VIEW_NODE, &show_ip_ospf_route_cmd);
 	install_element(VIEW_NODE, &show_ip_ospf_border_routers_cmd);
+
+	/* "show ip ospf spf" commands. */
+	install_element(VIEW_NODE, &show_ip_ospf_spf_log_cmd);
+
+	/* "show ip ospf refresher" commands. */
+	install_element(VIEW_NODE, &show_ip_ospf_refresher_cmd);
 }
 
 /* ospfd's interface node. */
@@ -6164,6 +6826,8 @@ static void ospf_vty_if_init(void) {
 	install_element(INTERFACE_NODE, &ip_ospf_mtu_ignore_cmd);
 	install_element(INTERFACE_NODE, &no_ip_ospf_mtu_ignore_addr_cmd);
 	install_element(INTERFACE_NODE, &no_ip_ospf_mtu_ignore_cmd);
+	install_element(INTERFACE_NODE, &ip_ospf_bfd_cmd);
+	install_element(INTERFACE_NODE, &no_ip_ospf_bfd_cmd);
 
 	/* "ip ospf dead-interval" commands. */
 	install_element(INTERFACE_NODE, &ip_ospf_dead_interval_addr_cmd);
@@ -6203,6 +6867,16 @@ static void ospf_vty_if_init(void) {
 	install_element(INTERFACE_NODE, &no_ip_ospf_transmit_delay_addr_cmd);
 	install_element(INTERFACE_NODE, &no_ip_ospf_transmit_delay_cmd);
 
+	/* "ip ospf flood-pacing" and "ip ospf flood-burst" commands. */
+	install_element(INTERFACE_NODE, &ip_ospf_flood_pacing_addr_cmd);
+	install_element(INTERFACE_NODE, &ip_ospf_flood_pacing_cmd);
+	install_element(INTERFACE_NODE, &no_ip_ospf_flood_pacing_addr_cmd);
+	install_element(INTERFACE_NODE, &no_ip_ospf_flood_pacing_cmd);
+	install_element(INTERFACE_NODE, &ip_ospf_flood_burst_addr_cmd);
+	install_element(INTERFACE_NODE, &ip_ospf_flood_burst_cmd);
+	install_element(INTERFACE_NODE, &no_ip_ospf_flood_burst_addr_cmd);
+	install_element(INTERFACE_NODE, &no_ip_ospf_flood_burst_cmd);
+
 	/* "ip ospf area" commands. */
 	install_element(INTERFACE_NODE, &ip_ospf_area_cmd);
 	install_element(INTERFACE_NODE, &no_ip_ospf_area_cmd);
@@ -6307,7 +6981,9 @@ void ospf_vty_init(void) {
 
 	/* "router ospf" commands. */
 	install_element(CONFIG_NODE, &router_ospf_cmd);
+	install_element(CONFIG_NODE, &router_ospf_instance_cmd);
 	install_element(CONFIG_NODE, &no_router_ospf_cmd);
+	install_element(CONFIG_NODE, &no_router_ospf_instance_cmd);
 
 	install_default(OSPF_NODE);
 
@@ -6431,12 +7107,17 @@ void ospf_vty_init(void) {
 	install_element(OSPF_NODE, &no_ospf_timers_min_ls_interval_cmd);
 	install_element(OSPF_NODE, &ospf_timers_min_ls_arrival_cmd);
 	install_element(OSPF_NODE, &no_ospf_timers_min_ls_arrival_cmd);
+	install_element(OSPF_NODE, &ospf_timers_external_lsa_rate_cmd);
+	install_element(OSPF_NODE, &no_ospf_timers_external_lsa_rate_cmd);
+	install_element(OSPF_NODE, &no_ospf_timers_external_lsa_rate_val_cmd);
 
 	/* SPF timer commands */
 	install_element(OSPF_NODE, &ospf_timers_spf_cmd);
 	install_element(OSPF_NODE, &no_ospf_timers_spf_cmd);
 	install_element(OSPF_NODE, &ospf_timers_throttle_spf_cmd);
 	install_element(OSPF_NODE, &no_ospf_timers_throttle_spf_cmd);
+	install_element(OSPF_NODE, &ospf_timers_throttle_spf_ietf_cmd);
+	install_element(OSPF_NODE, &no_ospf_timers_throttle_spf_ietf_cmd);
 
 	/* refresh timer commands */
 	install_element(OSPF_NODE, &ospf_refresh_timer_cmd);
@@ -50,6 +50,8 @@
 	#include "ospfd/ospf_snmp.h"
 #endif /* HAVE_SNMP */
 #include "ospfd/ospf_te.h"
+#include "ospfd/ospf_gr.h"
+#include "ospfd/ospf_bfd.h"
 
 /* Zebra structure to hold current status. */
 struct zclient *zclient = NULL;
@@ -61,6 +63,7 @@ struct in_addr router_id_zebra;
 /* Router-id update message from zebra. */
 static int ospf_router_id_update_zebra(int command, struct zclient *zclient, zebra_size_t length, vrf_id_t vrf_id) {
 	struct ospf *ospf;
+	struct listnode *node;
 	struct prefix router_id;
 	zebra_router_id_update_read(zclient->ibuf, &router_id);
 
@@ -72,9 +75,7 @@ static int ospf_router_id_update_zebra(int command, struct zclient *zclient, zeb
 
 	router_id_zebra = router_id.u.prefix4;
 
-	ospf = ospf_lookup();
-
-	if(ospf != NULL) {
+	for(ALL_LIST_ELEMENTS_RO(om->ospf, node, ospf)) {
 		ospf_router_id_update(ospf);
 	}
 
@@ -138,7 +139,7 @@ static int ospf_interface_delete(int command, struct zclient *zclient, zebra_siz
 		}
 	}
 
-	ifp->ifindex = IFINDEX_INTERNAL;
+	if_set_index(ifp, IFINDEX_INTERNAL);
 	return 0;
 }
 
@@ -320,6 +321,57 @@ static int ospf_interface_link_params(int command, struct zclient *zclient, zebr
 	return 0;
 }
 
+/* The metric zebra gets for a route */
+static u_int32_t ospf_zebra_metric(struct ospf_route * or) {
+	if(or->path_type == OSPF_PATH_TYPE1_EXTERNAL) {
+		return or->cost + or->u.ext.type2_cost;
+	} else if(or->path_type == OSPF_PATH_TYPE2_EXTERNAL) {
+		return or->u.ext.type2_cost;
+	}
+	return or->cost;
+}
+
+/* The tag zebra gets for a route, 0 for none */
+static route_tag_t ospf_zebra_tag(struct ospf_route * or) {
+	if(((or->path_type == OSPF_PATH_TYPE1_EXTERNAL) || (or->path_type == OSPF_PATH_TYPE2_EXTERNAL)) && (or->u.ext.tag > 0) && (or->u.ext.tag <= ROUTE_TAG_MAX)) {
+		return or->u.ext.tag;
+	}
+	return 0;
+}
+
+/* If zebra would be told the same about the new route as about the old
+   one, nexthops, metric, distance and tag, so that installing it changes
+   nothing, then return 1, otherwise return 0.  The routes may still
+   differ in path type or cost. */
+int ospf_zebra_route_same(struct prefix_ipv4 *p, struct ospf_route * or, struct ospf_route *newor) {
+	if(or->type != newor->type) {
+		return 0;
+	}
+	if(or->type == OSPF_DESTINATION_DISCARD) {
+		return 1;
+	}
+	return ospf_route_paths_same(or, newor) && ospf_zebra_metric(or) == ospf_zebra_metric(newor) && ospf_distance_apply(p, or) == ospf_distance_apply(p, newor) && ospf_zebra_tag(or) == ospf_zebra_tag(newor);
+}
+
+/* Between ospf_zebra_batch_start() and ospf_zebra_batch_end(), the
+   routes added and deleted go to zebra in as few messages as they fit,
+   for a routing table's changes at once. */
+void ospf_zebra_batch_start(void) {
+	zclient_route_batch(zclient, 1);
+}
+
+void ospf_zebra_batch_end(void) {
+	zclient_route_batch(zclient, 0);
+}
+
+/* Restarting gracefully, zebra keeps the routes from before as they are
+   until the restart is over, see ospf_gr.c. */
+static int ospf_zebra_gr_hold(void) {
+	struct ospf *ospf = ospf_lookup();
+
+	return ospf && OSPF_GR_RESTARTING_P(ospf);
+}
+
 void ospf_zebra_add(struct prefix_ipv4 *p, struct ospf_route * or) {
 	u_char message;
 	u_char distance;
@@ -329,7 +381,7 @@ void ospf_zebra_add(struct prefix_ipv4 *p, struct ospf_route * or) {
 	struct ospf_path *path;
 	struct listnode *node;
 
-	if(vrf_bitmap_check(zclient->redist[ZEBRA_ROUTE_OSPF], VRF_DEFAULT)) {
+	if(vrf_bitmap_check(zclient->redist[ZEBRA_ROUTE_OSPF], VRF_DEFAULT) && !ospf_zebra_gr_hold()) {
 		message = 0;
 		flags = 0;
 
@@ -344,7 +396,7 @@ void ospf_zebra_add(struct prefix_ipv4 *p, struct ospf_route * or) {
 		}
 
 		/* Check if path type is ASE */
-		if(((or->path_type == OSPF_PATH_TYPE1_EXTERNAL) || (or->path_type == OSPF_PATH_TYPE2_EXTERNAL)) && (or->u.ext.tag > 0) && (or->u.ext.tag <= ROUTE_TAG_MAX)) {
+		if(ospf_zebra_tag(or)) {
 			SET_FLAG(message, ZAPI_MESSAGE_TAG);
 		}
 
@@ -395,13 +447,7 @@ void ospf_zebra_add(struct prefix_ipv4 *p, struct ospf_route * or) {
 			stream_putc(s, distance);
 		}
 		if(CHECK_FLAG(message, ZAPI_MESSAGE_METRIC)) {
-			if(or->path_type == OSPF_PATH_TYPE1_EXTERNAL) {
-				stream_putl(s, or->cost + or->u.ext.type2_cost);
-			} else if(or->path_type == OSPF_PATH_TYPE2_EXTERNAL) {
-				stream_putl(s, or->u.ext.type2_cost);
-			} else {
-				stream_putl(s, or->cost);
-			}
+			stream_putl(s, ospf_zebra_metric(or));
 		}
 
 		if(CHECK_FLAG(message, ZAPI_MESSAGE_TAG)) {
@@ -410,7 +456,7 @@ void ospf_zebra_add(struct prefix_ipv4 *p, struct ospf_route * or) {
 
 		stream_putw_at(s, 0, stream_get_endp(s));
 
-		zclient_send_message(zclient);
+		zclient_route_send(zclient, ZEBRA_IPV4_ROUTE_ADD);
 	}
 }
 
@@ -423,7 +469,7 @@ void ospf_zebra_delete(struct prefix_ipv4 *p, struct ospf_route * or) {
 	struct ospf_path *path;
 	struct listnode *node;
 
-	if(vrf_bitmap_check(zclient->redist[ZEBRA_ROUTE_OSPF], VRF_DEFAULT)) {
+	if(vrf_bitmap_check(zclient->redist[ZEBRA_ROUTE_OSPF], VRF_DEFAULT) && !ospf_zebra_gr_hold()) {
 		message = 0;
 		flags = 0;
 		/* Distance value. */
@@ -471,18 +517,12 @@ void ospf_zebra_delete(struct prefix_ipv4 *p, struct ospf_route * or) {
 			stream_putc(s, distance);
 		}
 		if(CHECK_FLAG(message, ZAPI_MESSAGE_METRIC)) {
-			if(or->path_type == OSPF_PATH_TYPE1_EXTERNAL) {
-				stream_putl(s, or->cost + or->u.ext.type2_cost);
-			} else if(or->path_type == OSPF_PATH_TYPE2_EXTERNAL) {
-				stream_putl(s, or->u.ext.type2_cost);
-			} else {
-				stream_putl(s, or->cost);
-			}
+			stream_putl(s, ospf_zebra_metric(or));
 		}
 
 		stream_putw_at(s, 0, stream_get_endp(s));
 
-		zclient_send_message(zclient);
+		zclient_route_send(zclient, ZEBRA_IPV4_ROUTE_DELETE);
 	}
 }
 
@@ -511,7 +551,7 @@ void ospf_zebra_add_discard(struct prefix_ipv4 *p) {
 void ospf_zebra_delete_discard(struct prefix_ipv4 *p) {
 	struct zapi_ipv4 api;
 
-	if(vrf_bitmap_check(zclient->redist[ZEBRA_ROUTE_OSPF], VRF_DEFAULT)) {
+	if(vrf_bitmap_check(zclient->redist[ZEBRA_ROUTE_OSPF], VRF_DEFAULT) && !ospf_zebra_gr_hold()) {
 		api.vrf_id = VRF_DEFAULT;
 		api.type = ZEBRA_ROUTE_OSPF;
 		api.flags = ZEBRA_FLAG_BLACKHOLE;
@@ -530,14 +570,42 @@ void ospf_zebra_delete_discard(struct prefix_ipv4 *p) {
 	}
 }
 
-int ospf_is_type_redistributed(int type) {
+/* Have zebra keep the OSPF routes for so many seconds once ospfd has
+   gone, or, with 0, drop those it still keeps from before. */
+void ospf_zebra_graceful_restart(u_int32_t secs) {
+	if(zebra_graceful_restart_send(zclient, secs) < 0) {
+		zlog_warn("Zebra: can't send graceful restart %us", secs);
+	} else if(IS_DEBUG_OSPF(zebra, ZEBRA_REDISTRIBUTE)) {
+		zlog_debug("Zebra: Graceful restart %us", secs);
+	}
+}
+
+/* Whether an instance, or any of them for NULL, redistributes a type.
+   Zebra is asked for a type once, on behalf of all instances. */
+int ospf_is_type_redistributed(struct ospf *ospf, int type) {
+	if(ospf != NULL) {
+		return ospf->redist[type];
+	}
 	return (DEFAULT_ROUTE_TYPE(type)) ? vrf_bitmap_check(zclient->default_information, VRF_DEFAULT) : vrf_bitmap_check(zclient->redist[type], VRF_DEFAULT);
 }
 
+/* Does another instance still redistribute this type? */
+static int ospf_redistribute_shared(struct ospf *ospf, int type) {
+	struct ospf *other;
+	struct listnode *node;
+
+	for(ALL_LIST_ELEMENTS_RO(om->ospf, node, other)) {
+		if(other != ospf && other->redist[type]) {
+			return 1;
+		}
+	}
+	return 0;
+}
+
 int ospf_redistribute_set(struct ospf *ospf, int type, int mtype, int mvalue) {
 	int force = 0;
 
-	if(ospf_is_type_redistributed(type)) {
+	if(ospf_is_type_redistributed(ospf, type)) {
 		if(mtype != ospf->dmetric[type].type) {
 			ospf->dmetric[type].type = mtype;
 			force = LSA_REFRESH_FORCE;
@@ -558,8 +626,19 @@ int ospf_redistribute_set(struct ospf *ospf, int type, int mtype, int mvalue) {
 
 	ospf->dmetric[type].type = mtype;
 	ospf->dmetric[type].value = mvalue;
+	ospf->redist[type] = 1;
 
-	zclient_redistribute(ZEBRA_REDISTRIBUTE_ADD, zclient, type, VRF_DEFAULT);
+	/* Zebra already sends the routes to another instance, originate
+	   from what it has told us so far. */
+	if(ospf_is_type_redistributed(NULL, type)) {
+		if(ospf->router_id.s_addr == 0) {
+			ospf->external_origin |= (1 << type);
+		} else {
+			thread_add_event(master, ospf_external_lsa_originate_timer, ospf, type);
+		}
+	} else {
+		zclient_redistribute(ZEBRA_REDISTRIBUTE_ADD, zclient, type, VRF_DEFAULT);
+	}
 
 	if(IS_DEBUG_OSPF(zebra, ZEBRA_REDISTRIBUTE)) {
 		zlog_debug("Redistribute[%s]: Start  Type[%d], Metric[%d]", ospf_redist_string(type), metric_type(ospf, type), metric_value(ospf, type));
@@ -575,11 +654,14 @@ int ospf_redistribute_unset(struct ospf *ospf, int type) {
 		return CMD_SUCCESS;
 	}
 
-	if(!ospf_is_type_redistributed(type)) {
+	if(!ospf_is_type_redistributed(ospf, type)) {
 		return CMD_SUCCESS;
 	}
 
-	zclient_redistribute(ZEBRA_REDISTRIBUTE_DELETE, zclient, type, VRF_DEFAULT);
+	ospf->redist[type] = 0;
+	if(!ospf_redistribute_shared(ospf, type)) {
+		zclient_redistribute(ZEBRA_REDISTRIBUTE_DELETE, zclient, type, VRF_DEFAULT);
+	}
 
 	if(IS_DEBUG_OSPF(zebra, ZEBRA_REDISTRIBUTE)) {
 		zlog_debug("Redistribute[%s]: Stop", ospf_redist_string(type));
@@ -601,7 +683,7 @@ int ospf_redistribute_default_set(struct ospf *ospf, int originate, int mtype, i
 	ospf->dmetric[DEFAULT_ROUTE].type = mtype;
 	ospf->dmetric[DEFAULT_ROUTE].value = mvalue;
 
-	if(ospf_is_type_redistributed(DEFAULT_ROUTE)) {
+	if(ospf_is_type_redistributed(ospf, DEFAULT_ROUTE)) {
 		/* if ospf->default_originate changes value, is calling
 	 ospf_external_lsa_refresh_default sufficient to implement
 	 the change? */
@@ -613,7 +695,10 @@ int ospf_redistribute_default_set(struct ospf *ospf, int originate, int mtype, i
 		return CMD_SUCCESS;
 	}
 
-	zclient_redistribute_default(ZEBRA_REDISTRIBUTE_DEFAULT_ADD, zclient, VRF_DEFAULT);
+	ospf->redist[DEFAULT_ROUTE] = 1;
+	if(!ospf_is_type_redistributed(NULL, DEFAULT_ROUTE)) {
+		zclient_redistribute_default(ZEBRA_REDISTRIBUTE_DEFAULT_ADD, zclient, VRF_DEFAULT);
+	}
 
 	if(IS_DEBUG_OSPF(zebra, ZEBRA_REDISTRIBUTE)) {
 		zlog_debug("Redistribute[DEFAULT]: Start  Type[%d], Metric[%d]", metric_type(ospf, DEFAULT_ROUTE), metric_value(ospf, DEFAULT_ROUTE));
@@ -631,7 +716,7 @@ int ospf_redistribute_default_set(struct ospf *ospf, int originate, int mtype, i
 }
 
 int ospf_redistribute_default_unset(struct ospf *ospf) {
-	if(!ospf_is_type_redistributed(DEFAULT_ROUTE)) {
+	if(!ospf_is_type_redistributed(ospf, DEFAULT_ROUTE)) {
 		return CMD_SUCCESS;
 	}
 
@@ -639,7 +724,10 @@ int ospf_redistribute_default_unset(struct ospf *ospf) {
 	ospf->dmetric[DEFAULT_ROUTE].type = -1;
 	ospf->dmetric[DEFAULT_ROUTE].value = -1;
 
-	zclient_redistribute_default(ZEBRA_REDISTRIBUTE_DEFAULT_DELETE, zclient, VRF_DEFAULT);
+	ospf->redist[DEFAULT_ROUTE] = 0;
+	if(!ospf_redistribute_shared(ospf, DEFAULT_ROUTE)) {
+		zclient_redistribute_default(ZEBRA_REDISTRIBUTE_DEFAULT_DELETE, zclient, VRF_DEFAULT);
+	}
 
 	if(IS_DEBUG_OSPF(zebra, ZEBRA_REDISTRIBUTE)) {
 		zlog_debug("Redistribute[DEFAULT]: Stop");
@@ -700,6 +788,11 @@ int ospf_redistribute_check(struct ospf *ospf, struct external_info *ei, int *ch
 		return 0;
 	}
 
+	/* The external info is shared, skip what another instance asked for. */
+	if(!DEFAULT_ROUTE_TYPE(type) && !ospf_is_type_redistributed(ospf, type)) {
+		return 0;
+	}
+
 	/* Take care connected route. */
 	if(type == ZEBRA_ROUTE_CONNECT && !ospf_distribute_check_connected(ospf, ei)) {
 		return 0;
@@ -762,6 +855,115 @@ void ospf_routemap_unset(struct ospf *ospf, int type) {
 	ROUTEMAP(ospf, type) = NULL;
 }
 
+/* The redistributed route of a type this instance redistributes, if any */
+static struct external_info *ospf_external_info_redistributed(struct ospf *ospf, struct prefix_ipv4 *p) {
+	struct external_info *ei;
+	int type;
+
+	for(type = 0; type < ZEBRA_ROUTE_MAX; type++) {
+		if(ospf_is_type_redistributed(ospf, type) && (ei = ospf_external_info_lookup(type, p))) {
+			return ei;
+		}
+	}
+	return NULL;
+}
+
+/* Bring the AS-external-LSA for a pending prefix in line with what is
+ * redistributed now, whatever came and went while it waited. */
+static void ospf_external_pending_process(struct ospf *ospf, struct prefix_ipv4 *p) {
+	struct external_info *ei;
+	struct ospf_lsa *current;
+
+	ei = ospf_external_info_redistributed(ospf, p);
+	current = ospf_external_info_find_lsa(ospf, p);
+
+	if(ei) {
+		if(!current) {
+			ospf_external_lsa_originate(ospf, ei);
+		} else if(IS_LSA_MAXAGE(current)) {
+			ospf_external_lsa_refresh(ospf, current, ei, LSA_REFRESH_FORCE);
+		} else if(!CHECK_FLAG(current->flags, OSPF_LSA_LOCAL_XLT)) {
+			ospf_external_lsa_refresh(ospf, current, ei, LSA_REFRESH_IF_CHANGED);
+		}
+	} else if(current) {
+		ospf_external_lsa_flush(ospf, 0, p, 0);
+	}
+}
+
+static int ospf_external_pending_timer(struct thread *t) {
+	struct ospf *ospf = THREAD_ARG(t);
+	struct route_node *rn;
+	unsigned int budget;
+
+	ospf->t_external_pending = NULL;
+
+	budget = ospf->external_lsa_rate * OSPF_EXTERNAL_PENDING_INTERVAL / 1000;
+	if(budget == 0) {
+		budget = 1;
+	}
+
+	for(rn = route_top(ospf->external_pending); rn && budget; rn = route_next(rn)) {
+		if(!rn->info) {
+			continue;
+		}
+		rn->info = NULL;
+		ospf->external_pending_count--;
+		ospf_external_pending_process(ospf, (struct prefix_ipv4 *) &rn->p);
+		route_unlock_node(rn);
+		budget--;
+	}
+	if(rn) {
+		route_unlock_node(rn);
+	}
+
+	if(ospf->external_pending_count) {
+		ospf->t_external_pending = thread_add_timer_msec(master, ospf_external_pending_timer, ospf, OSPF_EXTERNAL_PENDING_INTERVAL);
+	}
+	return 0;
+}
+
+/* Queue a redistributed prefix for its AS-external-LSA to be originated,
+ * refreshed or flushed.  The queue is worked at external_lsa_rate, and
+ * a prefix already on it stays there once, however often it flaps. */
+void ospf_external_pending_add(struct ospf *ospf, struct prefix_ipv4 *p) {
+	struct route_node *rn;
+
+	if(!ospf->external_pending) {
+		ospf->external_pending = route_table_init();
+	}
+
+	rn = route_node_get(ospf->external_pending, (struct prefix *) p);
+	if(rn->info) {
+		route_unlock_node(rn);
+		ospf->external_pending_coalesced++;
+		return;
+	}
+	rn->info = ospf;
+	ospf->external_pending_count++;
+
+	if(!ospf->t_external_pending) {
+		ospf->t_external_pending = thread_add_timer_msec(master, ospf_external_pending_timer, ospf, OSPF_EXTERNAL_PENDING_INTERVAL);
+	}
+}
+
+void ospf_external_pending_finish(struct ospf *ospf) {
+	struct route_node *rn;
+
+	OSPF_TIMER_OFF(ospf->t_external_pending);
+	if(!ospf->external_pending) {
+		return;
+	}
+	for(rn = route_top(ospf->external_pending); rn; rn = route_next(rn)) {
+		if(rn->info) {
+			rn->info = NULL;
+			route_unlock_node(rn);
+		}
+	}
+	route_table_finish(ospf->external_pending);
+	ospf->external_pending = NULL;
+	ospf->external_pending_count = 0;
+}
+
 /* Zebra route add and delete treatment. */
 static int ospf_zebra_read_ipv4(int command, struct zclient *zclient, zebra_size_t length, vrf_id_t vrf_id) {
 	struct stream *s;
@@ -771,6 +973,7 @@ static int ospf_zebra_read_ipv4(int command, struct zclient *zclient, zebra_size
 	struct prefix_ipv4 p;
 	struct external_info *ei;
 	struct ospf *ospf;
+	struct listnode *node;
 	unsigned char plength = 0;
 
 	s = zclient->ibuf;
@@ -815,8 +1018,7 @@ static int ospf_zebra_read_ipv4(int command, struct zclient *zclient, zebra_size
 		api.tag = 0;
 	}
 
-	ospf = ospf_lookup();
-	if(ospf == NULL) {
+	if(listcount(om->ospf) == 0) {
 		return 0;
 	}
 
@@ -832,42 +1034,47 @@ static int ospf_zebra_read_ipv4(int command, struct zclient *zclient, zebra_size
        * return 0;
        */
 
-		/* Protocol tag overwrites all other tag value send by zebra */
-		if(ospf->dtag[api.type] > 0) {
-			api.tag = ospf->dtag[api.type];
+		/* Protocol tag overwrites all other tag value send by zebra,
+		 * the external info being shared, the first instance's does. */
+		for(ALL_LIST_ELEMENTS_RO(om->ospf, node, ospf)) {
+			if(ospf_is_type_redistributed(ospf, api.type) && ospf->dtag[api.type] > 0) {
+				api.tag = ospf->dtag[api.type];
+				break;
+			}
 		}
 
 		ei = ospf_external_info_add(api.type, p, ifindex, nexthop, api.tag);
 
-		if(ospf->router_id.s_addr == 0) {
-			/* Set flags to generate AS-external-LSA originate event
-           for each redistributed protocols later. */
-			ospf->external_origin |= (1 << api.type);
-		} else {
-			if(ei) {
+		for(ALL_LIST_ELEMENTS_RO(om->ospf, node, ospf)) {
+			if(!ospf_is_type_redistributed(ospf, api.type)) {
+				continue;
+			}
+
+			if(ospf->router_id.s_addr == 0) {
+				/* Set flags to generate AS-external-LSA originate event
+	           for each redistributed protocols later. */
+				ospf->external_origin |= (1 << api.type);
+			} else if(ei) {
 				if(is_prefix_default(&p)) {
 					ospf_external_lsa_refresh_default(ospf);
 				} else {
-					struct ospf_lsa *current;
-
-					current = ospf_external_info_find_lsa(ospf, &ei->p);
-					if(!current) {
-						ospf_external_lsa_originate(ospf, ei);
-					} else if(IS_LSA_MAXAGE(current)) {
-						ospf_external_lsa_refresh(ospf, current, ei, LSA_REFRESH_FORCE);
-					} else {
-						zlog_warn("ospf_zebra_read_ipv4() : %s already exists", inet_ntoa(p.prefix));
-					}
+					ospf_external_pending_add(ospf, &p);
 				}
 			}
 		}
 	} else /* if (command == ZEBRA_IPV4_ROUTE_DELETE) */
 	{
 		ospf_external_info_delete(api.type, p);
-		if(is_prefix_default(&p)) {
-			ospf_external_lsa_refresh_default(ospf);
-		} else {
-			ospf_external_lsa_flush(ospf, api.type, &p, ifindex /*, nexthop */);
+		for(ALL_LIST_ELEMENTS_RO(om->ospf, node, ospf)) {
+			if(!ospf_is_type_redistributed(ospf, api.type)) {
+				continue;
+			}
+
+			if(is_prefix_default(&p)) {
+				ospf_external_lsa_refresh_default(ospf);
+			} else {
+				ospf_external_pending_add(ospf, &p);
+			}
 		}
 	}
 
@@ -920,12 +1127,7 @@ static int ospf_distribute_list_update_timer(struct thread *thread) {
 	struct route_table *rt;
 	struct ospf_lsa *lsa;
 	int type, default_refresh = 0;
-	struct ospf *ospf;
-
-	ospf = ospf_lookup();
-	if(ospf == NULL) {
-		return 0;
-	}
+	struct ospf *ospf = THREAD_ARG(thread);
 
 	ospf->t_distribute_update = NULL;
 
@@ -970,23 +1172,16 @@ void ospf_distribute_list_update(struct ospf *ospf, uintptr_t type) {
 	}
 
 	/* Set timer. */
-	ospf->t_distribute_update = thread_add_timer_msec(master, ospf_distribute_list_update_timer, (void *) type, ospf->min_ls_interval);
+	ospf->t_distribute_update = thread_add_timer_msec(master, ospf_distribute_list_update_timer, ospf, ospf->min_ls_interval);
 }
 
 /* If access-list is updated, apply some check. */
-static void ospf_filter_update(const char *name) {
-	struct ospf *ospf;
+static void ospf_filter_update_instance(struct ospf *ospf, const char *name) {
 	int type;
 	int abr_inv = 0;
 	struct ospf_area *area;
 	struct listnode *node;
 
-	/* If OSPF instatnce does not exist, return right now. */
-	ospf = ospf_lookup();
-	if(ospf == NULL) {
-		return;
-	}
-
 	/* Update distribute-list, and apply filter. */
 	for(type = 0; type <= ZEBRA_ROUTE_MAX; type++) {
 		if(ROUTEMAP(ospf, type) != NULL) {
@@ -1039,20 +1234,22 @@ static void ospf_filter_update(const char *name) {
 	}
 }
 
-/* If prefix-list is updated, do some updates. */
-void ospf_prefix_list_update(struct prefix_list *plist) {
+static void ospf_filter_update(const char *name) {
 	struct ospf *ospf;
+	struct listnode *node;
+
+	for(ALL_LIST_ELEMENTS_RO(om->ospf, node, ospf)) {
+		ospf_filter_update_instance(ospf, name);
+	}
+}
+
+/* If prefix-list is updated, do some updates. */
+static void ospf_prefix_list_update_instance(struct ospf *ospf, struct prefix_list *plist) {
 	int type;
 	int abr_inv = 0;
 	struct ospf_area *area;
 	struct listnode *node;
 
-	/* If OSPF instatnce does not exist, return right now. */
-	ospf = ospf_lookup();
-	if(ospf == NULL) {
-		return;
-	}
-
 	/* Update all route-maps which are used as redistribution filters.
    * They might use prefix-list.
    */
@@ -1089,6 +1286,15 @@ void ospf_prefix_list_update(struct prefix_list *plist) {
 	}
 }
 
+void ospf_prefix_list_update(struct prefix_list *plist) {
+	struct ospf *ospf;
+	struct listnode *node;
+
+	for(ALL_LIST_ELEMENTS_RO(om->ospf, node, ospf)) {
+		ospf_prefix_list_update_instance(ospf, plist);
+	}
+}
+
 static struct ospf_distance *ospf_distance_new(void) {
 	return XCALLOC(MTYPE_OSPF_DISTANCE, sizeof(struct ospf_distance));
 }
@@ -1220,6 +1426,7 @@ u_char ospf_distance_apply(struct prefix_ipv4 *p, struct ospf_route * or) {
 
 static void ospf_zebra_connected(struct zclient *zclient) {
 	zclient_send_requests(zclient, VRF_DEFAULT);
+	ospf_bfd_register_all();
 }
 
 void ospf_zebra_init(struct thread_master *master) {
@@ -1238,6 +1445,7 @@ void ospf_zebra_init(struct thread_master *master) {
 
 	zclient->ipv4_route_add = ospf_zebra_read_ipv4;
 	zclient->ipv4_route_delete = ospf_zebra_read_ipv4;
+	zclient->bfd_update = ospf_bfd_update;
 
 	access_list_add_hook(ospf_filter_update);
 	access_list_delete_hook(ospf_filter_update);
@@ -44,17 +44,23 @@ struct ospf_distance {
 /* Prototypes */
 extern void ospf_zclient_start(void);
 
+extern int ospf_zebra_route_same(struct prefix_ipv4 *, struct ospf_route *, struct ospf_route *);
+extern void ospf_zebra_batch_start(void);
+extern void ospf_zebra_batch_end(void);
 extern void ospf_zebra_add(struct prefix_ipv4 *, struct ospf_route *);
 extern void ospf_zebra_delete(struct prefix_ipv4 *, struct ospf_route *);
 
 extern void ospf_zebra_add_discard(struct prefix_ipv4 *);
 extern void ospf_zebra_delete_discard(struct prefix_ipv4 *);
+extern void ospf_zebra_graceful_restart(u_int32_t);
 
 extern int ospf_redistribute_check(struct ospf *, struct external_info *, int *);
 extern int ospf_distribute_check_connected(struct ospf *, struct external_info *);
 extern void ospf_distribute_list_update(struct ospf *, uintptr_t);
 
-extern int ospf_is_type_redistributed(int);
+extern int ospf_is_type_redistributed(struct ospf *, int);
+extern void ospf_external_pending_add(struct ospf *, struct prefix_ipv4 *);
+extern void ospf_external_pending_finish(struct ospf *);
 extern void ospf_distance_reset(struct ospf *);
 extern u_char ospf_distance_apply(struct prefix_ipv4 *, struct ospf_route *);
 
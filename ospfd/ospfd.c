@@ -52,6 +52,7 @@ Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
 #include "ospfd/ospf_flood.h"
 #include "ospfd/ospf_route.h"
 #include "ospfd/ospf_ase.h"
+#include "ospfd/ospf_gr.h"
 
 /* OSPF process wide configuration. */
 static struct ospf_master ospf_master;
@@ -154,12 +155,67 @@ static int ospf_area_id_cmp(struct ospf_area *a1, struct ospf_area *a2) {
 	return 0;
 }
 
+/* Open the raw socket the instances share, if not yet open. */
+static void ospf_sock_start(void) {
+	int i;
+
+	if(om->fd >= 0) {
+		return;
+	}
+
+	if((om->fd = ospf_sock_init()) < 0) {
+		zlog_err("ospf_new: fatal error: ospf_sock_init was unable to open "
+			 "a socket");
+		exit(1);
+	}
+	om->maxsndbuflen = getsockopt_so_sendbuf(om->fd);
+	if(IS_DEBUG_OSPF(zebra, ZEBRA_INTERFACE)) {
+		zlog_debug("%s: starting with OSPF send buffer size %u", __func__, om->maxsndbuflen);
+	}
+	for(i = 0; i < OSPF_READ_BATCH; i++) {
+		if((om->ibuf[i] = stream_new(OSPF_MAX_PACKET_SIZE + 1)) == NULL) {
+			zlog_err("ospf_new: fatal error: stream_new(%u) failed allocating ibuf", OSPF_MAX_PACKET_SIZE + 1);
+			exit(1);
+		}
+	}
+	om->t_read = thread_add_read(master, ospf_read, NULL, om->fd);
+	ospf_sock_filter_update();
+}
+
+/* Close it again once the last instance is gone. */
+static void ospf_sock_stop(void) {
+	int i;
+
+	if(om->fd < 0 || listcount(om->ospf) != 0) {
+		return;
+	}
+
+	OSPF_TIMER_OFF(om->t_read);
+	OSPF_TIMER_OFF(om->t_write);
+	OSPF_TIMER_OFF(om->t_filter);
+	list_delete_all_node(om->oi_write_q);
+	ospf_read_flush();
+	close(om->fd);
+	om->fd = -1;
+	om->maxsndbuflen = 0;
+	for(i = 0; i < OSPF_READ_BATCH; i++) {
+		stream_free(om->ibuf[i]);
+		om->ibuf[i] = NULL;
+	}
+}
+
+static int ospf_instance_cmp(struct ospf *o1, struct ospf *o2) {
+	return (int) o1->instance - (int) o2->instance;
+}
+
 /* Allocate new ospf structure. */
-static struct ospf *ospf_new(void) {
+static struct ospf *ospf_new(u_short instance) {
 	int i;
 
 	struct ospf *new = XCALLOC(MTYPE_OSPF_TOP, sizeof(struct ospf));
 
+	new->instance = instance;
+
 	new->router_id.s_addr = htonl(0);
 	new->router_id_static.s_addr = htonl(0);
 
@@ -185,6 +241,8 @@ static struct ospf *ospf_new(void) {
 	new->stub_router_shutdown_time = OSPF_STUB_ROUTER_UNCONFIGURED;
 	new->stub_router_admin_set = OSPF_STUB_ROUTER_ADMINISTRATIVE_UNSET;
 
+	new->gr_period = OSPF_GR_PERIOD_DEFAULT;
+
 	/* Distribute parameter init. */
 	for(i = 0; i <= ZEBRA_ROUTE_MAX; i++) {
 		new->dmetric[i].type = -1;
@@ -203,6 +261,11 @@ static struct ospf *ospf_new(void) {
 	new->spf_holdtime = OSPF_SPF_HOLDTIME_DEFAULT;
 	new->spf_max_holdtime = OSPF_SPF_MAX_HOLDTIME_DEFAULT;
 	new->spf_hold_multiplier = 1;
+	new->spf_initial_delay = OSPF_SPF_INITIAL_DELAY_DEFAULT;
+	new->spf_short_delay = OSPF_SPF_SHORT_DELAY_DEFAULT;
+	new->spf_long_delay = OSPF_SPF_LONG_DELAY_DEFAULT;
+	new->spf_holddown = OSPF_SPF_HOLDDOWN_DEFAULT;
+	new->spf_time_to_learn = OSPF_SPF_TIME_TO_LEARN_DEFAULT;
 
 	/* MaxAge init. */
 	new->maxage_delay = OSPF_LSA_MAXAGE_REMOVE_DELAY_DEFAULT;
@@ -212,26 +275,14 @@ static struct ospf *ospf_new(void) {
 	/* Distance table init. */
 	new->distance_table = route_table_init();
 
+	new->external_lsa_rate = OSPF_EXTERNAL_LSA_RATE_DEFAULT;
+
 	new->lsa_refresh_queue.index = 0;
 	new->lsa_refresh_interval = OSPF_LSA_REFRESH_INTERVAL_DEFAULT;
 	new->t_lsa_refresher = thread_add_timer(master, ospf_lsa_refresh_walker, new, new->lsa_refresh_interval);
 	new->lsa_refresher_started = quagga_time(NULL);
 
-	if((new->fd = ospf_sock_init()) < 0) {
-		zlog_err("ospf_new: fatal error: ospf_sock_init was unable to open "
-			 "a socket");
-		exit(1);
-	}
-	new->maxsndbuflen = getsockopt_so_sendbuf(new->fd);
-	if(IS_DEBUG_OSPF(zebra, ZEBRA_INTERFACE)) {
-		zlog_debug("%s: starting with OSPF send buffer size %u", __func__, new->maxsndbuflen);
-	}
-	if((new->ibuf = stream_new(OSPF_MAX_PACKET_SIZE + 1)) == NULL) {
-		zlog_err("ospf_new: fatal error: stream_new(%u) failed allocating ibuf", OSPF_MAX_PACKET_SIZE + 1);
-		exit(1);
-	}
-	new->t_read = thread_add_read(master, ospf_read, new, new->fd);
-	new->oi_write_q = list_new();
+	ospf_sock_start();
 
 	return new;
 }
@@ -244,6 +295,39 @@ struct ospf *ospf_lookup() {
 	return listgetdata((struct listnode *) listhead(om->ospf));
 }
 
+struct ospf *ospf_lookup_instance(u_short instance) {
+	struct ospf *ospf;
+	struct listnode *node;
+
+	for(ALL_LIST_ELEMENTS_RO(om->ospf, node, ospf)) {
+		if(ospf->instance == instance) {
+			return ospf;
+		}
+	}
+
+	return NULL;
+}
+
+/* The instance running OSPF on an interface; an interface belongs
+   to one instance at most. */
+struct ospf *ospf_if_instance(struct interface *ifp) {
+	struct route_node *rn;
+	struct ospf_interface *oi;
+
+	if(listcount(om->ospf) <= 1) {
+		return ospf_lookup();
+	}
+
+	for(rn = route_top(IF_OIFS(ifp)); rn; rn = route_next(rn)) {
+		if((oi = rn->info) != NULL) {
+			route_unlock_node(rn);
+			return oi->ospf;
+		}
+	}
+
+	return NULL;
+}
+
 static int ospf_is_ready(struct ospf *ospf) {
 	/* OSPF must be on and Router-ID must be configured. */
 	if(!ospf || ospf->router_id.s_addr == 0) {
@@ -254,7 +338,7 @@ static int ospf_is_ready(struct ospf *ospf) {
 }
 
 static void ospf_add(struct ospf *ospf) {
-	listnode_add(om->ospf, ospf);
+	listnode_add_sort(om->ospf, ospf);
 }
 
 static void ospf_delete(struct ospf *ospf) {
@@ -266,7 +350,18 @@ struct ospf *ospf_get() {
 
 	ospf = ospf_lookup();
 	if(ospf == NULL) {
-		ospf = ospf_new();
+		ospf = ospf_get_instance(0);
+	}
+
+	return ospf;
+}
+
+struct ospf *ospf_get_instance(u_short instance) {
+	struct ospf *ospf;
+
+	ospf = ospf_lookup_instance(instance);
+	if(ospf == NULL) {
+		ospf = ospf_new(instance);
 		ospf_add(ospf);
 
 		if(ospf->router_id_static.s_addr == 0) {
@@ -325,6 +420,12 @@ static void ospf_deferred_shutdown_check(struct ospf *ospf) {
 		return;
 	}
 
+	/* To restart gracefully, neighbors are to see no change at all. */
+	if(ospf_gr_shutdown(ospf)) {
+		ospf_deferred_shutdown_finish(ospf);
+		return;
+	}
+
 	/* Should we try push out max-metric LSAs? */
 	if(ospf->stub_router_shutdown_time != OSPF_STUB_ROUTER_UNCONFIGURED) {
 		for(ALL_LIST_ELEMENTS_RO(ospf->areas, ln, area)) {
@@ -399,11 +500,14 @@ static void ospf_finish_final(struct ospf *ospf) {
 	/* be nice if this worked, but it doesn't */
 	/*ospf_flush_self_originated_lsas_now (ospf);*/
 
-	/* Unregister redistribution */
-	for(i = 0; i < ZEBRA_ROUTE_MAX; i++) {
-		ospf_redistribute_unset(ospf, i);
+	/* Unregister redistribution, unless restarting gracefully with the
+	   AS-external-LSAs left as they are. */
+	if(!OSPF_GR_RESTARTING_P(ospf)) {
+		for(i = 0; i < ZEBRA_ROUTE_MAX; i++) {
+			ospf_redistribute_unset(ospf, i);
+		}
+		ospf_redistribute_default_unset(ospf);
 	}
-	ospf_redistribute_default_unset(ospf);
 
 	for(ALL_LIST_ELEMENTS(ospf->areas, node, nnode, area)) {
 		ospf_remove_vls_through_area(ospf, area);
@@ -460,19 +564,19 @@ static void ospf_finish_final(struct ospf *ospf) {
 	/* Cancel all timers. */
 	OSPF_TIMER_OFF(ospf->t_external_lsa);
 	OSPF_TIMER_OFF(ospf->t_spf_calc);
+	OSPF_TIMER_OFF(ospf->t_spf_holddown);
+	OSPF_TIMER_OFF(ospf->t_spf_learn);
 	OSPF_TIMER_OFF(ospf->t_ase_calc);
 	OSPF_TIMER_OFF(ospf->t_maxage);
 	OSPF_TIMER_OFF(ospf->t_maxage_walker);
 	OSPF_TIMER_OFF(ospf->t_abr_task);
 	OSPF_TIMER_OFF(ospf->t_asbr_check);
 	OSPF_TIMER_OFF(ospf->t_distribute_update);
+	OSPF_TIMER_OFF(ospf->t_redistribute_update);
 	OSPF_TIMER_OFF(ospf->t_lsa_refresher);
-	OSPF_TIMER_OFF(ospf->t_read);
-	OSPF_TIMER_OFF(ospf->t_write);
 	OSPF_TIMER_OFF(ospf->t_opaque_lsa_self);
-
-	close(ospf->fd);
-	stream_free(ospf->ibuf);
+	ospf_external_pending_finish(ospf);
+	ospf_gr_finish(ospf);
 
 	LSDB_LOOP(OPAQUE_AS_LSDB(ospf), rn, lsa)
 	ospf_discard_from_db(ospf, ospf->lsdb, lsa);
@@ -520,7 +624,8 @@ static void ospf_finish_final(struct ospf *ospf) {
 
 	list_delete(ospf->areas);
 
-	for(i = ZEBRA_ROUTE_SYSTEM; i <= ZEBRA_ROUTE_MAX; i++) {
+	/* Redistributed routes are shared by the instances. */
+	for(i = ZEBRA_ROUTE_SYSTEM; i <= ZEBRA_ROUTE_MAX && listcount(om->ospf) == 1; i++) {
 		if(EXTERNAL_INFO(i) != NULL) {
 			for(rn = route_top(EXTERNAL_INFO(i)); rn; rn = route_next(rn)) {
 				if(rn->info == NULL) {
@@ -538,6 +643,7 @@ static void ospf_finish_final(struct ospf *ospf) {
 	route_table_finish(ospf->distance_table);
 
 	ospf_delete(ospf);
+	ospf_sock_stop();
 
 	XFREE(MTYPE_OSPF_TOP, ospf);
 }
@@ -579,6 +685,9 @@ static void ospf_area_free(struct ospf_area *area) {
 	struct route_node *rn;
 	struct ospf_lsa *lsa;
 
+	/* The kept shortest-path tree holds locks on the LSAs. */
+	ospf_spf_free(area);
+
 	/* Free LSDBs. */
 	LSDB_LOOP(ROUTER_LSDB(area), rn, lsa)
 	ospf_discard_from_db(area->ospf, area->lsdb, lsa);
@@ -721,7 +830,7 @@ static void update_redistributed(struct ospf *ospf, int add_to_ospf) {
 	struct route_node *rn;
 	struct external_info *ei;
 
-	if(ospf_is_type_redistributed(ZEBRA_ROUTE_CONNECT)) {
+	if(ospf_is_type_redistributed(ospf, ZEBRA_ROUTE_CONNECT)) {
 		if(EXTERNAL_INFO(ZEBRA_ROUTE_CONNECT)) {
 			for(rn = route_top(EXTERNAL_INFO(ZEBRA_ROUTE_CONNECT)); rn; rn = route_next(rn)) {
 				if((ei = rn->info) != NULL) {
@@ -891,6 +1000,7 @@ static void ospf_update_interface_area(struct connected *co, struct ospf_area *a
  *   a matching network configured.
  */
 static void ospf_network_run_subnet(struct ospf *ospf, struct connected *co, struct prefix *p, struct ospf_area *given_area) {
+	struct ospf *owner;
 	struct ospf_interface *oi;
 	struct ospf_if_params *params;
 	struct ospf_area *area = NULL;
@@ -905,6 +1015,12 @@ static void ospf_network_run_subnet(struct ospf *ospf, struct connected *co, str
 		return;
 	}
 
+	/* Received packets are demultiplexed by interface, so an interface
+	   runs a single instance: leave it to the one that got it first. */
+	if((owner = ospf_if_instance(co->ifp)) != NULL && owner != ospf) {
+		return;
+	}
+
 	/* Try determine the appropriate area for this interface + address
    * Start by checking interface config 
    */
@@ -912,7 +1028,11 @@ static void ospf_network_run_subnet(struct ospf *ospf, struct connected *co, str
 		params = IF_DEF_PARAMS(co->ifp);
 	}
 
+	/* "ip ospf area" configures the first instance. */
 	if(OSPF_IF_PARAM_CONFIGURED(params, if_area)) {
+		if(ospf != ospf_lookup()) {
+			return;
+		}
 		area = (ospf_area_get(ospf, params->if_area, OSPF_AREA_ID_FORMAT_ADDRESS));
 	}
 
@@ -1007,6 +1127,7 @@ void ospf_ls_upd_queue_empty(struct ospf_interface *oi) {
 			rn->info = NULL;
 		}
 	}
+	oi->ls_upd_count = 0;
 
 	/* remove update event */
 	if(oi->t_ls_upd_event) {
@@ -1015,9 +1136,23 @@ void ospf_ls_upd_queue_empty(struct ospf_interface *oi) {
 	}
 }
 
+static int ospf_redistribute_update_timer(struct thread *thread) {
+	struct ospf *ospf = THREAD_ARG(thread);
+
+	ospf->t_redistribute_update = NULL;
+	update_redistributed(ospf, 1);
+	return 0;
+}
+
 void ospf_if_update(struct ospf *ospf, struct interface *ifp) {
+	struct listnode *node;
+
+	/* An interface event concerns every instance. */
 	if(!ospf) {
-		ospf = ospf_lookup();
+		for(ALL_LIST_ELEMENTS_RO(om->ospf, node, ospf)) {
+			ospf_if_update(ospf, ifp);
+		}
+		return;
 	}
 
 	/* OSPF must be ready. */
@@ -1027,8 +1162,11 @@ void ospf_if_update(struct ospf *ospf, struct interface *ifp) {
 
 	ospf_network_run_interface(ospf, ifp, NULL, NULL);
 
-	/* Update connected redistribute. */
-	update_redistributed(ospf, 1);
+	/* Update connected redistribute, which walks all of it, once for a
+	 * burst of interface updates rather than for each. */
+	if(!ospf->t_redistribute_update) {
+		ospf->t_redistribute_update = thread_add_timer_msec(master, ospf_redistribute_update_timer, ospf, OSPF_REDISTRIBUTE_UPDATE_DELAY);
+	}
 }
 
 void ospf_remove_vls_through_area(struct ospf *ospf, struct ospf_area *area) {
@@ -1649,6 +1787,10 @@ void ospf_master_init() {
 
 	om = &ospf_master;
 	om->ospf = list_new();
+	om->ospf->cmp = (int (*)(void *, void *)) ospf_instance_cmp;
+	om->fd = -1;
+	om->oi_write_q = list_new();
+	om->if_read_q = list_new();
 	om->master = thread_master_create();
 	om->start_time = quagga_time(NULL);
 }
@@ -44,6 +44,10 @@
 
 #define OSPF_NSSA_TRANS_STABLE_DEFAULT 40
 
+/* Milliseconds interface updates are gathered for before connected
+ * redistribution is checked again. */
+#define OSPF_REDISTRIBUTE_UPDATE_DELAY 100
+
 #define OSPF_ALLSPFROUTERS 0xe0000005 /* 224.0.0.5 */
 #define OSPF_ALLDROUTERS 0xe0000006   /* 224.0.0.6 */
 
@@ -77,6 +81,11 @@
 #define OSPF_LS_REFRESH_SHIFT (60 * 15)
 #define OSPF_LS_REFRESH_JITTER 60
 
+/* Packets taken off the socket at once, see ospf_read(). */
+#define OSPF_READ_BATCH 16
+/* And put on it at once off an interface's queue, see ospf_write(). */
+#define OSPF_WRITE_BATCH 16
+
 /* OSPF master for system wide configuration and variables. */
 struct ospf_master {
 	/* OSPF instance. */
@@ -95,6 +104,25 @@ struct ospf_master {
 	/* OSPF start time. */
 	time_t start_time;
 
+	/* Area SPF threads, -t/--spf_threads */
+	unsigned int spf_threads;
+
+	/* Graceful restart checkpoint, -r/--gr_file */
+	const char *gr_file;
+
+	/* Raw socket shared by all instances, opened with the first one. */
+	int fd;
+	unsigned int maxsndbuflen;
+	struct stream *ibuf[OSPF_READ_BATCH];
+	struct thread *t_read;
+	struct thread *t_write;
+	struct list *oi_write_q;
+	struct thread *t_filter;
+
+	/* Interfaces with received packets yet to be processed. */
+	struct list *if_read_q;
+	struct thread *t_read_event;
+
 	/* Various OSPF global configuration. */
 	u_char options;
 #define OSPF_MASTER_SHUTDOWN (1 << 0) /* deferred-shutdown */
@@ -102,6 +130,9 @@ struct ospf_master {
 
 /* OSPF instance structure. */
 struct ospf {
+	/* Process ID from "router ospf <1-65535>", 0 for the plain form. */
+	u_short instance;
+
 	/* OSPF Router ID. */
 	struct in_addr router_id;	 /* Configured automatically. */
 	struct in_addr router_id_static; /* Configured manually. */
@@ -123,6 +154,11 @@ struct ospf {
 	/* NSSA ABR */
 	u_char anyNSSA; /* Bump for every NSSA attached. */
 
+	/* The ABR task is to be run in full after the next SPF, rather than
+	   for the routes it changed */
+	u_char abr_resync;
+	u_char abr_bb_connection; /* ospf_act_bb_connection() then */
+
 	/* Configured variables. */
 	u_char config;
 #define OSPF_RFC1583_COMPATIBLE (1 << 0)
@@ -144,6 +180,13 @@ struct ospf {
 
 #define OSPF_STUB_MAX_METRIC_SUMMARY_COST 0x00ff0000
 
+	/* RFC3623 graceful restart, see ospf_gr.c */
+	u_char gr_enable;
+	u_char gr_helper_disable;
+	u_int16_t gr_period; /* seconds */
+	u_char gr_state;
+	struct ospf_gr *gr; /* checkpoint restarted from, NULL if none */
+
 	/* LSA timers */
 	unsigned int min_ls_interval; /* minimum delay between LSAs (in msec) */
 	unsigned int min_ls_arrival;  /* minimum interarrival time between LSAs (in msec) */
@@ -154,6 +197,19 @@ struct ospf {
 	unsigned int spf_max_holdtime;	  /* SPF maximum-holdtime */
 	unsigned int spf_hold_multiplier; /* Adaptive multiplier for hold time */
 
+	/* RFC 8405 SPF back-off, used instead of the above if configured */
+	u_char spf_backoff;
+	u_char spf_backoff_state;
+#define OSPF_SPF_BACKOFF_QUIET 0
+#define OSPF_SPF_BACKOFF_SHORT_WAIT 1
+#define OSPF_SPF_BACKOFF_LONG_WAIT 2
+	unsigned int spf_initial_delay;	/* msec */
+	unsigned int spf_short_delay;	/* msec */
+	unsigned int spf_long_delay;	/* msec */
+	unsigned int spf_holddown;	/* msec */
+	unsigned int spf_time_to_learn; /* msec */
+	u_int32_t spf_reason;		/* Why the SPF due was scheduled, bits. */
+
 	int default_originate; /* Default information originate. */
 #define DEFAULT_ORIGINATE_NONE 0
 #define DEFAULT_ORIGINATE_ZEBRA 1
@@ -174,6 +230,7 @@ struct ospf {
 	/* Flags. */
 	int external_origin; /* AS-external-LSA origin flag. */
 	int ase_calc;	     /* ASE calculation flag. */
+	u_int32_t ase_fwd_count; /* External LSAs with a forwarding address. */
 
 	struct list *opaque_lsa_self; /* Type-11 Opaque-LSAs */
 
@@ -196,14 +253,19 @@ struct ospf {
 
 	struct route_table *maxage_lsa; /* List of MaxAge LSA for deletion. */
 	int redistribute;		/* Num of redistributed protocols. */
+	u_char redist[ZEBRA_ROUTE_MAX + 1]; /* Which of them, and default. */
 
 	/* Threads. */
 	struct thread *t_abr_task;	    /* ABR task timer. */
 	struct thread *t_asbr_check;	    /* ASBR check timer. */
 	struct thread *t_distribute_update; /* Distirbute list update timer. */
+	struct thread *t_redistribute_update; /* Connected redistribute update. */
 	struct thread *t_spf_calc;	    /* SPF calculation timer. */
+	struct thread *t_spf_holddown;	    /* SPF back-off quiet again. */
+	struct thread *t_spf_learn;	    /* SPF back-off long wait. */
 	struct thread *t_ase_calc;	    /* ASE calculation timer. */
 	struct thread *t_external_lsa;	    /* AS-external-LSA origin timer. */
+	struct thread *t_external_pending;  /* Pending AS-external-LSA pacing. */
 	struct thread *t_opaque_lsa_self;   /* Type-11 Opaque-LSAs origin event. */
 
 	unsigned int maxage_delay;	/* Delay on Maxage remover timer, sec */
@@ -211,13 +273,8 @@ struct ospf {
 	struct thread *t_maxage_walker; /* MaxAge LSA checking timer. */
 
 	struct thread *t_deferred_shutdown; /* deferred/stub-router shutdown timer*/
-
-	struct thread *t_write;
-	struct thread *t_read;
-	int fd;
-	unsigned int maxsndbuflen;
-	struct stream *ibuf;
-	struct list *oi_write_q;
+	struct thread *t_gr_restart;	    /* grace period of a restart */
+	struct thread *t_gr_sweep;	    /* routes to zebra once it's over */
 
 	/* Distribute lists out of other route sources. */
 	struct {
@@ -251,10 +308,18 @@ struct ospf {
 
 #define OSPF_LSA_REFRESHER_GRANULARITY 10
 #define OSPF_LSA_REFRESHER_SLOTS ((OSPF_LS_REFRESH_TIME + OSPF_LS_REFRESH_SHIFT) / 10 + 1)
+/* slots in one refresh period, over which the LSAs are spread */
+#define OSPF_LSA_REFRESHER_WINDOW (OSPF_LS_REFRESH_TIME / OSPF_LSA_REFRESHER_GRANULARITY)
+/* LSAs any slot may take before registering looks for a quieter one */
+#define OSPF_LSA_REFRESHER_SLOT_MIN 8
 
 	struct {
 		u_int16_t index;
 		struct list *qs[OSPF_LSA_REFRESHER_SLOTS];
+		unsigned long count;	/* LSAs in all slots */
+		unsigned long refreshed; /* by the walker */
+		unsigned long spread;	/* put in another slot than their own */
+		unsigned long deferred; /* left over by a walk to the next */
 	} lsa_refresh_queue;
 
 	struct thread *t_lsa_refresher;
@@ -262,6 +327,15 @@ struct ospf {
 #define OSPF_LSA_REFRESH_INTERVAL_DEFAULT 10
 	u_int16_t lsa_refresh_interval;
 
+	/* Redistributed prefixes whose AS-external-LSA is yet to be
+	 * originated, refreshed or flushed, and how many per second. */
+	struct route_table *external_pending;
+	unsigned long external_pending_count;
+	unsigned long external_pending_coalesced;
+#define OSPF_EXTERNAL_LSA_RATE_DEFAULT 1000
+#define OSPF_EXTERNAL_PENDING_INTERVAL 100 /* msec */
+	unsigned int external_lsa_rate;
+
 	/* Distance parameter. */
 	u_char distance_all;
 	u_char distance_intra;
@@ -277,6 +351,23 @@ struct ospf {
 	struct route_table *distance_table;
 };
 
+/* An SPF calculation, in the log of the last few kept per area. */
+#define OSPF_SPF_LOG_SIZE 16
+struct ospf_spf_log {
+	struct timeval ts; /* When it started. */
+	u_int32_t reason;  /* Why it was scheduled, bits. */
+	u_char incremental;
+
+	/* Time it took, usecs: the area itself, then the whole calculation. */
+	u_int32_t spf;
+	u_int32_t ia;
+	u_int32_t ase;
+	u_int32_t install;
+};
+
+/* SPF durations counted by the order of magnitude, from under 1ms on. */
+#define OSPF_SPF_HISTOGRAM_SIZE 5
+
 /* OSPF area structure. */
 struct ospf_area {
 	/* OSPF instance. */
@@ -331,6 +422,10 @@ struct ospf_area {
 #define OSPF_AREA_IS_STUB_ROUTED (1 << 1)	 /* stub-router active */
 #define OSPF_AREA_WAS_START_STUB_ROUTED (1 << 2) /* startup SR was done */
 
+	/* Transit capability and stub routing at the last ABR task, see
+	   ospf_abr_spf_update() */
+	u_char abr_state;
+
 	/* Area related LSDBs[Type1-4]. */
 	struct ospf_lsdb *lsdb;
 
@@ -375,6 +470,11 @@ struct ospf_area {
 
 	/* Shortest Path Tree. */
 	struct vertex *spf;
+	struct hash *spf_vertices;	  /* by LSA type and ID */
+	struct spf_pool *spf_pool;	  /* they are allocated from */
+	struct spf_if_state *spf_ifs; /* as of the last SPF */
+	unsigned int spf_ifs_count;
+	struct ospf_spf_job *spf_job; /* the calculation under way */
 
 	/* Threads. */
 	struct thread *t_stub_router;	  /* Stub-router timer */
@@ -382,6 +482,10 @@ struct ospf_area {
 
 	/* Statistics field. */
 	u_int32_t spf_calculation; /* SPF Calculation Count. */
+	u_int32_t spf_incremental; /* Of which done incrementally. */
+	struct ospf_spf_log spf_log[OSPF_SPF_LOG_SIZE];
+	unsigned int spf_log_next;
+	u_int32_t spf_histogram[OSPF_SPF_HISTOGRAM_SIZE];
 
 	/* Time stamps. */
 	struct timeval ts_spf; /* SPF calculation time stamp. */
@@ -490,7 +594,10 @@ extern int ospf_zlog;
 /* Prototypes. */
 extern const char *ospf_redist_string(u_int route_type);
 extern struct ospf *ospf_lookup(void);
+extern struct ospf *ospf_lookup_instance(u_short);
 extern struct ospf *ospf_get(void);
+extern struct ospf *ospf_get_instance(u_short);
+extern struct ospf *ospf_if_instance(struct interface *);
 extern void ospf_finish(struct ospf *);
 extern void ospf_router_id_update(struct ospf *ospf);
 extern int ospf_network_set(struct ospf *, struct prefix_ipv4 *, struct in_addr);
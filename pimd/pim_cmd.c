@@ -51,6 +51,7 @@
 #include "pim_macro.h"
 #include "pim_ssmpingd.h"
 #include "pim_zebra.h"
+#include "pim_zlookup.h"
 #include "pim_static.h"
 
 static struct cmd_node pim_global_node = {
@@ -792,7 +793,6 @@ static void pim_show_neighbors_secondary(struct vty *vty) {
 }
 
 static void pim_show_upstream(struct vty *vty) {
-	struct listnode *upnode;
 	struct pim_upstream *up;
 	time_t now;
 
@@ -800,7 +800,7 @@ static void pim_show_upstream(struct vty *vty) {
 
 	vty_out(vty, "Source          Group           State Uptime   JoinTimer RefCnt%s", VTY_NEWLINE);
 
-	for(ALL_LIST_ELEMENTS_RO(qpim_upstream_list, upnode, up)) {
+	TAILQ_FOREACH(up, &qpim_upstream_list, entry) {
 		char src_str[100];
 		char grp_str[100];
 		char uptime[10];
@@ -809,7 +809,11 @@ static void pim_show_upstream(struct vty *vty) {
 		pim_inet4_dump("<src?>", up->source_addr, src_str, sizeof(src_str));
 		pim_inet4_dump("<grp?>", up->group_addr, grp_str, sizeof(grp_str));
 		pim_time_uptime(uptime, sizeof(uptime), now - up->state_transition);
-		pim_time_timer_to_hhmmss(join_timer, sizeof(join_timer), up->t_join_timer);
+		if(up->jp_agg) {
+			pim_time_uptime(join_timer, sizeof(join_timer), pim_upstream_join_timer_remain_msec(up) / 1000);
+		} else {
+			snprintf(join_timer, sizeof(join_timer), "--:--:--");
+		}
 
 		vty_out(vty, "%-15s %-15s %-5s %-8s %-9s %6d%s", src_str, grp_str, up->join_state == PIM_UPSTREAM_JOINED ? "Jnd" : "NtJnd", uptime, join_timer, up->ref_count, VTY_NEWLINE);
 	}
@@ -847,12 +851,11 @@ static void pim_show_join_desired(struct vty *vty) {
 }
 
 static void pim_show_upstream_rpf(struct vty *vty) {
-	struct listnode *upnode;
 	struct pim_upstream *up;
 
 	vty_out(vty, "Source          Group           RpfIface RibNextHop      RpfAddress     %s", VTY_NEWLINE);
 
-	for(ALL_LIST_ELEMENTS_RO(qpim_upstream_list, upnode, up)) {
+	TAILQ_FOREACH(up, &qpim_upstream_list, entry) {
 		char src_str[100];
 		char grp_str[100];
 		char rpf_nexthop_str[100];
@@ -905,7 +908,6 @@ static void show_scan_oil_stats(struct vty *vty, time_t now) {
 }
 
 static void pim_show_rpf(struct vty *vty) {
-	struct listnode *up_node;
 	struct pim_upstream *up;
 	time_t now = pim_time_monotonic_sec();
 
@@ -915,7 +917,7 @@ static void pim_show_rpf(struct vty *vty) {
 
 	vty_out(vty, "Source          Group           RpfIface RpfAddress      RibNextHop      Metric Pref%s", VTY_NEWLINE);
 
-	for(ALL_LIST_ELEMENTS_RO(qpim_upstream_list, up_node, up)) {
+	TAILQ_FOREACH(up, &qpim_upstream_list, entry) {
 		char src_str[100];
 		char grp_str[100];
 		char rpf_addr_str[100];
@@ -1292,10 +1294,9 @@ DEFUN(clear_ip_igmp_interfaces, clear_ip_igmp_interfaces_cmd, "clear ip igmp int
 }
 
 static void mroute_add_all() {
-	struct listnode *node;
 	struct channel_oil *c_oil;
 
-	for(ALL_LIST_ELEMENTS_RO(qpim_channel_oil_list, node, c_oil)) {
+	TAILQ_FOREACH(c_oil, &qpim_channel_oil_list, entry) {
 		if(pim_mroute_add(&c_oil->oil)) {
 			/* just log warning */
 			char source_str[100];
@@ -1308,10 +1309,9 @@ static void mroute_add_all() {
 }
 
 static void mroute_del_all() {
-	struct listnode *node;
 	struct channel_oil *c_oil;
 
-	for(ALL_LIST_ELEMENTS_RO(qpim_channel_oil_list, node, c_oil)) {
+	TAILQ_FOREACH(c_oil, &qpim_channel_oil_list, entry) {
 		if(pim_mroute_del(&c_oil->oil)) {
 			/* just log warning */
 			char source_str[100];
@@ -1564,6 +1564,8 @@ static void show_multicast_interfaces(struct vty *vty) {
 
 DEFUN(show_ip_multicast, show_ip_multicast_cmd, "show ip multicast", SHOW_STR IP_STR "Multicast global information\n") {
 	time_t now = pim_time_monotonic_sec();
+	unsigned long cache_count;
+	int64_t cache_hits, cache_misses;
 
 	if(PIM_MROUTE_IS_ENABLED) {
 		char uptime[10];
@@ -1576,6 +1578,10 @@ DEFUN(show_ip_multicast, show_ip_multicast_cmd, "show ip multicast", SHOW_STR IP
 		vty_out(vty, "Multicast disabled%s", VTY_NEWLINE);
 	}
 
+	vty_out(vty, "%s", VTY_NEWLINE);
+	vty_out(vty, "Kernel upcalls: %lld deduped=%lld dropped=%lld%s", (long long) qpim_mroute_upcall_events, (long long) qpim_mroute_upcall_deduped, (long long) qpim_mroute_upcall_dropped, VTY_NEWLINE);
+	vty_out(vty, "MFC updates: pending=%d coalesced=%lld%s", pim_mroute_mfc_pending(), (long long) qpim_mroute_mfc_coalesced, VTY_NEWLINE);
+
 	vty_out(vty, "%s", VTY_NEWLINE);
 	vty_out(vty, "Zclient update socket: ");
 	if(qpim_zclient_update) {
@@ -1589,6 +1595,8 @@ DEFUN(show_ip_multicast, show_ip_multicast_cmd, "show ip multicast", SHOW_STR IP
 	} else {
 		vty_out(vty, "<null zclient>%s", VTY_NEWLINE);
 	}
+	zclient_lookup_cache_stats(&cache_count, &cache_hits, &cache_misses);
+	vty_out(vty, "Zclient lookup cache: entries=%lu hits=%lld misses=%lld%s", cache_count, (long long) cache_hits, (long long) cache_misses, VTY_NEWLINE);
 
 	vty_out(vty, "%s", VTY_NEWLINE);
 	vty_out(vty, "Current highest VifIndex: %d%s", qpim_mroute_oif_highest_vif_index, VTY_NEWLINE);
@@ -1624,7 +1632,7 @@ static void show_mroute(struct vty *vty) {
 	now = pim_time_monotonic_sec();
 
 	/* print list of PIM and IGMP routes */
-	for(ALL_LIST_ELEMENTS_RO(qpim_channel_oil_list, node, c_oil)) {
+	TAILQ_FOREACH(c_oil, &qpim_channel_oil_list, entry) {
 		char group_str[100];
 		char source_str[100];
 		int oif_vif_index;
@@ -1712,7 +1720,7 @@ static void show_mroute_count(struct vty *vty) {
 	vty_out(vty, "Source          Group           Packets      Bytes WrongIf  %s", VTY_NEWLINE);
 
 	/* Print PIM and IGMP route counts */
-	for(ALL_LIST_ELEMENTS_RO(qpim_channel_oil_list, node, c_oil)) {
+	TAILQ_FOREACH(c_oil, &qpim_channel_oil_list, entry) {
 		char group_str[100];
 		char source_str[100];
 		struct sioc_sg_req sgreq;
@@ -26,6 +26,7 @@
 #include "vty.h"
 #include "memory.h"
 #include "prefix.h"
+#include "hash.h"
 
 #include "pimd.h"
 #include "pim_iface.h"
@@ -36,6 +37,7 @@
 #include "pim_pim.h"
 #include "pim_neighbor.h"
 #include "pim_ifchannel.h"
+#include "pim_join.h"
 #include "pim_sock.h"
 #include "pim_time.h"
 #include "pim_ssmpingd.h"
@@ -59,6 +61,14 @@ static void *if_list_clean(struct pim_interface *pim_ifp) {
 		list_delete(pim_ifp->pim_ifchannel_list);
 	}
 
+	if(pim_ifp->pim_ifchannel_hash) {
+		hash_free(pim_ifp->pim_ifchannel_hash);
+	}
+
+	if(pim_ifp->pim_jp_agg_list) {
+		list_delete(pim_ifp->pim_jp_agg_list);
+	}
+
 	XFREE(MTYPE_PIM_INTERFACE, pim_ifp);
 
 	return 0;
@@ -107,6 +117,8 @@ struct pim_interface *pim_if_new(struct interface *ifp, int igmp, int pim) {
 	pim_ifp->igmp_socket_list = 0;
 	pim_ifp->pim_neighbor_list = 0;
 	pim_ifp->pim_ifchannel_list = 0;
+	pim_ifp->pim_ifchannel_hash = 0;
+	pim_ifp->pim_jp_agg_list = 0;
 	pim_ifp->pim_generation_id = 0;
 
 	/* list of struct igmp_sock */
@@ -132,6 +144,14 @@ struct pim_interface *pim_if_new(struct interface *ifp, int igmp, int pim) {
 		return if_list_clean(pim_ifp);
 	}
 	pim_ifp->pim_ifchannel_list->del = (void (*)(void *)) pim_ifchannel_free;
+	pim_ifp->pim_ifchannel_hash = hash_create_open(pim_ifchannel_hash_key, pim_ifchannel_hash_cmp);
+
+	/* list of struct pim_jp_agg */
+	pim_ifp->pim_jp_agg_list = list_new();
+	if(!pim_ifp->pim_jp_agg_list) {
+		zlog_err("%s %s: failure: pim_jp_agg_list=list_new()", __FILE__, __PRETTY_FUNCTION__);
+		return if_list_clean(pim_ifp);
+	}
 
 	ifp->info = pim_ifp;
 
@@ -174,6 +194,9 @@ void pim_if_delete(struct interface *ifp) {
 	list_delete(pim_ifp->igmp_socket_list);
 	list_delete(pim_ifp->pim_neighbor_list);
 	list_delete(pim_ifp->pim_ifchannel_list);
+	hash_free(pim_ifp->pim_ifchannel_hash);
+	pim_jp_agg_delete_all(ifp);
+	list_delete(pim_ifp->pim_jp_agg_list);
 
 	XFREE(MTYPE_PIM_INTERFACE, pim_ifp);
 
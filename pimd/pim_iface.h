@@ -78,6 +78,8 @@ struct pim_interface {
 	uint16_t pim_override_interval_msec; /* config */
 	struct list *pim_neighbor_list;	     /* list of struct pim_neighbor */
 	struct list *pim_ifchannel_list;     /* list of struct pim_ifchannel */
+	struct hash *pim_ifchannel_hash;     /* struct pim_ifchannel by (S,G) */
+	struct list *pim_jp_agg_list;	     /* list of struct pim_jp_agg */
 
 	/* neighbors without lan_delay */
 	int pim_number_of_nonlandelay_neighbors;
@@ -25,6 +25,8 @@
 #include "linklist.h"
 #include "thread.h"
 #include "memory.h"
+#include "hash.h"
+#include "jhash.h"
 
 #include "pimd.h"
 #include "pim_str.h"
@@ -38,6 +40,19 @@
 #include "pim_rpf.h"
 #include "pim_macro.h"
 
+unsigned int pim_ifchannel_hash_key(void *arg) {
+	struct pim_ifchannel *ch = arg;
+
+	return jhash_2words(ch->source_addr.s_addr, ch->group_addr.s_addr, 0);
+}
+
+int pim_ifchannel_hash_cmp(const void *arg1, const void *arg2) {
+	const struct pim_ifchannel *ch1 = arg1;
+	const struct pim_ifchannel *ch2 = arg2;
+
+	return (ch1->source_addr.s_addr == ch2->source_addr.s_addr) && (ch1->group_addr.s_addr == ch2->group_addr.s_addr);
+}
+
 void pim_ifchannel_free(struct pim_ifchannel *ch) {
 	zassert(!ch->t_ifjoin_expiry_timer);
 	zassert(!ch->t_ifjoin_prune_pending_timer);
@@ -63,11 +78,12 @@ void pim_ifchannel_delete(struct pim_ifchannel *ch) {
 	THREAD_OFF(ch->t_ifassert_timer);
 
 	/*
-    notice that listnode_delete() can't be moved
+    notice that list_delete_node() can't be moved
     into pim_ifchannel_free() because the later is
     called by list_delete_all_node()
   */
-	listnode_delete(pim_ifp->pim_ifchannel_list, ch);
+	hash_release(pim_ifp->pim_ifchannel_hash, ch);
+	list_delete_node(pim_ifp->pim_ifchannel_list, ch->node);
 
 	pim_ifchannel_free(ch);
 }
@@ -208,18 +224,37 @@ static struct pim_ifchannel *pim_ifchannel_new(struct interface *ifp, struct in_
 		PIM_IF_FLAG_UNSET_ASSERT_TRACKING_DESIRED(ch->flags);
 	}
 
-	/* Attach to list */
+	/* Attach to list and index */
 	listnode_add(pim_ifp->pim_ifchannel_list, ch);
+	ch->node = listtail(pim_ifp->pim_ifchannel_list);
+	hash_get(pim_ifp->pim_ifchannel_hash, ch, hash_alloc_intern);
 
 	zassert(IFCHANNEL_NOINFO(ch));
 
 	return ch;
 }
 
+/*
+  Like pim_ifchannel_find(), but quiet on interfaces without multicast,
+  for callers that probe every interface for an (S,G).
+*/
+struct pim_ifchannel *pim_ifchannel_lookup(struct interface *ifp, struct in_addr source_addr, struct in_addr group_addr) {
+	struct pim_interface *pim_ifp;
+	struct pim_ifchannel key;
+
+	pim_ifp = ifp->info;
+	if(!pim_ifp) {
+		return 0;
+	}
+
+	key.source_addr = source_addr;
+	key.group_addr = group_addr;
+
+	return hash_lookup(pim_ifp->pim_ifchannel_hash, &key);
+}
+
 struct pim_ifchannel *pim_ifchannel_find(struct interface *ifp, struct in_addr source_addr, struct in_addr group_addr) {
 	struct pim_interface *pim_ifp;
-	struct listnode *ch_node;
-	struct pim_ifchannel *ch;
 
 	zassert(ifp);
 
@@ -234,13 +269,7 @@ struct pim_ifchannel *pim_ifchannel_find(struct interface *ifp, struct in_addr s
 		return 0;
 	}
 
-	for(ALL_LIST_ELEMENTS_RO(pim_ifp->pim_ifchannel_list, ch_node, ch)) {
-		if((source_addr.s_addr == ch->source_addr.s_addr) && (group_addr.s_addr == ch->group_addr.s_addr)) {
-			return ch;
-		}
-	}
-
-	return 0;
+	return pim_ifchannel_lookup(ifp, source_addr, group_addr);
 }
 
 static void ifmembership_set(struct pim_ifchannel *ch, enum pim_ifmembership membership) {
@@ -630,7 +659,122 @@ void pim_ifchannel_prune(struct interface *ifp, struct in_addr upstream, struct
 	}
 }
 
+/*
+  Local membership changes made while a batch is open, i.e. while an
+  IGMPv3 report is processed, are held here and applied when it
+  closes. An (S,G) a report touches several times (TO_EX then BLOCK,
+  say) then costs a single ifchannel and upstream update, with its
+  final membership.
+*/
+struct membership_change {
+	struct interface *ifp;
+	struct in_addr source_addr;
+	struct in_addr group_addr;
+	unsigned int seq;
+	int include;
+};
+
+static struct {
+	int depth;
+	struct membership_change *change;
+	int count;
+	int size;
+	unsigned int seq;
+} membership_batch;
+
+static void membership_add(struct interface *ifp, struct in_addr source_addr, struct in_addr group_addr);
+static void membership_del(struct interface *ifp, struct in_addr source_addr, struct in_addr group_addr);
+
+static void membership_batch_queue(struct interface *ifp, struct in_addr source_addr, struct in_addr group_addr, int include) {
+	struct membership_change *mc;
+
+	if(membership_batch.count == membership_batch.size) {
+		membership_batch.size = membership_batch.size ? 2 * membership_batch.size : 64;
+		membership_batch.change = XREALLOC(MTYPE_TMP, membership_batch.change, membership_batch.size * sizeof(*membership_batch.change));
+	}
+
+	mc = &membership_batch.change[membership_batch.count++];
+	mc->ifp = ifp;
+	mc->source_addr = source_addr;
+	mc->group_addr = group_addr;
+	mc->seq = membership_batch.seq++;
+	mc->include = include;
+}
+
+/* (I,G,S) in queueing order */
+static int membership_change_cmp(const void *arg1, const void *arg2) {
+	const struct membership_change *mc1 = arg1;
+	const struct membership_change *mc2 = arg2;
+
+	if(mc1->ifp->ifindex != mc2->ifp->ifindex) {
+		return mc1->ifp->ifindex < mc2->ifp->ifindex ? -1 : 1;
+	}
+	if(mc1->group_addr.s_addr != mc2->group_addr.s_addr) {
+		return ntohl(mc1->group_addr.s_addr) < ntohl(mc2->group_addr.s_addr) ? -1 : 1;
+	}
+	if(mc1->source_addr.s_addr != mc2->source_addr.s_addr) {
+		return ntohl(mc1->source_addr.s_addr) < ntohl(mc2->source_addr.s_addr) ? -1 : 1;
+	}
+	return mc1->seq < mc2->seq ? -1 : (mc1->seq > mc2->seq);
+}
+
+void pim_ifchannel_membership_batch_begin(void) {
+	++membership_batch.depth;
+}
+
+void pim_ifchannel_membership_batch_end(void) {
+	struct membership_change *mc = membership_batch.change;
+	int count = membership_batch.count;
+	int i;
+
+	zassert(membership_batch.depth > 0);
+
+	if(--membership_batch.depth) {
+		return;
+	}
+
+	membership_batch.count = 0;
+	membership_batch.seq = 0;
+
+	if(count < 1) {
+		return;
+	}
+
+	qsort(mc, count, sizeof(*mc), membership_change_cmp);
+
+	for(i = 0; i < count; ++i) {
+		/* only the last change to an (S,G) on an interface counts */
+		if((i + 1 < count) && (mc[i].ifp == mc[i + 1].ifp) && (mc[i].group_addr.s_addr == mc[i + 1].group_addr.s_addr) && (mc[i].source_addr.s_addr == mc[i + 1].source_addr.s_addr)) {
+			continue;
+		}
+
+		if(mc[i].include) {
+			membership_add(mc[i].ifp, mc[i].source_addr, mc[i].group_addr);
+		} else {
+			membership_del(mc[i].ifp, mc[i].source_addr, mc[i].group_addr);
+		}
+	}
+}
+
 void pim_ifchannel_local_membership_add(struct interface *ifp, struct in_addr source_addr, struct in_addr group_addr) {
+	if(membership_batch.depth) {
+		membership_batch_queue(ifp, source_addr, group_addr, 1);
+		return;
+	}
+
+	membership_add(ifp, source_addr, group_addr);
+}
+
+void pim_ifchannel_local_membership_del(struct interface *ifp, struct in_addr source_addr, struct in_addr group_addr) {
+	if(membership_batch.depth) {
+		membership_batch_queue(ifp, source_addr, group_addr, 0);
+		return;
+	}
+
+	membership_del(ifp, source_addr, group_addr);
+}
+
+static void membership_add(struct interface *ifp, struct in_addr source_addr, struct in_addr group_addr) {
 	struct pim_ifchannel *ch;
 	struct pim_interface *pim_ifp;
 
@@ -653,7 +797,7 @@ void pim_ifchannel_local_membership_add(struct interface *ifp, struct in_addr so
 	zassert(!IFCHANNEL_NOINFO(ch));
 }
 
-void pim_ifchannel_local_membership_del(struct interface *ifp, struct in_addr source_addr, struct in_addr group_addr) {
+static void membership_del(struct interface *ifp, struct in_addr source_addr, struct in_addr group_addr) {
 	struct pim_ifchannel *ch;
 	struct pim_interface *pim_ifp;
 
@@ -96,18 +96,26 @@ struct pim_ifchannel {
 
 	/* Upstream (S,G) state */
 	struct pim_upstream *upstream;
+
+	struct listnode *node; /* in pim_ifp->pim_ifchannel_list */
 };
 
+unsigned int pim_ifchannel_hash_key(void *arg);
+int pim_ifchannel_hash_cmp(const void *arg1, const void *arg2);
+
 void pim_ifchannel_free(struct pim_ifchannel *ch);
 void pim_ifchannel_delete(struct pim_ifchannel *ch);
 void pim_ifchannel_membership_clear(struct interface *ifp);
 void pim_ifchannel_delete_on_noinfo(struct interface *ifp);
+struct pim_ifchannel *pim_ifchannel_lookup(struct interface *ifp, struct in_addr source_addr, struct in_addr group_addr);
 struct pim_ifchannel *pim_ifchannel_find(struct interface *ifp, struct in_addr source_addr, struct in_addr group_addr);
 struct pim_ifchannel *pim_ifchannel_add(struct interface *ifp, struct in_addr source_addr, struct in_addr group_addr);
 void pim_ifchannel_join_add(struct interface *ifp, struct in_addr neigh_addr, struct in_addr upstream, struct in_addr source_addr, struct in_addr group_addr, uint8_t source_flags, uint16_t holdtime);
 void pim_ifchannel_prune(struct interface *ifp, struct in_addr upstream, struct in_addr source_addr, struct in_addr group_addr, uint8_t source_flags, uint16_t holdtime);
 void pim_ifchannel_local_membership_add(struct interface *ifp, struct in_addr source_addr, struct in_addr group_addr);
 void pim_ifchannel_local_membership_del(struct interface *ifp, struct in_addr source_addr, struct in_addr group_addr);
+void pim_ifchannel_membership_batch_begin(void);
+void pim_ifchannel_membership_batch_end(void);
 
 void pim_ifchannel_ifjoin_switch(const char *caller, struct pim_ifchannel *ch, enum pim_ifjoin_state new_state);
 const char *pim_ifchannel_ifjoin_name(enum pim_ifjoin_state ifjoin_state);
@@ -23,6 +23,8 @@
 #include <zebra.h>
 
 #include "memory.h"
+#include "hash.h"
+#include "jhash.h"
 
 #include "pimd.h"
 #include "pim_igmp.h"
@@ -34,6 +36,7 @@
 #include "pim_util.h"
 #include "pim_time.h"
 #include "pim_zebra.h"
+#include "pim_ifchannel.h"
 
 #define IGMP_GRP_REC_TYPE_MODE_IS_INCLUDE (1)
 #define IGMP_GRP_REC_TYPE_MODE_IS_EXCLUDE (2)
@@ -44,7 +47,32 @@
 
 static void group_timer_off(struct igmp_group *group);
 
-static struct igmp_group *find_group_by_addr(struct igmp_sock *igmp, struct in_addr group_addr);
+static unsigned int igmp_group_hash_key(void *arg) {
+	struct igmp_group *group = arg;
+
+	return jhash_1word(group->group_addr.s_addr, 0);
+}
+
+static int igmp_group_hash_cmp(const void *arg1, const void *arg2) {
+	const struct igmp_group *g1 = arg1;
+	const struct igmp_group *g2 = arg2;
+
+	return g1->group_addr.s_addr == g2->group_addr.s_addr;
+}
+
+/* group pointers are unique within the socket, like group addresses */
+static unsigned int igmp_source_hash_key(void *arg) {
+	struct igmp_source *src = arg;
+
+	return jhash_2words(src->source_group->group_addr.s_addr, src->source_addr.s_addr, 0);
+}
+
+static int igmp_source_hash_cmp(const void *arg1, const void *arg2) {
+	const struct igmp_source *s1 = arg1;
+	const struct igmp_source *s2 = arg2;
+
+	return (s1->source_group == s2->source_group) && (s1->source_addr.s_addr == s2->source_addr.s_addr);
+}
 
 static int igmp_sock_open(struct in_addr ifaddr, ifindex_t ifindex, uint32_t pim_options) {
 	int fd;
@@ -366,7 +394,7 @@ static int recv_igmp_query(struct igmp_sock *igmp, int query_version, int max_re
 
 			/* this is a non-general query: perform timer updates */
 
-			group = find_group_by_addr(igmp, group_addr);
+			group = igmp_find_group_by_addr(igmp, group_addr);
 			if(group) {
 				int recv_num_sources = ntohs(*(uint16_t *) (igmp_msg + IGMP_V3_NUMSOURCES_OFFSET));
 
@@ -671,7 +699,17 @@ int pim_igmp_packet(struct igmp_sock *igmp, char *buf, size_t len) {
 				return recv_igmp_query(igmp, query_version, max_resp_code, ip_hdr->ip_src, from_str, igmp_msg, igmp_msg_len);
 			}
 
-		case PIM_IGMP_V3_MEMBERSHIP_REPORT: return igmp_v3_report(igmp, ip_hdr->ip_src, from_str, igmp_msg, igmp_msg_len);
+		case PIM_IGMP_V3_MEMBERSHIP_REPORT:
+			{
+				int result;
+
+				/* one (S,G) membership update per channel the report touches */
+				pim_ifchannel_membership_batch_begin();
+				result = igmp_v3_report(igmp, ip_hdr->ip_src, from_str, igmp_msg, igmp_msg_len);
+				pim_ifchannel_membership_batch_end();
+
+				return result;
+			}
 
 		case PIM_IGMP_V2_MEMBERSHIP_REPORT: return igmp_v2_report(igmp, ip_hdr->ip_src, from_str, igmp_msg, igmp_msg_len);
 
@@ -959,7 +997,8 @@ static void igmp_group_delete(struct igmp_group *group) {
 	}
 
 	group_timer_off(group);
-	listnode_delete(group->group_igmp_sock->igmp_group_list, group);
+	hash_release(group->group_igmp_sock->igmp_group_hash, group);
+	list_delete_node(group->group_igmp_sock->igmp_group_list, group->group_node);
 	igmp_group_free(group);
 }
 
@@ -978,6 +1017,8 @@ void igmp_sock_free(struct igmp_sock *igmp) {
 	zassert(!listcount(igmp->igmp_group_list));
 
 	list_free(igmp->igmp_group_list);
+	hash_free(igmp->igmp_group_hash);
+	hash_free(igmp->igmp_source_hash);
 
 	XFREE(MTYPE_PIM_IGMP_SOCKET, igmp);
 }
@@ -1023,6 +1064,8 @@ static struct igmp_sock *igmp_sock_new(int fd, struct in_addr ifaddr, struct int
 		return 0;
 	}
 	igmp->igmp_group_list->del = (void (*)(void *)) igmp_group_free;
+	igmp->igmp_group_hash = hash_create_open(igmp_group_hash_key, igmp_group_hash_cmp);
+	igmp->igmp_source_hash = hash_create_open(igmp_source_hash_key, igmp_source_hash_cmp);
 
 	igmp->fd = fd;
 	igmp->interface = ifp;
@@ -1164,23 +1207,18 @@ void igmp_group_timer_on(struct igmp_group *group, long interval_msec, const cha
 	THREAD_TIMER_MSEC_ON(master, group->t_group_timer, igmp_group_timer, group, interval_msec);
 }
 
-static struct igmp_group *find_group_by_addr(struct igmp_sock *igmp, struct in_addr group_addr) {
-	struct igmp_group *group;
-	struct listnode *node;
+struct igmp_group *igmp_find_group_by_addr(struct igmp_sock *igmp, struct in_addr group_addr) {
+	struct igmp_group key;
 
-	for(ALL_LIST_ELEMENTS_RO(igmp->igmp_group_list, node, group)) {
-		if(group_addr.s_addr == group->group_addr.s_addr) {
-			return group;
-		}
-	}
+	key.group_addr = group_addr;
 
-	return 0;
+	return hash_lookup(igmp->igmp_group_hash, &key);
 }
 
 struct igmp_group *igmp_add_group_by_addr(struct igmp_sock *igmp, struct in_addr group_addr) {
 	struct igmp_group *group;
 
-	group = find_group_by_addr(igmp, group_addr);
+	group = igmp_find_group_by_addr(igmp, group_addr);
 	if(group) {
 		return group;
 	}
@@ -1225,6 +1263,8 @@ struct igmp_group *igmp_add_group_by_addr(struct igmp_sock *igmp, struct in_addr
 	group->group_filtermode_isexcl = 0; /* 0=INCLUDE, 1=EXCLUDE */
 
 	listnode_add(igmp->igmp_group_list, group);
+	group->group_node = listtail(igmp->igmp_group_list);
+	hash_get(igmp->igmp_group_hash, group, hash_alloc_intern);
 
 	if(PIM_DEBUG_IGMP_TRACE) {
 		char group_str[100];
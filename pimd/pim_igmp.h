@@ -87,6 +87,8 @@ struct igmp_sock {
 	int startup_query_count;
 
 	struct list *igmp_group_list; /* list of struct igmp_group */
+	struct hash *igmp_group_hash;  /* struct igmp_group by group address */
+	struct hash *igmp_source_hash; /* struct igmp_source by (group, source) */
 };
 
 struct igmp_sock *pim_igmp_sock_lookup_ifaddr(struct list *igmp_sock_list, struct in_addr ifaddr);
@@ -127,6 +129,8 @@ struct igmp_source {
     RFC 3376: 6.6.3.2. Building and Sending Group and Source Specific Queries
   */
 	int source_query_retransmit_count;
+
+	struct listnode *source_node; /* in source_group->group_source_list */
 };
 
 struct igmp_group {
@@ -155,8 +159,11 @@ struct igmp_group {
 	struct igmp_sock *group_igmp_sock; /* back pointer */
 	int64_t last_igmp_v1_report_dsec;
 	int64_t last_igmp_v2_report_dsec;
+
+	struct listnode *group_node; /* in group_igmp_sock->igmp_group_list */
 };
 
+struct igmp_group *igmp_find_group_by_addr(struct igmp_sock *igmp, struct in_addr group_addr);
 struct igmp_group *igmp_add_group_by_addr(struct igmp_sock *igmp, struct in_addr group_addr);
 
 void igmp_group_delete_empty_include(struct igmp_group *group);
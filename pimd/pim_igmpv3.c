@@ -23,6 +23,7 @@
 #include <zebra.h>
 #include "log.h"
 #include "memory.h"
+#include "hash.h"
 
 #include "pimd.h"
 #include "pim_iface.h"
@@ -367,11 +368,12 @@ void igmp_source_delete(struct igmp_source *source) {
 	source_channel_oil_detach(source);
 
 	/*
-    notice that listnode_delete() can't be moved
+    notice that list_delete_node() can't be moved
     into igmp_source_free() because the later is
     called by list_delete_all_node()
   */
-	listnode_delete(group->group_source_list, source);
+	hash_release(group->group_igmp_sock->igmp_source_hash, source);
+	list_delete_node(group->group_source_list, source->source_node);
 
 	igmp_source_free(source);
 
@@ -405,16 +407,12 @@ void igmp_source_delete_expired(struct list *source_list) {
 }
 
 struct igmp_source *igmp_find_source_by_addr(struct igmp_group *group, struct in_addr src_addr) {
-	struct listnode *src_node;
-	struct igmp_source *src;
+	struct igmp_source key;
 
-	for(ALL_LIST_ELEMENTS_RO(group->group_source_list, src_node, src)) {
-		if(src_addr.s_addr == src->source_addr.s_addr) {
-			return src;
-		}
-	}
+	key.source_group = group;
+	key.source_addr = src_addr;
 
-	return 0;
+	return hash_lookup(group->group_igmp_sock->igmp_source_hash, &key);
 }
 
 struct igmp_source *source_new(struct igmp_group *group, struct in_addr src_addr) {
@@ -443,6 +441,8 @@ struct igmp_source *source_new(struct igmp_group *group, struct in_addr src_addr
 	src->source_channel_oil = NULL;
 
 	listnode_add(group->group_source_list, src);
+	src->source_node = listtail(group->group_source_list);
+	hash_get(group->group_igmp_sock->igmp_source_hash, src, hash_alloc_intern);
 
 	zassert(!src->t_source_timer); /* source timer == 0 */
 
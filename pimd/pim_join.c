@@ -24,6 +24,9 @@
 
 #include "log.h"
 #include "prefix.h"
+#include "memory.h"
+#include "thread.h"
+#include "linklist.h"
 
 #include "pimd.h"
 #include "pim_str.h"
@@ -34,6 +37,8 @@
 #include "pim_iface.h"
 #include "pim_hello.h"
 #include "pim_ifchannel.h"
+#include "pim_upstream.h"
+#include "pim_time.h"
 
 static void on_trace(const char *label, struct interface *ifp, struct in_addr src) {
 	if(PIM_DEBUG_PIM_TRACE) {
@@ -229,46 +234,188 @@ int pim_joinprune_recv(struct interface *ifp, struct pim_neighbor *neigh, struct
 	return 0;
 }
 
-int pim_joinprune_send(struct interface *ifp, struct in_addr upstream_addr, struct in_addr source_addr, struct in_addr group_addr, int send_join) {
-	struct pim_interface *pim_ifp;
-	uint8_t pim_msg[1000];
-	const uint8_t *pastend = pim_msg + sizeof(pim_msg);
-	uint8_t *pim_msg_curr = pim_msg + PIM_MSG_HEADER_LEN; /* room for pim header */
-	int pim_msg_size;
-	int remain;
+/*
+  Join/Prune aggregation
 
-	zassert(ifp);
+  Join/Prunes toward the same upstream neighbor, RPF'(S,G) on an
+  interface, share one struct pim_jp_agg.  Triggered Join/Prunes are
+  queued on it and sent together on the next flush, packed into as few
+  messages as the interface MTU allows (RFC 7761 4.9.5 allows many
+  groups, and many sources per group, in one message).
+
+  The periodic Joins of all upstreams joined toward the neighbor are
+  sent by one t_periodic timer on the aggregate, instead of one Join
+  Timer per (S,G).
+*/
+
+#define PIM_JP_GROUP_LEN (12) /* encoded group + number of joined/pruned sources */
+#define PIM_JP_SOURCE_LEN (8) /* encoded source */
+
+struct pim_jp_entry {
+	struct in_addr source_addr;
+	struct in_addr group_addr;
+	unsigned int seq; /* queueing order */
+	int join;
+};
+
+static int on_jp_agg_flush(struct thread *t);
+
+static struct pim_jp_agg *jp_agg_find(struct pim_interface *pim_ifp, struct in_addr rpf_addr) {
+	struct listnode *node;
+	struct pim_jp_agg *agg;
+
+	for(ALL_LIST_ELEMENTS_RO(pim_ifp->pim_jp_agg_list, node, agg)) {
+		if(agg->rpf_addr.s_addr == rpf_addr.s_addr) {
+			return agg;
+		}
+	}
+
+	return 0;
+}
+
+static struct pim_jp_agg *jp_agg_get(struct interface *ifp, struct in_addr rpf_addr) {
+	struct pim_interface *pim_ifp;
+	struct pim_jp_agg *agg;
 
 	pim_ifp = ifp->info;
+	zassert(pim_ifp);
 
-	if(!pim_ifp) {
-		zlog_warn("%s: multicast not enabled on interface %s", __PRETTY_FUNCTION__, ifp->name);
-		return -1;
+	agg = jp_agg_find(pim_ifp, rpf_addr);
+	if(agg) {
+		return agg;
 	}
 
-	if(PIM_DEBUG_PIM_TRACE) {
-		char source_str[100];
-		char group_str[100];
-		char dst_str[100];
-		pim_inet4_dump("<src?>", source_addr, source_str, sizeof(source_str));
-		pim_inet4_dump("<grp?>", group_addr, group_str, sizeof(group_str));
-		pim_inet4_dump("<dst?>", upstream_addr, dst_str, sizeof(dst_str));
-		zlog_debug("%s: sending %s(S,G)=(%s,%s) to upstream=%s on interface %s", __PRETTY_FUNCTION__, send_join ? "Join" : "Prune", source_str, group_str, dst_str, ifp->name);
+	agg = XCALLOC(MTYPE_PIM_JP_AGG, sizeof(*agg));
+	agg->interface = ifp;
+	agg->rpf_addr = rpf_addr;
+	agg->upstream_list = list_new();
+
+	listnode_add(pim_ifp->pim_jp_agg_list, agg);
+	agg->node = listtail(pim_ifp->pim_jp_agg_list);
+
+	return agg;
+}
+
+static void jp_agg_free(struct pim_jp_agg *agg) {
+	struct pim_interface *pim_ifp;
+	struct listnode *node;
+	struct pim_upstream *up;
+
+	pim_ifp = agg->interface->info;
+
+	THREAD_OFF(agg->t_periodic);
+	THREAD_OFF(agg->t_flush);
+
+	for(ALL_LIST_ELEMENTS_RO(agg->upstream_list, node, up)) {
+		up->jp_agg = 0;
+		up->jp_node = 0;
 	}
+	list_delete(agg->upstream_list);
 
-	if(PIM_INADDR_IS_ANY(upstream_addr)) {
-		if(PIM_DEBUG_PIM_TRACE) {
-			char source_str[100];
-			char group_str[100];
-			char dst_str[100];
-			pim_inet4_dump("<src?>", source_addr, source_str, sizeof(source_str));
-			pim_inet4_dump("<grp?>", group_addr, group_str, sizeof(group_str));
-			pim_inet4_dump("<dst?>", upstream_addr, dst_str, sizeof(dst_str));
-			zlog_debug("%s: %s(S,G)=(%s,%s): upstream=%s is myself on interface %s", __PRETTY_FUNCTION__, send_join ? "Join" : "Prune", source_str, group_str, dst_str, ifp->name);
+	list_delete_node(pim_ifp->pim_jp_agg_list, agg->node);
+
+	XFREE(MTYPE_PIM_JP_AGG, agg->pending);
+	XFREE(MTYPE_PIM_JP_AGG, agg);
+}
+
+/* free the aggregate once nothing is joined through it nor queued on it */
+static void jp_agg_release(struct pim_jp_agg *agg) {
+	if(!listcount(agg->upstream_list) && !agg->pending_count && !agg->t_flush) {
+		jp_agg_free(agg);
+	}
+}
+
+static void jp_agg_queue(struct pim_jp_agg *agg, struct in_addr source_addr, struct in_addr group_addr, int join) {
+	struct pim_jp_entry *e;
+
+	if(agg->pending_count == agg->pending_size) {
+		agg->pending_size = agg->pending_size ? 2 * agg->pending_size : 16;
+		agg->pending = XREALLOC(MTYPE_PIM_JP_AGG, agg->pending, agg->pending_size * sizeof(*agg->pending));
+	}
+
+	e = &agg->pending[agg->pending_count++];
+	e->source_addr = source_addr;
+	e->group_addr = group_addr;
+	e->seq = agg->pending_seq++;
+	e->join = join;
+}
+
+/* flush the queue within delay_msec, keeping an earlier flush if armed */
+static void jp_agg_schedule(struct pim_jp_agg *agg, long delay_msec) {
+	if(agg->t_flush) {
+		struct timeval remain = thread_timer_remain(agg->t_flush);
+
+		if(remain.tv_sec * 1000 + remain.tv_usec / 1000 <= delay_msec) {
+			return;
 		}
-		return 0;
+		THREAD_OFF(agg->t_flush);
 	}
 
+	THREAD_TIMER_MSEC_ON(master, agg->t_flush, on_jp_agg_flush, agg, delay_msec);
+}
+
+/* (G,S) in queueing order */
+static int jp_entry_cmp_sg(const void *arg1, const void *arg2) {
+	const struct pim_jp_entry *e1 = arg1;
+	const struct pim_jp_entry *e2 = arg2;
+
+	if(e1->group_addr.s_addr != e2->group_addr.s_addr) {
+		return ntohl(e1->group_addr.s_addr) < ntohl(e2->group_addr.s_addr) ? -1 : 1;
+	}
+	if(e1->source_addr.s_addr != e2->source_addr.s_addr) {
+		return ntohl(e1->source_addr.s_addr) < ntohl(e2->source_addr.s_addr) ? -1 : 1;
+	}
+	return e1->seq < e2->seq ? -1 : (e1->seq > e2->seq);
+}
+
+/* per group, joined sources before pruned ones */
+static int jp_entry_cmp_msg(const void *arg1, const void *arg2) {
+	const struct pim_jp_entry *e1 = arg1;
+	const struct pim_jp_entry *e2 = arg2;
+
+	if(e1->group_addr.s_addr != e2->group_addr.s_addr) {
+		return ntohl(e1->group_addr.s_addr) < ntohl(e2->group_addr.s_addr) ? -1 : 1;
+	}
+	if(e1->join != e2->join) {
+		return e1->join ? -1 : 1;
+	}
+	return ntohl(e1->source_addr.s_addr) < ntohl(e2->source_addr.s_addr) ? -1 : (ntohl(e1->source_addr.s_addr) > ntohl(e2->source_addr.s_addr));
+}
+
+static void jp_agg_send(struct pim_jp_agg *agg) {
+	struct interface *ifp = agg->interface;
+	struct pim_interface *pim_ifp = ifp->info;
+	struct pim_jp_entry *e = agg->pending;
+	uint8_t pim_msg[PIM_PIM_BUFSIZE_WRITE];
+	const uint8_t *pastend;
+	int max_size;
+	int count;
+	int msg_count;
+	int i;
+
+	if(!agg->pending_count) {
+		return;
+	}
+
+	/* the last Join or Prune queued for an (S,G) wins */
+	qsort(e, agg->pending_count, sizeof(*e), jp_entry_cmp_sg);
+	count = 0;
+	for(i = 0; i < agg->pending_count; ++i) {
+		if((i + 1 < agg->pending_count) && (e[i].group_addr.s_addr == e[i + 1].group_addr.s_addr) && (e[i].source_addr.s_addr == e[i + 1].source_addr.s_addr)) {
+			continue;
+		}
+		e[count++] = e[i];
+	}
+	agg->pending_count = 0;
+
+	qsort(e, count, sizeof(*e), jp_entry_cmp_msg);
+
+	max_size = sizeof(pim_msg);
+	if((ifp->mtu > PIM_IP_HEADER_MAX_LEN) && ((int) ifp->mtu - PIM_IP_HEADER_MAX_LEN < max_size)) {
+		max_size = ifp->mtu - PIM_IP_HEADER_MAX_LEN;
+	}
+	pastend = pim_msg + max_size;
+
 	/*
     RFC 4601: 4.3.1.  Sending Hello Messages
 
@@ -280,77 +427,218 @@ int pim_joinprune_send(struct interface *ifp, struct in_addr upstream_addr, stru
   */
 	pim_hello_require(ifp);
 
-	/*
-    Build PIM message
-  */
+	msg_count = 0;
+	i = 0;
+	while(i < count) {
+		uint8_t *pim_msg_curr = pim_msg + PIM_MSG_HEADER_LEN; /* room for pim header */
+		uint8_t *num_groups;
+		int pim_msg_size;
+
+		pim_msg_curr = pim_msg_addr_encode_ipv4_ucast(pim_msg_curr, pastend - pim_msg_curr, agg->rpf_addr);
+		if(!pim_msg_curr || (pastend - pim_msg_curr < 4 + PIM_JP_GROUP_LEN + PIM_JP_SOURCE_LEN)) {
+			zlog_warn("%s: Join/Prune will not fit: max size=%d on interface %s", __PRETTY_FUNCTION__, max_size, ifp->name);
+			return;
+		}
+
+		*pim_msg_curr = 0; /* reserved */
+		++pim_msg_curr;
+		num_groups = pim_msg_curr;
+		*num_groups = 0;
+		++pim_msg_curr;
+		*((uint16_t *) pim_msg_curr) = htons(PIM_JP_HOLDTIME);
+		++pim_msg_curr;
+		++pim_msg_curr;
+
+		/* groups, the last one cut short if its sources don't all fit */
+		while((i < count) && (*num_groups < 255) && (pastend - pim_msg_curr >= PIM_JP_GROUP_LEN + PIM_JP_SOURCE_LEN)) {
+			struct in_addr group_addr = e[i].group_addr;
+			uint8_t *num_sources;
+			int num_joined = 0;
+			int num_pruned = 0;
+			int fit;
+
+			pim_msg_curr = pim_msg_addr_encode_ipv4_group(pim_msg_curr, pastend - pim_msg_curr, group_addr);
+			num_sources = pim_msg_curr;
+			pim_msg_curr += 4;
+
+			fit = (pastend - pim_msg_curr) / PIM_JP_SOURCE_LEN;
+			while((i < count) && (e[i].group_addr.s_addr == group_addr.s_addr) && (num_joined + num_pruned < fit) && (num_joined + num_pruned < 0xffff)) {
+				pim_msg_curr = pim_msg_addr_encode_ipv4_source(pim_msg_curr, pastend - pim_msg_curr, e[i].source_addr);
+				if(e[i].join) {
+					++num_joined;
+				} else {
+					++num_pruned;
+				}
+				++i;
+			}
+
+			*((uint16_t *) num_sources) = htons(num_joined);
+			*((uint16_t *) (num_sources + 2)) = htons(num_pruned);
+			++*num_groups;
+		}
+
+		/* Add PIM header */
+
+		pim_msg_size = pim_msg_curr - pim_msg;
+
+		pim_msg_build_header(pim_msg, pim_msg_size, PIM_MSG_TYPE_JOIN_PRUNE);
 
-	remain = pastend - pim_msg_curr;
-	pim_msg_curr = pim_msg_addr_encode_ipv4_ucast(pim_msg_curr, remain, upstream_addr);
-	if(!pim_msg_curr) {
+		if(pim_msg_send(pim_ifp->pim_sock_fd, qpim_all_pim_routers_addr, pim_msg, pim_msg_size, ifp->name)) {
+			zlog_warn("%s: could not send PIM message on interface %s", __PRETTY_FUNCTION__, ifp->name);
+		}
+		++msg_count;
+	}
+
+	if(PIM_DEBUG_PIM_TRACE) {
 		char dst_str[100];
-		pim_inet4_dump("<dst?>", upstream_addr, dst_str, sizeof(dst_str));
-		zlog_warn("%s: failure encoding destination address %s: space left=%d", __PRETTY_FUNCTION__, dst_str, remain);
-		return -3;
+		pim_inet4_dump("<dst?>", agg->rpf_addr, dst_str, sizeof(dst_str));
+		zlog_debug("%s: sent %d (S,G) in %d Join/Prune messages to upstream=%s on interface %s", __PRETTY_FUNCTION__, count, msg_count, dst_str, ifp->name);
 	}
+}
 
-	remain = pastend - pim_msg_curr;
-	if(remain < 4) {
-		zlog_warn("%s: group will not fit: space left=%d", __PRETTY_FUNCTION__, remain);
-		return -4;
+static int on_jp_agg_flush(struct thread *t) {
+	struct pim_jp_agg *agg;
+
+	zassert(t);
+	agg = THREAD_ARG(t);
+	zassert(agg);
+
+	agg->t_flush = 0;
+
+	jp_agg_send(agg);
+	jp_agg_release(agg);
+
+	return 0;
+}
+
+static int on_jp_agg_periodic(struct thread *t) {
+	struct pim_jp_agg *agg;
+	struct listnode *node;
+	struct pim_upstream *up;
+	int64_t now;
+
+	zassert(t);
+	agg = THREAD_ARG(t);
+	zassert(agg);
+
+	agg->t_periodic = 0;
+
+	now = pim_time_monotonic_sec();
+
+	for(ALL_LIST_ELEMENTS_RO(agg->upstream_list, node, up)) {
+		/* Join(S,G) suppressed by another router's Join to RPF'(S,G) */
+		if(up->join_suppress_until > now) {
+			continue;
+		}
+
+		jp_agg_queue(agg, up->source_addr, up->group_addr, 1 /* join */);
 	}
 
-	*pim_msg_curr = 0; /* reserved */
-	++pim_msg_curr;
-	*pim_msg_curr = 1; /* number of groups */
-	++pim_msg_curr;
-	*((uint16_t *) pim_msg_curr) = htons(PIM_JP_HOLDTIME);
-	++pim_msg_curr;
-	++pim_msg_curr;
-
-	remain = pastend - pim_msg_curr;
-	pim_msg_curr = pim_msg_addr_encode_ipv4_group(pim_msg_curr, remain, group_addr);
-	if(!pim_msg_curr) {
-		char group_str[100];
-		pim_inet4_dump("<grp?>", group_addr, group_str, sizeof(group_str));
-		zlog_warn("%s: failure encoding group address %s: space left=%d", __PRETTY_FUNCTION__, group_str, remain);
-		return -5;
+	/* anything already queued goes out with the periodic Joins */
+	THREAD_OFF(agg->t_flush);
+	jp_agg_send(agg);
+
+	THREAD_TIMER_ON(master, agg->t_periodic, on_jp_agg_periodic, agg, qpim_t_periodic);
+
+	return 0;
+}
+
+void pim_jp_agg_upstream_add(struct pim_upstream *up) {
+	struct interface *ifp = up->rpf.source_nexthop.interface;
+	struct pim_jp_agg *agg;
+
+	zassert(!up->jp_agg);
+
+	/* no upstream neighbor to refresh */
+	if(!ifp || !ifp->info || PIM_INADDR_IS_ANY(up->rpf.rpf_addr)) {
+		return;
 	}
 
-	remain = pastend - pim_msg_curr;
-	if(remain < 4) {
-		zlog_warn("%s: sources will not fit: space left=%d", __PRETTY_FUNCTION__, remain);
-		return -6;
+	agg = jp_agg_get(ifp, up->rpf.rpf_addr);
+
+	listnode_add(agg->upstream_list, up);
+	up->jp_node = listtail(agg->upstream_list);
+	up->jp_agg = agg;
+
+	THREAD_TIMER_ON(master, agg->t_periodic, on_jp_agg_periodic, agg, qpim_t_periodic);
+}
+
+void pim_jp_agg_upstream_del(struct pim_upstream *up) {
+	struct pim_jp_agg *agg = up->jp_agg;
+
+	if(!agg) {
+		return;
 	}
 
-	/* number of joined sources */
-	*((uint16_t *) pim_msg_curr) = htons(send_join ? 1 : 0);
-	++pim_msg_curr;
-	++pim_msg_curr;
+	list_delete_node(agg->upstream_list, up->jp_node);
+	up->jp_agg = 0;
+	up->jp_node = 0;
 
-	/* number of pruned sources */
-	*((uint16_t *) pim_msg_curr) = htons(send_join ? 0 : 1);
-	++pim_msg_curr;
-	++pim_msg_curr;
+	if(!listcount(agg->upstream_list)) {
+		THREAD_OFF(agg->t_periodic);
+	}
 
-	remain = pastend - pim_msg_curr;
-	pim_msg_curr = pim_msg_addr_encode_ipv4_source(pim_msg_curr, remain, source_addr);
-	if(!pim_msg_curr) {
-		char source_str[100];
-		pim_inet4_dump("<src?>", source_addr, source_str, sizeof(source_str));
-		zlog_warn("%s: failure encoding source address %s: space left=%d", __PRETTY_FUNCTION__, source_str, remain);
-		return -7;
+	jp_agg_release(agg);
+}
+
+void pim_jp_agg_delete_all(struct interface *ifp) {
+	struct pim_interface *pim_ifp = ifp->info;
+	struct listnode *node;
+	struct listnode *nextnode;
+	struct pim_jp_agg *agg;
+
+	for(ALL_LIST_ELEMENTS(pim_ifp->pim_jp_agg_list, node, nextnode, agg)) {
+		jp_agg_free(agg);
 	}
+}
 
-	/* Add PIM header */
+int pim_joinprune_send(struct interface *ifp, struct in_addr upstream_addr, struct in_addr source_addr, struct in_addr group_addr, int send_join) {
+	return pim_joinprune_send_by(ifp, upstream_addr, source_addr, group_addr, send_join, 0);
+}
 
-	pim_msg_size = pim_msg_curr - pim_msg;
+/*
+  Queue Join/Prune(S,G) to upstream_addr, to be sent within delay_msec
+  along with whatever else is queued for that neighbor.
+*/
+int pim_joinprune_send_by(struct interface *ifp, struct in_addr upstream_addr, struct in_addr source_addr, struct in_addr group_addr, int send_join, long delay_msec) {
+	struct pim_interface *pim_ifp;
+	struct pim_jp_agg *agg;
 
-	pim_msg_build_header(pim_msg, pim_msg_size, PIM_MSG_TYPE_JOIN_PRUNE);
+	zassert(ifp);
 
-	if(pim_msg_send(pim_ifp->pim_sock_fd, qpim_all_pim_routers_addr, pim_msg, pim_msg_size, ifp->name)) {
-		zlog_warn("%s: could not send PIM message on interface %s", __PRETTY_FUNCTION__, ifp->name);
-		return -8;
+	pim_ifp = ifp->info;
+
+	if(!pim_ifp) {
+		zlog_warn("%s: multicast not enabled on interface %s", __PRETTY_FUNCTION__, ifp->name);
+		return -1;
 	}
 
+	if(PIM_DEBUG_PIM_TRACE) {
+		char source_str[100];
+		char group_str[100];
+		char dst_str[100];
+		pim_inet4_dump("<src?>", source_addr, source_str, sizeof(source_str));
+		pim_inet4_dump("<grp?>", group_addr, group_str, sizeof(group_str));
+		pim_inet4_dump("<dst?>", upstream_addr, dst_str, sizeof(dst_str));
+		zlog_debug("%s: queueing %s(S,G)=(%s,%s) to upstream=%s on interface %s within %ld msec", __PRETTY_FUNCTION__, send_join ? "Join" : "Prune", source_str, group_str, dst_str, ifp->name, delay_msec);
+	}
+
+	if(PIM_INADDR_IS_ANY(upstream_addr)) {
+		if(PIM_DEBUG_PIM_TRACE) {
+			char source_str[100];
+			char group_str[100];
+			char dst_str[100];
+			pim_inet4_dump("<src?>", source_addr, source_str, sizeof(source_str));
+			pim_inet4_dump("<grp?>", group_addr, group_str, sizeof(group_str));
+			pim_inet4_dump("<dst?>", upstream_addr, dst_str, sizeof(dst_str));
+			zlog_debug("%s: %s(S,G)=(%s,%s): upstream=%s is myself on interface %s", __PRETTY_FUNCTION__, send_join ? "Join" : "Prune", source_str, group_str, dst_str, ifp->name);
+		}
+		return 0;
+	}
+
+	agg = jp_agg_get(ifp, upstream_addr);
+	jp_agg_queue(agg, source_addr, group_addr, send_join);
+	jp_agg_schedule(agg, delay_msec);
+
 	return 0;
 }
@@ -28,9 +28,35 @@
 #include "if.h"
 
 #include "pim_neighbor.h"
+#include "pim_upstream.h"
+
+/*
+  Join/Prune state toward one upstream neighbor, RPF'(S,G) on an
+  interface: the upstreams joined through it, refreshed together by
+  t_periodic, and the queue of triggered Join/Prunes sent by t_flush.
+*/
+struct pim_jp_agg {
+	struct interface *interface;
+	struct in_addr rpf_addr;
+	struct list *upstream_list; /* joined struct pim_upstream */
+	struct thread *t_periodic;
+
+	struct pim_jp_entry *pending; /* queued Join/Prune(S,G) */
+	int pending_count;
+	int pending_size;
+	unsigned int pending_seq;
+	struct thread *t_flush;
+
+	struct listnode *node; /* in pim_ifp->pim_jp_agg_list */
+};
 
 int pim_joinprune_recv(struct interface *ifp, struct pim_neighbor *neigh, struct in_addr src_addr, uint8_t *tlv_buf, int tlv_buf_size);
 
 int pim_joinprune_send(struct interface *ifp, struct in_addr upstream_addr, struct in_addr source_addr, struct in_addr group_addr, int send_join);
+int pim_joinprune_send_by(struct interface *ifp, struct in_addr upstream_addr, struct in_addr source_addr, struct in_addr group_addr, int send_join, long delay_msec);
+
+void pim_jp_agg_upstream_add(struct pim_upstream *up);
+void pim_jp_agg_upstream_del(struct pim_upstream *up);
+void pim_jp_agg_delete_all(struct interface *ifp);
 
 #endif /* PIM_JOIN_H */
@@ -23,6 +23,11 @@
 #include <zebra.h>
 #include "log.h"
 #include "privs.h"
+#include "memory.h"
+#include "linklist.h"
+#include "hash.h"
+#include "jhash.h"
+#include "thread.h"
 
 #include "pimd.h"
 #include "pim_mroute.h"
@@ -35,6 +40,55 @@
 extern struct zebra_privs_t pimd_privs;
 
 static void mroute_read_on(void);
+static void mfc_flush_all(void);
+
+/*
+  MFC updates are not written to the kernel as they are requested.
+  They are queued per (S,G), a later update replacing a pending one,
+  and written from an event in runs of at most PIM_MROUTE_MFC_BATCH,
+  so a burst of OIL changes costs one MFC write per channel and does
+  not hold the thread for the whole burst.
+*/
+struct mfc_update {
+	struct mfcctl mc;
+	int del;
+	struct listnode *node;
+};
+
+static struct hash *mfc_update_hash = 0;   /* struct mfc_update by (S,G) */
+static struct list *mfc_update_list = 0;   /* struct mfc_update in queueing order */
+static struct thread *mfc_update_flusher = 0;
+
+static unsigned int mfc_update_hash_key(void *arg) {
+	const struct mfc_update *upd = arg;
+
+	return jhash_2words(upd->mc.mfcc_origin.s_addr, upd->mc.mfcc_mcastgrp.s_addr, 0);
+}
+
+static int mfc_update_hash_cmp(const void *arg1, const void *arg2) {
+	const struct mfc_update *upd1 = arg1;
+	const struct mfc_update *upd2 = arg2;
+
+	return (upd1->mc.mfcc_origin.s_addr == upd2->mc.mfcc_origin.s_addr) && (upd1->mc.mfcc_mcastgrp.s_addr == upd2->mc.mfcc_mcastgrp.s_addr);
+}
+
+/*
+  Kernel upcalls are rate limited by a token bucket, and an upcall
+  repeating one handled less than PIM_MROUTE_UPCALL_DEDUP_DSEC ago
+  for the same (S,G), vif and type is ignored. During a source storm
+  this keeps the upcall path from starving the rest of pimd.
+*/
+struct upcall_seen {
+	struct in_addr source_addr;
+	struct in_addr group_addr;
+	int64_t dsec;
+	unsigned char msgtype;
+	unsigned char vif;
+};
+
+static struct upcall_seen upcall_seen[PIM_MROUTE_UPCALL_DEDUP_SLOTS];
+static int64_t upcall_tokens = PIM_MROUTE_UPCALL_BURST;
+static int64_t upcall_tokens_dsec = 0;
 
 static int pim_mroute_set(int fd, int enable) {
 	int err;
@@ -162,7 +216,52 @@ int pim_mroute_msg(int fd, const char *buf, int buf_size) {
 	return 0;
 }
 
-static int mroute_read_msg(int fd) {
+/* Return true if the upcall should be handed to pim_mroute_msg() */
+static int mroute_upcall_admit(const char *buf) {
+	const struct ip *ip_hdr = (const struct ip *) buf;
+	const struct igmpmsg *msg;
+	struct upcall_seen *seen;
+	int64_t now;
+
+	/* not a kernel upcall, let pim_mroute_msg() tell */
+	if(ip_hdr->ip_p) {
+		return 1;
+	}
+
+	msg = (const struct igmpmsg *) buf;
+	now = pim_time_monotonic_dsec();
+	++qpim_mroute_upcall_events;
+
+	seen = &upcall_seen[jhash_3words(msg->im_src.s_addr, msg->im_dst.s_addr, (msg->im_msgtype << 8) | msg->im_vif, 0) % PIM_MROUTE_UPCALL_DEDUP_SLOTS];
+	if((seen->dsec > 0) && (now - seen->dsec < PIM_MROUTE_UPCALL_DEDUP_DSEC) && (seen->source_addr.s_addr == msg->im_src.s_addr) && (seen->group_addr.s_addr == msg->im_dst.s_addr) && (seen->msgtype == msg->im_msgtype) &&
+	   (seen->vif == msg->im_vif)) {
+		++qpim_mroute_upcall_deduped;
+		return 0;
+	}
+
+	upcall_tokens += (now - upcall_tokens_dsec) * PIM_MROUTE_UPCALL_RATE / 10;
+	if(upcall_tokens > PIM_MROUTE_UPCALL_BURST) {
+		upcall_tokens = PIM_MROUTE_UPCALL_BURST;
+	}
+	upcall_tokens_dsec = now;
+
+	if(upcall_tokens < 1) {
+		++qpim_mroute_upcall_dropped;
+		return 0;
+	}
+	--upcall_tokens;
+
+	seen->source_addr = msg->im_src;
+	seen->group_addr = msg->im_dst;
+	seen->dsec = now;
+	seen->msgtype = msg->im_msgtype;
+	seen->vif = msg->im_vif;
+
+	return 1;
+}
+
+/* Return 1 after reading a message, 0 if none is pending, <0 on failure */
+static int mroute_read_msg(int fd, int flags) {
 	const int msg_min_size = MAX(sizeof(struct ip), sizeof(struct igmpmsg));
 	char buf[1000];
 	int rd;
@@ -172,8 +271,11 @@ static int mroute_read_msg(int fd) {
 		return -1;
 	}
 
-	rd = read(fd, buf, sizeof(buf));
+	rd = recv(fd, buf, sizeof(buf), flags);
 	if(rd < 0) {
+		if((flags & MSG_DONTWAIT) && ((errno == EAGAIN) || (errno == EWOULDBLOCK))) {
+			return 0;
+		}
 		zlog_warn("%s: failure reading fd=%d: errno=%d: %s", __PRETTY_FUNCTION__, fd, errno, safe_strerror(errno));
 		return -2;
 	}
@@ -183,12 +285,17 @@ static int mroute_read_msg(int fd) {
 		return -3;
 	}
 
-	return pim_mroute_msg(fd, buf, rd);
+	if(mroute_upcall_admit(buf)) {
+		pim_mroute_msg(fd, buf, rd);
+	}
+
+	return 1;
 }
 
 static int mroute_read(struct thread *t) {
 	int fd;
 	int result;
+	int i;
 
 	zassert(t);
 	zassert(!THREAD_ARG(t));
@@ -196,7 +303,11 @@ static int mroute_read(struct thread *t) {
 	fd = THREAD_FD(t);
 	zassert(fd == qpim_mroute_socket_fd);
 
-	result = mroute_read_msg(fd);
+	/* drain a bounded number of upcalls per wakeup */
+	result = mroute_read_msg(fd, 0);
+	for(i = 1; (result > 0) && (i < PIM_MROUTE_READ_BATCH); ++i) {
+		result = mroute_read_msg(fd, MSG_DONTWAIT);
+	}
 
 	/* Keep reading */
 	qpim_mroute_socket_reader = 0;
@@ -246,6 +357,8 @@ int pim_mroute_socket_enable() {
 
 	qpim_mroute_socket_fd = fd;
 	qpim_mroute_socket_creation = pim_time_monotonic_sec();
+	mfc_update_hash = hash_create_open(mfc_update_hash_key, mfc_update_hash_cmp);
+	mfc_update_list = list_new();
 	mroute_read_on();
 
 	zassert(PIM_MROUTE_IS_ENABLED);
@@ -258,6 +371,9 @@ int pim_mroute_socket_disable() {
 		return -1;
 	}
 
+	/* pending MFC deletions must reach the kernel before MRT_DONE */
+	mfc_flush_all();
+
 	if(pim_mroute_set(qpim_mroute_socket_fd, 0)) {
 		zlog_warn("Could not disable mroute on socket fd=%d: errno=%d: %s", qpim_mroute_socket_fd, errno, safe_strerror(errno));
 		return -2;
@@ -271,6 +387,12 @@ int pim_mroute_socket_disable() {
 	mroute_read_off();
 	qpim_mroute_socket_fd = -1;
 
+	THREAD_OFF(mfc_update_flusher);
+	list_delete(mfc_update_list);
+	mfc_update_list = 0;
+	hash_free(mfc_update_hash);
+	mfc_update_hash = 0;
+
 	zassert(PIM_MROUTE_IS_DISABLED);
 
 	return 0;
@@ -327,6 +449,9 @@ int pim_mroute_del_vif(int vif_index) {
 		return -1;
 	}
 
+	/* do not leave the kernel MFC pointing at the vif */
+	mfc_flush_all();
+
 	memset(&vc, 0, sizeof(vc));
 	vc.vifc_vifi = vif_index;
 
@@ -341,46 +466,117 @@ int pim_mroute_del_vif(int vif_index) {
 	return 0;
 }
 
-int pim_mroute_add(struct mfcctl *mc) {
+static int mfc_write(const struct mfcctl *mc, int del) {
 	int err;
 
-	qpim_mroute_add_last = pim_time_monotonic_sec();
-	++qpim_mroute_add_events;
-
-	if(PIM_MROUTE_IS_DISABLED) {
-		zlog_warn("%s: global multicast is disabled", __PRETTY_FUNCTION__);
-		return -1;
+	if(del) {
+		qpim_mroute_del_last = pim_time_monotonic_sec();
+		++qpim_mroute_del_events;
+	} else {
+		qpim_mroute_add_last = pim_time_monotonic_sec();
+		++qpim_mroute_add_events;
 	}
 
-	err = setsockopt(qpim_mroute_socket_fd, IPPROTO_IP, MRT_ADD_MFC, mc, sizeof(*mc));
+	err = setsockopt(qpim_mroute_socket_fd, IPPROTO_IP, del ? MRT_DEL_MFC : MRT_ADD_MFC, mc, sizeof(*mc));
 	if(err) {
+		char source_str[100];
+		char group_str[100];
 		int e = errno;
-		zlog_warn("%s %s: failure: setsockopt(fd=%d,IPPROTO_IP,MRT_ADD_MFC): errno=%d: %s", __FILE__, __PRETTY_FUNCTION__, qpim_mroute_socket_fd, e, safe_strerror(e));
+		pim_inet4_dump("<source?>", mc->mfcc_origin, source_str, sizeof(source_str));
+		pim_inet4_dump("<group?>", mc->mfcc_mcastgrp, group_str, sizeof(group_str));
+		zlog_warn("%s %s: failure: setsockopt(fd=%d,IPPROTO_IP,%s) for (S,G)=(%s,%s): errno=%d: %s", __FILE__, __PRETTY_FUNCTION__, qpim_mroute_socket_fd, del ? "MRT_DEL_MFC" : "MRT_ADD_MFC", source_str, group_str, e, safe_strerror(e));
 		errno = e;
-		return -2;
+		return -1;
 	}
 
 	return 0;
 }
 
-int pim_mroute_del(struct mfcctl *mc) {
-	int err;
+/* Write up to max queued updates, oldest first */
+static void mfc_flush(int max) {
+	struct mfc_update *upd;
 
-	qpim_mroute_del_last = pim_time_monotonic_sec();
-	++qpim_mroute_del_events;
+	while((max-- > 0) && listcount(mfc_update_list)) {
+		upd = listgetdata(listhead(mfc_update_list));
+
+		list_delete_node(mfc_update_list, upd->node);
+		hash_release(mfc_update_hash, upd);
+
+		mfc_write(&upd->mc, upd->del);
+
+		XFREE(MTYPE_PIM_MFC_UPDATE, upd);
+	}
+}
+
+static void mfc_flush_all() {
+	if(!mfc_update_list) {
+		return;
+	}
+
+	THREAD_OFF(mfc_update_flusher);
+	mfc_flush(listcount(mfc_update_list));
+}
+
+static int on_mfc_flush(struct thread *t) {
+	zassert(t);
+	mfc_update_flusher = 0;
+
+	mfc_flush(PIM_MROUTE_MFC_BATCH);
+
+	/* leave room for other threads before the next run */
+	if(listcount(mfc_update_list)) {
+		THREAD_TIMER_MSEC_ON(master, mfc_update_flusher, on_mfc_flush, 0, 0);
+	}
+
+	return 0;
+}
+
+static int mfc_queue(const struct mfcctl *mc, int del) {
+	struct mfc_update lookup;
+	struct mfc_update *upd;
 
 	if(PIM_MROUTE_IS_DISABLED) {
 		zlog_warn("%s: global multicast is disabled", __PRETTY_FUNCTION__);
 		return -1;
 	}
 
-	err = setsockopt(qpim_mroute_socket_fd, IPPROTO_IP, MRT_DEL_MFC, mc, sizeof(*mc));
-	if(err) {
-		int e = errno;
-		zlog_warn("%s %s: failure: setsockopt(fd=%d,IPPROTO_IP,MRT_DEL_MFC): errno=%d: %s", __FILE__, __PRETTY_FUNCTION__, qpim_mroute_socket_fd, e, safe_strerror(e));
-		errno = e;
-		return -2;
+	lookup.mc.mfcc_origin = mc->mfcc_origin;
+	lookup.mc.mfcc_mcastgrp = mc->mfcc_mcastgrp;
+
+	upd = hash_lookup(mfc_update_hash, &lookup);
+	if(upd) {
+		++qpim_mroute_mfc_coalesced;
+	} else {
+		upd = XCALLOC(MTYPE_PIM_MFC_UPDATE, sizeof(*upd));
+		upd->mc.mfcc_origin = mc->mfcc_origin;
+		upd->mc.mfcc_mcastgrp = mc->mfcc_mcastgrp;
+		hash_get(mfc_update_hash, upd, hash_alloc_intern);
+		listnode_add(mfc_update_list, upd);
+		upd->node = listtail(mfc_update_list);
+	}
+
+	upd->mc = *mc;
+	upd->del = del;
+
+	if(!mfc_update_flusher) {
+		THREAD_TIMER_MSEC_ON(master, mfc_update_flusher, on_mfc_flush, 0, 0);
 	}
 
 	return 0;
 }
+
+int pim_mroute_mfc_pending() {
+	return mfc_update_list ? listcount(mfc_update_list) : 0;
+}
+
+/*
+  pim_mroute_add() and pim_mroute_del() queue the update and return
+  at once; kernel failures are logged when the queue is flushed.
+*/
+int pim_mroute_add(struct mfcctl *mc) {
+	return mfc_queue(mc, 0);
+}
+
+int pim_mroute_del(struct mfcctl *mc) {
+	return mfc_queue(mc, 1);
+}
@@ -40,6 +40,13 @@
 
 #define PIM_MROUTE_MIN_TTL (1)
 
+#define PIM_MROUTE_MFC_BATCH (64)	     /* MFC writes per flush run */
+#define PIM_MROUTE_READ_BATCH (32)	     /* upcalls read per socket wakeup */
+#define PIM_MROUTE_UPCALL_RATE (100)	     /* upcalls handled per second */
+#define PIM_MROUTE_UPCALL_BURST (200)	     /* upcalls handled back to back */
+#define PIM_MROUTE_UPCALL_DEDUP_DSEC (10)    /* same (S,G) upcall ignored within */
+#define PIM_MROUTE_UPCALL_DEDUP_SLOTS (1024) /* recent upcalls remembered */
+
 #if defined(HAVE_LINUX_MROUTE_H)
 	#include <linux/mroute.h>
 #else
@@ -170,6 +177,7 @@ int pim_mroute_del_vif(int vif_index);
 
 int pim_mroute_add(struct mfcctl *mc);
 int pim_mroute_del(struct mfcctl *mc);
+int pim_mroute_mfc_pending(void);
 
 int pim_mroute_msg(int fd, const char *buf, int buf_size);
 
@@ -25,23 +25,34 @@
 #include "log.h"
 #include "memory.h"
 #include "linklist.h"
+#include "hash.h"
+#include "jhash.h"
 
 #include "pimd.h"
 #include "pim_oil.h"
 #include "pim_str.h"
 #include "pim_iface.h"
 
+unsigned int pim_channel_oil_hash_key(void *arg) {
+	struct channel_oil *c_oil = arg;
+
+	return jhash_2words(c_oil->oil.mfcc_origin.s_addr, c_oil->oil.mfcc_mcastgrp.s_addr, 0);
+}
+
+int pim_channel_oil_hash_cmp(const void *arg1, const void *arg2) {
+	const struct channel_oil *c1 = arg1;
+	const struct channel_oil *c2 = arg2;
+
+	return (c1->oil.mfcc_origin.s_addr == c2->oil.mfcc_origin.s_addr) && (c1->oil.mfcc_mcastgrp.s_addr == c2->oil.mfcc_mcastgrp.s_addr);
+}
+
 void pim_channel_oil_free(struct channel_oil *c_oil) {
 	XFREE(MTYPE_PIM_CHANNEL_OIL, c_oil);
 }
 
 static void pim_channel_oil_delete(struct channel_oil *c_oil) {
-	/*
-    notice that listnode_delete() can't be moved
-    into pim_channel_oil_free() because the later is
-    called by list_delete_all_node()
-  */
-	listnode_delete(qpim_channel_oil_list, c_oil);
+	hash_release(qpim_channel_oil_hash, c_oil);
+	TAILQ_REMOVE(&qpim_channel_oil_list, c_oil, entry);
 
 	pim_channel_oil_free(c_oil);
 }
@@ -85,22 +96,19 @@ static struct channel_oil *pim_add_channel_oil(struct in_addr group_addr, struct
 		return 0;
 	}
 
-	listnode_add(qpim_channel_oil_list, c_oil);
+	TAILQ_INSERT_TAIL(&qpim_channel_oil_list, c_oil, entry);
+	hash_get(qpim_channel_oil_hash, c_oil, hash_alloc_intern);
 
 	return c_oil;
 }
 
 static struct channel_oil *pim_find_channel_oil(struct in_addr group_addr, struct in_addr source_addr) {
-	struct listnode *node;
-	struct channel_oil *c_oil;
+	struct channel_oil key;
 
-	for(ALL_LIST_ELEMENTS_RO(qpim_channel_oil_list, node, c_oil)) {
-		if((group_addr.s_addr == c_oil->oil.mfcc_mcastgrp.s_addr) && (source_addr.s_addr == c_oil->oil.mfcc_origin.s_addr)) {
-			return c_oil;
-		}
-	}
+	key.oil.mfcc_mcastgrp = group_addr;
+	key.oil.mfcc_origin = source_addr;
 
-	return 0;
+	return hash_lookup(qpim_channel_oil_hash, &key);
 }
 
 struct channel_oil *pim_channel_oil_add(struct in_addr group_addr, struct in_addr source_addr, int input_vif_index) {
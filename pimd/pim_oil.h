@@ -23,6 +23,8 @@
 #ifndef PIM_OIL_H
 #define PIM_OIL_H
 
+#include "queue.h"
+
 #include "pim_mroute.h"
 
 #define PIM_OIF_FLAG_PROTO_IGMP (1 << 0) /* bitmask 1 */
@@ -34,6 +36,9 @@
 
   Each channel_oil.oil is used to control an (S,G) entry in the Kernel
   Multicast Forwarding Cache.
+
+  Lookups go through qpim_channel_oil_hash, the list only keeps
+  creation order for scans and show output.
 */
 
 struct channel_oil {
@@ -42,8 +47,12 @@ struct channel_oil {
 	int oil_ref_count;
 	time_t oif_creation[MAXVIFS];
 	uint32_t oif_flags[MAXVIFS];
+	TAILQ_ENTRY(channel_oil) entry; /* in qpim_channel_oil_list */
 };
 
+unsigned int pim_channel_oil_hash_key(void *arg);
+int pim_channel_oil_hash_cmp(const void *arg1, const void *arg2);
+
 void pim_channel_oil_free(struct channel_oil *c_oil);
 struct channel_oil *pim_channel_oil_add(struct in_addr group_addr, struct in_addr source_addr, int input_vif_index);
 void pim_channel_oil_del(struct channel_oil *c_oil);
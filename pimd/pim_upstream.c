@@ -29,6 +29,8 @@
 #include "memory.h"
 #include "thread.h"
 #include "linklist.h"
+#include "hash.h"
+#include "jhash.h"
 
 #include "pimd.h"
 #include "pim_pim.h"
@@ -45,9 +47,21 @@
 #include "pim_oil.h"
 #include "pim_macro.h"
 
-static void join_timer_start(struct pim_upstream *up);
 static void pim_upstream_update_assert_tracking_desired(struct pim_upstream *up);
 
+unsigned int pim_upstream_hash_key(void *arg) {
+	struct pim_upstream *up = arg;
+
+	return jhash_2words(up->source_addr.s_addr, up->group_addr.s_addr, 0);
+}
+
+int pim_upstream_hash_cmp(const void *arg1, const void *arg2) {
+	const struct pim_upstream *up1 = arg1;
+	const struct pim_upstream *up2 = arg2;
+
+	return (up1->source_addr.s_addr == up2->source_addr.s_addr) && (up1->group_addr.s_addr == up2->group_addr.s_addr);
+}
+
 void pim_upstream_free(struct pim_upstream *up) {
 	XFREE(MTYPE_PIM_UPSTREAM, up);
 }
@@ -60,16 +74,12 @@ static void upstream_channel_oil_detach(struct pim_upstream *up) {
 }
 
 void pim_upstream_delete(struct pim_upstream *up) {
-	THREAD_OFF(up->t_join_timer);
+	pim_jp_agg_upstream_del(up);
 
 	upstream_channel_oil_detach(up);
 
-	/*
-    notice that listnode_delete() can't be moved
-    into pim_upstream_free() because the later is
-    called by list_delete_all_node()
-  */
-	listnode_delete(qpim_upstream_list, up);
+	hash_release(qpim_upstream_hash, up);
+	TAILQ_REMOVE(&qpim_upstream_list, up, entry);
 
 	pim_upstream_free(up);
 }
@@ -94,19 +104,26 @@ static void send_join(struct pim_upstream *up) {
 	pim_joinprune_send(up->rpf.source_nexthop.interface, up->rpf.rpf_addr, up->source_addr, up->group_addr, 1 /* join */);
 }
 
-static int on_join_timer(struct thread *t) {
-	struct pim_upstream *up;
-
-	zassert(t);
-	up = THREAD_ARG(t);
-	zassert(up);
+/*
+  The Join Timer of a joined (S,G) is the periodic timer of its RPF'(S,G)
+  aggregate, see pim_join.c, pushed back by join suppression to the
+  first period past join_suppress_until.
+*/
+long pim_upstream_join_timer_remain_msec(struct pim_upstream *up) {
+	long remain_msec;
+	long suppress_msec;
 
-	send_join(up);
+	if(!up->jp_agg || (qpim_t_periodic < 1)) {
+		return 0;
+	}
 
-	up->t_join_timer = 0;
-	join_timer_start(up);
+	remain_msec = pim_time_timer_remain_msec(up->jp_agg->t_periodic);
+	suppress_msec = 1000 * (up->join_suppress_until - pim_time_monotonic_sec());
+	while(remain_msec < suppress_msec) {
+		remain_msec += 1000 * qpim_t_periodic;
+	}
 
-	return 0;
+	return remain_msec;
 }
 
 static void join_timer_start(struct pim_upstream *up) {
@@ -115,39 +132,30 @@ static void join_timer_start(struct pim_upstream *up) {
 		char grp_str[100];
 		pim_inet4_dump("<src?>", up->source_addr, src_str, sizeof(src_str));
 		pim_inet4_dump("<grp?>", up->group_addr, grp_str, sizeof(grp_str));
-		zlog_debug("%s: starting %d sec timer for upstream (S,G)=(%s,%s)", __PRETTY_FUNCTION__, qpim_t_periodic, src_str, grp_str);
+		zlog_debug("%s: joining upstream (S,G)=(%s,%s) to %d sec periodic Join/Prune", __PRETTY_FUNCTION__, src_str, grp_str, qpim_t_periodic);
 	}
 
-	zassert(!up->t_join_timer);
+	up->join_suppress_until = 0;
+	pim_jp_agg_upstream_add(up);
+}
 
-	THREAD_TIMER_ON(master, up->t_join_timer, on_join_timer, up, qpim_t_periodic);
+static void join_timer_stop(struct pim_upstream *up) {
+	up->join_suppress_until = 0;
+	pim_jp_agg_upstream_del(up);
 }
 
 void pim_upstream_join_timer_restart(struct pim_upstream *up) {
-	THREAD_OFF(up->t_join_timer);
+	join_timer_stop(up);
 	join_timer_start(up);
 }
 
-static void pim_upstream_join_timer_restart_msec(struct pim_upstream *up, int interval_msec) {
-	if(PIM_DEBUG_PIM_EVENTS) {
-		char src_str[100];
-		char grp_str[100];
-		pim_inet4_dump("<src?>", up->source_addr, src_str, sizeof(src_str));
-		pim_inet4_dump("<grp?>", up->group_addr, grp_str, sizeof(grp_str));
-		zlog_debug("%s: restarting %d msec timer for upstream (S,G)=(%s,%s)", __PRETTY_FUNCTION__, interval_msec, src_str, grp_str);
-	}
-
-	THREAD_OFF(up->t_join_timer);
-	THREAD_TIMER_MSEC_ON(master, up->t_join_timer, on_join_timer, up, interval_msec);
-}
-
 void pim_upstream_join_suppress(struct pim_upstream *up, struct in_addr rpf_addr, int holdtime) {
 	long t_joinsuppress_msec;
 	long join_timer_remain_msec;
 
 	t_joinsuppress_msec = MIN(pim_if_t_suppressed_msec(up->rpf.source_nexthop.interface), 1000 * holdtime);
 
-	join_timer_remain_msec = pim_time_timer_remain_msec(up->t_join_timer);
+	join_timer_remain_msec = pim_upstream_join_timer_remain_msec(up);
 
 	if(PIM_DEBUG_PIM_TRACE) {
 		char src_str[100];
@@ -168,7 +176,7 @@ void pim_upstream_join_suppress(struct pim_upstream *up, struct in_addr rpf_addr
 			zlog_debug("%s %s: suppressing Join(S,G)=(%s,%s) for %ld msec", __FILE__, __PRETTY_FUNCTION__, src_str, grp_str, t_joinsuppress_msec);
 		}
 
-		pim_upstream_join_timer_restart_msec(up, t_joinsuppress_msec);
+		up->join_suppress_until = pim_time_monotonic_sec() + (t_joinsuppress_msec + 999) / 1000;
 	}
 }
 
@@ -176,7 +184,7 @@ void pim_upstream_join_timer_decrease_to_t_override(const char *debug_label, str
 	long join_timer_remain_msec;
 	int t_override_msec;
 
-	join_timer_remain_msec = pim_time_timer_remain_msec(up->t_join_timer);
+	join_timer_remain_msec = pim_upstream_join_timer_remain_msec(up);
 	t_override_msec = pim_if_t_override_msec(up->rpf.source_nexthop.interface);
 
 	if(PIM_DEBUG_PIM_TRACE) {
@@ -198,15 +206,14 @@ void pim_upstream_join_timer_decrease_to_t_override(const char *debug_label, str
 			zlog_debug("%s: decreasing (S,G)=(%s,%s) join timer to t_override=%d msec", debug_label, src_str, grp_str, t_override_msec);
 		}
 
-		pim_upstream_join_timer_restart_msec(up, t_override_msec);
+		up->join_suppress_until = 0;
+		pim_joinprune_send_by(up->rpf.source_nexthop.interface, up->rpf.rpf_addr, up->source_addr, up->group_addr, 1 /* join */, t_override_msec);
 	}
 }
 
 static void forward_on(struct pim_upstream *up) {
 	struct listnode *ifnode;
 	struct listnode *ifnextnode;
-	struct listnode *chnode;
-	struct listnode *chnextnode;
 	struct interface *ifp;
 	struct pim_interface *pim_ifp;
 	struct pim_ifchannel *ch;
@@ -218,25 +225,21 @@ static void forward_on(struct pim_upstream *up) {
 			continue;
 		}
 
-		/* scan per-interface (S,G) state */
-		for(ALL_LIST_ELEMENTS(pim_ifp->pim_ifchannel_list, chnode, chnextnode, ch)) {
-			if(ch->upstream != up) {
-				continue;
-			}
-
-			if(pim_macro_chisin_oiflist(ch)) {
-				pim_forward_start(ch);
-			}
+		/* per-interface (S,G) state */
+		ch = pim_ifchannel_lookup(ifp, up->source_addr, up->group_addr);
+		if(!ch) {
+			continue;
+		}
 
-		} /* scan iface channel list */
+		if(pim_macro_chisin_oiflist(ch)) {
+			pim_forward_start(ch);
+		}
 	}	  /* scan iflist */
 }
 
 static void forward_off(struct pim_upstream *up) {
 	struct listnode *ifnode;
 	struct listnode *ifnextnode;
-	struct listnode *chnode;
-	struct listnode *chnextnode;
 	struct interface *ifp;
 	struct pim_interface *pim_ifp;
 	struct pim_ifchannel *ch;
@@ -248,15 +251,13 @@ static void forward_off(struct pim_upstream *up) {
 			continue;
 		}
 
-		/* scan per-interface (S,G) state */
-		for(ALL_LIST_ELEMENTS(pim_ifp->pim_ifchannel_list, chnode, chnextnode, ch)) {
-			if(ch->upstream != up) {
-				continue;
-			}
-
-			pim_forward_stop(ch);
+		/* per-interface (S,G) state */
+		ch = pim_ifchannel_lookup(ifp, up->source_addr, up->group_addr);
+		if(!ch) {
+			continue;
+		}
 
-		} /* scan iface channel list */
+		pim_forward_stop(ch);
 	}	  /* scan iflist */
 }
 
@@ -285,8 +286,7 @@ static void pim_upstream_switch(struct pim_upstream *up, enum pim_upstream_state
 	} else {
 		forward_off(up);
 		pim_joinprune_send(up->rpf.source_nexthop.interface, up->rpf.rpf_addr, up->source_addr, up->group_addr, 0 /* prune */);
-		zassert(up->t_join_timer);
-		THREAD_OFF(up->t_join_timer);
+		join_timer_stop(up);
 	}
 }
 
@@ -304,7 +304,9 @@ static struct pim_upstream *pim_upstream_new(struct in_addr source_addr, struct
 	up->group_addr = group_addr;
 	up->flags = 0;
 	up->ref_count = 1;
-	up->t_join_timer = 0;
+	up->jp_agg = 0;
+	up->jp_node = 0;
+	up->join_suppress_until = 0;
 	up->join_state = 0;
 	up->state_transition = pim_time_monotonic_sec();
 	up->channel_oil = 0;
@@ -321,22 +323,19 @@ static struct pim_upstream *pim_upstream_new(struct in_addr source_addr, struct
 		return NULL;
 	}
 
-	listnode_add(qpim_upstream_list, up);
+	TAILQ_INSERT_TAIL(&qpim_upstream_list, up, entry);
+	hash_get(qpim_upstream_hash, up, hash_alloc_intern);
 
 	return up;
 }
 
 struct pim_upstream *pim_upstream_find(struct in_addr source_addr, struct in_addr group_addr) {
-	struct listnode *up_node;
-	struct pim_upstream *up;
+	struct pim_upstream key;
 
-	for(ALL_LIST_ELEMENTS_RO(qpim_upstream_list, up_node, up)) {
-		if((source_addr.s_addr == up->source_addr.s_addr) && (group_addr.s_addr == up->group_addr.s_addr)) {
-			return up;
-		}
-	}
+	key.source_addr = source_addr;
+	key.group_addr = group_addr;
 
-	return 0;
+	return hash_lookup(qpim_upstream_hash, &key);
 }
 
 struct pim_upstream *pim_upstream_add(struct in_addr source_addr, struct in_addr group_addr) {
@@ -386,8 +385,6 @@ void pim_upstream_del(struct pim_upstream *up) {
 int pim_upstream_evaluate_join_desired(struct pim_upstream *up) {
 	struct listnode *ifnode;
 	struct listnode *ifnextnode;
-	struct listnode *chnode;
-	struct listnode *chnextnode;
 	struct interface *ifp;
 	struct pim_interface *pim_ifp;
 	struct pim_ifchannel *ch;
@@ -399,20 +396,19 @@ int pim_upstream_evaluate_join_desired(struct pim_upstream *up) {
 			continue;
 		}
 
-		/* scan per-interface (S,G) state */
-		for(ALL_LIST_ELEMENTS(pim_ifp->pim_ifchannel_list, chnode, chnextnode, ch)) {
-			if(ch->upstream != up) {
-				continue;
-			}
+		/* per-interface (S,G) state */
+		ch = pim_ifchannel_lookup(ifp, up->source_addr, up->group_addr);
+		if(!ch) {
+			continue;
+		}
 
-			if(pim_macro_ch_lost_assert(ch)) {
-				continue; /* keep searching */
-			}
+		if(pim_macro_ch_lost_assert(ch)) {
+			continue; /* keep searching */
+		}
 
-			if(pim_macro_chisin_joins_or_include(ch)) {
-				return 1; /* true */
-			}
-		} /* scan iface channel list */
+		if(pim_macro_chisin_joins_or_include(ch)) {
+			return 1; /* true */
+		}
 	}	  /* scan iflist */
 
 	return 0; /* false */
@@ -459,14 +455,12 @@ void pim_upstream_update_join_desired(struct pim_upstream *up) {
   it so that it expires after t_override seconds.
 */
 void pim_upstream_rpf_genid_changed(struct in_addr neigh_addr) {
-	struct listnode *up_node;
-	struct listnode *up_nextnode;
-	struct pim_upstream *up;
+	struct pim_upstream *up, *next;
 
 	/*
     Scan all (S,G) upstreams searching for RPF'(S,G)=neigh_addr
   */
-	for(ALL_LIST_ELEMENTS(qpim_upstream_list, up_node, up_nextnode, up)) {
+	TAILQ_FOREACH_SAFE(up, &qpim_upstream_list, entry, next) {
 		if(PIM_DEBUG_PIM_TRACE) {
 			char neigh_str[100];
 			char src_str[100];
@@ -500,8 +494,6 @@ void pim_upstream_rpf_interface_changed(struct pim_upstream *up, struct interfac
 
 	/* scan all interfaces */
 	for(ALL_LIST_ELEMENTS(iflist, ifnode, ifnextnode, ifp)) {
-		struct listnode *chnode;
-		struct listnode *chnextnode;
 		struct pim_ifchannel *ch;
 		struct pim_interface *pim_ifp;
 
@@ -510,34 +502,31 @@ void pim_upstream_rpf_interface_changed(struct pim_upstream *up, struct interfac
 			continue;
 		}
 
-		/* search all ifchannels */
-		for(ALL_LIST_ELEMENTS(pim_ifp->pim_ifchannel_list, chnode, chnextnode, ch)) {
-			if(ch->upstream != up) {
-				continue;
+		/* per-interface (S,G) state */
+		ch = pim_ifchannel_lookup(ifp, up->source_addr, up->group_addr);
+		if(!ch) {
+			continue;
+		}
+
+		if(ch->ifassert_state == PIM_IFASSERT_I_AM_LOSER) {
+			if (
+    /* RPF_interface(S) was NOT I */
+    (old_rpf_ifp == ch->interface)
+    &&
+    /* RPF_interface(S) stopped being I */
+    (ch->upstream->rpf.source_nexthop.interface != ch->interface)
+    ) {
+				assert_action_a5(ch);
 			}
+		} /* PIM_IFASSERT_I_AM_LOSER */
 
-			if(ch->ifassert_state == PIM_IFASSERT_I_AM_LOSER) {
-				if (
-	    /* RPF_interface(S) was NOT I */
-	    (old_rpf_ifp == ch->interface)
-	    &&
-	    /* RPF_interface(S) stopped being I */
-	    (ch->upstream->rpf.source_nexthop.interface != ch->interface)
-	    ) {
-					assert_action_a5(ch);
-				}
-			} /* PIM_IFASSERT_I_AM_LOSER */
-
-			pim_ifchannel_update_assert_tracking_desired(ch);
-		}
+		pim_ifchannel_update_assert_tracking_desired(ch);
 	}
 }
 
 void pim_upstream_update_could_assert(struct pim_upstream *up) {
 	struct listnode *ifnode;
 	struct listnode *ifnextnode;
-	struct listnode *chnode;
-	struct listnode *chnextnode;
 	struct interface *ifp;
 	struct pim_interface *pim_ifp;
 	struct pim_ifchannel *ch;
@@ -549,23 +538,19 @@ void pim_upstream_update_could_assert(struct pim_upstream *up) {
 			continue;
 		}
 
-		/* scan per-interface (S,G) state */
-		for(ALL_LIST_ELEMENTS(pim_ifp->pim_ifchannel_list, chnode, chnextnode, ch)) {
-			if(ch->upstream != up) {
-				continue;
-			}
-
-			pim_ifchannel_update_could_assert(ch);
+		/* per-interface (S,G) state */
+		ch = pim_ifchannel_lookup(ifp, up->source_addr, up->group_addr);
+		if(!ch) {
+			continue;
+		}
 
-		} /* scan iface channel list */
+		pim_ifchannel_update_could_assert(ch);
 	}	  /* scan iflist */
 }
 
 void pim_upstream_update_my_assert_metric(struct pim_upstream *up) {
 	struct listnode *ifnode;
 	struct listnode *ifnextnode;
-	struct listnode *chnode;
-	struct listnode *chnextnode;
 	struct interface *ifp;
 	struct pim_interface *pim_ifp;
 	struct pim_ifchannel *ch;
@@ -577,23 +562,19 @@ void pim_upstream_update_my_assert_metric(struct pim_upstream *up) {
 			continue;
 		}
 
-		/* scan per-interface (S,G) state */
-		for(ALL_LIST_ELEMENTS(pim_ifp->pim_ifchannel_list, chnode, chnextnode, ch)) {
-			if(ch->upstream != up) {
-				continue;
-			}
-
-			pim_ifchannel_update_my_assert_metric(ch);
+		/* per-interface (S,G) state */
+		ch = pim_ifchannel_lookup(ifp, up->source_addr, up->group_addr);
+		if(!ch) {
+			continue;
+		}
 
-		} /* scan iface channel list */
+		pim_ifchannel_update_my_assert_metric(ch);
 	}	  /* scan iflist */
 }
 
 static void pim_upstream_update_assert_tracking_desired(struct pim_upstream *up) {
 	struct listnode *ifnode;
 	struct listnode *ifnextnode;
-	struct listnode *chnode;
-	struct listnode *chnextnode;
 	struct interface *ifp;
 	struct pim_interface *pim_ifp;
 	struct pim_ifchannel *ch;
@@ -605,14 +586,12 @@ static void pim_upstream_update_assert_tracking_desired(struct pim_upstream *up)
 			continue;
 		}
 
-		/* scan per-interface (S,G) state */
-		for(ALL_LIST_ELEMENTS(pim_ifp->pim_ifchannel_list, chnode, chnextnode, ch)) {
-			if(ch->upstream != up) {
-				continue;
-			}
-
-			pim_ifchannel_update_assert_tracking_desired(ch);
+		/* per-interface (S,G) state */
+		ch = pim_ifchannel_lookup(ifp, up->source_addr, up->group_addr);
+		if(!ch) {
+			continue;
+		}
 
-		} /* scan iface channel list */
+		pim_ifchannel_update_assert_tracking_desired(ch);
 	}	  /* scan iflist */
 }
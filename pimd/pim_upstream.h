@@ -25,6 +25,8 @@
 
 #include <zebra.h>
 
+#include "queue.h"
+
 #define PIM_UPSTREAM_FLAG_MASK_DR_JOIN_DESIRED (1 << 0)
 #define PIM_UPSTREAM_FLAG_MASK_DR_JOIN_DESIRED_UPDATED (2 << 0)
 
@@ -90,10 +92,18 @@ struct pim_upstream {
 
 	struct pim_rpf rpf;
 
-	struct thread *t_join_timer;
+	/* Joined: refreshed by the RPF'(S,G) Join/Prune aggregate */
+	struct pim_jp_agg *jp_agg;
+	struct listnode *jp_node;     /* in jp_agg->upstream_list */
+	int64_t join_suppress_until;  /* no periodic Join before (sec) */
 	int64_t state_transition; /* Record current state uptime */
+
+	TAILQ_ENTRY(pim_upstream) entry; /* in qpim_upstream_list */
 };
 
+unsigned int pim_upstream_hash_key(void *arg);
+int pim_upstream_hash_cmp(const void *arg1, const void *arg2);
+
 void pim_upstream_free(struct pim_upstream *up);
 void pim_upstream_delete(struct pim_upstream *up);
 struct pim_upstream *pim_upstream_find(struct in_addr source_addr, struct in_addr group_addr);
@@ -106,6 +116,7 @@ void pim_upstream_update_join_desired(struct pim_upstream *up);
 void pim_upstream_join_suppress(struct pim_upstream *up, struct in_addr rpf_addr, int holdtime);
 void pim_upstream_join_timer_decrease_to_t_override(const char *debug_label, struct pim_upstream *up, struct in_addr rpf_addr);
 void pim_upstream_join_timer_restart(struct pim_upstream *up);
+long pim_upstream_join_timer_remain_msec(struct pim_upstream *up);
 void pim_upstream_rpf_genid_changed(struct in_addr neigh_addr);
 void pim_upstream_rpf_interface_changed(struct pim_upstream *up, struct interface *old_rpf_ifp);
 
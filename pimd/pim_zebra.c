@@ -285,11 +285,9 @@ static int pim_zebra_if_address_del(int command, struct zclient *client, zebra_s
 }
 
 static void scan_upstream_rpf_cache() {
-	struct listnode *up_node;
-	struct listnode *up_nextnode;
-	struct pim_upstream *up;
+	struct pim_upstream *up, *next;
 
-	for(ALL_LIST_ELEMENTS(qpim_upstream_list, up_node, up_nextnode, up)) {
+	TAILQ_FOREACH_SAFE(up, &qpim_upstream_list, entry, next) {
 		struct pim_rpf old_rpf;
 		enum pim_rpf_result rpf_result;
 
@@ -333,14 +331,12 @@ static void scan_upstream_rpf_cache() {
 }
 
 void pim_scan_oil() {
-	struct listnode *node;
-	struct listnode *nextnode;
-	struct channel_oil *c_oil;
+	struct channel_oil *c_oil, *next;
 
 	qpim_scan_oil_last = pim_time_monotonic_sec();
 	++qpim_scan_oil_events;
 
-	for(ALL_LIST_ELEMENTS(qpim_channel_oil_list, node, nextnode, c_oil)) {
+	TAILQ_FOREACH_SAFE(c_oil, &qpim_channel_oil_list, entry, next) {
 		int old_vif_index;
 		int input_iface_vif_index = fib_lookup_if_vif_index(c_oil->oil.mfcc_origin);
 		if(input_iface_vif_index < 1) {
@@ -414,6 +410,9 @@ static int on_rpf_cache_refresh(struct thread *t) {
 
 	qpim_rpf_cache_refresher = 0;
 
+	/* each source is looked up once for all its (S,G)s and OILs */
+	zclient_lookup_cache_flush();
+
 	/* update PIM protocol state */
 	scan_upstream_rpf_cache();
 
@@ -429,6 +428,9 @@ static int on_rpf_cache_refresh(struct thread *t) {
 static void sched_rpf_cache_refresh() {
 	++qpim_rpf_cache_refresh_requests;
 
+	/* lookups until the refresh must not see the routes before the change */
+	zclient_lookup_cache_flush();
+
 	if(qpim_rpf_cache_refresher) {
 		/* Refresh timer is already running */
 		return;
@@ -29,6 +29,9 @@
 #include "stream.h"
 #include "network.h"
 #include "thread.h"
+#include "hash.h"
+#include "jhash.h"
+#include "memory.h"
 
 #include "pimd.h"
 #include "pim_pim.h"
@@ -39,6 +42,83 @@ extern int zclient_debug;
 
 static void zclient_lookup_sched(struct zclient *zlookup, int delay);
 
+/*
+  Resolved nexthops per looked up address.  Every (S,G) of a source, and
+  its channel OIL, asks for the same address, and each ask is a blocking
+  round trip to zebra; with the cache it costs one per source between
+  unicast changes, which flush it (see zclient_lookup_cache_flush()).
+*/
+struct zlookup_cache_entry {
+	struct in_addr addr;
+	int num_ifindex;
+	struct pim_zlookup_nexthop nexthop_tab[];
+};
+
+static struct hash *zlookup_cache;
+static int64_t zlookup_cache_hits;
+static int64_t zlookup_cache_misses;
+
+static unsigned int zlookup_cache_key(void *arg) {
+	struct zlookup_cache_entry *entry = arg;
+
+	return jhash_1word(entry->addr.s_addr, 0);
+}
+
+static int zlookup_cache_cmp(const void *arg1, const void *arg2) {
+	const struct zlookup_cache_entry *entry1 = arg1;
+	const struct zlookup_cache_entry *entry2 = arg2;
+
+	return entry1->addr.s_addr == entry2->addr.s_addr;
+}
+
+static void zlookup_cache_free(void *arg) {
+	XFREE(MTYPE_PIM_ZLOOKUP_CACHE, arg);
+}
+
+/* Forget every resolved address, as the unicast routes have changed */
+void zclient_lookup_cache_flush() {
+	if(zlookup_cache && zlookup_cache->count) {
+		hash_clean(zlookup_cache, zlookup_cache_free);
+	}
+}
+
+void zclient_lookup_cache_stats(unsigned long *count, int64_t *hits, int64_t *misses) {
+	*count = zlookup_cache ? zlookup_cache->count : 0;
+	*hits = zlookup_cache_hits;
+	*misses = zlookup_cache_misses;
+}
+
+static int zlookup_cache_get(struct in_addr addr, struct pim_zlookup_nexthop nexthop_tab[], const int tab_size) {
+	struct zlookup_cache_entry key;
+	struct zlookup_cache_entry *entry;
+	int num_ifindex;
+
+	key.addr = addr;
+	if(!zlookup_cache || !(entry = hash_lookup(zlookup_cache, &key))) {
+		++zlookup_cache_misses;
+		return 0;
+	}
+	++zlookup_cache_hits;
+
+	num_ifindex = entry->num_ifindex < tab_size ? entry->num_ifindex : tab_size;
+	memcpy(nexthop_tab, entry->nexthop_tab, num_ifindex * sizeof(struct pim_zlookup_nexthop));
+	return num_ifindex;
+}
+
+static void zlookup_cache_put(struct in_addr addr, struct pim_zlookup_nexthop nexthop_tab[], int num_ifindex) {
+	struct zlookup_cache_entry *entry;
+
+	if(!zlookup_cache) {
+		zlookup_cache = hash_create_open(zlookup_cache_key, zlookup_cache_cmp);
+	}
+
+	entry = XMALLOC(MTYPE_PIM_ZLOOKUP_CACHE, sizeof(struct zlookup_cache_entry) + num_ifindex * sizeof(struct pim_zlookup_nexthop));
+	entry->addr = addr;
+	entry->num_ifindex = num_ifindex;
+	memcpy(entry->nexthop_tab, nexthop_tab, num_ifindex * sizeof(struct pim_zlookup_nexthop));
+	hash_get(zlookup_cache, entry, hash_alloc_intern);
+}
+
 /* Connect to zebra for nexthop lookup. */
 static int zclient_lookup_connect(struct thread *t) {
 	struct zclient *zlookup;
@@ -95,6 +175,9 @@ static void zclient_lookup_reconnect(struct zclient *zlookup) {
 }
 
 static void zclient_lookup_failed(struct zclient *zlookup) {
+	/* zebra may have moved on while we were not listening */
+	zclient_lookup_cache_flush();
+
 	if(zlookup->sock >= 0) {
 		if(close(zlookup->sock)) {
 			zlog_warn("%s: closing fd=%d: errno=%d %s", __func__, zlookup->sock, errno, safe_strerror(errno));
@@ -299,7 +382,7 @@ static int zclient_lookup_nexthop_once(struct zclient *zlookup, struct pim_zlook
 	return zclient_read_nexthop(zlookup, nexthop_tab, tab_size, addr);
 }
 
-int zclient_lookup_nexthop(struct zclient *zlookup, struct pim_zlookup_nexthop nexthop_tab[], const int tab_size, struct in_addr addr, int max_lookup) {
+static int zclient_lookup_nexthop_recursive(struct zclient *zlookup, struct pim_zlookup_nexthop nexthop_tab[], const int tab_size, struct in_addr addr, int max_lookup) {
 	int lookup;
 	uint32_t route_metric = 0xFFFFFFFF;
 	uint8_t protocol_distance = 0xFF;
@@ -376,3 +459,20 @@ int zclient_lookup_nexthop(struct zclient *zlookup, struct pim_zlookup_nexthop n
 
 	return -2;
 }
+
+int zclient_lookup_nexthop(struct zclient *zlookup, struct pim_zlookup_nexthop nexthop_tab[], const int tab_size, struct in_addr addr, int max_lookup) {
+	int num_ifindex;
+
+	num_ifindex = zlookup_cache_get(addr, nexthop_tab, tab_size);
+	if(num_ifindex > 0) {
+		return num_ifindex;
+	}
+
+	/* Only what zebra resolved is kept, failures are asked again */
+	num_ifindex = zclient_lookup_nexthop_recursive(zlookup, nexthop_tab, tab_size, addr, max_lookup);
+	if(num_ifindex > 0) {
+		zlookup_cache_put(addr, nexthop_tab, num_ifindex);
+	}
+
+	return num_ifindex;
+}
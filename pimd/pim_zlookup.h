@@ -38,6 +38,9 @@ struct pim_zlookup_nexthop {
 
 struct zclient *zclient_lookup_new(void);
 
+void zclient_lookup_cache_flush(void);
+void zclient_lookup_cache_stats(unsigned long *count, int64_t *hits, int64_t *misses);
+
 int zclient_lookup_nexthop(struct zclient *zlookup, struct pim_zlookup_nexthop nexthop_tab[], const int tab_size, struct in_addr addr, int max_lookup);
 
 #endif /* PIM_ZLOOKUP_H */
@@ -25,6 +25,7 @@
 #include "log.h"
 #include "memory.h"
 #include "vrf.h"
+#include "hash.h"
 
 #include "pimd.h"
 #include "pim_cmd.h"
@@ -49,10 +50,12 @@ int qpim_mroute_socket_fd = -1;
 int64_t qpim_mroute_socket_creation = 0; /* timestamp of creation */
 struct thread *qpim_mroute_socket_reader = 0;
 int qpim_mroute_oif_highest_vif_index = -1;
-struct list *qpim_channel_oil_list = 0;
+struct channel_oil_list qpim_channel_oil_list = TAILQ_HEAD_INITIALIZER(qpim_channel_oil_list);
+struct hash *qpim_channel_oil_hash = 0;
 struct in_addr qpim_all_pim_routers_addr;
 int qpim_t_periodic = PIM_DEFAULT_T_PERIODIC; /* Period between Join/Prune Messages */
-struct list *qpim_upstream_list = 0;
+struct pim_upstream_list qpim_upstream_list = TAILQ_HEAD_INITIALIZER(qpim_upstream_list);
+struct hash *qpim_upstream_hash = 0;
 struct zclient *qpim_zclient_update = 0;
 struct zclient *qpim_zclient_lookup = 0;
 struct pim_assert_metric qpim_infinite_assert_metric;
@@ -70,17 +73,21 @@ int64_t qpim_mroute_add_events = 0;
 int64_t qpim_mroute_add_last = 0;
 int64_t qpim_mroute_del_events = 0;
 int64_t qpim_mroute_del_last = 0;
+int64_t qpim_mroute_mfc_coalesced = 0;
+int64_t qpim_mroute_upcall_events = 0;
+int64_t qpim_mroute_upcall_deduped = 0;
+int64_t qpim_mroute_upcall_dropped = 0;
 struct list *qpim_static_route_list = 0;
 
 static void pim_free() {
 	pim_ssmpingd_destroy();
 
-	if(qpim_channel_oil_list) {
-		list_free(qpim_channel_oil_list);
+	if(qpim_channel_oil_hash) {
+		hash_free(qpim_channel_oil_hash);
 	}
 
-	if(qpim_upstream_list) {
-		list_free(qpim_upstream_list);
+	if(qpim_upstream_hash) {
+		hash_free(qpim_upstream_hash);
 	}
 
 	if(qpim_static_route_list) {
@@ -97,20 +104,9 @@ void pim_init() {
 		return;
 	}
 
-	qpim_channel_oil_list = list_new();
-	if(!qpim_channel_oil_list) {
-		zlog_err("%s %s: failure: channel_oil_list=list_new()", __FILE__, __PRETTY_FUNCTION__);
-		return;
-	}
-	qpim_channel_oil_list->del = (void (*)(void *)) pim_channel_oil_free;
+	qpim_channel_oil_hash = hash_create_open(pim_channel_oil_hash_key, pim_channel_oil_hash_cmp);
 
-	qpim_upstream_list = list_new();
-	if(!qpim_upstream_list) {
-		zlog_err("%s %s: failure: upstream_list=list_new()", __FILE__, __PRETTY_FUNCTION__);
-		pim_free();
-		return;
-	}
-	qpim_upstream_list->del = (void (*)(void *)) pim_upstream_free;
+	qpim_upstream_hash = hash_create_open(pim_upstream_hash_key, pim_upstream_hash_cmp);
 
 	qpim_static_route_list = list_new();
 	if(!qpim_static_route_list) {
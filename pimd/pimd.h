@@ -25,6 +25,8 @@
 
 #include <stdint.h>
 
+#include "queue.h"
+
 #include "pim_assert.h"
 #include "pim_mroute.h"
 
@@ -79,10 +81,14 @@ extern int qpim_mroute_socket_fd;
 extern int64_t qpim_mroute_socket_creation; /* timestamp of creation */
 extern struct thread *qpim_mroute_socket_reader;
 extern int qpim_mroute_oif_highest_vif_index;
-extern struct list *qpim_channel_oil_list; /* list of struct channel_oil */
+TAILQ_HEAD(channel_oil_list, channel_oil);
+extern struct channel_oil_list qpim_channel_oil_list; /* all struct channel_oil */
+extern struct hash *qpim_channel_oil_hash; /* struct channel_oil by (S,G) */
 extern struct in_addr qpim_all_pim_routers_addr;
 extern int qpim_t_periodic;		/* Period between Join/Prune Messages */
-extern struct list *qpim_upstream_list; /* list of struct pim_upstream */
+TAILQ_HEAD(pim_upstream_list, pim_upstream);
+extern struct pim_upstream_list qpim_upstream_list; /* all struct pim_upstream */
+extern struct hash *qpim_upstream_hash; /* struct pim_upstream by (S,G) */
 extern struct zclient *qpim_zclient_update;
 extern struct zclient *qpim_zclient_lookup;
 extern struct pim_assert_metric qpim_infinite_assert_metric;
@@ -100,6 +106,10 @@ extern int64_t qpim_mroute_add_events;
 extern int64_t qpim_mroute_add_last;
 extern int64_t qpim_mroute_del_events;
 extern int64_t qpim_mroute_del_last;
+extern int64_t qpim_mroute_mfc_coalesced;	/* MFC updates folded into a pending one */
+extern int64_t qpim_mroute_upcall_events;	/* kernel upcalls read */
+extern int64_t qpim_mroute_upcall_deduped;	/* repeated (S,G) upcalls ignored */
+extern int64_t qpim_mroute_upcall_dropped;	/* upcalls over the rate limit */
 extern struct list *qpim_static_route_list; /* list of routes added statically */
 
 #define PIM_JP_HOLDTIME (qpim_t_periodic * 7 / 2)
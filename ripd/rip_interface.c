@@ -436,7 +436,7 @@ int rip_interface_delete(int command, struct zclient *zclient, zebra_size_t leng
 
 	/* To support pseudo interface do not free interface structure.  */
 	/* if_delete(ifp); */
-	ifp->ifindex = IFINDEX_INTERNAL;
+	if_set_index(ifp, IFINDEX_INTERNAL);
 
 	return 0;
 }
@@ -466,6 +466,7 @@ static void rip_interface_reset(struct rip_interface *ri) {
      compatibility. */
 	ri->auth_type = RIP_NO_AUTH;
 	ri->md5_auth_len = RIP_AUTH_MD5_COMPAT_SIZE;
+	ri->auth_hash = AUTH_HASH_MD5;
 
 	/* Set default split-horizon behavior.  If the interface is Frame
      Relay or SMDS is enabled, the default value for split-horizon is
@@ -485,6 +486,10 @@ static void rip_interface_reset(struct rip_interface *ri) {
 		free(ri->key_chain);
 		ri->key_chain = NULL;
 	}
+	if(ri->auth_key_str) {
+		free(ri->auth_key_str);
+		ri->auth_key_str = NULL;
+	}
 
 	ri->list[RIP_FILTER_IN] = NULL;
 	ri->list[RIP_FILTER_OUT] = NULL;
@@ -1337,15 +1342,23 @@ ALIAS(no_ip_rip_send_version, no_ip_rip_send_version_num_cmd, "no ip rip send ve
 		    "Version 1\n"
 		    "Version 2\n")
 
-DEFUN(ip_rip_authentication_mode, ip_rip_authentication_mode_cmd, "ip rip authentication mode (md5|text)",
+#define RIP_AUTH_HMAC_CMD "hmac-sha-1|hmac-sha-256|hmac-sha-384|hmac-sha-512"
+#define RIP_AUTH_HMAC_STR \
+	"HMAC-SHA-1 message digest (RFC 4822)\n" \
+	"HMAC-SHA-256 message digest (RFC 4822)\n" \
+	"HMAC-SHA-384 message digest (RFC 4822)\n" \
+	"HMAC-SHA-512 message digest (RFC 4822)\n"
+
+DEFUN(ip_rip_authentication_mode, ip_rip_authentication_mode_cmd, "ip rip authentication mode (md5|text|" RIP_AUTH_HMAC_CMD ")",
       IP_STR "Routing Information Protocol\n"
 	     "Authentication control\n"
 	     "Authentication mode\n"
 	     "Keyed message digest\n"
-	     "Clear text authentication\n") {
+	     "Clear text authentication\n" RIP_AUTH_HMAC_STR) {
 	struct interface *ifp;
 	struct rip_interface *ri;
 	int auth_type;
+	int hash = AUTH_HASH_MD5;
 
 	ifp = (struct interface *) vty->index;
 	ri = ifp->info;
@@ -1355,21 +1368,23 @@ DEFUN(ip_rip_authentication_mode, ip_rip_authentication_mode_cmd, "ip rip authen
 		return CMD_WARNING;
 	}
 
-	if(strncmp("md5", argv[0], strlen(argv[0])) == 0) {
-		auth_type = RIP_AUTH_MD5;
-	} else if(strncmp("text", argv[0], strlen(argv[0])) == 0) {
+	/* HMAC-SHA goes on the wire as the MD5 type, with a longer digest */
+	if(strncmp("text", argv[0], strlen(argv[0])) == 0) {
 		auth_type = RIP_AUTH_SIMPLE_PASSWORD;
+	} else if((hash = auth_hash_lookup(argv[0])) >= 0) {
+		auth_type = RIP_AUTH_MD5;
 	} else {
-		vty_out(vty, "mode should be md5 or text%s", VTY_NEWLINE);
+		vty_out(vty, "mode should be md5, text or hmac-sha-X%s", VTY_NEWLINE);
 		return CMD_WARNING;
 	}
 
 	if(argc == 1) {
 		ri->auth_type = auth_type;
+		ri->auth_hash = hash;
 		return CMD_SUCCESS;
 	}
 
-	if((argc == 2) && (auth_type != RIP_AUTH_MD5)) {
+	if((argc == 2) && (auth_type != RIP_AUTH_MD5 || hash != AUTH_HASH_MD5)) {
 		vty_out(vty, "auth length argument only valid for md5%s", VTY_NEWLINE);
 		return CMD_WARNING;
 	}
@@ -1383,6 +1398,7 @@ DEFUN(ip_rip_authentication_mode, ip_rip_authentication_mode_cmd, "ip rip authen
 	}
 
 	ri->auth_type = auth_type;
+	ri->auth_hash = hash;
 
 	return CMD_SUCCESS;
 }
@@ -1409,16 +1425,17 @@ DEFUN(no_ip_rip_authentication_mode, no_ip_rip_authentication_mode_cmd, "no ip r
 
 	ri->auth_type = RIP_NO_AUTH;
 	ri->md5_auth_len = RIP_AUTH_MD5_COMPAT_SIZE;
+	ri->auth_hash = AUTH_HASH_MD5;
 
 	return CMD_SUCCESS;
 }
 
-ALIAS(no_ip_rip_authentication_mode, no_ip_rip_authentication_mode_type_cmd, "no ip rip authentication mode (md5|text)",
+ALIAS(no_ip_rip_authentication_mode, no_ip_rip_authentication_mode_type_cmd, "no ip rip authentication mode (md5|text|" RIP_AUTH_HMAC_CMD ")",
       NO_STR IP_STR "Routing Information Protocol\n"
 		    "Authentication control\n"
 		    "Authentication mode\n"
 		    "Keyed message digest\n"
-		    "Clear text authentication\n")
+		    "Clear text authentication\n" RIP_AUTH_HMAC_STR)
 
 ALIAS(no_ip_rip_authentication_mode, no_ip_rip_authentication_mode_type_authlen_cmd, "no ip rip authentication mode (md5|text) auth-length (rfc|old-ripd)",
       NO_STR IP_STR "Routing Information Protocol\n"
@@ -1685,7 +1702,9 @@ static int rip_interface_config_write(struct vty *vty) {
 			vty_out(vty, " ip rip authentication mode text%s", VTY_NEWLINE);
 		}
 
-		if(ri->auth_type == RIP_AUTH_MD5) {
+		if(ri->auth_type == RIP_AUTH_MD5 && ri->auth_hash != AUTH_HASH_MD5) {
+			vty_out(vty, " ip rip authentication mode %s%s", auth_hash_name(ri->auth_hash), VTY_NEWLINE);
+		} else if(ri->auth_type == RIP_AUTH_MD5) {
 			vty_out(vty, " ip rip authentication mode md5");
 			if(ri->md5_auth_len == RIP_AUTH_MD5_COMPAT_SIZE) {
 				vty_out(vty, " auth-length old-ripd");
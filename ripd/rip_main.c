@@ -236,6 +236,8 @@ int main(int argc, char **argv) {
 
 	/* Prepare master thread. */
 	master = thread_master_create();
+	/* every route carries timeout and garbage-collect timers */
+	thread_master_timer_wheel_enable(master);
 
 	/* Library initialization. */
 	if(skip_runas) {
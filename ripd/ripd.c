@@ -38,7 +38,7 @@
 #include "if_rmap.h"
 #include "plist.h"
 #include "distribute.h"
-#include "md5.h"
+#include "auth_hash.h"
 #include "keychain.h"
 #include "privs.h"
 
@@ -111,6 +111,23 @@ void rip_info_free(struct rip_info *rinfo) {
 	XFREE(MTYPE_RIP_INFO, rinfo);
 }
 
+/* Set the route change flag and queue the node for the next triggered
+   update, so that it only has to visit what actually changed.  A
+   flagged entry is always queued already; duplicates left by entries
+   overwritten in place are merged by rip_changed_sort(). */
+static void rip_route_changed(struct route_node *rp, struct rip_info *rinfo) {
+	if(CHECK_FLAG(rinfo->flags, RIP_RTF_CHANGED)) {
+		return;
+	}
+	SET_FLAG(rinfo->flags, RIP_RTF_CHANGED);
+
+	if(rip->changed_count == rip->changed_max) {
+		rip->changed_max = rip->changed_max ? rip->changed_max * 2 : 64;
+		rip->changed = XREALLOC(MTYPE_RIP_CHANGED, rip->changed, rip->changed_max * sizeof(struct route_node *));
+	}
+	rip->changed[rip->changed_count++] = route_lock_node(rp);
+}
+
 /* RIP route garbage collect timer. */
 static int rip_garbage_collect(struct thread *t) {
 	struct rip_info *rinfo;
@@ -172,7 +189,7 @@ struct rip_info *rip_ecmp_add(struct rip_info *rinfo_new) {
 
 	/* Set the route change flag on the first entry. */
 	rinfo = listgetdata(listhead(list));
-	SET_FLAG(rinfo->flags, RIP_RTF_CHANGED);
+	rip_route_changed(rp, rinfo);
 
 	/* Signal the output process to trigger an update (see section 2.5). */
 	rip_event(RIP_TRIGGERED_UPDATE, 0);
@@ -224,7 +241,7 @@ struct rip_info *rip_ecmp_replace(struct rip_info *rinfo_new) {
 	}
 
 	/* Set the route change flag. */
-	SET_FLAG(rinfo->flags, RIP_RTF_CHANGED);
+	rip_route_changed(rp, rinfo);
 
 	/* Signal the output process to trigger an update (see section 2.5). */
 	rip_event(RIP_TRIGGERED_UPDATE, 0);
@@ -270,7 +287,7 @@ struct rip_info *rip_ecmp_delete(struct rip_info *rinfo) {
 
 	/* Set the route change flag on the first entry. */
 	rinfo = listgetdata(listhead(list));
-	SET_FLAG(rinfo->flags, RIP_RTF_CHANGED);
+	rip_route_changed(rp, rinfo);
 
 	/* Signal the output process to trigger an update (see section 2.5). */
 	rip_event(RIP_TRIGGERED_UPDATE, 0);
@@ -608,7 +625,7 @@ static void rip_rte_process(struct rte *rte, struct sockaddr_in *from, struct in
 
 					/* - Set the route change flag on the first entry. */
 					rinfo = listgetdata(listhead(list));
-					SET_FLAG(rinfo->flags, RIP_RTF_CHANGED);
+					rip_route_changed(rp, rinfo);
 					rip_event(RIP_TRIGGERED_UPDATE, 0);
 				}
 			}
@@ -760,17 +777,32 @@ static int rip_auth_simple_password(struct rte *rte, struct sockaddr_in *from, s
 	return 0;
 }
 
-/* RIP version 2 authentication with MD5. */
+/* The interface's digest key for a key string, made ready again only
+ * when the string or the digest changed since the last packet. */
+static const struct auth_key *rip_auth_key(struct rip_interface *ri, const char *str) {
+	if(str == NULL) {
+		str = "";
+	}
+	if(ri->auth_key_str == NULL || ri->auth_key.type != ri->auth_hash || strcmp(ri->auth_key_str, str)) {
+		if(ri->auth_key_str) {
+			free(ri->auth_key_str);
+		}
+		ri->auth_key_str = strdup(str);
+		auth_key_set(&ri->auth_key, ri->auth_hash, str, strlen(str));
+	}
+	return &ri->auth_key;
+}
+
+/* RIP version 2 authentication with MD5 or HMAC-SHA. */
 static int rip_auth_md5(struct rip_packet *packet, struct sockaddr_in *from, int length, struct interface *ifp) {
 	struct rip_interface *ri;
 	struct rip_md5_info *md5;
 	struct rip_md5_data *md5data;
 	struct keychain *keychain;
 	struct key *key;
-	MD5_CTX ctx;
-	u_char digest[RIP_AUTH_MD5_SIZE];
 	u_int16_t packet_len;
-	char auth_str[RIP_AUTH_MD5_SIZE];
+	const char *auth_str = NULL;
+	size_t size;
 
 	if(IS_RIP_DEBUG_EVENT) {
 		zlog_debug("RIPv2 MD5 authentication from %s", inet_ntoa(from->sin_addr));
@@ -787,8 +819,10 @@ static int rip_auth_md5(struct rip_packet *packet, struct sockaddr_in *from, int
 	/* If the authentication length is less than 16, then it must be wrong for
    * any interpretation of rfc2082. Some implementations also interpret
    * this as RIP_HEADER_SIZE+ RIP_AUTH_MD5_SIZE, aka RIP_AUTH_MD5_COMPAT_SIZE.
+   * For HMAC-SHA it is the digest's length.
    */
-	if(!((md5->auth_len == RIP_AUTH_MD5_SIZE) || (md5->auth_len == RIP_AUTH_MD5_COMPAT_SIZE))) {
+	size = auth_hash_size(ri->auth_hash);
+	if(ri->auth_hash != AUTH_HASH_MD5 ? md5->auth_len != size : !((md5->auth_len == RIP_AUTH_MD5_SIZE) || (md5->auth_len == RIP_AUTH_MD5_COMPAT_SIZE))) {
 		if(IS_RIP_DEBUG_EVENT) {
 			zlog_debug(
 				"RIPv2 MD5 authentication, strange authentication "
@@ -802,7 +836,7 @@ static int rip_auth_md5(struct rip_packet *packet, struct sockaddr_in *from, int
 	/* grab and verify check packet length */
 	packet_len = ntohs(md5->packet_len);
 
-	if(packet_len > (length - RIP_HEADER_SIZE - RIP_AUTH_MD5_SIZE)) {
+	if(packet_len > (length - RIP_HEADER_SIZE - (int) size)) {
 		if(IS_RIP_DEBUG_EVENT) {
 			zlog_debug(
 				"RIPv2 MD5 authentication, packet length field %d "
@@ -816,8 +850,6 @@ static int rip_auth_md5(struct rip_packet *packet, struct sockaddr_in *from, int
 	/* retrieve authentication data */
 	md5data = (struct rip_md5_data *) (((u_char *) packet) + packet_len);
 
-	memset(auth_str, 0, RIP_AUTH_MD5_SIZE);
-
 	if(ri->key_chain) {
 		keychain = keychain_lookup(ri->key_chain);
 		if(keychain == NULL) {
@@ -829,23 +861,17 @@ static int rip_auth_md5(struct rip_packet *packet, struct sockaddr_in *from, int
 			return 0;
 		}
 
-		strncpy(auth_str, key->string, RIP_AUTH_MD5_SIZE);
+		auth_str = key->string;
 	} else if(ri->auth_str) {
-		strncpy(auth_str, ri->auth_str, RIP_AUTH_MD5_SIZE);
+		auth_str = ri->auth_str;
 	}
 
-	if(auth_str[0] == 0) {
+	if(auth_str == NULL || auth_str[0] == 0) {
 		return 0;
 	}
 
-	/* MD5 digest authentication. */
-	memset(&ctx, 0, sizeof(ctx));
-	MD5Init(&ctx);
-	MD5Update(&ctx, packet, packet_len + RIP_HEADER_SIZE);
-	MD5Update(&ctx, auth_str, RIP_AUTH_MD5_SIZE);
-	MD5Final(digest, &ctx);
-
-	if(memcmp(md5data->digest, digest, RIP_AUTH_MD5_SIZE) == 0) {
+	/* Digest authentication, over the trailer's family and type too. */
+	if(auth_digest_check(rip_auth_key(ri, auth_str), packet, packet_len + RIP_HEADER_SIZE, md5data->digest)) {
 		return packet_len;
 	} else {
 		return 0;
@@ -922,9 +948,13 @@ static size_t rip_auth_md5_ah_write(struct stream *s, struct rip_interface *ri,
 
 	/* Auth Data Len.  Set 16 for MD5 authentication data. Older ripds
    * however expect RIP_HEADER_SIZE + RIP_AUTH_MD5_SIZE so we allow for this
-   * to be configurable.
+   * to be configurable.  HMAC-SHA sets the digest's length.
    */
-	stream_putc(s, ri->md5_auth_len);
+	if(ri->auth_hash != AUTH_HASH_MD5) {
+		stream_putc(s, auth_hash_size(ri->auth_hash));
+	} else {
+		stream_putc(s, ri->md5_auth_len);
+	}
 
 	/* Sequence Number (non-decreasing). */
 	/* RFC2080: The value used in the sequence number is
@@ -957,15 +987,15 @@ static size_t rip_auth_header_write(struct stream *s, struct rip_interface *ri,
 	return 0;
 }
 
-/* Write RIPv2 MD5 authentication data trailer */
-static void rip_auth_md5_set(struct stream *s, struct rip_interface *ri, size_t doff, char *auth_str, int authlen) {
+/* Write RIPv2 MD5 or HMAC-SHA authentication data trailer, with the
+ * key string of the key if any, else of the interface. */
+static void rip_auth_md5_set(struct stream *s, struct rip_interface *ri, size_t doff, struct key *key) {
 	unsigned long len;
-	MD5_CTX ctx;
-	unsigned char digest[RIP_AUTH_MD5_SIZE];
+	unsigned char digest[AUTH_HASH_SIZE_MAX];
 
 	/* Make it sure this interface is configured as MD5
      authentication. */
-	assert((ri->auth_type == RIP_AUTH_MD5) && (authlen == RIP_AUTH_MD5_SIZE));
+	assert(ri->auth_type == RIP_AUTH_MD5);
 	assert(doff > 0);
 
 	/* Get packet length. */
@@ -985,14 +1015,10 @@ static void rip_auth_md5_set(struct stream *s, struct rip_interface *ri, size_t
 	stream_putw(s, RIP_AUTH_DATA);
 
 	/* Generate a digest for the RIP packet. */
-	memset(&ctx, 0, sizeof(ctx));
-	MD5Init(&ctx);
-	MD5Update(&ctx, STREAM_DATA(s), stream_get_endp(s));
-	MD5Update(&ctx, auth_str, RIP_AUTH_MD5_SIZE);
-	MD5Final(digest, &ctx);
+	auth_digest(rip_auth_key(ri, (key && key->string) ? key->string : ri->auth_str), STREAM_DATA(s), stream_get_endp(s), digest);
 
 	/* Copy the digest to the packet. */
-	stream_write(s, digest, RIP_AUTH_MD5_SIZE);
+	stream_write(s, digest, auth_hash_size(ri->auth_hash));
 }
 
 /* RIP routing information. */
@@ -1448,7 +1474,7 @@ void rip_redistribute_delete(int type, int sub_type, struct prefix_ipv4 *p, ifin
 				rinfo->metric = RIP_METRIC_INFINITY;
 				RIP_TIMER_ON(rinfo->t_garbage_collect, rip_garbage_collect, rip->garbage_time);
 				RIP_TIMER_OFF(rinfo->t_timeout);
-				rinfo->flags |= RIP_RTF_CHANGED;
+				rip_route_changed(rp, rinfo);
 
 				if(IS_RIP_DEBUG_EVENT) {
 					zlog_debug(
@@ -1901,6 +1927,23 @@ static int rip_write_rte(int num, struct stream *s, struct prefix_ipv4 *p, u_cha
 	return ++num;
 }
 
+/* Route nodes visited by rip_output_process(): the whole table, or only
+   the queued changed routes for a triggered update. */
+static struct route_node *rip_output_first(int route_type, unsigned int *idx) {
+	*idx = 0;
+	if(route_type == rip_changed_route) {
+		return rip->changed_count ? rip->changed[0] : NULL;
+	}
+	return route_top(rip->table);
+}
+
+static struct route_node *rip_output_next(struct route_node *rp, int route_type, unsigned int *idx) {
+	if(route_type == rip_changed_route) {
+		return ++(*idx) < rip->changed_count ? rip->changed[*idx] : NULL;
+	}
+	return route_next(rp);
+}
+
 /* Send update to the ifp or spcified neighbor. */
 void rip_output_process(struct connected *ifc, struct sockaddr_in *to, int route_type, u_char version) {
 	int ret;
@@ -1921,6 +1964,7 @@ void rip_output_process(struct connected *ifc, struct sockaddr_in *to, int route
 	int subnetted = 0;
 	struct list *list = NULL;
 	struct listnode *listnode = NULL;
+	unsigned int changed_idx;
 
 	/* Logging output event. */
 	if(IS_RIP_DEBUG_EVENT) {
@@ -1948,9 +1992,10 @@ void rip_output_process(struct connected *ifc, struct sockaddr_in *to, int route
 	}
 
 	/* If output interface is in MD5 authentication mode, we need space
-     for authentication header and data. */
+     for authentication header and data, the trailer's family and type
+     and digest taking whole RTEs. */
 	if(ri->auth_type == RIP_AUTH_MD5) {
-		rtemax -= 2;
+		rtemax -= 1 + (RIP_HEADER_SIZE + auth_hash_size(ri->auth_hash) + RIP_RTE_SIZE - 1) / RIP_RTE_SIZE;
 	}
 
 	/* If output interface is in simple password authentication mode
@@ -1977,7 +2022,7 @@ void rip_output_process(struct connected *ifc, struct sockaddr_in *to, int route
 		}
 	}
 
-	for(rp = route_top(rip->table); rp; rp = route_next(rp)) {
+	for(rp = rip_output_first(route_type, &changed_idx); rp; rp = rip_output_next(rp, route_type, &changed_idx)) {
 		if((list = rp->info) != NULL && listcount(list) != 0) {
 			rinfo = listgetdata(listhead(list));
 			/* For RIPv1, if we are subnetted, output subnets in our network    */
@@ -2159,7 +2204,7 @@ void rip_output_process(struct connected *ifc, struct sockaddr_in *to, int route
 			num = rip_write_rte(num, s, p, version, rinfo);
 			if(num == rtemax) {
 				if(version == RIPv2 && ri->auth_type == RIP_AUTH_MD5) {
-					rip_auth_md5_set(s, ri, doff, auth_str, RIP_AUTH_SIMPLE_SIZE);
+					rip_auth_md5_set(s, ri, doff, key);
 				}
 
 				ret = rip_send_packet(STREAM_DATA(s), stream_get_endp(s), to, ifc);
@@ -2176,7 +2221,7 @@ void rip_output_process(struct connected *ifc, struct sockaddr_in *to, int route
 	/* Flush unwritten RTE. */
 	if(num != 0) {
 		if(version == RIPv2 && ri->auth_type == RIP_AUTH_MD5) {
-			rip_auth_md5_set(s, ri, doff, auth_str, RIP_AUTH_SIMPLE_SIZE);
+			rip_auth_md5_set(s, ri, doff, key);
 		}
 
 		ret = rip_send_packet(STREAM_DATA(s), stream_get_endp(s), to, ifc);
@@ -2340,22 +2385,56 @@ static int rip_update(struct thread *t) {
 	return 0;
 }
 
-/* Walk down the RIP routing table then clear changed flag. */
+static int rip_changed_cmp(const void *a, const void *b) {
+	const struct route_node *ra = *(struct route_node * const *) a;
+	const struct route_node *rb = *(struct route_node * const *) b;
+	u_int32_t aa = ntohl(ra->p.u.prefix4.s_addr);
+	u_int32_t ab = ntohl(rb->p.u.prefix4.s_addr);
+
+	if(aa != ab) {
+		return aa < ab ? -1 : 1;
+	}
+	return ra->p.prefixlen - rb->p.prefixlen;
+}
+
+/* Put the changed routes in table order and drop duplicate nodes. */
+static void rip_changed_sort(void) {
+	unsigned int i, n;
+
+	if(rip->changed_count < 2) {
+		return;
+	}
+
+	qsort(rip->changed, rip->changed_count, sizeof(struct route_node *), rip_changed_cmp);
+
+	for(i = 1, n = 1; i < rip->changed_count; i++) {
+		if(rip->changed[i] == rip->changed[n - 1]) {
+			route_unlock_node(rip->changed[i]);
+		} else {
+			rip->changed[n++] = rip->changed[i];
+		}
+	}
+	rip->changed_count = n;
+}
+
+/* Clear the changed flag on the queued routes and release them. */
 static void rip_clear_changed_flag(void) {
 	struct route_node *rp;
 	struct rip_info *rinfo = NULL;
 	struct list *list = NULL;
 	struct listnode *listnode = NULL;
+	unsigned int i;
 
-	for(rp = route_top(rip->table); rp; rp = route_next(rp)) {
+	for(i = 0; i < rip->changed_count; i++) {
+		rp = rip->changed[i];
 		if((list = rp->info) != NULL) {
 			for(ALL_LIST_ELEMENTS_RO(list, listnode, rinfo)) {
 				UNSET_FLAG(rinfo->flags, RIP_RTF_CHANGED);
-				/* This flag can be set only on the first entry. */
-				break;
 			}
 		}
+		route_unlock_node(rp);
 	}
+	rip->changed_count = 0;
 }
 
 /* Triggered update interval timer. */
@@ -2391,8 +2470,12 @@ static int rip_triggered_update(struct thread *t) {
 	}
 
 	/* Split Horizon processing is done when generating triggered
-     updates as well as normal updates (see section 2.6). */
-	rip_update_process(rip_changed_route);
+     updates as well as normal updates (see section 2.6).  The changed
+     set is sorted once and shared by every interface and neighbor. */
+	rip_changed_sort();
+	if(rip->changed_count) {
+		rip_update_process(rip_changed_route);
+	}
 
 	/* Once all of the triggered updates have been generated, the route
      change flags should be cleared. */
@@ -2427,7 +2510,7 @@ void rip_redistribute_withdraw(int type) {
 				rinfo->metric = RIP_METRIC_INFINITY;
 				RIP_TIMER_ON(rinfo->t_garbage_collect, rip_garbage_collect, rip->garbage_time);
 				RIP_TIMER_OFF(rinfo->t_timeout);
-				rinfo->flags |= RIP_RTF_CHANGED;
+				rip_route_changed(rp, rinfo);
 
 				if(IS_RIP_DEBUG_EVENT) {
 					struct prefix_ipv4 *p = (struct prefix_ipv4 *) &rp->p;
@@ -3031,7 +3114,7 @@ static void rip_ecmp_disable(void) {
 			rip_zebra_ipv4_add(rp);
 
 			/* Set the route change flag. */
-			SET_FLAG(rinfo->flags, RIP_RTF_CHANGED);
+			rip_route_changed(rp, rinfo);
 
 			/* Signal the output process to trigger an update. */
 			rip_event(RIP_TRIGGERED_UPDATE, 0);
@@ -3433,6 +3516,12 @@ void rip_clean(void) {
 	struct listnode *listnode = NULL;
 
 	if(rip) {
+		/* Release the pending triggered update routes. */
+		rip_clear_changed_flag();
+		if(rip->changed) {
+			XFREE(MTYPE_RIP_CHANGED, rip->changed);
+		}
+
 		/* Clear RIP routes */
 		for(rp = route_top(rip->table); rp; rp = route_next(rp)) {
 			if((list = rp->info) != NULL) {
@@ -23,6 +23,8 @@
 #ifndef _ZEBRA_RIP_H
 #define _ZEBRA_RIP_H
 
+#include "auth_hash.h"
+
 /* RIP version number. */
 #define RIPv1 1
 #define RIPv2 2
@@ -126,6 +128,12 @@ struct rip {
 	struct thread *t_triggered_update;
 	struct thread *t_triggered_interval;
 
+	/* Routes flagged RIP_RTF_CHANGED since the last triggered update,
+	   each holding a route_node lock. */
+	struct route_node **changed;
+	unsigned int changed_count;
+	unsigned int changed_max;
+
 	/* RIP timer values. */
 	unsigned long update_time;
 	unsigned long timeout_time;
@@ -261,6 +269,13 @@ struct rip_interface {
 	/* value to use for md5->auth_len */
 	u_int8_t md5_auth_len;
 
+	/* Digest for RIP_AUTH_MD5: keyed MD5 or HMAC-SHA (RFC 4822). */
+	u_char auth_hash;
+
+	/* The last key string used, made ready for auth_hash. */
+	char *auth_key_str;
+	struct auth_key auth_key;
+
 	/* Split horizon flag. */
 	split_horizon_policy_t split_horizon;
 	split_horizon_policy_t split_horizon_default;
@@ -283,7 +283,7 @@ int ripng_interface_delete(int command, struct zclient *zclient, zebra_size_t le
 
 	/* To support pseudo interface do not free interface structure.  */
 	/* if_delete(ifp); */
-	ifp->ifindex = IFINDEX_INTERNAL;
+	if_set_index(ifp, IFINDEX_INTERNAL);
 
 	return 0;
 }
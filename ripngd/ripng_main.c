@@ -232,6 +232,8 @@ int main(int argc, char **argv) {
 	}
 
 	master = thread_master_create();
+	/* every route carries timeout and garbage-collect timers */
+	thread_master_timer_wheel_enable(master);
 
 	/* Library inits. */
 	if(skip_runas) {
@@ -143,7 +143,7 @@ void ripng_rte_send(struct list *ripng_rte_list, struct interface *ifp, struct s
 		if(!IPV6_ADDR_SAME(&last_nexthop, NEXTHOP_OUT_PTR(data))) {
 			/* A nexthop entry should be at least followed by 1 RTE */
 			if(num == (rtemax - 1)) {
-				ret = ripng_send_packet((caddr_t) STREAM_DATA(s), stream_get_endp(s), to, ifp);
+				ret = ripng_send_packet_queue((caddr_t) STREAM_DATA(s), stream_get_endp(s), to, ifp);
 
 				if(ret >= 0 && IS_RIPNG_DEBUG_SEND) {
 					ripng_packet_dump((struct ripng_packet *) STREAM_DATA(s), stream_get_endp(s), "SEND");
@@ -173,7 +173,7 @@ void ripng_rte_send(struct list *ripng_rte_list, struct interface *ifp, struct s
 		num = ripng_write_rte(num, s, data->p, NULL, TAG_OUT(data), METRIC_OUT(data));
 
 		if(num == rtemax) {
-			ret = ripng_send_packet((caddr_t) STREAM_DATA(s), stream_get_endp(s), to, ifp);
+			ret = ripng_send_packet_queue((caddr_t) STREAM_DATA(s), stream_get_endp(s), to, ifp);
 
 			if(ret >= 0 && IS_RIPNG_DEBUG_SEND) {
 				ripng_packet_dump((struct ripng_packet *) STREAM_DATA(s), stream_get_endp(s), "SEND");
@@ -185,7 +185,7 @@ void ripng_rte_send(struct list *ripng_rte_list, struct interface *ifp, struct s
 
 	/* If unwritten RTE exist, flush it. */
 	if(num != 0) {
-		ret = ripng_send_packet((caddr_t) STREAM_DATA(s), stream_get_endp(s), to, ifp);
+		ret = ripng_send_packet_queue((caddr_t) STREAM_DATA(s), stream_get_endp(s), to, ifp);
 
 		if(ret >= 0 && IS_RIPNG_DEBUG_SEND) {
 			ripng_packet_dump((struct ripng_packet *) STREAM_DATA(s), stream_get_endp(s), "SEND");
@@ -150,15 +150,11 @@ static int ripng_make_socket(void) {
 	return sock;
 }
 
-/* Send RIPng packet. */
-int ripng_send_packet(caddr_t buf, int bufsize, struct sockaddr_in6 *to, struct interface *ifp) {
-	int ret;
-	struct msghdr msg;
-	struct iovec iov;
+/* Fill in msg for sending buf out of ifp, to the RIPng group unless
+   to is given.  addr, iov and adata are the caller's storage. */
+static void ripng_send_msghdr(struct msghdr *msg, struct sockaddr_in6 *addr, struct iovec *iov, char *adata, caddr_t buf, int bufsize, struct sockaddr_in6 *to, struct interface *ifp) {
 	struct cmsghdr *cmsgptr;
-	char adata[256];
 	struct in6_pktinfo *pkt;
-	struct sockaddr_in6 addr;
 
 	if(IS_RIPNG_DEBUG_SEND) {
 		if(to) {
@@ -168,31 +164,32 @@ int ripng_send_packet(caddr_t buf, int bufsize, struct sockaddr_in6 *to, struct
 		zlog_debug("  send packet size %d", bufsize);
 	}
 
-	memset(&addr, 0, sizeof(struct sockaddr_in6));
-	addr.sin6_family = AF_INET6;
+	memset(addr, 0, sizeof(struct sockaddr_in6));
+	addr->sin6_family = AF_INET6;
 #ifdef SIN6_LEN
-	addr.sin6_len = sizeof(struct sockaddr_in6);
+	addr->sin6_len = sizeof(struct sockaddr_in6);
 #endif /* SIN6_LEN */
-	addr.sin6_flowinfo = htonl(RIPNG_PRIORITY_DEFAULT);
+	addr->sin6_flowinfo = htonl(RIPNG_PRIORITY_DEFAULT);
 
 	/* When destination is specified. */
 	if(to != NULL) {
-		addr.sin6_addr = to->sin6_addr;
-		addr.sin6_port = to->sin6_port;
+		addr->sin6_addr = to->sin6_addr;
+		addr->sin6_port = to->sin6_port;
 	} else {
-		inet_pton(AF_INET6, RIPNG_GROUP, &addr.sin6_addr);
-		addr.sin6_port = htons(RIPNG_PORT_DEFAULT);
+		inet_pton(AF_INET6, RIPNG_GROUP, &addr->sin6_addr);
+		addr->sin6_port = htons(RIPNG_PORT_DEFAULT);
 	}
 
-	msg.msg_name = (void *) &addr;
-	msg.msg_namelen = sizeof(struct sockaddr_in6);
-	msg.msg_iov = &iov;
-	msg.msg_iovlen = 1;
-	msg.msg_control = (void *) adata;
-	msg.msg_controllen = CMSG_SPACE(sizeof(struct in6_pktinfo));
+	memset(msg, 0, sizeof(struct msghdr));
+	msg->msg_name = (void *) addr;
+	msg->msg_namelen = sizeof(struct sockaddr_in6);
+	msg->msg_iov = iov;
+	msg->msg_iovlen = 1;
+	msg->msg_control = (void *) adata;
+	msg->msg_controllen = CMSG_SPACE(sizeof(struct in6_pktinfo));
 
-	iov.iov_base = buf;
-	iov.iov_len = bufsize;
+	iov->iov_base = buf;
+	iov->iov_len = bufsize;
 
 	cmsgptr = (struct cmsghdr *) adata;
 	cmsgptr->cmsg_len = CMSG_LEN(sizeof(struct in6_pktinfo));
@@ -202,20 +199,101 @@ int ripng_send_packet(caddr_t buf, int bufsize, struct sockaddr_in6 *to, struct
 	pkt = (struct in6_pktinfo *) CMSG_DATA(cmsgptr);
 	memset(&pkt->ipi6_addr, 0, sizeof(struct in6_addr));
 	pkt->ipi6_ifindex = ifp->ifindex;
+}
+
+static void ripng_send_error(struct sockaddr_in6 *to, struct interface *ifp) {
+	if(to) {
+		zlog_err("RIPng send fail on %s to %s: %s", ifp->name, inet6_ntoa(to->sin6_addr), safe_strerror(errno));
+	} else {
+		zlog_err("RIPng send fail on %s: %s", ifp->name, safe_strerror(errno));
+	}
+}
+
+/* Send RIPng packet. */
+int ripng_send_packet(caddr_t buf, int bufsize, struct sockaddr_in6 *to, struct interface *ifp) {
+	int ret;
+	struct msghdr msg;
+	struct iovec iov;
+	char adata[256];
+	struct sockaddr_in6 addr;
+
+	ripng_send_msghdr(&msg, &addr, &iov, adata, buf, bufsize, to, ifp);
 
 	ret = sendmsg(ripng->sock, &msg, 0);
 
 	if(ret < 0) {
-		if(to) {
-			zlog_err("RIPng send fail on %s to %s: %s", ifp->name, inet6_ntoa(to->sin6_addr), safe_strerror(errno));
-		} else {
-			zlog_err("RIPng send fail on %s: %s", ifp->name, safe_strerror(errno));
-		}
+		ripng_send_error(to, ifp);
 	}
 
 	return ret;
 }
 
+#ifdef MSG_WAITFORONE
+/* Updates going out of many interfaces are copied here and handed to
+   the kernel RIPNG_SEND_BATCH at a time by ripng_send_flush(). */
+static struct ripng_send_slot {
+	struct interface *ifp;
+	struct sockaddr_in6 to;
+	int has_to;
+	struct sockaddr_in6 addr;
+	struct iovec iov;
+	char adata[CMSG_SPACE(sizeof(struct in6_pktinfo))];
+	u_char buf[RIPNG_MAX_PACKET_SIZE];
+} ripng_sendq[RIPNG_SEND_BATCH];
+static struct mmsghdr ripng_sendq_msg[RIPNG_SEND_BATCH];
+static unsigned int ripng_sendq_count;
+#endif /* MSG_WAITFORONE */
+
+/* Like ripng_send_packet(), but the packet may be held until the next
+   ripng_send_flush().  Only a send error on the spot is reported. */
+int ripng_send_packet_queue(caddr_t buf, int bufsize, struct sockaddr_in6 *to, struct interface *ifp) {
+#ifdef MSG_WAITFORONE
+	struct ripng_send_slot *slot;
+
+	if(bufsize > RIPNG_MAX_PACKET_SIZE) {
+		return ripng_send_packet(buf, bufsize, to, ifp);
+	}
+
+	slot = &ripng_sendq[ripng_sendq_count];
+	memcpy(slot->buf, buf, bufsize);
+	slot->ifp = ifp;
+	slot->has_to = (to != NULL);
+	if(to) {
+		slot->to = *to;
+	}
+	ripng_send_msghdr(&ripng_sendq_msg[ripng_sendq_count].msg_hdr, &slot->addr, &slot->iov, slot->adata, (caddr_t) slot->buf, bufsize, to, ifp);
+
+	if(++ripng_sendq_count == RIPNG_SEND_BATCH) {
+		ripng_send_flush();
+	}
+	return bufsize;
+#else
+	return ripng_send_packet(buf, bufsize, to, ifp);
+#endif /* MSG_WAITFORONE */
+}
+
+/* Send whatever ripng_send_packet_queue() is holding. */
+void ripng_send_flush(void) {
+#ifdef MSG_WAITFORONE
+	struct ripng_send_slot *slot;
+	unsigned int i = 0;
+	int ret;
+
+	while(i < ripng_sendq_count) {
+		ret = sendmmsg(ripng->sock, &ripng_sendq_msg[i], ripng_sendq_count - i, 0);
+		if(ret <= 0) {
+			/* the error belongs to the first message; skip it */
+			slot = &ripng_sendq[i];
+			ripng_send_error(slot->has_to ? &slot->to : NULL, slot->ifp);
+			i++;
+			continue;
+		}
+		i += ret;
+	}
+	ripng_sendq_count = 0;
+#endif /* MSG_WAITFORONE */
+}
+
 /* Receive UDP RIPng packet from socket. */
 static int ripng_recv_packet(int sock, u_char *buf, int bufsize, struct sockaddr_in6 *from, ifindex_t *ifindex, int *hoplimit) {
 	int ret;
@@ -1124,6 +1202,7 @@ static void ripng_request_process(struct ripng_packet *packet, int size, struct
 	if(lim == ((caddr_t) (rte + 1)) && IN6_IS_ADDR_UNSPECIFIED(&rte->addr) && rte->prefixlen == 0 && rte->metric == RIPNG_METRIC_INFINITY) {
 		/* All route with split horizon */
 		ripng_output_process(ifp, from, ripng_all_route);
+		ripng_send_flush();
 	} else {
 		/* Except for this special case, processing is quite simple.
 	 Examine the list of RTEs in the Request one by one.  For each
@@ -1253,10 +1332,55 @@ static void ripng_clear_changed_flag(void) {
 
 /* Regular update of RIPng route.  Send all routing formation to RIPng
    enabled interface. */
+/* Whether updates go out of ifp at all. */
+static int ripng_update_enabled(struct interface *ifp) {
+	struct ripng_interface *ri = ifp->info;
+
+	if(if_is_loopback(ifp) || !if_is_up(ifp)) {
+		return 0;
+	}
+
+	if(!ri->running) {
+		return 0;
+	}
+
+	/* When passive interface is specified, suppress announce to the
+     interface. */
+	if(ri->passive) {
+		return 0;
+	}
+
+	return 1;
+}
+
+/* Send the periodic update to the next RIPNG_UPDATE_SLICE interfaces
+   of the sweep started by ripng_update(). */
+static int ripng_update_step(struct thread *t) {
+	struct interface *ifp;
+	unsigned int n;
+
+	ripng->t_update_step = NULL;
+
+	for(n = 0; n < RIPNG_UPDATE_SLICE && ripng->update_pos < ripng->update_count; n++) {
+		/* The interface may have gone away or down since the sweep began. */
+		ifp = if_lookup_by_index(ripng->update_ifindex[ripng->update_pos++]);
+		if(ifp && ripng_update_enabled(ifp)) {
+			ripng_output_process(ifp, NULL, ripng_all_route);
+		}
+	}
+	ripng_send_flush();
+
+	if(ripng->update_pos < ripng->update_count) {
+		ripng->t_update_step = thread_add_timer_msec(master, ripng_update_step, NULL, ripng->update_step_msec);
+	}
+
+	return 0;
+}
+
 static int ripng_update(struct thread *t) {
 	struct listnode *node;
 	struct interface *ifp;
-	struct ripng_interface *ri;
+	unsigned int steps;
 
 	/* Clear update timer thread. */
 	ripng->t_update = NULL;
@@ -1266,26 +1390,20 @@ static int ripng_update(struct thread *t) {
 		zlog_debug("RIPng update timer expired!");
 	}
 
-	/* Supply routes to each interface. */
-	for(ALL_LIST_ELEMENTS_RO(iflist, node, ifp)) {
-		ri = ifp->info;
+	/* Supply routes to each interface.  The interfaces are taken in
+     slices, so that a router with many of them spreads the update
+     over the interval instead of sending it in one burst. */
+	RIPNG_TIMER_OFF(ripng->t_update_step);
+	ripng->update_count = 0;
+	ripng->update_pos = 0;
 
-		if(if_is_loopback(ifp) || !if_is_up(ifp)) {
-			continue;
-		}
-
-		if(!ri->running) {
-			continue;
-		}
-
-		/* When passive interface is specified, suppress announce to the
-         interface. */
-		if(ri->passive) {
+	for(ALL_LIST_ELEMENTS_RO(iflist, node, ifp)) {
+		if(!ripng_update_enabled(ifp)) {
 			continue;
 		}
 
 #if RIPNG_ADVANCED
-		if(ri->ri_send == RIPNG_SEND_OFF) {
+		if(((struct ripng_interface *) ifp->info)->ri_send == RIPNG_SEND_OFF) {
 			if(IS_RIPNG_DEBUG_EVENT) {
 				zlog(NULL, LOG_DEBUG, "[Event] RIPng send to if %d is suppressed by config", ifp->ifindex);
 			}
@@ -1293,8 +1411,18 @@ static int ripng_update(struct thread *t) {
 		}
 #endif /* RIPNG_ADVANCED */
 
-		ripng_output_process(ifp, NULL, ripng_all_route);
+		if(ripng->update_count == ripng->update_max) {
+			ripng->update_max = ripng->update_max ? ripng->update_max * 2 : 64;
+			ripng->update_ifindex = XREALLOC(MTYPE_RIPNG_UPDATE, ripng->update_ifindex, ripng->update_max * sizeof(ifindex_t));
+		}
+		ripng->update_ifindex[ripng->update_count++] = ifp->ifindex;
+	}
+
+	steps = (ripng->update_count + RIPNG_UPDATE_SLICE - 1) / RIPNG_UPDATE_SLICE;
+	if(steps > 1) {
+		ripng->update_step_msec = ripng->update_time * 1000 / 2 / steps;
 	}
+	ripng_update_step(NULL);
 
 	/* Triggered updates may be suppressed if a regular update is due by
      the time the triggered update would be sent. */
@@ -1325,7 +1453,6 @@ static int ripng_triggered_interval(struct thread *t) {
 int ripng_triggered_update(struct thread *t) {
 	struct listnode *node;
 	struct interface *ifp;
-	struct ripng_interface *ri;
 	int interval;
 
 	ripng->t_triggered_update = NULL;
@@ -1345,24 +1472,11 @@ int ripng_triggered_update(struct thread *t) {
 	/* Split Horizon processing is done when generating triggered
      updates as well as normal updates (see section 2.6). */
 	for(ALL_LIST_ELEMENTS_RO(iflist, node, ifp)) {
-		ri = ifp->info;
-
-		if(if_is_loopback(ifp) || !if_is_up(ifp)) {
-			continue;
-		}
-
-		if(!ri->running) {
-			continue;
+		if(ripng_update_enabled(ifp)) {
+			ripng_output_process(ifp, NULL, ripng_changed_route);
 		}
-
-		/* When passive interface is specified, suppress announce to the
-         interface. */
-		if(ri->passive) {
-			continue;
-		}
-
-		ripng_output_process(ifp, NULL, ripng_changed_route);
 	}
+	ripng_send_flush();
 
 	/* Once all of the triggered updates have been generated, the route
      change flags should be cleared. */
@@ -2532,6 +2646,7 @@ void ripng_clean() {
 
 		/* Cancel the RIPng timers */
 		RIPNG_TIMER_OFF(ripng->t_update);
+		RIPNG_TIMER_OFF(ripng->t_update_step);
 		RIPNG_TIMER_OFF(ripng->t_triggered_update);
 		RIPNG_TIMER_OFF(ripng->t_triggered_interval);
 
@@ -2573,6 +2688,10 @@ void ripng_clean() {
 		XFREE(MTYPE_ROUTE_TABLE, ripng->route);
 		XFREE(MTYPE_ROUTE_TABLE, ripng->aggregate);
 
+		if(ripng->update_ifindex) {
+			XFREE(MTYPE_RIPNG_UPDATE, ripng->update_ifindex);
+		}
+
 		XFREE(MTYPE_RIPNG, ripng);
 		ripng = NULL;
 	} /* if (ripng) */
@@ -51,6 +51,13 @@
 /* RIPng peer timeout value. */
 #define RIPNG_PEER_TIMER_DEFAULT 180
 
+/* RIPng packets handed to the kernel per sendmmsg(). */
+#define RIPNG_SEND_BATCH 32
+
+/* Interfaces sent to per step of a periodic update.  When there are
+   more, the steps are spread over half of the update interval. */
+#define RIPNG_UPDATE_SLICE 16
+
 /* Default config file name. */
 #define RIPNG_DEFAULT_CONFIG "ripngd.conf"
 
@@ -121,6 +128,7 @@ struct ripng {
 	struct thread *t_read;
 	struct thread *t_write;
 	struct thread *t_update;
+	struct thread *t_update_step;
 	struct thread *t_garbage;
 	struct thread *t_zebra;
 
@@ -129,6 +137,13 @@ struct ripng {
 	struct thread *t_triggered_update;
 	struct thread *t_triggered_interval;
 
+	/* Interfaces still to be sent the current periodic update. */
+	ifindex_t *update_ifindex;
+	unsigned int update_count;
+	unsigned int update_max;
+	unsigned int update_pos;
+	long update_step_msec;
+
 	/* RIPng ECMP flag */
 	unsigned int ecmp;
 
@@ -385,6 +400,8 @@ extern void ripng_redistribute_write(struct vty *, int);
 
 extern int ripng_write_rte(int num, struct stream *s, struct prefix_ipv6 *p, struct in6_addr *nexthop, u_int16_t tag, u_char metric);
 extern int ripng_send_packet(caddr_t buf, int bufsize, struct sockaddr_in6 *to, struct interface *ifp);
+extern int ripng_send_packet_queue(caddr_t buf, int bufsize, struct sockaddr_in6 *to, struct interface *ifp);
+extern void ripng_send_flush(void);
 
 extern void ripng_packet_dump(struct ripng_packet *packet, int size, const char *sndrcv);
 
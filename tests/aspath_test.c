@@ -25,10 +25,12 @@
 #include "stream.h"
 #include "privs.h"
 #include "filter.h"
+#include "regex_dfa.h"
 
 #include "bgpd/bgpd.h"
 #include "bgpd/bgp_aspath.h"
 #include "bgpd/bgp_attr.h"
+#include "bgpd/bgp_regex.h"
 
 #define VT100_RESET "\x1b[0m"
 #define VT100_RED "\x1b[31m"
@@ -1060,6 +1062,60 @@ static void aggregate_test(struct tests *t) {
 	/*  aspath_unintern (ascratch);*/
 }
 
+/* AS path regexes matched against the ASNs must agree with regexec() on
+ * the string, on the test segments and a few more paths */
+static const char *regex_tests[] = {
+	"_8466_", "^8466_", "_4096$", "^8466 3 52737 4096$", "_3_52737_", "^[0-9]+_3_", "_[0-9]+$", "^$", "_846_", "^846", "_52737_[0-9]+$", "^8466_[0-9]+$", "_0_", "_65000 65001_", "^65000$", "^65000_65001$", "_3_", "^(8466|65000)_", NULL,
+};
+
+static const char *regex_paths[] = {
+	"", "65000", "65000 65001", "3 3 3 4096", "8466 3 52737 4096", "1 {8466,3} 4096", "(65000) 8466", NULL,
+};
+
+static int regex_check(const char *pattern, struct bgp_aspath_regex *re, struct bgp_regex *reg, struct regex_dfa *dfa, struct aspath *as) {
+	int got = (bgp_aspath_regexec(re, as) != REG_NOMATCH);
+	int shouldbe = (bgp_regexec(reg, as) != REG_NOMATCH);
+	int dfa_got = regex_dfa_exec(dfa, aspath_print(as));
+
+	if(got != shouldbe || dfa_got != shouldbe) {
+		printf("regex %s on \"%s\": got %d, dfa %d, should be %d\n", pattern, aspath_print(as), got, dfa_got, shouldbe);
+		failed++;
+		return 1;
+	}
+	return 0;
+}
+
+static void regex_test(void) {
+	int i, j, fails = 0;
+
+	for(i = 0; regex_tests[i]; i++) {
+		struct bgp_aspath_regex *re = bgp_aspath_regcomp(regex_tests[i]);
+		struct bgp_regex *reg = bgp_regcomp(regex_tests[i]);
+		struct regex_dfa *dfa = regex_dfa_compile(reg->expanded);
+		struct aspath *as;
+
+		assert(re && reg && dfa);
+
+		for(j = 0; test_segments[j].name; j++) {
+			as = make_aspath(test_segments[j].asdata, test_segments[j].len, 0);
+			if(as) {
+				fails += regex_check(regex_tests[i], re, reg, dfa, as);
+				aspath_unintern(&as);
+			}
+		}
+		for(j = 0; regex_paths[j]; j++) {
+			as = aspath_str2aspath(regex_paths[j]);
+			fails += regex_check(regex_tests[i], re, reg, dfa, as);
+			aspath_free(as);
+		}
+
+		bgp_aspath_regex_free(re);
+		bgp_regex_free(reg);
+		regex_dfa_free(dfa);
+	}
+	printf("regex test: %s\n\n", fails ? FAILED : OK);
+}
+
 /* cmp_left tests  */
 static void cmp_test() {
 	unsigned int i;
@@ -1135,15 +1191,15 @@ static int handle_attr_test(struct aspath_tests *t) {
 		printf("aspath is NULL, but should be: %s\n", t->shouldbe);
 		failed++;
 	}
-	if(t->shouldbe && attr.aspath && strcmp(attr.aspath->str, t->shouldbe)) {
+	if(t->shouldbe && attr.aspath && strcmp(aspath_print(attr.aspath), t->shouldbe)) {
 		printf("attr str and 'shouldbe' mismatched!\n"
 		       "attr str:  %s\n"
 		       "shouldbe:  %s\n",
-		       attr.aspath->str, t->shouldbe);
+		       aspath_print(attr.aspath), t->shouldbe);
 		failed++;
 	}
 	if(!t->shouldbe && attr.aspath) {
-		printf("aspath should be NULL, but is: %s\n", attr.aspath->str);
+		printf("aspath should be NULL, but is: %s\n", aspath_print(attr.aspath));
 		failed++;
 	}
 
@@ -1200,6 +1256,10 @@ int main(void) {
 
 	i = 0;
 
+	regex_test();
+
+	i = 0;
+
 	empty_get_test();
 
 	i = 0;
@@ -0,0 +1,712 @@
+/*
+ * bgpd convergence benchmark.
+ *
+ * Starts a bgpd with a generated configuration and connects to it as N
+ * synthetic upstream peers, each announcing the same generated table,
+ * and M synthetic downstream peers which only listen.  Upstream peer i
+ * announces the table with an AS path of N - i hops, so every new peer
+ * to arrive displaces the previous best path and the final best paths
+ * all come from the last upstream peer.  A downstream peer has converged
+ * once it has been sent that final path for every prefix.
+ *
+ * Reported, from the moment all sessions are Established:
+ *   ingest     time until bgpd has read every UPDATE off the upstream
+ *              sockets, and the resulting prefixes/sec
+ *   best-path  time until the first downstream peer holds the final
+ *              best path for every prefix
+ *   advertise  time until all M downstream peers do
+ *   peak RSS   VmHWM of the bgpd process
+ *
+ * Peers bind 127.0.0.10 and up (upstream) and 127.0.0.100 and up
+ * (downstream), so up to 90 and 155 of them respectively.  Anything
+ * after "--" is passed on to bgpd, e.g. "-- -t 4" for its I/O threads.
+ *
+ * This file is part of Quagga.
+ *
+ * Quagga is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2, or (at your option) any
+ * later version.
+ *
+ * Quagga is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Quagga; see the file COPYING.  If not, write to the Free
+ * Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ * 02111-1307, USA.
+ */
+
+#include <zebra.h>
+
+#include <poll.h>
+#include <sys/wait.h>
+#ifdef GNU_LINUX
+#include <linux/sockios.h>
+#endif
+
+#include "log.h"
+
+#define BENCH_AS 65000
+#define UPSTREAM_AS 65100
+#define DOWNSTREAM_AS 65200
+#define UPSTREAM_ADDR 10
+#define DOWNSTREAM_ADDR 100
+
+#define BGP_HDR 19
+#define BGP_MAX 4096
+#define MSG_OPEN 1
+#define MSG_UPDATE 2
+#define MSG_NOTIFY 3
+#define MSG_KEEPALIVE 4
+
+#define PEER_BUF 65536
+#define KEEPALIVE_SECS 30
+#define SETUP_SECS 120
+
+enum peer_state { P_IDLE, P_CONNECTING, P_OPENSENT, P_OPENCONFIRM, P_ESTABLISHED };
+
+struct peer {
+	int idx;
+	int upstream;
+	int fd;
+	enum peer_state state;
+	double retry;     /* when to reconnect after a refused attempt */
+	double keepalive; /* when the next KEEPALIVE is due */
+
+	u_char ibuf[PEER_BUF];
+	size_t ilen;
+	u_char obuf[PEER_BUF];
+	size_t ohead, olen;
+
+	/* upstream: next prefix to announce */
+	unsigned long next;
+
+	/* downstream: prefixes holding the final best path */
+	u_char *best;
+	unsigned long nbest;
+	double done;
+};
+
+static const char *bgpd_path = "../bgpd/bgpd";
+static int nup = 2, ndown = 2;
+static unsigned long routes = 100000;
+static int port = 17179;
+static int verbose;
+static int announcing;
+
+static struct peer *peers;
+static int npeers;
+static pid_t bgpd_pid;
+static char tmpdir[] = "/tmp/bgp-bench.XXXXXX";
+static char conffile[64], pidfile[64], logfile[64];
+
+static double now(void) {
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void cleanup(void) {
+	if(bgpd_pid > 0) {
+		kill(bgpd_pid, SIGTERM);
+		waitpid(bgpd_pid, NULL, 0);
+		bgpd_pid = 0;
+	}
+	unlink(conffile);
+	unlink(pidfile);
+	if(!verbose) {
+		unlink(logfile);
+	}
+	rmdir(tmpdir);
+}
+
+static void die(const char *fmt, ...) {
+	va_list ap;
+
+	va_start(ap, fmt);
+	vfprintf(stderr, fmt, ap);
+	va_end(ap);
+	fputc('\n', stderr);
+	cleanup();
+	exit(1);
+}
+
+static struct in_addr peer_addr(const struct peer *p) {
+	struct in_addr a;
+
+	a.s_addr = htonl(INADDR_LOOPBACK & 0xffffff00) | htonl(p->upstream ? UPSTREAM_ADDR + p->idx : DOWNSTREAM_ADDR + p->idx);
+	return a;
+}
+
+static int peer_as(const struct peer *p) {
+	return p->upstream ? UPSTREAM_AS + p->idx : DOWNSTREAM_AS + p->idx;
+}
+
+static void write_config(void) {
+	FILE *f;
+	int i;
+
+	f = fopen(conffile, "w");
+	if(!f) {
+		die("%s: %s", conffile, safe_strerror(errno));
+	}
+
+	fprintf(f, "hostname bgp-bench\n");
+	fprintf(f, "log file %s\n", logfile);
+	fprintf(f, "!\nrouter bgp %d\n", BENCH_AS);
+	fprintf(f, " bgp router-id 10.255.255.1\n");
+	for(i = 0; i < npeers; i++) {
+		const char *addr = inet_ntoa(peer_addr(&peers[i]));
+
+		fprintf(f, " neighbor %s remote-as %d\n", addr, peer_as(&peers[i]));
+		fprintf(f, " neighbor %s passive\n", addr);
+		if(!peers[i].upstream) {
+			/* measure bgpd, not the MRAI */
+			fprintf(f, " neighbor %s advertisement-interval 0\n", addr);
+		}
+	}
+	fprintf(f, "!\n");
+	fclose(f);
+}
+
+static void start_bgpd(char **extra, int nextra) {
+	char portstr[16];
+	char *argv[32];
+	int argc = 0, i;
+
+	snprintf(portstr, sizeof(portstr), "%d", port);
+	argv[argc++] = (char *) bgpd_path;
+	argv[argc++] = (char *) "-f";
+	argv[argc++] = conffile;
+	argv[argc++] = (char *) "-i";
+	argv[argc++] = pidfile;
+	argv[argc++] = (char *) "-z";
+	argv[argc++] = (char *) "/nonexistent";
+	argv[argc++] = (char *) "-l";
+	argv[argc++] = (char *) "127.0.0.1";
+	argv[argc++] = (char *) "-p";
+	argv[argc++] = portstr;
+	argv[argc++] = (char *) "-P";
+	argv[argc++] = (char *) "0";
+	argv[argc++] = (char *) "-S";
+	for(i = 0; i < nextra && argc < 31; i++) {
+		argv[argc++] = extra[i];
+	}
+	argv[argc] = NULL;
+
+	bgpd_pid = fork();
+	if(bgpd_pid < 0) {
+		die("fork: %s", safe_strerror(errno));
+	}
+	if(bgpd_pid == 0) {
+		int null = open("/dev/null", O_RDWR);
+
+		if(null >= 0 && !verbose) {
+			dup2(null, STDOUT_FILENO);
+			dup2(null, STDERR_FILENO);
+		}
+		execv(bgpd_path, argv);
+		_exit(127);
+	}
+}
+
+static long bgpd_status_kb(const char *field) {
+	char path[64], line[128];
+	size_t flen = strlen(field);
+	long kb = -1;
+	FILE *f;
+
+	snprintf(path, sizeof(path), "/proc/%d/status", (int) bgpd_pid);
+	f = fopen(path, "r");
+	if(!f) {
+		return -1;
+	}
+	while(fgets(line, sizeof(line), f)) {
+		if(!strncmp(line, field, flen) && line[flen] == ':') {
+			kb = strtol(line + flen + 1, NULL, 10);
+			break;
+		}
+	}
+	fclose(f);
+	return kb;
+}
+
+/* Output buffering */
+
+static u_char *msg_begin(struct peer *p, size_t room) {
+	if(p->ohead + p->olen + room > PEER_BUF) {
+		memmove(p->obuf, p->obuf + p->ohead, p->olen);
+		p->ohead = 0;
+	}
+	if(p->olen + room > PEER_BUF) {
+		return NULL;
+	}
+	return p->obuf + p->ohead + p->olen;
+}
+
+static void msg_end(struct peer *p, u_char *m, size_t len, u_char type) {
+	memset(m, 0xff, 16);
+	m[16] = len >> 8;
+	m[17] = len & 0xff;
+	m[18] = type;
+	p->olen += len;
+}
+
+static void send_open(struct peer *p) {
+	u_char *m = msg_begin(p, BGP_HDR + 10);
+	struct in_addr id = peer_addr(p);
+
+	m[BGP_HDR] = 4;
+	m[BGP_HDR + 1] = peer_as(p) >> 8;
+	m[BGP_HDR + 2] = peer_as(p) & 0xff;
+	m[BGP_HDR + 3] = 180 >> 8;
+	m[BGP_HDR + 4] = 180 & 0xff;
+	memcpy(m + BGP_HDR + 5, &id, 4);
+	m[BGP_HDR + 9] = 0; /* no capabilities: 2-byte ASNs, IPv4 unicast */
+	msg_end(p, m, BGP_HDR + 10, MSG_OPEN);
+}
+
+static void send_keepalive(struct peer *p) {
+	u_char *m = msg_begin(p, BGP_HDR);
+
+	if(m) {
+		msg_end(p, m, BGP_HDR, MSG_KEEPALIVE);
+	}
+	p->keepalive = now() + KEEPALIVE_SECS;
+}
+
+/* Fill the output buffer with UPDATEs for the next stretch of the
+ * table, as many /24s per message as fit, starting at 11.0.0.0/24. */
+static void fill_updates(struct peer *p) {
+	int hops = nup - p->idx;
+	size_t attrlen = 4 + (3 + 2 + 2 * hops) + 7;
+	u_char *m, *a;
+	size_t len;
+	int i;
+
+	while(p->next < routes && (m = msg_begin(p, BGP_MAX))) {
+		a = m + BGP_HDR;
+		*a++ = 0; /* no withdrawn routes */
+		*a++ = 0;
+		*a++ = attrlen >> 8;
+		*a++ = attrlen & 0xff;
+
+		*a++ = 0x40; /* ORIGIN IGP */
+		*a++ = 1;
+		*a++ = 1;
+		*a++ = 0;
+
+		*a++ = 0x40; /* AS_PATH, one AS_SEQUENCE of the peer's AS */
+		*a++ = 2;
+		*a++ = 2 + 2 * hops;
+		*a++ = 2;
+		*a++ = hops;
+		for(i = 0; i < hops; i++) {
+			*a++ = peer_as(p) >> 8;
+			*a++ = peer_as(p) & 0xff;
+		}
+
+		*a++ = 0x40; /* NEXT_HOP 10.0.<idx>.1 */
+		*a++ = 3;
+		*a++ = 4;
+		*a++ = 10;
+		*a++ = 0;
+		*a++ = p->idx;
+		*a++ = 1;
+
+		len = a - m;
+		while(p->next < routes && len + 4 <= BGP_MAX) {
+			u_int32_t net = (11 << 16) + p->next++;
+
+			*a++ = 24;
+			*a++ = net >> 16;
+			*a++ = net >> 8;
+			*a++ = net;
+			len += 4;
+		}
+		msg_end(p, m, len, MSG_UPDATE);
+	}
+}
+
+/* Input parsing */
+
+/* Downstream UPDATEs: count prefixes whose path is the final best,
+ * BENCH_AS followed by the last upstream peer's AS. */
+static void parse_update(struct peer *p, const u_char *m, size_t len) {
+	const u_char *end = m + len, *a, *aend;
+	size_t wlen, alen;
+	int final = 0;
+
+	m += BGP_HDR;
+	if(m + 2 > end) {
+		return;
+	}
+	wlen = (m[0] << 8) | m[1];
+	m += 2 + wlen;
+	if(m + 2 > end) {
+		return;
+	}
+	alen = (m[0] << 8) | m[1];
+	a = m + 2;
+	aend = a + alen;
+	if(aend > end) {
+		return;
+	}
+
+	while(a + 3 <= aend) {
+		u_char flags = a[0], type = a[1];
+		size_t l, hl = (flags & 0x10) ? 4 : 3;
+
+		if(a + hl > aend) {
+			return;
+		}
+		l = (flags & 0x10) ? ((a[2] << 8) | a[3]) : a[2];
+		if(type == 2) {
+			const u_char *s = a + hl, *send = s + l;
+			int hops = 0;
+
+			while(s + 2 <= send) {
+				hops += s[1];
+				s += 2 + 2 * s[1];
+			}
+			final = hops == 2;
+		}
+		a += hl + l;
+	}
+
+	if(!final) {
+		return;
+	}
+
+	for(a = aend; a < end;) {
+		u_char plen = a[0];
+		size_t bytes = (plen + 7) / 8;
+		unsigned long k;
+
+		if(a + 1 + bytes > end) {
+			break;
+		}
+		if(plen == 24 && a[1] >= 11) {
+			k = ((unsigned long) (a[1] - 11) << 16) | (a[2] << 8) | a[3];
+			if(k < routes && !p->best[k]) {
+				p->best[k] = 1;
+				p->nbest++;
+			}
+		}
+		a += 1 + bytes;
+	}
+
+	if(p->nbest == routes && !p->done) {
+		p->done = now();
+	}
+}
+
+static void peer_reset(struct peer *p, const char *why) {
+	if(verbose) {
+		fprintf(stderr, "%s: %s\n", inet_ntoa(peer_addr(p)), why);
+	}
+	if(p->state == P_ESTABLISHED) {
+		die("%s: session lost: %s", inet_ntoa(peer_addr(p)), why);
+	}
+	close(p->fd);
+	p->fd = -1;
+	p->state = P_IDLE;
+	p->ilen = p->ohead = p->olen = 0;
+	p->retry = now() + 1;
+}
+
+static void peer_input(struct peer *p) {
+	size_t off = 0;
+	ssize_t n;
+
+	n = read(p->fd, p->ibuf + p->ilen, PEER_BUF - p->ilen);
+	if(n < 0 && (errno == EAGAIN || errno == EINTR)) {
+		return;
+	}
+	if(n <= 0) {
+		peer_reset(p, n ? safe_strerror(errno) : "closed");
+		return;
+	}
+	p->ilen += n;
+
+	while(p->ilen - off >= BGP_HDR) {
+		const u_char *m = p->ibuf + off;
+		size_t len = (m[16] << 8) | m[17];
+
+		if(len < BGP_HDR || len > BGP_MAX) {
+			peer_reset(p, "bad message length");
+			return;
+		}
+		if(p->ilen - off < len) {
+			break;
+		}
+
+		switch(m[18]) {
+			case MSG_OPEN:
+				p->state = P_OPENCONFIRM;
+				send_keepalive(p);
+				break;
+			case MSG_KEEPALIVE:
+				if(p->state == P_OPENCONFIRM) {
+					p->state = P_ESTABLISHED;
+				}
+				break;
+			case MSG_UPDATE:
+				if(!p->upstream) {
+					parse_update(p, m, len);
+				}
+				break;
+			case MSG_NOTIFY:
+				peer_reset(p, "NOTIFICATION received");
+				return;
+		}
+		off += len;
+	}
+
+	memmove(p->ibuf, p->ibuf + off, p->ilen - off);
+	p->ilen -= off;
+}
+
+static void peer_output(struct peer *p) {
+	ssize_t n;
+
+	if(p->upstream && announcing) {
+		fill_updates(p);
+	}
+	if(!p->olen) {
+		return;
+	}
+
+	n = write(p->fd, p->obuf + p->ohead, p->olen);
+	if(n < 0) {
+		if(errno != EAGAIN && errno != EINTR) {
+			peer_reset(p, safe_strerror(errno));
+		}
+		return;
+	}
+	p->ohead += n;
+	p->olen -= n;
+	if(!p->olen) {
+		p->ohead = 0;
+	}
+}
+
+static void peer_connect(struct peer *p) {
+	struct sockaddr_in sin;
+
+	p->fd = socket(AF_INET, SOCK_STREAM, 0);
+	if(p->fd < 0) {
+		die("socket: %s", safe_strerror(errno));
+	}
+	fcntl(p->fd, F_SETFL, O_NONBLOCK);
+
+	memset(&sin, 0, sizeof(sin));
+	sin.sin_family = AF_INET;
+	sin.sin_addr = peer_addr(p);
+	if(bind(p->fd, (struct sockaddr *) &sin, sizeof(sin)) < 0) {
+		die("bind %s: %s", inet_ntoa(sin.sin_addr), safe_strerror(errno));
+	}
+
+	sin.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	sin.sin_port = htons(port);
+	if(connect(p->fd, (struct sockaddr *) &sin, sizeof(sin)) < 0 && errno != EINPROGRESS) {
+		peer_reset(p, safe_strerror(errno));
+		return;
+	}
+	p->state = P_CONNECTING;
+}
+
+/* One pass of the event loop. */
+static void run_once(int timeout_ms) {
+	struct pollfd pfd[npeers];
+	double t = now();
+	int i;
+
+	for(i = 0; i < npeers; i++) {
+		struct peer *p = &peers[i];
+
+		if(p->state == P_IDLE && t >= p->retry) {
+			peer_connect(p);
+		}
+		if(p->state == P_ESTABLISHED && t >= p->keepalive) {
+			send_keepalive(p);
+		}
+
+		pfd[i].fd = p->fd;
+		pfd[i].events = 0;
+		if(p->fd < 0) {
+			continue;
+		}
+		if(p->state == P_CONNECTING) {
+			pfd[i].events = POLLOUT;
+		} else {
+			pfd[i].events = POLLIN;
+			if(p->olen || (p->upstream && announcing && p->next < routes)) {
+				pfd[i].events |= POLLOUT;
+			}
+		}
+	}
+
+	if(poll(pfd, npeers, timeout_ms) < 0 && errno != EINTR) {
+		die("poll: %s", safe_strerror(errno));
+	}
+
+	for(i = 0; i < npeers; i++) {
+		struct peer *p = &peers[i];
+
+		if(p->fd < 0 || !pfd[i].revents) {
+			continue;
+		}
+		if(p->state == P_CONNECTING) {
+			int err = 0;
+			socklen_t errlen = sizeof(err);
+
+			getsockopt(p->fd, SOL_SOCKET, SO_ERROR, &err, &errlen);
+			if(err) {
+				peer_reset(p, safe_strerror(err));
+				continue;
+			}
+			p->state = P_OPENSENT;
+			send_open(p);
+		}
+		if(pfd[i].revents & (POLLIN | POLLHUP | POLLERR)) {
+			peer_input(p);
+		}
+		if(p->fd >= 0 && (pfd[i].revents & POLLOUT)) {
+			peer_output(p);
+		}
+	}
+}
+
+/* Whether bgpd has read everything sent to it. */
+static int upstream_drained(void) {
+	int i;
+
+	for(i = 0; i < nup; i++) {
+		struct peer *p = &peers[i];
+
+		if(p->next < routes || p->olen) {
+			return 0;
+		}
+#ifdef SIOCOUTQ
+		{
+			int queued = 0;
+
+			if(ioctl(p->fd, SIOCOUTQ, &queued) == 0 && queued > 0) {
+				return 0;
+			}
+		}
+#endif
+	}
+	return 1;
+}
+
+static void usage(const char *progname) {
+	fprintf(stderr,
+	        "Usage: %s [-b bgpd] [-n upstream] [-m downstream] [-r routes] "
+	        "[-p port] [-v] [-- bgpd options]\n",
+	        progname);
+	exit(1);
+}
+
+int main(int argc, char **argv) {
+	double t0, t_ingest = 0, t_best = 0, t_adv = 0, deadline;
+	int i, opt, established;
+
+	while((opt = getopt(argc, argv, "b:n:m:r:p:vh")) != -1) {
+		switch(opt) {
+			case 'b': bgpd_path = optarg; break;
+			case 'n': nup = atoi(optarg); break;
+			case 'm': ndown = atoi(optarg); break;
+			case 'r': routes = strtoul(optarg, NULL, 10); break;
+			case 'p': port = atoi(optarg); break;
+			case 'v': verbose = 1; break;
+			default: usage(argv[0]);
+		}
+	}
+	if(nup < 1 || nup > 90 || ndown < 1 || ndown > 155 || routes < 1 || routes > (224 - 11) << 16) {
+		usage(argv[0]);
+	}
+
+	signal(SIGPIPE, SIG_IGN);
+
+	npeers = nup + ndown;
+	peers = calloc(npeers, sizeof(struct peer));
+	for(i = 0; i < npeers; i++) {
+		peers[i].upstream = i < nup;
+		peers[i].idx = i < nup ? i : i - nup;
+		peers[i].fd = -1;
+		if(!peers[i].upstream) {
+			peers[i].best = calloc(routes, 1);
+		}
+	}
+
+	if(!mkdtemp(tmpdir)) {
+		fprintf(stderr, "mkdtemp: %s\n", safe_strerror(errno));
+		return 1;
+	}
+	snprintf(conffile, sizeof(conffile), "%s/bgpd.conf", tmpdir);
+	snprintf(pidfile, sizeof(pidfile), "%s/bgpd.pid", tmpdir);
+	snprintf(logfile, sizeof(logfile), "%s/bgpd.log", tmpdir);
+	write_config();
+	start_bgpd(argv + optind, argc - optind);
+
+	printf("bgpd %s: %d upstream, %d downstream, %lu prefixes\n", bgpd_path, nup, ndown, routes);
+
+	/* Bring every session up before anything is announced, so that
+	 * startup costs stay out of the measurements. */
+	deadline = now() + SETUP_SECS;
+	do {
+		if(now() > deadline) {
+			die("sessions did not come up in %d seconds", SETUP_SECS);
+		}
+		if(waitpid(bgpd_pid, NULL, WNOHANG) == bgpd_pid) {
+			bgpd_pid = 0;
+			die("bgpd exited during startup");
+		}
+		run_once(100);
+		for(established = 0, i = 0; i < npeers; i++) {
+			established += peers[i].state == P_ESTABLISHED;
+		}
+	} while(established < npeers);
+
+	announcing = 1;
+	t0 = now();
+
+	while(!t_adv) {
+		double t;
+
+		run_once(10);
+		t = now();
+
+		if(!t_ingest && upstream_drained()) {
+			t_ingest = t;
+		}
+		for(t_adv = t, i = nup; i < npeers; i++) {
+			if(!peers[i].done) {
+				t_adv = 0;
+			} else if(!t_best || peers[i].done < t_best) {
+				t_best = peers[i].done;
+			}
+		}
+		if(waitpid(bgpd_pid, NULL, WNOHANG) == bgpd_pid) {
+			bgpd_pid = 0;
+			die("bgpd exited during the run");
+		}
+	}
+	if(!t_ingest) {
+		t_ingest = t_adv;
+	}
+
+	printf("ingest:     %8.3f s  %.0f prefixes/s\n", t_ingest - t0, (double) nup * routes / (t_ingest - t0));
+	printf("best-path:  %8.3f s\n", t_best - t0);
+	printf("advertise:  %8.3f s  to %d peers\n", t_adv - t0, ndown);
+	printf("peak RSS:   %8ld KiB\n", bgpd_status_kb("VmHWM"));
+
+	cleanup();
+	return 0;
+}
@@ -460,6 +460,21 @@ static struct test_segment misc_segments[] = {
 		{ CAPABILITY_CODE_DYNAMIC, 0x0 },
 		2, SHOULD_PARSE,
 	 },
+	{
+		"ext-msg", "Extended message capability",
+		{ CAPABILITY_CODE_EXT_MESSAGE, 0x0 },
+		2, SHOULD_PARSE,
+	 },
+	{
+		"addpath", "Add-Path capability, IPv4 unicast send and receive",
+		{ CAPABILITY_CODE_ADDPATH, CAPABILITY_CODE_ADDPATH_LEN, 0x0, 0x1, 0x1, 0x3 },
+		6, SHOULD_PARSE,
+	 },
+	{
+		"addpath-short", "Add-Path capability, tuple cut short",
+		{ CAPABILITY_CODE_ADDPATH, 0x3, 0x0, 0x1, 0x1 },
+		5, SHOULD_ERR,
+	 },
 	{ NULL, NULL, { 0 }, 0, 0 }
 };
 
@@ -645,6 +660,7 @@ static as_t asn = 100;
 
 int main(void) {
 	struct peer *peer;
+	union sockunion su;
 	int i, j;
 
 	conf_bgp_debug_fsm = -1UL;
@@ -670,7 +686,8 @@ int main(void) {
 		return -1;
 	}
 
-	peer = peer_create_accept(bgp);
+	memset(&su, 0, sizeof(su));
+	peer = peer_create_accept(bgp, &su);
 	peer->host = (char *) "foo";
 
 	for(i = AFI_IP; i < AFI_MAX; i++) {
@@ -0,0 +1,362 @@
+/*
+ * Test program to check that community-lists long enough to be matched
+ * through their index, with expanded entries matched as plain strings
+ * where they can be, still decide as walking the whole list in order
+ * with regexec() does, for communities, large and extended communities
+ * alike, while entries are added and deleted.
+ *
+ * This file is part of Quagga
+ *
+ * Quagga is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2, or (at your option) any
+ * later version.
+ *
+ * Quagga is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Quagga; see the file COPYING.  If not, write to the Free
+ * Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ * 02111-1307, USA.
+ */
+
+#include <zebra.h>
+
+#include <stdio.h>
+
+#include "vty.h"
+#include "memory.h"
+#include "filter.h"
+#include "prng.h"
+
+#include "bgpd/bgpd.h"
+#include "bgpd/bgp_aspath.h"
+#include "bgpd/bgp_aspath.h"
+#include "bgpd/bgp_regex.h"
+#include "bgpd/bgp_community.h"
+#include "bgpd/bgp_ecommunity.h"
+#include "bgpd/bgp_lcommunity.h"
+#include "bgpd/bgp_clist.h"
+
+#define ENTRIES 300
+#define ROUTES 20
+
+/* need these to link in libbgp */
+struct zebra_privs_t *bgpd_privs = NULL;
+struct thread_master *master = NULL;
+
+enum { COM, LCOM, ECOM, KINDS };
+
+/* A list holds standard or expanded entries, not both: list l is of
+   kind l / 2, and expanded if l is odd. */
+#define LISTS (KINDS * 2)
+
+static const char *names[LISTS] = { "c", "cx", "l", "lx", "e", "ex" };
+static const int masters[KINDS] = { COMMUNITY_LIST_MASTER, LARGE_COMMUNITY_LIST_MASTER, EXTCOMMUNITY_LIST_MASTER };
+static const int styles[LISTS] = { COMMUNITY_LIST_STANDARD,	  COMMUNITY_LIST_EXPANDED,	  LARGE_COMMUNITY_LIST_STANDARD,
+				   LARGE_COMMUNITY_LIST_EXPANDED, EXTCOMMUNITY_LIST_STANDARD, EXTCOMMUNITY_LIST_EXPANDED };
+
+static struct community_list_handler *ch;
+static struct prng *prng;
+
+static struct entry {
+	char str[64];
+	int direct;
+	int style;
+	int present;
+} entries[LISTS][ENTRIES];
+
+/* Values are drawn from a small pool, so that routes hit entries. */
+static int random_value(char *buf, size_t size, int kind) {
+	switch(kind) {
+		case COM:
+			if(prng_range(prng, 20) == 0) {
+				return snprintf(buf, size, "no-export");
+			}
+			return snprintf(buf, size, "%u:%u", 1 + prng_range(prng, 3), 1 + prng_range(prng, 30));
+		case LCOM: return snprintf(buf, size, "%u:%u:%u", 1 + prng_range(prng, 2), 1 + prng_range(prng, 3), 1 + prng_range(prng, 15));
+		default: return snprintf(buf, size, "rt %u:%u", 1 + prng_range(prng, 3), 1 + prng_range(prng, 30));
+	}
+}
+
+/* A part of a value: a whole one, or the front or back of one */
+static void random_literal(char *buf, size_t size, int kind) {
+	static const char *front[] = { "", "^", "_" }, *back[] = { "", "$", "_" };
+	char val[32];
+	char *colon;
+
+	random_value(val, sizeof(val), kind);
+	colon = strrchr(val, ':');
+	if(colon && prng_range(prng, 4) == 0) {
+		colon[1] = '\0';
+	} else if(colon && prng_range(prng, 4) == 0) {
+		memmove(val, colon, strlen(colon) + 1);
+	}
+	snprintf(buf, size, "%s%s%s", front[prng_range(prng, 3)], val, back[prng_range(prng, 3)]);
+}
+
+static void random_entry(struct entry *e, int l) {
+	unsigned int r = prng_range(prng, 100);
+	int kind = l / 2;
+	int len;
+
+	memset(e, 0, sizeof(struct entry));
+	e->direct = prng_range(prng, 2) ? COMMUNITY_PERMIT : COMMUNITY_DENY;
+	e->style = styles[l];
+
+	if(!(l & 1)) {
+		if(kind == COM && r < 2) {
+			strcpy(e->str, "internet");
+			return;
+		}
+		len = random_value(e->str, sizeof(e->str), kind);
+		if(r >= 85) {
+			e->str[len++] = ' ';
+			random_value(e->str + len, sizeof(e->str) - len, kind);
+		}
+		return;
+	}
+
+	if(r < 80) {
+		random_literal(e->str, sizeof(e->str), kind);
+	} else if(r < 90) {
+		snprintf(e->str, sizeof(e->str), "^%u:[0-9]+", 1 + prng_range(prng, 3));
+	} else {
+		snprintf(e->str, sizeof(e->str), "_%u:1[0-9]_", 1 + prng_range(prng, 3));
+	}
+}
+
+static int entry_set(int l, struct entry *e, int set) {
+	switch(l / 2) {
+		case COM: return (set ? community_list_set : community_list_unset)(ch, names[l], e->str, e->direct, e->style);
+		case LCOM: return (set ? lcommunity_list_set : lcommunity_list_unset)(ch, names[l], e->str, e->direct, e->style);
+		default: return (set ? extcommunity_list_set : extcommunity_list_unset)(ch, names[l], e->str, e->direct, e->style);
+	}
+}
+
+static void entry_add(int l, int i) {
+	struct entry *e = &entries[l][i];
+
+	random_entry(e, l);
+	assert(entry_set(l, e, 1) == 0);
+	e->present = 1;
+}
+
+/* Unsetting a duplicate that was never added fails, but removes none */
+static void entry_del(int l, int i) {
+	entry_set(l, &entries[l][i], 0);
+	entries[l][i].present = 0;
+}
+
+/* The list walked in order, as it was matched before it had an index. */
+static int ref_regexec(struct community_entry *entry, const char *str) {
+	return regexec(&entry->reg->reg, str, 0, NULL, 0) == 0;
+}
+
+static int ref_match(struct community_list *list, int kind, void *com, int exact) {
+	struct community_entry *entry;
+	int match;
+
+	for(entry = list->head; entry; entry = entry->next) {
+		switch(entry->style) {
+			case COMMUNITY_LIST_STANDARD:
+				match = community_include(entry->u.com, COMMUNITY_INTERNET) || (exact ? community_cmp(com, entry->u.com) : community_match(com, entry->u.com));
+				break;
+			case COMMUNITY_LIST_EXPANDED: match = ref_regexec(entry, com ? community_str(com) : ""); break;
+			case LARGE_COMMUNITY_LIST_STANDARD: match = lcommunity_match(com, entry->u.lcom); break;
+			case LARGE_COMMUNITY_LIST_EXPANDED: match = ref_regexec(entry, com ? lcommunity_str(com) : ""); break;
+			case EXTCOMMUNITY_LIST_STANDARD: match = ecommunity_match(com, entry->u.ecom); break;
+			default: match = ref_regexec(entry, com ? ecommunity_str(com) : ""); break;
+		}
+		if(match) {
+			return entry->direct == COMMUNITY_PERMIT;
+		}
+	}
+	return 0;
+}
+
+/* Whether the list deletes value i of the route */
+static int ref_delete(struct community_list *list, int kind, void *com, int i) {
+	struct community_entry *entry;
+	char str[64];
+	u_int32_t val = 0;
+	u_char *ptr = NULL;
+	int match;
+
+	if(kind == COM) {
+		val = community_val_get(com, i);
+		if(val == COMMUNITY_NO_EXPORT) {
+			strcpy(str, "no-export");
+		} else {
+			snprintf(str, sizeof(str), "%u:%u", val >> 16, val & 0xffff);
+		}
+	} else {
+		ptr = ((struct lcommunity *) com)->val + i * LCOMMUNITY_SIZE;
+		snprintf(str, sizeof(str), "%u:%u:%u", (ptr[0] << 24) | (ptr[1] << 16) | (ptr[2] << 8) | ptr[3], (ptr[4] << 24) | (ptr[5] << 16) | (ptr[6] << 8) | ptr[7],
+		         (ptr[8] << 24) | (ptr[9] << 16) | (ptr[10] << 8) | ptr[11]);
+	}
+
+	for(entry = list->head; entry; entry = entry->next) {
+		switch(entry->style) {
+			case COMMUNITY_LIST_STANDARD: match = community_include(entry->u.com, COMMUNITY_INTERNET) || community_include(entry->u.com, val); break;
+			case LARGE_COMMUNITY_LIST_STANDARD: match = lcommunity_include(entry->u.lcom, ptr); break;
+			default: match = ref_regexec(entry, str); break;
+		}
+		if(match) {
+			return entry->direct == COMMUNITY_PERMIT;
+		}
+	}
+	return 0;
+}
+
+static void check_delete(struct community_list *list, int kind, void *com) {
+	u_char expect[ROUTES * LCOMMUNITY_SIZE];
+	int len = kind == COM ? sizeof(u_int32_t) : LCOMMUNITY_SIZE;
+	int size, n = 0, i;
+	u_char *val;
+
+	if(kind == COM) {
+		size = ((struct community *) com)->size;
+		val = (u_char *) ((struct community *) com)->val;
+	} else {
+		size = ((struct lcommunity *) com)->size;
+		val = ((struct lcommunity *) com)->val;
+	}
+	for(i = 0; i < size; i++) {
+		if(!ref_delete(list, kind, com, i)) {
+			memcpy(expect + n++ * len, val + i * len, len);
+		}
+	}
+
+	if(kind == COM) {
+		struct community *res = community_list_match_delete(community_dup(com), list);
+
+		assert(res->size == n);
+		assert(n == 0 || memcmp(res->val, expect, n * len) == 0);
+		community_free(res);
+	} else {
+		struct lcommunity *res = lcommunity_list_match_delete(lcommunity_dup(com), list);
+
+		assert(res->size == n);
+		assert(n == 0 || memcmp(res->val, expect, n * len) == 0);
+		lcommunity_free(&res);
+	}
+}
+
+static void check_routes(int l, int routes) {
+	struct community_list *list = community_list_lookup(ch, names[l], masters[l / 2]);
+	int kind = l / 2;
+	char str[ROUTES * 16];
+	void *com;
+	int i, j, len;
+
+	if(!list) {
+		return;
+	}
+
+	for(i = 0; i < routes; i++) {
+		/* mostly one to four values, sometimes just one */
+		len = 0;
+		str[0] = '\0';
+		for(j = prng_range(prng, 5); j >= 0; j--) {
+			len += random_value(str + len, sizeof(str) - len, kind);
+			str[len++] = ' ';
+			str[len] = '\0';
+		}
+		if(len) {
+			str[len - 1] = '\0';
+		}
+
+		switch(kind) {
+			case COM:
+				com = community_str2com(str);
+				assert(community_list_match(com, list) == ref_match(list, kind, com, 0));
+				assert(community_list_exact_match(com, list) == ref_match(list, kind, com, 1));
+				if(com) {
+					check_delete(list, kind, com);
+					community_free(com);
+				}
+				break;
+			case LCOM:
+				com = lcommunity_str2com(str);
+				assert(lcommunity_list_match(com, list) == ref_match(list, kind, com, 0));
+				if(com) {
+					check_delete(list, kind, com);
+					lcommunity_free((struct lcommunity **) &com);
+				}
+				break;
+			default:
+				com = ecommunity_str2com(str, 0, 1);
+				assert(ecommunity_list_match(com, list) == ref_match(list, kind, com, 0));
+				if(com) {
+					ecommunity_free((struct ecommunity **) &com);
+				}
+				break;
+		}
+	}
+
+	/* and routes with no such attribute */
+	switch(kind) {
+		case COM:
+			assert(community_list_match(NULL, list) == ref_match(list, kind, NULL, 0));
+			assert(community_list_exact_match(NULL, list) == ref_match(list, kind, NULL, 1));
+			break;
+		case LCOM: assert(lcommunity_list_match(NULL, list) == ref_match(list, kind, NULL, 0)); break;
+		default: assert(ecommunity_list_match(NULL, list) == ref_match(list, kind, NULL, 0)); break;
+	}
+}
+
+int main(int argc, char **argv) {
+	int l, i, round;
+
+	prng = prng_new(0);
+	community_init();
+	ecommunity_init();
+	lcommunity_init();
+	ch = community_list_init();
+
+	for(l = 0; l < LISTS; l++) {
+		for(i = 0; i < ENTRIES; i++) {
+			entry_add(l, i);
+
+			/* across the switch from walking the list to the index */
+			if(i < 20 || i % 10 == 0) {
+				check_routes(l, ROUTES);
+			}
+		}
+		check_routes(l, ROUTES * 10);
+
+		for(round = 0; round < 4; round++) {
+			for(i = 0; i < ENTRIES; i++) {
+				if(prng_range(prng, 3)) {
+					continue;
+				}
+				if(entries[l][i].present) {
+					entry_del(l, i);
+				} else {
+					entry_add(l, i);
+				}
+			}
+			check_routes(l, ROUTES * 10);
+		}
+
+		/* and down to nothing again */
+		for(i = 0; i < ENTRIES; i++) {
+			if(entries[l][i].present) {
+				entry_del(l, i);
+			}
+			if(i >= ENTRIES - 20) {
+				check_routes(l, ROUTES);
+			}
+		}
+		assert(community_list_lookup(ch, names[l], masters[l / 2]) == NULL);
+	}
+	printf("Community-list matches OK.\n");
+
+	community_list_terminate(ch);
+	prng_free(prng);
+	return 0;
+}
@@ -932,6 +932,7 @@ static as_t asn = 100;
 
 int main(void) {
 	struct peer *peer;
+	union sockunion su;
 	int i, j;
 
 	conf_bgp_debug_fsm = -1UL;
@@ -960,7 +961,8 @@ int main(void) {
 		return -1;
 	}
 
-	peer = peer_create_accept(bgp);
+	memset(&su, 0, sizeof(su));
+	peer = peer_create_accept(bgp, &su);
 	peer->host = (char *) "foo";
 	peer->status = Established;
 
@@ -27,6 +27,7 @@
 #include "stream.h"
 #include "privs.h"
 #include "linklist.h"
+#include "hash.h"
 #include "memory.h"
 #include "zclient.h"
 #include "filter.h"
@@ -96,6 +97,7 @@ static struct bgp *bgp_create_fake(as_t *as, const char *name) {
 
 	bgp->peer = list_new();
 	//bgp->peer->cmp = (int (*)(void *, void *)) peer_cmp;
+	bgp->peerhash = hash_create(NULL, NULL); /* no peer goes in */
 
 	bgp->group = list_new();
 	//bgp->group->cmp = (int (*)(void *, void *)) peer_group_cmp;
@@ -103,6 +105,8 @@ static struct bgp *bgp_create_fake(as_t *as, const char *name) {
 	bgp->rsclient = list_new();
 	//bgp->rsclient->cmp = (int (*)(void*, void*)) peer_cmp;
 
+	bgp->update_groups = list_new();
+
 	for(afi = AFI_IP; afi < AFI_MAX; afi++) {
 		for(safi = SAFI_UNICAST; safi < SAFI_MAX; safi++) {
 			bgp->route[afi][safi] = bgp_table_init(afi, safi);
@@ -232,13 +236,11 @@ static int setup_bgp_mp_list(testcase_t *t) {
 }
 
 static int run_bgp_mp_list(testcase_t *t) {
-	struct list mp_list;
-	struct listnode *mp_node;
-	struct bgp_info *info;
+	struct bgp_mp_list mp_list;
 	int i;
 	int test_result = TEST_PASSED;
 	bgp_mp_list_init(&mp_list);
-	EXPECT_TRUE(listcount(&mp_list) == 0, test_result);
+	EXPECT_TRUE(mp_list.count == 0, test_result);
 
 	bgp_mp_list_add(&mp_list, &test_mp_list_info[1]);
 	bgp_mp_list_add(&mp_list, &test_mp_list_info[4]);
@@ -246,13 +248,13 @@ static int run_bgp_mp_list(testcase_t *t) {
 	bgp_mp_list_add(&mp_list, &test_mp_list_info[3]);
 	bgp_mp_list_add(&mp_list, &test_mp_list_info[0]);
 
-	for(i = 0, mp_node = mp_list.head; i < test_mp_list_info_count; i++, mp_node = listnextnode(mp_node)) {
-		info = listgetdata(mp_node);
-		EXPECT_TRUE(info == &test_mp_list_info[i], test_result);
+	EXPECT_TRUE(mp_list.count == (u_int32_t) test_mp_list_info_count, test_result);
+	for(i = 0; i < test_mp_list_info_count; i++) {
+		EXPECT_TRUE(mp_list.paths[i] == &test_mp_list_info[i], test_result);
 	}
 
 	bgp_mp_list_clear(&mp_list);
-	EXPECT_TRUE(listcount(&mp_list) == 0, test_result);
+	EXPECT_TRUE(mp_list.count == 0, test_result);
 
 	return test_result;
 }
@@ -292,7 +294,7 @@ static int setup_bgp_info_mpath_update(testcase_t *t) {
 
 static int run_bgp_info_mpath_update(testcase_t *t) {
 	struct bgp_info *new_best, *old_best, *mpath;
-	struct list mp_list;
+	struct bgp_mp_list mp_list;
 
 	test_mp_bgp.maxpaths[AFI_IP][SAFI_UNICAST].maxpaths_ebgp = 3;
 	test_mp_bgp.maxpaths[AFI_IP][SAFI_UNICAST].maxpaths_ibgp = 3;
@@ -38,6 +38,7 @@ static int failed = 0;
 /* specification for a test - what the results should be */
 struct test_spec {
 	const char *shouldbe; /* the string the path should parse to */
+	int rts;	      /* how many of the values are route targets */
 };
 
 /* test segments to parse and validate, and use for other tests */
@@ -51,22 +52,50 @@ static struct test_segment {
 	{/* 0 */
 	  "ipaddr",	  "rt 1.2.3.4:257",
 	  { ECOMMUNITY_ENCODE_IP, ECOMMUNITY_ROUTE_TARGET, 0x1, 0x2, 0x3, 0x4, 0x1, 0x1 },
-	  8,										       { "rt 1.2.3.4:257" }     },
+	  8,										       { "rt 1.2.3.4:257", 1 }  },
 	{ /* 1 */
 	  "ipaddr-so", "soo 1.2.3.4:257",
 	  { ECOMMUNITY_ENCODE_IP, ECOMMUNITY_SITE_ORIGIN, 0x1, 0x2, 0x3, 0x4, 0x1, 0x1 },
-	  8,										       { "soo 1.2.3.4:257" }	},
+	  8,										       { "soo 1.2.3.4:257", 0 }	},
 	{ /* 2 */
 	  "asn",	  "rt 23456:987654321",
 	  { ECOMMUNITY_ENCODE_AS, ECOMMUNITY_SITE_ORIGIN, 0x5b, 0xa0, 0x3a, 0xde, 0x68, 0xb1 },
-	  8,										       { "soo 23456:987654321" }},
+	  8,										       { "soo 23456:987654321", 0 }},
 	{ /* 3 */
 	  "asn4",	  "rt 168450976:4321",
 	  { ECOMMUNITY_ENCODE_AS4, ECOMMUNITY_SITE_ORIGIN, 0xa, 0xa, 0x5b, 0xa0, 0x10, 0xe1 },
-	  8,										       { "soo 168450976:4321" } },
+	  8,										       { "soo 168450976:4321", 0 } },
+	{ /* 4 */
+	  "mixed",	  "rt 1.2.3.4:257 soo 100:1 rt 100:2",
+	  { ECOMMUNITY_ENCODE_IP, ECOMMUNITY_ROUTE_TARGET, 0x1, 0x2, 0x3, 0x4, 0x1, 0x1,
+	    ECOMMUNITY_ENCODE_AS, ECOMMUNITY_SITE_ORIGIN, 0x0, 0x64, 0x0, 0x0, 0x0, 0x1,
+	    ECOMMUNITY_ENCODE_AS, ECOMMUNITY_ROUTE_TARGET, 0x0, 0x64, 0x0, 0x0, 0x0, 0x2 },
+	  24,										       { "rt 100:2 soo 100:1 rt 1.2.3.4:257", 2 } },
 	{ NULL,		 NULL,		      { 0 },				   0, { NULL }		 }
 };
 
+/* the cached route targets must be the RT values, in order */
+static int validate_rt(struct ecommunity *ecom, const struct test_spec *sp) {
+	int i, n = 0;
+
+	if(ecom->rt_size != sp->rts) {
+		return 0;
+	}
+	for(i = 0; i < ecom->size; i++) {
+		u_int8_t *pnt = ecom->val + i * ECOMMUNITY_SIZE;
+
+		if(ECOMMUNITY_IS_RT(pnt) && ecom->rt[n++] != ecommunity_val2u64(pnt)) {
+			return 0;
+		}
+	}
+	for(i = 1; i < ecom->rt_size; i++) {
+		if(ecom->rt[i - 1] >= ecom->rt[i]) {
+			return 0;
+		}
+	}
+	return n == ecom->rt_size;
+}
+
 /* validate the given aspath */
 static int validate(struct ecommunity *ecom, const struct test_spec *sp) {
 	int fails = 0;
@@ -94,6 +123,11 @@ static int validate(struct ecommunity *ecom, const struct test_spec *sp) {
 		       "    in->out %s\n",
 		       str1, (etmp && str2) ? str2 : "NULL");
 	}
+	if(!validate_rt(ecom, sp)) {
+		failed++;
+		fails++;
+		printf("route targets: %d of them, should be %d\n", ecom->rt_size, sp->rts);
+	}
 	ecommunity_free(&etmp);
 	XFREE(MTYPE_ECOMMUNITY_STR, str1);
 	XFREE(MTYPE_ECOMMUNITY_STR, str2);
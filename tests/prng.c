@@ -69,6 +69,11 @@ unsigned int prng_rand(struct prng *prng) {
 	return rv;
 }
 
+/* prng_rand() always leaves the lowest bit clear */
+unsigned int prng_range(struct prng *prng, unsigned int n) {
+	return (prng_rand(prng) >> 1) % n;
+}
+
 const char *prng_fuzz(struct prng *prng, const char *string, const char *charset, unsigned int operations) {
 	static char buf[256];
 	unsigned int charset_len;
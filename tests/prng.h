@@ -29,6 +29,8 @@ struct prng;
 
 struct prng *prng_new(unsigned long long seed);
 unsigned int prng_rand(struct prng *);
+/* a number below n */
+unsigned int prng_range(struct prng *, unsigned int n);
 const char *prng_fuzz(struct prng *, const char *string, const char *charset, unsigned int operations);
 void prng_free(struct prng *);
 
@@ -0,0 +1,613 @@
+/*
+ * OSPF SPF benchmark over generated topologies.
+ *
+ * Builds an area of N routers joined by numbered point-to-point links,
+ * as a grid, a two-tier Clos (leaves each linked to every spine) or a
+ * random connected graph of a given average degree, installs their
+ * router-LSAs straight into the LSDB, with summary-LSAs from a few ABRs
+ * and AS-external-LSAs from a few ASBRs, and runs ospfd's SPF timer on
+ * it, router 0 calculating.  After each SPF run every AS-external-LSA
+ * is calculated again, as the AS-external timer does.
+ *
+ * Each run is a calculation from scratch, or with -c one after a random
+ * link changed its cost, which the incremental SPF may take.  Reported
+ * per phase, from the area's SPF log, are the median and worst times of
+ * the runs, and the allocations a run made, counted over all types.
+ *
+ * This file is part of Quagga
+ *
+ * Quagga is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2, or (at your option) any
+ * later version.
+ *
+ * Quagga is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Quagga; see the file COPYING.  If not, write to the Free
+ * Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ * 02111-1307, USA.
+ */
+
+#include <zebra.h>
+
+#include <stdio.h>
+
+#include "thread.h"
+#include "log.h"
+#include "memory.h"
+#include "prefix.h"
+#include "linklist.h"
+#include "table.h"
+#include "command.h"
+#include "privs.h"
+#include "vrf.h"
+#include "if.h"
+#include "zclient.h"
+#include "prng.h"
+
+#include "ospfd/ospfd.h"
+#include "ospfd/ospf_interface.h"
+#include "ospfd/ospf_asbr.h"
+#include "ospfd/ospf_lsa.h"
+#include "ospfd/ospf_lsdb.h"
+#include "ospfd/ospf_spf.h"
+#include "ospfd/ospf_route.h"
+#include "ospfd/ospf_ase.h"
+#include "ospfd/ospf_zebra.h"
+
+/* need these to link in libospf */
+struct thread_master *master;
+struct zebra_privs_t ospfd_privs = {
+	.user = NULL,
+	.group = NULL,
+	.vty_group = NULL,
+};
+
+enum topo { TOPO_GRID, TOPO_CLOS, TOPO_RANDOM };
+
+static enum topo topo = TOPO_GRID;
+static unsigned int nrouters = 1000, degree = 4, nruns = 20;
+static unsigned int nabrs = 2, nsummaries = 1000, nasbrs = 2, nexternals = 10000;
+static int churn, equal_cost;
+
+static struct prng *prng;
+
+/* Link k joins routers a and b, on 10.0.0.0/8 + 4k/30: a is .1, b .2. */
+struct bench_link {
+	unsigned int r[2];
+	u_int16_t cost[2];
+};
+
+static struct bench_link *links;
+static unsigned int nlinks, maxlinks;
+
+/* the links of each router, in the order of its router-LSA */
+static unsigned int *adj, *adj_start;
+static u_char *rflags;
+static u_int32_t seqnum = 0x80000001;
+
+static struct ospf *ospf;
+static struct ospf_area *area;
+
+/* per run, usecs */
+struct bench_run {
+	unsigned long total, spf, ia, install, ase;
+	unsigned long spf_allocs, ase_allocs;
+	int incremental;
+};
+
+static struct bench_run *runs;
+static unsigned int run;
+static unsigned long allocs_before;
+
+static unsigned int rnd(unsigned int n) {
+	return prng_rand(prng) % n;
+}
+
+static struct in_addr router_id(unsigned int r) {
+	struct in_addr id;
+
+	id.s_addr = htonl(0x01000000 + r + 1);
+	return id;
+}
+
+static struct in_addr link_addr(unsigned int k, int side) {
+	struct in_addr addr;
+
+	addr.s_addr = htonl(0x0a000000 + k * 4 + side + 1);
+	return addr;
+}
+
+static unsigned long now_usec(void) {
+	struct timeval tv;
+
+	quagga_gettime(QUAGGA_CLK_MONOTONIC, &tv);
+	return tv.tv_sec * 1000000UL + tv.tv_usec;
+}
+
+static unsigned long allocs_total(void) {
+	unsigned long total = 0;
+	int type;
+
+	for(type = 1; type < MTYPE_MAX; type++) {
+		total += mtype_stats_total(type);
+	}
+	return total;
+}
+
+static unsigned long bytes_held(void) {
+	unsigned long bytes = 0;
+	int type;
+
+	for(type = 1; type < MTYPE_MAX; type++) {
+		bytes += mtype_stats_bytes(type);
+	}
+	return bytes;
+}
+
+/* Topologies */
+
+static void link_add(unsigned int a, unsigned int b) {
+	if(nlinks == maxlinks) {
+		maxlinks = maxlinks ? maxlinks * 2 : 1024;
+		links = realloc(links, maxlinks * sizeof(*links));
+	}
+	links[nlinks].r[0] = a;
+	links[nlinks].r[1] = b;
+	links[nlinks].cost[0] = equal_cost ? 10 : 1 + rnd(20);
+	links[nlinks].cost[1] = links[nlinks].cost[0];
+	nlinks++;
+}
+
+static void topo_grid(void) {
+	unsigned int w, r;
+
+	for(w = 1; w * w < nrouters; w++) {
+		;
+	}
+	for(r = 0; r < nrouters; r++) {
+		if((r + 1) % w && r + 1 < nrouters) {
+			link_add(r, r + 1);
+		}
+		if(r + w < nrouters) {
+			link_add(r, r + w);
+		}
+	}
+}
+
+/* Leaves first, so router 0 is one; the spines follow. */
+static void topo_clos(void) {
+	unsigned int spines, leaves, l, s;
+
+	spines = nrouters / 32;
+	if(spines < 2) {
+		spines = 2;
+	}
+	if(spines > 64) {
+		spines = 64;
+	}
+	leaves = nrouters - spines;
+	for(l = 0; l < leaves; l++) {
+		for(s = 0; s < spines; s++) {
+			link_add(l, leaves + s);
+		}
+	}
+}
+
+/* A random tree to keep it connected, then random links up to the degree. */
+static void topo_random(void) {
+	unsigned int r, a, b;
+
+	for(r = 1; r < nrouters; r++) {
+		link_add(r, rnd(r));
+	}
+	while(nlinks < (unsigned long) nrouters * degree / 2) {
+		a = rnd(nrouters);
+		b = rnd(nrouters);
+		if(a != b) {
+			link_add(a, b);
+		}
+	}
+}
+
+static void adj_build(void) {
+	unsigned int *fill, k, r;
+	int side;
+
+	adj_start = calloc(nrouters + 1, sizeof(*adj_start));
+	for(k = 0; k < nlinks; k++) {
+		adj_start[links[k].r[0] + 1]++;
+		adj_start[links[k].r[1] + 1]++;
+	}
+	for(r = 0; r < nrouters; r++) {
+		adj_start[r + 1] += adj_start[r];
+	}
+	adj = calloc(nlinks * 2, sizeof(*adj));
+	fill = calloc(nrouters, sizeof(*fill));
+	for(k = 0; k < nlinks; k++) {
+		for(side = 0; side < 2; side++) {
+			r = links[k].r[side];
+			adj[adj_start[r] + fill[r]++] = k;
+		}
+	}
+	free(fill);
+}
+
+/* LSAs */
+
+static struct ospf_lsa *lsa_new(struct ospf_area *lsa_area, u_char type, struct in_addr id, struct in_addr adv_router, size_t length) {
+	struct ospf_lsa *lsa;
+
+	lsa = ospf_lsa_new();
+	lsa->data = ospf_lsa_data_new(length);
+	lsa->area = lsa_area;
+	lsa->data->type = type;
+	lsa->data->id = id;
+	lsa->data->adv_router = adv_router;
+	lsa->data->ls_seqnum = htonl(seqnum);
+	lsa->data->length = htons(length);
+	return lsa;
+}
+
+static void set_metric(u_char *metric, u_int32_t cost) {
+	metric[0] = (cost >> 16) & 0xff;
+	metric[1] = (cost >> 8) & 0xff;
+	metric[2] = cost & 0xff;
+}
+
+/* A link per neighbor, then the loopback as a stub. */
+static struct ospf_lsa *router_lsa(unsigned int r) {
+	struct router_lsa *rl;
+	struct ospf_lsa *lsa;
+	struct bench_link *l;
+	unsigned int i, n, nl = adj_start[r + 1] - adj_start[r];
+	int side;
+
+	lsa = lsa_new(area, OSPF_ROUTER_LSA, router_id(r), router_id(r), OSPF_LSA_HEADER_SIZE + 4 + (nl + 1) * OSPF_ROUTER_LSA_LINK_SIZE);
+	rl = (struct router_lsa *) lsa->data;
+	rl->flags = rflags[r];
+	rl->links = htons(nl + 1);
+
+	for(i = 0; i < nl; i++) {
+		l = &links[adj[adj_start[r] + i]];
+		side = l->r[0] != r;
+		n = l->r[!side];
+		rl->link[i].link_id = router_id(n);
+		rl->link[i].link_data = link_addr(l - links, side);
+		rl->link[i].type = LSA_LINK_TYPE_POINTOPOINT;
+		rl->link[i].metric = htons(l->cost[side]);
+	}
+	rl->link[i].link_id.s_addr = htonl(0xac000000 + r);
+	rl->link[i].link_data.s_addr = htonl(0xffffffff);
+	rl->link[i].type = LSA_LINK_TYPE_STUB;
+	rl->link[i].metric = htons(1);
+
+	return lsa;
+}
+
+static struct ospf_lsa *summary_lsa(unsigned int s, unsigned int abr) {
+	struct summary_lsa *sl;
+	struct ospf_lsa *lsa;
+	struct in_addr id;
+
+	id.s_addr = htonl(0x64000000 + (s << 8));
+	lsa = lsa_new(area, OSPF_SUMMARY_LSA, id, router_id(abr), OSPF_LSA_HEADER_SIZE + 8);
+	sl = (struct summary_lsa *) lsa->data;
+	sl->mask.s_addr = htonl(0xffffff00);
+	set_metric(sl->metric, 1 + rnd(100));
+	return lsa;
+}
+
+static struct ospf_lsa *external_lsa(unsigned int x, unsigned int asbr) {
+	struct as_external_lsa *al;
+	struct ospf_lsa *lsa;
+	struct in_addr id;
+
+	id.s_addr = htonl(0x80000000 + (x << 8));
+	lsa = lsa_new(NULL, OSPF_AS_EXTERNAL_LSA, id, router_id(asbr), OSPF_LSA_HEADER_SIZE + 16);
+	al = (struct as_external_lsa *) lsa->data;
+	al->mask.s_addr = htonl(0xffffff00);
+	al->e[0].tos = 0x80; /* type 2 */
+	set_metric(al->e[0].metric, 20);
+	return lsa;
+}
+
+/* Replace the LSA there is, as flooding would. */
+static void lsa_install(struct ospf_lsdb *lsdb, struct ospf_lsa *lsa) {
+	struct ospf_lsa *old;
+
+	old = ospf_lsdb_lookup(lsdb, lsa);
+	if(old) {
+		ospf_discard_from_db(ospf, lsdb, old);
+	}
+	ospf_lsdb_add(lsdb, lsa);
+	if(lsa->data->type == OSPF_ROUTER_LSA && IPV4_ADDR_SAME(&lsa->data->id, &ospf->router_id)) {
+		ospf_lsa_unlock(&area->router_lsa_self);
+		area->router_lsa_self = ospf_lsa_lock(lsa);
+	}
+}
+
+/* The instance: router 0, with a point-to-multipoint interface on each
+ * of its links, which gives a next hop from the neighbor's link back. */
+static void bench_ospf_new(void) {
+	struct ospf_interface *oi;
+	struct in_addr area_id;
+	struct bench_link *l;
+	char name[INTERFACE_NAMSIZ];
+	unsigned int i;
+
+	ospf = XCALLOC(MTYPE_OSPF_TOP, sizeof(struct ospf));
+	ospf->router_id = router_id(0);
+	ospf->abr_type = OSPF_ABR_DEFAULT;
+	ospf->oiflist = list_new();
+	ospf->vlinks = list_new();
+	ospf->areas = list_new();
+	ospf->networks = route_table_init();
+	ospf->nbr_nbma = route_table_init();
+	ospf->lsdb = ospf_lsdb_new();
+	ospf->new_external_route = route_table_init();
+	ospf->old_external_route = route_table_init();
+	ospf->external_lsas = route_table_init();
+	ospf->maxage_lsa = route_table_init();
+	ospf->distance_table = route_table_init();
+	ospf->stub_router_admin_set = OSPF_STUB_ROUTER_ADMINISTRATIVE_UNSET;
+	ospf->spf_hold_multiplier = 1;
+	listnode_add(om->ospf, ospf);
+
+	area_id.s_addr = 0;
+	area = ospf_area_get(ospf, area_id, OSPF_AREA_ID_FORMAT_ADDRESS);
+
+	for(i = adj_start[0]; i < adj_start[1]; i++) {
+		l = &links[adj[i]];
+		snprintf(name, sizeof(name), "eth%u", i);
+		oi = XCALLOC(MTYPE_OSPF_IF, sizeof(struct ospf_interface));
+		oi->ifp = if_get_by_name(name);
+		if_set_index(oi->ifp, i + 1);
+		oi->ospf = ospf;
+		oi->area = area;
+		oi->type = OSPF_IFTYPE_POINTOMULTIPOINT;
+		oi->address = prefix_new();
+		oi->address->family = AF_INET;
+		oi->address->u.prefix4 = link_addr(l - links, l->r[0] != 0);
+		oi->address->prefixlen = 30;
+		oi->nbrs = route_table_init();
+		oi->params = XCALLOC(MTYPE_OSPF_IF_PARAMS, sizeof(struct ospf_if_params));
+		oi->lsa_pos_beg = i - adj_start[0];
+		oi->lsa_pos_end = oi->lsa_pos_beg + 1;
+		listnode_add(ospf->oiflist, oi);
+		listnode_add(area->oiflist, oi);
+	}
+}
+
+static void originate(void) {
+	unsigned int r, i;
+
+	rflags = calloc(nrouters, 1);
+	/* the ABRs and ASBRs away from router 0, wherever they fall */
+	for(i = 0; i < nabrs; i++) {
+		rflags[nrouters - 1 - i * 7 % (nrouters - 1)] |= ROUTER_LSA_BORDER;
+	}
+	for(i = 0; i < nasbrs; i++) {
+		rflags[1 + i * 13 % (nrouters - 1)] |= ROUTER_LSA_EXTERNAL;
+	}
+
+	for(r = 0; r < nrouters; r++) {
+		lsa_install(area->lsdb, router_lsa(r));
+	}
+	for(i = 0; nabrs && i < nsummaries; i++) {
+		lsa_install(area->lsdb, summary_lsa(i, nrouters - 1 - rnd(nabrs) * 7 % (nrouters - 1)));
+	}
+	for(i = 0; nasbrs && i < nexternals; i++) {
+		lsa_install(ospf->lsdb, external_lsa(i, 1 + rnd(nasbrs) * 13 % (nrouters - 1)));
+	}
+}
+
+/* A random link changes its cost, both ways. */
+static void change(void) {
+	struct bench_link *l = &links[rnd(nlinks)];
+	u_int16_t cost;
+
+	do {
+		cost = equal_cost ? 5 + rnd(2) * 10 : 1 + rnd(20);
+	} while(cost == l->cost[0]);
+	l->cost[0] = l->cost[1] = cost;
+
+	seqnum++;
+	lsa_install(area->lsdb, router_lsa(l->r[0]));
+	lsa_install(area->lsdb, router_lsa(l->r[1]));
+}
+
+static unsigned long table_count(struct route_table *table) {
+	struct route_node *rn;
+	unsigned long count = 0;
+
+	for(rn = route_top(table); rn; rn = route_next(rn)) {
+		if(rn->info) {
+			count++;
+		}
+	}
+	return count;
+}
+
+/* Runs */
+
+static int cmp_ulong(const void *a, const void *b) {
+	unsigned long x = *(const unsigned long *) a, y = *(const unsigned long *) b;
+
+	return x < y ? -1 : x > y;
+}
+
+static void report_phase(const char *what, size_t offset) {
+	unsigned long *v = calloc(nruns, sizeof(*v));
+	unsigned int i;
+
+	for(i = 0; i < nruns; i++) {
+		v[i] = *(unsigned long *) ((char *) &runs[i] + offset);
+	}
+	qsort(v, nruns, sizeof(*v), cmp_ulong);
+	printf("  %-12s p50 %8lu  max %8lu\n", what, v[nruns / 2], v[nruns - 1]);
+	free(v);
+}
+
+static void report(void) {
+	unsigned int i, incremental = 0;
+
+	for(i = 0; i < nruns; i++) {
+		incremental += runs[i].incremental;
+	}
+	printf("%u runs, %u incremental; %lu intra/inter-area routes, %lu external, %lu KiB held\n", nruns, incremental, table_count(ospf->new_table),
+	       table_count(ospf->old_external_route), bytes_held() / 1024);
+	printf("  usec\n");
+	report_phase("SPF total", offsetof(struct bench_run, total));
+	report_phase("tree", offsetof(struct bench_run, spf));
+	report_phase("inter-area", offsetof(struct bench_run, ia));
+	report_phase("install", offsetof(struct bench_run, install));
+	report_phase("external", offsetof(struct bench_run, ase));
+	printf("  allocations\n");
+	report_phase("SPF run", offsetof(struct bench_run, spf_allocs));
+	report_phase("external", offsetof(struct bench_run, ase_allocs));
+}
+
+static int bench_run(struct thread *t);
+
+/* All the AS-external-LSAs, as ospf_ase_calculate_timer() does them,
+ * short of telling zebra. */
+static void bench_ase(struct bench_run *br) {
+	struct route_node *rn;
+	struct ospf_lsa *lsa;
+	unsigned long start, allocs;
+
+	allocs = allocs_total();
+	start = now_usec();
+	LSDB_LOOP(EXTERNAL_LSDB(ospf), rn, lsa)
+	ospf_ase_calculate_route(ospf, lsa);
+	br->ase = now_usec() - start;
+	br->ase_allocs = allocs_total() - allocs;
+
+	ospf_route_table_free(ospf->old_external_route);
+	ospf->old_external_route = ospf->new_external_route;
+	ospf->new_external_route = route_table_init();
+}
+
+/* Until the SPF timer has run */
+static int bench_wait(struct thread *t) {
+	struct bench_run *br = &runs[run];
+	struct ospf_spf_log *log;
+
+	if(ospf->t_spf_calc) {
+		thread_add_timer_msec(master, bench_wait, NULL, 0);
+		return 0;
+	}
+
+	br->spf_allocs = allocs_total() - allocs_before;
+	log = &area->spf_log[(area->spf_log_next + OSPF_SPF_LOG_SIZE - 1) % OSPF_SPF_LOG_SIZE];
+	br->total = ospf->ts_spf_duration.tv_sec * 1000000UL + ospf->ts_spf_duration.tv_usec;
+	br->spf = log->spf;
+	br->ia = log->ia;
+	br->install = log->install;
+	br->incremental = log->incremental;
+
+	bench_ase(br);
+
+	run++;
+	thread_add_event(master, bench_run, NULL, 0);
+	return 0;
+}
+
+static int bench_run(struct thread *t) {
+	if(run == nruns) {
+		report();
+		exit(0);
+	}
+
+	if(churn && run > 0) {
+		change();
+	} else {
+		ospf_spf_free(area);
+	}
+
+	allocs_before = allocs_total();
+	ospf_spf_calculate_schedule(ospf, SPF_FLAG_ROUTER_LSA_INSTALL);
+	thread_add_timer_msec(master, bench_wait, NULL, 0);
+	return 0;
+}
+
+static void usage(const char *progname) {
+	fprintf(stderr,
+	        "Usage: %s [grid|clos|random] [-n routers] [-d degree] [-r runs] [-c] [-e]\n"
+	        "          [-a ABRs] [-s summaries] [-A ASBRs] [-x externals]\n"
+	        "  -c  change a link's cost between runs, instead of from scratch\n"
+	        "  -e  equal link costs\n",
+	        progname);
+	exit(1);
+}
+
+int main(int argc, char **argv) {
+	const char *name = "grid";
+	int opt;
+
+	if(argc > 1 && argv[1][0] != '-') {
+		name = argv[1];
+		optind = 2;
+	}
+	if(!strcmp(name, "grid")) {
+		topo = TOPO_GRID;
+	} else if(!strcmp(name, "clos")) {
+		topo = TOPO_CLOS;
+	} else if(!strcmp(name, "random")) {
+		topo = TOPO_RANDOM;
+	} else {
+		usage(argv[0]);
+	}
+
+	while((opt = getopt(argc, argv, "n:d:r:cea:s:A:x:h")) != -1) {
+		switch(opt) {
+			case 'n': nrouters = strtoul(optarg, NULL, 10); break;
+			case 'd': degree = strtoul(optarg, NULL, 10); break;
+			case 'r': nruns = strtoul(optarg, NULL, 10); break;
+			case 'c': churn = 1; break;
+			case 'e': equal_cost = 1; break;
+			case 'a': nabrs = strtoul(optarg, NULL, 10); break;
+			case 's': nsummaries = strtoul(optarg, NULL, 10); break;
+			case 'A': nasbrs = strtoul(optarg, NULL, 10); break;
+			case 'x': nexternals = strtoul(optarg, NULL, 10); break;
+			default: usage(argv[0]);
+		}
+	}
+	if(nrouters < 4 || !nruns || degree < 2 || nabrs >= nrouters / 2 || nasbrs >= nrouters / 2) {
+		usage(argv[0]);
+	}
+
+	zlog_default = openzlog("spf-bench", ZLOG_OSPF, LOG_CONS | LOG_NDELAY | LOG_PID, LOG_DAEMON);
+	zlog_set_level(NULL, ZLOG_DEST_SYSLOG, ZLOG_DISABLED);
+	zlog_set_level(NULL, ZLOG_DEST_STDOUT, LOG_WARNING);
+
+	prng = prng_new(0);
+	master = thread_master_create();
+	cmd_init(0);
+	vrf_init();
+	ospf_master_init();
+	zclient = zclient_new(master);
+
+	switch(topo) {
+		case TOPO_GRID: topo_grid(); break;
+		case TOPO_CLOS: topo_clos(); break;
+		case TOPO_RANDOM: topo_random(); break;
+	}
+	adj_build();
+	bench_ospf_new();
+	originate();
+
+	printf("%s: %u routers, %u links, %u summaries from %u ABRs, %u externals from %u ASBRs, %s costs\n", name, nrouters, nlinks, nabrs ? nsummaries : 0, nabrs,
+	       nasbrs ? nexternals : 0, nasbrs, equal_cost ? "equal" : "random");
+
+	runs = calloc(nruns, sizeof(*runs));
+	thread_add_event(master, bench_run, NULL, 0);
+	thread_main(master);
+
+	return 0;
+}
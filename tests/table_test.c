@@ -467,6 +467,142 @@ static void test_iter_pause(void) {
 	route_table_finish(table);
 }
 
+/*
+ * verify_match
+ *
+ * Check route_node_match() against a linear scan for the longest
+ * matching prefix with info.
+ */
+static void verify_match(struct route_table *table, struct prefix_ipv4 *p) {
+	struct route_node *rn, *match, *best = NULL;
+
+	for(rn = route_top(table); rn; rn = route_next(rn)) {
+		if(rn->info && prefix_match(&rn->p, (struct prefix *) p) && (!best || rn->p.prefixlen > best->p.prefixlen)) {
+			best = rn;
+		}
+	}
+
+	match = route_node_match_ipv4(table, &p->prefix);
+	assert(match == best);
+	if(match) {
+		route_unlock_node(match);
+	}
+}
+
+/*
+ * test_match
+ *
+ * Longest-prefix match on a table large enough to use the stride index,
+ * with prefixes above, on and below the stride boundary coming and going.
+ */
+static void test_match(void) {
+	struct route_table *table;
+	struct route_node *rn;
+	struct prefix_ipv4 p;
+	int i, round;
+
+	printf("\n\nTesting route_node_match() against a linear scan\n");
+	srandom(1);
+	table = route_table_init();
+
+	for(round = 0; round < 4; round++) {
+		for(i = 0; i < 500; i++) {
+			memset(&p, 0, sizeof(p));
+			p.family = AF_INET;
+			p.prefixlen = random() % 33;
+			p.prefix.s_addr = htonl((random() % 16) << 28 | (random() & 0x0fffffff));
+			apply_mask_ipv4(&p);
+
+			rn = route_node_get(table, (struct prefix *) &p);
+			if(rn->info) {
+				route_unlock_node(rn);
+			} else {
+				rn->info = table;
+			}
+		}
+
+		for(i = 0; i < 2000; i++) {
+			memset(&p, 0, sizeof(p));
+			p.family = AF_INET;
+			p.prefixlen = IPV4_MAX_BITLEN;
+			p.prefix.s_addr = htonl((random() % 16) << 28 | (random() & 0x0fffffff));
+			verify_match(table, &p);
+		}
+
+		/* Drop about half of the routes, short ones included. */
+		for(rn = route_top(table); rn; rn = route_next(rn)) {
+			if(rn->info && random() % 2) {
+				rn->info = NULL;
+				route_unlock_node(rn);
+			}
+		}
+	}
+
+	for(rn = route_top(table); rn; rn = route_next(rn)) {
+		if(rn->info) {
+			rn->info = NULL;
+			route_unlock_node(rn);
+		}
+	}
+	assert(table->top == NULL);
+	route_table_finish(table);
+}
+
+/*
+ * test_walk
+ *
+ * Walk a table with route_table_walk_t, deleting every other node as
+ * it's returned and adding one behind the cursor while paused.
+ */
+static void test_walk(void) {
+	struct route_table *table;
+	route_table_walk_t walk;
+	struct route_node *rn;
+	int i, count, num_prefixes;
+	const char *prefixes[] = { "1.0.1.0/24", "1.0.1.0/25", "1.0.1.128/25", "1.0.2.0/24", "2.0.0.0/8", "2.1.0.0/16", "10.0.0.0/8" };
+
+	num_prefixes = sizeof(prefixes) / sizeof(prefixes[0]);
+
+	printf("\n\nTesting route_table_walk_t\n");
+	table = route_table_init();
+	for(i = 0; i < num_prefixes; i++) {
+		add_nodes(table, prefixes[i], NULL);
+	}
+
+	/* No glue nodes, and the same order as route_next(). */
+	count = 0;
+	for(rn = route_top_info(table); rn; rn = route_next_info(rn)) {
+		assert(rn->info);
+		assert(!strcmp(((test_node_t *) rn->info)->prefix_str, prefixes[count]));
+		count++;
+	}
+	assert(count == num_prefixes);
+
+	count = 0;
+	route_table_walk_init(&walk, table);
+	while((rn = route_table_walk_next(&walk))) {
+		test_node_t *node = rn->info;
+
+		assert(!strcmp(node->prefix_str, prefixes[count]));
+		if(count == 3) {
+			route_table_walk_pause(&walk);
+			add_node(table, "1.0.0.0/24");
+		}
+		if(count % 2 == 0) {
+			rn->info = NULL;
+			route_unlock_node(rn);
+			free(node->prefix_str);
+			free(node);
+		}
+		count++;
+	}
+	assert(count == num_prefixes);
+	assert(route_table_count(table) > 0);
+
+	clear_table(table);
+	route_table_finish(table);
+}
+
 /*
  * run_tests
  */
@@ -474,6 +610,8 @@ static void run_tests(void) {
 	test_prefix_iter_cmp();
 	test_get_next();
 	test_iter_pause();
+	test_match();
+	test_walk();
 }
 
 /*
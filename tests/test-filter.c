@@ -0,0 +1,266 @@
+/*
+ * Test program to check that access-lists long enough to be looked up
+ * through a trie still give the first matching filter in list order,
+ * for zebra filters with and without exact-match and for standard cisco
+ * ones, whose wildcard may not be a prefix, while filters are added and
+ * deleted.
+ *
+ * This file is part of Quagga
+ *
+ * Quagga is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2, or (at your option) any
+ * later version.
+ *
+ * Quagga is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Quagga; see the file COPYING.  If not, write to the Free
+ * Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ * 02111-1307, USA.
+ */
+
+#include <zebra.h>
+
+#include <stdio.h>
+
+#include "memory.h"
+#include "prefix.h"
+#include "command.h"
+#include "vty.h"
+#include "filter.h"
+#include "prng.h"
+
+#define ENTRIES 2000
+#define LOOKUPS 10000
+
+struct thread_master *master;
+
+static struct vty *vty;
+
+/* "test" holds zebra filters, "1" standard cisco ones */
+static const char *names[2] = { "test", "1" };
+
+static struct entry {
+	int cisco;
+	int permit;
+	int exact;
+	struct prefix_ipv4 p; /* zebra */
+	u_int32_t addr, wildcard; /* cisco, host order */
+	int present;
+	unsigned long order; /* when added, for its place in the list */
+} entries[2][ENTRIES];
+
+static unsigned long order;
+
+/* An address in 10.0.0.0/8, mostly in a handful of /16s so that filters
+ * nest and overlap. */
+static u_int32_t random_addr(struct prng *prng) {
+	return 0x0a000000 | (prng_range(prng, 4) << 16) | prng_range(prng, 0x10000);
+}
+
+static void random_prefix(struct prng *prng, struct prefix_ipv4 *p, int minlen, int maxlen) {
+	memset(p, 0, sizeof(struct prefix_ipv4));
+	p->family = AF_INET;
+	p->prefixlen = minlen + prng_range(prng, maxlen + 1 - minlen);
+	p->prefix.s_addr = htonl(random_addr(prng));
+	apply_mask_ipv4(p);
+}
+
+static void random_entry(struct prng *prng, struct entry *e, int cisco) {
+	int bits;
+
+	memset(e, 0, sizeof(struct entry));
+	e->cisco = cisco;
+	e->permit = prng_range(prng, 2);
+	if(!cisco) {
+		if(prng_range(prng, 50) == 0) {
+			e->p.family = AF_INET; /* any */
+		} else {
+			random_prefix(prng, &e->p, 8, 28);
+			e->exact = prng_range(prng, 3) == 0;
+		}
+		return;
+	}
+
+	bits = prng_range(prng, 25);
+	e->wildcard = bits ? (1U << bits) - 1 : 0;
+	if(prng_range(prng, 8) == 0) {
+		/* not a prefix: some bit above the host bits */
+		e->wildcard |= 1U << (8 + prng_range(prng, 16));
+	}
+	e->addr = random_addr(prng) & ~e->wildcard;
+}
+
+static int entry_same(struct entry *a, struct entry *b) {
+	if(a->permit != b->permit) {
+		return 0;
+	}
+	if(a->cisco) {
+		return a->addr == b->addr && a->wildcard == b->wildcard;
+	}
+	return a->exact == b->exact && prefix_same((struct prefix *) &a->p, (struct prefix *) &b->p);
+}
+
+static void config(const char *fmt, ...) {
+	char line[256];
+	va_list args;
+	vector vline;
+
+	va_start(args, fmt);
+	vsnprintf(line, sizeof(line), fmt, args);
+	va_end(args);
+
+	vline = cmd_make_strvec(line);
+	if(cmd_execute_command(vline, vty, NULL, 0) != CMD_SUCCESS) {
+		fprintf(stderr, "failed: %s\n", line);
+		exit(1);
+	}
+	cmd_free_strvec(vline);
+}
+
+static void entry_set(int list, struct entry *e, int set) {
+	char buf[INET_ADDRSTRLEN], wbuf[INET_ADDRSTRLEN];
+	struct in_addr addr;
+
+	if(e->cisco) {
+		addr.s_addr = htonl(e->addr);
+		inet_ntop(AF_INET, &addr, buf, sizeof(buf));
+		addr.s_addr = htonl(e->wildcard);
+		inet_ntop(AF_INET, &addr, wbuf, sizeof(wbuf));
+		config("%saccess-list %s %s %s %s", set ? "" : "no ", names[list], e->permit ? "permit" : "deny", buf, wbuf);
+	} else if(e->p.prefixlen == 0) {
+		config("%saccess-list %s %s any", set ? "" : "no ", names[list], e->permit ? "permit" : "deny");
+	} else {
+		inet_ntop(AF_INET, &e->p.prefix, buf, sizeof(buf));
+		config("%saccess-list %s %s %s/%d%s", set ? "" : "no ", names[list], e->permit ? "permit" : "deny", buf, e->p.prefixlen, e->exact ? " exact-match" : "");
+	}
+}
+
+/* Add a new random filter in place of entry i, unless the list has it. */
+static void entry_add(struct prng *prng, int list, int i) {
+	struct entry *e = &entries[list][i];
+	int j;
+
+	random_entry(prng, e, list == 1);
+	for(j = 0; j < ENTRIES; j++) {
+		if(j != i && entries[list][j].present && entry_same(&entries[list][j], e)) {
+			return;
+		}
+	}
+	entry_set(list, e, 1);
+	e->present = 1;
+	e->order = ++order;
+}
+
+static int entry_match(struct entry *e, struct prefix *p) {
+	if(e->cisco) {
+		return (ntohl(p->u.prefix4.s_addr) & ~e->wildcard) == e->addr;
+	}
+	if(e->exact && p->prefixlen != e->p.prefixlen) {
+		return 0;
+	}
+	return prefix_match((struct prefix *) &e->p, p);
+}
+
+/* What the first matching filter, in list order, says */
+static enum filter_type reference_apply(int list, struct prefix *p) {
+	struct entry *first = NULL;
+	int i;
+
+	for(i = 0; i < ENTRIES; i++) {
+		struct entry *e = &entries[list][i];
+
+		if(e->present && (!first || e->order < first->order) && entry_match(e, p)) {
+			first = e;
+		}
+	}
+	if(!first) {
+		return FILTER_DENY;
+	}
+	return first->permit ? FILTER_PERMIT : FILTER_DENY;
+}
+
+static void check_lookups(struct prng *prng, int list, int lookups) {
+	struct access_list *access = access_list_lookup(AFI_IP, names[list]);
+	struct prefix_ipv4 p;
+	int i;
+
+	for(i = 0; i < lookups; i++) {
+		random_prefix(prng, &p, 8, 32);
+		assert(access_list_apply(access, &p) == reference_apply(list, (struct prefix *) &p));
+	}
+
+	/* and the filters' own addresses, which are sure to hit something */
+	for(i = 0; i < ENTRIES; i++) {
+		struct entry *e = &entries[list][i];
+
+		if(!e->present) {
+			continue;
+		}
+		if(e->cisco) {
+			p.prefixlen = 8 + prng_range(prng, 25);
+			p.prefix.s_addr = htonl(e->addr);
+		} else {
+			p = e->p;
+		}
+		assert(access_list_apply(access, &p) == reference_apply(list, (struct prefix *) &p));
+	}
+}
+
+int main(int argc, char **argv) {
+	struct prng *prng;
+	int list, i, round;
+
+	prng = prng_new(0);
+	cmd_init(1);
+	access_list_init();
+	vty = vty_new();
+	vty->node = CONFIG_NODE;
+
+	for(list = 0; list < 2; list++) {
+		for(i = 0; i < ENTRIES; i++) {
+			entry_add(prng, list, i);
+
+			/* across the switch from walking the list to the trie */
+			if(i < 40) {
+				check_lookups(prng, list, LOOKUPS / 20);
+			}
+		}
+		check_lookups(prng, list, LOOKUPS);
+
+		for(round = 0; round < 4; round++) {
+			for(i = 0; i < ENTRIES; i++) {
+				if(prng_range(prng, 3)) {
+					continue;
+				}
+				if(entries[list][i].present) {
+					entry_set(list, &entries[list][i], 0);
+					entries[list][i].present = 0;
+				} else {
+					entry_add(prng, list, i);
+				}
+			}
+			check_lookups(prng, list, LOOKUPS);
+		}
+
+		/* and down to nothing again */
+		for(i = 0; i < ENTRIES; i++) {
+			if(entries[list][i].present) {
+				entry_set(list, &entries[list][i], 0);
+				entries[list][i].present = 0;
+			}
+			if(i >= ENTRIES - 40) {
+				check_lookups(prng, list, LOOKUPS / 20);
+			}
+		}
+		assert(access_list_lookup(AFI_IP, names[list]) == NULL);
+	}
+	printf("Access-list lookups OK.\n");
+
+	prng_free(prng);
+	return 0;
+}
@@ -0,0 +1,138 @@
+/*
+ * Test program to check that open addressed hashes behave like chained
+ * ones: random insertions and releases across several expansions,
+ * lookups in the middle of migrating to a new slot array, and releasing
+ * from within hash_iterate().
+ *
+ * This file is part of Quagga
+ *
+ * Quagga is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2, or (at your option) any
+ * later version.
+ *
+ * Quagga is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Quagga; see the file COPYING.  If not, write to the Free
+ * Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ * 02111-1307, USA.
+ */
+
+#include <zebra.h>
+
+#include <stdio.h>
+
+#include "memory.h"
+#include "hash.h"
+#include "prng.h"
+
+#define VALUES 20000
+
+struct thread_master *master;
+
+static unsigned int values[VALUES];
+static int present[VALUES];
+static int visited[VALUES];
+static int was_present[VALUES];
+
+/* Few distinct keys, so runs get long and collide across expansions. */
+static unsigned int value_key(void *p) {
+	return *(unsigned int *) p % (VALUES / 4);
+}
+
+static int value_cmp(const void *a, const void *b) {
+	return *(const unsigned int *) a == *(const unsigned int *) b;
+}
+
+static void check_contents(struct hash *hash) {
+	unsigned long count = 0;
+	int i;
+
+	for(i = 0; i < VALUES; i++) {
+		void *found = hash_lookup(hash, &values[i]);
+
+		assert(found == (present[i] ? &values[i] : NULL));
+		count += present[i];
+	}
+	assert(hash->count == count);
+}
+
+static void visit(struct hash_backet *hb, void *arg) {
+	struct hash *hash = arg;
+	unsigned int *value = hb->data;
+	int i = value - values;
+
+	assert(present[i]);
+	assert(!visited[i]);
+	visited[i] = 1;
+
+	/* release every other one as it's handed to us */
+	if(i % 2) {
+		assert(hash_release(hash, value) == value);
+		present[i] = 0;
+	}
+}
+
+static void test_hash(struct hash *hash, struct prng *prng) {
+	int round, i;
+
+	memset(present, 0, sizeof(present));
+
+	for(round = 0; round < 5; round++) {
+		for(i = 0; i < VALUES; i++) {
+			int v = prng_rand(prng) % VALUES;
+
+			if(prng_rand(prng) % 4) {
+				assert(hash_get(hash, &values[v], hash_alloc_intern) == &values[v]);
+				present[v] = 1;
+			} else {
+				assert(hash_release(hash, &values[v]) == (present[v] ? &values[v] : NULL));
+				present[v] = 0;
+			}
+
+			/* catch it part way through a migration, too */
+			if(i % 4999 == 0) {
+				check_contents(hash);
+			}
+		}
+		check_contents(hash);
+
+		memset(visited, 0, sizeof(visited));
+		memcpy(was_present, present, sizeof(present));
+		hash_iterate(hash, visit, hash);
+		for(i = 0; i < VALUES; i++) {
+			assert(visited[i] == was_present[i]);
+		}
+		check_contents(hash);
+	}
+
+	hash_clean(hash, NULL);
+	assert(hash->count == 0);
+	memset(present, 0, sizeof(present));
+	check_contents(hash);
+	hash_free(hash);
+}
+
+int main(int argc, char **argv) {
+	struct prng *prng;
+	int i;
+
+	for(i = 0; i < VALUES; i++) {
+		values[i] = i;
+	}
+
+	prng = prng_new(0);
+
+	test_hash(hash_create(value_key, value_cmp), prng);
+	printf("Chained hash OK.\n");
+
+	test_hash(hash_create_open(value_key, value_cmp), prng);
+	printf("Open addressed hash OK.\n");
+
+	prng_free(prng);
+	return 0;
+}
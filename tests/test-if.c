@@ -0,0 +1,237 @@
+/*
+ * Test program to check that interface lookups by ifindex, name and
+ * address, answered from the VRF's indexes, agree with walking the
+ * interface and connected lists, while interfaces come and go, change
+ * index and gain and lose addresses, peers included.
+ *
+ * This file is part of Quagga
+ *
+ * Quagga is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2, or (at your option) any
+ * later version.
+ *
+ * Quagga is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Quagga; see the file COPYING.  If not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ * 02111-1307, USA.
+ */
+
+#include <zebra.h>
+
+#include <stdio.h>
+
+#include "memory.h"
+#include "prefix.h"
+#include "linklist.h"
+#include "command.h"
+#include "vrf.h"
+#include "if.h"
+#include "prng.h"
+
+#define INTERFACES 1000
+#define ROUNDS 6
+#define LOOKUPS 5000
+
+struct thread_master *master;
+
+static struct interface *ifps[INTERFACES];
+
+/* An address in 10.0.0.0/14, so that subnets nest and overlap */
+static struct in_addr random_addr(struct prng *prng) {
+	struct in_addr addr;
+
+	addr.s_addr = htonl(0x0a000000 | prng_range(prng, 0x40000));
+	return addr;
+}
+
+static void add_address(struct prng *prng, struct interface *ifp) {
+	struct prefix_ipv4 p, d;
+	struct connected *ifc;
+
+	p.family = AF_INET;
+	p.prefix = random_addr(prng);
+	p.prefixlen = 16 + prng_range(prng, 17);
+
+	if(prng_range(prng, 4)) {
+		ifc = connected_add_by_prefix(ifp, (struct prefix *) &p, NULL);
+	} else {
+		/* a peer, flagged only once linked as zclient does */
+		d = p;
+		d.prefix = random_addr(prng);
+		ifc = connected_add_by_prefix(ifp, (struct prefix *) &p, (struct prefix *) &d);
+		SET_FLAG(ifc->flags, ZEBRA_IFA_PEER);
+	}
+}
+
+/*
+ * The lookups as they were, walking everything.
+ */
+static struct interface *walk_by_index(ifindex_t ifindex) {
+	struct listnode *node;
+	struct interface *ifp;
+
+	for(ALL_LIST_ELEMENTS_RO(iflist, node, ifp)) {
+		if(ifp->ifindex == ifindex) {
+			return ifp;
+		}
+	}
+	return NULL;
+}
+
+static int walk_has_address(struct interface *ifp, struct in_addr addr) {
+	struct listnode *node;
+	struct connected *c;
+
+	for(ALL_LIST_ELEMENTS_RO(ifp->connected, node, c)) {
+		if(IPV4_ADDR_SAME(&c->address->u.prefix4, &addr)) {
+			return 1;
+		}
+	}
+	return 0;
+}
+
+static int walk_has_prefix(struct interface *ifp, struct prefix *p) {
+	struct listnode *node;
+	struct connected *c;
+
+	for(ALL_LIST_ELEMENTS_RO(ifp->connected, node, c)) {
+		if(prefix_cmp(c->address, p) == 0) {
+			return 1;
+		}
+	}
+	return 0;
+}
+
+/* Longest prefix length of an address whose connected prefix holds addr */
+static int walk_subnet_len(struct interface *only, struct in_addr addr) {
+	struct listnode *node, *cnode;
+	struct interface *ifp;
+	struct connected *c;
+	struct prefix_ipv4 p;
+	int bestlen = 0;
+
+	p.family = AF_INET;
+	p.prefix = addr;
+	p.prefixlen = IPV4_MAX_BITLEN;
+
+	for(ALL_LIST_ELEMENTS_RO(iflist, node, ifp)) {
+		if(only && ifp != only) {
+			continue;
+		}
+		for(ALL_LIST_ELEMENTS_RO(ifp->connected, cnode, c)) {
+			if(prefix_match(CONNECTED_PREFIX(c), (struct prefix *) &p) && c->address->prefixlen > bestlen) {
+				bestlen = c->address->prefixlen;
+			}
+		}
+	}
+	return bestlen;
+}
+
+static void check_lookups(struct prng *prng, ifindex_t next_index) {
+	struct listnode *node, *cnode;
+	struct interface *ifp, *found;
+	struct connected *c;
+	struct in_addr addr;
+	int i, len;
+
+	for(ALL_LIST_ELEMENTS_RO(iflist, node, ifp)) {
+		assert(if_lookup_by_name(ifp->name) == ifp);
+		assert(if_lookup_by_name_len(ifp->name, strlen(ifp->name)) == ifp);
+		if(ifp->ifindex != IFINDEX_INTERNAL) {
+			assert(if_lookup_by_index(ifp->ifindex) == ifp);
+		}
+		for(ALL_LIST_ELEMENTS_RO(ifp->connected, cnode, c)) {
+			found = if_lookup_exact_address(c->address->u.prefix4);
+			assert(found && walk_has_address(found, c->address->u.prefix4));
+			found = if_lookup_prefix(c->address);
+			assert(found && walk_has_prefix(found, c->address));
+		}
+	}
+
+	for(i = 0; i < LOOKUPS; i++) {
+		ifindex_t ifindex = 1 + prng_range(prng, next_index);
+
+		assert(if_lookup_by_index(ifindex) == walk_by_index(ifindex));
+
+		addr = random_addr(prng);
+		found = if_lookup_exact_address(addr);
+		if(found) {
+			assert(walk_has_address(found, addr));
+		} else {
+			for(ALL_LIST_ELEMENTS_RO(iflist, node, ifp)) {
+				assert(!walk_has_address(ifp, addr));
+			}
+		}
+
+		len = walk_subnet_len(NULL, addr);
+		found = if_lookup_address(addr);
+		if(len) {
+			assert(found && walk_subnet_len(found, addr) == len);
+		} else {
+			assert(!found);
+		}
+	}
+	assert(!if_lookup_by_name("none"));
+}
+
+int main(int argc, char **argv) {
+	struct prng *prng;
+	struct connected *c;
+	char name[INTERFACE_NAMSIZ];
+	int i, j, round;
+	ifindex_t next_index = 1;
+
+	prng = prng_new(0);
+	cmd_init(0);
+	vrf_init();
+
+	for(i = 0; i < INTERFACES; i++) {
+		snprintf(name, sizeof(name), "vlan%d", i);
+		ifps[i] = if_get_by_name(name);
+		if_set_index(ifps[i], next_index++);
+		for(j = prng_range(prng, 4); j > 0; j--) {
+			add_address(prng, ifps[i]);
+		}
+	}
+	check_lookups(prng, next_index);
+
+	for(round = 0; round < ROUNDS; round++) {
+		for(i = 0; i < INTERFACES; i++) {
+			switch(prng_range(prng, 8)) {
+				case 0:
+					/* gone from the kernel, kept for its configuration */
+					if_delete_retain(ifps[i]);
+					if_set_index(ifps[i], IFINDEX_INTERNAL);
+					break;
+				case 1:
+					if_set_index(ifps[i], next_index++);
+					break;
+				case 2:
+					snprintf(name, sizeof(name), "%s", ifps[i]->name);
+					if_delete(ifps[i]);
+					ifps[i] = if_get_by_name(name);
+					break;
+				case 3:
+					if((c = listnode_head(ifps[i]->connected)) != NULL) {
+						c = connected_delete_by_prefix(ifps[i], c->address);
+						assert(c);
+						connected_free(c);
+					}
+					break;
+				default: add_address(prng, ifps[i]); break;
+			}
+		}
+		check_lookups(prng, next_index);
+	}
+	printf("Interface lookups OK.\n");
+
+	vrf_terminate();
+	prng_free(prng);
+	return 0;
+}
@@ -41,6 +41,38 @@ struct thread_master *master;
 #endif
 
 #define TIMES 10
+#define SLAB_OBJS 20000
+
+/* slab objects: distinct, zeroed by calloc, reused after free */
+static void test_slab(void) {
+	static unsigned long *o[SLAB_OBJS];
+	int i, j;
+
+	mtype_slab_init(MTYPE_PREFIX, 4 * sizeof(unsigned long));
+
+	for(i = 0; i < TIMES; i++) {
+		for(j = 0; j < SLAB_OBJS; j++) {
+			o[j] = XCALLOC(MTYPE_PREFIX, 4 * sizeof(unsigned long));
+			assert(o[j][0] == 0 && o[j][3] == 0);
+			o[j][0] = o[j][3] = j;
+		}
+		for(j = 0; j < SLAB_OBJS; j++) {
+			assert(o[j][0] == (unsigned long) j && o[j][3] == (unsigned long) j);
+		}
+		assert(XREALLOC(MTYPE_PREFIX, o[0], sizeof(unsigned long)) == o[0]);
+
+		/* every other one, then the rest, so chunks empty out unevenly */
+		for(j = i % 2; j < SLAB_OBJS; j += 2) {
+			XFREE(MTYPE_PREFIX, o[j]);
+		}
+		for(j = 0; j < SLAB_OBJS; j++) {
+			if(o[j]) {
+				XFREE(MTYPE_PREFIX, o[j]);
+			}
+		}
+		assert(mtype_stats_alloc(MTYPE_PREFIX) == 0);
+	}
+}
 
 int main(int argc, char **argv) {
 	void *a[10];
@@ -113,5 +145,8 @@ int main(int argc, char **argv) {
 		XFREE(MTYPE_VTY, a[2]);
 		/* alloc == 0, cache valid next request */
 	}
+
+	printf("slab\n\n");
+	test_slab();
 	return 0;
 }
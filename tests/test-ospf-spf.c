@@ -0,0 +1,874 @@
+/*
+ * Test program to check that the shortest-path tree kept between SPF
+ * runs, and updated incrementally, gives the routes a calculation from
+ * scratch does, while routers join and leave transit networks, change
+ * their costs and go away altogether; and that the routes to the
+ * destinations of summary-LSAs, recalculated for each summary-LSA as it
+ * changes, are those of a calculation from scratch too.  A second area
+ * with the same routers and networks has its SPF run alongside, on the
+ * SPF threads.  A neighbor's retransmission list is checked along the way
+ * against an LSDB of the LSAs that should be on it.  For the later rounds
+ * we are an area border router, with area ranges, and the summary-LSAs
+ * updated for the routes changed alone are checked against those of the
+ * full ABR task.
+ *
+ * This file is part of Quagga
+ *
+ * Quagga is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2, or (at your option) any
+ * later version.
+ *
+ * Quagga is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Quagga; see the file COPYING.  If not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ * 02111-1307, USA.
+ */
+
+#include <zebra.h>
+
+#include <stdio.h>
+
+#include "thread.h"
+#include "memory.h"
+#include "prefix.h"
+#include "linklist.h"
+#include "table.h"
+#include "command.h"
+#include "privs.h"
+#include "vrf.h"
+#include "if.h"
+#include "zclient.h"
+#include "prng.h"
+
+#include "ospfd/ospfd.h"
+#include "ospfd/ospf_interface.h"
+#include "ospfd/ospf_asbr.h"
+#include "ospfd/ospf_lsa.h"
+#include "ospfd/ospf_lsdb.h"
+#include "ospfd/ospf_neighbor.h"
+#include "ospfd/ospf_flood.h"
+#include "ospfd/ospf_spf.h"
+#include "ospfd/ospf_route.h"
+#include "ospfd/ospf_ia.h"
+#include "ospfd/ospf_abr.h"
+#include "ospfd/ospf_zebra.h"
+
+#define ROUTERS 60
+#define NETWORKS 40
+#define ROUNDS 300
+#define ABR_ROUND 150 /* from which on we are an ABR */
+#define ABRS 6
+#define SUMMARIES 8
+#define ASBRS 4
+#define RXMT_INTERVAL 1 /* sec */
+#define SPF_THREADS 2
+
+/* need these to link in libospf */
+struct thread_master *master;
+struct zebra_privs_t ospfd_privs = {
+	.user = NULL,
+	.group = NULL,
+	.vty_group = NULL,
+};
+
+/* The topology the LSAs are originated from; router 0 is us. */
+static int alive[ROUTERS];
+static u_int16_t attached[ROUTERS][NETWORKS]; /* cost, 0 if not */
+static u_int16_t stub_cost[ROUTERS];
+static u_int16_t summary_cost[ABRS][SUMMARIES]; /* 0 if not advertised */
+static u_int16_t asbr_cost[ABRS][ASBRS];
+static u_int32_t seqnum = 0x80000001;
+
+/* Kept up to date incrementally, and calculated from scratch each time */
+static struct ospf *incremental, *full;
+static struct ospf_neighbor *nbr; /* of the incremental instance */
+static struct ospf_lsdb *rxmt;	  /* what should be on its list */
+static struct prng *prng;
+static int round;
+static unsigned int spf_runs, summary_updates, summaries_checked;
+
+/* The summary-LSAs installed since, for the partial calculation */
+static struct list *changed;
+
+static struct in_addr router_id(int r) {
+	struct in_addr id;
+
+	id.s_addr = htonl(0xc0a80000 | (r + 1));
+	return id;
+}
+
+static struct in_addr if_addr(int r, int n) {
+	struct in_addr addr;
+
+	addr.s_addr = htonl(0x0a000000 | (n << 8) | (r + 1));
+	return addr;
+}
+
+/* Some of the routers are area border routers, for the summaries */
+static int abr_router(int a) {
+	return 5 + a * 10;
+}
+
+static int router_abr(int r) {
+	return r % 10 == 5 ? (r - 5) / 10 : -1;
+}
+
+static struct in_addr summary_id(int s) {
+	struct in_addr id;
+
+	id.s_addr = htonl(0x64400000 | (s << 8));
+	return id;
+}
+
+static struct in_addr asbr_id(int s) {
+	struct in_addr id;
+
+	id.s_addr = htonl(0xcb007100 | (s + 1));
+	return id;
+}
+
+/* The designated router, the first one attached */
+static int network_dr(int n) {
+	int r;
+
+	for(r = 0; r < ROUTERS; r++) {
+		if(alive[r] && attached[r][n]) {
+			return r;
+		}
+	}
+	return -1;
+}
+
+static struct ospf_lsa *lsa_new(struct ospf_area *area, u_char type, struct in_addr id, struct in_addr adv_router, size_t length) {
+	struct ospf_lsa *lsa;
+
+	lsa = ospf_lsa_new();
+	lsa->data = ospf_lsa_data_new(length);
+	lsa->area = area;
+	lsa->data->type = type;
+	lsa->data->id = id;
+	lsa->data->adv_router = adv_router;
+	lsa->data->ls_seqnum = htonl(seqnum);
+	lsa->data->length = htons(length);
+	return lsa;
+}
+
+static struct ospf_lsa *router_lsa(struct ospf_area *area, int r) {
+	struct router_lsa *rl;
+	struct ospf_lsa *lsa;
+	int n, dr, links = 1;
+
+	for(n = 0; n < NETWORKS; n++) {
+		if(attached[r][n]) {
+			links++;
+		}
+	}
+
+	lsa = lsa_new(area, OSPF_ROUTER_LSA, router_id(r), router_id(r), OSPF_LSA_HEADER_SIZE + 4 + links * OSPF_ROUTER_LSA_LINK_SIZE);
+	rl = (struct router_lsa *) lsa->data;
+	rl->links = htons(links);
+	if(router_abr(r) >= 0) {
+		rl->flags = ROUTER_LSA_BORDER;
+	}
+
+	links = 0;
+	for(n = 0; n < NETWORKS; n++) {
+		if(attached[r][n]) {
+			dr = network_dr(n);
+			rl->link[links].link_id = if_addr(dr, n);
+			rl->link[links].link_data = if_addr(r, n);
+			rl->link[links].type = LSA_LINK_TYPE_TRANSIT;
+			rl->link[links].metric = htons(attached[r][n]);
+			links++;
+		}
+	}
+	rl->link[links].link_id.s_addr = htonl(0xac100000 | (r << 8));
+	rl->link[links].link_data.s_addr = htonl(0xffffff00);
+	rl->link[links].type = LSA_LINK_TYPE_STUB;
+	rl->link[links].metric = htons(stub_cost[r]);
+
+	return lsa;
+}
+
+static struct ospf_lsa *network_lsa(struct ospf_area *area, int n) {
+	struct network_lsa *nl;
+	struct ospf_lsa *lsa;
+	int r, dr, routers = 0;
+
+	dr = network_dr(n);
+	for(r = 0; r < ROUTERS; r++) {
+		if(alive[r] && attached[r][n]) {
+			routers++;
+		}
+	}
+
+	lsa = lsa_new(area, OSPF_NETWORK_LSA, if_addr(dr, n), router_id(dr), OSPF_LSA_HEADER_SIZE + 4 + routers * 4);
+	nl = (struct network_lsa *) lsa->data;
+	nl->mask.s_addr = htonl(0xffffff00);
+
+	routers = 0;
+	for(r = 0; r < ROUTERS; r++) {
+		if(alive[r] && attached[r][n]) {
+			nl->routers[routers++] = router_id(r);
+		}
+	}
+	return lsa;
+}
+
+static struct ospf_lsa *summary_lsa(struct ospf_area *area, u_char type, int s, int a, u_int32_t cost) {
+	struct summary_lsa *sl;
+	struct ospf_lsa *lsa;
+
+	if(type == OSPF_SUMMARY_LSA) {
+		lsa = lsa_new(area, type, summary_id(s), router_id(abr_router(a)), OSPF_LSA_HEADER_SIZE + 8);
+	} else {
+		lsa = lsa_new(area, type, asbr_id(s), router_id(abr_router(a)), OSPF_LSA_HEADER_SIZE + 8);
+	}
+	sl = (struct summary_lsa *) lsa->data;
+	if(type == OSPF_SUMMARY_LSA) {
+		sl->mask.s_addr = htonl(0xffffff00);
+	}
+	sl->metric[0] = (cost >> 16) & 0xff;
+	sl->metric[1] = (cost >> 8) & 0xff;
+	sl->metric[2] = cost & 0xff;
+	return lsa;
+}
+
+/* Install the LSA, unless the one in the database already says as much;
+ * the database keeps the reference it was created with, as with ospfd.
+ * Returns the LSA installed, if it was.
+ */
+static struct ospf_lsa *lsa_install(struct ospf_lsa *lsa) {
+	struct ospf_lsa *old;
+
+	old = ospf_lsdb_lookup(lsa->area->lsdb, lsa);
+	if(old && !ospf_lsa_different(old, lsa)) {
+		ospf_lsa_discard(lsa);
+		return NULL;
+	}
+
+	if(old) {
+		ospf_discard_from_db(lsa->area->ospf, lsa->area->lsdb, old);
+	}
+	ospf_lsdb_add(lsa->area->lsdb, lsa);
+	if(lsa->data->type == OSPF_ROUTER_LSA && IPV4_ADDR_SAME(&lsa->data->id, &lsa->area->ospf->router_id)) {
+		ospf_lsa_unlock(&lsa->area->router_lsa_self);
+		lsa->area->router_lsa_self = ospf_lsa_lock(lsa);
+	}
+	return lsa;
+}
+
+/* As for a summary-LSA changed, to the incremental instance */
+static void lsa_changed(struct ospf *ospf, struct ospf_lsa *lsa) {
+	if(lsa && ospf == incremental && (lsa->data->type == OSPF_SUMMARY_LSA || lsa->data->type == OSPF_ASBR_SUMMARY_LSA)) {
+		listnode_add(changed, ospf_lsa_lock(lsa));
+	}
+}
+
+/* Summaries no longer advertised go MaxAge, and out the round after */
+static void summaries_flush(struct ospf *ospf, struct route_table *lsdb) {
+	struct route_node *rn;
+	struct ospf_lsa *lsa, *flushed;
+	struct list *gone, *maxage;
+	struct listnode *node;
+	int a, s;
+
+	gone = list_new();
+	maxage = list_new();
+	LSDB_LOOP(lsdb, rn, lsa) {
+		if(IS_LSA_MAXAGE(lsa)) {
+			listnode_add(gone, lsa);
+			continue;
+		}
+		a = router_abr((ntohl(lsa->data->adv_router.s_addr) & 0xff) - 1);
+		s = lsa->data->type == OSPF_SUMMARY_LSA ? (ntohl(lsa->data->id.s_addr) >> 8) & 0xff : (ntohl(lsa->data->id.s_addr) & 0xff) - 1;
+		if((lsa->data->type == OSPF_SUMMARY_LSA ? summary_cost[a][s] : asbr_cost[a][s]) == 0) {
+			listnode_add(maxage, lsa);
+		}
+	}
+	for(ALL_LIST_ELEMENTS_RO(gone, node, lsa)) {
+		ospf_discard_from_db(ospf, lsa->area->lsdb, lsa);
+	}
+	for(ALL_LIST_ELEMENTS_RO(maxage, node, lsa)) {
+		flushed = lsa_new(lsa->area, lsa->data->type, lsa->data->id, lsa->data->adv_router, ntohs(lsa->data->length));
+		memcpy(flushed->data, lsa->data, ntohs(lsa->data->length));
+		flushed->data->ls_age = htons(OSPF_LSA_MAXAGE);
+		lsa_changed(ospf, lsa_install(flushed));
+	}
+	list_delete(gone);
+	list_delete(maxage);
+}
+
+/* Bring the router- and network-LSAs of an area in line with the topology */
+static void originate_area(struct ospf *ospf, struct ospf_area *area) {
+	struct route_node *rn;
+	struct ospf_lsa *lsa;
+	struct list *gone;
+	struct listnode *node;
+	int r, n, dr;
+
+	for(r = 0; r < ROUTERS; r++) {
+		if(alive[r]) {
+			lsa_install(router_lsa(area, r));
+		}
+	}
+	for(n = 0; n < NETWORKS; n++) {
+		if(network_dr(n) >= 0) {
+			lsa_install(network_lsa(area, n));
+		}
+	}
+
+	gone = list_new();
+	LSDB_LOOP(ROUTER_LSDB(area), rn, lsa) {
+		for(r = 0; r < ROUTERS; r++) {
+			if(lsa->data->id.s_addr == router_id(r).s_addr) {
+				break;
+			}
+		}
+		if(!alive[r]) {
+			listnode_add(gone, lsa);
+		}
+	}
+	LSDB_LOOP(NETWORK_LSDB(area), rn, lsa) {
+		n = (ntohl(lsa->data->id.s_addr) >> 8) & 0xff;
+		dr = network_dr(n);
+		if(dr < 0 || lsa->data->id.s_addr != if_addr(dr, n).s_addr) {
+			listnode_add(gone, lsa);
+		}
+	}
+	for(ALL_LIST_ELEMENTS_RO(gone, node, lsa)) {
+		ospf_discard_from_db(ospf, area->lsdb, lsa);
+	}
+	list_delete(gone);
+}
+
+/* Bring the databases in line with the topology, the summaries only in
+ * the backbone */
+static void originate(struct ospf *ospf) {
+	struct ospf_area *area;
+	struct listnode *node;
+	int a, s;
+
+	seqnum++;
+	for(ALL_LIST_ELEMENTS_RO(ospf->areas, node, area)) {
+		originate_area(ospf, area);
+	}
+
+	area = ospf->backbone;
+	/* those of routers gone stay, as they would until they aged out */
+	for(a = 0; a < ABRS; a++) {
+		for(s = 0; s < SUMMARIES; s++) {
+			if(summary_cost[a][s]) {
+				lsa_changed(ospf, lsa_install(summary_lsa(area, OSPF_SUMMARY_LSA, s, a, summary_cost[a][s])));
+			}
+		}
+		for(s = 0; s < ASBRS; s++) {
+			if(asbr_cost[a][s]) {
+				lsa_changed(ospf, lsa_install(summary_lsa(area, OSPF_ASBR_SUMMARY_LSA, s, a, asbr_cost[a][s])));
+			}
+		}
+	}
+	summaries_flush(ospf, SUMMARY_LSDB(area));
+	summaries_flush(ospf, ASBR_SUMMARY_LSDB(area));
+}
+
+static struct ospf *test_ospf_new(void) {
+	struct ospf *ospf;
+	struct ospf_interface *oi;
+	struct ospf_area *area;
+	struct in_addr area_id;
+	char name[INTERFACE_NAMSIZ];
+	int i, n, pos;
+
+	ospf = XCALLOC(MTYPE_OSPF_TOP, sizeof(struct ospf));
+	ospf->router_id = router_id(0);
+	ospf->abr_type = OSPF_ABR_DEFAULT;
+	ospf->oiflist = list_new();
+	ospf->vlinks = list_new();
+	ospf->areas = list_new();
+	ospf->networks = route_table_init();
+	ospf->nbr_nbma = route_table_init();
+	ospf->lsdb = ospf_lsdb_new();
+	ospf->new_external_route = route_table_init();
+	ospf->old_external_route = route_table_init();
+	ospf->external_lsas = route_table_init();
+	ospf->maxage_lsa = route_table_init();
+	ospf->distance_table = route_table_init();
+	ospf->stub_router_admin_set = OSPF_STUB_ROUTER_ADMINISTRATIVE_UNSET;
+	ospf->spf_hold_multiplier = 1;
+	listnode_add(om->ospf, ospf);
+
+	/* our interfaces, in the order of the links in our router-LSA, the
+	 * same in both areas */
+	for(i = 0; i < 2; i++) {
+		area_id.s_addr = htonl(i);
+		area = ospf_area_get(ospf, area_id, OSPF_AREA_ID_FORMAT_ADDRESS);
+		for(n = 0, pos = 0; n < NETWORKS; n++) {
+			if(!attached[0][n]) {
+				continue;
+			}
+			snprintf(name, sizeof(name), "eth%d.%d", n, i);
+			oi = XCALLOC(MTYPE_OSPF_IF, sizeof(struct ospf_interface));
+			oi->ifp = if_get_by_name(name);
+			if_set_index(oi->ifp, i * NETWORKS + n + 1);
+			oi->ospf = ospf;
+			oi->area = area;
+			oi->type = OSPF_IFTYPE_BROADCAST;
+			oi->address = prefix_new();
+			oi->address->family = AF_INET;
+			oi->address->u.prefix4 = if_addr(0, n);
+			oi->address->prefixlen = 24;
+			oi->nbrs = route_table_init();
+			oi->params = XCALLOC(MTYPE_OSPF_IF_PARAMS, sizeof(struct ospf_if_params));
+			SET_IF_PARAM(oi->params, retransmit_interval);
+			oi->params->retransmit_interval = RXMT_INTERVAL;
+			oi->lsa_pos_beg = pos++;
+			oi->lsa_pos_end = pos;
+			listnode_add(ospf->oiflist, oi);
+			listnode_add(area->oiflist, oi);
+		}
+	}
+	return ospf;
+}
+
+static int path_cmp(struct ospf_route *a, struct ospf_route *b) {
+	struct listnode *node, *bnode;
+	struct ospf_path *pa, *pb;
+
+	if(a->cost != b->cost || a->path_type != b->path_type || listcount(a->paths) != listcount(b->paths)) {
+		return 1;
+	}
+	for(ALL_LIST_ELEMENTS_RO(a->paths, node, pa)) {
+		for(ALL_LIST_ELEMENTS_RO(b->paths, bnode, pb)) {
+			if(IPV4_ADDR_SAME(&pa->nexthop, &pb->nexthop) && pa->ifindex == pb->ifindex) {
+				break;
+			}
+		}
+		if(bnode == NULL) {
+			return 1;
+		}
+	}
+	return 0;
+}
+
+static void check_routes(int round) {
+	struct route_node *rn, *frn;
+	struct ospf_route *or, *fr;
+	unsigned long routes = 0, expected = 0;
+
+	for(rn = route_top(incremental->new_table); rn; rn = route_next(rn)) {
+		if((or = rn->info) == NULL) {
+			continue;
+		}
+		routes++;
+		frn = route_node_lookup(full->new_table, &rn->p);
+		if(frn == NULL || (fr = frn->info) == NULL || path_cmp(or, fr)) {
+			printf("round %d: route to %s/%d differs\n", round, inet_ntoa(rn->p.u.prefix4), rn->p.prefixlen);
+			exit(1);
+		}
+		route_unlock_node(frn);
+	}
+	for(rn = route_top(full->new_table); rn; rn = route_next(rn)) {
+		if(rn->info) {
+			expected++;
+		}
+	}
+	if(routes != expected) {
+		printf("round %d: %lu routes, %lu expected\n", round, routes, expected);
+		exit(1);
+	}
+}
+
+static unsigned long rtrs_count(struct route_node *rn) {
+	return rn && rn->info ? listcount((struct list *) rn->info) : 0;
+}
+
+static void check_rtrs(int round) {
+	struct route_node *rn, *frn;
+	struct listnode *node, *fnode;
+	struct ospf_route *or, *fr;
+	unsigned long routes = 0, expected = 0;
+
+	for(rn = route_top(incremental->new_rtrs); rn; rn = route_next(rn)) {
+		if(rtrs_count(rn) == 0) {
+			continue;
+		}
+		routes++;
+		frn = route_node_lookup(full->new_rtrs, &rn->p);
+		if(rtrs_count(frn) != rtrs_count(rn)) {
+			printf("round %d: routes to router %s differ\n", round, inet_ntoa(rn->p.u.prefix4));
+			exit(1);
+		}
+		for(ALL_LIST_ELEMENTS_RO((struct list *) rn->info, node, or)) {
+			for(ALL_LIST_ELEMENTS_RO((struct list *) frn->info, fnode, fr)) {
+				if(IPV4_ADDR_SAME(&or->u.std.area_id, &fr->u.std.area_id) && or->u.std.flags == fr->u.std.flags && !path_cmp(or, fr)) {
+					break;
+				}
+			}
+			if(fnode == NULL) {
+				printf("round %d: route to router %s differs\n", round, inet_ntoa(rn->p.u.prefix4));
+				exit(1);
+			}
+		}
+		route_unlock_node(frn);
+	}
+	for(rn = route_top(full->new_rtrs); rn; rn = route_next(rn)) {
+		if(rtrs_count(rn)) {
+			expected++;
+		}
+	}
+	if(routes != expected) {
+		printf("round %d: %lu routes to routers, %lu expected\n", round, routes, expected);
+		exit(1);
+	}
+}
+
+/* Every LSA walked in order is what a lookup finds, and nothing else is */
+static void check_lsdb(int round, struct ospf *ospf) {
+	struct ospf_lsdb *lsdb = ospf->backbone->lsdb;
+	struct route_node *rn;
+	struct ospf_lsa *lsa;
+	struct in_addr none;
+	unsigned long count = 0;
+	int i;
+
+	for(i = OSPF_MIN_LSA; i < OSPF_MAX_LSA; i++) {
+		LSDB_LOOP(lsdb->type[i].db, rn, lsa) {
+			count++;
+			if(ospf_lsdb_lookup(lsdb, lsa) != lsa || ospf_lsdb_lookup_by_id(lsdb, i, lsa->data->id, lsa->data->adv_router) != lsa) {
+				printf("round %d: LSA %s type %d not found\n", round, inet_ntoa(lsa->data->id), i);
+				exit(1);
+			}
+		}
+	}
+	none.s_addr = htonl(0xc6336401); /* 198.51.100.1 */
+	if(count != ospf_lsdb_count_all(lsdb) || ospf_lsdb_lookup_by_id(lsdb, OSPF_ROUTER_LSA, none, none) || ospf_lsdb_lookup_by_id(lsdb, OSPF_SUMMARY_LSA, summary_id(0), none)) {
+		printf("round %d: LSDB lookups differ from its tables\n", round);
+		exit(1);
+	}
+	if(lsdb->hash == NULL) {
+		printf("round %d: %lu LSAs, and no hash\n", round, count);
+		exit(1);
+	}
+}
+
+/* Our summary-LSAs in the area, those not flushed, counted */
+static unsigned long summaries_self(struct ospf_area *area) {
+	struct route_node *rn;
+	struct ospf_lsa *lsa;
+	unsigned long count = 0;
+
+	LSDB_LOOP(SUMMARY_LSDB(area), rn, lsa) {
+		if(IS_LSA_SELF(lsa) && !IS_LSA_MAXAGE(lsa)) {
+			count++;
+		}
+	}
+	return count;
+}
+
+/* The summary-LSAs originated after the routes changed are those of the
+ * full ABR task */
+static void check_summaries(int round) {
+	struct ospf_area *area, *farea;
+	struct listnode *node;
+	struct route_node *rn;
+	struct ospf_lsa *lsa, *flsa;
+
+	for(ALL_LIST_ELEMENTS_RO(incremental->areas, node, area)) {
+		farea = ospf_area_lookup_by_area_id(full, area->area_id);
+		LSDB_LOOP(SUMMARY_LSDB(area), rn, lsa) {
+			if(!IS_LSA_SELF(lsa) || IS_LSA_MAXAGE(lsa)) {
+				continue;
+			}
+			flsa = ospf_lsdb_lookup_by_id(farea->lsdb, OSPF_SUMMARY_LSA, lsa->data->id, full->router_id);
+			if(flsa == NULL || IS_LSA_MAXAGE(flsa) || memcmp(((struct summary_lsa *) lsa->data)->metric, ((struct summary_lsa *) flsa->data)->metric, 3) || ((struct summary_lsa *) lsa->data)->mask.s_addr != ((struct summary_lsa *) flsa->data)->mask.s_addr) {
+				printf("round %d: summary-LSA %s in area %s differs\n", round, inet_ntoa(lsa->data->id), inet_ntoa(area->area_id));
+				exit(1);
+			}
+			summaries_checked++;
+		}
+		if(summaries_self(area) != summaries_self(farea)) {
+			printf("round %d: %lu summary-LSAs in area %s, %lu expected\n", round, summaries_self(area), inet_ntoa(area->area_id), summaries_self(farea));
+			exit(1);
+		}
+	}
+}
+
+/* Become an ABR, with an area range in each area and one suppressed */
+static void abr_start(struct ospf *ospf) {
+	struct ospf_area *area;
+	struct listnode *node;
+	struct prefix_ipv4 p;
+
+	for(ALL_LIST_ELEMENTS_RO(ospf->areas, node, area)) {
+		area->act_ints = 1;
+	}
+	SET_FLAG(ospf->flags, OSPF_FLAG_ABR);
+
+	p.family = AF_INET;
+	p.prefix.s_addr = htonl(0xac100000); /* stub networks of routers 0-31 */
+	p.prefixlen = 19;
+	ospf_area_range_set(ospf, ospf->backbone->area_id, &p, OSPF_AREA_RANGE_ADVERTISE);
+	area = listgetdata(listtail(ospf->areas));
+	p.prefix.s_addr = htonl(0x0a000000); /* transit networks 0-31 */
+	ospf_area_range_set(ospf, area->area_id, &p, OSPF_AREA_RANGE_ADVERTISE);
+	p.prefix.s_addr = htonl(0xac102000);
+	p.prefixlen = 20;
+	ospf_area_range_set(ospf, area->area_id, &p, 0);
+}
+
+/* Put some of the LSAs on the neighbor's retransmission list, newer ones
+ * replacing what's there, take some off, and compare. */
+static void check_rxmt(int round) {
+	struct ospf_lsdb *lsdb = incremental->backbone->lsdb;
+	struct route_node *rn;
+	struct ospf_lsa *lsa, *old;
+	struct list *update;
+	struct listnode *node;
+	int i;
+
+	for(i = OSPF_MIN_LSA; i < OSPF_MAX_LSA; i++) {
+		LSDB_LOOP(lsdb->type[i].db, rn, lsa) {
+			if(prng_range(prng, 3) == 0) {
+				old = ospf_lsdb_lookup(rxmt, lsa);
+				if(ospf_lsa_more_recent(old, lsa) < 0) {
+					ospf_lsdb_add(rxmt, lsa);
+				}
+				ospf_ls_retransmit_add(nbr, lsa);
+			}
+		}
+		LSDB_LOOP(rxmt->type[i].db, rn, lsa) {
+			if(prng_range(prng, 4) == 0) {
+				ospf_ls_retransmit_delete(nbr, lsa);
+				ospf_lsdb_delete(rxmt, lsa);
+			}
+		}
+	}
+
+	for(i = OSPF_MIN_LSA; i < OSPF_MAX_LSA; i++) {
+		LSDB_LOOP(rxmt->type[i].db, rn, lsa) {
+			if(ospf_ls_retransmit_lookup(nbr, lsa) != lsa || lsa->retransmit_counter != 1) {
+				printf("round %d: LSA %s type %d not on the retransmission list\n", round, inet_ntoa(lsa->data->id), i);
+				exit(1);
+			}
+		}
+	}
+	if(ospf_ls_retransmit_count(nbr) != ospf_lsdb_count_all(rxmt)) {
+		printf("round %d: %lu LSAs to retransmit, not %lu\n", round, ospf_ls_retransmit_count(nbr), ospf_lsdb_count_all(rxmt));
+		exit(1);
+	}
+
+	/* whatever is due is on the list, and stays there */
+	update = list_new();
+	ospf_ls_retransmit_due(nbr, update);
+	for(ALL_LIST_ELEMENTS_RO(update, node, lsa)) {
+		if(ospf_lsdb_lookup(rxmt, lsa) != lsa) {
+			printf("round %d: LSA %s retransmitted, not on the list\n", round, inet_ntoa(lsa->data->id));
+			exit(1);
+		}
+	}
+	list_delete(update);
+	if(ospf_ls_retransmit_count(nbr) != ospf_lsdb_count_all(rxmt)) {
+		printf("round %d: retransmission list changed by the timer\n", round);
+		exit(1);
+	}
+}
+
+/* After a retransmission interval everything on the list is due once */
+static void check_rxmt_due(void) {
+	struct list *update = list_new();
+	struct timeval now;
+
+	sleep(RXMT_INTERVAL + 1);
+	quagga_gettime(QUAGGA_CLK_MONOTONIC, &now);
+
+	ospf_ls_retransmit_due(nbr, update);
+	if(listcount(update) != ospf_lsdb_count_all(rxmt)) {
+		printf("%u of %lu LSAs due for retransmission\n", listcount(update), ospf_lsdb_count_all(rxmt));
+		exit(1);
+	}
+	list_delete_all_node(update);
+	ospf_ls_retransmit_due(nbr, update);
+	if(listcount(update) != 0) {
+		printf("%u LSAs due again at once\n", listcount(update));
+		exit(1);
+	}
+	list_delete(update);
+}
+
+static void change(void) {
+	int r, n;
+
+	/* our own links only change now and then, to go through a full run */
+	r = prng_range(prng, 50) ? 1 + prng_range(prng, ROUTERS - 1) : 0;
+	n = prng_range(prng, NETWORKS);
+
+	switch(prng_range(prng, 6)) {
+		case 0:
+			if(r) {
+				alive[r] = !alive[r];
+			}
+			break;
+		case 1:
+			if(r) {
+				attached[r][n] = attached[r][n] ? 0 : 1 + prng_range(prng, 10);
+			}
+			break;
+		case 2: stub_cost[r] = 1 + prng_range(prng, 20); break;
+		default:
+			if(attached[r][n]) {
+				attached[r][n] = 1 + prng_range(prng, 10);
+			}
+			break;
+	}
+}
+
+static void change_summary(void) {
+	int a, s;
+
+	a = prng_range(prng, ABRS);
+	if(prng_range(prng, 3)) {
+		s = prng_range(prng, SUMMARIES);
+		summary_cost[a][s] = prng_range(prng, 3) ? 1 + prng_range(prng, 20) : 0;
+	} else {
+		s = prng_range(prng, ASBRS);
+		asbr_cost[a][s] = prng_range(prng, 3) ? 1 + prng_range(prng, 20) : 0;
+	}
+}
+
+/* Check the routes of the calculations just run, then change the
+ * topology, or the summaries alone, and run them again; timers of
+ * 0 msec run first.
+ */
+static int test_round(struct thread *thread) {
+	struct listnode *node;
+	struct ospf_lsa *lsa;
+	int i, summaries = 0;
+
+	if(round > 0) {
+		check_routes(round);
+		check_rtrs(round);
+		check_lsdb(round, incremental);
+		check_lsdb(round, full);
+		check_rxmt(round);
+		if(round > ABR_ROUND) {
+			check_summaries(round);
+		}
+		summaries = prng_range(prng, 3) == 0;
+		for(i = prng_range(prng, 4); i > 0; i--) {
+			if(summaries) {
+				change_summary();
+			} else {
+				change();
+			}
+		}
+	}
+
+	if(round++ == ROUNDS) {
+		if(incremental->backbone->spf_incremental < spf_runs * 3 / 4) {
+			printf("only %u of %u SPF runs incremental\n", incremental->backbone->spf_incremental, spf_runs);
+			exit(1);
+		}
+		if(summary_updates < ROUNDS / 10) {
+			printf("only %u summary-LSAs updated\n", summary_updates);
+			exit(1);
+		}
+		check_rxmt_due();
+		ospf_ls_retransmit_cleanup(nbr);
+		ospf_lsdb_delete_all(rxmt);
+		if(summaries_checked < ROUNDS) {
+			printf("only %u summary-LSAs of ours checked\n", summaries_checked);
+			exit(1);
+		}
+		printf("Incremental SPF OK, %u of %u runs, %u summary-LSAs updated, %u of ours checked.\n", incremental->backbone->spf_incremental, spf_runs, summary_updates, summaries_checked);
+		exit(0);
+	}
+
+	if(round == ABR_ROUND) {
+		abr_start(incremental);
+		abr_start(full);
+	}
+
+	originate(incremental);
+	originate(full);
+	ospf_spf_free(full->backbone);
+	full->abr_resync = 1;
+	ospf_spf_calculate_schedule(full, SPF_FLAG_ROUTER_LSA_INSTALL);
+	/* area border routers take summaries in with a full calculation */
+	if(summaries && !IS_OSPF_ABR(incremental)) {
+		for(ALL_LIST_ELEMENTS_RO(changed, node, lsa)) {
+			if(!ospf_ia_incremental_update(incremental, lsa)) {
+				printf("round %d: summary-LSA %s not updated\n", round, inet_ntoa(lsa->data->id));
+				exit(1);
+			}
+			summary_updates++;
+		}
+	} else {
+		ospf_spf_calculate_schedule(incremental, SPF_FLAG_ROUTER_LSA_INSTALL);
+		spf_runs++;
+	}
+	for(ALL_LIST_ELEMENTS_RO(changed, node, lsa)) {
+		ospf_lsa_unlock(&lsa);
+	}
+	list_delete_all_node(changed);
+
+	thread_add_timer_msec(master, test_round, NULL, 1);
+	return 0;
+}
+
+int main(int argc, char **argv) {
+	int r, n;
+
+	prng = prng_new(0);
+	master = thread_master_create();
+	cmd_init(0);
+	vrf_init();
+	ospf_master_init();
+	zclient = zclient_new(master);
+	om->spf_threads = SPF_THREADS;
+
+	for(r = 0; r < ROUTERS; r++) {
+		alive[r] = 1;
+		stub_cost[r] = 1 + prng_range(prng, 20);
+		for(n = 0; n < NETWORKS; n++) {
+			if(prng_range(prng, 12) == 0) {
+				attached[r][n] = 1 + prng_range(prng, 10);
+			}
+		}
+	}
+	for(n = 0; n < 3; n++) {
+		attached[0][n] = 1 + prng_range(prng, 10);
+	}
+	for(r = 0; r < ABRS; r++) {
+		for(n = 0; n < SUMMARIES; n++) {
+			if(prng_range(prng, 2)) {
+				summary_cost[r][n] = 1 + prng_range(prng, 20);
+			}
+		}
+		for(n = 0; n < ASBRS; n++) {
+			if(prng_range(prng, 2)) {
+				asbr_cost[r][n] = 1 + prng_range(prng, 20);
+			}
+		}
+	}
+	changed = list_new();
+
+	incremental = test_ospf_new();
+	full = test_ospf_new();
+
+	nbr = XCALLOC(MTYPE_OSPF_NEIGHBOR, sizeof(struct ospf_neighbor));
+	nbr->oi = listgetdata(listhead(incremental->oiflist));
+	nbr->router_id = router_id(1);
+	rxmt = ospf_lsdb_new();
+
+	thread_add_event(master, test_round, NULL, 0);
+	thread_main(master);
+
+	return 0;
+}
@@ -0,0 +1,192 @@
+/*
+ * Test program to check that prefix-lists long enough to be looked up
+ * through a trie still give the first matching entry in sequence order,
+ * with ge/le ranges, while entries are added, replaced and deleted.
+ *
+ * This file is part of Quagga
+ *
+ * Quagga is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2, or (at your option) any
+ * later version.
+ *
+ * Quagga is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Quagga; see the file COPYING.  If not, write to the Free
+ * Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ * 02111-1307, USA.
+ */
+
+#include <zebra.h>
+
+#include <stdio.h>
+
+#include "memory.h"
+#include "prefix.h"
+#include "command.h"
+#include "plist.h"
+#include "prng.h"
+
+#define ENTRIES 2000
+#define LOOKUPS 20000
+
+struct thread_master *master;
+
+static char name[] = "test";
+
+static struct entry {
+	struct orf_prefix orf;
+	int permit;
+	int present;
+} entries[ENTRIES];
+
+/* A prefix in 10.0.0.0/8, mostly in a handful of /16s so that entries
+ * nest and overlap. */
+static void random_prefix(struct prng *prng, struct prefix *p, int minlen, int maxlen) {
+	struct prefix_ipv4 *p4 = (struct prefix_ipv4 *) p;
+	u_int32_t addr = 0x0a000000 | (prng_range(prng, 4) << 16) | prng_range(prng, 0x10000);
+
+	memset(p, 0, sizeof(struct prefix));
+	p4->family = AF_INET;
+	p4->prefixlen = minlen + prng_range(prng, maxlen + 1 - minlen);
+	p4->prefix.s_addr = htonl(addr);
+	apply_mask_ipv4(p4);
+}
+
+static void random_entry(struct prng *prng, struct entry *e, int seq) {
+	struct orf_prefix *orf = &e->orf;
+
+	memset(orf, 0, sizeof(struct orf_prefix));
+	orf->seq = seq;
+	random_prefix(prng, &orf->p, 12, 24);
+	e->permit = prng_range(prng, 2);
+
+	switch(prng_range(prng, 4)) {
+		case 0: break;
+		case 1:
+			if(orf->p.prefixlen < 32) {
+				orf->le = orf->p.prefixlen + 1 + prng_range(prng, 32 - orf->p.prefixlen);
+			}
+			break;
+		case 2:
+			if(orf->p.prefixlen < 32) {
+				orf->ge = orf->p.prefixlen + 1 + prng_range(prng, 32 - orf->p.prefixlen);
+			}
+			break;
+		case 3:
+			if(orf->p.prefixlen < 31) {
+				orf->ge = orf->p.prefixlen + 1 + prng_range(prng, 31 - orf->p.prefixlen);
+				orf->le = orf->ge + prng_range(prng, 33 - orf->ge);
+			}
+			break;
+	}
+}
+
+/* What the first matching entry, in sequence order, says */
+static enum prefix_list_type reference_apply(struct prefix *p, int count) {
+	int i;
+
+	if(count == 0) {
+		return PREFIX_PERMIT;
+	}
+
+	for(i = 0; i < ENTRIES; i++) {
+		struct orf_prefix *orf = &entries[i].orf;
+
+		if(!entries[i].present || !prefix_match(&orf->p, p)) {
+			continue;
+		}
+		if(!orf->le && !orf->ge) {
+			if(p->prefixlen != orf->p.prefixlen) {
+				continue;
+			}
+		} else {
+			if(orf->le && p->prefixlen > orf->le) {
+				continue;
+			}
+			if(orf->ge && p->prefixlen < orf->ge) {
+				continue;
+			}
+		}
+		return entries[i].permit ? PREFIX_PERMIT : PREFIX_DENY;
+	}
+	return PREFIX_DENY;
+}
+
+static void check_lookups(struct prng *prng, int count) {
+	struct prefix_list *plist = prefix_bgp_orf_lookup(AFI_IP, name);
+	struct prefix p;
+	int i;
+
+	for(i = 0; i < LOOKUPS; i++) {
+		random_prefix(prng, &p, 16, 32);
+		assert(prefix_list_apply(plist, &p) == reference_apply(&p, count));
+	}
+
+	/* and the entries' own prefixes, which are sure to hit something */
+	for(i = 0; i < ENTRIES; i++) {
+		if(entries[i].present) {
+			assert(prefix_list_apply(plist, &entries[i].orf.p) == reference_apply(&entries[i].orf.p, count));
+		}
+	}
+}
+
+int main(int argc, char **argv) {
+	struct prng *prng;
+	int count = 0;
+	int i, round;
+
+	prng = prng_new(0);
+
+	for(i = 0; i < ENTRIES; i++) {
+		random_entry(prng, &entries[i], (i + 1) * 5);
+		if(prefix_bgp_orf_set(name, AFI_IP, &entries[i].orf, entries[i].permit, 1) == CMD_SUCCESS) {
+			entries[i].present = 1;
+			count++;
+		}
+
+		/* across the switch from walking the list to the trie */
+		if(i < 40) {
+			check_lookups(prng, count);
+		}
+	}
+	check_lookups(prng, count);
+
+	for(round = 0; round < 4; round++) {
+		for(i = 0; i < ENTRIES; i++) {
+			struct entry replacement;
+
+			if(prng_range(prng, 3)) {
+				continue;
+			}
+			if(entries[i].present && prng_range(prng, 2)) {
+				/* same sequence number, so it takes the place of the old */
+				random_entry(prng, &replacement, (i + 1) * 5);
+				if(prefix_bgp_orf_set(name, AFI_IP, &replacement.orf, replacement.permit, 1) == CMD_SUCCESS) {
+					replacement.present = 1;
+					entries[i] = replacement;
+				}
+			} else if(entries[i].present) {
+				assert(prefix_bgp_orf_set(name, AFI_IP, &entries[i].orf, entries[i].permit, 0) == CMD_SUCCESS);
+				entries[i].present = 0;
+				count--;
+			} else {
+				random_entry(prng, &entries[i], (i + 1) * 5);
+				if(prefix_bgp_orf_set(name, AFI_IP, &entries[i].orf, entries[i].permit, 1) == CMD_SUCCESS) {
+					entries[i].present = 1;
+					count++;
+				}
+			}
+		}
+		check_lookups(prng, count);
+	}
+	printf("Prefix-list lookups OK.\n");
+
+	prefix_bgp_orf_remove_all(AFI_IP, name);
+	prng_free(prng);
+	return 0;
+}
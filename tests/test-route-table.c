@@ -0,0 +1,607 @@
+/*
+ * Route table implementations, side by side.
+ *
+ * Each implementation sits behind struct table_impl.  Besides lib/table.c
+ * there is a reference one keeping a hash of prefixes per prefix length,
+ * which gets longest prefix matches by probing lengths from the longest
+ * down.  A new table implementation is added to impls[] to be checked
+ * and measured against the others.
+ *
+ * Run without arguments, random inserts, deletes, exact lookups and
+ * longest prefix matches are applied to all of them over a small, dense
+ * address space, and every answer has to agree.
+ *
+ * With -b, each is loaded with an IPv4 and an IPv6 table and timed for
+ * insert, exact lookup, match of addresses within the table's prefixes,
+ * a full walk and delete, and its memory is reported in bytes per
+ * prefix.  The tables follow the prefix length distribution of the DFZ,
+ * or come from a file of prefixes, one per line, with -f.
+ *
+ * This file is part of Quagga
+ *
+ * Quagga is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2, or (at your option) any
+ * later version.
+ *
+ * Quagga is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Quagga; see the file COPYING.  If not, write to the Free
+ * Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ * 02111-1307, USA.
+ */
+
+#include <zebra.h>
+
+#include <stdio.h>
+
+#include "memory.h"
+#include "prefix.h"
+#include "table.h"
+#include "hash.h"
+#include "jhash.h"
+#include "prng.h"
+
+#define FUZZ_OPS 200000
+
+struct thread_master *master;
+
+struct table_impl {
+	const char *name;
+	void *(*create)(void);
+	void (*destroy)(void *);
+	void (*insert)(void *, const struct prefix *);
+	int (*remove)(void *, const struct prefix *);                 /* 1 if it was there */
+	int (*lookup)(void *, const struct prefix *);                 /* exact, 1 if there */
+	int (*match)(void *, const struct prefix *, struct prefix *); /* longest, 1 if any */
+	unsigned long (*walk)(void *);                                /* prefixes visited */
+};
+
+/* lib/table.c: a node holds a prefix if its info is set */
+
+static void *rt_create(void) {
+	return route_table_init();
+}
+
+static void rt_destroy(void *t) {
+	struct route_node *rn;
+
+	for(rn = route_top(t); rn; rn = route_next(rn)) {
+		if(rn->info) {
+			rn->info = NULL;
+			route_unlock_node(rn);
+		}
+	}
+	route_table_finish(t);
+}
+
+static void rt_insert(void *t, const struct prefix *p) {
+	struct route_node *rn = route_node_get(t, p);
+
+	if(rn->info) {
+		route_unlock_node(rn);
+	} else {
+		rn->info = rn;
+	}
+}
+
+static int rt_remove(void *t, const struct prefix *p) {
+	struct route_node *rn = route_node_lookup(t, p);
+
+	if(!rn) {
+		return 0;
+	}
+	route_unlock_node(rn);
+	if(!rn->info) {
+		return 0;
+	}
+	rn->info = NULL;
+	route_unlock_node(rn);
+	return 1;
+}
+
+static int rt_lookup(void *t, const struct prefix *p) {
+	struct route_node *rn = route_node_lookup(t, p);
+	int found;
+
+	if(!rn) {
+		return 0;
+	}
+	found = rn->info != NULL;
+	route_unlock_node(rn);
+	return found;
+}
+
+static int rt_match(void *t, const struct prefix *p, struct prefix *res) {
+	struct route_node *rn = route_node_match(t, p);
+
+	if(!rn) {
+		return 0;
+	}
+	prefix_copy(res, &rn->p);
+	route_unlock_node(rn);
+	return 1;
+}
+
+static unsigned long rt_walk(void *t) {
+	struct route_node *rn;
+	unsigned long n = 0;
+
+	for(rn = route_top(t); rn; rn = route_next(rn)) {
+		n += rn->info != NULL;
+	}
+	return n;
+}
+
+/* Reference: a hash of prefixes for each prefix length */
+
+struct lenhash {
+	struct hash *len[IPV6_MAX_BITLEN + 1];
+};
+
+static unsigned int lh_key(void *data) {
+	struct prefix *p = data;
+
+	return jhash(&p->u.prefix, p->family == AF_INET ? 4 : 16, p->prefixlen);
+}
+
+static int lh_cmp(const void *a, const void *b) {
+	return prefix_same(a, b);
+}
+
+static void *lh_create(void) {
+	return XCALLOC(MTYPE_TMP, sizeof(struct lenhash));
+}
+
+static void lh_free_prefix(void *p) {
+	prefix_free(p);
+}
+
+static void lh_destroy(void *t) {
+	struct lenhash *lh = t;
+	int i;
+
+	for(i = 0; i <= IPV6_MAX_BITLEN; i++) {
+		if(lh->len[i]) {
+			hash_clean(lh->len[i], lh_free_prefix);
+			hash_free(lh->len[i]);
+		}
+	}
+	XFREE(MTYPE_TMP, lh);
+}
+
+static void *lh_alloc(void *p) {
+	struct prefix *copy = prefix_new();
+
+	prefix_copy(copy, p);
+	return copy;
+}
+
+static void lh_insert(void *t, const struct prefix *p) {
+	struct lenhash *lh = t;
+
+	if(!lh->len[p->prefixlen]) {
+		lh->len[p->prefixlen] = hash_create_open(lh_key, lh_cmp);
+	}
+	hash_get(lh->len[p->prefixlen], (void *) p, lh_alloc);
+}
+
+static int lh_remove(void *t, const struct prefix *p) {
+	struct lenhash *lh = t;
+	struct prefix *found;
+
+	if(!lh->len[p->prefixlen] || !(found = hash_release(lh->len[p->prefixlen], (void *) p))) {
+		return 0;
+	}
+	prefix_free(found);
+	return 1;
+}
+
+static int lh_lookup(void *t, const struct prefix *p) {
+	struct lenhash *lh = t;
+
+	return lh->len[p->prefixlen] && hash_lookup(lh->len[p->prefixlen], (void *) p);
+}
+
+static int lh_match(void *t, const struct prefix *p, struct prefix *res) {
+	struct lenhash *lh = t;
+	struct prefix q;
+	int len;
+
+	for(len = p->prefixlen; len >= 0; len--) {
+		if(!lh->len[len] || !lh->len[len]->count) {
+			continue;
+		}
+		prefix_copy(&q, p);
+		q.prefixlen = len;
+		apply_mask(&q);
+		if(hash_lookup(lh->len[len], &q)) {
+			prefix_copy(res, &q);
+			return 1;
+		}
+	}
+	return 0;
+}
+
+static void lh_walk_one(struct hash_backet *hb, void *arg) {
+	(*(unsigned long *) arg)++;
+}
+
+static unsigned long lh_walk(void *t) {
+	struct lenhash *lh = t;
+	unsigned long n = 0;
+	int i;
+
+	for(i = 0; i <= IPV6_MAX_BITLEN; i++) {
+		if(lh->len[i]) {
+			hash_iterate(lh->len[i], lh_walk_one, &n);
+		}
+	}
+	return n;
+}
+
+static const struct table_impl impls[] = {
+	{ "route_table", rt_create, rt_destroy, rt_insert, rt_remove, rt_lookup, rt_match, rt_walk },
+	{ "lenhash", lh_create, lh_destroy, lh_insert, lh_remove, lh_lookup, lh_match, lh_walk },
+};
+#define NIMPLS array_size(impls)
+
+/* Random prefixes */
+
+struct lendist {
+	u_char len;
+	unsigned short permille;
+};
+
+/* Share of each prefix length in the IPv4 and IPv6 DFZ */
+static const struct lendist dfz4[] = {
+	{ 24, 615 }, { 23, 100 }, { 22, 120 }, { 21, 45 }, { 20, 45 }, { 19, 25 }, { 18, 15 },
+	{ 17, 10 },  { 16, 15 },  { 15, 3 },   { 14, 3 },  { 13, 2 },  { 12, 2 },  { 0, 0 },
+};
+static const struct lendist dfz6[] = {
+	{ 48, 480 }, { 32, 130 }, { 44, 90 }, { 40, 60 }, { 36, 30 }, { 29, 35 }, { 46, 40 }, { 47, 30 }, { 45, 15 }, { 42, 15 },
+	{ 33, 15 },  { 34, 10 },  { 28, 10 }, { 38, 10 }, { 30, 10 }, { 31, 5 },  { 35, 5 },  { 39, 5 },  { 41, 5 },  { 0, 0 },
+};
+
+static u_char random_len(struct prng *prng, const struct lendist *dist) {
+	unsigned int r = prng_rand(prng) % 1000;
+
+	for(; dist->permille; dist++) {
+		if(r < dist->permille) {
+			return dist->len;
+		}
+		r -= dist->permille;
+	}
+	return dist[-1].len;
+}
+
+/* prng.c is made for fuzzing strings: its draws are even and close to
+ * each other, which would give a table full of duplicates */
+static u_int32_t random32(struct prng *prng) {
+	return ((u_int32_t) random() << 16) ^ (u_int32_t) random() ^ prng_rand(prng);
+}
+
+/* A random address; IPv4 in 1/8 to 223/8 less 10/8 and 127/8, IPv6 in
+ * 2000::/3. */
+static void random_addr(struct prng *prng, u_char family, struct prefix *p) {
+	int i;
+
+	memset(p, 0, sizeof(*p));
+	p->family = family;
+	if(family == AF_INET) {
+		u_int32_t a;
+
+		do {
+			a = random32(prng);
+		} while((a >> 24) < 1 || (a >> 24) > 223 || (a >> 24) == 10 || (a >> 24) == 127);
+		p->u.prefix4.s_addr = htonl(a);
+		p->prefixlen = IPV4_MAX_BITLEN;
+	} else {
+		for(i = 0; i < 4; i++) {
+			u_int32_t w = htonl(random32(prng));
+
+			memcpy(&p->u.prefix6.s6_addr[i * 4], &w, 4);
+		}
+		p->u.prefix6.s6_addr[0] = 0x20 | (p->u.prefix6.s6_addr[0] & 0x1f);
+		p->prefixlen = IPV6_MAX_BITLEN;
+	}
+}
+
+/* A random host address covered by prefix pfx */
+static void random_addr_within(struct prng *prng, const struct prefix *pfx, struct prefix *p) {
+	u_char *a = (u_char *) &p->u.prefix;
+	const u_char *n = (const u_char *) &pfx->u.prefix;
+	int i;
+
+	random_addr(prng, pfx->family, p);
+	for(i = 0; i < pfx->prefixlen / 8; i++) {
+		a[i] = n[i];
+	}
+	if(pfx->prefixlen % 8) {
+		u_char mask = 0xff << (8 - pfx->prefixlen % 8);
+
+		a[i] = (n[i] & mask) | (a[i] & ~mask);
+	}
+}
+
+/* Differential fuzzing */
+
+static void fuzz_fail(const char *what, const struct prefix *p, int impl) {
+	char buf[PREFIX_STRLEN];
+
+	fprintf(stderr, "%s %s: %s disagrees with %s\n", what, prefix2str(p, buf, sizeof(buf)), impls[impl].name, impls[0].name);
+	exit(1);
+}
+
+/* Prefixes of /8 to /32 or /24 to /128 within a /16 or a /40, so
+ * that most of them overlap. */
+static void fuzz_prefix(struct prng *prng, u_char family, struct prefix *p) {
+	random_addr(prng, family, p);
+	if(family == AF_INET) {
+		p->u.prefix4.s_addr = htonl(0x0a000000 | (ntohl(p->u.prefix4.s_addr) & 0xffff));
+		p->prefixlen = 8 + prng_rand(prng) % 25;
+	} else {
+		memset(&p->u.prefix6.s6_addr[0], 0, 5);
+		p->u.prefix6.s6_addr[0] = 0x20;
+		p->u.prefix6.s6_addr[1] = 0x01;
+		p->u.prefix6.s6_addr[2] = 0x0d;
+		p->u.prefix6.s6_addr[3] = 0xb8;
+		p->prefixlen = 24 + prng_rand(prng) % 105;
+	}
+	apply_mask(p);
+}
+
+static void fuzz(struct prng *prng, u_char family) {
+	void *t[NIMPLS];
+	struct prefix p, res[NIMPLS];
+	int found[NIMPLS];
+	unsigned long op, walked;
+	unsigned int i;
+
+	for(i = 0; i < NIMPLS; i++) {
+		t[i] = impls[i].create();
+	}
+
+	for(op = 0; op < FUZZ_OPS; op++) {
+		fuzz_prefix(prng, family, &p);
+
+		switch(prng_rand(prng) % 4) {
+			case 0:
+				for(i = 0; i < NIMPLS; i++) {
+					impls[i].insert(t[i], &p);
+				}
+				break;
+			case 1:
+				for(i = 0; i < NIMPLS; i++) {
+					found[i] = impls[i].remove(t[i], &p);
+					if(found[i] != found[0]) {
+						fuzz_fail("delete", &p, i);
+					}
+				}
+				break;
+			case 2:
+				for(i = 0; i < NIMPLS; i++) {
+					found[i] = impls[i].lookup(t[i], &p);
+					if(found[i] != found[0]) {
+						fuzz_fail("lookup", &p, i);
+					}
+				}
+				break;
+			case 3:
+				for(i = 0; i < NIMPLS; i++) {
+					found[i] = impls[i].match(t[i], &p, &res[i]);
+					if(found[i] != found[0] || (found[i] && !prefix_same(&res[i], &res[0]))) {
+						fuzz_fail("match", &p, i);
+					}
+				}
+				break;
+		}
+
+		if(op % 10000 == 0) {
+			walked = impls[0].walk(t[0]);
+			for(i = 1; i < NIMPLS; i++) {
+				if(impls[i].walk(t[i]) != walked) {
+					fuzz_fail("walk", &p, i);
+				}
+			}
+		}
+	}
+
+	for(i = 0; i < NIMPLS; i++) {
+		impls[i].destroy(t[i]);
+	}
+}
+
+/* Benchmark */
+
+static double now(void) {
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static unsigned long mem_bytes(void) {
+	unsigned long bytes = 0;
+	int type;
+
+	for(type = 0; type < MTYPE_MAX; type++) {
+		bytes += mtype_stats_bytes(type);
+	}
+	return bytes;
+}
+
+struct prefix_set {
+	struct prefix *p;
+	unsigned long n, size;
+};
+
+static void set_add(struct prefix_set *set, const struct prefix *p) {
+	if(set->n == set->size) {
+		set->size = set->size ? set->size * 2 : 65536;
+		set->p = XREALLOC(MTYPE_TMP, set->p, set->size * sizeof(struct prefix));
+	}
+	set->p[set->n++] = *p;
+}
+
+static void set_generate(struct prng *prng, struct prefix_set *set, u_char family, unsigned long n) {
+	struct prefix p;
+
+	while(set->n < n) {
+		random_addr(prng, family, &p);
+		p.prefixlen = random_len(prng, family == AF_INET ? dfz4 : dfz6);
+		apply_mask(&p);
+		set_add(set, &p);
+	}
+}
+
+static void set_load(struct prefix_set *set4, struct prefix_set *set6, const char *file) {
+	char line[128], *s;
+	struct prefix p;
+	FILE *f;
+
+	f = fopen(file, "r");
+	if(!f) {
+		perror(file);
+		exit(1);
+	}
+	while(fgets(line, sizeof(line), f)) {
+		for(s = line; *s && !isspace((unsigned char) *s); s++) {
+			;
+		}
+		*s = '\0';
+		if(str2prefix(line, &p) <= 0) {
+			continue;
+		}
+		apply_mask(&p);
+		if(p.family == AF_INET) {
+			set_add(set4, &p);
+		} else if(p.family == AF_INET6) {
+			set_add(set6, &p);
+		}
+	}
+	fclose(f);
+}
+
+static void bench(const struct prefix_set *set, const struct prefix_set *addrs, const char *family) {
+	unsigned long unique = 0, hits, i;
+	unsigned int k;
+
+	if(!set->n) {
+		return;
+	}
+
+	printf("%s: %lu prefixes\n", family, set->n);
+	printf("  %-12s %10s %10s %10s %10s %10s %10s\n", "ns/prefix", "insert", "lookup", "match", "walk", "delete", "bytes");
+
+	for(k = 0; k < NIMPLS; k++) {
+		const struct table_impl *impl = &impls[k];
+		double t_insert, t_lookup, t_match, t_walk, t_delete, t;
+		unsigned long before = mem_bytes(), bytes, n;
+		struct prefix res;
+		void *tab;
+
+		tab = impl->create();
+
+		t = now();
+		for(i = 0; i < set->n; i++) {
+			impl->insert(tab, &set->p[i]);
+		}
+		t_insert = now() - t;
+		bytes = mem_bytes() - before;
+
+		t = now();
+		for(i = 0; i < set->n; i++) {
+			impl->lookup(tab, &set->p[i]);
+		}
+		t_lookup = now() - t;
+
+		t = now();
+		for(hits = 0, i = 0; i < addrs->n; i++) {
+			hits += impl->match(tab, &addrs->p[i], &res);
+		}
+		t_match = now() - t;
+
+		t = now();
+		n = impl->walk(tab);
+		t_walk = now() - t;
+		if(!unique) {
+			unique = n;
+		}
+
+		t = now();
+		for(i = 0; i < set->n; i++) {
+			impl->remove(tab, &set->p[i]);
+		}
+		t_delete = now() - t;
+
+		impl->destroy(tab);
+
+		printf("  %-12s %10.1f %10.1f %10.1f %10.1f %10.1f %10.1f\n", impl->name, t_insert * 1e9 / set->n, t_lookup * 1e9 / set->n, t_match * 1e9 / addrs->n,
+		       t_walk * 1e9 / n, t_delete * 1e9 / set->n, (double) bytes / n);
+		if(n != unique) {
+			printf("  %s holds %lu prefixes, not %lu\n", impl->name, n, unique);
+		}
+	}
+	printf("  %lu unique, %lu of %lu addresses matched\n", unique, hits, addrs->n);
+}
+
+static void usage(const char *progname) {
+	fprintf(stderr, "Usage: %s [-b [-n ipv4 prefixes] [-6 ipv6 prefixes] [-f prefix file]]\n", progname);
+	exit(1);
+}
+
+int main(int argc, char **argv) {
+	struct prefix_set set4 = {}, set6 = {}, addr4 = {}, addr6 = {};
+	unsigned long n4 = 1000000, n6 = 200000, i;
+	const char *file = NULL;
+	struct prng *prng;
+	struct prefix p;
+	int opt, benchmark = 0;
+
+	while((opt = getopt(argc, argv, "bn:6:f:h")) != -1) {
+		switch(opt) {
+			case 'b': benchmark = 1; break;
+			case 'n': n4 = strtoul(optarg, NULL, 10); break;
+			case '6': n6 = strtoul(optarg, NULL, 10); break;
+			case 'f': file = optarg; break;
+			default: usage(argv[0]);
+		}
+	}
+
+	prng = prng_new(0);
+
+	if(!benchmark) {
+		fuzz(prng, AF_INET);
+		printf("IPv4 tables agree.\n");
+		fuzz(prng, AF_INET6);
+		printf("IPv6 tables agree.\n");
+		prng_free(prng);
+		return 0;
+	}
+
+	if(file) {
+		set_load(&set4, &set6, file);
+	} else {
+		set_generate(prng, &set4, AF_INET, n4);
+		set_generate(prng, &set6, AF_INET6, n6);
+	}
+	for(i = 0; i < set4.n; i++) {
+		random_addr_within(prng, &set4.p[random32(prng) % set4.n], &p);
+		set_add(&addr4, &p);
+	}
+	for(i = 0; i < set6.n; i++) {
+		random_addr_within(prng, &set6.p[random32(prng) % set6.n], &p);
+		set_add(&addr6, &p);
+	}
+
+	bench(&set4, &addr4, "IPv4");
+	bench(&set6, &addr6, "IPv6");
+
+	prng_free(prng);
+	return 0;
+}
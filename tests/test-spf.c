@@ -0,0 +1,226 @@
+/*
+ * Test program for the SPF helpers: the candidate heap against a plain
+ * scan for the minimum through random pushes, decreases and removals,
+ * the pool's reuse and counting, and the order kept by the arrays.
+ *
+ * This file is part of Quagga
+ *
+ * Quagga is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2, or (at your option) any
+ * later version.
+ *
+ * Quagga is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Quagga; see the file COPYING.  If not, write to the Free
+ * Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ * 02111-1307, USA.
+ */
+
+#include <zebra.h>
+
+#include <stdio.h>
+
+#include "memory.h"
+#include "spf.h"
+#include "prng.h"
+
+#define ITEMS 5000
+
+struct thread_master *master;
+
+struct item {
+	u_int64_t key;
+	int pos;
+	int queued;
+};
+
+static struct item items[ITEMS];
+
+/* The item the heap should hand out next: lowest key, any of equal ones. */
+static u_int64_t min_key(int *count) {
+	u_int64_t key = UINT64_MAX;
+	int i;
+
+	*count = 0;
+	for(i = 0; i < ITEMS; i++) {
+		if(items[i].queued) {
+			(*count)++;
+			if(items[i].key < key) {
+				key = items[i].key;
+			}
+		}
+	}
+	return key;
+}
+
+static void check_positions(struct spf_heap *heap) {
+	unsigned int i;
+
+	for(i = 0; i < spf_heap_count(heap); i++) {
+		struct item *item = spf_heap_item(heap, i);
+
+		assert(item->queued && item->pos == (int) i);
+	}
+}
+
+static void test_heap(struct prng *prng) {
+	struct spf_heap *heap = spf_heap_new();
+	struct item *item;
+	u_int64_t key;
+	int round, i, count;
+
+	memset(items, 0, sizeof(items));
+
+	for(round = 0; round < 4; round++) {
+		for(i = 0; i < ITEMS * 2; i++) {
+			int n = prng_rand(prng) % ITEMS;
+
+			item = &items[n];
+			if(!item->queued) {
+				item->key = prng_rand(prng) % 1000;
+				item->queued = 1;
+				spf_heap_push(heap, item, &item->pos, item->key);
+			} else if(prng_rand(prng) % 3) {
+				if(item->key > 0) {
+					item->key -= prng_rand(prng) % item->key + 1;
+				}
+				spf_heap_decrease(heap, item->pos, item->key);
+			} else {
+				spf_heap_remove(heap, item->pos);
+				item->queued = 0;
+			}
+
+			if(i % 997 == 0) {
+				check_positions(heap);
+			}
+		}
+		check_positions(heap);
+
+		/* take out half, each one the least of those left */
+		for(i = 0; i < ITEMS / 2; i++) {
+			key = min_key(&count);
+			assert((unsigned int) count == spf_heap_count(heap));
+			item = spf_heap_pop(heap);
+			if(count == 0) {
+				assert(item == NULL);
+				break;
+			}
+			assert(item->queued && item->key == key);
+			item->queued = 0;
+		}
+		check_positions(heap);
+	}
+
+	while((item = spf_heap_pop(heap))) {
+		item->queued = 0;
+	}
+	min_key(&count);
+	assert(count == 0);
+	spf_heap_free(heap);
+}
+
+static void test_pool(void) {
+	struct spf_pool *pool = spf_pool_new(sizeof(struct item), MTYPE_TMP);
+	struct item *got[ITEMS];
+	struct item *again;
+	int i;
+
+	for(i = 0; i < ITEMS; i++) {
+		got[i] = spf_pool_get(pool);
+		assert(got[i]->key == 0 && got[i]->pos == 0);
+		got[i]->key = i + 1;
+	}
+	assert(spf_pool_count(pool) == ITEMS);
+
+	/* what's put back is what comes out next, and zeroed again */
+	for(i = 0; i < ITEMS; i += 2) {
+		spf_pool_put(pool, got[i]);
+	}
+	assert(spf_pool_count(pool) == ITEMS / 2);
+	for(i = ITEMS - 2; i >= 0; i -= 2) {
+		again = spf_pool_get(pool);
+		assert(again == got[i] && again->key == 0);
+	}
+	for(i = 1; i < ITEMS; i += 2) {
+		assert(got[i]->key == (u_int64_t) i + 1);
+	}
+	assert(spf_pool_count(pool) == ITEMS);
+
+	spf_pool_free(pool);
+}
+
+static int item_cmp(void *a, void *b) {
+	u_int64_t ka = ((struct item *) a)->key, kb = ((struct item *) b)->key;
+
+	return ka < kb ? -1 : ka > kb;
+}
+
+static void test_array(struct prng *prng) {
+	struct spf_array array;
+	struct item *item, *prev;
+	unsigned int i;
+
+	memset(&array, 0, sizeof(array));
+	memset(items, 0, sizeof(items));
+
+	/* sorted, and among equal keys in the order added */
+	for(i = 0; i < ITEMS; i++) {
+		items[i].key = prng_rand(prng) % 50;
+		spf_array_add_sort(&array, &items[i], item_cmp);
+	}
+	assert(spf_array_count(&array) == ITEMS);
+	prev = NULL;
+	for(SPF_ARRAY_ELEMENTS(&array, i, item)) {
+		if(prev) {
+			assert(prev->key < item->key || (prev->key == item->key && prev < item));
+		}
+		prev = item;
+	}
+
+	/* deleting keeps the order of the rest */
+	for(i = 0; i < ITEMS; i += 3) {
+		spf_array_delete(&array, &items[i]);
+		assert(spf_array_lookup(&array, &items[i]) < 0);
+	}
+	spf_array_delete(&array, &items[0]);
+	assert(spf_array_count(&array) == ITEMS - (ITEMS + 2) / 3);
+	prev = NULL;
+	for(SPF_ARRAY_ELEMENTS(&array, i, item)) {
+		assert((item - items) % 3 != 0);
+		assert(spf_array_lookup(&array, item) == (int) i);
+		if(prev) {
+			assert(prev->key < item->key || (prev->key == item->key && prev < item));
+		}
+		prev = item;
+	}
+
+	spf_array_clear(&array);
+	assert(spf_array_count(&array) == 0);
+	spf_array_add(&array, &items[1]);
+	assert(spf_array_lookup(&array, &items[1]) == 0);
+	spf_array_free(&array);
+	assert(spf_array_count(&array) == 0 && array.item == NULL);
+}
+
+int main(int argc, char **argv) {
+	struct prng *prng;
+
+	prng = prng_new(0);
+
+	test_heap(prng);
+	printf("SPF heap OK.\n");
+
+	test_pool();
+	printf("SPF pool OK.\n");
+
+	test_array(prng);
+	printf("SPF array OK.\n");
+
+	prng_free(prng);
+	return 0;
+}
@@ -43,6 +43,39 @@ static void print_stream(struct stream *s) {
 	stream_set_getp(s, getp);
 }
 
+/* one body shared by two fifos, each behind its own header */
+static void test_share_flush(void) {
+	struct stream_fifo *fifo[2];
+	struct stream *body, *hdr;
+	unsigned char buf[64];
+	int fds[2], i;
+
+	body = stream_new(16);
+	stream_put(body, "body", 4);
+
+	assert(pipe(fds) == 0);
+	for(i = 0; i < 2; i++) {
+		fifo[i] = stream_fifo_new();
+		hdr = stream_new(4);
+		stream_putc(hdr, '0' + i);
+		stream_fifo_push(fifo[i], hdr);
+		stream_fifo_push(fifo[i], stream_share(body));
+	}
+	stream_free(body); /* the shares keep the data */
+
+	for(i = 0; i < 2; i++) {
+		assert(stream_fifo_flush(fifo[i], fds[1], 16) == 5);
+		assert(read(fds[0], buf, sizeof(buf)) == 5);
+		assert(buf[0] == '0' + i && !memcmp(buf + 1, "body", 4));
+		assert(!STREAM_READABLE(stream_fifo_head(fifo[i])));
+		stream_fifo_free(fifo[i]);
+	}
+	close(fds[0]);
+	close(fds[1]);
+
+	printf("shared stream flushed\n");
+}
+
 int main(void) {
 	struct stream *s;
 
@@ -64,5 +97,7 @@ int main(void) {
 	printf("l: 0x%x\n", stream_getl(s));
 	printf("q: 0x%" PRIu64 "\n", stream_getq(s));
 
+	test_share_flush();
+
 	return 0;
 }
@@ -0,0 +1,146 @@
+/*
+ * Test program to verify that read and write threads fire only for
+ * ready file descriptors, including ones beyond FD_SETSIZE when the
+ * poller supports them.
+ *
+ * This file is part of Quagga
+ *
+ * Quagga is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2, or (at your option) any
+ * later version.
+ *
+ * Quagga is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Quagga; see the file COPYING.  If not, write to the Free
+ * Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ * 02111-1307, USA.
+ */
+
+#include <zebra.h>
+#include <sys/resource.h>
+
+#include <stdio.h>
+#include <unistd.h>
+
+#include "memory.h"
+#include "thread.h"
+
+#ifdef THREAD_POLL_SELECT
+	#define PIPES 64
+#else
+	#define PIPES 700 /* 1400 fds, beyond FD_SETSIZE */
+#endif
+
+struct thread_master *master;
+
+static int pipes[PIPES][2];
+static struct thread *readers[PIPES];
+static int fired[PIPES];
+static int reads_pending;
+static int writes_pending;
+
+static void terminate_test(void) {
+	int i, exit_code = 0;
+
+	for(i = 0; i < PIPES; i++) {
+		int expect = (i % 3 == 0) ? 1 : 0;
+
+		if(fired[i] != expect) {
+			fprintf(stderr, "pipe %d: fired %d times, expected %d\n", i, fired[i], expect);
+			exit_code = 1;
+		}
+	}
+
+	if(!exit_code) {
+		printf("Ready descriptors fired as expected.\n");
+	}
+
+	for(i = 0; i < PIPES; i++) {
+		if(readers[i]) {
+			thread_cancel(readers[i]);
+		}
+		close(pipes[i][0]);
+		close(pipes[i][1]);
+	}
+	thread_master_free(master);
+	exit(exit_code);
+}
+
+static int read_func(struct thread *thread) {
+	int i = (intptr_t) THREAD_ARG(thread);
+	char c;
+
+	readers[i] = NULL;
+	assert(read(THREAD_FD(thread), &c, 1) == 1);
+	fired[i]++;
+
+	if(--reads_pending == 0 && writes_pending == 0) {
+		terminate_test();
+	}
+	return 0;
+}
+
+static int write_func(struct thread *thread) {
+	assert(write(THREAD_FD(thread), "x", 1) == 1);
+
+	if(--writes_pending == 0 && reads_pending == 0) {
+		terminate_test();
+	}
+	return 0;
+}
+
+static int timeout_func(struct thread *thread) {
+	fprintf(stderr, "Timed out with %d reads and %d writes pending\n", reads_pending, writes_pending);
+	exit(1);
+}
+
+int main(int argc, char **argv) {
+	struct rlimit limit;
+	int i;
+
+	getrlimit(RLIMIT_NOFILE, &limit);
+	if(limit.rlim_cur < 2 * PIPES + 64) {
+		limit.rlim_cur = MIN(limit.rlim_max, 2 * PIPES + 64);
+		setrlimit(RLIMIT_NOFILE, &limit);
+	}
+	getrlimit(RLIMIT_NOFILE, &limit);
+	if(limit.rlim_cur < 2 * PIPES + 64) {
+		printf("Not enough file descriptors, skipping.\n");
+		return 77;
+	}
+
+	master = thread_master_create();
+
+	for(i = 0; i < PIPES; i++) {
+		assert(pipe(pipes[i]) == 0);
+		readers[i] = thread_add_read(master, read_func, (void *) (intptr_t) i, pipes[i][0]);
+		assert(readers[i]);
+	}
+
+	/* A second reader on the same fd must be refused. */
+	assert(thread_add_read(master, read_func, NULL, pipes[0][0]) == NULL);
+
+	/* Every third pipe gets written to; every third-plus-one reader
+	 * is cancelled, the rest stay idle. */
+	for(i = 0; i < PIPES; i++) {
+		if(i % 3 == 0) {
+			thread_add_write(master, write_func, (void *) (intptr_t) i, pipes[i][1]);
+			writes_pending++;
+			reads_pending++;
+		} else if(i % 3 == 1) {
+			thread_cancel(readers[i]);
+			readers[i] = NULL;
+		}
+	}
+
+	thread_add_timer(master, timeout_func, NULL, 10);
+
+	thread_main(master);
+
+	return 1;
+}
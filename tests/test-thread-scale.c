@@ -0,0 +1,302 @@
+/*
+ * Scheduler scalability benchmark.
+ *
+ * fds:    one read thread on each of N socketpairs.  Every round writes
+ *         to a random K of them and waits for all K reads to run, so
+ *         each wakeup has to be found among N mostly idle fds.
+ * timers: M timers at random intervals; as each one fires, it is armed
+ *         again at a random interval, and one time in four another
+ *         random timer is cancelled and re-armed, as hold and keepalive
+ *         timers are.
+ *
+ * Reported are the latency from a write, or a timer's due time, to its
+ * callback running, as percentiles, and the CPU spent per event.  -w runs
+ * the timers on the thread master's timer wheel instead of the heap.
+ *
+ * This file is part of Quagga
+ *
+ * Quagga is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2, or (at your option) any
+ * later version.
+ *
+ * Quagga is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Quagga; see the file COPYING.  If not, write to the Free
+ * Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ * 02111-1307, USA.
+ */
+
+#include <zebra.h>
+
+#include <stdio.h>
+#include <sys/resource.h>
+
+#include "thread.h"
+#include "prng.h"
+
+struct thread_master *master;
+
+static struct prng *prng;
+
+static unsigned long nfds = 10000, active = 100, rounds = 1000;
+static unsigned long ntimers = 1000000, timer_msec = 60000, run_secs = 20;
+static int use_wheel;
+
+/* latencies, in usec */
+static unsigned long *samples;
+static unsigned long nsamples, maxsamples;
+
+static RUSAGE_T cpu_start;
+
+static unsigned long now_usec(void) {
+	struct timeval tv;
+
+	quagga_gettime(QUAGGA_CLK_MONOTONIC, &tv);
+	return tv.tv_sec * 1000000UL + tv.tv_usec;
+}
+
+static void sample(unsigned long usec) {
+	if(nsamples < maxsamples) {
+		samples[nsamples++] = usec;
+	}
+}
+
+static int cmp_ulong(const void *a, const void *b) {
+	unsigned long x = *(const unsigned long *) a, y = *(const unsigned long *) b;
+
+	return x < y ? -1 : x > y;
+}
+
+static void report(const char *what, unsigned long events) {
+	RUSAGE_T cpu_end;
+	unsigned long cpu;
+
+	thread_getrusage(&cpu_end);
+	thread_consumed_time(&cpu_end, &cpu_start, &cpu);
+
+	qsort(samples, nsamples, sizeof(*samples), cmp_ulong);
+	printf("%s: %lu events, %.2f usec CPU per event\n", what, events, (double) cpu / events);
+	if(nsamples) {
+		printf("  latency usec  p50 %lu  p90 %lu  p99 %lu  p99.9 %lu  max %lu\n", samples[nsamples / 2], samples[nsamples * 9 / 10], samples[nsamples * 99 / 100],
+		       samples[nsamples * 999 / 1000], samples[nsamples - 1]);
+	}
+}
+
+static void bench_begin(void) {
+	thread_getrusage(&cpu_start);
+}
+
+/* Many fds */
+
+struct fd_pair {
+	int fd[2];
+	struct thread *reader;
+	unsigned long written; /* usec, 0 while idle */
+};
+
+static struct fd_pair *pairs;
+static unsigned long round_no, round_pending, fd_events;
+
+static int fd_round(struct thread *t);
+
+static int fd_read(struct thread *t) {
+	struct fd_pair *pair = THREAD_ARG(t);
+	char c;
+
+	pair->reader = thread_add_read(master, fd_read, pair, pair->fd[0]);
+	if(read(pair->fd[0], &c, 1) != 1 || !pair->written) {
+		return 0;
+	}
+
+	sample(now_usec() - pair->written);
+	pair->written = 0;
+	fd_events++;
+
+	if(--round_pending == 0) {
+		thread_add_event(master, fd_round, NULL, 0);
+	}
+	return 0;
+}
+
+static int fd_round(struct thread *t) {
+	unsigned long i;
+
+	if(round_no++ == rounds) {
+		report("fds", fd_events);
+		exit(0);
+	}
+
+	for(i = 0; i < active; i++) {
+		struct fd_pair *pair = &pairs[prng_rand(prng) % nfds];
+
+		if(pair->written) {
+			continue;
+		}
+		pair->written = now_usec();
+		if(write(pair->fd[1], "x", 1) != 1) {
+			perror("write");
+			exit(1);
+		}
+		round_pending++;
+	}
+	if(!round_pending) {
+		thread_add_event(master, fd_round, NULL, 0);
+	}
+	return 0;
+}
+
+static void bench_fds(void) {
+	struct rlimit rl;
+	unsigned long i;
+
+	getrlimit(RLIMIT_NOFILE, &rl);
+	if(rl.rlim_max != RLIM_INFINITY && rl.rlim_max < nfds * 2 + 64) {
+		nfds = (rl.rlim_max - 64) / 2;
+		printf("fd limit %lu, down to %lu socketpairs\n", (unsigned long) rl.rlim_max, nfds);
+	}
+	rl.rlim_cur = nfds * 2 + 64;
+	if(setrlimit(RLIMIT_NOFILE, &rl) < 0) {
+		perror("setrlimit");
+		exit(1);
+	}
+
+	/* the thread master sizes its fd arrays by the limit */
+	master = thread_master_create();
+
+	pairs = calloc(nfds, sizeof(*pairs));
+	for(i = 0; i < nfds; i++) {
+		if(socketpair(AF_UNIX, SOCK_STREAM, 0, pairs[i].fd) < 0) {
+			perror("socketpair");
+			exit(1);
+		}
+		pairs[i].reader = thread_add_read(master, fd_read, &pairs[i], pairs[i].fd[0]);
+	}
+
+	maxsamples = active * rounds;
+	samples = calloc(maxsamples, sizeof(*samples));
+
+	printf("%lu socketpairs, %lu written per round, %lu rounds\n", nfds, active, rounds);
+	bench_begin();
+	thread_add_event(master, fd_round, NULL, 0);
+	thread_main(master);
+}
+
+/* Many timers */
+
+struct bench_timer {
+	struct thread *t;
+	unsigned long due; /* usec */
+};
+
+static struct bench_timer *timers;
+static unsigned long timer_events, timer_cancels;
+
+static int timer_fire(struct thread *t);
+
+static void timer_arm(struct bench_timer *bt, long after_msec) {
+	long msec = after_msec + prng_rand(prng) % timer_msec;
+
+	bt->due = now_usec() + msec * 1000;
+	bt->t = thread_add_timer_msec(master, timer_fire, bt, msec);
+}
+
+static int timer_fire(struct thread *t) {
+	struct bench_timer *bt = THREAD_ARG(t), *other;
+	unsigned long now = now_usec();
+
+	bt->t = NULL;
+	sample(now > bt->due ? now - bt->due : 0);
+	timer_events++;
+	timer_arm(bt, 0);
+
+	/* one in four also moves another timer */
+	other = &timers[prng_rand(prng) % ntimers];
+	if(other->t && prng_rand(prng) % 4 == 0) {
+		thread_cancel(other->t);
+		timer_cancels++;
+		timer_arm(other, 0);
+	}
+	return 0;
+}
+
+static int timer_stop(struct thread *t) {
+	report("timers", timer_events);
+	printf("  %lu re-armed after cancel\n", timer_cancels);
+	exit(0);
+}
+
+static void bench_timers(void) {
+	unsigned long i;
+
+	master = thread_master_create();
+	if(use_wheel) {
+		thread_master_timer_wheel_enable(master);
+	}
+
+	timers = calloc(ntimers, sizeof(*timers));
+	maxsamples = 10000000;
+	samples = calloc(maxsamples, sizeof(*samples));
+
+	printf("%lu timers within %lu ms, %s, for %lu s\n", ntimers, timer_msec, use_wheel ? "wheel" : "heap", run_secs);
+	/* none due before they are all armed */
+	for(i = 0; i < ntimers; i++) {
+		timer_arm(&timers[i], 2000);
+	}
+
+	bench_begin();
+	thread_add_timer(master, timer_stop, NULL, run_secs);
+	thread_main(master);
+}
+
+static void usage(const char *progname) {
+	fprintf(stderr,
+	        "Usage: %s fds [-n fds] [-a active per round] [-r rounds]\n"
+	        "       %s timers [-n timers] [-i max interval ms] [-s seconds] [-w]\n",
+	        progname, progname);
+	exit(1);
+}
+
+int main(int argc, char **argv) {
+	const char *mode;
+	int opt;
+
+	if(argc < 2) {
+		usage(argv[0]);
+	}
+	mode = argv[1];
+	optind = 2;
+
+	while((opt = getopt(argc, argv, "n:a:r:i:s:wh")) != -1) {
+		switch(opt) {
+			case 'n':
+				nfds = strtoul(optarg, NULL, 10);
+				ntimers = nfds;
+				break;
+			case 'a': active = strtoul(optarg, NULL, 10); break;
+			case 'r': rounds = strtoul(optarg, NULL, 10); break;
+			case 'i': timer_msec = strtoul(optarg, NULL, 10); break;
+			case 's': run_secs = strtoul(optarg, NULL, 10); break;
+			case 'w': use_wheel = 1; break;
+			default: usage(argv[0]);
+		}
+	}
+	if(!nfds || !active || !timer_msec) {
+		usage(argv[0]);
+	}
+
+	prng = prng_new(0);
+
+	if(!strcmp(mode, "fds")) {
+		bench_fds();
+	} else if(!strcmp(mode, "timers")) {
+		bench_timers();
+	} else {
+		usage(argv[0]);
+	}
+	return 0;
+}
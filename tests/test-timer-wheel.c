@@ -0,0 +1,105 @@
+/*
+ * Test program to verify that second-granularity timers kept on the
+ * thread_master timer wheel fire, never early and at most one tick late,
+ * and that cancelled ones don't.
+ *
+ * This file is part of Quagga
+ *
+ * Quagga is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2, or (at your option) any
+ * later version.
+ *
+ * Quagga is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Quagga; see the file COPYING.  If not, write to the Free
+ * Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ * 02111-1307, USA.
+ */
+
+#include <zebra.h>
+
+#include <stdio.h>
+#include <unistd.h>
+
+#include "memory.h"
+#include "prng.h"
+#include "thread.h"
+
+#define SCHEDULE_TIMERS 400
+#define REMOVE_TIMERS 100
+
+struct thread_master *master;
+
+static struct prng *prng;
+static struct thread *timers[SCHEDULE_TIMERS];
+static struct timeval expiry[SCHEDULE_TIMERS];
+static int timers_pending;
+static int errors;
+
+static int timer_func(struct thread *thread) {
+	int i = (intptr_t) THREAD_ARG(thread);
+	struct timeval now;
+	long late;
+
+	quagga_gettime(QUAGGA_CLK_MONOTONIC, &now);
+	late = timeval_elapsed(now, expiry[i]);
+	if(late < 0 || late > 1100 * 1000) {
+		fprintf(stderr, "timer %d fired %ld usec after its expiry\n", i, late);
+		errors++;
+	}
+	timers[i] = NULL;
+
+	if(--timers_pending == 0) {
+		printf("%d timer(s) misfired.\n", errors);
+		thread_master_free(master);
+		prng_free(prng);
+		exit(errors ? 1 : 0);
+	}
+	return 0;
+}
+
+static int canary_func(struct thread *thread) {
+	fprintf(stderr, "cancelled msec timer fired\n");
+	exit(1);
+}
+
+int main(int argc, char **argv) {
+	struct thread *canary;
+	int i;
+
+	master = thread_master_create();
+	thread_master_timer_wheel_enable(master);
+	prng = prng_new(0);
+
+	for(i = 0; i < SCHEDULE_TIMERS; i++) {
+		timers[i] = thread_add_timer(master, timer_func, (void *) (intptr_t) i, prng_rand(prng) % 4);
+		assert(timers[i]->index < -1);
+		expiry[i] = timers[i]->u.sands;
+		timers_pending++;
+	}
+
+	for(i = 0; i < REMOVE_TIMERS; i++) {
+		int index = prng_rand(prng) % SCHEDULE_TIMERS;
+
+		if(!timers[index]) {
+			continue;
+		}
+		thread_cancel(timers[index]);
+		timers[index] = NULL;
+		timers_pending--;
+	}
+
+	/* msec timers still live on the heap and can be cancelled there */
+	canary = thread_add_timer_msec(master, canary_func, NULL, 100);
+	assert(canary->index >= 0);
+	thread_cancel(canary);
+
+	thread_main(master);
+
+	return 1;
+}
@@ -0,0 +1,152 @@
+/*
+ * Test program for work pools: every job submitted must have its 'done'
+ * callback run on the thread_master, with the result computed on a
+ * worker, and every job of work_pool_run() must have run by the time it
+ * returns.
+ *
+ * This file is part of Quagga
+ *
+ * Quagga is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2, or (at your option) any
+ * later version.
+ *
+ * Quagga is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Quagga; see the file COPYING.  If not, write to the Free
+ * Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ * 02111-1307, USA.
+ */
+
+#include <zebra.h>
+
+#include <stdio.h>
+#include <unistd.h>
+
+#include "memory.h"
+#include "thread.h"
+#include "workpool.h"
+
+#define JOBS 2000
+
+struct thread_master *master;
+
+struct job {
+	unsigned int n;
+	unsigned long sum;
+	int done;
+};
+
+static struct job jobs[2][JOBS];
+static struct job batch[2][JOBS];
+static struct job waited[2][JOBS];
+static struct work_pool *pools[2];
+static int outstanding;
+
+static void job_run(void *arg) {
+	struct job *job = arg;
+	unsigned int i;
+
+	for(i = 1; i <= job->n; i++) {
+		job->sum += i;
+	}
+}
+
+static int terminate_test(struct thread *thread) {
+	int p, i, errors = 0;
+
+	for(p = 0; p < 2; p++) {
+		assert(work_pool_pending(pools[p]) == 0);
+		for(i = 0; i < JOBS; i++) {
+			if(jobs[p][i].done != 1) {
+				errors++;
+			}
+		}
+		work_pool_free(pools[p]);
+	}
+	printf("%d job(s) not completed exactly once.\n", errors);
+	thread_master_free(master);
+	exit(errors ? 1 : 0);
+}
+
+static void job_done(void *arg) {
+	struct job *job = arg;
+
+	if(job->sum != (unsigned long) job->n * (job->n + 1) / 2) {
+		fprintf(stderr, "job %u computed %lu\n", job->n, job->sum);
+		exit(1);
+	}
+	job->done++;
+
+	/* pools can't be freed from their own callbacks */
+	if(--outstanding == 0) {
+		thread_add_event(master, terminate_test, NULL, 0);
+	}
+}
+
+static void wait_done(void *arg) {
+	struct job *job = arg;
+
+	job->done++;
+}
+
+static int timeout_func(struct thread *thread) {
+	fprintf(stderr, "Timed out with %d jobs outstanding\n", outstanding);
+	exit(1);
+}
+
+int main(int argc, char **argv) {
+	int p, i;
+
+	master = thread_master_create();
+	pools[0] = work_pool_new(master, "test threaded", 4);
+	pools[1] = work_pool_new(master, "test inline", 0);
+
+	for(p = 0; p < 2; p++) {
+		void *args[JOBS];
+
+		for(i = 0; i < JOBS; i++) {
+			batch[p][i].n = i * 10;
+			args[i] = &batch[p][i];
+		}
+		work_pool_run(pools[p], job_run, args, JOBS);
+		for(i = 0; i < JOBS; i++) {
+			if(batch[p][i].sum != (unsigned long) batch[p][i].n * (batch[p][i].n + 1) / 2) {
+				fprintf(stderr, "batch job %u computed %lu\n", batch[p][i].n, batch[p][i].sum);
+				exit(1);
+			}
+		}
+	}
+
+	for(p = 0; p < 2; p++) {
+		for(i = 0; i < JOBS; i++) {
+			waited[p][i].n = i * 10;
+			work_pool_submit(pools[p], job_run, wait_done, &waited[p][i]);
+		}
+		work_pool_wait(pools[p]);
+		assert(work_pool_pending(pools[p]) == 0);
+		for(i = 0; i < JOBS; i++) {
+			if(waited[p][i].done != 1 || waited[p][i].sum != (unsigned long) waited[p][i].n * (waited[p][i].n + 1) / 2) {
+				fprintf(stderr, "waited job %u: done %d, computed %lu\n", waited[p][i].n, waited[p][i].done, waited[p][i].sum);
+				exit(1);
+			}
+		}
+	}
+
+	for(p = 0; p < 2; p++) {
+		for(i = 0; i < JOBS; i++) {
+			jobs[p][i].n = i * 10;
+			work_pool_submit(pools[p], job_run, job_done, &jobs[p][i]);
+			outstanding++;
+		}
+	}
+
+	thread_add_timer(master, timeout_func, NULL, 20);
+	thread_main(master);
+
+	return 1;
+}
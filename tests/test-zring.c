@@ -0,0 +1,148 @@
+/*
+ * Test program for zrings: every message a producer process queues must
+ * reach the consumer process intact and in order, with each side sleeping
+ * on its eventfd whenever the ring is full or empty, and a corrupt length
+ * must be reported rather than followed.
+ *
+ * This file is part of Quagga
+ *
+ * Quagga is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2, or (at your option) any
+ * later version.
+ *
+ * Quagga is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Quagga; see the file COPYING.  If not, write to the Free
+ * Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ * 02111-1307, USA.
+ */
+
+#include <zebra.h>
+
+#include <stdio.h>
+#include <unistd.h>
+#include <poll.h>
+#include <sys/wait.h>
+#include <sys/mman.h>
+
+#include "memory.h"
+#include "zring.h"
+
+#define MESSAGES 200000
+
+struct thread_master *master;
+
+static size_t message_len(unsigned int seq) {
+	return 6 + (seq * 7919) % 4000;
+}
+
+static void message_make(u_char *buf, unsigned int seq) {
+	size_t len = message_len(seq), i;
+
+	buf[0] = len >> 8;
+	buf[1] = len & 0xff;
+	memcpy(buf + 2, &seq, sizeof(seq));
+	for(i = 6; i < len; i++) {
+		buf[i] = (seq + i) & 0xff;
+	}
+}
+
+static void wait_fd(int fd) {
+	struct pollfd pfd = { .fd = fd, .events = POLLIN };
+
+	if(poll(&pfd, 1, 5000) != 1) {
+		fprintf(stderr, "timed out waiting on fd %d\n", fd);
+		exit(1);
+	}
+}
+
+static void producer(struct zring *ring) {
+	u_char buf[4096];
+	unsigned int seq;
+
+	for(seq = 0; seq < MESSAGES; seq++) {
+		message_make(buf, seq);
+		while(zring_put(ring, buf, message_len(seq)) < 0) {
+			if(zring_sleep_space(ring, message_len(seq))) {
+				wait_fd(ring->space_fd);
+			}
+		}
+	}
+	exit(0);
+}
+
+int main(int argc, char **argv) {
+	struct zring *ring, *peer;
+	u_char buf[4096];
+	const u_char *data;
+	size_t len;
+	unsigned int seq, sleeps = 0;
+	pid_t pid;
+	int status, ret, fd;
+
+	if((ring = zring_new(ZRING_SIZE_MIN)) == NULL) {
+		printf("zrings aren't supported here\n");
+		return 0;
+	}
+	assert(zring_new(ZRING_SIZE_MIN + 1) == NULL);
+
+	if((pid = fork()) == 0) {
+		producer(ring);
+	}
+	assert(pid > 0);
+
+	peer = zring_attach(ZRING_SIZE_MIN, dup(ring->mem_fd), dup(ring->data_fd), dup(ring->space_fd));
+	assert(peer != NULL);
+
+	for(seq = 0; seq < MESSAGES;) {
+		if((ret = zring_get(peer, &data, &len)) == 0) {
+			if(zring_sleep_data(peer)) {
+				wait_fd(peer->data_fd);
+				sleeps++;
+			}
+			continue;
+		}
+		assert(ret == 1);
+		message_make(buf, seq);
+		if(len != message_len(seq) || memcmp(data, buf, len)) {
+			fprintf(stderr, "message %u came out wrong\n", seq);
+			return 1;
+		}
+		zring_consume(peer);
+		seq++;
+	}
+	assert(zring_get(peer, &data, &len) == 0);
+	assert(waitpid(pid, &status, 0) == pid && WIFEXITED(status) && WEXITSTATUS(status) == 0);
+
+	zring_free(peer);
+	zring_free(ring);
+
+	/* a length running past what was queued, on a fresh ring as the
+	 * producer's position is only known to the child */
+	ring = zring_new(ZRING_SIZE_MIN);
+	peer = zring_attach(ZRING_SIZE_MIN, dup(ring->mem_fd), dup(ring->data_fd), dup(ring->space_fd));
+	assert(peer != NULL);
+	message_make(buf, 1);
+	assert(zring_put(ring, buf, message_len(1)) == 0);
+	buf[0] = 0x7f;
+	assert(zring_put(ring, buf, 6) == 0);
+	assert(zring_get(peer, &data, &len) == 1);
+	zring_consume(peer);
+	assert(zring_get(peer, &data, &len) == -1);
+
+	/* memory that could be shrunk under the mapping isn't taken */
+	if((fd = memfd_create("zring", MFD_CLOEXEC)) >= 0) {
+		assert(ftruncate(fd, peer->map_size) == 0);
+		assert(zring_attach(ZRING_SIZE_MIN, fd, dup(ring->data_fd), dup(ring->space_fd)) == NULL);
+	}
+
+	printf("%u messages, the consumer slept %u times.\n", MESSAGES, sleeps);
+	zring_free(peer);
+	zring_free(ring);
+	return 0;
+}
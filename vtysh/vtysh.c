@@ -50,6 +50,12 @@ struct vtysh_client {
 	const char *name;
 	int flag;
 	const char *path;
+	/* # of commands sent whose reply hasn't been read */
+	int pending;
+	/* reply bytes read but not yet passed on */
+	char *ibuf;
+	size_t ilen;
+	size_t isize;
 } vtysh_client[] = {
 	{.fd = -1,  .name = "zebra",  .flag = VTYSH_ZEBRA,  .path = ZEBRA_VTYSH_PATH},
 	{ .fd = -1, .name = "ripd",   .flag = VTYSH_RIPD,	.path = RIP_VTYSH_PATH  },
@@ -76,6 +82,8 @@ static void vclient_close(struct vtysh_client *vclient) {
 		close(vclient->fd);
 		vclient->fd = -1;
 	}
+	vclient->pending = 0;
+	vclient->ilen = 0;
 }
 
 /* Return true if str begins with prefix, else return false */
@@ -91,141 +99,192 @@ static int begins_with(const char *str, const char *prefix) {
 	return strncmp(str, prefix, lenprefix) == 0;
 }
 
-/* Following filled with debug code to trace a problematic condition
- * under load - it SHOULD handle it. */
-#define ERR_WHERE_STRING "vtysh(): vtysh_client_execute(): "
+#define ERR_WHERE_STRING "vtysh(): vtysh_client_recv(): "
 
-static int vtysh_client_execute(struct vtysh_client *vclient, const char *line, FILE *fp) {
-	int ret;
-	char *buf;
-	size_t bufsz;
-	char *pbuf;
-	size_t left;
-	char *eoln;
-	int nbytes;
-	int i;
-	int readln;
-	int numnulls = 0;
+/* Config lines sent to a daemon ahead of their replies while a file is
+ * applied; small enough that neither side blocks on a full socket. */
+#define VTYSH_PIPELINE_DEPTH 64
+
+/* Queue a command to the daemon, without waiting for its reply. */
+static int vtysh_client_send(struct vtysh_client *vclient, const char *line) {
+	size_t len = strlen(line) + 1;
+	ssize_t ret;
 
 	if(vclient->fd < 0) {
-		return CMD_SUCCESS;
+		return -1;
 	}
 
-	ret = write(vclient->fd, line, strlen(line) + 1);
-	if(ret <= 0) {
-		vclient_close(vclient);
-		return CMD_SUCCESS;
+	while(len > 0) {
+		ret = write(vclient->fd, line, len);
+		if(ret <= 0) {
+			if(ret < 0 && errno == EINTR) {
+				continue;
+			}
+			vclient_close(vclient);
+			return -1;
+		}
+		line += ret;
+		len -= ret;
+	}
+
+	vclient->pending++;
+	return 0;
+}
+
+/* Pass reply text on, to fp or else to the config parser, which wants
+ * whole lines. */
+static void vtysh_client_emit(struct vtysh_client *vclient, size_t len, FILE *fp) {
+	char c;
+
+	if(len == 0) {
+		return;
+	}
+
+	if(fp) {
+		fwrite(vclient->ibuf, 1, len, fp);
+		fflush(fp);
+	} else {
+		/* there is always room for the terminator */
+		c = vclient->ibuf[len];
+		vclient->ibuf[len] = '\0';
+		vtysh_config_parse(vclient->ibuf);
+		vclient->ibuf[len] = c;
 	}
 
-	/* Allow enough room for buffer to read more than a few pages from socket. */
-	bufsz = 5 * getpagesize() + 1;
-	buf = XMALLOC(MTYPE_TMP, bufsz);
-	memset(buf, 0, bufsz);
-	pbuf = buf;
+	vclient->ilen -= len;
+	memmove(vclient->ibuf, vclient->ibuf + len, vclient->ilen);
+}
+
+/* Read the reply to the oldest command sent to the daemon, passing its
+ * lines on as they arrive.  A reply ends in three NULs and the command's
+ * status; bytes after it belong to the next reply and are kept. */
+static int vtysh_client_recv(struct vtysh_client *vclient, FILE *fp) {
+	char *nul;
+	char *eoln;
+	ssize_t nbytes;
+	int ret;
+
+	if(vclient->fd < 0 || vclient->pending == 0) {
+		return CMD_SUCCESS;
+	}
 
 	while(1) {
-		if(pbuf >= ((buf + bufsz) - 1)) {
-			fprintf(stderr, ERR_WHERE_STRING "warning - pbuf beyond buffer end.\n");
-			XFREE(MTYPE_TMP, buf);
-			return CMD_WARNING;
+		nul = memchr(vclient->ibuf, '\0', vclient->ilen);
+		if(nul && (size_t) (nul - vclient->ibuf) + 4 <= vclient->ilen) {
+			ret = nul[3];
+			vtysh_client_emit(vclient, nul - vclient->ibuf, fp);
+			vclient->ilen -= 4;
+			memmove(vclient->ibuf, vclient->ibuf + 4, vclient->ilen);
+			vclient->pending--;
+			return ret;
+		}
+
+		/* Pass on the complete lines so far. */
+		eoln = nul ? nul : vclient->ibuf + vclient->ilen;
+		while(eoln > vclient->ibuf && eoln[-1] != '\n') {
+			eoln--;
 		}
+		vtysh_client_emit(vclient, eoln - vclient->ibuf, fp);
 
-		readln = (buf + bufsz) - pbuf - 1;
-		nbytes = read(vclient->fd, pbuf, readln);
+		/* Leave room for a terminator; a long line grows the buffer. */
+		if(vclient->ilen + 1 >= vclient->isize) {
+			if(vclient->isize) {
+				vclient->isize *= 2;
+			} else {
+				vclient->isize = 5 * getpagesize() + 1;
+			}
+			vclient->ibuf = XREALLOC(MTYPE_TMP, vclient->ibuf, vclient->isize);
+		}
 
+		nbytes = read(vclient->fd, vclient->ibuf + vclient->ilen, vclient->isize - vclient->ilen - 1);
 		if(nbytes <= 0) {
-			if(errno == EINTR) {
+			if(nbytes < 0 && (errno == EINTR || errno == EAGAIN)) {
 				continue;
 			}
 
 			fprintf(stderr, ERR_WHERE_STRING "(%u)", errno);
 			perror("");
 
-			if(errno == EAGAIN || errno == EIO) {
-				continue;
-			}
-
 			vclient_close(vclient);
-			XFREE(MTYPE_TMP, buf);
 			return CMD_SUCCESS;
 		}
-		/* If we have already seen 3 nulls, then current byte is ret code */
-		if((numnulls == 3) && (nbytes == 1)) {
-			ret = pbuf[0];
-			break;
-		}
+		vclient->ilen += nbytes;
+	}
+}
 
-		pbuf[nbytes] = '\0';
+static int vtysh_client_execute(struct vtysh_client *vclient, const char *line, FILE *fp) {
+	if(vtysh_client_send(vclient, line) < 0) {
+		return CMD_SUCCESS;
+	}
+	return vtysh_client_recv(vclient, fp);
+}
 
-		/* If the config needs to be written in file or stdout */
-		if(fp) {
-			fputs(pbuf, fp);
-			fflush(fp);
-		}
+/* Run a command on all the daemons in the 'daemon' mask at once: it is
+ * sent to every one of them before any reply is read, and the replies
+ * are then passed on in daemon order.  Returns the first failure. */
+static int vtysh_client_execute_all(int daemon, const char *line, FILE *fp) {
+	u_int i;
+	int ret;
+	int cmd_stat = CMD_SUCCESS;
 
-		/* At max look last four bytes */
-		if(nbytes >= 4) {
-			i = nbytes - 4;
-			numnulls = 0;
-		} else {
-			i = 0;
+	for(i = 0; i < array_size(vtysh_client); i++) {
+		if(daemon & vtysh_client[i].flag) {
+			vtysh_client_send(&vtysh_client[i], line);
 		}
+	}
 
-		/* Count the numnulls */
-		while(i < nbytes && numnulls < 3) {
-			if(pbuf[i++] == '\0') {
-				numnulls++;
-			} else {
-				numnulls = 0;
+	for(i = 0; i < array_size(vtysh_client); i++) {
+		if(daemon & vtysh_client[i].flag) {
+			ret = vtysh_client_recv(&vtysh_client[i], fp);
+			if(cmd_stat == CMD_SUCCESS) {
+				cmd_stat = ret;
 			}
 		}
-		/* We might have seen 3 consecutive nulls so store the ret code before updating pbuf*/
-		ret = pbuf[nbytes - 1];
-		pbuf += nbytes;
-
-		/* See if a line exists in buffer, if so parse and consume it, and
-        * reset read position. If 3 nulls has been encountered consume the buffer before
-        * next read.
-        */
-		if(((eoln = strrchr(buf, '\n')) == NULL) && (numnulls < 3)) {
-			continue;
-		}
+	}
 
-		if(eoln >= ((buf + bufsz) - 1)) {
-			fprintf(stderr, ERR_WHERE_STRING "warning - eoln beyond buffer end.\n");
-		}
+	return cmd_stat;
+}
 
-		/* If the config needs parsing, consume it */
-		if(!fp) {
-			vtysh_config_parse(buf);
-		}
+/* As vtysh_client_execute_all() on every daemon, each reply headed by
+ * 'title' and the daemon's name. */
+static int vtysh_client_show_all(const char *line, const char *title) {
+	u_int i;
+	int ret = CMD_SUCCESS;
 
-		eoln++;
-		left = (size_t) (buf + bufsz - eoln);
-		/*
-        * This check is required since when a config line split between two consecutive reads,
-        * then buf will have first half of config line and current read will bring rest of the
-        * line. So in this case eoln will be 1 here, hence calculation of left will be wrong.
-        * In this case we don't need to do memmove, because we have already seen 3 nulls.
-        */
-		if(left < bufsz) {
-			memmove(buf, eoln, left);
-		}
+	for(i = 0; i < array_size(vtysh_client); i++) {
+		vtysh_client_send(&vtysh_client[i], line);
+	}
 
-		buf[bufsz - 1] = '\0';
-		pbuf = buf + strlen(buf);
-		/* got 3 or more trailing NULs? */
-		if((numnulls >= 3) && (i < nbytes)) {
-			break;
+	for(i = 0; i < array_size(vtysh_client); i++) {
+		if(vtysh_client[i].pending) {
+			fprintf(stdout, "%s for %s:\n", title, vtysh_client[i].name);
+			ret = vtysh_client_recv(&vtysh_client[i], stdout);
+			fprintf(stdout, "\n");
 		}
 	}
 
-	if(!fp) {
-		vtysh_config_parse(buf);
+	return ret;
+}
+
+/* Send a config line without waiting for its reply, reading replies
+ * only to keep VTYSH_PIPELINE_DEPTH at most outstanding.  The daemon
+ * writes its own error messages into the replies. */
+static void vtysh_client_pipeline(struct vtysh_client *vclient, const char *line) {
+	if(vclient->pending >= VTYSH_PIPELINE_DEPTH) {
+		vtysh_client_recv(vclient, stdout);
 	}
+	vtysh_client_send(vclient, line);
+}
 
-	XFREE(MTYPE_TMP, buf);
-	return ret;
+/* Read all the replies still outstanding. */
+static void vtysh_client_drain(void) {
+	u_int i;
+
+	for(i = 0; i < array_size(vtysh_client); i++) {
+		while(vtysh_client[i].pending) {
+			vtysh_client_recv(&vtysh_client[i], stdout);
+		}
+	}
 }
 
 void vtysh_pager_init(void) {
@@ -243,7 +302,6 @@ void vtysh_pager_init(void) {
 /* Command execution over the vty interface. */
 static int vtysh_execute_func(const char *line, int pager) {
 	int ret, cmd_stat;
-	u_int i;
 	vector vline;
 	struct cmd_element *cmd;
 	FILE *fp = NULL;
@@ -322,12 +380,7 @@ static int vtysh_execute_func(const char *line, int pager) {
 				}
 
 				if(!strcmp(cmd->string, "configure terminal")) {
-					for(i = 0; i < array_size(vtysh_client); i++) {
-						cmd_stat = vtysh_client_execute(&vtysh_client[i], line, fp);
-						if(cmd_stat == CMD_WARNING) {
-							break;
-						}
-					}
+					cmd_stat = vtysh_client_execute_all(VTYSH_ALL, line, fp);
 
 					if(cmd_stat) {
 						line = "end";
@@ -354,15 +407,7 @@ static int vtysh_execute_func(const char *line, int pager) {
 					}
 				}
 
-				cmd_stat = CMD_SUCCESS;
-				for(i = 0; i < array_size(vtysh_client); i++) {
-					if(cmd->daemon & vtysh_client[i].flag) {
-						cmd_stat = vtysh_client_execute(&vtysh_client[i], line, fp);
-						if(cmd_stat != CMD_SUCCESS) {
-							break;
-						}
-					}
-				}
+				cmd_stat = vtysh_client_execute_all(cmd->daemon, line, fp);
 				if(cmd_stat != CMD_SUCCESS) {
 					break;
 				}
@@ -409,19 +454,14 @@ int vtysh_config_from_file(struct vty *vty, FILE *fp) {
 			case CMD_SUCCESS_DAEMON:
 				{
 					u_int i;
-					int cmd_stat = CMD_SUCCESS;
 
+					/* Replies are read later; the daemons report their own
+					   errors, and any vtysh node change follows the file. */
 					for(i = 0; i < array_size(vtysh_client); i++) {
 						if(cmd->daemon & vtysh_client[i].flag) {
-							cmd_stat = vtysh_client_execute(&vtysh_client[i], vty->buf, stdout);
-							if(cmd_stat != CMD_SUCCESS) {
-								break;
-							}
+							vtysh_client_pipeline(&vtysh_client[i], vty->buf);
 						}
 					}
-					if(cmd_stat != CMD_SUCCESS) {
-						break;
-					}
 
 					if(cmd->func) {
 						(*cmd->func)(cmd, vty, 0, NULL);
@@ -429,6 +469,7 @@ int vtysh_config_from_file(struct vty *vty, FILE *fp) {
 				}
 		}
 	}
+	vtysh_client_drain();
 	return CMD_SUCCESS;
 }
 
@@ -1109,14 +1150,36 @@ DEFUN(vtysh_show_thread, vtysh_show_thread_cmd, "show thread cpu [FILTER]",
       SHOW_STR "Thread information\n"
 	       "Thread CPU usage\n"
 	       "Display filter (rwtexb)\n") {
-	unsigned int i;
 	int ret = CMD_SUCCESS;
 	char line[100];
 
 	sprintf(line, "show thread cpu %s\n", (argc == 1) ? argv[0] : "");
+	ret = vtysh_client_show_all(line, "Thread statistics");
+	return ret;
+}
+
+DEFUN(vtysh_show_thread_latency, vtysh_show_thread_latency_cmd, "show thread latency [FILTER]",
+      SHOW_STR "Thread information\n"
+	       "Thread latency percentiles\n"
+	       "Display filter (rwtexb)\n") {
+	int ret = CMD_SUCCESS;
+	char line[100];
+
+	snprintf(line, sizeof(line), "show thread latency %s\n", (argc == 1) ? argv[0] : "");
+	ret = vtysh_client_show_all(line, "Thread latency");
+	return ret;
+}
+
+DEFUN(vtysh_show_thread_placement, vtysh_show_thread_placement_cmd, "show thread placement",
+      SHOW_STR "Thread information\n"
+	       "Where threads run\n") {
+	unsigned int i;
+	int ret = CMD_SUCCESS;
+	char line[] = "show thread placement\n";
+
 	for(i = 0; i < array_size(vtysh_client); i++) {
 		if(vtysh_client[i].fd >= 0) {
-			fprintf(stdout, "Thread statistics for %s:\n", vtysh_client[i].name);
+			fprintf(stdout, "Thread placement for %s:\n", vtysh_client[i].name);
 			ret = vtysh_client_execute(&vtysh_client[i], line, stdout);
 			fprintf(stdout, "\n");
 		}
@@ -1125,17 +1188,10 @@ DEFUN(vtysh_show_thread, vtysh_show_thread_cmd, "show thread cpu [FILTER]",
 }
 
 DEFUN(vtysh_show_work_queues, vtysh_show_work_queues_cmd, "show work-queues", SHOW_STR "Work Queue information\n") {
-	unsigned int i;
 	int ret = CMD_SUCCESS;
 	char line[] = "show work-queues\n";
 
-	for(i = 0; i < array_size(vtysh_client); i++) {
-		if(vtysh_client[i].fd >= 0) {
-			fprintf(stdout, "Work queue statistics for %s:\n", vtysh_client[i].name);
-			ret = vtysh_client_execute(&vtysh_client[i], line, stdout);
-			fprintf(stdout, "\n");
-		}
-	}
+	ret = vtysh_client_show_all(line, "Work queue statistics");
 
 	return ret;
 }
@@ -1177,38 +1233,61 @@ DEFUNSH(VTYSH_ZEBRA, exit_link_params, exit_link_params_cmd, "exit-link-params",
 
 /* Memory */
 DEFUN(vtysh_show_memory, vtysh_show_memory_cmd, "show memory", SHOW_STR "Memory statistics\n") {
-	unsigned int i;
 	int ret = CMD_SUCCESS;
 	char line[] = "show memory\n";
 
-	for(i = 0; i < array_size(vtysh_client); i++) {
-		if(vtysh_client[i].fd >= 0) {
-			fprintf(stdout, "Memory statistics for %s:\n", vtysh_client[i].name);
-			ret = vtysh_client_execute(&vtysh_client[i], line, stdout);
-			fprintf(stdout, "\n");
-		}
-	}
+	ret = vtysh_client_show_all(line, "Memory statistics");
 
 	return ret;
 }
 
+DEFUN(vtysh_show_memory_profile, vtysh_show_memory_profile_cmd, "show memory profile",
+      SHOW_STR "Memory statistics\n"
+	       "Allocation sites, from sampled allocations\n") {
+	int ret = CMD_SUCCESS;
+	char line[] = "show memory profile\n";
+
+	ret = vtysh_client_show_all(line, "Memory profile");
+
+	return ret;
+}
+
+DEFUNSH(VTYSH_ALL, vtysh_memory_profile, vtysh_memory_profile_cmd, "memory profile sample <1-1000000>",
+	"Memory allocation\n"
+	"Allocation-site profiling\n"
+	"Sample one in so many allocations, starting over\n"
+	"Allocations per sample\n") {
+	return CMD_SUCCESS;
+}
+
+DEFUNSH(VTYSH_ALL, no_vtysh_memory_profile, no_vtysh_memory_profile_cmd, "no memory profile",
+	NO_STR "Memory allocation\n"
+	       "Allocation-site profiling\n") {
+	return CMD_SUCCESS;
+}
+
 /* Logging commands. */
 DEFUN(vtysh_show_logging, vtysh_show_logging_cmd, "show logging", SHOW_STR "Show current logging configuration\n") {
-	unsigned int i;
 	int ret = CMD_SUCCESS;
 	char line[] = "show logging\n";
 
-	for(i = 0; i < array_size(vtysh_client); i++) {
-		if(vtysh_client[i].fd >= 0) {
-			fprintf(stdout, "Logging configuration for %s:\n", vtysh_client[i].name);
-			ret = vtysh_client_execute(&vtysh_client[i], line, stdout);
-			fprintf(stdout, "\n");
-		}
-	}
+	ret = vtysh_client_show_all(line, "Logging configuration");
 
 	return ret;
 }
 
+DEFUNSH(VTYSH_ALL, vtysh_config_batch, vtysh_config_batch_cmd, "configuration batch",
+	"Configuration transaction\n"
+	"Hold back policy updates until commit or end of configuration\n") {
+	return CMD_SUCCESS;
+}
+
+DEFUNSH(VTYSH_ALL, vtysh_config_commit, vtysh_config_commit_cmd, "configuration commit",
+	"Configuration transaction\n"
+	"Apply the policy updates held back since batch\n") {
+	return CMD_SUCCESS;
+}
+
 DEFUNSH(VTYSH_ALL, vtysh_log_stdout, vtysh_log_stdout_cmd, "log stdout",
 	"Logging control\n"
 	"Set stdout logging level\n") {
@@ -1358,6 +1437,18 @@ DEFUNSH(VTYSH_ALL, no_vtysh_log_timestamp_precision, no_vtysh_log_timestamp_prec
 	return CMD_SUCCESS;
 }
 
+DEFUNSH(VTYSH_ALL, vtysh_log_async, vtysh_log_async_cmd, "log async",
+	"Logging control\n"
+	"Write log files and syslog from a separate thread\n") {
+	return CMD_SUCCESS;
+}
+
+DEFUNSH(VTYSH_ALL, no_vtysh_log_async, no_vtysh_log_async_cmd, "no log async",
+	NO_STR "Logging control\n"
+	       "Write log files and syslog from a separate thread\n") {
+	return CMD_SUCCESS;
+}
+
 DEFUNSH(VTYSH_ALL, vtysh_service_password_encrypt, vtysh_service_password_encrypt_cmd, "service password-encryption",
 	"Set up miscellaneous service\n"
 	"Enable encrypted passwords\n") {
@@ -1409,7 +1500,6 @@ DEFUNSH(VTYSH_ALL, no_vtysh_config_enable_password, no_vtysh_enable_password_cmd
 DEFUN(vtysh_write_terminal, vtysh_write_terminal_cmd, "write terminal",
       "Write running configuration to memory, network, or terminal\n"
       "Write to terminal\n") {
-	u_int i;
 	char line[] = "write terminal\n";
 	FILE *fp = NULL;
 
@@ -1427,9 +1517,7 @@ DEFUN(vtysh_write_terminal, vtysh_write_terminal_cmd, "write terminal",
 	vty_out(vty, "%sCurrent configuration:%s", VTY_NEWLINE, VTY_NEWLINE);
 	vty_out(vty, "!%s", VTY_NEWLINE);
 
-	for(i = 0; i < array_size(vtysh_client); i++) {
-		vtysh_client_execute(&vtysh_client[i], line, NULL);
-	}
+	vtysh_client_execute_all(VTYSH_ALL, line, NULL);
 
 	/* Integrate vtysh specific configuration. */
 	vtysh_config_write();
@@ -1494,7 +1582,6 @@ DEFUN(no_vtysh_integrated_config, no_vtysh_integrated_config_cmd, "no service in
 }
 
 static int write_config_integrated(void) {
-	u_int i;
 	char line[] = "write terminal\n";
 	FILE *fp;
 	char *integrate_sav = NULL;
@@ -1516,9 +1603,7 @@ static int write_config_integrated(void) {
 		return CMD_SUCCESS;
 	}
 
-	for(i = 0; i < array_size(vtysh_client); i++) {
-		vtysh_client_execute(&vtysh_client[i], line, NULL);
-	}
+	vtysh_client_execute_all(VTYSH_ALL, line, NULL);
 
 	vtysh_config_write();
 	vtysh_config_dump(fp);
@@ -1542,7 +1627,6 @@ DEFUN(vtysh_write_memory, vtysh_write_memory_cmd, "write memory",
       "Write configuration to the file (same as write file)\n") {
 	int ret = CMD_SUCCESS;
 	char line[] = "write memory\n";
-	u_int i;
 
 	/* If integrated Quagga.conf explicitely set. */
 	if(vtysh_writeconfig_integrated) {
@@ -1551,9 +1635,7 @@ DEFUN(vtysh_write_memory, vtysh_write_memory_cmd, "write memory",
 
 	fprintf(stdout, "Building Configuration...\n");
 
-	for(i = 0; i < array_size(vtysh_client); i++) {
-		ret = vtysh_client_execute(&vtysh_client[i], line, stdout);
-	}
+	ret = vtysh_client_execute_all(VTYSH_ALL, line, stdout);
 
 	fprintf(stdout, "[OK]\n");
 
@@ -2120,6 +2202,10 @@ void vtysh_init_vty(void) {
 
 	install_element(VIEW_NODE, &vtysh_show_memory_cmd);
 	install_element(ENABLE_NODE, &vtysh_show_memory_cmd);
+	install_element(VIEW_NODE, &vtysh_show_memory_profile_cmd);
+	install_element(ENABLE_NODE, &vtysh_show_memory_profile_cmd);
+	install_element(ENABLE_NODE, &vtysh_memory_profile_cmd);
+	install_element(ENABLE_NODE, &no_vtysh_memory_profile_cmd);
 
 	install_element(VIEW_NODE, &vtysh_show_work_queues_cmd);
 	install_element(ENABLE_NODE, &vtysh_show_work_queues_cmd);
@@ -2128,10 +2214,16 @@ void vtysh_init_vty(void) {
 
 	install_element(VIEW_NODE, &vtysh_show_thread_cmd);
 	install_element(ENABLE_NODE, &vtysh_show_thread_cmd);
+	install_element(VIEW_NODE, &vtysh_show_thread_latency_cmd);
+	install_element(ENABLE_NODE, &vtysh_show_thread_latency_cmd);
+	install_element(VIEW_NODE, &vtysh_show_thread_placement_cmd);
+	install_element(ENABLE_NODE, &vtysh_show_thread_placement_cmd);
 
 	/* Logging */
 	install_element(ENABLE_NODE, &vtysh_show_logging_cmd);
 	install_element(VIEW_NODE, &vtysh_show_logging_cmd);
+	install_element(CONFIG_NODE, &vtysh_config_batch_cmd);
+	install_element(CONFIG_NODE, &vtysh_config_commit_cmd);
 	install_element(CONFIG_NODE, &vtysh_log_stdout_cmd);
 	install_element(CONFIG_NODE, &vtysh_log_stdout_level_cmd);
 	install_element(CONFIG_NODE, &no_vtysh_log_stdout_cmd);
@@ -2153,6 +2245,8 @@ void vtysh_init_vty(void) {
 	install_element(CONFIG_NODE, &no_vtysh_log_record_priority_cmd);
 	install_element(CONFIG_NODE, &vtysh_log_timestamp_precision_cmd);
 	install_element(CONFIG_NODE, &no_vtysh_log_timestamp_precision_cmd);
+	install_element(CONFIG_NODE, &vtysh_log_async_cmd);
+	install_element(CONFIG_NODE, &no_vtysh_log_async_cmd);
 
 	install_element(CONFIG_NODE, &vtysh_service_password_encrypt_cmd);
 	install_element(CONFIG_NODE, &no_vtysh_service_password_encrypt_cmd);
@@ -318,6 +318,8 @@ static void vtysh_read_file(FILE *confp) {
 
 	vtysh_execute_no_pager("enable");
 	vtysh_execute_no_pager("configure terminal");
+	/* Policy updates are done once, at the "end" below. */
+	vtysh_execute_no_pager("configuration batch");
 
 	/* Execute configuration file. */
 	ret = vtysh_config_from_file(vty, confp);
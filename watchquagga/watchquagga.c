@@ -56,6 +56,14 @@
 
 #define PING_TOKEN "PING"
 
+/* Echo round trips are summed up over windows of this many seconds, the
+   last ECHO_WINDOWS of them kept. */
+#define ECHO_WINDOW_SECS 60
+#define ECHO_WINDOWS 15
+
+/* Most of a diagnostic command's output that is kept for the log */
+#define SNAPSHOT_MAX 32768
+
 /* Needs to be global, referenced somewhere inside libzebra. */
 struct thread_master *master;
 
@@ -117,6 +125,7 @@ static struct global_state {
 	int numdaemons;
 	int numpids;
 	int numdown; /* # of daemons that are not UP or UNRESPONSIVE */
+	long latency_threshold; /* msec, 0 for none */
 } gs = {
 	.mode = MODE_MONITOR,
 	.phase = PHASE_NONE,
@@ -144,11 +153,26 @@ static const char *state_str[] = {
 	"Init", "Down", "Connecting", "Up", "Unresponsive",
 };
 
+struct echo_window {
+	time_t start;
+	u_long count;
+	u_long min, max, sum; /* usec */
+};
+
 struct daemon {
 	const char *name;
 	daemon_state_t state;
 	int fd;
 	struct timeval echo_sent;
+	struct echo_window echo_stats[ECHO_WINDOWS];
+	int echo_cur;
+	time_t last_snapshot;
+	/* while diagnostic commands run: the next one, and what the current
+	   one has said so far */
+	int snapshot;
+	char *snap;
+	size_t snap_len;
+	u_char snap_tail[4];
 	u_int connect_tries;
 	struct thread *t_wakeup;
 	struct thread *t_read;
@@ -176,6 +200,7 @@ static const struct option longopts[] = {
 	{ "max-restart-interval", required_argument, NULL, 'M'},
 	{ "pid-file",	      required_argument, NULL, 'p'},
 	{ "blank-string",	  required_argument, NULL, 'b'},
+	{ "latency-threshold",	  required_argument, NULL, 'L'},
 	{ "help",		  no_argument,       NULL, 'h'},
 	{ "version",		     no_argument,	  NULL, 'v'},
 	{ NULL,		   0,		   NULL, 0  }
@@ -183,6 +208,8 @@ static const struct option longopts[] = {
 
 static int try_connect(struct daemon *dmn);
 static int wakeup_send_echo(struct thread *t_wakeup);
+static int wakeup_no_answer(struct thread *t_wakeup);
+static int handle_read(struct thread *t_read);
 static void try_restart(struct daemon *dmn);
 static void phase_check(void);
 
@@ -294,9 +321,14 @@ Otherwise, the interval is doubled (but capped at the -M value).\n\n",
 		various shell command arguments (-r, -s, -k, or -R), replace\n\
 		it with a space.  This is an ugly hack to circumvent problems\n\
 		passing command-line arguments with embedded spaces.\n\
+-L, --latency-threshold\n\
+		When an echo takes longer than this many milliseconds, log\n\
+		the daemon's 'show thread cpu' and 'show work-queues' (at\n\
+		most once every %d seconds).  Echo round trip times are\n\
+		logged on SIGUSR1 for each of the last %d minutes.\n\
 -v, --version	Print program version\n\
 -h, --help	Display this help and exit\n",
-		       VTYDIR, DEFAULT_LOGLEVEL, LOG_EMERG, LOG_DEBUG, LOG_DEBUG, DEFAULT_MIN_RESTART, DEFAULT_MAX_RESTART, DEFAULT_PERIOD, DEFAULT_TIMEOUT, DEFAULT_RESTART_TIMEOUT, DEFAULT_PIDFILE);
+		       VTYDIR, DEFAULT_LOGLEVEL, LOG_EMERG, LOG_DEBUG, LOG_DEBUG, DEFAULT_MIN_RESTART, DEFAULT_MAX_RESTART, DEFAULT_PERIOD, DEFAULT_TIMEOUT, DEFAULT_RESTART_TIMEOUT, DEFAULT_PIDFILE, ECHO_WINDOW_SECS, ECHO_WINDOW_SECS * ECHO_WINDOWS / 60);
 	}
 
 	return status;
@@ -512,6 +544,7 @@ static void daemon_down(struct daemon *dmn, const char *why) {
 		gs.numdown++;
 	}
 	dmn->state = DAEMON_DOWN;
+	dmn->snapshot = 0;
 	if(dmn->fd >= 0) {
 		close(dmn->fd);
 		dmn->fd = -1;
@@ -525,6 +558,155 @@ static void daemon_down(struct daemon *dmn, const char *why) {
 	phase_check();
 }
 
+static const char *snapshot_cmds[] = {
+	"show thread cpu",
+	"show work-queues",
+};
+
+/* Add an echo round trip to the current window, starting a new one when
+   it is over. */
+static void echo_latency_record(struct daemon *dmn, const struct timeval *delay) {
+	struct echo_window *w = &dmn->echo_stats[dmn->echo_cur];
+	u_long usec = delay->tv_sec * 1000000UL + delay->tv_usec;
+	time_t now = time(NULL);
+
+	if(w->count && now - w->start >= ECHO_WINDOW_SECS) {
+		if(gs.loglevel > LOG_DEBUG) {
+			zlog_debug("%s: %lu echoes, min/avg/max %lu/%lu/%lu usec", dmn->name, w->count, w->min, w->sum / w->count, w->max);
+		}
+		dmn->echo_cur = (dmn->echo_cur + 1) % ECHO_WINDOWS;
+		w = &dmn->echo_stats[dmn->echo_cur];
+		memset(w, 0, sizeof(*w));
+	}
+	if(!w->count) {
+		w->start = now;
+		w->min = usec;
+	}
+	w->count++;
+	w->sum += usec;
+	if(usec < w->min) {
+		w->min = usec;
+	}
+	if(usec > w->max) {
+		w->max = usec;
+	}
+}
+
+static void echo_latency_report(void) {
+	struct daemon *dmn;
+
+	for(dmn = gs.daemons; dmn; dmn = dmn->next) {
+		int i;
+
+		zlog_notice("%s: echo round trips, min/avg/max usec, %s", dmn->name, state_str[dmn->state]);
+		for(i = 1; i <= ECHO_WINDOWS; i++) {
+			struct echo_window *w = &dmn->echo_stats[(dmn->echo_cur + i) % ECHO_WINDOWS];
+			struct tm tm;
+			char when[16];
+
+			if(!w->count) {
+				continue;
+			}
+			localtime_r(&w->start, &tm);
+			strftime(when, sizeof(when), "%H:%M:%S", &tm);
+			zlog_notice("%s:   from %s: %lu echoes, %lu/%lu/%lu", dmn->name, when, w->count, w->min, w->sum / w->count, w->max);
+		}
+	}
+}
+
+/* Send the next diagnostic command, or return 0 when they have all run */
+static int snapshot_next(struct daemon *dmn) {
+	const char *cmd;
+	ssize_t rc;
+
+	if(dmn->snapshot >= (int) array_size(snapshot_cmds)) {
+		dmn->snapshot = 0;
+		return 0;
+	}
+	cmd = snapshot_cmds[dmn->snapshot++];
+	if(((rc = write(dmn->fd, cmd, strlen(cmd) + 1)) < 0) || ((size_t) rc != strlen(cmd) + 1)) {
+		char why[100];
+		snprintf(why, sizeof(why), "write '%s' returned %d", cmd, (int) rc);
+		daemon_down(dmn, why);
+		return -1;
+	}
+	dmn->snap_len = 0;
+	memset(dmn->snap_tail, 0xff, sizeof(dmn->snap_tail));
+	dmn->t_wakeup = thread_add_timer(master, wakeup_no_answer, dmn, gs.timeout);
+	return 1;
+}
+
+/* Start logging what the daemon is busy with, if it has not been done
+   lately. */
+static int snapshot_start(struct daemon *dmn) {
+	time_t now = time(NULL);
+
+	if(dmn->last_snapshot && now - dmn->last_snapshot < ECHO_WINDOW_SECS) {
+		return 0;
+	}
+	dmn->last_snapshot = now;
+	if(!dmn->snap) {
+		dmn->snap = XMALLOC(MTYPE_TMP, SNAPSHOT_MAX);
+	}
+	return snapshot_next(dmn);
+}
+
+/* Output of a diagnostic command: a command's output ends in three
+   zero bytes and its status. */
+static void snapshot_read(struct daemon *dmn) {
+	char buf[4096];
+	ssize_t rc, i;
+	size_t n;
+	char *line, *end;
+
+	if((rc = read(dmn->fd, buf, sizeof(buf))) <= 0) {
+		char why[100];
+
+		if(rc < 0 && ERRNO_IO_RETRY(errno)) {
+			SET_READ_HANDLER(dmn);
+			return;
+		}
+		snprintf(why, sizeof(why), "diagnostic read returned %d: %s", (int) rc, rc ? safe_strerror(errno) : "EOF");
+		daemon_down(dmn, why);
+		return;
+	}
+
+	n = MIN((size_t) rc, SNAPSHOT_MAX - 1 - dmn->snap_len);
+	memcpy(dmn->snap + dmn->snap_len, buf, n);
+	dmn->snap_len += n;
+	for(i = 0; i < rc; i++) {
+		memmove(dmn->snap_tail, dmn->snap_tail + 1, 3);
+		dmn->snap_tail[3] = buf[i];
+	}
+	SET_READ_HANDLER(dmn);
+	if(dmn->snap_tail[0] || dmn->snap_tail[1] || dmn->snap_tail[2]) {
+		return;
+	}
+
+	/* the output has no NULs, the end marker starts at the first */
+	dmn->snap[dmn->snap_len] = '\0';
+	zlog_warn("%s: %s:", dmn->name, snapshot_cmds[dmn->snapshot - 1]);
+	for(line = dmn->snap; *line; line = end) {
+		if((end = strchr(line, '\n')) != NULL) {
+			*end++ = '\0';
+		} else {
+			end = line + strlen(line);
+		}
+		if(*line && *line != '\r') {
+			zlog_warn("%s:   %s", dmn->name, line);
+		}
+	}
+
+	THREAD_OFF(dmn->t_wakeup);
+	if(dmn->state == DAEMON_UNRESPONSIVE) {
+		dmn->state = DAEMON_UP;
+		zlog_warn("%s state -> up : diagnostic command answered", dmn->name);
+	}
+	if(snapshot_next(dmn) == 0) {
+		SET_WAKEUP_ECHO(dmn);
+	}
+}
+
 static int handle_read(struct thread *t_read) {
 	struct daemon *dmn = THREAD_ARG(t_read);
 	static const char resp[sizeof(PING_TOKEN) + 4] = PING_TOKEN "\n";
@@ -533,6 +715,10 @@ static int handle_read(struct thread *t_read) {
 	struct timeval delay;
 
 	dmn->t_read = NULL;
+	if(dmn->snapshot) {
+		snapshot_read(dmn);
+		return 0;
+	}
 	if((rc = read(dmn->fd, buf, sizeof(buf))) < 0) {
 		char why[100];
 
@@ -573,6 +759,7 @@ static int handle_read(struct thread *t_read) {
 
 	time_elapsed(&delay, &dmn->echo_sent);
 	dmn->echo_sent.tv_sec = 0;
+	echo_latency_record(dmn, &delay);
 	if(dmn->state == DAEMON_UNRESPONSIVE) {
 		if(delay.tv_sec < gs.timeout) {
 			dmn->state = DAEMON_UP;
@@ -596,6 +783,14 @@ static int handle_read(struct thread *t_read) {
 	if(dmn->t_wakeup) {
 		thread_cancel(dmn->t_wakeup);
 	}
+	dmn->t_wakeup = NULL;
+
+	if(gs.latency_threshold && delay.tv_sec * 1000 + delay.tv_usec / 1000 > gs.latency_threshold) {
+		zlog_warn("%s: echo took %ld.%06ld seconds", dmn->name, (long) delay.tv_sec, (long) delay.tv_usec);
+		if(snapshot_start(dmn)) {
+			return 0;
+		}
+	}
 	SET_WAKEUP_ECHO(dmn);
 
 	return 0;
@@ -877,6 +1072,10 @@ static int wakeup_send_echo(struct thread *t_wakeup) {
 	return 0;
 }
 
+static void sigusr1(void) {
+	echo_latency_report();
+}
+
 static void sigint(void) {
 	zlog_notice("Terminating on signal");
 	exit(0);
@@ -928,6 +1127,10 @@ int main(int argc, char **argv) {
 			.signal = SIGCHLD,
 			.handler = sigchild,
 		 },
+		{
+			.signal = SIGUSR1,
+			.handler = sigusr1,
+		 },
 	};
 
 	if((progname = strrchr(argv[0], '/')) != NULL) {
@@ -937,7 +1140,7 @@ int main(int argc, char **argv) {
 	}
 
 	gs.restart.name = "all";
-	while((opt = getopt_long(argc, argv, "aAb:dek:l:m:M:i:p:r:R:S:s:t:T:zvh", longopts, 0)) != EOF) {
+	while((opt = getopt_long(argc, argv, "aAb:dek:l:L:m:M:i:p:r:R:S:s:t:T:zvh", longopts, 0)) != EOF) {
 		switch(opt) {
 			case 0: break;
 			case 'a':
@@ -973,6 +1176,15 @@ int main(int argc, char **argv) {
 					}
 				}
 				break;
+			case 'L':
+				{
+					char garbage[3];
+					if((sscanf(optarg, "%ld%1s", &gs.latency_threshold, garbage) != 1) || (gs.latency_threshold < 0)) {
+						fprintf(stderr, "Invalid latency threshold argument: %s\n", optarg);
+						return usage(progname, 1);
+					}
+				}
+				break;
 			case 'm':
 				{
 					char garbage[3];
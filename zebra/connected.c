@@ -68,7 +68,7 @@ static void connected_withdraw(struct connected *ifc) {
 	UNSET_FLAG(ifc->conf, ZEBRA_IFC_QUEUED);
 
 	if(!CHECK_FLAG(ifc->conf, ZEBRA_IFC_CONFIGURED)) {
-		listnode_delete(ifc->ifp->connected, ifc);
+		connected_delete(ifc->ifp, ifc);
 		connected_free(ifc);
 	}
 }
@@ -86,7 +86,7 @@ static void connected_announce(struct interface *ifp, struct connected *ifc) {
 		}
 	}
 
-	listnode_add(ifp->connected, ifc);
+	connected_add(ifp, ifc);
 
 	/* Update interface address information to protocol daemon. */
 	if(ifc->address->family == AF_INET) {
@@ -210,7 +210,7 @@ void connected_up_ipv4(struct interface *ifp, struct connected *ifc) {
 
 	rib_add_ipv4(ZEBRA_ROUTE_CONNECT, 0, &p, NULL, NULL, ifp->ifindex, ifp->vrf_id, RT_TABLE_MAIN, ifp->metric, 0, 0, SAFI_MULTICAST);
 
-	rib_update(ifp->vrf_id);
+	rib_update_interface(ifp);
 }
 
 /* Add connected IPv4 route to the interface. */
@@ -318,7 +318,7 @@ void connected_down_ipv4(struct interface *ifp, struct connected *ifc) {
 
 	rib_delete_ipv4(ZEBRA_ROUTE_CONNECT, 0, &p, NULL, ifp->ifindex, ifp->vrf_id, SAFI_MULTICAST);
 
-	rib_update(ifp->vrf_id);
+	rib_update_interface(ifp);
 }
 
 /* Delete connected IPv4 route to the interface. */
@@ -338,7 +338,7 @@ void connected_delete_ipv4(struct interface *ifp, int flags, struct in_addr *add
 
 	connected_withdraw(ifc);
 
-	rib_update(ifp->vrf_id);
+	rib_update_interface(ifp);
 }
 
 #ifdef HAVE_IPV6
@@ -363,7 +363,7 @@ void connected_up_ipv6(struct interface *ifp, struct connected *ifc) {
 
 	rib_add_ipv6(ZEBRA_ROUTE_CONNECT, 0, &p, NULL, ifp->ifindex, ifp->vrf_id, RT_TABLE_MAIN, ifp->metric, 0, 0, SAFI_UNICAST);
 
-	rib_update(ifp->vrf_id);
+	rib_update_interface(ifp);
 }
 
 /* Add connected IPv6 route to the interface. */
@@ -444,7 +444,7 @@ void connected_down_ipv6(struct interface *ifp, struct connected *ifc) {
 
 	rib_delete_ipv6(ZEBRA_ROUTE_CONNECT, 0, &p, NULL, ifp->ifindex, ifp->vrf_id, SAFI_UNICAST);
 
-	rib_update(ifp->vrf_id);
+	rib_update_interface(ifp);
 }
 
 void connected_delete_ipv6(struct interface *ifp, struct in6_addr *address, u_char prefixlen, struct in6_addr *broad) {
@@ -463,6 +463,6 @@ void connected_delete_ipv6(struct interface *ifp, struct in6_addr *address, u_ch
 
 	connected_withdraw(ifc);
 
-	rib_update(ifp->vrf_id);
+	rib_update_interface(ifp);
 }
 #endif /* HAVE_IPV6 */
@@ -114,7 +114,6 @@ static int if_zebra_new_hook(struct interface *ifp) {
 		rtadv->AdvSendAdvertisements = 0;
 		rtadv->MaxRtrAdvInterval = RTADV_MAX_RTR_ADV_INTERVAL;
 		rtadv->MinRtrAdvInterval = RTADV_MIN_RTR_ADV_INTERVAL;
-		rtadv->AdvIntervalTimer = 0;
 		rtadv->AdvManagedFlag = 0;
 		rtadv->AdvOtherConfigFlag = 0;
 		rtadv->AdvHomeAgentFlag = 0;
@@ -146,6 +145,9 @@ static int if_zebra_delete_hook(struct interface *ifp) {
 	if(ifp->info) {
 		zebra_if = ifp->info;
 
+		zebra_interface_notify_cancel(ifp);
+		rtadv_if_delete(ifp);
+
 		/* Free installed address chains tree. */
 		if(zebra_if->ipv4_subnets) {
 			route_table_finish(zebra_if->ipv4_subnets);
@@ -519,7 +521,7 @@ void if_delete_update(struct interface *ifp) {
 
 					/* Remove from interface address list (unconditionally). */
 					if(!CHECK_FLAG(ifc->conf, ZEBRA_IFC_CONFIGURED)) {
-						listnode_delete(ifp->connected, ifc);
+						connected_delete(ifp, ifc);
 						connected_free(ifc);
 					} else {
 						last = node;
@@ -543,7 +545,7 @@ void if_delete_update(struct interface *ifp) {
 				if(CHECK_FLAG(ifc->conf, ZEBRA_IFC_CONFIGURED)) {
 					last = node;
 				} else {
-					listnode_delete(ifp->connected, ifc);
+					connected_delete(ifp, ifc);
 					connected_free(ifc);
 				}
 			}
@@ -560,7 +562,7 @@ void if_delete_update(struct interface *ifp) {
      while processing the deletion.  Each client daemon is responsible
      for setting ifindex to IFINDEX_INTERNAL after processing the
      interface deletion message. */
-	ifp->ifindex = IFINDEX_INTERNAL;
+	if_set_index(ifp, IFINDEX_INTERNAL);
 }
 
 /* Interface is up. */
@@ -591,8 +593,8 @@ void if_up(struct interface *ifp) {
 		}
 	}
 
-	/* Examine all static routes. */
-	rib_update(ifp->vrf_id);
+	/* Examine the routes over the interface. */
+	rib_update_interface(ifp);
 }
 
 /* Interface goes down.  We have to manage different behavior of based
@@ -628,8 +630,8 @@ void if_down(struct interface *ifp) {
 		}
 	}
 
-	/* Examine all static routes which direct to the interface. */
-	rib_update(ifp->vrf_id);
+	/* Examine the routes over the interface. */
+	rib_update_interface(ifp);
 }
 
 void if_refresh(struct interface *ifp) {
@@ -1932,7 +1934,7 @@ static int ip_address_install(struct vty *vty, struct interface *ifp, const char
 		}
 
 		/* Add to linked list. */
-		listnode_add(ifp->connected, ifc);
+		connected_add(ifp, ifc);
 	}
 
 	/* This address is configured from zebra. */
@@ -1991,7 +1993,7 @@ static int ip_address_uninstall(struct vty *vty, struct interface *ifp, const ch
 
 	/* This is not real address or interface is not active. */
 	if(!CHECK_FLAG(ifc->conf, ZEBRA_IFC_QUEUED) || !CHECK_FLAG(ifp->status, ZEBRA_INTERFACE_ACTIVE)) {
-		listnode_delete(ifp->connected, ifc);
+		connected_delete(ifp, ifc);
 		connected_free(ifc);
 		return CMD_WARNING;
 	}
@@ -2079,7 +2081,7 @@ static int ipv6_address_install(struct vty *vty, struct interface *ifp, const ch
 		}
 
 		/* Add to linked list. */
-		listnode_add(ifp->connected, ifc);
+		connected_add(ifp, ifc);
 	}
 
 	/* This address is configured from zebra. */
@@ -2138,7 +2140,7 @@ static int ipv6_address_uninstall(struct vty *vty, struct interface *ifp, const
 
 	/* This is not real address or interface is not active. */
 	if(!CHECK_FLAG(ifc->conf, ZEBRA_IFC_QUEUED) || !CHECK_FLAG(ifp->status, ZEBRA_INTERFACE_ACTIVE)) {
-		listnode_delete(ifp->connected, ifc);
+		connected_delete(ifp, ifc);
 		connected_free(ifc);
 		return CMD_WARNING;
 	}
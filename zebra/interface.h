@@ -75,11 +75,21 @@ struct rtadvconf {
      MUST be no greater than .75 * MaxRtrAdvInterval.
 
      Default: 0.33 * MaxRtrAdvInterval */
-	int MinRtrAdvInterval; /* This field is currently unused. */
+	int MinRtrAdvInterval;
 	#define RTADV_MIN_RTR_ADV_INTERVAL (0.33 * RTADV_MAX_RTR_ADV_INTERVAL)
 
-	/* Unsolicited Router Advertisements' interval timer. */
-	int AdvIntervalTimer;
+	/* Unsolicited Router Advertisements' timer, and how many of the
+     first ones, sent closer together [RFC4861 6.2.4], went out. */
+	struct thread *t_adv;
+	int initial_sent;
+
+	/* The advertisement as it goes on the wire, made when first sent
+     and again after a change to anything in it; the link-layer
+     address option is checked against the interface's each time. */
+	u_char *payload;
+	int payload_len;
+	int payload_hwaddr;
+	int on_send_q;
 
 	/* The TRUE/FALSE value to be placed in the "Managed address
      configuration" flag field in the Router Advertisement.  See
@@ -205,6 +215,13 @@ struct zebra_if {
 	struct event_counter up_events;
 	struct event_counter down_events;
 
+	/* Notifications held back for clients, see zebra/redistribute.c:
+	 * the last up or down, the addresses changed, and whether the
+	 * interface is queued for them to be sent */
+	int notify_cmd;
+	struct list *notify_addrs;
+	u_char notify_queued;
+
 #if defined(HAVE_RTADV)
 	struct rtadvconf rtadv;
 #endif /* RTADV */
@@ -30,14 +30,54 @@
 #include "zebra/connected.h"
 #include "zebra/rib.h"
 
+#ifdef ZEBRA_BENCH
+extern int zebra_bench_kernel(struct prefix *, struct rib *, struct rib *);
+#endif
+
 int kernel_route_rib(struct prefix *a, struct rib *old, struct rib *new) {
+#ifdef ZEBRA_BENCH
+	return zebra_bench_kernel(a, old, new);
+#else
 	return 0;
+#endif
+}
+
+void kernel_route_flush(void) {
+	return;
+}
+
+void kernel_privs_hold(void) {
+	return;
+}
+
+void kernel_privs_release(void) {
+	return;
 }
 
 int kernel_add_route(struct prefix_ipv4 *a, struct in_addr *b, int c, int d) {
 	return 0;
 }
 
+int kernel_nhg_install(struct zebra_nhg *a) {
+	return -1;
+}
+
+void kernel_nhg_uninstall(struct zebra_nhg *a) {
+	return;
+}
+
+int kernel_audit_start(struct zebra_vrf *a, afi_t b) {
+	return -1;
+}
+
+int kernel_audit_read(struct zebra_vrf *a, int b) {
+	return -1;
+}
+
+void kernel_audit_stop(struct zebra_vrf *a) {
+	return;
+}
+
 int kernel_address_add_ipv4(struct interface *a, struct connected *b) {
 	zlog_debug("%s", __func__);
 	SET_FLAG(b->conf, ZEBRA_IFC_REAL);
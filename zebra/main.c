@@ -34,6 +34,7 @@
 #include "privs.h"
 #include "sigevent.h"
 #include "vrf.h"
+#include "table.h"
 
 #include "zebra/rib.h"
 #include "zebra/zserv.h"
@@ -42,6 +43,9 @@
 #include "zebra/irdp.h"
 #include "zebra/rtadv.h"
 #include "zebra/zebra_fpm.h"
+#include "zebra/zebra_nhg.h"
+#include "zebra/zebra_bfd.h"
+#include "zebra/rt.h"
 
 /* Zebra instance */
 struct zebra_t zebrad = {
@@ -60,9 +64,15 @@ int retain_mode = 0;
 /* Don't delete kernel route. */
 int keep_kernel_mode = 0;
 
+/* Keep routes in the kernel for clients to claim, for that many seconds */
+u_int32_t graceful_restart = 0;
+
 #ifdef HAVE_NETLINK
 /* Receive buffer size for netlink socket */
 u_int32_t nl_rcvbufsize = 0;
+
+/* Send route changes to the kernel in batches, from a dataplane thread */
+int nl_batch = 0;
 #endif /* HAVE_NETLINK */
 
 /* Command line options. */
@@ -70,6 +80,7 @@ struct option longopts[] = {
 	{ "batch", no_argument, NULL, 'b' },
 	{ "daemon", no_argument, NULL, 'd' },
 	{ "keep_kernel", no_argument, NULL, 'k' },
+	{ "graceful_restart", required_argument, NULL, 'K' },
 	{ "fpm_format", required_argument, NULL, 'F' },
 	{ "config_file", required_argument, NULL, 'f' },
 	{ "pid_file", required_argument, NULL, 'i' },
@@ -81,6 +92,7 @@ struct option longopts[] = {
 	{ "dryrun", no_argument, NULL, 'C' },
 #ifdef HAVE_NETLINK
 	{ "nl-bufsize", required_argument, NULL, 's' },
+	{ "nl-batch", no_argument, NULL, 'B' },
 #endif  /* HAVE_NETLINK */
 	{ "user", required_argument, NULL, 'u' },
 	{ "group", required_argument, NULL, 'g' },
@@ -131,6 +143,9 @@ static void usage(char *progname, int status) {
 		       "-z, --socket       Set path of zebra socket\n"
 		       "-k, --keep_kernel  Don't delete old routes which installed by "
 		       "zebra.\n"
+		       "-K, --graceful_restart TIME\n"
+		       "                   Keep routes installed by the previous zebra for TIME\n"
+		       "                   seconds, for clients to announce them again\n"
 		       "-C, --dryrun       Check configuration for validity and exit\n"
 		       "-A, --vty_addr     Set vty's bind address\n"
 		       "-P, --vty_port     Set vty's port number\n"
@@ -141,7 +156,9 @@ static void usage(char *progname, int status) {
 		       "-S, --skip_runas   Skip user and group run as\n",
 		       progname);
 #ifdef HAVE_NETLINK
-		printf("-s, --nl-bufsize   Set netlink receive buffer size\n");
+		printf("-s, --nl-bufsize   Set netlink receive buffer size\n"
+		       "-B, --nl-batch     Send route changes to the kernel in batches, from a\n"
+		       "                   dataplane thread\n");
 #endif /* HAVE_NETLINK */
 		printf("-v, --version      Print program version\n"
 		       "-h, --help         Display this help and exit\n"
@@ -167,6 +184,8 @@ static void sigint(void) {
 
 	if(!retain_mode) {
 		rib_close();
+		kernel_route_flush();
+		zebra_nhg_terminate();
 	}
 #ifdef HAVE_IRDP
 	irdp_finish();
@@ -222,8 +241,12 @@ static int zebra_vrf_enable(vrf_id_t vrf_id, void **info) {
 	rtadv_init(zvrf);
 #endif
 	kernel_init(zvrf);
+	/* up for the reads only, not for the rest of startup */
+	kernel_privs_hold();
 	interface_list(zvrf);
 	route_read(zvrf);
+	kernel_privs_release();
+	rib_audit_enable(zvrf);
 
 	return 0;
 }
@@ -247,6 +270,9 @@ static int zebra_vrf_disable(vrf_id_t vrf_id, void **info) {
 		}
 	}
 
+	rib_update_cancel(zvrf);
+	rib_audit_disable(zvrf);
+
 #if defined(HAVE_RTADV)
 	rtadv_terminate(zvrf);
 #endif
@@ -292,9 +318,9 @@ int main(int argc, char **argv) {
 		int opt;
 
 #ifdef HAVE_NETLINK
-		opt = getopt_long(argc, argv, "bdkf:F:i:z:hA:P:ru:g:vs:CS", longopts, 0);
+		opt = getopt_long(argc, argv, "bdkK:f:F:i:z:hA:P:ru:g:vs:BCS", longopts, 0);
 #else
-		opt = getopt_long(argc, argv, "bdkf:F:i:z:hA:P:ru:g:vCS", longopts, 0);
+		opt = getopt_long(argc, argv, "bdkK:f:F:i:z:hA:P:ru:g:vCS", longopts, 0);
 #endif /* HAVE_NETLINK */
 
 		if(opt == EOF) {
@@ -306,6 +332,7 @@ int main(int argc, char **argv) {
 			case 'b': batch_mode = 1;
 			case 'd': daemon_mode = 1; break;
 			case 'k': keep_kernel_mode = 1; break;
+			case 'K': graceful_restart = strtoul(optarg, NULL, 10); break;
 			case 'C': dryrun = 1; break;
 			case 'f': config_file = optarg; break;
 			case 'F': fpm_format = optarg; break;
@@ -327,6 +354,7 @@ int main(int argc, char **argv) {
 			case 'r': retain_mode = 1; break;
 #ifdef HAVE_NETLINK
 			case 's': nl_rcvbufsize = atoi(optarg); break;
+			case 'B': nl_batch = 1; break;
 #endif /* HAVE_NETLINK */
 			case 'u': zserv_privs.user = optarg; break;
 			case 'g': zserv_privs.group = optarg; break;
@@ -342,6 +370,8 @@ int main(int argc, char **argv) {
 
 	/* Make master thread emulator. */
 	zebrad.master = thread_master_create();
+	/* every interface sending router advertisements has a timer */
+	thread_master_timer_wheel_enable(zebrad.master);
 
 	/* privs initialise */
 	if(skip_runas) {
@@ -354,10 +384,13 @@ int main(int argc, char **argv) {
 	cmd_init(1);
 	vty_init(zebrad.master);
 	memory_init();
+	mtype_slab_init(MTYPE_ROUTE_NODE, sizeof(struct route_node));
 
 	/* Zebra related initialize. */
 	zebra_init();
 	rib_init();
+	zebra_nhg_init();
+	zebra_bfd_init();
 	zebra_if_init();
 	zebra_debug_init();
 	router_id_cmd_init();
@@ -432,6 +465,9 @@ int main(int argc, char **argv) {
 	if(!keep_kernel_mode) {
 		rib_sweep_route();
 	}
+	if(graceful_restart) {
+		rib_sweep_start(graceful_restart);
+	}
 
 	/* Needed for BSD routing socket. */
 	pid = getpid();
@@ -31,6 +31,10 @@ void rtadv_config_write(struct vty *vty, struct interface *ifp) {
 	return;
 }
 
+void rtadv_if_delete(struct interface *ifp) {
+	return;
+}
+
 void irdp_config_write(struct vty *vty, struct interface *ifp) {
 	return;
 }
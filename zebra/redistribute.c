@@ -32,16 +32,29 @@
 #include "linklist.h"
 #include "log.h"
 #include "vrf.h"
+#include "memory.h"
+#include "hash.h"
+#include "jhash.h"
 
 #include "zebra/rib.h"
 #include "zebra/zserv.h"
 #include "zebra/redistribute.h"
 #include "zebra/debug.h"
 #include "zebra/router-id.h"
+#include "zebra/interface.h"
 
 /* master zebra server structure */
 extern struct zebra_t zebrad;
 
+/* Routes held back from a client while its output backlog is over the
+ * high watermark: the prefixes changed, by vrf and family, each with the
+ * types of the routes that were to be sent. */
+struct redist_held
+{
+  vrf_id_t vrf_id;
+  struct route_table *table[AFI_MAX];
+};
+
 int
 zebra_check_addr (struct prefix *p)
 {
@@ -147,6 +160,9 @@ zebra_redistribute (struct zserv *client, int type, vrf_id_t vrf_id)
   struct route_table *table;
   struct route_node *rn;
 
+  /* The table is queued for the client and written out as it goes */
+  zserv_cork (client);
+
   table = zebra_vrf_table (AFI_IP, SAFI_UNICAST, vrf_id);
   if (table)
     for (rn = route_top (table); rn; rn = route_next (rn))
@@ -180,73 +196,415 @@ zebra_redistribute (struct zserv *client, int type, vrf_id_t vrf_id)
 	    zsend_route_multipath (ZEBRA_IPV6_ROUTE_ADD, client, &rn->p, newrib);
 	  }
 #endif /* HAVE_IPV6 */
+
+  zserv_uncork (client);
+}
+
+/* Note the change of a route redistributed to a client that is being
+ * held back, to be sent as it stands once the client caught up. */
+static void
+redistribute_hold (struct zserv *client, struct prefix *p, vrf_id_t vrf_id,
+                   int type)
+{
+  struct listnode *node;
+  struct redist_held *held = NULL;
+  struct route_node *rn;
+  afi_t afi = family2afi (p->family);
+
+  if (! client->redist_held)
+    client->redist_held = list_new ();
+  for (ALL_LIST_ELEMENTS_RO (client->redist_held, node, held))
+    if (held->vrf_id == vrf_id)
+      break;
+  if (! node)
+    {
+      held = XCALLOC (MTYPE_ZEBRA_REDIST_HELD, sizeof (struct redist_held));
+      held->vrf_id = vrf_id;
+      listnode_add (client->redist_held, held);
+    }
+  if (! held->table[afi])
+    held->table[afi] = route_table_init ();
+
+  rn = route_node_get (held->table[afi], p);
+  if (rn->info)
+    route_unlock_node (rn);
+  else
+    client->redist_held_cnt++;
+  rn->info = (void *) ((uintptr_t) rn->info | ((uintptr_t) 1 << type));
+}
+
+/* Send the route selected for a prefix held back, if redistributed,
+ * and withdraw the other types that were to be sent. */
+static void
+redistribute_held_send (struct zserv *client, struct route_node *hn,
+                        vrf_id_t vrf_id, afi_t afi)
+{
+  uintptr_t types = (uintptr_t) hn->info;
+  struct route_table *table;
+  struct route_node *rn = NULL;
+  struct rib *rib, *sel = NULL;
+  struct rib dummy;
+  int type;
+
+  table = zebra_vrf_table (afi, SAFI_UNICAST, vrf_id);
+  if (table)
+    rn = route_node_lookup (table, &hn->p);
+  if (rn)
+    {
+      RNODE_FOREACH_RIB (rn, rib)
+        if (CHECK_FLAG (rib->flags, ZEBRA_FLAG_SELECTED)
+            && rib->distance != DISTANCE_INFINITY)
+          {
+            sel = rib;
+            break;
+          }
+    }
+
+  if (sel && (vrf_bitmap_check (client->redist[sel->type], vrf_id)
+              || (is_default (&hn->p)
+                  && vrf_bitmap_check (client->redist_default, vrf_id))))
+    {
+      if (afi == AFI_IP)
+        {
+          client->redist_v4_add_cnt++;
+          zsend_route_multipath (ZEBRA_IPV4_ROUTE_ADD, client, &hn->p, sel);
+        }
+      else
+        {
+          client->redist_v6_add_cnt++;
+          zsend_route_multipath (ZEBRA_IPV6_ROUTE_ADD, client, &hn->p, sel);
+        }
+      types &= ~((uintptr_t) 1 << sel->type);
+    }
+
+  /* zsend_route_multipath() reads no more than these for a delete */
+  memset (&dummy, 0, sizeof (struct rib));
+  dummy.vrf_id = vrf_id;
+  for (type = 0; type < ZEBRA_ROUTE_MAX; type++)
+    if (types & ((uintptr_t) 1 << type))
+      {
+        dummy.type = type;
+        zsend_route_multipath (afi == AFI_IP ? ZEBRA_IPV4_ROUTE_DELETE
+                               : ZEBRA_IPV6_ROUTE_DELETE,
+                               client, &hn->p, &dummy);
+      }
+
+  if (rn)
+    route_unlock_node (rn);
 }
 
+/* The client's backlog drained: send the routes held back, until done
+ * or the backlog is past the high watermark again. */
 void
-redistribute_add (struct prefix *p, struct rib *rib, struct rib *rib_old)
+zebra_redistribute_release (struct zserv *client)
 {
   struct listnode *node, *nnode;
-  struct zserv *client;
+  struct redist_held *held;
+  struct route_node *rn;
+  afi_t afi;
 
-  for (ALL_LIST_ELEMENTS (zebrad.client_list, node, nnode, client))
+  client->redist_hold = 0;
+  if (! client->redist_held)
+    return;
+
+  for (ALL_LIST_ELEMENTS (client->redist_held, node, nnode, held))
     {
-      if ((is_default (p) &&
-           vrf_bitmap_check (client->redist_default, rib->vrf_id))
-          || vrf_bitmap_check (client->redist[rib->type], rib->vrf_id))
+      for (afi = AFI_IP; afi < AFI_MAX; afi++)
         {
-          if (p->family == AF_INET)
-	    {
-	      client->redist_v4_add_cnt++;
-	      zsend_route_multipath (ZEBRA_IPV4_ROUTE_ADD, client, p, rib);
-	    }
-          if (p->family == AF_INET6)
-	    {
-	      client->redist_v6_add_cnt++;
-	      zsend_route_multipath (ZEBRA_IPV6_ROUTE_ADD, client, p, rib);
-	    }
+          if (! held->table[afi])
+            continue;
+          for (rn = route_top (held->table[afi]); rn; rn = route_next (rn))
+            {
+              if (! rn->info)
+                continue;
+              redistribute_held_send (client, rn, held->vrf_id, afi);
+              rn->info = NULL;
+              route_unlock_node (rn);
+              client->redist_held_cnt--;
+              if (client->redist_hold)
+                {
+                  route_unlock_node (rn);
+                  return;
+                }
+            }
+          route_table_finish (held->table[afi]);
+          held->table[afi] = NULL;
         }
-      else if (rib_old && vrf_bitmap_check (client->redist[rib_old->type],
-                                            rib_old->vrf_id))
+      list_delete_node (client->redist_held, node);
+      XFREE (MTYPE_ZEBRA_REDIST_HELD, held);
+    }
+}
+
+void
+zebra_redistribute_held_free (struct zserv *client)
+{
+  struct listnode *node, *nnode;
+  struct redist_held *held;
+  struct route_node *rn;
+  afi_t afi;
+
+  if (! client->redist_held)
+    return;
+
+  for (ALL_LIST_ELEMENTS (client->redist_held, node, nnode, held))
+    {
+      for (afi = AFI_IP; afi < AFI_MAX; afi++)
         {
-          /* redistribute_add has implicit withdraw semantics, so there
-           * may be an old route already redistributed that is being updated.
-           *
-           * However, if the new route is of a type that is /not/ redistributed
-           * to the client, then we must ensure the old route is explicitly
-           * withdrawn.
-           */
-          if (p->family == AF_INET)
-            zsend_route_multipath (ZEBRA_IPV4_ROUTE_DELETE, client, p, rib_old);
-          if (p->family == AF_INET6)
-            zsend_route_multipath (ZEBRA_IPV6_ROUTE_DELETE, client, p, rib_old);
+          if (! held->table[afi])
+            continue;
+          for (rn = route_top (held->table[afi]); rn; rn = route_next (rn))
+            if (rn->info)
+              {
+                rn->info = NULL;
+                route_unlock_node (rn);
+              }
+          route_table_finish (held->table[afi]);
         }
+      XFREE (MTYPE_ZEBRA_REDIST_HELD, held);
     }
+  list_free (client->redist_held);
+  client->redist_held = NULL;
+  client->redist_held_cnt = 0;
 }
 
+/* The clients each route type is redistributed to in a VRF, and those
+ * the default route is (type ZEBRA_ROUTE_MAX), kept along with their
+ * bitmaps so that a change reaches these without going over every
+ * client. */
+struct redist_subs
+{
+  int type;
+  vrf_id_t vrf_id;
+  struct list *clients;
+};
+
+static struct hash *redist_subs_hash;
+
+/* A route redistributed is encoded once, here, for all its clients */
+static struct stream *redist_stream;
+
+static unsigned int
+redist_subs_key (void *arg)
+{
+  struct redist_subs *subs = arg;
+
+  return jhash_2words (subs->type, subs->vrf_id, 0);
+}
+
+static int
+redist_subs_cmp (const void *a, const void *b)
+{
+  const struct redist_subs *sa = a, *sb = b;
+
+  return sa->type == sb->type && sa->vrf_id == sb->vrf_id;
+}
+
+static void *
+redist_subs_alloc (void *arg)
+{
+  struct redist_subs *key = arg, *subs;
+
+  subs = XCALLOC (MTYPE_ZEBRA_REDIST_SUBS, sizeof (struct redist_subs));
+  subs->type = key->type;
+  subs->vrf_id = key->vrf_id;
+  subs->clients = list_new ();
+  return subs;
+}
+
+static struct list *
+redist_subscribers (int type, vrf_id_t vrf_id)
+{
+  struct redist_subs key, *subs;
+
+  if (! redist_subs_hash)
+    return NULL;
+  key.type = type;
+  key.vrf_id = vrf_id;
+  subs = hash_lookup (redist_subs_hash, &key);
+  return subs ? subs->clients : NULL;
+}
+
+static vrf_bitmap_t
+redist_bitmap (struct zserv *client, int type)
+{
+  return type == ZEBRA_ROUTE_MAX ? client->redist_default
+                                 : client->redist[type];
+}
+
+/* Set the client's flag, returns 0 if it was already */
+static int
+redist_subscribe (struct zserv *client, int type, vrf_id_t vrf_id)
+{
+  struct redist_subs key, *subs;
+
+  if (vrf_bitmap_check (redist_bitmap (client, type), vrf_id))
+    return 0;
+  vrf_bitmap_set (redist_bitmap (client, type), vrf_id);
+
+  if (! redist_subs_hash)
+    redist_subs_hash = hash_create (redist_subs_key, redist_subs_cmp);
+  key.type = type;
+  key.vrf_id = vrf_id;
+  subs = hash_get (redist_subs_hash, &key, redist_subs_alloc);
+  listnode_add (subs->clients, client);
+  return 1;
+}
+
+static void
+redist_subs_free (struct redist_subs *subs)
+{
+  hash_release (redist_subs_hash, subs);
+  list_free (subs->clients);
+  XFREE (MTYPE_ZEBRA_REDIST_SUBS, subs);
+}
+
+static void
+redist_unsubscribe (struct zserv *client, int type, vrf_id_t vrf_id)
+{
+  struct redist_subs key, *subs;
+
+  if (! vrf_bitmap_check (redist_bitmap (client, type), vrf_id))
+    return;
+  vrf_bitmap_unset (redist_bitmap (client, type), vrf_id);
+
+  key.type = type;
+  key.vrf_id = vrf_id;
+  subs = hash_lookup (redist_subs_hash, &key);
+  if (! subs)
+    return;
+  listnode_delete (subs->clients, client);
+  if (! listcount (subs->clients))
+    redist_subs_free (subs);
+}
+
+/* The client unregistered the VRF */
 void
-redistribute_delete (struct prefix *p, struct rib *rib)
+zebra_redistribute_vrf_unset (struct zserv *client, vrf_id_t vrf_id)
+{
+  int type;
+
+  for (type = 0; type <= ZEBRA_ROUTE_MAX; type++)
+    redist_unsubscribe (client, type, vrf_id);
+}
+
+static void
+redist_subs_client_close (struct hash_backet *hb, void *arg)
+{
+  struct redist_subs *subs = hb->data;
+
+  listnode_delete (subs->clients, arg);
+  if (! listcount (subs->clients))
+    redist_subs_free (subs);
+}
+
+/* The client is gone */
+void
+zebra_redistribute_client_close (struct zserv *client)
+{
+  if (redist_subs_hash)
+    hash_iterate (redist_subs_hash, redist_subs_client_close, client);
+}
+
+static int
+redistribute_wants (struct zserv *client, struct prefix *p, struct rib *rib)
+{
+  return vrf_bitmap_check (client->redist[rib->type], rib->vrf_id)
+         || (is_default (p)
+             && vrf_bitmap_check (client->redist_default, rib->vrf_id));
+}
+
+/* Send the route to a client it's redistributed to, or note it if the
+ * client is held back.  The message is encoded for the first client
+ * there is to send it to, and queued as it is for the others. */
+static void
+redistribute_client (struct zserv *client, int cmd, struct prefix *p,
+                     struct rib *rib, int *encoded)
+{
+  if (client->redist_hold)
+    {
+      redistribute_hold (client, p, rib->vrf_id, rib->type);
+      return;
+    }
+
+  if (cmd == ZEBRA_IPV4_ROUTE_ADD)
+    client->redist_v4_add_cnt++;
+  else if (cmd == ZEBRA_IPV6_ROUTE_ADD)
+    client->redist_v6_add_cnt++;
+
+  if (! *encoded)
+    {
+      if (! redist_stream)
+        redist_stream = stream_new (ZEBRA_MAX_PACKET_SIZ);
+      zserv_encode_route (redist_stream, cmd, p, rib);
+      *encoded = 1;
+    }
+  zebra_server_send_stream (client, redist_stream);
+}
+
+/* Send the route to the clients it's redistributed to, but those that
+ * want 'except' instead. */
+static void
+redistribute_fanout (int cmd, struct prefix *p, struct rib *rib,
+                     struct rib *except)
 {
   struct listnode *node, *nnode;
   struct zserv *client;
+  struct list *clients;
+  int encoded = 0;
+
+  clients = redist_subscribers (rib->type, rib->vrf_id);
+  if (clients)
+    for (ALL_LIST_ELEMENTS (clients, node, nnode, client))
+      if (! except || ! redistribute_wants (client, p, except))
+        redistribute_client (client, cmd, p, rib, &encoded);
+
+  /* The clients that already had it for its type are skipped here */
+  if (is_default (p) && ! except
+      && (clients = redist_subscribers (ZEBRA_ROUTE_MAX, rib->vrf_id)))
+    for (ALL_LIST_ELEMENTS (clients, node, nnode, client))
+      if (! vrf_bitmap_check (client->redist[rib->type], rib->vrf_id))
+        redistribute_client (client, cmd, p, rib, &encoded);
+}
 
+void
+redistribute_add (struct prefix *p, struct rib *rib, struct rib *rib_old)
+{
+  if (p->family == AF_INET)
+    {
+      redistribute_fanout (ZEBRA_IPV4_ROUTE_ADD, p, rib, NULL);
+      /* redistribute_add has implicit withdraw semantics, so there
+       * may be an old route already redistributed that is being updated.
+       *
+       * However, if the new route is of a type that is /not/ redistributed
+       * to the client, then we must ensure the old route is explicitly
+       * withdrawn.
+       */
+      if (rib_old)
+        redistribute_fanout (ZEBRA_IPV4_ROUTE_DELETE, p, rib_old, rib);
+    }
+#ifdef HAVE_IPV6
+  else if (p->family == AF_INET6)
+    {
+      redistribute_fanout (ZEBRA_IPV6_ROUTE_ADD, p, rib, NULL);
+      if (rib_old)
+        redistribute_fanout (ZEBRA_IPV6_ROUTE_DELETE, p, rib_old, rib);
+    }
+#endif /* HAVE_IPV6 */
+}
+
+void
+redistribute_delete (struct prefix *p, struct rib *rib)
+{
   /* Add DISTANCE_INFINITY check. */
   if (rib->distance == DISTANCE_INFINITY)
     return;
 
-  for (ALL_LIST_ELEMENTS (zebrad.client_list, node, nnode, client))
-    {
-      if ((is_default (p) &&
-           vrf_bitmap_check (client->redist_default, rib->vrf_id))
-          || vrf_bitmap_check (client->redist[rib->type], rib->vrf_id))
-	{
-	  if (p->family == AF_INET)
-	    zsend_route_multipath (ZEBRA_IPV4_ROUTE_DELETE, client, p, rib);
+  if (p->family == AF_INET)
+    redistribute_fanout (ZEBRA_IPV4_ROUTE_DELETE, p, rib, NULL);
 #ifdef HAVE_IPV6
-	  if (p->family == AF_INET6)
-	    zsend_route_multipath (ZEBRA_IPV6_ROUTE_DELETE, client, p, rib);
+  else if (p->family == AF_INET6)
+    redistribute_fanout (ZEBRA_IPV6_ROUTE_DELETE, p, rib, NULL);
 #endif /* HAVE_IPV6 */
-	}
-    }
 }
 
 void
@@ -260,11 +618,8 @@ zebra_redistribute_add (int command, struct zserv *client, int length,
   if (type == 0 || type >= ZEBRA_ROUTE_MAX)
     return;
 
-  if (! vrf_bitmap_check (client->redist[type], vrf_id))
-    {
-      vrf_bitmap_set (client->redist[type], vrf_id);
-      zebra_redistribute (client, type, vrf_id);
-    }
+  if (redist_subscribe (client, type, vrf_id))
+    zebra_redistribute (client, type, vrf_id);
 }
 
 void
@@ -278,14 +633,14 @@ zebra_redistribute_delete (int command, struct zserv *client, int length,
   if (type == 0 || type >= ZEBRA_ROUTE_MAX)
     return;
 
-  vrf_bitmap_unset (client->redist[type], vrf_id);
+  redist_unsubscribe (client, type, vrf_id);
 }
 
 void
 zebra_redistribute_default_add (int command, struct zserv *client, int length,
     vrf_id_t vrf_id)
 {
-  vrf_bitmap_set (client->redist_default, vrf_id);
+  redist_subscribe (client, ZEBRA_ROUTE_MAX, vrf_id);
   zebra_redistribute_default (client, vrf_id);
 }
 
@@ -293,41 +648,289 @@ void
 zebra_redistribute_default_delete (int command, struct zserv *client,
     int length, vrf_id_t vrf_id)
 {
-  vrf_bitmap_unset (client->redist_default, vrf_id);
+  redist_unsubscribe (client, ZEBRA_ROUTE_MAX, vrf_id);
 }
 
-/* Interface up information. */
-void
-zebra_interface_up_update (struct interface *ifp)
+/* Interface up/down and address notifications are held back for a
+ * moment, while a burst of link changes comes in, and then sent
+ * together, each client corked so that the lot goes out in as few
+ * writes as it takes.  An interface is sent the state it was last left
+ * in, and each of its addresses the last thing that happened to it:
+ * deletions first, then the state, then additions, which is the order
+ * a flap would have given them.  An address added and deleted again in
+ * the meantime isn't sent at all.  Anything else about an interface
+ * first sends what's pending for it. */
+#define ZEBRA_IF_NOTIFY_DELAY_MSEC 10
+
+struct if_notify_addr
+{
+  /* The last that happened, ZEBRA_INTERFACE_ADDRESS_ADD or _DELETE */
+  int cmd;
+
+  /* Clients had the address before, so it is deleted first */
+  int deleted;
+
+  /* A copy of the address as it was then */
+  struct connected *ifc;
+};
+
+static struct list *if_notify_list;
+static struct thread *t_if_notify;
+
+static void
+zebra_interface_state_send (struct interface *ifp, int cmd)
 {
   struct listnode *node, *nnode;
   struct zserv *client;
 
   if (IS_ZEBRA_DEBUG_EVENT)
-    zlog_debug ("MESSAGE: ZEBRA_INTERFACE_UP %s", ifp->name);
+    zlog_debug ("MESSAGE: %s %s", zserv_command_string (cmd), ifp->name);
+
+  for (ALL_LIST_ELEMENTS (zebrad.client_list, node, nnode, client))
+    {
+      if (cmd == ZEBRA_INTERFACE_UP)
+        {
+          if (! client->ifinfo)
+            continue;
+          zsend_interface_update (ZEBRA_INTERFACE_UP, client, ifp);
+          zsend_interface_link_params (client, ifp);
+        }
+      else
+        zsend_interface_update (ZEBRA_INTERFACE_DOWN, client, ifp);
+    }
+}
+
+static void
+zebra_interface_address_send (struct interface *ifp, int cmd,
+                              struct connected *ifc)
+{
+  struct listnode *node, *nnode;
+  struct zserv *client;
+
+  if (IS_ZEBRA_DEBUG_EVENT)
+    {
+      char buf[PREFIX_STRLEN];
+
+      zlog_debug ("MESSAGE: %s %s on %s", zserv_command_string (cmd),
+		  prefix2str (ifc->address, buf, sizeof(buf)), ifp->name);
+    }
 
   for (ALL_LIST_ELEMENTS (zebrad.client_list, node, nnode, client))
     if (client->ifinfo)
       {
-        zsend_interface_update (ZEBRA_INTERFACE_UP, client, ifp);
-        zsend_interface_link_params (client, ifp);
+	if (cmd == ZEBRA_INTERFACE_ADDRESS_ADD)
+	  client->connected_rt_add_cnt++;
+	else
+	  client->connected_rt_del_cnt++;
+	zsend_interface_address (cmd, client, ifp, ifc);
       }
 }
 
-/* Interface down information. */
-void
-zebra_interface_down_update (struct interface *ifp)
+static struct connected *
+if_notify_addr_copy (struct connected *ifc)
+{
+  struct connected *copy;
+
+  copy = connected_new ();
+  copy->ifp = ifc->ifp;
+  copy->conf = ifc->conf;
+  copy->flags = ifc->flags;
+  copy->address = prefix_new ();
+  prefix_copy (copy->address, ifc->address);
+  if (ifc->destination)
+    {
+      copy->destination = prefix_new ();
+      prefix_copy (copy->destination, ifc->destination);
+    }
+  return copy;
+}
+
+static void
+if_notify_addr_free (struct if_notify_addr *na)
+{
+  connected_free (na->ifc);
+  XFREE (MTYPE_ZEBRA_IF_NOTIFY, na);
+}
+
+/* Send what's held back for the interface, if anything. */
+static void
+zebra_interface_notify_flush (struct interface *ifp)
+{
+  struct zebra_if *zif = ifp->info;
+  struct if_notify_addr *na;
+  struct listnode *node;
+  struct list *addrs;
+  int cmd;
+
+  if (! zif || (! zif->notify_cmd && ! zif->notify_addrs))
+    return;
+
+  cmd = zif->notify_cmd;
+  addrs = zif->notify_addrs;
+  zif->notify_cmd = 0;
+  zif->notify_addrs = NULL;
+
+  if (addrs)
+    for (ALL_LIST_ELEMENTS_RO (addrs, node, na))
+      if (na->deleted)
+        zebra_interface_address_send (ifp, ZEBRA_INTERFACE_ADDRESS_DELETE,
+                                      na->ifc);
+  if (cmd)
+    zebra_interface_state_send (ifp, cmd);
+  if (addrs)
+    {
+      for (ALL_LIST_ELEMENTS_RO (addrs, node, na))
+        if (na->cmd == ZEBRA_INTERFACE_ADDRESS_ADD)
+          zebra_interface_address_send (ifp, ZEBRA_INTERFACE_ADDRESS_ADD,
+                                        na->ifc);
+      list_delete (addrs);
+    }
+}
+
+static int
+zebra_interface_notify_timer (struct thread *thread)
 {
   struct listnode *node, *nnode;
   struct zserv *client;
+  struct interface *ifp;
+  struct zebra_if *zif;
 
-  if (IS_ZEBRA_DEBUG_EVENT)
-    zlog_debug ("MESSAGE: ZEBRA_INTERFACE_DOWN %s", ifp->name);
+  t_if_notify = NULL;
 
   for (ALL_LIST_ELEMENTS (zebrad.client_list, node, nnode, client))
+    if (! client->corked)
+      {
+        zserv_cork (client);
+        client->notify_corked = 1;
+      }
+
+  while ((ifp = listnode_head (if_notify_list)) != NULL)
+    {
+      list_delete_node (if_notify_list, listhead (if_notify_list));
+      zif = ifp->info;
+      zif->notify_queued = 0;
+      zebra_interface_notify_flush (ifp);
+    }
+
+  for (ALL_LIST_ELEMENTS (zebrad.client_list, node, nnode, client))
+    if (client->notify_corked)
+      {
+        client->notify_corked = 0;
+        zserv_uncork (client);
+      }
+  return 0;
+}
+
+static void
+zebra_interface_notify_queue (struct interface *ifp)
+{
+  struct zebra_if *zif = ifp->info;
+
+  if (! zif->notify_queued)
+    {
+      if (! if_notify_list)
+        if_notify_list = list_new ();
+      listnode_add (if_notify_list, ifp);
+      zif->notify_queued = 1;
+    }
+  if (! t_if_notify)
+    t_if_notify = thread_add_timer_msec (zebrad.master,
+                                         zebra_interface_notify_timer, NULL,
+                                         ZEBRA_IF_NOTIFY_DELAY_MSEC);
+}
+
+static void
+zebra_interface_notify_state (struct interface *ifp, int cmd)
+{
+  struct zebra_if *zif = ifp->info;
+
+  if (! zif)
+    {
+      zebra_interface_state_send (ifp, cmd);
+      return;
+    }
+
+  /* The last one wins: the message carries the interface as it is */
+  zif->notify_cmd = cmd;
+  zebra_interface_notify_queue (ifp);
+}
+
+static void
+zebra_interface_notify_address (struct interface *ifp, int cmd,
+                                struct connected *ifc)
+{
+  struct zebra_if *zif = ifp->info;
+  struct if_notify_addr *na;
+  struct listnode *node;
+
+  if (! zif)
     {
-      zsend_interface_update (ZEBRA_INTERFACE_DOWN, client, ifp);
+      zebra_interface_address_send (ifp, cmd, ifc);
+      return;
     }
+
+  if (! zif->notify_addrs)
+    {
+      zif->notify_addrs = list_new ();
+      zif->notify_addrs->del = (void (*) (void *)) if_notify_addr_free;
+    }
+
+  for (ALL_LIST_ELEMENTS_RO (zif->notify_addrs, node, na))
+    if (prefix_same (na->ifc->address, ifc->address))
+      break;
+
+  if (! node)
+    {
+      na = XCALLOC (MTYPE_ZEBRA_IF_NOTIFY, sizeof (struct if_notify_addr));
+      na->cmd = cmd;
+      na->deleted = (cmd == ZEBRA_INTERFACE_ADDRESS_DELETE);
+      na->ifc = if_notify_addr_copy (ifc);
+      listnode_add (zif->notify_addrs, na);
+    }
+  else if (! na->deleted && cmd == ZEBRA_INTERFACE_ADDRESS_DELETE)
+    {
+      /* Come and gone: clients needn't hear of it */
+      list_delete_node (zif->notify_addrs, node);
+      if_notify_addr_free (na);
+    }
+  else
+    {
+      na->cmd = cmd;
+      connected_free (na->ifc);
+      na->ifc = if_notify_addr_copy (ifc);
+    }
+  zebra_interface_notify_queue (ifp);
+}
+
+/* The interface is going away: forget what's held back for it. */
+void
+zebra_interface_notify_cancel (struct interface *ifp)
+{
+  struct zebra_if *zif = ifp->info;
+
+  if (! zif)
+    return;
+  if (zif->notify_queued)
+    listnode_delete (if_notify_list, ifp);
+  if (zif->notify_addrs)
+    list_delete (zif->notify_addrs);
+  zif->notify_queued = 0;
+  zif->notify_cmd = 0;
+  zif->notify_addrs = NULL;
+}
+
+/* Interface up information. */
+void
+zebra_interface_up_update (struct interface *ifp)
+{
+  zebra_interface_notify_state (ifp, ZEBRA_INTERFACE_UP);
+}
+
+/* Interface down information. */
+void
+zebra_interface_down_update (struct interface *ifp)
+{
+  zebra_interface_notify_state (ifp, ZEBRA_INTERFACE_DOWN);
 }
 
 /* Interface information update. */
@@ -337,6 +940,8 @@ zebra_interface_add_update (struct interface *ifp)
   struct listnode *node, *nnode;
   struct zserv *client;
 
+  zebra_interface_notify_flush (ifp);
+
   if (IS_ZEBRA_DEBUG_EVENT)
     zlog_debug ("MESSAGE: ZEBRA_INTERFACE_ADD %s", ifp->name);
 
@@ -355,6 +960,8 @@ zebra_interface_delete_update (struct interface *ifp)
   struct listnode *node, *nnode;
   struct zserv *client;
 
+  zebra_interface_notify_flush (ifp);
+
   if (IS_ZEBRA_DEBUG_EVENT)
     zlog_debug ("MESSAGE: ZEBRA_INTERFACE_DELETE %s", ifp->name);
 
@@ -371,31 +978,13 @@ void
 zebra_interface_address_add_update (struct interface *ifp,
 				    struct connected *ifc)
 {
-  struct listnode *node, *nnode;
-  struct zserv *client;
-  struct prefix *p;
-
-  if (IS_ZEBRA_DEBUG_EVENT)
-    {
-      char buf[PREFIX_STRLEN];
-
-      p = ifc->address;
-      zlog_debug ("MESSAGE: ZEBRA_INTERFACE_ADDRESS_ADD %s on %s",
-		  prefix2str (p, buf, sizeof(buf)),
-		  ifc->ifp->name);
-    }
-
   if (!CHECK_FLAG(ifc->conf, ZEBRA_IFC_REAL))
     zlog_warn("WARNING: advertising address to clients that is not yet usable.");
 
   router_id_add_address(ifc);
 
-  for (ALL_LIST_ELEMENTS (zebrad.client_list, node, nnode, client))
-    if (client->ifinfo && CHECK_FLAG (ifc->conf, ZEBRA_IFC_REAL))
-      {
-	client->connected_rt_add_cnt++;
-	zsend_interface_address (ZEBRA_INTERFACE_ADDRESS_ADD, client, ifp, ifc);
-      }
+  if (CHECK_FLAG (ifc->conf, ZEBRA_IFC_REAL))
+    zebra_interface_notify_address (ifp, ZEBRA_INTERFACE_ADDRESS_ADD, ifc);
 }
 
 /* Interface address deletion. */
@@ -403,28 +992,10 @@ void
 zebra_interface_address_delete_update (struct interface *ifp,
 				       struct connected *ifc)
 {
-  struct listnode *node, *nnode;
-  struct zserv *client;
-  struct prefix *p;
-
-  if (IS_ZEBRA_DEBUG_EVENT)
-    {
-      char buf[PREFIX_STRLEN];
-
-      p = ifc->address;
-      zlog_debug ("MESSAGE: ZEBRA_INTERFACE_ADDRESS_DELETE %s on %s",
-		  prefix2str (p, buf, sizeof(buf)),
-		  ifc->ifp->name);
-    }
-
   router_id_del_address(ifc);
 
-  for (ALL_LIST_ELEMENTS (zebrad.client_list, node, nnode, client))
-    if (client->ifinfo && CHECK_FLAG (ifc->conf, ZEBRA_IFC_REAL))
-      {
-	client->connected_rt_del_cnt++;
-	zsend_interface_address (ZEBRA_INTERFACE_ADDRESS_DELETE, client, ifp, ifc);
-      }
+  if (CHECK_FLAG (ifc->conf, ZEBRA_IFC_REAL))
+    zebra_interface_notify_address (ifp, ZEBRA_INTERFACE_ADDRESS_DELETE, ifc);
 }
 
 /* Interface parameters update */
@@ -434,6 +1005,8 @@ zebra_interface_parameters_update (struct interface *ifp)
   struct listnode *node, *nnode;
   struct zserv *client;
 
+  zebra_interface_notify_flush (ifp);
+
   if (IS_ZEBRA_DEBUG_EVENT)
     zlog_debug ("MESSAGE: ZEBRA_INTERFACE_LINK_PARAMS %s", ifp->name);
 
@@ -36,8 +36,14 @@ extern void zebra_redistribute_default_delete(int, struct zserv *, int, vrf_id_t
 extern void redistribute_add(struct prefix *, struct rib *new, struct rib *old);
 extern void redistribute_delete(struct prefix *, struct rib *);
 
+extern void zebra_redistribute_release(struct zserv *);
+extern void zebra_redistribute_held_free(struct zserv *);
+extern void zebra_redistribute_vrf_unset(struct zserv *, vrf_id_t);
+extern void zebra_redistribute_client_close(struct zserv *);
+
 extern void zebra_interface_up_update(struct interface *);
 extern void zebra_interface_down_update(struct interface *);
+extern void zebra_interface_notify_cancel(struct interface *);
 
 extern void zebra_interface_add_update(struct interface *);
 extern void zebra_interface_delete_update(struct interface *);
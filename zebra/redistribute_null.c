@@ -86,6 +86,10 @@ void zebra_interface_address_delete_update(struct interface *a, struct connected
 }
 #endif
 
+void zebra_interface_notify_cancel(struct interface *a) {
+	return;
+}
+
 /* Interface parameters update */
 void zebra_interface_parameters_update(struct interface *ifp) {
 	return;
@@ -24,11 +24,13 @@
 #ifndef _ZEBRA_RIB_H
 #define _ZEBRA_RIB_H
 
+#include "if.h"
 #include "linklist.h"
 #include "nexthop.h"
 #include "prefix.h"
 #include "queue.h"
 #include "table.h"
+#include "vty.h"
 #include "zebra.h"
 
 #define DISTANCE_INFINITY 255
@@ -41,6 +43,10 @@ struct rib {
 	/* Nexthop structure */
 	struct nexthop *nexthop;
 
+	/* Nexthop group the nexthops are copied from, if any */
+	struct zebra_nhg *nhg;
+	struct listnode *nhg_node;
+
 	/* Refrence count. */
 	unsigned long refcnt;
 
@@ -80,11 +86,18 @@ struct rib {
 #define RIB_ENTRY_REMOVED (1 << 0)
 #define RIB_ENTRY_CHANGED (1 << 1)
 #define RIB_ENTRY_SELECTED_FIB (1 << 2)
+#define RIB_ENTRY_QUEUED (1 << 3) /* with the dataplane, see nl_batch */
+#define RIB_ENTRY_STALE (1 << 4)  /* left by a previous zebra or client, see rib_sweep_start */
 
 	/* Nexthop information. */
 	u_char nexthop_num;
 	u_char nexthop_active_num;
 	u_char nexthop_fib_num;
+
+	/* rib_nexthop_epoch as of which nexthop_active_num holds, and the
+	 * nexthops are resolved in full: 0 until they are first looked at */
+	u_int32_t active_epoch;
+	u_int32_t resolved_epoch;
 };
 
 /* meta-queue structure:
@@ -96,8 +109,32 @@ struct rib {
  */
 #define MQ_SIZE 5
 
+struct meta_queue_entry {
+	struct route_node *rn;
+	u_int32_t queued; /* msec, monotonic */
+};
+
+/* A sub-queue is a ring of route_nodes, doubled when full: nothing is
+ * allocated per route_node queued. */
+struct meta_subq {
+	struct meta_queue_entry *ring;
+	u_int32_t cap; /* a power of 2 */
+	u_int32_t head;
+	u_int32_t count;
+
+	/* stats */
+	u_int32_t max_count;
+	u_int64_t enqueued;
+	u_int64_t dequeued;
+	u_int32_t rate; /* enqueued in the last whole second */
+	u_int32_t rate_count;
+	time_t rate_sec;
+	u_int64_t wait_total; /* msec in queue, of those dequeued */
+	u_int32_t wait_max;
+};
+
 struct meta_queue {
-	struct list *subq[MQ_SIZE];
+	struct meta_subq subq[MQ_SIZE];
 	u_int32_t size; /* sum of lengths of all subqueues */
 };
 
@@ -122,31 +159,30 @@ typedef struct rib_dest_t_ {
 	u_int32_t flags;
 
 	/*
-   * Linkage to put dest on the FPM processing queue.
+   * FPM servers, a bit each, the dest is queued to be sent to, and
+   * that it was 'advertised' to, to be installed in the forwarding
+   * plane.
+   */
+	u_char fpm_update;
+	u_char fpm_sent;
+
+	/*
+   * Version of the last change of selected route, and the dest's place
+   * on its table's list of changed dests.
    */
-	TAILQ_ENTRY(rib_dest_t_) fpm_q_entries;
+	u_int64_t version;
+	struct rib_dest_t_ *vprev, *vnext;
 
 } rib_dest_t;
 
 #define RIB_ROUTE_QUEUED(x) (1 << (x))
+#define RIB_DEST_CHANGED (1 << 16)
 
 /*
  * The maximum qindex that can be used.
  */
 #define ZEBRA_MAX_QINDEX (MQ_SIZE - 1)
 
-/*
- * This flag indicates that a given prefix has been 'advertised' to
- * the FPM to be installed in the forwarding plane.
- */
-#define RIB_DEST_SENT_TO_FPM (1 << (ZEBRA_MAX_QINDEX + 1))
-
-/*
- * This flag is set when we need to send an update to the FPM about a
- * dest.
- */
-#define RIB_DEST_UPDATE_FPM (1 << (ZEBRA_MAX_QINDEX + 2))
-
 /*
  * Macro to iterate over each route for a destination (prefix).
  */
@@ -253,10 +289,12 @@ struct rtadv {
 	int sock;
 
 	int adv_if_count;
-	int adv_msec_if_count;
 
 	struct thread *ra_read;
-	struct thread *ra_timer;
+
+	/* Interfaces with an advertisement due, sent together */
+	struct list *send_q;
+	struct thread *ra_send;
 };
 #endif /* HAVE_RTADV */
 
@@ -270,6 +308,43 @@ struct nlsock {
 };
 #endif
 
+/* RIB and FIB audit: a pass compares a dump of the kernel's routes, then
+ * the RIB, against the other, in slices, see rib_audit_start.  The
+ * mismatches of a pass are repaired if the pass after finds them again. */
+#define RIB_AUDIT_KERNEL_STALE 0   /* a zebra route the RIB has no longer */
+#define RIB_AUDIT_KERNEL_DIFF 1	   /* other nexthops than the RIB's */
+#define RIB_AUDIT_KERNEL_MISSING 2 /* a RIB route missing from the kernel */
+#define RIB_AUDIT_RIB_MISSING 3	   /* a kernel route the RIB missed */
+#define RIB_AUDIT_RIB_STALE 4	   /* a kernel route gone from the kernel */
+#define RIB_AUDIT_MAX 5
+
+struct rib_audit {
+	u_char enabled;
+	u_char state;
+#define RIB_AUDIT_S_IDLE 0
+#define RIB_AUDIT_S_DUMP 1
+#define RIB_AUDIT_S_WALK 2
+	u_char again;	/* start over once done, overrun meanwhile */
+	u_char intr;	/* the kernel's dump was inconsistent */
+	afi_t afi;
+	struct thread *t_audit;
+	struct route_node *walk;
+	time_t start;
+
+	/* Prefixes of the dump, by origin; mismatches of this pass and of
+	 * the one before */
+	struct route_table *seen[AFI_MAX];
+	struct route_table *found[AFI_MAX];
+	struct route_table *suspect[AFI_MAX];
+
+	unsigned long passes;
+	unsigned long overruns;
+	unsigned long mismatches[RIB_AUDIT_MAX];
+	unsigned long repaired[RIB_AUDIT_MAX];
+	time_t last;
+	time_t last_duration;
+};
+
 /* Routing table instance.  */
 struct zebra_vrf {
 	/* Identifier. */
@@ -293,6 +368,8 @@ struct zebra_vrf {
 #ifdef HAVE_NETLINK
 	struct nlsock netlink;	   /* kernel messages */
 	struct nlsock netlink_cmd; /* command channel */
+	struct nlsock netlink_dplane; /* route changes, see nl_batch */
+	struct nlsock netlink_audit;  /* dumps, see rib_audit_start */
 	struct thread *t_netlink;
 #endif
 
@@ -311,6 +388,17 @@ struct zebra_vrf {
 
 	/* Recursive Nexthop table */
 	struct route_table *rnh_table[AFI_MAX];
+
+	/* Where gateways resolve, see rib_resolve */
+	struct route_table *resolve_table[AFI_MAX];
+
+	/* Routes whose nexthops look at interfaces, see rib_ifdep */
+	struct hash *ifdeps;
+
+	/* Pending walk of this VRF's tables, see rib_update */
+	struct thread *t_rib_update;
+
+	struct rib_audit audit;
 };
 
 /*
@@ -327,8 +415,36 @@ typedef struct rib_table_info_t_ {
 	afi_t afi;
 	safi_t safi;
 
+	/*
+   * Each dest whose selected route changes takes the next version and
+   * goes to the end of 'changed'. The last RIB_TABLE_WITHDRAWN_MAX
+   * prefixes left with none are kept in a ring, as their dests go;
+   * 'forgotten' is the version of the last one let go of.
+   */
+	u_int64_t version;
+	u_int64_t forgotten;
+	rib_dest_t *changed_head, *changed_tail;
+	struct rib_withdrawn *withdrawn;
+	unsigned int withdrawn_start, withdrawn_count;
+
 } rib_table_info_t;
 
+#define RIB_TABLE_WITHDRAWN_MAX 16384
+
+struct rib_withdrawn {
+	struct prefix p;
+	u_int64_t version;
+};
+
+/*
+ * Walk of the changes of a table since a version, in version order.
+ */
+typedef struct rib_table_changes_t_ {
+	rib_table_info_t *info;
+	rib_dest_t *changed;
+	unsigned int withdrawn;
+} rib_table_changes_t;
+
 typedef enum {
 	RIB_TABLES_ITER_S_INIT,
 	RIB_TABLES_ITER_S_ITERATING,
@@ -387,6 +503,8 @@ extern struct zebra_vrf *zebra_vrf_lookup(vrf_id_t vrf_id);
 extern struct zebra_vrf *zebra_vrf_alloc(vrf_id_t);
 extern struct route_table *zebra_vrf_table(afi_t, safi_t, vrf_id_t);
 extern struct route_table *zebra_vrf_static_table(afi_t, safi_t, vrf_id_t);
+extern struct route_table *zebra_vrf_table_get(afi_t, safi_t, vrf_id_t);
+extern struct route_table *zebra_vrf_static_table_get(struct zebra_vrf *, afi_t, safi_t);
 
 /* NOTE:
  * All rib_add_ipv[46]* functions will not just add prefix into RIB, but
@@ -403,11 +521,34 @@ extern struct rib *rib_match_ipv4_multicast(struct in_addr addr, struct route_no
 extern struct rib *rib_lookup_ipv4(struct prefix_ipv4 *, vrf_id_t);
 
 extern void rib_update(vrf_id_t);
+extern void rib_update_interface(struct interface *);
+extern void rib_update_cancel(struct zebra_vrf *);
 extern void rib_weed_tables(void);
 extern void rib_sweep_route(void);
+extern void rib_sweep_start(u_int32_t);
+extern unsigned long rib_stale_proto(u_char, u_int32_t);
+extern unsigned long rib_sweep_proto(u_char);
+
+/* Seconds between audits, 0 for those after overruns only, and the
+ * routes an audit looks at a second */
+extern u_int32_t rib_audit_interval;
+extern u_int32_t rib_audit_rate;
+#define RIB_AUDIT_RATE_DEFAULT 10000
+extern void rib_audit_enable(struct zebra_vrf *);
+extern void rib_audit_disable(struct zebra_vrf *);
+extern void rib_audit_start(struct zebra_vrf *);
+extern void rib_audit_overrun(struct zebra_vrf *);
+extern void rib_audit_reschedule(void);
+/* What to do with a route of the kernel's dump, see rib_audit_kernel_route */
+#define RIB_AUDIT_KEEP 0
+#define RIB_AUDIT_DELETE 1
+#define RIB_AUDIT_IMPORT 2
+extern int rib_audit_kernel_route(struct zebra_vrf *, struct prefix *, struct rib *, u_int32_t);
+extern void rib_audit_show(struct vty *);
 extern void rib_close_table(struct route_table *);
 extern void rib_close(void);
 extern void rib_init(void);
+extern void rib_meta_queue_show(struct vty *);
 extern unsigned long rib_score_proto(u_char proto);
 
 extern int static_add_ipv4_safi(safi_t safi, struct prefix *p, struct in_addr *gate, const char *ifname, u_char flags, route_tag_t, u_char distance, vrf_id_t vrf_id);
@@ -430,6 +571,17 @@ extern int rib_add_ipv6_multipath(struct prefix_ipv6 *, struct rib *, safi_t);
 extern int static_delete_ipv6(struct prefix *p, u_char type, struct in6_addr *gate, const char *ifname, route_tag_t, u_char distance, vrf_id_t vrf_id);
 
 extern int rib_gc_dest(struct route_node *rn);
+
+/* 0 if the changes since 'version' are no longer all known */
+extern int rib_table_changes_init(rib_table_changes_t *, struct route_table *, u_int64_t version);
+/* 0 at the end, else *rn is the node whose selected route changed, or
+ * NULL with *withdrawn the prefix left without one */
+extern int rib_table_changes_next(rib_table_changes_t *, struct route_node **rn, const struct rib_withdrawn **withdrawn);
+extern void rib_nhg_refresh(struct route_node *rn, struct rib *rib, int in_kernel);
+/* A route nexthops may resolve over changed: resolutions kept by nexthop
+ * groups are out of date, and with rn, those of the gateways it covers */
+extern void rib_nexthop_epoch_bump(void);
+extern void rib_nexthop_changed(struct route_node *rn);
 extern struct route_table *rib_tables_iter_next(rib_tables_iter_t *iter);
 
 /*
@@ -29,8 +29,27 @@
 #include "zebra/rib.h"
 
 extern int kernel_route_rib(struct prefix *, struct rib *, struct rib *);
+/* Hand the kernel any route changes held back, and wait for it to act */
+extern void kernel_route_flush(void);
+/* Keep the privileges needed to talk to the kernel up, from hold to
+ * release, across a run of messages; the two nest */
+extern void kernel_privs_hold(void);
+extern void kernel_privs_release(void);
 extern int kernel_add_route(struct prefix_ipv4 *, struct in_addr *, int, int);
 extern int kernel_address_add_ipv4(struct interface *, struct connected *);
 extern int kernel_address_delete_ipv4(struct interface *, struct connected *);
 
+/* Add or replace the kernel nexthop object for a nexthop group, -1 where
+ * the kernel cannot have one for it. */
+extern int kernel_nhg_install(struct zebra_nhg *);
+extern void kernel_nhg_uninstall(struct zebra_nhg *);
+
+/* Dump the kernel's routes of a family, for an audit of the VRF's RIB;
+ * -1 where the kernel cannot be dumped.  Reading takes the routes of up
+ * to about budget messages to rib_audit_kernel_route, and returns 1 once
+ * the dump is over, 0 with more to come, -1 if it failed. */
+extern int kernel_audit_start(struct zebra_vrf *, afi_t);
+extern int kernel_audit_read(struct zebra_vrf *, int budget);
+extern void kernel_audit_stop(struct zebra_vrf *);
+
 #endif /* _ZEBRA_RT_H */
@@ -22,6 +22,9 @@
 
 #include <zebra.h>
 #include <net/if_arp.h>
+#ifdef RTM_NEWNEXTHOP
+#include <linux/nexthop.h>
+#endif
 
 /* Hack for GNU libc version 2. */
 #ifndef MSG_TRUNC
@@ -40,12 +43,16 @@
 #include "privs.h"
 #include "vrf.h"
 #include "nexthop.h"
+#include "trace.h"
+#include "workpool.h"
 
 #include "zebra/zserv.h"
 #include "zebra/rt.h"
 #include "zebra/redistribute.h"
 #include "zebra/interface.h"
 #include "zebra/debug.h"
+#include "zebra/zebra_nhg.h"
+#include "zebra/zebra_rnh.h"
 
 #include "rt_netlink.h"
 
@@ -68,6 +75,15 @@ extern struct zebra_privs_t zserv_privs;
 
 extern u_int32_t nl_rcvbufsize;
 
+extern int nl_batch;
+
+/* Receive buffer, shared by all netlink sockets: NL_RCV_SLOTS datagrams
+ * of up to size bytes each are taken at once.  32k is what the kernel
+ * fills dump datagrams up to, given room enough; the slots grow to fit
+ * anything larger, as peeked before. */
+#define NL_RCV_SLOTS 8
+#define NL_RCV_SLOT_SIZE 32768
+
 static struct {
 	char *p;
 	size_t size;
@@ -99,7 +115,7 @@ static void set_ifindex(struct interface *ifp, ifindex_t ifi_index) {
 			if_delete_update(oifp);
 		}
 	}
-	ifp->ifindex = ifi_index;
+	if_set_index(ifp, ifi_index);
 }
 
 #ifndef SO_RCVBUFFORCE
@@ -194,6 +210,53 @@ static int netlink_socket(struct nlsock *nl, unsigned long groups, vrf_id_t vrf_
 	return ret;
 }
 
+static void netlink_batch_sync(void);
+
+/* The kernel checks the sender's privileges on each message, not only the
+ * socket's, so they are up while talking to it.  Rather than raise and
+ * lower them around every message, a run of messages, such as a run of
+ * the RIB queue or the reads of a VRF's enabling, is put between
+ * kernel_privs_hold() and kernel_privs_release(), which raise them once
+ * and lower them again.  A message sent outside any run raises and lowers
+ * them around itself.  Whoever lowers them in the middle of a run is
+ * noticed through current_state(), which answers for the calling thread.
+ */
+static int nl_privs_held;
+
+void kernel_privs_hold(void) {
+	if(nl_privs_held++ == 0 && zserv_privs.change(ZPRIVS_RAISE)) {
+		zlog(NULL, LOG_ERR, "Can't raise privileges");
+	}
+}
+
+void kernel_privs_release(void) {
+	assert(nl_privs_held > 0);
+	if(--nl_privs_held == 0 && zserv_privs.change(ZPRIVS_LOWER)) {
+		zlog(NULL, LOG_ERR, "Can't lower privileges");
+	}
+}
+
+static int netlink_privs_raise(void) {
+	if(nl_privs_held && zserv_privs.current_state() == ZPRIVS_RAISED) {
+		return 0;
+	}
+	if(zserv_privs.change(ZPRIVS_RAISE)) {
+		zlog(NULL, LOG_ERR, "Can't raise privileges");
+		return -1;
+	}
+	return 0;
+}
+
+static void netlink_privs_lower(void) {
+	/* the run's release lowers them */
+	if(nl_privs_held) {
+		return;
+	}
+	if(zserv_privs.change(ZPRIVS_LOWER)) {
+		zlog(NULL, LOG_ERR, "Can't lower privileges");
+	}
+}
+
 /* Get type specified information from netlink. */
 static int netlink_request(int family, int type, struct nlsock *nl) {
 	int ret;
@@ -205,6 +268,8 @@ static int netlink_request(int family, int type, struct nlsock *nl) {
 		struct rtgenmsg g;
 	} req;
 
+	netlink_batch_sync();
+
 	/* Check netlink socket. */
 	if(nl->sock < 0) {
 		zlog(NULL, LOG_ERR, "%s socket isn't active.", nl->name);
@@ -222,20 +287,14 @@ static int netlink_request(int family, int type, struct nlsock *nl) {
 	req.nlh.nlmsg_seq = ++nl->seq;
 	req.g.rtgen_family = family;
 
-	/* linux appears to check capabilities on every message
-   * have to raise caps for every message sent
-   */
-	if(zserv_privs.change(ZPRIVS_RAISE)) {
-		zlog(NULL, LOG_ERR, "Can't raise privileges");
+	/* linux appears to check capabilities on every message */
+	if(netlink_privs_raise()) {
 		return -1;
 	}
 
 	ret = sendto(nl->sock, (void *) &req, sizeof req, 0, (struct sockaddr *) &snl, sizeof snl);
 	save_errno = errno;
-
-	if(zserv_privs.change(ZPRIVS_LOWER)) {
-		zlog(NULL, LOG_ERR, "Can't lower privileges");
-	}
+	netlink_privs_lower();
 
 	if(ret < 0) {
 		zlog(NULL, LOG_ERR, "%s sendto failed: %s", nl->name, safe_strerror(save_errno));
@@ -245,24 +304,84 @@ static int netlink_request(int family, int type, struct nlsock *nl) {
 	return 0;
 }
 
+/* Make the receive slots size bytes long at least */
+static void netlink_rcvbuf_grow(size_t size) {
+	if(size <= nl_rcvbuf.size) {
+		return;
+	}
+	size = (size + 4095) & ~(size_t) 4095;
+	XFREE(MTYPE_NETLINK_RCVBUF, nl_rcvbuf.p);
+	nl_rcvbuf.p = XMALLOC(MTYPE_NETLINK_RCVBUF, size * NL_RCV_SLOTS);
+	nl_rcvbuf.size = size;
+}
+
+/* Take up to NL_RCV_SLOTS datagrams off nl, sizing the slots to the first
+ * one beforehand.  Blocks for the first one only, as the socket does. */
+static int netlink_recv(struct nlsock *nl, struct sockaddr_nl *snl, struct msghdr *msg, int *len) {
+	struct iovec iov[NL_RCV_SLOTS];
+	int status, i, n = 1;
+
+	status = recv(nl->sock, NULL, 0, MSG_PEEK | MSG_TRUNC);
+	if(status < 0) {
+		return status;
+	}
+	netlink_rcvbuf_grow((size_t) status);
+
+#ifdef MSG_WAITFORONE
+	{
+		struct mmsghdr mmsg[NL_RCV_SLOTS];
+
+		memset(mmsg, 0, sizeof(mmsg));
+		for(i = 0; i < NL_RCV_SLOTS; i++) {
+			iov[i].iov_base = nl_rcvbuf.p + i * nl_rcvbuf.size;
+			iov[i].iov_len = nl_rcvbuf.size;
+			mmsg[i].msg_hdr.msg_name = (void *) &snl[i];
+			mmsg[i].msg_hdr.msg_namelen = sizeof(*snl);
+			mmsg[i].msg_hdr.msg_iov = &iov[i];
+			mmsg[i].msg_hdr.msg_iovlen = 1;
+		}
+		n = recvmmsg(nl->sock, mmsg, NL_RCV_SLOTS, MSG_WAITFORONE, NULL);
+		if(n < 0 && errno == ENOSYS) {
+			goto single;
+		}
+		for(i = 0; i < n; i++) {
+			msg[i] = mmsg[i].msg_hdr;
+			len[i] = mmsg[i].msg_len;
+		}
+		return n;
+	}
+single:
+#endif /* MSG_WAITFORONE */
+	iov[0].iov_base = nl_rcvbuf.p;
+	iov[0].iov_len = nl_rcvbuf.size;
+	memset(msg, 0, sizeof(*msg));
+	msg->msg_name = (void *) snl;
+	msg->msg_namelen = sizeof(*snl);
+	msg->msg_iov = iov;
+	msg->msg_iovlen = 1;
+	status = recvmsg(nl->sock, msg, 0);
+	if(status < 0) {
+		return status;
+	}
+	len[0] = status;
+	return n;
+}
+
 /* Receive message from netlink interface and pass those information
    to the given function. */
 static int netlink_parse_info(int (*filter)(struct sockaddr_nl *, struct nlmsghdr *, vrf_id_t), struct nlsock *nl, struct zebra_vrf *zvrf) {
+	struct sockaddr_nl snls[NL_RCV_SLOTS];
+	struct msghdr msgs[NL_RCV_SLOTS];
+	int lens[NL_RCV_SLOTS];
+	size_t grow = 0;
 	int status;
 	int ret = 0;
 	int error;
+	int i, n;
 
 	while(1) {
-		struct iovec iov = {
-			.iov_base = nl_rcvbuf.p,
-			.iov_len = nl_rcvbuf.size,
-		};
-		struct sockaddr_nl snl;
-		struct msghdr msg = { .msg_name = (void *) &snl, .msg_namelen = sizeof snl, .msg_iov = &iov, .msg_iovlen = 1 };
-		struct nlmsghdr *h;
-
-		status = recvmsg(nl->sock, &msg, 0);
-		if(status < 0) {
+		n = netlink_recv(nl, snls, msgs, lens);
+		if(n < 0) {
 			if(errno == EINTR) {
 				continue;
 			}
@@ -270,93 +389,106 @@ static int netlink_parse_info(int (*filter)(struct sockaddr_nl *, struct nlmsghd
 				break;
 			}
 			zlog(NULL, LOG_ERR, "%s recvmsg overrun: %s", nl->name, safe_strerror(errno));
+			/* routes may have come and gone unseen */
+			if(errno == ENOBUFS && nl == &zvrf->netlink) {
+				rib_audit_overrun(zvrf);
+			}
 			continue;
 		}
 
-		if(status == 0) {
-			zlog(NULL, LOG_ERR, "%s EOF", nl->name);
-			return -1;
-		}
+		for(i = 0; i < n; i++) {
+			struct sockaddr_nl snl = snls[i];
+			struct msghdr msg = msgs[i];
+			struct nlmsghdr *h;
 
-		if(msg.msg_namelen != sizeof snl) {
-			zlog(NULL, LOG_ERR, "%s sender address length error: length %d", nl->name, msg.msg_namelen);
-			return -1;
-		}
+			status = lens[i];
+			if(status == 0) {
+				zlog(NULL, LOG_ERR, "%s EOF", nl->name);
+				return -1;
+			}
 
-		for(h = (struct nlmsghdr *) nl_rcvbuf.p; NLMSG_OK(h, (unsigned int) status); h = NLMSG_NEXT(h, status)) {
-			/* Finish of reading. */
-			if(h->nlmsg_type == NLMSG_DONE) {
-				return ret;
+			if(msg.msg_namelen != sizeof snl) {
+				zlog(NULL, LOG_ERR, "%s sender address length error: length %d", nl->name, msg.msg_namelen);
+				return -1;
 			}
 
-			/* Error handling. */
-			if(h->nlmsg_type == NLMSG_ERROR) {
-				struct nlmsgerr *err = (struct nlmsgerr *) NLMSG_DATA(h);
-				int errnum = err->error;
-				int msg_type = err->msg.nlmsg_type;
+			for(h = (struct nlmsghdr *) (nl_rcvbuf.p + i * nl_rcvbuf.size); NLMSG_OK(h, (unsigned int) status); h = NLMSG_NEXT(h, status)) {
+				/* Finish of reading. */
+				if(h->nlmsg_type == NLMSG_DONE) {
+					return ret;
+				}
 
-				/* If the error field is zero, then this is an ACK */
-				if(err->error == 0) {
-					if(IS_ZEBRA_DEBUG_KERNEL) {
-						zlog_debug("%s: %s ACK: type=%s(%u), seq=%u, pid=%u", __FUNCTION__, nl->name, lookup(nlmsg_str, err->msg.nlmsg_type), err->msg.nlmsg_type, err->msg.nlmsg_seq, err->msg.nlmsg_pid);
+				/* Error handling. */
+				if(h->nlmsg_type == NLMSG_ERROR) {
+					struct nlmsgerr *err = (struct nlmsgerr *) NLMSG_DATA(h);
+					int errnum = err->error;
+					int msg_type = err->msg.nlmsg_type;
+
+					/* If the error field is zero, then this is an ACK */
+					if(err->error == 0) {
+						if(IS_ZEBRA_DEBUG_KERNEL) {
+							zlog_debug("%s: %s ACK: type=%s(%u), seq=%u, pid=%u", __FUNCTION__, nl->name, lookup(nlmsg_str, err->msg.nlmsg_type), err->msg.nlmsg_type, err->msg.nlmsg_seq, err->msg.nlmsg_pid);
+						}
+
+						/* return if not a multipart message, otherwise continue */
+						if(!(h->nlmsg_flags & NLM_F_MULTI)) {
+							return 0;
+						}
+						continue;
+					}
+
+					if(h->nlmsg_len < NLMSG_LENGTH(sizeof(struct nlmsgerr))) {
+						zlog(NULL, LOG_ERR, "%s error: message truncated", nl->name);
+						return -1;
 					}
 
-					/* return if not a multipart message, otherwise continue */
-					if(!(h->nlmsg_flags & NLM_F_MULTI)) {
+					/* Deal with errors that occur because of races in link handling */
+					if(nl == &zvrf->netlink_cmd && ((msg_type == RTM_DELROUTE && (-errnum == ENODEV || -errnum == ESRCH)) || (msg_type == RTM_NEWROUTE && -errnum == EEXIST))) {
+						if(IS_ZEBRA_DEBUG_KERNEL) {
+							zlog_debug("%s: error: %s type=%s(%u), seq=%u, pid=%u", nl->name, safe_strerror(-errnum), lookup(nlmsg_str, msg_type), msg_type, err->msg.nlmsg_seq, err->msg.nlmsg_pid);
+						}
 						return 0;
 					}
-					continue;
-				}
 
-				if(h->nlmsg_len < NLMSG_LENGTH(sizeof(struct nlmsgerr))) {
-					zlog(NULL, LOG_ERR, "%s error: message truncated", nl->name);
+					zlog_err("%s error: %s, type=%s(%u), seq=%u, pid=%u", nl->name, safe_strerror(-errnum), lookup(nlmsg_str, msg_type), msg_type, err->msg.nlmsg_seq, err->msg.nlmsg_pid);
 					return -1;
 				}
 
-				/* Deal with errors that occur because of races in link handling */
-				if(nl == &zvrf->netlink_cmd && ((msg_type == RTM_DELROUTE && (-errnum == ENODEV || -errnum == ESRCH)) || (msg_type == RTM_NEWROUTE && -errnum == EEXIST))) {
+				/* OK we got netlink message. */
+				if(IS_ZEBRA_DEBUG_KERNEL) {
+					zlog_debug("netlink_parse_info: %s type %s(%u), seq=%u, pid=%u", nl->name, lookup(nlmsg_str, h->nlmsg_type), h->nlmsg_type, h->nlmsg_seq, h->nlmsg_pid);
+				}
+
+				/* skip unsolicited messages originating from command socket
+	           * linux sets the originators port-id for {NEW|DEL}ADDR messages,
+	           * so this has to be checked here. */
+				if(nl != &zvrf->netlink_cmd && h->nlmsg_pid == zvrf->netlink_cmd.snl.nl_pid && (h->nlmsg_type != RTM_NEWADDR && h->nlmsg_type != RTM_DELADDR)) {
 					if(IS_ZEBRA_DEBUG_KERNEL) {
-						zlog_debug("%s: error: %s type=%s(%u), seq=%u, pid=%u", nl->name, safe_strerror(-errnum), lookup(nlmsg_str, msg_type), msg_type, err->msg.nlmsg_seq, err->msg.nlmsg_pid);
+						zlog_debug("netlink_parse_info: %s packet comes from %s", zvrf->netlink_cmd.name, nl->name);
 					}
-					return 0;
+					continue;
 				}
 
-				zlog_err("%s error: %s, type=%s(%u), seq=%u, pid=%u", nl->name, safe_strerror(-errnum), lookup(nlmsg_str, msg_type), msg_type, err->msg.nlmsg_seq, err->msg.nlmsg_pid);
-				return -1;
-			}
-
-			/* OK we got netlink message. */
-			if(IS_ZEBRA_DEBUG_KERNEL) {
-				zlog_debug("netlink_parse_info: %s type %s(%u), seq=%u, pid=%u", nl->name, lookup(nlmsg_str, h->nlmsg_type), h->nlmsg_type, h->nlmsg_seq, h->nlmsg_pid);
+				error = (*filter)(&snl, h, zvrf->vrf_id);
+				if(error < 0) {
+					zlog(NULL, LOG_ERR, "%s filter function error", nl->name);
+					ret = error;
+				}
 			}
 
-			/* skip unsolicited messages originating from command socket
-           * linux sets the originators port-id for {NEW|DEL}ADDR messages,
-           * so this has to be checked here. */
-			if(nl != &zvrf->netlink_cmd && h->nlmsg_pid == zvrf->netlink_cmd.snl.nl_pid && (h->nlmsg_type != RTM_NEWADDR && h->nlmsg_type != RTM_DELADDR)) {
-				if(IS_ZEBRA_DEBUG_KERNEL) {
-					zlog_debug("netlink_parse_info: %s packet comes from %s", zvrf->netlink_cmd.name, nl->name);
-				}
+			/* After error care: one past the first of the lot may
+			   not fit, let the slots grow for the next ones */
+			if(msg.msg_flags & MSG_TRUNC) {
+				zlog(NULL, LOG_ERR, "%s error: message truncated!", nl->name);
+				grow = nl_rcvbuf.size * 2;
 				continue;
 			}
-
-			error = (*filter)(&snl, h, zvrf->vrf_id);
-			if(error < 0) {
-				zlog(NULL, LOG_ERR, "%s filter function error", nl->name);
-				ret = error;
+			if(status) {
+				zlog(NULL, LOG_ERR, "%s error: data remnant size %d", nl->name, status);
+				return -1;
 			}
 		}
-
-		/* After error care. */
-		if(msg.msg_flags & MSG_TRUNC) {
-			zlog(NULL, LOG_ERR, "%s error: message truncated!", nl->name);
-			zlog(NULL, LOG_ERR, "Must restart with larger --nl-bufsize value!");
-			continue;
-		}
-		if(status) {
-			zlog(NULL, LOG_ERR, "%s error: data remnant size %d", nl->name, status);
-			return -1;
-		}
+		netlink_rcvbuf_grow(grow);
 	}
 	return ret;
 }
@@ -1276,6 +1408,323 @@ static int netlink_talk_filter(struct sockaddr_nl *snl, struct nlmsghdr *h, vrf_
 	return 0;
 }
 
+/* Route changes sent in batches, see nl_batch: the messages of a batch go
+ * to the kernel in one sendmsg(), only the last of them asking for an ACK.
+ * The kernel acts on them in order and tells of those failing, with their
+ * sequence number, so the ACK means all others went through.
+ *
+ * Batches are handed to the dataplane, a work pool of one thread owning
+ * each VRF's netlink_dplane socket: it sends a batch and waits for the
+ * kernel's verdict on it, while the RIB goes on with the next one.  The
+ * ribs of a batch are marked RIB_ENTRY_QUEUED meanwhile; the verdict comes
+ * back to the main thread with the batch, through the pool's lock-free
+ * finished stack.  Up to NL_BATCH_QUEUE batches are out at once, the RIB
+ * waits for the dataplane past that.
+ */
+#define NL_BATCH_SIZE 65536
+#define NL_BATCH_MAX 1024
+#define NL_BATCH_QUEUE 4
+
+struct nl_batch_route {
+	u_int32_t seq;
+	int cmd;
+	int error; /* the kernel's, set by the dataplane */
+	struct prefix p;
+	vrf_id_t vrf_id;
+	struct rib *rib;
+};
+
+struct nl_batch {
+	struct nl_batch *next; /* on the free list */
+	struct zebra_vrf *zvrf;
+	int sock; /* zvrf's netlink_dplane, for the dataplane */
+	size_t len;
+	size_t last; /* where the last message starts */
+	int count;
+	int error; /* sendmsg() or recv() failed, set by the dataplane */
+	struct nl_batch_route route[NL_BATCH_MAX];
+	char buf[NL_BATCH_SIZE];
+};
+
+static struct nl_batch nl_batches[NL_BATCH_QUEUE];
+static struct nl_batch *nl_batch_free;
+static struct nl_batch *nl_batch_fill;
+static struct thread *nl_batch_t_flush;
+
+static struct work_pool *nl_dplane;
+/* the dataplane thread keeps its privileges raised, rather than
+   raise and lower them around each batch */
+static int nl_dplane_raised;
+/* the dataplane thread's own */
+static char nl_dplane_rcvbuf[16384];
+
+/* The kernel's verdict on a route of the batch in: the nexthops of its
+ * rib, if that is still there, aren't in the FIB on failure. */
+static void netlink_batch_route_done(struct nl_batch_route *route) {
+	struct route_table *table;
+	struct route_node *rn;
+	struct rib *rib;
+	struct nexthop *nexthop, *tnexthop;
+	int recursing;
+	char buf[PREFIX_STRLEN];
+	int errnum = route->error;
+
+	/* races in link handling, as for netlink_parse_info() */
+	if((route->cmd == RTM_DELROUTE && (errnum == ENODEV || errnum == ESRCH)) || (route->cmd == RTM_NEWROUTE && errnum == EEXIST)) {
+		if(IS_ZEBRA_DEBUG_KERNEL) {
+			zlog_debug("%s: %s %s: %s", __func__, lookup(nlmsg_str, route->cmd), prefix2str(&route->p, buf, sizeof(buf)), safe_strerror(errnum));
+		}
+		errnum = 0;
+	} else if(errnum) {
+		zlog_err("netlink-dplane error: %s, type=%s(%u), %s, seq=%u", safe_strerror(errnum), lookup(nlmsg_str, route->cmd), route->cmd, prefix2str(&route->p, buf, sizeof(buf)), route->seq);
+	}
+
+	table = zebra_vrf_table(family2afi(route->p.family), SAFI_UNICAST, route->vrf_id);
+	if(table == NULL || (rn = route_node_lookup(table, &route->p)) == NULL) {
+		return;
+	}
+	RNODE_FOREACH_RIB(rn, rib) {
+		if(rib != route->rib) {
+			continue;
+		}
+		UNSET_FLAG(rib->status, RIB_ENTRY_QUEUED);
+		if(errnum && route->cmd == RTM_NEWROUTE && CHECK_FLAG(rib->status, RIB_ENTRY_SELECTED_FIB)) {
+			for(ALL_NEXTHOPS_RO(rib->nexthop, nexthop, tnexthop, recursing)) {
+				UNSET_FLAG(nexthop->flags, NEXTHOP_FLAG_FIB);
+			}
+			zebra_rnh_changed(rn);
+			if(rib->type != ZEBRA_ROUTE_BGP) {
+				rib_nexthop_changed(rn);
+			}
+		}
+		break;
+	}
+	route_unlock_node(rn);
+}
+
+/* Dataplane thread: send the batch and take what the kernel says of it,
+ * up to the ACK of its last message.  Works on the batch and its socket
+ * only, see workpool.h. */
+static void netlink_dplane_run(void *arg) {
+	struct nl_batch *b = arg;
+	struct sockaddr_nl snl;
+	struct iovec iov = { .iov_base = b->buf, .iov_len = b->len };
+	struct msghdr msg = {
+		.msg_name = (void *) &snl,
+		.msg_namelen = sizeof snl,
+		.msg_iov = &iov,
+		.msg_iovlen = 1,
+	};
+	struct nlmsghdr *h;
+	struct nlmsgerr *err;
+	u_int32_t first, last, seq;
+	int status;
+
+	memset(&snl, 0, sizeof snl);
+	snl.nl_family = AF_NETLINK;
+	first = b->route[0].seq;
+	last = b->route[b->count - 1].seq;
+
+	if(!nl_dplane_raised) {
+		zserv_privs.change(ZPRIVS_RAISE);
+	}
+	status = sendmsg(b->sock, &msg, 0);
+	b->error = status < 0 ? errno : 0;
+	if(!nl_dplane_raised) {
+		zserv_privs.change(ZPRIVS_LOWER);
+	}
+	if(status < 0) {
+		return;
+	}
+
+	for(;;) {
+		status = recv(b->sock, nl_dplane_rcvbuf, sizeof(nl_dplane_rcvbuf), 0);
+		if(status < 0) {
+			if(errno == EINTR) {
+				continue;
+			}
+			b->error = errno;
+			return;
+		}
+		if(status == 0) {
+			b->error = EPIPE;
+			return;
+		}
+
+		for(h = (struct nlmsghdr *) nl_dplane_rcvbuf; NLMSG_OK(h, (unsigned int) status); h = NLMSG_NEXT(h, status)) {
+			if(h->nlmsg_type != NLMSG_ERROR || h->nlmsg_len < NLMSG_LENGTH(sizeof(struct nlmsgerr))) {
+				continue;
+			}
+			err = (struct nlmsgerr *) NLMSG_DATA(h);
+			seq = err->msg.nlmsg_seq;
+			if(seq - first >= (u_int32_t) b->count) {
+				continue;
+			}
+			b->route[seq - first].error = -err->error;
+			if(seq == last) {
+				return;
+			}
+		}
+	}
+}
+
+/* Back on the main thread with the kernel's verdict */
+static void netlink_dplane_done(void *arg) {
+	struct nl_batch *b = arg;
+	int i;
+
+	if(b->error) {
+		/* nothing more will come of it: the routes' fate is unknown,
+		   take them as failed */
+		zlog_err("%s error on %d routes: %s", b->zvrf->netlink_dplane.name, b->count, safe_strerror(b->error));
+		for(i = 0; i < b->count; i++) {
+			if(b->route[i].error == 0) {
+				b->route[i].error = b->error;
+			}
+		}
+	} else if(IS_ZEBRA_DEBUG_KERNEL) {
+		zlog_debug("%s: %s ACK of %d routes, seq=%u..%u", __func__, b->zvrf->netlink_dplane.name, b->count, b->route[0].seq, b->route[b->count - 1].seq);
+	}
+
+	for(i = 0; i < b->count; i++) {
+		netlink_batch_route_done(&b->route[i]);
+	}
+
+	b->count = 0;
+	b->len = 0;
+	b->zvrf = NULL;
+	b->next = nl_batch_free;
+	nl_batch_free = b;
+}
+
+#ifdef HAVE_CAPABILITIES
+static void netlink_dplane_raise(void *arg) {
+	zserv_privs.change(ZPRIVS_RAISE);
+}
+#endif
+
+static void netlink_dplane_init(void) {
+	unsigned int workers = 0;
+	int i;
+
+	for(i = 0; i < NL_BATCH_QUEUE; i++) {
+		nl_batches[i].next = nl_batch_free;
+		nl_batch_free = &nl_batches[i];
+	}
+
+#ifdef HAVE_PTHREAD
+	/* A thread of its own only where the privileges it needs don't
+	   get in the way of the main thread's: capabilities are each
+	   thread's, a run-as user's uid is the whole process'. */
+#ifdef HAVE_CAPABILITIES
+	workers = 1;
+#else
+	workers = geteuid() == 0;
+#endif
+#endif
+	nl_dplane = work_pool_new(zebrad.master, "zebra dataplane", workers);
+
+#ifdef HAVE_CAPABILITIES
+	if(workers) {
+		/* the main thread waits, so the two don't race on the privs */
+		work_pool_submit(nl_dplane, netlink_dplane_raise, NULL, NULL);
+		work_pool_wait(nl_dplane);
+		nl_dplane_raised = 1;
+	}
+#else
+	nl_dplane_raised = workers;
+#endif
+}
+
+/* Hand the batch filled to the dataplane, waiting for it first if all
+ * batches are out */
+static void netlink_batch_flush(void) {
+	struct nl_batch *b = nl_batch_fill;
+
+	THREAD_OFF(nl_batch_t_flush);
+	if(b == NULL || b->count == 0) {
+		return;
+	}
+
+	if(IS_ZEBRA_DEBUG_KERNEL) {
+		zlog_debug("%s: %s %d routes, %zu bytes, seq=%u..%u", __func__, b->zvrf->netlink_dplane.name, b->count, b->len, b->route[0].seq, b->route[b->count - 1].seq);
+	}
+
+	nl_batch_fill = NULL;
+	b->sock = b->zvrf->netlink_dplane.sock;
+	work_pool_submit(nl_dplane, netlink_dplane_run, netlink_dplane_done, b);
+}
+
+static int netlink_batch_flush_event(struct thread *t) {
+	nl_batch_t_flush = NULL;
+	netlink_batch_flush();
+	return 0;
+}
+
+/* Send all route changes held back and wait for the kernel's verdict,
+ * ahead of anything else sent to it */
+static void netlink_batch_sync(void) {
+	if(!nl_dplane) {
+		return;
+	}
+	netlink_batch_flush();
+	work_pool_wait(nl_dplane);
+}
+
+void kernel_route_flush(void) {
+	netlink_batch_sync();
+}
+
+/* Queue the route change in n for the next batch, sent out once the work
+ * at hand is done or the batch is full */
+static int netlink_batch_add(struct nlmsghdr *n, struct prefix *p, struct rib *rib, struct zebra_vrf *zvrf) {
+	struct nl_batch *b = nl_batch_fill;
+	struct nl_batch_route *route;
+
+	if(b && (b->zvrf != zvrf || b->count == NL_BATCH_MAX || b->len + NLMSG_ALIGN(n->nlmsg_len) > NL_BATCH_SIZE)) {
+		netlink_batch_flush();
+		b = NULL;
+	}
+	if(b == NULL) {
+		/* started on first use: the thread wouldn't survive daemon() */
+		if(nl_dplane == NULL) {
+			netlink_dplane_init();
+		}
+		if(nl_batch_free == NULL) {
+			work_pool_wait(nl_dplane);
+		}
+		b = nl_batch_fill = nl_batch_free;
+		nl_batch_free = b->next;
+		b->zvrf = zvrf;
+	}
+
+	/* errors are reported anyway, the batch's last message asks for an
+	   ACK to tell of its end: the one before loses its NLM_F_ACK */
+	n->nlmsg_seq = ++zvrf->netlink_dplane.seq;
+	n->nlmsg_flags |= NLM_F_ACK;
+	if(b->count) {
+		((struct nlmsghdr *) (b->buf + b->last))->nlmsg_flags &= ~NLM_F_ACK;
+	}
+	b->last = b->len;
+	memcpy(b->buf + b->len, n, n->nlmsg_len);
+
+	route = &b->route[b->count++];
+	route->seq = n->nlmsg_seq;
+	route->cmd = n->nlmsg_type;
+	route->error = 0;
+	prefix_copy(&route->p, p);
+	route->vrf_id = zvrf->vrf_id;
+	route->rib = rib;
+	b->len += NLMSG_ALIGN(n->nlmsg_len);
+
+	SET_FLAG(rib->status, RIB_ENTRY_QUEUED);
+
+	if(!nl_batch_t_flush) {
+		nl_batch_t_flush = thread_add_event(zebrad.master, netlink_batch_flush_event, NULL, 0);
+	}
+	return 0;
+}
+
 /* sendmsg() to netlink socket then recvmsg(). */
 static int netlink_talk(struct nlmsghdr *n, struct nlsock *nl, struct zebra_vrf *zvrf) {
 	int status;
@@ -1289,6 +1738,8 @@ static int netlink_talk(struct nlmsghdr *n, struct nlsock *nl, struct zebra_vrf
 	};
 	int save_errno;
 
+	netlink_batch_sync();
+
 	memset(&snl, 0, sizeof snl);
 	snl.nl_family = AF_NETLINK;
 
@@ -1297,19 +1748,19 @@ static int netlink_talk(struct nlmsghdr *n, struct nlsock *nl, struct zebra_vrf
 	/* Request an acknowledgement by setting NLM_F_ACK */
 	n->nlmsg_flags |= NLM_F_ACK;
 
+	QUAGGA_TRACE(zebra, netlink_talk, n->nlmsg_type, n->nlmsg_seq, zvrf->vrf_id);
+
 	if(IS_ZEBRA_DEBUG_KERNEL) {
 		zlog_debug("netlink_talk: %s type %s(%u), seq=%u", nl->name, lookup(nlmsg_str, n->nlmsg_type), n->nlmsg_type, n->nlmsg_seq);
 	}
 
 	/* Send message to netlink interface. */
-	if(zserv_privs.change(ZPRIVS_RAISE)) {
-		zlog(NULL, LOG_ERR, "Can't raise privileges");
+	if(netlink_privs_raise()) {
+		return -1;
 	}
 	status = sendmsg(nl->sock, &msg, 0);
 	save_errno = errno;
-	if(zserv_privs.change(ZPRIVS_LOWER)) {
-		zlog(NULL, LOG_ERR, "Can't lower privileges");
-	}
+	netlink_privs_lower();
 
 	if(status < 0) {
 		zlog(NULL, LOG_ERR, "netlink_talk sendmsg() error: %s", safe_strerror(save_errno));
@@ -1565,6 +2016,45 @@ static int netlink_route_multipath(int cmd, struct prefix *p, struct rib *rib) {
 		addattr_l(&req.n, NL_PKT_BUF_SIZE, RTA_METRICS, RTA_DATA(rta), RTA_PAYLOAD(rta));
 	}
 
+#ifdef RTM_NEWNEXTHOP
+	/* The nexthops are an object the kernel shares between the routes of
+     the group, and deleting needs none. */
+	if(rib->nhg && rib->nhg->kernel_id && !discard) {
+		if(cmd == RTM_NEWROUTE) {
+			union g_addr *src = NULL;
+
+			for(nexthop = rib->nexthop; nexthop; nexthop = nexthop->next) {
+				if(nexthop->type != NEXTHOP_TYPE_IFINDEX) {
+					req.r.rtm_scope = RT_SCOPE_UNIVERSE;
+				}
+				if(CHECK_FLAG(nexthop->flags, NEXTHOP_FLAG_ACTIVE)) {
+					SET_FLAG(nexthop->flags, NEXTHOP_FLAG_FIB);
+					if(!src && nexthop->src.ipv4.s_addr) {
+						src = &nexthop->src;
+					}
+				}
+			}
+			addattr32(&req.n, sizeof req, RTA_NH_ID, rib->nhg->kernel_id);
+			/* a route map's src is the route's, not the object's */
+			if(src) {
+				addattr_l(&req.n, sizeof req, RTA_PREFSRC, &src->ipv4, bytelen);
+			}
+
+			if(IS_ZEBRA_DEBUG_KERNEL) {
+				zlog_debug("netlink_route_multipath() (nexthop group): %s/%d via nexthop object %u", inet_ntoa(p->u.prefix4), p->prefixlen, rib->nhg->kernel_id);
+			}
+		}
+		goto skip;
+	}
+#endif
+
+	/* Nor does deleting a route the previous zebra left, which may be on
+     an object of its own, whatever its scope. */
+	if(cmd == RTM_DELROUTE && CHECK_FLAG(rib->status, RIB_ENTRY_STALE)) {
+		req.r.rtm_scope = RT_SCOPE_NOWHERE;
+		goto skip;
+	}
+
 	if(discard) {
 		if(cmd == RTM_NEWROUTE) {
 			for(ALL_NEXTHOPS_RO(rib->nexthop, nexthop, tnexthop, recursing)) {
@@ -1680,9 +2170,148 @@ skip:
 	snl.nl_family = AF_NETLINK;
 
 	/* Talk to netlink socket. */
+	if(nl_batch) {
+		return netlink_batch_add(&req.n, p, rib, zvrf);
+	}
 	return netlink_talk(&req.n, &zvrf->netlink_cmd, zvrf);
 }
 
+#ifdef RTM_NEWNEXTHOP
+/* Kernel nexthop object ids are handed out here, the last one used */
+static u_int32_t netlink_nhg_id_last;
+
+static u_int32_t netlink_nhg_id_new(void) {
+	if(++netlink_nhg_id_last == 0) {
+		netlink_nhg_id_last = 1;
+	}
+	return netlink_nhg_id_last;
+}
+
+/* Add, replace or delete a nexthop object: a single nexthop, or with grp a
+ * group of others.  Objects are only replaced where told to, so that ids
+ * others already use are left alone. */
+static int netlink_nexthop(int cmd, u_int32_t id, int replace, struct nexthop *nexthop, struct nexthop_grp *grp, int grp_num, struct zebra_vrf *zvrf) {
+	struct {
+		struct nlmsghdr n;
+		struct nhmsg nhm;
+		char buf[NL_PKT_BUF_SIZE];
+	} req;
+
+	memset(&req, 0, sizeof req - NL_PKT_BUF_SIZE);
+
+	req.n.nlmsg_len = NLMSG_LENGTH(sizeof(struct nhmsg));
+	req.n.nlmsg_flags = NLM_F_REQUEST;
+	req.n.nlmsg_type = cmd;
+	req.nhm.nh_family = AF_UNSPEC;
+
+	if(cmd == RTM_NEWNEXTHOP) {
+		req.n.nlmsg_flags |= NLM_F_CREATE | (replace ? NLM_F_REPLACE : NLM_F_EXCL);
+		req.nhm.nh_protocol = RTPROT_ZEBRA;
+	}
+
+	addattr32(&req.n, sizeof req, NHA_ID, id);
+	if(nexthop) {
+		req.nhm.nh_family = AF_INET;
+		if(CHECK_FLAG(nexthop->flags, NEXTHOP_FLAG_ONLINK)) {
+			req.nhm.nh_flags |= RTNH_F_ONLINK;
+		}
+		addattr32(&req.n, sizeof req, NHA_OIF, nexthop->ifindex);
+		if(nexthop->type == NEXTHOP_TYPE_IPV4 || nexthop->type == NEXTHOP_TYPE_IPV4_IFINDEX) {
+			addattr_l(&req.n, sizeof req, NHA_GATEWAY, &nexthop->gate.ipv4, 4);
+		}
+	}
+	if(grp) {
+		addattr_l(&req.n, sizeof req, NHA_GROUP, grp, grp_num * sizeof(struct nexthop_grp));
+	}
+
+	return netlink_talk(&req.n, &zvrf->netlink_cmd, zvrf);
+}
+
+/* The group is always a group object, even of one nexthop, as the kernel
+ * can't replace a single nexthop object with a group or the other way. */
+int kernel_nhg_install(struct zebra_nhg *nhg) {
+	struct zebra_vrf *zvrf = vrf_info_lookup(VRF_DEFAULT);
+	struct nexthop_grp grp[MULTIPATH_NUM];
+	struct nexthop *nexthop;
+	u_int32_t *member_id;
+	u_int32_t id;
+	int i, num;
+
+	if(nhg->nexthop == NULL) {
+		return -1;
+	}
+	for(nexthop = nhg->nexthop; nexthop; nexthop = nexthop->next) {
+		if((nexthop->type != NEXTHOP_TYPE_IFINDEX && nexthop->type != NEXTHOP_TYPE_IPV4 && nexthop->type != NEXTHOP_TYPE_IPV4_IFINDEX) || !nexthop->ifindex) {
+			return -1;
+		}
+	}
+
+	member_id = XCALLOC(MTYPE_ZEBRA_NHG, sizeof(u_int32_t) * MULTIPATH_NUM);
+	memset(grp, 0, sizeof(grp));
+	num = 0;
+	for(nexthop = nhg->nexthop; nexthop && num < MULTIPATH_NUM; nexthop = nexthop->next) {
+		member_id[num] = netlink_nhg_id_new();
+		if(netlink_nexthop(RTM_NEWNEXTHOP, member_id[num], 0, nexthop, NULL, 0, zvrf) < 0) {
+			goto fail;
+		}
+		grp[num].id = member_id[num];
+		num++;
+	}
+
+	id = nhg->kernel_id ? nhg->kernel_id : netlink_nhg_id_new();
+	if(netlink_nexthop(RTM_NEWNEXTHOP, id, nhg->kernel_id != 0, NULL, grp, num, zvrf) < 0) {
+		goto fail;
+	}
+
+	/* the group no longer refers to the old ones */
+	for(i = 0; i < nhg->kernel_member_num; i++) {
+		netlink_nexthop(RTM_DELNEXTHOP, nhg->kernel_member_id[i], 0, NULL, NULL, 0, zvrf);
+	}
+	if(nhg->kernel_member_id) {
+		XFREE(MTYPE_ZEBRA_NHG, nhg->kernel_member_id);
+	}
+
+	nhg->kernel_id = id;
+	nhg->kernel_member_id = member_id;
+	nhg->kernel_member_num = num;
+	return 0;
+
+fail:
+	for(i = 0; i < num; i++) {
+		netlink_nexthop(RTM_DELNEXTHOP, member_id[i], 0, NULL, NULL, 0, zvrf);
+	}
+	XFREE(MTYPE_ZEBRA_NHG, member_id);
+	return -1;
+}
+
+/* Routes still using the object go with it */
+void kernel_nhg_uninstall(struct zebra_nhg *nhg) {
+	struct zebra_vrf *zvrf = vrf_info_lookup(VRF_DEFAULT);
+	int i;
+
+	if(nhg->kernel_id == 0) {
+		return;
+	}
+
+	netlink_nexthop(RTM_DELNEXTHOP, nhg->kernel_id, 0, NULL, NULL, 0, zvrf);
+	for(i = 0; i < nhg->kernel_member_num; i++) {
+		netlink_nexthop(RTM_DELNEXTHOP, nhg->kernel_member_id[i], 0, NULL, NULL, 0, zvrf);
+	}
+	XFREE(MTYPE_ZEBRA_NHG, nhg->kernel_member_id);
+	nhg->kernel_member_id = NULL;
+	nhg->kernel_member_num = 0;
+	nhg->kernel_id = 0;
+}
+#else
+int kernel_nhg_install(struct zebra_nhg *nhg) {
+	return -1;
+}
+
+void kernel_nhg_uninstall(struct zebra_nhg *nhg) {
+	return;
+}
+#endif /* RTM_NEWNEXTHOP */
+
 int kernel_route_rib(struct prefix *p, struct rib *old, struct rib *new) {
 	if(!old && new) {
 		return netlink_route_multipath(RTM_NEWROUTE, p, new);
@@ -1753,6 +2382,252 @@ int kernel_address_delete_ipv4(struct interface *ifp, struct connected *ifc) {
 
 extern struct thread_master *master;
 
+/* RIB and FIB audit, see rib_audit_start: the kernel's routes are dumped
+ * on a socket of their own, read a slice at a time, which holds the dump
+ * back meanwhile.  Its buffer is its own too, as repairs talk to the
+ * kernel in between, on nl_rcvbuf. */
+static char *nl_audit_buf;
+static size_t nl_audit_bufsize;
+
+int kernel_audit_start(struct zebra_vrf *zvrf, afi_t afi) {
+	struct nlsock *nl = &zvrf->netlink_audit;
+
+	if(nl->sock < 0) {
+		if(netlink_socket(nl, 0, zvrf->vrf_id) < 0) {
+			return -1;
+		}
+		if(fcntl(nl->sock, F_SETFL, O_NONBLOCK) < 0) {
+			zlog_err("Can't set %s socket flags: %s", nl->name, safe_strerror(errno));
+			kernel_audit_stop(zvrf);
+			return -1;
+		}
+	}
+
+	return netlink_request(afi == AFI_IP ? AF_INET : AF_INET6, RTM_GETROUTE, nl);
+}
+
+void kernel_audit_stop(struct zebra_vrf *zvrf) {
+	if(zvrf->netlink_audit.sock >= 0) {
+		close(zvrf->netlink_audit.sock);
+		zvrf->netlink_audit.sock = -1;
+	}
+}
+
+static void netlink_audit_nexthop(struct rib *rib, int family, void *gate, void *src, ifindex_t index) {
+	struct nexthop *nexthop;
+
+	if(family == AF_INET) {
+		if(gate && index) {
+			rib_nexthop_ipv4_ifindex_add(rib, gate, src, index);
+		} else if(gate) {
+			rib_nexthop_ipv4_add(rib, gate, src);
+		} else {
+			nexthop = rib_nexthop_ifindex_add(rib, index);
+			if(src) {
+				memcpy(&nexthop->src.ipv4, src, 4);
+			}
+		}
+	}
+#ifdef HAVE_IPV6
+	if(family == AF_INET6) {
+		if(gate && index) {
+			rib_nexthop_ipv6_ifindex_add(rib, gate, index);
+		} else if(gate) {
+			rib_nexthop_ipv6_add(rib, gate);
+		} else {
+			rib_nexthop_ifindex_add(rib, index);
+		}
+	}
+#endif /* HAVE_IPV6 */
+}
+
+/* Remove a zebra route of the dump from the kernel, whatever its
+ * nexthops, as for a stale one */
+static void netlink_audit_delete(struct zebra_vrf *zvrf, struct rtmsg *rtm, struct rtattr **tb) {
+	struct {
+		struct nlmsghdr n;
+		struct rtmsg r;
+		char buf[NL_PKT_BUF_SIZE];
+	} req;
+
+	memset(&req, 0, sizeof req - NL_PKT_BUF_SIZE);
+
+	req.n.nlmsg_len = NLMSG_LENGTH(sizeof(struct rtmsg));
+	req.n.nlmsg_flags = NLM_F_REQUEST;
+	req.n.nlmsg_type = RTM_DELROUTE;
+	req.r.rtm_family = rtm->rtm_family;
+	req.r.rtm_table = rtm->rtm_table;
+	req.r.rtm_dst_len = rtm->rtm_dst_len;
+	req.r.rtm_tos = rtm->rtm_tos;
+	req.r.rtm_protocol = rtm->rtm_protocol;
+	req.r.rtm_scope = RT_SCOPE_NOWHERE;
+
+	if(tb[RTA_DST]) {
+		addattr_l(&req.n, sizeof req, RTA_DST, RTA_DATA(tb[RTA_DST]), RTA_PAYLOAD(tb[RTA_DST]));
+	}
+	if(tb[RTA_PRIORITY]) {
+		addattr_l(&req.n, sizeof req, RTA_PRIORITY, RTA_DATA(tb[RTA_PRIORITY]), RTA_PAYLOAD(tb[RTA_PRIORITY]));
+	}
+	if(tb[RTA_TABLE]) {
+		addattr_l(&req.n, sizeof req, RTA_TABLE, RTA_DATA(tb[RTA_TABLE]), RTA_PAYLOAD(tb[RTA_TABLE]));
+	}
+
+	netlink_talk(&req.n, &zvrf->netlink_cmd, zvrf);
+}
+
+/* A route of the dump, read as the RIB would have it for
+ * rib_audit_kernel_route, from the tables netlink_route_change() takes
+ * routes from; routes of the kernel's own aren't in the RIB. */
+static void netlink_audit_route(struct zebra_vrf *zvrf, struct sockaddr_nl *snl, struct nlmsghdr *h) {
+	struct rtmsg *rtm = NLMSG_DATA(h);
+	struct rtattr *tb[RTA_MAX + 1];
+	struct rtattr *rtb[RTA_MAX + 1];
+	struct rtnexthop *rtnh;
+	struct prefix p;
+	struct rib rib;
+	u_int32_t nh_id = 0;
+	void *gate, *src = NULL;
+	int len;
+
+	if(h->nlmsg_type != RTM_NEWROUTE || (rtm->rtm_family != AF_INET && rtm->rtm_family != AF_INET6)) {
+		return;
+	}
+	if(rtm->rtm_table != RT_TABLE_MAIN && rtm->rtm_table != zebrad.rtm_table_default) {
+		return;
+	}
+	if((rtm->rtm_flags & RTM_F_CLONED) || rtm->rtm_protocol == RTPROT_REDIRECT || rtm->rtm_protocol == RTPROT_KERNEL || rtm->rtm_src_len != 0) {
+		return;
+	}
+
+	memset(&rib, 0, sizeof rib);
+	rib.type = ZEBRA_ROUTE_KERNEL;
+	rib.vrf_id = zvrf->vrf_id;
+	rib.table = rtm->rtm_table;
+	if(rtm->rtm_protocol == RTPROT_ZEBRA) {
+		SET_FLAG(rib.flags, ZEBRA_FLAG_SELFROUTE);
+	}
+	switch(rtm->rtm_type) {
+		case RTN_UNICAST: break;
+		case RTN_BLACKHOLE: SET_FLAG(rib.flags, ZEBRA_FLAG_BLACKHOLE); break;
+		case RTN_UNREACHABLE:
+		case RTN_PROHIBIT: SET_FLAG(rib.flags, ZEBRA_FLAG_REJECT); break;
+		default: return;
+	}
+
+	len = h->nlmsg_len - NLMSG_LENGTH(sizeof(struct rtmsg));
+	if(len < 0) {
+		return;
+	}
+	memset(tb, 0, sizeof tb);
+	netlink_parse_rtattr(tb, RTA_MAX, RTM_RTA(rtm), len);
+
+	memset(&p, 0, sizeof p);
+	p.family = rtm->rtm_family;
+	p.prefixlen = rtm->rtm_dst_len;
+	if(tb[RTA_DST]) {
+		memcpy(&p.u.prefix, RTA_DATA(tb[RTA_DST]), rtm->rtm_family == AF_INET ? 4 : 16);
+	}
+
+#ifdef RTM_NEWNEXTHOP
+	if(tb[RTA_NH_ID]) {
+		nh_id = *(u_int32_t *) RTA_DATA(tb[RTA_NH_ID]);
+	}
+#endif
+	if(tb[RTA_PREFSRC]) {
+		src = RTA_DATA(tb[RTA_PREFSRC]);
+	}
+
+	if(tb[RTA_MULTIPATH]) {
+		rtnh = (struct rtnexthop *) RTA_DATA(tb[RTA_MULTIPATH]);
+		len = RTA_PAYLOAD(tb[RTA_MULTIPATH]);
+		while(len >= (int) sizeof(*rtnh) && rtnh->rtnh_len <= len) {
+			gate = NULL;
+			if(rtnh->rtnh_len > sizeof(*rtnh)) {
+				memset(rtb, 0, sizeof(rtb));
+				netlink_parse_rtattr(rtb, RTA_MAX, RTNH_DATA(rtnh), rtnh->rtnh_len - sizeof(*rtnh));
+				if(rtb[RTA_GATEWAY]) {
+					gate = RTA_DATA(rtb[RTA_GATEWAY]);
+				}
+			}
+			netlink_audit_nexthop(&rib, rtm->rtm_family, gate, src, rtnh->rtnh_ifindex);
+
+			len -= NLMSG_ALIGN(rtnh->rtnh_len);
+			rtnh = RTNH_NEXT(rtnh);
+		}
+	} else if(tb[RTA_GATEWAY] || tb[RTA_OIF]) {
+		netlink_audit_nexthop(&rib, rtm->rtm_family, tb[RTA_GATEWAY] ? RTA_DATA(tb[RTA_GATEWAY]) : NULL, src, tb[RTA_OIF] ? *(int *) RTA_DATA(tb[RTA_OIF]) : 0);
+	}
+
+	switch(rib_audit_kernel_route(zvrf, &p, &rib, nh_id)) {
+		case RIB_AUDIT_DELETE: netlink_audit_delete(zvrf, rtm, tb); break;
+		case RIB_AUDIT_IMPORT: netlink_route_change(snl, h, zvrf->vrf_id); break;
+	}
+
+	nexthops_free(rib.nexthop);
+}
+
+int kernel_audit_read(struct zebra_vrf *zvrf, int budget) {
+	struct nlsock *nl = &zvrf->netlink_audit;
+	struct sockaddr_nl snl;
+	struct iovec iov;
+	struct msghdr msg;
+	struct nlmsghdr *h;
+	int status;
+
+	while(budget > 0) {
+		status = recv(nl->sock, NULL, 0, MSG_PEEK | MSG_TRUNC);
+		if(status > 0 && (size_t) status > nl_audit_bufsize) {
+			XFREE(MTYPE_NETLINK_RCVBUF, nl_audit_buf);
+			nl_audit_bufsize = ((size_t) status + 4095) & ~(size_t) 4095;
+			nl_audit_buf = XMALLOC(MTYPE_NETLINK_RCVBUF, nl_audit_bufsize);
+		}
+		if(status > 0) {
+			iov.iov_base = nl_audit_buf;
+			iov.iov_len = nl_audit_bufsize;
+			memset(&msg, 0, sizeof msg);
+			msg.msg_name = (void *) &snl;
+			msg.msg_namelen = sizeof snl;
+			msg.msg_iov = &iov;
+			msg.msg_iovlen = 1;
+			status = recvmsg(nl->sock, &msg, 0);
+		}
+		if(status < 0) {
+			if(errno == EINTR) {
+				continue;
+			}
+			if(errno == EWOULDBLOCK || errno == EAGAIN) {
+				return 0;
+			}
+			zlog_err("%s recvmsg: %s", nl->name, safe_strerror(errno));
+			return -1;
+		}
+		if(status == 0) {
+			zlog_err("%s EOF", nl->name);
+			return -1;
+		}
+
+		for(h = (struct nlmsghdr *) nl_audit_buf; NLMSG_OK(h, (unsigned int) status); h = NLMSG_NEXT(h, status)) {
+#ifdef NLM_F_DUMP_INTR
+			if(h->nlmsg_flags & NLM_F_DUMP_INTR) {
+				zvrf->audit.intr = 1;
+			}
+#endif
+			if(h->nlmsg_type == NLMSG_DONE) {
+				return 1;
+			}
+			if(h->nlmsg_type == NLMSG_ERROR) {
+				struct nlmsgerr *err = (struct nlmsgerr *) NLMSG_DATA(h);
+
+				zlog_err("%s error: %s", nl->name, safe_strerror(-err->error));
+				return -1;
+			}
+			netlink_audit_route(zvrf, &snl, h);
+			budget--;
+		}
+	}
+	return 0;
+}
+
 /* Kernel route reflection. */
 static int kernel_read(struct thread *thread) {
 	struct zebra_vrf *zvrf = (struct zebra_vrf *) THREAD_ARG(thread);
@@ -1765,21 +2640,23 @@ static int kernel_read(struct thread *thread) {
 /* Filter out messages from self that occur on listener socket,
    caused by our actions on the command socket
  */
-static void netlink_install_filter(int sock, __u32 pid) {
+static void netlink_install_filter(int sock, __u32 pid, __u32 dplane_pid) {
 	struct sock_filter filter[] = {
 		/* 0: ldh [4]	          */
 		BPF_STMT(BPF_LD | BPF_ABS | BPF_H, offsetof(struct nlmsghdr, nlmsg_type)),
-		/* 1: jeq 0x18 jt 3 jf 6  */
+		/* 1: jeq 0x18 jt 3 jf 7  */
 		BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, htons(RTM_NEWROUTE), 1, 0),
-		/* 2: jeq 0x19 jt 3 jf 6  */
-		BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, htons(RTM_DELROUTE), 0, 3),
+		/* 2: jeq 0x19 jt 3 jf 7  */
+		BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, htons(RTM_DELROUTE), 0, 4),
 		/* 3: ldw [12]		  */
 		BPF_STMT(BPF_LD | BPF_ABS | BPF_W, offsetof(struct nlmsghdr, nlmsg_pid)),
-		/* 4: jeq XX  jt 5 jf 6   */
-		BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, htonl(pid), 0, 1),
-		/* 5: ret 0    (skip)     */
+		/* 4: jeq XX  jt 6 jf 5   */
+		BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, htonl(pid), 1, 0),
+		/* 5: jeq YY  jt 6 jf 7   */
+		BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, htonl(dplane_pid), 0, 1),
+		/* 6: ret 0    (skip)     */
 		BPF_STMT(BPF_RET | BPF_K, 0),
-		/* 6: ret 0xffff (keep)   */
+		/* 7: ret 0xffff (keep)   */
 		BPF_STMT(BPF_RET | BPF_K, 0xffff),
 	};
 
@@ -1804,11 +2681,12 @@ void kernel_init(struct zebra_vrf *zvrf) {
 #endif /* HAVE_IPV6 */
 	netlink_socket(&zvrf->netlink, groups, zvrf->vrf_id);
 	netlink_socket(&zvrf->netlink_cmd, 0, zvrf->vrf_id);
+	if(nl_batch) {
+		netlink_socket(&zvrf->netlink_dplane, 0, zvrf->vrf_id);
+	}
 
 	/* Register kernel socket. */
 	if(zvrf->netlink.sock > 0) {
-		size_t bufsize = MAX(nl_rcvbufsize, 2 * sysconf(_SC_PAGESIZE));
-
 		/* Only want non-blocking on the netlink event socket */
 		if(fcntl(zvrf->netlink.sock, F_SETFL, O_NONBLOCK) < 0) {
 			zlog_err("Can't set %s socket flags: %s", zvrf->netlink.name, safe_strerror(errno));
@@ -1819,16 +2697,16 @@ void kernel_init(struct zebra_vrf *zvrf) {
 			netlink_recvbuf(&zvrf->netlink, nl_rcvbufsize);
 		}
 
-		nl_rcvbuf.p = XMALLOC(MTYPE_NETLINK_RCVBUF, bufsize);
-		nl_rcvbuf.size = bufsize;
+		netlink_rcvbuf_grow(NL_RCV_SLOT_SIZE);
 
-		netlink_install_filter(zvrf->netlink.sock, zvrf->netlink_cmd.snl.nl_pid);
+		netlink_install_filter(zvrf->netlink.sock, zvrf->netlink_cmd.snl.nl_pid, nl_batch ? zvrf->netlink_dplane.snl.nl_pid : zvrf->netlink_cmd.snl.nl_pid);
 		zvrf->t_netlink = thread_add_read(zebrad.master, kernel_read, zvrf, zvrf->netlink.sock);
 	}
 }
 
 void kernel_terminate(struct zebra_vrf *zvrf) {
 	THREAD_READ_OFF(zvrf->t_netlink);
+	netlink_batch_sync();
 
 	if(zvrf->netlink.sock >= 0) {
 		close(zvrf->netlink.sock);
@@ -1839,6 +2717,11 @@ void kernel_terminate(struct zebra_vrf *zvrf) {
 		close(zvrf->netlink_cmd.sock);
 		zvrf->netlink_cmd.sock = -1;
 	}
+
+	if(zvrf->netlink_dplane.sock >= 0) {
+		close(zvrf->netlink_dplane.sock);
+		zvrf->netlink_dplane.sock = -1;
+	}
 }
 
 /*
@@ -354,3 +354,39 @@ int kernel_route_rib(struct prefix *p, struct rib *old, struct rib *new) {
 
 	return route;
 }
+
+/* Routes go to the kernel as they come */
+void kernel_route_flush(void) {
+	return;
+}
+
+void kernel_privs_hold(void) {
+	return;
+}
+
+void kernel_privs_release(void) {
+	return;
+}
+
+/* Routing sockets know no nexthop objects, routes using a nexthop group
+ * are installed with its nexthops. */
+int kernel_nhg_install(struct zebra_nhg *nhg) {
+	return -1;
+}
+
+void kernel_nhg_uninstall(struct zebra_nhg *nhg) {
+	return;
+}
+
+/* Routing sockets can't be dumped a slice at a time, there's no audit */
+int kernel_audit_start(struct zebra_vrf *zvrf, afi_t afi) {
+	return -1;
+}
+
+int kernel_audit_read(struct zebra_vrf *zvrf, int budget) {
+	return -1;
+}
+
+void kernel_audit_stop(struct zebra_vrf *zvrf) {
+	return;
+}
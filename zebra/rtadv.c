@@ -64,8 +64,6 @@ extern struct zebra_t zebrad;
 enum rtadv_event {
 	RTADV_START,
 	RTADV_STOP,
-	RTADV_TIMER,
-	RTADV_TIMER_MSEC,
 	RTADV_READ
 };
 
@@ -119,60 +117,47 @@ static int rtadv_recv_packet(int sock, u_char *buf, int buflen, struct sockaddr_
 }
 
 	#define RTADV_MSG_SIZE 4096
+	/* Advertisements put on the socket at once */
+	#define RTADV_SEND_BATCH 64
+	/* The first advertisement of an interface goes out at random
+	   within this many milliseconds, so that many interfaces starting
+	   together do not all advertise together. */
+	#define RTADV_INITIAL_SPREAD 1000
+	/* RFC4861 10 */
+	#define MAX_INITIAL_RTR_ADVERT_INTERVAL 16000
+	#define MAX_INITIAL_RTR_ADVERTISEMENTS 3
+
+static void rtadv_payload_reset(struct zebra_if *zif) {
+	if(zif->rtadv.payload) {
+		XFREE(MTYPE_RTADV_PAYLOAD, zif->rtadv.payload);
+	}
+	zif->rtadv.payload_len = 0;
+}
 
-/* Send router advertisement packet. */
-static void rtadv_send_packet(int sock, struct interface *ifp) {
-	struct msghdr msg;
-	struct iovec iov;
-	struct cmsghdr *cmsgptr;
-	struct in6_pktinfo *pkt;
-	struct sockaddr_in6 addr;
-	#ifdef HAVE_STRUCT_SOCKADDR_DL
-	struct sockaddr_dl *sdl;
-	#endif /* HAVE_STRUCT_SOCKADDR_DL */
-	static void *adata = NULL;
+/* Make the router advertisement message of an interface, unless the
+   one made last is still good. */
+static void rtadv_payload_make(struct interface *ifp) {
 	unsigned char buf[RTADV_MSG_SIZE];
 	struct nd_router_advert *rtadv;
-	int ret;
 	int len = 0;
+	int hwaddr = -1;
 	struct zebra_if *zif;
 	struct rtadv_prefix *rprefix;
-	u_char all_nodes_addr[] = { 0xff, 0x02, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1 };
 	struct listnode *node;
 	u_int16_t pkt_RouterLifetime;
 
-	/*
-   * Allocate control message bufffer.  This is dynamic because
-   * CMSG_SPACE is not guaranteed not to call a function.  Note that
-   * the size will be different on different architectures due to
-   * differing alignment rules.
-   */
-	if(adata == NULL) {
-		/* XXX Free on shutdown. */
-		adata = malloc(CMSG_SPACE(sizeof(struct in6_pktinfo)));
-
-		if(adata == NULL) {
-			zlog_err("rtadv_send_packet: can't malloc control data\n");
-		}
-	}
-
-	/* Logging of packet. */
-	if(IS_ZEBRA_DEBUG_PACKET) {
-		zlog_debug("Router advertisement send to %s", ifp->name);
-	}
-
-	/* Fill in sockaddr_in6. */
-	memset(&addr, 0, sizeof(struct sockaddr_in6));
-	addr.sin6_family = AF_INET6;
-	#ifdef SIN6_LEN
-	addr.sin6_len = sizeof(struct sockaddr_in6);
-	#endif /* SIN6_LEN */
-	addr.sin6_port = htons(IPPROTO_ICMPV6);
-	IPV6_ADDR_COPY(&addr.sin6_addr, all_nodes_addr);
-
 	/* Fetch interface information. */
 	zif = ifp->info;
 
+	if(zif->rtadv.payload) {
+		hwaddr = zif->rtadv.payload_hwaddr;
+		if(hwaddr < 0 ? ifp->hw_addr_len == 0 : (ifp->hw_addr_len != 0 && zif->rtadv.payload[hwaddr - 1] == ((ifp->hw_addr_len + 9) >> 3) && !memcmp(zif->rtadv.payload + hwaddr, ifp->hw_addr, ifp->hw_addr_len))) {
+			return;
+		}
+		rtadv_payload_reset(zif);
+		hwaddr = -1;
+	}
+
 	/* Make router advertisement message. */
 	rtadv = (struct nd_router_advert *) buf;
 
@@ -286,6 +271,7 @@ static void rtadv_send_packet(int sock, struct interface *ifp) {
          the link address does not end on an octet boundary. */
 		buf[len++] = (ifp->hw_addr_len + 9) >> 3;
 
+		hwaddr = len;
 		memcpy(buf + len, ifp->hw_addr, ifp->hw_addr_len);
 		len += ifp->hw_addr_len;
 
@@ -304,73 +290,199 @@ static void rtadv_send_packet(int sock, struct interface *ifp) {
 		len += sizeof(struct nd_opt_mtu);
 	}
 
-	msg.msg_name = (void *) &addr;
-	msg.msg_namelen = sizeof(struct sockaddr_in6);
-	msg.msg_iov = &iov;
-	msg.msg_iovlen = 1;
-	msg.msg_control = (void *) adata;
-	msg.msg_controllen = CMSG_SPACE(sizeof(struct in6_pktinfo));
-	msg.msg_flags = 0;
-	iov.iov_base = buf;
-	iov.iov_len = len;
+	zif->rtadv.payload = XMALLOC(MTYPE_RTADV_PAYLOAD, len);
+	memcpy(zif->rtadv.payload, buf, len);
+	zif->rtadv.payload_len = len;
+	zif->rtadv.payload_hwaddr = hwaddr;
+}
 
-	cmsgptr = ZCMSG_FIRSTHDR(&msg);
-	cmsgptr->cmsg_len = CMSG_LEN(sizeof(struct in6_pktinfo));
-	cmsgptr->cmsg_level = IPPROTO_IPV6;
-	cmsgptr->cmsg_type = IPV6_PKTINFO;
+/* Send the advertisements due: RTADV_SEND_BATCH at a time, with one
+   sendmmsg() where there is one. */
+static int rtadv_send(struct thread *thread) {
+	struct zebra_vrf *zvrf = THREAD_ARG(thread);
+	struct mmsghdr msgs[RTADV_SEND_BATCH];
+	struct iovec iov[RTADV_SEND_BATCH];
+	struct interface *ifps[RTADV_SEND_BATCH];
+	union {
+		char buf[CMSG_SPACE(sizeof(struct in6_pktinfo))];
+		struct cmsghdr align;
+	} adata[RTADV_SEND_BATCH];
+	struct cmsghdr *cmsgptr;
+	struct in6_pktinfo *pkt;
+	struct sockaddr_in6 addr;
+	struct listnode *node;
+	struct interface *ifp;
+	struct zebra_if *zif;
+	u_char all_nodes_addr[] = { 0xff, 0x02, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1 };
+	int i, n, ret;
 
-	pkt = (struct in6_pktinfo *) CMSG_DATA(cmsgptr);
-	memset(&pkt->ipi6_addr, 0, sizeof(struct in6_addr));
-	pkt->ipi6_ifindex = ifp->ifindex;
+	zvrf->rtadv.ra_send = NULL;
 
-	ret = sendmsg(sock, &msg, 0);
-	if(ret < 0) {
-		zlog_err("rtadv_send_packet: sendmsg %d (%s)\n", errno, safe_strerror(errno));
+	/* Fill in sockaddr_in6. */
+	memset(&addr, 0, sizeof(struct sockaddr_in6));
+	addr.sin6_family = AF_INET6;
+	#ifdef SIN6_LEN
+	addr.sin6_len = sizeof(struct sockaddr_in6);
+	#endif /* SIN6_LEN */
+	addr.sin6_port = htons(IPPROTO_ICMPV6);
+	IPV6_ADDR_COPY(&addr.sin6_addr, all_nodes_addr);
+
+	while(!list_isempty(zvrf->rtadv.send_q)) {
+		memset(msgs, 0, sizeof(msgs));
+		for(n = 0; n < RTADV_SEND_BATCH && (node = listhead(zvrf->rtadv.send_q)) != NULL;) {
+			ifp = listgetdata(node);
+			list_delete_node(zvrf->rtadv.send_q, node);
+			zif = ifp->info;
+			zif->rtadv.on_send_q = 0;
+
+			if(!zif->rtadv.AdvSendAdvertisements || if_is_loopback(ifp) || !if_is_operative(ifp)) {
+				continue;
+			}
+
+			/* Logging of packet. */
+			if(IS_ZEBRA_DEBUG_PACKET) {
+				zlog_debug("Router advertisement send to %s", ifp->name);
+			}
+
+			rtadv_payload_make(ifp);
+
+			iov[n].iov_base = zif->rtadv.payload;
+			iov[n].iov_len = zif->rtadv.payload_len;
+			msgs[n].msg_hdr.msg_name = (void *) &addr;
+			msgs[n].msg_hdr.msg_namelen = sizeof(struct sockaddr_in6);
+			msgs[n].msg_hdr.msg_iov = &iov[n];
+			msgs[n].msg_hdr.msg_iovlen = 1;
+			msgs[n].msg_hdr.msg_control = (void *) adata[n].buf;
+			msgs[n].msg_hdr.msg_controllen = CMSG_SPACE(sizeof(struct in6_pktinfo));
+
+			cmsgptr = ZCMSG_FIRSTHDR(&msgs[n].msg_hdr);
+			cmsgptr->cmsg_len = CMSG_LEN(sizeof(struct in6_pktinfo));
+			cmsgptr->cmsg_level = IPPROTO_IPV6;
+			cmsgptr->cmsg_type = IPV6_PKTINFO;
+
+			pkt = (struct in6_pktinfo *) CMSG_DATA(cmsgptr);
+			memset(&pkt->ipi6_addr, 0, sizeof(struct in6_addr));
+			pkt->ipi6_ifindex = ifp->ifindex;
+
+			ifps[n++] = ifp;
+		}
+
+		/* One that fails is told of and skipped. */
+		for(i = 0; i < n; i += ret) {
+	#ifdef HAVE_SENDMMSG
+			ret = sendmmsg(zvrf->rtadv.sock, msgs + i, n - i, 0);
+	#else
+			ret = sendmsg(zvrf->rtadv.sock, &msgs[i].msg_hdr, 0) < 0 ? -1 : 1;
+	#endif /* HAVE_SENDMMSG */
+			if(ret < 0) {
+				zlog_err("rtadv_send: sendmsg on %s %d (%s)\n", ifps[i]->name, errno, safe_strerror(errno));
+				ret = 1;
+			}
+		}
+
+		if(thread_should_yield(thread)) {
+			break;
+		}
+	}
+
+	if(!list_isempty(zvrf->rtadv.send_q)) {
+		zvrf->rtadv.ra_send = thread_add_event(zebrad.master, rtadv_send, zvrf, 0);
 	}
+	return 0;
 }
 
-static int rtadv_timer(struct thread *thread) {
-	struct zebra_vrf *zvrf = THREAD_ARG(thread);
-	struct listnode *node, *nnode;
-	struct interface *ifp;
-	struct zebra_if *zif;
-	int period;
+/* Have an advertisement sent on the interface with the others due. */
+static void rtadv_send_packet(struct interface *ifp) {
+	struct zebra_if *zif = ifp->info;
+	struct zebra_vrf *zvrf = vrf_info_lookup(ifp->vrf_id);
+
+	if(zif->rtadv.on_send_q || zvrf == NULL || zvrf->rtadv.send_q == NULL) {
+		return;
+	}
+	listnode_add(zvrf->rtadv.send_q, ifp);
+	zif->rtadv.on_send_q = 1;
+	if(!zvrf->rtadv.ra_send) {
+		zvrf->rtadv.ra_send = thread_add_event(zebrad.master, rtadv_send, zvrf, 0);
+	}
+}
+
+static int rtadv_timer(struct thread *thread);
+
+/* Arm the interface's advertisement timer, in milliseconds.  Whole
+   seconds go on the thread master's timer wheel, so with thousands of
+   interfaces arming and firing costs the same as with one; the
+   interfaces due in the same second are then sent together. */
+static void rtadv_timer_set(struct interface *ifp, int delay) {
+	struct zebra_if *zif = ifp->info;
 
-	zvrf->rtadv.ra_timer = NULL;
-	if(zvrf->rtadv.adv_msec_if_count == 0) {
-		period = 1000; /* 1 s */
-		rtadv_event(zvrf, RTADV_TIMER, 1 /* 1 s */);
+	THREAD_OFF(zif->rtadv.t_adv);
+	if(zif->rtadv.MaxRtrAdvInterval % 1000) {
+		zif->rtadv.t_adv = thread_add_timer_msec(zebrad.master, rtadv_timer, ifp, delay);
 	} else {
-		period = 10; /* 10 ms */
-		rtadv_event(zvrf, RTADV_TIMER_MSEC, 10 /* 10 ms */);
+		zif->rtadv.t_adv = thread_add_timer(zebrad.master, rtadv_timer, ifp, (delay + 500) / 1000);
 	}
+}
 
-	for(ALL_LIST_ELEMENTS(vrf_iflist(zvrf->vrf_id), node, nnode, ifp)) {
-		if(if_is_loopback(ifp) || !if_is_operative(ifp)) {
-			continue;
-		}
+/* Unsolicited advertisements go out at random between the minimum
+   and the maximum interval, the first few no further apart than
+   MAX_INITIAL_RTR_ADVERT_INTERVAL [RFC4861 6.2.4]. */
+static int rtadv_timer(struct thread *thread) {
+	struct interface *ifp = THREAD_ARG(thread);
+	struct zebra_if *zif = ifp->info;
+	int delay;
 
-		zif = ifp->info;
+	zif->rtadv.t_adv = NULL;
+	if(!zif->rtadv.AdvSendAdvertisements) {
+		return 0;
+	}
 
-		if(zif->rtadv.AdvSendAdvertisements) {
-			zif->rtadv.AdvIntervalTimer -= period;
-			if(zif->rtadv.AdvIntervalTimer <= 0) {
-				/* FIXME: using MaxRtrAdvInterval each time isn't what section
-	         6.2.4 of RFC4861 tells to do. */
-				zif->rtadv.AdvIntervalTimer = zif->rtadv.MaxRtrAdvInterval;
-				rtadv_send_packet(zvrf->rtadv.sock, ifp);
-			}
-		}
+	if(!if_is_loopback(ifp) && if_is_operative(ifp)) {
+		rtadv_send_packet(ifp);
+		zif->rtadv.initial_sent++;
 	}
+
+	delay = zif->rtadv.MinRtrAdvInterval + random() % (zif->rtadv.MaxRtrAdvInterval - zif->rtadv.MinRtrAdvInterval + 1);
+	if(zif->rtadv.initial_sent < MAX_INITIAL_RTR_ADVERTISEMENTS && delay > MAX_INITIAL_RTR_ADVERT_INTERVAL) {
+		delay = MAX_INITIAL_RTR_ADVERT_INTERVAL;
+	}
+	rtadv_timer_set(ifp, delay);
 	return 0;
 }
 
+/* Start advertising on an interface, or start over after a change of
+   interval. */
+static void rtadv_if_start(struct interface *ifp) {
+	struct zebra_if *zif = ifp->info;
+
+	zif->rtadv.initial_sent = 0;
+	rtadv_timer_set(ifp, random() % MIN(zif->rtadv.MaxRtrAdvInterval, RTADV_INITIAL_SPREAD));
+}
+
+/* Stop it, with the interface going away or advertising turned off. */
+static void rtadv_if_stop(struct interface *ifp) {
+	struct zebra_if *zif = ifp->info;
+	struct zebra_vrf *zvrf;
+
+	THREAD_OFF(zif->rtadv.t_adv);
+	if(zif->rtadv.on_send_q) {
+		if((zvrf = vrf_info_lookup(ifp->vrf_id)) != NULL && zvrf->rtadv.send_q != NULL) {
+			listnode_delete(zvrf->rtadv.send_q, ifp);
+		}
+		zif->rtadv.on_send_q = 0;
+	}
+	rtadv_payload_reset(zif);
+}
+
+void rtadv_if_delete(struct interface *ifp) {
+	rtadv_if_stop(ifp);
+}
+
 static void rtadv_process_solicit(struct interface *ifp) {
 	struct zebra_vrf *zvrf = vrf_info_lookup(ifp->vrf_id);
 
 	zlog_info("Router solicitation received on %s vrf %u", ifp->name, zvrf->vrf_id);
 
-	rtadv_send_packet(zvrf->rtadv.sock, ifp);
+	rtadv_send_packet(ifp);
 }
 
 static void rtadv_process_advert(void) {
@@ -563,6 +675,7 @@ static void rtadv_prefix_set(struct zebra_if *zif, struct rtadv_prefix *rp) {
 	rprefix->AdvOnLinkFlag = rp->AdvOnLinkFlag;
 	rprefix->AdvAutonomousFlag = rp->AdvAutonomousFlag;
 	rprefix->AdvRouterAddressFlag = rp->AdvRouterAddressFlag;
+	rtadv_payload_reset(zif);
 }
 
 static int rtadv_prefix_reset(struct zebra_if *zif, struct rtadv_prefix *rp) {
@@ -572,6 +685,7 @@ static int rtadv_prefix_reset(struct zebra_if *zif, struct rtadv_prefix *rp) {
 	if(rprefix != NULL) {
 		listnode_delete(zif->rtadv.AdvPrefixList, (void *) rprefix);
 		rtadv_prefix_free(rprefix);
+		rtadv_payload_reset(zif);
 		return 1;
 	} else {
 		return 0;
@@ -597,7 +711,7 @@ DEFUN(ipv6_nd_suppress_ra, ipv6_nd_suppress_ra_cmd, "ipv6 nd suppress-ra",
 
 	if(zif->rtadv.AdvSendAdvertisements) {
 		zif->rtadv.AdvSendAdvertisements = 0;
-		zif->rtadv.AdvIntervalTimer = 0;
+		rtadv_if_stop(ifp);
 		zvrf->rtadv.adv_if_count--;
 
 		if_leave_all_router(zvrf->rtadv.sock, ifp);
@@ -629,7 +743,7 @@ DEFUN(no_ipv6_nd_suppress_ra, no_ipv6_nd_suppress_ra_cmd, "no ipv6 nd suppress-r
 
 	if(!zif->rtadv.AdvSendAdvertisements) {
 		zif->rtadv.AdvSendAdvertisements = 1;
-		zif->rtadv.AdvIntervalTimer = 0;
+		rtadv_if_start(ifp);
 		zvrf->rtadv.adv_if_count++;
 
 		if_join_all_router(zvrf->rtadv.sock, ifp);
@@ -650,7 +764,6 @@ DEFUN(ipv6_nd_ra_interval_msec, ipv6_nd_ra_interval_msec_cmd, "ipv6 nd ra-interv
 	unsigned interval;
 	struct interface *ifp = (struct interface *) vty->index;
 	struct zebra_if *zif = ifp->info;
-	struct zebra_vrf *zvrf = vrf_info_lookup(ifp->vrf_id);
 
 	VTY_GET_INTEGER_RANGE("router advertisement interval", interval, argv[0], 70, 1800000);
 	if((zif->rtadv.AdvDefaultLifetime != -1 && interval > (unsigned) zif->rtadv.AdvDefaultLifetime * 1000)) {
@@ -658,17 +771,12 @@ DEFUN(ipv6_nd_ra_interval_msec, ipv6_nd_ra_interval_msec_cmd, "ipv6 nd ra-interv
 		return CMD_WARNING;
 	}
 
-	if(zif->rtadv.MaxRtrAdvInterval % 1000) {
-		zvrf->rtadv.adv_msec_if_count--;
-	}
-
-	if(interval % 1000) {
-		zvrf->rtadv.adv_msec_if_count++;
-	}
-
 	zif->rtadv.MaxRtrAdvInterval = interval;
 	zif->rtadv.MinRtrAdvInterval = 0.33 * interval;
-	zif->rtadv.AdvIntervalTimer = 0;
+	rtadv_payload_reset(zif);
+	if(zif->rtadv.AdvSendAdvertisements) {
+		rtadv_if_start(ifp);
+	}
 
 	return CMD_SUCCESS;
 }
@@ -681,7 +789,6 @@ DEFUN(ipv6_nd_ra_interval, ipv6_nd_ra_interval_cmd, "ipv6 nd ra-interval <1-1800
 	unsigned interval;
 	struct interface *ifp = (struct interface *) vty->index;
 	struct zebra_if *zif = ifp->info;
-	struct zebra_vrf *zvrf = vrf_info_lookup(ifp->vrf_id);
 
 	VTY_GET_INTEGER_RANGE("router advertisement interval", interval, argv[0], 1, 1800);
 	if((zif->rtadv.AdvDefaultLifetime != -1 && interval > (unsigned) zif->rtadv.AdvDefaultLifetime)) {
@@ -689,16 +796,15 @@ DEFUN(ipv6_nd_ra_interval, ipv6_nd_ra_interval_cmd, "ipv6 nd ra-interval <1-1800
 		return CMD_WARNING;
 	}
 
-	if(zif->rtadv.MaxRtrAdvInterval % 1000) {
-		zvrf->rtadv.adv_msec_if_count--;
-	}
-
 	/* convert to milliseconds */
 	interval = interval * 1000;
 
 	zif->rtadv.MaxRtrAdvInterval = interval;
 	zif->rtadv.MinRtrAdvInterval = 0.33 * interval;
-	zif->rtadv.AdvIntervalTimer = 0;
+	rtadv_payload_reset(zif);
+	if(zif->rtadv.AdvSendAdvertisements) {
+		rtadv_if_start(ifp);
+	}
 
 	return CMD_SUCCESS;
 }
@@ -709,19 +815,16 @@ DEFUN(no_ipv6_nd_ra_interval, no_ipv6_nd_ra_interval_cmd, "no ipv6 nd ra-interva
 	     "Router Advertisement interval\n") {
 	struct interface *ifp;
 	struct zebra_if *zif;
-	struct zebra_vrf *zvrf;
 
 	ifp = (struct interface *) vty->index;
 	zif = ifp->info;
-	zvrf = vrf_info_lookup(ifp->vrf_id);
-
-	if(zif->rtadv.MaxRtrAdvInterval % 1000) {
-		zvrf->rtadv.adv_msec_if_count--;
-	}
 
 	zif->rtadv.MaxRtrAdvInterval = RTADV_MAX_RTR_ADV_INTERVAL;
 	zif->rtadv.MinRtrAdvInterval = RTADV_MIN_RTR_ADV_INTERVAL;
-	zif->rtadv.AdvIntervalTimer = zif->rtadv.MaxRtrAdvInterval;
+	rtadv_payload_reset(zif);
+	if(zif->rtadv.AdvSendAdvertisements) {
+		rtadv_if_start(ifp);
+	}
 
 	return CMD_SUCCESS;
 }
@@ -761,6 +864,7 @@ DEFUN(ipv6_nd_ra_lifetime, ipv6_nd_ra_lifetime_cmd, "ipv6 nd ra-lifetime <0-9000
 	}
 
 	zif->rtadv.AdvDefaultLifetime = lifetime;
+	rtadv_payload_reset(zif);
 
 	return CMD_SUCCESS;
 }
@@ -776,6 +880,7 @@ DEFUN(no_ipv6_nd_ra_lifetime, no_ipv6_nd_ra_lifetime_cmd, "no ipv6 nd ra-lifetim
 	zif = ifp->info;
 
 	zif->rtadv.AdvDefaultLifetime = -1;
+	rtadv_payload_reset(zif);
 
 	return CMD_SUCCESS;
 }
@@ -794,6 +899,7 @@ DEFUN(ipv6_nd_reachable_time, ipv6_nd_reachable_time_cmd, "ipv6 nd reachable-tim
 	struct interface *ifp = (struct interface *) vty->index;
 	struct zebra_if *zif = ifp->info;
 	VTY_GET_INTEGER_RANGE("reachable time", zif->rtadv.AdvReachableTime, argv[0], 1, RTADV_MAX_REACHABLE_TIME);
+	rtadv_payload_reset(zif);
 	return CMD_SUCCESS;
 }
 
@@ -808,6 +914,7 @@ DEFUN(no_ipv6_nd_reachable_time, no_ipv6_nd_reachable_time_cmd, "no ipv6 nd reac
 	zif = ifp->info;
 
 	zif->rtadv.AdvReachableTime = 0;
+	rtadv_payload_reset(zif);
 
 	return CMD_SUCCESS;
 }
@@ -826,6 +933,7 @@ DEFUN(ipv6_nd_homeagent_preference, ipv6_nd_homeagent_preference_cmd, "ipv6 nd h
 	struct interface *ifp = (struct interface *) vty->index;
 	struct zebra_if *zif = ifp->info;
 	VTY_GET_INTEGER_RANGE("home agent preference", zif->rtadv.HomeAgentPreference, argv[0], 0, 65535);
+	rtadv_payload_reset(zif);
 	return CMD_SUCCESS;
 }
 
@@ -840,6 +948,7 @@ DEFUN(no_ipv6_nd_homeagent_preference, no_ipv6_nd_homeagent_preference_cmd, "no
 	zif = ifp->info;
 
 	zif->rtadv.HomeAgentPreference = 0;
+	rtadv_payload_reset(zif);
 
 	return CMD_SUCCESS;
 }
@@ -858,6 +967,7 @@ DEFUN(ipv6_nd_homeagent_lifetime, ipv6_nd_homeagent_lifetime_cmd, "ipv6 nd home-
 	struct interface *ifp = (struct interface *) vty->index;
 	struct zebra_if *zif = ifp->info;
 	VTY_GET_INTEGER_RANGE("home agent lifetime", zif->rtadv.HomeAgentLifetime, argv[0], 0, RTADV_MAX_HALIFETIME);
+	rtadv_payload_reset(zif);
 	return CMD_SUCCESS;
 }
 
@@ -872,6 +982,7 @@ DEFUN(no_ipv6_nd_homeagent_lifetime, no_ipv6_nd_homeagent_lifetime_cmd, "no ipv6
 	zif = ifp->info;
 
 	zif->rtadv.HomeAgentLifetime = -1;
+	rtadv_payload_reset(zif);
 
 	return CMD_SUCCESS;
 }
@@ -893,6 +1004,7 @@ DEFUN(ipv6_nd_managed_config_flag, ipv6_nd_managed_config_flag_cmd, "ipv6 nd man
 	zif = ifp->info;
 
 	zif->rtadv.AdvManagedFlag = 1;
+	rtadv_payload_reset(zif);
 
 	return CMD_SUCCESS;
 }
@@ -908,6 +1020,7 @@ DEFUN(no_ipv6_nd_managed_config_flag, no_ipv6_nd_managed_config_flag_cmd, "no ip
 	zif = ifp->info;
 
 	zif->rtadv.AdvManagedFlag = 0;
+	rtadv_payload_reset(zif);
 
 	return CMD_SUCCESS;
 }
@@ -923,6 +1036,7 @@ DEFUN(ipv6_nd_homeagent_config_flag, ipv6_nd_homeagent_config_flag_cmd, "ipv6 nd
 	zif = ifp->info;
 
 	zif->rtadv.AdvHomeAgentFlag = 1;
+	rtadv_payload_reset(zif);
 
 	return CMD_SUCCESS;
 }
@@ -938,6 +1052,7 @@ DEFUN(no_ipv6_nd_homeagent_config_flag, no_ipv6_nd_homeagent_config_flag_cmd, "n
 	zif = ifp->info;
 
 	zif->rtadv.AdvHomeAgentFlag = 0;
+	rtadv_payload_reset(zif);
 
 	return CMD_SUCCESS;
 }
@@ -953,6 +1068,7 @@ DEFUN(ipv6_nd_adv_interval_config_option, ipv6_nd_adv_interval_config_option_cmd
 	zif = ifp->info;
 
 	zif->rtadv.AdvIntervalOption = 1;
+	rtadv_payload_reset(zif);
 
 	return CMD_SUCCESS;
 }
@@ -968,6 +1084,7 @@ DEFUN(no_ipv6_nd_adv_interval_config_option, no_ipv6_nd_adv_interval_config_opti
 	zif = ifp->info;
 
 	zif->rtadv.AdvIntervalOption = 0;
+	rtadv_payload_reset(zif);
 
 	return CMD_SUCCESS;
 }
@@ -983,6 +1100,7 @@ DEFUN(ipv6_nd_other_config_flag, ipv6_nd_other_config_flag_cmd, "ipv6 nd other-c
 	zif = ifp->info;
 
 	zif->rtadv.AdvOtherConfigFlag = 1;
+	rtadv_payload_reset(zif);
 
 	return CMD_SUCCESS;
 }
@@ -998,6 +1116,7 @@ DEFUN(no_ipv6_nd_other_config_flag, no_ipv6_nd_other_config_flag_cmd, "no ipv6 n
 	zif = ifp->info;
 
 	zif->rtadv.AdvOtherConfigFlag = 0;
+	rtadv_payload_reset(zif);
 
 	return CMD_SUCCESS;
 }
@@ -1261,6 +1380,7 @@ DEFUN(ipv6_nd_router_preference, ipv6_nd_router_preference_cmd, "ipv6 nd router-
 	while(0 != rtadv_pref_strs[i]) {
 		if(strncmp(argv[0], rtadv_pref_strs[i], 1) == 0) {
 			zif->rtadv.DefaultPreference = i;
+			rtadv_payload_reset(zif);
 			return CMD_SUCCESS;
 		}
 		i++;
@@ -1280,6 +1400,7 @@ DEFUN(no_ipv6_nd_router_preference, no_ipv6_nd_router_preference_cmd, "no ipv6 n
 	zif = ifp->info;
 
 	zif->rtadv.DefaultPreference = RTADV_PREF_MEDIUM; /* Default per RFC4191. */
+	rtadv_payload_reset(zif);
 
 	return CMD_SUCCESS;
 }
@@ -1300,6 +1421,7 @@ DEFUN(ipv6_nd_mtu, ipv6_nd_mtu_cmd, "ipv6 nd mtu <1-65535>",
 	struct interface *ifp = (struct interface *) vty->index;
 	struct zebra_if *zif = ifp->info;
 	VTY_GET_INTEGER_RANGE("MTU", zif->rtadv.AdvLinkMTU, argv[0], 1, 65535);
+	rtadv_payload_reset(zif);
 	return CMD_SUCCESS;
 }
 
@@ -1310,6 +1432,7 @@ DEFUN(no_ipv6_nd_mtu, no_ipv6_nd_mtu_cmd, "no ipv6 nd mtu",
 	struct interface *ifp = (struct interface *) vty->index;
 	struct zebra_if *zif = ifp->info;
 	zif->rtadv.AdvLinkMTU = 0;
+	rtadv_payload_reset(zif);
 	return CMD_SUCCESS;
 }
 
@@ -1417,30 +1540,13 @@ static void rtadv_event(struct zebra_vrf *zvrf, enum rtadv_event event, int val)
 			if(!rtadv->ra_read) {
 				rtadv->ra_read = thread_add_read(zebrad.master, rtadv_read, zvrf, val);
 			}
-			if(!rtadv->ra_timer) {
-				rtadv->ra_timer = thread_add_event(zebrad.master, rtadv_timer, zvrf, 0);
-			}
 			break;
 		case RTADV_STOP:
-			if(rtadv->ra_timer) {
-				thread_cancel(rtadv->ra_timer);
-				rtadv->ra_timer = NULL;
-			}
 			if(rtadv->ra_read) {
 				thread_cancel(rtadv->ra_read);
 				rtadv->ra_read = NULL;
 			}
 			break;
-		case RTADV_TIMER:
-			if(!rtadv->ra_timer) {
-				rtadv->ra_timer = thread_add_timer(zebrad.master, rtadv_timer, zvrf, val);
-			}
-			break;
-		case RTADV_TIMER_MSEC:
-			if(!rtadv->ra_timer) {
-				rtadv->ra_timer = thread_add_timer_msec(zebrad.master, rtadv_timer, zvrf, val);
-			}
-			break;
 		case RTADV_READ:
 			if(!rtadv->ra_read) {
 				rtadv->ra_read = thread_add_read(zebrad.master, rtadv_read, zvrf, val);
@@ -1453,18 +1559,33 @@ static void rtadv_event(struct zebra_vrf *zvrf, enum rtadv_event event, int val)
 
 void rtadv_init(struct zebra_vrf *zvrf) {
 	zvrf->rtadv.sock = rtadv_make_socket(zvrf->vrf_id);
+	zvrf->rtadv.send_q = list_new();
 }
 
 void rtadv_terminate(struct zebra_vrf *zvrf) {
+	struct interface *ifp;
+	struct zebra_if *zif;
+
 	rtadv_event(zvrf, RTADV_STOP, 0);
 
+	THREAD_OFF(zvrf->rtadv.ra_send);
+	if(zvrf->rtadv.send_q) {
+		while(!list_isempty(zvrf->rtadv.send_q)) {
+			ifp = listgetdata(listhead(zvrf->rtadv.send_q));
+			zif = ifp->info;
+			zif->rtadv.on_send_q = 0;
+			list_delete_node(zvrf->rtadv.send_q, listhead(zvrf->rtadv.send_q));
+		}
+		list_delete(zvrf->rtadv.send_q);
+		zvrf->rtadv.send_q = NULL;
+	}
+
 	if(zvrf->rtadv.sock >= 0) {
 		close(zvrf->rtadv.sock);
 		zvrf->rtadv.sock = -1;
 	}
 
 	zvrf->rtadv.adv_if_count = 0;
-	zvrf->rtadv.adv_msec_if_count = 0;
 }
 
 void rtadv_cmd_init(void) {
@@ -1565,6 +1686,10 @@ void rtadv_terminate(struct zebra_vrf *zvrf) {
 	/* Empty.*/;
 }
 
+void rtadv_if_delete(struct interface *ifp) {
+	/* Empty.*/;
+}
+
 void rtadv_cmd_init(void) {
 	/* Empty.*/;
 }
@@ -101,6 +101,7 @@ extern const char *rtadv_pref_strs[];
 
 extern void rtadv_init(struct zebra_vrf *);
 extern void rtadv_terminate(struct zebra_vrf *);
+extern void rtadv_if_delete(struct interface *);
 extern void rtadv_cmd_init(void);
 
 #endif /* _ZEBRA_RTADV_H */
@@ -37,6 +37,8 @@
 #include "zebra/debug.h"
 #include "zebra/router-id.h"
 #include "zebra/interface.h"
+#include "zebra/zebra_nhg.h"
+#include "zebra/rt.h"
 
 /* Zebra instance */
 struct zebra_t zebrad = {
@@ -115,7 +117,7 @@ DEFUN(test_interface_state, test_interface_state_cmd, "state (up|down)",
 
 	ifp = vty->index;
 	if(ifp->ifindex == IFINDEX_INTERNAL) {
-		ifp->ifindex = ++test_ifindex;
+		if_set_index(ifp, ++test_ifindex);
 		ifp->mtu = 1500;
 		ifp->flags = IFF_BROADCAST | IFF_MULTICAST;
 	}
@@ -198,7 +200,10 @@ static int zebra_vrf_enable(vrf_id_t vrf_id, void **info) {
 	assert(zvrf);
 
 	kernel_init(zvrf);
+	kernel_privs_hold();
 	route_read(zvrf);
+	kernel_privs_release();
+	rib_audit_enable(zvrf);
 
 	return 0;
 }
@@ -222,6 +227,9 @@ static int zebra_vrf_disable(vrf_id_t vrf_id, void **info) {
 		}
 	}
 
+	rib_update_cancel(zvrf);
+	rib_audit_disable(zvrf);
+
 	kernel_terminate(zvrf);
 
 	return 0;
@@ -308,6 +316,7 @@ int main(int argc, char **argv) {
 
 	/* Zebra related initialize. */
 	rib_init();
+	zebra_nhg_init();
 	access_list_init();
 
 	/* Make kernel routing socket. */
@@ -0,0 +1,371 @@
+/* RIB processing microbenchmark.
+ *
+ * Runs the zebra RIB on its own, as testzebra does, over the null kernel
+ * backend, and feeds it routes by direct calls the way zserv would:
+ * batches of rib_add_ipv4_multipath() from an event thread, interleaved
+ * with the meta queue.  It then withdraws them again the same way.
+ *
+ * For either phase it reports routes/sec, and splits the time into
+ * injection (rib_add/rib_delete), nexthop resolution, kernel programming
+ * and the rest of meta queue processing, along with percentiles of the
+ * latency from a route's injection to its kernel install or removal.
+ *
+ * The null kernel costs next to nothing; -k adds a fixed cost to every
+ * kernel call, to see how the queue behaves behind a slow FIB.
+ *
+ * This file is part of Quagga.
+ *
+ * Quagga is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2, or (at your option) any
+ * later version.
+ *
+ * Quagga is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Quagga; see the file COPYING.  If not, write to the Free
+ * Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ * 02111-1307, USA.
+ */
+
+#include <zebra.h>
+
+#include "command.h"
+#include "thread.h"
+#include "filter.h"
+#include "memory.h"
+#include "prefix.h"
+#include "log.h"
+#include "vrf.h"
+#include "if.h"
+
+#include "zebra/rib.h"
+#include "zebra/zserv.h"
+#include "zebra/debug.h"
+#include "zebra/interface.h"
+#include "zebra/connected.h"
+#include "zebra/zebra_nhg.h"
+
+/* Zebra instance */
+struct zebra_t zebrad = {
+	.rtm_table_default = 0,
+};
+
+pid_t pid;
+struct thread_master *master;
+
+/* from zebra_rib.c */
+extern int rib_process_hold_time;
+extern u_int64_t rib_bench_resolve_nsec;
+
+enum bench_nexthop { NH_IFINDEX, NH_GATEWAY, NH_RECURSIVE };
+
+static unsigned long routes = 1000000;
+static unsigned long batch = 1000;
+static int npaths = 1;
+static enum bench_nexthop nhtype = NH_GATEWAY;
+static unsigned long kernel_cost_nsec;
+
+static struct interface *bench_ifp;
+
+/* per phase */
+static int deleting;
+static unsigned long injected, completed;
+static u_int64_t *injected_at, *latency;
+static u_int64_t inject_nsec, kernel_nsec;
+static u_int64_t phase_start, phase_end, phase_resolve;
+
+static u_int64_t now_nsec(void) {
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/* Route k is 11.0.0.0/24 + k */
+static void bench_prefix(unsigned long k, struct prefix_ipv4 *p) {
+	memset(p, 0, sizeof(*p));
+	p->family = AF_INET;
+	p->prefixlen = 24;
+	p->prefix.s_addr = htonl((11 << 24) + (k << 8));
+}
+
+static long bench_index(struct prefix *p) {
+	u_int32_t a = ntohl(p->u.prefix4.s_addr);
+
+	if(p->family != AF_INET || p->prefixlen != 24 || a < (11U << 24)) {
+		return -1;
+	}
+	a = (a - (11U << 24)) >> 8;
+	return a < routes ? (long) a : -1;
+}
+
+static int bench_report(struct thread *t);
+
+/* Called by kernel_null.c for every route it is asked to program. */
+extern int zebra_bench_kernel(struct prefix *, struct rib *, struct rib *);
+int zebra_bench_kernel(struct prefix *p, struct rib *old, struct rib *new) {
+	u_int64_t start = now_nsec(), end;
+	long k = bench_index(p);
+	struct nexthop *nexthop, *tnexthop;
+	int recursing;
+
+	/* take the nexthops into the FIB as rt_netlink.c does, so that
+	 * recursive nexthops have something to resolve over */
+	if(new) {
+		for(ALL_NEXTHOPS_RO(new->nexthop, nexthop, tnexthop, recursing)) {
+			if(!CHECK_FLAG(nexthop->flags, NEXTHOP_FLAG_RECURSIVE) && CHECK_FLAG(nexthop->flags, NEXTHOP_FLAG_ACTIVE)) {
+				SET_FLAG(nexthop->flags, NEXTHOP_FLAG_FIB);
+			}
+		}
+	}
+
+	if(kernel_cost_nsec) {
+		while(now_nsec() - start < kernel_cost_nsec) {
+			;
+		}
+	}
+	end = now_nsec();
+	kernel_nsec += end - start;
+
+	if(k >= 0 && !latency[k] && (deleting ? !new : new != NULL)) {
+		latency[k] = end - injected_at[k];
+		if(++completed == routes) {
+			phase_end = end;
+			thread_add_event(master, bench_report, NULL, 0);
+		}
+	}
+	return 0;
+}
+
+static void bench_add(unsigned long k) {
+	struct prefix_ipv4 p;
+	struct in_addr gate;
+	struct rib *rib;
+	int i;
+
+	rib = XCALLOC(MTYPE_RIB, sizeof(struct rib));
+	rib->type = ZEBRA_ROUTE_BGP;
+	rib->uptime = time(NULL);
+	rib->vrf_id = VRF_DEFAULT;
+	rib->table = zebrad.rtm_table_default;
+
+	for(i = 0; i < npaths; i++) {
+		switch(nhtype) {
+			case NH_IFINDEX: rib_nexthop_ifindex_add(rib, bench_ifp->ifindex + i); break;
+			case NH_GATEWAY:
+				gate.s_addr = htonl(0x0a000002 + i); /* 10.0.0.2 + i */
+				rib_nexthop_ipv4_add(rib, &gate, NULL);
+				break;
+			case NH_RECURSIVE:
+				SET_FLAG(rib->flags, ZEBRA_FLAG_INTERNAL | ZEBRA_FLAG_IBGP);
+				gate.s_addr = htonl(0x0a010001 + i); /* 10.1.0.1 + i */
+				rib_nexthop_ipv4_add(rib, &gate, NULL);
+				break;
+		}
+	}
+
+	bench_prefix(k, &p);
+	rib_add_ipv4_multipath(&p, rib, SAFI_UNICAST);
+}
+
+static void bench_delete(unsigned long k) {
+	struct prefix_ipv4 p;
+
+	bench_prefix(k, &p);
+	rib_delete_ipv4(ZEBRA_ROUTE_BGP, 0, &p, NULL, 0, VRF_DEFAULT, SAFI_UNICAST);
+}
+
+/* One zserv read's worth of routes per event. */
+static int bench_inject(struct thread *t) {
+	unsigned long end = injected + batch;
+	u_int64_t start;
+
+	if(end > routes) {
+		end = routes;
+	}
+
+	start = now_nsec();
+	for(; injected < end; injected++) {
+		injected_at[injected] = now_nsec();
+		if(deleting) {
+			bench_delete(injected);
+		} else {
+			bench_add(injected);
+		}
+	}
+	inject_nsec += now_nsec() - start;
+
+	if(injected < routes) {
+		thread_add_event(master, bench_inject, NULL, 0);
+	}
+	return 0;
+}
+
+static int cmp_u64(const void *a, const void *b) {
+	u_int64_t x = *(const u_int64_t *) a, y = *(const u_int64_t *) b;
+
+	return x < y ? -1 : x > y;
+}
+
+static int bench_start(struct thread *t);
+
+static int bench_report(struct thread *t) {
+	u_int64_t wall = phase_end - phase_start;
+	u_int64_t resolve = rib_bench_resolve_nsec - phase_resolve;
+
+	qsort(latency, routes, sizeof(*latency), cmp_u64);
+
+	printf("%s: %lu routes in %.3f s, %.0f routes/s\n", deleting ? "delete" : "add", routes, wall / 1e9, routes / (wall / 1e9));
+	printf("  inject      %8.3f s\n", inject_nsec / 1e9);
+	printf("  resolve     %8.3f s\n", resolve / 1e9);
+	printf("  kernel      %8.3f s\n", kernel_nsec / 1e9);
+	printf("  meta queue  %8.3f s  (rest)\n", (wall - inject_nsec - resolve - kernel_nsec) / 1e9);
+	printf("  latency ms  p50 %.3f  p90 %.3f  p99 %.3f  max %.3f\n", latency[routes / 2] / 1e6, latency[routes * 9 / 10] / 1e6, latency[routes * 99 / 100] / 1e6,
+	       latency[routes - 1] / 1e6);
+
+	if(deleting) {
+		exit(0);
+	}
+	deleting = 1;
+	thread_add_event(master, bench_start, NULL, 0);
+	return 0;
+}
+
+/* Starts a phase once whatever was queued before has been processed,
+ * so that nothing left over is counted against it. */
+static int bench_start(struct thread *t) {
+	if(zebrad.mq->size) {
+		thread_add_timer_msec(master, bench_start, NULL, 10);
+		return 0;
+	}
+
+	injected = completed = 0;
+	inject_nsec = kernel_nsec = 0;
+	memset(latency, 0, routes * sizeof(*latency));
+	phase_resolve = rib_bench_resolve_nsec;
+	phase_start = now_nsec();
+	thread_add_event(master, bench_inject, NULL, 0);
+	return 0;
+}
+
+/* Callback upon creating a new VRF. */
+static int zebra_vrf_new(vrf_id_t vrf_id, void **info) {
+	if(!*info) {
+		*info = zebra_vrf_alloc(vrf_id);
+	}
+	return 0;
+}
+
+/* Callback upon enabling a VRF. */
+static int zebra_vrf_enable(vrf_id_t vrf_id, void **info) {
+	kernel_init(*info);
+	return 0;
+}
+
+static void bench_topology(void) {
+	struct in_addr addr, gate;
+	struct prefix_ipv4 p;
+	int i;
+
+	/* one interface per path, each on its own /24 of 10.0.0.0/16 for
+	 * the ifindex case; the gateways all live on the first one */
+	for(i = 0; i < npaths; i++) {
+		char name[INTERFACE_NAMSIZ];
+
+		snprintf(name, sizeof(name), "bench%d", i);
+		bench_ifp = if_get_by_name(name);
+		if_set_index(bench_ifp, i + 1);
+		bench_ifp->mtu = 1500;
+		bench_ifp->flags = IFF_UP | IFF_RUNNING | IFF_BROADCAST | IFF_MULTICAST;
+		if_add_update(bench_ifp);
+
+		addr.s_addr = htonl(0x0a000001 + (i << 8)); /* 10.0.i.1 */
+		connected_add_ipv4(bench_ifp, 0, &addr, i ? 24 : 16, NULL, NULL);
+	}
+	bench_ifp = if_lookup_by_index(1);
+
+	/* the IGP route that recursive nexthops resolve over */
+	if(nhtype == NH_RECURSIVE) {
+		memset(&p, 0, sizeof(p));
+		p.family = AF_INET;
+		p.prefixlen = 16;
+		p.prefix.s_addr = htonl(0x0a010000);
+		gate.s_addr = htonl(0x0a000002);
+		rib_add_ipv4(ZEBRA_ROUTE_OSPF, 0, &p, &gate, NULL, 0, VRF_DEFAULT, zebrad.rtm_table_default, 0, 0, 0, SAFI_UNICAST);
+	}
+}
+
+static void usage(const char *progname) {
+	fprintf(stderr,
+	        "Usage: %s [-n routes] [-b batch] [-t ifindex|gateway|recursive] "
+	        "[-p paths] [-k kernel usecs] [-r rib hold msecs]\n",
+	        progname);
+	exit(1);
+}
+
+int main(int argc, char **argv) {
+	int opt;
+
+	while((opt = getopt(argc, argv, "n:b:t:p:k:r:h")) != -1) {
+		switch(opt) {
+			case 'n': routes = strtoul(optarg, NULL, 10); break;
+			case 'b': batch = strtoul(optarg, NULL, 10); break;
+			case 't':
+				if(!strcmp(optarg, "ifindex")) {
+					nhtype = NH_IFINDEX;
+				} else if(!strcmp(optarg, "gateway")) {
+					nhtype = NH_GATEWAY;
+				} else if(!strcmp(optarg, "recursive")) {
+					nhtype = NH_RECURSIVE;
+				} else {
+					usage(argv[0]);
+				}
+				break;
+			case 'p': npaths = atoi(optarg); break;
+			case 'k': kernel_cost_nsec = strtoul(optarg, NULL, 10) * 1000; break;
+			case 'r': rib_process_hold_time = atoi(optarg); break;
+			default: usage(argv[0]);
+		}
+	}
+	if(routes < 1 || routes > (224 - 11) << 16 || batch < 1 || npaths < 1 || npaths > MULTIPATH_NUM) {
+		usage(argv[0]);
+	}
+
+	zlog_default = openzlog(argv[0], ZLOG_ZEBRA, LOG_CONS | LOG_NDELAY | LOG_PID, LOG_DAEMON);
+	zlog_set_level(NULL, ZLOG_DEST_SYSLOG, ZLOG_DISABLED);
+	zlog_set_level(NULL, ZLOG_DEST_STDOUT, LOG_WARNING);
+
+	master = zebrad.master = thread_master_create();
+	cmd_init(1);
+	vty_init(master);
+	memory_init();
+	zebra_debug_init();
+	zebra_if_init();
+	rib_init();
+	zebra_nhg_init();
+	access_list_init();
+
+	vrf_add_hook(VRF_NEW_HOOK, zebra_vrf_new);
+	vrf_add_hook(VRF_ENABLE_HOOK, zebra_vrf_enable);
+	vrf_init();
+
+	pid = getpid();
+
+	injected_at = XCALLOC(MTYPE_TMP, routes * sizeof(*injected_at));
+	latency = XCALLOC(MTYPE_TMP, routes * sizeof(*latency));
+
+	bench_topology();
+
+	printf("%lu routes, %d %s nexthop%s, batches of %lu, kernel cost %lu us\n", routes, npaths,
+	       nhtype == NH_IFINDEX ? "ifindex" : nhtype == NH_GATEWAY ? "gateway" : "recursive", npaths > 1 ? "s" : "", batch, kernel_cost_nsec / 1000);
+
+	thread_add_event(master, bench_start, NULL, 0);
+	thread_main(master);
+
+	/* Not reached... */
+	return 0;
+}
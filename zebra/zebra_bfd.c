@@ -0,0 +1,794 @@
+/*
+ * Zebra BFD sessions run for clients
+ *
+ * This file is part of GNU Zebra.
+ *
+ * GNU Zebra is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2, or (at your option) any
+ * later version.
+ *
+ * GNU Zebra is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with GNU Zebra; see the file COPYING.  If not, write to the Free
+ * Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ * 02111-1307, USA.
+ */
+
+#include <zebra.h>
+
+#include "prefix.h"
+#include "stream.h"
+#include "memory.h"
+#include "linklist.h"
+#include "hash.h"
+#include "jhash.h"
+#include "thread.h"
+#include "command.h"
+#include "log.h"
+#include "sockunion.h"
+#include "sockopt.h"
+#include "network.h"
+#include "zclient.h"
+
+#include "zebra/zserv.h"
+#include "zebra/zebra_bfd.h"
+
+extern struct zebra_t zebrad;
+
+/* A client registered for a session, as many times as refcnt */
+struct bfd_reg {
+	struct zserv *client;
+	u_int32_t min_rx; /* milliseconds */
+	u_int32_t min_tx;
+	u_char detect_mult;
+	int refcnt;
+};
+
+struct bfd_session {
+	struct prefix dst;
+	struct prefix src;
+	ifindex_t ifindex;
+
+	u_int32_t local_discr;
+	u_int32_t remote_discr;
+	u_char state;
+	u_char remote_state;
+	u_char diag;
+	u_char detect_mult;
+	u_char remote_detect_mult;
+
+	/* Microseconds: what we advertise, as the registrations ask ... */
+	u_int32_t desired_min_tx;
+	u_int32_t required_min_rx;
+	/* ... what is in effect, which only goes slower once the peer
+	 * answered the Poll for it ... */
+	u_int32_t active_min_tx;
+	u_int32_t active_min_rx;
+	u_char poll;
+	/* ... and what the peer advertises */
+	u_int32_t remote_min_rx;
+	u_int32_t remote_min_tx;
+
+	int sock;
+	struct thread *t_tx;
+	struct thread *t_detect;
+
+	struct list *regs;
+
+	time_t last_change;
+	unsigned long rx_count;
+	unsigned long tx_count;
+	unsigned long up_count;
+};
+
+/* By dst and src, and by local discriminator */
+static struct hash *bfd_sessions;
+static struct hash *bfd_discrs;
+
+static int bfd_sock4 = -1;
+static struct thread *bfd_t_read4;
+#ifdef HAVE_IPV6
+static int bfd_sock6 = -1;
+static struct thread *bfd_t_read6;
+#endif /* HAVE_IPV6 */
+
+static const char *bfd_state_str[] = {"AdminDown", "Down", "Init", "Up"};
+
+static unsigned int bfd_session_key(void *p) {
+	struct bfd_session *session = p;
+	u_int32_t key;
+
+	key = jhash(&session->dst.u.prefix, prefix_blen(&session->dst), session->dst.family);
+	return jhash(&session->src.u.prefix, prefix_blen(&session->src), key);
+}
+
+static int bfd_session_cmp(const void *p1, const void *p2) {
+	const struct bfd_session *s1 = p1;
+	const struct bfd_session *s2 = p2;
+
+	return prefix_same((struct prefix *) &s1->dst, (struct prefix *) &s2->dst) && prefix_same((struct prefix *) &s1->src, (struct prefix *) &s2->src);
+}
+
+static unsigned int bfd_discr_key(void *p) {
+	struct bfd_session *session = p;
+
+	return jhash_1word(session->local_discr, 0);
+}
+
+static int bfd_discr_cmp(const void *p1, const void *p2) {
+	const struct bfd_session *s1 = p1;
+	const struct bfd_session *s2 = p2;
+
+	return s1->local_discr == s2->local_discr;
+}
+
+static char *bfd_session_str(struct bfd_session *session, char *buf, size_t size) {
+	char dst[INET6_ADDRSTRLEN], src[INET6_ADDRSTRLEN];
+
+	inet_ntop(session->dst.family, &session->dst.u.prefix, dst, sizeof(dst));
+	inet_ntop(session->src.family, &session->src.u.prefix, src, sizeof(src));
+	snprintf(buf, size, "%s from %s", dst, src);
+	return buf;
+}
+
+static socklen_t bfd_su_len(union sockunion *su) {
+#ifdef HAVE_IPV6
+	if(su->sa.sa_family == AF_INET6) {
+		return sizeof(struct sockaddr_in6);
+	}
+#endif /* HAVE_IPV6 */
+	return sizeof(struct sockaddr_in);
+}
+
+/* The receive socket of a family, made on first use */
+static int bfd_read(struct thread *);
+
+static int bfd_sock_rx(int family) {
+	union sockunion su;
+	int sock, on = 1;
+
+	sock = socket(family, SOCK_DGRAM, 0);
+	if(sock < 0) {
+		zlog_err("BFD: can't make %s socket: %s", family == AF_INET ? "IPv4" : "IPv6", safe_strerror(errno));
+		return -1;
+	}
+	sockopt_reuseaddr(sock);
+
+	memset(&su, 0, sizeof(su));
+	su.sa.sa_family = family;
+	if(family == AF_INET) {
+		su.sin.sin_port = htons(BFD_PORT);
+#ifdef IP_RECVTTL
+		setsockopt(sock, IPPROTO_IP, IP_RECVTTL, &on, sizeof(on));
+#endif /* IP_RECVTTL */
+		setsockopt_ifindex(AF_INET, sock, 1);
+#ifdef HAVE_IPV6
+	} else {
+		su.sin6.sin6_port = htons(BFD_PORT);
+		setsockopt(sock, IPPROTO_IPV6, IPV6_V6ONLY, &on, sizeof(on));
+		setsockopt_ipv6_hoplimit(sock, 1);
+		setsockopt_ipv6_pktinfo(sock, 1);
+#endif /* HAVE_IPV6 */
+	}
+
+	if(bind(sock, &su.sa, bfd_su_len(&su)) < 0) {
+		zlog_err("BFD: can't bind %s socket to port %d: %s", family == AF_INET ? "IPv4" : "IPv6", BFD_PORT, safe_strerror(errno));
+		close(sock);
+		return -1;
+	}
+	set_nonblocking(sock);
+	return sock;
+}
+
+static void bfd_rx_start(int family) {
+	if(family == AF_INET && bfd_sock4 < 0) {
+		if((bfd_sock4 = bfd_sock_rx(AF_INET)) >= 0) {
+			bfd_t_read4 = thread_add_read(zebrad.master, bfd_read, NULL, bfd_sock4);
+		}
+	}
+#ifdef HAVE_IPV6
+	if(family == AF_INET6 && bfd_sock6 < 0) {
+		if((bfd_sock6 = bfd_sock_rx(AF_INET6)) >= 0) {
+			bfd_t_read6 = thread_add_read(zebrad.master, bfd_read, NULL, bfd_sock6);
+		}
+	}
+#endif /* HAVE_IPV6 */
+}
+
+/* A session's own socket, bound to its source address and a port of the
+ * range RFC 5881 gives */
+static int bfd_sock_tx(struct bfd_session *session) {
+	union sockunion su;
+	int sock, ttl = BFD_TTL, i, port;
+
+	sock = socket(session->src.family, SOCK_DGRAM, 0);
+	if(sock < 0) {
+		return -1;
+	}
+
+	memset(&su, 0, sizeof(su));
+	su.sa.sa_family = session->src.family;
+	if(su.sa.sa_family == AF_INET) {
+		su.sin.sin_addr = session->src.u.prefix4;
+		setsockopt(sock, IPPROTO_IP, IP_TTL, &ttl, sizeof(ttl));
+#ifdef HAVE_IPV6
+	} else {
+		su.sin6.sin6_addr = session->src.u.prefix6;
+		if(IN6_IS_ADDR_LINKLOCAL(&su.sin6.sin6_addr)) {
+			su.sin6.sin6_scope_id = session->ifindex;
+		}
+		setsockopt_ipv6_unicast_hops(sock, BFD_TTL);
+#endif /* HAVE_IPV6 */
+	}
+
+	port = BFD_SRC_PORT_MIN + random() % (BFD_SRC_PORT_MAX - BFD_SRC_PORT_MIN + 1);
+	for(i = 0; i <= BFD_SRC_PORT_MAX - BFD_SRC_PORT_MIN; i++) {
+		if(su.sa.sa_family == AF_INET) {
+			su.sin.sin_port = htons(port);
+#ifdef HAVE_IPV6
+		} else {
+			su.sin6.sin6_port = htons(port);
+#endif /* HAVE_IPV6 */
+		}
+		if(bind(sock, &su.sa, bfd_su_len(&su)) == 0) {
+			set_nonblocking(sock);
+			return sock;
+		}
+		if(errno != EADDRINUSE) {
+			break;
+		}
+		port = (port == BFD_SRC_PORT_MAX) ? BFD_SRC_PORT_MIN : port + 1;
+	}
+	close(sock);
+	return -1;
+}
+
+/* What we advertise we send at: no faster than once a second until up */
+static u_int32_t bfd_desired_min_tx(struct bfd_session *session) {
+	if(session->state != BFD_STATE_UP && session->desired_min_tx < BFD_SLOW_TX) {
+		return BFD_SLOW_TX;
+	}
+	return session->desired_min_tx;
+}
+
+static void bfd_send(struct bfd_session *session, int final) {
+	u_char buf[BFD_PKT_LEN];
+	union sockunion su;
+	u_int32_t val;
+	u_char flags = 0;
+
+	if(session->sock < 0) {
+		return;
+	}
+
+	if(final) {
+		flags |= BFD_FLAG_FINAL;
+	} else if(session->poll) {
+		flags |= BFD_FLAG_POLL;
+	}
+	buf[0] = (BFD_VERSION << 5) | session->diag;
+	buf[1] = (session->state << 6) | flags;
+	buf[2] = session->detect_mult;
+	buf[3] = BFD_PKT_LEN;
+	val = htonl(session->local_discr);
+	memcpy(buf + 4, &val, 4);
+	val = htonl(session->remote_discr);
+	memcpy(buf + 8, &val, 4);
+	val = htonl(bfd_desired_min_tx(session));
+	memcpy(buf + 12, &val, 4);
+	val = htonl(session->required_min_rx);
+	memcpy(buf + 16, &val, 4);
+	/* no echo */
+	memset(buf + 20, 0, 4);
+
+	memset(&su, 0, sizeof(su));
+	su.sa.sa_family = session->dst.family;
+	if(su.sa.sa_family == AF_INET) {
+		su.sin.sin_addr = session->dst.u.prefix4;
+		su.sin.sin_port = htons(BFD_PORT);
+#ifdef HAVE_IPV6
+	} else {
+		su.sin6.sin6_addr = session->dst.u.prefix6;
+		su.sin6.sin6_port = htons(BFD_PORT);
+		if(IN6_IS_ADDR_LINKLOCAL(&su.sin6.sin6_addr)) {
+			su.sin6.sin6_scope_id = session->ifindex;
+		}
+#endif /* HAVE_IPV6 */
+	}
+
+	if(sendto(session->sock, buf, BFD_PKT_LEN, 0, &su.sa, bfd_su_len(&su)) == BFD_PKT_LEN) {
+		session->tx_count++;
+	}
+}
+
+static int bfd_tx_timer(struct thread *);
+
+/* RFC 5880 6.8.7: the interval is the slower of ours and what the peer
+ * takes, less 0 to 25% of it, so that neighbours do not synchronise */
+static void bfd_tx_schedule(struct bfd_session *session) {
+	u_int32_t interval;
+	int jitter;
+
+	THREAD_TIMER_OFF(session->t_tx);
+	/* the peer wants none */
+	if(session->remote_min_rx == 0) {
+		return;
+	}
+
+	interval = MAX(session->state == BFD_STATE_UP ? session->active_min_tx : bfd_desired_min_tx(session), session->remote_min_rx);
+	jitter = (session->detect_mult == 1) ? 10 + random() % 16 : random() % 26;
+	interval = interval / 100 * (100 - jitter);
+	session->t_tx = thread_add_timer_msec(zebrad.master, bfd_tx_timer, session, MAX(interval / 1000, 1));
+}
+
+static int bfd_tx_timer(struct thread *thread) {
+	struct bfd_session *session = THREAD_ARG(thread);
+
+	session->t_tx = NULL;
+	bfd_send(session, 0);
+	bfd_tx_schedule(session);
+	return 0;
+}
+
+static void bfd_notify(struct bfd_session *session, struct zserv *client) {
+	struct zapi_bfd bfd;
+	struct stream *s;
+
+	memset(&bfd, 0, sizeof(bfd));
+	bfd.dst = session->dst;
+	bfd.src = session->src;
+	bfd.ifindex = session->ifindex;
+	bfd.state = (session->state == BFD_STATE_UP) ? ZEBRA_BFD_UP : ZEBRA_BFD_DOWN;
+
+	s = client->obuf;
+	stream_reset(s);
+	zserv_create_header(s, ZEBRA_BFD_DEST_UPDATE, VRF_DEFAULT);
+	zapi_bfd_encode(s, &bfd);
+	stream_putw_at(s, 0, stream_get_endp(s));
+
+	client->last_write_cmd = ZEBRA_BFD_DEST_UPDATE;
+	zebra_server_send_message(client);
+}
+
+static void bfd_state_change(struct bfd_session *session, u_char state, u_char diag) {
+	struct listnode *node;
+	struct bfd_reg *reg;
+	u_char old = session->state;
+	char buf[2 * INET6_ADDRSTRLEN + 8];
+
+	session->state = state;
+	session->diag = diag;
+	session->last_change = quagga_time(NULL);
+	zlog_notice("BFD session %s: %s -> %s", bfd_session_str(session, buf, sizeof(buf)), bfd_state_str[old], bfd_state_str[state]);
+
+	if(state == BFD_STATE_UP) {
+		session->up_count++;
+		/* to the intervals asked for, from the slow ones */
+		if(session->desired_min_tx < BFD_SLOW_TX) {
+			session->poll = 1;
+			session->active_min_tx = session->desired_min_tx;
+		}
+	} else if(state == BFD_STATE_DOWN) {
+		session->remote_discr = 0;
+		session->poll = 0;
+		session->active_min_tx = bfd_desired_min_tx(session);
+		session->active_min_rx = session->required_min_rx;
+		THREAD_TIMER_OFF(session->t_detect);
+	}
+
+	/* clients hear of it going up, and of it going down once up */
+	if(state == BFD_STATE_UP || old == BFD_STATE_UP) {
+		for(ALL_LIST_ELEMENTS_RO(session->regs, node, reg)) {
+			bfd_notify(session, reg->client);
+		}
+	}
+	bfd_tx_schedule(session);
+}
+
+static int bfd_detect_timer(struct thread *thread) {
+	struct bfd_session *session = THREAD_ARG(thread);
+
+	session->t_detect = NULL;
+	if(session->state == BFD_STATE_INIT || session->state == BFD_STATE_UP) {
+		bfd_state_change(session, BFD_STATE_DOWN, BFD_DIAG_DETECT_EXPIRED);
+	}
+	return 0;
+}
+
+static void bfd_detect_schedule(struct bfd_session *session) {
+	u_int32_t detect;
+
+	THREAD_TIMER_OFF(session->t_detect);
+	detect = session->remote_detect_mult * MAX(session->active_min_rx, session->remote_min_tx);
+	session->t_detect = thread_add_timer_msec(zebrad.master, bfd_detect_timer, session, MAX(detect / 1000, 1));
+}
+
+/* RFC 5880 6.8.6, for a control packet that passed the checks */
+static void bfd_recv(struct bfd_session *session, u_char *buf) {
+	u_int32_t val;
+	u_char state = buf[1] >> 6, flags = buf[1] & 0x3f;
+	u_int32_t remote_min_rx = session->remote_min_rx;
+
+	session->rx_count++;
+	memcpy(&val, buf + 4, 4);
+	session->remote_discr = ntohl(val);
+	session->remote_state = state;
+	session->remote_detect_mult = buf[2];
+	memcpy(&val, buf + 12, 4);
+	session->remote_min_tx = ntohl(val);
+	memcpy(&val, buf + 16, 4);
+	session->remote_min_rx = ntohl(val);
+
+	/* the peer took our new intervals */
+	if((flags & BFD_FLAG_FINAL) && session->poll) {
+		session->poll = 0;
+		session->active_min_tx = session->desired_min_tx;
+		session->active_min_rx = session->required_min_rx;
+	}
+
+	if(state == BFD_STATE_ADMIN_DOWN) {
+		if(session->state != BFD_STATE_DOWN) {
+			bfd_state_change(session, BFD_STATE_DOWN, BFD_DIAG_NEIGHBOR_DOWN);
+		}
+	} else if(session->state == BFD_STATE_DOWN) {
+		if(state == BFD_STATE_DOWN) {
+			bfd_state_change(session, BFD_STATE_INIT, BFD_DIAG_NONE);
+		} else if(state == BFD_STATE_INIT) {
+			bfd_state_change(session, BFD_STATE_UP, BFD_DIAG_NONE);
+		}
+	} else if(session->state == BFD_STATE_INIT) {
+		if(state == BFD_STATE_INIT || state == BFD_STATE_UP) {
+			bfd_state_change(session, BFD_STATE_UP, BFD_DIAG_NONE);
+		}
+	} else if(state == BFD_STATE_DOWN) {
+		bfd_state_change(session, BFD_STATE_DOWN, BFD_DIAG_NEIGHBOR_DOWN);
+	}
+
+	if(session->state == BFD_STATE_INIT || session->state == BFD_STATE_UP) {
+		bfd_detect_schedule(session);
+	}
+	if(flags & BFD_FLAG_POLL) {
+		bfd_send(session, 1);
+	}
+	/* the peer wants packets at a new rate, or again */
+	if(session->remote_min_rx != remote_min_rx && (session->remote_min_rx > remote_min_rx || !session->t_tx)) {
+		bfd_tx_schedule(session);
+	}
+}
+
+static int bfd_read(struct thread *thread) {
+	int sock = THREAD_FD(thread);
+	u_char buf[BFD_PKT_LEN + 64];
+	char control[256];
+	union sockunion from;
+	struct msghdr msg;
+	struct iovec iov;
+	struct cmsghdr *cmsg;
+	struct bfd_session tmp, *session;
+	u_int32_t discr;
+	ssize_t len;
+	int ttl = -1;
+
+	if(sock == bfd_sock4) {
+		bfd_t_read4 = thread_add_read(zebrad.master, bfd_read, NULL, sock);
+#ifdef HAVE_IPV6
+	} else {
+		bfd_t_read6 = thread_add_read(zebrad.master, bfd_read, NULL, sock);
+#endif /* HAVE_IPV6 */
+	}
+
+	memset(&tmp, 0, sizeof(tmp));
+	memset(&msg, 0, sizeof(msg));
+	iov.iov_base = buf;
+	iov.iov_len = sizeof(buf);
+	msg.msg_name = &from;
+	msg.msg_namelen = sizeof(from);
+	msg.msg_iov = &iov;
+	msg.msg_iovlen = 1;
+	msg.msg_control = control;
+	msg.msg_controllen = sizeof(control);
+
+	len = recvmsg(sock, &msg, 0);
+	if(len < 0) {
+		return 0;
+	}
+
+	for(cmsg = CMSG_FIRSTHDR(&msg); cmsg; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+		if(cmsg->cmsg_level == IPPROTO_IP) {
+#ifdef IP_RECVTTL
+			if(cmsg->cmsg_type == IP_TTL) {
+				memcpy(&ttl, CMSG_DATA(cmsg), sizeof(int));
+			}
+#endif /* IP_RECVTTL */
+#ifdef IP_PKTINFO
+			if(cmsg->cmsg_type == IP_PKTINFO) {
+				struct in_pktinfo *pktinfo = (struct in_pktinfo *) CMSG_DATA(cmsg);
+
+				tmp.src.family = AF_INET;
+				tmp.src.prefixlen = IPV4_MAX_BITLEN;
+				tmp.src.u.prefix4 = pktinfo->ipi_addr;
+			}
+#endif /* IP_PKTINFO */
+#ifdef HAVE_IPV6
+		} else if(cmsg->cmsg_level == IPPROTO_IPV6) {
+			if(cmsg->cmsg_type == IPV6_HOPLIMIT) {
+				memcpy(&ttl, CMSG_DATA(cmsg), sizeof(int));
+			} else if(cmsg->cmsg_type == IPV6_PKTINFO) {
+				struct in6_pktinfo *pktinfo = (struct in6_pktinfo *) CMSG_DATA(cmsg);
+
+				tmp.src.family = AF_INET6;
+				tmp.src.prefixlen = IPV6_MAX_BITLEN;
+				tmp.src.u.prefix6 = pktinfo->ipi6_addr;
+			}
+#endif /* HAVE_IPV6 */
+		}
+	}
+
+	/* RFC 5881 5: from off the link only with GTSM */
+	if(ttl >= 0 && ttl != BFD_TTL) {
+		return 0;
+	}
+	/* RFC 5880 6.8.6 */
+	if(len < BFD_PKT_LEN || (buf[0] >> 5) != BFD_VERSION || buf[3] < BFD_PKT_LEN || buf[3] > len || buf[2] == 0 || (buf[1] & (BFD_FLAG_MULTIPOINT | BFD_FLAG_AUTH))) {
+		return 0;
+	}
+	memcpy(&discr, buf + 4, 4);
+	if(discr == 0) {
+		return 0;
+	}
+
+	memcpy(&discr, buf + 8, 4);
+	if(discr) {
+		tmp.local_discr = ntohl(discr);
+		session = hash_lookup(bfd_discrs, &tmp);
+	} else {
+		/* the peer does not know us yet: by its address, and ours */
+		if((buf[1] >> 6) != BFD_STATE_DOWN && (buf[1] >> 6) != BFD_STATE_ADMIN_DOWN) {
+			return 0;
+		}
+		sockunion2hostprefix(&from, &tmp.dst);
+		session = tmp.src.family ? hash_lookup(bfd_sessions, &tmp) : NULL;
+	}
+	if(session) {
+		bfd_recv(session, buf);
+	}
+	return 0;
+}
+
+static void bfd_session_params(struct bfd_session *session) {
+	struct listnode *node;
+	struct bfd_reg *reg;
+	u_int32_t min_rx = UINT32_MAX, min_tx = UINT32_MAX;
+	u_char mult = 255;
+
+	for(ALL_LIST_ELEMENTS_RO(session->regs, node, reg)) {
+		min_rx = MIN(min_rx, reg->min_rx);
+		min_tx = MIN(min_tx, reg->min_tx);
+		mult = MIN(mult, reg->detect_mult);
+	}
+	min_rx = MIN(min_rx, UINT32_MAX / 1000) * 1000;
+	min_tx = MIN(min_tx, UINT32_MAX / 1000) * 1000;
+
+	session->detect_mult = mult;
+	if(min_rx == session->required_min_rx && min_tx == session->desired_min_tx) {
+		return;
+	}
+	session->required_min_rx = min_rx;
+	session->desired_min_tx = min_tx;
+
+	if(session->state == BFD_STATE_UP) {
+		/* faster, at once; slower once the peer took it */
+		session->active_min_tx = MIN(session->active_min_tx, min_tx);
+		session->active_min_rx = MAX(session->active_min_rx, min_rx);
+		session->poll = 1;
+		bfd_send(session, 0);
+	} else {
+		session->active_min_tx = bfd_desired_min_tx(session);
+		session->active_min_rx = min_rx;
+	}
+}
+
+static struct bfd_session *bfd_session_new(struct zapi_bfd *bfd) {
+	struct bfd_session *session;
+
+	session = XCALLOC(MTYPE_ZEBRA_BFD, sizeof(struct bfd_session));
+	session->dst = bfd->dst;
+	session->src = bfd->src;
+	session->ifindex = bfd->ifindex;
+	session->regs = list_new();
+	session->state = BFD_STATE_DOWN;
+	session->remote_state = BFD_STATE_DOWN;
+	session->remote_min_rx = 1;
+	session->last_change = quagga_time(NULL);
+
+	do {
+		session->local_discr = random();
+	} while(session->local_discr == 0 || hash_lookup(bfd_discrs, session));
+
+	session->sock = bfd_sock_tx(session);
+	if(session->sock < 0) {
+		char buf[2 * INET6_ADDRSTRLEN + 8];
+
+		zlog_warn("BFD session %s: can't make its socket: %s", bfd_session_str(session, buf, sizeof(buf)), safe_strerror(errno));
+	}
+	bfd_rx_start(session->dst.family);
+
+	hash_get(bfd_sessions, session, hash_alloc_intern);
+	hash_get(bfd_discrs, session, hash_alloc_intern);
+	return session;
+}
+
+static void bfd_session_free(struct bfd_session *session) {
+	/* tell the peer, rather than have it time out */
+	session->state = BFD_STATE_ADMIN_DOWN;
+	session->diag = BFD_DIAG_ADMIN_DOWN;
+	session->poll = 0;
+	bfd_send(session, 0);
+
+	hash_release(bfd_sessions, session);
+	hash_release(bfd_discrs, session);
+	THREAD_TIMER_OFF(session->t_tx);
+	THREAD_TIMER_OFF(session->t_detect);
+	if(session->sock >= 0) {
+		close(session->sock);
+	}
+	list_delete(session->regs);
+	XFREE(MTYPE_ZEBRA_BFD, session);
+}
+
+static struct bfd_reg *bfd_reg_lookup(struct bfd_session *session, struct zserv *client) {
+	struct listnode *node;
+	struct bfd_reg *reg;
+
+	for(ALL_LIST_ELEMENTS_RO(session->regs, node, reg)) {
+		if(reg->client == client) {
+			return reg;
+		}
+	}
+	return NULL;
+}
+
+static int bfd_read_request(struct zserv *client, u_short length, struct zapi_bfd *bfd) {
+	if(zapi_bfd_decode(client->ibuf, bfd) < 0 || bfd->src.family != bfd->dst.family) {
+		zlog_warn("%s: %s sent a malformed BFD registration", __func__, zebra_route_string(client->proto));
+		return -1;
+	}
+	return 0;
+}
+
+void zebra_bfd_register(struct zserv *client, u_short length) {
+	struct zapi_bfd bfd;
+	struct bfd_session tmp, *session;
+	struct bfd_reg *reg;
+
+	if(bfd_read_request(client, length, &bfd) < 0) {
+		return;
+	}
+
+	tmp.dst = bfd.dst;
+	tmp.src = bfd.src;
+	session = hash_lookup(bfd_sessions, &tmp);
+	if(!session) {
+		session = bfd_session_new(&bfd);
+	}
+
+	reg = bfd_reg_lookup(session, client);
+	if(!reg) {
+		reg = XCALLOC(MTYPE_ZEBRA_BFD_REG, sizeof(struct bfd_reg));
+		reg->client = client;
+		listnode_add(session->regs, reg);
+	}
+	reg->refcnt++;
+	reg->min_rx = bfd.min_rx ? bfd.min_rx : ZEBRA_BFD_MIN_RX_DEFAULT;
+	reg->min_tx = bfd.min_tx ? bfd.min_tx : ZEBRA_BFD_MIN_TX_DEFAULT;
+	reg->detect_mult = bfd.detect_mult ? bfd.detect_mult : ZEBRA_BFD_DETECT_MULT_DEFAULT;
+	bfd_session_params(session);
+
+	if(session->state == BFD_STATE_UP) {
+		bfd_notify(session, client);
+	} else if(!session->t_tx) {
+		bfd_send(session, 0);
+		bfd_tx_schedule(session);
+	}
+}
+
+static void bfd_reg_remove(struct bfd_session *session, struct bfd_reg *reg) {
+	listnode_delete(session->regs, reg);
+	XFREE(MTYPE_ZEBRA_BFD_REG, reg);
+	if(list_isempty(session->regs)) {
+		bfd_session_free(session);
+	} else {
+		bfd_session_params(session);
+	}
+}
+
+void zebra_bfd_deregister(struct zserv *client, u_short length) {
+	struct zapi_bfd bfd;
+	struct bfd_session tmp, *session;
+	struct bfd_reg *reg;
+
+	if(bfd_read_request(client, length, &bfd) < 0) {
+		return;
+	}
+
+	tmp.dst = bfd.dst;
+	tmp.src = bfd.src;
+	session = hash_lookup(bfd_sessions, &tmp);
+	if(!session || !(reg = bfd_reg_lookup(session, client))) {
+		return;
+	}
+	if(--reg->refcnt == 0) {
+		bfd_reg_remove(session, reg);
+	}
+}
+
+static void bfd_session_collect(struct hash_backet *backet, void *arg) {
+	listnode_add(arg, backet->data);
+}
+
+/* The sessions, in a list of their own for the caller to change them */
+static struct list *bfd_session_list(void) {
+	struct list *list = list_new();
+
+	hash_iterate(bfd_sessions, bfd_session_collect, list);
+	return list;
+}
+
+void zebra_bfd_client_close(struct zserv *client) {
+	struct list *list;
+	struct listnode *node;
+	struct bfd_session *session;
+	struct bfd_reg *reg;
+
+	if(!bfd_sessions->count) {
+		return;
+	}
+	list = bfd_session_list();
+	for(ALL_LIST_ELEMENTS_RO(list, node, session)) {
+		if((reg = bfd_reg_lookup(session, client))) {
+			bfd_reg_remove(session, reg);
+		}
+	}
+	list_delete(list);
+}
+
+DEFUN(show_bfd_peers, show_bfd_peers_cmd, "show bfd peers", SHOW_STR "Bidirectional Forwarding Detection\n"
+								 "BFD sessions\n") {
+	struct list *list;
+	struct listnode *node, *rnode;
+	struct bfd_session *session;
+	struct bfd_reg *reg;
+	char dst[INET6_ADDRSTRLEN], src[INET6_ADDRSTRLEN];
+	time_t now = quagga_time(NULL);
+
+	list = bfd_session_list();
+	for(ALL_LIST_ELEMENTS_RO(list, node, session)) {
+		inet_ntop(session->dst.family, &session->dst.u.prefix, dst, sizeof(dst));
+		inet_ntop(session->src.family, &session->src.u.prefix, src, sizeof(src));
+		vty_out(vty, "peer %s local-address %s%s", dst, src, VTY_NEWLINE);
+		vty_out(vty, "  state %s for %lds, remote %s, diag %d, up %lu times%s", bfd_state_str[session->state], (long) (now - session->last_change), bfd_state_str[session->remote_state], session->diag, session->up_count, VTY_NEWLINE);
+		vty_out(vty, "  discriminators local %u remote %u%s", session->local_discr, session->remote_discr, VTY_NEWLINE);
+		vty_out(vty, "  local  tx %ums rx %ums mult %u%s%s", session->active_min_tx / 1000, session->active_min_rx / 1000, session->detect_mult, session->poll ? ", polling" : "", VTY_NEWLINE);
+		vty_out(vty, "  remote tx %ums rx %ums mult %u%s", session->remote_min_tx / 1000, session->remote_min_rx / 1000, session->remote_detect_mult, VTY_NEWLINE);
+		vty_out(vty, "  packets sent %lu received %lu%s", session->tx_count, session->rx_count, VTY_NEWLINE);
+		vty_out(vty, "  clients:");
+		for(ALL_LIST_ELEMENTS_RO(session->regs, rnode, reg)) {
+			vty_out(vty, " %s", zebra_route_string(reg->client->proto));
+		}
+		vty_out(vty, "%s", VTY_NEWLINE);
+	}
+	list_delete(list);
+	return CMD_SUCCESS;
+}
+
+void zebra_bfd_init(void) {
+	bfd_sessions = hash_create(bfd_session_key, bfd_session_cmp);
+	bfd_discrs = hash_create(bfd_discr_key, bfd_discr_cmp);
+
+	install_element(VIEW_NODE, &show_bfd_peers_cmd);
+}
@@ -0,0 +1,74 @@
+/*
+ * Zebra BFD sessions run for clients
+ *
+ * This file is part of GNU Zebra.
+ *
+ * GNU Zebra is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2, or (at your option) any
+ * later version.
+ *
+ * GNU Zebra is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with GNU Zebra; see the file COPYING.  If not, write to the Free
+ * Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ * 02111-1307, USA.
+ */
+
+#ifndef _ZEBRA_BFD_H
+#define _ZEBRA_BFD_H
+
+/* Single-hop BFD (RFC 5880, RFC 5881) in asynchronous mode, without
+ * authentication or echo, for the neighbours the clients register.  A
+ * session exists while a client is registered for it, and runs at the
+ * fastest intervals any of them asked for.  Control packets go out of a
+ * socket of the session's own, bound to its source address, and come in
+ * on the one socket of each family listening on port 3784, where those
+ * not sent with a TTL of 255 are dropped.
+ *
+ * The sessions run off millisecond timers of zebra's thread master:
+ * between two of its callbacks, the RIB work queue yields after 10ms at
+ * most, well within the shortest detection time that makes sense. */
+#define BFD_PORT 3784
+#define BFD_SRC_PORT_MIN 49152
+#define BFD_SRC_PORT_MAX 65535
+
+#define BFD_VERSION 1
+#define BFD_PKT_LEN 24
+#define BFD_TTL 255
+
+/* Session states */
+#define BFD_STATE_ADMIN_DOWN 0
+#define BFD_STATE_DOWN 1
+#define BFD_STATE_INIT 2
+#define BFD_STATE_UP 3
+
+/* Diagnostics */
+#define BFD_DIAG_NONE 0
+#define BFD_DIAG_DETECT_EXPIRED 1
+#define BFD_DIAG_NEIGHBOR_DOWN 3
+#define BFD_DIAG_ADMIN_DOWN 7
+
+/* Flags, with the state in the two bits above them */
+#define BFD_FLAG_POLL 0x20
+#define BFD_FLAG_FINAL 0x10
+#define BFD_FLAG_CPI 0x08
+#define BFD_FLAG_AUTH 0x04
+#define BFD_FLAG_DEMAND 0x02
+#define BFD_FLAG_MULTIPOINT 0x01
+
+/* Transmit interval while the session is not up, in microseconds */
+#define BFD_SLOW_TX 1000000
+
+struct zserv;
+
+extern void zebra_bfd_register(struct zserv *client, u_short length);
+extern void zebra_bfd_deregister(struct zserv *client, u_short length);
+extern void zebra_bfd_client_close(struct zserv *client);
+extern void zebra_bfd_init(void);
+
+#endif /* _ZEBRA_BFD_H */
@@ -29,6 +29,7 @@
 #include "thread.h"
 #include "network.h"
 #include "command.h"
+#include "memory.h"
 
 #include "zebra/rib.h"
 
@@ -41,19 +42,39 @@
  */
 #define ZFPM_CONNECT_RETRY_IVL 5
 
+/*
+ * Most FPM servers we talk to at once. Each has a bit in the
+ * fpm_update and fpm_sent masks of a rib_dest_t.
+ */
+#define ZFPM_MAX_SERVERS 8
+
 /*
  * Sizes of outgoing and incoming stream buffers for writing/reading
- * FPM messages.
+ * FPM messages. Messages are encoded in place into ZFPM_OBUF_COUNT
+ * outgoing streams, and written out of them with a single writev().
  */
-#define ZFPM_OBUF_SIZE (2 * FPM_MAX_MSG_LEN)
+#define ZFPM_OBUF_SIZE (64 * 1024)
+#define ZFPM_OBUF_COUNT 4
 #define ZFPM_IBUF_SIZE (FPM_MAX_MSG_LEN)
 
+/*
+ * Largest FPM message carrying several netlink route messages, to a
+ * server that takes them. It has to fit the 16 bits of msg_len.
+ */
+#define ZFPM_BATCH_MSG_LEN (ZFPM_OBUF_SIZE - FPM_MSG_ALIGNTO)
+
 /*
  * The maximum number of times the FPM socket write callback can call
- * 'write' before it yields.
+ * 'writev' before it yields.
  */
 #define ZFPM_MAX_WRITES_PER_RUN 10
 
+/*
+ * The most route_nodes looked at for routes to send to a server whose
+ * connection came up, each time its buffers are filled.
+ */
+#define ZFPM_RESYNC_SLICE 10000
+
 /*
  * Interval over which we collect statistics.
  */
@@ -65,7 +86,7 @@
  */
 typedef struct zfpm_rnodes_iter_t_ {
 	rib_tables_iter_t tables_iter;
-	route_table_iter_t iter;
+	route_table_walk_t walk;
 } zfpm_rnodes_iter_t;
 
 /*
@@ -98,14 +119,24 @@ typedef struct zfpm_stats_t_ {
 	unsigned long t_conn_down_yields;
 	unsigned long t_conn_down_finishes;
 
-	unsigned long t_conn_up_starts;
-	unsigned long t_conn_up_dests_processed;
-	unsigned long t_conn_up_yields;
-	unsigned long t_conn_up_aborts;
-	unsigned long t_conn_up_finishes;
+	unsigned long resync_starts;
+	unsigned long resync_dests_sent;
+	unsigned long resync_dests_skipped;
+	unsigned long resync_slices;
+	unsigned long resync_aborts;
+	unsigned long resync_finishes;
 
 } zfpm_stats_t;
 
+/*
+ * What was sent to one FPM server.
+ */
+typedef struct zfpm_server_stats_t_ {
+	unsigned long routes;
+	unsigned long messages;
+	unsigned long bytes;
+} zfpm_server_stats_t;
+
 /*
  * States for the FPM state machine.
  */
@@ -146,33 +177,47 @@ typedef enum {
 } zfpm_msg_format_e;
 
 /*
- * Globals.
+ * An FPM server, with its own connection, queue of updates and resync
+ * state, so that one slow to keep up doesn't hold back the others.
  */
-typedef struct zfpm_glob_t_ {
+typedef struct zfpm_server_t_ {
 	/*
-   * True if the FPM module has been enabled.
+   * Bit of the server in the masks of a rib_dest_t.
    */
-	int enabled;
+	u_char bit;
+
+	in_addr_t addr;
+	int port;
 
 	/*
-   * Message format to be used to communicate with the fpm.
+   * True if the server comes from the configuration rather than
+   * being the default one.
    */
-	zfpm_msg_format_e message_format;
-
-	struct thread_master *master;
+	int configured;
 
-	zfpm_state_t state;
+	/*
+   * True if the server takes several netlink route messages in one
+   * FPM message.
+   */
+	int batch;
 
-	in_addr_t fpm_server;
 	/*
-   * Port on which the FPM is running.
+   * True once the server was removed. It is freed after the state
+   * that belongs to it is cleaned up.
    */
-	int fpm_port;
+	int deleted;
+
+	zfpm_state_t state;
 
 	/*
-   * List of rib_dest_t structures to be processed
+   * rib_dest_t structures to be sent to the server, in order.
    */
-	TAILQ_HEAD(zfpm_dest_q, rib_dest_t_) dest_q;
+	struct {
+		rib_dest_t **dests;
+		unsigned int head;
+		unsigned int count;
+		unsigned int size;
+	} dest_q;
 
 	/*
    * Stream socket to the FPM.
@@ -182,7 +227,7 @@ typedef struct zfpm_glob_t_ {
 	/*
    * Buffers for messages to/from the FPM.
    */
-	struct stream *obuf;
+	struct stream *obuf[ZFPM_OBUF_COUNT];
 	struct stream *ibuf;
 
 	/*
@@ -203,18 +248,51 @@ typedef struct zfpm_glob_t_ {
 	} t_conn_down_state;
 
 	/*
-   * Thread to take actions once the TCP conn to the FPM comes up, and
-   * the state that belongs to it.
+   * True while the routes that were there when the connection came up
+   * are being sent, and where we got to in the tables.
    */
-	struct thread *t_conn_up;
+	int resync;
 
 	struct {
 		zfpm_rnodes_iter_t iter;
-	} t_conn_up_state;
+	} resync_state;
 
 	unsigned long connect_calls;
 	time_t last_connect_call_time;
 
+	/*
+   * What was sent since the stats were cleared, up to the start of
+   * the current statistics interval, and over the last interval.
+   */
+	zfpm_server_stats_t stats;
+	zfpm_server_stats_t ivl_start_stats;
+	zfpm_server_stats_t last_ivl_stats;
+
+} zfpm_server_t;
+
+/*
+ * Globals.
+ */
+typedef struct zfpm_glob_t_ {
+	/*
+   * True if the FPM module has been enabled.
+   */
+	int enabled;
+
+	/*
+   * Message format to be used to communicate with the fpm.
+   */
+	zfpm_msg_format_e message_format;
+
+	struct thread_master *master;
+
+	/*
+   * Port of the default server, used until one is configured.
+   */
+	int default_port;
+
+	zfpm_server_t *servers[ZFPM_MAX_SERVERS];
+
 	/*
    * Stats from the start of the current statistics interval up to
    * now. These are the counters we typically update in the code.
@@ -250,9 +328,10 @@ static zfpm_glob_t *zfpm_g = &zfpm_glob_space;
 static int zfpm_read_cb(struct thread *thread);
 static int zfpm_write_cb(struct thread *thread);
 
-static void zfpm_set_state(zfpm_state_t state, const char *reason);
-static void zfpm_start_connect_timer(const char *reason);
+static void zfpm_set_state(zfpm_server_t *srv, zfpm_state_t state, const char *reason);
+static void zfpm_start_connect_timer(zfpm_server_t *srv, const char *reason);
 static void zfpm_start_stats_timer(void);
+static void zfpm_server_free(zfpm_server_t *srv);
 
 /*
  * zfpm_thread_should_yield
@@ -343,12 +422,10 @@ static inline void zfpm_rnodes_iter_init(zfpm_rnodes_iter_t *iter) {
 	rib_tables_iter_init(&iter->tables_iter);
 
 	/*
-   * This is a hack, but it makes implementing 'next' easier by
-   * ensuring that route_table_iter_next() will return NULL the first
-   * time we call it.
+   * A walk over no table returns NULL the first time we call
+   * route_table_walk_next(), which gets 'next' onto the first table.
    */
-	route_table_iter_init(&iter->iter, NULL);
-	route_table_iter_cleanup(&iter->iter);
+	route_table_walk_init(&iter->walk, NULL);
 }
 
 /*
@@ -359,7 +436,7 @@ static inline struct route_node *zfpm_rnodes_iter_next(zfpm_rnodes_iter_t *iter)
 	struct route_table *table;
 
 	while(1) {
-		rn = route_table_iter_next(&iter->iter);
+		rn = route_table_walk_next(&iter->walk);
 		if(rn) {
 			return rn;
 		}
@@ -367,8 +444,6 @@ static inline struct route_node *zfpm_rnodes_iter_next(zfpm_rnodes_iter_t *iter)
 		/*
        * We've made our way through this table, go to the next one.
        */
-		route_table_iter_cleanup(&iter->iter);
-
 		while((table = rib_tables_iter_next(&iter->tables_iter))) {
 			if(zfpm_is_table_for_fpm(table)) {
 				break;
@@ -379,7 +454,7 @@ static inline struct route_node *zfpm_rnodes_iter_next(zfpm_rnodes_iter_t *iter)
 			return NULL;
 		}
 
-		route_table_iter_init(&iter->iter, table);
+		route_table_walk_init(&iter->walk, table);
 	}
 
 	return NULL;
@@ -389,14 +464,14 @@ static inline struct route_node *zfpm_rnodes_iter_next(zfpm_rnodes_iter_t *iter)
  * zfpm_rnodes_iter_pause
  */
 static inline void zfpm_rnodes_iter_pause(zfpm_rnodes_iter_t *iter) {
-	route_table_iter_pause(&iter->iter);
+	route_table_walk_pause(&iter->walk);
 }
 
 /*
  * zfpm_rnodes_iter_cleanup
  */
 static inline void zfpm_rnodes_iter_cleanup(zfpm_rnodes_iter_t *iter) {
-	route_table_iter_cleanup(&iter->iter);
+	route_table_walk_init(&iter->walk, NULL);
 	rib_tables_iter_cleanup(&iter->tables_iter);
 }
 
@@ -453,85 +528,104 @@ static void zfpm_stats_compose(const zfpm_stats_t *s1, const zfpm_stats_t *s2, z
 /*
  * zfpm_read_on
  */
-static inline void zfpm_read_on(void) {
-	assert(!zfpm_g->t_read);
-	assert(zfpm_g->sock >= 0);
+static inline void zfpm_read_on(zfpm_server_t *srv) {
+	assert(!srv->t_read);
+	assert(srv->sock >= 0);
 
-	THREAD_READ_ON(zfpm_g->master, zfpm_g->t_read, zfpm_read_cb, 0, zfpm_g->sock);
+	THREAD_READ_ON(zfpm_g->master, srv->t_read, zfpm_read_cb, srv, srv->sock);
 }
 
 /*
  * zfpm_write_on
  */
-static inline void zfpm_write_on(void) {
-	assert(!zfpm_g->t_write);
-	assert(zfpm_g->sock >= 0);
+static inline void zfpm_write_on(zfpm_server_t *srv) {
+	assert(!srv->t_write);
+	assert(srv->sock >= 0);
 
-	THREAD_WRITE_ON(zfpm_g->master, zfpm_g->t_write, zfpm_write_cb, 0, zfpm_g->sock);
+	THREAD_WRITE_ON(zfpm_g->master, srv->t_write, zfpm_write_cb, srv, srv->sock);
 }
 
 /*
  * zfpm_read_off
  */
-static inline void zfpm_read_off(void) {
-	THREAD_READ_OFF(zfpm_g->t_read);
+static inline void zfpm_read_off(zfpm_server_t *srv) {
+	THREAD_READ_OFF(srv->t_read);
 }
 
 /*
  * zfpm_write_off
  */
-static inline void zfpm_write_off(void) {
-	THREAD_WRITE_OFF(zfpm_g->t_write);
+static inline void zfpm_write_off(zfpm_server_t *srv) {
+	THREAD_WRITE_OFF(srv->t_write);
 }
 
 /*
- * zfpm_conn_up_thread_cb
+ * zfpm_dest_q_push
  *
- * Callback for actions to be taken when the connection to the FPM
- * comes up.
+ * Queue a dest to be sent to the server.
  */
-static int zfpm_conn_up_thread_cb(struct thread *thread) {
-	struct route_node *rnode;
-	zfpm_rnodes_iter_t *iter;
-	rib_dest_t *dest;
+static void zfpm_dest_q_push(zfpm_server_t *srv, rib_dest_t *dest) {
+	rib_dest_t **dests;
+	unsigned int i, size;
+
+	if(srv->dest_q.count == srv->dest_q.size) {
+		size = srv->dest_q.size ? srv->dest_q.size * 2 : 1024;
+		dests = XMALLOC(MTYPE_ZEBRA_FPM_QUEUE, size * sizeof(rib_dest_t *));
+		for(i = 0; i < srv->dest_q.count; i++) {
+			dests[i] = srv->dest_q.dests[(srv->dest_q.head + i) % srv->dest_q.size];
+		}
+		if(srv->dest_q.dests) {
+			XFREE(MTYPE_ZEBRA_FPM_QUEUE, srv->dest_q.dests);
+		}
+		srv->dest_q.dests = dests;
+		srv->dest_q.head = 0;
+		srv->dest_q.size = size;
+	}
 
-	assert(zfpm_g->t_conn_up);
-	zfpm_g->t_conn_up = NULL;
+	srv->dest_q.dests[(srv->dest_q.head + srv->dest_q.count) % srv->dest_q.size] = dest;
+	srv->dest_q.count++;
+}
 
-	iter = &zfpm_g->t_conn_up_state.iter;
+/*
+ * zfpm_dest_q_pop
+ *
+ * Returns the next dest to be sent to the server, NULL if none.
+ */
+static rib_dest_t *zfpm_dest_q_pop(zfpm_server_t *srv) {
+	rib_dest_t *dest;
 
-	if(zfpm_g->state != ZFPM_STATE_ESTABLISHED) {
-		zfpm_debug("Connection not up anymore, conn_up thread aborting");
-		zfpm_g->stats.t_conn_up_aborts++;
-		goto done;
+	if(!srv->dest_q.count) {
+		return NULL;
 	}
 
-	while((rnode = zfpm_rnodes_iter_next(iter))) {
-		dest = rib_dest_from_rnode(rnode);
+	dest = srv->dest_q.dests[srv->dest_q.head];
+	srv->dest_q.head = (srv->dest_q.head + 1) % srv->dest_q.size;
+	srv->dest_q.count--;
+	return dest;
+}
 
-		if(dest) {
-			zfpm_g->stats.t_conn_up_dests_processed++;
-			zfpm_trigger_update(rnode, NULL);
-		}
+/*
+ * zfpm_trigger_server_update
+ *
+ * Queue an update about the given dest for the server.
+ */
+static void zfpm_trigger_server_update(zfpm_server_t *srv, rib_dest_t *dest) {
+	if(dest->fpm_update & srv->bit) {
+		zfpm_g->stats.redundant_triggers++;
+		return;
+	}
 
-		/*
-       * Yield if need be.
-       */
-		if(!zfpm_thread_should_yield(thread)) {
-			continue;
-		}
+	dest->fpm_update |= srv->bit;
+	zfpm_dest_q_push(srv, dest);
 
-		zfpm_g->stats.t_conn_up_yields++;
-		zfpm_rnodes_iter_pause(iter);
-		zfpm_g->t_conn_up = thread_add_background(zfpm_g->master, zfpm_conn_up_thread_cb, 0, 0);
-		return 0;
+	/*
+   * Make sure that writes are enabled.
+   */
+	if(srv->t_write) {
+		return;
 	}
 
-	zfpm_g->stats.t_conn_up_finishes++;
-
-done:
-	zfpm_rnodes_iter_cleanup(iter);
-	return 0;
+	zfpm_write_on(srv);
 }
 
 /*
@@ -539,22 +633,21 @@ done:
  *
  * Called when the connection to the FPM comes up.
  */
-static void zfpm_connection_up(const char *detail) {
-	assert(zfpm_g->sock >= 0);
-	zfpm_read_on();
-	zfpm_write_on();
-	zfpm_set_state(ZFPM_STATE_ESTABLISHED, detail);
+static void zfpm_connection_up(zfpm_server_t *srv, const char *detail) {
+	assert(srv->sock >= 0);
+	zfpm_read_on(srv);
+	zfpm_write_on(srv);
+	zfpm_set_state(srv, ZFPM_STATE_ESTABLISHED, detail);
 
 	/*
-   * Start thread to push existing routes to the FPM.
+   * Send the existing routes to the FPM as there is room in the
+   * buffers, after the updates triggered meanwhile.
    */
-	assert(!zfpm_g->t_conn_up);
-
-	zfpm_rnodes_iter_init(&zfpm_g->t_conn_up_state.iter);
+	assert(!srv->resync);
 
-	zfpm_debug("Starting conn_up thread");
-	zfpm_g->t_conn_up = thread_add_background(zfpm_g->master, zfpm_conn_up_thread_cb, 0, 0);
-	zfpm_g->stats.t_conn_up_starts++;
+	zfpm_rnodes_iter_init(&srv->resync_state.iter);
+	srv->resync = 1;
+	zfpm_g->stats.resync_starts++;
 }
 
 /*
@@ -562,29 +655,29 @@ static void zfpm_connection_up(const char *detail) {
  *
  * Check if an asynchronous connect() to the FPM is complete.
  */
-static void zfpm_connect_check() {
+static void zfpm_connect_check(zfpm_server_t *srv) {
 	int status;
 	socklen_t slen;
 	int ret;
 
-	zfpm_read_off();
-	zfpm_write_off();
+	zfpm_read_off(srv);
+	zfpm_write_off(srv);
 
 	slen = sizeof(status);
-	ret = getsockopt(zfpm_g->sock, SOL_SOCKET, SO_ERROR, (void *) &status, &slen);
+	ret = getsockopt(srv->sock, SOL_SOCKET, SO_ERROR, (void *) &status, &slen);
 
 	if(ret >= 0 && status == 0) {
-		zfpm_connection_up("async connect complete");
+		zfpm_connection_up(srv, "async connect complete");
 		return;
 	}
 
 	/*
    * getsockopt() failed or indicated an error on the socket.
    */
-	close(zfpm_g->sock);
-	zfpm_g->sock = -1;
+	close(srv->sock);
+	srv->sock = -1;
 
-	zfpm_start_connect_timer("getsockopt() after async connect failed");
+	zfpm_start_connect_timer(srv, "getsockopt() after async connect failed");
 	return;
 }
 
@@ -595,27 +688,23 @@ static void zfpm_connect_check() {
  * to the FPM goes down.
  */
 static int zfpm_conn_down_thread_cb(struct thread *thread) {
+	zfpm_server_t *srv = THREAD_ARG(thread);
 	struct route_node *rnode;
 	zfpm_rnodes_iter_t *iter;
 	rib_dest_t *dest;
 
-	assert(zfpm_g->state == ZFPM_STATE_IDLE);
+	assert(srv->state == ZFPM_STATE_IDLE);
 
-	assert(zfpm_g->t_conn_down);
-	zfpm_g->t_conn_down = NULL;
+	assert(srv->t_conn_down);
+	srv->t_conn_down = NULL;
 
-	iter = &zfpm_g->t_conn_down_state.iter;
+	iter = &srv->t_conn_down_state.iter;
 
 	while((rnode = zfpm_rnodes_iter_next(iter))) {
 		dest = rib_dest_from_rnode(rnode);
 
 		if(dest) {
-			if(CHECK_FLAG(dest->flags, RIB_DEST_UPDATE_FPM)) {
-				TAILQ_REMOVE(&zfpm_g->dest_q, dest, fpm_q_entries);
-			}
-
-			UNSET_FLAG(dest->flags, RIB_DEST_UPDATE_FPM);
-			UNSET_FLAG(dest->flags, RIB_DEST_SENT_TO_FPM);
+			dest->fpm_sent &= ~srv->bit;
 
 			zfpm_g->stats.t_conn_down_dests_processed++;
 
@@ -634,17 +723,22 @@ static int zfpm_conn_down_thread_cb(struct thread *thread) {
 
 		zfpm_g->stats.t_conn_down_yields++;
 		zfpm_rnodes_iter_pause(iter);
-		zfpm_g->t_conn_down = thread_add_background(zfpm_g->master, zfpm_conn_down_thread_cb, 0, 0);
+		srv->t_conn_down = thread_add_background(zfpm_g->master, zfpm_conn_down_thread_cb, srv, 0);
 		return 0;
 	}
 
 	zfpm_g->stats.t_conn_down_finishes++;
 	zfpm_rnodes_iter_cleanup(iter);
 
+	if(srv->deleted) {
+		zfpm_server_free(srv);
+		return 0;
+	}
+
 	/*
    * Start the process of connecting to the FPM again.
    */
-	zfpm_start_connect_timer("cleanup complete");
+	zfpm_start_connect_timer(srv, "cleanup complete");
 	return 0;
 }
 
@@ -653,71 +747,92 @@ static int zfpm_conn_down_thread_cb(struct thread *thread) {
  *
  * Called when the connection to the FPM has gone down.
  */
-static void zfpm_connection_down(const char *detail) {
+static void zfpm_connection_down(zfpm_server_t *srv, const char *detail) {
+	struct in_addr in;
+	rib_dest_t *dest;
+	int i;
+
 	if(!detail) {
 		detail = "unknown";
 	}
 
-	assert(zfpm_g->state == ZFPM_STATE_ESTABLISHED);
+	assert(srv->state == ZFPM_STATE_ESTABLISHED);
 
-	zlog_info("connection to the FPM has gone down: %s", detail);
+	in.s_addr = srv->addr;
+	zlog_info("connection to the FPM %s port %d has gone down: %s", inet_ntoa(in), srv->port, detail);
 
-	zfpm_read_off();
-	zfpm_write_off();
+	zfpm_read_off(srv);
+	zfpm_write_off(srv);
 
-	stream_reset(zfpm_g->ibuf);
-	stream_reset(zfpm_g->obuf);
+	/*
+   * The routes still to be pushed, and those queued, will be sent
+   * again once the connection comes back.
+   */
+	if(srv->resync) {
+		srv->resync = 0;
+		zfpm_rnodes_iter_cleanup(&srv->resync_state.iter);
+		zfpm_g->stats.resync_aborts++;
+	}
+	while((dest = zfpm_dest_q_pop(srv))) {
+		dest->fpm_update &= ~srv->bit;
+	}
+
+	stream_reset(srv->ibuf);
+	for(i = 0; i < ZFPM_OBUF_COUNT; i++) {
+		stream_reset(srv->obuf[i]);
+	}
 
-	if(zfpm_g->sock >= 0) {
-		close(zfpm_g->sock);
-		zfpm_g->sock = -1;
+	if(srv->sock >= 0) {
+		close(srv->sock);
+		srv->sock = -1;
 	}
 
 	/*
    * Start thread to clean up state after the connection goes down.
    */
-	assert(!zfpm_g->t_conn_down);
+	assert(!srv->t_conn_down);
 	zfpm_debug("Starting conn_down thread");
-	zfpm_rnodes_iter_init(&zfpm_g->t_conn_down_state.iter);
-	zfpm_g->t_conn_down = thread_add_background(zfpm_g->master, zfpm_conn_down_thread_cb, 0, 0);
+	zfpm_rnodes_iter_init(&srv->t_conn_down_state.iter);
+	srv->t_conn_down = thread_add_background(zfpm_g->master, zfpm_conn_down_thread_cb, srv, 0);
 	zfpm_g->stats.t_conn_down_starts++;
 
-	zfpm_set_state(ZFPM_STATE_IDLE, detail);
+	zfpm_set_state(srv, ZFPM_STATE_IDLE, detail);
 }
 
 /*
  * zfpm_read_cb
  */
 static int zfpm_read_cb(struct thread *thread) {
+	zfpm_server_t *srv = THREAD_ARG(thread);
 	size_t already;
 	struct stream *ibuf;
 	uint16_t msg_len;
 	fpm_msg_hdr_t *hdr;
 
 	zfpm_g->stats.read_cb_calls++;
-	assert(zfpm_g->t_read);
-	zfpm_g->t_read = NULL;
+	assert(srv->t_read);
+	srv->t_read = NULL;
 
 	/*
    * Check if async connect is now done.
    */
-	if(zfpm_g->state == ZFPM_STATE_CONNECTING) {
-		zfpm_connect_check();
+	if(srv->state == ZFPM_STATE_CONNECTING) {
+		zfpm_connect_check(srv);
 		return 0;
 	}
 
-	assert(zfpm_g->state == ZFPM_STATE_ESTABLISHED);
-	assert(zfpm_g->sock >= 0);
+	assert(srv->state == ZFPM_STATE_ESTABLISHED);
+	assert(srv->sock >= 0);
 
-	ibuf = zfpm_g->ibuf;
+	ibuf = srv->ibuf;
 
 	already = stream_get_endp(ibuf);
 	if(already < FPM_MSG_HDR_LEN) {
 		ssize_t nbyte;
 
-		nbyte = stream_read_try(ibuf, zfpm_g->sock, FPM_MSG_HDR_LEN - already);
+		nbyte = stream_read_try(ibuf, srv->sock, FPM_MSG_HDR_LEN - already);
 		if(nbyte == 0 || nbyte == -1) {
-			zfpm_connection_down("closed socket in read");
+			zfpm_connection_down(srv, "closed socket in read");
 			return 0;
 		}
 
@@ -733,7 +848,7 @@ static int zfpm_read_cb(struct thread *thread) {
 	hdr = (fpm_msg_hdr_t *) stream_pnt(ibuf);
 
 	if(!fpm_msg_hdr_ok(hdr)) {
-		zfpm_connection_down("invalid message header");
+		zfpm_connection_down(srv, "invalid message header");
 		return 0;
 	}
 
@@ -745,10 +860,10 @@ static int zfpm_read_cb(struct thread *thread) {
 	if(already < msg_len) {
 		ssize_t nbyte;
 
-		nbyte = stream_read_try(ibuf, zfpm_g->sock, msg_len - already);
+		nbyte = stream_read_try(ibuf, srv->sock, msg_len - already);
 
 		if(nbyte == 0 || nbyte == -1) {
-			zfpm_connection_down("failed to read message");
+			zfpm_connection_down(srv, "failed to read message");
 			return 0;
 		}
 
@@ -765,28 +880,52 @@ static int zfpm_read_cb(struct thread *thread) {
 	stream_reset(ibuf);
 
 done:
-	zfpm_read_on();
+	zfpm_read_on(srv);
 	return 0;
 }
 
+/*
+ * zfpm_obuf_pending
+ *
+ * Returns the number of bytes in the outbound buffers that have not
+ * been written to the socket yet.
+ */
+static size_t zfpm_obuf_pending(zfpm_server_t *srv) {
+	size_t pending = 0;
+	int i;
+
+	for(i = 0; i < ZFPM_OBUF_COUNT; i++) {
+		pending += stream_get_endp(srv->obuf[i]) - stream_get_getp(srv->obuf[i]);
+	}
+
+	return pending;
+}
+
 /*
  * zfpm_writes_pending
  *
  * Returns TRUE if we may have something to write to the FPM.
  */
-static int zfpm_writes_pending(void) {
+static int zfpm_writes_pending(zfpm_server_t *srv) {
 	/*
-   * Check if there is any data in the outbound buffer that has not
+   * Check if there is any data in the outbound buffers that has not
    * been written to the socket yet.
    */
-	if(stream_get_endp(zfpm_g->obuf) - stream_get_getp(zfpm_g->obuf)) {
+	if(zfpm_obuf_pending(srv)) {
 		return 1;
 	}
 
 	/*
    * Check if there are any prefixes on the outbound queue.
    */
-	if(!TAILQ_EMPTY(&zfpm_g->dest_q)) {
+	if(srv->dest_q.count) {
+		return 1;
+	}
+
+	/*
+   * Or routes left to send since the connection came up.
+   */
+	if(srv->resync) {
 		return 1;
 	}
 
@@ -854,50 +993,148 @@ struct rib *zfpm_route_for_update(rib_dest_t *dest) {
 	return NULL;
 }
 
+/*
+ * zfpm_resync_next
+ *
+ * Returns the next dest with a route to send to a server whose
+ * connection came up, or NULL if there is none in this slice of the
+ * tables. Dests already sent or queued since, by updates triggered
+ * after the connection came up, are skipped: those bits stand for the
+ * snapshot the connection started from.
+ *
+ * Clears srv->resync once all tables were walked.
+ */
+static rib_dest_t *zfpm_resync_next(zfpm_server_t *srv, int *budget) {
+	struct route_node *rnode;
+	rib_dest_t *dest;
+
+	while(*budget > 0) {
+		(*budget)--;
+
+		rnode = zfpm_rnodes_iter_next(&srv->resync_state.iter);
+		if(!rnode) {
+			zfpm_rnodes_iter_cleanup(&srv->resync_state.iter);
+			srv->resync = 0;
+			zfpm_g->stats.resync_finishes++;
+			zfpm_debug("sent all routes to the FPM since the connection came up");
+			return NULL;
+		}
+
+		dest = rib_dest_from_rnode(rnode);
+		if(!dest || !zfpm_route_for_update(dest)) {
+			continue;
+		}
+
+		if((dest->fpm_update | dest->fpm_sent) & srv->bit) {
+			zfpm_g->stats.resync_dests_skipped++;
+			continue;
+		}
+
+		zfpm_g->stats.resync_dests_sent++;
+		return dest;
+	}
+
+	return NULL;
+}
+
+/*
+ * zfpm_encode_sync_done
+ *
+ * Tell the server it was sent all routes there were when its
+ * connection came up. Only netlink has a way to say so, the message
+ * ending a dump.
+ */
+static void zfpm_encode_sync_done(zfpm_server_t *srv, struct stream *s) {
+#ifdef HAVE_NETLINK
+	fpm_msg_hdr_t *hdr;
+	size_t data_len;
+
+	if(zfpm_g->message_format != ZFPM_MSG_FORMAT_NETLINK) {
+		return;
+	}
+
+	hdr = (fpm_msg_hdr_t *) (STREAM_DATA(s) + stream_get_endp(s));
+	data_len = zfpm_netlink_encode_done((char *) fpm_msg_data(hdr), STREAM_WRITEABLE(s) - FPM_MSG_HDR_LEN);
+	if(!data_len) {
+		return;
+	}
+
+	hdr->version = FPM_PROTO_VERSION;
+	hdr->msg_type = FPM_MSG_TYPE_NETLINK;
+	hdr->msg_len = htons(FPM_MSG_HDR_LEN + data_len);
+	stream_forward_endp(s, FPM_MSG_HDR_LEN + data_len);
+	srv->stats.messages++;
+#endif /* HAVE_NETLINK */
+}
+
 /*
  * zfpm_build_updates
  *
- * Process the outgoing queue and write messages to the outbound
- * buffer.
+ * Process the server's outgoing queue and write messages to the
+ * outbound buffers, in place. To a server that takes several routes
+ * per message, consecutive netlink route messages are appended to the
+ * same FPM message, as long as it remains within ZFPM_BATCH_MSG_LEN.
+ *
+ * Once the queue is empty, the buffers are filled with the routes left
+ * to send since the connection came up, a slice of the tables at a
+ * time, so that updates keep going out ahead of those.
  */
-static void zfpm_build_updates(void) {
+static void zfpm_build_updates(zfpm_server_t *srv) {
 	struct stream *s;
 	rib_dest_t *dest;
-	unsigned char *buf, *data, *buf_end;
+	unsigned char *data, *buf_end;
 	size_t msg_len;
 	size_t data_len;
 	fpm_msg_hdr_t *hdr;
 	struct rib *rib;
-	int is_add, write_msg;
+	int is_add, write_msg, batch, budget, i;
 	fpm_msg_type_e msg_type;
 
-	s = zfpm_g->obuf;
+	batch = srv->batch && zfpm_g->message_format == ZFPM_MSG_FORMAT_NETLINK;
 
+	i = 0;
+	s = srv->obuf[i];
 	assert(stream_empty(s));
 
-	do {
+	/*
+   * The message being added to, if batching.
+   */
+	hdr = NULL;
+	msg_len = 0;
+
+	budget = ZFPM_RESYNC_SLICE;
+
+	while(srv->dest_q.count || srv->resync) {
 		/*
-     * Make sure there is enough space to write another message.
+     * Make sure there is enough space to write another message,
+     * moving on to the next buffer if need be.
      */
 		if(STREAM_WRITEABLE(s) < FPM_MAX_MSG_LEN) {
-			break;
+			if(++i == ZFPM_OBUF_COUNT) {
+				break;
+			}
+			s = srv->obuf[i];
+			assert(stream_empty(s));
+			hdr = NULL;
 		}
 
-		buf = STREAM_DATA(s) + stream_get_endp(s);
-		buf_end = buf + STREAM_WRITEABLE(s);
+		if(hdr && msg_len + FPM_MAX_MSG_LEN > ZFPM_BATCH_MSG_LEN) {
+			hdr = NULL;
+		}
 
-		dest = TAILQ_FIRST(&zfpm_g->dest_q);
+		dest = zfpm_dest_q_pop(srv);
 		if(!dest) {
-			break;
+			dest = zfpm_resync_next(srv, &budget);
+			if(!dest) {
+				if(!srv->resync) {
+					zfpm_encode_sync_done(srv, s);
+				}
+				break;
+			}
+		} else {
+			assert(dest->fpm_update & srv->bit);
 		}
 
-		assert(CHECK_FLAG(dest->flags, RIB_DEST_UPDATE_FPM));
-
-		hdr = (fpm_msg_hdr_t *) buf;
-		hdr->version = FPM_PROTO_VERSION;
-
-		data = fpm_msg_data(hdr);
-
 		rib = zfpm_route_for_update(dest);
 		is_add = rib ? 1 : 0;
 
@@ -907,20 +1144,34 @@ static void zfpm_build_updates(void) {
      * If this is a route deletion, and we have not sent the route to
      * the FPM previously, skip it.
      */
-		if(!is_add && !CHECK_FLAG(dest->flags, RIB_DEST_SENT_TO_FPM)) {
+		if(!is_add && !(dest->fpm_sent & srv->bit)) {
 			write_msg = 0;
 			zfpm_g->stats.nop_deletes_skipped++;
 		}
 
 		if(write_msg) {
+			buf_end = STREAM_DATA(s) + STREAM_SIZE(s);
+
+			if(hdr) {
+				data = STREAM_DATA(s) + stream_get_endp(s);
+			} else {
+				hdr = (fpm_msg_hdr_t *) (STREAM_DATA(s) + stream_get_endp(s));
+				hdr->version = FPM_PROTO_VERSION;
+				data = fpm_msg_data(hdr);
+				msg_len = FPM_MSG_HDR_LEN;
+				stream_forward_endp(s, FPM_MSG_HDR_LEN);
+				srv->stats.messages++;
+			}
+
 			data_len = zfpm_encode_route(dest, rib, (char *) data, buf_end - data, &msg_type);
 
 			assert(data_len);
 			if(data_len) {
 				hdr->msg_type = msg_type;
-				msg_len = fpm_data_len_to_msg_len(data_len);
+				msg_len += data_len;
 				hdr->msg_len = htons(msg_len);
-				stream_forward_endp(s, msg_len);
+				stream_forward_endp(s, data_len);
+				srv->stats.routes++;
 
 				if(is_add) {
 					zfpm_g->stats.route_adds++;
@@ -928,18 +1179,21 @@ static void zfpm_build_updates(void) {
 					zfpm_g->stats.route_dels++;
 				}
 			}
+
+			if(!batch) {
+				hdr = NULL;
+			}
 		}
 
 		/*
-     * Remove the dest from the queue, and reset the flag.
+     * The dest was taken off the queue, reset the flag.
      */
-		UNSET_FLAG(dest->flags, RIB_DEST_UPDATE_FPM);
-		TAILQ_REMOVE(&zfpm_g->dest_q, dest, fpm_q_entries);
+		dest->fpm_update &= ~srv->bit;
 
 		if(is_add) {
-			SET_FLAG(dest->flags, RIB_DEST_SENT_TO_FPM);
+			dest->fpm_sent |= srv->bit;
 		} else {
-			UNSET_FLAG(dest->flags, RIB_DEST_SENT_TO_FPM);
+			dest->fpm_sent &= ~srv->bit;
 		}
 
 		/*
@@ -948,52 +1202,74 @@ static void zfpm_build_updates(void) {
 		if(rib_gc_dest(dest->rnode)) {
 			zfpm_g->stats.dests_del_after_update++;
 		}
+	}
 
-	} while(1);
+	if(srv->resync) {
+		zfpm_rnodes_iter_pause(&srv->resync_state.iter);
+		zfpm_g->stats.resync_slices++;
+	}
 }
 
 /*
  * zfpm_write_cb
  */
 static int zfpm_write_cb(struct thread *thread) {
+	zfpm_server_t *srv = THREAD_ARG(thread);
+	struct iovec iov[ZFPM_OBUF_COUNT];
 	struct stream *s;
-	int num_writes;
+	size_t bytes_to_write, len;
+	ssize_t bytes_written;
+	int num_writes, iovcnt, i;
 
 	zfpm_g->stats.write_cb_calls++;
-	assert(zfpm_g->t_write);
-	zfpm_g->t_write = NULL;
+	assert(srv->t_write);
+	srv->t_write = NULL;
 
 	/*
    * Check if async connect is now done.
    */
-	if(zfpm_g->state == ZFPM_STATE_CONNECTING) {
-		zfpm_connect_check();
+	if(srv->state == ZFPM_STATE_CONNECTING) {
+		zfpm_connect_check(srv);
 		return 0;
 	}
 
-	assert(zfpm_g->state == ZFPM_STATE_ESTABLISHED);
-	assert(zfpm_g->sock >= 0);
+	assert(srv->state == ZFPM_STATE_ESTABLISHED);
+	assert(srv->sock >= 0);
 
 	num_writes = 0;
 
 	do {
-		int bytes_to_write, bytes_written;
-
-		s = zfpm_g->obuf;
-
 		/*
-       * If the stream is empty, try fill it up with data.
+       * If the buffers are written out, try fill them up with data.
        */
-		if(stream_empty(s)) {
-			zfpm_build_updates();
+		if(!zfpm_obuf_pending(srv)) {
+			for(i = 0; i < ZFPM_OBUF_COUNT; i++) {
+				stream_reset(srv->obuf[i]);
+			}
+			zfpm_build_updates(srv);
 		}
 
-		bytes_to_write = stream_get_endp(s) - stream_get_getp(s);
+		/*
+       * Write what the buffers hold straight out of them.
+       */
+		bytes_to_write = 0;
+		iovcnt = 0;
+		for(i = 0; i < ZFPM_OBUF_COUNT; i++) {
+			s = srv->obuf[i];
+			len = stream_get_endp(s) - stream_get_getp(s);
+			if(!len) {
+				continue;
+			}
+			iov[iovcnt].iov_base = STREAM_PNT(s);
+			iov[iovcnt].iov_len = len;
+			iovcnt++;
+			bytes_to_write += len;
+		}
 		if(!bytes_to_write) {
 			break;
 		}
 
-		bytes_written = write(zfpm_g->sock, STREAM_PNT(s), bytes_to_write);
+		bytes_written = writev(srv->sock, iov, iovcnt);
 		zfpm_g->stats.write_calls++;
 		num_writes++;
 
@@ -1002,23 +1278,35 @@ static int zfpm_write_cb(struct thread *thread) {
 				break;
 			}
 
-			zfpm_connection_down("failed to write to socket");
+			zfpm_connection_down(srv, "failed to write to socket");
 			return 0;
 		}
 
-		if(bytes_written != bytes_to_write) {
+		srv->stats.bytes += bytes_written;
+
+		if((size_t) bytes_written != bytes_to_write) {
 			/*
 	   * Partial write.
 	   */
-			stream_forward_getp(s, bytes_written);
+			for(i = 0; i < ZFPM_OBUF_COUNT && bytes_written; i++) {
+				s = srv->obuf[i];
+				len = stream_get_endp(s) - stream_get_getp(s);
+				if(len > (size_t) bytes_written) {
+					len = bytes_written;
+				}
+				stream_forward_getp(s, len);
+				bytes_written -= len;
+			}
 			zfpm_g->stats.partial_writes++;
 			break;
 		}
 
 		/*
-       * We've written out the entire contents of the stream.
+       * We've written out the entire contents of the buffers.
        */
-		stream_reset(s);
+		for(i = 0; i < ZFPM_OBUF_COUNT; i++) {
+			stream_reset(srv->obuf[i]);
+		}
 
 		if(num_writes >= ZFPM_MAX_WRITES_PER_RUN) {
 			zfpm_g->stats.max_writes_hit++;
@@ -1031,8 +1319,8 @@ static int zfpm_write_cb(struct thread *thread) {
 		}
 	} while(1);
 
-	if(zfpm_writes_pending()) {
-		zfpm_write_on();
+	if(zfpm_writes_pending(srv)) {
+		zfpm_write_on(srv);
 	}
 
 	return 0;
@@ -1042,12 +1330,13 @@ static int zfpm_write_cb(struct thread *thread) {
  * zfpm_connect_cb
  */
 static int zfpm_connect_cb(struct thread *t) {
+	zfpm_server_t *srv = THREAD_ARG(t);
 	int sock, ret;
 	struct sockaddr_in serv;
 
-	assert(zfpm_g->t_connect);
-	zfpm_g->t_connect = NULL;
-	assert(zfpm_g->state == ZFPM_STATE_ACTIVE);
+	assert(srv->t_connect);
+	srv->t_connect = NULL;
+	assert(srv->state == ZFPM_STATE_ACTIVE);
 
 	sock = socket(AF_INET, SOCK_STREAM, 0);
 	if(sock < 0) {
@@ -1061,35 +1350,35 @@ static int zfpm_connect_cb(struct thread *t) {
 	/* Make server socket. */
 	memset(&serv, 0, sizeof(serv));
 	serv.sin_family = AF_INET;
-	serv.sin_port = htons(zfpm_g->fpm_port);
+	serv.sin_port = htons(srv->port);
 #ifdef HAVE_STRUCT_SOCKADDR_IN_SIN_LEN
 	serv.sin_len = sizeof(struct sockaddr_in);
 #endif /* HAVE_STRUCT_SOCKADDR_IN_SIN_LEN */
-	if(!zfpm_g->fpm_server) {
+	if(!srv->addr) {
 		serv.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
 	} else {
-		serv.sin_addr.s_addr = (zfpm_g->fpm_server);
+		serv.sin_addr.s_addr = (srv->addr);
 	}
 
 	/*
    * Connect to the FPM.
    */
-	zfpm_g->connect_calls++;
+	srv->connect_calls++;
 	zfpm_g->stats.connect_calls++;
-	zfpm_g->last_connect_call_time = zfpm_get_time();
+	srv->last_connect_call_time = zfpm_get_time();
 
 	ret = connect(sock, (struct sockaddr *) &serv, sizeof(serv));
 	if(ret >= 0) {
-		zfpm_g->sock = sock;
-		zfpm_connection_up("connect succeeded");
+		srv->sock = sock;
+		zfpm_connection_up(srv, "connect succeeded");
 		return 1;
 	}
 
 	if(errno == EINPROGRESS) {
-		zfpm_g->sock = sock;
-		zfpm_read_on();
-		zfpm_write_on();
-		zfpm_set_state(ZFPM_STATE_CONNECTING, "async connect in progress");
+		srv->sock = sock;
+		zfpm_read_on(srv);
+		zfpm_write_on(srv);
+		zfpm_set_state(srv, ZFPM_STATE_CONNECTING, "async connect in progress");
 		return 0;
 	}
 
@@ -1099,7 +1388,7 @@ static int zfpm_connect_cb(struct thread *t) {
 	/*
    * Restart timer for retrying connection.
    */
-	zfpm_start_connect_timer("connect() failed");
+	zfpm_start_connect_timer(srv, "connect() failed");
 	return 0;
 }
 
@@ -1108,8 +1397,8 @@ static int zfpm_connect_cb(struct thread *t) {
  *
  * Move state machine into the given state.
  */
-static void zfpm_set_state(zfpm_state_t state, const char *reason) {
-	zfpm_state_t cur_state = zfpm_g->state;
+static void zfpm_set_state(zfpm_server_t *srv, zfpm_state_t state, const char *reason) {
+	zfpm_state_t cur_state = srv->state;
 
 	if(!reason) {
 		reason = "Unknown";
@@ -1126,25 +1415,25 @@ static void zfpm_set_state(zfpm_state_t state, const char *reason) {
 
 		case ZFPM_STATE_ACTIVE:
 			assert(cur_state == ZFPM_STATE_IDLE || cur_state == ZFPM_STATE_CONNECTING);
-			assert(zfpm_g->t_connect);
+			assert(srv->t_connect);
 			break;
 
 		case ZFPM_STATE_CONNECTING:
-			assert(zfpm_g->sock);
+			assert(srv->sock);
 			assert(cur_state == ZFPM_STATE_ACTIVE);
-			assert(zfpm_g->t_read);
-			assert(zfpm_g->t_write);
+			assert(srv->t_read);
+			assert(srv->t_write);
 			break;
 
 		case ZFPM_STATE_ESTABLISHED:
 			assert(cur_state == ZFPM_STATE_ACTIVE || cur_state == ZFPM_STATE_CONNECTING);
-			assert(zfpm_g->sock);
-			assert(zfpm_g->t_read);
-			assert(zfpm_g->t_write);
+			assert(srv->sock);
+			assert(srv->t_read);
+			assert(srv->t_write);
 			break;
 	}
 
-	zfpm_g->state = state;
+	srv->state = state;
 }
 
 /*
@@ -1153,17 +1442,17 @@ static void zfpm_set_state(zfpm_state_t state, const char *reason) {
  * Returns the number of seconds after which we should attempt to
  * reconnect to the FPM.
  */
-static long zfpm_calc_connect_delay(void) {
+static long zfpm_calc_connect_delay(zfpm_server_t *srv) {
 	time_t elapsed;
 
 	/*
    * Return 0 if this is our first attempt to connect.
    */
-	if(zfpm_g->connect_calls == 0) {
+	if(srv->connect_calls == 0) {
 		return 0;
 	}
 
-	elapsed = zfpm_get_elapsed_time(zfpm_g->last_connect_call_time);
+	elapsed = zfpm_get_elapsed_time(srv->last_connect_call_time);
 
 	if(elapsed > ZFPM_CONNECT_RETRY_IVL) {
 		return 0;
@@ -1175,19 +1464,19 @@ static long zfpm_calc_connect_delay(void) {
 /*
  * zfpm_start_connect_timer
  */
-static void zfpm_start_connect_timer(const char *reason) {
+static void zfpm_start_connect_timer(zfpm_server_t *srv, const char *reason) {
 	long delay_secs;
 
-	assert(!zfpm_g->t_connect);
-	assert(zfpm_g->sock < 0);
+	assert(!srv->t_connect);
+	assert(srv->sock < 0);
 
-	assert(zfpm_g->state == ZFPM_STATE_IDLE || zfpm_g->state == ZFPM_STATE_ACTIVE || zfpm_g->state == ZFPM_STATE_CONNECTING);
+	assert(srv->state == ZFPM_STATE_IDLE || srv->state == ZFPM_STATE_ACTIVE || srv->state == ZFPM_STATE_CONNECTING);
 
-	delay_secs = zfpm_calc_connect_delay();
+	delay_secs = zfpm_calc_connect_delay(srv);
 	zfpm_debug("scheduling connect in %ld seconds", delay_secs);
 
-	THREAD_TIMER_ON(zfpm_g->master, zfpm_g->t_connect, zfpm_connect_cb, 0, delay_secs);
-	zfpm_set_state(ZFPM_STATE_ACTIVE, reason);
+	THREAD_TIMER_ON(zfpm_g->master, srv->t_connect, zfpm_connect_cb, srv, delay_secs);
+	zfpm_set_state(srv, ZFPM_STATE_ACTIVE, reason);
 }
 
 /*
@@ -1202,33 +1491,146 @@ static inline int zfpm_is_enabled(void) {
 /*
  * zfpm_conn_is_up
  *
- * Returns TRUE if the connection to the FPM is up.
+ * Returns TRUE if the connection to the FPM server is up.
  */
-static inline int zfpm_conn_is_up(void) {
-	if(zfpm_g->state != ZFPM_STATE_ESTABLISHED) {
+static inline int zfpm_conn_is_up(zfpm_server_t *srv) {
+	if(srv->state != ZFPM_STATE_ESTABLISHED) {
 		return 0;
 	}
 
-	assert(zfpm_g->sock >= 0);
+	assert(srv->sock >= 0);
 
 	return 1;
 }
 
+/*
+ * zfpm_server_new
+ *
+ * Add a server to talk to, connecting to it if the module is enabled.
+ * Returns NULL if there are too many already.
+ */
+static zfpm_server_t *zfpm_server_new(in_addr_t addr, int port) {
+	zfpm_server_t *srv;
+	int i;
+
+	for(i = 0; i < ZFPM_MAX_SERVERS; i++) {
+		if(!zfpm_g->servers[i]) {
+			break;
+		}
+	}
+	if(i == ZFPM_MAX_SERVERS) {
+		return NULL;
+	}
+
+	srv = XCALLOC(MTYPE_ZEBRA_FPM_SERVER, sizeof(zfpm_server_t));
+	srv->bit = 1 << i;
+	srv->addr = addr;
+	srv->port = port;
+	srv->sock = -1;
+	srv->state = ZFPM_STATE_IDLE;
+	for(i = 0; i < ZFPM_OBUF_COUNT; i++) {
+		srv->obuf[i] = stream_new(ZFPM_OBUF_SIZE);
+	}
+	srv->ibuf = stream_new(ZFPM_IBUF_SIZE);
+	zfpm_g->servers[ffs(srv->bit) - 1] = srv;
+
+	if(zfpm_is_enabled()) {
+		zfpm_start_connect_timer(srv, "server added");
+	}
+
+	return srv;
+}
+
+/*
+ * zfpm_server_free
+ */
+static void zfpm_server_free(zfpm_server_t *srv) {
+	int i;
+
+	zfpm_g->servers[ffs(srv->bit) - 1] = NULL;
+
+	THREAD_OFF(srv->t_connect);
+	THREAD_OFF(srv->t_read);
+	THREAD_OFF(srv->t_write);
+	if(srv->sock >= 0) {
+		close(srv->sock);
+	}
+
+	for(i = 0; i < ZFPM_OBUF_COUNT; i++) {
+		stream_free(srv->obuf[i]);
+	}
+	stream_free(srv->ibuf);
+	if(srv->dest_q.dests) {
+		XFREE(MTYPE_ZEBRA_FPM_QUEUE, srv->dest_q.dests);
+	}
+	XFREE(MTYPE_ZEBRA_FPM_SERVER, srv);
+}
+
+/*
+ * zfpm_server_delete
+ *
+ * Stop talking to the server. Once connected, it is freed after the
+ * routes sent to it are accounted as no longer sent.
+ */
+static void zfpm_server_delete(zfpm_server_t *srv) {
+	srv->deleted = 1;
+
+	switch(srv->state) {
+		case ZFPM_STATE_ESTABLISHED: zfpm_connection_down(srv, "server removed"); return;
+
+		case ZFPM_STATE_IDLE:
+			if(srv->t_conn_down) {
+				return;
+			}
+			break;
+
+		default: break;
+	}
+
+	zfpm_server_free(srv);
+}
+
+/*
+ * zfpm_server_lookup
+ */
+static zfpm_server_t *zfpm_server_lookup(in_addr_t addr, int port) {
+	zfpm_server_t *srv;
+	int i;
+
+	for(i = 0; i < ZFPM_MAX_SERVERS; i++) {
+		srv = zfpm_g->servers[i];
+		if(srv && !srv->deleted && srv->addr == addr && srv->port == port) {
+			return srv;
+		}
+	}
+
+	return NULL;
+}
+
 /*
  * zfpm_trigger_update
  *
  * The zebra code invokes this function to indicate that we should
- * send an update to the FPM about the given route_node.
+ * send an update to the FPM servers about the given route_node.
  */
 void zfpm_trigger_update(struct route_node *rn, const char *reason) {
 	rib_dest_t *dest;
+	zfpm_server_t *srv;
 	char buf[PREFIX_STRLEN];
+	int i, up;
 
 	/*
-   * Ignore if the connection is down. We will update the FPM about
-   * all destinations once the connection comes up.
+   * Ignore the servers whose connection is down. We will update each
+   * about all destinations once its connection comes up.
    */
-	if(!zfpm_conn_is_up()) {
+	up = 0;
+	for(i = 0; i < ZFPM_MAX_SERVERS; i++) {
+		if((srv = zfpm_g->servers[i]) && zfpm_conn_is_up(srv)) {
+			up = 1;
+			break;
+		}
+	}
+	if(!up) {
 		return;
 	}
 
@@ -1243,33 +1645,34 @@ void zfpm_trigger_update(struct route_node *rn, const char *reason) {
 		return;
 	}
 
-	if(CHECK_FLAG(dest->flags, RIB_DEST_UPDATE_FPM)) {
-		zfpm_g->stats.redundant_triggers++;
-		return;
-	}
-
 	if(reason) {
 		zfpm_debug("%s triggering update to FPM - Reason: %s", prefix2str(&rn->p, buf, sizeof(buf)), reason);
 	}
 
-	SET_FLAG(dest->flags, RIB_DEST_UPDATE_FPM);
-	TAILQ_INSERT_TAIL(&zfpm_g->dest_q, dest, fpm_q_entries);
 	zfpm_g->stats.updates_triggered++;
-
-	/*
-   * Make sure that writes are enabled.
-   */
-	if(zfpm_g->t_write) {
-		return;
+	for(; i < ZFPM_MAX_SERVERS; i++) {
+		if((srv = zfpm_g->servers[i]) && zfpm_conn_is_up(srv)) {
+			zfpm_trigger_server_update(srv, dest);
+		}
 	}
+}
 
-	zfpm_write_on();
+/*
+ * zfpm_server_stats_sub
+ */
+static void zfpm_server_stats_sub(const zfpm_server_stats_t *s1, const zfpm_server_stats_t *s2, zfpm_server_stats_t *result) {
+	result->routes = s1->routes - s2->routes;
+	result->messages = s1->messages - s2->messages;
+	result->bytes = s1->bytes - s2->bytes;
 }
 
 /*
  * zfpm_stats_timer_cb
  */
 static int zfpm_stats_timer_cb(struct thread *t) {
+	zfpm_server_t *srv;
+	int i;
+
 	assert(zfpm_g->t_stats);
 	zfpm_g->t_stats = NULL;
 
@@ -1289,6 +1692,13 @@ static int zfpm_stats_timer_cb(struct thread *t) {
    */
 	zfpm_stats_reset(&zfpm_g->stats);
 
+	for(i = 0; i < ZFPM_MAX_SERVERS; i++) {
+		if((srv = zfpm_g->servers[i])) {
+			zfpm_server_stats_sub(&srv->stats, &srv->ivl_start_stats, &srv->last_ivl_stats);
+			srv->ivl_start_stats = srv->stats;
+		}
+	}
+
 	zfpm_start_stats_timer();
 
 	return 0;
@@ -1323,6 +1733,29 @@ void zfpm_start_stats_timer(void) {
 		vty_out(vty, "%-40s %10lu %16lu%s", #counter, total_stats.counter, zfpm_g->last_ivl_stats.counter, VTY_NEWLINE); \
 	} while(0)
 
+/*
+ * zfpm_show_server_stats
+ *
+ * Show what went out to each server, and at what rate over the last
+ * interval.
+ */
+static void zfpm_show_server_stats(struct vty *vty) {
+	zfpm_server_t *srv;
+	struct in_addr in;
+	int i;
+
+	for(i = 0; i < ZFPM_MAX_SERVERS; i++) {
+		if(!(srv = zfpm_g->servers[i])) {
+			continue;
+		}
+
+		in.s_addr = srv->addr;
+		vty_out(vty, "%sServer %s port %d%s: %s, %u routes queued%s%s", VTY_NEWLINE, inet_ntoa(in), srv->port, srv->batch ? " batch" : "", srv->deleted ? "removed" : zfpm_state_to_str(srv->state), srv->dest_q.count, srv->resync ? ", resyncing" : "", VTY_NEWLINE);
+		vty_out(vty, "  %lu routes in %lu messages, %lu bytes%s", srv->stats.routes, srv->stats.messages, srv->stats.bytes, VTY_NEWLINE);
+		vty_out(vty, "  Last %d secs: %lu routes/s, %lu messages/s, %lu bytes/s%s", ZFPM_STATS_IVL_SECS, srv->last_ivl_stats.routes / ZFPM_STATS_IVL_SECS, srv->last_ivl_stats.messages / ZFPM_STATS_IVL_SECS, srv->last_ivl_stats.bytes / ZFPM_STATS_IVL_SECS, VTY_NEWLINE);
+	}
+}
+
 /*
  * zfpm_show_stats
  */
@@ -1356,11 +1789,14 @@ static void zfpm_show_stats(struct vty *vty) {
 	ZFPM_SHOW_STAT(t_conn_down_dests_processed);
 	ZFPM_SHOW_STAT(t_conn_down_yields);
 	ZFPM_SHOW_STAT(t_conn_down_finishes);
-	ZFPM_SHOW_STAT(t_conn_up_starts);
-	ZFPM_SHOW_STAT(t_conn_up_dests_processed);
-	ZFPM_SHOW_STAT(t_conn_up_yields);
-	ZFPM_SHOW_STAT(t_conn_up_aborts);
-	ZFPM_SHOW_STAT(t_conn_up_finishes);
+	ZFPM_SHOW_STAT(resync_starts);
+	ZFPM_SHOW_STAT(resync_dests_sent);
+	ZFPM_SHOW_STAT(resync_dests_skipped);
+	ZFPM_SHOW_STAT(resync_slices);
+	ZFPM_SHOW_STAT(resync_aborts);
+	ZFPM_SHOW_STAT(resync_finishes);
+
+	zfpm_show_server_stats(vty);
 
 	if(!zfpm_g->last_stats_clear_time) {
 		return;
@@ -1375,6 +1811,9 @@ static void zfpm_show_stats(struct vty *vty) {
  * zfpm_clear_stats
  */
 static void zfpm_clear_stats(struct vty *vty) {
+	zfpm_server_t *srv;
+	int i;
+
 	if(!zfpm_is_enabled()) {
 		vty_out(vty, "The FPM module is not enabled...%s", VTY_NEWLINE);
 		return;
@@ -1384,6 +1823,14 @@ static void zfpm_clear_stats(struct vty *vty) {
 	zfpm_stats_reset(&zfpm_g->last_ivl_stats);
 	zfpm_stats_reset(&zfpm_g->cumulative_stats);
 
+	for(i = 0; i < ZFPM_MAX_SERVERS; i++) {
+		if((srv = zfpm_g->servers[i])) {
+			memset(&srv->stats, 0, sizeof(srv->stats));
+			memset(&srv->ivl_start_stats, 0, sizeof(srv->ivl_start_stats));
+			memset(&srv->last_ivl_stats, 0, sizeof(srv->last_ivl_stats));
+		}
+	}
+
 	zfpm_stop_stats_timer();
 	zfpm_start_stats_timer();
 
@@ -1415,42 +1862,90 @@ DEFUN(clear_zebra_fpm_stats, clear_zebra_fpm_stats_cmd, "clear zebra fpm stats",
 }
 
 /*
- * update fpm connection information 
+ * zfpm_server_config
+ *
+ * Add a server to talk to, in place of the default one for the first,
+ * or change how routes are sent to one already there.
  */
-DEFUN(fpm_remote_ip, fpm_remote_ip_cmd, "fpm connection ip A.B.C.D port <1-65535>",
-      "fpm connection remote ip and port\n"
-      "Remote fpm server ip A.B.C.D\n"
-      "Enter ip ") {
+static int zfpm_server_config(struct vty *vty, const char *addr_str, const char *port_str, int batch) {
+	zfpm_server_t *srv;
 	in_addr_t fpm_server;
 	uint32_t port_no;
+	int i;
 
-	fpm_server = inet_addr(argv[0]);
+	fpm_server = inet_addr(addr_str);
 	if(fpm_server == INADDR_NONE) {
 		return CMD_ERR_INCOMPLETE;
 	}
 
-	port_no = atoi(argv[1]);
+	port_no = atoi(port_str);
 	if(port_no < TCP_MIN_PORT || port_no > TCP_MAX_PORT) {
 		return CMD_ERR_INCOMPLETE;
 	}
 
-	zfpm_g->fpm_server = fpm_server;
-	zfpm_g->fpm_port = port_no;
+	srv = zfpm_server_lookup(fpm_server, port_no);
+	if(!srv) {
+		for(i = 0; i < ZFPM_MAX_SERVERS; i++) {
+			if(zfpm_g->servers[i] && !zfpm_g->servers[i]->configured && !zfpm_g->servers[i]->deleted) {
+				zfpm_server_delete(zfpm_g->servers[i]);
+			}
+		}
+
+		srv = zfpm_server_new(fpm_server, port_no);
+		if(!srv) {
+			vty_out(vty, "%% No more than %d FPM servers, or being removed%s", ZFPM_MAX_SERVERS, VTY_NEWLINE);
+			return CMD_WARNING;
+		}
+	}
+
+	srv->configured = 1;
+	srv->batch = batch;
 
 	return CMD_SUCCESS;
 }
 
+/*
+ * update fpm connection information
+ */
+DEFUN(fpm_remote_ip, fpm_remote_ip_cmd, "fpm connection ip A.B.C.D port <1-65535>",
+      "fpm connection remote ip and port\n"
+      "Remote fpm server ip A.B.C.D\n"
+      "Enter ip ") {
+	return zfpm_server_config(vty, argv[0], argv[1], 0);
+}
+
+DEFUN(fpm_remote_ip_batch, fpm_remote_ip_batch_cmd, "fpm connection ip A.B.C.D port <1-65535> batch",
+      "fpm connection remote ip and port\n"
+      "Remote fpm server ip A.B.C.D\n"
+      "Enter ip "
+      "Send several routes in each netlink message\n") {
+	return zfpm_server_config(vty, argv[0], argv[1], 1);
+}
+
 DEFUN(no_fpm_remote_ip, no_fpm_remote_ip_cmd, "no fpm connection ip A.B.C.D port <1-65535>",
       "fpm connection remote ip and port\n"
       "Connection\n"
       "Remote fpm server ip A.B.C.D\n"
       "Enter ip ") {
-	if(zfpm_g->fpm_server != inet_addr(argv[0]) || zfpm_g->fpm_port != atoi(argv[1])) {
+	zfpm_server_t *srv;
+	int i;
+
+	srv = zfpm_server_lookup(inet_addr(argv[0]), atoi(argv[1]));
+	if(!srv || !srv->configured) {
 		return CMD_ERR_NO_MATCH;
 	}
 
-	zfpm_g->fpm_server = FPM_DEFAULT_IP;
-	zfpm_g->fpm_port = FPM_DEFAULT_PORT;
+	zfpm_server_delete(srv);
+
+	/*
+   * Back to the default server once none is configured.
+   */
+	for(i = 0; i < ZFPM_MAX_SERVERS; i++) {
+		if(zfpm_g->servers[i] && !zfpm_g->servers[i]->deleted) {
+			return CMD_SUCCESS;
+		}
+	}
+	zfpm_server_new(FPM_DEFAULT_IP, zfpm_g->default_port);
 
 	return CMD_SUCCESS;
 }
@@ -1504,20 +1999,26 @@ static inline void zfpm_init_message_format(const char *format) {
 }
 
 /**
- * fpm_remote_srv_write 
+ * fpm_remote_srv_write
  *
- * Module to write remote fpm connection 
+ * Module to write remote fpm connection
  *
  * Returns ZERO on success.
  */
 
 int fpm_remote_srv_write(struct vty *vty) {
+	zfpm_server_t *srv;
 	struct in_addr in;
+	int i;
 
-	in.s_addr = zfpm_g->fpm_server;
+	for(i = 0; i < ZFPM_MAX_SERVERS; i++) {
+		srv = zfpm_g->servers[i];
+		if(!srv || srv->deleted || !srv->configured) {
+			continue;
+		}
 
-	if(zfpm_g->fpm_server != FPM_DEFAULT_IP || zfpm_g->fpm_port != FPM_DEFAULT_PORT) {
-		vty_out(vty, "fpm connection ip %s port %d%s", inet_ntoa(in), zfpm_g->fpm_port, VTY_NEWLINE);
+		in.s_addr = srv->addr;
+		vty_out(vty, "fpm connection ip %s port %d%s%s", inet_ntoa(in), srv->port, srv->batch ? " batch" : "", VTY_NEWLINE);
 	}
 
 	return 0;
@@ -1545,9 +2046,6 @@ int zfpm_init(struct thread_master *master, int enable, uint16_t port, const cha
 
 	memset(zfpm_g, 0, sizeof(*zfpm_g));
 	zfpm_g->master = master;
-	TAILQ_INIT(&zfpm_g->dest_q);
-	zfpm_g->sock = -1;
-	zfpm_g->state = ZFPM_STATE_IDLE;
 
 	zfpm_stats_init(&zfpm_g->stats);
 	zfpm_stats_init(&zfpm_g->last_ivl_stats);
@@ -1556,6 +2054,7 @@ int zfpm_init(struct thread_master *master, int enable, uint16_t port, const cha
 	install_element(ENABLE_NODE, &show_zebra_fpm_stats_cmd);
 	install_element(ENABLE_NODE, &clear_zebra_fpm_stats_cmd);
 	install_element(CONFIG_NODE, &fpm_remote_ip_cmd);
+	install_element(CONFIG_NODE, &fpm_remote_ip_batch_cmd);
 	install_element(CONFIG_NODE, &no_fpm_remote_ip_cmd);
 
 	zfpm_init_message_format(format);
@@ -1569,25 +2068,22 @@ int zfpm_init(struct thread_master *master, int enable, uint16_t port, const cha
 
 	zfpm_g->enabled = enable;
 
-	if(!enable) {
-		return 1;
-	}
-
-	if(!zfpm_g->fpm_server) {
-		zfpm_g->fpm_server = FPM_DEFAULT_IP;
-	}
-
 	if(!port) {
 		port = FPM_DEFAULT_PORT;
 	}
 
-	zfpm_g->fpm_port = port;
+	zfpm_g->default_port = port;
 
-	zfpm_g->obuf = stream_new(ZFPM_OBUF_SIZE);
-	zfpm_g->ibuf = stream_new(ZFPM_IBUF_SIZE);
+	/*
+   * The default server is there until one is configured.
+   */
+	zfpm_server_new(FPM_DEFAULT_IP, port);
+
+	if(!enable) {
+		return 1;
+	}
 
 	zfpm_start_stats_timer();
-	zfpm_start_connect_timer("initialized");
 
 	return 1;
 }
@@ -35,14 +35,18 @@
  *
  * # invoke zebra function zfpm_dt_benchmark_protobuf_encode 100000
  *
+ * # invoke zebra function zfpm_dt_benchmark_sync netlink 1000000
+ *
  */
 
 #include <zebra.h>
 #include "log.h"
 #include "vrf.h"
+#include "thread.h"
 
 #include "zebra/rib.h"
 
+#include "fpm/fpm.h"
 #include "zebra_fpm_private.h"
 
 #include "qpb/qpb_allocator.h"
@@ -57,6 +61,7 @@
 extern int zfpm_dt_benchmark_netlink_encode(int argc, const char **argv);
 extern int zfpm_dt_benchmark_protobuf_encode(int argc, const char **argv);
 extern int zfpm_dt_benchmark_protobuf_decode(int argc, const char **argv);
+extern int zfpm_dt_benchmark_sync(int argc, const char **argv);
 
 /*
  * zfpm_dt_find_route
@@ -268,3 +273,95 @@ int zfpm_dt_benchmark_protobuf_decode(int argc, const char **argv) {
 }
 
 #endif /* HAVE_PROTOBUF */
+
+/*
+ * zfpm_dt_benchmark_sync
+ *
+ * Time encoding, with the given format, the routes of the default IPv4
+ * unicast table as they would be for a full sync to the FPM, going
+ * round the table until the given number of routes were encoded.
+ *
+ * The format is one of 'netlink', 'protobuf' (written out directly) or
+ * 'protobuf-pack' (through protobuf-c).
+ */
+int zfpm_dt_benchmark_sync(int argc, const char **argv) {
+	struct route_table *table;
+	struct route_node *rnode;
+	route_table_iter_t iter;
+	rib_dest_t *dest;
+	struct rib *rib;
+	const char *format;
+	int times, i, len;
+	size_t used, bytes;
+	unsigned long usecs;
+	struct timeval start, end;
+	static uint8_t buf[64 * 1024];
+
+	format = "netlink";
+	if(argc > 0) {
+		format = argv[0];
+	}
+
+	times = 1000000;
+	if(argc > 1) {
+		times = atoi(argv[1]);
+	}
+
+	table = zebra_vrf_table(AFI_IP, SAFI_UNICAST, VRF_DEFAULT);
+	if(!table) {
+		return 1;
+	}
+
+	i = 0;
+	used = bytes = 0;
+	quagga_gettime(QUAGGA_CLK_MONOTONIC, &start);
+
+	while(i < times) {
+		route_table_iter_init(&iter, table);
+		len = 0;
+		while(i < times && (rnode = route_table_iter_next(&iter))) {
+			dest = rib_dest_from_rnode(rnode);
+			if(!dest || !(rib = zfpm_route_for_update(dest))) {
+				continue;
+			}
+
+			if(sizeof(buf) - used < FPM_MAX_MSG_LEN) {
+				bytes += used;
+				used = 0;
+			}
+
+			if(!strcmp(format, "protobuf")) {
+				len = zfpm_protobuf_encode_route(dest, rib, buf + used, sizeof(buf) - used);
+			} else if(!strcmp(format, "protobuf-pack")) {
+				len = zfpm_protobuf_pack_route(dest, rib, buf + used, sizeof(buf) - used);
+			}
+#ifdef HAVE_NETLINK
+			else {
+				len = zfpm_netlink_encode_route(RTM_NEWROUTE, dest, rib, (char *) buf + used, sizeof(buf) - used);
+			}
+#endif /* HAVE_NETLINK */
+
+			if(len <= 0) {
+				break;
+			}
+
+			used += len;
+			i++;
+		}
+		route_table_iter_cleanup(&iter);
+
+		/*
+       * Nothing in the table to encode, or failed to.
+       */
+		if(len <= 0) {
+			return 2;
+		}
+	}
+
+	bytes += used;
+	quagga_gettime(QUAGGA_CLK_MONOTONIC, &end);
+	usecs = timeval_elapsed(end, start);
+
+	zlog_info("FPM sync with %s encoding: %d routes, %lu bytes in %lu.%06lu secs", format, i, (unsigned long) bytes, usecs / 1000000, usecs % 1000000);
+	return 0;
+}
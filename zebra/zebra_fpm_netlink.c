@@ -435,3 +435,27 @@ int zfpm_netlink_encode_route(int cmd, rib_dest_t *dest, struct rib *rib, char *
 
 	return netlink_route_info_encode(ri, in_buf, in_buf_len);
 }
+
+/*
+ * zfpm_netlink_encode_done
+ *
+ * Create the netlink message that ends a dump, telling the FPM it has
+ * been sent all routes, in the given buffer space.
+ *
+ * Returns the number of bytes written to the buffer.
+ */
+int zfpm_netlink_encode_done(char *in_buf, size_t in_buf_len) {
+	struct nlmsghdr *nlmsg;
+
+	if(in_buf_len < NLMSG_LENGTH(sizeof(int))) {
+		return 0;
+	}
+
+	memset(in_buf, 0, NLMSG_LENGTH(sizeof(int)));
+	nlmsg = (struct nlmsghdr *) in_buf;
+	nlmsg->nlmsg_len = NLMSG_LENGTH(sizeof(int));
+	nlmsg->nlmsg_type = NLMSG_DONE;
+	nlmsg->nlmsg_flags = NLM_F_MULTI;
+
+	return NLMSG_ALIGN(nlmsg->nlmsg_len);
+}
@@ -51,8 +51,10 @@ static inline void zfpm_debug(const char *format, ...) {
  * Externs
  */
 extern int zfpm_netlink_encode_route(int cmd, rib_dest_t *dest, struct rib *rib, char *in_buf, size_t in_buf_len);
+extern int zfpm_netlink_encode_done(char *in_buf, size_t in_buf_len);
 
 extern int zfpm_protobuf_encode_route(rib_dest_t *dest, struct rib *rib, uint8_t *in_buf, size_t in_buf_len);
+extern int zfpm_protobuf_pack_route(rib_dest_t *dest, struct rib *rib, uint8_t *in_buf, size_t in_buf_len);
 
 extern struct rib *zfpm_route_for_update(rib_dest_t *dest);
 #endif /* _ZEBRA_FPM_PRIVATE_H */
@@ -66,9 +66,13 @@ static Fpm__DeleteRoute *create_delete_route_message(qpb_allocator_t *allocator,
 }
 
 /*
- * add_nexthop
+ * get_nexthop_info
+ *
+ * Find out the interface and gateway a nexthop is to be sent with.
+ *
+ * Returns FALSE if the nexthop has neither.
  */
-static inline int add_nexthop(qpb_allocator_t *allocator, Fpm__AddRoute *msg, rib_dest_t *dest, struct nexthop *nexthop) {
+static inline int get_nexthop_info(struct nexthop *nexthop, uint32_t *if_index_p, union g_addr **gateway_p) {
 	uint32_t if_index;
 	union g_addr *gateway, *src;
 
@@ -97,6 +101,24 @@ static inline int add_nexthop(qpb_allocator_t *allocator, Fpm__AddRoute *msg, ri
 		return 0;
 	}
 
+	// TODO: Use src.
+
+	*if_index_p = if_index;
+	*gateway_p = gateway;
+	return 1;
+}
+
+/*
+ * add_nexthop
+ */
+static inline int add_nexthop(qpb_allocator_t *allocator, Fpm__AddRoute *msg, rib_dest_t *dest, struct nexthop *nexthop) {
+	uint32_t if_index;
+	union g_addr *gateway;
+
+	if(!get_nexthop_info(nexthop, &if_index, &gateway)) {
+		return 0;
+	}
+
 	/*
    * We have a valid nexthop.
    */
@@ -121,19 +143,52 @@ static inline int add_nexthop(qpb_allocator_t *allocator, Fpm__AddRoute *msg, ri
 		msg->nexthops[msg->n_nexthops++] = pb_nh;
 	}
 
-	// TODO: Use src.
-
 	return 1;
 }
 
+/*
+ * get_route_nexthops
+ *
+ * Collect the nexthops of a route to be sent to the FPM.
+ *
+ * Returns the number of nexthops.
+ */
+static uint get_route_nexthops(struct rib *rib, struct nexthop **nexthops, uint max_nhs) {
+	struct nexthop *nexthop, *tnexthop;
+	int recursing;
+	uint num_nhs;
+
+	num_nhs = 0;
+	for(ALL_NEXTHOPS_RO(rib->nexthop, nexthop, tnexthop, recursing)) {
+		if(MULTIPATH_NUM != 0 && num_nhs >= MULTIPATH_NUM) {
+			break;
+		}
+
+		if(num_nhs >= max_nhs) {
+			break;
+		}
+
+		if(CHECK_FLAG(nexthop->flags, NEXTHOP_FLAG_RECURSIVE)) {
+			continue;
+		}
+
+		if(!CHECK_FLAG(nexthop->flags, NEXTHOP_FLAG_ACTIVE)) {
+			continue;
+		}
+
+		nexthops[num_nhs] = nexthop;
+		num_nhs++;
+	}
+
+	return num_nhs;
+}
+
 /*
  * create_add_route_message
  */
 static Fpm__AddRoute *create_add_route_message(qpb_allocator_t *allocator, rib_dest_t *dest, struct rib *rib) {
 	Fpm__AddRoute *msg;
 	int discard;
-	struct nexthop *nexthop, *tnexthop;
-	int recursing;
 	uint num_nhs, u;
 	struct nexthop *nexthops[MAX(MULTIPATH_NUM, 64)];
 
@@ -180,28 +235,7 @@ static Fpm__AddRoute *create_add_route_message(qpb_allocator_t *allocator, rib_d
 	/*
    * Figure out the set of nexthops to be added to the message.
    */
-	num_nhs = 0;
-	for(ALL_NEXTHOPS_RO(rib->nexthop, nexthop, tnexthop, recursing)) {
-		if(MULTIPATH_NUM != 0 && num_nhs >= MULTIPATH_NUM) {
-			break;
-		}
-
-		if(num_nhs >= ZEBRA_NUM_OF(nexthops)) {
-			break;
-		}
-
-		if(CHECK_FLAG(nexthop->flags, NEXTHOP_FLAG_RECURSIVE)) {
-			continue;
-		}
-
-		if(!CHECK_FLAG(nexthop->flags, NEXTHOP_FLAG_ACTIVE)) {
-			continue;
-		}
-
-		nexthops[num_nhs] = nexthop;
-		num_nhs++;
-	}
-
+	num_nhs = get_route_nexthops(rib, nexthops, ZEBRA_NUM_OF(nexthops));
 	if(!num_nhs) {
 		zfpm_debug("netlink_encode_route(): No useful nexthop.");
 		assert(0);
@@ -264,15 +298,16 @@ static Fpm__Message *create_route_message(qpb_allocator_t *allocator, rib_dest_t
 }
 
 /*
- * zfpm_protobuf_encode_route
+ * zfpm_protobuf_pack_route
  *
  * Create a protobuf message corresponding to the given route in the
- * given buffer space.
+ * given buffer space, by building the message with protobuf-c and
+ * packing it.
  *
  * Returns the number of bytes written to the buffer. 0 or a negative
  * value indicates an error.
  */
-int zfpm_protobuf_encode_route(rib_dest_t *dest, struct rib *rib, uint8_t *in_buf, size_t in_buf_len) {
+int zfpm_protobuf_pack_route(rib_dest_t *dest, struct rib *rib, uint8_t *in_buf, size_t in_buf_len) {
 	Fpm__Message *msg;
 	QPB_DECLARE_STACK_ALLOCATOR(allocator, 4096);
 	size_t len;
@@ -291,3 +326,305 @@ int zfpm_protobuf_encode_route(rib_dest_t *dest, struct rib *rib, uint8_t *in_bu
 	QPB_RESET_STACK_ALLOCATOR(allocator);
 	return len;
 }
+
+/*
+ * Direct encoding of the fpm.proto messages.
+ *
+ * The messages sent to the FPM are written out field by field, in
+ * field number order, as protobuf-c would pack them, without building
+ * a message tree first. An embedded message is written after a one
+ * byte length, which is widened once its length is known, if need be.
+ */
+
+/*
+ * Wire types.
+ */
+#define PB_WIRE_VARINT 0
+#define PB_WIRE_FIXED32 5
+#define PB_WIRE_LEN 2
+
+typedef struct pb_writer_t_ {
+	uint8_t *buf;
+	uint8_t *cur;
+	uint8_t *end;
+	int overflow;
+} pb_writer_t;
+
+/*
+ * pb_put_varint
+ */
+static inline void pb_put_varint(pb_writer_t *w, uint64_t value) {
+	do {
+		if(w->cur >= w->end) {
+			w->overflow = 1;
+			return;
+		}
+		*w->cur++ = (value & 0x7f) | (value > 0x7f ? 0x80 : 0);
+		value >>= 7;
+	} while(value);
+}
+
+/*
+ * pb_put_tag
+ */
+static inline void pb_put_tag(pb_writer_t *w, uint field, uint wire_type) {
+	pb_put_varint(w, (field << 3) | wire_type);
+}
+
+/*
+ * pb_put_uint
+ */
+static inline void pb_put_uint(pb_writer_t *w, uint field, uint32_t value) {
+	pb_put_tag(w, field, PB_WIRE_VARINT);
+	pb_put_varint(w, value);
+}
+
+/*
+ * pb_put_int
+ *
+ * An int32, sign extended to 64 bits if negative.
+ */
+static inline void pb_put_int(pb_writer_t *w, uint field, int32_t value) {
+	pb_put_tag(w, field, PB_WIRE_VARINT);
+	pb_put_varint(w, (uint64_t) (int64_t) value);
+}
+
+/*
+ * pb_put_fixed32
+ */
+static inline void pb_put_fixed32(pb_writer_t *w, uint field, uint32_t value) {
+	pb_put_tag(w, field, PB_WIRE_FIXED32);
+	if(w->end - w->cur < 4) {
+		w->overflow = 1;
+		return;
+	}
+	w->cur[0] = value;
+	w->cur[1] = value >> 8;
+	w->cur[2] = value >> 16;
+	w->cur[3] = value >> 24;
+	w->cur += 4;
+}
+
+/*
+ * pb_put_bytes
+ */
+static inline void pb_put_bytes(pb_writer_t *w, uint field, const void *data, size_t len) {
+	pb_put_tag(w, field, PB_WIRE_LEN);
+	pb_put_varint(w, len);
+	if((size_t) (w->end - w->cur) < len) {
+		w->overflow = 1;
+		return;
+	}
+	memcpy(w->cur, data, len);
+	w->cur += len;
+}
+
+/*
+ * pb_begin_msg
+ *
+ * Start an embedded message. Returns where its contents start.
+ */
+static inline uint8_t *pb_begin_msg(pb_writer_t *w, uint field) {
+	pb_put_tag(w, field, PB_WIRE_LEN);
+	if(w->cur >= w->end) {
+		w->overflow = 1;
+		return w->cur;
+	}
+	w->cur++;
+	return w->cur;
+}
+
+/*
+ * pb_end_msg
+ *
+ * Finish the embedded message whose contents start at 'start', writing
+ * its length in front of them.
+ */
+static inline void pb_end_msg(pb_writer_t *w, uint8_t *start) {
+	size_t len, len_bytes;
+	uint8_t *p;
+
+	if(w->overflow) {
+		return;
+	}
+
+	len = w->cur - start;
+	for(len_bytes = 1; len >> (7 * len_bytes); len_bytes++) {
+		;
+	}
+
+	if(len_bytes > 1) {
+		if((size_t) (w->end - w->cur) < len_bytes - 1) {
+			w->overflow = 1;
+			return;
+		}
+		memmove(start + len_bytes - 1, start, len);
+		w->cur += len_bytes - 1;
+	}
+
+	p = start - 1;
+	while(len > 0x7f) {
+		*p++ = (len & 0x7f) | 0x80;
+		len >>= 7;
+	}
+	*p = len;
+}
+
+/*
+ * encode_route_key
+ */
+static inline void encode_route_key(pb_writer_t *w, uint field, struct prefix *p) {
+	uint8_t *key, *prefix;
+
+	key = pb_begin_msg(w, field);
+	prefix = pb_begin_msg(w, 1);
+	pb_put_uint(w, 1, p->prefixlen);
+	pb_put_bytes(w, 2, &p->u.prefix, (p->prefixlen + 7) / 8);
+	pb_end_msg(w, prefix);
+	pb_end_msg(w, key);
+}
+
+/*
+ * encode_route_header
+ *
+ * Fields common to the AddRoute and DeleteRoute messages.
+ */
+static inline void encode_route_header(pb_writer_t *w, rib_dest_t *dest) {
+	Qpb__AddressFamily family;
+
+	pb_put_uint(w, 1, rib_dest_vrf(dest)->vrf_id);
+	qpb_address_family_set(&family, rib_dest_af(dest));
+	pb_put_uint(w, 2, family);
+
+	/*
+   * XXX Hardcode subaddress family for now.
+   */
+	pb_put_uint(w, 3, QPB__SUB_ADDRESS_FAMILY__UNICAST);
+	encode_route_key(w, 4, rib_dest_prefix(dest));
+}
+
+/*
+ * encode_nexthop
+ */
+static inline int encode_nexthop(pb_writer_t *w, rib_dest_t *dest, struct nexthop *nexthop) {
+	uint32_t if_index;
+	union g_addr *gateway;
+	uint8_t *nh, *sub, *addr;
+
+	if(!get_nexthop_info(nexthop, &if_index, &gateway)) {
+		return 0;
+	}
+
+	nh = pb_begin_msg(w, 9);
+
+	if(if_index != 0) {
+		sub = pb_begin_msg(w, 2);
+		pb_put_uint(w, 1, if_index);
+		pb_end_msg(w, sub);
+	}
+
+	if(gateway) {
+		sub = pb_begin_msg(w, 3);
+		switch(rib_dest_af(dest)) {
+			case AF_INET:
+				addr = pb_begin_msg(w, 1);
+				pb_put_fixed32(w, 1, ntohl(gateway->ipv4.s_addr));
+				pb_end_msg(w, addr);
+				break;
+
+			case AF_INET6:
+				addr = pb_begin_msg(w, 2);
+				pb_put_bytes(w, 1, gateway->ipv6.s6_addr, 16);
+				pb_end_msg(w, addr);
+				break;
+		}
+		pb_end_msg(w, sub);
+	}
+
+	pb_end_msg(w, nh);
+	return 1;
+}
+
+/*
+ * encode_add_route
+ */
+static inline int encode_add_route(pb_writer_t *w, rib_dest_t *dest, struct rib *rib) {
+	Qpb__Protocol protocol;
+	uint num_nhs, u;
+	struct nexthop *nexthops[MAX(MULTIPATH_NUM, 64)];
+
+	encode_route_header(w, dest);
+
+	if(rib->flags & ZEBRA_FLAG_BLACKHOLE) {
+		pb_put_uint(w, 5, FPM__ROUTE_TYPE__BLACKHOLE);
+	} else if(rib->flags & ZEBRA_FLAG_REJECT) {
+		pb_put_uint(w, 5, FPM__ROUTE_TYPE__UNREACHABLE);
+	} else {
+		pb_put_uint(w, 5, FPM__ROUTE_TYPE__NORMAL);
+	}
+
+	qpb_protocol_set(&protocol, rib->type);
+	pb_put_uint(w, 6, protocol);
+
+	if((rib->flags & ZEBRA_FLAG_BLACKHOLE) || (rib->flags & ZEBRA_FLAG_REJECT)) {
+		pb_put_int(w, 8, 0);
+		return 1;
+	}
+
+	pb_put_int(w, 8, rib->metric);
+
+	num_nhs = get_route_nexthops(rib, nexthops, ZEBRA_NUM_OF(nexthops));
+	if(!num_nhs) {
+		zfpm_debug("protobuf_encode_route(): No useful nexthop.");
+		assert(0);
+		return 0;
+	}
+
+	for(u = 0; u < num_nhs; u++) {
+		if(!encode_nexthop(w, dest, nexthops[u])) {
+			assert(0);
+			return 0;
+		}
+	}
+
+	return 1;
+}
+
+/*
+ * zfpm_protobuf_encode_route
+ *
+ * Create a protobuf message corresponding to the given route in the
+ * given buffer space, writing it out directly.
+ *
+ * Returns the number of bytes written to the buffer. 0 or a negative
+ * value indicates an error.
+ */
+int zfpm_protobuf_encode_route(rib_dest_t *dest, struct rib *rib, uint8_t *in_buf, size_t in_buf_len) {
+	pb_writer_t w;
+	uint8_t *route;
+
+	w.buf = w.cur = in_buf;
+	w.end = in_buf + in_buf_len;
+	w.overflow = 0;
+
+	if(!rib) {
+		pb_put_uint(&w, 1, FPM__MESSAGE__TYPE__DELETE_ROUTE);
+		route = pb_begin_msg(&w, 3);
+		encode_route_header(&w, dest);
+		pb_end_msg(&w, route);
+	} else {
+		pb_put_uint(&w, 1, FPM__MESSAGE__TYPE__ADD_ROUTE);
+		route = pb_begin_msg(&w, 2);
+		if(!encode_add_route(&w, dest, rib)) {
+			return 0;
+		}
+		pb_end_msg(&w, route);
+	}
+
+	if(w.overflow) {
+		assert(0);
+		return 0;
+	}
+
+	return w.cur - w.buf;
+}
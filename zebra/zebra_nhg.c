@@ -0,0 +1,427 @@
+/*
+ * Zebra nexthop groups shared between routes of a client
+ *
+ * This file is part of GNU Zebra.
+ *
+ * GNU Zebra is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2, or (at your option) any
+ * later version.
+ *
+ * GNU Zebra is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with GNU Zebra; see the file COPYING.  If not, write to the Free
+ * Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ * 02111-1307, USA.
+ */
+
+#include <zebra.h>
+
+#include "prefix.h"
+#include "table.h"
+#include "memory.h"
+#include "command.h"
+#include "log.h"
+#include "hash.h"
+#include "jhash.h"
+#include "linklist.h"
+#include "nexthop.h"
+
+#include "zebra/rib.h"
+#include "zebra/rt.h"
+#include "zebra/zserv.h"
+#include "zebra/debug.h"
+#include "zebra/zebra_nhg.h"
+
+static struct hash *zebra_nhgs;
+static struct hash *zebra_nhgs_shared;
+
+static unsigned int zebra_nhg_hash_key(void *p) {
+	const struct zebra_nhg *nhg = p;
+
+	return jhash_2words((uintptr_t) nhg->client, nhg->id, 0);
+}
+
+static int zebra_nhg_hash_cmp(const void *p1, const void *p2) {
+	const struct zebra_nhg *nhg1 = p1;
+	const struct zebra_nhg *nhg2 = p2;
+
+	return (nhg1->client == nhg2->client && nhg1->id == nhg2->id);
+}
+
+static void *zebra_nhg_alloc(void *p) {
+	const struct zebra_nhg *key = p;
+	struct zebra_nhg *nhg;
+
+	nhg = XCALLOC(MTYPE_ZEBRA_NHG, sizeof(struct zebra_nhg));
+	nhg->client = key->client;
+	nhg->id = key->id;
+	nhg->members = list_new();
+	return nhg;
+}
+
+/* A gateway left to zebra to resolve takes its interface from there, so
+ * it isn't part of what a shared group is interned on */
+static int zebra_nhg_nexthop_same(struct nexthop *nh1, struct nexthop *nh2) {
+	return (nh1->type == nh2->type && nh1->gate.ipv4.s_addr == nh2->gate.ipv4.s_addr && nh1->src.ipv4.s_addr == nh2->src.ipv4.s_addr && (nh1->type == NEXTHOP_TYPE_IPV4 || nh1->ifindex == nh2->ifindex) && CHECK_FLAG(nh1->flags, NEXTHOP_FLAG_ONLINK) == CHECK_FLAG(nh2->flags, NEXTHOP_FLAG_ONLINK));
+}
+
+static unsigned int zebra_nhg_shared_hash_key(void *p) {
+	const struct zebra_nhg *nhg = p;
+	struct nexthop *nexthop;
+	unsigned int key = nhg->vrf_id;
+
+	for(nexthop = nhg->nexthop; nexthop; nexthop = nexthop->next) {
+		key = jhash_3words(nexthop->type, nexthop->gate.ipv4.s_addr, nexthop->type == NEXTHOP_TYPE_IPV4 ? 0 : nexthop->ifindex, key);
+	}
+	return key;
+}
+
+static int zebra_nhg_shared_hash_cmp(const void *p1, const void *p2) {
+	const struct zebra_nhg *nhg1 = p1;
+	const struct zebra_nhg *nhg2 = p2;
+	struct nexthop *nh1, *nh2;
+
+	if(nhg1->vrf_id != nhg2->vrf_id) {
+		return 0;
+	}
+	for(nh1 = nhg1->nexthop, nh2 = nhg2->nexthop; nh1 && nh2; nh1 = nh1->next, nh2 = nh2->next) {
+		if(!zebra_nhg_nexthop_same(nh1, nh2)) {
+			return 0;
+		}
+	}
+	return (nh1 == NULL && nh2 == NULL);
+}
+
+static void zebra_nhg_resolve(struct zebra_nhg *);
+
+static void *zebra_nhg_shared_alloc(void *p) {
+	const struct zebra_nhg *key = p;
+	struct zebra_nhg *nhg;
+	struct nexthop *nexthop, *copy;
+
+	nhg = XCALLOC(MTYPE_ZEBRA_NHG, sizeof(struct zebra_nhg));
+	nhg->shared = 1;
+	nhg->vrf_id = key->vrf_id;
+	nhg->members = list_new();
+
+	for(nexthop = key->nexthop; nexthop; nexthop = nexthop->next) {
+		copy = nexthop_new();
+		copy->type = nexthop->type;
+		copy->gate = nexthop->gate;
+		copy->src = nexthop->src;
+		copy->ifindex = nexthop->ifindex;
+		copy->flags = nexthop->flags & NEXTHOP_FLAG_ONLINK;
+		nexthop_add(&nhg->nexthop, copy);
+		nhg->nexthop_num++;
+	}
+
+	zebra_nhg_resolve(nhg);
+	if(nhg->vrf_id == VRF_DEFAULT) {
+		kernel_nhg_install(nhg);
+	}
+	if(IS_ZEBRA_DEBUG_RIB) {
+		zlog_debug("%s: shared group of %u nexthops, %s", __func__, nhg->nexthop_num, nhg->kernel_id ? "added to kernel" : "not in kernel");
+	}
+	return nhg;
+}
+
+static void zebra_nhg_resolved_flush(struct zebra_nhg *nhg) {
+	nexthops_free(nhg->resolved);
+	nhg->resolved = NULL;
+	nhg->resolved_epoch = 0;
+}
+
+static void zebra_nhg_free(struct zebra_nhg *nhg) {
+	assert(nhg->members->count == 0);
+
+	kernel_nhg_uninstall(nhg);
+	zebra_nhg_resolved_flush(nhg);
+	nexthops_free(nhg->nexthop);
+	list_free(nhg->members);
+	XFREE(MTYPE_ZEBRA_NHG, nhg);
+}
+
+struct zebra_nhg *zebra_nhg_lookup(struct zserv *client, u_int32_t id) {
+	struct zebra_nhg key;
+
+	key.client = client;
+	key.id = id;
+	return hash_lookup(zebra_nhgs, &key);
+}
+
+/* Replace the nexthops of rib with copies of those of nhg */
+static void zebra_nhg_copy(struct rib *rib, struct zebra_nhg *nhg) {
+	struct nexthop *nexthop;
+
+	nexthops_free(rib->nexthop);
+	rib->nexthop = NULL;
+	rib->nexthop_num = 0;
+
+	for(nexthop = nhg->nexthop; nexthop; nexthop = nexthop->next) {
+		switch(nexthop->type) {
+			case NEXTHOP_TYPE_IFINDEX: rib_nexthop_ifindex_add(rib, nexthop->ifindex); break;
+			case NEXTHOP_TYPE_IPV4: rib_nexthop_ipv4_add(rib, &nexthop->gate.ipv4, NULL); break;
+			case NEXTHOP_TYPE_IPV4_IFINDEX: rib_nexthop_ipv4_ifindex_add(rib, &nexthop->gate.ipv4, NULL, nexthop->ifindex); break;
+			default: break;
+		}
+	}
+}
+
+void zebra_nhg_rib_set(struct rib *rib, struct zebra_nhg *nhg) {
+	zebra_nhg_copy(rib, nhg);
+	rib->nhg = nhg;
+}
+
+/* Routes the kernel would take a nexthop object for, which any but
+ * system and discard routes, with gateways or interfaces, are */
+void zebra_nhg_intern(struct rib *rib, safi_t safi) {
+	struct zebra_nhg key;
+	struct nexthop *nexthop;
+
+	if(safi != SAFI_UNICAST || rib->type == ZEBRA_ROUTE_KERNEL || rib->type == ZEBRA_ROUTE_CONNECT || rib->nexthop == NULL || CHECK_FLAG(rib->flags, ZEBRA_FLAG_BLACKHOLE | ZEBRA_FLAG_REJECT)) {
+		return;
+	}
+	for(nexthop = rib->nexthop; nexthop; nexthop = nexthop->next) {
+		if(nexthop->type != NEXTHOP_TYPE_IFINDEX && nexthop->type != NEXTHOP_TYPE_IPV4 && nexthop->type != NEXTHOP_TYPE_IPV4_IFINDEX) {
+			return;
+		}
+	}
+
+	memset(&key, 0, sizeof(key));
+	key.vrf_id = rib->vrf_id;
+	key.nexthop = rib->nexthop;
+	rib->nhg = hash_get(zebra_nhgs_shared, &key, zebra_nhg_shared_alloc);
+}
+
+void zebra_nhg_link(struct route_node *rn, struct rib *rib) {
+	listnode_add(rib->nhg->members, rn);
+	rib->nhg_node = listtail(rib->nhg->members);
+}
+
+void zebra_nhg_unlink(struct rib *rib) {
+	struct zebra_nhg *nhg = rib->nhg;
+
+	list_delete_node(nhg->members, rib->nhg_node);
+	rib->nhg = NULL;
+	rib->nhg_node = NULL;
+
+	if(nhg->client == NULL && nhg->members->count == 0) {
+		if(nhg->shared) {
+			hash_release(zebra_nhgs_shared, nhg);
+		}
+		zebra_nhg_free(nhg);
+	}
+}
+
+/* Gateways the client left to zebra to resolve need an interface before
+ * the kernel takes them into an object: only those on a connected subnet
+ * get one, others keep the group per route. */
+static void zebra_nhg_resolve(struct zebra_nhg *nhg) {
+	struct nexthop *nexthop;
+	struct rib *match;
+
+	for(nexthop = nhg->nexthop; nexthop; nexthop = nexthop->next) {
+		if(nexthop->type != NEXTHOP_TYPE_IPV4) {
+			continue;
+		}
+		nexthop->ifindex = 0;
+		match = rib_match_ipv4_safi(nexthop->gate.ipv4, SAFI_UNICAST, 1, NULL, nhg->vrf_id);
+		if(match && match->type == ZEBRA_ROUTE_CONNECT && match->nexthop) {
+			nexthop->ifindex = match->nexthop->ifindex;
+		}
+	}
+}
+
+/* Member routes, with their nexthops copied anew if copy, are brought up
+ * to date: see rib_nhg_refresh() */
+static void zebra_nhg_members_refresh(struct zebra_nhg *nhg, int in_kernel, int copy) {
+	struct listnode *node;
+	struct route_node *rn;
+	struct rib *rib;
+
+	zebra_nhg_resolved_flush(nhg);
+	for(ALL_LIST_ELEMENTS_RO(nhg->members, node, rn)) {
+		RNODE_FOREACH_RIB(rn, rib) {
+			if(rib->nhg_node == node) {
+				if(copy) {
+					zebra_nhg_copy(rib, nhg);
+				}
+				rib_nhg_refresh(rn, rib, in_kernel);
+				break;
+			}
+		}
+	}
+}
+
+void zebra_nhg_update(struct zserv *client, u_int32_t id, struct nexthop *nexthop, u_char nexthop_num) {
+	struct zebra_nhg key, *nhg;
+	int was_installed, installed;
+
+	key.client = client;
+	key.id = id;
+	nhg = hash_get(zebra_nhgs, &key, zebra_nhg_alloc);
+
+	nexthops_free(nhg->nexthop);
+	nhg->nexthop = nexthop;
+	nhg->nexthop_num = nexthop_num;
+	zebra_nhg_resolve(nhg);
+
+	/* Routes must not stay on an object with the old nexthops: without
+	 * one they are reinstalled one by one, as any other route. */
+	was_installed = (nhg->kernel_id != 0);
+	if(kernel_nhg_install(nhg) < 0) {
+		kernel_nhg_uninstall(nhg);
+	}
+	installed = (nhg->kernel_id != 0);
+
+	if(IS_ZEBRA_DEBUG_RIB) {
+		zlog_debug("%s: group %u from %s, %u nexthops, %u routes, %s", __func__, id, zebra_route_string(client->proto), nexthop_num, nhg->members->count, installed ? (was_installed ? "replaced in kernel" : "added to kernel") : "not in kernel");
+	}
+
+	zebra_nhg_members_refresh(nhg, was_installed && installed, 1);
+}
+
+/* What member routes resolve over may have changed: shared groups and
+ * client groups whose gateways now take another interface, or none, get
+ * their kernel objects updated and their routes looked at again. */
+static void zebra_nhg_refresh_one(struct hash_backet *backet, void *arg) {
+	struct zebra_nhg *nhg = backet->data;
+	ifindex_t ifindex[MULTIPATH_NUM];
+	struct nexthop *nexthop;
+	int i, changed, was_installed, installed;
+
+	for(i = 0, nexthop = nhg->nexthop; nexthop && i < MULTIPATH_NUM; nexthop = nexthop->next) {
+		ifindex[i++] = nexthop->ifindex;
+	}
+	zebra_nhg_resolve(nhg);
+	for(changed = 0, i = 0, nexthop = nhg->nexthop; nexthop && i < MULTIPATH_NUM; nexthop = nexthop->next) {
+		if(ifindex[i++] != nexthop->ifindex) {
+			changed = 1;
+		}
+	}
+	if(!changed || nhg->vrf_id != VRF_DEFAULT) {
+		return;
+	}
+
+	was_installed = (nhg->kernel_id != 0);
+	if(kernel_nhg_install(nhg) < 0) {
+		kernel_nhg_uninstall(nhg);
+	}
+	installed = (nhg->kernel_id != 0);
+
+	if(IS_ZEBRA_DEBUG_RIB) {
+		zlog_debug("%s: %s group, %u routes, nexthops resolved anew, %s", __func__, nhg->shared ? "shared" : zebra_route_string(nhg->client->proto), nhg->members->count, installed ? (was_installed ? "replaced in kernel" : "added to kernel") : "not in kernel");
+	}
+	zebra_nhg_members_refresh(nhg, was_installed && installed, 0);
+}
+
+void zebra_nhg_refresh(void) {
+	hash_iterate(zebra_nhgs, zebra_nhg_refresh_one, NULL);
+	hash_iterate(zebra_nhgs_shared, zebra_nhg_refresh_one, NULL);
+}
+
+void zebra_nhg_delete(struct zserv *client, u_int32_t id) {
+	struct zebra_nhg *nhg;
+
+	nhg = zebra_nhg_lookup(client, id);
+	if(nhg == NULL) {
+		return;
+	}
+
+	hash_release(zebra_nhgs, nhg);
+	nhg->client = NULL;
+	if(nhg->members->count == 0) {
+		zebra_nhg_free(nhg);
+	}
+}
+
+struct zebra_nhg_owned {
+	struct zserv *client;
+	struct list *list;
+};
+
+static void zebra_nhg_client_collect(struct hash_backet *backet, void *arg) {
+	struct zebra_nhg *nhg = backet->data;
+	struct zebra_nhg_owned *owned = arg;
+
+	if(nhg->client == owned->client) {
+		listnode_add(owned->list, nhg);
+	}
+}
+
+void zebra_nhg_client_close(struct zserv *client) {
+	struct zebra_nhg_owned owned;
+	struct listnode *node;
+	struct zebra_nhg *nhg;
+
+	/* collect first, the hash can't change under hash_iterate() */
+	owned.client = client;
+	owned.list = list_new();
+	hash_iterate(zebra_nhgs, zebra_nhg_client_collect, &owned);
+
+	for(ALL_LIST_ELEMENTS_RO(owned.list, node, nhg)) {
+		zebra_nhg_delete(client, nhg->id);
+	}
+	list_delete(owned.list);
+}
+
+static void zebra_nhg_show(struct hash_backet *backet, void *arg) {
+	struct zebra_nhg *nhg = backet->data;
+	struct vty *vty = arg;
+	struct nexthop *nexthop;
+	char buf[INET_ADDRSTRLEN];
+
+	if(nhg->shared) {
+		vty_out(vty, "Shared group, %u routes", nhg->members->count);
+		if(nhg->vrf_id != VRF_DEFAULT) {
+			vty_out(vty, ", vrf %u", nhg->vrf_id);
+		}
+	} else {
+		vty_out(vty, "Group %u from %s, %u routes", nhg->id, zebra_route_string(nhg->client->proto), nhg->members->count);
+	}
+	if(nhg->kernel_id) {
+		vty_out(vty, ", kernel id %u", nhg->kernel_id);
+	}
+	vty_out(vty, ", resolution reused %lu times%s", nhg->resolved_hits, VTY_NEWLINE);
+
+	for(nexthop = nhg->nexthop; nexthop; nexthop = nexthop->next) {
+		switch(nexthop->type) {
+			case NEXTHOP_TYPE_IPV4:
+			case NEXTHOP_TYPE_IPV4_IFINDEX: vty_out(vty, "  via %s", inet_ntop(AF_INET, &nexthop->gate.ipv4, buf, sizeof(buf))); break;
+			case NEXTHOP_TYPE_IFINDEX: vty_out(vty, "  directly connected"); break;
+			default: vty_out(vty, "  %s", nexthop_type_to_str(nexthop->type)); break;
+		}
+		if(nexthop->ifindex) {
+			vty_out(vty, ", %s", ifindex2ifname(nexthop->ifindex));
+		}
+		vty_out(vty, "%s", VTY_NEWLINE);
+	}
+}
+
+DEFUN(show_ip_nexthop_group, show_ip_nexthop_group_cmd, "show ip nexthop-group", SHOW_STR IP_STR "Nexthop groups shared by routes\n") {
+	hash_iterate(zebra_nhgs, zebra_nhg_show, vty);
+	hash_iterate(zebra_nhgs_shared, zebra_nhg_show, vty);
+	return CMD_SUCCESS;
+}
+
+static void zebra_nhg_kernel_uninstall(struct hash_backet *backet, void *arg) {
+	kernel_nhg_uninstall(backet->data);
+}
+
+/* With the routes gone from the kernel, the objects they used go too */
+void zebra_nhg_terminate(void) {
+	hash_iterate(zebra_nhgs, zebra_nhg_kernel_uninstall, NULL);
+	hash_iterate(zebra_nhgs_shared, zebra_nhg_kernel_uninstall, NULL);
+}
+
+void zebra_nhg_init(void) {
+	zebra_nhgs = hash_create(zebra_nhg_hash_key, zebra_nhg_hash_cmp);
+	zebra_nhgs_shared = hash_create(zebra_nhg_shared_hash_key, zebra_nhg_shared_hash_cmp);
+
+	install_element(VIEW_NODE, &show_ip_nexthop_group_cmd);
+}
@@ -0,0 +1,87 @@
+/*
+ * Zebra nexthop groups shared between routes of a client
+ *
+ * This file is part of GNU Zebra.
+ *
+ * GNU Zebra is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2, or (at your option) any
+ * later version.
+ *
+ * GNU Zebra is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with GNU Zebra; see the file COPYING.  If not, write to the Free
+ * Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ * 02111-1307, USA.
+ */
+
+#ifndef _ZEBRA_NHG_H
+#define _ZEBRA_NHG_H
+
+#include "linklist.h"
+#include "nexthop.h"
+#include "table.h"
+
+/* A set of nexthops a client defines once and then refers to from any
+ * number of its IPv4 routes.  When the client changes the set, all of
+ * those routes follow: where the kernel has the group as a nexthop
+ * object, with a single update of that object.
+ *
+ * Routes that don't refer to a group get a shared one, interned on their
+ * nexthops, which zebra owns and drops with its last route.  Either kind
+ * keeps the outcome of resolving its nexthops for one route, which the
+ * other routes take as long as no route they may resolve over changed.
+ */
+struct zebra_nhg {
+	/* Owner, and the id the owner knows the group by.  client is NULL
+	 * once the owner deleted the group or went away, and the group only
+	 * lingers for routes yet to be removed, or for a shared group. */
+	struct zserv *client;
+	u_int32_t id;
+	u_char shared;
+	vrf_id_t vrf_id;
+
+	struct nexthop *nexthop;
+	u_char nexthop_num;
+
+	/* Route nodes of routes using the group, one entry per rib, which
+	 * keeps its own entry in rib->nhg_node. */
+	struct list *members;
+
+	/* The kernel nexthop object for the group, 0 while there is none,
+	 * and the objects for each of its nexthops. */
+	u_int32_t kernel_id;
+	u_int32_t *kernel_member_id;
+	u_char kernel_member_num;
+
+	/* The nexthops as resolved for a member, valid while resolved_epoch
+	 * is the RIB's, see rib_nexthop_epoch. */
+	struct nexthop *resolved;
+	u_int32_t resolved_epoch;
+	u_int32_t resolved_mtu;
+	u_char resolved_flags;
+	unsigned long resolved_hits;
+};
+
+extern struct zebra_nhg *zebra_nhg_lookup(struct zserv *client, u_int32_t id);
+extern void zebra_nhg_update(struct zserv *client, u_int32_t id, struct nexthop *nexthop, u_char nexthop_num);
+extern void zebra_nhg_delete(struct zserv *client, u_int32_t id);
+extern void zebra_nhg_client_close(struct zserv *client);
+
+/* Give a new rib, before it is added, the nexthops of nhg */
+extern void zebra_nhg_rib_set(struct rib *rib, struct zebra_nhg *nhg);
+/* Or, for a rib of no group, the shared group of its nexthops */
+extern void zebra_nhg_intern(struct rib *rib, safi_t safi);
+extern void zebra_nhg_link(struct route_node *rn, struct rib *rib);
+extern void zebra_nhg_unlink(struct rib *rib);
+/* Resolve the groups again, once routes they may resolve over changed */
+extern void zebra_nhg_refresh(void);
+
+extern void zebra_nhg_init(void);
+extern void zebra_nhg_terminate(void);
+
+#endif /* _ZEBRA_NHG_H */
@@ -37,6 +37,9 @@
 #include "routemap.h"
 #include "vrf.h"
 #include "nexthop.h"
+#include "hash.h"
+#include "jhash.h"
+#include "trace.h"
 
 #include "zebra/rib.h"
 #include "zebra/rt.h"
@@ -45,6 +48,7 @@
 #include "zebra/debug.h"
 #include "zebra/zebra_fpm.h"
 #include "zebra/zebra_rnh.h"
+#include "zebra/zebra_nhg.h"
 
 /* Default rtm_table for all clients */
 extern struct zebra_t zebrad;
@@ -105,6 +109,7 @@ static void __attribute__((format(printf, 4, 5))) _rnode_zlog(const char *_func,
 void rib_nexthop_add(struct rib *rib, struct nexthop *nexthop) {
 	nexthop_add(&rib->nexthop, nexthop);
 	rib->nexthop_num++;
+	rib->active_epoch = rib->resolved_epoch = 0;
 }
 
 /* Delete specified nexthop from the list. */
@@ -118,6 +123,7 @@ static void rib_nexthop_delete(struct rib *rib, struct nexthop *nexthop) {
 		rib->nexthop = nexthop->next;
 	}
 	rib->nexthop_num--;
+	rib->active_epoch = rib->resolved_epoch = 0;
 }
 
 struct nexthop *rib_nexthop_ifindex_add(struct rib *rib, ifindex_t ifindex) {
@@ -244,12 +250,239 @@ int nexthop_has_fib_child(struct nexthop *nexthop) {
 	return 0;
 }
 
+/* Where gateways resolve.  For each gateway address looked up, a
+ * rib_resolve in the VRF's resolve_table keeps the node the lookup stopped
+ * at, the longest match with a selected route other than BGP, and the
+ * route nodes whose routes resolved over it.  A change to the routes of a
+ * node drops the entries of the gateways it covers, unless they resolve
+ * over a longer match, and queues the routes that depended on them: see
+ * rib_nexthop_changed(). */
+struct rib_resolve {
+	struct route_node *rn; /* locked, NULL if nothing matched */
+	struct hash *dependents;
+};
+
+static void rib_queue_add(struct zebra_t *zebra, struct route_node *rn);
+
+static unsigned int rib_resolve_dependent_key(void *p) {
+	return jhash_1word((uintptr_t) p, 0);
+}
+
+static int rib_resolve_dependent_cmp(const void *p1, const void *p2) {
+	return (p1 == p2);
+}
+
+/* The route at rn gateways resolve over, if any */
+static struct rib *rib_resolve_match(struct route_node *rn) {
+	struct rib *match;
+
+	RNODE_FOREACH_RIB(rn, match) {
+		if(CHECK_FLAG(match->status, RIB_ENTRY_REMOVED)) {
+			continue;
+		}
+		if(CHECK_FLAG(match->status, RIB_ENTRY_SELECTED_FIB)) {
+			break;
+		}
+	}
+
+	/* BGP routes don't resolve gateways, look further up the tree */
+	if(match && match->type == ZEBRA_ROUTE_BGP) {
+		return NULL;
+	}
+	return match;
+}
+
+static struct route_node *rib_resolve_walk(struct route_table *table, struct prefix *p) {
+	struct route_node *rn;
+
+	rn = route_node_match(table, p);
+	while(rn) {
+		route_unlock_node(rn);
+		if(rib_resolve_match(rn)) {
+			return rn;
+		}
+		do {
+			rn = rn->parent;
+		} while(rn && rn->info == NULL);
+		if(rn) {
+			route_lock_node(rn);
+		}
+	}
+	return NULL;
+}
+
+static void rib_resolve_depend(struct rib_resolve *entry, struct route_node *rn) {
+	if(hash_lookup(entry->dependents, rn) == NULL) {
+		hash_get(entry->dependents, rn, hash_alloc_intern);
+		route_lock_node(rn);
+	}
+}
+
+/* The route a gateway p of a route at top resolves over, in table: none
+ * if the lookup would find top itself on the way to it. */
+static struct rib *rib_resolve(struct route_table *table, struct prefix *p, struct route_node *top) {
+	rib_table_info_t *info = table->info;
+	struct route_node *node;
+	struct rib_resolve *entry;
+
+	node = route_node_get(info->zvrf->resolve_table[info->afi], p);
+	if((entry = node->info) == NULL) {
+		entry = XCALLOC(MTYPE_RIB_RESOLVE, sizeof(struct rib_resolve));
+		entry->dependents = hash_create_open(rib_resolve_dependent_key, rib_resolve_dependent_cmp);
+		if((entry->rn = rib_resolve_walk(table, p)) != NULL) {
+			route_lock_node(entry->rn);
+		}
+		node->info = entry;
+	} else {
+		route_unlock_node(node);
+	}
+	rib_resolve_depend(entry, top);
+
+	if(top->table == table && prefix_match(&top->p, p) && (entry->rn == NULL || top->p.prefixlen >= entry->rn->p.prefixlen)) {
+		return NULL;
+	}
+	return entry->rn ? rib_resolve_match(entry->rn) : NULL;
+}
+
+static afi_t rib_resolve_gateway(struct nexthop *nexthop, struct prefix *p) {
+	memset(p, 0, sizeof(struct prefix));
+	switch(nexthop->type) {
+		case NEXTHOP_TYPE_IPV4:
+		case NEXTHOP_TYPE_IPV4_IFINDEX:
+			p->family = AF_INET;
+			p->prefixlen = IPV4_MAX_PREFIXLEN;
+			p->u.prefix4 = nexthop->gate.ipv4;
+			return AFI_IP;
+#ifdef HAVE_IPV6
+		case NEXTHOP_TYPE_IPV6:
+		case NEXTHOP_TYPE_IPV6_IFINDEX:
+			if(nexthop->type == NEXTHOP_TYPE_IPV6_IFINDEX && IN6_IS_ADDR_LINKLOCAL(&nexthop->gate.ipv6)) {
+				return 0;
+			}
+			p->family = AF_INET6;
+			p->prefixlen = IPV6_MAX_PREFIXLEN;
+			p->u.prefix6 = nexthop->gate.ipv6;
+			return AFI_IP6;
+#endif /* HAVE_IPV6 */
+		default: return 0;
+	}
+}
+
+static struct rib_resolve *rib_resolve_lookup(struct rib *rib, struct nexthop *nexthop, struct route_node **node_out) {
+	struct zebra_vrf *zvrf;
+	struct route_node *node;
+	struct prefix p;
+	afi_t afi;
+
+	if((afi = rib_resolve_gateway(nexthop, &p)) == 0 || (zvrf = vrf_info_lookup(rib->vrf_id)) == NULL) {
+		return NULL;
+	}
+	if((node = route_node_lookup(zvrf->resolve_table[afi], &p)) == NULL) {
+		return NULL;
+	}
+	route_unlock_node(node);
+	if(node_out) {
+		*node_out = node;
+	}
+	return node->info;
+}
+
+/* rib at rn took how its nexthops resolve from elsewhere, its group */
+static void rib_resolve_depend_all(struct route_node *rn, struct rib *rib) {
+	struct rib_resolve *entry;
+	struct nexthop *nexthop;
+
+	for(nexthop = rib->nexthop; nexthop; nexthop = nexthop->next) {
+		if((entry = rib_resolve_lookup(rib, nexthop, NULL)) != NULL) {
+			rib_resolve_depend(entry, rn);
+		}
+	}
+}
+
+static void rib_resolve_free(struct route_node *node, struct rib_resolve *entry) {
+	hash_clean(entry->dependents, NULL);
+	hash_free(entry->dependents);
+	if(entry->rn) {
+		route_unlock_node(entry->rn);
+	}
+	XFREE(MTYPE_RIB_RESOLVE, entry);
+	node->info = NULL;
+	route_unlock_node(node);
+}
+
+/* rib, at rn, is going away: rn no longer depends on its gateways unless
+ * another of its routes has them too */
+static void rib_resolve_release(struct route_node *rn, struct rib *rib) {
+	struct rib_resolve *entry;
+	struct route_node *node;
+	struct nexthop *nexthop, *other_hop;
+	struct rib *other;
+	int shared;
+
+	for(nexthop = rib->nexthop; nexthop; nexthop = nexthop->next) {
+		if((entry = rib_resolve_lookup(rib, nexthop, &node)) == NULL || hash_lookup(entry->dependents, rn) == NULL) {
+			continue;
+		}
+
+		shared = 0;
+		RNODE_FOREACH_RIB(rn, other) {
+			if(other == rib || CHECK_FLAG(other->status, RIB_ENTRY_REMOVED)) {
+				continue;
+			}
+			for(other_hop = other->nexthop; other_hop; other_hop = other_hop->next) {
+				if(other_hop->type == nexthop->type && !memcmp(&other_hop->gate, &nexthop->gate, sizeof(union g_addr))) {
+					shared = 1;
+				}
+			}
+		}
+		if(shared) {
+			continue;
+		}
+
+		hash_release(entry->dependents, rn);
+		route_unlock_node(rn);
+		if(entry->dependents->count == 0) {
+			rib_resolve_free(node, entry);
+		}
+	}
+}
+
+static void rib_resolve_requeue(struct hash_backet *backet, void *arg) {
+	struct route_node *rn = backet->data;
+
+	if(rn != arg && rnode_to_ribs(rn)) {
+		rib_queue_add(&zebrad, rn);
+	}
+	route_unlock_node(rn);
+}
+
+static void rib_resolve_invalidate(struct route_node *rn) {
+	rib_table_info_t *info = rn->table->info;
+	struct route_node *start, *node;
+	struct rib_resolve *entry;
+
+	if(info->safi != SAFI_UNICAST) {
+		return;
+	}
+
+	start = route_node_get(info->zvrf->resolve_table[info->afi], &rn->p);
+	for(node = start; node; node = route_next_until(node, start)) {
+		if((entry = node->info) == NULL) {
+			continue;
+		}
+		if(entry->rn && entry->rn->p.prefixlen > rn->p.prefixlen) {
+			continue;
+		}
+		hash_iterate(entry->dependents, rib_resolve_requeue, rn);
+		rib_resolve_free(node, entry);
+	}
+}
+
 /* If force flag is not set, do not modify falgs at all for uninstall
    the route from FIB. */
 static int nexthop_active_ipv4(struct rib *rib, struct nexthop *nexthop, int set, struct route_node *top) {
 	struct prefix_ipv4 p;
 	struct route_table *table;
-	struct route_node *rn;
 	struct rib *match;
 	int resolved;
 	struct nexthop *newhop;
@@ -278,91 +511,63 @@ static int nexthop_active_ipv4(struct rib *rib, struct nexthop *nexthop, int set
 		return 0;
 	}
 
-	rn = route_node_match(table, (struct prefix *) &p);
-	while(rn) {
-		route_unlock_node(rn);
+	if((match = rib_resolve(table, (struct prefix *) &p, top)) == NULL) {
+		return 0;
+	}
 
-		/* If lookup self prefix return immediately. */
-		if(rn == top) {
-			return 0;
-		}
+	/* If the longest prefix match for the nexthop yields
+	 * a blackhole, mark it as inactive. */
+	if(CHECK_FLAG(match->flags, ZEBRA_FLAG_BLACKHOLE) || CHECK_FLAG(match->flags, ZEBRA_FLAG_REJECT)) {
+		return 0;
+	}
 
-		/* Pick up selected route. */
-		RNODE_FOREACH_RIB(rn, match) {
-			if(CHECK_FLAG(match->status, RIB_ENTRY_REMOVED)) {
-				continue;
-			}
-			if(CHECK_FLAG(match->status, RIB_ENTRY_SELECTED_FIB)) {
-				break;
-			}
+	if(match->type == ZEBRA_ROUTE_CONNECT) {
+		/* Directly point connected route. */
+		newhop = match->nexthop;
+		if(newhop && nexthop->type == NEXTHOP_TYPE_IPV4) {
+			nexthop->ifindex = newhop->ifindex;
 		}
 
-		/* If there is no selected route or matched route is EGP, go up
-         tree. */
-		if(!match || match->type == ZEBRA_ROUTE_BGP) {
-			do {
-				rn = rn->parent;
-			} while(rn && rn->info == NULL);
-			if(rn) {
-				route_lock_node(rn);
-			}
-		} else {
-			/* If the longest prefix match for the nexthop yields
-	   * a blackhole, mark it as inactive. */
-			if(CHECK_FLAG(match->flags, ZEBRA_FLAG_BLACKHOLE) || CHECK_FLAG(match->flags, ZEBRA_FLAG_REJECT)) {
-				return 0;
-			}
-
-			if(match->type == ZEBRA_ROUTE_CONNECT) {
-				/* Directly point connected route. */
-				newhop = match->nexthop;
-				if(newhop && nexthop->type == NEXTHOP_TYPE_IPV4) {
-					nexthop->ifindex = newhop->ifindex;
-				}
+		return 1;
+	} else if(CHECK_FLAG(rib->flags, ZEBRA_FLAG_INTERNAL)) {
+		resolved = 0;
+		for(newhop = match->nexthop; newhop; newhop = newhop->next) {
+			if(CHECK_FLAG(newhop->flags, NEXTHOP_FLAG_FIB) && !CHECK_FLAG(newhop->flags, NEXTHOP_FLAG_RECURSIVE)) {
+				if(set) {
+					SET_FLAG(nexthop->flags, NEXTHOP_FLAG_RECURSIVE);
+
+					resolved_hop = XCALLOC(MTYPE_NEXTHOP, sizeof(struct nexthop));
+					SET_FLAG(resolved_hop->flags, NEXTHOP_FLAG_ACTIVE);
+					/* If the resolving route specifies a gateway, use it */
+					if(newhop->type == NEXTHOP_TYPE_IPV4 || newhop->type == NEXTHOP_TYPE_IPV4_IFINDEX || newhop->type == NEXTHOP_TYPE_IPV4_IFNAME) {
+						resolved_hop->type = newhop->type;
+						resolved_hop->gate.ipv4 = newhop->gate.ipv4;
+						resolved_hop->ifindex = newhop->ifindex;
+					}
 
-				return 1;
-			} else if(CHECK_FLAG(rib->flags, ZEBRA_FLAG_INTERNAL)) {
-				resolved = 0;
-				for(newhop = match->nexthop; newhop; newhop = newhop->next) {
-					if(CHECK_FLAG(newhop->flags, NEXTHOP_FLAG_FIB) && !CHECK_FLAG(newhop->flags, NEXTHOP_FLAG_RECURSIVE)) {
-						if(set) {
-							SET_FLAG(nexthop->flags, NEXTHOP_FLAG_RECURSIVE);
-
-							resolved_hop = XCALLOC(MTYPE_NEXTHOP, sizeof(struct nexthop));
-							SET_FLAG(resolved_hop->flags, NEXTHOP_FLAG_ACTIVE);
-							/* If the resolving route specifies a gateway, use it */
-							if(newhop->type == NEXTHOP_TYPE_IPV4 || newhop->type == NEXTHOP_TYPE_IPV4_IFINDEX || newhop->type == NEXTHOP_TYPE_IPV4_IFNAME) {
-								resolved_hop->type = newhop->type;
-								resolved_hop->gate.ipv4 = newhop->gate.ipv4;
-								resolved_hop->ifindex = newhop->ifindex;
-							}
-
-							/* If the resolving route is an interface route, it
-			 * means the gateway we are looking up is connected
-			 * to that interface. Therefore, the resolved route
-			 * should have the original gateway as nexthop as it
-			 * is directly connected. */
-							if(newhop->type == NEXTHOP_TYPE_IFINDEX || newhop->type == NEXTHOP_TYPE_IFNAME) {
-								resolved_hop->type = NEXTHOP_TYPE_IPV4_IFINDEX;
-								resolved_hop->gate.ipv4 = nexthop->gate.ipv4;
-								resolved_hop->ifindex = newhop->ifindex;
-							}
-
-							nexthop_add(&nexthop->resolved, resolved_hop);
-						}
-						resolved = 1;
+					/* If the resolving route is an interface route, it
+					 * means the gateway we are looking up is connected
+					 * to that interface. Therefore, the resolved route
+					 * should have the original gateway as nexthop as it
+					 * is directly connected. */
+					if(newhop->type == NEXTHOP_TYPE_IFINDEX || newhop->type == NEXTHOP_TYPE_IFNAME) {
+						resolved_hop->type = NEXTHOP_TYPE_IPV4_IFINDEX;
+						resolved_hop->gate.ipv4 = nexthop->gate.ipv4;
+						resolved_hop->ifindex = newhop->ifindex;
 					}
+
+					nexthop_add(&nexthop->resolved, resolved_hop);
 				}
-				if(resolved && set) {
-					rib->nexthop_mtu = match->mtu;
-				}
-				return resolved;
-			} else {
-				return 0;
+				resolved = 1;
 			}
 		}
+		if(resolved && set) {
+			rib->nexthop_mtu = match->mtu;
+		}
+		return resolved;
+	} else {
+		return 0;
 	}
-	return 0;
 }
 
 /* If force flag is not set, do not modify falgs at all for uninstall
@@ -370,7 +575,6 @@ static int nexthop_active_ipv4(struct rib *rib, struct nexthop *nexthop, int set
 static int nexthop_active_ipv6(struct rib *rib, struct nexthop *nexthop, int set, struct route_node *top) {
 	struct prefix_ipv6 p;
 	struct route_table *table;
-	struct route_node *rn;
 	struct rib *match;
 	int resolved;
 	struct nexthop *newhop;
@@ -398,90 +602,62 @@ static int nexthop_active_ipv6(struct rib *rib, struct nexthop *nexthop, int set
 		return 0;
 	}
 
-	rn = route_node_match(table, (struct prefix *) &p);
-	while(rn) {
-		route_unlock_node(rn);
-
-		/* If lookup self prefix return immediately. */
-		if(rn == top) {
-			return 0;
-		}
-
-		/* Pick up selected route. */
-		RNODE_FOREACH_RIB(rn, match) {
-			if(CHECK_FLAG(match->status, RIB_ENTRY_REMOVED)) {
-				continue;
-			}
-			if(CHECK_FLAG(match->status, RIB_ENTRY_SELECTED_FIB)) {
-				break;
-			}
-		}
+	if((match = rib_resolve(table, (struct prefix *) &p, top)) == NULL) {
+		return 0;
+	}
 
-		/* If there is no selected route or matched route is EGP, go up
-         tree. */
-		if(!match || match->type == ZEBRA_ROUTE_BGP) {
-			do {
-				rn = rn->parent;
-			} while(rn && rn->info == NULL);
-			if(rn) {
-				route_lock_node(rn);
-			}
-		} else {
-			/* If the longest prefix match for the nexthop yields
-	   * a blackhole, mark it as inactive. */
-			if(CHECK_FLAG(match->flags, ZEBRA_FLAG_BLACKHOLE) || CHECK_FLAG(match->flags, ZEBRA_FLAG_REJECT)) {
-				return 0;
-			}
+	/* If the longest prefix match for the nexthop yields
+	 * a blackhole, mark it as inactive. */
+	if(CHECK_FLAG(match->flags, ZEBRA_FLAG_BLACKHOLE) || CHECK_FLAG(match->flags, ZEBRA_FLAG_REJECT)) {
+		return 0;
+	}
 
-			if(match->type == ZEBRA_ROUTE_CONNECT) {
-				/* Directly point connected route. */
-				newhop = match->nexthop;
+	if(match->type == ZEBRA_ROUTE_CONNECT) {
+		/* Directly point connected route. */
+		newhop = match->nexthop;
 
-				if(newhop && nexthop->type == NEXTHOP_TYPE_IPV6) {
-					nexthop->ifindex = newhop->ifindex;
-				}
+		if(newhop && nexthop->type == NEXTHOP_TYPE_IPV6) {
+			nexthop->ifindex = newhop->ifindex;
+		}
 
-				return 1;
-			} else if(CHECK_FLAG(rib->flags, ZEBRA_FLAG_INTERNAL)) {
-				resolved = 0;
-				for(newhop = match->nexthop; newhop; newhop = newhop->next) {
-					if(CHECK_FLAG(newhop->flags, NEXTHOP_FLAG_FIB) && !CHECK_FLAG(newhop->flags, NEXTHOP_FLAG_RECURSIVE)) {
-						if(set) {
-							SET_FLAG(nexthop->flags, NEXTHOP_FLAG_RECURSIVE);
-
-							resolved_hop = XCALLOC(MTYPE_NEXTHOP, sizeof(struct nexthop));
-							SET_FLAG(resolved_hop->flags, NEXTHOP_FLAG_ACTIVE);
-							/* See nexthop_active_ipv4 for a description how the
-			 * resolved nexthop is constructed. */
-							if(newhop->type == NEXTHOP_TYPE_IPV6 || newhop->type == NEXTHOP_TYPE_IPV6_IFINDEX || newhop->type == NEXTHOP_TYPE_IPV6_IFNAME) {
-								resolved_hop->type = newhop->type;
-								resolved_hop->gate.ipv6 = newhop->gate.ipv6;
-
-								if(newhop->ifindex) {
-									resolved_hop->type = NEXTHOP_TYPE_IPV6_IFINDEX;
-									resolved_hop->ifindex = newhop->ifindex;
-								}
-							}
-
-							if(newhop->type == NEXTHOP_TYPE_IFINDEX || newhop->type == NEXTHOP_TYPE_IFNAME) {
-								resolved_hop->flags |= NEXTHOP_FLAG_ONLINK;
-								resolved_hop->type = NEXTHOP_TYPE_IPV6_IFINDEX;
-								resolved_hop->gate.ipv6 = nexthop->gate.ipv6;
-								resolved_hop->ifindex = newhop->ifindex;
-							}
-
-							nexthop_add(&nexthop->resolved, resolved_hop);
+		return 1;
+	} else if(CHECK_FLAG(rib->flags, ZEBRA_FLAG_INTERNAL)) {
+		resolved = 0;
+		for(newhop = match->nexthop; newhop; newhop = newhop->next) {
+			if(CHECK_FLAG(newhop->flags, NEXTHOP_FLAG_FIB) && !CHECK_FLAG(newhop->flags, NEXTHOP_FLAG_RECURSIVE)) {
+				if(set) {
+					SET_FLAG(nexthop->flags, NEXTHOP_FLAG_RECURSIVE);
+
+					resolved_hop = XCALLOC(MTYPE_NEXTHOP, sizeof(struct nexthop));
+					SET_FLAG(resolved_hop->flags, NEXTHOP_FLAG_ACTIVE);
+					/* See nexthop_active_ipv4 for a description how the
+					 * resolved nexthop is constructed. */
+					if(newhop->type == NEXTHOP_TYPE_IPV6 || newhop->type == NEXTHOP_TYPE_IPV6_IFINDEX || newhop->type == NEXTHOP_TYPE_IPV6_IFNAME) {
+						resolved_hop->type = newhop->type;
+						resolved_hop->gate.ipv6 = newhop->gate.ipv6;
+
+						if(newhop->ifindex) {
+							resolved_hop->type = NEXTHOP_TYPE_IPV6_IFINDEX;
+							resolved_hop->ifindex = newhop->ifindex;
 						}
-						resolved = 1;
 					}
+
+					if(newhop->type == NEXTHOP_TYPE_IFINDEX || newhop->type == NEXTHOP_TYPE_IFNAME) {
+						resolved_hop->flags |= NEXTHOP_FLAG_ONLINK;
+						resolved_hop->type = NEXTHOP_TYPE_IPV6_IFINDEX;
+						resolved_hop->gate.ipv6 = nexthop->gate.ipv6;
+						resolved_hop->ifindex = newhop->ifindex;
+					}
+
+					nexthop_add(&nexthop->resolved, resolved_hop);
 				}
-				return resolved;
-			} else {
-				return 0;
+				resolved = 1;
 			}
 		}
+		return resolved;
+	} else {
+		return 0;
 	}
-	return 0;
 }
 
 struct rib *rib_match_ipv4_safi(struct in_addr addr, safi_t safi, int skip_bgp, struct route_node **rn_out, vrf_id_t vrf_id) {
@@ -916,46 +1092,362 @@ static unsigned nexthop_active_check(struct route_node *rn, struct rib *rib, str
 	return CHECK_FLAG(nexthop->flags, NEXTHOP_FLAG_ACTIVE);
 }
 
-/* Iterate over all nexthops of the given RIB entry and refresh their
- * ACTIVE flag. rib->nexthop_active_num is updated accordingly. If any
- * nexthop is found to toggle the ACTIVE flag, the whole rib structure
- * is flagged with RIB_ENTRY_CHANGED. The 4th 'set' argument is
- * transparently passed to nexthop_active_check().
- *
- * Return value is the new number of active nexthops.
- */
+/* Bumped whenever something nexthops resolve over may have changed: a
+ * non-BGP route in or out of the FIB, its nexthops, or interface states.
+ * Groups keep how their nexthops resolved as of an epoch, for the next
+ * member route that asks within that epoch. */
+static u_int32_t rib_nexthop_epoch = 1;
 
-static int nexthop_active_update(struct route_node *rn, struct rib *rib, int set) {
+void rib_nexthop_epoch_bump(void) {
+	if(++rib_nexthop_epoch == 0) {
+		rib_nexthop_epoch = 1;
+	}
+}
+
+/* The routes at rn, other than BGP, changed in or out of the FIB */
+void rib_nexthop_changed(struct route_node *rn) {
+	rib_nexthop_epoch_bump();
+	rib_resolve_invalidate(rn);
+}
+
+#define RIB_RESOLVES_NEXTHOPS(R) ((R) && (R)->type != ZEBRA_ROUTE_BGP)
+
+/* Whether a route map may turn nexthops of rib down, on its own terms */
+static int nexthop_route_mapped(struct route_node *rn, struct rib *rib) {
+	extern char *proto_rm[AFI_MAX][ZEBRA_ROUTE_MAX + 1];
+	afi_t afi = family2afi(rn->p.family);
+
+	return (afi == 0 || rib->type < 0 || rib->type >= ZEBRA_ROUTE_MAX || proto_rm[afi][rib->type] || proto_rm[afi][ZEBRA_ROUTE_MAX]);
+}
+
+/* Whether rib's nexthops resolve as those of any other member of its
+ * group would: not if a route map may treat its prefix its own way, nor
+ * if a gateway falls within that prefix, see nexthop_active_ipv4(). */
+static int nexthop_resolution_shared(struct route_node *rn, struct rib *rib) {
 	struct nexthop *nexthop;
-	unsigned int prev_active, new_active;
-	ifindex_t prev_index;
+	struct prefix_ipv4 p;
 
-	rib->nexthop_active_num = 0;
+	if(rib->nhg == NULL || rn->p.family != AF_INET || rib->vrf_id != rib->nhg->vrf_id || RIB_SYSTEM_ROUTE(rib)) {
+		return 0;
+	}
+	if(nexthop_route_mapped(rn, rib)) {
+		return 0;
+	}
 
+	memset(&p, 0, sizeof(p));
+	p.family = AF_INET;
+	p.prefixlen = IPV4_MAX_PREFIXLEN;
 	for(nexthop = rib->nexthop; nexthop; nexthop = nexthop->next) {
-		prev_active = CHECK_FLAG(nexthop->flags, NEXTHOP_FLAG_ACTIVE);
-		prev_index = nexthop->ifindex;
-		if((new_active = nexthop_active_check(rn, rib, nexthop, set))) {
-			rib->nexthop_active_num++;
-		}
-		if(prev_active != new_active || prev_index != nexthop->ifindex) {
-			SET_FLAG(rib->status, RIB_ENTRY_CHANGED);
+		if(nexthop->type == NEXTHOP_TYPE_IPV4 || nexthop->type == NEXTHOP_TYPE_IPV4_IFINDEX) {
+			p.prefix = nexthop->gate.ipv4;
+			if(prefix_match(&rn->p, (struct prefix *) &p)) {
+				return 0;
+			}
 		}
 	}
-	return rib->nexthop_active_num;
+	return 1;
 }
 
-static int rib_update_kernel(struct route_node *rn, struct rib *old, struct rib *new) {
-	int ret = 0;
-	struct nexthop *nexthop, *tnexthop;
-	rib_table_info_t *info = rn->table->info;
-	int recursing;
+static struct nexthop *nexthop_resolved_copy(struct nexthop *nexthop) {
+	struct nexthop *copy, *resolved;
 
-	if(info->safi != SAFI_UNICAST) {
-		if(new) {
-			for(ALL_NEXTHOPS_RO(new->nexthop, nexthop, tnexthop, recursing)) {
-				SET_FLAG(nexthop->flags, NEXTHOP_FLAG_FIB);
-			}
+	copy = nexthop_new();
+	copy->type = nexthop->type;
+	copy->flags = nexthop->flags & (NEXTHOP_FLAG_ACTIVE | NEXTHOP_FLAG_RECURSIVE | NEXTHOP_FLAG_ONLINK);
+	copy->ifindex = nexthop->ifindex;
+	copy->gate = nexthop->gate;
+	copy->src = nexthop->src;
+	for(resolved = nexthop->resolved; resolved; resolved = resolved->next) {
+		nexthop_add(&copy->resolved, nexthop_resolved_copy(resolved));
+	}
+	return copy;
+}
+
+/* Take the outcome of nexthop_active_check() from a group's resolution */
+static unsigned nexthop_active_take(struct nexthop *nexthop, struct nexthop *resolved, int set) {
+	struct nexthop *hop;
+
+	if(set) {
+		UNSET_FLAG(nexthop->flags, NEXTHOP_FLAG_RECURSIVE);
+		nexthops_free(nexthop->resolved);
+		nexthop->resolved = NULL;
+		if(CHECK_FLAG(resolved->flags, NEXTHOP_FLAG_RECURSIVE)) {
+			SET_FLAG(nexthop->flags, NEXTHOP_FLAG_RECURSIVE);
+			for(hop = resolved->resolved; hop; hop = hop->next) {
+				nexthop_add(&nexthop->resolved, nexthop_resolved_copy(hop));
+			}
+		}
+	}
+	nexthop->ifindex = resolved->ifindex;
+	if(CHECK_FLAG(resolved->flags, NEXTHOP_FLAG_ACTIVE)) {
+		SET_FLAG(nexthop->flags, NEXTHOP_FLAG_ACTIVE);
+	} else {
+		UNSET_FLAG(nexthop->flags, NEXTHOP_FLAG_ACTIVE);
+	}
+	return CHECK_FLAG(nexthop->flags, NEXTHOP_FLAG_ACTIVE);
+}
+
+/* Where nexthops look at interfaces.  For each interface, by ifindex or
+ * by name as the nexthops give it, a rib_ifdep in the VRF's ifdeps keeps
+ * the route nodes whose routes looked at its state, see
+ * nexthop_active_check().  A route a route map may have a say on depends
+ * on any interface, the entry with neither.  An interface event queues
+ * the dependents of its entries and drops them, the routes depending
+ * again as they are looked at: see rib_update_interface(). */
+struct rib_ifdep {
+	ifindex_t ifindex;
+	char ifname[INTERFACE_NAMSIZ + 1];
+	struct hash *dependents;
+};
+
+static unsigned int rib_ifdep_key(void *p) {
+	struct rib_ifdep *dep = p;
+
+	return dep->ifindex ? jhash_1word(dep->ifindex, 0) : string_hash_make(dep->ifname);
+}
+
+static int rib_ifdep_cmp(const void *p1, const void *p2) {
+	const struct rib_ifdep *dep1 = p1;
+	const struct rib_ifdep *dep2 = p2;
+
+	return dep1->ifindex == dep2->ifindex && strcmp(dep1->ifname, dep2->ifname) == 0;
+}
+
+static void *rib_ifdep_alloc(void *p) {
+	struct rib_ifdep *dep;
+
+	dep = XMALLOC(MTYPE_RIB_IFDEP, sizeof(struct rib_ifdep));
+	memcpy(dep, p, sizeof(struct rib_ifdep));
+	dep->dependents = hash_create_open(rib_resolve_dependent_key, rib_resolve_dependent_cmp);
+	return dep;
+}
+
+static void rib_ifdep_free(struct zebra_vrf *zvrf, struct rib_ifdep *dep) {
+	hash_release(zvrf->ifdeps, dep);
+	hash_clean(dep->dependents, NULL);
+	hash_free(dep->dependents);
+	XFREE(MTYPE_RIB_IFDEP, dep);
+}
+
+/* The interface whose state nexthop takes, if any */
+static int rib_ifdep_of(struct nexthop *nexthop, struct rib_ifdep *key) {
+	memset(key, 0, sizeof(struct rib_ifdep));
+	switch(nexthop->type) {
+		case NEXTHOP_TYPE_IPV6_IFINDEX:
+			if(!IN6_IS_ADDR_LINKLOCAL(&nexthop->gate.ipv6)) {
+				return 0;
+			}
+			/* fall through */
+		case NEXTHOP_TYPE_IFINDEX: key->ifindex = nexthop->ifindex; return 1;
+		case NEXTHOP_TYPE_IFNAME:
+		case NEXTHOP_TYPE_IPV6_IFNAME: strncpy(key->ifname, nexthop->ifname, INTERFACE_NAMSIZ); return 1;
+		default: return 0;
+	}
+}
+
+/* Whether rib at rn depends on the interface of key */
+static int rib_ifdep_has(struct route_node *rn, struct rib *rib, struct rib_ifdep *key) {
+	struct rib_ifdep other;
+	struct nexthop *nexthop;
+
+	if(key->ifindex == 0 && key->ifname[0] == '\0') {
+		return nexthop_route_mapped(rn, rib);
+	}
+	for(nexthop = rib->nexthop; nexthop; nexthop = nexthop->next) {
+		if(rib_ifdep_of(nexthop, &other) && rib_ifdep_cmp(&other, key)) {
+			return 1;
+		}
+	}
+	return 0;
+}
+
+static void rib_ifdep_depend(struct zebra_vrf *zvrf, struct rib_ifdep *key, struct route_node *rn) {
+	struct rib_ifdep *dep;
+
+	dep = hash_get(zvrf->ifdeps, key, rib_ifdep_alloc);
+	if(hash_lookup(dep->dependents, rn) == NULL) {
+		hash_get(dep->dependents, rn, hash_alloc_intern);
+		route_lock_node(rn);
+	}
+}
+
+/* rib at rn took the state of the interfaces of its nexthops */
+static void rib_ifdep_depend_all(struct route_node *rn, struct rib *rib) {
+	struct zebra_vrf *zvrf;
+	struct rib_ifdep key;
+	struct nexthop *nexthop;
+
+	if((zvrf = vrf_info_lookup(rib->vrf_id)) == NULL) {
+		return;
+	}
+	if(nexthop_route_mapped(rn, rib)) {
+		memset(&key, 0, sizeof(key));
+		rib_ifdep_depend(zvrf, &key, rn);
+	}
+	for(nexthop = rib->nexthop; nexthop; nexthop = nexthop->next) {
+		if(rib_ifdep_of(nexthop, &key)) {
+			rib_ifdep_depend(zvrf, &key, rn);
+		}
+	}
+}
+
+/* rn no longer depends on an interface through rib, going away, unless
+ * another of its routes does too */
+static void rib_ifdep_release_one(struct zebra_vrf *zvrf, struct route_node *rn, struct rib *rib, struct rib_ifdep *key) {
+	struct rib_ifdep *dep;
+	struct rib *other;
+
+	if((dep = hash_lookup(zvrf->ifdeps, key)) == NULL || hash_lookup(dep->dependents, rn) == NULL) {
+		return;
+	}
+	RNODE_FOREACH_RIB(rn, other) {
+		if(other != rib && !CHECK_FLAG(other->status, RIB_ENTRY_REMOVED) && rib_ifdep_has(rn, other, key)) {
+			return;
+		}
+	}
+
+	hash_release(dep->dependents, rn);
+	route_unlock_node(rn);
+	if(dep->dependents->count == 0) {
+		rib_ifdep_free(zvrf, dep);
+	}
+}
+
+static void rib_ifdep_release(struct route_node *rn, struct rib *rib) {
+	struct zebra_vrf *zvrf;
+	struct rib_ifdep key;
+	struct nexthop *nexthop;
+
+	if((zvrf = vrf_info_lookup(rib->vrf_id)) == NULL) {
+		return;
+	}
+	memset(&key, 0, sizeof(key));
+	rib_ifdep_release_one(zvrf, rn, rib, &key);
+	for(nexthop = rib->nexthop; nexthop; nexthop = nexthop->next) {
+		if(rib_ifdep_of(nexthop, &key)) {
+			rib_ifdep_release_one(zvrf, rn, rib, &key);
+		}
+	}
+}
+
+static unsigned long rib_ifdep_invalidate(struct zebra_vrf *zvrf, struct rib_ifdep *key) {
+	struct rib_ifdep *dep;
+	unsigned long count;
+
+	if((dep = hash_lookup(zvrf->ifdeps, key)) == NULL) {
+		return 0;
+	}
+	count = dep->dependents->count;
+	hash_iterate(dep->dependents, rib_resolve_requeue, NULL);
+	rib_ifdep_free(zvrf, dep);
+	return count;
+}
+
+/* Iterate over all nexthops of the given RIB entry and refresh their
+ * ACTIVE flag. rib->nexthop_active_num is updated accordingly. If any
+ * nexthop is found to toggle the ACTIVE flag, the whole rib structure
+ * is flagged with RIB_ENTRY_CHANGED. The 4th 'set' argument is
+ * transparently passed to nexthop_active_check(), unless the outcome is
+ * taken from the rib's nexthop group.
+ *
+ * Nothing a rib's nexthops depend on changed while rib_nexthop_epoch
+ * stays the same, so within an epoch, the nexthops of a rib aren't looked
+ * at again, but where a route map may have a say.
+ *
+ * Return value is the new number of active nexthops.
+ */
+static int nexthop_active_update(struct route_node *rn, struct rib *rib, int set) {
+	struct nexthop *nexthop, *resolved = NULL;
+	struct zebra_nhg *nhg = NULL;
+	unsigned int prev_active, new_active;
+	ifindex_t prev_index;
+	int mapped;
+
+	if(rib->active_epoch == rib_nexthop_epoch && (!set || rib->resolved_epoch == rib_nexthop_epoch)) {
+		return rib->nexthop_active_num;
+	}
+
+	rib->nexthop_active_num = 0;
+
+	if(nexthop_resolution_shared(rn, rib)) {
+		nhg = rib->nhg;
+		if(nhg->resolved_epoch == rib_nexthop_epoch && nhg->resolved_flags == (rib->flags & ZEBRA_FLAG_INTERNAL)) {
+			resolved = nhg->resolved;
+			nhg->resolved_hits++;
+			rib_resolve_depend_all(rn, rib);
+			if(set) {
+				rib->nexthop_mtu = nhg->resolved_mtu;
+			}
+		}
+	}
+
+	for(nexthop = rib->nexthop; nexthop; nexthop = nexthop->next) {
+		prev_active = CHECK_FLAG(nexthop->flags, NEXTHOP_FLAG_ACTIVE);
+		prev_index = nexthop->ifindex;
+		if(resolved) {
+			new_active = nexthop_active_take(nexthop, resolved, set);
+			resolved = resolved->next;
+		} else {
+			new_active = nexthop_active_check(rn, rib, nexthop, set);
+		}
+		if(new_active) {
+			rib->nexthop_active_num++;
+		}
+		if(prev_active != new_active || prev_index != nexthop->ifindex) {
+			SET_FLAG(rib->status, RIB_ENTRY_CHANGED);
+		}
+	}
+
+	/* the first member to resolve in full does so for the group */
+	if(nhg && set && nhg->resolved_epoch != rib_nexthop_epoch) {
+		nexthops_free(nhg->resolved);
+		nhg->resolved = NULL;
+		for(nexthop = rib->nexthop; nexthop; nexthop = nexthop->next) {
+			nexthop_add(&nhg->resolved, nexthop_resolved_copy(nexthop));
+		}
+		nhg->resolved_epoch = rib_nexthop_epoch;
+		nhg->resolved_mtu = rib->nexthop_mtu;
+		nhg->resolved_flags = rib->flags & ZEBRA_FLAG_INTERNAL;
+	}
+
+	rib_ifdep_depend_all(rn, rib);
+
+	mapped = nexthop_route_mapped(rn, rib);
+	rib->active_epoch = mapped ? 0 : rib_nexthop_epoch;
+	if(set) {
+		rib->resolved_epoch = rib->active_epoch;
+	}
+	return rib->nexthop_active_num;
+}
+
+#ifdef ZEBRA_BENCH
+/* zebrabench reports the time spent in nexthop resolution on its own */
+u_int64_t rib_bench_resolve_nsec;
+
+static int nexthop_active_update_timed(struct route_node *rn, struct rib *rib, int set) {
+	struct timespec start, end;
+	int ret;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	ret = nexthop_active_update(rn, rib, set);
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	rib_bench_resolve_nsec += (end.tv_sec - start.tv_sec) * 1000000000ULL + end.tv_nsec - start.tv_nsec;
+	return ret;
+}
+	#define nexthop_active_update nexthop_active_update_timed
+#endif
+
+static int rib_update_kernel(struct route_node *rn, struct rib *old, struct rib *new) {
+	int ret = 0;
+	struct nexthop *nexthop, *tnexthop;
+	rib_table_info_t *info = rn->table->info;
+	int recursing;
+
+	if(info->safi != SAFI_UNICAST) {
+		if(new) {
+			for(ALL_NEXTHOPS_RO(new->nexthop, nexthop, tnexthop, recursing)) {
+				SET_FLAG(nexthop->flags, NEXTHOP_FLAG_FIB);
+			}
 		}
 		if(old) {
 			for(ALL_NEXTHOPS_RO(old->nexthop, nexthop, tnexthop, recursing)) {
@@ -987,6 +1479,140 @@ static int rib_update_kernel(struct route_node *rn, struct rib *old, struct rib
 	return ret;
 }
 
+/* Graceful restart: the routes still to be claimed, all of them and by
+ * the type they are kept for, and the timers sweeping those left.  The
+ * self routes read from the kernel at startup go as ZEBRA_ROUTE_KERNEL,
+ * those of a client restarting as the client's type. */
+static unsigned long rib_stale_count;
+static unsigned long rib_stale_type_count[ZEBRA_ROUTE_MAX];
+static struct thread *rib_sweep_thread[ZEBRA_ROUTE_MAX];
+
+/* Returns TRUE if the kernel has nexthop as the nexthop it read back
+ * for a stale route.  */
+static int rib_kernel_nexthop_same(struct nexthop *stale, struct nexthop *nexthop, int family) {
+	if(nexthop->ifindex && nexthop->ifindex != stale->ifindex) {
+		return 0;
+	}
+
+	switch(nexthop->type) {
+		case NEXTHOP_TYPE_IPV4:
+		case NEXTHOP_TYPE_IPV4_IFINDEX:
+			if(!IPV4_ADDR_SAME(&nexthop->gate.ipv4, &stale->gate.ipv4)) {
+				return 0;
+			}
+			break;
+#ifdef HAVE_IPV6
+		case NEXTHOP_TYPE_IPV6:
+		case NEXTHOP_TYPE_IPV6_IFINDEX:
+		case NEXTHOP_TYPE_IPV6_IFNAME:
+			if(!IPV6_ADDR_SAME(&nexthop->gate.ipv6, &stale->gate.ipv6)) {
+				return 0;
+			}
+			break;
+#endif /* HAVE_IPV6 */
+		default: break;
+	}
+
+	if(family == AF_INET && !IPV4_ADDR_SAME(&nexthop->src.ipv4, &stale->src.ipv4)) {
+		return 0;
+	}
+
+	return 1;
+}
+
+/* Returns TRUE if installing rib would leave the kernel with the route
+ * the previous zebra installed, read back as stale: the nexthops that
+ * would be installed, the active ones it resolves to up to
+ * MULTIPATH_NUM, are those of the stale route.  */
+static int rib_kernel_route_same(struct route_node *rn, struct rib *stale, struct rib *rib) {
+	struct nexthop *nexthop, *tnexthop, *snexthop;
+	int recursing, num, snum, family;
+
+	if((stale->flags ^ rib->flags) & (ZEBRA_FLAG_BLACKHOLE | ZEBRA_FLAG_REJECT)) {
+		return 0;
+	}
+	if(rib->flags & (ZEBRA_FLAG_BLACKHOLE | ZEBRA_FLAG_REJECT)) {
+		return 1;
+	}
+
+	/* Kernel nexthop groups of the previous zebra are gone. */
+	if(rib->nhg && rib->nhg->kernel_id) {
+		return 0;
+	}
+
+	family = PREFIX_FAMILY(&rn->p);
+
+	snum = 0;
+	for(snexthop = stale->nexthop; snexthop; snexthop = snexthop->next) {
+		snum++;
+	}
+
+	num = 0;
+	for(ALL_NEXTHOPS_RO(rib->nexthop, nexthop, tnexthop, recursing)) {
+		if(CHECK_FLAG(nexthop->flags, NEXTHOP_FLAG_RECURSIVE) || !CHECK_FLAG(nexthop->flags, NEXTHOP_FLAG_ACTIVE)) {
+			continue;
+		}
+		if(MULTIPATH_NUM != 0 && num >= MULTIPATH_NUM) {
+			break;
+		}
+
+		for(snexthop = stale->nexthop; snexthop; snexthop = snexthop->next) {
+			if(rib_kernel_nexthop_same(snexthop, nexthop, family)) {
+				break;
+			}
+		}
+		if(!snexthop) {
+			return 0;
+		}
+		num++;
+	}
+
+	return num && num == snum;
+}
+
+/* Take over the route in the kernel for rib, without writing it again. */
+static void rib_kernel_route_keep(struct route_node *rn, struct rib *rib) {
+	struct nexthop *nexthop, *tnexthop;
+	int recursing, num;
+
+	if(IS_ZEBRA_DEBUG_RIB) {
+		rnode_debug(rn, "keeping the route in the kernel");
+	}
+
+	zfpm_trigger_update(rn, "kept in kernel");
+
+	num = 0;
+	for(ALL_NEXTHOPS_RO(rib->nexthop, nexthop, tnexthop, recursing)) {
+		if(CHECK_FLAG(nexthop->flags, NEXTHOP_FLAG_RECURSIVE)) {
+			continue;
+		}
+		if(rib->flags & (ZEBRA_FLAG_BLACKHOLE | ZEBRA_FLAG_REJECT)) {
+			SET_FLAG(nexthop->flags, NEXTHOP_FLAG_FIB);
+			continue;
+		}
+		if(!CHECK_FLAG(nexthop->flags, NEXTHOP_FLAG_ACTIVE) || (MULTIPATH_NUM != 0 && num >= MULTIPATH_NUM)) {
+			continue;
+		}
+		SET_FLAG(nexthop->flags, NEXTHOP_FLAG_FIB);
+		num++;
+	}
+}
+
+static void rib_delnode(struct route_node *, struct rib *);
+
+/* A client announced a route where the previous zebra left one in the
+ * kernel, or where the client's previous instance left one: drop the
+ * stale route, the new one replaces it. */
+static void rib_claim_stale(struct route_node *rn, struct rib *new) {
+	struct rib *rib;
+
+	RNODE_FOREACH_RIB(rn, rib) {
+		if(CHECK_FLAG(rib->status, RIB_ENTRY_STALE) && !CHECK_FLAG(rib->status, RIB_ENTRY_REMOVED) && (rib->type == ZEBRA_ROUTE_KERNEL || rib->type == new->type)) {
+			rib_delnode(rn, rib);
+		}
+	}
+}
+
 /* Uninstall the route from kernel. */
 static void rib_uninstall(struct route_node *rn, struct rib *rib) {
 	rib_table_info_t *info = rn->table->info;
@@ -1020,40 +1646,149 @@ static int rib_can_delete_dest(rib_dest_t *dest) {
    * Don't delete the dest if we have to update the FPM about this
    * prefix.
    */
-	if(CHECK_FLAG(dest->flags, RIB_DEST_UPDATE_FPM) || CHECK_FLAG(dest->flags, RIB_DEST_SENT_TO_FPM)) {
+	if(dest->fpm_update || dest->fpm_sent) {
 		return 0;
 	}
 
 	return 1;
 }
 
+static void rib_dest_version_unlink(rib_table_info_t *info, rib_dest_t *dest) {
+	if(!CHECK_FLAG(dest->flags, RIB_DEST_CHANGED)) {
+		return;
+	}
+
+	if(dest->vprev) {
+		dest->vprev->vnext = dest->vnext;
+	} else {
+		info->changed_head = dest->vnext;
+	}
+	if(dest->vnext) {
+		dest->vnext->vprev = dest->vprev;
+	} else {
+		info->changed_tail = dest->vprev;
+	}
+	dest->vprev = dest->vnext = NULL;
+	UNSET_FLAG(dest->flags, RIB_DEST_CHANGED);
+}
+
 /*
- * rib_gc_dest
- *
- * Garbage collect the rib dest corresponding to the given route node
- * if appropriate.
+ * rib_dest_version_bump
  *
- * Returns TRUE if the dest was deleted, FALSE otherwise.
+ * Give the dest of rn the table's next version, its selected route
+ * having changed. A prefix left without one goes to the withdrawn ring,
+ * as its dest may be freed.
  */
-int rib_gc_dest(struct route_node *rn) {
-	rib_dest_t *dest;
+static void rib_dest_version_bump(struct route_node *rn, int withdrawn) {
+	rib_table_info_t *info = rn->table->info;
+	rib_dest_t *dest = rib_dest_from_rnode(rn);
+	struct rib_withdrawn *w;
 
-	dest = rib_dest_from_rnode(rn);
-	if(!dest) {
-		return 0;
-	}
+	rib_dest_version_unlink(info, dest);
+	dest->version = ++info->version;
 
-	if(!rib_can_delete_dest(dest)) {
-		return 0;
+	if(withdrawn) {
+		if(!info->withdrawn) {
+			info->withdrawn = XCALLOC(MTYPE_RIB_TABLE_INFO, RIB_TABLE_WITHDRAWN_MAX * sizeof(struct rib_withdrawn));
+		}
+		if(info->withdrawn_count == RIB_TABLE_WITHDRAWN_MAX) {
+			info->forgotten = info->withdrawn[info->withdrawn_start].version;
+			info->withdrawn_start = (info->withdrawn_start + 1) % RIB_TABLE_WITHDRAWN_MAX;
+			info->withdrawn_count--;
+		}
+		w = &info->withdrawn[(info->withdrawn_start + info->withdrawn_count) % RIB_TABLE_WITHDRAWN_MAX];
+		prefix_copy(&w->p, &rn->p);
+		w->version = dest->version;
+		info->withdrawn_count++;
+		return;
 	}
 
-	if(IS_ZEBRA_DEBUG_RIB) {
-		rnode_debug(rn, "removing dest from table");
+	dest->vprev = info->changed_tail;
+	if(info->changed_tail) {
+		info->changed_tail->vnext = dest;
+	} else {
+		info->changed_head = dest;
 	}
+	info->changed_tail = dest;
+	SET_FLAG(dest->flags, RIB_DEST_CHANGED);
+}
 
-	dest->rnode = NULL;
+int rib_table_changes_init(rib_table_changes_t *changes, struct route_table *table, u_int64_t version) {
+	rib_table_info_t *info = table->info;
+	rib_dest_t *dest;
+	unsigned int i;
+
+	changes->info = info;
+
+	/* the changes asked for are the latest, look from the end */
+	changes->changed = NULL;
+	for(dest = info->changed_tail; dest && dest->version > version; dest = dest->vprev) {
+		changes->changed = dest;
+	}
+
+	for(i = info->withdrawn_count; i > 0; i--) {
+		if(info->withdrawn[(info->withdrawn_start + i - 1) % RIB_TABLE_WITHDRAWN_MAX].version <= version) {
+			break;
+		}
+	}
+	changes->withdrawn = i;
+
+	return version >= info->forgotten;
+}
+
+int rib_table_changes_next(rib_table_changes_t *changes, struct route_node **rn, const struct rib_withdrawn **withdrawn) {
+	rib_table_info_t *info = changes->info;
+	const struct rib_withdrawn *w = NULL;
+
+	if(changes->withdrawn < info->withdrawn_count) {
+		w = &info->withdrawn[(info->withdrawn_start + changes->withdrawn) % RIB_TABLE_WITHDRAWN_MAX];
+	}
+
+	if(changes->changed && (!w || changes->changed->version < w->version)) {
+		*rn = changes->changed->rnode;
+		*withdrawn = NULL;
+		changes->changed = changes->changed->vnext;
+		return 1;
+	}
+	if(w) {
+		*rn = NULL;
+		*withdrawn = w;
+		changes->withdrawn++;
+		return 1;
+	}
+	return 0;
+}
+
+/*
+ * rib_gc_dest
+ *
+ * Garbage collect the rib dest corresponding to the given route node
+ * if appropriate.
+ *
+ * Returns TRUE if the dest was deleted, FALSE otherwise.
+ */
+int rib_gc_dest(struct route_node *rn) {
+	rib_dest_t *dest;
+
+	dest = rib_dest_from_rnode(rn);
+	if(!dest) {
+		return 0;
+	}
+
+	if(!rib_can_delete_dest(dest)) {
+		return 0;
+	}
+
+	if(IS_ZEBRA_DEBUG_RIB) {
+		rnode_debug(rn, "removing dest from table");
+	}
+
+	rib_dest_version_unlink(rn->table->info, dest);
+	dest->rnode = NULL;
 	XFREE(MTYPE_RIB_DEST, dest);
 	rn->info = NULL;
+	/* nexthops matched here resolve through a shorter prefix now */
+	zebra_rnh_changed(rn);
 
 	/*
    * Release the one reference that we keep on the route node.
@@ -1122,6 +1857,7 @@ static void rib_process(struct route_node *rn) {
 	assert(rn);
 
 	info = rn->table->info;
+	QUAGGA_TRACE(zebra, rib_process, &rn->p, info->zvrf->vrf_id);
 
 	RNODE_FOREACH_RIB(rn, rib) {
 		UNSET_FLAG(rib->status, RIB_ENTRY_CHANGED);
@@ -1183,8 +1919,12 @@ static void rib_process(struct route_node *rn) {
 
 	/* Update kernel if FIB entry has changed */
 	if(old_fib != new_fib || (new_fib && CHECK_FLAG(new_fib->status, RIB_ENTRY_CHANGED))) {
+		zebra_rnh_changed(rn);
+		if(RIB_RESOLVES_NEXTHOPS(old_fib) || RIB_RESOLVES_NEXTHOPS(new_fib)) {
+			rib_nexthop_changed(rn);
+		}
 		if(old_fib && old_fib != new_fib) {
-			if(!RIB_SYSTEM_ROUTE(old_fib) && (!new_fib || RIB_SYSTEM_ROUTE(new_fib))) {
+			if((!RIB_SYSTEM_ROUTE(old_fib) || CHECK_FLAG(old_fib->status, RIB_ENTRY_STALE)) && (!new_fib || RIB_SYSTEM_ROUTE(new_fib))) {
 				rib_update_kernel(rn, old_fib, NULL);
 			}
 			UNSET_FLAG(old_fib->status, RIB_ENTRY_SELECTED_FIB);
@@ -1194,7 +1934,13 @@ static void rib_process(struct route_node *rn) {
 			/* Install new or replace existing FIB entry */
 			SET_FLAG(new_fib->status, RIB_ENTRY_SELECTED_FIB);
 			if(!RIB_SYSTEM_ROUTE(new_fib)) {
-				rib_update_kernel(rn, old_fib, new_fib);
+				/* A route left in the kernel by the previous zebra
+                 * is kept if claimed as it is. */
+				if(old_fib && CHECK_FLAG(old_fib->status, RIB_ENTRY_STALE) && rib_kernel_route_same(rn, old_fib, new_fib)) {
+					rib_kernel_route_keep(rn, new_fib);
+				} else {
+					rib_update_kernel(rn, old_fib, new_fib);
+				}
 			}
 		}
 
@@ -1214,6 +1960,10 @@ static void rib_process(struct route_node *rn) {
 		}
 		if(!installed) {
 			rib_update_kernel(rn, NULL, new_fib);
+			zebra_rnh_changed(rn);
+			if(RIB_RESOLVES_NEXTHOPS(new_fib)) {
+				rib_nexthop_changed(rn);
+			}
 		}
 	}
 
@@ -1233,6 +1983,8 @@ static void rib_process(struct route_node *rn) {
 			SET_FLAG(new_selected->flags, ZEBRA_FLAG_SELECTED);
 			redistribute_add(&rn->p, new_selected, old_selected);
 		}
+
+		rib_dest_version_bump(rn, new_selected == NULL);
 	}
 
 	/* Remove all RIB entries queued for removal */
@@ -1255,19 +2007,38 @@ static void rib_process(struct route_node *rn) {
 	rib_gc_dest(rn);
 }
 
-/* Take a list of route_node structs and return 1, if there was a record
- * picked from it and processed by rib_process(). Don't process more,
- * than one RN record; operate only in the specified sub-queue.
+static u_int32_t meta_queue_msec(void) {
+	struct timeval tv;
+
+	quagga_gettime(QUAGGA_CLK_MONOTONIC, &tv);
+	return tv.tv_sec * 1000 + tv.tv_usec / 1000;
+}
+
+/* Take the route_node at the head of a sub-queue and return 1, if there
+ * was one to pass to rib_process(). Don't process more, than one RN
+ * record; operate only in the specified sub-queue.
  */
-static unsigned int process_subq(struct list *subq, u_char qindex) {
-	struct listnode *lnode = listhead(subq);
+static unsigned int process_subq(struct meta_subq *subq, u_char qindex) {
+	struct meta_queue_entry *e;
 	struct route_node *rnode;
+	u_int32_t wait;
 
-	if(!lnode) {
+	if(!subq->count) {
 		return 0;
 	}
 
-	rnode = listgetdata(lnode);
+	e = &subq->ring[subq->head];
+	rnode = e->rn;
+	wait = meta_queue_msec() - e->queued;
+	subq->head = (subq->head + 1) & (subq->cap - 1);
+	subq->count--;
+
+	subq->dequeued++;
+	subq->wait_total += wait;
+	if(wait > subq->wait_max) {
+		subq->wait_max = wait;
+	}
+
 	rib_process(rnode);
 
 	if(rnode->info) {
@@ -1283,7 +2054,6 @@ static unsigned int process_subq(struct list *subq, u_char qindex) {
     }
 #endif
 	route_unlock_node(rnode);
-	list_delete_node(subq, lnode);
 	return 1;
 }
 
@@ -1291,10 +2061,25 @@ static unsigned int process_subq(struct list *subq, u_char qindex) {
  * All meta queues have been processed. Trigger next-hop evaluation.
  */
 static void meta_queue_process_complete(struct work_queue *dummy) {
-	zebra_evaluate_rnh_table(0, AF_INET);
-#ifdef HAVE_IPV6
-	zebra_evaluate_rnh_table(0, AF_INET6);
-#endif /* HAVE_IPV6 */
+	static u_int32_t refreshed;
+
+	/* nexthop groups first, their routes are queued again if need be */
+	if(refreshed != rib_nexthop_epoch) {
+		refreshed = rib_nexthop_epoch;
+		zebra_nhg_refresh();
+	}
+
+	zebra_evaluate_rnh();
+}
+
+/* A run of the queue talks to the kernel throughout: the privileges for
+ * it are raised once for the run, and lowered at its end. */
+static void meta_queue_run_begin(struct work_queue *dummy) {
+	kernel_privs_hold();
+}
+
+static void meta_queue_run_end(struct work_queue *dummy) {
+	kernel_privs_release();
 }
 
 /* Dispatch the meta queue by picking, processing and unlocking the next RN from
@@ -1306,7 +2091,7 @@ static wq_item_status meta_queue_process(struct work_queue *dummy, void *data) {
 	unsigned i;
 
 	for(i = 0; i < MQ_SIZE; i++) {
-		if(process_subq(mq->subq[i], i)) {
+		if(process_subq(&mq->subq[i], i)) {
 			mq->size--;
 			break;
 		}
@@ -1322,6 +2107,45 @@ static const u_char meta_queue_map[ZEBRA_ROUTE_MAX] = {
 	[ZEBRA_ROUTE_OSPF6] = 2,  [ZEBRA_ROUTE_ISIS] = 2,   [ZEBRA_ROUTE_BGP] = 3,     [ZEBRA_ROUTE_HSLS] = 4,	 [ZEBRA_ROUTE_BABEL] = 2, [ZEBRA_ROUTE_NHRP] = 2,
 };
 
+/* Append rn to the sub-queue, making room for it if need be */
+static void meta_subq_push(struct meta_subq *subq, struct route_node *rn) {
+	struct meta_queue_entry *e;
+	time_t now;
+
+	if(subq->count == subq->cap) {
+		struct meta_queue_entry *ring;
+		u_int32_t i, cap = subq->cap ? subq->cap * 2 : 1024;
+
+		ring = XMALLOC(MTYPE_RIB_QUEUE, cap * sizeof(*ring));
+		for(i = 0; i < subq->count; i++) {
+			ring[i] = subq->ring[(subq->head + i) & (subq->cap - 1)];
+		}
+		if(subq->ring) {
+			XFREE(MTYPE_RIB_QUEUE, subq->ring);
+		}
+		subq->ring = ring;
+		subq->cap = cap;
+		subq->head = 0;
+	}
+
+	e = &subq->ring[(subq->head + subq->count) & (subq->cap - 1)];
+	e->rn = rn;
+	e->queued = meta_queue_msec();
+	subq->count++;
+
+	if(subq->count > subq->max_count) {
+		subq->max_count = subq->count;
+	}
+	subq->enqueued++;
+	now = e->queued / 1000;
+	if(now != subq->rate_sec) {
+		subq->rate = now == subq->rate_sec + 1 ? subq->rate_count : 0;
+		subq->rate_count = 0;
+		subq->rate_sec = now;
+	}
+	subq->rate_count++;
+}
+
 /* Look into the RN and queue it into one or more priority queues,
  * increasing the size for each data push done.
  */
@@ -1340,7 +2164,7 @@ static void rib_meta_queue_add(struct meta_queue *mq, struct route_node *rn) {
 		}
 
 		SET_FLAG(rib_dest_from_rnode(rn)->flags, RIB_ROUTE_QUEUED(qindex));
-		listnode_add(mq->subq[qindex], rn);
+		meta_subq_push(&mq->subq[qindex], rn);
 		route_lock_node(rn);
 		mq->size++;
 
@@ -1398,17 +2222,47 @@ static void rib_queue_add(struct zebra_t *zebra, struct route_node *rn) {
  */
 static struct meta_queue *meta_queue_new(void) {
 	struct meta_queue *new;
-	unsigned i;
 
 	new = XCALLOC(MTYPE_WORK_QUEUE, sizeof(struct meta_queue));
 	assert(new);
 
-	for(i = 0; i < MQ_SIZE; i++) {
-		new->subq[i] = list_new();
-		assert(new->subq[i]);
+	return new;
+}
+
+static const char *meta_queue_desc[MQ_SIZE] = {
+	"connected, kernel", "static", "IGP", "BGP", "other",
+};
+
+/* route_nodes queued over the last whole second */
+static u_int32_t meta_subq_rate(struct meta_subq *subq) {
+	time_t now = meta_queue_msec() / 1000;
+
+	if(now == subq->rate_sec) {
+		return subq->rate;
 	}
+	if(now == subq->rate_sec + 1) {
+		return subq->rate_count;
+	}
+	return 0;
+}
 
-	return new;
+void rib_meta_queue_show(struct vty *vty) {
+	struct meta_queue *mq = zebrad.mq;
+	struct meta_subq *subq;
+	unsigned i;
+
+	if(mq == NULL) {
+		return;
+	}
+
+	vty_out(vty, "RIB meta queue: %u route nodes queued%s", mq->size, VTY_NEWLINE);
+	vty_out(vty, "%-17s %8s %8s %12s %8s %9s %9s%s", "Sub-queue", "Depth", "Max", "Enqueued", "Rate/s", "Wait avg", "Wait max", VTY_NEWLINE);
+	for(i = 0; i < MQ_SIZE; i++) {
+		subq = &mq->subq[i];
+		vty_out(vty, "%u %-15s %8u %8u %12llu %8u %7llums %7ums%s", i, meta_queue_desc[i], subq->count, subq->max_count, (unsigned long long) subq->enqueued,
+			meta_subq_rate(subq),
+			(unsigned long long) (subq->dequeued ? subq->wait_total / subq->dequeued : 0), subq->wait_max, VTY_NEWLINE);
+	}
 }
 
 /* initialise zebra rib work queue */
@@ -1424,9 +2278,12 @@ static void rib_queue_init(struct zebra_t *zebra) {
 	zebra->ribq->spec.workfunc = &meta_queue_process;
 	zebra->ribq->spec.errorfunc = NULL;
 	zebra->ribq->spec.completion_func = &meta_queue_process_complete;
+	zebra->ribq->spec.run_begin = &meta_queue_run_begin;
+	zebra->ribq->spec.run_end = &meta_queue_run_end;
 	/* XXX: TODO: These should be runtime configurable via vty */
 	zebra->ribq->spec.max_retries = 3;
 	zebra->ribq->spec.hold = rib_process_hold_time;
+	zebra->ribq->spec.timeslice = THREAD_YIELD_TIME_SLOT;
 
 	if(!(zebra->mq = meta_queue_new())) {
 		zlog_err("%s: could not initialise meta queue!", __func__);
@@ -1493,6 +2350,11 @@ static void rib_link(struct route_node *rn, struct rib *rib) {
 		route_lock_node(rn); /* rn route table reference */
 		rn->info = dest;
 		dest->rnode = rn;
+		zebra_rnh_changed(rn);
+	}
+
+	if(rib_stale_count && !RIB_SYSTEM_ROUTE(rib)) {
+		rib_claim_stale(rn, rib);
 	}
 
 	head = dest->routes;
@@ -1549,11 +2411,57 @@ static void rib_unlink(struct route_node *rn, struct rib *rib) {
 		dest->routes = rib->next;
 	}
 
+	if(rib->nhg) {
+		zebra_nhg_unlink(rib);
+	}
+	rib_resolve_release(rn, rib);
+	rib_ifdep_release(rn, rib);
+
+	if(CHECK_FLAG(rib->status, RIB_ENTRY_STALE)) {
+		rib_stale_count--;
+		if(!--rib_stale_type_count[rib->type] && rib_sweep_thread[rib->type]) {
+			THREAD_TIMER_OFF(rib_sweep_thread[rib->type]);
+			zlog_notice("Graceful restart complete, all %s routes kept in the kernel were claimed", zebra_route_string(rib->type));
+		}
+	}
+
 	/* free RIB and nexthops */
 	nexthops_free(rib->nexthop);
 	XFREE(MTYPE_RIB, rib);
 }
 
+/* The nexthops of rib were just copied anew from its nexthop group.  Where
+ * the kernel has already moved the installed route along with the group,
+ * only the flags are brought up to date, otherwise the route is processed
+ * again as any other changed route. */
+void rib_nhg_refresh(struct route_node *rn, struct rib *rib, int in_kernel) {
+	struct nexthop *nexthop;
+
+	rib->active_epoch = rib->resolved_epoch = 0;
+
+	if(in_kernel && CHECK_FLAG(rib->status, RIB_ENTRY_SELECTED_FIB) && nexthop_active_update(rn, rib, 1)) {
+		for(nexthop = rib->nexthop; nexthop; nexthop = nexthop->next) {
+			if(CHECK_FLAG(nexthop->flags, NEXTHOP_FLAG_ACTIVE)) {
+				SET_FLAG(nexthop->flags, NEXTHOP_FLAG_FIB);
+			}
+		}
+		UNSET_FLAG(rib->status, RIB_ENTRY_CHANGED);
+		zebra_rnh_changed(rn);
+		if(RIB_RESOLVES_NEXTHOPS(rib)) {
+			rib_nexthop_changed(rn);
+		}
+
+		if(CHECK_FLAG(rib->flags, ZEBRA_FLAG_SELECTED)) {
+			redistribute_add(&rn->p, rib, rib);
+		}
+		zfpm_trigger_update(rn, "nexthop group changed");
+		return;
+	}
+
+	SET_FLAG(rib->status, RIB_ENTRY_CHANGED);
+	rib_queue_add(&zebrad, rn);
+}
+
 static void rib_delnode(struct route_node *rn, struct rib *rib) {
 	if(IS_ZEBRA_DEBUG_RIB) {
 		rnode_debug(rn, "rn %p, rib %p, removing", (void *) rn, (void *) rib);
@@ -1570,7 +2478,7 @@ int rib_add_ipv4(int type, int flags, struct prefix_ipv4 *p, struct in_addr *gat
 	struct nexthop *nexthop;
 
 	/* Lookup table.  */
-	table = zebra_vrf_table(AFI_IP, safi, vrf_id);
+	table = zebra_vrf_table_get(AFI_IP, safi, vrf_id);
 	if(!table) {
 		return 0;
 	}
@@ -1736,7 +2644,7 @@ int rib_add_ipv4_multipath(struct prefix_ipv4 *p, struct rib *rib, safi_t safi)
 	int ret = 0;
 
 	/* Lookup table.  */
-	table = zebra_vrf_table(AFI_IP, safi, rib->vrf_id);
+	table = zebra_vrf_table_get(AFI_IP, safi, rib->vrf_id);
 	if(!table) {
 		return 0;
 	}
@@ -1776,6 +2684,13 @@ int rib_add_ipv4_multipath(struct prefix_ipv4 *p, struct rib *rib, safi_t safi)
 		}
 	}
 
+	if(rib->nhg == NULL) {
+		zebra_nhg_intern(rib, safi);
+	}
+	if(rib->nhg) {
+		zebra_nhg_link(rn, rib);
+	}
+
 	/* Link new rib to node.*/
 	rib_addnode(rn, rib);
 	ret = 1;
@@ -1925,7 +2840,7 @@ static void static_install_route(afi_t afi, safi_t safi, struct prefix *p, struc
 	struct route_table *table;
 
 	/* Lookup table.  */
-	table = zebra_vrf_table(afi, safi, si->vrf_id);
+	table = zebra_vrf_table_get(afi, safi, si->vrf_id);
 	if(!table) {
 		return;
 	}
@@ -2081,7 +2996,7 @@ int static_add_ipv4_safi(safi_t safi, struct prefix *p, struct in_addr *gate, co
 	struct static_route *cp;
 	struct static_route *update = NULL;
 	struct zebra_vrf *zvrf = vrf_info_get(vrf_id);
-	struct route_table *stable = zvrf->stable[AFI_IP][safi];
+	struct route_table *stable = zebra_vrf_static_table_get(zvrf, AFI_IP, safi);
 
 	if(!stable) {
 		return -1;
@@ -2242,7 +3157,7 @@ int rib_add_ipv6(int type, int flags, struct prefix_ipv6 *p, struct in6_addr *ga
 	struct nexthop *nexthop;
 
 	/* Lookup table.  */
-	table = zebra_vrf_table(AFI_IP6, safi, vrf_id);
+	table = zebra_vrf_table_get(AFI_IP6, safi, vrf_id);
 	if(!table) {
 		return 0;
 	}
@@ -2344,7 +3259,7 @@ int rib_add_ipv6_multipath(struct prefix_ipv6 *p, struct rib *rib, safi_t safi)
 	}
 
 	/* Lookup table.  */
-	table = zebra_vrf_table(AFI_IP6, safi, rib->vrf_id);
+	table = zebra_vrf_table_get(AFI_IP6, safi, rib->vrf_id);
 
 	if(!table) {
 		return 0;
@@ -2529,7 +3444,7 @@ int static_add_ipv6(struct prefix *p, u_char type, struct in6_addr *gate, const
 	struct static_route *cp;
 	struct static_route *update = NULL;
 	struct zebra_vrf *zvrf = vrf_info_get(vrf_id);
-	struct route_table *stable = zvrf->stable[AFI_IP6][SAFI_UNICAST];
+	struct route_table *stable = zebra_vrf_static_table_get(zvrf, AFI_IP6, SAFI_UNICAST);
 
 	if(!stable) {
 		return -1;
@@ -2571,192 +3486,791 @@ int static_add_ipv6(struct prefix *p, u_char type, struct in6_addr *gate, const
 	si->flags = flags;
 	si->vrf_id = vrf_id;
 
-	switch(type) {
-		case STATIC_IPV6_GATEWAY: si->addr.ipv6 = *gate; break;
-		case STATIC_IPV6_IFNAME: si->ifname = XSTRDUP(MTYPE_TMP, ifname); break;
-		case STATIC_IPV6_GATEWAY_IFNAME:
-			si->addr.ipv6 = *gate;
-			si->ifname = XSTRDUP(MTYPE_TMP, ifname);
-			break;
+	switch(type) {
+		case STATIC_IPV6_GATEWAY: si->addr.ipv6 = *gate; break;
+		case STATIC_IPV6_IFNAME: si->ifname = XSTRDUP(MTYPE_TMP, ifname); break;
+		case STATIC_IPV6_GATEWAY_IFNAME:
+			si->addr.ipv6 = *gate;
+			si->ifname = XSTRDUP(MTYPE_TMP, ifname);
+			break;
+	}
+
+	/* Add new static route information to the tree with sort by
+     distance value and gateway address. */
+	for(pp = NULL, cp = rn->info; cp; pp = cp, cp = cp->next) {
+		if(si->distance < cp->distance) {
+			break;
+		}
+		if(si->distance > cp->distance) {
+			continue;
+		}
+	}
+
+	/* Make linked list. */
+	if(pp) {
+		pp->next = si;
+	} else {
+		rn->info = si;
+	}
+	if(cp) {
+		cp->prev = si;
+	}
+	si->prev = pp;
+	si->next = cp;
+
+	/* Install into rib. */
+	static_install_route(AFI_IP6, SAFI_UNICAST, p, si);
+
+	return 1;
+}
+
+/* Delete static route from static route configuration. */
+int static_delete_ipv6(struct prefix *p, u_char type, struct in6_addr *gate, const char *ifname, route_tag_t tag, u_char distance, vrf_id_t vrf_id) {
+	struct route_node *rn;
+	struct static_route *si;
+	struct route_table *stable;
+
+	/* Lookup table.  */
+	stable = zebra_vrf_static_table(AFI_IP6, SAFI_UNICAST, vrf_id);
+	if(!stable) {
+		return -1;
+	}
+
+	/* Lookup static route prefix. */
+	rn = route_node_lookup(stable, p);
+	if(!rn) {
+		return 0;
+	}
+
+	/* Find same static route is the tree */
+	for(si = rn->info; si; si = si->next) {
+		if(distance == si->distance && type == si->type && (!gate || IPV6_ADDR_SAME(gate, &si->addr.ipv6)) && (!ifname || strcmp(ifname, si->ifname) == 0) && (!tag || (tag == si->tag))) {
+			break;
+		}
+	}
+
+	/* Can't find static route. */
+	if(!si) {
+		route_unlock_node(rn);
+		return 0;
+	}
+
+	/* Install into rib. */
+	static_uninstall_route(AFI_IP6, SAFI_UNICAST, p, si);
+
+	/* Unlink static route from linked list. */
+	if(si->prev) {
+		si->prev->next = si->next;
+	} else {
+		rn->info = si->next;
+	}
+	if(si->next) {
+		si->next->prev = si->prev;
+	}
+
+	/* Free static route configuration. */
+	if(ifname) {
+		XFREE(0, si->ifname);
+	}
+	XFREE(MTYPE_STATIC_ROUTE, si);
+
+	return 1;
+}
+
+static void rib_update_table(struct route_table *table) {
+	struct route_node *rn;
+
+	if(table) {
+		for(rn = route_top(table); rn; rn = route_next(rn)) {
+			if(rnode_to_ribs(rn)) {
+				rib_queue_add(&zebrad, rn);
+			}
+		}
+	}
+}
+
+static int rib_update_timer(struct thread *thread) {
+	struct zebra_vrf *zvrf = THREAD_ARG(thread);
+
+	zvrf->t_rib_update = NULL;
+
+	rib_update_table(zvrf->table[AFI_IP][SAFI_UNICAST]);
+	rib_update_table(zvrf->table[AFI_IP6][SAFI_UNICAST]);
+
+	return 0;
+}
+
+/*
+ * RIB update function, for changes any route may depend on, such as a
+ * route map taking part in nexthop checks.  Cached resolutions are
+ * dropped at once, but the walk requeueing every route of the VRF is left
+ * to an event, so that a burst of changes costs one walk.  Interface
+ * changes go through rib_update_interface() instead.
+ */
+void rib_update(vrf_id_t vrf_id) {
+	struct zebra_vrf *zvrf = vrf_info_lookup(vrf_id);
+
+	rib_nexthop_epoch_bump();
+
+	if(zvrf && !zvrf->t_rib_update) {
+		zvrf->t_rib_update = thread_add_event(zebrad.master, rib_update_timer, zvrf, 0);
+	}
+}
+
+/*
+ * An interface went up or down, or its addresses changed.  Routes over
+ * gateways are queued as the connected routes change, see
+ * rib_nexthop_changed(), so only those whose nexthops take the
+ * interface's state are queued here, see rib_ifdep.
+ */
+void rib_update_interface(struct interface *ifp) {
+	struct zebra_vrf *zvrf = vrf_info_lookup(ifp->vrf_id);
+	struct rib_ifdep key;
+	unsigned long count;
+
+	rib_nexthop_epoch_bump();
+
+	if(!zvrf) {
+		return;
+	}
+
+	memset(&key, 0, sizeof(key));
+	count = rib_ifdep_invalidate(zvrf, &key);
+	if(ifp->ifindex != IFINDEX_INTERNAL) {
+		key.ifindex = ifp->ifindex;
+		count += rib_ifdep_invalidate(zvrf, &key);
+		key.ifindex = 0;
+	}
+	strncpy(key.ifname, ifp->name, INTERFACE_NAMSIZ);
+	count += rib_ifdep_invalidate(zvrf, &key);
+
+	if(IS_ZEBRA_DEBUG_RIB) {
+		zlog_debug("%s: %s vrf %u, %lu route nodes queued", __func__, ifp->name, ifp->vrf_id, count);
+	}
+}
+
+/* Drop a VRF's pending walk, when it goes away. */
+void rib_update_cancel(struct zebra_vrf *zvrf) {
+	THREAD_OFF(zvrf->t_rib_update);
+}
+
+/* Remove all routes which comes from non main table.  */
+static void rib_weed_table(struct route_table *table) {
+	struct route_node *rn;
+	struct rib *rib;
+	struct rib *next;
+
+	if(table) {
+		for(rn = route_top_info(table); rn; rn = route_next_info(rn)) {
+			RNODE_FOREACH_RIB_SAFE(rn, rib, next) {
+				if(CHECK_FLAG(rib->status, RIB_ENTRY_REMOVED)) {
+					continue;
+				}
+
+				if(rib->table != zebrad.rtm_table_default && rib->table != RT_TABLE_MAIN) {
+					rib_delnode(rn, rib);
+				}
+			}
+		}
+	}
+}
+
+/* Delete all routes from non main table. */
+void rib_weed_tables(void) {
+	vrf_iter_t iter;
+	struct zebra_vrf *zvrf;
+
+	for(iter = vrf_first(); iter != VRF_ITER_INVALID; iter = vrf_next(iter)) {
+		if((zvrf = vrf_iter2info(iter)) != NULL) {
+			rib_weed_table(zvrf->table[AFI_IP][SAFI_UNICAST]);
+			rib_weed_table(zvrf->table[AFI_IP6][SAFI_UNICAST]);
+		}
+	}
+}
+
+#if 0
+/* Delete self installed routes after zebra is relaunched.  */
+static void
+rib_sweep_table (struct route_table *table)
+{
+  struct route_node *rn;
+  struct rib *rib;
+  struct rib *next;
+  int ret = 0;
+
+  if (table)
+    for (rn = route_top (table); rn; rn = route_next (rn))
+      RNODE_FOREACH_RIB_SAFE (rn, rib, next)
+	{
+	  if (CHECK_FLAG (rib->status, RIB_ENTRY_REMOVED))
+	    continue;
+
+	  if (rib->type == ZEBRA_ROUTE_KERNEL &&
+	      CHECK_FLAG (rib->flags, ZEBRA_FLAG_SELFROUTE))
+	    {
+	      ret = rib_update_kernel (rn, rib, NULL);
+	      if (! ret)
+                rib_delnode (rn, rib);
+	    }
+	}
+}
+#endif
+
+/* Sweep all RIB tables.  */
+void rib_sweep_route(void) {
+	vrf_iter_t iter;
+	struct zebra_vrf *zvrf;
+
+	for(iter = vrf_first(); iter != VRF_ITER_INVALID; iter = vrf_next(iter)) {
+		if((zvrf = vrf_iter2info(iter)) != NULL) {
+			rib_weed_table(zvrf->table[AFI_IP][SAFI_UNICAST]);
+			rib_weed_table(zvrf->table[AFI_IP6][SAFI_UNICAST]);
+		}
+	}
+}
+
+/* Mark the routes of 'table' kept for 'type' stale, or sweep those left
+ * stale. */
+static void rib_sweep_stale_table(struct route_table *table, u_char type, int sweep) {
+	struct route_node *rn;
+	struct rib *rib;
+	struct rib *next;
+
+	if(!table) {
+		return;
+	}
+
+	for(rn = route_top_info(table); rn; rn = route_next_info(rn)) {
+		RNODE_FOREACH_RIB_SAFE(rn, rib, next) {
+			if(CHECK_FLAG(rib->status, RIB_ENTRY_REMOVED)) {
+				continue;
+			}
+
+			if(rib->type != type) {
+				continue;
+			}
+			if(sweep) {
+				if(CHECK_FLAG(rib->status, RIB_ENTRY_STALE)) {
+					rib_delnode(rn, rib);
+				}
+			} else if((type != ZEBRA_ROUTE_KERNEL || CHECK_FLAG(rib->flags, ZEBRA_FLAG_SELFROUTE)) && !CHECK_FLAG(rib->status, RIB_ENTRY_STALE)) {
+				SET_FLAG(rib->status, RIB_ENTRY_STALE);
+				rib_stale_count++;
+				rib_stale_type_count[type]++;
+			}
+		}
+	}
+}
+
+static void rib_sweep_stale(u_char type, int sweep) {
+	vrf_iter_t iter;
+	struct zebra_vrf *zvrf;
+
+	for(iter = vrf_first(); iter != VRF_ITER_INVALID; iter = vrf_next(iter)) {
+		if((zvrf = vrf_iter2info(iter)) != NULL) {
+			rib_sweep_stale_table(zvrf->table[AFI_IP][SAFI_UNICAST], type, sweep);
+			rib_sweep_stale_table(zvrf->table[AFI_IP6][SAFI_UNICAST], type, sweep);
+		}
+	}
+}
+
+static int rib_sweep_timer(struct thread *thread) {
+	u_char type;
+
+	for(type = 0; type < ZEBRA_ROUTE_MAX; type++) {
+		if(rib_sweep_thread[type] == thread) {
+			break;
+		}
+	}
+	if(type == ZEBRA_ROUTE_MAX) {
+		return 0;
+	}
+	rib_sweep_thread[type] = NULL;
+
+	zlog_notice("Graceful restart over, removing %lu unclaimed %s routes from the kernel", rib_stale_type_count[type], zebra_route_string(type));
+	rib_sweep_stale(type, 1);
+	return 0;
+}
+
+/* Graceful restart: keep the routes a previous zebra left in the kernel,
+ * read by route_read(), for its clients to announce them again within
+ * 'secs' seconds.  A route announced as it is in the kernel isn't
+ * written again, those not announced are removed once the time is up. */
+void rib_sweep_start(u_int32_t secs) {
+	rib_sweep_stale(ZEBRA_ROUTE_KERNEL, 0);
+	if(!rib_stale_type_count[ZEBRA_ROUTE_KERNEL]) {
+		return;
+	}
+
+	zlog_notice("Graceful restart, keeping %lu routes in the kernel for %u seconds", rib_stale_type_count[ZEBRA_ROUTE_KERNEL], secs);
+	rib_sweep_thread[ZEBRA_ROUTE_KERNEL] = thread_add_timer(zebrad.master, rib_sweep_timer, NULL, secs);
+}
+
+/* Graceful restart of a client: its routes of 'type' stay, marked stale,
+ * for its next instance to announce them again within 'secs' seconds,
+ * as those of a previous zebra do.  Returns the number kept. */
+unsigned long rib_stale_proto(u_char type, u_int32_t secs) {
+	rib_sweep_stale(type, 0);
+	if(!rib_stale_type_count[type]) {
+		return 0;
+	}
+
+	if(rib_sweep_thread[type]) {
+		thread_cancel(rib_sweep_thread[type]);
+	}
+	rib_sweep_thread[type] = thread_add_timer(zebrad.master, rib_sweep_timer, NULL, secs);
+	return rib_stale_type_count[type];
+}
+
+/* The client restarting is done: the routes of 'type' it didn't announce
+ * again go now.  Returns the number removed. */
+unsigned long rib_sweep_proto(u_char type) {
+	unsigned long n = rib_stale_type_count[type];
+
+	if(rib_sweep_thread[type]) {
+		THREAD_TIMER_OFF(rib_sweep_thread[type]);
+	}
+	if(n) {
+		rib_sweep_stale(type, 1);
+	}
+	return n;
+}
+
+/*
+ * RIB and FIB audit.  A pass dumps the kernel's routes of each family,
+ * comparing each with the RIB, then walks the RIB for the routes the dump
+ * had not; each slice of it looks at the routes of rib_audit_rate per
+ * second.  Routes changing meanwhile make for mismatches that are none,
+ * so a mismatch is only repaired by the pass after, finding it again,
+ * which starts at once.  Nodes with work queued, here or with the
+ * dataplane, are left for the next pass.
+ */
+u_int32_t rib_audit_interval;
+u_int32_t rib_audit_rate = RIB_AUDIT_RATE_DEFAULT;
+
+#define RIB_AUDIT_SLICE_MSEC 100
+
+/* Prefixes of the dump, by origin */
+#define RIB_AUDIT_SEEN_SELF 1
+#define RIB_AUDIT_SEEN_OTHER 2
+
+static const char *rib_audit_desc[RIB_AUDIT_MAX] = {
+	"zebra routes stale in the kernel", "routes with other nexthops in the kernel", "routes missing from the kernel", "kernel routes missing from the RIB", "kernel routes stale in the RIB",
+};
+
+static int rib_audit_timer(struct thread *);
+
+static void rib_audit_schedule(struct zebra_vrf *zvrf, long msec) {
+	THREAD_OFF(zvrf->audit.t_audit);
+	zvrf->audit.t_audit = thread_add_timer_msec(zebrad.master, rib_audit_timer, zvrf, msec);
+}
+
+/* Add bits to those of p in *table, made if need be. */
+static void rib_audit_mark(struct route_table **table, struct prefix *p, uintptr_t bits) {
+	struct route_node *rn;
+
+	if(!*table) {
+		*table = route_table_init();
+	}
+	rn = route_node_get(*table, p);
+	if(rn->info) {
+		route_unlock_node(rn);
+	}
+	rn->info = (void *) ((uintptr_t) rn->info | bits);
+}
+
+static uintptr_t rib_audit_bits(struct route_table *table, struct prefix *p) {
+	struct route_node *rn;
+	uintptr_t bits;
+
+	if(!table || (rn = route_node_lookup(table, p)) == NULL) {
+		return 0;
+	}
+	bits = (uintptr_t) rn->info;
+	route_unlock_node(rn);
+	return bits;
+}
+
+static void rib_audit_table_free(struct route_table **table) {
+	if(*table) {
+		route_table_finish(*table);
+		*table = NULL;
+	}
+}
+
+/* A mismatch at p: returns TRUE, for it to be repaired, if the pass
+ * before found it too, otherwise it's noted for the next pass. */
+static int rib_audit_mismatch(struct zebra_vrf *zvrf, struct prefix *p, int kind) {
+	struct rib_audit *audit = &zvrf->audit;
+	afi_t afi = family2afi(p->family);
+	char buf[PREFIX_STRLEN];
+
+	if(rib_audit_bits(audit->suspect[afi], p) & (1 << kind)) {
+		audit->repaired[kind]++;
+		zlog_warn("FIB audit, vrf %u: repairing %s, one of the %s", zvrf->vrf_id, prefix2str(p, buf, sizeof(buf)), rib_audit_desc[kind]);
+		return 1;
 	}
 
-	/* Add new static route information to the tree with sort by
-     distance value and gateway address. */
-	for(pp = NULL, cp = rn->info; cp; pp = cp, cp = cp->next) {
-		if(si->distance < cp->distance) {
-			break;
-		}
-		if(si->distance > cp->distance) {
-			continue;
-		}
+	if(IS_ZEBRA_DEBUG_RIB) {
+		zlog_debug("FIB audit, vrf %u: %s is one of the %s, if so again next pass", zvrf->vrf_id, prefix2str(p, buf, sizeof(buf)), rib_audit_desc[kind]);
 	}
+	audit->mismatches[kind]++;
+	rib_audit_mark(&audit->found[afi], p, 1 << kind);
+	return 0;
+}
 
-	/* Make linked list. */
-	if(pp) {
-		pp->next = si;
-	} else {
-		rn->info = si;
+/* Work queued for rn, here or with the dataplane, is to change it yet. */
+static int rib_audit_busy(struct route_node *rn) {
+	rib_dest_t *dest = rib_dest_from_rnode(rn);
+	struct rib *rib;
+	u_char qindex;
+
+	for(qindex = 0; qindex < MQ_SIZE; qindex++) {
+		if(CHECK_FLAG(dest->flags, RIB_ROUTE_QUEUED(qindex))) {
+			return 1;
+		}
 	}
-	if(cp) {
-		cp->prev = si;
+	RNODE_FOREACH_RIB(rn, rib) {
+		if(CHECK_FLAG(rib->status, RIB_ENTRY_QUEUED)) {
+			return 1;
+		}
 	}
-	si->prev = pp;
-	si->next = cp;
+	return 0;
+}
 
-	/* Install into rib. */
-	static_install_route(AFI_IP6, SAFI_UNICAST, p, si);
+/* The kernel tables zebra's routes go to */
+static int rib_audit_table(int table) {
+	return table == 0 || table == RT_TABLE_MAIN || table == zebrad.rtm_table_default;
+}
 
-	return 1;
+/* Returns TRUE if the kernel route, on nexthop object nh_id if any, is
+ * the one installing rib would leave. */
+static int rib_audit_route_same(struct route_node *rn, struct rib *kernel, struct rib *rib, u_int32_t nh_id) {
+	if(rib->nhg && rib->nhg->kernel_id && !(rib->flags & (ZEBRA_FLAG_BLACKHOLE | ZEBRA_FLAG_REJECT))) {
+		return nh_id == rib->nhg->kernel_id;
+	}
+	return !nh_id && rib_kernel_route_same(rn, kernel, rib);
 }
 
-/* Delete static route from static route configuration. */
-int static_delete_ipv6(struct prefix *p, u_char type, struct in6_addr *gate, const char *ifname, route_tag_t tag, u_char distance, vrf_id_t vrf_id) {
+/* A route of the kernel's dump, read as kernel: a self route, on nexthop
+ * object nh_id if any, is to be the one of the RIB's FIB route, any other
+ * a kernel route of the RIB.  Repairs what the RIB has to, and returns
+ * what is to be done with the kernel's route, see RIB_AUDIT_KEEP. */
+int rib_audit_kernel_route(struct zebra_vrf *zvrf, struct prefix *p, struct rib *kernel, u_int32_t nh_id) {
+	struct rib_audit *audit = &zvrf->audit;
+	struct route_table *table;
 	struct route_node *rn;
-	struct static_route *si;
-	struct route_table *stable;
+	struct rib *rib, *fib = NULL, *imported = NULL, *stale = NULL;
+	afi_t afi = family2afi(p->family);
+	int self = CHECK_FLAG(kernel->flags, ZEBRA_FLAG_SELFROUTE);
+	int ret = RIB_AUDIT_KEEP;
 
-	/* Lookup table.  */
-	stable = zebra_vrf_static_table(AFI_IP6, SAFI_UNICAST, vrf_id);
-	if(!stable) {
-		return -1;
+	if(audit->state != RIB_AUDIT_S_DUMP) {
+		return RIB_AUDIT_KEEP;
 	}
+	rib_audit_mark(&audit->seen[afi], p, self ? RIB_AUDIT_SEEN_SELF : RIB_AUDIT_SEEN_OTHER);
 
-	/* Lookup static route prefix. */
-	rn = route_node_lookup(stable, p);
-	if(!rn) {
-		return 0;
+	rn = NULL;
+	if((table = zvrf->table[afi][SAFI_UNICAST]) != NULL) {
+		rn = route_node_lookup(table, p);
+	}
+	if(rn) {
+		if(rib_audit_busy(rn)) {
+			route_unlock_node(rn);
+			return RIB_AUDIT_KEEP;
+		}
+		RNODE_FOREACH_RIB(rn, rib) {
+			if(CHECK_FLAG(rib->status, RIB_ENTRY_REMOVED)) {
+				continue;
+			}
+			if(CHECK_FLAG(rib->status, RIB_ENTRY_STALE)) {
+				stale = rib;
+			} else if(CHECK_FLAG(rib->status, RIB_ENTRY_SELECTED_FIB) && !RIB_SYSTEM_ROUTE(rib)) {
+				fib = rib;
+			} else if(rib->type == ZEBRA_ROUTE_KERNEL && !CHECK_FLAG(rib->flags, ZEBRA_FLAG_SELFROUTE)) {
+				imported = rib;
+			}
+		}
 	}
 
-	/* Find same static route is the tree */
-	for(si = rn->info; si; si = si->next) {
-		if(distance == si->distance && type == si->type && (!gate || IPV6_ADDR_SAME(gate, &si->addr.ipv6)) && (!ifname || strcmp(ifname, si->ifname) == 0) && (!tag || (tag == si->tag))) {
-			break;
+	if(self) {
+		/* left by the previous zebra, see rib_sweep_start */
+		if(stale) {
+			;
+		} else if(!fib) {
+			if(rib_audit_mismatch(zvrf, p, RIB_AUDIT_KERNEL_STALE)) {
+				ret = RIB_AUDIT_DELETE;
+			}
+		} else if(!rib_audit_route_same(rn, kernel, fib, nh_id)) {
+			if(rib_audit_mismatch(zvrf, p, RIB_AUDIT_KERNEL_DIFF)) {
+				rib_update_kernel(rn, NULL, fib);
+			}
+		}
+	} else if(!imported && !(kernel->flags & (ZEBRA_FLAG_BLACKHOLE | ZEBRA_FLAG_REJECT))) {
+		if(rib_audit_mismatch(zvrf, p, RIB_AUDIT_RIB_MISSING)) {
+			ret = RIB_AUDIT_IMPORT;
 		}
 	}
 
-	/* Can't find static route. */
-	if(!si) {
+	if(rn) {
 		route_unlock_node(rn);
-		return 0;
 	}
+	return ret;
+}
 
-	/* Install into rib. */
-	static_uninstall_route(AFI_IP6, SAFI_UNICAST, p, si);
+/* The RIB's routes at rn the dump had not */
+static void rib_audit_node(struct zebra_vrf *zvrf, struct route_node *rn) {
+	struct rib_audit *audit = &zvrf->audit;
+	struct rib *rib, *next;
+	struct nexthop *nexthop, *tnexthop;
+	int recursing, installed;
+	uintptr_t seen;
 
-	/* Unlink static route from linked list. */
-	if(si->prev) {
-		si->prev->next = si->next;
-	} else {
-		rn->info = si->next;
-	}
-	if(si->next) {
-		si->next->prev = si->prev;
+	if(!rnode_to_ribs(rn) || rib_audit_busy(rn)) {
+		return;
 	}
+	seen = rib_audit_bits(audit->seen[audit->afi], &rn->p);
 
-	/* Free static route configuration. */
-	if(ifname) {
-		XFREE(0, si->ifname);
+	RNODE_FOREACH_RIB_SAFE(rn, rib, next) {
+		if(CHECK_FLAG(rib->status, RIB_ENTRY_REMOVED) || rib->uptime >= audit->start || !rib_audit_table(rib->table)) {
+			continue;
+		}
+
+		if(CHECK_FLAG(rib->status, RIB_ENTRY_SELECTED_FIB) && !RIB_SYSTEM_ROUTE(rib)) {
+			if(seen & RIB_AUDIT_SEEN_SELF) {
+				continue;
+			}
+			/* a route the kernel had refused is no mismatch */
+			installed = 0;
+			for(ALL_NEXTHOPS_RO(rib->nexthop, nexthop, tnexthop, recursing)) {
+				if(CHECK_FLAG(nexthop->flags, NEXTHOP_FLAG_FIB)) {
+					installed = 1;
+					break;
+				}
+			}
+			if(installed && rib_audit_mismatch(zvrf, &rn->p, RIB_AUDIT_KERNEL_MISSING)) {
+				rib_update_kernel(rn, NULL, rib);
+			}
+		} else if(rib->type == ZEBRA_ROUTE_KERNEL && !CHECK_FLAG(rib->flags, ZEBRA_FLAG_SELFROUTE)) {
+			if(!(seen & RIB_AUDIT_SEEN_OTHER) && rib_audit_mismatch(zvrf, &rn->p, RIB_AUDIT_RIB_STALE)) {
+				rib_delnode(rn, rib);
+			}
+		}
 	}
-	XFREE(MTYPE_STATIC_ROUTE, si);
+}
 
-	return 1;
+static struct route_node *rib_audit_walk_top(struct zebra_vrf *zvrf, afi_t afi) {
+	struct route_table *table = zvrf->table[afi][SAFI_UNICAST];
+
+	return table ? route_top(table) : NULL;
 }
 
-/* RIB update function. */
-void rib_update(vrf_id_t vrf_id) {
-	struct route_node *rn;
-	struct route_table *table;
+/* Leave the pass at that, mismatches noted or not */
+static void rib_audit_clear(struct zebra_vrf *zvrf) {
+	struct rib_audit *audit = &zvrf->audit;
+	afi_t afi;
 
-	table = zebra_vrf_table(AFI_IP, SAFI_UNICAST, vrf_id);
-	if(table) {
-		for(rn = route_top(table); rn; rn = route_next(rn)) {
-			if(rnode_to_ribs(rn)) {
-				rib_queue_add(&zebrad, rn);
-			}
-		}
+	kernel_audit_stop(zvrf);
+	if(audit->walk) {
+		route_unlock_node(audit->walk);
+		audit->walk = NULL;
+	}
+	for(afi = AFI_IP; afi < AFI_MAX; afi++) {
+		rib_audit_table_free(&audit->seen[afi]);
+		rib_audit_table_free(&audit->found[afi]);
 	}
+	audit->state = RIB_AUDIT_S_IDLE;
+}
 
-	table = zebra_vrf_table(AFI_IP6, SAFI_UNICAST, vrf_id);
-	if(table) {
-		for(rn = route_top(table); rn; rn = route_next(rn)) {
-			if(rnode_to_ribs(rn)) {
-				rib_queue_add(&zebrad, rn);
-			}
+/* Wrap up a pass: the one after starts at once, if there are mismatches
+ * to confirm, or overruns came meanwhile. */
+static void rib_audit_end(struct zebra_vrf *zvrf, int failed) {
+	struct rib_audit *audit = &zvrf->audit;
+	int confirm = 0;
+	afi_t afi;
+
+	if(!failed) {
+		for(afi = AFI_IP; afi < AFI_MAX; afi++) {
+			rib_audit_table_free(&audit->suspect[afi]);
+			audit->suspect[afi] = audit->found[afi];
+			audit->found[afi] = NULL;
+			confirm |= audit->suspect[afi] != NULL;
+		}
+		audit->passes++;
+		audit->last = time(NULL);
+		audit->last_duration = audit->last - audit->start;
+		if(audit->intr) {
+			audit->again = 1;
 		}
 	}
+	rib_audit_clear(zvrf);
+
+	if(confirm || (audit->again && !failed)) {
+		audit->again = 0;
+		rib_audit_schedule(zvrf, RIB_AUDIT_SLICE_MSEC);
+	} else if(rib_audit_interval) {
+		rib_audit_schedule(zvrf, rib_audit_interval * 1000L);
+	}
 }
 
-/* Remove all routes which comes from non main table.  */
-static void rib_weed_table(struct route_table *table) {
-	struct route_node *rn;
-	struct rib *rib;
-	struct rib *next;
+/* A slice of the pass, the first starting it */
+static int rib_audit_timer(struct thread *thread) {
+	struct zebra_vrf *zvrf = THREAD_ARG(thread);
+	struct rib_audit *audit = &zvrf->audit;
+	int budget, ret;
 
-	if(table) {
-		for(rn = route_top(table); rn; rn = route_next(rn)) {
-			RNODE_FOREACH_RIB_SAFE(rn, rib, next) {
-				if(CHECK_FLAG(rib->status, RIB_ENTRY_REMOVED)) {
-					continue;
+	audit->t_audit = NULL;
+
+	budget = rib_audit_rate * RIB_AUDIT_SLICE_MSEC / 1000;
+	if(budget == 0) {
+		budget = 1;
+	}
+
+	switch(audit->state) {
+		case RIB_AUDIT_S_IDLE:
+			audit->start = time(NULL);
+			audit->intr = 0;
+			audit->afi = AFI_IP;
+			audit->state = RIB_AUDIT_S_DUMP;
+			if(kernel_audit_start(zvrf, AFI_IP) < 0) {
+				rib_audit_end(zvrf, 1);
+				return 0;
+			}
+			break;
+
+		case RIB_AUDIT_S_DUMP:
+			ret = kernel_audit_read(zvrf, budget);
+			if(ret < 0) {
+				rib_audit_end(zvrf, 1);
+				return 0;
+			}
+			if(ret == 0) {
+				break;
+			}
+#ifdef HAVE_IPV6
+			if(audit->afi == AFI_IP) {
+				audit->afi = AFI_IP6;
+				if(kernel_audit_start(zvrf, AFI_IP6) < 0) {
+					rib_audit_end(zvrf, 1);
+					return 0;
 				}
+				break;
+			}
+#endif /* HAVE_IPV6 */
+			/* what the dump had not is for the next pass to tell */
+			if(audit->intr) {
+				rib_audit_end(zvrf, 0);
+				return 0;
+			}
+			audit->state = RIB_AUDIT_S_WALK;
+			audit->afi = AFI_IP;
+			audit->walk = rib_audit_walk_top(zvrf, AFI_IP);
+			break;
 
-				if(rib->table != zebrad.rtm_table_default && rib->table != RT_TABLE_MAIN) {
-					rib_delnode(rn, rib);
+		case RIB_AUDIT_S_WALK:
+			while(budget-- > 0) {
+				if(!audit->walk) {
+#ifdef HAVE_IPV6
+					if(audit->afi == AFI_IP) {
+						audit->afi = AFI_IP6;
+						audit->walk = rib_audit_walk_top(zvrf, AFI_IP6);
+						continue;
+					}
+#endif /* HAVE_IPV6 */
+					rib_audit_end(zvrf, 0);
+					return 0;
 				}
+				rib_audit_node(zvrf, audit->walk);
+				audit->walk = route_next(audit->walk);
 			}
-		}
+			break;
 	}
+
+	rib_audit_schedule(zvrf, RIB_AUDIT_SLICE_MSEC);
+	return 0;
 }
 
-/* Delete all routes from non main table. */
-void rib_weed_tables(void) {
-	vrf_iter_t iter;
-	struct zebra_vrf *zvrf;
+/* Start a pass now, or once the one at hand is over. */
+void rib_audit_start(struct zebra_vrf *zvrf) {
+	struct rib_audit *audit = &zvrf->audit;
 
-	for(iter = vrf_first(); iter != VRF_ITER_INVALID; iter = vrf_next(iter)) {
-		if((zvrf = vrf_iter2info(iter)) != NULL) {
-			rib_weed_table(zvrf->table[AFI_IP][SAFI_UNICAST]);
-			rib_weed_table(zvrf->table[AFI_IP6][SAFI_UNICAST]);
-		}
+	if(!audit->enabled) {
+		return;
+	}
+	if(audit->state != RIB_AUDIT_S_IDLE) {
+		audit->again = 1;
+		return;
 	}
+	rib_audit_schedule(zvrf, 0);
 }
 
-#if 0
-/* Delete self installed routes after zebra is relaunched.  */
-static void
-rib_sweep_table (struct route_table *table)
-{
-  struct route_node *rn;
-  struct rib *rib;
-  struct rib *next;
-  int ret = 0;
+/* The RIB missed what the kernel told, it's audited at once. */
+void rib_audit_overrun(struct zebra_vrf *zvrf) {
+	zvrf->audit.overruns++;
+	rib_audit_start(zvrf);
+}
 
-  if (table)
-    for (rn = route_top (table); rn; rn = route_next (rn))
-      RNODE_FOREACH_RIB_SAFE (rn, rib, next)
-	{
-	  if (CHECK_FLAG (rib->status, RIB_ENTRY_REMOVED))
-	    continue;
+void rib_audit_enable(struct zebra_vrf *zvrf) {
+	zvrf->audit.enabled = 1;
+	if(rib_audit_interval) {
+		rib_audit_schedule(zvrf, rib_audit_interval * 1000L);
+	}
+}
 
-	  if (rib->type == ZEBRA_ROUTE_KERNEL &&
-	      CHECK_FLAG (rib->flags, ZEBRA_FLAG_SELFROUTE))
-	    {
-	      ret = rib_update_kernel (rn, rib, NULL);
-	      if (! ret)
-                rib_delnode (rn, rib);
-	    }
+void rib_audit_disable(struct zebra_vrf *zvrf) {
+	struct rib_audit *audit = &zvrf->audit;
+	afi_t afi;
+
+	THREAD_OFF(audit->t_audit);
+	rib_audit_clear(zvrf);
+	for(afi = AFI_IP; afi < AFI_MAX; afi++) {
+		rib_audit_table_free(&audit->suspect[afi]);
 	}
+	audit->enabled = 0;
+	audit->again = 0;
 }
-#endif
 
-/* Sweep all RIB tables.  */
-void rib_sweep_route(void) {
+/* rib_audit_interval changed: the passes to come follow it. */
+void rib_audit_reschedule(void) {
+	struct zebra_vrf *zvrf;
 	vrf_iter_t iter;
+
+	for(iter = vrf_first(); iter != VRF_ITER_INVALID; iter = vrf_next(iter)) {
+		if((zvrf = vrf_iter2info(iter)) == NULL || !zvrf->audit.enabled || zvrf->audit.state != RIB_AUDIT_S_IDLE) {
+			continue;
+		}
+		THREAD_OFF(zvrf->audit.t_audit);
+		if(rib_audit_interval) {
+			rib_audit_schedule(zvrf, rib_audit_interval * 1000L);
+		}
+	}
+}
+
+void rib_audit_show(struct vty *vty) {
 	struct zebra_vrf *zvrf;
+	struct rib_audit *audit;
+	vrf_iter_t iter;
+	int kind;
+
+	if(rib_audit_interval) {
+		vty_out(vty, "FIB audit every %u seconds, and after netlink overruns, %u routes a second%s", rib_audit_interval, rib_audit_rate, VTY_NEWLINE);
+	} else {
+		vty_out(vty, "FIB audit after netlink overruns, %u routes a second%s", rib_audit_rate, VTY_NEWLINE);
+	}
 
 	for(iter = vrf_first(); iter != VRF_ITER_INVALID; iter = vrf_next(iter)) {
-		if((zvrf = vrf_iter2info(iter)) != NULL) {
-			rib_weed_table(zvrf->table[AFI_IP][SAFI_UNICAST]);
-			rib_weed_table(zvrf->table[AFI_IP6][SAFI_UNICAST]);
+		if((zvrf = vrf_iter2info(iter)) == NULL || !zvrf->audit.enabled) {
+			continue;
+		}
+		audit = &zvrf->audit;
+
+		vty_out(vty, "%sVRF %u: %s, %lu passes, %lu overruns%s", VTY_NEWLINE, zvrf->vrf_id, audit->state == RIB_AUDIT_S_IDLE ? "idle" : audit->state == RIB_AUDIT_S_DUMP ? "reading the kernel" : "walking the RIB", audit->passes, audit->overruns, VTY_NEWLINE);
+		if(audit->passes) {
+			vty_out(vty, "  last pass %lds ago, in %lds%s", (long) (time(NULL) - audit->last), (long) audit->last_duration, VTY_NEWLINE);
+		}
+		vty_out(vty, "  %-42s %10s %10s%s", "Mismatches", "Found", "Repaired", VTY_NEWLINE);
+		for(kind = 0; kind < RIB_AUDIT_MAX; kind++) {
+			vty_out(vty, "  %-42s %10lu %10lu%s", rib_audit_desc[kind], audit->mismatches[kind], audit->repaired[kind], VTY_NEWLINE);
 		}
 	}
 }
@@ -2980,14 +4494,17 @@ struct zebra_vrf *zebra_vrf_alloc(vrf_id_t vrf_id) {
 	zebra_vrf_table_create(zvrf, AFI_IP6, SAFI_UNICAST);
 	zvrf->stable[AFI_IP][SAFI_UNICAST] = route_table_init();
 	zvrf->stable[AFI_IP6][SAFI_UNICAST] = route_table_init();
-	zebra_vrf_table_create(zvrf, AFI_IP, SAFI_MULTICAST);
-	zebra_vrf_table_create(zvrf, AFI_IP6, SAFI_MULTICAST);
-	zvrf->stable[AFI_IP][SAFI_MULTICAST] = route_table_init();
-	zvrf->stable[AFI_IP6][SAFI_MULTICAST] = route_table_init();
+
+	/* The multicast tables only come with their first route, see
+	 * zebra_vrf_table_get. */
 
 	zvrf->rnh_table[AFI_IP] = route_table_init();
 	zvrf->rnh_table[AFI_IP6] = route_table_init();
 
+	zvrf->resolve_table[AFI_IP] = route_table_init();
+	zvrf->resolve_table[AFI_IP6] = route_table_init();
+	zvrf->ifdeps = hash_create(rib_ifdep_key, rib_ifdep_cmp);
+
 	/* Set VRF ID */
 	zvrf->vrf_id = vrf_id;
 
@@ -3000,6 +4517,14 @@ struct zebra_vrf *zebra_vrf_alloc(vrf_id_t vrf_id) {
 	snprintf(nl_name, 64, "netlink-cmd (vrf %u)", vrf_id);
 	zvrf->netlink_cmd.sock = -1;
 	zvrf->netlink_cmd.name = XSTRDUP(MTYPE_NETLINK_NAME, nl_name);
+
+	snprintf(nl_name, 64, "netlink-dplane (vrf %u)", vrf_id);
+	zvrf->netlink_dplane.sock = -1;
+	zvrf->netlink_dplane.name = XSTRDUP(MTYPE_NETLINK_NAME, nl_name);
+
+	snprintf(nl_name, 64, "netlink-audit (vrf %u)", vrf_id);
+	zvrf->netlink_audit.sock = -1;
+	zvrf->netlink_audit.name = XSTRDUP(MTYPE_NETLINK_NAME, nl_name);
 #endif
 
 	return zvrf;
@@ -3020,6 +4545,38 @@ struct route_table *zebra_vrf_table(afi_t afi, safi_t safi, vrf_id_t vrf_id) {
 	return zvrf->table[afi][safi];
 }
 
+/* As zebra_vrf_table, creating a table not in use yet for a route. */
+struct route_table *zebra_vrf_table_get(afi_t afi, safi_t safi, vrf_id_t vrf_id) {
+	struct zebra_vrf *zvrf = vrf_info_lookup(vrf_id);
+
+	if(!zvrf) {
+		return NULL;
+	}
+
+	if(afi >= AFI_MAX || safi >= SAFI_MAX) {
+		return NULL;
+	}
+
+	if(!zvrf->table[afi][safi] && (afi == AFI_IP || afi == AFI_IP6) && (safi == SAFI_UNICAST || safi == SAFI_MULTICAST)) {
+		zebra_vrf_table_create(zvrf, afi, safi);
+	}
+
+	return zvrf->table[afi][safi];
+}
+
+/* The static route configuration of a VRF, created with its first route. */
+struct route_table *zebra_vrf_static_table_get(struct zebra_vrf *zvrf, afi_t afi, safi_t safi) {
+	if(afi >= AFI_MAX || safi >= SAFI_MAX) {
+		return NULL;
+	}
+
+	if(!zvrf->stable[afi][safi] && (afi == AFI_IP || afi == AFI_IP6) && (safi == SAFI_UNICAST || safi == SAFI_MULTICAST)) {
+		zvrf->stable[afi][safi] = route_table_init();
+	}
+
+	return zvrf->stable[afi][safi];
+}
+
 /* Lookup the static routing table in a VRF. */
 struct route_table *zebra_vrf_static_table(afi_t afi, safi_t safi, vrf_id_t vrf_id) {
 	struct zebra_vrf *zvrf = vrf_info_lookup(vrf_id);
@@ -59,6 +59,15 @@ static int compare_state(struct rib *r1, struct rib *r2);
 static int send_client(struct rnh *rnh, struct zserv *client, vrf_id_t vrf_id);
 static void print_rnh(struct route_node *rn, struct vty *vty);
 
+extern struct zebra_t zebrad;
+
+u_int32_t zebra_rnh_delay;
+
+/* The nexthops a route change may have changed, to be evaluated once the
+ * RIB is processed, or the delay after */
+static struct list *rnh_pending;
+static struct thread *rnh_t_evaluate;
+
 char *rnh_str(struct rnh *rnh, char *buf, int size) {
 	prefix2str(&(rnh->node->p), buf, size);
 	return buf;
@@ -92,6 +101,7 @@ struct rnh *zebra_add_rnh(struct prefix *p, vrf_id_t vrfid) {
 		route_lock_node(rn);
 		rn->info = rnh;
 		rnh->node = rn;
+		rnh->vrf_id = vrfid;
 	}
 
 	route_unlock_node(rn);
@@ -132,6 +142,9 @@ void zebra_delete_rnh(struct rnh *rnh) {
 		zlog_debug("delete rnh %s", rnh_str(rnh, buf, INET6_ADDRSTRLEN));
 	}
 
+	if(CHECK_FLAG(rnh->flags, ZEBRA_NHT_PENDING)) {
+		listnode_delete(rnh_pending, rnh);
+	}
 	list_free(rnh->client_list);
 	free_state(rnh->state);
 	XFREE(MTYPE_RNH, rn->info);
@@ -140,11 +153,104 @@ void zebra_delete_rnh(struct rnh *rnh) {
 	return;
 }
 
+/* Look up the route the nexthop resolves through, returns 1 if what it
+ * resolves to changed */
+static int zebra_rnh_evaluate(struct rnh *rnh) {
+	struct route_table *ptable;
+	struct route_node *nrn = rnh->node;
+	struct route_node *prn;
+	struct rib *rib;
+
+	SET_FLAG(rnh->flags, ZEBRA_NHT_EVALUATED);
+	ptable = zebra_vrf_table(family2afi(nrn->p.family), SAFI_UNICAST, rnh->vrf_id);
+	if(!ptable) {
+		zlog_debug("evaluate_rnh: prefix table not found\n");
+		return 0;
+	}
+
+	prn = route_node_match(ptable, &nrn->p);
+	if(!prn) {
+		rib = NULL;
+	} else {
+		RNODE_FOREACH_RIB(prn, rib) {
+			if(CHECK_FLAG(rib->status, RIB_ENTRY_REMOVED)) {
+				continue;
+			}
+			if(!CHECK_FLAG(rib->status, RIB_ENTRY_SELECTED_FIB)) {
+				continue;
+			}
+
+			if(CHECK_FLAG(rnh->flags, ZEBRA_NHT_CONNECTED)) {
+				if(rib->type == ZEBRA_ROUTE_CONNECT) {
+					break;
+				}
+
+				if(rib->type == ZEBRA_ROUTE_NHRP) {
+					struct nexthop *nexthop;
+					for(nexthop = rib->nexthop; nexthop; nexthop = nexthop->next) {
+						if(nexthop->type == NEXTHOP_TYPE_IFINDEX || nexthop->type == NEXTHOP_TYPE_IFNAME) {
+							break;
+						}
+					}
+					if(nexthop) {
+						break;
+					}
+				}
+			} else {
+				break;
+			}
+		}
+	}
+	rnh->resolved_len = prn ? prn->p.prefixlen : 0;
+
+	if(!compare_state(rib, rnh->state)) {
+		if(prn) {
+			route_unlock_node(prn);
+		}
+		return 0;
+	}
+
+	if(IS_ZEBRA_DEBUG_NHT) {
+		char bufn[INET6_ADDRSTRLEN];
+		char bufp[INET6_ADDRSTRLEN];
+		prefix2str(&nrn->p, bufn, INET6_ADDRSTRLEN);
+		if(prn) {
+			prefix2str(&prn->p, bufp, INET6_ADDRSTRLEN);
+		} else {
+			strcpy(bufp, "null");
+		}
+		zlog_debug(
+			"rnh %s resolved through route %s - sending "
+			"nexthop %s event to clients",
+			bufn, bufp, rib ? "reachable" : "unreachable"
+		);
+	}
+	copy_state(rnh, rib);
+	if(prn) {
+		route_unlock_node(prn);
+	}
+	return 1;
+}
+
+static void zebra_rnh_notify(struct rnh *rnh) {
+	struct listnode *node;
+	struct zserv *client;
+
+	for(ALL_LIST_ELEMENTS_RO(rnh->client_list, node, client)) {
+		send_client(rnh, client, rnh->vrf_id);
+	}
+}
+
 void zebra_add_rnh_client(struct rnh *rnh, struct zserv *client, vrf_id_t vrf_id) {
 	if(IS_ZEBRA_DEBUG_NHT) {
 		char buf[INET6_ADDRSTRLEN];
 		zlog_debug("client %s registers rnh %s", zebra_route_string(client->proto), rnh_str(rnh, buf, INET6_ADDRSTRLEN));
 	}
+	/* A nexthop new, or tracked differently now, is looked up at once, so
+	 * that the client is told what it resolves to in the first place. */
+	if(!CHECK_FLAG(rnh->flags, ZEBRA_NHT_EVALUATED) && zebra_rnh_evaluate(rnh)) {
+		zebra_rnh_notify(rnh);
+	}
 	if(!listnode_lookup(rnh->client_list, client)) {
 		listnode_add(rnh->client_list, client);
 		send_client(rnh, client, vrf_id);
@@ -162,91 +268,72 @@ void zebra_remove_rnh_client(struct rnh *rnh, struct zserv *client) {
 	}
 }
 
-int zebra_evaluate_rnh_table(vrf_id_t vrfid, int family) {
-	struct route_table *ptable;
+/* The routes at rn changed in or out of the FIB: the nexthops covered by
+ * its prefix, that resolved through it or a shorter prefix, are to be
+ * evaluated again.  Those that resolved through a longer prefix are
+ * left alone. */
+void zebra_rnh_changed(struct route_node *rn) {
+	rib_table_info_t *info = rn->table->info;
 	struct route_table *ntable;
-	struct route_node *prn;
-	struct route_node *nrn;
+	struct route_node *start, *nrn;
 	struct rnh *rnh;
-	struct zserv *client;
-	struct listnode *node;
-	struct rib *rib;
 
-	ntable = lookup_rnh_table(vrfid, family);
-	if(!ntable) {
-		zlog_debug("evaluate_rnh_table: rnh table not found\n");
-		return -1;
+	if(info->safi != SAFI_UNICAST) {
+		return;
 	}
-
-	ptable = zebra_vrf_table(family2afi(family), SAFI_UNICAST, vrfid);
-	if(!ptable) {
-		zlog_debug("evaluate_rnh_table: prefix table not found\n");
-		return -1;
+	ntable = info->zvrf->rnh_table[info->afi];
+	if(!ntable || !ntable->top) {
+		return;
 	}
 
-	for(nrn = route_top(ntable); nrn; nrn = route_next(nrn)) {
-		if(!nrn->info) {
+	start = route_node_get(ntable, &rn->p);
+	for(nrn = start; nrn; nrn = route_next_until(nrn, start)) {
+		if((rnh = nrn->info) == NULL) {
 			continue;
 		}
+		if(rnh->resolved_len > rn->p.prefixlen || CHECK_FLAG(rnh->flags, ZEBRA_NHT_PENDING)) {
+			continue;
+		}
+		SET_FLAG(rnh->flags, ZEBRA_NHT_PENDING);
+		if(!rnh_pending) {
+			rnh_pending = list_new();
+		}
+		listnode_add(rnh_pending, rnh);
+	}
+}
 
-		rnh = nrn->info;
-		prn = route_node_match(ptable, &nrn->p);
-		if(!prn) {
-			rib = NULL;
-		} else {
-			RNODE_FOREACH_RIB(prn, rib) {
-				if(CHECK_FLAG(rib->status, RIB_ENTRY_REMOVED)) {
-					continue;
-				}
-				if(!CHECK_FLAG(rib->status, RIB_ENTRY_SELECTED_FIB)) {
-					continue;
-				}
-
-				if(CHECK_FLAG(rnh->flags, ZEBRA_NHT_CONNECTED)) {
-					if(rib->type == ZEBRA_ROUTE_CONNECT) {
-						break;
-					}
+/* Evaluate the nexthops pending, and tell their clients of those that
+ * changed.  One changed and back meanwhile isn't sent at all. */
+static void zebra_rnh_evaluate_pending(void) {
+	struct listnode *node;
+	struct rnh *rnh;
 
-					if(rib->type == ZEBRA_ROUTE_NHRP) {
-						struct nexthop *nexthop;
-						for(nexthop = rib->nexthop; nexthop; nexthop = nexthop->next) {
-							if(nexthop->type == NEXTHOP_TYPE_IFINDEX || nexthop->type == NEXTHOP_TYPE_IFNAME) {
-								break;
-							}
-						}
-						if(nexthop) {
-							break;
-						}
-					}
-				} else {
-					break;
-				}
-			}
+	while(rnh_pending && (node = listhead(rnh_pending))) {
+		rnh = listgetdata(node);
+		list_delete_node(rnh_pending, node);
+		UNSET_FLAG(rnh->flags, ZEBRA_NHT_PENDING);
+		if(zebra_rnh_evaluate(rnh)) {
+			zebra_rnh_notify(rnh);
 		}
+	}
+}
 
-		if(compare_state(rib, rnh->state)) {
-			if(IS_ZEBRA_DEBUG_NHT) {
-				char bufn[INET6_ADDRSTRLEN];
-				char bufp[INET6_ADDRSTRLEN];
-				prefix2str(&nrn->p, bufn, INET6_ADDRSTRLEN);
-				if(prn) {
-					prefix2str(&prn->p, bufp, INET6_ADDRSTRLEN);
-				} else {
-					strcpy(bufp, "null");
-				}
-				zlog_debug(
-					"rnh %s resolved through route %s - sending "
-					"nexthop %s event to clients",
-					bufn, bufp, rib ? "reachable" : "unreachable"
-				);
-			}
-			copy_state(rnh, rib);
-			for(ALL_LIST_ELEMENTS_RO(rnh->client_list, node, client)) {
-				send_client(rnh, client, vrfid);
-			}
-		}
+static int zebra_rnh_timer(struct thread *thread) {
+	rnh_t_evaluate = NULL;
+	zebra_rnh_evaluate_pending();
+	return 0;
+}
+
+/* The RIB was processed */
+void zebra_evaluate_rnh(void) {
+	if(!rnh_pending || list_isempty(rnh_pending)) {
+		return;
+	}
+	if(!zebra_rnh_delay) {
+		zebra_rnh_evaluate_pending();
+	} else if(!rnh_t_evaluate) {
+		rnh_t_evaluate = thread_add_timer_msec(zebrad.master, zebra_rnh_timer, NULL, zebra_rnh_delay);
 	}
-	return 1;
 }
 
 int zebra_dispatch_rnh_table(vrf_id_t vrfid, int family, struct zserv *client) {
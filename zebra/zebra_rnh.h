@@ -30,17 +30,29 @@
 struct rnh {
 	u_char flags;
 #define ZEBRA_NHT_CONNECTED 0x1
+#define ZEBRA_NHT_EVALUATED 0x2
+#define ZEBRA_NHT_PENDING 0x4
+	/* prefix length of the route node it resolved through, 0 for none:
+	 * the routes at shorter prefixes have no bearing on it */
+	u_char resolved_len;
+	vrf_id_t vrf_id;
 	struct rib *state;
 	struct list *client_list;
 	struct route_node *node;
 };
 
+/* milliseconds the nexthops changed are evaluated after, coalescing what
+ * happened meanwhile */
+extern u_int32_t zebra_rnh_delay;
+#define ZEBRA_RNH_DELAY_MAX 10000
+
 extern struct rnh *zebra_add_rnh(struct prefix *p, vrf_id_t vrfid);
 extern struct rnh *zebra_lookup_rnh(struct prefix *p, vrf_id_t vrfid);
 extern void zebra_delete_rnh(struct rnh *rnh);
 extern void zebra_add_rnh_client(struct rnh *rnh, struct zserv *client, vrf_id_t vrf_id_t);
 extern void zebra_remove_rnh_client(struct rnh *rnh, struct zserv *client);
-extern int zebra_evaluate_rnh_table(vrf_id_t vrfid, int family);
+extern void zebra_rnh_changed(struct route_node *rn);
+extern void zebra_evaluate_rnh(void);
 extern int zebra_dispatch_rnh_table(vrf_id_t vrfid, int family, struct zserv *cl);
 extern void zebra_print_rnh_table(vrf_id_t vrfid, int family, struct vty *vty);
 extern char *rnh_str(struct rnh *rnh, char *buf, int size);
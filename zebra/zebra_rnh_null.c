@@ -3,8 +3,10 @@
 #include "zebra/zserv.h"
 #include "zebra/zebra_rnh.h"
 
-int zebra_evaluate_rnh_table(vrf_id_t vrfid, int family) {
-	return 0;
-}
+u_int32_t zebra_rnh_delay;
+
+void zebra_rnh_changed(struct route_node *rn) {}
+
+void zebra_evaluate_rnh(void) {}
 
 void zebra_print_rnh_table(vrf_id_t vrfid, int family, struct vty *vty) {}
@@ -30,6 +30,7 @@
 #include "rib.h"
 #include "vrf.h"
 #include "nexthop.h"
+#include "json.h"
 
 #include "zebra/zserv.h"
 #include "zebra/zebra_rnh.h"
@@ -2044,6 +2045,9 @@ DEFUN (ip_protocol,
   if (proto_rm[AFI_IP][i])
     XFREE (MTYPE_ROUTE_MAP_NAME, proto_rm[AFI_IP][i]);
   proto_rm[AFI_IP][i] = XSTRDUP (MTYPE_ROUTE_MAP_NAME, argv[1]);
+
+  /* routes it now applies to depend on any interface, see rib_ifdep */
+  rib_update (VRF_DEFAULT);
   return CMD_SUCCESS;
 }
 
@@ -2069,6 +2073,7 @@ DEFUN (no_ip_protocol,
   if (proto_rm[AFI_IP][i])
     XFREE (MTYPE_ROUTE_MAP_NAME, proto_rm[AFI_IP][i]);
   proto_rm[AFI_IP][i] = NULL;
+  rib_update (VRF_DEFAULT);
   return CMD_SUCCESS;
 }
 
@@ -2106,6 +2111,8 @@ vty_show_ip_route_detail (struct vty *vty, struct route_node *rn, int mcast)
         vty_out (vty, ", fib-override");
       if (CHECK_FLAG (rib->status, RIB_ENTRY_SELECTED_FIB))
         vty_out (vty, ", fib");
+      if (CHECK_FLAG (rib->status, RIB_ENTRY_QUEUED))
+        vty_out (vty, ", queued");
       if (rib->refcnt)
         vty_out (vty, ", refcnt %ld", rib->refcnt);
       if (CHECK_FLAG (rib->flags, ZEBRA_FLAG_BLACKHOLE))
@@ -2419,6 +2426,384 @@ ALIAS (show_ip_route,
        "IP routing table\n"
        VRF_CMD_HELP_STR)
 
+static void
+vty_show_route_json (struct json_out *j, struct route_node *rn,
+                     struct rib *rib)
+{
+  struct nexthop *nexthop, *tnexthop;
+  int recursing;
+  char buf[INET6_ADDRSTRLEN];
+
+  json_out_object (j, NULL);
+  json_out_prefix (j, "prefix", &rn->p);
+  json_out_uint (j, "version", rib_dest_from_rnode (rn)->version);
+  json_out_str (j, "protocol", zebra_route_string (rib->type));
+  json_out_bool (j, "selected", CHECK_FLAG (rib->flags, ZEBRA_FLAG_SELECTED));
+  json_out_uint (j, "distance", rib->distance);
+  json_out_uint (j, "metric", rib->metric);
+  json_out_uint (j, "vrf", rib->vrf_id);
+  json_out_int (j, "uptime", time (NULL) - rib->uptime);
+  if (CHECK_FLAG (rib->flags, ZEBRA_FLAG_BLACKHOLE))
+    json_out_bool (j, "blackhole", 1);
+  if (CHECK_FLAG (rib->flags, ZEBRA_FLAG_REJECT))
+    json_out_bool (j, "reject", 1);
+
+  json_out_array (j, "nexthops");
+  for (ALL_NEXTHOPS_RO(rib->nexthop, nexthop, tnexthop, recursing))
+    {
+      json_out_object (j, NULL);
+
+      switch (nexthop->type)
+        {
+        case NEXTHOP_TYPE_IPV4:
+        case NEXTHOP_TYPE_IPV4_IFINDEX:
+          json_out_in_addr (j, "gateway", nexthop->gate.ipv4);
+          break;
+        case NEXTHOP_TYPE_IPV6:
+        case NEXTHOP_TYPE_IPV6_IFINDEX:
+        case NEXTHOP_TYPE_IPV6_IFNAME:
+          inet_ntop (AF_INET6, &nexthop->gate.ipv6, buf, sizeof buf);
+          json_out_str (j, "gateway", buf);
+          break;
+        case NEXTHOP_TYPE_BLACKHOLE:
+          json_out_str (j, "interface", "Null0");
+          break;
+        default:
+          break;
+        }
+
+      if (nexthop->type == NEXTHOP_TYPE_IFNAME
+          || nexthop->type == NEXTHOP_TYPE_IPV6_IFNAME)
+        json_out_str (j, "interface", nexthop->ifname);
+      else if (nexthop->ifindex)
+        json_out_str (j, "interface",
+                      ifindex2ifname_vrf (nexthop->ifindex, rib->vrf_id));
+
+      json_out_bool (j, "fib", CHECK_FLAG (nexthop->flags, NEXTHOP_FLAG_FIB));
+      json_out_bool (j, "active",
+                     CHECK_FLAG (nexthop->flags, NEXTHOP_FLAG_ACTIVE));
+      if (CHECK_FLAG (nexthop->flags, NEXTHOP_FLAG_ONLINK))
+        json_out_bool (j, "onlink", 1);
+      if (recursing)
+        json_out_bool (j, "resolved", 1);
+      if (CHECK_FLAG (nexthop->flags, NEXTHOP_FLAG_RECURSIVE))
+        json_out_bool (j, "recursive", 1);
+
+      switch (nexthop->type)
+        {
+          case NEXTHOP_TYPE_IPV4:
+          case NEXTHOP_TYPE_IPV4_IFINDEX:
+          case NEXTHOP_TYPE_IPV4_IFNAME:
+            if (nexthop->src.ipv4.s_addr)
+              json_out_in_addr (j, "source", nexthop->src.ipv4);
+            break;
+#ifdef HAVE_IPV6
+          case NEXTHOP_TYPE_IPV6:
+          case NEXTHOP_TYPE_IPV6_IFINDEX:
+          case NEXTHOP_TYPE_IPV6_IFNAME:
+            if (!IPV6_ADDR_SAME(&nexthop->src.ipv6, &in6addr_any))
+              {
+                inet_ntop (AF_INET6, &nexthop->src.ipv6, buf, sizeof buf);
+                json_out_str (j, "source", buf);
+              }
+            break;
+#endif /* HAVE_IPV6 */
+          default:
+            break;
+        }
+
+      json_out_object_end (j);
+    }
+  json_out_array_end (j);
+
+  json_out_object_end (j);
+}
+
+/* A "show ip route json" walk, kept while its output is continued.
+   VRF tables are never freed, so only the node needs holding. */
+struct show_route_json
+{
+  struct json_out json;
+  route_table_iter_t iter;
+};
+
+static int
+show_route_json_continue (struct vty *vty, void *arg)
+{
+  struct show_route_json *st = arg;
+  struct route_node *rn;
+  struct rib *rib;
+
+  while ((rn = route_table_iter_next (&st->iter)) != NULL)
+    {
+      RNODE_FOREACH_RIB (rn, rib)
+        vty_show_route_json (&st->json, rn, rib);
+
+      if (vty_output_full (vty))
+        {
+          route_table_iter_pause (&st->iter);
+          return 1;
+        }
+    }
+
+  json_out_array_end (&st->json);
+  json_out_object_end (&st->json);
+  json_out_finish (&st->json);
+  return 0;
+}
+
+static void
+show_route_json_clean (void *arg)
+{
+  struct show_route_json *st = arg;
+
+  route_table_iter_cleanup (&st->iter);
+  XFREE (MTYPE_ZEBRA_SHOW, st);
+}
+
+DEFUN (show_ip_route_json,
+       show_ip_route_json_cmd,
+       "show ip route json",
+       SHOW_STR
+       IP_STR
+       "IP routing table\n"
+       "JavaScript Object Notation\n")
+{
+  struct route_table *table;
+  struct show_route_json *st;
+  vrf_id_t vrf_id = VRF_DEFAULT;
+
+  if (argc > 0)
+    VTY_GET_INTEGER ("VRF ID", vrf_id, argv[0]);
+
+  table = zebra_vrf_table (AFI_IP, SAFI_UNICAST, vrf_id);
+
+  st = XCALLOC (MTYPE_ZEBRA_SHOW, sizeof (struct show_route_json));
+  json_out_init (&st->json, vty);
+  json_out_object (&st->json, NULL);
+  json_out_uint (&st->json, "vrf", vrf_id);
+  json_out_array (&st->json, "routes");
+
+  if (! table)
+    {
+      json_out_array_end (&st->json);
+      json_out_object_end (&st->json);
+      json_out_finish (&st->json);
+      XFREE (MTYPE_ZEBRA_SHOW, st);
+      return CMD_SUCCESS;
+    }
+
+  route_table_iter_init (&st->iter, table);
+  if (show_route_json_continue (vty, st))
+    vty_output_continue (vty, show_route_json_continue,
+                         show_route_json_clean, st);
+  else
+    show_route_json_clean (st);
+
+  return CMD_SUCCESS;
+}
+
+ALIAS (show_ip_route_json,
+       show_ip_route_json_vrf_cmd,
+       "show ip route json " VRF_CMD_STR,
+       SHOW_STR
+       IP_STR
+       "IP routing table\n"
+       "JavaScript Object Notation\n"
+       VRF_CMD_HELP_STR)
+
+/* The routes whose selection changed since a table version, oldest
+   change first, so that a consumer keeping a copy of the table need not
+   fetch all of it again.  When the withdrawals since are no longer all
+   known it has to: the JSON then holds every route, "full" telling to
+   drop what isn't among them. */
+static int
+show_route_changes (struct vty *vty, afi_t afi, const char *version_str,
+                    const char *vrf_str, int use_json)
+{
+  struct route_table *table;
+  rib_table_info_t *info;
+  rib_table_changes_t changes;
+  struct route_node *rn;
+  const struct rib_withdrawn *w;
+  struct rib *rib;
+  struct show_route_json *st;
+  struct json_out json;
+  unsigned long long version;
+  char *endptr;
+  char buf[PREFIX_STRLEN];
+  vrf_id_t vrf_id = VRF_DEFAULT;
+  int known;
+
+  errno = 0;
+  version = strtoull (version_str, &endptr, 10);
+  if (*endptr != '\0' || errno || version_str[0] == '-')
+    {
+      vty_out (vty, "%% Malformed table version%s", VTY_NEWLINE);
+      return CMD_WARNING;
+    }
+  if (vrf_str)
+    VTY_GET_INTEGER ("VRF ID", vrf_id, vrf_str);
+
+  table = zebra_vrf_table (afi, SAFI_UNICAST, vrf_id);
+  if (! table)
+    {
+      vty_out (vty, "%% No such VRF%s", VTY_NEWLINE);
+      return CMD_WARNING;
+    }
+  info = table->info;
+  known = rib_table_changes_init (&changes, table, version);
+
+  if (! use_json)
+    {
+      if (! known)
+        {
+          vty_out (vty, "%% Changes since version %llu are no longer kept, "
+                   "table version is %llu%s", version,
+                   (unsigned long long) info->version, VTY_NEWLINE);
+          return CMD_WARNING;
+        }
+      vty_out (vty, "Table version is %llu, changes since version %llu%s",
+               (unsigned long long) info->version, version, VTY_NEWLINE);
+      if (afi == AFI_IP)
+        vty_out (vty, SHOW_ROUTE_V4_HEADER);
+      else
+        vty_out (vty, SHOW_ROUTE_V6_HEADER);
+      while (rib_table_changes_next (&changes, &rn, &w))
+        {
+          if (w)
+            {
+              vty_out (vty, "W   %s%s", prefix2str (&w->p, buf, sizeof (buf)),
+                       VTY_NEWLINE);
+              continue;
+            }
+          RNODE_FOREACH_RIB (rn, rib)
+            if (CHECK_FLAG (rib->flags, ZEBRA_FLAG_SELECTED))
+              vty_show_ip_route (vty, rn, rib);
+        }
+      return CMD_SUCCESS;
+    }
+
+  json_out_init (&json, vty);
+  json_out_object (&json, NULL);
+  json_out_uint (&json, "vrf", vrf_id);
+  json_out_uint (&json, "version", info->version);
+  json_out_uint (&json, "since", version);
+  json_out_bool (&json, "full", ! known);
+
+  if (known)
+    {
+      json_out_array (&json, "changes");
+      while (rib_table_changes_next (&changes, &rn, &w))
+        {
+          if (w)
+            {
+              json_out_object (&json, NULL);
+              json_out_prefix (&json, "prefix", &w->p);
+              json_out_uint (&json, "version", w->version);
+              json_out_bool (&json, "withdrawn", 1);
+              json_out_object_end (&json);
+              continue;
+            }
+          RNODE_FOREACH_RIB (rn, rib)
+            if (CHECK_FLAG (rib->flags, ZEBRA_FLAG_SELECTED))
+              vty_show_route_json (&json, rn, rib);
+        }
+      json_out_array_end (&json);
+      json_out_object_end (&json);
+      json_out_finish (&json);
+      return CMD_SUCCESS;
+    }
+
+  /* the whole table goes out as the vty drains */
+  json_out_array (&json, "routes");
+  st = XCALLOC (MTYPE_ZEBRA_SHOW, sizeof (struct show_route_json));
+  st->json = json;
+  route_table_iter_init (&st->iter, table);
+  if (show_route_json_continue (vty, st))
+    vty_output_continue (vty, show_route_json_continue,
+                         show_route_json_clean, st);
+  else
+    show_route_json_clean (st);
+
+  return CMD_SUCCESS;
+}
+
+DEFUN (show_ip_route_changes,
+       show_ip_route_changes_cmd,
+       "show ip route changes-since VERSION",
+       SHOW_STR
+       IP_STR
+       "IP routing table\n"
+       "Routes whose selection changed since a table version\n"
+       "Table version\n")
+{
+  return show_route_changes (vty, AFI_IP, argv[0],
+                             argc > 1 ? argv[1] : NULL, 0);
+}
+
+ALIAS (show_ip_route_changes,
+       show_ip_route_changes_vrf_cmd,
+       "show ip route changes-since VERSION " VRF_CMD_STR,
+       SHOW_STR
+       IP_STR
+       "IP routing table\n"
+       "Routes whose selection changed since a table version\n"
+       "Table version\n"
+       VRF_CMD_HELP_STR)
+
+DEFUN (show_ip_route_changes_json,
+       show_ip_route_changes_json_cmd,
+       "show ip route changes-since VERSION json",
+       SHOW_STR
+       IP_STR
+       "IP routing table\n"
+       "Routes whose selection changed since a table version\n"
+       "Table version\n"
+       "JavaScript Object Notation\n")
+{
+  return show_route_changes (vty, AFI_IP, argv[0],
+                             argc > 1 ? argv[1] : NULL, 1);
+}
+
+ALIAS (show_ip_route_changes_json,
+       show_ip_route_changes_json_vrf_cmd,
+       "show ip route changes-since VERSION json " VRF_CMD_STR,
+       SHOW_STR
+       IP_STR
+       "IP routing table\n"
+       "Routes whose selection changed since a table version\n"
+       "Table version\n"
+       "JavaScript Object Notation\n"
+       VRF_CMD_HELP_STR)
+
+#ifdef HAVE_IPV6
+DEFUN (show_ipv6_route_changes,
+       show_ipv6_route_changes_cmd,
+       "show ipv6 route changes-since VERSION",
+       SHOW_STR
+       IP_STR
+       "IPv6 routing table\n"
+       "Routes whose selection changed since a table version\n"
+       "Table version\n")
+{
+  return show_route_changes (vty, AFI_IP6, argv[0], NULL, 0);
+}
+
+DEFUN (show_ipv6_route_changes_json,
+       show_ipv6_route_changes_json_cmd,
+       "show ipv6 route changes-since VERSION json",
+       SHOW_STR
+       IP_STR
+       "IPv6 routing table\n"
+       "Routes whose selection changed since a table version\n"
+       "Table version\n"
+       "JavaScript Object Notation\n")
+{
+  return show_route_changes (vty, AFI_IP6, argv[0], NULL, 1);
+}
+#endif /* HAVE_IPV6 */
+
 DEFUN (show_ip_nht,
        show_ip_nht_cmd,
        "show ip nht",
@@ -2441,6 +2826,134 @@ DEFUN (show_ipv6_nht,
   return CMD_SUCCESS;
 }
 
+DEFUN (ip_nht_delay,
+       ip_nht_delay_cmd,
+       "ip nht delay <0-10000>",
+       IP_STR
+       "IP nexthop tracking\n"
+       "Evaluate the nexthops a route change affects after a delay\n"
+       "Milliseconds, changes meanwhile coalesced\n")
+{
+  u_int32_t delay;
+
+  VTY_GET_INTEGER_RANGE ("delay", delay, argv[0], 0, ZEBRA_RNH_DELAY_MAX);
+  zebra_rnh_delay = delay;
+  return CMD_SUCCESS;
+}
+
+DEFUN (no_ip_nht_delay,
+       no_ip_nht_delay_cmd,
+       "no ip nht delay",
+       NO_STR
+       IP_STR
+       "IP nexthop tracking\n"
+       "Evaluate the nexthops a route change affects after a delay\n")
+{
+  zebra_rnh_delay = 0;
+  return CMD_SUCCESS;
+}
+
+ALIAS (no_ip_nht_delay,
+       no_ip_nht_delay_val_cmd,
+       "no ip nht delay <0-10000>",
+       NO_STR
+       IP_STR
+       "IP nexthop tracking\n"
+       "Evaluate the nexthops a route change affects after a delay\n"
+       "Milliseconds, changes meanwhile coalesced\n")
+
+DEFUN (ip_fib_audit_interval,
+       ip_fib_audit_interval_cmd,
+       "ip fib audit interval <10-86400>",
+       IP_STR
+       "Forwarding information base\n"
+       "Compare the kernel's routes with the RIB, repairing differences\n"
+       "Audit periodically, not only after netlink overruns\n"
+       "Seconds between audits\n")
+{
+  u_int32_t interval;
+
+  VTY_GET_INTEGER_RANGE ("interval", interval, argv[0], 10, 86400);
+  rib_audit_interval = interval;
+  rib_audit_reschedule ();
+  return CMD_SUCCESS;
+}
+
+DEFUN (no_ip_fib_audit_interval,
+       no_ip_fib_audit_interval_cmd,
+       "no ip fib audit interval",
+       NO_STR
+       IP_STR
+       "Forwarding information base\n"
+       "Compare the kernel's routes with the RIB, repairing differences\n"
+       "Audit periodically, not only after netlink overruns\n")
+{
+  rib_audit_interval = 0;
+  rib_audit_reschedule ();
+  return CMD_SUCCESS;
+}
+
+ALIAS (no_ip_fib_audit_interval,
+       no_ip_fib_audit_interval_val_cmd,
+       "no ip fib audit interval <10-86400>",
+       NO_STR
+       IP_STR
+       "Forwarding information base\n"
+       "Compare the kernel's routes with the RIB, repairing differences\n"
+       "Audit periodically, not only after netlink overruns\n"
+       "Seconds between audits\n")
+
+DEFUN (ip_fib_audit_rate,
+       ip_fib_audit_rate_cmd,
+       "ip fib audit rate <100-1000000>",
+       IP_STR
+       "Forwarding information base\n"
+       "Compare the kernel's routes with the RIB, repairing differences\n"
+       "Pace of the audit\n"
+       "Routes a second\n")
+{
+  u_int32_t rate;
+
+  VTY_GET_INTEGER_RANGE ("rate", rate, argv[0], 100, 1000000);
+  rib_audit_rate = rate;
+  return CMD_SUCCESS;
+}
+
+DEFUN (no_ip_fib_audit_rate,
+       no_ip_fib_audit_rate_cmd,
+       "no ip fib audit rate",
+       NO_STR
+       IP_STR
+       "Forwarding information base\n"
+       "Compare the kernel's routes with the RIB, repairing differences\n"
+       "Pace of the audit\n")
+{
+  rib_audit_rate = RIB_AUDIT_RATE_DEFAULT;
+  return CMD_SUCCESS;
+}
+
+ALIAS (no_ip_fib_audit_rate,
+       no_ip_fib_audit_rate_val_cmd,
+       "no ip fib audit rate <100-1000000>",
+       NO_STR
+       IP_STR
+       "Forwarding information base\n"
+       "Compare the kernel's routes with the RIB, repairing differences\n"
+       "Pace of the audit\n"
+       "Routes a second\n")
+
+DEFUN (show_ip_fib_audit,
+       show_ip_fib_audit_cmd,
+       "show ip fib audit",
+       SHOW_STR
+       IP_STR
+       "Forwarding information base\n"
+       "Comparisons of the kernel's routes with the RIB\n")
+{
+  rib_audit_show (vty);
+  return CMD_SUCCESS;
+}
+
 DEFUN (show_ip_route_tag,
        show_ip_route_tag_cmd,
        "show ip route tag <1-4294967295>",
@@ -5266,6 +5779,14 @@ static int config_write_vty(struct vty *vty)
       vty_out (vty, "ip protocol %s route-map %s%s", "any",
                proto_rm[AFI_IP][ZEBRA_ROUTE_MAX], VTY_NEWLINE);
 
+  if (zebra_rnh_delay)
+    vty_out (vty, "ip nht delay %u%s", zebra_rnh_delay, VTY_NEWLINE);
+
+  if (rib_audit_interval)
+    vty_out (vty, "ip fib audit interval %u%s", rib_audit_interval, VTY_NEWLINE);
+  if (rib_audit_rate != RIB_AUDIT_RATE_DEFAULT)
+    vty_out (vty, "ip fib audit rate %u%s", rib_audit_rate, VTY_NEWLINE);
+
   return 1;
 }
 
@@ -5363,6 +5884,16 @@ zebra_vty_init (void)
   install_element (VIEW_NODE, &show_ip_route_tag_vrf_cmd);
   install_element (VIEW_NODE, &show_ip_nht_cmd);
   install_element (VIEW_NODE, &show_ipv6_nht_cmd);
+  install_element (CONFIG_NODE, &ip_nht_delay_cmd);
+  install_element (CONFIG_NODE, &no_ip_nht_delay_cmd);
+  install_element (CONFIG_NODE, &no_ip_nht_delay_val_cmd);
+  install_element (CONFIG_NODE, &ip_fib_audit_interval_cmd);
+  install_element (CONFIG_NODE, &no_ip_fib_audit_interval_cmd);
+  install_element (CONFIG_NODE, &no_ip_fib_audit_interval_val_cmd);
+  install_element (CONFIG_NODE, &ip_fib_audit_rate_cmd);
+  install_element (CONFIG_NODE, &no_ip_fib_audit_rate_cmd);
+  install_element (CONFIG_NODE, &no_ip_fib_audit_rate_val_cmd);
+  install_element (VIEW_NODE, &show_ip_fib_audit_cmd);
   install_element (VIEW_NODE, &show_ip_route_addr_cmd);
   install_element (VIEW_NODE, &show_ip_route_prefix_cmd);
   install_element (VIEW_NODE, &show_ip_route_prefix_longer_cmd);
@@ -5407,6 +5938,12 @@ zebra_vty_init (void)
   install_element (CONFIG_NODE, &no_ip_route_mask_flags_distance2_vrf_cmd);
 
   install_element (VIEW_NODE, &show_ip_route_vrf_cmd);
+  install_element (VIEW_NODE, &show_ip_route_json_cmd);
+  install_element (VIEW_NODE, &show_ip_route_json_vrf_cmd);
+  install_element (VIEW_NODE, &show_ip_route_changes_cmd);
+  install_element (VIEW_NODE, &show_ip_route_changes_vrf_cmd);
+  install_element (VIEW_NODE, &show_ip_route_changes_json_cmd);
+  install_element (VIEW_NODE, &show_ip_route_changes_json_vrf_cmd);
   install_element (VIEW_NODE, &show_ip_route_addr_vrf_cmd);
   install_element (VIEW_NODE, &show_ip_route_prefix_vrf_cmd);
   install_element (VIEW_NODE, &show_ip_route_prefix_longer_vrf_cmd);
@@ -5476,6 +6013,8 @@ zebra_vty_init (void)
   install_element (CONFIG_NODE, &no_ipv6_route_ifname_flags_pref_tag_cmd);
   install_element (CONFIG_NODE, &no_ipv6_route_ifname_flags_pref_tag_vrf_cmd);
   install_element (VIEW_NODE, &show_ipv6_route_cmd);
+  install_element (VIEW_NODE, &show_ipv6_route_changes_cmd);
+  install_element (VIEW_NODE, &show_ipv6_route_changes_json_cmd);
   install_element (VIEW_NODE, &show_ipv6_route_tag_cmd);
   install_element (VIEW_NODE, &show_ipv6_route_tag_vrf_cmd);
   install_element (VIEW_NODE, &show_ipv6_route_summary_cmd);
@@ -39,6 +39,7 @@
 #include "buffer.h"
 #include "vrf.h"
 #include "nexthop.h"
+#include "zring.h"
 
 #include "zebra/zserv.h"
 #include "zebra/router-id.h"
@@ -46,6 +47,8 @@
 #include "zebra/debug.h"
 #include "zebra/ipforward.h"
 #include "zebra/zebra_rnh.h"
+#include "zebra/zebra_nhg.h"
+#include "zebra/zebra_bfd.h"
 
 /* Event list of zebra. */
 enum event {
@@ -79,6 +82,23 @@ static int zserv_delayed_close(struct thread *thread) {
  */
 static int route_type_oaths[ZEBRA_ROUTE_MAX];
 
+/* Account the client's output backlog once some was queued: past the
+ * high watermark, redistribution to the client is held. */
+static void zserv_backlog_check(struct zserv *client) {
+	size_t backlog = buffer_pending(client->wb);
+
+	if(backlog > client->backlog_max) {
+		client->backlog_max = backlog;
+	}
+	if(!client->redist_hold && zebrad.backlog_high && backlog >= zebrad.backlog_high) {
+		if(IS_ZEBRA_DEBUG_EVENT) {
+			zlog_debug("%s client fd %d backlog %lu bytes, holding redistribution", zebra_route_string(client->proto), client->sock, (u_long) backlog);
+		}
+		client->redist_hold = 1;
+		client->backlog_holds++;
+	}
+}
+
 static int zserv_flush_data(struct thread *thread) {
 	struct zserv *client = THREAD_ARG(thread);
 
@@ -87,31 +107,42 @@ static int zserv_flush_data(struct thread *thread) {
 		zebra_client_close(client);
 		return -1;
 	}
-	switch(buffer_flush_available(client->wb, client->sock)) {
+	/* writev over the chunks queued, until the socket would block */
+	switch(buffer_flush_all(client->wb, client->sock)) {
 		case BUFFER_ERROR:
 			zlog_warn(
-				"%s: buffer_flush_available failed on zserv client fd %d, "
+				"%s: buffer_flush_all failed on zserv client fd %d, "
 				"closing",
 				__func__, client->sock
 			);
 			zebra_client_close(client);
-			break;
+			return -1;
 		case BUFFER_PENDING: client->t_write = thread_add_write(zebrad.master, zserv_flush_data, client, client->sock); break;
 		case BUFFER_EMPTY: break;
 	}
 
 	client->last_write_time = quagga_time(NULL);
+
+	/* drained to the low watermark, send what was held */
+	if(client->redist_hold && buffer_pending(client->wb) <= zebrad.backlog_low) {
+		zebra_redistribute_release(client);
+	}
 	return 0;
 }
 
-int zebra_server_send_message(struct zserv *client) {
+/* Queue a message for the client, the one encoded in s.  A corked
+ * client only has it queued, until zserv_uncork(). */
+int zebra_server_send_stream(struct zserv *client, struct stream *s) {
 	if(client->t_suicide) {
 		return -1;
 	}
 
-	stream_set_getp(client->obuf, 0);
-	client->last_write_cmd = stream_getw_from(client->obuf, 4);
-	switch(buffer_write(client->wb, client->sock, STREAM_DATA(client->obuf), stream_get_endp(client->obuf))) {
+	client->last_write_cmd = stream_getw_from(s, 4);
+	if(client->corked) {
+		buffer_put(client->wb, STREAM_DATA(s), stream_get_endp(s));
+		return 0;
+	}
+	switch(buffer_write(client->wb, client->sock, STREAM_DATA(s), stream_get_endp(s))) {
 		case BUFFER_ERROR:
 			zlog_warn("%s: buffer_write failed to zserv client fd %d, closing", __func__, client->sock);
 			/* Schedule a delayed close since many of the functions that call this
@@ -121,13 +152,35 @@ int zebra_server_send_message(struct zserv *client) {
 			client->t_suicide = thread_add_event(zebrad.master, zserv_delayed_close, client, 0);
 			return -1;
 		case BUFFER_EMPTY: THREAD_OFF(client->t_write); break;
-		case BUFFER_PENDING: THREAD_WRITE_ON(zebrad.master, client->t_write, zserv_flush_data, client, client->sock); break;
+		case BUFFER_PENDING:
+			THREAD_WRITE_ON(zebrad.master, client->t_write, zserv_flush_data, client, client->sock);
+			zserv_backlog_check(client);
+			break;
 	}
 
 	client->last_write_time = quagga_time(NULL);
 	return 0;
 }
 
+int zebra_server_send_message(struct zserv *client) {
+	return zebra_server_send_stream(client, client->obuf);
+}
+
+/* While a whole table is sent to the client, only queue the messages,
+ * to be written in as few writev() as they take. */
+void zserv_cork(struct zserv *client) {
+	client->corked = 1;
+}
+
+void zserv_uncork(struct zserv *client) {
+	client->corked = 0;
+	if(client->t_suicide || !buffer_pending(client->wb)) {
+		return;
+	}
+	THREAD_WRITE_ON(zebrad.master, client->t_write, zserv_flush_data, client, client->sock);
+	zserv_backlog_check(client);
+}
+
 void zserv_create_header(struct stream *s, uint16_t cmd, vrf_id_t vrf_id) {
 	/* length placeholder, caller can update */
 	stream_putw(s, ZEBRA_HEADER_SIZE);
@@ -386,19 +439,24 @@ int zsend_interface_update(int cmd, struct zserv *client, struct interface *ifp)
  * duplication.
  */
 int zsend_route_multipath(int cmd, struct zserv *client, struct prefix *p, struct rib *rib) {
+	/* Check this client need this route. */
+	if(!vrf_bitmap_check(client->redist[rib->type], rib->vrf_id) && !(is_default(p) && vrf_bitmap_check(client->redist_default, rib->vrf_id))) {
+		return 0;
+	}
+
+	zserv_encode_route(client->obuf, cmd, p, rib);
+	return zebra_server_send_message(client);
+}
+
+/* Encode the route message into s, as it is for every client it's
+ * redistributed to. */
+void zserv_encode_route(struct stream *s, int cmd, struct prefix *p, struct rib *rib) {
 	int psize;
-	struct stream *s;
 	struct nexthop *nexthop;
 	unsigned long nhnummark = 0, messmark = 0;
 	int nhnum = 0;
 	u_char zapi_flags = 0;
 
-	/* Check this client need this route. */
-	if(!vrf_bitmap_check(client->redist[rib->type], rib->vrf_id) && !(is_default(p) && vrf_bitmap_check(client->redist_default, rib->vrf_id))) {
-		return 0;
-	}
-
-	s = client->obuf;
 	stream_reset(s);
 
 	zserv_create_header(s, cmd, rib->vrf_id);
@@ -491,8 +549,6 @@ int zsend_route_multipath(int cmd, struct zserv *client, struct prefix *p, struc
 
 	/* Write packet size. */
 	stream_putw_at(s, 0, stream_get_endp(s));
-
-	return zebra_server_send_message(client);
 }
 
 #ifdef HAVE_IPV6
@@ -658,14 +714,13 @@ static int zserv_nexthop_register(struct zserv *client, int sock, u_short length
 
 		client->nh_reg_time = quagga_time(NULL);
 
-		if(connected) {
+		if(connected && !CHECK_FLAG(rnh->flags, ZEBRA_NHT_CONNECTED)) {
 			SET_FLAG(rnh->flags, ZEBRA_NHT_CONNECTED);
+			UNSET_FLAG(rnh->flags, ZEBRA_NHT_EVALUATED);
 		}
 
 		zebra_add_rnh_client(rnh, client, vrf_id);
 	}
-	zebra_evaluate_rnh_table(0, AF_INET);
-	zebra_evaluate_rnh_table(0, AF_INET6);
 	return 0;
 }
 
@@ -906,6 +961,15 @@ static int zread_ipv4_add(struct zserv *client, u_short length, vrf_id_t vrf_id)
 		rib->tag = 0;
 	}
 
+	/* Nexthop group, the nexthops sent along are for when there is none */
+	if(CHECK_FLAG(message, ZAPI_MESSAGE_NHG)) {
+		struct zebra_nhg *nhg = zebra_nhg_lookup(client, stream_getl(s));
+
+		if(nhg) {
+			zebra_nhg_rib_set(rib, nhg);
+		}
+	}
+
 	/* Table */
 	rib->table = zebrad.rtm_table_default;
 	ret = rib_add_ipv4_multipath(&p, rib, safi);
@@ -919,6 +983,55 @@ static int zread_ipv4_add(struct zserv *client, u_short length, vrf_id_t vrf_id)
 	return 0;
 }
 
+/* Nexthop group add or replace: id, then nexthops as in a route add */
+static int zread_nexthop_group_add(struct zserv *client, u_short length) {
+	struct stream *s = client->ibuf;
+	struct nexthop *head = NULL, *nexthop;
+	u_int32_t id;
+	u_char nexthop_num;
+	u_char nexthop_type;
+	int i;
+
+	id = stream_getl(s);
+	nexthop_num = stream_getc(s);
+
+	for(i = 0; i < nexthop_num; i++) {
+		nexthop_type = stream_getc(s);
+
+		nexthop = nexthop_new();
+		switch(nexthop_type) {
+			case ZEBRA_NEXTHOP_IFINDEX:
+				nexthop->type = NEXTHOP_TYPE_IFINDEX;
+				nexthop->ifindex = stream_getl(s);
+				break;
+			case ZEBRA_NEXTHOP_IPV4:
+				nexthop->type = NEXTHOP_TYPE_IPV4;
+				nexthop->gate.ipv4.s_addr = stream_get_ipv4(s);
+				break;
+			case ZEBRA_NEXTHOP_IPV4_IFINDEX:
+				nexthop->type = NEXTHOP_TYPE_IPV4_IFINDEX;
+				nexthop->gate.ipv4.s_addr = stream_get_ipv4(s);
+				nexthop->ifindex = stream_getl(s);
+				break;
+			default:
+				/* can't tell where the next one starts */
+				zlog_warn("%s: group %u from %s, unsupported nexthop type %u", __func__, id, zebra_route_string(client->proto), nexthop_type);
+				nexthop_free(nexthop);
+				nexthops_free(head);
+				return -1;
+		}
+		nexthop_add(&head, nexthop);
+	}
+
+	zebra_nhg_update(client, id, head, nexthop_num);
+	return 0;
+}
+
+static int zread_nexthop_group_delete(struct zserv *client, u_short length) {
+	zebra_nhg_delete(client, stream_getl(client->ibuf));
+	return 0;
+}
+
 /* Zebra server IPv4 prefix delete function. */
 static int zread_ipv4_delete(struct zserv *client, u_short length, vrf_id_t vrf_id) {
 	int i;
@@ -1226,6 +1339,78 @@ static int zread_ipv6_nexthop_lookup(struct zserv *client, u_short length, vrf_i
 }
 #endif /* HAVE_IPV6 */
 
+/* Many route adds or deletes sharing all but their prefix, or their
+ * head only, see zclient_route_send(): each is put back together as the
+ * message it stands for and handed to the usual reader. */
+static int zread_route_bulk(struct zserv *client, u_short length, vrf_id_t vrf_id) {
+	static struct stream *one;
+	struct stream *s = client->ibuf;
+	int (*zread)(struct zserv *, u_short, vrf_id_t);
+	u_char head[ZAPI_ROUTE_HEAD];
+	u_int16_t cmd, count, i;
+	size_t rest, rest_len;
+	u_char plen;
+	int each;
+
+	cmd = stream_getw(s);
+	switch(cmd) {
+		case ZEBRA_IPV4_ROUTE_ADD: zread = zread_ipv4_add; break;
+		case ZEBRA_IPV4_ROUTE_DELETE: zread = zread_ipv4_delete; break;
+#ifdef HAVE_IPV6
+		case ZEBRA_IPV6_ROUTE_ADD: zread = zread_ipv6_add; break;
+		case ZEBRA_IPV6_ROUTE_DELETE: zread = zread_ipv6_delete; break;
+#endif /* HAVE_IPV6 */
+		default: zlog_warn("%s: %s sent %s in bulk", __func__, zebra_route_string(client->proto), zserv_command_string(cmd)); return -1;
+	}
+
+	if(one == NULL) {
+		one = stream_new(ZEBRA_MAX_PACKET_SIZ);
+	}
+
+	stream_get(head, s, ZAPI_ROUTE_HEAD);
+	rest_len = stream_getw(s);
+	/* or each route with its own, after its prefix */
+	if((each = rest_len == ZAPI_BULK_EACH)) {
+		rest_len = 0;
+	}
+	rest = stream_get_getp(s);
+	if(STREAM_READABLE(s) < rest_len + 2) {
+		zlog_warn("%s: %s sent a truncated bulk", __func__, zebra_route_string(client->proto));
+		return -1;
+	}
+	stream_forward_getp(s, rest_len);
+	count = stream_getw(s);
+
+	for(i = 0; i < count; i++) {
+		if(STREAM_READABLE(s) < 1 || STREAM_READABLE(s) < (size_t) 1 + PSIZE(stream_getc_from(s, stream_get_getp(s)))) {
+			zlog_warn("%s: %s sent a truncated bulk", __func__, zebra_route_string(client->proto));
+			return -1;
+		}
+		plen = stream_getc(s);
+
+		stream_reset(one);
+		stream_put(one, head, ZAPI_ROUTE_HEAD);
+		stream_putc(one, plen);
+		stream_put(one, STREAM_DATA(s) + stream_get_getp(s), PSIZE(plen));
+		stream_forward_getp(s, PSIZE(plen));
+		if(each) {
+			if(STREAM_READABLE(s) < 2 || STREAM_READABLE(s) < (size_t) 2 + stream_getw_from(s, stream_get_getp(s))) {
+				zlog_warn("%s: %s sent a truncated bulk", __func__, zebra_route_string(client->proto));
+				return -1;
+			}
+			rest_len = stream_getw(s);
+			rest = stream_get_getp(s);
+			stream_forward_getp(s, rest_len);
+		}
+		stream_put(one, STREAM_DATA(s) + rest, rest_len);
+
+		client->ibuf = one;
+		zread(client, stream_get_endp(one), vrf_id);
+		client->ibuf = s;
+	}
+	return 0;
+}
+
 /* Register zebra server router-id information.  Send current router-id */
 static int zread_router_id_add(struct zserv *client, u_short length, vrf_id_t vrf_id) {
 	struct prefix p;
@@ -1266,33 +1451,64 @@ static void zread_hello(struct zserv *client) {
 
 /* Unregister all information in a VRF. */
 static int zread_vrf_unregister(struct zserv *client, u_short length, vrf_id_t vrf_id) {
-	int i;
-
-	for(i = 0; i < ZEBRA_ROUTE_MAX; i++) {
-		vrf_bitmap_unset(client->redist[i], vrf_id);
-	}
-	vrf_bitmap_unset(client->redist_default, vrf_id);
+	zebra_redistribute_vrf_unset(client, vrf_id);
 	vrf_bitmap_unset(client->ifinfo, vrf_id);
 	vrf_bitmap_unset(client->ridinfo, vrf_id);
 
 	return 0;
 }
 
+/* The client is restarting gracefully for so many seconds, or, with 0,
+ * has announced all its routes again since it did. */
+static void zread_graceful_restart(struct zserv *client, u_short length) {
+	u_int32_t secs;
+
+	if(length < 4) {
+		zlog_warn("%s: %s sent a truncated message", __func__, zebra_route_string(client->proto));
+		return;
+	}
+	secs = stream_getl(client->ibuf);
+
+	if(client->proto <= ZEBRA_ROUTE_STATIC || client->proto >= ZEBRA_ROUTE_MAX) {
+		zlog_warn("%s: client %d restarting without saying what routes are its", __func__, client->sock);
+		return;
+	}
+
+	client->gr_time = secs;
+	if(secs) {
+		zlog_notice("client %d restarting, %s routes kept for %u seconds once it goes", client->sock, zebra_route_string(client->proto), secs);
+	} else {
+		zlog_notice("client %d restarted, %lu unclaimed %s routes removed from the rib", client->sock, rib_sweep_proto(client->proto), zebra_route_string(client->proto));
+	}
+}
+
 /* If client sent routes of specific type, zebra removes it
- * and returns number of deleted routes.
+ * and returns number of deleted routes, or keeps them stale for a while
+ * if it said it is restarting.
  */
-static void zebra_score_rib(int client_sock) {
+static void zebra_score_rib(struct zserv *client) {
 	int i;
 
 	for(i = ZEBRA_ROUTE_RIP; i < ZEBRA_ROUTE_MAX; i++) {
-		if(client_sock == route_type_oaths[i]) {
-			zlog_notice("client %d disconnected. %lu %s routes removed from the rib", client_sock, rib_score_proto(i), zebra_route_string(i));
+		if(client->sock == route_type_oaths[i]) {
+			if(client->gr_time) {
+				zlog_notice("client %d disconnected. %lu %s routes kept for %u seconds", client->sock, rib_stale_proto(i, client->gr_time), zebra_route_string(i), client->gr_time);
+			} else {
+				zlog_notice("client %d disconnected. %lu %s routes removed from the rib", client->sock, rib_score_proto(i), zebra_route_string(i));
+			}
 			route_type_oaths[i] = 0;
 			break;
 		}
 	}
 }
 
+/* Close the descriptors passed along with a message it didn't use */
+static void zserv_passed_fds_close(struct zserv *client) {
+	while(client->passed_fds > 0) {
+		close(client->passed_fd[--client->passed_fds]);
+	}
+}
+
 /* Close zebra client. */
 static void zebra_client_close(struct zserv *client) {
 	zebra_cleanup_rnh_client(0, AF_INET, client);
@@ -1301,9 +1517,17 @@ static void zebra_client_close(struct zserv *client) {
 	/* Close file descriptor. */
 	if(client->sock) {
 		close(client->sock);
-		zebra_score_rib(client->sock);
+		zebra_score_rib(client);
 		client->sock = -1;
 	}
+	zebra_nhg_client_close(client);
+	zebra_bfd_client_close(client);
+	zebra_redistribute_held_free(client);
+	zebra_redistribute_client_close(client);
+	zserv_passed_fds_close(client);
+	if(client->ring) {
+		zring_free(client->ring);
+	}
 
 	/* Free stream buffers. */
 	if(client->ibuf) {
@@ -1326,6 +1550,9 @@ static void zebra_client_close(struct zserv *client) {
 	if(client->t_suicide) {
 		thread_cancel(client->t_suicide);
 	}
+	if(client->t_ring) {
+		thread_cancel(client->t_ring);
+	}
 
 	/* Free client structure. */
 	listnode_delete(zebrad.client_list, client);
@@ -1365,6 +1592,243 @@ static void zebra_client_create(int sock) {
 }
 
 /* Handler of zebra service request. */
+static int zebra_client_ring_read(struct thread *);
+
+/* stream_read_try() for the client's socket, keeping the descriptors
+ * passed along with the data, for zread_shm_ring() */
+static ssize_t zserv_read_try(struct zserv *client, size_t size) {
+	struct stream *s = client->ibuf;
+	struct msghdr msg;
+	struct iovec iov;
+	struct cmsghdr *cmsg;
+	union {
+		char buf[CMSG_SPACE(sizeof(int) * 3)];
+		struct cmsghdr align;
+	} control;
+	int flags = 0;
+	ssize_t nbytes;
+	size_t i, n;
+	int fd;
+
+	if(STREAM_WRITEABLE(s) < size) {
+		zlog_warn("%s: no room for %lu bytes from client fd %d", __func__, (u_long) size, client->sock);
+		return -1;
+	}
+
+	memset(&msg, 0, sizeof(msg));
+	iov.iov_base = STREAM_DATA(s) + stream_get_endp(s);
+	iov.iov_len = size;
+	msg.msg_iov = &iov;
+	msg.msg_iovlen = 1;
+	msg.msg_control = control.buf;
+	msg.msg_controllen = sizeof(control.buf);
+#ifdef MSG_CMSG_CLOEXEC
+	flags |= MSG_CMSG_CLOEXEC;
+#endif
+	if((nbytes = recvmsg(client->sock, &msg, flags)) < 0) {
+		if(ERRNO_IO_RETRY(errno)) {
+			return -2;
+		}
+		zlog_warn("%s: read failed on fd %d: %s", __func__, client->sock, safe_strerror(errno));
+		return -1;
+	}
+	stream_forward_endp(s, nbytes);
+
+	for(cmsg = CMSG_FIRSTHDR(&msg); cmsg; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+		if(cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS) {
+			continue;
+		}
+		n = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+		for(i = 0; i < n; i++) {
+			memcpy(&fd, CMSG_DATA(cmsg) + i * sizeof(int), sizeof(int));
+			if(client->passed_fds < (int) array_size(client->passed_fd)) {
+				client->passed_fd[client->passed_fds++] = fd;
+			} else {
+				close(fd);
+			}
+		}
+	}
+	return nbytes;
+}
+
+static int zsend_shm_ring(struct zserv *client, u_char state) {
+	struct stream *s = client->obuf;
+
+	stream_reset(s);
+	zserv_create_header(s, ZEBRA_SHM_RING, VRF_DEFAULT);
+	stream_putc(s, state);
+	stream_putw_at(s, 0, stream_get_endp(s));
+	return zebra_server_send_message(client);
+}
+
+/* A client offering a ring to send through, or starting to */
+static void zread_shm_ring(struct zserv *client, u_short length) {
+	u_char state;
+	u_int32_t size;
+
+	if(length < 1) {
+		return;
+	}
+	state = stream_getc(client->ibuf);
+
+	switch(state) {
+		case ZSERV_RING_OFFER:
+			if(length < 5 || client->ring || client->passed_fds != 3) {
+				zsend_shm_ring(client, ZSERV_RING_REFUSE);
+				break;
+			}
+			size = stream_getl(client->ibuf);
+			client->ring = zring_attach(size, client->passed_fd[0], client->passed_fd[1], client->passed_fd[2]);
+			client->passed_fds = 0;
+			if(!client->ring) {
+				zlog_warn("%s client fd %d offered a ring zebra can't map", zebra_route_string(client->proto), client->sock);
+			}
+			zsend_shm_ring(client, client->ring ? ZSERV_RING_ACCEPT : ZSERV_RING_REFUSE);
+			break;
+		case ZSERV_RING_START:
+			if(client->ring && !client->ring_started) {
+				if(IS_ZEBRA_DEBUG_EVENT) {
+					zlog_debug("client fd %d sends through a ring of %u bytes", client->sock, client->ring->size);
+				}
+				client->ring_started = 1;
+				client->t_ring = thread_add_event(zebrad.master, zebra_client_ring_read, client, 0);
+			}
+			break;
+	}
+}
+
+/* Handle the message in ibuf, read past its header */
+static void zebra_client_dispatch(struct zserv *client, uint16_t command, uint16_t length, vrf_id_t vrf_id) {
+	/* Debug packet information. */
+	if(IS_ZEBRA_DEBUG_EVENT) {
+		zlog_debug("zebra message comes from socket [%d]", client->sock);
+	}
+
+	if(IS_ZEBRA_DEBUG_PACKET && IS_ZEBRA_DEBUG_RECV) {
+		zlog_debug("zebra message received [%s] %d in VRF %u", zserv_command_string(command), length, vrf_id);
+	}
+
+	client->last_read_time = quagga_time(NULL);
+	client->last_read_cmd = command;
+
+	switch(command) {
+		case ZEBRA_ROUTER_ID_ADD: zread_router_id_add(client, length, vrf_id); break;
+		case ZEBRA_ROUTER_ID_DELETE: zread_router_id_delete(client, length, vrf_id); break;
+		case ZEBRA_INTERFACE_ADD: zread_interface_add(client, length, vrf_id); break;
+		case ZEBRA_INTERFACE_DELETE: zread_interface_delete(client, length, vrf_id); break;
+		case ZEBRA_IPV4_ROUTE_ADD: zread_ipv4_add(client, length, vrf_id); break;
+		case ZEBRA_IPV4_ROUTE_DELETE: zread_ipv4_delete(client, length, vrf_id); break;
+#ifdef HAVE_IPV6
+		case ZEBRA_IPV6_ROUTE_ADD: zread_ipv6_add(client, length, vrf_id); break;
+		case ZEBRA_IPV6_ROUTE_DELETE: zread_ipv6_delete(client, length, vrf_id); break;
+#endif /* HAVE_IPV6 */
+		case ZEBRA_REDISTRIBUTE_ADD: zebra_redistribute_add(command, client, length, vrf_id); break;
+		case ZEBRA_REDISTRIBUTE_DELETE: zebra_redistribute_delete(command, client, length, vrf_id); break;
+		case ZEBRA_REDISTRIBUTE_DEFAULT_ADD: zebra_redistribute_default_add(command, client, length, vrf_id); break;
+		case ZEBRA_REDISTRIBUTE_DEFAULT_DELETE: zebra_redistribute_default_delete(command, client, length, vrf_id); break;
+		case ZEBRA_IPV4_NEXTHOP_LOOKUP:
+		case ZEBRA_IPV4_NEXTHOP_LOOKUP_MRIB: zread_ipv4_nexthop_lookup(command, client, length, vrf_id); break;
+#ifdef HAVE_IPV6
+		case ZEBRA_IPV6_NEXTHOP_LOOKUP: zread_ipv6_nexthop_lookup(client, length, vrf_id); break;
+#endif /* HAVE_IPV6 */
+		case ZEBRA_IPV4_IMPORT_LOOKUP: zread_ipv4_import_lookup(client, length, vrf_id); break;
+		case ZEBRA_HELLO: zread_hello(client); break;
+		case ZEBRA_VRF_UNREGISTER: zread_vrf_unregister(client, length, vrf_id);
+		case ZEBRA_NEXTHOP_REGISTER: zserv_nexthop_register(client, client->sock, length, vrf_id); break;
+		case ZEBRA_NEXTHOP_UNREGISTER: zserv_nexthop_unregister(client, client->sock, length); break;
+		case ZEBRA_NEXTHOP_GROUP_ADD: zread_nexthop_group_add(client, length); break;
+		case ZEBRA_NEXTHOP_GROUP_DELETE: zread_nexthop_group_delete(client, length); break;
+		case ZEBRA_ROUTE_BULK: zread_route_bulk(client, length, vrf_id); break;
+		case ZEBRA_SHM_RING: zread_shm_ring(client, length); break;
+		case ZEBRA_GRACEFUL_RESTART: zread_graceful_restart(client, length); break;
+		case ZEBRA_BFD_DEST_REGISTER: zebra_bfd_register(client, length); break;
+		case ZEBRA_BFD_DEST_DEREGISTER: zebra_bfd_deregister(client, length); break;
+		default: zlog_info("Zebra received unknown command %d", command); break;
+	}
+}
+
+/* Messages read from a ring, at most, before letting others run */
+#define ZSERV_RING_BATCH 256
+
+/* Handle up to limit messages queued in the client's ring.  Returns 1 if
+ * there are more, 0 if the ring is empty, -1 if the client was closed. */
+static int zebra_client_ring_drain(struct zserv *client, unsigned int limit) {
+	static struct stream *ring_msg;
+	struct stream *ibuf = client->ibuf;
+	const u_char *data;
+	size_t len;
+	uint16_t length, command;
+	uint8_t marker, version;
+	vrf_id_t vrf_id;
+	int ret = 0;
+
+	if(!ring_msg) {
+		ring_msg = stream_new(ZEBRA_MAX_PACKET_SIZ);
+	}
+
+	while(limit-- > 0) {
+		if((ret = zring_get(client->ring, &data, &len)) <= 0) {
+			break;
+		}
+		if(len < ZEBRA_HEADER_SIZE || len > STREAM_SIZE(ring_msg)) {
+			ret = -1;
+			break;
+		}
+		stream_reset(ring_msg);
+		stream_put(ring_msg, data, len);
+		zring_consume(client->ring);
+
+		length = stream_getw(ring_msg);
+		marker = stream_getc(ring_msg);
+		version = stream_getc(ring_msg);
+		vrf_id = stream_getw(ring_msg);
+		command = stream_getw(ring_msg);
+		if(marker != ZEBRA_HEADER_MARKER || version != ZSERV_VERSION || length != len) {
+			ret = -1;
+			break;
+		}
+
+		/* the readers all read from ibuf */
+		client->ibuf = ring_msg;
+		client->ring_read_cnt++;
+		zebra_client_dispatch(client, command, length - ZEBRA_HEADER_SIZE, vrf_id);
+		client->ibuf = ibuf;
+
+		if(client->t_suicide) {
+			zebra_client_close(client);
+			return -1;
+		}
+	}
+
+	if(ret < 0) {
+		zlog_warn("%s client fd %d: corrupt message in its ring, closing", zebra_route_string(client->proto), client->sock);
+		zebra_client_close(client);
+		return -1;
+	}
+	return ret;
+}
+
+static int zebra_client_ring_read(struct thread *thread) {
+	struct zserv *client = THREAD_ARG(thread);
+	int ret;
+
+	client->t_ring = NULL;
+	if(client->t_suicide) {
+		zebra_client_close(client);
+		return -1;
+	}
+
+	if((ret = zebra_client_ring_drain(client, ZSERV_RING_BATCH)) < 0) {
+		return -1;
+	}
+	if(ret == 0 && zring_sleep_data(client->ring)) {
+		client->t_ring = thread_add_read(zebrad.master, zebra_client_ring_read, client, client->ring->data_fd);
+	} else {
+		client->t_ring = thread_add_event(zebrad.master, zebra_client_ring_read, client, 0);
+	}
+	return 0;
+}
+
 static int zebra_client_read(struct thread *thread) {
 	int sock;
 	struct zserv *client;
@@ -1386,10 +1850,14 @@ static int zebra_client_read(struct thread *thread) {
 	/* Read length and command (if we don't have it already). */
 	if((already = stream_get_endp(client->ibuf)) < ZEBRA_HEADER_SIZE) {
 		ssize_t nbyte;
-		if(((nbyte = stream_read_try(client->ibuf, sock, ZEBRA_HEADER_SIZE - already)) == 0) || (nbyte == -1)) {
+		if(((nbyte = zserv_read_try(client, ZEBRA_HEADER_SIZE - already)) == 0) || (nbyte == -1)) {
 			if(IS_ZEBRA_DEBUG_EVENT) {
 				zlog_debug("connection closed socket [%d]", sock);
 			}
+			/* what the client queued before it went away */
+			if(nbyte == 0 && already == 0 && client->ring_started && zebra_client_ring_drain(client, UINT_MAX) < 0) {
+				return -1;
+			}
 			zebra_client_close(client);
 			return -1;
 		}
@@ -1430,7 +1898,7 @@ static int zebra_client_read(struct thread *thread) {
 	/* Read rest of data. */
 	if(already < length) {
 		ssize_t nbyte;
-		if(((nbyte = stream_read_try(client->ibuf, sock, length - already)) == 0) || (nbyte == -1)) {
+		if(((nbyte = zserv_read_try(client, length - already)) == 0) || (nbyte == -1)) {
 			if(IS_ZEBRA_DEBUG_EVENT) {
 				zlog_debug("connection closed [%d] when reading zebra data", sock);
 			}
@@ -1446,45 +1914,8 @@ static int zebra_client_read(struct thread *thread) {
 
 	length -= ZEBRA_HEADER_SIZE;
 
-	/* Debug packet information. */
-	if(IS_ZEBRA_DEBUG_EVENT) {
-		zlog_debug("zebra message comes from socket [%d]", sock);
-	}
-
-	if(IS_ZEBRA_DEBUG_PACKET && IS_ZEBRA_DEBUG_RECV) {
-		zlog_debug("zebra message received [%s] %d in VRF %u", zserv_command_string(command), length, vrf_id);
-	}
-
-	client->last_read_time = quagga_time(NULL);
-	client->last_read_cmd = command;
-
-	switch(command) {
-		case ZEBRA_ROUTER_ID_ADD: zread_router_id_add(client, length, vrf_id); break;
-		case ZEBRA_ROUTER_ID_DELETE: zread_router_id_delete(client, length, vrf_id); break;
-		case ZEBRA_INTERFACE_ADD: zread_interface_add(client, length, vrf_id); break;
-		case ZEBRA_INTERFACE_DELETE: zread_interface_delete(client, length, vrf_id); break;
-		case ZEBRA_IPV4_ROUTE_ADD: zread_ipv4_add(client, length, vrf_id); break;
-		case ZEBRA_IPV4_ROUTE_DELETE: zread_ipv4_delete(client, length, vrf_id); break;
-#ifdef HAVE_IPV6
-		case ZEBRA_IPV6_ROUTE_ADD: zread_ipv6_add(client, length, vrf_id); break;
-		case ZEBRA_IPV6_ROUTE_DELETE: zread_ipv6_delete(client, length, vrf_id); break;
-#endif /* HAVE_IPV6 */
-		case ZEBRA_REDISTRIBUTE_ADD: zebra_redistribute_add(command, client, length, vrf_id); break;
-		case ZEBRA_REDISTRIBUTE_DELETE: zebra_redistribute_delete(command, client, length, vrf_id); break;
-		case ZEBRA_REDISTRIBUTE_DEFAULT_ADD: zebra_redistribute_default_add(command, client, length, vrf_id); break;
-		case ZEBRA_REDISTRIBUTE_DEFAULT_DELETE: zebra_redistribute_default_delete(command, client, length, vrf_id); break;
-		case ZEBRA_IPV4_NEXTHOP_LOOKUP:
-		case ZEBRA_IPV4_NEXTHOP_LOOKUP_MRIB: zread_ipv4_nexthop_lookup(command, client, length, vrf_id); break;
-#ifdef HAVE_IPV6
-		case ZEBRA_IPV6_NEXTHOP_LOOKUP: zread_ipv6_nexthop_lookup(client, length, vrf_id); break;
-#endif /* HAVE_IPV6 */
-		case ZEBRA_IPV4_IMPORT_LOOKUP: zread_ipv4_import_lookup(client, length, vrf_id); break;
-		case ZEBRA_HELLO: zread_hello(client); break;
-		case ZEBRA_VRF_UNREGISTER: zread_vrf_unregister(client, length, vrf_id);
-		case ZEBRA_NEXTHOP_REGISTER: zserv_nexthop_register(client, sock, length, vrf_id); break;
-		case ZEBRA_NEXTHOP_UNREGISTER: zserv_nexthop_unregister(client, sock, length); break;
-		default: zlog_info("Zebra received unknown command %d", command); break;
-	}
+	zebra_client_dispatch(client, command, length, vrf_id);
+	zserv_passed_fds_close(client);
 
 	if(client->t_suicide) {
 		/* No need to wait for thread callback, just kill immediately. */
@@ -1722,6 +2153,11 @@ static void zebra_show_client_detail(struct vty *vty, struct zserv *client) {
 	vty_out(vty, "Connected   %-12d%-12d%-12d%s", client->ifadd_cnt, 0, client->ifdel_cnt, VTY_NEWLINE);
 	vty_out(vty, "Interface Up Notifications: %d%s", client->ifup_cnt, VTY_NEWLINE);
 	vty_out(vty, "Interface Down Notifications: %d%s", client->ifdown_cnt, VTY_NEWLINE);
+	vty_out(vty, "Output Backlog: %lu bytes, max %lu%s", (u_long) buffer_pending(client->wb), (u_long) client->backlog_max, VTY_NEWLINE);
+	vty_out(vty, "Redistribution: %s, held %u times, %u routes held%s", client->redist_hold ? "held" : "sent", client->backlog_holds, client->redist_held_cnt, VTY_NEWLINE);
+	if(client->ring) {
+		vty_out(vty, "Ring: %u bytes, %s, %u messages read%s", client->ring->size, client->ring_started ? "started" : "offered", client->ring_read_cnt, VTY_NEWLINE);
+	}
 
 	vty_out(vty, "%s", VTY_NEWLINE);
 	return;
@@ -1781,6 +2217,41 @@ DEFUN(no_ip_forwarding, no_ip_forwarding_cmd, "no ip forwarding", NO_STR IP_STR
 	return CMD_SUCCESS;
 }
 
+DEFUN(zebra_client_backlog, zebra_client_backlog_cmd, "zebra client backlog <65536-1073741824> <0-1073741824>",
+      "Zebra server\n"
+      "Zebra clients\n"
+      "Output waiting to be written to a client\n"
+      "Bytes past which redistribution to the client is held\n"
+      "Bytes at which what was held is sent\n") {
+	u_int32_t high, low;
+
+	VTY_GET_INTEGER_RANGE("high watermark", high, argv[0], 65536, 1073741824);
+	VTY_GET_INTEGER_RANGE("low watermark", low, argv[1], 0, 1073741824);
+	if(low >= high) {
+		vty_out(vty, "%% The low watermark must be below the high one%s", VTY_NEWLINE);
+		return CMD_WARNING;
+	}
+	zebrad.backlog_high = high;
+	zebrad.backlog_low = low;
+	return CMD_SUCCESS;
+}
+
+DEFUN(no_zebra_client_backlog, no_zebra_client_backlog_cmd, "no zebra client backlog",
+      NO_STR "Zebra server\n"
+	     "Zebra clients\n"
+	     "Output waiting to be written to a client\n") {
+	zebrad.backlog_high = ZSERV_BACKLOG_HIGH_DEFAULT;
+	zebrad.backlog_low = ZSERV_BACKLOG_LOW_DEFAULT;
+	return CMD_SUCCESS;
+}
+
+ALIAS(no_zebra_client_backlog, no_zebra_client_backlog_val_cmd, "no zebra client backlog <65536-1073741824> <0-1073741824>",
+      NO_STR "Zebra server\n"
+	     "Zebra clients\n"
+	     "Output waiting to be written to a client\n"
+	     "Bytes past which redistribution to the client is held\n"
+	     "Bytes at which what was held is sent\n")
+
 /* This command is for debugging purpose. */
 DEFUN(show_zebra_client, show_zebra_client_cmd, "show zebra client",
       SHOW_STR "Zebra information"
@@ -1795,6 +2266,13 @@ DEFUN(show_zebra_client, show_zebra_client_cmd, "show zebra client",
 	return CMD_SUCCESS;
 }
 
+DEFUN(show_zebra_rib_queue, show_zebra_rib_queue_cmd, "show zebra rib-queue",
+      SHOW_STR "Zebra information"
+	       "RIB processing queue depth, rate and time in queue") {
+	rib_meta_queue_show(vty);
+	return CMD_SUCCESS;
+}
+
 /* This command is for debugging purpose. */
 DEFUN(show_zebra_client_summary, show_zebra_client_summary_cmd, "show zebra client summary",
       SHOW_STR "Zebra information brief"
@@ -1818,6 +2296,9 @@ static int config_write_table(struct vty *vty) {
 	if(zebrad.rtm_table_default) {
 		vty_out(vty, "table %d%s", zebrad.rtm_table_default, VTY_NEWLINE);
 	}
+	if(zebrad.backlog_high != ZSERV_BACKLOG_HIGH_DEFAULT || zebrad.backlog_low != ZSERV_BACKLOG_LOW_DEFAULT) {
+		vty_out(vty, "zebra client backlog %lu %lu%s", (u_long) zebrad.backlog_high, (u_long) zebrad.backlog_low, VTY_NEWLINE);
+	}
 	return 0;
 }
 
@@ -1926,6 +2407,8 @@ static struct cmd_node zebra_node = { ZEBRA_NODE, "", 1 };
 void zebra_init(void) {
 	/* Client list init. */
 	zebrad.client_list = list_new();
+	zebrad.backlog_high = ZSERV_BACKLOG_HIGH_DEFAULT;
+	zebrad.backlog_low = ZSERV_BACKLOG_LOW_DEFAULT;
 
 	/* Install configuration write function. */
 	install_node(&table_node, config_write_table);
@@ -1939,6 +2422,10 @@ void zebra_init(void) {
 	install_element(CONFIG_NODE, &no_ip_forwarding_cmd);
 	install_element(ENABLE_NODE, &show_zebra_client_cmd);
 	install_element(ENABLE_NODE, &show_zebra_client_summary_cmd);
+	install_element(ENABLE_NODE, &show_zebra_rib_queue_cmd);
+	install_element(CONFIG_NODE, &zebra_client_backlog_cmd);
+	install_element(CONFIG_NODE, &no_zebra_client_backlog_cmd);
+	install_element(CONFIG_NODE, &no_zebra_client_backlog_val_cmd);
 
 #ifdef HAVE_NETLINK
 	install_element(VIEW_NODE, &show_table_cmd);
@@ -50,6 +50,15 @@ struct zserv {
 	struct thread *t_read;
 	struct thread *t_write;
 
+	/* Shared memory ring the client sends through, once it said START,
+	 * and the descriptors passed with the message being read. */
+	struct zring *ring;
+	struct thread *t_ring;
+	int ring_started;
+	int passed_fd[3];
+	int passed_fds;
+	u_int32_t ring_read_cnt;
+
 	/* Thread for delayed close. */
 	struct thread *t_suicide;
 
@@ -71,6 +80,10 @@ struct zserv {
 	/* client's protocol */
 	u_char proto;
 
+	/* Seconds its routes are kept for once it goes, as it is restarting
+	 * gracefully; 0 to remove them at once */
+	u_int32_t gr_time;
+
 	/* Statistics */
 	u_int32_t redist_v4_add_cnt;
 	u_int32_t redist_v4_del_cnt;
@@ -98,6 +111,20 @@ struct zserv {
 
 	int last_read_cmd;
 	int last_write_cmd;
+
+	/* Output backlog.  Past the high watermark, routes redistributed to
+	 * the client are held back, only the latest change of each prefix
+	 * kept, until the backlog drains to the low watermark. */
+	size_t backlog_max;
+	u_int32_t backlog_holds;
+	u_char redist_hold;
+	u_int32_t redist_held_cnt;
+	struct list *redist_held;
+
+	/* Messages are only queued, not written, while set */
+	u_char corked;
+	/* Corked for a burst of interface notifications */
+	u_char notify_corked;
 };
 
 /* Zebra instance */
@@ -112,8 +139,15 @@ struct zebra_t {
 	/* rib work queue */
 	struct work_queue *ribq;
 	struct meta_queue *mq;
+
+	/* client output backlog watermarks, in bytes */
+	size_t backlog_high;
+	size_t backlog_low;
 };
 
+#define ZSERV_BACKLOG_HIGH_DEFAULT (16 * 1024 * 1024)
+#define ZSERV_BACKLOG_LOW_DEFAULT (4 * 1024 * 1024)
+
 /* Prototypes. */
 extern void zebra_init(void);
 extern void zebra_if_init(void);
@@ -133,6 +167,7 @@ extern int zsend_interface_delete(struct zserv *, struct interface *);
 extern int zsend_interface_address(int, struct zserv *, struct interface *, struct connected *);
 extern int zsend_interface_update(int, struct zserv *, struct interface *);
 extern int zsend_route_multipath(int, struct zserv *, struct prefix *, struct rib *);
+extern void zserv_encode_route(struct stream *, int, struct prefix *, struct rib *);
 extern int zsend_router_id_update(struct zserv *, struct prefix *, vrf_id_t);
 
 extern int zsend_interface_link_params(struct zserv *, struct interface *);
@@ -141,5 +176,8 @@ extern pid_t pid;
 
 extern void zserv_create_header(struct stream *s, uint16_t cmd, vrf_id_t);
 extern int zebra_server_send_message(struct zserv *client);
+extern int zebra_server_send_stream(struct zserv *client, struct stream *);
+extern void zserv_cork(struct zserv *client);
+extern void zserv_uncork(struct zserv *client);
 
 #endif /* _ZEBRA_ZEBRA_H */